@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma de
+# Barcelona (UAB), and the INTEL Visual Computing Lab.
+#
+# This work is licensed under the terms of the MIT license.
+# For a copy, see <https://opensource.org/licenses/MIT>.
+
+"""CARLA client based on asyncio, Python 3.5+ only.
+
+The world channel, the measurements reader and the control writer run as
+separate coroutines in a single event loop, so sending the control of a frame
+overlaps with receiving the next ones, without threads contending for the GIL.
+Up to `prefetch` frames are read ahead, once they are not consumed the reader
+stops reading and the server buffers or drops frames as configured.
+
+    async def run(client):
+        await client.connect()
+        positions = await client.request_new_episode('CarlaSettings.ini')
+        await client.new_episode(0)
+        while True:
+            measurements = await client.get_measurements()
+            client.send_command(control)
+"""
+
+import asyncio
+import logging
+import struct
+
+from .datastream import DataStream
+from .protoc import *
+
+
+async def _read_message(reader):
+    size, = struct.unpack('<L', await reader.readexactly(4))
+    return await reader.readexactly(size)
+
+
+def _pack_message(message):
+    data = message.SerializeToString()
+    return struct.pack('<L', len(data)) + data
+
+
+class AsyncCARLA(object):
+
+    def __init__(self, host, port, prefetch=2):
+        self._host = host
+        self._port = port
+        self._prefetch = prefetch
+        self._world = None
+        self._shared_memory_name = ''
+        self._episode_ready = None
+        self._agent_writers = []
+        self._agent_tasks = []
+        self._frames = None
+        self._controls = None
+        self._parser = None
+
+    async def connect(self):
+        self._world = await self._open_connection(self._port)
+        logging.debug('connected to the world port %d' % self._port)
+
+    async def request_new_episode(self, ini_path):
+        """Send the settings file and return the player start spots."""
+        with open(ini_path, 'r') as ini_file:
+            data = ini_file.read()
+        request = RequestNewEpisode()
+        request.ini_file = data.encode('utf-8')
+        persistent = (self._episode_ready is not None and
+                      self._episode_ready.persistent_agent_connections)
+        if not persistent:
+            await self._stop_agent()
+        reader, writer = self._world
+        writer.write(_pack_message(request))
+        await writer.drain()
+        scene = SceneDescription()
+        scene.ParseFromString(await _read_message(reader))
+        self._shared_memory_name = scene.shared_memory_images
+        return scene.player_start_spots
+
+    async def new_episode(self, start_index):
+        """Start the episode and the agent coroutines, returns the episode
+        ready message.
+        """
+        start = EpisodeStart()
+        start.player_start_spot_index = start_index
+        reader, writer = self._world
+        writer.write(_pack_message(start))
+        await writer.drain()
+        episode_ready = EpisodeReady()
+        episode_ready.ParseFromString(await _read_message(reader))
+        self._episode_ready = episode_ready
+        if episode_ready.agent_connections_reused and self._agent_tasks:
+            logging.debug('reusing the agent connections')
+            self._parser.set_episode(episode_ready.episode_id)
+            self._drain_frames()
+        else:
+            await self._stop_agent()
+            await self._start_agent(episode_ready.episode_id)
+        return episode_ready
+
+    async def get_measurements(self):
+        """Next frame read ahead, same dictionary as CARLA.getMeasurements."""
+        frame = await self._frames.get()
+        if isinstance(frame, Exception):
+            raise frame
+        return frame
+
+    def send_command(self, control):
+        """Queue the control to be sent, returns immediately."""
+        self._controls.put_nowait(control)
+
+    async def close(self):
+        await self._stop_agent()
+        if self._world is not None:
+            self._world[1].close()
+            self._world = None
+
+    async def _open_connection(self, port):
+        for attempt in range(10):
+            try:
+                return await asyncio.open_connection(self._host, port)
+            except OSError:
+                logging.debug('failed to connect to port %d, retrying' % port)
+                await asyncio.sleep(1)
+        raise OSError('unable to connect to port %d' % port)
+
+    async def _start_agent(self, episode_id):
+        stream = await self._open_connection(self._port + 1)
+        control = await self._open_connection(self._port + 2)
+        self._agent_writers = [stream[1], control[1]]
+        self._parser = DataStream(shared_memory_name=self._shared_memory_name)
+        self._parser.set_episode(episode_id)
+        self._frames = asyncio.Queue(maxsize=self._prefetch)
+        self._controls = asyncio.Queue()
+        self._agent_tasks = [
+            asyncio.ensure_future(self._read_measurements(stream[0])),
+            asyncio.ensure_future(self._write_controls(control[1]))]
+
+    async def _stop_agent(self):
+        for task in self._agent_tasks:
+            task.cancel()
+        for writer in self._agent_writers:
+            writer.close()
+        if self._agent_tasks:
+            await asyncio.wait(self._agent_tasks)
+        self._agent_tasks = []
+        self._agent_writers = []
+
+    def _drain_frames(self):
+        while not self._frames.empty():
+            self._frames.get_nowait()
+
+    async def _read_measurements(self, reader):
+        try:
+            while True:
+                data = await _read_message(reader)
+                imagedata = memoryview(await _read_message(reader))
+                frame = self._parser.parse_data(data, imagedata)
+                if frame is not None:
+                    await self._frames.put(frame)
+        except asyncio.CancelledError:
+            raise
+        except Exception as e:
+            logging.exception('measurements stream closed')
+            await self._frames.put(e)
+
+    async def _write_controls(self, writer):
+        while True:
+            control = await self._controls.get()
+            writer.write(_pack_message(control))
+            await writer.drain()
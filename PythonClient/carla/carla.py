@@ -41,6 +41,8 @@ class CARLA(object):
 
 		self._port_control = self._port +2
 		self._port_stream = self._port +1
+		# Host of the agent connections, an episode broker may send us elsewhere.
+		self._agent_host = self._host
 
 		# Default start. Keep it as class param for eventual restart
 		self._image_x =0
@@ -54,10 +56,21 @@ class CARLA(object):
 		self._socket_control = 0
 		self._latest_start = 0
 		self._agent_is_running = False
+		# Whether the server keeps the agent sockets across episodes.
+		self._persistent_agent_connections = False
 
 		self._episode_requested = False
 
 		self._data_stream = None
+
+		# Shared memory segment announced by the server, if any.
+		self._shared_memory_name = ''
+
+		# Totals of the last episode, sent with the next scene description.
+		self._previous_episode_summary = None
+
+		# Last road map downloaded, as (hash, world_to_pixel, pixels).
+		self._road_map = None
 		logging.debug("Started Unreal Client")
 
 
@@ -74,14 +87,15 @@ class CARLA(object):
 	"""
 
 
-	def startAgent(self):
+	def startAgent(self,episode_id=0):
 
-		self._data_stream = DataStream(self._image_x,self._image_y)
+		self._data_stream = DataStream(self._image_x,self._image_y,self._shared_memory_name)
+		self._data_stream.set_episode(episode_id)
 
 		logging.debug("Going to Connect Stream and start thread")
 		# Perform persistent connections, try up to 10 times
 		try:
-			self._socket_stream = socket_util.pers_connect(self._host ,self._port_stream)
+			self._socket_stream = socket_util.pers_connect(self._agent_host ,self._port_stream)
 		except Exception:
 			logging.exception("Attempts to connect Stream all failed, restart...")	
 			self.restart()
@@ -90,7 +104,7 @@ class CARLA(object):
 		logging.debug("Streaming Thread  Started")
 
 		try:
-			self._socket_control = socket_util.pers_connect(self._host ,self._port_control)
+			self._socket_control = socket_util.pers_connect(self._agent_host ,self._port_control)
 		except Exception:
 			logging.exception("Attempts to connect Agent all failed, restart ...")
 			self.restart()
@@ -125,6 +139,11 @@ class CARLA(object):
 			scene = SceneDescription()
 			scene.ParseFromString(data)
 			logging.debug("Received Scene Configuration")
+			self._shared_memory_name = scene.shared_memory_images
+			if scene.HasField('previous_episode_summary'):
+				self._previous_episode_summary = scene.previous_episode_summary
+			else:
+				self._previous_episode_summary = None
 
 
 			return scene.player_start_spots
@@ -169,7 +188,7 @@ class CARLA(object):
 
 
 
-		if self._agent_is_running:	
+		if self._agent_is_running and not self._persistent_agent_connections:
 			self.stopAgent()
 		self._episode_requested = True
 
@@ -214,11 +233,32 @@ class CARLA(object):
 		else:
 			logging.debug("Episode is Ready")
 
-		self.startAgent()
+		self._persistent_agent_connections = episode_ready.persistent_agent_connections
+		if self._agent_is_running and not episode_ready.agent_connections_reused:
+			self.stopAgent()
+		if self._agent_is_running:
+			logging.debug("Reusing the agent connections")
+			self._data_stream.set_episode(episode_ready.episode_id)
+		else:
+			self._set_agent_server(episode_ready)
+			self.startAgent(episode_ready.episode_id)
 		self._episode_requested = False
 
 
 
+	def _set_agent_server(self,episode_ready):
+		if episode_ready.server_host:
+			logging.debug("Redirected to %s:%d" % (episode_ready.server_host,episode_ready.server_world_port))
+			self._agent_host = episode_ready.server_host
+			agent_world_port = episode_ready.server_world_port
+		else:
+			self._agent_host = self._host
+			agent_world_port = self._port
+		self._port_stream = agent_world_port +1
+		self._port_control = agent_world_port +2
+
+
+
 	"""  Measurements 
 		 returns
 		 @game time
@@ -267,6 +307,65 @@ class CARLA(object):
 			
 
 
+	"""
+	Ask the server for the shortest route along the lanes from start, a
+	Transform, to the location of end. Returns a Route message, with success
+	False if there is none. Only while an episode runs, which goes on.
+	"""
+
+	def requestRoute(self,start,end):
+		request = RequestNewEpisode()
+		request.route.start.CopyFrom(start)
+		request.route.end.CopyFrom(end)
+		socket_util.send_message(self._socket_world,request)
+		route = Route()
+		route.ParseFromString(socket_util.get_message(self._socket_world))
+		return route
+
+
+	"""
+	Ask the server for the road map of the city. Returns a tuple of the
+	transform from world locations to pixels, a 2x4 numpy array, and the
+	pixels, a height x width numpy array of uint16, or None if the map has no
+	road map. The map is only downloaded again if it changed. Only while an
+	episode runs, which goes on.
+	"""
+
+	def requestRoadMap(self):
+		request = RequestNewEpisode()
+		request.road_map = True
+		if self._road_map is not None:
+			request.cached_road_map_hash = self._road_map[0]
+		socket_util.send_message(self._socket_world,request)
+		road_map = RoadMap()
+		road_map.ParseFromString(socket_util.get_message(self._socket_world))
+		if not road_map.success:
+			return None
+		if road_map.data:
+			self._road_map = (road_map.hash,) + _decode_road_map(road_map.data)
+		return self._road_map[1:]
+
+
+	"""
+	Totals of the episode that ended with the last requestNewEpisode, as an
+	EpisodeSummary message, or None for the first episode.
+	"""
+
+	def getPreviousEpisodeSummary(self):
+		return self._previous_episode_summary
+
+
+	"""
+	Tell the server the client is alive, to be called periodically while
+	computing the next command if the server has a LivenessTimeOut.
+	"""
+
+	def sendHeartbeat(self):
+		socket_util.send_heartbeat(self._socket_world)
+		if self._agent_is_running:
+			socket_util.send_heartbeat(self._socket_control)
+
+
 	def restart(self):
 		logging.debug("Trying to close clients") 
 		self.closeConections()
@@ -274,6 +373,7 @@ class CARLA(object):
 		if self._data_stream != None:
 			self._data_stream._running = False
 		self._agent_is_running = False
+		self._persistent_agent_connections = False
 		while not connected:
 			try:
 				logging.debug("Trying to connect to the world thread")
@@ -283,7 +383,7 @@ class CARLA(object):
 				logging.exception("Couldn't connected ... retry in 10 seconds...")
 				time.sleep(10)
 
-		self._data_stream = DataStream(self._image_x,self._image_y)
+		self._data_stream = DataStream(self._image_x,self._image_y,self._shared_memory_name)
 
 		
 		positions = self.requestNewEpisode()
@@ -296,7 +396,7 @@ class CARLA(object):
 		connected = False 
 
 		self._data_stream._running = False
-		self._data_stream = DataStream(self._image_x,self._image_y)
+		self._data_stream = DataStream(self._image_x,self._image_y,self._shared_memory_name)
 
 	def closeConections(self):
 
@@ -320,4 +420,32 @@ class CARLA(object):
 			self._socket_control.close()
 			logging.debug("Close Control")
 		except Exception as ex:
-			logging.exception("Exception on closing Connections")
\ No newline at end of file
+			logging.exception("Exception on closing Connections")
+
+
+def _decode_road_map(data):
+	# Header of (magic, version, width, height, tile size, number of tiles,
+	# world to pixel transform, hash), then a table of (offset, size) per
+	# tile, a uniform tile has size zero and its value as offset.
+	import numpy as np
+	import lz4.block
+	magic, version, width, height, tile_size, number_of_tiles = struct.unpack('<6L', data[0:24])
+	if magic != 0x50414d52 or version != 1:
+		raise ValueError('unknown road map encoding')
+	world_to_pixel = np.reshape(np.array(struct.unpack('<8f', data[24:56])), (2,4))
+	tiles_x = (width + tile_size - 1) // tile_size
+	tiles_y = (height + tile_size - 1) // tile_size
+	pixels = np.empty((tiles_y*tile_size, tiles_x*tile_size), dtype=np.uint16)
+	for i in range(number_of_tiles):
+		offset, size = struct.unpack('<2L', data[(64+8*i):(72+8*i)])
+		y = (i // tiles_x) * tile_size
+		x = (i % tiles_x) * tile_size
+		if size == 0:
+			pixels[y:(y+tile_size), x:(x+tile_size)] = offset
+		else:
+			tile = lz4.block.decompress(
+				data[offset:(offset+size)],
+				uncompressed_size=2*tile_size*tile_size)
+			pixels[y:(y+tile_size), x:(x+tile_size)] = np.reshape(
+				np.frombuffer(tile, dtype=np.dtype('<u2')), (tile_size, tile_size))
+	return world_to_pixel, pixels[:height, :width]
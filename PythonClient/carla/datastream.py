@@ -23,6 +23,8 @@ from PIL import Image
 from .socket_util import *
 import io
 import sys
+import mmap
+import os
 import numpy as np
 import logging
 
@@ -45,7 +47,7 @@ def threaded(fn):
 
 class DataStream(object):
 
-    def __init__(self,image_x=640,image_y=480):
+    def __init__(self,image_x=640,image_y=480,shared_memory_name=''):
         self._data_buffer = Queue.Queue(1)
         self._image_x = image_x
         self._image_y = image_y
@@ -53,36 +55,214 @@ class DataStream(object):
         self._socket = 0
         self._running = True
 
-
-
-    def _read_image(self,imagedata,pointer):
-
-
-        width = struct.unpack('<L',imagedata[pointer:(pointer+4)])[0]
-
-        pointer +=4
-        height = struct.unpack('<L',imagedata[pointer:(pointer+4)])[0]
-        pointer +=4
-        im_type = struct.unpack('<L',imagedata[pointer:(pointer+4)])[0]
-        pointer +=4
-
-
-        image_size = width*height*4
-
-        image_bytes = imagedata[pointer:(pointer+image_size)]
-
-
-        dt = np.dtype("uint8")
-
-        new_image =np.frombuffer(image_bytes,dtype=dt)
-
-        new_image = np.reshape(new_image,(self._image_y,self._image_x,4)) # TODO: make this generic
-
-        pointer += image_size
-
-
-
-        return new_image,im_type,pointer
+        # Last known state of each agent, for delta agents mode.
+        self._agents = {}
+
+        # Segment where the server writes the images, mapped on first use.
+        self._shared_memory_name = shared_memory_name
+        self._shared_memory = None
+
+        # Measurements of other episodes are discarded, zero accepts any.
+        self._episode_id = 0
+
+        # Last compressed image decoded of each camera, as (frame number,
+        # pixels), the delta compressed images are applied on top.
+        self._image_history = {}
+
+
+
+    def _read_image(self,imagedata,entry,camera_index,frame_number):
+
+        # Header table of (offset, width, height, type, stride, encoding,
+        # screen percentage).
+        offset, width, height, im_type, stride, encoding, screen_percentage = struct.unpack(
+            '<7L', imagedata[entry:(entry+28)])
+
+        # Compression in the upper 16 bits of the encoding, LZ4 blocks are
+        # preceded by their compressed size. Deltas have the frame number of
+        # the image they are against in between, and are dropped if that is
+        # not the last image of the camera, until its next key frame.
+        compression = encoding >> 16
+        encoding = encoding & 0xFFFF
+        if compression == 1:
+            import lz4.block
+            size, = struct.unpack('<L', imagedata[offset:(offset+4)])
+            image_bytes = lz4.block.decompress(
+                bytes(imagedata[(offset+4):(offset+4+size)]),
+                uncompressed_size=stride*height)
+            self._image_history[camera_index] = (frame_number, image_bytes)
+        elif compression == 2:
+            import lz4.block
+            size, base_frame_number = struct.unpack('<LQ', imagedata[offset:(offset+12)])
+            delta = lz4.block.decompress(
+                bytes(imagedata[(offset+12):(offset+12+size)]),
+                uncompressed_size=stride*height)
+            base = self._image_history.pop(camera_index, None)
+            if base is None or base[0] != base_frame_number or len(base[1]) != len(delta):
+                return None,im_type,screen_percentage
+            image_bytes = np.bitwise_xor(
+                np.frombuffer(delta,dtype=np.uint8),
+                np.frombuffer(base[1],dtype=np.uint8)).tobytes()
+            self._image_history[camera_index] = (frame_number, image_bytes)
+        else:
+            # A slice of the memoryview, no copy.
+            image_bytes = imagedata[offset:(offset+stride*height)]
+
+        # Encodings BGRA8, Float32, Float16, Gray8, BGR8, point clouds and
+        # motion vectors.
+        if encoding == 7:
+            new_image = np.frombuffer(image_bytes,dtype=np.dtype("<f2"))
+            new_image = np.reshape(new_image,(height,width,2))
+        elif encoding == 5:
+            new_image = np.frombuffer(image_bytes,dtype=np.dtype("<f4"))
+            new_image = np.reshape(new_image,(width*height,4))
+        elif encoding == 1:
+            new_image = np.frombuffer(image_bytes,dtype=np.dtype("float32"))
+            new_image = np.reshape(new_image,(height,width))
+        elif encoding == 2:
+            new_image = np.frombuffer(image_bytes,dtype=np.dtype("float16"))
+            new_image = np.reshape(new_image,(height,width))
+        elif encoding == 3:
+            new_image = np.frombuffer(image_bytes,dtype=np.dtype("uint8"))
+            new_image = np.reshape(new_image,(height,width))
+        elif encoding == 4:
+            new_image = np.frombuffer(image_bytes,dtype=np.dtype("uint8"))
+            new_image = np.reshape(new_image,(height,width,3))
+        else:
+            dt = np.dtype("uint8")
+
+            new_image =np.frombuffer(image_bytes,dtype=dt)
+
+            new_image = np.reshape(new_image,(height,width,4))
+
+        return new_image,im_type,screen_percentage
+
+
+    def _read_shared_memory_images(self,sequence):
+
+        # Only POSIX shared memory (Linux) is supported, see SharedMemoryImages
+        # in the server for the layout of the segment.
+        if self._shared_memory is None:
+            path = os.path.join('/dev/shm',self._shared_memory_name)
+            with open(path,'rb') as segment:
+                self._shared_memory = mmap.mmap(segment.fileno(),0,access=mmap.ACCESS_READ)
+        shm = self._shared_memory
+        magic, version, number_of_slots, slot_size = struct.unpack('<4L', shm[0:16])
+        if magic != 0x414c5243 or version != 1:
+            raise RuntimeError('invalid shared memory segment %s' % self._shared_memory_name)
+
+        slot = 64 + ((sequence - 1) % number_of_slots) * (64 + slot_size)
+        def slot_sequence():
+            return struct.unpack('<Q', shm[slot:(slot+8)])[0]
+
+        # The slot is rewritten if we fall behind by more than number_of_slots
+        # frames, check the sequence before and after copying.
+        if slot_sequence() != sequence:
+            return None
+        size, = struct.unpack('<L', shm[(slot+64):(slot+68)])
+        imagedata = shm[(slot+68):(slot+68+size)]
+        if slot_sequence() != sequence:
+            return None
+        return imagedata
+
+
+    def _read_packed_agents(self,packed):
+
+        # Structure of arrays, see PackedAgents and AgentsEncoding in
+        # carla_server.proto.
+        n = packed.number_of_agents
+        data = packed.data
+        ids = np.frombuffer(data,dtype='<u4',count=n)
+        if packed.encoding == AGENTS_QUANTIZED:
+            types = np.frombuffer(data,dtype='u1',count=n,offset=4*n)
+            locations = np.frombuffer(data,dtype='<i4',count=3*n,offset=5*n)
+            orientations = np.frombuffer(data,dtype='<i2',count=3*n,offset=17*n)
+            extents = np.frombuffer(data,dtype='<u2',count=3*n,offset=23*n)
+            speeds = np.frombuffer(data,dtype='<f4',count=n,offset=29*n)
+        elif packed.encoding == AGENTS_QUANTIZED_DELTA:
+            values, offset = self._read_varint_deltas(data,n,11)
+            ids = values[:n]
+            types = values[n:2*n]
+            locations = values[2*n:5*n]
+            orientations = values[5*n:8*n]
+            extents = values[8*n:]
+            speeds = np.frombuffer(data,dtype='<f4',count=n,offset=offset)
+        elif packed.encoding == AGENTS_HALF_FLOAT:
+            types = np.frombuffer(data,dtype='u1',count=n,offset=4*n)
+            halfs = np.frombuffer(data,dtype='<f2',count=10*n,offset=5*n)
+            halfs = halfs.astype(np.float32)
+            locations = halfs[:3*n]
+            orientations = halfs[3*n:6*n]
+            extents = halfs[6*n:9*n]
+            speeds = halfs[9*n:]
+        else:
+            types = np.frombuffer(data,dtype='<u4',count=n,offset=4*n)
+            vectors = np.frombuffer(data,dtype='<f4',count=9*n,offset=8*n)
+            vectors = np.reshape(vectors,(3,n,3))
+            return {'Ids':ids,'Types':types,'Locations':vectors[0],
+                    'Orientations':vectors[1],'BoxExtents':vectors[2],
+                    'ForwardSpeeds':np.frombuffer(
+                        data,dtype='<f4',count=n,offset=44*n)}
+        if packed.encoding != AGENTS_HALF_FLOAT:
+            locations = locations.astype(np.float32)
+            orientations = orientations.astype(np.float32) / 32767.0
+            extents = extents.astype(np.float32)
+
+        return {'Ids':ids,'Types':types,
+                'Locations':np.reshape(locations,(n,3)),
+                'Orientations':np.reshape(orientations,(n,3)),
+                'BoxExtents':np.reshape(extents,(n,3)),
+                'ForwardSpeeds':speeds}
+
+
+    def _read_varint_deltas(self,data,n,number_of_columns):
+
+        # Zigzag varint deltas of AGENTS_QUANTIZED_DELTA, the vectors delta per
+        # component.
+        zigzags = np.zeros(n*number_of_columns,dtype=np.int64)
+        offset = 0
+        for index in range(n*number_of_columns):
+            zigzag = 0
+            shift = 0
+            while True:
+                byte = ord(data[offset]) if is_py2 else data[offset]
+                offset += 1
+                zigzag |= (byte & 0x7F) << shift
+                shift += 7
+                if byte < 0x80:
+                    break
+            zigzags[index] = zigzag
+        deltas = (zigzags >> 1) ^ -(zigzags & 1)
+        scalars = np.cumsum(np.reshape(deltas[:2*n],(2,n)),axis=1)
+        vectors = np.cumsum(np.reshape(deltas[2*n:],(-1,n,3)),axis=1)
+        values = np.concatenate([scalars.ravel(),vectors.ravel()])
+        return values, offset
+
+
+    def _read_agent_boxes(self,camera):
+
+        # Structure of arrays, see AgentBoxes2D in carla_server.proto.
+        n = camera.number_of_boxes
+        data = camera.data
+        ids = np.frombuffer(data,dtype='<u4',count=n)
+        boxes = np.frombuffer(data,dtype='<f4',count=4*n,offset=4*n)
+        boxes = np.reshape(boxes,(n,4))
+        flags = np.frombuffer(data,dtype='<u4',count=n,offset=20*n)
+
+        return {'Ids':ids,'Boxes':boxes,'Flags':flags}
+
+
+    def _merge_agents(self,measurements):
+
+        # Apply the agents received on top of the last known ones.
+        if not measurements.non_player_agents_delta:
+            self._agents = {}
+        for agent_id in measurements.removed_non_player_agents:
+            self._agents.pop(agent_id, None)
+        for agent in measurements.non_player_agents:
+            self._agents[agent.id] = agent
+
+        return list(self._agents.values())
 
 
     def receive_data(self):
@@ -100,21 +280,39 @@ class DataStream(object):
             return [] # return something empty, since it is not running anymore
 
 
-        measurements = Measurements()
-        measurements.ParseFromString(data)
-        
-        player_measures = measurements.player_measurements
-        non_player_agents = measurements.non_player_agents
-        
         try:
             logging.debug(" Trying to get the image")
-            imagedata  = get_message(self._socket)
+            # Received in place, the images below are views of this buffer.
+            imagedata  = get_message_buffer(self._socket)
         except Exception:
             if self._running:
                 logging.exception("Error on Datastream, Raise Again")
                 raise Exception
             return [] # return something empty, since it is not running anymore
 
+        return self.parse_data(data,imagedata)
+
+
+    def parse_data(self,data,imagedata):
+
+        # Measurements and images messages as received, returns None if the
+        # measurements belong to another episode.
+        measurements = Measurements()
+        measurements.ParseFromString(data)
+
+        player_measures = measurements.player_measurements
+        non_player_agents = measurements.non_player_agents
+
+        if self._episode_id and measurements.episode_id != self._episode_id:
+            logging.debug("Discarding measurements of episode %d" % measurements.episode_id)
+            return None
+
+        if measurements.shared_memory_images_sequence > 0:
+            imagedata = self._read_shared_memory_images(
+                measurements.shared_memory_images_sequence)
+            if imagedata is None:
+                logging.warning("Images overwritten in shared memory, dropping them")
+                imagedata = struct.pack('<2L', 2, 0)
 
         meas_dict ={}
         meas_dict.update({'RAW_BGRA':[]})
@@ -125,10 +323,28 @@ class DataStream(object):
 
         meas_dict.update({'Labels':[]})
 
+        meas_dict.update({'Lidar':[]})
+
+        # Screen percentage each image was rendered at, in order of arrival.
+        meas_dict.update({'ScreenPercentages':[]})
 
-        pointer = 0
-        while pointer < len(imagedata):
-            image,im_type,pointer = self._read_image(imagedata,pointer)
+
+        version, number_of_images = struct.unpack('<2L', imagedata[0:8])
+        if version != 3:
+            raise RuntimeError('unsupported image message version %d' % version)
+
+        camera_indices = measurements.image_camera_indices
+        frame_numbers = measurements.image_frame_numbers
+        for index in range(number_of_images):
+            entry = 8 + 28 * index
+            image,im_type,screen_percentage = self._read_image(
+                imagedata,entry,
+                camera_indices[index] if index < len(camera_indices) else index,
+                frame_numbers[index] if index < len(frame_numbers) else 0)
+            if image is None:
+                logging.debug("Dropping delta image, previous image missing")
+                continue
+            meas_dict['ScreenPercentages'].append(screen_percentage)
             if im_type == 0:
 
                 meas_dict['RAW_BGRA'].append(image)
@@ -145,6 +361,10 @@ class DataStream(object):
 
                 meas_dict['Labels'].append(image)
                 logging.debug("RECEIVED scene_seg")
+            if im_type == 4:
+
+                meas_dict['Lidar'].append(image)
+                logging.debug("RECEIVED lidar")
 
         meas_dict.update({'WallTime':measurements.platform_timestamp})
 
@@ -152,8 +372,34 @@ class DataStream(object):
 
         meas_dict.update({'PlayerMeasurements':player_measures})
 
+        if measurements.non_player_agents_delta or self._agents:
+            non_player_agents = self._merge_agents(measurements)
+
         meas_dict.update({'Agents':non_player_agents})
 
+        meas_dict.update({'RemovedAgents':list(measurements.removed_non_player_agents)})
+
+        if measurements.HasField('packed_non_player_agents'):
+            meas_dict.update({'PackedAgents':self._read_packed_agents(
+                measurements.packed_non_player_agents)})
+
+        # Boxes of the agents by camera index, boxes as min x, min y, max x,
+        # max y in pixels.
+        meas_dict.update({'AgentBoxes':dict(
+            (camera.camera_index,self._read_agent_boxes(camera))
+            for camera in measurements.agent_boxes)})
+
+        # Pixels of each semantic label by camera index, indexed by label.
+        meas_dict.update({'ClassHistograms':dict(
+            (histogram.camera_index,np.array(histogram.counts,dtype=np.uint32))
+            for histogram in measurements.class_histograms)})
+
+        # Collisions of the player during the last frame, one per component
+        # hit, as (other agent id, label, summed normal impulse).
+        meas_dict.update({'CollisionEvents':[
+            (event.other_actor_id,event.label,event.normal_impulse)
+            for event in measurements.collision_events]})
+
         return meas_dict
 
 
@@ -178,6 +424,11 @@ class DataStream(object):
 
 
 
+    def set_episode(self,episode_id):
+
+        self._episode_id = episode_id
+        self.clean()
+
     def start(self,socket):
 
         self._socket = socket
@@ -190,6 +441,9 @@ class DataStream(object):
         self._running = False
 
         disconnect(self._socket)
+        if self._shared_memory is not None:
+            self._shared_memory.close()
+            self._shared_memory = None
         self.clean()
 
     # We clean the buffer so that no old data is going to be used
@@ -206,7 +460,9 @@ class DataStream(object):
         try:
             while self._running:
                 try:
-                    self._data_buffer.put(self.receive_data(),timeout=20)
+                    data = self.receive_data()
+                    if data is not None:
+                        self._data_buffer.put(data,timeout=20)
                 except Queue.Full:
                     logging.exception("ERROR: Queue Full for more than 20 seconds...")
                 except Exception as e:
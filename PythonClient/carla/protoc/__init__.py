@@ -1,2 +1,3 @@
-from .carla_server_pb2 import  SceneDescription,EpisodeStart,EpisodeReady,Control,Measurements,RequestNewEpisode
+from .carla_server_pb2 import  SceneDescription,EpisodeStart,EpisodeReady,Control,Measurements,RequestNewEpisode,Route,RoadMap
+from .carla_server_pb2 import AGENTS_FLOAT32,AGENTS_QUANTIZED,AGENTS_QUANTIZED_DELTA,AGENTS_HALF_FLOAT
 
@@ -68,6 +68,14 @@ def send_message(sock, message):
 	sock.sendall(packed_len + s)
 
 
+def send_heartbeat(sock):
+	""" Tell the server the client is alive, a reserved length
+	    sent alone in place of a message.
+	"""
+
+	sock.sendall(struct.pack('<L', 0xFFFFFFFF))
+
+
 
 
 def get_message(sock):
@@ -85,30 +93,54 @@ def get_message(sock):
 	return msg_buf
 
 
+def get_message_buffer(sock):
+	""" Read a message from a socket into a buffer allocated
+	    for its size, returns a memoryview of it. Slices of the
+	    view (e.g. numpy.frombuffer) do not copy the message.
+	"""
+
+	len_buf = socket_read_n(sock, 4)
+
+	msg_len = struct.unpack('<L', len_buf)[0]
+	logging.debug( "SOCKET RECEIVED: %d bytes" % msg_len)
+
+	msg_buf = memoryview(bytearray(msg_len))
+	socket_read_into(sock, msg_buf)
+
+	return msg_buf
+
+
 def socket_read_n(sock,n):
 	""" Read exactly n bytes from the socket.
 	    Raise RuntimeError if the connection closed before
 	    n bytes were read.
 	"""
 
-	buf = b''
-	while n > 0:
-	
+	buf = bytearray(n)
+	socket_read_into(sock, memoryview(buf))
+
+	return bytes(buf)
+
+
+def socket_read_into(sock,view):
+	""" Fill the writable memoryview with bytes from the socket,
+	    in place. Raise RuntimeError if the connection closed
+	    before the view was filled.
+	"""
+
+	n = len(view)
+	received = 0
+	while received < n:
+
 		sock.setblocking(0)
 		ready = select.select([sock], [], [], 3)
 		if ready[0]:
 			try:
-				data = sock.recv(n)
-				if data == b'':
+				size = sock.recv_into(view[received:], n - received)
+				if size == 0:
 					raise RuntimeError('unexpected connection close')
-				buf += data
-				n -= len(data)
+				received += size
 			except socket.error:
 				raise socket.error
 
 	sock.setblocking(1)
-
-
-	return buf
-
-
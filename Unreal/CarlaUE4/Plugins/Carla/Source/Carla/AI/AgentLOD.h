@@ -0,0 +1,50 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+/// Distance based level of detail of the AI agents. Agents far from the view
+/// point of every local player can be updated at a lower rate.
+class FAgentLOD
+{
+public:
+
+  /// Collect the view points of the local players. The cameras of the player
+  /// are attached to its vehicle, so this covers them too.
+  static void GetViewLocations(const UWorld &World, TArray<FVector> &ViewLocations)
+  {
+    ViewLocations.Reset();
+    for (auto It = World.GetPlayerControllerIterator(); It; ++It) {
+      const APlayerController *Controller = It->Get();
+      // NPC vehicles have player controllers too, but no local player.
+      if ((Controller != nullptr) && (Controller->GetLocalPlayer() != nullptr)) {
+        FVector Location;
+        FRotator Rotation;
+        Controller->GetPlayerViewPoint(Location, Rotation);
+        ViewLocations.Add(Location);
+      }
+    }
+  }
+
+  /// Whether @a Location is further than @a Distance from every view point.
+  /// Always false if there are no view points.
+  static bool IsFar(
+      const FVector &Location,
+      const TArray<FVector> &ViewLocations,
+      const float Distance)
+  {
+    const float DistanceSquared = Distance * Distance;
+    for (const auto &ViewLocation : ViewLocations) {
+      if (FVector::DistSquared(Location, ViewLocation) <= DistanceSquared) {
+        return false;
+      }
+    }
+    return (ViewLocations.Num() > 0);
+  }
+};
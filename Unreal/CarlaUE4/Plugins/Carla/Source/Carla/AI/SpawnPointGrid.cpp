@@ -0,0 +1,74 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "SpawnPointGrid.h"
+
+#include "Util/RandomEngine.h"
+
+void FSpawnPointGrid::Build(const TArray<FVector> &InLocations, const float InCellSize)
+{
+  check(InCellSize > 0.0f);
+  CellSize = InCellSize;
+  Locations = InLocations;
+  Cells.Reset();
+  for (auto i = 0; i < Locations.Num(); ++i) {
+    Cells.FindOrAdd(GetCell(Locations[i])).Add(i);
+  }
+}
+
+FIntPoint FSpawnPointGrid::GetCell(const FVector &Location) const
+{
+  return {
+    FMath::FloorToInt(Location.X / CellSize),
+    FMath::FloorToInt(Location.Y / CellSize)};
+}
+
+void FSpawnPointGrid::FindNear(
+    const FVector &Location,
+    const float Radius,
+    TArray<int32> &OutIndices) const
+{
+  OutIndices.Reset();
+  const FIntPoint Min = GetCell(Location - FVector(Radius, Radius, 0.0f));
+  const FIntPoint Max = GetCell(Location + FVector(Radius, Radius, 0.0f));
+  const float RadiusSquared = Radius * Radius;
+  for (auto X = Min.X; X <= Max.X; ++X) {
+    for (auto Y = Min.Y; Y <= Max.Y; ++Y) {
+      const auto *Cell = Cells.Find({X, Y});
+      if (Cell == nullptr) {
+        continue;
+      }
+      for (const int32 Index : *Cell) {
+        if (FVector::DistSquared(Location, Locations[Index]) < RadiusSquared) {
+          OutIndices.Add(Index);
+        }
+      }
+    }
+  }
+}
+
+int32 FSpawnPointGrid::PickFar(
+    const FVector &Location,
+    const float MinimumDistance,
+    URandomEngine &RandomEngine) const
+{
+  FindNear(Location, MinimumDistance, NearIndices);
+  const int32 Count = Locations.Num() - NearIndices.Num();
+  if (Count <= 0) {
+    return INDEX_NONE;
+  }
+  // Pick the n-th point not near, skipping the near ones in index order.
+  NearIndices.Sort();
+  int32 Index = RandomEngine.GetUniformIntInRange(0, Count - 1);
+  for (const int32 Near : NearIndices) {
+    if (Near > Index) {
+      break;
+    }
+    ++Index;
+  }
+  return Index;
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Util/NonCopyable.h"
+
+class URandomEngine;
+
+/// Uniform 2D grid of the locations of the spawn points, built once. Finding
+/// the points near a location only visits the cells around it, so picking a
+/// point far enough from a location costs the same however many points the
+/// level has.
+class CARLA_API FSpawnPointGrid : private NonCopyable
+{
+public:
+
+  /// Index @a InLocations in cells of @a InCellSize centimeters.
+  void Build(const TArray<FVector> &InLocations, float InCellSize);
+
+  int32 Num() const
+  {
+    return Locations.Num();
+  }
+
+  const FVector &GetLocation(const int32 Index) const
+  {
+    return Locations[Index];
+  }
+
+  /// Indices of the points closer than @a Radius to @a Location.
+  void FindNear(const FVector &Location, float Radius, TArray<int32> &OutIndices) const;
+
+  /// Index of a point picked at random, uniformly, among those at least
+  /// @a MinimumDistance away from @a Location. INDEX_NONE if there is none.
+  int32 PickFar(const FVector &Location, float MinimumDistance, URandomEngine &RandomEngine) const;
+
+private:
+
+  FIntPoint GetCell(const FVector &Location) const;
+
+  float CellSize = 1000.0f;
+
+  TMap<FIntPoint, TArray<int32>> Cells;
+
+  TArray<FVector> Locations;
+
+  /// Scratch of PickFar.
+  mutable TArray<int32> NearIndices;
+};
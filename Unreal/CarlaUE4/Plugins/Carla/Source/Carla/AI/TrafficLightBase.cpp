@@ -99,8 +99,21 @@ void ATrafficLightBase::NotifyWheeledVehicle(ACarlaWheeledVehicle *Vehicle)
     if (Controller != nullptr) {
       Controller->SetTrafficLightState(State);
       if (State != ETrafficLightState::Green) {
-        Vehicles.Add(Controller);
+        Vehicles.AddUnique(Controller);
       }
     }
   }
 }
+
+float ATrafficLightBase::GetStateDuration(const ETrafficLightState InState) const
+{
+  switch (InState) {
+    case ETrafficLightState::Green:
+      return GreenTime;
+    case ETrafficLightState::Yellow:
+      return YellowTime;
+    default:
+    case ETrafficLightState::Red:
+      return RedTime;
+  }
+}
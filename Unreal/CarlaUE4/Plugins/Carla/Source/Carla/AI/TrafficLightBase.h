@@ -48,6 +48,30 @@ public:
   UFUNCTION(Category = "Traffic Light", BlueprintCallable)
   void NotifyWheeledVehicle(ACarlaWheeledVehicle *Vehicle);
 
+  /// Duration in seconds of @a InState when driven by ATrafficLightTimer.
+  float GetStateDuration(ETrafficLightState InState) const;
+
+  /** If true, the state of this light is driven by the level's traffic light
+    * timer instead of by blueprint.
+    */
+  UPROPERTY(Category = "Traffic Light|Timer", EditAnywhere, BlueprintReadOnly)
+  bool bUseTimer = false;
+
+  UPROPERTY(Category = "Traffic Light|Timer", EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "bUseTimer", ClampMin = "0.1"))
+  float GreenTime = 10.0f;
+
+  UPROPERTY(Category = "Traffic Light|Timer", EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "bUseTimer", ClampMin = "0.1"))
+  float YellowTime = 2.0f;
+
+  UPROPERTY(Category = "Traffic Light|Timer", EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "bUseTimer", ClampMin = "0.1"))
+  float RedTime = 12.0f;
+
+  /** Seconds already elapsed in the initial state at begin play, to
+    * desynchronize the lights of an intersection.
+    */
+  UPROPERTY(Category = "Traffic Light|Timer", EditAnywhere, BlueprintReadOnly, meta = (EditCondition = "bUseTimer", ClampMin = "0.0"))
+  float TimeOffset = 0.0f;
+
 protected:
 
   UFUNCTION(Category = "Traffic Light", BlueprintImplementableEvent)
@@ -0,0 +1,89 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "TrafficLightTimer.h"
+
+#include "EngineUtils.h"
+
+#include "TrafficLightBase.h"
+
+DECLARE_CYCLE_STAT(TEXT("Traffic Light Timer Tick"), STAT_CarlaTrafficLightTimerTick, STATGROUP_Carla);
+
+ATrafficLightTimer::ATrafficLightTimer(const FObjectInitializer& ObjectInitializer) :
+  Super(ObjectInitializer)
+{
+  PrimaryActorTick.bCanEverTick = true;
+  PrimaryActorTick.TickGroup = TG_PrePhysics;
+}
+
+void ATrafficLightTimer::BeginPlay()
+{
+  Super::BeginPlay();
+  FindTrafficLights();
+}
+
+void ATrafficLightTimer::FindTrafficLights()
+{
+  TrafficLights.Reset();
+  TimesLeft.Reset();
+  for (TActorIterator<ATrafficLightBase> It(GetWorld()); It; ++It) {
+    if (It->bUseTimer) {
+      TrafficLights.Add(*It);
+      TimesLeft.Add(It->GetStateDuration(It->GetTrafficLightState()) - It->TimeOffset);
+    }
+  }
+  UE_LOG(LogCarla, Log, TEXT("Traffic light timer driving %d traffic lights"), TrafficLights.Num());
+  SetActorTickEnabled(TrafficLights.Num() > 0);
+}
+
+void ATrafficLightTimer::Tick(const float DeltaTime)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaTrafficLightTimerTick);
+  Super::Tick(DeltaTime);
+
+  for (auto i = 0; i < TrafficLights.Num(); ++i) {
+    TimesLeft[i] -= DeltaTime;
+    if (TimesLeft[i] > 0.0f) {
+      continue;
+    }
+    ATrafficLightBase *TrafficLight = TrafficLights[i];
+    if ((TrafficLight == nullptr) || TrafficLight->IsPendingKill()) {
+      continue;
+    }
+    // A long enough frame may skip a whole state, but we switch at most once
+    // per tick so every state is seen by the vehicles.
+    TrafficLight->SwitchTrafficLightState();
+    TimesLeft[i] = FMath::Max(
+        TimesLeft[i] + TrafficLight->GetStateDuration(TrafficLight->GetTrafficLightState()),
+        0.0f);
+  }
+}
+
+float ATrafficLightTimer::GetTimeUntilNextState(const ATrafficLightBase *TrafficLight) const
+{
+  const int32 Index = TrafficLights.Find(const_cast<ATrafficLightBase *>(TrafficLight));
+  return (Index != INDEX_NONE ? TimesLeft[Index] : -1.0f);
+}
+
+void ATrafficLightTimer::SerializeState(FArchive &Ar)
+{
+  int32 Count = TrafficLights.Num();
+  Ar << Count;
+  if (Ar.IsLoading() && (Count != TrafficLights.Num())) {
+    Ar.ArIsError = true;
+    return;
+  }
+  for (auto i = 0; i < Count; ++i) {
+    ATrafficLightBase *TrafficLight = TrafficLights[i];
+    uint8 State = (TrafficLight != nullptr ? static_cast<uint8>(TrafficLight->GetTrafficLightState()) : 0u);
+    Ar << State;
+    Ar << TimesLeft[i];
+    if (Ar.IsLoading() && (TrafficLight != nullptr) && !TrafficLight->IsPendingKill()) {
+      TrafficLight->SetTrafficLightState(static_cast<ETrafficLightState>(State));
+    }
+  }
+}
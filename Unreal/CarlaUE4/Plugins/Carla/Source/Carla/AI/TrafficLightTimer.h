@@ -0,0 +1,59 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "TrafficLightTimer.generated.h"
+
+class ATrafficLightBase;
+
+/// Advances the timing of every traffic light in the level in a single tick,
+/// instead of a timer per light.
+///
+/// Only the lights with bUseTimer set are driven, the rest keep whatever
+/// blueprint logic they have. The table keeps for each light the time left
+/// until its next state change; once expired the light switches state, which
+/// in turn notifies the vehicles waiting at it.
+UCLASS()
+class CARLA_API ATrafficLightTimer : public AActor
+{
+  GENERATED_BODY()
+
+public:
+
+  ATrafficLightTimer(const FObjectInitializer& ObjectInitializer);
+
+  virtual void BeginPlay() override;
+
+  virtual void Tick(float DeltaTime) override;
+
+  /// Gather the traffic lights present in the level, again if the map shown
+  /// changed, see FResidentMaps.
+  void FindTrafficLights();
+
+  int32 GetNumberOfTrafficLights() const
+  {
+    return TrafficLights.Num();
+  }
+
+  /// Seconds until @a TrafficLight changes state, or a negative number if the
+  /// light is not driven by this timer.
+  UFUNCTION(Category = "Traffic Light", BlueprintCallable)
+  float GetTimeUntilNextState(const ATrafficLightBase *TrafficLight) const;
+
+  /// Save or restore the state of every light driven and the time left until
+  /// its next change. Fails to load if the number of lights differs.
+  void SerializeState(FArchive &Ar);
+
+private:
+
+  UPROPERTY(Category = "Traffic Light", VisibleAnywhere)
+  TArray<ATrafficLightBase *> TrafficLights;
+
+  UPROPERTY(Category = "Traffic Light", VisibleAnywhere)
+  TArray<float> TimesLeft;
+};
@@ -0,0 +1,268 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "TrafficManager.h"
+
+#include "Async/ParallelFor.h"
+
+#include "AgentLOD.h"
+#include "CarlaWheeledVehicle.h"
+#include "Game/CarlaGameState.h"
+#include "MapGen/RoadMap.h"
+
+DECLARE_CYCLE_STAT(TEXT("Traffic Manager Tick"), STAT_CarlaTrafficManagerTick, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Traffic Manager Gather State"), STAT_CarlaTrafficManagerGather, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Traffic Manager Update Autopilot"), STAT_CarlaTrafficManagerUpdate, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Traffic Manager Apply Control"), STAT_CarlaTrafficManagerApply, STATGROUP_Carla);
+
+// =============================================================================
+// -- Static local methods -----------------------------------------------------
+// =============================================================================
+
+static bool IsControllerValid(const AWheeledVehicleAIController *Controller)
+{
+  return
+      (Controller != nullptr) &&
+      !Controller->IsPendingKill() &&
+      Controller->IsPossessingAVehicle() &&
+      !Controller->GetPossessedVehicle()->IsPendingKill() &&
+      Controller->IsAutopilotEnabled() &&
+      (Controller->GetRoadMap() != nullptr);
+}
+
+// =============================================================================
+// -- ATrafficManager ----------------------------------------------------------
+// =============================================================================
+
+ATrafficManager::ATrafficManager(const FObjectInitializer& ObjectInitializer) :
+  Super(ObjectInitializer)
+{
+  PrimaryActorTick.bCanEverTick = true;
+  PrimaryActorTick.TickGroup = TG_PrePhysics;
+}
+
+void ATrafficManager::Tick(const float DeltaTime)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaTrafficManagerTick);
+  Super::Tick(DeltaTime);
+
+  const double StartTime = FPlatformTime::Seconds();
+  GatherVehicleState();
+  UpdateAutopilot();
+  ApplyAutopilotControl();
+  LastTickTime = 1000.0 * (FPlatformTime::Seconds() - StartTime);
+}
+
+void ATrafficManager::RegisterVehicle(AWheeledVehicleAIController &Controller)
+{
+  if (!Controllers.Contains(&Controller)) {
+    Controllers.Add(&Controller);
+    ObstacleTraces.AddDefaulted();
+    ObstaclesAhead.Add(false);
+  }
+}
+
+void ATrafficManager::UnregisterVehicle(AWheeledVehicleAIController &Controller)
+{
+  const int32 Index = Controllers.Find(&Controller);
+  if (Index != INDEX_NONE) {
+    RemoveVehicleAt(Index);
+  }
+}
+
+void ATrafficManager::RemoveVehicleAt(const int32 Index)
+{
+  Controllers.RemoveAtSwap(Index, 1, false);
+  ObstacleTraces.RemoveAtSwap(Index, 1, false);
+  ObstaclesAhead.RemoveAtSwap(Index, 1, false);
+}
+
+void ATrafficManager::GatherVehicleState()
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaTrafficManagerGather);
+  for (auto i = Controllers.Num() - 1; i >= 0; --i) {
+    if (!IsControllerValid(Controllers[i])) {
+      RemoveVehicleAt(i);
+    }
+  }
+
+  auto *World = GetWorld();
+  check(World != nullptr);
+  FAgentLOD::GetViewLocations(*World, ViewLocations);
+  auto *GameState = World->GetGameState<ACarlaGameState>();
+  ObstacleGrid = (GameState != nullptr ? &GameState->GetObstacleGrid() : nullptr);
+  ++TickCount;
+  const uint32 Interval = FMath::Max(1, LowDetailUpdateInterval);
+
+  Indices.Reset();
+  RoadMaps.Reset();
+  Locations.Reset();
+  Forwards.Reset();
+  Orientations.Reset();
+  BoundsExtents.Reset();
+  Speeds.Reset();
+  SpeedLimits.Reset();
+  MaximumSteerAngles.Reset();
+  TrafficLightStates.Reset();
+  HasTargetLocations.Reset();
+  TargetLocations.Reset();
+
+  for (auto i = 0; i < Controllers.Num(); ++i) {
+    // Results of the traces submitted the previous tick, if any.
+    bool bTracesRead = false;
+    bool bObstacleAhead = false;
+    for (const auto &Handle : ObstacleTraces[i].Handles) {
+      FTraceDatum Datum;
+      if (World->QueryTraceData(Handle, Datum)) {
+        bTracesRead = true;
+        for (const auto &Hit : Datum.OutHits) {
+          bObstacleAhead |= Hit.bBlockingHit;
+        }
+      }
+    }
+    if (bTracesRead) {
+      ObstaclesAhead[i] = bObstacleAhead;
+    }
+
+    auto &Controller = *Controllers[i];
+    const auto &Vehicle = *Controller.GetPossessedVehicle();
+    const FVector Location = Vehicle.GetActorLocation();
+    // Far vehicles take turns so the updates are spread along the ticks.
+    if (((TickCount + i) % Interval != 0u) &&
+        FAgentLOD::IsFar(Location, ViewLocations, LowDetailDistance)) {
+      continue;
+    }
+
+    Indices.Add(i);
+    RoadMaps.Add(Controller.GetRoadMap());
+    Locations.Add(Location);
+    Forwards.Add(Vehicle.GetActorForwardVector());
+    Orientations.Add(Vehicle.GetVehicleOrientation());
+    BoundsExtents.Add(Vehicle.GetVehicleBoundsExtent());
+    Speeds.Add(Vehicle.GetVehicleForwardSpeed());
+    SpeedLimits.Add(Controller.GetSpeedLimit());
+    MaximumSteerAngles.Add(Vehicle.GetMaximumSteerAngle());
+    TrafficLightStates.Add(Controller.GetTrafficLightState());
+    FVector Target;
+    HasTargetLocations.Add(Controller.GetNextTargetLocation(Location, Target));
+    TargetLocations.Add(Target);
+  }
+}
+
+void ATrafficManager::UpdateAutopilot()
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaTrafficManagerUpdate);
+  const int32 Count = Indices.Num();
+  Directions.SetNumUninitialized(Count, false);
+  AgentsAhead.SetNumUninitialized(Count, false);
+  Throttles.SetNumUninitialized(Count, false);
+  Steers.SetNumUninitialized(Count, false);
+  Brakes.SetNumUninitialized(Count, false);
+  States.SetNumUninitialized(Count, false);
+
+  using Controller = AWheeledVehicleAIController;
+
+  const int32 ChunkSize = FMath::Max(1, VehiclesPerTask);
+  const int32 NumberOfChunks = (Count + ChunkSize - 1) / ChunkSize;
+  // Reads only the arrays gathered above, the road maps and the obstacle grid,
+  // each chunk writes its own slice of the output arrays.
+  ParallelFor(NumberOfChunks, [&](const int32 Chunk) {
+    const int32 End = FMath::Min(Count, (Chunk + 1) * ChunkSize);
+    for (int32 i = Chunk * ChunkSize; i < End; ++i) {
+      Directions[i] = Forwards[i];
+      if (HasTargetLocations[i]) {
+        Steers[i] = Controller::CalcSteeringToTarget(
+            Locations[i],
+            Forwards[i],
+            TargetLocations[i],
+            MaximumSteerAngles[i],
+            Directions[i]);
+        States[i] = ECarlaWheeledVehicleState::FollowingFixedRoute;
+      } else {
+        Steers[i] = Controller::CalcSteeringOnRoad(
+            *RoadMaps[i],
+            Locations[i],
+            Forwards[i],
+            BoundsExtents[i],
+            MaximumSteerAngles[i],
+            Directions[i]);
+        States[i] = ECarlaWheeledVehicleState::FreeDriving;
+      }
+
+      AgentsAhead[i] = false;
+      if (ObstacleGrid != nullptr) {
+        float MinDistance;
+        float MaxDistance;
+        float HalfWidth;
+        Controller::GetObstacleCorridor(BoundsExtents[i], Speeds[i], MinDistance, MaxDistance, HalfWidth);
+        AgentsAhead[i] = (INDEX_NONE != ObstacleGrid->FindLeadAgent(
+            Locations[i],
+            Directions[i],
+            MinDistance,
+            MaxDistance,
+            HalfWidth));
+      }
+
+      bool bStop = true;
+      if (TrafficLightStates[i] != ETrafficLightState::Green) {
+        States[i] = ECarlaWheeledVehicleState::WaitingForRedLight;
+      } else if (AgentsAhead[i] || ObstaclesAhead[Indices[i]]) {
+        States[i] = ECarlaWheeledVehicleState::ObstacleAhead;
+      } else {
+        bStop = false;
+      }
+
+      Controller::CalcThrottleAndBrake(Speeds[i], SpeedLimits[i], bStop, Throttles[i], Brakes[i]);
+    }
+  }, NumberOfChunks < 2);
+}
+
+void ATrafficManager::ApplyAutopilotControl()
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaTrafficManagerApply);
+  using Controller = AWheeledVehicleAIController;
+
+  auto *World = GetWorld();
+  check(World != nullptr);
+  static FName TraceTag = FName(TEXT("VehicleTrace"));
+  const FCollisionObjectQueryParams ObjectParams(FCollisionObjectQueryParams::AllDynamicObjects);
+
+  for (auto i = 0; i < Indices.Num(); ++i) {
+    const int32 Index = Indices[i];
+    auto &Vehicle = *Controllers[Index]->GetPossessedVehicle();
+    Vehicle.ApplyAutopilotControl(Throttles[i], Steers[i], Brakes[i]);
+    Vehicle.SetAIVehicleState(States[i]);
+
+    if (AgentsAhead[i]) {
+      // Nothing to trace, the probes would hit the agent.
+      ObstacleTraces[Index] = FObstacleTraces();
+      ObstaclesAhead[Index] = false;
+      continue;
+    }
+
+    FVector Start[Controller::NumberOfObstacleProbes];
+    FVector End[Controller::NumberOfObstacleProbes];
+    Controller::GetObstacleProbes(
+        Locations[i],
+        Orientations[i],
+        BoundsExtents[i],
+        Speeds[i],
+        Directions[i],
+        Start,
+        End);
+    FCollisionQueryParams CollisionParams(TraceTag, true);
+    CollisionParams.AddIgnoredActor(&Vehicle);
+    for (auto j = 0u; j < Controller::NumberOfObstacleProbes; ++j) {
+      ObstacleTraces[Index].Handles[j] = World->AsyncLineTraceByObjectType(
+          EAsyncTraceType::Single,
+          Start[j],
+          End[j],
+          ObjectParams,
+          CollisionParams);
+    }
+  }
+}
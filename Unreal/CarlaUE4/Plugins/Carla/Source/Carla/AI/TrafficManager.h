@@ -0,0 +1,159 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "CarlaWheeledVehicleState.h"
+#include "TrafficLightState.h"
+#include "WheeledVehicleAIController.h"
+#include "WorldCollision.h"
+#include "TrafficManager.generated.h"
+
+class FAgentGrid;
+class URoadMap;
+
+/// Updates the autopilot of every NPC vehicle in a single tick, instead of a
+/// tick per controller.
+///
+/// The state of the vehicles is copied each tick into flat arrays, one per
+/// field. The steering and throttle of every vehicle are then computed in
+/// parallel, as this only reads the arrays and the road map, and finally the
+/// controls are written back to the vehicles. The agent ahead of each vehicle
+/// is found in the obstacle grid of the game state; only the vehicles with
+/// none ahead trace their obstacle probes, asynchronously, and their results
+/// are used the next tick.
+///
+/// Vehicles far from every player are only updated once every few ticks,
+/// keeping their last controls in between, see FAgentLOD.
+UCLASS()
+class CARLA_API ATrafficManager : public AActor
+{
+  GENERATED_BODY()
+
+public:
+
+  ATrafficManager(const FObjectInitializer& ObjectInitializer);
+
+  virtual void Tick(float DeltaTime) override;
+
+  /// Drive the vehicle of @a Controller from now on. The controller is
+  /// expected to stop ticking its own autopilot.
+  void RegisterVehicle(AWheeledVehicleAIController &Controller);
+
+  void UnregisterVehicle(AWheeledVehicleAIController &Controller);
+
+  int32 GetNumberOfVehicles() const
+  {
+    return Controllers.Num();
+  }
+
+  /// Time spent in the last tick, in milliseconds.
+  float GetLastTickTime() const
+  {
+    return LastTickTime;
+  }
+
+private:
+
+  void RemoveVehicleAt(int32 Index);
+
+  /// Copy the state of the vehicles to be updated this tick, game thread
+  /// only.
+  void GatherVehicleState();
+
+  /// Compute the controls of the vehicles gathered, runs in parallel.
+  void UpdateAutopilot();
+
+  /// Write back the controls and submit the obstacle traces, game thread
+  /// only.
+  void ApplyAutopilotControl();
+
+  struct FObstacleTraces
+  {
+    FTraceHandle Handles[AWheeledVehicleAIController::NumberOfObstacleProbes];
+  };
+
+  UPROPERTY(Category = "Traffic Manager", VisibleAnywhere)
+  TArray<AWheeledVehicleAIController *> Controllers;
+
+  /// Traces submitted the previous tick, one entry per controller.
+  TArray<FObstacleTraces> ObstacleTraces;
+
+  /// Result of the last traces read, one entry per controller. Kept between
+  /// the updates of the far vehicles.
+  TArray<bool> ObstaclesAhead;
+
+  /** Minimum number of vehicles per parallel task. */
+  UPROPERTY(Category = "Traffic Manager", EditAnywhere, meta = (ClampMin = "1"))
+  int32 VehiclesPerTask = 16;
+
+  /** Vehicles further than this distance (cm) from every player are updated
+    * at a lower rate.
+    */
+  UPROPERTY(Category = "Traffic Manager", EditAnywhere, meta = (ClampMin = "0"))
+  float LowDetailDistance = 15000.0f;
+
+  /** Number of ticks between updates of the vehicles far from the players. */
+  UPROPERTY(Category = "Traffic Manager", EditAnywhere, meta = (ClampMin = "1"))
+  int32 LowDetailUpdateInterval = 4;
+
+  uint32 TickCount = 0u;
+
+  float LastTickTime = 0.0f;
+
+  TArray<FVector> ViewLocations;
+
+  /// Of the game state, rebuilt this tick, null if none.
+  const FAgentGrid *ObstacleGrid = nullptr;
+
+  // ===========================================================================
+  // -- Vehicle state, rebuilt each tick ---------------------------------------
+  // ===========================================================================
+
+  /// Index in Controllers of each vehicle updated this tick.
+  TArray<int32> Indices;
+
+  TArray<const URoadMap *> RoadMaps;
+
+  TArray<FVector> Locations;
+
+  TArray<FVector> Forwards;
+
+  TArray<FVector> Orientations;
+
+  TArray<FVector> BoundsExtents;
+
+  TArray<float> Speeds;
+
+  TArray<float> SpeedLimits;
+
+  TArray<float> MaximumSteerAngles;
+
+  TArray<ETrafficLightState> TrafficLightStates;
+
+  TArray<bool> HasTargetLocations;
+
+  TArray<FVector> TargetLocations;
+
+  // ===========================================================================
+  // -- Autopilot output -------------------------------------------------------
+  // ===========================================================================
+
+  TArray<FVector> Directions;
+
+  /// Whether an agent or the player is in the corridor ahead, the probes are
+  /// not traced then.
+  TArray<bool> AgentsAhead;
+
+  TArray<float> Throttles;
+
+  TArray<float> Steers;
+
+  TArray<float> Brakes;
+
+  TArray<ECarlaWheeledVehicleState> States;
+};
@@ -0,0 +1,90 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "VehiclePathGrid.h"
+
+#include "EngineUtils.h"
+#include "WheeledVehicle.h"
+#include "WheeledVehicleMovementComponent.h"
+
+static constexpr float PREVISION_TIME_IN_SECONDS = 5.0f;
+static constexpr float VEHICLE_SAFETY_RADIUS = 400.0f;
+
+static FVector GetLocation(const AActor &Actor)
+{
+  const FVector &Location = Actor.GetActorLocation();
+  return {Location.X, Location.Y, 0.0f};
+}
+
+FVehiclePathGrid::FVehiclePathGrid(const float InCellSize) :
+  CellSize(InCellSize) {
+  check(CellSize > 0.0f);
+}
+
+FIntPoint FVehiclePathGrid::GetCell(const FVector &Location) const
+{
+  return {
+    FMath::FloorToInt(Location.X / CellSize),
+    FMath::FloorToInt(Location.Y / CellSize)};
+}
+
+void FVehiclePathGrid::Rebuild(UWorld &World)
+{
+  for (auto &Cell : Cells) {
+    Cell.Value.Reset();
+  }
+  Paths.Reset();
+  for (TActorIterator<AWheeledVehicle> It(&World); It; ++It) {
+    const AWheeledVehicle *Vehicle = *It;
+    const auto *MovementComponent = Vehicle->GetVehicleMovementComponent();
+    if (Vehicle->IsPendingKill() || (MovementComponent == nullptr)) {
+      continue;
+    }
+    // Within the prevision time the vehicle covers the straight line in front
+    // of it, plus a safety radius around.
+    const FVector Location = GetLocation(*Vehicle);
+    const FVector Forward = Vehicle->GetTransform().GetRotation().GetForwardVector();
+    const float Speed = MovementComponent->GetForwardSpeed();
+    Cells.FindOrAdd(GetCell(Location)).Add(Paths.Num());
+    Paths.Add({
+        Location,
+        Location - Forward * VEHICLE_SAFETY_RADIUS,
+        Location + Forward * (VEHICLE_SAFETY_RADIUS + Speed * PREVISION_TIME_IN_SECONDS)});
+  }
+}
+
+bool FVehiclePathGrid::Intersects(
+    const FVector &Start,
+    const FVector &End,
+    const float Radius) const
+{
+  const FVector Direction = End - Start;
+  const float RadiusSquared = Radius * Radius;
+  const FIntPoint Min = GetCell(Start - FVector(Radius, Radius, 0.0f));
+  const FIntPoint Max = GetCell(Start + FVector(Radius, Radius, 0.0f));
+  for (int32 X = Min.X; X <= Max.X; ++X) {
+    for (int32 Y = Min.Y; Y <= Max.Y; ++Y) {
+      const auto *Cell = Cells.Find(FIntPoint(X, Y));
+      if (Cell == nullptr) {
+        continue;
+      }
+      for (const int32 Index : *Cell) {
+        const auto &Path = Paths[Index];
+        const FVector ToVehicle = Path.Location - Start;
+        if ((ToVehicle.SizeSquared2D() > RadiusSquared) ||
+            (FVector::DotProduct(ToVehicle, Direction) < 0.0f)) {
+          continue;
+        }
+        FVector IntersectionPoint;
+        if (FMath::SegmentIntersection2D(Start, End, Path.Start, Path.End, IntersectionPoint)) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Util/NonCopyable.h"
+
+class UWorld;
+
+/// Uniform 2D grid of the vehicles' locations and predicted paths. Rebuilt
+/// once per tick and shared by every walker, so each walker only visits the
+/// vehicles around it to find out if one is about to cross its way.
+class CARLA_API FVehiclePathGrid : private NonCopyable
+{
+public:
+
+  /// @a CellSize in centimeters.
+  explicit FVehiclePathGrid(float CellSize = 1000.0f);
+
+  /// Place every wheeled vehicle in @a World, player's included.
+  void Rebuild(UWorld &World);
+
+  /// Whether the segment from @a Start to @a End (on the XY plane) crosses
+  /// the predicted path of a vehicle within @a Radius of @a Start and not
+  /// behind it.
+  bool Intersects(const FVector &Start, const FVector &End, float Radius) const;
+
+private:
+
+  struct FVehiclePath
+  {
+    FVector Location;
+
+    FVector Start;
+
+    FVector End;
+  };
+
+  FIntPoint GetCell(const FVector &Location) const;
+
+  const float CellSize;
+
+  TMap<FIntPoint, TArray<int32>> Cells;
+
+  TArray<FVehiclePath> Paths;
+};
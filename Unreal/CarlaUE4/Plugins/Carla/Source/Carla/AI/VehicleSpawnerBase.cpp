@@ -7,8 +7,11 @@
 #include "Carla.h"
 #include "VehicleSpawnerBase.h"
 
+#include "AI/TrafficManager.h"
 #include "AI/WheeledVehicleAIController.h"
 #include "CarlaWheeledVehicle.h"
+#include "Game/CarlaGameState.h"
+#include "Util/PawnParking.h"
 #include "Util/RandomEngine.h"
 
 #include "Engine/PlayerStartPIE.h"
@@ -16,6 +19,8 @@
 #include "GameFramework/Character.h"
 #include "GameFramework/PlayerStart.h"
 
+DECLARE_CYCLE_STAT(TEXT("Vehicle Spawner Tick"), STAT_CarlaVehicleSpawnerTick, STATGROUP_Carla);
+
 // =============================================================================
 // -- Static local methods -----------------------------------------------------
 // =============================================================================
@@ -36,7 +41,11 @@ static AWheeledVehicleAIController *GetController(ACarlaWheeledVehicle *Vehicle)
 
 // Sets default values
 AVehicleSpawnerBase::AVehicleSpawnerBase(const FObjectInitializer& ObjectInitializer) :
-  Super(ObjectInitializer) {}
+  Super(ObjectInitializer)
+{
+  PrimaryActorTick.bCanEverTick = true;
+  PrimaryActorTick.TickGroup = TG_PrePhysics;
+}
 
 void AVehicleSpawnerBase::BeginPlay()
 {
@@ -47,31 +56,115 @@ void AVehicleSpawnerBase::BeginPlay()
   // Allocate space for walkers.
   Vehicles.Reserve(NumberOfVehicles);
 
-  // Find spawn points present in level.
+  FindSpawnPoints();
+
+  if (bUseTrafficManager) {
+    FActorSpawnParameters SpawnParameters;
+    SpawnParameters.Owner = this;
+    TrafficManager = GetWorld()->SpawnActor<ATrafficManager>(SpawnParameters);
+  }
+
+  SpawnVehicles();
+}
+
+void AVehicleSpawnerBase::Tick(float DeltaTime)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaVehicleSpawnerTick);
+  Super::Tick(DeltaTime);
+
+  if (HasPendingSpawns()) {
+    SpawnPendingVehicles();
+  } else if (NumberOfPoolVehiclesLeft > 0) {
+    SpawnPendingPoolVehicles();
+  }
+}
+
+void AVehicleSpawnerBase::FindSpawnPoints()
+{
+  SpawnPoints.Reset();
   for (TActorIterator<APlayerStart> It(GetWorld()); It; ++It) {
     SpawnPoints.Add(*It);
   }
-
   UE_LOG(LogCarla, Log, TEXT("Found %d positions for spawning vehicles"), SpawnPoints.Num());
+}
 
+void AVehicleSpawnerBase::SpawnVehicles()
+{
   if (SpawnPoints.Num() < NumberOfVehicles) {
     bSpawnVehicles = false;
     UE_LOG(LogCarla, Error, TEXT("We don't have enough spawn points for vehicles!"));
   }
 
+  NextVehicleStreamId = 0;
   if (bSpawnVehicles) {
-    const int32 MaximumNumberOfAttempts = 4 * NumberOfVehicles;
-    int32 NumberOfAttempts = 0;
-    while ((NumberOfVehicles > Vehicles.Num()) && (NumberOfAttempts < MaximumNumberOfAttempts)) {
-      // Try to spawn one vehicle.
-      TryToSpawnRandomVehicle();
-      ++NumberOfAttempts;
+    NumberOfAttemptsLeft = 4 * NumberOfVehicles;
+    SpawnPendingVehicles();
+  }
+}
+
+void AVehicleSpawnerBase::SpawnPendingVehicles()
+{
+  int32 NumberOfAttempts = 0;
+  while ((NumberOfVehicles > Vehicles.Num()) &&
+         (NumberOfAttemptsLeft > 0) &&
+         ((MaxSpawnsPerFrame <= 0) || (NumberOfAttempts < MaxSpawnsPerFrame))) {
+    // Try to spawn one vehicle.
+    TryToSpawnRandomVehicle();
+    --NumberOfAttemptsLeft;
+    ++NumberOfAttempts;
+  }
+
+  if (NumberOfVehicles <= Vehicles.Num()) {
+    NumberOfAttemptsLeft = 0;
+  } else if (NumberOfAttemptsLeft <= 0) {
+    UE_LOG(LogCarla, Error, TEXT("Requested %d vehicles, but we were only able to spawn %d"), NumberOfVehicles, Vehicles.Num());
+  }
+}
+
+void AVehicleSpawnerBase::DespawnVehicles()
+{
+  auto *GameState = GetWorld()->GetGameState<ACarlaGameState>();
+  for (auto *Vehicle : Vehicles) {
+    if (VehicleIsValid(Vehicle)) {
+      auto Controller = GetController(Vehicle);
+      if (bPoolVehicles && (Controller != nullptr)) {
+        Controller->SetAutopilot(false);
+        if (GameState != nullptr) {
+          GameState->DeregisterAgent(*Vehicle);
+        }
+        FPawnParking::Park(*Vehicle);
+        VehiclePool.Add(Vehicle);
+      } else {
+        if (Controller != nullptr) {
+          Controller->Destroy();
+        }
+        Vehicle->Destroy();
+      }
     }
+  }
+  Vehicles.Empty();
+  NumberOfAttemptsLeft = 0;
+  NumberOfPoolVehiclesLeft = 0;
+}
 
-    if (NumberOfVehicles > Vehicles.Num()) {
-      UE_LOG(LogCarla, Error, TEXT("Requested %d vehicles, but we were only able to spawn %d"), NumberOfVehicles, Vehicles.Num());
+SIZE_T AVehicleSpawnerBase::GetPoolAllocatedSize() const
+{
+  SIZE_T Size = VehiclePool.GetAllocatedSize();
+  for (auto *Vehicle : VehiclePool) {
+    if (Vehicle != nullptr) {
+      Size += FPawnParking::GetResourceSize(*Vehicle);
     }
   }
+  return Size;
+}
+
+void AVehicleSpawnerBase::PrepareVehiclePool(const int32 Count)
+{
+  NumberOfPoolVehiclesLeft =
+      (bPoolVehicles ? FMath::Min(Count, SpawnPoints.Num()) - Vehicles.Num() - VehiclePool.Num() : 0);
+  if (NumberOfPoolVehiclesLeft > 0) {
+    UE_LOG(LogCarla, Log, TEXT("Preparing %d parked vehicles for the next episode"), NumberOfPoolVehiclesLeft);
+  }
 }
 
 void AVehicleSpawnerBase::SetNumberOfVehicles(const int32 Count)
@@ -97,17 +190,28 @@ void AVehicleSpawnerBase::TryToSpawnRandomVehicle()
 void AVehicleSpawnerBase::SpawnVehicleAtSpawnPoint(
     const APlayerStart &SpawnPoint)
 {
-  ACarlaWheeledVehicle *Vehicle;
-  SpawnVehicle(SpawnPoint.GetActorTransform(), Vehicle);
-  if ((Vehicle != nullptr) && !Vehicle->IsPendingKill()) {
-    Vehicle->AIControllerClass = AWheeledVehicleAIController::StaticClass();
-    Vehicle->SpawnDefaultController();
+  ACarlaWheeledVehicle *Vehicle = TryToReuseVehicleAt(SpawnPoint);
+  if (Vehicle == nullptr) {
+    SpawnVehicle(SpawnPoint.GetActorTransform(), Vehicle);
+    if (VehicleIsValid(Vehicle)) {
+      Vehicle->AIControllerClass = AWheeledVehicleAIController::StaticClass();
+      Vehicle->SpawnDefaultController();
+    }
+  }
+  if (VehicleIsValid(Vehicle)) {
     auto Controller = GetController(Vehicle);
     if (Controller != nullptr) { // Sometimes fails...
-      Controller->SetRandomEngine(GetRandomEngine());
+      Controller->SetRandomEngine(GetRandomEngine()->Fork(Controller, NextVehicleStreamId++));
       Controller->SetRoadMap(GetRoadMap());
+      Controller->SetLaneGraph(LaneGraph);
+      Controller->SetTrafficManager(TrafficManager);
       Controller->SetAutopilot(true);
+      Vehicle->SetRestWhenStopped(bRestStoppedVehicles);
       Vehicles.Add(Vehicle);
+      auto *GameState = GetWorld()->GetGameState<ACarlaGameState>();
+      if (GameState != nullptr) {
+        GameState->RegisterAgent(*Vehicle, EAgentType::Vehicle);
+      }
     } else {
       UE_LOG(LogCarla, Error, TEXT("Something went wrong creating the controller for the new vehicle"));
       Vehicle->Destroy();
@@ -115,6 +219,55 @@ void AVehicleSpawnerBase::SpawnVehicleAtSpawnPoint(
   }
 }
 
+ACarlaWheeledVehicle *AVehicleSpawnerBase::TryToReuseVehicleAt(
+    const APlayerStart &SpawnPoint)
+{
+  while ((VehiclePool.Num() > 0) && (GetController(VehiclePool.Last()) == nullptr)) {
+    // Destroyed while parked.
+    VehiclePool.Pop(false);
+  }
+  if (VehiclePool.Num() == 0) {
+    return nullptr;
+  }
+  auto *Vehicle = VehiclePool.Last();
+  // Parked vehicles have no collision, check with the default object instead.
+  const auto *VehicleToFit = Vehicle->GetClass()->GetDefaultObject<ACarlaWheeledVehicle>();
+  if (GetWorld()->EncroachingBlockingGeometry(
+          VehicleToFit,
+          SpawnPoint.GetActorLocation(),
+          SpawnPoint.GetActorRotation())) {
+    return nullptr;
+  }
+  VehiclePool.Pop(false);
+  FPawnParking::Unpark(*Vehicle, SpawnPoint.GetActorTransform(), true);
+  return Vehicle;
+}
+
+void AVehicleSpawnerBase::SpawnPendingPoolVehicles()
+{
+  // One spawn point per tick at most, the current episode is still running.
+  const int32 MaxAttempts = (MaxSpawnsPerFrame > 0 ? MaxSpawnsPerFrame : 1);
+  for (auto i = 0; (i < MaxAttempts) && (NumberOfPoolVehiclesLeft > 0) && (SpawnPoints.Num() > 0); ++i) {
+    NextPoolSpawnPoint = (NextPoolSpawnPoint + 1) % SpawnPoints.Num();
+    const auto *SpawnPoint = SpawnPoints[NextPoolSpawnPoint];
+    check(SpawnPoint != nullptr);
+    ACarlaWheeledVehicle *Vehicle = nullptr;
+    // Fails if the spawn point is occupied, the next tick tries another one.
+    SpawnVehicle(SpawnPoint->GetActorTransform(), Vehicle);
+    if (VehicleIsValid(Vehicle)) {
+      Vehicle->AIControllerClass = AWheeledVehicleAIController::StaticClass();
+      Vehicle->SpawnDefaultController();
+      if (GetController(Vehicle) != nullptr) {
+        FPawnParking::Park(*Vehicle);
+        VehiclePool.Add(Vehicle);
+        --NumberOfPoolVehiclesLeft;
+      } else {
+        Vehicle->Destroy();
+      }
+    }
+  }
+}
+
 APlayerStart *AVehicleSpawnerBase::GetRandomSpawnPoint()
 {
   return (SpawnPoints.Num() > 0 ? GetRandomEngine()->PickOne(SpawnPoints) : nullptr);
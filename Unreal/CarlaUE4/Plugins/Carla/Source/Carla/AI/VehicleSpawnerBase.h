@@ -11,6 +11,8 @@
 
 class ACarlaWheeledVehicle;
 class APlayerStart;
+class ATrafficManager;
+class ULaneGraph;
 
 UCLASS(Abstract)
 class CARLA_API AVehicleSpawnerBase : public AActorWithRandomEngine
@@ -27,6 +29,12 @@ protected:
   // Called when the game starts or when spawned
   virtual void BeginPlay() override;
 
+public:
+
+  virtual void Tick(float DeltaTime) override;
+
+protected:
+
   UFUNCTION(BlueprintImplementableEvent)
   void SpawnVehicle(const FTransform &SpawnTransform, ACarlaWheeledVehicle *&SpawnedCharacter);
 
@@ -37,6 +45,52 @@ public:
 
   void SetNumberOfVehicles(int32 Count);
 
+  /// Gather the spawn points present in the level, again if the map shown
+  /// changed, see FResidentMaps.
+  void FindSpawnPoints();
+
+  /// Spawn the requested number of vehicles at random spawn points. Called at
+  /// begin play and when the episode is reset in place.
+  ///
+  /// If a limit of spawns per frame is set, the vehicles left are spawned in
+  /// the following ticks.
+  void SpawnVehicles();
+
+  /// Limit the spawn attempts per frame, zero or negative for no limit.
+  void SetMaxSpawnsPerFrame(int32 Count)
+  {
+    MaxSpawnsPerFrame = Count;
+  }
+
+  /// Let the vehicles spawned from now on rest while stopped, see
+  /// ACarlaWheeledVehicle::SetRestWhenStopped.
+  void SetRestStoppedVehicles(bool bEnabled)
+  {
+    bRestStoppedVehicles = bEnabled;
+  }
+
+  /// Whether some of the vehicles requested are still to be spawned.
+  bool HasPendingSpawns() const
+  {
+    return NumberOfAttemptsLeft > 0;
+  }
+
+  /// Remove every vehicle spawned so far. Unless pooling is disabled, they are
+  /// parked to be reused by the next call to SpawnVehicles, otherwise they
+  /// are destroyed along with their controller.
+  void DespawnVehicles();
+
+  /// Spawn parked vehicles along the next ticks until the spawned and parked
+  /// vehicles add up to @a Count, so the next in-place reset does not need to
+  /// spawn any. Does nothing if pooling is disabled.
+  ///
+  /// Used to prepare a queued episode while the current one runs, the random
+  /// engine is not used so the current episode is not altered.
+  void PrepareVehiclePool(int32 Count);
+
+  /// Bytes held by the vehicles parked in the pool.
+  SIZE_T GetPoolAllocatedSize() const;
+
   int32 GetNumberOfSpawnedVehicles() const
   {
     return Vehicles.Num();
@@ -46,6 +100,12 @@ public:
     return Vehicles;
   }
 
+  /// Null if the vehicles drive their own autopilot.
+  const ATrafficManager *GetTrafficManager() const
+  {
+    return TrafficManager;
+  }
+
   void SetRoadMap(URoadMap *InRoadMap)
   {
     RoadMap = InRoadMap;
@@ -57,15 +117,31 @@ public:
     return RoadMap;
   }
 
+  void SetLaneGraph(ULaneGraph *InLaneGraph)
+  {
+    LaneGraph = InLaneGraph;
+  }
+
 protected:
 
   APlayerStart* GetRandomSpawnPoint();
 
   void SpawnVehicleAtSpawnPoint(const APlayerStart &SpawnPoint);
 
+  /// Take a vehicle from the pool and move it to @a SpawnPoint. Returns null
+  /// if the pool is empty or the spawn point is occupied.
+  ACarlaWheeledVehicle *TryToReuseVehicleAt(const APlayerStart &SpawnPoint);
+
+  void SpawnPendingVehicles();
+
+  void SpawnPendingPoolVehicles();
+
   UPROPERTY()
   URoadMap *RoadMap;
 
+  UPROPERTY()
+  ULaneGraph *LaneGraph;
+
   /** If false, no walker will be spawned. */
   UPROPERTY(Category = "Vehicle Spawner", EditAnywhere)
   bool bSpawnVehicles = true;
@@ -74,9 +150,52 @@ protected:
   UPROPERTY(Category = "Vehicle Spawner", EditAnywhere, meta = (EditCondition = bSpawnVehicles, ClampMin = "1"))
   int32 NumberOfVehicles = 10;
 
+  /** If true, the autopilot of every vehicle spawned is updated at once by a
+    * traffic manager, otherwise each controller ticks its own.
+    */
+  UPROPERTY(Category = "Vehicle Spawner", EditAnywhere)
+  bool bUseTrafficManager = true;
+
+  UPROPERTY(Category = "Vehicle Spawner", VisibleAnywhere, AdvancedDisplay)
+  ATrafficManager *TrafficManager = nullptr;
+
+  /** If true, the vehicles removed when the episode is reset are parked and
+    * reused instead of destroyed.
+    */
+  UPROPERTY(Category = "Vehicle Spawner", EditAnywhere)
+  bool bPoolVehicles = true;
+
+  /** If true, the vehicles rest while stopped with the brake pressed, their
+    * body kinematic until they move again.
+    */
+  UPROPERTY(Category = "Vehicle Spawner", EditAnywhere)
+  bool bRestStoppedVehicles = true;
+
   UPROPERTY(Category = "Vechicle Spawner", VisibleAnywhere, AdvancedDisplay)
   TArray<APlayerStart *> SpawnPoints;
 
   UPROPERTY(Category = "Vehicle Spawner", BlueprintReadOnly, VisibleAnywhere, AdvancedDisplay)
   TArray<ACarlaWheeledVehicle *> Vehicles;
+
+  /** Maximum number of spawn attempts per frame, zero for no limit. */
+  UPROPERTY(Category = "Vehicle Spawner", VisibleAnywhere, AdvancedDisplay)
+  int32 MaxSpawnsPerFrame = 0;
+
+  /** Random stream of the next vehicle spawned, each vehicle draws from its
+    * own stream forked from the spawner's engine.
+    */
+  int32 NextVehicleStreamId = 0;
+
+  /** Spawn attempts left to reach the number of vehicles requested. */
+  int32 NumberOfAttemptsLeft = 0;
+
+  /** Vehicles still to be spawned into the pool, see PrepareVehiclePool. */
+  int32 NumberOfPoolVehiclesLeft = 0;
+
+  /** Next spawn point tried for the vehicles of the pool. */
+  int32 NextPoolSpawnPoint = 0;
+
+  /** Parked vehicles, ready to be reused. */
+  UPROPERTY(Category = "Vehicle Spawner", VisibleAnywhere, AdvancedDisplay)
+  TArray<ACarlaWheeledVehicle *> VehiclePool;
 };
@@ -8,130 +8,21 @@
 #include "WalkerAIController.h"
 
 #include "Navigation/CrowdFollowingComponent.h"
-#include "Perception/AIPerceptionComponent.h"
-#include "Perception/AISenseConfig_Sight.h"
-#include "Perception/AISense_Sight.h"
-#include "WheeledVehicle.h"
-#include "WheeledVehicleMovementComponent.h"
+
+#include "VehiclePathGrid.h"
+#include "WalkerPathCache.h"
+
+DECLARE_CYCLE_STAT(TEXT("Walker AI Controller Tick"), STAT_CarlaWalkerAITick, STATGROUP_Carla);
 
 #ifdef CARLA_AI_WALKERS_EXTRA_LOG
 #  include <DrawDebugHelpers.h>
 #  define LOG_AI_WALKER(Verbosity, Text) UE_LOG(LogCarla, Verbosity, TEXT("Walker %s " Text), *GetPawn()->GetName());
-#  define EXTRA_LOG_ONLY(predicate) predicate
 #else
 #  define LOG_AI_WALKER(Verbosity, Text)
-#  define EXTRA_LOG_ONLY(predicate)
 #endif // CARLA_AI_WALKERS_EXTRA_LOG
 
 static constexpr float UPDATE_TIME_IN_SECONDS = 10.0f;
-static constexpr float PREVISION_TIME_IN_SECONDS = 5.0f;
 static constexpr float WALKER_SIGHT_RADIUS = 500.0f;
-static constexpr float WALKER_PERIPHERAL_VISION_ANGLE_IN_DEGREES = 90.0f;
-static constexpr float VEHICLE_SAFETY_RADIUS = 400.0f;
-
-// =============================================================================
-// -- PawnPath -----------------------------------------------------------------
-// =============================================================================
-
-class PawnPath {
-private:
-
-  static FVector GetLocation(const AActor &Actor)
-  {
-    const FVector &Location = Actor.GetActorLocation();
-    return {Location.X, Location.Y, 0.0f};
-  }
-
-  static FVector GetForwardVector(const AActor &Actor)
-  {
-    return Actor.GetTransform().GetRotation().GetForwardVector();
-  }
-
-  static float GetForwardSpeed(const AWheeledVehicle &Vehicle)
-  {
-    const auto *MovementComponent = Vehicle.GetVehicleMovementComponent();
-    check(nullptr != MovementComponent);
-    return MovementComponent->GetForwardSpeed();
-  }
-
-#ifdef CARLA_AI_WALKERS_EXTRA_LOG
-  static FVector GetPointForDrawing(const FVector &Location)
-  {
-    return {Location.X, Location.Y, 50.0f};
-  }
-#endif // CARLA_AI_WALKERS_EXTRA_LOG
-
-  /// Helper constructor for vehicles.
-  explicit PawnPath(const FVector &Location, const FVector &ForwardDirection, const float Speed) :
-    Start(Location - ForwardDirection * VEHICLE_SAFETY_RADIUS),
-    End(Location + ForwardDirection * (VEHICLE_SAFETY_RADIUS + Speed * PREVISION_TIME_IN_SECONDS)) {}
-
-private:
-
-  explicit PawnPath(const APawn &Walker) :
-    Start(GetLocation(Walker)),
-    End(GetLocation(Walker) + GetForwardVector(Walker) * WALKER_SIGHT_RADIUS) {}
-
-  explicit PawnPath(const AWheeledVehicle &Vehicle) :
-    PawnPath(GetLocation(Vehicle), GetForwardVector(Vehicle), GetForwardSpeed(Vehicle)) {}
-
-  static bool Intersect(const PawnPath &Lhs, const PawnPath &Rhs, UWorld* EXTRA_LOG_ONLY(World))
-  {
-    EXTRA_LOG_ONLY(Lhs.DrawDebugArrow(World));
-    EXTRA_LOG_ONLY(Rhs.DrawDebugArrow(World));
-    FVector IntersectionPoint;
-    const bool bIntersect = FMath::SegmentIntersection2D(
-        Lhs.Start, Lhs.End,
-        Rhs.Start, Rhs.End,
-        IntersectionPoint);
-
-#ifdef CARLA_AI_WALKERS_EXTRA_LOG
-    if (bIntersect) {
-      DrawDebugPoint(World, GetPointForDrawing(IntersectionPoint), 10.0f, FColor::Red, false, 2.0f);
-    }
-#endif // CARLA_AI_WALKERS_EXTRA_LOG
-    return bIntersect;
-  }
-
-#ifdef CARLA_AI_WALKERS_EXTRA_LOG
-  void DrawDebugArrow(UWorld *World) const
-  {
-    DrawDebugDirectionalArrow(World, GetPointForDrawing(Start), GetPointForDrawing(End), 60.0f, FColor::Red, false, 1.0f);
-  }
-#endif // CARLA_AI_WALKERS_EXTRA_LOG
-
-public:
-
-  /// Check if the paths of @a Walker and @a Vehicle intersect.
-  ///
-  /// It checks if within the update time the vehicle will cross the straight
-  /// line of @a Walker sight radius on its forward direction.
-  static bool Intersect(const APawn &Walker, const AWheeledVehicle &Vehicle)
-  {
-    return Intersect(PawnPath(Walker), PawnPath(Vehicle), Walker.GetWorld());
-  }
-
-private:
-
-  FVector Start;
-
-  FVector End;
-};
-
-// =============================================================================
-// -- Other static functions ---------------------------------------------------
-// =============================================================================
-
-static bool IntersectsWithVehicle(const APawn &Self, const TArray<AActor *> &Actors)
-{
-  for (auto *Actor : Actors) {
-    const auto *Vehicle = Cast<AWheeledVehicle>(Actor);
-    if ((Vehicle != nullptr) && PawnPath::Intersect(Self, *Vehicle)) {
-      return true;
-    }
-  }
-  return false;
-}
 
 // =============================================================================
 // -- AWalkerAIController ------------------------------------------------------
@@ -142,22 +33,6 @@ AWalkerAIController::AWalkerAIController(const FObjectInitializer& ObjectInitial
 {
   PrimaryActorTick.bCanEverTick = true;
   PrimaryActorTick.TickInterval = UPDATE_TIME_IN_SECONDS;
-
-  auto Perception = CreateDefaultSubobject<UAIPerceptionComponent>(TEXT("AIPerception Component"));
-  check(Perception != nullptr);
-  SetPerceptionComponent(*Perception);
-
-  SightConfiguration = CreateDefaultSubobject<UAISenseConfig_Sight>(TEXT("SightConfiguration"));
-  SightConfiguration->SightRadius = WALKER_SIGHT_RADIUS;
-  SightConfiguration->LoseSightRadius = (WALKER_SIGHT_RADIUS + 100.0f);
-  SightConfiguration->PeripheralVisionAngleDegrees = WALKER_PERIPHERAL_VISION_ANGLE_IN_DEGREES;
-  SightConfiguration->DetectionByAffiliation.bDetectEnemies = true;
-  SightConfiguration->DetectionByAffiliation.bDetectNeutrals = true;
-  SightConfiguration->DetectionByAffiliation.bDetectFriendlies = true;
-
-  Perception->ConfigureSense(*SightConfiguration);
-  Perception->SetDominantSense(SightConfiguration->GetSenseImplementation());
-  Perception->OnPerceptionUpdated.AddDynamic(this, &AWalkerAIController::SenseActors);
 }
 
 
@@ -170,6 +45,7 @@ void AWalkerAIController::Possess(APawn *aPawn)
 
 void AWalkerAIController::Tick(float DeltaSeconds)
 {
+  SCOPE_CYCLE_COUNTER(STAT_CarlaWalkerAITick);
   Super::Tick(DeltaSeconds);
 
   if (Status != EWalkerStatus::RunOver) {
@@ -214,16 +90,148 @@ void AWalkerAIController::OnMoveCompleted(
   Status = EWalkerStatus::MoveCompleted;
 }
 
-void AWalkerAIController::SenseActors(const TArray<AActor *> Actors)
+void AWalkerAIController::MoveBetweenSpawnPoints(
+    FWalkerPathCache &PathCache,
+    const AWalkerSpawnPointBase &Origin,
+    const int32 Destination,
+    const FVector &DestinationLocation)
+{
+  PendingPathCache = &PathCache;
+  PendingOrigin = &Origin;
+  PendingDestination = Destination;
+  MoveToLocation(DestinationLocation);
+  PendingPathCache = nullptr;
+  PendingOrigin = nullptr;
+  PendingDestination = INDEX_NONE;
+}
+
+void AWalkerAIController::FindPathForMoveRequest(
+    const FAIMoveRequest &MoveRequest,
+    FPathFindingQuery &Query,
+    FNavPathSharedPtr &OutPath) const
+{
+  if (PendingPathCache == nullptr) {
+    Super::FindPathForMoveRequest(MoveRequest, Query, OutPath);
+    return;
+  }
+  OutPath = PendingPathCache->Find(PendingOrigin, PendingDestination);
+  if (OutPath.IsValid()) {
+    OutPath->SetQuerier(this);
+    return;
+  }
+  Super::FindPathForMoveRequest(MoveRequest, Query, OutPath);
+  if (OutPath.IsValid()) {
+    PendingPathCache->Add(PendingOrigin, PendingDestination, *OutPath);
+  }
+}
+
+/// The walker looks along the straight line of its sight radius on its
+/// forward direction.
+static void GetLineOfSight(const APawn &Pawn, FVector &Start, FVector &End)
+{
+  const FVector &Location = Pawn.GetActorLocation();
+  Start = FVector(Location.X, Location.Y, 0.0f);
+  End = Start + Pawn.GetTransform().GetRotation().GetForwardVector() * WALKER_SIGHT_RADIUS;
+}
+
+bool AWalkerAIController::IsVehicleAhead(const FVehiclePathGrid &VehiclePaths) const
 {
   const auto *aPawn = GetPawn();
-  if ((Status == EWalkerStatus::Moving) &&
-      (aPawn != nullptr) &&
-      IntersectsWithVehicle(*aPawn, Actors)) {
+  if ((Status != EWalkerStatus::Moving) || (aPawn == nullptr)) {
+    return false;
+  }
+  FVector Start;
+  FVector End;
+  GetLineOfSight(*aPawn, Start, End);
+  return VehiclePaths.Intersects(Start, End, WALKER_SIGHT_RADIUS);
+}
+
+void AWalkerAIController::ApplyVehicleCheck(const bool bVehicleAhead)
+{
+#ifdef CARLA_AI_WALKERS_EXTRA_LOG
+  // Drawn here as the check runs outside the game thread.
+  if ((Status == EWalkerStatus::Moving) && (GetPawn() != nullptr)) {
+    FVector Start;
+    FVector End;
+    GetLineOfSight(*GetPawn(), Start, End);
+    DrawDebugDirectionalArrow(GetWorld(), Start + FVector(0.0f, 0.0f, 50.0f), End + FVector(0.0f, 0.0f, 50.0f), 60.0f, FColor::Red, false, 1.0f);
+  }
+#endif // CARLA_AI_WALKERS_EXTRA_LOG
+  if (bVehicleAhead) {
     TryPauseMovement();
   }
 }
 
+void AWalkerAIController::SerializeState(FArchive &Ar)
+{
+  uint8 SavedStatus = static_cast<uint8>(Status);
+  FVector Destination = FAISystem::InvalidLocation;
+  if (Ar.IsSaving() && (GetPathFollowingComponent() != nullptr)) {
+    Destination = GetPathFollowingComponent()->GetPathDestination();
+  }
+  Ar << SavedStatus;
+  Ar << Destination;
+  if (!Ar.IsLoading() || Ar.IsError()) {
+    return;
+  }
+  StopMovement();
+  RestartMovement(static_cast<EWalkerStatus>(SavedStatus), Destination);
+}
+
+void AWalkerAIController::SetCrowdSimulation(const bool bEnabled)
+{
+  auto *Crowd = Cast<UCrowdFollowingComponent>(GetPathFollowingComponent());
+  if ((Crowd == nullptr) || (Crowd->IsCrowdSimulationEnabled() == bEnabled)) {
+    return;
+  }
+  const auto PreviousStatus = Status;
+  FVector Destination = FAISystem::InvalidLocation;
+  if (Crowd->GetStatus() != EPathFollowingStatus::Idle) {
+    Destination = Crowd->GetPathDestination();
+    StopMovement();
+  }
+  Crowd->SetCrowdSimulationState(
+      bEnabled ? ECrowdSimulationState::Enabled : ECrowdSimulationState::Disabled);
+  RestartMovement(PreviousStatus, Destination);
+}
+
+bool AWalkerAIController::IsCrowdSimulated() const
+{
+  const auto *Crowd = Cast<UCrowdFollowingComponent>(GetPathFollowingComponent());
+  return (Crowd != nullptr) && Crowd->IsCrowdSimulationEnabled();
+}
+
+void AWalkerAIController::SetCrowdAvoidance(const bool bHighQuality, const float QueryRange)
+{
+  auto *Crowd = Cast<UCrowdFollowingComponent>(GetPathFollowingComponent());
+  if ((Crowd == nullptr) ||
+      ((bHighQuality == bCrowdHighQuality) && (QueryRange == CrowdQueryRange))) {
+    return;
+  }
+  bCrowdHighQuality = bHighQuality;
+  CrowdQueryRange = QueryRange;
+  // Each call updates the agent of the crowd manager.
+  Crowd->SetCrowdAvoidanceQuality(
+      bHighQuality ? ECrowdAvoidanceQuality::High : ECrowdAvoidanceQuality::Low);
+  Crowd->SetCrowdCollisionQueryRange(QueryRange);
+}
+
+void AWalkerAIController::RestartMovement(
+    const EWalkerStatus PreviousStatus,
+    const FVector &Destination)
+{
+  const bool bHadMove =
+      (PreviousStatus == EWalkerStatus::Moving) ||
+      (PreviousStatus == EWalkerStatus::Paused);
+  if (bHadMove && FAISystem::IsValidLocation(Destination)) {
+    MoveToLocation(Destination);
+    if (PreviousStatus == EWalkerStatus::Paused) {
+      TryPauseMovement();
+    }
+  }
+  Status = PreviousStatus;
+}
+
 void AWalkerAIController::TryResumeMovement()
 {
   if (Status != EWalkerStatus::Moving) {
@@ -271,5 +279,4 @@ void AWalkerAIController::OnPawnTookDamage(
   Status = EWalkerStatus::RunOver;
 }
 
-#undef EXTRA_LOG_ONLY
 #undef LOG_AI_WALKER
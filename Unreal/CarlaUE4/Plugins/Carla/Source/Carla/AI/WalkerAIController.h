@@ -9,7 +9,9 @@
 #include "AIController.h"
 #include "WalkerAIController.generated.h"
 
-class UAISenseConfig_Sight;
+class AWalkerSpawnPointBase;
+class FVehiclePathGrid;
+class FWalkerPathCache;
 
 UENUM(BlueprintType)
 enum class EWalkerStatus : uint8 {
@@ -41,16 +43,72 @@ public:
 
   virtual void OnMoveCompleted(FAIRequestID RequestID, const FPathFollowingResult &Result) override;
 
-  UFUNCTION(BlueprintCallable)
-  void SenseActors(TArray<AActor *> Actors);
+  /// Move from the spawn point @a Origin, where the walker must stand, to
+  /// the spawn point of index @a Destination at @a DestinationLocation. The
+  /// path is taken from @a PathCache if found there, otherwise it is searched
+  /// and added to it.
+  void MoveBetweenSpawnPoints(
+      FWalkerPathCache &PathCache,
+      const AWalkerSpawnPointBase &Origin,
+      int32 Destination,
+      const FVector &DestinationLocation);
+
+  /// Whether the walker is moving and the path of a vehicle in
+  /// @a VehiclePaths crosses its way. Read-only, the walker spawner calls it
+  /// every tick for many walkers in parallel.
+  bool IsVehicleAhead(const FVehiclePathGrid &VehiclePaths) const;
+
+  /// Pause the walker if @a bVehicleAhead, the result of IsVehicleAhead.
+  /// Game thread only.
+  void ApplyVehicleCheck(bool bVehicleAhead);
 
   EWalkerStatus GetWalkerStatus() const
   {
     return Status;
   }
 
+  /// Far walkers keep walking but do not check for vehicles.
+  void SetLowDetail(bool bInLowDetail)
+  {
+    bLowDetail = bInLowDetail;
+  }
+
+  bool IsLowDetail() const
+  {
+    return bLowDetail;
+  }
+
+  /// Whether the crowd manager simulates the walker, avoiding the walkers
+  /// around. Otherwise it follows its path on its own, see
+  /// AWalkerSpawnerBase::MaxCrowdAgents. The crowd following component only
+  /// switches while idle, so a walker on its way requests its move again from
+  /// where it stands.
+  void SetCrowdSimulation(bool bEnabled);
+
+  bool IsCrowdSimulated() const;
+
+  /// Avoidance quality and range (cm) of the neighbours query of the walker
+  /// while simulated by the crowd.
+  void SetCrowdAvoidance(bool bHighQuality, float QueryRange);
+
+  /// Save or restore the status of the walker and the destination of its
+  /// move. On restore the move is requested again from the current location
+  /// of the pawn, so it must be moved into place first.
+  void SerializeState(FArchive &Ar);
+
+protected:
+
+  virtual void FindPathForMoveRequest(
+      const FAIMoveRequest &MoveRequest,
+      FPathFindingQuery &Query,
+      FNavPathSharedPtr &OutPath) const override;
+
 private:
 
+  /// Request again the move to @a Destination that was in @a PreviousStatus
+  /// before being stopped.
+  void RestartMovement(EWalkerStatus PreviousStatus, const FVector &Destination);
+
   void TryResumeMovement();
 
   void TryPauseMovement(bool bItWasRunOver = false);
@@ -58,9 +116,24 @@ private:
   UFUNCTION()
   void OnPawnTookDamage(AActor *DamagedActor, float Damage, const UDamageType *DamageType, AController *InstigatedBy, AActor *DamageCauser);
 
-  UPROPERTY(Category = "Walker AI Controller", VisibleAnywhere)
-  UAISenseConfig_Sight *SightConfiguration;
-
   UPROPERTY(VisibleAnywhere)
   EWalkerStatus Status = EWalkerStatus::Unknown;
+
+  UPROPERTY(VisibleAnywhere)
+  bool bLowDetail = false;
+
+  UPROPERTY(VisibleAnywhere)
+  bool bCrowdHighQuality = false;
+
+  /// Negative until set.
+  UPROPERTY(VisibleAnywhere)
+  float CrowdQueryRange = -1.0f;
+
+  /// Path cache and key of the move being requested by
+  /// MoveBetweenSpawnPoints, null otherwise.
+  FWalkerPathCache *PendingPathCache = nullptr;
+
+  const AWalkerSpawnPointBase *PendingOrigin = nullptr;
+
+  int32 PendingDestination = INDEX_NONE;
 };
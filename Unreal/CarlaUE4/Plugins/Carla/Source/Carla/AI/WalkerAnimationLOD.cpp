@@ -0,0 +1,113 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "WalkerAnimationLOD.h"
+
+#include "Camera/PlayerCameraManager.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+
+#include "Game/CarlaVehicleController.h"
+#include "SceneCaptureCamera.h"
+
+/// Aspect ratio assumed for the viewport of the local players.
+static constexpr float VIEWPORT_ASPECT_RATIO = 16.0f / 9.0f;
+
+void FWalkerAnimationLOD::AddView(
+    const FVector &Location,
+    const FRotator &Rotation,
+    const float FOVAngle,
+    const float AspectRatio)
+{
+  // Half angle of the cone through the corners of the frustum.
+  const float TanHalfFOV = FMath::Tan(FMath::DegreesToRadians(0.5f * FOVAngle));
+  const float TanHalfDiagonal = TanHalfFOV * FMath::Sqrt(1.0f + 1.0f / FMath::Square(AspectRatio));
+  const float HalfAngle = FMath::Atan(TanHalfDiagonal);
+  Views.Add({Location, Rotation.Vector(), FMath::Cos(HalfAngle), FMath::Sin(HalfAngle)});
+}
+
+void FWalkerAnimationLOD::GatherViews(const UWorld &World, const float DeltaSeconds)
+{
+  Views.Reset();
+  FrameTime = DeltaSeconds;
+  for (auto It = World.GetPlayerControllerIterator(); It; ++It) {
+    const APlayerController *Controller = It->Get();
+    // NPC vehicles have player controllers too, but no local player.
+    if ((Controller == nullptr) || (Controller->GetLocalPlayer() == nullptr)) {
+      continue;
+    }
+    FVector Location;
+    FRotator Rotation;
+    Controller->GetPlayerViewPoint(Location, Rotation);
+    const auto *CameraManager = Controller->PlayerCameraManager;
+    const float FOVAngle = (CameraManager != nullptr ? CameraManager->GetFOVAngle() : 90.0f);
+    AddView(Location, Rotation, FOVAngle, VIEWPORT_ASPECT_RATIO);
+
+    const auto *Player = Cast<ACarlaVehicleController>(Controller);
+    if (Player == nullptr) {
+      continue;
+    }
+    for (const auto *Camera : Player->GetSceneCaptureCameras()) {
+      if ((Camera != nullptr) && Camera->IsCaptureEnabled() && Camera->IsPanoramic()) {
+        // Sees all around, a cone of half angle 180 degrees.
+        Views.Add({Camera->GetActorLocation(), Camera->GetActorForwardVector(), -1.0f, 0.0f});
+      } else if ((Camera != nullptr) && Camera->IsCaptureEnabled() && (Camera->GetImageSizeY() > 0u)) {
+        AddView(
+            Camera->GetActorLocation(),
+            Camera->GetActorRotation(),
+            Camera->GetFOVAngle(),
+            static_cast<float>(Camera->GetImageSizeX()) / static_cast<float>(Camera->GetImageSizeY()));
+      }
+    }
+  }
+}
+
+void FWalkerAnimationLOD::Apply(
+    ACharacter &Walker,
+    const float FullRateDistance,
+    const int32 MaxFramesSkipped) const
+{
+  auto *Mesh = Walker.GetMesh();
+  if ((Mesh == nullptr) || (Views.Num() == 0)) {
+    return;
+  }
+  const FVector Center = Mesh->Bounds.Origin;
+  const float Radius = Mesh->Bounds.SphereRadius;
+
+  // Distance to the nearest view whose cone touches the bounding sphere.
+  float NearestDistance = TNumericLimits<float>::Max();
+  for (const auto &View : Views) {
+    const FVector Offset = Center - View.Location;
+    const float Distance = Offset.Size();
+    if (Distance <= Radius) {
+      NearestDistance = 0.0f;
+      break;
+    }
+    // Cosine of the half angle widened by the angle the sphere subtends.
+    const float SinSphere = Radius / Distance;
+    const float CosSphere = FMath::Sqrt(1.0f - FMath::Square(SinSphere));
+    const float CosWidened = View.CosHalfAngle * CosSphere - View.SinHalfAngle * SinSphere;
+    if (FVector::DotProduct(Offset, View.Forward) >= Distance * CosWidened) {
+      NearestDistance = FMath::Min(NearestDistance, Distance);
+    }
+  }
+
+  if (NearestDistance == TNumericLimits<float>::Max()) {
+    // Not seen by any view, keep the last pose.
+    Mesh->SetComponentTickEnabled(false);
+    return;
+  }
+  const int32 FramesSkipped = FMath::Clamp(
+      FMath::FloorToInt(NearestDistance / FMath::Max(FullRateDistance, 1.0f)) - 1,
+      0,
+      FMath::Max(0, MaxFramesSkipped));
+  // Half a frame short so the mesh does tick every FramesSkipped + 1 frames,
+  // its delta time covers the frames skipped.
+  Mesh->SetComponentTickInterval(FramesSkipped > 0 ? (FramesSkipped + 0.5f) * FrameTime : 0.0f);
+  Mesh->SetComponentTickEnabled(true);
+}
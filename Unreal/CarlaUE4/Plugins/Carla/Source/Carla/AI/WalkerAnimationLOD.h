@@ -0,0 +1,56 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Util/NonCopyable.h"
+
+class ACharacter;
+class UWorld;
+
+/// Animation level of detail of the walkers. The views are gathered once per
+/// tick: the view point of each local player and every scene capture camera
+/// enabled, so the captured images stay correct even if the walker is off the
+/// main viewport.
+///
+/// A walker outside every view does not animate at all. A walker in view
+/// animates at full rate up to a distance from the nearest view seeing it,
+/// and at a lower rate the further it is. The bones are only evaluated and
+/// sent to skinning when the mesh ticks, so both are reduced along.
+class CARLA_API FWalkerAnimationLOD : private NonCopyable
+{
+public:
+
+  /// Collect the views of @a World. @a DeltaSeconds is the expected time
+  /// between frames, used to turn the frames skipped into a tick interval.
+  void GatherViews(const UWorld &World, float DeltaSeconds);
+
+  /// Set the animation rate of @a Walker. Its mesh animates every frame up to
+  /// @a FullRateDistance (cm) from the nearest view, and skips up to
+  /// @a MaxFramesSkipped frames further on, one more each multiple of the
+  /// distance.
+  void Apply(ACharacter &Walker, float FullRateDistance, int32 MaxFramesSkipped) const;
+
+private:
+
+  struct FView
+  {
+    FVector Location;
+
+    FVector Forward;
+
+    /// Of the half angle of the cone containing the frustum.
+    float CosHalfAngle;
+
+    float SinHalfAngle;
+  };
+
+  void AddView(const FVector &Location, const FRotator &Rotation, float FOVAngle, float AspectRatio);
+
+  TArray<FView> Views;
+
+  float FrameTime = 0.0f;
+};
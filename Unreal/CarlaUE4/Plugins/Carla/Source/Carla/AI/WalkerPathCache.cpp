@@ -0,0 +1,44 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "WalkerPathCache.h"
+
+#include "AI/Navigation/RecastNavMesh.h"
+
+/// Copy the points and, for navmesh paths, the corridor the crowd follows.
+static FNavPathSharedPtr CopyPath(const FNavigationPath &Path)
+{
+  FNavMeshPath *Copy = new FNavMeshPath();
+  Copy->GetPathPoints() = Path.GetPathPoints();
+  const FNavMeshPath *NavMeshPath = Path.CastPath<FNavMeshPath>();
+  if (NavMeshPath != nullptr) {
+    Copy->PathCorridor = NavMeshPath->PathCorridor;
+    Copy->PathCorridorCost = NavMeshPath->PathCorridorCost;
+  }
+  Copy->SetNavigationDataUsed(Path.GetNavigationDataUsed());
+  Copy->SetIsPartial(Path.IsPartial());
+  Copy->MarkReady();
+  return MakeShareable(Copy);
+}
+
+FNavPathSharedPtr FWalkerPathCache::Find(
+    const AWalkerSpawnPointBase *Origin,
+    const int32 Destination) const
+{
+  const auto *Path = Paths.Find(FKey(Origin, Destination));
+  return (Path != nullptr ? CopyPath(**Path) : FNavPathSharedPtr());
+}
+
+void FWalkerPathCache::Add(
+    const AWalkerSpawnPointBase *Origin,
+    const int32 Destination,
+    const FNavigationPath &Path)
+{
+  if (Path.IsValid() && !Path.IsPartial()) {
+    Paths.Add(FKey(Origin, Destination), CopyPath(Path));
+  }
+}
@@ -0,0 +1,46 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "AI/Navigation/NavigationTypes.h"
+#include "Util/NonCopyable.h"
+
+class AWalkerSpawnPointBase;
+
+/// Navigation paths found between walker spawn points, so walkers going from
+/// the same spawn point to the same destination reuse the first one's path
+/// instead of searching the navmesh again.
+///
+/// Every walker gets its own copy of the path, as path following modifies
+/// it. The cache has to be reset whenever the navmesh is rebuilt.
+class CARLA_API FWalkerPathCache : private NonCopyable
+{
+public:
+
+  /// Copy of the path from @a Origin to the spawn point @a Destination, null
+  /// if not cached.
+  FNavPathSharedPtr Find(const AWalkerSpawnPointBase *Origin, int32 Destination) const;
+
+  /// Cache a copy of @a Path, ignored if partial.
+  void Add(const AWalkerSpawnPointBase *Origin, int32 Destination, const FNavigationPath &Path);
+
+  void Reset()
+  {
+    Paths.Reset();
+  }
+
+  int32 Num() const
+  {
+    return Paths.Num();
+  }
+
+private:
+
+  using FKey = TPair<const AWalkerSpawnPointBase *, int32>;
+
+  TMap<FKey, FNavPathSharedPtr> Paths;
+};
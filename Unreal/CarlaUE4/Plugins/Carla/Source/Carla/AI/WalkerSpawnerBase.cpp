@@ -7,14 +7,35 @@
 #include "Carla.h"
 #include "WalkerSpawnerBase.h"
 
+#include "Async/ParallelFor.h"
 #include "Components/BoxComponent.h"
+#include "AI/Navigation/NavigationSystem.h"
 #include "EngineUtils.h"
 #include "GameFramework/Character.h"
+#include "Game/CarlaGameState.h"
 
+#include "AgentLOD.h"
+#include "Util/PawnParking.h"
 #include "Util/RandomEngine.h"
 #include "WalkerAIController.h"
 #include "WalkerSpawnPoint.h"
 
+DECLARE_CYCLE_STAT(TEXT("Walker Spawner Tick"), STAT_CarlaWalkerSpawnerTick, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Walkers Check For Vehicles"), STAT_CarlaWalkersCheckForVehicles, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Walkers Crowd Budget"), STAT_CarlaWalkersCrowdBudget, STATGROUP_Carla);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Walkers In Crowd"), STAT_CarlaWalkersInCrowd, STATGROUP_Carla);
+
+/// Seconds between updates of the walkers in the crowd.
+static constexpr float CROWD_UPDATE_INTERVAL = 1.0f;
+
+/// Walkers joining or leaving the crowd per update. Each one walking finds its
+/// path again.
+static constexpr int32 MAX_CROWD_CHANGES_PER_UPDATE = 16;
+
+/// Walkers in the crowd keep their place until others are this much nearer
+/// (as a factor of the squared distance).
+static constexpr float CROWD_HYSTERESIS = 0.8f;
+
 // =============================================================================
 // -- Static local methods -----------------------------------------------------
 // =============================================================================
@@ -29,16 +50,6 @@ static AWalkerAIController *GetController(ACharacter *Walker)
   return (WalkerIsValid(Walker) ? Cast<AWalkerAIController>(Walker->GetController()) : nullptr);
 }
 
-static float GetDistance(const FVector &Location0, const FVector &Location1)
-{
-  return FMath::Abs((Location0 - Location1).Size());
-}
-
-static float GetDistance(const AActor &Actor0, const AActor &Actor1)
-{
-  return GetDistance(Actor0.GetActorLocation(), Actor1.GetActorLocation());
-}
-
 static EWalkerStatus GetWalkerStatus(ACharacter *Walker)
 {
   const auto *Controller = GetController(Walker);
@@ -69,50 +80,66 @@ void AWalkerSpawnerBase::BeginPlay()
   // Allocate space for walkers.
   Walkers.Reserve(NumberOfWalkers);
 
-  // Find spawn points present in level.
-  TArray<AWalkerSpawnPointBase *> BeginSpawnPoints;
-  for (TActorIterator<AWalkerSpawnPointBase> It(GetWorld()); It; ++It) {
-    BeginSpawnPoints.Add(*It);
-    AWalkerSpawnPoint *SpawnPoint = Cast<AWalkerSpawnPoint>(*It);
-    if (SpawnPoint != nullptr) {
-      SpawnPoints.Add(SpawnPoint);
-    }
-  }
-  UE_LOG(LogCarla, Log, TEXT("Found %d positions for spawning walkers at begin play."), BeginSpawnPoints.Num());
-  UE_LOG(LogCarla, Log, TEXT("Found %d positions for spawning walkers during game play."), SpawnPoints.Num());
+  FindSpawnPoints();
 
-  if (SpawnPoints.Num() < 2) {
-    bSpawnWalkers = false;
-    UE_LOG(LogCarla, Error, TEXT("We don't have enough spawn points for walkers!"));
-  } else if (BeginSpawnPoints.Num() < NumberOfWalkers) {
-    UE_LOG(LogCarla, Warning, TEXT("Requested %d walkers, but we only have %d spawn points. Some will fail to spawn."), NumberOfWalkers, BeginSpawnPoints.Num());
+  auto *NavSys = GetWorld()->GetNavigationSystem();
+  if (NavSys != nullptr) {
+    NavSys->OnNavigationGenerationFinishedDelegate.AddUniqueDynamic(
+        this,
+        &AWalkerSpawnerBase::OnNavigationGenerationFinished);
   }
 
-  GetRandomEngine()->Shuffle(BeginSpawnPoints);
-
-  if (bSpawnWalkers && bSpawnWalkersAtBeginPlay) {
-    uint32 Count = 0u;
-    for (auto i = 0; i < NumberOfWalkers; ++i) {
-      if (TryToSpawnWalkerAt(*BeginSpawnPoints[i % BeginSpawnPoints.Num()])) {
-        ++Count;
-      }
-    }
-    UE_LOG(LogCarla, Log, TEXT("Spawned %d walkers at begin play."), Count);
-  }
+  SpawnWalkersAtBeginPlay();
 }
 
 void AWalkerSpawnerBase::Tick(float DeltaTime)
 {
+  SCOPE_CYCLE_COUNTER(STAT_CarlaWalkerSpawnerTick);
   Super::Tick(DeltaTime);
 
-  if (bSpawnWalkers && (NumberOfWalkers > GetCurrentNumberOfWalkers())) {
+  if (HasPendingSpawns()) {
+    SpawnPendingWalkers();
+  } else if (bSpawnWalkers && (NumberOfWalkers > GetCurrentNumberOfWalkers())) {
     // Try to spawn one walker.
     TryToSpawnWalkerAt(GetRandomSpawnPoint());
   }
 
-  if (WalkersBlackList.Num() > 0) {
+  MaintainWalkers();
+
+  // Update the level of detail of the walkers, and let the ones near the
+  // players check for the vehicles crossing their way.
+  FAgentLOD::GetViewLocations(*GetWorld(), ViewLocations);
+  if (bAnimationLOD) {
+    AnimationLOD.GatherViews(*GetWorld(), DeltaTime);
+  }
+  VehiclePaths.Rebuild(*GetWorld());
+  CheckingControllers.Reset();
+  for (auto *List : {&Walkers, &WalkersBlackList}) {
+    for (auto *Walker : *List) {
+      auto *Controller = GetController(Walker);
+      if (Controller != nullptr) {
+        Controller->SetLowDetail(
+            FAgentLOD::IsFar(Walker->GetActorLocation(), ViewLocations, LowDetailDistance));
+        if (!Controller->IsLowDetail()) {
+          CheckingControllers.Add(Controller);
+        }
+        if (bAnimationLOD) {
+          AnimationLOD.Apply(*Walker, AnimationFullRateDistance, MaxAnimationFramesSkipped);
+        }
+      }
+    }
+  }
+  CheckForVehicles();
+  UpdateCrowdBudget(DeltaTime);
+}
+
+void AWalkerSpawnerBase::MaintainWalkers()
+{
+  const int32 Budget = FMath::Max(1, WalkersCheckedPerTick);
+
+  for (auto n = FMath::Min(Budget, WalkersBlackList.Num()); (n > 0) && (WalkersBlackList.Num() > 0); --n) {
     // If still stuck in the black list, just kill it.
-    const int32 Index = (++CurrentIndexToCheck % WalkersBlackList.Num());
+    const int32 Index = (NextBlackListedWalkerToCheck++ % WalkersBlackList.Num());
     auto Walker = WalkersBlackList[Index];
     const auto Status = GetWalkerStatus(Walker);
     if ((Status == EWalkerStatus::MoveCompleted) ||
@@ -125,9 +152,9 @@ void AWalkerSpawnerBase::Tick(float DeltaTime)
     }
   }
 
-  if (Walkers.Num() > 0) {
-    // Check one walker, if fails black-list it or kill it.
-    const int32 Index = (++CurrentIndexToCheck % Walkers.Num());
+  for (auto n = FMath::Min(Budget, Walkers.Num()); (n > 0) && (Walkers.Num() > 0); --n) {
+    // Check the walker, if fails black-list it or kill it.
+    const int32 Index = (NextWalkerToCheck++ % Walkers.Num());
     auto Walker = Walkers[Index];
     const auto Status = GetWalkerStatus(Walker);
 
@@ -149,6 +176,99 @@ void AWalkerSpawnerBase::Tick(float DeltaTime)
   }
 }
 
+void AWalkerSpawnerBase::OnNavigationGenerationFinished(ANavigationData *)
+{
+  PathCache.Reset();
+}
+
+void AWalkerSpawnerBase::CheckForVehicles()
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaWalkersCheckForVehicles);
+  const int32 Count = CheckingControllers.Num();
+  VehiclesAhead.SetNumUninitialized(Count, false);
+  const int32 ChunkSize = FMath::Max(1, WalkersPerTask);
+  const int32 NumberOfChunks = (Count + ChunkSize - 1) / ChunkSize;
+  // Think, reads only the walkers and the vehicle paths, each chunk writes
+  // its own slice of the results.
+  ParallelFor(NumberOfChunks, [&](const int32 Chunk) {
+    const int32 End = FMath::Min(Count, (Chunk + 1) * ChunkSize);
+    for (int32 i = Chunk * ChunkSize; i < End; ++i) {
+      VehiclesAhead[i] = CheckingControllers[i]->IsVehicleAhead(VehiclePaths);
+    }
+  }, NumberOfChunks < 2);
+  // Apply, moves are paused on the game thread.
+  for (auto i = 0; i < Count; ++i) {
+    CheckingControllers[i]->ApplyVehicleCheck(VehiclesAhead[i]);
+  }
+}
+
+void AWalkerSpawnerBase::UpdateCrowdBudget(const float DeltaTime)
+{
+  TimeToCrowdUpdate -= DeltaTime;
+  if (TimeToCrowdUpdate > 0.0f) {
+    return;
+  }
+  TimeToCrowdUpdate = CROWD_UPDATE_INTERVAL;
+  SCOPE_CYCLE_COUNTER(STAT_CarlaWalkersCrowdBudget);
+
+  CrowdCandidates.Reset();
+  for (auto *List : {&Walkers, &WalkersBlackList}) {
+    for (auto *Walker : *List) {
+      auto *Controller = GetController(Walker);
+      if ((Controller == nullptr) || (Controller->GetWalkerStatus() == EWalkerStatus::RunOver)) {
+        continue;
+      }
+      const FVector &Location = Walker->GetActorLocation();
+      float DistanceSquared = (ViewLocations.Num() > 0 ? TNumericLimits<float>::Max() : 0.0f);
+      for (const auto &ViewLocation : ViewLocations) {
+        DistanceSquared = FMath::Min(DistanceSquared, FVector::DistSquared(Location, ViewLocation));
+      }
+      const bool bSimulated = Controller->IsCrowdSimulated();
+      CrowdCandidates.Add({
+          (bSimulated ? CROWD_HYSTERESIS * DistanceSquared : DistanceSquared),
+          DistanceSquared,
+          bSimulated,
+          Controller});
+    }
+  }
+  CrowdCandidates.Sort([](const FCrowdCandidate &A, const FCrowdCandidate &B) {
+    return (A.RankDistanceSquared < B.RankDistanceSquared) ||
+        ((A.RankDistanceSquared == B.RankDistanceSquared) && A.bSimulated && !B.bSimulated);
+  });
+
+  const int32 Budget = FMath::Min(FMath::Max(0, MaxCrowdAgents), CrowdCandidates.Num());
+  int32 NumberOfChanges = 0;
+  int32 NumberSimulated = 0;
+  // Out of the budget first, making room in the crowd manager for the ones
+  // coming in.
+  for (auto i = CrowdCandidates.Num() - 1; i >= 0; --i) {
+    auto &Candidate = CrowdCandidates[i];
+    if (Candidate.bSimulated && (i >= Budget) && (NumberOfChanges < MAX_CROWD_CHANGES_PER_UPDATE)) {
+      Candidate.Controller->SetCrowdSimulation(false);
+      Candidate.bSimulated = false;
+      ++NumberOfChanges;
+    }
+    NumberSimulated += (Candidate.bSimulated ? 1 : 0);
+  }
+  const float HighQualityDistanceSquared = CrowdHighQualityDistance * CrowdHighQualityDistance;
+  for (auto i = 0; i < Budget; ++i) {
+    auto &Candidate = CrowdCandidates[i];
+    if (!Candidate.bSimulated) {
+      if ((NumberSimulated >= Budget) || (NumberOfChanges >= MAX_CROWD_CHANGES_PER_UPDATE)) {
+        continue;
+      }
+      Candidate.Controller->SetCrowdSimulation(true);
+      ++NumberSimulated;
+      ++NumberOfChanges;
+    }
+    const bool bHighQuality = (Candidate.DistanceSquared <= HighQualityDistanceSquared);
+    Candidate.Controller->SetCrowdAvoidance(
+        bHighQuality,
+        (bHighQuality ? CrowdQueryRange : 0.5f * CrowdQueryRange));
+  }
+  SET_DWORD_STAT(STAT_CarlaWalkersInCrowd, NumberSimulated);
+}
+
 // =============================================================================
 // -- Other member functions ---------------------------------------------------
 // =============================================================================
@@ -163,6 +283,113 @@ void AWalkerSpawnerBase::SetNumberOfWalkers(const int32 Count)
   }
 }
 
+SIZE_T AWalkerSpawnerBase::GetPoolAllocatedSize() const
+{
+  SIZE_T Size = WalkerPool.GetAllocatedSize();
+  for (auto *Walker : WalkerPool) {
+    if (Walker != nullptr) {
+      Size += FPawnParking::GetResourceSize(*Walker);
+    }
+  }
+  return Size;
+}
+
+void AWalkerSpawnerBase::FindSpawnPoints()
+{
+  SpawnPoints.Reset();
+  for (TActorIterator<AWalkerSpawnPoint> It(GetWorld()); It; ++It) {
+    SpawnPoints.Add(*It);
+  }
+  UE_LOG(LogCarla, Log, TEXT("Found %d positions for spawning walkers during game play."), SpawnPoints.Num());
+  TArray<FVector> SpawnLocations;
+  for (const auto *SpawnPoint : SpawnPoints) {
+    SpawnLocations.Add(SpawnPoint->GetActorLocation());
+  }
+  // Cells as big as the minimum walk distance, only the points in the cells
+  // around the origin are too close to be a destination.
+  SpawnPointGrid.Build(SpawnLocations, FMath::Max(MinimumWalkDistance, 100.0f));
+
+  PathCache.Reset();
+}
+
+void AWalkerSpawnerBase::SpawnWalkersAtBeginPlay()
+{
+  BeginSpawnPoints.Empty();
+  for (TActorIterator<AWalkerSpawnPointBase> It(GetWorld()); It; ++It) {
+    BeginSpawnPoints.Add(*It);
+  }
+  UE_LOG(LogCarla, Log, TEXT("Found %d positions for spawning walkers at begin play."), BeginSpawnPoints.Num());
+
+  if (SpawnPoints.Num() < 2) {
+    bSpawnWalkers = false;
+    UE_LOG(LogCarla, Error, TEXT("We don't have enough spawn points for walkers!"));
+  } else if (BeginSpawnPoints.Num() < NumberOfWalkers) {
+    UE_LOG(LogCarla, Warning, TEXT("Requested %d walkers, but we only have %d spawn points. Some will fail to spawn."), NumberOfWalkers, BeginSpawnPoints.Num());
+  }
+
+  GetRandomEngine()->Shuffle(BeginSpawnPoints);
+
+  NextBeginPlaySpawn = 0;
+  NumberOfWalkersSpawnedAtBeginPlay = 0u;
+  if (bSpawnWalkers && bSpawnWalkersAtBeginPlay && (BeginSpawnPoints.Num() > 0)) {
+    NumberOfBeginPlaySpawns = NumberOfWalkers;
+    SpawnPendingWalkers();
+  } else {
+    NumberOfBeginPlaySpawns = 0;
+  }
+}
+
+void AWalkerSpawnerBase::SpawnPendingWalkers()
+{
+  int32 NumberOfAttempts = 0;
+  while (HasPendingSpawns() &&
+         ((MaxSpawnsPerFrame <= 0) || (NumberOfAttempts < MaxSpawnsPerFrame))) {
+    const int32 i = NextBeginPlaySpawn++;
+    if (TryToSpawnWalkerAt(*BeginSpawnPoints[i % BeginSpawnPoints.Num()])) {
+      ++NumberOfWalkersSpawnedAtBeginPlay;
+    }
+    ++NumberOfAttempts;
+  }
+  if ((NumberOfAttempts > 0) && !HasPendingSpawns()) {
+    UE_LOG(LogCarla, Log, TEXT("Spawned %d walkers at begin play."), NumberOfWalkersSpawnedAtBeginPlay);
+  }
+}
+
+void AWalkerSpawnerBase::DespawnWalkers()
+{
+  auto *GameState = GetWorld()->GetGameState<ACarlaGameState>();
+  for (auto *List : {&Walkers, &WalkersBlackList}) {
+    for (auto *Walker : *List) {
+      if (!WalkerIsValid(Walker)) {
+        continue;
+      }
+      auto Controller = GetController(Walker);
+      const auto Status = GetWalkerStatus(Walker);
+      if (Status == EWalkerStatus::RunOver) {
+        // Will self-destroy.
+        continue;
+      } else if (bPoolWalkers && (Controller != nullptr)) {
+        Controller->StopMovement();
+        // Out of the crowd manager while parked.
+        Controller->SetCrowdSimulation(false);
+        if (GameState != nullptr) {
+          GameState->DeregisterAgent(*Walker);
+        }
+        FPawnParking::Park(*Walker);
+        WalkerPool.Add(Walker);
+      } else {
+        if (Controller != nullptr) {
+          Controller->Destroy();
+        }
+        Walker->Destroy();
+      }
+    }
+    List->Empty();
+  }
+  NumberOfBeginPlaySpawns = 0;
+  NextBeginPlaySpawn = 0;
+}
+
 const AWalkerSpawnPointBase &AWalkerSpawnerBase::GetRandomSpawnPoint()
 {
   check(SpawnPoints.Num() > 0);
@@ -171,31 +398,40 @@ const AWalkerSpawnPointBase &AWalkerSpawnerBase::GetRandomSpawnPoint()
   return *SpawnPoint;
 }
 
-bool AWalkerSpawnerBase::TryGetValidDestination(const FVector &Origin, FVector &Destination)
+bool AWalkerSpawnerBase::TryGetValidDestination(
+    const FVector &Origin,
+    FVector &Destination,
+    int32 &DestinationIndex)
 {
-  const auto &DestinationPoint = GetRandomSpawnPoint();
-  Destination = DestinationPoint.GetActorLocation();
-  return (GetDistance(Origin, Destination) >= MinimumWalkDistance);
+  DestinationIndex = SpawnPointGrid.PickFar(Origin, MinimumWalkDistance, *GetRandomEngine());
+  if (DestinationIndex == INDEX_NONE) {
+    return false;
+  }
+  Destination = SpawnPointGrid.GetLocation(DestinationIndex);
+  return true;
 }
 
 bool AWalkerSpawnerBase::TryToSpawnWalkerAt(const AWalkerSpawnPointBase &SpawnPoint)
 {
   // Try find destination.
   FVector Destination;
-  if (!TryGetValidDestination(SpawnPoint.GetActorLocation(), Destination)) {
+  int32 DestinationIndex;
+  if (!TryGetValidDestination(SpawnPoint.GetActorLocation(), Destination, DestinationIndex)) {
     return false;
   }
 
-  // Spawn walker.
-  ACharacter *Walker;
-  SpawnWalker(SpawnPoint.GetActorTransform(), Walker);
-  if (!WalkerIsValid(Walker)) {
-    return false;
-  }
+  // Reuse a parked walker or spawn a new one.
+  ACharacter *Walker = TryToReuseWalkerAt(SpawnPoint);
+  if (Walker == nullptr) {
+    SpawnWalker(SpawnPoint.GetActorTransform(), Walker);
+    if (!WalkerIsValid(Walker)) {
+      return false;
+    }
 
-  // Assign controller.
-  Walker->AIControllerClass = AWalkerAIController::StaticClass();
-  Walker->SpawnDefaultController();
+    // Assign controller.
+    Walker->AIControllerClass = AWalkerAIController::StaticClass();
+    Walker->SpawnDefaultController();
+  }
   auto Controller = GetController(Walker);
   if (Controller == nullptr) { // Sometimes fails...
     UE_LOG(LogCarla, Error, TEXT("Something went wrong creating the controller for the new walker"));
@@ -203,12 +439,41 @@ bool AWalkerSpawnerBase::TryToSpawnWalkerAt(const AWalkerSpawnPointBase &SpawnPo
     return false;
   }
 
-  // Add walker and set destination.
+  // Add walker and set destination. It joins the crowd on the next update of
+  // the budget if near enough.
+  Controller->SetCrowdSimulation(false);
   Walkers.Add(Walker);
-  Controller->MoveToLocation(Destination);
+  auto *GameState = GetWorld()->GetGameState<ACarlaGameState>();
+  if (GameState != nullptr) {
+    GameState->RegisterAgent(*Walker, EAgentType::Walker);
+  }
+  Controller->MoveBetweenSpawnPoints(PathCache, SpawnPoint, DestinationIndex, Destination);
   return true;
 }
 
+ACharacter *AWalkerSpawnerBase::TryToReuseWalkerAt(const AWalkerSpawnPointBase &SpawnPoint)
+{
+  while ((WalkerPool.Num() > 0) && (GetController(WalkerPool.Last()) == nullptr)) {
+    // Destroyed while parked.
+    WalkerPool.Pop(false);
+  }
+  if (WalkerPool.Num() == 0) {
+    return nullptr;
+  }
+  auto *Walker = WalkerPool.Last();
+  // Parked walkers have no collision, check with the default object instead.
+  const auto *WalkerToFit = Walker->GetClass()->GetDefaultObject<ACharacter>();
+  if (GetWorld()->EncroachingBlockingGeometry(
+          WalkerToFit,
+          SpawnPoint.GetActorLocation(),
+          SpawnPoint.GetActorRotation())) {
+    return nullptr;
+  }
+  WalkerPool.Pop(false);
+  FPawnParking::Unpark(*Walker, SpawnPoint.GetActorTransform(), false);
+  return Walker;
+}
+
 bool AWalkerSpawnerBase::TrySetDestination(ACharacter &Walker)
 {
   // Try to retrieve controller.
@@ -219,7 +484,8 @@ bool AWalkerSpawnerBase::TrySetDestination(ACharacter &Walker)
 
   // Try find destination.
   FVector Destination;
-  if (!TryGetValidDestination(Walker.GetActorLocation(), Destination)) {
+  int32 DestinationIndex;
+  if (!TryGetValidDestination(Walker.GetActorLocation(), Destination, DestinationIndex)) {
     return false;
   }
 
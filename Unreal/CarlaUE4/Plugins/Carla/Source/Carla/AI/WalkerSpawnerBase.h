@@ -6,11 +6,17 @@
 
 #pragma once
 
+#include "AI/SpawnPointGrid.h"
+#include "AI/VehiclePathGrid.h"
+#include "AI/WalkerAnimationLOD.h"
+#include "AI/WalkerPathCache.h"
 #include "Util/ActorWithRandomEngine.h"
 #include "WalkerSpawnerBase.generated.h"
 
+class AWalkerAIController;
 class AWalkerSpawnPoint;
 class AWalkerSpawnPointBase;
+class ANavigationData;
 class UBoxComponent;
 
 /// Base class for spawning walkers. Implement SpawnWalker in derived
@@ -63,6 +69,49 @@ public:
 
   void SetNumberOfWalkers(int32 Count);
 
+  /// Gather the spawn points present in the level, again if the map shown
+  /// changed, see FResidentMaps. The paths found so far are forgotten.
+  void FindSpawnPoints();
+
+  /// Spawn the requested number of walkers at the begin play spawn points,
+  /// unless disabled. Called at begin play and when the episode is reset in
+  /// place.
+  ///
+  /// If a limit of spawns per frame is set, the walkers left are spawned in
+  /// the following ticks.
+  void SpawnWalkersAtBeginPlay();
+
+  /// Limit the spawn attempts per frame at begin play, zero or negative for no
+  /// limit.
+  void SetMaxSpawnsPerFrame(int32 Count)
+  {
+    MaxSpawnsPerFrame = Count;
+  }
+
+  /// Simulate by the crowd only the @a MaxAgents walkers nearest to the
+  /// players, see MaxCrowdAgents.
+  void SetCrowdBudget(int32 MaxAgents, float QueryRange, float HighQualityDistance)
+  {
+    MaxCrowdAgents = MaxAgents;
+    CrowdQueryRange = QueryRange;
+    CrowdHighQualityDistance = HighQualityDistance;
+  }
+
+  /// Bytes held by the walkers parked in the pool.
+  SIZE_T GetPoolAllocatedSize() const;
+
+  /// Whether some of the walkers requested at begin play are still to be
+  /// spawned.
+  bool HasPendingSpawns() const
+  {
+    return NextBeginPlaySpawn < NumberOfBeginPlaySpawns;
+  }
+
+  /// Remove every walker spawned so far. Unless pooling is disabled, they are
+  /// parked to be reused by the next walkers spawned, otherwise they are
+  /// destroyed along with their controller.
+  void DespawnWalkers();
+
   int32 GetCurrentNumberOfWalkers() const
   {
     return Walkers.Num() + WalkersBlackList.Num();
@@ -80,12 +129,36 @@ private:
 
   const AWalkerSpawnPointBase &GetRandomSpawnPoint();
 
-  bool TryGetValidDestination(const FVector &Origin, FVector &Destination);
+  /// Pick a spawn point far enough from @a Origin as destination, and its
+  /// index in SpawnPoints.
+  bool TryGetValidDestination(const FVector &Origin, FVector &Destination, int32 &DestinationIndex);
 
   bool TryToSpawnWalkerAt(const AWalkerSpawnPointBase &SpawnPoint);
 
+  /// Take a walker from the pool and move it to @a SpawnPoint. Returns null if
+  /// the pool is empty or the spawn point is occupied.
+  ACharacter *TryToReuseWalkerAt(const AWalkerSpawnPointBase &SpawnPoint);
+
+  void SpawnPendingWalkers();
+
   bool TrySetDestination(ACharacter &Walker);
 
+  /// Check the walkers in CheckingControllers for vehicles in parallel, then
+  /// pause those with a vehicle ahead.
+  void CheckForVehicles();
+
+  /// Check the status of up to WalkersCheckedPerTick walkers of each list,
+  /// round-robin, removing those done and black-listing those stuck.
+  void MaintainWalkers();
+
+  /// Every so often, rank the walkers by distance to the players and let only
+  /// the nearest ones into the crowd simulation.
+  void UpdateCrowdBudget(float DeltaTime);
+
+  /// The cached paths are no longer valid once the navmesh is rebuilt.
+  UFUNCTION()
+  void OnNavigationGenerationFinished(ANavigationData *NavData);
+
   /// @}
 
 private:
@@ -102,6 +175,55 @@ private:
   UPROPERTY(Category = "Walker Spawner", EditAnywhere, meta = (EditCondition = bSpawnWalkers, ClampMin = "1"))
   int32 NumberOfWalkers = 10;
 
+  /** Walkers further than this distance (cm) from every player do not use
+    * their perception.
+    */
+  UPROPERTY(Category = "Walker Spawner", EditAnywhere, meta = (ClampMin = "0"))
+  float LowDetailDistance = 10000.0f;
+
+  /** If true, the walkers animate at a lower rate the further they are from
+    * the players' views and capture cameras, and not at all out of view.
+    */
+  UPROPERTY(Category = "Walker Spawner", EditAnywhere)
+  bool bAnimationLOD = true;
+
+  /** Walkers in view animate every frame up to this distance (cm), and skip
+    * one more frame each multiple of it further on.
+    */
+  UPROPERTY(Category = "Walker Spawner", EditAnywhere, meta = (EditCondition = bAnimationLOD, ClampMin = "100"))
+  float AnimationFullRateDistance = 3000.0f;
+
+  /** Maximum number of frames a walker in view skips between animation
+    * updates.
+    */
+  UPROPERTY(Category = "Walker Spawner", EditAnywhere, meta = (EditCondition = bAnimationLOD, ClampMin = "0"))
+  int32 MaxAnimationFramesSkipped = 3;
+
+  /** Maximum number of walkers simulated by the crowd manager, those nearest
+    * to the players. The rest follow their path without avoiding the others.
+    * The crowd manager does not take more agents than its MaxAgents.
+    */
+  UPROPERTY(Category = "Walker Spawner", EditAnywhere, meta = (ClampMin = "0"))
+  int32 MaxCrowdAgents = 50;
+
+  /** Range (cm) in which the walkers of the crowd look for neighbours to
+    * avoid, halved beyond CrowdHighQualityDistance.
+    */
+  UPROPERTY(Category = "Walker Spawner", EditAnywhere, meta = (ClampMin = "0"))
+  float CrowdQueryRange = 400.0f;
+
+  /** Walkers of the crowd up to this distance (cm) from the players avoid the
+    * others with high quality, the further ones with low quality.
+    */
+  UPROPERTY(Category = "Walker Spawner", EditAnywhere, meta = (ClampMin = "0"))
+  float CrowdHighQualityDistance = 3000.0f;
+
+  /** If true, the walkers removed when the episode is reset are parked and
+    * reused instead of destroyed.
+    */
+  UPROPERTY(Category = "Walker Spawner", EditAnywhere, meta = (EditCondition = bSpawnWalkers))
+  bool bPoolWalkers = true;
+
   /** Minimum walk distance in centimeters. */
   UPROPERTY(Category = "Walker Spawner", EditAnywhere, meta = (EditCondition = bSpawnWalkers))
   float MinimumWalkDistance = 1500.0f;
@@ -109,11 +231,78 @@ private:
   UPROPERTY(Category = "Walker Spawner", VisibleAnywhere, AdvancedDisplay)
   TArray<AWalkerSpawnPoint *> SpawnPoints;
 
+  /** Locations of SpawnPoints, to pick the destinations. */
+  FSpawnPointGrid SpawnPointGrid;
+
+  /** Paths found from the spawn points to the destinations. */
+  FWalkerPathCache PathCache;
+
+  /** Number of walkers (and of black-listed walkers) whose status is checked
+    * each tick.
+    */
+  UPROPERTY(Category = "Walker Spawner", EditAnywhere, AdvancedDisplay, meta = (ClampMin = "1"))
+  int32 WalkersCheckedPerTick = 4;
+
   UPROPERTY(Category = "Walker Spawner", VisibleAnywhere, AdvancedDisplay)
   TArray<ACharacter *> Walkers;
 
   UPROPERTY(Category = "Walker Spawner", VisibleAnywhere, AdvancedDisplay)
   TArray<ACharacter *> WalkersBlackList;
 
-  uint32 CurrentIndexToCheck = 0u;
+  /** Maximum number of spawn attempts per frame at begin play, zero for no
+    * limit.
+    */
+  UPROPERTY(Category = "Walker Spawner", VisibleAnywhere, AdvancedDisplay)
+  int32 MaxSpawnsPerFrame = 0;
+
+  /** Spawn points used at begin play, shuffled. */
+  UPROPERTY(Category = "Walker Spawner", VisibleAnywhere, AdvancedDisplay)
+  TArray<AWalkerSpawnPointBase *> BeginSpawnPoints;
+
+  int32 NumberOfBeginPlaySpawns = 0;
+
+  int32 NextBeginPlaySpawn = 0;
+
+  uint32 NumberOfWalkersSpawnedAtBeginPlay = 0u;
+
+  /** Parked walkers, ready to be reused. */
+  UPROPERTY(Category = "Walker Spawner", VisibleAnywhere, AdvancedDisplay)
+  TArray<ACharacter *> WalkerPool;
+
+  uint32 NextWalkerToCheck = 0u;
+
+  uint32 NextBlackListedWalkerToCheck = 0u;
+
+  TArray<FVector> ViewLocations;
+
+  FWalkerAnimationLOD AnimationLOD;
+
+  /** Vehicles the walkers check for, rebuilt every tick. */
+  FVehiclePathGrid VehiclePaths;
+
+  /** Minimum number of walkers per parallel task checking for vehicles. */
+  UPROPERTY(Category = "Walker Spawner", EditAnywhere, AdvancedDisplay, meta = (ClampMin = "1"))
+  int32 WalkersPerTask = 32;
+
+  /// Walkers checking for vehicles this tick, and the result of each.
+  TArray<AWalkerAIController *> CheckingControllers;
+
+  TArray<bool> VehiclesAhead;
+
+  struct FCrowdCandidate
+  {
+    /// Squared distance to the nearest player, shortened for the walkers
+    /// already in the crowd so they do not swap places back and forth.
+    float RankDistanceSquared;
+
+    float DistanceSquared;
+
+    bool bSimulated;
+
+    AWalkerAIController *Controller;
+  };
+
+  TArray<FCrowdCandidate> CrowdCandidates;
+
+  float TimeToCrowdUpdate = 0.0f;
 };
@@ -11,54 +11,40 @@
 #include "GameFramework/Pawn.h"
 #include "WheeledVehicleMovementComponent.h"
 
+#include "AI/TrafficManager.h"
 #include "CarlaWheeledVehicle.h"
+#include "Game/CarlaGameState.h"
+#include "MapGen/LaneGraph.h"
 #include "MapGen/RoadMap.h"
+#include "Util/RandomEngine.h"
+
+DECLARE_CYCLE_STAT(TEXT("Vehicle AI Controller Tick"), STAT_CarlaVehicleAITick, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Vehicle Autopilot"), STAT_CarlaVehicleAutopilot, STATGROUP_Carla);
 
 // =============================================================================
 // -- Static local methods -----------------------------------------------------
 // =============================================================================
 
-static bool RayTrace(const AActor &Actor, const FVector &Start, const FVector &End) {
-  FHitResult OutHit;
+static FCollisionQueryParams GetObstacleQueryParams(const AActor &Actor)
+{
   static FName TraceTag = FName(TEXT("VehicleTrace"));
   FCollisionQueryParams CollisionParams(TraceTag, true);
   CollisionParams.AddIgnoredActor(&Actor);
+  return CollisionParams;
+}
 
+static bool RayTrace(const AActor &Actor, const FVector &Start, const FVector &End) {
+  FHitResult OutHit;
   const bool Success = Actor.GetWorld()->LineTraceSingleByObjectType(
         OutHit,
         Start,
         End,
         FCollisionObjectQueryParams(FCollisionObjectQueryParams::AllDynamicObjects),
-        CollisionParams);
+        GetObstacleQueryParams(Actor));
 
   return Success && OutHit.bBlockingHit;
 }
 
-static bool IsThereAnObstacleAhead(
-    const ACarlaWheeledVehicle &Vehicle,
-    const float Speed,
-    const FVector &Direction)
-{
-  const auto ForwardVector = Vehicle.GetVehicleOrientation();
-  const auto VehicleBounds = Vehicle.GetVehicleBoundsExtent();
-
-  const float Distance = std::max(50.0f, Speed * Speed); // why?
-
-  const FVector StartCenter = Vehicle.GetActorLocation() + (ForwardVector * (250.0f + VehicleBounds.X / 2.0f)) + FVector(0.0f, 0.0f, 50.0f);
-  const FVector EndCenter = StartCenter + Direction * (Distance + VehicleBounds.X / 2.0f);
-
-  const FVector StartRight = StartCenter + (FVector(ForwardVector.Y, -ForwardVector.X, ForwardVector.Z) * 100.0f);
-  const FVector EndRight = StartRight + Direction * (Distance + VehicleBounds.X / 2.0f);
-
-  const FVector StartLeft = StartCenter + (FVector(-ForwardVector.Y, ForwardVector.X, ForwardVector.Z) * 100.0f);
-  const FVector EndLeft = StartLeft + Direction * (Distance + VehicleBounds.X / 2.0f);
-
-  return
-      RayTrace(Vehicle, StartCenter, EndCenter) ||
-      RayTrace(Vehicle, StartRight, EndRight) ||
-      RayTrace(Vehicle, StartLeft, EndLeft);
-}
-
 // =============================================================================
 // -- Constructor and destructor -----------------------------------------------
 // =============================================================================
@@ -93,15 +79,25 @@ void AWheeledVehicleAIController::Possess(APawn *aPawn)
 
 void AWheeledVehicleAIController::Tick(const float DeltaTime)
 {
+  SCOPE_CYCLE_COUNTER(STAT_CarlaVehicleAITick);
   Super::Tick(DeltaTime);
 
   TickAutopilotController();
 
   if (bAutopilotEnabled) {
-    Vehicle->SetThrottleInput(AutopilotControl.Throttle);
-    Vehicle->SetSteeringInput(AutopilotControl.Steer);
-    Vehicle->SetBrakeInput(AutopilotControl.Brake);
+    Vehicle->ApplyAutopilotControl(
+        AutopilotControl.Throttle,
+        AutopilotControl.Steer,
+        AutopilotControl.Brake);
+  }
+}
+
+void AWheeledVehicleAIController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+  if (TrafficManager != nullptr) {
+    TrafficManager->UnregisterVehicle(*this);
   }
+  Super::EndPlay(EndPlayReason);
 }
 
 // =============================================================================
@@ -112,6 +108,7 @@ void AWheeledVehicleAIController::ConfigureAutopilot(const bool Enable)
 {
   bAutopilotEnabled = Enable;
   // Reset state.
+  Vehicle->StopResting();
   Vehicle->SetSteeringInput(0.0f);
   Vehicle->SetThrottleInput(0.0f);
   Vehicle->SetBrakeInput(0.0f);
@@ -120,12 +117,73 @@ void AWheeledVehicleAIController::ConfigureAutopilot(const bool Enable)
   TrafficLightState = ETrafficLightState::Green;
   decltype(TargetLocations) EmptyQueue;
   TargetLocations.swap(EmptyQueue);
+  // NPC vehicles are driven by the traffic manager if any, this controller
+  // only ticks its own autopilot otherwise.
+  if (TrafficManager != nullptr) {
+    if (bAutopilotEnabled && !IsPossessingThePlayer()) {
+      TrafficManager->RegisterVehicle(*this);
+      SetActorTickEnabled(false);
+    } else {
+      TrafficManager->UnregisterVehicle(*this);
+      SetActorTickEnabled(true);
+    }
+  }
   Vehicle->SetAIVehicleState(
       bAutopilotEnabled ?
           ECarlaWheeledVehicleState::FreeDriving :
           ECarlaWheeledVehicleState::AutopilotOff);
 }
 
+void AWheeledVehicleAIController::SerializeAutopilotState(FArchive &Ar)
+{
+  check(Vehicle != nullptr);
+  bool bEnabled = bAutopilotEnabled;
+  uint8 LightState = static_cast<uint8>(TrafficLightState);
+  Ar << bEnabled;
+  Ar << SpeedLimit;
+  Ar << LightState;
+  Ar << AutopilotControl.Throttle;
+  Ar << AutopilotControl.Steer;
+  Ar << AutopilotControl.Brake;
+  Ar << AutopilotControl.bHandBrake;
+  bool bHasRandomEngine = (RandomEngine != nullptr);
+  Ar << bHasRandomEngine;
+  if (bHasRandomEngine) {
+    if (RandomEngine == nullptr) {
+      RandomEngine = NewObject<URandomEngine>(this);
+    }
+    RandomEngine->SerializeState(Ar);
+  }
+  TArray<FVector> Route;
+  if (Ar.IsSaving()) {
+    auto Copy = TargetLocations;
+    for (; !Copy.empty(); Copy.pop()) {
+      Route.Add(Copy.front());
+    }
+  }
+  Ar << Route;
+  if (Ar.IsLoading() && !Ar.IsError()) {
+    const FAutopilotControl Control = AutopilotControl;
+    if (bEnabled != bAutopilotEnabled) {
+      // Resets the rest of the state, overwritten below.
+      ConfigureAutopilot(bEnabled);
+    }
+    AutopilotControl = Control;
+    TrafficLightState = static_cast<ETrafficLightState>(LightState);
+    decltype(TargetLocations) EmptyQueue;
+    TargetLocations.swap(EmptyQueue);
+    SetFixedRoute(Route);
+    for (auto &Trace : ObstacleTraces) {
+      Trace = FTraceHandle();
+    }
+    if (bAutopilotEnabled) {
+      Vehicle->SetThrottleInput(AutopilotControl.Throttle);
+      Vehicle->SetSteeringInput(AutopilotControl.Steer);
+      Vehicle->SetBrakeInput(AutopilotControl.Brake);
+    }
+  }
+}
+
 // =============================================================================
 // -- Traffic ------------------------------------------------------------------
 // =============================================================================
@@ -137,12 +195,45 @@ void AWheeledVehicleAIController::SetFixedRoute(const TArray<FVector> &Locations
   }
 }
 
+bool AWheeledVehicleAIController::SetRouteTo(const FVector &Destination)
+{
+  if ((LaneGraph == nullptr) || !LaneGraph->IsValid() || !IsPossessingAVehicle()) {
+    return false;
+  }
+  TArray<FVector> Waypoints;
+  if (!LaneGraph->GetRouteWaypoints(
+          Vehicle->GetActorLocation(),
+          Vehicle->GetVehicleOrientation(),
+          Destination,
+          Waypoints)) {
+    return false;
+  }
+  decltype(TargetLocations) EmptyQueue;
+  TargetLocations.swap(EmptyQueue);
+  SetFixedRoute(Waypoints);
+  return true;
+}
+
+bool AWheeledVehicleAIController::GetNextTargetLocation(const FVector &Location, FVector &Target)
+{
+  while (!TargetLocations.empty()) {
+    const auto &Next = TargetLocations.front();
+    Target = FVector{Next.X, Next.Y, Location.Z};
+    if (!Target.Equals(Location, 80.0f)) {
+      return true;
+    }
+    TargetLocations.pop();
+  }
+  return false;
+}
+
 // =============================================================================
 // -- AI -----------------------------------------------------------------------
 // =============================================================================
 
 void AWheeledVehicleAIController::TickAutopilotController()
 {
+  SCOPE_CYCLE_COUNTER(STAT_CarlaVehicleAutopilot);
 #if WITH_EDITOR
   if (Vehicle == nullptr) { // This happens in simulation mode in editor.
     bAutopilotEnabled = false;
@@ -157,58 +248,157 @@ void AWheeledVehicleAIController::TickAutopilotController()
     return;
   }
 
-  FVector Direction;
+  const FVector Location = Vehicle->GetActorLocation();
+  const FVector Forward = Vehicle->GetActorForwardVector();
+
+  FVector Direction = Forward;
 
   float Steering;
-  if (!TargetLocations.empty()) {
-    Steering = GoToNextTargetLocation(Direction);
+  FVector Target;
+  if (GetNextTargetLocation(Location, Target)) {
+    Steering = CalcSteeringToTarget(Location, Forward, Target, MaximumSteerAngle, Direction);
+    Vehicle->SetAIVehicleState(ECarlaWheeledVehicleState::FollowingFixedRoute);
   } else {
-    Steering = CalcStreeringValue(Direction);
+    Steering = CalcSteeringOnRoad(
+        *RoadMap,
+        Location,
+        Forward,
+        Vehicle->GetVehicleBoundsExtent(),
+        MaximumSteerAngle,
+        Direction);
+    Vehicle->SetAIVehicleState(ECarlaWheeledVehicleState::FreeDriving);
   }
 
   const auto Speed = Vehicle->GetVehicleForwardSpeed();
 
-  float Throttle;
+  bool bStop = true;
   if (TrafficLightState != ETrafficLightState::Green) {
     Vehicle->SetAIVehicleState(ECarlaWheeledVehicleState::WaitingForRedLight);
-    Throttle = Stop(Speed);
-  } else if (IsThereAnObstacleAhead(*Vehicle, Speed, Direction)) {
+  } else if (IsThereAnObstacleAhead(Speed, Direction)) {
     Vehicle->SetAIVehicleState(ECarlaWheeledVehicleState::ObstacleAhead);
-    Throttle = Stop(Speed);
   } else {
-    Throttle = Move(Speed);
+    bStop = false;
   }
 
-  if (Throttle < 0.001f) {
-    AutopilotControl.Brake = 1.0f;
-    AutopilotControl.Throttle = 0.0f;
-  } else {
-    AutopilotControl.Brake = 0.0f;
-    AutopilotControl.Throttle = Throttle;
-  }
+  CalcThrottleAndBrake(Speed, SpeedLimit, bStop, AutopilotControl.Throttle, AutopilotControl.Brake);
   AutopilotControl.Steer = Steering;
 }
 
-float AWheeledVehicleAIController::GoToNextTargetLocation(FVector &Direction)
+bool AWheeledVehicleAIController::IsThereAnObstacleAhead(const float Speed, const FVector &Direction)
 {
-  const auto &CurrentLocation = Vehicle->GetActorLocation();
-  const auto Target = [&](){
-    const auto &Result = TargetLocations.front();
-    return FVector{Result.X, Result.Y, CurrentLocation.Z};
-  }();
+  // Most obstacles are agents whose location is known already, the probes
+  // remain for the rest.
+  auto *GameState = GetWorld()->GetGameState<ACarlaGameState>();
+  if (GameState != nullptr) {
+    float MinDistance;
+    float MaxDistance;
+    float HalfWidth;
+    GetObstacleCorridor(Vehicle->GetVehicleBoundsExtent(), Speed, MinDistance, MaxDistance, HalfWidth);
+    const int32 Lead = GameState->GetObstacleGrid().FindLeadAgent(
+        Vehicle->GetActorLocation(),
+        Direction,
+        MinDistance,
+        MaxDistance,
+        HalfWidth);
+    if (Lead != INDEX_NONE) {
+      return true;
+    }
+  }
 
-  if (Target.Equals(CurrentLocation, 80.0f)) {
-    TargetLocations.pop();
-    if (!TargetLocations.empty()) {
-      return GoToNextTargetLocation(Direction);
-    } else {
-      return CalcStreeringValue(Direction);
+  FVector Start[NumberOfObstacleProbes];
+  FVector End[NumberOfObstacleProbes];
+  GetObstacleProbes(
+      Vehicle->GetActorLocation(),
+      Vehicle->GetVehicleOrientation(),
+      Vehicle->GetVehicleBoundsExtent(),
+      Speed,
+      Direction,
+      Start,
+      End);
+
+  if (!bAsyncObstacleTraces) {
+    return
+        RayTrace(*Vehicle, Start[0], End[0]) ||
+        RayTrace(*Vehicle, Start[1], End[1]) ||
+        RayTrace(*Vehicle, Start[2], End[2]);
+  }
+
+  // The world runs the async traces of every vehicle in one batch, off the
+  // game thread, and their results are ready the next frame. Read the ones
+  // submitted the previous tick and submit the current ones.
+  auto *World = GetWorld();
+  check(World != nullptr);
+  bool bObstacleAhead = false;
+  for (auto i = 0u; i < NumberOfObstacleProbes; ++i) {
+    FTraceDatum Datum;
+    if (World->QueryTraceData(ObstacleTraces[i], Datum)) {
+      for (const auto &Hit : Datum.OutHits) {
+        bObstacleAhead |= Hit.bBlockingHit;
+      }
     }
   }
+  const FCollisionObjectQueryParams ObjectParams(FCollisionObjectQueryParams::AllDynamicObjects);
+  const FCollisionQueryParams CollisionParams = GetObstacleQueryParams(*Vehicle);
+  for (auto i = 0u; i < NumberOfObstacleProbes; ++i) {
+    ObstacleTraces[i] = World->AsyncLineTraceByObjectType(
+        EAsyncTraceType::Single,
+        Start[i],
+        End[i],
+        ObjectParams,
+        CollisionParams);
+  }
+  return bObstacleAhead;
+}
 
-  Direction = (Target - CurrentLocation).GetSafeNormal();
+// =============================================================================
+// -- Autopilot computation ----------------------------------------------------
+// =============================================================================
 
-  const FVector &Forward = GetPawn()->GetActorForwardVector();
+void AWheeledVehicleAIController::GetObstacleProbes(
+    const FVector &Location,
+    const FVector &Orientation,
+    const FVector &BoundsExtent,
+    const float Speed,
+    const FVector &Direction,
+    FVector (&Start)[NumberOfObstacleProbes],
+    FVector (&End)[NumberOfObstacleProbes])
+{
+  const float Distance = std::max(50.0f, Speed * Speed); // why?
+
+  Start[0] = Location + (Orientation * (250.0f + BoundsExtent.X / 2.0f)) + FVector(0.0f, 0.0f, 50.0f);
+  Start[1] = Start[0] + (FVector(Orientation.Y, -Orientation.X, Orientation.Z) * 100.0f);
+  Start[2] = Start[0] + (FVector(-Orientation.Y, Orientation.X, Orientation.Z) * 100.0f);
+
+  for (auto i = 0u; i < NumberOfObstacleProbes; ++i) {
+    End[i] = Start[i] + Direction * (Distance + BoundsExtent.X / 2.0f);
+  }
+}
+
+void AWheeledVehicleAIController::GetObstacleCorridor(
+    const FVector &BoundsExtent,
+    const float Speed,
+    float &MinDistance,
+    float &MaxDistance,
+    float &HalfWidth)
+{
+  // Half the length and the width of a car.
+  constexpr float AgentHalfLength = 200.0f;
+  constexpr float AgentHalfWidth = 100.0f;
+  // Same stretch as the probes, see GetObstacleProbes.
+  const float Distance = std::max(50.0f, Speed * Speed);
+  MinDistance = BoundsExtent.X;
+  MaxDistance = 250.0f + BoundsExtent.X + Distance + AgentHalfLength;
+  HalfWidth = 100.0f + AgentHalfWidth;
+}
+
+float AWheeledVehicleAIController::CalcSteeringToTarget(
+    const FVector &Location,
+    const FVector &Forward,
+    const FVector &Target,
+    const float MaximumSteerAngle,
+    FVector &Direction)
+{
+  Direction = (Target - Location).GetSafeNormal();
 
   float dirAngle = Direction.UnitCartesianToSpherical().Y;
   float actorAngle = Forward.UnitCartesianToSpherical().Y;
@@ -231,15 +421,19 @@ float AWheeledVehicleAIController::GoToNextTargetLocation(FVector &Direction)
     Steering += angle / MaximumSteerAngle;
   }
 
-  Vehicle->SetAIVehicleState(ECarlaWheeledVehicleState::FollowingFixedRoute);
   return Steering;
 }
 
-float AWheeledVehicleAIController::CalcStreeringValue(FVector &direction)
+float AWheeledVehicleAIController::CalcSteeringOnRoad(
+    const URoadMap &RoadMap,
+    const FVector &Location,
+    const FVector &Forward,
+    const FVector &BoxExtent,
+    const float MaximumSteerAngle,
+    FVector &direction)
 {
   float steering = 0;
-  FVector BoxExtent = Vehicle->GetVehicleBoundsExtent();
-  FVector forward = Vehicle->GetActorForwardVector();
+  FVector forward = Forward;
 
   FVector rightSensorPosition(BoxExtent.X / 2.0f, (BoxExtent.Y / 2.0f) + 100.0f, 0.0f);
   FVector leftSensorPosition(BoxExtent.X / 2.0f, -(BoxExtent.Y / 2.0f) - 100.0f, 0.0f);
@@ -265,29 +459,33 @@ float AWheeledVehicleAIController::CalcStreeringValue(FVector &direction)
   leftSensorPosition.Y = sinL * Magnitude;
   leftSensorPosition.X = cosL * Magnitude;
 
-  FVector rightPositon = GetPawn()->GetActorLocation() + FVector(rightSensorPosition.X, rightSensorPosition.Y, 0.0f);
-  FVector leftPosition = GetPawn()->GetActorLocation() + FVector(leftSensorPosition.X, leftSensorPosition.Y, 0.0f);
+  FVector rightPositon = Location + FVector(rightSensorPosition.X, rightSensorPosition.Y, 0.0f);
+  FVector leftPosition = Location + FVector(leftSensorPosition.X, leftSensorPosition.Y, 0.0f);
+
+  const FVector SensorPositions[] = {Location, rightPositon, leftPosition};
+  FRoadMapPixelData SensorData[ARRAY_COUNT(SensorPositions)];
+  RoadMap.GetDataAt(MakeArrayView(SensorPositions), MakeArrayView(SensorData));
+  const FRoadMapPixelData &roadData = SensorData[0];
+  const FRoadMapPixelData &rightRoadData = SensorData[1];
+  const FRoadMapPixelData &leftRoadData = SensorData[2];
 
-  FRoadMapPixelData rightRoadData = RoadMap->GetDataAt(rightPositon);
   if (!rightRoadData.IsRoad()) { steering -= 0.2f;}
 
-  FRoadMapPixelData leftRoadData = RoadMap->GetDataAt(leftPosition);
   if (!leftRoadData.IsRoad()) { steering += 0.2f;}
 
-  FRoadMapPixelData roadData = RoadMap->GetDataAt(GetPawn()->GetActorLocation());
   if (!roadData.IsRoad()) {
     steering = -1;
   } else if (roadData.HasDirection()) {
 
     direction = roadData.GetDirection();
-    FVector right = rightRoadData.GetDirection();
-    FVector left = leftRoadData.GetDirection();
 
     forward.Z = 0.0f;
 
-    float dirAngle = direction.UnitCartesianToSpherical().Y;
-    float rightAngle = right.UnitCartesianToSpherical().Y;
-    float leftAngle = left.UnitCartesianToSpherical().Y;
+    // The angles are already encoded in the map, no need to recover them from
+    // the directions.
+    float dirAngle = roadData.GetDirectionAzimuthalAngle();
+    float rightAngle = rightRoadData.GetDirectionAzimuthalAngle();
+    float leftAngle = leftRoadData.GetDirectionAzimuthalAngle();
 
     dirAngle *= (180.0f / PI);
     rightAngle *= (180.0 / PI);
@@ -323,17 +521,32 @@ float AWheeledVehicleAIController::CalcStreeringValue(FVector &direction)
     }
   }
 
-  Vehicle->SetAIVehicleState(ECarlaWheeledVehicleState::FreeDriving);
   return steering;
 }
 
-float AWheeledVehicleAIController::Stop(const float Speed) {
+void AWheeledVehicleAIController::CalcThrottleAndBrake(
+    const float Speed,
+    const float SpeedLimit,
+    const bool bStop,
+    float &Throttle,
+    float &Brake)
+{
+  Throttle = (bStop ? Stop(Speed, SpeedLimit) : Move(Speed, SpeedLimit));
+  if (Throttle < 0.001f) {
+    Brake = 1.0f;
+    Throttle = 0.0f;
+  } else {
+    Brake = 0.0f;
+  }
+}
+
+float AWheeledVehicleAIController::Stop(const float Speed, const float SpeedLimit) {
   return (Speed >= 1.0f ? -Speed / SpeedLimit : 0.0f);
 }
 
-float AWheeledVehicleAIController::Move(const float Speed) {
+float AWheeledVehicleAIController::Move(const float Speed, const float SpeedLimit) {
   if (Speed >= SpeedLimit) {
-    return Stop(Speed);
+    return Stop(Speed, SpeedLimit);
   } else if (Speed >= SpeedLimit - 10.0f) {
     return 0.5f;
   } else {
@@ -10,9 +10,12 @@
 
 #include "GameFramework/PlayerController.h"
 #include "TrafficLightState.h"
+#include "WorldCollision.h"
 #include "WheeledVehicleAIController.generated.h"
 
 class ACarlaWheeledVehicle;
+class ATrafficManager;
+class ULaneGraph;
 class URandomEngine;
 class URoadMap;
 
@@ -43,6 +46,8 @@ public:
 
   virtual void Tick(float DeltaTime) override;
 
+  virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
   /// @}
   // ===========================================================================
   /// @name Possessed vehicle
@@ -91,6 +96,36 @@ public:
     return RoadMap;
   }
 
+  const URoadMap *GetRoadMap() const
+  {
+    return RoadMap;
+  }
+
+  void SetLaneGraph(ULaneGraph *InLaneGraph)
+  {
+    LaneGraph = InLaneGraph;
+  }
+
+  const ULaneGraph *GetLaneGraph() const
+  {
+    return LaneGraph;
+  }
+
+  /// @}
+  // ===========================================================================
+  /// @name Traffic manager
+  // ===========================================================================
+  /// @{
+public:
+
+  /// If set, the autopilot of this controller is updated by @a InTrafficManager
+  /// along with the rest of vehicles instead of by this controller's tick. The
+  /// player's controller always ticks its own autopilot.
+  void SetTrafficManager(ATrafficManager *InTrafficManager)
+  {
+    TrafficManager = InTrafficManager;
+  }
+
   /// @}
   // ===========================================================================
   /// @name Random engine
@@ -136,6 +171,11 @@ public:
     ConfigureAutopilot(!bAutopilotEnabled);
   }
 
+  /// Save or restore the autopilot state: whether it is enabled, the speed
+  /// limit and traffic light state, the last control computed and the fixed
+  /// route. Obstacle traces in flight are dropped on restore.
+  void SerializeAutopilotState(FArchive &Ar);
+
 private:
 
   void ConfigureAutopilot(bool Enable);
@@ -179,6 +219,16 @@ public:
   UFUNCTION(Category = "Wheeled Vehicle Controller", BlueprintCallable)
   void SetFixedRoute(const TArray<FVector> &Locations);
 
+  /// Set a fixed route along the lane centers to @a Destination. Returns
+  /// false if there is no lane graph or no route was found.
+  UFUNCTION(Category = "Wheeled Vehicle Controller", BlueprintCallable)
+  bool SetRouteTo(const FVector &Destination);
+
+  /// Drop the locations of the fixed route already reached from @a Location.
+  /// Returns false if there is no fixed route left to follow, otherwise the
+  /// next location is copied into @a Target.
+  bool GetNextTargetLocation(const FVector &Location, FVector &Target);
+
   /// @}
   // ===========================================================================
   /// @name AI
@@ -202,17 +252,74 @@ private:
 
   void TickAutopilotController();
 
-  /// Returns steering value.
-  float GoToNextTargetLocation(FVector &Direction);
+  /// Whether an agent or the player is in the corridor ahead of the vehicle,
+  /// see ACarlaGameState::GetObstacleGrid, otherwise whether the probes in
+  /// front of the vehicle hit something. With async traces the answer of the
+  /// probes is one frame late.
+  bool IsThereAnObstacleAhead(float Speed, const FVector &Direction);
+
+  /// @}
+  // ===========================================================================
+  /// @name Autopilot computation
+  // ===========================================================================
+  /// Stateless steps of the autopilot, shared with ATrafficManager. They do
+  /// not touch any actor so they can run outside the game thread.
+  /// @{
+public:
 
-  /// Returns steering value.
-  float CalcStreeringValue(FVector &Direction);
+  static constexpr uint32 NumberOfObstacleProbes = 3u;
+
+  /// Center, right and left rays in front of the vehicle.
+  static void GetObstacleProbes(
+      const FVector &Location,
+      const FVector &Orientation,
+      const FVector &BoundsExtent,
+      float Speed,
+      const FVector &Direction,
+      FVector (&Start)[NumberOfObstacleProbes],
+      FVector (&End)[NumberOfObstacleProbes]);
+
+  /// The corridor ahead of the vehicle the probes cover, as distances along
+  /// the direction of the vehicle and half its width. Grown by the size of a
+  /// car, as the agents in it are found by their center.
+  static void GetObstacleCorridor(
+      const FVector &BoundsExtent,
+      float Speed,
+      float &MinDistance,
+      float &MaxDistance,
+      float &HalfWidth);
+
+  /// Returns steering value towards @a Target.
+  static float CalcSteeringToTarget(
+      const FVector &Location,
+      const FVector &Forward,
+      const FVector &Target,
+      float MaximumSteerAngle,
+      FVector &Direction);
+
+  /// Returns steering value to follow the lane in @a RoadMap.
+  static float CalcSteeringOnRoad(
+      const URoadMap &RoadMap,
+      const FVector &Location,
+      const FVector &Forward,
+      const FVector &BoundsExtent,
+      float MaximumSteerAngle,
+      FVector &Direction);
+
+  /// Throttle and brake values to keep the speed under @a SpeedLimit, or to
+  /// stop the vehicle if @a bStop.
+  static void CalcThrottleAndBrake(
+      float Speed,
+      float SpeedLimit,
+      bool bStop,
+      float &Throttle,
+      float &Brake);
 
   /// Returns throttle value.
-  float Stop(float Speed);
+  static float Stop(float Speed, float SpeedLimit);
 
   /// Returns throttle value.
-  float Move(float Speed);
+  static float Move(float Speed, float SpeedLimit);
 
   /// @}
   // ===========================================================================
@@ -226,9 +333,15 @@ private:
   UPROPERTY()
   URoadMap *RoadMap;
 
+  UPROPERTY()
+  ULaneGraph *LaneGraph = nullptr;
+
   UPROPERTY()
   URandomEngine *RandomEngine;
 
+  UPROPERTY()
+  ATrafficManager *TrafficManager = nullptr;
+
   UPROPERTY(VisibleAnywhere)
   bool bAutopilotEnabled = false;
 
@@ -241,6 +354,14 @@ private:
   UPROPERTY(VisibleAnywhere)
   float MaximumSteerAngle = -1.0f;
 
+  /** If true, the obstacle probes are traced asynchronously, batched with
+    * the rest of vehicles, and their results are used on the next tick.
+    */
+  UPROPERTY(Category = "Wheeled Vehicle Controller", EditAnywhere)
+  bool bAsyncObstacleTraces = true;
+
+  FTraceHandle ObstacleTraces[NumberOfObstacleProbes];
+
   FAutopilotControl AutopilotControl;
 
   std::queue<FVector> TargetLocations;
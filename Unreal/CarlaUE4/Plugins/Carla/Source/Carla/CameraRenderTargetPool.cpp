@@ -0,0 +1,77 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "CameraRenderTargetPool.h"
+
+#include "Engine/TextureRenderTarget2D.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Camera Render Targets Reused"), STAT_CarlaCameraRenderTargetsReused, STATGROUP_Carla);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Camera Render Targets Created"), STAT_CarlaCameraRenderTargetsCreated, STATGROUP_Carla);
+
+static bool IsInitializedWith(
+    const UTextureRenderTarget2D &RenderTarget,
+    const uint32 SizeX,
+    const uint32 SizeY,
+    const EPixelFormat PixelFormat,
+    const bool bForceLinearGamma)
+{
+  return
+      (RenderTarget.SizeX == static_cast<int32>(SizeX)) &&
+      (RenderTarget.SizeY == static_cast<int32>(SizeY)) &&
+      (RenderTarget.OverrideFormat == PixelFormat) &&
+      (RenderTarget.bForceLinearGamma == bForceLinearGamma);
+}
+
+void UCameraRenderTargetPool::SetCapacity(const uint32 InCapacity)
+{
+  Capacity = InCapacity;
+  Trim(Capacity);
+}
+
+UTextureRenderTarget2D *UCameraRenderTargetPool::Acquire(
+    const uint32 SizeX,
+    const uint32 SizeY,
+    const EPixelFormat PixelFormat,
+    const bool bForceLinearGamma)
+{
+  // The most recent first, the likeliest to have the same setup.
+  for (auto i = FreeRenderTargets.Num() - 1; i >= 0; --i) {
+    auto *RenderTarget = FreeRenderTargets[i];
+    if ((RenderTarget != nullptr) &&
+        IsInitializedWith(*RenderTarget, SizeX, SizeY, PixelFormat, bForceLinearGamma)) {
+      FreeRenderTargets.RemoveAt(i);
+      INC_DWORD_STAT(STAT_CarlaCameraRenderTargetsReused);
+      UE_LOG(LogCarla, Log, TEXT("Reusing a %dx%d camera render target"), SizeX, SizeY);
+      return RenderTarget;
+    }
+  }
+  auto *RenderTarget = NewObject<UTextureRenderTarget2D>(this);
+  check(RenderTarget != nullptr);
+  RenderTarget->InitCustomFormat(SizeX, SizeY, PixelFormat, bForceLinearGamma);
+  INC_DWORD_STAT(STAT_CarlaCameraRenderTargetsCreated);
+  return RenderTarget;
+}
+
+void UCameraRenderTargetPool::Release(UTextureRenderTarget2D *RenderTarget)
+{
+  if ((RenderTarget == nullptr) || (Capacity == 0u)) {
+    return;
+  }
+  // Room for it first, so the one released is always kept.
+  Trim(Capacity - 1u);
+  FreeRenderTargets.AddUnique(RenderTarget);
+}
+
+void UCameraRenderTargetPool::Trim(const uint32 MaxFreeRenderTargets)
+{
+  const int32 Excess = FreeRenderTargets.Num() - static_cast<int32>(MaxFreeRenderTargets);
+  if (Excess > 0) {
+    // Dropped from the pool, their resource goes with them when garbage
+    // collected.
+    FreeRenderTargets.RemoveAt(0, Excess);
+  }
+}
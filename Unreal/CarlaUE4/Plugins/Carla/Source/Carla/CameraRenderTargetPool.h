@@ -0,0 +1,60 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "UObject/Object.h"
+#include "PixelFormat.h"
+#include "CameraRenderTargetPool.generated.h"
+
+class UTextureRenderTarget2D;
+
+/// Render targets of the scene capture cameras kept alive in between levels,
+/// see UCarlaSettings::CameraRenderTargetPoolSize.
+///
+/// The camera actors go with the level, but their render targets are handed
+/// back here when they end play. A camera of the next level with the same
+/// size, pixel format and gamma, the ones its post-process effect decides,
+/// takes one of them instead of allocating its GPU resource again. Owned by
+/// the game instance.
+UCLASS()
+class CARLA_API UCameraRenderTargetPool : public UObject
+{
+  GENERATED_BODY()
+
+public:
+
+  /// Render targets kept while unused, the oldest are released above it.
+  /// Zero disables the pool.
+  void SetCapacity(uint32 Capacity);
+
+  /// A free render target initialized with these parameters if any, or a new
+  /// one. Render targets from the pool are not initialized again, their
+  /// resource is reused as is.
+  UTextureRenderTarget2D *Acquire(
+      uint32 SizeX,
+      uint32 SizeY,
+      EPixelFormat PixelFormat,
+      bool bForceLinearGamma);
+
+  /// Hand back a render target of Acquire that nobody renders to anymore.
+  void Release(UTextureRenderTarget2D *RenderTarget);
+
+  uint32 GetNumberOfFreeRenderTargets() const
+  {
+    return FreeRenderTargets.Num();
+  }
+
+private:
+
+  void Trim(uint32 MaxFreeRenderTargets);
+
+  uint32 Capacity = 0u;
+
+  /// Oldest first.
+  UPROPERTY()
+  TArray<UTextureRenderTarget2D *> FreeRenderTargets;
+};
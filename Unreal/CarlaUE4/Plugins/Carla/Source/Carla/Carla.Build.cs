@@ -33,7 +33,10 @@ public class Carla : ModuleRules
         "AIModule",
         "CoreUObject",
         "Engine",
+        "ImageWrapper",
         "PhysXVehicles",
+        "RenderCore",
+        "RHI",
         "Slate",
         "SlateCore"
         // ... add private dependencies that you statically link with here ...
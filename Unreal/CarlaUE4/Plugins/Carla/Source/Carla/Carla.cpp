@@ -7,6 +7,13 @@
 DEFINE_LOG_CATEGORY(LogCarla);
 DEFINE_LOG_CATEGORY(LogCarlaServer);
 
+DEFINE_STAT(STAT_CarlaImageMemory);
+DEFINE_STAT(STAT_CarlaAgentInfoMemory);
+DEFINE_STAT(STAT_CarlaRoadMapMemory);
+DEFINE_STAT(STAT_CarlaCapturedImagesMemory);
+DEFINE_STAT(STAT_CarlaRenderTargetsMemory);
+DEFINE_STAT(STAT_CarlaSpawnerPoolsMemory);
+
 void FCarlaModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
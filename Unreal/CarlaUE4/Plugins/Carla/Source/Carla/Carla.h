@@ -5,12 +5,22 @@
 #pragma once
 
 #include "ModuleManager.h"
+#include "Stats/Stats.h"
 
 #include "Util/NonCopyable.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogCarla, Log, All);
 DECLARE_LOG_CATEGORY_EXTERN(LogCarlaServer, Log, All);
 
+// Stats shown with "stat Carla", cycle counters are declared where used.
+DECLARE_STATS_GROUP(TEXT("Carla"), STATGROUP_Carla, STATCAT_Advanced);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Image Buffers"), STAT_CarlaImageMemory, STATGROUP_Carla, CARLA_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Agent Info"), STAT_CarlaAgentInfoMemory, STATGROUP_Carla, CARLA_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Road Map"), STAT_CarlaRoadMapMemory, STATGROUP_Carla, CARLA_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Captured Images"), STAT_CarlaCapturedImagesMemory, STATGROUP_Carla, CARLA_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Render Targets"), STAT_CarlaRenderTargetsMemory, STATGROUP_Carla, CARLA_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Spawner Pools"), STAT_CarlaSpawnerPoolsMemory, STATGROUP_Carla, CARLA_API);
+
 // Options to compile with extra debug log.
 #if WITH_EDITOR
 // #define CARLA_AI_VEHICLES_EXTRA_LOG
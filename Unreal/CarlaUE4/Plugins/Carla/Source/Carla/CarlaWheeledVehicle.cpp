@@ -27,6 +27,16 @@ ACarlaWheeledVehicle::ACarlaWheeledVehicle(const FObjectInitializer& ObjectIniti
 
 ACarlaWheeledVehicle::~ACarlaWheeledVehicle() {}
 
+// =============================================================================
+// -- AActor -------------------------------------------------------------------
+// =============================================================================
+
+void ACarlaWheeledVehicle::BeginPlay()
+{
+  Super::BeginPlay();
+  OnActorHit.AddDynamic(this, &ACarlaWheeledVehicle::OnHitWhileResting);
+}
+
 // =============================================================================
 // -- Get functions ------------------------------------------------------------
 // =============================================================================
@@ -93,3 +103,87 @@ void ACarlaWheeledVehicle::SetHandbrakeInput(const bool Value)
 {
   GetVehicleMovementComponent()->SetHandbrakeInput(Value);
 }
+
+// =============================================================================
+// -- Resting ------------------------------------------------------------------
+// =============================================================================
+
+/// Below this speed in km/h the vehicle is considered stopped.
+static constexpr float REST_SPEED = 0.5f;
+
+/// Seconds stopped with the brake pressed before resting, so the vehicles
+/// creeping in a queue do not switch back and forth.
+static constexpr float REST_DELAY = 1.0f;
+
+void ACarlaWheeledVehicle::ApplyAutopilotControl(
+    const float Throttle,
+    const float Steer,
+    const float Brake)
+{
+  if (bIsResting) {
+    auto *RootPrimitive = Cast<UPrimitiveComponent>(GetRootComponent());
+    const bool bSimulatedMeanwhile = (RootPrimitive != nullptr) && RootPrimitive->IsSimulatingPhysics();
+    if (bSimulatedMeanwhile) {
+      // Unparked or restored from a snapshot, it is not resting anymore.
+      bIsResting = false;
+    } else if ((Throttle > 0.0f) || !bRestWhenStopped) {
+      StopResting();
+    } else {
+      return;
+    }
+  }
+  SetThrottleInput(Throttle);
+  SetSteeringInput(Steer);
+  SetBrakeInput(Brake);
+  const bool bStoppedBraking =
+      bRestWhenStopped &&
+      (Throttle <= 0.0f) &&
+      (Brake > 0.0f) &&
+      (FMath::Abs(GetVehicleForwardSpeed()) < REST_SPEED);
+  if (!bStoppedBraking) {
+    StoppedSince = -1.0f;
+    return;
+  }
+  const float Now = GetWorld()->GetTimeSeconds();
+  if (StoppedSince < 0.0f) {
+    StoppedSince = Now;
+  } else if (Now - StoppedSince >= REST_DELAY) {
+    StartResting();
+  }
+}
+
+void ACarlaWheeledVehicle::StartResting()
+{
+  auto *RootPrimitive = Cast<UPrimitiveComponent>(GetRootComponent());
+  if ((RootPrimitive == nullptr) || !RootPrimitive->IsSimulatingPhysics()) {
+    return;
+  }
+  // Kinematic bodies keep blocking the rest, but are neither moved by the
+  // scene nor updated by the vehicle simulation.
+  RootPrimitive->SetPhysicsLinearVelocity(FVector::ZeroVector);
+  RootPrimitive->SetPhysicsAngularVelocity(FVector::ZeroVector);
+  RootPrimitive->SetSimulatePhysics(false);
+  bIsResting = true;
+  StoppedSince = -1.0f;
+}
+
+void ACarlaWheeledVehicle::StopResting()
+{
+  if (!bIsResting) {
+    return;
+  }
+  bIsResting = false;
+  auto *RootPrimitive = Cast<UPrimitiveComponent>(GetRootComponent());
+  if ((RootPrimitive != nullptr) && !RootPrimitive->IsSimulatingPhysics()) {
+    RootPrimitive->SetSimulatePhysics(true);
+  }
+}
+
+void ACarlaWheeledVehicle::OnHitWhileResting(
+    AActor * /*Actor*/,
+    AActor * /*OtherActor*/,
+    FVector /*NormalImpulse*/,
+    const FHitResult & /*Hit*/)
+{
+  StopResting();
+}
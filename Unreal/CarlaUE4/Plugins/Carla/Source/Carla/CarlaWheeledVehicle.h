@@ -29,6 +29,15 @@ public:
 
   ~ACarlaWheeledVehicle();
 
+  /// @}
+  // ===========================================================================
+  /// @name AActor overrides
+  // ===========================================================================
+  /// @{
+protected:
+
+  virtual void BeginPlay() override;
+
   /// @}
   // ===========================================================================
   /// @name Get functions
@@ -56,6 +65,12 @@ public:
   UFUNCTION(Category = "CARLA Wheeled Vehicle", BlueprintCallable)
   float GetMaximumSteerAngle() const;
 
+  UFUNCTION(Category = "CARLA Wheeled Vehicle", BlueprintCallable)
+  bool IsInReverse() const
+  {
+    return bIsInReverse;
+  }
+
   /// @}
   // ===========================================================================
   /// @name Set functions
@@ -101,6 +116,48 @@ public:
     State = InState;
   }
 
+  /// @}
+  // ===========================================================================
+  /// @name Resting
+  // ===========================================================================
+  /// A vehicle standing still with the brake pressed for a moment, e.g. at a
+  /// red light, rests: its body turns kinematic so the physics scene skips its
+  /// wheels and suspension. It simulates again on the first throttle or when
+  /// something hits it. See UCarlaSettings::bRestStoppedVehicles.
+  /// @{
+public:
+
+  /// Whether the vehicle may rest, the non-player vehicles only.
+  void SetRestWhenStopped(bool bEnabled)
+  {
+    bRestWhenStopped = bEnabled;
+  }
+
+  bool IsResting() const
+  {
+    return bIsResting;
+  }
+
+  /// Apply the control of the autopilot, resting or waking up as needed.
+  /// While resting the inputs are not applied, the vehicle is held in place.
+  void ApplyAutopilotControl(float Throttle, float Steer, float Brake);
+
+  /// Simulate the body again if resting.
+  void StopResting();
+
+private:
+
+  void StartResting();
+
+  UFUNCTION()
+  void OnHitWhileResting(
+      AActor *Actor,
+      AActor *OtherActor,
+      FVector NormalImpulse,
+      const FHitResult &Hit);
+
+  /// @}
+
 private:
 
   /// Current state of the vehicle controller (for debugging purposes).
@@ -112,4 +169,12 @@ private:
 
   UPROPERTY()
   bool bIsInReverse = false;
+
+  bool bRestWhenStopped = false;
+
+  bool bIsResting = false;
+
+  /// Game time since the vehicle stands still with the brake pressed,
+  /// negative if it does not.
+  float StoppedSince = -1.0f;
 };
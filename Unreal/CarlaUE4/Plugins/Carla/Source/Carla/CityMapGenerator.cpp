@@ -8,11 +8,15 @@
 #include "CityMapGenerator.h"
 
 #include "MapGen/GraphGenerator.h"
+#include "MapGen/LaneGraph.h"
 #include "MapGen/RoadMap.h"
 #include "Tagger.h"
 
+#include "Async/ParallelFor.h"
 #include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
 #include "Engine/World.h"
+#include "Misc/ScopedSlowTask.h"
 #include "Paths.h"
 
 #include <algorithm>
@@ -29,6 +33,7 @@ ACityMapGenerator::ACityMapGenerator(const FObjectInitializer& ObjectInitializer
   : Super(ObjectInitializer)
 {
   RoadMap = ObjectInitializer.CreateDefaultSubobject<URoadMap>(this, TEXT("RoadMap"));
+  LaneGraph = ObjectInitializer.CreateDefaultSubobject<ULaneGraph>(this, TEXT("LaneGraph"));
 }
 
 ACityMapGenerator::~ACityMapGenerator() {}
@@ -43,7 +48,7 @@ void ACityMapGenerator::PreSave(const ITargetPlatform *TargetPlatform)
   if (bGenerateRoadMapOnSave) {
     // Generate road map only if we are not cooking.
     FCoreUObjectDelegates::OnObjectSaved.Broadcast(this);
-    if (!GIsCookerLoadingPackage) {
+    if (!GIsCookerLoadingPackage && (GeneratedRoadMapKey != GetRoadMapKey())) {
       check(RoadMap != nullptr);
       GenerateRoadMap();
     }
@@ -53,6 +58,19 @@ void ACityMapGenerator::PreSave(const ITargetPlatform *TargetPlatform)
   Super::PreSave(TargetPlatform);
 }
 
+#if WITH_EDITOR
+void ACityMapGenerator::PostEditChangeProperty(FPropertyChangedEvent &PropertyChangedEvent)
+{
+  Super::PostEditChangeProperty(PropertyChangedEvent);
+  // If the map was up-to-date it has not been updated, but the road map may
+  // still be requested.
+  if (bTriggerRoadMapGeneration) {
+    bTriggerRoadMapGeneration = false;
+    GenerateRoadMap();
+  }
+}
+#endif // WITH_EDITOR
+
 // =============================================================================
 // -- Overriden from ACityMapMeshHolder ----------------------------------------
 // =============================================================================
@@ -60,16 +78,28 @@ void ACityMapGenerator::PreSave(const ITargetPlatform *TargetPlatform)
 void ACityMapGenerator::UpdateMap()
 {
   UpdateSeeds();
-  GenerateGraph();
+  const uint32 GraphKey = GetGraphKey();
+  if ((Dcel == nullptr) || (GraphKey == 0u) || (GraphKey != GeneratedGraphKey)) {
+    GenerateGraph();
+  } else {
+    UE_LOG(LogCarla, Log, TEXT("Graph up-to-date, only the roads are generated again"));
+  }
   if (bGenerateRoads) {
     GenerateRoads();
   }
+  GeneratedMapKey = GetMapKey();
   if (bTriggerRoadMapGeneration) {
     bTriggerRoadMapGeneration = false;
     GenerateRoadMap();
   }
 }
 
+bool ACityMapGenerator::IsMapUpToDate() const
+{
+  const uint32 Key = GetMapKey();
+  return (Key != 0u) && (Key == GeneratedMapKey);
+}
+
 // =============================================================================
 // -- Map construction and update related methods ------------------------------
 // =============================================================================
@@ -101,6 +131,7 @@ void ACityMapGenerator::GenerateGraph()
       Dcel->CountHalfEdges(),
       Dcel->CountFaces());
   DcelParser = MakeUnique<MapGen::GraphParser>(*Dcel);
+  GeneratedGraphKey = GetGraphKey();
 #ifdef CARLA_ROAD_GENERATOR_EXTRA_LOG
   { // print the results of the parser.
     std::wstringstream sout;
@@ -240,6 +271,11 @@ void ACityMapGenerator::GenerateRoadMap()
   check(GetWorld() != nullptr);
   check(RoadMap != nullptr);
 
+  // The graph is not saved with the level, but it is cheap to generate.
+  if ((Dcel == nullptr) && bUseFixedSeed) {
+    GenerateGraph();
+  }
+
   ATagger::TagActorsInLevel(*GetWorld(), bTagForSemanticSegmentation); // We need the tags.
 
   const float IntersectionSize = CityMapMeshTag::GetRoadIntersectionSize();
@@ -256,34 +292,54 @@ void ACityMapGenerator::GenerateRoadMap()
   const FVector MapOffset(-Offset, -Offset, 0.0f);
   RoadMap->Reset(SizeX, SizeY, 1.0f / CmPerPixel, ActorTransform.Inverse(), MapOffset);
 
-  for (uint32 PixelY = 0u; PixelY < SizeY; ++PixelY) {
-    for (uint32 PixelX = 0u; PixelX < SizeX; ++PixelX) {
-      const float X = static_cast<float>(PixelX) * CmPerPixel - Offset;
-      const float Y = static_cast<float>(PixelY) * CmPerPixel - Offset;
-      const FVector Start = ActorTransform.TransformPosition(FVector(X, Y, 50.0f));
-      const FVector End = ActorTransform.TransformPosition(FVector(X, Y, -50.0f));
-
-      // Do the ray tracing.
-      FHitResult Hit;
-      if (LineTrace(World, Start, End, Hit)) {
-        auto InstancedStaticMeshComponent = Cast<UInstancedStaticMeshComponent>(Hit.Component.Get());
-        if (InstancedStaticMeshComponent == nullptr) {
-          UE_LOG(LogCarla, Error, TEXT("Road component is not UInstancedStaticMeshComponent"));
-        } else {
-          FTransform InstanceTransform;
-          if (!InstancedStaticMeshComponent->GetInstanceTransform(Hit.Item, InstanceTransform, true)) {
-            UE_LOG(LogCarla, Error, TEXT("Failed to get instance's transform"));
+  // Every pixel is traced independently and only writes its own slot of the
+  // road map, so rows are traced in parallel. They are processed in bands to
+  // report the progress in between.
+  const uint32 NumberOfThreads = FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+  const uint32 RowsPerBand = FMath::Max(4u * NumberOfThreads, SizeY / 100u);
+  FScopedSlowTask SlowTask(SizeY, FText::FromString(TEXT("Generating road map...")));
+  SlowTask.MakeDialog();
+
+  for (uint32 BandStart = 0u; BandStart < SizeY; BandStart += RowsPerBand) {
+    const uint32 BandSize = FMath::Min(RowsPerBand, SizeY - BandStart);
+    ParallelFor(BandSize, [&](const int32 Row) {
+      const uint32 PixelY = BandStart + Row;
+      for (uint32 PixelX = 0u; PixelX < SizeX; ++PixelX) {
+        const float X = static_cast<float>(PixelX) * CmPerPixel - Offset;
+        const float Y = static_cast<float>(PixelY) * CmPerPixel - Offset;
+        const FVector Start = ActorTransform.TransformPosition(FVector(X, Y, 50.0f));
+        const FVector End = ActorTransform.TransformPosition(FVector(X, Y, -50.0f));
+
+        // Do the ray tracing.
+        FHitResult Hit;
+        if (LineTrace(World, Start, End, Hit)) {
+          auto InstancedStaticMeshComponent = Cast<UInstancedStaticMeshComponent>(Hit.Component.Get());
+          if (InstancedStaticMeshComponent == nullptr) {
+            UE_LOG(LogCarla, Error, TEXT("Road component is not UInstancedStaticMeshComponent"));
           } else {
-            RoadMap->SetPixelAt(
-                PixelX,
-                PixelY,
-                GetTag(*InstancedStaticMeshComponent->GetStaticMesh()),
-                InstanceTransform,
-                bLeftHandTraffic);
+            FTransform InstanceTransform;
+            if (!InstancedStaticMeshComponent->GetInstanceTransform(Hit.Item, InstanceTransform, true)) {
+              UE_LOG(LogCarla, Error, TEXT("Failed to get instance's transform"));
+            } else {
+              RoadMap->SetPixelAt(
+                  PixelX,
+                  PixelY,
+                  GetTag(*InstancedStaticMeshComponent->GetStaticMesh()),
+                  InstanceTransform,
+                  bLeftHandTraffic);
+            }
           }
         }
       }
-    }
+    });
+    SlowTask.EnterProgressFrame(BandSize);
+  }
+
+  RoadMap->GenerateDistanceField();
+
+  check(LaneGraph != nullptr);
+  if (Dcel != nullptr) {
+    LaneGraph->Build(*Dcel, ActorTransform, GetMapScale(), Margin, *RoadMap, bLeftHandTraffic);
   }
 
 #if WITH_EDITOR
@@ -297,4 +353,56 @@ void ACityMapGenerator::GenerateRoadMap()
 #if WITH_EDITOR
   RoadMap->DrawDebugPixelsToLevel(GetWorld(), !bDrawDebugPixelsToLevel);
 #endif // WITH_EDITOR
+
+  GeneratedRoadMapKey = GetRoadMapKey();
+}
+
+static uint32 GetMeshKey(const UStaticMesh *Mesh)
+{
+  return GetTypeHash(Mesh != nullptr ? Mesh->GetPathName() : FString());
+}
+
+uint32 ACityMapGenerator::GetGraphKey() const
+{
+  if (!bUseFixedSeed) {
+    return 0u;
+  }
+  uint32 Key = GetTypeHash(Seed);
+  Key = HashCombine(Key, GetTypeHash(MapSizeX));
+  Key = HashCombine(Key, GetTypeHash(MapSizeY));
+  // Zero is reserved for "no key".
+  return (Key != 0u ? Key : 1u);
+}
+
+uint32 ACityMapGenerator::GetMapKey() const
+{
+  const uint32 GraphKey = GetGraphKey();
+  if (GraphKey == 0u) {
+    return 0u;
+  }
+  uint32 Key = HashCombine(GraphKey, GetTypeHash(static_cast<uint32>(bGenerateRoads)));
+  Key = HashCombine(Key, GetTypeHash(GetStreamingCellSize()));
+  // The map scale is taken from the base mesh, the other meshes are swapped
+  // without touching the instances.
+  Key = HashCombine(Key, GetMeshKey(GetStaticMesh(CityMapMeshTag::GetBaseMeshTag())));
+  return (Key != 0u ? Key : 1u);
+}
+
+uint32 ACityMapGenerator::GetRoadMapKey() const
+{
+  const uint32 MapKey = GetMapKey();
+  if (MapKey == 0u) {
+    return 0u;
+  }
+  const FTransform &ActorTransform = GetActorTransform();
+  uint32 Key = MapKey;
+  for (uint8 i = 0u; i < CityMapMeshTag::GetNumberOfTags(); ++i) {
+    Key = HashCombine(Key, GetMeshKey(GetStaticMesh(CityMapMeshTag::FromUInt(i))));
+  }
+  Key = HashCombine(Key, GetTypeHash(PixelsPerMapUnit));
+  Key = HashCombine(Key, GetTypeHash(static_cast<uint32>(bLeftHandTraffic)));
+  Key = HashCombine(Key, GetTypeHash(ActorTransform.GetLocation()));
+  Key = HashCombine(Key, GetTypeHash(ActorTransform.GetRotation().Euler()));
+  Key = HashCombine(Key, GetTypeHash(ActorTransform.GetScale3D()));
+  return (Key != 0u ? Key : 1u);
 }
@@ -11,6 +11,7 @@
 #include "MapGen/GraphParser.h"
 #include "CityMapGenerator.generated.h"
 
+class ULaneGraph;
 class URoadMap;
 
 /// Generates a random city using the meshes provided.
@@ -40,6 +41,10 @@ public:
 
   virtual void PreSave(const ITargetPlatform *TargetPlatform) override;
 
+#if WITH_EDITOR
+  virtual void PostEditChangeProperty(FPropertyChangedEvent &PropertyChangedEvent) override;
+#endif // WITH_EDITOR
+
   /// @}
   // ===========================================================================
   /// @name Overriden from ACityMapMeshHolder
@@ -49,6 +54,8 @@ private:
 
   virtual void UpdateMap() override;
 
+  virtual bool IsMapUpToDate() const override;
+
   /// @}
   // ===========================================================================
   /// @name Road map
@@ -62,6 +69,12 @@ public:
     return RoadMap;
   }
 
+  UFUNCTION(BlueprintCallable)
+  ULaneGraph *GetLaneGraph()
+  {
+    return LaneGraph;
+  }
+
   /// @}
   // ===========================================================================
   /// @name Map construction and update related methods
@@ -78,9 +91,27 @@ private:
   /// Add the road meshes to the scene based on the current DCEL.
   void GenerateRoads();
 
-  /// Generate the road map image and save to disk if requested.
+  /// Generate the road map image and save to disk if requested. The lane
+  /// graph is generated too.
   void GenerateRoadMap();
 
+  // The stages of the generation depend on each other as seed -> graph ->
+  // road instances -> road map, each key includes the one of the stage
+  // before. An edit recomputes only the stages whose key changed, and a
+  // change of the mesh of a tag only swaps the mesh of its instances.
+
+  /// Hash of the properties the graph depends on. Zero if the layout is
+  /// random.
+  uint32 GetGraphKey() const;
+
+  /// Hash of the properties the transforms of the road instances depend on,
+  /// the graph's included. Zero if the layout is random.
+  uint32 GetMapKey() const;
+
+  /// Hash of the properties the road map depends on, the instances' and
+  /// their meshes included.
+  uint32 GetRoadMapKey() const;
+
   /// @}
   // ===========================================================================
   /// @name Map generation properties
@@ -149,9 +180,10 @@ private:
   UPROPERTY(Category = "Road Map", EditAnywhere)
   bool bDrawDebugPixelsToLevel = false;
 
-  /** The road map is re-computed on save so we always store an up-to-date
-    * version. Uncheck this only for testing purposes as the road map might get
-    * out-of-sync with the current road layout.
+  /** The road map is re-computed on save, if the road layout changed, so we
+    * always store an up-to-date version. Uncheck this only for testing
+    * purposes as the road map might get out-of-sync with the current road
+    * layout.
     */
   UPROPERTY(Category = "Road Map", EditAnywhere, AdvancedDisplay)
   bool bGenerateRoadMapOnSave = true;
@@ -167,6 +199,17 @@ private:
   UPROPERTY()
   URoadMap *RoadMap;
 
+  UPROPERTY()
+  ULaneGraph *LaneGraph;
+
+  /// Key of the road layout the current instances were generated with.
+  UPROPERTY()
+  uint32 GeneratedMapKey = 0u;
+
+  /// Key of the road layout and settings the road map was generated with.
+  UPROPERTY()
+  uint32 GeneratedRoadMapKey = 0u;
+
   /// @}
   // ===========================================================================
   /// @name Other private members
@@ -176,6 +219,9 @@ private:
 
   TUniquePtr<MapGen::DoublyConnectedEdgeList> Dcel;
 
+  /// Key of the graph in Dcel, not saved as the graph is not either.
+  uint32 GeneratedGraphKey = 0u;
+
   TUniquePtr<MapGen::GraphParser> DcelParser;
   /// @}
 };
@@ -11,6 +11,15 @@
 
 #include "Components/ArrowComponent.h"
 
+/// Frames rendered with each preset while pre-warming, the first one issues
+/// the shader and pipeline requests, the rest let them complete.
+static constexpr uint32 PRE_WARM_FRAMES_PER_PRESET = 3u;
+
+static bool AreEqual(const FWeatherDescription &Lhs, const FWeatherDescription &Rhs)
+{
+  return FWeatherDescription::StaticStruct()->CompareScriptStruct(&Lhs, &Rhs, PPF_None);
+}
+
 static FString GetIniFileName(const FString &MapName = TEXT(""))
 {
   const FString BaseName = TEXT("CarlaWeather");
@@ -42,6 +51,16 @@ void ADynamicWeather::LoadWeatherDescriptionsFromFile(
     const FString &MapName,
     TArray<FWeatherDescription> &Descriptions)
 {
+#if !WITH_EDITOR
+  // The config files do not change in a packaged build.
+  static TMap<FString, TArray<FWeatherDescription>> Cache;
+  const auto *Cached = Cache.Find(MapName);
+  if (Cached != nullptr) {
+    Descriptions.Append(*Cached);
+    return;
+  }
+#endif // !WITH_EDITOR
+
   // Try to load config file.
   FString DefaultFilePath;
   if (GetWeatherIniFilePath(GetIniFileName(), DefaultFilePath)) {
@@ -69,6 +88,10 @@ void ADynamicWeather::LoadWeatherDescriptionsFromFile(
     Descriptions.AddDefaulted(1u);
     Descriptions.Last().Name = TEXT("Default");
   }
+
+#if !WITH_EDITOR
+  Cache.Add(MapName, Descriptions);
+#endif // !WITH_EDITOR
 }
 
 ADynamicWeather::ADynamicWeather(const FObjectInitializer& ObjectInitializer) :
@@ -77,7 +100,9 @@ ADynamicWeather::ADynamicWeather(const FObjectInitializer& ObjectInitializer) :
   , FileName(GetIniFileName())
 #endif // WITH_EDITORONLY_DATA
 {
-  PrimaryActorTick.bCanEverTick = false;
+  // Ticks only while pre-warming the presets.
+  PrimaryActorTick.bCanEverTick = true;
+  PrimaryActorTick.bStartWithTickEnabled = false;
 
   RootComponent = ObjectInitializer.CreateDefaultSubobject<USceneComponent>(this, TEXT("SceneComponent0"));
 
@@ -111,6 +136,59 @@ void ADynamicWeather::BeginPlay()
 #endif // WITH_EDITOR
 }
 
+void ADynamicWeather::Tick(float DeltaSeconds)
+{
+  Super::Tick(DeltaSeconds);
+  if (PreWarmFramesLeft > 0u) {
+    --PreWarmFramesLeft;
+    return;
+  }
+  if (PreWarmPresetsLeft.Num() > 0) {
+    ActivateWeatherDescription(PreWarmPresetsLeft.Pop(false));
+    bIsWeatherApplied = false;
+    PreWarmFramesLeft = PRE_WARM_FRAMES_PER_PRESET - 1u;
+    return;
+  }
+  UE_LOG(LogCarla, Log, TEXT("Weather presets pre-warmed"));
+  SetActorTickEnabled(false);
+  ApplyWeatherDescription(PreWarmTarget);
+}
+
+void ADynamicWeather::ApplyWeatherDescription(const FWeatherDescription &WeatherDescription)
+{
+  if (IsPreWarming()) {
+    PreWarmTarget = WeatherDescription;
+    return;
+  }
+  if (bIsWeatherApplied && AreEqual(Weather, WeatherDescription)) {
+    UE_LOG(LogCarla, Log, TEXT("Weather \"%s\" is already active"), *Weather.Name);
+    return;
+  }
+  ActivateWeatherDescription(WeatherDescription);
+  bIsWeatherApplied = true;
+}
+
+void ADynamicWeather::PreWarmPresets(
+    const TArray<FWeatherDescription> &Presets,
+    const FWeatherDescription &WeatherDescription)
+{
+  // The shaders compiled stay in the cache for the whole process.
+  static bool bPreWarmed = false;
+  if (bPreWarmed || (Presets.Num() == 0)) {
+    ApplyWeatherDescription(WeatherDescription);
+    return;
+  }
+  bPreWarmed = true;
+  UE_LOG(LogCarla, Log, TEXT("Pre-warming %d weather presets..."), Presets.Num());
+  PreWarmPresetsLeft.Reset(Presets.Num());
+  for (int32 i = Presets.Num() - 1; i >= 0; --i) {
+    PreWarmPresetsLeft.Add(Presets[i]);
+  }
+  PreWarmTarget = WeatherDescription;
+  PreWarmFramesLeft = 0u;
+  SetActorTickEnabled(true);
+}
+
 #if WITH_EDITOR
 
 void ADynamicWeather::PostEditChangeProperty(FPropertyChangedEvent &Event)
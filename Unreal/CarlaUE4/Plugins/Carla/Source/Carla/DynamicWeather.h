@@ -28,6 +28,9 @@ public:
   ///  * Config/<MapName>.CarlaWeather.ini
   ///
   /// If no description is found, the default one is added.
+  ///
+  /// Outside the editor the files are parsed only the first time each map is
+  /// loaded, level reloads get the presets parsed then.
   static void LoadWeatherDescriptionsFromFile(
       const FString &MapName,
       TArray<FWeatherDescription> &Descriptions);
@@ -38,6 +41,8 @@ public:
 
   virtual void BeginPlay() override;
 
+  virtual void Tick(float DeltaSeconds) override;
+
 #if WITH_EDITOR
 
   virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
@@ -67,6 +72,26 @@ public:
   UFUNCTION(BlueprintImplementableEvent)
   void RefreshWeather();
 
+  /// Activate @a WeatherDescription unless it is already the active one, so
+  /// the episodes that keep the weather do not refresh it.
+  void ApplyWeatherDescription(const FWeatherDescription &WeatherDescription);
+
+  /// Activate every one of @a Presets for a few frames, one after another, so
+  /// the materials and post-process settings they need are compiled and
+  /// cached before the first episode uses them. Then @a WeatherDescription is
+  /// activated.
+  ///
+  /// Done once per process, later calls just apply @a WeatherDescription.
+  void PreWarmPresets(
+      const TArray<FWeatherDescription> &Presets,
+      const FWeatherDescription &WeatherDescription);
+
+  /// Whether the presets are still being pre-warmed.
+  bool IsPreWarming() const
+  {
+    return PreWarmPresetsLeft.Num() > 0;
+  }
+
   UFUNCTION(BlueprintCallable)
   FVector GetSunDirection() const;
 
@@ -111,4 +136,16 @@ private:
 
   UPROPERTY(Category = "Weather Description", EditAnywhere)
   FWeatherDescription Weather;
+
+  /** Whether Weather has been refreshed since it last changed. */
+  bool bIsWeatherApplied = false;
+
+  /** Presets left to pre-warm, in reverse order. */
+  TArray<FWeatherDescription> PreWarmPresetsLeft;
+
+  /** Weather activated after the pre-warm. */
+  FWeatherDescription PreWarmTarget;
+
+  /** Frames left on the current pre-warm preset. */
+  uint32 PreWarmFramesLeft = 0u;
 };
@@ -0,0 +1,188 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "AgentBoxProjector.h"
+
+#include "Async/ParallelFor.h"
+
+#include "SceneCaptureCamera.h"
+
+#include <carla/carla_server.h>
+
+DECLARE_CYCLE_STAT(TEXT("Project Agent Boxes"), STAT_CarlaProjectAgentBoxes, STATGROUP_Carla);
+
+/// Closest depth, in centimeters, at which a box corner is projected.
+static constexpr float NEAR_PLANE = 10.0f;
+
+/// Far plane of the depth post-process material, in centimeters.
+static constexpr float DEPTH_FAR_PLANE = 100000.0f;
+
+/// Scene depth closer than the agent by more than this, in centimeters, is
+/// an occluder.
+static constexpr float OCCLUSION_TOLERANCE = 20.0f;
+
+/// Samples per side of the grid the depth is checked at inside each box.
+static constexpr uint32 OCCLUSION_SAMPLES = 4u;
+
+/// Agents are projected in parallel in chunks of this size.
+static constexpr int32 AGENTS_PER_CHUNK = 64;
+
+static FVector ToFVector(const carla_vector3d &Vector)
+{
+  return {Vector.x, Vector.y, Vector.z};
+}
+
+// =============================================================================
+// -- FAgentBoxDepth -----------------------------------------------------------
+// =============================================================================
+
+float FAgentBoxDepth::GetDepth(const uint32 X, const uint32 Y) const
+{
+  check((X < Width) && (Y < Height));
+  const uint32 Index = X + Y * Width;
+  if (Encoding == EImageEncoding::Float32) {
+    return static_cast<const float *>(Data)[Index];
+  }
+  const FColor &Color = static_cast<const FColor *>(Data)[Index];
+  const float Normalized =
+      (Color.R + Color.G * 256.0f + Color.B * 65536.0f) / 16777215.0f;
+  return Normalized * DEPTH_FAR_PLANE;
+}
+
+// =============================================================================
+// -- FAgentBoxProjector -------------------------------------------------------
+// =============================================================================
+
+FMatrix FAgentBoxProjector::GetViewProjectionMatrix(const ASceneCaptureCamera &Camera)
+{
+  // The camera looks along its X axis, with Y to the right and Z up.
+  const float HalfWidth = 0.5f * Camera.GetImageSizeX();
+  const float HalfHeight = 0.5f * Camera.GetImageSizeY();
+  const float Focal = HalfWidth / FMath::Tan(FMath::DegreesToRadians(0.5f * Camera.GetFOVAngle()));
+  const FMatrix Projection(
+      FPlane(HalfWidth, HalfHeight, 0.0f, 1.0f),
+      FPlane(Focal, 0.0f, 0.0f, 0.0f),
+      FPlane(0.0f, -Focal, 0.0f, 0.0f),
+      FPlane(0.0f, 0.0f, 0.0f, 0.0f));
+  return Camera.GetActorTransform().ToInverseMatrixWithScale() * Projection;
+}
+
+// Returns whether the depth of the scene is closer than @a MinDepth at every
+// sample of @a Box.
+static bool IsOccluded(const FAgentBoxDepth &Depth, const FBox2D &Box, const float MinDepth)
+{
+  for (auto i = 0u; i < OCCLUSION_SAMPLES; ++i) {
+    for (auto j = 0u; j < OCCLUSION_SAMPLES; ++j) {
+      const float U = (i + 0.5f) / OCCLUSION_SAMPLES;
+      const float V = (j + 0.5f) / OCCLUSION_SAMPLES;
+      const uint32 X = FMath::Min(static_cast<uint32>(FMath::Lerp(Box.Min.X, Box.Max.X, U)), Depth.Width - 1u);
+      const uint32 Y = FMath::Min(static_cast<uint32>(FMath::Lerp(Box.Min.Y, Box.Max.Y, V)), Depth.Height - 1u);
+      if (Depth.GetDepth(X, Y) >= MinDepth - OCCLUSION_TOLERANCE) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void FAgentBoxProjector::Project(
+    const ASceneCaptureCamera &Camera,
+    const carla_agent *Agents,
+    const int32 NumberOfAgents,
+    const FAgentBoxDepth *Depth,
+    TArray<carla_agent_box_2d> &Boxes)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaProjectAgentBoxes);
+  if (NumberOfAgents <= 0) {
+    return;
+  }
+  check(Agents != nullptr);
+
+  const FMatrix ViewProjection = GetViewProjectionMatrix(Camera);
+  // From the captured image to the image sent.
+  const FIntRect Region = Camera.GetRegionOfInterest();
+  const FVector2D RegionMin(Region.Min.X, Region.Min.Y);
+  const FVector2D OutputSize(Camera.GetOutputSizeX(), Camera.GetOutputSizeY());
+  const FVector2D Scale(OutputSize.X / Region.Width(), OutputSize.Y / Region.Height());
+  const FBox2D Image(FVector2D::ZeroVector, OutputSize);
+  check((Depth == nullptr) ||
+      ((Depth->Width == Camera.GetOutputSizeX()) && (Depth->Height == Camera.GetOutputSizeY())));
+
+  Seen.SetNumUninitialized(NumberOfAgents, false);
+  Projected.SetNumUninitialized(NumberOfAgents, false);
+  Flags.SetNumUninitialized(NumberOfAgents, false);
+
+  const int32 NumberOfChunks = (NumberOfAgents + AGENTS_PER_CHUNK - 1) / AGENTS_PER_CHUNK;
+  ParallelFor(NumberOfChunks, [&](const int32 Chunk) {
+    const int32 End = FMath::Min(NumberOfAgents, (Chunk + 1) * AGENTS_PER_CHUNK);
+    for (int32 Index = Chunk * AGENTS_PER_CHUNK; Index < End; ++Index) {
+      const carla_agent &Agent = Agents[Index];
+      Seen[Index] = false;
+      const bool bHasBox =
+          (Agent.type == CARLA_SERVER_AGENT_VEHICLE) ||
+          (Agent.type == CARLA_SERVER_AGENT_PEDESTRIAN);
+      if (!bHasBox) {
+        continue;
+      }
+      const FMatrix AgentToWorld = FRotationTranslationMatrix(
+          FRotationMatrix::MakeFromX(ToFVector(Agent.transform.orientation)).Rotator(),
+          ToFVector(Agent.transform.location));
+      const FMatrix AgentToImage = AgentToWorld * ViewProjection;
+      const FVector Extent = ToFVector(Agent.box_extent);
+      FVector4 Corners[8u];
+      for (auto i = 0u; i < 8u; ++i) {
+        const FVector Corner(
+            (i & 1u ? Extent.X : -Extent.X),
+            (i & 2u ? Extent.Y : -Extent.Y),
+            (i & 4u ? Extent.Z : -Extent.Z));
+        Corners[i] = AgentToImage.TransformPosition(Corner);
+      }
+      // Bounds of the corners in front of the near plane, and of the points
+      // where the edges of the box cross it.
+      FBox2D Box(ForceInit);
+      float MinDepth = TNumericLimits<float>::Max();
+      auto AddPoint = [&](const FVector4 &Point) {
+        Box += (FVector2D(Point.X, Point.Y) / Point.W - RegionMin) * Scale;
+        MinDepth = FMath::Min(MinDepth, Point.W);
+      };
+      for (auto i = 0u; i < 8u; ++i) {
+        if (Corners[i].W >= NEAR_PLANE) {
+          AddPoint(Corners[i]);
+        }
+        for (auto Axis = 1u; Axis < 8u; Axis <<= 1u) {
+          const auto j = i | Axis;
+          const bool bCrosses = (j != i) &&
+              ((Corners[i].W >= NEAR_PLANE) != (Corners[j].W >= NEAR_PLANE));
+          if (bCrosses) {
+            const float Alpha = (NEAR_PLANE - Corners[i].W) / (Corners[j].W - Corners[i].W);
+            AddPoint(Corners[i] + (Corners[j] - Corners[i]) * Alpha);
+          }
+        }
+      }
+      if (!Box.bIsValid || !Box.Intersect(Image)) {
+        continue;
+      }
+      const bool bTruncated = !Image.IsInside(Box);
+      Box.Min = FVector2D::Max(Box.Min, Image.Min);
+      Box.Max = FVector2D::Min(Box.Max, Image.Max);
+      uint32 BoxFlags = (bTruncated ? CARLA_SERVER_AGENT_BOX_TRUNCATED : 0u);
+      if ((Depth != nullptr) && IsOccluded(*Depth, Box, MinDepth)) {
+        BoxFlags |= CARLA_SERVER_AGENT_BOX_OCCLUDED;
+      }
+      Seen[Index] = true;
+      Projected[Index] = Box;
+      Flags[Index] = BoxFlags;
+    }
+  }, NumberOfChunks < 2);
+
+  for (int32 Index = 0; Index < NumberOfAgents; ++Index) {
+    if (Seen[Index]) {
+      const FBox2D &Box = Projected[Index];
+      Boxes.Add({Agents[Index].id, Box.Min.X, Box.Min.Y, Box.Max.X, Box.Max.Y, Flags[Index]});
+    }
+  }
+}
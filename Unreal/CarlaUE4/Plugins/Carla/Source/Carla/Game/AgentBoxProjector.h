@@ -0,0 +1,68 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Settings/ImageEncoding.h"
+
+class ASceneCaptureCamera;
+struct carla_agent;
+struct carla_agent_box_2d;
+
+/// Depth image of a camera as read back, used to tell whether the agents are
+/// occluded.
+struct FAgentBoxDepth
+{
+  /// Pixels as sent, BGRA8 (normalized depth in the RGB channels) or Float32
+  /// (centimeters). Other encodings are not supported.
+  const void *Data = nullptr;
+
+  EImageEncoding Encoding = EImageEncoding::BGRA8;
+
+  uint32 Width = 0u;
+
+  uint32 Height = 0u;
+
+  /// Depth in centimeters at the given pixel.
+  float GetDepth(uint32 X, uint32 Y) const;
+};
+
+/// Projects the bounding boxes of the agents into the image sent by a camera,
+/// using the view-projection matrix of the camera and its region of interest
+/// and output size.
+class CARLA_API FAgentBoxProjector
+{
+public:
+
+  /// Append to @a Boxes the screen-space box of every agent of @a Agents
+  /// seen by @a Camera, clipped to its image. The agents are projected in
+  /// parallel in the task graph workers.
+  ///
+  /// If @a Depth is not null it must be the depth image of a camera at the
+  /// same place, with the same field of view and output size, and the boxes
+  /// fully hidden by the scene are flagged as occluded.
+  void Project(
+      const ASceneCaptureCamera &Camera,
+      const carla_agent *Agents,
+      int32 NumberOfAgents,
+      const FAgentBoxDepth *Depth,
+      TArray<carla_agent_box_2d> &Boxes);
+
+  /// View-projection matrix of @a Camera. A world location transformed by it
+  /// gives, once divided by W, its pixel in the captured image; W is the
+  /// depth in centimeters along the view direction.
+  static FMatrix GetViewProjectionMatrix(const ASceneCaptureCamera &Camera);
+
+private:
+
+  /** Whether each agent was seen, by index in the agents projected. */
+  TArray<bool> Seen;
+
+  /** Box of each agent, by index in the agents projected. */
+  TArray<FBox2D> Projected;
+
+  TArray<uint32> Flags;
+};
@@ -0,0 +1,139 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "AgentGrid.h"
+
+#include <algorithm>
+
+FAgentGrid::FAgentGrid(const float InCellSize) :
+  CellSize(InCellSize) {
+  check(CellSize > 0.0f);
+}
+
+FIntPoint FAgentGrid::GetCell(const FVector &Location) const
+{
+  return {
+    FMath::FloorToInt(Location.X / CellSize),
+    FMath::FloorToInt(Location.Y / CellSize)};
+}
+
+void FAgentGrid::Rebuild(const TArray<FAgentRecord> &Agents, const uint8 TypeMask)
+{
+  for (auto &Cell : Cells) {
+    Cell.Value.Reset();
+  }
+  Placed.Reset();
+  Locations.SetNumUninitialized(Agents.Num(), false);
+  for (int32 Index = 0; Index < Agents.Num(); ++Index) {
+    const auto &Agent = Agents[Index];
+    const AActor *Actor = Agent.Actor.Get();
+    if ((Actor == nullptr) || ((GetTypeBit(Agent.Type) & TypeMask) == 0u)) {
+      continue;
+    }
+    Locations[Index] = Actor->GetActorLocation();
+    Cells.FindOrAdd(GetCell(Locations[Index])).Add(Index);
+    Placed.Add(Index);
+  }
+}
+
+void FAgentGrid::Query(
+    const FVector &Center,
+    const float Radius,
+    TArray<int32> &Indices) const
+{
+  const float RadiusSquared = Radius * Radius;
+  const FIntPoint Min = GetCell(Center - FVector(Radius, Radius, 0.0f));
+  const FIntPoint Max = GetCell(Center + FVector(Radius, Radius, 0.0f));
+  for (int32 X = Min.X; X <= Max.X; ++X) {
+    for (int32 Y = Min.Y; Y <= Max.Y; ++Y) {
+      const auto *Cell = Cells.Find(FIntPoint(X, Y));
+      if (Cell == nullptr) {
+        continue;
+      }
+      for (const int32 Index : *Cell) {
+        if (FVector::DistSquaredXY(Center, Locations[Index]) <= RadiusSquared) {
+          Indices.Add(Index);
+        }
+      }
+    }
+  }
+}
+
+void FAgentGrid::QueryAll(TArray<int32> &Indices) const
+{
+  Indices.Append(Placed);
+}
+
+void FAgentGrid::AddLocation(const FVector &Location)
+{
+  const int32 Index = Locations.Add(Location);
+  Cells.FindOrAdd(GetCell(Location)).Add(Index);
+  Placed.Add(Index);
+}
+
+int32 FAgentGrid::FindLeadAgent(
+    const FVector &Location,
+    const FVector &Direction,
+    const float MinDistance,
+    const float MaxDistance,
+    const float HalfWidth) const
+{
+  const FVector Axis = FVector(Direction.X, Direction.Y, 0.0f).GetSafeNormal();
+  if (Axis.IsZero() || (MaxDistance <= MinDistance)) {
+    return INDEX_NONE;
+  }
+  // Bounding box of the corridor.
+  const FVector Side(-Axis.Y, Axis.X, 0.0f);
+  const FVector Corners[] = {
+    Location + Axis * MinDistance + Side * HalfWidth,
+    Location + Axis * MinDistance - Side * HalfWidth,
+    Location + Axis * MaxDistance + Side * HalfWidth,
+    Location + Axis * MaxDistance - Side * HalfWidth};
+  FBox Box(ForceInit);
+  for (const auto &Corner : Corners) {
+    Box += Corner;
+  }
+  const FIntPoint Min = GetCell(Box.Min);
+  const FIntPoint Max = GetCell(Box.Max);
+
+  int32 Lead = INDEX_NONE;
+  float LeadDistance = MaxDistance;
+  for (int32 X = Min.X; X <= Max.X; ++X) {
+    for (int32 Y = Min.Y; Y <= Max.Y; ++Y) {
+      const auto *Cell = Cells.Find(FIntPoint(X, Y));
+      if (Cell == nullptr) {
+        continue;
+      }
+      for (const int32 Index : *Cell) {
+        const FVector Offset = Locations[Index] - Location;
+        const float Along = Offset.X * Axis.X + Offset.Y * Axis.Y;
+        const float Across = Offset.X * Side.X + Offset.Y * Side.Y;
+        if ((Along >= MinDistance) && (Along <= LeadDistance) && (FMath::Abs(Across) <= HalfWidth)) {
+          Lead = Index;
+          LeadDistance = Along;
+        }
+      }
+    }
+  }
+  return Lead;
+}
+
+void FAgentGrid::KeepNearest(
+    const FVector &Center,
+    const int32 Count,
+    TArray<int32> &Indices) const
+{
+  if (Indices.Num() <= Count) {
+    return;
+  }
+  auto *Begin = Indices.GetData();
+  std::nth_element(Begin, Begin + Count, Begin + Indices.Num(), [&](const int32 Lhs, const int32 Rhs) {
+    return FVector::DistSquaredXY(Center, Locations[Lhs]) <
+           FVector::DistSquaredXY(Center, Locations[Rhs]);
+  });
+  Indices.SetNum(Count, false);
+}
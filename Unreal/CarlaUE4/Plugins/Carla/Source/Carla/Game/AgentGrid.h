@@ -0,0 +1,73 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Game/AgentRegistry.h"
+#include "Util/NonCopyable.h"
+
+/// Uniform 2D grid of the agents' locations, for finding the agents around a
+/// given point without visiting every agent of the level.
+///
+/// The grid refers to the agents by their index in the registry, so it needs
+/// to be rebuilt every time the registry is modified or the agents move. The
+/// cells keep their memory between rebuilds.
+class CARLA_API FAgentGrid : private NonCopyable
+{
+public:
+
+  /// @a CellSize in centimeters.
+  explicit FAgentGrid(float CellSize = 5000.0f);
+
+  /// Place every agent in @a Agents whose type is in @a TypeMask, see
+  /// GetTypeBit.
+  void Rebuild(const TArray<FAgentRecord> &Agents, uint8 TypeMask);
+
+  /// Append the index of every agent within @a Radius of @a Center (on the
+  /// XY plane) to @a Indices.
+  void Query(const FVector &Center, float Radius, TArray<int32> &Indices) const;
+
+  /// Append the index of every agent in the grid to @a Indices.
+  void QueryAll(TArray<int32> &Indices) const;
+
+  /// Place @a Location too, of an actor that is not in the registry, like
+  /// the player. It gets the next index past the agents'.
+  void AddLocation(const FVector &Location);
+
+  /// Index of the agent nearest to @a Location within the corridor ahead of
+  /// it along @a Direction, between @a MinDistance and @a MaxDistance and at
+  /// most @a HalfWidth from its axis, on the XY plane. INDEX_NONE if there is
+  /// none. Visits only the cells the corridor overlaps, never allocates.
+  int32 FindLeadAgent(
+      const FVector &Location,
+      const FVector &Direction,
+      float MinDistance,
+      float MaxDistance,
+      float HalfWidth) const;
+
+  /// Keep only the @a Count agents in @a Indices nearest to @a Center, in no
+  /// particular order.
+  void KeepNearest(const FVector &Center, int32 Count, TArray<int32> &Indices) const;
+
+  static constexpr uint8 GetTypeBit(EAgentType Type)
+  {
+    return 1u << static_cast<uint8>(Type);
+  }
+
+private:
+
+  FIntPoint GetCell(const FVector &Location) const;
+
+  const float CellSize;
+
+  TMap<FIntPoint, TArray<int32>> Cells;
+
+  /** Location of each agent, by index in the registry. */
+  TArray<FVector> Locations;
+
+  /** Index of each agent in the grid. */
+  TArray<int32> Placed;
+};
@@ -0,0 +1,39 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "AgentRegistry.h"
+
+uint32 FAgentRegistry::Register(AActor &Actor, const EAgentType Type)
+{
+  const int32 *Index = Indices.Find(&Actor);
+  if (Index != nullptr) {
+    if (Agents[*Index].Actor.Get() == &Actor) {
+      return Agents[*Index].Id;
+    }
+    // A destroyed agent whose memory has been reused by this actor.
+    Deregister(Actor);
+  }
+  const uint32 Id = NextId++;
+  Indices.Add(&Actor, Agents.Num());
+  Agents.Add({Id, Type, &Actor});
+  Keys.Add(&Actor);
+  return Id;
+}
+
+void FAgentRegistry::Deregister(const AActor &Actor)
+{
+  int32 Index;
+  if (!Indices.RemoveAndCopyValue(&Actor, Index)) {
+    return;
+  }
+  Agents.RemoveAtSwap(Index, 1, false);
+  Keys.RemoveAtSwap(Index, 1, false);
+  if (Index < Agents.Num()) {
+    // The last agent took its place.
+    Indices[Keys[Index]] = Index;
+  }
+}
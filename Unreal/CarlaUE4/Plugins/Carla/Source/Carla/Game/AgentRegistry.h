@@ -0,0 +1,78 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Util/NonCopyable.h"
+
+class AActor;
+
+enum class EAgentType : uint8
+{
+  Vehicle,
+  Walker,
+  TrafficSign
+};
+
+struct FAgentRecord
+{
+  /** Stable id of the agent, unique during the lifetime of the registry. */
+  uint32 Id;
+
+  EAgentType Type;
+
+  TWeakObjectPtr<AActor> Actor;
+};
+
+/// Keeps every non-player agent of the level in a single dense array. Agents
+/// are registered once when spawned and get a monotonically increasing id.
+///
+/// Agents whose actor has been destroyed but not yet deregistered are still
+/// present, check the actor before using it.
+class CARLA_API FAgentRegistry : private NonCopyable
+{
+public:
+
+  /// Register @a Actor, returns its id. Registering twice the same actor
+  /// returns the id it already had.
+  uint32 Register(AActor &Actor, EAgentType Type);
+
+  /// Remove @a Actor from the registry. The order of the remaining agents may
+  /// change.
+  void Deregister(const AActor &Actor);
+
+  int32 Num() const
+  {
+    return Agents.Num();
+  }
+
+  /// Id of @a Actor, or 0 if it is not an agent. @a Actor is not
+  /// dereferenced, it may have been destroyed.
+  uint32 FindId(const AActor *Actor) const
+  {
+    const int32 *Index = Indices.Find(Actor);
+    return (Index != nullptr ? Agents[*Index].Id : 0u);
+  }
+
+  const TArray<FAgentRecord> &GetAgents() const
+  {
+    return Agents;
+  }
+
+private:
+
+  TArray<FAgentRecord> Agents;
+
+  /** Actor of each agent, in the same order as Agents. Kept apart as the weak
+    * pointers cannot be resolved once the actor is gone.
+    */
+  TArray<const AActor *> Keys;
+
+  /** Index of each actor in Agents. */
+  TMap<const AActor *, int32> Indices;
+
+  uint32 NextId = 1u;
+};
@@ -0,0 +1,135 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "BatchGameController.h"
+
+#include "GameFramework/PlayerStart.h"
+
+#include "CarlaGameState.h"
+#include "CarlaServer.h"
+#include "CarlaVehicleController.h"
+#include "Settings/CarlaSettings.h"
+
+using Errc = CarlaServer::ErrorCode;
+
+BatchGameController::BatchGameController() {}
+
+BatchGameController::~BatchGameController() {}
+
+void BatchGameController::Initialize(UCarlaSettings &InCarlaSettings)
+{
+  CarlaSettings = &InCarlaSettings;
+
+  // Called again on every level reload, the server and the job go on.
+  if (Server == nullptr) {
+    UE_LOG(LogCarla, Log, TEXT("Running the batch job \"%s\""), *CarlaSettings->BatchJobFile);
+    Server = MakeUnique<CarlaServer>(CarlaSettings->WorldPort, CarlaSettings->ServerTimeOut);
+    Server->SetThreadOptions(*CarlaSettings);
+    CarlaServer::SetBufferOptions(*CarlaSettings);
+    TArray<FString> Ids;
+    CarlaSettings->BatchWeathers.ParseIntoArray(Ids, TEXT(","), true);
+    for (const auto &Id : Ids) {
+      Weathers.Add(FCString::Atoi(*Id.Trim()));
+    }
+  }
+  CarlaSettings->WeatherId = GetEpisodeWeather();
+}
+
+APlayerStart *BatchGameController::ChoosePlayerStart(
+    const TArray<APlayerStart *> &AvailableStartSpots)
+{
+  check(AvailableStartSpots.Num() > 0);
+  // Each episode starts somewhere else, the same in every run of the job.
+  const uint32 Index = Episode % AvailableStartSpots.Num();
+  UE_LOG(LogCarla, Log, TEXT("Spawning player at player start %d/%d"), Index, AvailableStartSpots.Num());
+  return AvailableStartSpots[Index];
+}
+
+void BatchGameController::RegisterPlayer(AController &NewPlayer)
+{
+  Player = Cast<ACarlaVehicleController>(&NewPlayer);
+  check(Player != nullptr);
+}
+
+void BatchGameController::BeginPlay()
+{
+  check(Player != nullptr);
+  check(CarlaSettings != nullptr);
+  GameState = Cast<ACarlaGameState>(Player->GetWorld()->GetGameState());
+  check(GameState != nullptr);
+  Player->SetAutopilot(true);
+  FrameCount = 0u;
+  UE_LOG(
+      LogCarla,
+      Log,
+      TEXT("Batch episode %d/%d, weather %d"),
+      Episode + 1u,
+      CarlaSettings->BatchNumberOfEpisodes,
+      CarlaSettings->WeatherId);
+  if ((Server != nullptr) && (Errc::Success != Server->StartOfflineEpisode(*CarlaSettings))) {
+    UE_LOG(LogCarlaServer, Error, TEXT("Failed to start the recording of the batch episode"));
+    Server = nullptr;
+    FGenericPlatformMisc::RequestExit(false);
+  }
+}
+
+void BatchGameController::Tick(float DeltaSeconds)
+{
+  FrameArena.Reset();
+  if ((Server == nullptr) || (Player == nullptr)) {
+    return;
+  }
+  check(GameState != nullptr);
+  check(CarlaSettings != nullptr);
+
+  if (FrameCount++ < CarlaSettings->BatchWarmUpFrames) {
+    return;
+  }
+  if (Errc::Error == Server->SendMeasurements(*GameState, *Player, *CarlaSettings, FrameArena)) {
+    UE_LOG(LogCarlaServer, Error, TEXT("Failed to record the frame, batch job aborted"));
+    Server = nullptr;
+    FGenericPlatformMisc::RequestExit(false);
+    return;
+  }
+  if (FrameCount >= CarlaSettings->BatchWarmUpFrames + CarlaSettings->BatchFramesPerEpisode) {
+    EndEpisode();
+  }
+}
+
+int32 BatchGameController::GetEpisodeWeather() const
+{
+  check(CarlaSettings != nullptr);
+  if (Weathers.Num() > 0) {
+    return Weathers[Episode % Weathers.Num()];
+  }
+  const int32 NumberOfWeathers = CarlaSettings->WeatherDescriptions.Num();
+  return (NumberOfWeathers > 0 ? static_cast<int32>(Episode % NumberOfWeathers) : -1);
+}
+
+void BatchGameController::EndEpisode()
+{
+  const auto Summary = Player->GetPlayerState().GetEpisodeSummary();
+  UE_LOG(
+      LogCarla,
+      Log,
+      TEXT("Batch episode %d summary: { Distance = %.1f m, Collisions = %d, OffRoad = %.2f s, OtherLane = %.2f s, OverSpeedLimit = %.2f s }"),
+      Episode + 1u,
+      Summary.DistanceTraveled / 100.0f,
+      Summary.NumberOfCollisions,
+      Summary.SecondsOffRoad,
+      Summary.SecondsOnOtherLane,
+      Summary.SecondsOverSpeedLimit);
+  ++Episode;
+  if (Episode >= CarlaSettings->BatchNumberOfEpisodes) {
+    UE_LOG(LogCarla, Log, TEXT("Batch job done, %d episodes recorded"), Episode);
+    // Frees the recorder first, so every frame is written.
+    Server = nullptr;
+    FGenericPlatformMisc::RequestExit(false);
+    return;
+  }
+  Player->RestartLevel();
+}
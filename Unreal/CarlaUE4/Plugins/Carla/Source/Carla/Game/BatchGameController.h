@@ -0,0 +1,65 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "CarlaGameControllerBase.h"
+#include "Util/FrameArena.h"
+
+class ACarlaGameState;
+class ACarlaVehicleController;
+class CarlaServer;
+
+/// Runs the batch job given with -carla-batch= without any client: every
+/// episode of the job drives the player with the autopilot and records its
+/// frames through the server-side recorder, one weather after another, then
+/// quits. See the Batch settings of UCarlaSettings.
+class CARLA_API BatchGameController : public CarlaGameControllerBase
+{
+public:
+
+  BatchGameController();
+
+  ~BatchGameController();
+
+  virtual void Initialize(UCarlaSettings &CarlaSettings) override;
+
+  virtual APlayerStart *ChoosePlayerStart(const TArray<APlayerStart *> &AvailableStartSpots) override;
+
+  virtual void RegisterPlayer(AController &NewPlayer) override;
+
+  virtual void BeginPlay() override;
+
+  virtual void Tick(float DeltaSeconds) override;
+
+private:
+
+  /// Weather of the current episode, -1 for the default one.
+  int32 GetEpisodeWeather() const;
+
+  /// Go to the next episode, or quit after the last one.
+  void EndEpisode();
+
+  TUniquePtr<CarlaServer> Server;
+
+  /// Buffers recorded, released at every tick.
+  FFrameArena FrameArena;
+
+  UCarlaSettings *CarlaSettings = nullptr;
+
+  ACarlaVehicleController *Player = nullptr;
+
+  ACarlaGameState *GameState = nullptr;
+
+  /// Parsed from UCarlaSettings::BatchWeathers.
+  TArray<int32> Weathers;
+
+  /// Index of the current episode in the job, survives the level reloads.
+  uint32 Episode = 0u;
+
+  /// Frames ticked in the current episode, warm-up included.
+  uint32 FrameCount = 0u;
+};
@@ -11,7 +11,10 @@
 
 /// Bitmap and meta info of a scene capture.
 ///
-/// The bitmap may be empty if the capture failed.
+/// The bitmap may be empty if the capture failed. The images sent to the
+/// client are read directly from the cameras and do not go through this
+/// bitmap, each camera keeps its own for its whole lifetime, see
+/// ASceneCaptureCamera::ReadPixels.
 USTRUCT()
 struct FCapturedImage
 {
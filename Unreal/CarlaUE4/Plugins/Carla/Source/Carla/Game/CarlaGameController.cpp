@@ -7,16 +7,55 @@
 #include "Carla.h"
 #include "CarlaGameController.h"
 
+#include "CarlaGameModeBase.h"
+#include "CarlaGameState.h"
 #include "CarlaVehicleController.h"
+#include "Engine/GameViewportClient.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerStart.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/PackageName.h"
+#include "MapGen/LaneGraph.h"
+#include "SceneCaptureCamera.h"
 
 #include "Settings/CarlaSettings.h"
+#include "Util/StartupProfiler.h"
+#include "Util/ThreadAffinity.h"
 #include "CarlaServer.h"
 
+DECLARE_CYCLE_STAT(TEXT("Game Controller Tick"), STAT_CarlaGameControllerTick, STATGROUP_Carla);
+
 using Errc = CarlaServer::ErrorCode;
 
 static constexpr bool BLOCKING = true;
 static constexpr bool NON_BLOCKING = false;
 
+static bool OverridesCameraPostProcessParameters(const UCarlaSettings &Settings)
+{
+  const auto *Weather = Settings.GetActiveWeatherDescription();
+  return ((Weather != nullptr) && Weather->bOverrideCameraPostProcessParameters);
+}
+
+/// The sensors are attached in the order of the map, so the order matters too.
+template <typename DescriptionT>
+static bool AreEqual(
+    const TMap<FString, DescriptionT> &Lhs,
+    const TMap<FString, DescriptionT> &Rhs)
+{
+  if (Lhs.Num() != Rhs.Num()) {
+    return false;
+  }
+  auto It = Rhs.CreateConstIterator();
+  for (const auto &Item : Lhs) {
+    if ((Item.Key != It->Key) ||
+        !DescriptionT::StaticStruct()->CompareScriptStruct(&Item.Value, &It->Value, PPF_None)) {
+      return false;
+    }
+    ++It;
+  }
+  return true;
+}
+
 CarlaGameController::CarlaGameController() :
   Server(nullptr),
   Player(nullptr) {}
@@ -29,22 +68,50 @@ void CarlaGameController::Initialize(UCarlaSettings &InCarlaSettings)
 
   // Initialize server if missing.
   if (Server == nullptr) {
-    Server = MakeUnique<CarlaServer>(CarlaSettings->WorldPort, CarlaSettings->ServerTimeOut);
-    if ((Errc::Success != Server->Connect()) ||
-        (Errc::Success != Server->ReadNewEpisode(*CarlaSettings, BLOCKING))) {
+    MakeServer();
+    FThreadAffinity::PinEngineThreads(CarlaSettings->GameThreadCPUs, CarlaSettings->RenderThreadCPUs);
+    FStartupProfiler::Mark(TEXT("server_listening"));
+    if (CarlaSettings->bLoadLevelBeforeClient) {
+      // The level loads with the current settings while the client connects.
+      if (Errc::Success != Server->Listen()) {
+        UE_LOG(LogCarlaServer, Warning, TEXT("Failed to listen for the client, server needs restart"));
+        Server = nullptr;
+        return;
+      }
+      bAwaitingFirstClient = true;
+      return;
+    }
+    if (Errc::Success != Server->Connect()) {
       UE_LOG(LogCarlaServer, Warning, TEXT("Failed to initialize, server needs restart"));
       Server = nullptr;
+      return;
     }
+    // Includes the time the client takes to connect.
+    FStartupProfiler::Mark(TEXT("client_connected"));
+    if (Errc::Success != Server->ReadNewEpisode(*CarlaSettings, BLOCKING)) {
+      UE_LOG(LogCarlaServer, Warning, TEXT("Failed to initialize, server needs restart"));
+      Server = nullptr;
+      return;
+    }
+    FStartupProfiler::Mark(TEXT("episode_settings_parsed"));
   }
 }
 
+void CarlaGameController::MakeServer()
+{
+  Server = MakeUnique<CarlaServer>(CarlaSettings->WorldPort, CarlaSettings->ServerTimeOut);
+  Server->SetSocketOptions(*CarlaSettings);
+  Server->SetThreadOptions(*CarlaSettings);
+  CarlaServer::SetBufferOptions(*CarlaSettings);
+}
+
 APlayerStart *CarlaGameController::ChoosePlayerStart(
     const TArray<APlayerStart *> &AvailableStartSpots)
 {
   check(AvailableStartSpots.Num() > 0);
-  // Send scene description.
-  if (Server != nullptr) {
-    if (Errc::Success != Server->SendSceneDescription(AvailableStartSpots, BLOCKING)) {
+  // Send scene description, unless nobody connected yet.
+  if ((Server != nullptr) && !bAwaitingFirstClient) {
+    if (Errc::Success != Server->SendSceneDescription(AvailableStartSpots, FrameArena, BLOCKING)) {
       UE_LOG(LogCarlaServer, Warning, TEXT("Failed to send scene description, server needs restart"));
       Server = nullptr;
     }
@@ -52,7 +119,7 @@ APlayerStart *CarlaGameController::ChoosePlayerStart(
 
   // Read episode start.
   uint32 StartIndex = 0u; // default.
-  if (Server != nullptr) {
+  if ((Server != nullptr) && !bAwaitingFirstClient) {
     if (Errc::Success != Server->ReadEpisodeStart(StartIndex, BLOCKING)) {
       UE_LOG(LogCarlaServer, Warning, TEXT("Failed to read episode start, server needs restart"));
       Server = nullptr;
@@ -78,31 +145,94 @@ void CarlaGameController::BeginPlay()
   check(Player != nullptr);
   GameState = Cast<ACarlaGameState>(Player->GetWorld()->GetGameState());
   check(GameState != nullptr);
-  if (Server != nullptr) {
-    if (Errc::Success != Server->SendEpisodeReady(BLOCKING)) {
-      UE_LOG(LogCarlaServer, Warning, TEXT("Failed to read episode start, server needs restart"));
-      Server = nullptr;
-    }
+  check(CarlaSettings != nullptr);
+  LevelSettings.PlayerVehicle = CarlaSettings->PlayerVehicle;
+  LevelSettings.CameraDescriptions = CarlaSettings->CameraDescriptions;
+  LevelSettings.LidarDescriptions = CarlaSettings->LidarDescriptions;
+  LevelSettings.bSemanticSegmentationEnabled = CarlaSettings->bSemanticSegmentationEnabled;
+  LevelSettings.bOverrideCameraPostProcessParameters = OverridesCameraPostProcessParameters(*CarlaSettings);
+  LevelSettings.WeatherId = CarlaSettings->WeatherId;
+  EpisodeSettings.FixedDeltaSeconds = CarlaSettings->FixedDeltaSeconds;
+  EpisodeSettings.PhysicsSubsteps = CarlaSettings->PhysicsSubsteps;
+  EpisodeSettings.MaxPhysicsSubstepDeltaSeconds = CarlaSettings->MaxPhysicsSubstepDeltaSeconds;
+  EpisodeSettings.NumberOfVehicles = CarlaSettings->NumberOfVehicles;
+  EpisodeSettings.NumberOfPedestrians = CarlaSettings->NumberOfPedestrians;
+  EpisodeSettings.SeedVehicles = CarlaSettings->SeedVehicles;
+  EpisodeSettings.SeedPedestrians = CarlaSettings->SeedPedestrians;
+  EpisodeSettings.MaxSpawnsPerFrame = CarlaSettings->MaxSpawnsPerFrame;
+  BudgetGovernor.Reset(CarlaSettings->FrameBudgetMs, Player->GetSceneCaptureCameras());
+  // In synchronous mode the client sets the pace.
+  FramePacer.Reset(
+      CarlaSettings->bSynchronousMode ? 0.0f : CarlaSettings->TargetFramesPerSecond,
+      CarlaSettings->FramePacingSpinMilliseconds);
+  if (bAwaitingFirstClient) {
+    // The episode starts once the client sends its settings.
+    return;
+  }
+  // With a spawn budget the spawners populate the level along the next ticks,
+  // and the client should not get measurements of a half-empty level. Neither
+  // of a level going through the weather presets.
+  bEpisodeReadyPending = true;
+  if ((CarlaSettings->MaxSpawnsPerFrame == 0u) && !IsPreWarmingWeather()) {
+    SendEpisodeReady();
   }
 }
 
 void CarlaGameController::Tick(float DeltaSeconds)
 {
+  SCOPE_CYCLE_COUNTER(STAT_CarlaGameControllerTick);
   check(Player != nullptr);
   check(CarlaSettings != nullptr);
 
+  FrameArena.Reset();
+
+  if (bAwaitingFirstClient) {
+    ReadFirstClient();
+    return;
+  }
+
   if (Server == nullptr) {
-    UE_LOG(LogCarlaServer, Warning, TEXT("Client disconnected, server needs restart"));
-    RestartLevel();
+    if (!CarlaSettings->bReconnectWithoutRestart) {
+      UE_LOG(LogCarlaServer, Warning, TEXT("Client disconnected, server needs restart"));
+      RestartLevel();
+      return;
+    }
+    if (!bReconnecting) {
+      UE_LOG(LogCarlaServer, Warning, TEXT("Client disconnected, keeping the level loaded"));
+    }
+    Listen();
     return;
   }
 
+  if (bReconnecting) {
+    ReadReconnection();
+    return;
+  }
+
+  ReportMemoryUsage();
+
+  if (bEpisodeReadyPending) {
+    if (IsSpawningAgents() || IsPreWarmingWeather()) {
+      return;
+    }
+    SendEpisodeReady();
+    if (Server == nullptr) {
+      return;
+    }
+  }
+
   // Check if the client requested a new episode.
   {
     auto ec = Server->ReadNewEpisode(*CarlaSettings, NON_BLOCKING);
     switch (ec) {
       case Errc::Success:
-        RestartLevel();
+        // Answered with the scene description of the next episode.
+        Server->SetEpisodeSummary(Player->GetPlayerState().GetEpisodeSummary());
+        if (CanResetEpisodeInPlace(*CarlaSettings)) {
+          ResetEpisode(CarlaSettings->bDeltaEpisodeReset);
+        } else {
+          RestartLevel();
+        }
         return;
       case Errc::Error:
         Server = nullptr;
@@ -112,30 +242,407 @@ void CarlaGameController::Tick(float DeltaSeconds)
     }
   }
 
-  // Send measurements.
-  {
+  ReadQueuedEpisode();
+
+  ReadWorldSnapshotRequest();
+  if (Server == nullptr) {
+    return;
+  }
+
+  ReadRouteRequest();
+  if (Server == nullptr) {
+    return;
+  }
+
+  ReadRoadMapRequest();
+  if (Server == nullptr) {
+    return;
+  }
+
+  // Hold the frame until its deadline, so the measurements go out at an even
+  // cadence.
+  if (FramePacer.IsEnabled()) {
+    FramePacer.Wait();
+    Server->SetFramePacing(FramePacer.GetLastWaitMs(), FramePacer.GetJitterMs());
+  }
+
+  // Send measurements, unless the client asked only for the ones at the end of
+  // the current batch of controls.
+  if (!Server->ShouldSkipMeasurements()) {
     check(GameState != nullptr);
     if (Errc::Error == Server->SendMeasurements(
             *GameState,
-            Player->GetPlayerState(),
-            CarlaSettings->bSendNonPlayerAgentsInfo)) {
+            *Player,
+            *CarlaSettings,
+            FrameArena)) {
       Server = nullptr;
       return;
     }
+    FStartupProfiler::Mark(TEXT("first_measurements_sent"));
+    FStartupProfiler::LogReport();
   }
 
-  // Read control, block if the settings say so.
-  {
+  // Read control, block if the settings say so. Controls pending from the last
+  // batch are applied first, one per tick.
+  // In pipelined mode the first tick reads no control, from then on every tick
+  // waits for the control answering the measurements of the previous tick,
+  // computed by the client while this one was simulated.
+  const bool bSkipControl =
+      bAwaitingFirstControl &&
+      CarlaSettings->bSynchronousMode &&
+      CarlaSettings->bPipelinedSynchronousMode;
+  bAwaitingFirstControl = false;
+  if (!bSkipControl && !Server->ApplyPendingControl(*Player)) {
     const bool bShouldBlock = CarlaSettings->bSynchronousMode;
     if (Errc::Error == Server->ReadControl(*Player, bShouldBlock)) {
       Server = nullptr;
       return;
     }
   }
+
+  // Scale the cameras for the next frames, the images read so far keep the
+  // screen percentage they were rendered at.
+  BudgetGovernor.Tick(Player->GetSceneCaptureCameras());
+
+  // Skip rendering the next frame if its images are not going to be sent.
+  if (CarlaSettings->bSkipUnusedFrameRendering) {
+    SetRenderingEnabled(!Server->ShouldSkipMeasurements());
+  }
+
+  // Nor the cameras the client did not ask for.
+  SetObservedCameras();
+}
+
+void CarlaGameController::SetRenderingEnabled(const bool bEnabled)
+{
+  for (auto *Camera : Player->GetSceneCaptureCameras()) {
+    check(Camera != nullptr);
+    Camera->SetCaptureEnabled(bEnabled);
+  }
+  // In headless rendering the viewport never renders the world.
+  auto *Viewport = Player->GetWorld()->GetGameViewport();
+  if ((Viewport != nullptr) && !CarlaSettings->bHeadlessRendering) {
+    Viewport->bDisableWorldRendering = !bEnabled;
+  }
+}
+
+void CarlaGameController::SetObservedCameras()
+{
+  const bool bRender = !(CarlaSettings->bSkipUnusedFrameRendering && Server->ShouldSkipMeasurements());
+  const auto &Cameras = Player->GetSceneCaptureCameras();
+  for (auto i = 0; i < Cameras.Num(); ++i) {
+    check(Cameras[i] != nullptr);
+    Cameras[i]->SetCaptureEnabled(bRender && Server->IsSensorObserved(i));
+  }
 }
 
 void CarlaGameController::RestartLevel()
 {
+  const auto *GameMode = Player->GetWorld()->GetAuthGameMode<ACarlaGameModeBase>();
+  const auto &MapName = CarlaSettings->MapName;
+  if ((GameMode != nullptr) && !GameMode->CanShowMapInPlace(MapName)) {
+    UE_LOG(LogCarlaServer, Log, TEXT("Loading the map \"%s\"..."), *MapName);
+    UGameplayStatics::OpenLevel(Player, FName(*MapName));
+    return;
+  }
   UE_LOG(LogCarlaServer, Log, TEXT("Restarting the level..."));
   Player->RestartLevel();
 }
+
+void CarlaGameController::Listen()
+{
+  // The old server is destroyed first, so the ports are free again.
+  Server = nullptr;
+  MakeServer();
+  if (Errc::Success != Server->Listen()) {
+    UE_LOG(LogCarlaServer, Warning, TEXT("Failed to listen for the client, server needs restart"));
+    Server = nullptr;
+    RestartLevel();
+    return;
+  }
+  bReconnecting = true;
+  bEpisodeReadyPending = false;
+  SetPaused(CarlaSettings->bPauseWhileDisconnected);
+}
+
+void CarlaGameController::ReadReconnection()
+{
+  check(Server != nullptr);
+  switch (Server->ReadNewEpisode(*CarlaSettings, NON_BLOCKING)) {
+    case Errc::Success:
+      break;
+    case Errc::Error:
+      // Nobody connected within the time-out, listen again on the next tick.
+      Server = nullptr;
+      return;
+    default:
+      return;
+  }
+  UE_LOG(LogCarlaServer, Log, TEXT("Client reconnected"));
+  bReconnecting = false;
+  SetPaused(false);
+  if (CarlaSettings->bResumeEpisode && CanResumeEpisode(*CarlaSettings)) {
+    ResumeEpisode();
+  } else if (CanResetEpisodeInPlace(*CarlaSettings)) {
+    ResetEpisode(CarlaSettings->bDeltaEpisodeReset);
+  } else {
+    RestartLevel();
+  }
+}
+
+void CarlaGameController::ReadFirstClient()
+{
+  if (Server == nullptr) {
+    // Nobody connected within the time-out, the level stays loaded.
+    MakeServer();
+    if (Errc::Success != Server->Listen()) {
+      UE_LOG(LogCarlaServer, Warning, TEXT("Failed to listen for the client, trying again"));
+      Server = nullptr;
+      return;
+    }
+  }
+  // Compared below with the settings the level was loaded with.
+  switch (Server->ReadNewEpisode(*CarlaSettings, NON_BLOCKING)) {
+    case Errc::Success:
+      break;
+    case Errc::Error:
+      Server = nullptr;
+      return;
+    default:
+      return;
+  }
+  FStartupProfiler::Mark(TEXT("client_connected"));
+  FStartupProfiler::Mark(TEXT("episode_settings_parsed"));
+  bAwaitingFirstClient = false;
+  if (HasLevelSettings(*CarlaSettings)) {
+    UE_LOG(LogCarlaServer, Log, TEXT("Client connected, applying its settings to the level loaded"));
+    ResetEpisode(true);
+  } else {
+    UE_LOG(LogCarlaServer, Log, TEXT("Client connected, its settings need to reload the level"));
+    RestartLevel();
+  }
+}
+
+bool CarlaGameController::CanResumeEpisode(const UCarlaSettings &Settings) const
+{
+  // Nothing is reset, so the client has to ask for the episode running.
+  const auto *GameMode = Player->GetWorld()->GetAuthGameMode<ACarlaGameModeBase>();
+  check(GameMode != nullptr);
+  return
+      (Settings.MapName.IsEmpty() || (FPackageName::GetShortName(Settings.MapName) == GameMode->GetMapName())) &&
+      (Settings.PlayerVehicle == LevelSettings.PlayerVehicle) &&
+      (Settings.bSemanticSegmentationEnabled == LevelSettings.bSemanticSegmentationEnabled) &&
+      AreEqual(Settings.CameraDescriptions, LevelSettings.CameraDescriptions) &&
+      AreEqual(Settings.LidarDescriptions, LevelSettings.LidarDescriptions) &&
+      (Settings.WeatherId == LevelSettings.WeatherId) &&
+      (Settings.FixedDeltaSeconds == EpisodeSettings.FixedDeltaSeconds) &&
+      (Settings.PhysicsSubsteps == EpisodeSettings.PhysicsSubsteps) &&
+      (Settings.MaxPhysicsSubstepDeltaSeconds == EpisodeSettings.MaxPhysicsSubstepDeltaSeconds) &&
+      (Settings.NumberOfVehicles == EpisodeSettings.NumberOfVehicles) &&
+      (Settings.NumberOfPedestrians == EpisodeSettings.NumberOfPedestrians) &&
+      (Settings.SeedVehicles == EpisodeSettings.SeedVehicles) &&
+      (Settings.SeedPedestrians == EpisodeSettings.SeedPedestrians) &&
+      (Settings.MaxSpawnsPerFrame == EpisodeSettings.MaxSpawnsPerFrame);
+}
+
+void CarlaGameController::ResumeEpisode()
+{
+  UE_LOG(LogCarlaServer, Log, TEXT("Resuming the current episode..."));
+  // The client still expects a scene description and chooses a start, but
+  // the player stays where it is.
+  TArray<APlayerStart *> StartSpots;
+  for (TActorIterator<APlayerStart> It(Player->GetWorld()); It; ++It) {
+    StartSpots.Add(*It);
+  }
+  if (StartSpots.Num() > 0) {
+    ChoosePlayerStart(StartSpots);
+  }
+  BeginPlay();
+}
+
+void CarlaGameController::SetPaused(const bool bPaused)
+{
+  if (UGameplayStatics::IsGamePaused(Player) != bPaused) {
+    UE_LOG(LogCarlaServer, Log, TEXT("%s the world"), (bPaused ? TEXT("Pausing") : TEXT("Resuming")));
+    UGameplayStatics::SetGamePaused(Player, bPaused);
+  }
+}
+
+bool CarlaGameController::CanResetEpisodeInPlace(const UCarlaSettings &Settings) const
+{
+  return Settings.bSoftEpisodeReset && HasLevelSettings(Settings);
+}
+
+bool CarlaGameController::HasLevelSettings(const UCarlaSettings &Settings) const
+{
+  // The sensors are attached when the player is spawned, the post-process
+  // parameters may be overridden by the weather.
+  const bool bWeatherChangesCameras =
+      (Settings.WeatherId != LevelSettings.WeatherId) &&
+      (LevelSettings.bOverrideCameraPostProcessParameters ||
+       OverridesCameraPostProcessParameters(Settings));
+  const auto *GameMode = Player->GetWorld()->GetAuthGameMode<ACarlaGameModeBase>();
+  check(GameMode != nullptr);
+  return
+      GameMode->CanShowMapInPlace(Settings.MapName) &&
+      (Settings.PlayerVehicle == LevelSettings.PlayerVehicle) &&
+      (Settings.bSemanticSegmentationEnabled == LevelSettings.bSemanticSegmentationEnabled) &&
+      AreEqual(Settings.CameraDescriptions, LevelSettings.CameraDescriptions) &&
+      AreEqual(Settings.LidarDescriptions, LevelSettings.LidarDescriptions) &&
+      !bWeatherChangesCameras;
+}
+
+void CarlaGameController::ReadQueuedEpisode()
+{
+  check(Server != nullptr);
+  check(CarlaSettings != nullptr);
+  FString IniFile;
+  if (Errc::Success != Server->ReadQueuedEpisode(IniFile)) {
+    return;
+  }
+  // The INI given by the client only overrides some of the current settings,
+  // the copy is garbage collected once the episode is prepared.
+  auto *QueuedSettings = DuplicateObject<UCarlaSettings>(CarlaSettings, GetTransientPackage());
+  check(QueuedSettings != nullptr);
+  QueuedSettings->LoadSettingsFromString(IniFile);
+  QueuedSettings->ValidateWeatherId();
+  if (!CanResetEpisodeInPlace(*QueuedSettings)) {
+    // The level is reloaded from scratch, there is nothing to keep.
+    UE_LOG(LogCarlaServer, Log, TEXT("The queued episode needs to reload the level"));
+    return;
+  }
+  UE_LOG(LogCarlaServer, Log, TEXT("Preparing the queued episode..."));
+  auto *GameMode = Player->GetWorld()->GetAuthGameMode<ACarlaGameModeBase>();
+  check(GameMode != nullptr);
+  GameMode->PrepareEpisode(*QueuedSettings);
+}
+
+void CarlaGameController::ReadWorldSnapshotRequest()
+{
+  check(Server != nullptr);
+  TArray<uint8> Data;
+  if (Errc::Success != Server->ReadWorldSnapshotRequest(Data)) {
+    return;
+  }
+  auto *GameMode = Player->GetWorld()->GetAuthGameMode<ACarlaGameModeBase>();
+  check(GameMode != nullptr);
+  bool bSuccess = true;
+  if (Data.Num() == 0) {
+    GameMode->SaveWorldSnapshot(Data);
+  } else {
+    bSuccess = GameMode->RestoreWorldSnapshot(Data);
+    Data.Reset();
+  }
+  if (Errc::Error == Server->SendWorldSnapshot(bSuccess, Data)) {
+    Server = nullptr;
+  }
+}
+
+void CarlaGameController::ReadRouteRequest()
+{
+  check(Server != nullptr);
+  FVector StartLocation;
+  FVector StartForward;
+  FVector EndLocation;
+  if (Errc::Success != Server->ReadRouteRequest(StartLocation, StartForward, EndLocation)) {
+    return;
+  }
+  // Same graph and cache the autopilot routes use.
+  const auto *LaneGraph = Player->GetLaneGraph();
+  TArray<FVector> Waypoints;
+  TArray<int32> Lanes;
+  if ((LaneGraph == nullptr) ||
+      !LaneGraph->IsValid() ||
+      !LaneGraph->GetRouteWaypoints(StartLocation, StartForward, EndLocation, Waypoints, &Lanes)) {
+    UE_LOG(LogCarlaServer, Warning, TEXT("No route found for the client"));
+    Waypoints.Reset();
+    Lanes.Reset();
+  }
+  if (Errc::Error == Server->SendRoute(Waypoints, Lanes, FrameArena)) {
+    Server = nullptr;
+  }
+}
+
+void CarlaGameController::ReadRoadMapRequest()
+{
+  check(Server != nullptr);
+  if (Errc::Success != Server->ReadRoadMapRequest()) {
+    return;
+  }
+  if (Errc::Error == Server->SendRoadMap(Player->GetRoadMap())) {
+    Server = nullptr;
+  }
+}
+
+void CarlaGameController::ReportMemoryUsage()
+{
+  check(Server != nullptr);
+  const double Now = FPlatformTime::Seconds();
+  if ((Now - LastMemoryReportTime < MemoryReportPeriod) || (GameState == nullptr)) {
+    return;
+  }
+  LastMemoryReportTime = Now;
+  Server->ReportMemoryUsage(*GameState, *Player);
+}
+
+void CarlaGameController::ResetEpisode(const bool bOnlyChanges)
+{
+  UE_LOG(LogCarlaServer, Log, TEXT("Resetting the episode without reloading the level..."));
+  auto *GameMode = Player->GetWorld()->GetAuthGameMode<ACarlaGameModeBase>();
+  check(GameMode != nullptr);
+  FEpisodeChanges Changes;
+  if (bOnlyChanges) {
+    // The episode settings are taken again at begin play, compare them before.
+    const auto &Settings = *CarlaSettings;
+    Changes.bWeather = (Settings.WeatherId != LevelSettings.WeatherId);
+    Changes.bTimeStep =
+        (Settings.FixedDeltaSeconds != EpisodeSettings.FixedDeltaSeconds) ||
+        (Settings.PhysicsSubsteps != EpisodeSettings.PhysicsSubsteps) ||
+        (Settings.MaxPhysicsSubstepDeltaSeconds != EpisodeSettings.MaxPhysicsSubstepDeltaSeconds);
+    Changes.bNonPlayerAgents =
+        (Settings.NumberOfVehicles != EpisodeSettings.NumberOfVehicles) ||
+        (Settings.NumberOfPedestrians != EpisodeSettings.NumberOfPedestrians) ||
+        (Settings.SeedVehicles != EpisodeSettings.SeedVehicles) ||
+        (Settings.SeedPedestrians != EpisodeSettings.SeedPedestrians) ||
+        (Settings.MaxSpawnsPerFrame != EpisodeSettings.MaxSpawnsPerFrame);
+    UE_LOG(
+        LogCarlaServer,
+        Log,
+        TEXT("Episode changes: weather %s, time step %s, non-player agents %s"),
+        (Changes.bWeather ? TEXT("yes") : TEXT("no")),
+        (Changes.bTimeStep ? TEXT("yes") : TEXT("no")),
+        (Changes.bNonPlayerAgents ? TEXT("yes") : TEXT("no")));
+  }
+  GameMode->ResetEpisode(Changes);
+}
+
+bool CarlaGameController::IsSpawningAgents() const
+{
+  check(GameState != nullptr);
+  const auto *VehicleSpawner = GameState->GetVehicleSpawner();
+  const auto *WalkerSpawner = GameState->GetWalkerSpawner();
+  return
+      ((VehicleSpawner != nullptr) && VehicleSpawner->HasPendingSpawns()) ||
+      ((WalkerSpawner != nullptr) && WalkerSpawner->HasPendingSpawns());
+}
+
+bool CarlaGameController::IsPreWarmingWeather() const
+{
+  const auto *GameMode = Player->GetWorld()->GetAuthGameMode<ACarlaGameModeBase>();
+  return (GameMode != nullptr) && GameMode->IsPreWarmingWeather();
+}
+
+void CarlaGameController::SendEpisodeReady()
+{
+  bEpisodeReadyPending = false;
+  bAwaitingFirstControl = true;
+  if (Server != nullptr) {
+    if (Errc::Success != Server->SendEpisodeReady(BLOCKING)) {
+      UE_LOG(LogCarlaServer, Warning, TEXT("Failed to read episode start, server needs restart"));
+      Server = nullptr;
+      return;
+    }
+    // After the spawners populated the level and the weather was pre-warmed.
+    FStartupProfiler::Mark(TEXT("episode_ready"));
+  }
+}
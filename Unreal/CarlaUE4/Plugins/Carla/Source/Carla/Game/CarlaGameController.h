@@ -7,6 +7,11 @@
 #pragma once
 
 #include "CarlaGameControllerBase.h"
+#include "FrameBudgetGovernor.h"
+#include "FramePacer.h"
+#include "Settings/CameraDescription.h"
+#include "Settings/LidarDescription.h"
+#include "Util/FrameArena.h"
 
 class ACarlaGameState;
 class ACarlaVehicleController;
@@ -33,13 +38,155 @@ public:
 
 private:
 
+  /// Make the server with the current settings, not connected yet.
+  void MakeServer();
+
   void RestartLevel();
 
+  /// Make the server again and start waiting for a client without blocking,
+  /// see UCarlaSettings::bReconnectWithoutRestart.
+  void Listen();
+
+  /// Start the episode requested by the client reconnecting, if it did
+  /// already.
+  void ReadReconnection();
+
+  /// Apply the settings of the first client, if it connected already, to the
+  /// level loaded before it, see UCarlaSettings::bLoadLevelBeforeClient.
+  void ReadFirstClient();
+
+  /// Whether the episode requested with @a Settings is the current one, see
+  /// UCarlaSettings::bResumeEpisode.
+  bool CanResumeEpisode(const UCarlaSettings &Settings) const;
+
+  /// Go through the start of an episode with the client without resetting
+  /// anything.
+  void ResumeEpisode();
+
+  void SetPaused(bool bPaused);
+
+  /// Whether an episode with @a Settings can start without reloading the
+  /// level, see UCarlaSettings::bSoftEpisodeReset.
+  bool CanResetEpisodeInPlace(const UCarlaSettings &Settings) const;
+
+  /// Whether the level loaded has the map, player and sensors of
+  /// @a Settings.
+  bool HasLevelSettings(const UCarlaSettings &Settings) const;
+
+  /// Read the episode queued by the client, if any, and prepare what can be
+  /// prepared while the current episode runs.
+  void ReadQueuedEpisode();
+
+  /// Take or restore the world snapshot requested by the client, if any.
+  void ReadWorldSnapshotRequest();
+
+  /// Answer the route query of the client, if any, with the lane graph.
+  void ReadRouteRequest();
+
+  /// Send the road map to the client, if it asked for it.
+  void ReadRoadMapRequest();
+
+  /// Reset the episode in place, reconfiguring only what changed if
+  /// @a bOnlyChanges.
+  void ResetEpisode(bool bOnlyChanges);
+
+  /// Whether the spawners are still populating the level.
+  bool IsSpawningAgents() const;
+
+  /// Whether the weather presets are still being pre-warmed.
+  bool IsPreWarmingWeather() const;
+
+  void SendEpisodeReady();
+
+  /// Enable or disable rendering of the world and the player's cameras.
+  void SetRenderingEnabled(bool bEnabled);
+
+  /// Report the memory held by the game to the server, once per
+  /// MemoryReportPeriod.
+  void ReportMemoryUsage();
+
+  /// Capture only the cameras the client asked for with the last control,
+  /// see CarlaServer::IsSensorObserved.
+  void SetObservedCameras();
+
   TUniquePtr<CarlaServer> Server;
 
+  /// Transient buffers of the server glue, released at the start of every
+  /// tick so steady-state ticks do not allocate.
+  FFrameArena FrameArena;
+
+  /// Scales the player's cameras to keep the GPU frame time within the
+  /// budget, if any.
+  FFrameBudgetGovernor BudgetGovernor;
+
+  /// Keeps the frame rate steady in asynchronous mode, if the settings ask
+  /// for a target rate.
+  FFramePacer FramePacer;
+
   ACarlaVehicleController *Player = nullptr;
 
   const ACarlaGameState *GameState = nullptr;
 
   UCarlaSettings *CarlaSettings = nullptr;
+
+  /// The settings the level was loaded with that cannot change without
+  /// reloading it.
+  struct FLevelSettings
+  {
+    FString PlayerVehicle;
+
+    TMap<FString, FCameraDescription> CameraDescriptions;
+
+    TMap<FString, FLidarDescription> LidarDescriptions;
+
+    bool bSemanticSegmentationEnabled = false;
+
+    bool bOverrideCameraPostProcessParameters = false;
+
+    int32 WeatherId = -1;
+  };
+
+  FLevelSettings LevelSettings;
+
+  /// The settings of the current episode an in-place reset reconfigures only
+  /// if they change, see UCarlaSettings::bDeltaEpisodeReset.
+  struct FEpisodeSettings
+  {
+    float FixedDeltaSeconds = 0.0f;
+
+    uint32 PhysicsSubsteps = 0u;
+
+    float MaxPhysicsSubstepDeltaSeconds = 0.0f;
+
+    uint32 NumberOfVehicles = 0u;
+
+    uint32 NumberOfPedestrians = 0u;
+
+    int32 SeedVehicles = 0;
+
+    int32 SeedPedestrians = 0;
+
+    uint32 MaxSpawnsPerFrame = 0u;
+  };
+
+  FEpisodeSettings EpisodeSettings;
+
+  /// The episode ready is held until the level is populated.
+  bool bEpisodeReadyPending = false;
+
+  /// In pipelined synchronous mode, the first tick of the episode does not
+  /// wait for any control, see UCarlaSettings::bPipelinedSynchronousMode.
+  bool bAwaitingFirstControl = false;
+
+  /// The client disconnected and the server is waiting for it to reconnect.
+  bool bReconnecting = false;
+
+  /// The level was loaded before any client connected, and the server is
+  /// waiting for the first one.
+  bool bAwaitingFirstClient = false;
+
+  /// In seconds, walking the pools and the road map tiles is not free.
+  static constexpr double MemoryReportPeriod = 1.0;
+
+  double LastMemoryReportTime = 0.0;
 };
@@ -7,15 +7,57 @@
 #include "Carla.h"
 #include "CarlaGameInstance.h"
 
+#include "HAL/IConsoleManager.h"
+#include "PhysicsEngine/PhysicsSettings.h"
+
+#include "BatchGameController.h"
+#include "CameraRenderTargetPool.h"
 #include "CarlaGameController.h"
 #include "MockGameController.h"
 #include "Settings/CarlaSettings.h"
+#include "Util/StartupProfiler.h"
+
+static void SetConsoleVariable(const TCHAR *Name, const FString &Value)
+{
+  auto *Variable = IConsoleManager::Get().FindConsoleVariable(Name);
+  if (Variable != nullptr) {
+    Variable->Set(*Value, ECVF_SetByCode);
+  } else {
+    UE_LOG(LogCarla, Warning, TEXT("Console variable %s not found"), Name);
+  }
+}
+
+// The engine defaults assume the GPU is ours alone.
+static void SetGPUMemoryBudgets(const UCarlaSettings &Settings)
+{
+  if (Settings.TextureStreamingPoolSizeMB > 0u) {
+    SetConsoleVariable(TEXT("r.Streaming.PoolSize"), FString::FromInt(Settings.TextureStreamingPoolSizeMB));
+  }
+  if (Settings.RenderTargetPoolSizeMB > 0u) {
+    SetConsoleVariable(TEXT("r.RenderTargetPoolMin"), FString::FromInt(Settings.RenderTargetPoolSizeMB));
+  }
+  if (Settings.TextureMipBias != 0.0f) {
+    SetConsoleVariable(TEXT("r.Streaming.MipBias"), FString::SanitizeFloat(Settings.TextureMipBias));
+  }
+}
 
 UCarlaGameInstance::UCarlaGameInstance() {
   CarlaSettings = CreateDefaultSubobject<UCarlaSettings>(TEXT("CarlaSettings"));
   check(CarlaSettings != nullptr);
   CarlaSettings->LoadSettings();
   CarlaSettings->LogSettings();
+  CameraRenderTargetPool = CreateDefaultSubobject<UCameraRenderTargetPool>(TEXT("CameraRenderTargetPool"));
+  check(CameraRenderTargetPool != nullptr);
+  CameraRenderTargetPool->SetCapacity(CarlaSettings->CameraRenderTargetPoolSize);
+  if (!HasAnyFlags(RF_ClassDefaultObject)) {
+    FStartupProfiler::Mark(TEXT("settings_loaded"));
+    // Before the first level is loaded, its physics scenes are created with
+    // it.
+    if (CarlaSettings->bAsyncPhysicsScene) {
+      UPhysicsSettings::Get()->bEnableAsyncScene = true;
+    }
+    SetGPUMemoryBudgets(*CarlaSettings);
+  }
 }
 
 UCarlaGameInstance::~UCarlaGameInstance() {}
@@ -24,7 +66,10 @@ void UCarlaGameInstance::InitializeGameControllerIfNotPresent(
     const FMockGameControllerSettings &MockControllerSettings)
 {
   if (GameController == nullptr) {
-    if (CarlaSettings->bUseNetworking) {
+    if (!CarlaSettings->BatchJobFile.IsEmpty()) {
+      GameController = MakeUnique<BatchGameController>();
+      UE_LOG(LogCarla, Log, TEXT("Using batch CARLA controller"));
+    } else if (CarlaSettings->bUseNetworking) {
       GameController = MakeUnique<CarlaGameController>();
     } else {
       GameController = MakeUnique<MockGameController>(MockControllerSettings);
@@ -10,6 +10,7 @@
 #include "CarlaGameControllerBase.h"
 #include "CarlaGameInstance.generated.h"
 
+class UCameraRenderTargetPool;
 class UCarlaSettings;
 struct FMockGameControllerSettings;
 
@@ -47,6 +48,11 @@ public:
     return *CarlaSettings;
   }
 
+  UCameraRenderTargetPool *GetCameraRenderTargetPool()
+  {
+    return CameraRenderTargetPool;
+  }
+
   // Extra overload just for blueprints.
   UFUNCTION(BlueprintCallable)
   UCarlaSettings *GetCARLASettings()
@@ -59,5 +65,8 @@ private:
   UPROPERTY(Category = "CARLA Settings", EditAnywhere)
   UCarlaSettings *CarlaSettings;
 
+  UPROPERTY()
+  UCameraRenderTargetPool *CameraRenderTargetPool;
+
   TUniquePtr<CarlaGameControllerBase> GameController;
 };
@@ -8,19 +8,125 @@
 #include "CarlaGameModeBase.h"
 
 #include "ConstructorHelpers.h"
+#include "Engine/GameViewportClient.h"
 #include "Engine/PlayerStartPIE.h"
 #include "EngineUtils.h"
 #include "GameFramework/PlayerStart.h"
+#include "Misc/App.h"
+#include "Misc/PackageName.h"
+#include "PhysicsEngine/PhysicsSettings.h"
 #include "SceneViewport.h"
+#include "WheeledVehicleMovementComponent.h"
 
+#include "AI/TrafficLightTimer.h"
 #include "CarlaGameInstance.h"
 #include "CarlaGameState.h"
 #include "CarlaHUD.h"
 #include "CarlaPlayerState.h"
 #include "CarlaVehicleController.h"
+#include "SceneCaptureCamera.h"
 #include "Settings/CarlaSettings.h"
 #include "Tagger.h"
 #include "TaggerDelegate.h"
+#include "Util/RandomEngine.h"
+#include "Util/StartupProfiler.h"
+#include "WorldSnapshot.h"
+
+// Set the time-step, a fixed one makes the simulation independent of the frame
+// rate of the machine, and the physics substeps of each frame.
+static void SetTimeStep(const UCarlaSettings &CarlaSettings)
+{
+  if (CarlaSettings.FixedDeltaSeconds > 0.0f) {
+    FApp::SetUseFixedTimeStep(true);
+    FApp::SetFixedDeltaTime(CarlaSettings.FixedDeltaSeconds);
+  } else {
+    FApp::SetUseFixedTimeStep(false);
+  }
+  // Read by the physics scene every frame. Same limits as the project
+  // settings.
+  auto *PhysicsSettings = UPhysicsSettings::Get();
+  check(PhysicsSettings != nullptr);
+  PhysicsSettings->bSubstepping = (CarlaSettings.PhysicsSubsteps > 1u);
+  PhysicsSettings->MaxSubsteps = FMath::Clamp(static_cast<int32>(CarlaSettings.PhysicsSubsteps), 1, 16);
+  PhysicsSettings->MaxSubstepDeltaTime = FMath::Max(CarlaSettings.MaxPhysicsSubstepDeltaSeconds, 0.0013f);
+  PhysicsSettings->bSubsteppingAsync = PhysicsSettings->bSubstepping && PhysicsSettings->bEnableAsyncScene;
+}
+
+// Move the simulated bodies of the level that are not part of a vehicle to the
+// async physics scene, see UCarlaSettings::bAsyncPhysicsScene.
+static void MoveBodiesToAsyncPhysicsScene(UWorld &World)
+{
+  if (!UPhysicsSettings::Get()->bEnableAsyncScene) {
+    UE_LOG(LogCarla, Warning, TEXT("The async physics scene is enabled for the levels loaded after the settings"));
+    return;
+  }
+  auto Count = 0;
+  for (TActorIterator<AActor> It(&World); It; ++It) {
+    if (It->FindComponentByClass<UWheeledVehicleMovementComponent>() != nullptr) {
+      continue;
+    }
+    TInlineComponentArray<UPrimitiveComponent *> Primitives(*It);
+    for (auto *Primitive : Primitives) {
+      if (Primitive->IsSimulatingPhysics() && !Primitive->BodyInstance.bUseAsyncScene) {
+        Primitive->BodyInstance.bUseAsyncScene = true;
+        Primitive->RecreatePhysicsState();
+        ++Count;
+      }
+    }
+  }
+  UE_LOG(LogCarla, Log, TEXT("Moved %d physics bodies to the async scene"), Count);
+}
+
+// Render the level once with a camera of each post-process effect, so their
+// shaders are compiled before the client connects rather than along the first
+// frames of the first episode. Only the first level of the process, the
+// shaders compiled stay in memory.
+static void PreWarmCameraShaders(UWorld &World)
+{
+  static bool bPreWarmed = false;
+  if (bPreWarmed) {
+    return;
+  }
+  bPreWarmed = true;
+  const double StartTime = FPlatformTime::Seconds();
+  const EPostProcessEffect Effects[] = {
+    EPostProcessEffect::SceneFinal,
+    EPostProcessEffect::Depth,
+    EPostProcessEffect::SemanticSegmentation
+  };
+  for (auto Effect : Effects) {
+    auto *Camera = World.SpawnActor<ASceneCaptureCamera>();
+    if (Camera == nullptr) {
+      UE_LOG(LogCarla, Warning, TEXT("Failed to spawn a camera to pre-warm the shaders"));
+      return;
+    }
+    Camera->SetPostProcessEffect(Effect);
+    Camera->CaptureSceneNow();
+    // Wait for the render thread, the render target goes with the camera.
+    FlushRenderingCommands();
+    Camera->Destroy();
+  }
+  UE_LOG(
+      LogCarla,
+      Log,
+      TEXT("Pre-warmed the shaders of %d post-process effects in %.3f s"),
+      static_cast<int32>(ARRAY_COUNT(Effects)),
+      FPlatformTime::Seconds() - StartTime);
+}
+
+// Keep the main viewport from rendering the world and drawing the HUD, only
+// the scene capture cameras render.
+static void SetUpHeadlessRendering(UWorld &World, APlayerController *Player)
+{
+  auto *Viewport = World.GetGameViewport();
+  if (Viewport != nullptr) {
+    Viewport->bDisableWorldRendering = true;
+  }
+  auto *HUD = (Player != nullptr ? Player->GetHUD() : nullptr);
+  if (HUD != nullptr) {
+    HUD->bShowHUD = false;
+  }
+}
 
 ACarlaGameModeBase::ACarlaGameModeBase(const FObjectInitializer& ObjectInitializer) :
   Super(ObjectInitializer),
@@ -29,6 +135,9 @@ ACarlaGameModeBase::ACarlaGameModeBase(const FObjectInitializer& ObjectInitializ
 {
   PrimaryActorTick.bCanEverTick = true;
   PrimaryActorTick.TickGroup = TG_PrePhysics;
+  // The game controller waits for the client to reconnect with the world
+  // paused, see UCarlaSettings::bPauseWhileDisconnected.
+  PrimaryActorTick.bTickEvenWhenPaused = true;
   bAllowTickBeforeBeginPlay = false;
 
   PlayerControllerClass = ACarlaVehicleController::StaticClass();
@@ -45,6 +154,7 @@ void ACarlaGameModeBase::InitGame(
     FString &ErrorMessage)
 {
   Super::InitGame(MapName, Options, ErrorMessage);
+  FStartupProfiler::Mark(TEXT("engine_initialized"));
 
   GameInstance = Cast<UCarlaGameInstance>(GetGameInstance());
   checkf(
@@ -70,11 +180,22 @@ void ACarlaGameModeBase::InitGame(
 #else
     CarlaSettings.LoadWeatherDescriptions(MapName);
 #endif // WITH_EDITOR
+    if (CarlaSettings.bPreWarmShaders) {
+      PreWarmCameraShaders(*GetWorld());
+      FStartupProfiler::Mark(TEXT("shaders_prewarmed"));
+    }
     GameController->Initialize(CarlaSettings);
+    if (!CarlaSettings.ResidentMaps.IsEmpty()) {
+      // Shown before the player is spawned, so it starts on the right map.
+      ResidentMaps.Load(*GetWorld(), CarlaSettings.ResidentMaps, CarlaSettings.ResidentMapsMemoryBudgetMB);
+      ShowResidentMap(CarlaSettings);
+    }
     CarlaSettings.ValidateWeatherId();
     CarlaSettings.LogSettings();
   }
 
+  SetTimeStep(CarlaSettings);
+
   // Set default pawn class.
   if (!CarlaSettings.PlayerVehicle.IsEmpty()) {
     auto Class = FindObject<UClass>(ANY_PACKAGE, *CarlaSettings.PlayerVehicle);
@@ -102,6 +223,8 @@ void ACarlaGameModeBase::InitGame(
   if (WalkerSpawnerClass != nullptr) {
     WalkerSpawner = GetWorld()->SpawnActor<AWalkerSpawnerBase>(WalkerSpawnerClass);
   }
+
+  TrafficLightTimer = GetWorld()->SpawnActor<ATrafficLightTimer>();
 }
 
 void ACarlaGameModeBase::RestartPlayer(AController* NewPlayer)
@@ -128,6 +251,7 @@ void ACarlaGameModeBase::RestartPlayer(AController* NewPlayer)
 void ACarlaGameModeBase::BeginPlay()
 {
   Super::BeginPlay();
+  FStartupProfiler::Mark(TEXT("level_loaded"));
 
   auto CarlaGameState = Cast<ACarlaGameState>(GameState);
   checkf(
@@ -146,57 +270,175 @@ void ACarlaGameModeBase::BeginPlay()
   if (CarlaSettings.bSemanticSegmentationEnabled) {
     TagActorsForSemanticSegmentation();
     TaggerDelegate->SetSemanticSegmentationEnabled();
+    FStartupProfiler::Mark(TEXT("actors_tagged"));
   }
 
-  // Change weather.
-  if (DynamicWeather != nullptr) {
+  if (CarlaSettings.bPreWarmWeatherPresets && (DynamicWeather != nullptr)) {
     const auto *Weather = CarlaSettings.GetActiveWeatherDescription();
-    if (Weather != nullptr) {
-      UE_LOG(LogCarla, Log, TEXT("Changing weather settings to \"%s\""), *Weather->Name);
-      DynamicWeather->SetWeatherDescription(*Weather);
-      DynamicWeather->RefreshWeather();
-    }
+    DynamicWeather->PreWarmPresets(
+        CarlaSettings.WeatherDescriptions,
+        (Weather != nullptr ? *Weather : DynamicWeather->GetWeatherDescription()));
   } else {
-    UE_LOG(LogCarla, Error, TEXT("Missing dynamic weather actor!"));
+    ApplyWeather(CarlaSettings);
   }
 
-  // Find road map.
-  TActorIterator<ACityMapGenerator> It(GetWorld());
-  URoadMap *RoadMap = (It ? It->GetRoadMap() : nullptr);
+  if (CarlaSettings.bHeadlessRendering) {
+    SetUpHeadlessRendering(*GetWorld(), PlayerController);
+  }
+
+  if (CarlaSettings.bAsyncPhysicsScene) {
+    MoveBodiesToAsyncPhysicsScene(*GetWorld());
+  }
+
+  SetUpRoadMap();
 
+  SetUpSpawners(CarlaSettings);
+
+  WorldStreamer.Reset(*GetWorld(), CarlaSettings.StreamingRadius, CarlaSettings.bStreamCollision);
+
+  if ((VehicleSpawner != nullptr) && (PlayerController != nullptr)) {
+    // Negative stream ids are never given to the spawned vehicles.
+    PlayerController->SetRandomEngine(VehicleSpawner->GetRandomEngine()->Fork(PlayerController, -1));
+  }
+
+  EpisodeGuid = FGuid::NewGuid();
+  GameController->BeginPlay();
+}
+
+void ACarlaGameModeBase::Tick(float DeltaSeconds)
+{
+  Super::Tick(DeltaSeconds);
   if (PlayerController != nullptr) {
-    PlayerController->SetRoadMap(RoadMap);
-  } else {
-    UE_LOG(LogCarla, Error, TEXT("Player controller is not a AWheeledVehicleAIController!"));
+    WorldStreamer.Tick(*PlayerController);
   }
+  GameController->Tick(DeltaSeconds);
+}
 
-  // Setup other vehicles.
-  if (VehicleSpawner != nullptr) {
-    VehicleSpawner->SetNumberOfVehicles(CarlaSettings.NumberOfVehicles);
-    VehicleSpawner->SetSeed(CarlaSettings.SeedVehicles);
-    VehicleSpawner->SetRoadMap(RoadMap);
-    if (PlayerController != nullptr) {
-      PlayerController->SetRandomEngine(VehicleSpawner->GetRandomEngine());
+void ACarlaGameModeBase::ResetEpisode(const FEpisodeChanges &InChanges)
+{
+  check(GameController != nullptr);
+  check(PlayerController != nullptr);
+  auto &CarlaSettings = GameInstance->GetCarlaSettings();
+  auto Changes = InChanges;
+  if (Changes.bMap && ShowResidentMap(CarlaSettings)) {
+    // The agents and the weather of the previous map are of no use.
+    Changes.bWeather = true;
+    Changes.bNonPlayerAgents = true;
+  }
+  CarlaSettings.ValidateWeatherId();
+  CarlaSettings.LogSettings();
+  if (Changes.bTimeStep) {
+    SetTimeStep(CarlaSettings);
+  }
+  // Everything is streamed in again, the player is about to move anywhere.
+  WorldStreamer.Reset(*GetWorld(), CarlaSettings.StreamingRadius, CarlaSettings.bStreamCollision);
+
+  // Remove the non-player agents first, so they do not occupy any start spot.
+  // If they are kept, the start spots they occupy are not offered.
+  if (Changes.bNonPlayerAgents) {
+    if (VehicleSpawner != nullptr) {
+      VehicleSpawner->DespawnVehicles();
+    }
+    if (WalkerSpawner != nullptr) {
+      WalkerSpawner->DespawnWalkers();
     }
-  } else {
-    UE_LOG(LogCarla, Error, TEXT("Missing vehicle spawner actor!"));
   }
 
-  // Setup walkers.
-  if (WalkerSpawner != nullptr) {
-    WalkerSpawner->SetNumberOfWalkers(CarlaSettings.NumberOfPedestrians);
-    WalkerSpawner->SetSeed(CarlaSettings.SeedPedestrians);
+  // The player is not in the way when the level is reloaded either, so the
+  // client gets the same start spots in both cases.
+  auto *Pawn = PlayerController->GetPawn();
+  if (Pawn != nullptr) {
+    Pawn->SetActorEnableCollision(false);
+  }
+  TArray<APlayerStart *> UnOccupiedStartPoints;
+  APlayerStart *StartSpot = FindUnOccupiedStartPoints(PlayerController, UnOccupiedStartPoints);
+  if (Pawn != nullptr) {
+    Pawn->SetActorEnableCollision(true);
+  }
+  if ((StartSpot == nullptr) && (UnOccupiedStartPoints.Num() > 0u)) {
+    StartSpot = GameController->ChoosePlayerStart(UnOccupiedStartPoints);
+  }
+  if (StartSpot != nullptr) {
+    PlayerController->ResetEpisode(StartSpot->GetActorTransform());
   } else {
-    UE_LOG(LogCarla, Error, TEXT("Missing walker spawner actor!"));
+    UE_LOG(LogCarla, Error, TEXT("No start spot found!"));
   }
 
+  if (Changes.bWeather) {
+    ApplyWeather(CarlaSettings);
+  }
+
+  // Same order as at begin play, the player shares the random engine of the
+  // vehicle spawner.
+  if (Changes.bNonPlayerAgents) {
+    SetUpSpawners(CarlaSettings);
+    if (VehicleSpawner != nullptr) {
+      VehicleSpawner->SpawnVehicles();
+    }
+    if (WalkerSpawner != nullptr) {
+      WalkerSpawner->SpawnWalkersAtBeginPlay();
+    }
+  }
+
+  EpisodeGuid = FGuid::NewGuid();
   GameController->BeginPlay();
 }
 
-void ACarlaGameModeBase::Tick(float DeltaSeconds)
+FString ACarlaGameModeBase::GetMapName() const
 {
-  Super::Tick(DeltaSeconds);
-  GameController->Tick(DeltaSeconds);
+  const auto &VisibleMap = ResidentMaps.GetVisibleMap();
+  return (VisibleMap.IsEmpty() ? UWorld::RemovePIEPrefix(GetWorld()->GetMapName()) : VisibleMap);
+}
+
+bool ACarlaGameModeBase::CanShowMapInPlace(const FString &MapName) const
+{
+  return
+      MapName.IsEmpty() ||
+      (FPackageName::GetShortName(MapName) == GetMapName()) ||
+      ResidentMaps.Contains(MapName);
+}
+
+bool ACarlaGameModeBase::IsPreWarmingWeather() const
+{
+  return (DynamicWeather != nullptr) && DynamicWeather->IsPreWarming();
+}
+
+static FWorldSnapshot::FContext MakeSnapshotContext(
+    ACarlaVehicleController *PlayerController,
+    AVehicleSpawnerBase *VehicleSpawner,
+    AWalkerSpawnerBase *WalkerSpawner,
+    ATrafficLightTimer *TrafficLightTimer,
+    const FGuid &EpisodeGuid)
+{
+  FWorldSnapshot::FContext Context;
+  Context.Player = PlayerController;
+  Context.VehicleSpawner = VehicleSpawner;
+  Context.WalkerSpawner = WalkerSpawner;
+  Context.TrafficLightTimer = TrafficLightTimer;
+  Context.Episode = EpisodeGuid;
+  return Context;
+}
+
+void ACarlaGameModeBase::SaveWorldSnapshot(TArray<uint8> &Data)
+{
+  FWorldSnapshot::Save(
+      MakeSnapshotContext(PlayerController, VehicleSpawner, WalkerSpawner, TrafficLightTimer, EpisodeGuid),
+      Data);
+}
+
+bool ACarlaGameModeBase::RestoreWorldSnapshot(const TArray<uint8> &Data)
+{
+  return FWorldSnapshot::Restore(
+      MakeSnapshotContext(PlayerController, VehicleSpawner, WalkerSpawner, TrafficLightTimer, EpisodeGuid),
+      Data);
+}
+
+void ACarlaGameModeBase::PrepareEpisode(const UCarlaSettings &QueuedSettings)
+{
+  // The vehicles parked now are taken from the pool instead of spawned.
+  if (VehicleSpawner != nullptr) {
+    VehicleSpawner->PrepareVehiclePool(static_cast<int32>(QueuedSettings.NumberOfVehicles));
+  }
 }
 
 void ACarlaGameModeBase::RegisterPlayer(AController &NewPlayer)
@@ -224,12 +466,109 @@ void ACarlaGameModeBase::AttachCaptureCamerasToPlayer()
   for (const auto &Item : Settings.CameraDescriptions) {
     PlayerController->AddSceneCaptureCamera(Item.Value, OverridePostProcessParameters);
   }
+  for (const auto &Item : Settings.LidarDescriptions) {
+    PlayerController->AddRayCastLidar(Item.Value);
+  }
 }
 
 void ACarlaGameModeBase::TagActorsForSemanticSegmentation()
 {
   check(GetWorld() != nullptr);
-  ATagger::TagActorsInLevel(*GetWorld(), true);
+  check(TaggerDelegate != nullptr);
+  TaggerDelegate->TagActorsInLevel(*GetWorld(), true);
+}
+
+void ACarlaGameModeBase::ApplyWeather(const UCarlaSettings &CarlaSettings)
+{
+  if (DynamicWeather != nullptr) {
+    const auto *Weather = CarlaSettings.GetActiveWeatherDescription();
+    if (Weather != nullptr) {
+      UE_LOG(LogCarla, Log, TEXT("Changing weather settings to \"%s\""), *Weather->Name);
+      DynamicWeather->ApplyWeatherDescription(*Weather);
+    }
+  } else {
+    UE_LOG(LogCarla, Error, TEXT("Missing dynamic weather actor!"));
+  }
+}
+
+void ACarlaGameModeBase::SetUpRoadMap()
+{
+  TActorIterator<ACityMapGenerator> It(GetWorld());
+  URoadMap *RoadMap = (It ? It->GetRoadMap() : nullptr);
+  ULaneGraph *LaneGraph = (It ? It->GetLaneGraph() : nullptr);
+
+  if (PlayerController != nullptr) {
+    PlayerController->SetRoadMap(RoadMap);
+    PlayerController->SetLaneGraph(LaneGraph);
+  } else {
+    UE_LOG(LogCarla, Error, TEXT("Player controller is not a AWheeledVehicleAIController!"));
+  }
+
+  if (VehicleSpawner != nullptr) {
+    VehicleSpawner->SetRoadMap(RoadMap);
+    VehicleSpawner->SetLaneGraph(LaneGraph);
+  }
+}
+
+bool ACarlaGameModeBase::ShowResidentMap(UCarlaSettings &CarlaSettings)
+{
+  if (ResidentMaps.IsEmpty()) {
+    return false;
+  }
+  // Without a map requested the first resident one is shown at start.
+  const FString MapName = (CarlaSettings.MapName.IsEmpty() && ResidentMaps.GetVisibleMap().IsEmpty() ?
+      ResidentMaps.GetDefaultMap() :
+      CarlaSettings.MapName);
+  if (MapName.IsEmpty() ||
+      (FPackageName::GetShortName(MapName) == ResidentMaps.GetVisibleMap()) ||
+      !ResidentMaps.Show(*GetWorld(), MapName)) {
+    return false;
+  }
+  CarlaSettings.LoadWeatherDescriptions(ResidentMaps.GetVisibleMap());
+  if (!HasActorBegunPlay()) {
+    // The rest is gathered at begin play.
+    return true;
+  }
+  SetUpRoadMap();
+  if (VehicleSpawner != nullptr) {
+    VehicleSpawner->FindSpawnPoints();
+  }
+  if (WalkerSpawner != nullptr) {
+    WalkerSpawner->FindSpawnPoints();
+  }
+  if (TrafficLightTimer != nullptr) {
+    TrafficLightTimer->FindTrafficLights();
+  }
+  if (CarlaSettings.bSemanticSegmentationEnabled) {
+    TagActorsForSemanticSegmentation();
+  }
+  return true;
+}
+
+void ACarlaGameModeBase::SetUpSpawners(const UCarlaSettings &CarlaSettings)
+{
+  // Setup other vehicles.
+  if (VehicleSpawner != nullptr) {
+    VehicleSpawner->SetNumberOfVehicles(CarlaSettings.NumberOfVehicles);
+    VehicleSpawner->SetSeed(CarlaSettings.SeedVehicles);
+    VehicleSpawner->SetMaxSpawnsPerFrame(CarlaSettings.MaxSpawnsPerFrame);
+    VehicleSpawner->SetRestStoppedVehicles(CarlaSettings.bRestStoppedVehicles);
+  } else {
+    UE_LOG(LogCarla, Error, TEXT("Missing vehicle spawner actor!"));
+  }
+
+  // Setup walkers.
+  if (WalkerSpawner != nullptr) {
+    WalkerSpawner->SetNumberOfWalkers(CarlaSettings.NumberOfPedestrians);
+    WalkerSpawner->SetSeed(CarlaSettings.SeedPedestrians);
+    WalkerSpawner->SetMaxSpawnsPerFrame(CarlaSettings.MaxSpawnsPerFrame);
+    WalkerSpawner->SetCrowdBudget(
+        CarlaSettings.MaxCrowdPedestrians,
+        CarlaSettings.CrowdQueryRange,
+        CarlaSettings.CrowdHighQualityDistance);
+  } else {
+    UE_LOG(LogCarla, Error, TEXT("Missing walker spawner actor!"));
+  }
 }
 
 APlayerStart *ACarlaGameModeBase::FindUnOccupiedStartPoints(
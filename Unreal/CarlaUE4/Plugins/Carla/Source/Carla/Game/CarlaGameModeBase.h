@@ -12,13 +12,33 @@
 #include "CarlaGameControllerBase.h"
 #include "DynamicWeather.h"
 #include "MockGameControllerSettings.h"
+#include "ResidentMaps.h"
+#include "WorldCellStreamer.h"
 #include "CarlaGameModeBase.generated.h"
 
 class ACarlaVehicleController;
 class APlayerStart;
 class ASceneCaptureCamera;
+class ATrafficLightTimer;
+class UCarlaSettings;
 class UTaggerDelegate;
 
+/// What an in-place episode reset reconfigures, see
+/// UCarlaSettings::bDeltaEpisodeReset. Everything by default.
+struct FEpisodeChanges
+{
+  bool bWeather = true;
+
+  bool bTimeStep = true;
+
+  /// If false, the non-player agents are not spawned again.
+  bool bNonPlayerAgents = true;
+
+  /// If true, the resident map requested is shown first, see FResidentMaps.
+  /// Nothing of the previous map is kept then.
+  bool bMap = true;
+};
+
 /**
  *
  */
@@ -39,6 +59,37 @@ public:
 
   virtual void Tick(float DeltaSeconds) override;
 
+  /// Start a new episode without reloading the level. The non-player agents
+  /// are spawned again, the weather is re-applied and the player is moved to
+  /// the start spot chosen by the client. The player and its cameras are kept
+  /// as they are.
+  ///
+  /// Only the subsystems set in @a Changes are reconfigured, the player is
+  /// moved to its start spot in any case.
+  void ResetEpisode(const FEpisodeChanges &Changes = FEpisodeChanges());
+
+  /// Prepare the next episode, queued by the client, while the current one
+  /// runs, so its in-place reset has less to do. The current episode is not
+  /// altered.
+  void PrepareEpisode(const UCarlaSettings &QueuedSettings);
+
+  /// Name of the map shown, the resident one if any.
+  FString GetMapName() const;
+
+  /// Whether an episode in @a MapName can start without loading a map.
+  bool CanShowMapInPlace(const FString &MapName) const;
+
+  /// Whether the weather presets are still being pre-warmed, see
+  /// UCarlaSettings::bPreWarmWeatherPresets.
+  bool IsPreWarmingWeather() const;
+
+  /// Take a snapshot of the current episode into @a Data, see FWorldSnapshot.
+  void SaveWorldSnapshot(TArray<uint8> &Data);
+
+  /// Restore a snapshot taken in the current episode. Returns false, leaving
+  /// the world untouched, if it belongs to another episode.
+  bool RestoreWorldSnapshot(const TArray<uint8> &Data);
+
 protected:
 
   /** Used only when networking is disabled. */
@@ -65,6 +116,20 @@ private:
 
   void TagActorsForSemanticSegmentation();
 
+  void ApplyWeather(const UCarlaSettings &CarlaSettings);
+
+  /// Give the road map and lane graph of the map shown to the player and the
+  /// vehicle spawner.
+  void SetUpRoadMap();
+
+  /// Show the resident map requested in @a CarlaSettings and gather again
+  /// what the level holds. Returns false if the map shown did not change.
+  bool ShowResidentMap(UCarlaSettings &CarlaSettings);
+
+  /// Set the number of non-player agents and the seeds, the spawners spawn
+  /// them afterwards.
+  void SetUpSpawners(const UCarlaSettings &CarlaSettings);
+
   /// Iterate all the APlayerStart present in the world and add the ones with
   /// unoccupied locations to @a UnOccupiedStartPoints.
   ///
@@ -92,4 +157,14 @@ private:
 
   UPROPERTY()
   AWalkerSpawnerBase *WalkerSpawner;
+
+  UPROPERTY()
+  ATrafficLightTimer *TrafficLightTimer;
+
+  /// New on every episode, so snapshots of other episodes are rejected.
+  FGuid EpisodeGuid;
+
+  FWorldCellStreamer WorldStreamer;
+
+  FResidentMaps ResidentMaps;
 };
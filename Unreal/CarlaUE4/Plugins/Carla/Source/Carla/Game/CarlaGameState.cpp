@@ -7,6 +7,41 @@
 #include "Carla.h"
 #include "CarlaGameState.h"
 
+uint32 ACarlaGameState::RegisterAgent(AActor &Agent, const EAgentType Type)
+{
+  Agent.OnDestroyed.AddUniqueDynamic(this, &ACarlaGameState::OnAgentDestroyed);
+  return AgentRegistry.Register(Agent, Type);
+}
 
+void ACarlaGameState::DeregisterAgent(AActor &Agent)
+{
+  Agent.OnDestroyed.RemoveDynamic(this, &ACarlaGameState::OnAgentDestroyed);
+  AgentRegistry.Deregister(Agent);
+}
 
+const FAgentGrid &ACarlaGameState::GetObstacleGrid()
+{
+  if (ObstacleGridFrame != GFrameCounter) {
+    ObstacleGridFrame = GFrameCounter;
+    ObstacleGrid.Rebuild(
+        AgentRegistry.GetAgents(),
+        FAgentGrid::GetTypeBit(EAgentType::Vehicle) | FAgentGrid::GetTypeBit(EAgentType::Walker));
+    // The players are not in the registry, but the vehicles stop behind them
+    // too.
+    for (auto It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+      const APlayerController *Controller = It->Get();
+      const APawn *Pawn = (Controller != nullptr ? Controller->GetPawn() : nullptr);
+      if (Pawn != nullptr) {
+        ObstacleGrid.AddLocation(Pawn->GetActorLocation());
+      }
+    }
+  }
+  return ObstacleGrid;
+}
 
+void ACarlaGameState::OnAgentDestroyed(AActor *Agent)
+{
+  if (Agent != nullptr) {
+    AgentRegistry.Deregister(*Agent);
+  }
+}
@@ -10,6 +10,8 @@
 #include "AI/TrafficSignBase.h"
 #include "AI/VehicleSpawnerBase.h"
 #include "AI/WalkerSpawnerBase.h"
+#include "Game/AgentGrid.h"
+#include "Game/AgentRegistry.h"
 #include "CarlaGameState.generated.h"
 
 UCLASS()
@@ -37,10 +39,39 @@ public:
   void RegisterTrafficSign(ATrafficSignBase *TrafficSign)
   {
     TrafficSigns.Add(TrafficSign);
+    if (TrafficSign != nullptr) {
+      RegisterAgent(*TrafficSign, EAgentType::TrafficSign);
+    }
   }
 
+  /** Every non-player agent of the level. */
+  const FAgentRegistry &GetAgentRegistry() const
+  {
+    return AgentRegistry;
+  }
+
+  /** Grid of the vehicles, the walkers and the players' pawns, rebuilt at
+    * most once per frame. Finds the agent ahead of a vehicle without any
+    * physics query, see FAgentGrid::FindLeadAgent. Game thread only, the grid
+    * returned may be read from any thread until the next frame.
+    */
+  const FAgentGrid &GetObstacleGrid();
+
+  /** Register a non-player agent, it is deregistered automatically when
+    * destroyed. Returns its id.
+    */
+  uint32 RegisterAgent(AActor &Agent, EAgentType Type);
+
+  /** Deregister a non-player agent that is taken out of the simulation
+    * without being destroyed. If registered again, it gets a new id.
+    */
+  void DeregisterAgent(AActor &Agent);
+
 private:
 
+  UFUNCTION()
+  void OnAgentDestroyed(AActor *Agent);
+
   friend class ACarlaGameModeBase;
 
   UPROPERTY()
@@ -51,4 +82,11 @@ private:
 
   UPROPERTY()
   TArray<ATrafficSignBase *> TrafficSigns;
+
+  FAgentRegistry AgentRegistry;
+
+  /** Cells about the length of the corridor ahead of a vehicle. */
+  FAgentGrid ObstacleGrid{2000.0f};
+
+  uint64 ObstacleGridFrame = MAX_uint64;
 };
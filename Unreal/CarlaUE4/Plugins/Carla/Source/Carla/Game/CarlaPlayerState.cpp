@@ -7,14 +7,12 @@
 #include "Carla.h"
 #include "CarlaPlayerState.h"
 
+#include "Tagger.h"
+
 void ACarlaPlayerState::Reset()
 {
   Super::Reset();
-  // Reset incremental values.
-  GameTimeStamp = 0.0f;
-  CollisionIntensityCars = 0.0f;
-  CollisionIntensityPedestrians = 0.0f;
-  CollisionIntensityOther = 0.0f;
+  ResetIncrementalValues();
   Images.Empty();
 }
 
@@ -45,27 +43,93 @@ void ACarlaPlayerState::CopyProperties(APlayerState *PlayerState)
       OtherLaneIntersectionFactor = Other->OtherLaneIntersectionFactor;
       OffRoadIntersectionFactor = Other->OffRoadIntersectionFactor;
       Images = Other->Images;
+      EpisodeSummary = Other->EpisodeSummary;
       UE_LOG(LogCarla, Log, TEXT("Copied properties of ACarlaPlayerState"));
     }
   }
 }
 
+FEpisodeSummary ACarlaPlayerState::GetEpisodeSummary() const
+{
+  FEpisodeSummary Summary = EpisodeSummary;
+  Summary.GameTimeStamp = GameTimeStamp;
+  Summary.CollisionIntensityCars = CollisionIntensityCars;
+  Summary.CollisionIntensityPedestrians = CollisionIntensityPedestrians;
+  Summary.CollisionIntensityOther = CollisionIntensityOther;
+  return Summary;
+}
+
+void ACarlaPlayerState::ResetIncrementalValues()
+{
+  GameTimeStamp = 0.0f;
+  ForwardSpeed = 0.0f;
+  Acceleration = FVector::ZeroVector;
+  CollisionIntensityCars = 0.0f;
+  CollisionIntensityPedestrians = 0.0f;
+  CollisionIntensityOther = 0.0f;
+  OtherLaneIntersectionFactor = 0.0f;
+  OffRoadIntersectionFactor = 0.0f;
+  PendingCollisions.Reset();
+  CollisionEvents.Reset();
+  EpisodeSummary = FEpisodeSummary();
+  bCollidedLastFrame = false;
+}
+
 void ACarlaPlayerState::RegisterCollision(
     AActor * /*Actor*/,
-    AActor * /*OtherActor*/,
+    AActor *OtherActor,
     const FVector &NormalImpulse,
     const FHitResult &Hit)
 {
-  switch (ATagger::GetTagOfTaggedComponent(*Hit.Component)) {
-    case ECityObjectLabel::Vehicles:
-      CollisionIntensityCars += NormalImpulse.Size();
-      break;
-    case ECityObjectLabel::Pedestrians:
-      CollisionIntensityPedestrians += NormalImpulse.Size();
-      break;
-    default:
-      CollisionIntensityOther += NormalImpulse.Size();
-      break;
+  auto &Pending = PendingCollisions.FindOrAdd(Hit.Component);
+  Pending.OtherActor = OtherActor;
+  Pending.NormalImpulse += NormalImpulse.Size();
+}
+
+void ACarlaPlayerState::UpdateCollisions()
+{
+  CollisionEvents.Reset();
+  for (const auto &Item : PendingCollisions) {
+    const auto *Component = Item.Key.Get();
+    const auto Label = (Component != nullptr ?
+        ATagger::GetTagOfTaggedComponent(*Component) :
+        ECityObjectLabel::None);
+    const float NormalImpulse = Item.Value.NormalImpulse;
+    switch (Label) {
+      case ECityObjectLabel::Vehicles:
+        CollisionIntensityCars += NormalImpulse;
+        break;
+      case ECityObjectLabel::Pedestrians:
+        CollisionIntensityPedestrians += NormalImpulse;
+        break;
+      default:
+        CollisionIntensityOther += NormalImpulse;
+        break;
+    }
+    CollisionEvents.Add({Item.Value.OtherActor, Label, NormalImpulse});
+  }
+  PendingCollisions.Reset();
+}
+
+void ACarlaPlayerState::UpdateEpisodeSummary(
+    const float DeltaSeconds,
+    const FVector &PreviousLocation)
+{
+  // In the first frame the previous location is not that of this episode.
+  if (EpisodeSummary.NumberOfFrames > 0u) {
+    EpisodeSummary.DistanceTraveled += FVector::Dist(PreviousLocation, GetLocation());
+  }
+  ++EpisodeSummary.NumberOfFrames;
+  if ((CollisionEvents.Num() > 0) && !bCollidedLastFrame) {
+    ++EpisodeSummary.NumberOfCollisions;
+  }
+  bCollidedLastFrame = (CollisionEvents.Num() > 0);
+  EpisodeSummary.SecondsOffRoad += OffRoadIntersectionFactor * DeltaSeconds;
+  EpisodeSummary.SecondsOnOtherLane += OtherLaneIntersectionFactor * DeltaSeconds;
+  // Forward speed in cm/s, speed limit in km/h.
+  constexpr float ToKilometersPerHour = 0.036f;
+  if ((SpeedLimit > 0.0f) && (FMath::Abs(ForwardSpeed) * ToKilometersPerHour > SpeedLimit)) {
+    EpisodeSummary.SecondsOverSpeedLimit += DeltaSeconds;
   }
 }
 
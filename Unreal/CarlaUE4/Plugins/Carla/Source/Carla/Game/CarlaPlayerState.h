@@ -11,6 +11,53 @@
 #include "CapturedImage.h"
 #include "CarlaPlayerState.generated.h"
 
+enum class ECityObjectLabel : uint8;
+
+/// Hits of the player against a component of another actor during a frame,
+/// aggregated.
+struct FCollisionEvent
+{
+  /// Only used as a key, the actor may have been destroyed.
+  const AActor *OtherActor;
+
+  ECityObjectLabel Label;
+
+  /// Sum of the normal impulses of the hits.
+  float NormalImpulse;
+};
+
+/// Totals of the player over the current episode, accumulated every frame.
+/// They summarize the episode for benchmarks without reading every frame, see
+/// ACarlaPlayerState::GetEpisodeSummary.
+struct FEpisodeSummary
+{
+  uint32 NumberOfFrames = 0u;
+
+  /// Game time of the episode, in milliseconds.
+  int32 GameTimeStamp = 0;
+
+  /// In centimeters.
+  float DistanceTraveled = 0.0f;
+
+  /// Each run of consecutive frames with collisions counts once.
+  uint32 NumberOfCollisions = 0u;
+
+  /// Weighted by the fraction of the vehicle off-road, see
+  /// GetOffRoadIntersectionFactor.
+  float SecondsOffRoad = 0.0f;
+
+  /// Weighted by the fraction of the vehicle on the other lane.
+  float SecondsOnOtherLane = 0.0f;
+
+  float SecondsOverSpeedLimit = 0.0f;
+
+  float CollisionIntensityCars = 0.0f;
+
+  float CollisionIntensityPedestrians = 0.0f;
+
+  float CollisionIntensityOther = 0.0f;
+};
+
 /// Current state of the player, updated every frame by ACarlaVehicleController.
 ///
 /// This class matches the reward that it is sent to the client over the
@@ -165,6 +212,12 @@ public:
     return CollisionIntensityOther;
   }
 
+  /// Collisions of the last frame, one per component hit.
+  const TArray<FCollisionEvent> &GetCollisionEvents() const
+  {
+    return CollisionEvents;
+  }
+
   /// @}
   // ===========================================================================
   /// @name Road intersection
@@ -183,6 +236,16 @@ public:
     return OffRoadIntersectionFactor;
   }
 
+  /// @}
+  // ===========================================================================
+  /// @name Episode summary
+  // ===========================================================================
+  /// @{
+
+  /// Totals of the episode so far, the collision intensities and the time
+  /// stamp are the current ones.
+  FEpisodeSummary GetEpisodeSummary() const;
+
   /// @}
   // ===========================================================================
   /// @name Images
@@ -212,14 +275,30 @@ public:
   // ===========================================================================
 private:
 
+  /// Reset the values accumulated during the episode. Unlike Reset, the
+  /// images are kept since the cameras do not change.
+  void ResetIncrementalValues();
+
+  /// Accumulate a hit, may be called many times per frame during sustained
+  /// contact. The hits are classified in UpdateCollisions.
   void RegisterCollision(
       AActor *Actor,
       AActor *OtherActor,
       const FVector &NormalImpulse,
       const FHitResult &Hit);
 
+  /// Classify the hits accumulated since the last call, once per component,
+  /// add them to the collision intensities and make them the collision
+  /// events of this frame.
+  void UpdateCollisions();
+
   void UpdateTimeStamp(float DeltaSeconds);
 
+  /// Add the last frame to the episode summary, once the rest of the state
+  /// is updated. @a PreviousLocation is the location of the player in the
+  /// frame before.
+  void UpdateEpisodeSummary(float DeltaSeconds, const FVector &PreviousLocation);
+
   // ===========================================================================
   // -- Private members --------------------------------------------------------
   // ===========================================================================
@@ -286,4 +365,20 @@ private:
 
   UPROPERTY(VisibleAnywhere)
   TArray<FCapturedImage> Images;
+
+  struct FPendingCollision
+  {
+    const AActor *OtherActor = nullptr;
+
+    float NormalImpulse = 0.0f;
+  };
+
+  /// Hits accumulated by component since the last UpdateCollisions.
+  TMap<TWeakObjectPtr<UPrimitiveComponent>, FPendingCollision> PendingCollisions;
+
+  TArray<FCollisionEvent> CollisionEvents;
+
+  FEpisodeSummary EpisodeSummary;
+
+  bool bCollidedLastFrame = false;
 };
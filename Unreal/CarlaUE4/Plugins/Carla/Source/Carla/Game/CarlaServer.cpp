@@ -7,16 +7,56 @@
 #include "Carla.h"
 #include "CarlaServer.h"
 
+#include "Async/ParallelFor.h"
 #include "GameFramework/PlayerStart.h"
+#include "RHI.h"
+#include "RenderCore.h"
 
+#include "AI/TrafficManager.h"
+#include "AI/VehicleSpawnerBase.h"
+#include "AI/WalkerSpawnerBase.h"
+#include "AgentBoxProjector.h"
+#include "CarlaGameState.h"
 #include "CarlaPlayerState.h"
 #include "CarlaVehicleController.h"
 #include "CarlaWheeledVehicle.h"
+#include "ClassHistogram.h"
+#include "MapGen/RoadMap.h"
+#include "RayCastLidar.h"
 #include "SceneCaptureCamera.h"
 #include "Settings/CarlaSettings.h"
+#include "Util/FrameArena.h"
+#include "Util/FrameTaskGraph.h"
+#include "Util/ThreadAffinity.h"
 
 #include <carla/carla_server.h>
 
+static_assert(ImageEncoding::ToUInt(EImageEncoding::BGRA8) == CARLA_SERVER_IMAGE_BGRA8, "Image encodings mismatch");
+static_assert(ImageEncoding::ToUInt(EImageEncoding::Float32) == CARLA_SERVER_IMAGE_FLOAT32, "Image encodings mismatch");
+static_assert(ImageEncoding::ToUInt(EImageEncoding::Float16) == CARLA_SERVER_IMAGE_FLOAT16, "Image encodings mismatch");
+static_assert(ImageEncoding::ToUInt(EImageEncoding::Gray8) == CARLA_SERVER_IMAGE_GRAY8, "Image encodings mismatch");
+static_assert(ImageEncoding::ToUInt(EImageEncoding::BGR8) == CARLA_SERVER_IMAGE_BGR8, "Image encodings mismatch");
+static_assert(ImageEncoding::ToUInt(EImageEncoding::PointsXYZL) == CARLA_SERVER_IMAGE_POINTS_XYZL, "Image encodings mismatch");
+static_assert(ImageEncoding::ToUInt(EImageEncoding::GPUShared) == CARLA_SERVER_IMAGE_GPU_SHARED, "Image encodings mismatch");
+static_assert(ImageEncoding::ToUInt(EImageEncoding::MotionVectors) == CARLA_SERVER_IMAGE_MOTION_VECTORS, "Image encodings mismatch");
+static_assert(ImageCompression::ToUInt(EImageCompression::None) == CARLA_SERVER_IMAGE_COMPRESSION_NONE, "Image compressions mismatch");
+static_assert(ImageCompression::ToUInt(EImageCompression::LZ4) == CARLA_SERVER_IMAGE_COMPRESSION_LZ4, "Image compressions mismatch");
+static_assert(ImageCompression::ToUInt(EImageCompression::Delta) == CARLA_SERVER_IMAGE_COMPRESSION_DELTA, "Image compressions mismatch");
+static_assert(AgentsEncoding::ToUInt(EAgentsEncoding::Float32) == CARLA_SERVER_AGENTS_FLOAT32, "Agents encodings mismatch");
+static_assert(AgentsEncoding::ToUInt(EAgentsEncoding::Quantized) == CARLA_SERVER_AGENTS_QUANTIZED, "Agents encodings mismatch");
+static_assert(AgentsEncoding::ToUInt(EAgentsEncoding::QuantizedDelta) == CARLA_SERVER_AGENTS_QUANTIZED_DELTA, "Agents encodings mismatch");
+static_assert(AgentsEncoding::ToUInt(EAgentsEncoding::HalfFloat) == CARLA_SERVER_AGENTS_HALF_FLOAT, "Agents encodings mismatch");
+
+DECLARE_CYCLE_STAT(TEXT("Send Measurements"), STAT_CarlaSendMeasurements, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Get Agent Info"), STAT_CarlaGetAgentInfo, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Intersect Agents With Road Map"), STAT_CarlaIntersectAgentsWithRoadMap, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Read Camera Pixels"), STAT_CarlaReadCameraPixels, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Read Control"), STAT_CarlaReadControl, STATGROUP_Carla);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Agents Sent"), STAT_CarlaAgentsSent, STATGROUP_Carla);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Images Sent"), STAT_CarlaImagesSent, STATGROUP_Carla);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Agent Boxes Sent"), STAT_CarlaAgentBoxesSent, STATGROUP_Carla);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Class Histograms Sent"), STAT_CarlaClassHistogramsSent, STATGROUP_Carla);
+
 // =============================================================================
 // -- Static local methods -----------------------------------------------------
 // =============================================================================
@@ -62,23 +102,63 @@ static inline void Set(carla_transform &lhs, const FTransform &rhs)
   Set(lhs.orientation, rhs.GetRotation().GetForwardVector());
 }
 
-static void Set(carla_image &cImage, const FCapturedImage &uImage)
+static void Set(carla_image &cImage, const ASceneCaptureCamera &Camera, const uint32 CameraIndex)
 {
-  if (uImage.BitMap.Num() > 0) {
-    cImage.width = uImage.SizeX;
-    cImage.height = uImage.SizeY;
-    cImage.type = PostProcessEffect::ToUInt(uImage.PostProcessEffect);
-    cImage.data = &uImage.BitMap.GetData()->DWColor();
-
+  cImage.width = Camera.GetOutputSizeX();
+  cImage.height = Camera.GetOutputSizeY();
+  cImage.type = PostProcessEffect::ToUInt(Camera.GetPostProcessEffect());
+  cImage.data = nullptr;
+  cImage.frame_number = GFrameCounter;
+  cImage.camera_index = CameraIndex;
+  cImage.encoding = ImageEncoding::ToUInt(Camera.GetImageEncoding());
+  cImage.compression = ImageCompression::ToUInt(Camera.GetImageCompression());
+  cImage.key_frame_interval = Camera.GetImageKeyFrameInterval();
+  cImage.row_pitch = 0u;
+  cImage.screen_percentage = FMath::RoundToInt(Camera.GetImageScreenPercentage());
+  uint64 FrameNumber;
+  if (Camera.IsAsyncReadback() && Camera.PeekPixelsAsync(FrameNumber)) {
+    cImage.frame_number = FrameNumber;
+  }
 #ifdef CARLA_SERVER_EXTRA_LOG
-    {
-      const auto Size = uImage.BitMap.Num();
-      UE_LOG(LogCarlaServer, Log, TEXT("Sending image %dx%d (%d) type %d"), cImage.width, cImage.height, Size, cImage.type);
-    }
-  } else {
-    UE_LOG(LogCarlaServer, Warning, TEXT("Sending empty image"));
+  UE_LOG(LogCarlaServer, Log, TEXT("Sending image %dx%d type %d"), cImage.width, cImage.height, cImage.type);
 #endif // CARLA_SERVER_EXTRA_LOG
-  }
+}
+
+// The image of a camera sharing its render target is a single
+// carla_gpu_shared_image.
+static void SetGpuShared(carla_image &cImage)
+{
+  cImage.width = 1u;
+  cImage.height = 1u;
+  cImage.encoding = CARLA_SERVER_IMAGE_GPU_SHARED;
+  cImage.compression = CARLA_SERVER_IMAGE_COMPRESSION_NONE;
+}
+
+static void Set(carla_gpu_shared_image &cImage, const FSharedRenderTargetFrame &Frame)
+{
+  cImage.handle = Frame.Handle;
+  cImage.width = Frame.Width;
+  cImage.height = Frame.Height;
+  cImage.format = Frame.Format;
+  cImage.slot = Frame.Slot;
+}
+
+/// Image type of the point clouds, after the post-process effects.
+static constexpr uint32 LIDAR_IMAGE_TYPE = 4u;
+
+// The points of a LiDAR are sent as an image one point high, its index
+// follows the indices of the cameras.
+static void Set(carla_image &cImage, const ARayCastLidar &Lidar, const uint32 SensorIndex)
+{
+  cImage.width = Lidar.GetNumberOfPoints();
+  cImage.height = 1u;
+  cImage.type = LIDAR_IMAGE_TYPE;
+  cImage.data = nullptr;
+  cImage.frame_number = GFrameCounter;
+  cImage.camera_index = SensorIndex;
+  cImage.encoding = CARLA_SERVER_IMAGE_POINTS_XYZL;
+  cImage.compression = CARLA_SERVER_IMAGE_COMPRESSION_NONE;
+  cImage.row_pitch = 0u;
 }
 
 static void SetBoxSpeedAndType(carla_agent &values, const ACharacter *Walker)
@@ -164,12 +244,61 @@ CarlaServer::~CarlaServer()
   carla_free_server(Server);
 }
 
+void CarlaServer::SetSocketOptions(const UCarlaSettings &Settings)
+{
+  carla_socket_options Options;
+  Options.no_delay = Settings.bTCPNoDelay;
+  Options.reuse_address = Settings.bTCPReuseAddress;
+  Options.send_buffer_size = 0u;
+  Options.receive_buffer_size = 0u;
+  carla_set_socket_options(Server, CARLA_SERVER_SOCKET_WORLD, Options);
+  Options.send_buffer_size = Settings.MeasurementsSendBufferSize;
+  carla_set_socket_options(Server, CARLA_SERVER_SOCKET_MEASUREMENTS, Options);
+  Options.send_buffer_size = 0u;
+  Options.receive_buffer_size = Settings.ControlReceiveBufferSize;
+  carla_set_socket_options(Server, CARLA_SERVER_SOCKET_CONTROL, Options);
+  carla_set_liveness_timeout(Server, Settings.LivenessTimeOut);
+}
+
+void CarlaServer::SetThreadOptions(const UCarlaSettings &Settings)
+{
+  TArray<uint32> CPUs;
+  if (!FThreadAffinity::ParseCPUList(Settings.ServerThreadCPUs, CPUs)) {
+    UE_LOG(LogCarlaServer, Error, TEXT("Invalid server thread CPUs \"%s\""), *Settings.ServerThreadCPUs);
+    return;
+  }
+  if ((CPUs.Num() == 0) && (Settings.ServerThreadPriority == 0)) {
+    return;
+  }
+  carla_thread_options Options;
+  Options.cpus = CPUs.GetData();
+  Options.number_of_cpus = CPUs.Num();
+  Options.priority = Settings.ServerThreadPriority;
+  if (CARLA_SERVER_SUCCESS != carla_set_thread_options(Options)) {
+    UE_LOG(LogCarlaServer, Warning, TEXT("Failed to set the options of the server threads"));
+  }
+}
+
+void CarlaServer::SetBufferOptions(const UCarlaSettings &Settings)
+{
+  carla_buffer_options Options;
+  Options.huge_pages = Settings.bHugePageBuffers;
+  Options.numa_local = Settings.bNUMALocalBuffers;
+  carla_set_buffer_options(Options);
+}
+
 CarlaServer::ErrorCode CarlaServer::Connect()
 {
   UE_LOG(LogCarlaServer, Log, TEXT("Waiting for the client to connect..."));
   return ParseErrorCode(carla_server_connect(Server, WorldPort, TimeOut));
 }
 
+CarlaServer::ErrorCode CarlaServer::Listen()
+{
+  UE_LOG(LogCarlaServer, Log, TEXT("Waiting for the client to reconnect..."));
+  return ParseErrorCode(carla_server_connect_non_blocking(Server, WorldPort, TimeOut));
+}
+
 CarlaServer::ErrorCode CarlaServer::ReadNewEpisode(UCarlaSettings &Settings, const bool bBlocking)
 {
   carla_request_new_episode values;
@@ -180,17 +309,222 @@ CarlaServer::ErrorCode CarlaServer::ReadNewEpisode(UCarlaSettings &Settings, con
 #ifdef CARLA_SERVER_EXTRA_LOG
     UE_LOG(LogCarlaServer, Log, TEXT("Received CarlaSettings.ini:\n%s"), *IniFile);
 #endif // CARLA_SERVER_EXTRA_LOG
-    Settings.LoadSettingsFromString(IniFile);
+    // The settings only change if the client changed something, applying the
+    // same INI again on top of them would give the same settings.
+    if (IniFile != LastIniFile) {
+      Settings.LoadSettingsFromString(IniFile);
+      LastIniFile = MoveTemp(IniFile);
+    } else {
+      UE_LOG(LogCarlaServer, Log, TEXT("The settings did not change"));
+    }
+    PendingControls.Reset();
+    NextPendingControl = 0;
+    Observation = FObservationRequest();
+    SetEncodingOptions(Settings);
+    carla_set_persistent_agent_connections(Server, Settings.bPersistentAgentConnections);
+    carla_set_images_stream(
+        Server,
+        Settings.bSeparateImagesStream,
+        FMath::Max(2u, Settings.ImagesStreamBufferSize),
+        Settings.bImagesStreamDropOldest ? CARLA_SERVER_STREAM_DROP_OLDEST : CARLA_SERVER_STREAM_BLOCK);
+    carla_set_control_wait(Server, Settings.ControlSpinCount, Settings.ControlYieldCount);
+    // Subscribers keep connected while enabled, this does nothing if the
+    // publisher is already running.
+    carla_set_measurements_publisher(
+        Server,
+        Settings.bPublishMeasurements,
+        FMath::Max(1u, Settings.PublisherMaxQueuedFrames));
+    carla_set_metrics_server(Server, Settings.bEnableMetricsServer);
+    SetStreamRecorder(Settings, Settings.bRecordStream);
   }
   return ec;
 }
 
+CarlaServer::ErrorCode CarlaServer::StartOfflineEpisode(const UCarlaSettings &Settings)
+{
+  SetEncodingOptions(Settings);
+  // The images must go into the recording, not into memory shared with a
+  // client.
+  carla_set_shared_memory_images(Server, false);
+  carla_set_gpu_shared_images(Server, false);
+  SetStreamRecorder(Settings, true);
+  return ParseErrorCode(carla_start_offline_episode(Server));
+}
+
+void CarlaServer::SetEncodingOptions(const UCarlaSettings &Settings)
+{
+  carla_set_packed_agents(Server, Settings.bPackNonPlayerAgentsInfo);
+  carla_set_agents_encoding(Server, AgentsEncoding::ToUInt(Settings.PackedAgentsEncoding));
+  carla_set_delta_agents(
+      Server,
+      Settings.bSendNonPlayerAgentsDelta,
+      FMath::Max(0.0f, Settings.NonPlayerAgentsDeltaThreshold));
+  carla_set_shared_memory_images(Server, Settings.bUseSharedMemoryImages);
+  bool bShareRenderTargets = false;
+  for (auto &Item : Settings.CameraDescriptions) {
+    bShareRenderTargets |= Item.Value.bShareRenderTarget;
+  }
+  carla_set_gpu_shared_images(Server, bShareRenderTargets);
+}
+
+void CarlaServer::ReportMemoryUsage(
+    const ACarlaGameState &GameState,
+    const ACarlaVehicleController &Player)
+{
+  carla_memory_usage values;
+  const auto *RoadMap = Player.GetRoadMap();
+  values.road_map = (RoadMap != nullptr ? RoadMap->GetAllocatedSize() : 0u);
+  values.captured_images = 0u;
+  for (const auto &Image : Player.GetPlayerState().GetImages()) {
+    values.captured_images += Image.BitMap.GetAllocatedSize();
+  }
+  values.render_targets = 0u;
+  for (const auto *Camera : Player.GetSceneCaptureCameras()) {
+    check(Camera != nullptr);
+    values.captured_images += Camera->GetBitMapsAllocatedSize();
+    values.render_targets += Camera->GetRenderTargetAllocatedSize();
+  }
+  const auto *VehicleSpawner = GameState.GetVehicleSpawner();
+  const auto *WalkerSpawner = GameState.GetWalkerSpawner();
+  values.spawner_pools =
+      (VehicleSpawner != nullptr ? VehicleSpawner->GetPoolAllocatedSize() : 0u) +
+      (WalkerSpawner != nullptr ? WalkerSpawner->GetPoolAllocatedSize() : 0u);
+
+  // Only what the RHI keeps track of, buffers and the driver's own memory are
+  // not counted.
+  values.gpu_textures = 1024u * static_cast<uint64>(FMath::Max(0, static_cast<int32>(GCurrentTextureMemorySize)));
+  values.gpu_render_targets = 1024u * static_cast<uint64>(FMath::Max(0, static_cast<int32>(GCurrentRendertargetMemorySize)));
+  values.gpu_texture_pool = static_cast<uint64>(FMath::Max<int64>(0, GTexturePoolSize));
+
+  SET_MEMORY_STAT(STAT_CarlaRoadMapMemory, values.road_map);
+  SET_MEMORY_STAT(STAT_CarlaCapturedImagesMemory, values.captured_images);
+  SET_MEMORY_STAT(STAT_CarlaRenderTargetsMemory, values.render_targets);
+  SET_MEMORY_STAT(STAT_CarlaSpawnerPoolsMemory, values.spawner_pools);
+  carla_set_memory_usage(Server, values);
+}
+
+void CarlaServer::SetStreamRecorder(const UCarlaSettings &Settings, const bool bEnable)
+{
+  // The recording goes on across episodes unless its directory changes.
+  if (bEnable) {
+    const FString Directory = FPaths::ConvertRelativePathToFull(
+        Settings.RecordingDirectory.IsEmpty() ?
+            FPaths::ProjectSavedDir() / TEXT("StreamRecordings") :
+            Settings.RecordingDirectory);
+    IFileManager::Get().MakeDirectory(*Directory, true);
+    carla_set_stream_recorder(
+        Server,
+        true,
+        TCHAR_TO_UTF8(*Directory),
+        FMath::Max(1u, Settings.RecordingSegmentSizeMB));
+  } else {
+    carla_set_stream_recorder(Server, false, nullptr, 0u);
+  }
+}
+
+CarlaServer::ErrorCode CarlaServer::ReadQueuedEpisode(FString &IniFile)
+{
+  carla_request_new_episode values;
+  auto ec = ParseErrorCode(carla_read_queued_episode(Server, values));
+  if (Success == ec) {
+    IniFile = FString(values.ini_file_length, ANSI_TO_TCHAR(values.ini_file));
+    UE_LOG(LogCarlaServer, Log, TEXT("Received queued episode"));
+#ifdef CARLA_SERVER_EXTRA_LOG
+    UE_LOG(LogCarlaServer, Log, TEXT("Received queued CarlaSettings.ini:\n%s"), *IniFile);
+#endif // CARLA_SERVER_EXTRA_LOG
+  }
+  return ec;
+}
+
+CarlaServer::ErrorCode CarlaServer::ReadWorldSnapshotRequest(TArray<uint8> &RestoreData)
+{
+  carla_world_snapshot_request values;
+  auto ec = ParseErrorCode(carla_read_world_snapshot_request(Server, values));
+  if (Success == ec) {
+    RestoreData.Reset();
+    if (values.restore_data_length > 0u) {
+      RestoreData.Append(static_cast<const uint8 *>(values.restore_data), values.restore_data_length);
+    }
+  }
+  return ec;
+}
+
+CarlaServer::ErrorCode CarlaServer::SendWorldSnapshot(const bool bSuccess, const TArray<uint8> &Data)
+{
+  carla_world_snapshot values;
+  values.success = bSuccess;
+  values.data = Data.GetData();
+  values.data_length = static_cast<uint32>(Data.Num());
+  return ParseErrorCode(carla_write_world_snapshot(Server, values, TimeOut));
+}
+
+CarlaServer::ErrorCode CarlaServer::ReadRouteRequest(
+    FVector &StartLocation,
+    FVector &StartForward,
+    FVector &EndLocation)
+{
+  carla_route_request values;
+  auto ec = ParseErrorCode(carla_read_route_request(Server, values));
+  if (Success == ec) {
+    StartLocation = {values.start.location.x, values.start.location.y, values.start.location.z};
+    StartForward = {values.start.orientation.x, values.start.orientation.y, values.start.orientation.z};
+    EndLocation = {values.end.location.x, values.end.location.y, values.end.location.z};
+  }
+  return ec;
+}
+
+CarlaServer::ErrorCode CarlaServer::SendRoute(
+    const TArray<FVector> &Waypoints,
+    const TArray<int32> &Lanes,
+    FFrameArena &Arena)
+{
+  auto Points = Arena.NewArray<carla_vector3d>(Waypoints.Num());
+  float Length = 0.0f;
+  for (auto i = 0; i < Waypoints.Num(); ++i) {
+    Set(Points[i], Waypoints[i]);
+    if (i > 0) {
+      Length += FVector::Dist(Waypoints[i - 1], Waypoints[i]);
+    }
+  }
+  auto LaneIndices = Arena.NewArray<uint32_t>(Lanes.Num());
+  for (auto i = 0; i < Lanes.Num(); ++i) {
+    LaneIndices[i] = static_cast<uint32_t>(Lanes[i]);
+  }
+  carla_route values;
+  values.success = (Waypoints.Num() > 0);
+  values.waypoints = Points.GetData();
+  values.number_of_waypoints = Points.Num();
+  values.lanes = LaneIndices.GetData();
+  values.number_of_lanes = LaneIndices.Num();
+  values.length = Length;
+  return ParseErrorCode(carla_write_route(Server, values, TimeOut));
+}
+
+CarlaServer::ErrorCode CarlaServer::ReadRoadMapRequest()
+{
+  carla_road_map_request values;
+  return ParseErrorCode(carla_read_road_map_request(Server, values));
+}
+
+CarlaServer::ErrorCode CarlaServer::SendRoadMap(const URoadMap *RoadMap)
+{
+  // Only on request and hashed by the library, not worth an arena.
+  TArray<uint16> Pixels;
+  carla_road_map values;
+  values.success = (RoadMap != nullptr) && RoadMap->GetPixels(Pixels, values.world_to_pixel);
+  values.pixels = Pixels.GetData();
+  values.width = (values.success ? RoadMap->GetWidth() : 0u);
+  values.height = (values.success ? RoadMap->GetHeight() : 0u);
+  return ParseErrorCode(carla_write_road_map(Server, values, TimeOut));
+}
+
 CarlaServer::ErrorCode CarlaServer::SendSceneDescription(
       const TArray<APlayerStart *> &AvailableStartSpots,
+      FFrameArena &Arena,
       const bool bBlocking)
 {
   const int32 NumberOfStartSpots = AvailableStartSpots.Num();
-  auto StartSpots = MakeUnique<carla_transform[]>(NumberOfStartSpots);
+  auto StartSpots = Arena.NewArray<carla_transform>(NumberOfStartSpots);
 
   for (auto i = 0; i < NumberOfStartSpots; ++i) {
     Set(StartSpots[i], AvailableStartSpots[i]->GetActorTransform());
@@ -198,8 +532,25 @@ CarlaServer::ErrorCode CarlaServer::SendSceneDescription(
 
   UE_LOG(LogCarlaServer, Log, TEXT("Sending %d available start positions"), NumberOfStartSpots);
   carla_scene_description scene;
-  scene.player_start_spots = StartSpots.Get();
+  scene.player_start_spots = StartSpots.GetData();
   scene.number_of_player_start_spots = NumberOfStartSpots;
+  scene.previous_episode_summary = nullptr;
+  carla_episode_summary summary;
+  if (EpisodeSummary.IsSet()) {
+    const auto &Summary = EpisodeSummary.GetValue();
+    summary.number_of_frames = Summary.NumberOfFrames;
+    summary.game_timestamp = Summary.GameTimeStamp;
+    summary.distance_traveled = Summary.DistanceTraveled;
+    summary.collision_vehicles = Summary.CollisionIntensityCars;
+    summary.collision_pedestrians = Summary.CollisionIntensityPedestrians;
+    summary.collision_other = Summary.CollisionIntensityOther;
+    summary.number_of_collisions = Summary.NumberOfCollisions;
+    summary.seconds_off_road = Summary.SecondsOffRoad;
+    summary.seconds_on_other_lane = Summary.SecondsOnOtherLane;
+    summary.seconds_over_speed_limit = Summary.SecondsOverSpeedLimit;
+    scene.previous_episode_summary = &summary;
+    EpisodeSummary.Reset();
+  }
 
   return ParseErrorCode(carla_write_scene_description(Server, scene, GetTimeOut(TimeOut, bBlocking)));
 }
@@ -222,86 +573,353 @@ CarlaServer::ErrorCode CarlaServer::SendEpisodeReady(const bool bBlocking)
   return ParseErrorCode(carla_write_episode_ready(Server, values, GetTimeOut(TimeOut, bBlocking)));
 }
 
+static void ApplyControl(
+    ACarlaVehicleController &Player,
+    const float Steer,
+    const float Throttle,
+    const float Brake,
+    const bool bHandBrake,
+    const bool bReverse)
+{
+  check(Player.IsPossessingAVehicle());
+  auto Vehicle = Player.GetPossessedVehicle();
+  Vehicle->SetSteeringInput(Steer);
+  Vehicle->SetThrottleInput(Throttle);
+  Vehicle->SetBrakeInput(Brake);
+  Vehicle->SetHandbrakeInput(bHandBrake);
+  Vehicle->SetReverse(bReverse);
+}
+
 CarlaServer::ErrorCode CarlaServer::ReadControl(ACarlaVehicleController &Player, const bool bBlocking)
 {
-  carla_control values;
-  auto ec = ParseErrorCode(carla_read_control(Server, values, GetTimeOut(TimeOut, bBlocking)));
+  SCOPE_CYCLE_COUNTER(STAT_CarlaReadControl);
+  carla_control_batch batch;
+  auto ec = ParseErrorCode(carla_read_control_batch(Server, batch, GetTimeOut(TimeOut, bBlocking)));
   if (Success == ec) {
-    check(Player.IsPossessingAVehicle());
-    auto Vehicle = Player.GetPossessedVehicle();
-    Vehicle->SetSteeringInput(values.steer);
-    Vehicle->SetThrottleInput(values.throttle);
-    Vehicle->SetBrakeInput(values.brake);
-    Vehicle->SetHandbrakeInput(values.hand_brake);
-    Vehicle->SetReverse(values.reverse);
+    check(batch.number_of_controls > 0u);
+    const carla_control &values = batch.controls[0u];
+    ApplyControl(Player, values.steer, values.throttle, values.brake, values.hand_brake, values.reverse);
+    carla_set_applied_control(Server, values.sequence_number);
+    PendingControls.Reset(batch.number_of_controls - 1u);
+    for (uint32 i = 1u; i < batch.number_of_controls; ++i) {
+      const carla_control &next = batch.controls[i];
+      PendingControls.Add({next.steer, next.throttle, next.brake, next.hand_brake, next.reverse, next.sequence_number});
+    }
+    NextPendingControl = 0;
+    bSkipIntermediateMeasurements = batch.skip_intermediate_measurements;
+    Observation = FObservationRequest();
+    if (batch.has_observation_request) {
+      Observation.bActive = true;
+      Observation.Sensors.Append(batch.observed_sensors, batch.number_of_observed_sensors);
+      Observation.bNonPlayerAgents = batch.observe_non_player_agents;
+      Observation.bAgentBoxes = batch.observe_agent_boxes;
+      Observation.bClassHistograms = batch.observe_class_histograms;
+    }
 #ifdef CARLA_SERVER_EXTRA_LOG
     UE_LOG(
         LogCarlaServer,
         Log,
-        TEXT("Read control (%s): { Steer = %f, Throttle = %f, Brake = %f, Handbrake = %s, Reverse = %s }"),
+        TEXT("Read control (%s): { Steer = %f, Throttle = %f, Brake = %f, Handbrake = %s, Reverse = %s, Batch = %d }"),
         (bBlocking ? TEXT("Sync") : TEXT("Async")),
         values.steer,
         values.throttle,
         values.brake,
         (values.hand_brake ? TEXT("True") : TEXT("False")),
-        (values.reverse ? TEXT("True") : TEXT("False")));
+        (values.reverse ? TEXT("True") : TEXT("False")),
+        batch.number_of_controls);
 #endif // CARLA_SERVER_EXTRA_LOG
   } else if ((!bBlocking) && (TryAgain == ec)) {
-    UE_LOG(LogCarlaServer, Warning, TEXT("No control received from the client this frame!"));
+    // No new control this frame, the vehicle holds the last one applied.
+#ifdef CARLA_SERVER_EXTRA_LOG
+    carla_control values;
+    carla_control_status status;
+    if (Success == ParseErrorCode(carla_read_latest_control(Server, values, status))) {
+      UE_LOG(
+          LogCarlaServer,
+          Log,
+          TEXT("No control received this frame, holding the last one: { Age = %llu frames, %f ms }"),
+          status.age_in_frames,
+          status.age_in_milliseconds);
+    }
+#endif // CARLA_SERVER_EXTRA_LOG
   }
   return ec;
 }
 
+bool CarlaServer::ApplyPendingControl(ACarlaVehicleController &Player)
+{
+  if (NextPendingControl >= PendingControls.Num()) {
+    return false;
+  }
+  const FControl &Control = PendingControls[NextPendingControl++];
+  ApplyControl(Player, Control.Steer, Control.Throttle, Control.Brake, Control.bHandBrake, Control.bReverse);
+  carla_set_applied_control(Server, Control.SequenceNumber);
+  return true;
+}
+
+CarlaServer::ErrorCode CarlaServer::DiscardControl(const bool bBlocking)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaReadControl);
+  carla_control_batch batch;
+  PendingControls.Reset();
+  NextPendingControl = 0;
+  bSkipIntermediateMeasurements = false;
+  Observation = FObservationRequest();
+  return ParseErrorCode(carla_read_control_batch(Server, batch, GetTimeOut(TimeOut, bBlocking)));
+}
+
 template <typename T>
-static void AddAgents(TArray<carla_agent> &Agents, const TArray<T> &Actors)
-{
-  for (auto &&Actor : Actors) {
-    if (Actor != nullptr) {
-      Agents.Emplace();
-      auto &values = Agents.Last();
-      values.id = GetTypeHash(Actor);
-      Set(values.transform, Actor->GetActorTransform());
-      SetBoxSpeedAndType(values, Actor);
+static void SetAgent(carla_agent &values, const FAgentRecord &Agent, const AActor &Actor)
+{
+  values.id = Agent.Id;
+  Set(values.transform, Actor.GetActorTransform());
+  SetBoxSpeedAndType(values, static_cast<const T *>(&Actor));
+}
+
+static void SetAgent(carla_agent &values, const FAgentRecord &Agent)
+{
+  const AActor *Actor = Agent.Actor.Get();
+  if (Actor == nullptr) {
+    values.id = 0u; // Destroyed but not yet deregistered, removed later.
+    return;
+  }
+  switch (Agent.Type) {
+    case EAgentType::Vehicle:
+      SetAgent<ACarlaWheeledVehicle>(values, Agent, *Actor);
+      break;
+    case EAgentType::Walker:
+      SetAgent<ACharacter>(values, Agent, *Actor);
+      break;
+    case EAgentType::TrafficSign:
+      SetAgent<ATrafficSignBase>(values, Agent, *Actor);
+      break;
+  }
+}
+
+/// Agents are read in parallel in chunks of this size, scenes with fewer
+/// agents are read on the game thread to avoid the dispatch overhead.
+static constexpr int32 AGENTS_PER_CHUNK = 64;
+
+/// Read the agents in @a Records, or only those at @a Indices if not null,
+/// into @a Agents, zeroed and sized to fit all of them. Returns the slice of
+/// @a Agents read.
+static TArrayView<carla_agent> GetAgentInfo(
+    const TArray<FAgentRecord> &Records,
+    const TArray<int32> *Indices,
+    TArrayView<carla_agent> Agents)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaGetAgentInfo);
+  const int32 NumberOfAgents = (Indices != nullptr ? Indices->Num() : Records.Num());
+  check(Agents.Num() == NumberOfAgents);
+  const int32 NumberOfChunks = (NumberOfAgents + AGENTS_PER_CHUNK - 1) / AGENTS_PER_CHUNK;
+  // Read-only pass, each chunk writes its own slice of the pre-sized array.
+  ParallelFor(NumberOfChunks, [&](const int32 Chunk) {
+    const int32 End = FMath::Min(NumberOfAgents, (Chunk + 1) * AGENTS_PER_CHUNK);
+    for (int32 i = Chunk * AGENTS_PER_CHUNK; i < End; ++i) {
+      SetAgent(Agents[i], Records[Indices != nullptr ? (*Indices)[i] : i]);
+    }
+  }, NumberOfChunks < 2);
+  // Drop the agents not read, keeping the order.
+  int32 Count = 0;
+  for (int32 i = 0; i < NumberOfAgents; ++i) {
+    if (Agents[i].id != 0u) {
+      Agents[Count++] = Agents[i];
     }
   }
+  return Agents.Slice(0, Count);
 }
 
-static void GetAgentInfo(
-    const ACarlaGameState &GameState,
-    TArray<carla_agent> &Agents)
+/// Intersect the vehicles of @a Agents with @a RoadMap, all at once.
+static void IntersectWithRoadMap(const URoadMap *RoadMap, TArrayView<carla_agent> Agents)
 {
-  const auto *WalkerSpawner = GameState.GetWalkerSpawner();
-  const auto *VehicleSpawner = GameState.GetVehicleSpawner();
-  const auto &TrafficSigns = GameState.GetTrafficSigns();
+  if (RoadMap == nullptr) {
+    return;
+  }
+  SCOPE_CYCLE_COUNTER(STAT_CarlaIntersectAgentsWithRoadMap);
+  TArray<int32> Vehicles;
+  TArray<FTransform> Transforms;
+  TArray<FVector> Extents;
+  for (auto i = 0; i < Agents.Num(); ++i) {
+    const auto &Agent = Agents[i];
+    if (Agent.type == CARLA_SERVER_AGENT_VEHICLE) {
+      // Only the forward vector was read, the roll does not change the
+      // projection of the box to the map.
+      const auto &t = Agent.transform;
+      Vehicles.Add(i);
+      Transforms.Emplace(
+          FRotationMatrix::MakeFromX(FVector(t.orientation.x, t.orientation.y, t.orientation.z)).Rotator(),
+          FVector(t.location.x, t.location.y, t.location.z));
+      Extents.Emplace(Agent.box_extent.x, Agent.box_extent.y, Agent.box_extent.z);
+    }
+  }
+  constexpr float ChecksPerCentimeter = 0.1f;
+  TArray<FRoadMapIntersectionResult> Results;
+  RoadMap->IntersectMany(Transforms, Extents, ChecksPerCentimeter, Results);
+  for (auto i = 0; i < Vehicles.Num(); ++i) {
+    auto &Agent = Agents[Vehicles[i]];
+    Agent.intersection_offroad = Results[i].OffRoad;
+    Agent.intersection_otherlane = Results[i].OppositeLane;
+  }
+}
+
+static bool IsFilteringAgents(const UCarlaSettings &Settings)
+{
+  constexpr uint8 AllTypes =
+      FAgentGrid::GetTypeBit(EAgentType::Vehicle) |
+      FAgentGrid::GetTypeBit(EAgentType::Walker) |
+      FAgentGrid::GetTypeBit(EAgentType::TrafficSign);
+  return
+      (Settings.NonPlayerAgentsRadius > 0.0f) ||
+      (Settings.MaxNumberOfNonPlayerAgents > 0u) ||
+      ((Settings.NonPlayerAgentsTypeMask & AllTypes) != AllTypes);
+}
 
-  auto NumberOfAgents = TrafficSigns.Num();
-  if (WalkerSpawner != nullptr) {
-    NumberOfAgents += WalkerSpawner->GetCurrentNumberOfWalkers();
+using FCameraArray = TArray<ASceneCaptureCamera *, TInlineAllocator<8u>>;
+
+/// Colocated depth camera of @a Camera among @a Cameras, the image it sends
+/// must match pixel by pixel. INDEX_NONE if none.
+static int32 FindDepthCamera(const ASceneCaptureCamera &Camera, const FCameraArray &Cameras)
+{
+  return Cameras.IndexOfByPredicate([&](const ASceneCaptureCamera *Other) {
+    const auto Encoding = Other->GetImageEncoding();
+    return
+        (Other->GetPostProcessEffect() == EPostProcessEffect::Depth) &&
+        ((Encoding == EImageEncoding::BGRA8) || (Encoding == EImageEncoding::Float32)) &&
+        !Other->IsAsyncReadback() &&
+        Other->GetActorTransform().Equals(Camera.GetActorTransform()) &&
+        FMath::IsNearlyEqual(Other->GetFOVAngle(), Camera.GetFOVAngle()) &&
+        (Other->GetImageSizeX() == Camera.GetImageSizeX()) &&
+        (Other->GetImageSizeY() == Camera.GetImageSizeY()) &&
+        (Other->GetRegionOfInterest() == Camera.GetRegionOfInterest()) &&
+        (Other->GetOutputSizeX() == Camera.GetOutputSizeX()) &&
+        (Other->GetOutputSizeY() == Camera.GetOutputSizeY());
+  });
+}
+
+/// Project @a Agents into each of @a Cameras set to compute their boxes, and
+/// attach the boxes to the next measurements. @a ImageData holds the images
+/// read back of each camera, used for the occlusion check.
+static void SetAgentBoxes(
+    void *Server,
+    FAgentBoxProjector &Projector,
+    TArrayView<const carla_agent> Agents,
+    const FCameraArray &Cameras,
+    const TArray<uint32, TInlineAllocator<8u>> &CameraIndices,
+    uint32_t *const *ImageData)
+{
+  // Reserved so the arrays of boxes do not move while being referenced.
+  TArray<TArray<carla_agent_box_2d>, TInlineAllocator<8u>> Boxes;
+  Boxes.Reserve(Cameras.Num());
+  TArray<carla_camera_agent_boxes, TInlineAllocator<8u>> CameraBoxes;
+  uint32 NumberOfBoxes = 0u;
+  for (auto i = 0; i < Cameras.Num(); ++i) {
+    const auto &Camera = *Cameras[i];
+    if (!Camera.IsComputingAgentBoxes()) {
+      continue;
+    }
+    FAgentBoxDepth Depth;
+    const int32 DepthIndex = FindDepthCamera(Camera, Cameras);
+    if (DepthIndex != INDEX_NONE) {
+      Depth.Data = ImageData[DepthIndex];
+      Depth.Encoding = Cameras[DepthIndex]->GetImageEncoding();
+      Depth.Width = Cameras[DepthIndex]->GetOutputSizeX();
+      Depth.Height = Cameras[DepthIndex]->GetOutputSizeY();
+    }
+    auto &CameraBoxesArray = Boxes[Boxes.AddDefaulted()];
+    Projector.Project(
+        Camera,
+        Agents.GetData(),
+        Agents.Num(),
+        (DepthIndex != INDEX_NONE ? &Depth : nullptr),
+        CameraBoxesArray);
+    CameraBoxes.Add({CameraIndices[i], CameraBoxesArray.GetData(), static_cast<uint32_t>(CameraBoxesArray.Num())});
+    NumberOfBoxes += CameraBoxesArray.Num();
+  }
+  SET_DWORD_STAT(STAT_CarlaAgentBoxesSent, NumberOfBoxes);
+  carla_set_agent_boxes(Server, CameraBoxes.GetData(), CameraBoxes.Num());
+}
+
+/// Count the labels of each camera set to compute its class histogram, and
+/// attach the counts to the next measurements. The cameras sent use their
+/// image in @a ImageData, those not sending images (@a HiddenCameras) are
+/// read back into @a Scratch.
+static void SetClassHistograms(
+    void *Server,
+    TArray<FClassHistogram> &Histograms,
+    TArray<uint8> &Scratch,
+    const FCameraArray &Cameras,
+    const TArray<uint32, TInlineAllocator<8u>> &CameraIndices,
+    uint32_t *const *ImageData,
+    const FCameraArray &HiddenCameras,
+    const TArray<uint32, TInlineAllocator<8u>> &HiddenCameraIndices)
+{
+  // Sized once so the counts do not move while being referenced.
+  Histograms.SetNum(Cameras.Num() + HiddenCameras.Num());
+  TArray<carla_class_histogram, TInlineAllocator<8u>> Counts;
+  auto Count = [&](const ASceneCaptureCamera &Camera, const uint32 CameraIndex, const void *Image) {
+    auto &Histogram = Histograms[Counts.Num()];
+    Histogram.Compute(Image, Camera.GetImageEncoding(), Camera.GetOutputSizeX() * Camera.GetOutputSizeY());
+    Counts.Add({CameraIndex, Histogram.GetCounts().GetData(), FClassHistogram::NumberOfClasses});
+  };
+  for (auto i = 0; i < Cameras.Num(); ++i) {
+    if (Cameras[i]->IsComputingClassHistogram()) {
+      Count(*Cameras[i], CameraIndices[i], ImageData[i]);
+    }
   }
-  if (VehicleSpawner != nullptr) {
-    NumberOfAgents += VehicleSpawner->GetNumberOfSpawnedVehicles();
+  for (auto i = 0; i < HiddenCameras.Num(); ++i) {
+    auto &Camera = *HiddenCameras[i];
+    const auto Encoding = Camera.GetImageEncoding();
+    Scratch.SetNumUninitialized(
+        ImageEncoding::GetBytesPerPixel(Encoding) * Camera.GetOutputSizeX() * Camera.GetOutputSizeY(),
+        false);
+    const bool bRead = (ImageEncoding::IsReadAsBGRA8(Encoding) ?
+        Camera.ReadPixels(reinterpret_cast<FColor *>(Scratch.GetData())) :
+        Camera.ReadRawPixels(Scratch.GetData()));
+    if (!bRead) {
+      UE_LOG(LogCarlaServer, Warning, TEXT("Failed to read pixels of camera %d, sending no class histogram"), HiddenCameraIndices[i]);
+      continue;
+    }
+    Count(Camera, HiddenCameraIndices[i], Scratch.GetData());
   }
-  Agents.Reserve(NumberOfAgents);
+  SET_DWORD_STAT(STAT_CarlaClassHistogramsSent, Counts.Num());
+  carla_set_class_histograms(Server, Counts.GetData(), Counts.Num());
+}
 
-  AddAgents(Agents, TrafficSigns);
-  if (WalkerSpawner != nullptr) {
-    AddAgents(Agents, WalkerSpawner->GetWalkersWhiteList());
-    AddAgents(Agents, WalkerSpawner->GetWalkersBlackList());
+/// Attach the collisions of the player during the last frame to the next
+/// measurements, if any.
+static void SetCollisionEvents(
+    void *Server,
+    const TArray<FCollisionEvent> &Collisions,
+    const FAgentRegistry &Registry,
+    FFrameArena &Arena)
+{
+  if (Collisions.Num() == 0) {
+    return;
   }
-  if (VehicleSpawner != nullptr) {
-    AddAgents(Agents, VehicleSpawner->GetVehicles());
+  auto Events = Arena.NewArray<carla_collision_event>(Collisions.Num());
+  for (auto i = 0; i < Collisions.Num(); ++i) {
+    Events[i].other_actor_id = Registry.FindId(Collisions[i].OtherActor);
+    Events[i].label = static_cast<uint32_t>(Collisions[i].Label);
+    Events[i].normal_impulse = Collisions[i].NormalImpulse;
   }
+  carla_set_collision_events(Server, Events.GetData(), Events.Num());
 }
 
 CarlaServer::ErrorCode CarlaServer::SendMeasurements(
     const ACarlaGameState &GameState,
-    const ACarlaPlayerState &PlayerState,
-    const bool bSendNonPlayerAgentsInfo)
+    const ACarlaVehicleController &Player,
+    const UCarlaSettings &Settings,
+    FFrameArena &Arena)
 {
+  SCOPE_CYCLE_COUNTER(STAT_CarlaSendMeasurements);
+
+  const auto &PlayerState = Player.GetPlayerState();
+
   // Measurements.
   carla_measurements values;
   values.platform_timestamp = PlayerState.GetPlatformTimeStamp();
   values.game_timestamp = PlayerState.GetGameTimeStamp();
+  values.frame_number = GFrameCounter;
   auto &player = values.player_measurements;
   Set(player.transform, PlayerState.GetTransform());
   Set(player.acceleration, PlayerState.GetAcceleration());
@@ -317,26 +935,303 @@ CarlaServer::ErrorCode CarlaServer::SendMeasurements(
   Set(player.ai_control.hand_brake, PlayerState.GetHandBrake());
   Set(player.ai_control.reverse, PlayerState.GetCurrentGear() < 0);
 
-  TArray<carla_agent> Agents;
-  if (bSendNonPlayerAgentsInfo) {
-    GetAgentInfo(GameState, Agents);
+  // Only what the client asked for with the last control is read and sent,
+  // everything the settings enable if it did not ask, see IsSensorObserved.
+  const bool bSendAgents = Settings.bSendNonPlayerAgentsInfo && Observation.bNonPlayerAgents;
+
+  // The agents are read for the cameras computing their boxes too, even if
+  // they are not sent.
+  const auto &AllCameras = Player.GetSceneCaptureCameras();
+  bool bComputeAgentBoxes = false;
+  if (Observation.bAgentBoxes) {
+    for (auto i = 0; i < AllCameras.Num(); ++i) {
+      bComputeAgentBoxes |=
+          AllCameras[i]->IsComputingAgentBoxes() &&
+          AllCameras[i]->HasImage(GFrameCounter) &&
+          IsSensorObserved(i);
+    }
   }
-  values.non_player_agents = (Agents.Num() > 0 ? Agents.GetData() : nullptr);
-  values.number_of_non_player_agents = Agents.Num();
+
+  // Agents, read and intersected with the road map in a chain of tasks. The
+  // array is allocated here as the arena is not thread-safe.
+  TArrayView<carla_agent> Agents;
+
+  // The work independent of the readback of the cameras runs in worker
+  // threads meanwhile, the game thread waits for it only before sending.
+  FFrameTaskGraph Tasks;
+  if (bSendAgents || bComputeAgentBoxes) {
+    const auto &Records = GameState.GetAgentRegistry().GetAgents();
+    const TArray<int32> *Indices = nullptr;
+    if (IsFilteringAgents(Settings)) {
+      // Only the agents of interest around the player are read and sent.
+      const FVector Center = PlayerState.GetTransform().GetLocation();
+      AgentGrid.Rebuild(Records, Settings.NonPlayerAgentsTypeMask);
+      AgentIndices.Reset();
+      if (Settings.NonPlayerAgentsRadius > 0.0f) {
+        AgentGrid.Query(Center, Settings.NonPlayerAgentsRadius, AgentIndices);
+      } else {
+        AgentGrid.QueryAll(AgentIndices);
+      }
+      if (Settings.MaxNumberOfNonPlayerAgents > 0u) {
+        AgentGrid.KeepNearest(Center, Settings.MaxNumberOfNonPlayerAgents, AgentIndices);
+      }
+      Indices = &AgentIndices;
+    }
+    auto Buffer = Arena.NewArray<carla_agent>(Indices != nullptr ? Indices->Num() : Records.Num());
+    auto AgentsTask = Tasks.Add([&Agents, &Records, Indices, Buffer]() {
+      Agents = GetAgentInfo(Records, Indices, Buffer);
+    });
+    const bool bIntersectWithRoadMap =
+        bSendAgents &&
+        Settings.bSendNonPlayerAgentsRoadIntersection &&
+        !Settings.bPackNonPlayerAgentsInfo;
+    if (bIntersectWithRoadMap) {
+      const URoadMap *RoadMap = Player.GetRoadMap();
+      Tasks.Add([&Agents, RoadMap]() {
+        if (Agents.Num() > 0) {
+          IntersectWithRoadMap(RoadMap, Agents);
+        }
+      }, {AgentsTask});
+    }
+  }
+
+  // Images, the server reserves the space and the render targets are read
+  // directly into it. Only the cameras due this frame send an image.
+  // Those not sending images are only read back for their class histogram.
+  FCameraArray Cameras;
+  TArray<uint32, TInlineAllocator<8u>> CameraIndices;
+  FCameraArray HiddenCameras;
+  TArray<uint32, TInlineAllocator<8u>> HiddenCameraIndices;
+  bool bComputeClassHistograms = false;
+  for (auto i = 0; i < AllCameras.Num(); ++i) {
+    check(AllCameras[i] != nullptr);
+    if (AllCameras[i]->HasImage(GFrameCounter) && IsSensorObserved(i)) {
+      bComputeClassHistograms |= Observation.bClassHistograms && AllCameras[i]->IsComputingClassHistogram();
+      if (AllCameras[i]->IsSendingImage()) {
+        Cameras.Add(AllCameras[i]);
+        CameraIndices.Add(i);
+      } else if (Observation.bClassHistograms) {
+        HiddenCameras.Add(AllCameras[i]);
+        HiddenCameraIndices.Add(i);
+      }
+    }
+  }
+  // The point clouds of the LiDARs go after the images of the cameras.
+  TArray<const ARayCastLidar *, TInlineAllocator<4u>> Lidars;
+  TArray<uint32, TInlineAllocator<4u>> LidarIndices;
+  for (auto i = 0; i < Player.GetRayCastLidars().Num(); ++i) {
+    if (IsSensorObserved(AllCameras.Num() + i)) {
+      Lidars.Add(Player.GetRayCastLidars()[i]);
+      LidarIndices.Add(AllCameras.Num() + i);
+    }
+  }
+  const auto NumberOfCameraImages = Cameras.Num();
+  const auto NumberOfImages = NumberOfCameraImages + Lidars.Num();
+  // Render targets are shared only if the client supports it, otherwise
+  // those cameras are read back as any other.
+  bool bShareRenderTargets = false;
+  carla_get_gpu_shared_images(Server, bShareRenderTargets);
+  auto images = Arena.NewArray<carla_image>(NumberOfImages);
+  auto image_data = Arena.NewArray<uint32_t *>(NumberOfImages);
+  if (NumberOfImages > 0) {
+    for (auto i = 0; i < NumberOfCameraImages; ++i) {
+      Set(images[i], *Cameras[i], CameraIndices[i]);
+      if (bShareRenderTargets && Cameras[i]->IsSharingRenderTarget()) {
+        SetGpuShared(images[i]);
+      }
+    }
+    for (auto i = 0; i < Lidars.Num(); ++i) {
+      check(Lidars[i] != nullptr);
+      Set(images[NumberOfCameraImages + i], *Lidars[i], LidarIndices[i]);
+    }
+  }
+
+  auto ec = carla_acquire_image_buffer(Server, images.GetData(), NumberOfImages, image_data.GetData());
+  if (ec != CARLA_SERVER_SUCCESS) {
+    return ParseErrorCode(ec);
+  }
+
+  const double ReadbackStartTime = FPlatformTime::Seconds();
+  SET_DWORD_STAT(STAT_CarlaImagesSent, NumberOfImages);
+  int64 ImageMemory = 0;
+
+  // Cameras read synchronously through the atlas.
+  TArray<ASceneCaptureCamera *, TInlineAllocator<8u>> AtlasCameras;
+  TArray<FColor *, TInlineAllocator<8u>> AtlasBuffers;
+
+  for (auto i = 0; i < NumberOfCameraImages; ++i) {
+    SCOPE_CYCLE_COUNTER(STAT_CarlaReadCameraPixels);
+    auto *Buffer = reinterpret_cast<FColor *>(image_data[i]);
+    if (images[i].encoding == CARLA_SERVER_IMAGE_GPU_SHARED) {
+      auto &Shared = *reinterpret_cast<carla_gpu_shared_image *>(image_data[i]);
+      FSharedRenderTargetFrame Frame;
+      if (!Cameras[i]->ShareRenderTarget(Frame)) {
+        UE_LOG(LogCarlaServer, Warning, TEXT("Failed to share render target of camera %d, sending empty image"), CameraIndices[i]);
+      }
+      Set(Shared, Frame);
+      ImageMemory += sizeof(carla_gpu_shared_image);
+      continue;
+    }
+    const auto SizeInBytes =
+        ImageEncoding::GetBytesPerPixel(Cameras[i]->GetImageEncoding()) * images[i].width * images[i].height;
+    ImageMemory += SizeInBytes;
+    if (!ImageEncoding::IsReadAsBGRA8(Cameras[i]->GetImageEncoding())) {
+      if (!Cameras[i]->ReadRawPixels(image_data[i])) {
+        UE_LOG(LogCarlaServer, Warning, TEXT("Failed to read pixels of camera %d, sending empty image"), CameraIndices[i]);
+        FMemory::Memzero(image_data[i], SizeInBytes);
+      }
+    } else if (Settings.bUseCameraAtlas &&
+               !Cameras[i]->IsAsyncReadback() &&
+               !Cameras[i]->IsCroppedOrScaled() &&
+               !Cameras[i]->IsPanoramic()) {
+      AtlasCameras.Add(Cameras[i]);
+      AtlasBuffers.Add(Buffer);
+    } else if (Cameras[i]->IsAsyncReadback()) {
+      uint64 FrameNumber;
+      if (!Cameras[i]->ReadPixelsAsync(Buffer, FrameNumber)) {
+        // Nothing old enough yet, happens during the first frames of an episode.
+        UE_LOG(LogCarlaServer, Log, TEXT("No image ready yet for camera %d, sending empty image"), CameraIndices[i]);
+        FMemory::Memzero(Buffer, SizeInBytes);
+      } else {
+        check(FrameNumber == images[i].frame_number);
+      }
+    } else if (!Cameras[i]->ReadPixels(Buffer)) {
+      UE_LOG(LogCarlaServer, Warning, TEXT("Failed to read pixels of camera %d, sending empty image"), CameraIndices[i]);
+      FMemory::Memzero(Buffer, SizeInBytes);
+    }
+  }
+
+  for (auto i = 0; i < Lidars.Num(); ++i) {
+    const auto SizeInBytes = sizeof(FVector4) * Lidars[i]->GetNumberOfPoints();
+    uint32_t *Dest = image_data[NumberOfCameraImages + i];
+    const FVector4 *Source = Lidars[i]->GetPoints();
+    Tasks.Add([Dest, Source, SizeInBytes]() {
+      FMemory::Memcpy(Dest, Source, SizeInBytes);
+    });
+    ImageMemory += SizeInBytes;
+  }
+
+  SET_MEMORY_STAT(STAT_CarlaImageMemory, ImageMemory);
+
+  if ((AtlasCameras.Num() > 0) && !CameraAtlas.ReadPixels(AtlasCameras, AtlasBuffers)) {
+    UE_LOG(LogCarlaServer, Warning, TEXT("Failed to read pixels of the camera atlas, sending empty images"));
+    for (auto i = 0; i < AtlasCameras.Num(); ++i) {
+      const auto Size = AtlasCameras[i]->GetOutputSizeX() * AtlasCameras[i]->GetOutputSizeY();
+      FMemory::Memzero(AtlasBuffers[i], sizeof(FColor) * Size);
+    }
+  }
+
+  // Everything below needs the agents, and the point clouds copied.
+  Tasks.WaitAll();
+  const auto NumberOfAgentsSent = (bSendAgents ? Agents.Num() : 0);
+  values.non_player_agents = (NumberOfAgentsSent > 0 ? Agents.GetData() : nullptr);
+  values.number_of_non_player_agents = NumberOfAgentsSent;
+  SET_DWORD_STAT(STAT_CarlaAgentsSent, NumberOfAgentsSent);
+  SET_MEMORY_STAT(STAT_CarlaAgentInfoMemory, Agents.Num() * sizeof(carla_agent));
 
 #ifdef CARLA_SERVER_EXTRA_LOG
   UE_LOG(LogCarlaServer, Log, TEXT("Sending data of %d agents"), values.number_of_non_player_agents);
 #endif // CARLA_SERVER_EXTRA_LOG
 
-  // Images.
-  const auto NumberOfImages = PlayerState.GetNumberOfImages();
-  TUniquePtr<carla_image[]> images;
-  if (NumberOfImages > 0) {
-    images = MakeUnique<carla_image[]>(NumberOfImages);
-    for (auto i = 0; i < NumberOfImages; ++i) {
-      Set(images[i], PlayerState.GetImages()[i]);
-    }
+  if (bComputeAgentBoxes) {
+    SetAgentBoxes(Server, AgentBoxProjector, Agents, Cameras, CameraIndices, image_data.GetData());
+  }
+
+  if (bComputeClassHistograms) {
+    SetClassHistograms(
+        Server,
+        ClassHistograms,
+        HistogramImage,
+        Cameras,
+        CameraIndices,
+        image_data.GetData(),
+        HiddenCameras,
+        HiddenCameraIndices);
+  }
+
+  if (Settings.bSendFrameTiming) {
+    carla_frame_timing timing;
+    FMemory::Memzero(timing);
+    timing.game_tick = FPlatformTime::ToMilliseconds(GGameThreadTime);
+    const auto *VehicleSpawner = GameState.GetVehicleSpawner();
+    const auto *TrafficManager = (VehicleSpawner != nullptr ? VehicleSpawner->GetTrafficManager() : nullptr);
+    timing.ai = (TrafficManager != nullptr ? TrafficManager->GetLastTickTime() : 0.0f);
+    timing.capture_readback = 1000.0 * (FPlatformTime::Seconds() - ReadbackStartTime);
+    timing.pacing_wait = FramePacingWaitMs;
+    timing.pacing_jitter = FramePacingJitterMs;
+    carla_set_frame_timing(Server, timing);
+  }
+
+  SetCollisionEvents(Server, PlayerState.GetCollisionEvents(), GameState.GetAgentRegistry(), Arena);
+
+  return ParseErrorCode(carla_commit_image_buffer(Server, values));
+}
+
+CarlaServer::ErrorCode CarlaServer::SendSyntheticMeasurements(
+    const TArray<FIntPoint> &ImageSizes,
+    const uint32 NumberOfAgents,
+    FFrameArena &Arena)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaSendMeasurements);
+
+  carla_measurements values;
+  FMemory::Memzero(values);
+  values.platform_timestamp = static_cast<uint32>(1000.0 * FPlatformTime::Seconds());
+  values.game_timestamp = values.platform_timestamp;
+  values.frame_number = GFrameCounter;
+  values.player_measurements.transform.orientation = {1.0f, 0.0f, 0.0f};
+
+  // Vehicles on a grid moving forward, so every frame differs from the last.
+  const float Offset = 10.0f * static_cast<float>(GFrameCounter % 1000u);
+  auto Agents = Arena.NewArray<carla_agent>(NumberOfAgents);
+  for (uint32 i = 0u; i < NumberOfAgents; ++i) {
+    auto &Agent = Agents[i];
+    Agent.id = i + 1u;
+    Agent.type = CARLA_SERVER_AGENT_VEHICLE;
+    Agent.transform.location = {1000.0f * (i % 32u) + Offset, 1000.0f * (i / 32u), 0.0f};
+    Agent.transform.orientation = {1.0f, 0.0f, 0.0f};
+    Agent.box_extent = {200.0f, 100.0f, 80.0f};
+    Agent.forward_speed = 10.0f;
   }
+  values.non_player_agents = (Agents.Num() > 0 ? Agents.GetData() : nullptr);
+  values.number_of_non_player_agents = Agents.Num();
+  SET_DWORD_STAT(STAT_CarlaAgentsSent, Agents.Num());
+  SET_MEMORY_STAT(STAT_CarlaAgentInfoMemory, Agents.Num() * sizeof(carla_agent));
 
-  return ParseErrorCode(carla_write_measurements(Server, values, images.Get(), NumberOfImages));
+  const auto NumberOfImages = ImageSizes.Num();
+  TArray<carla_image, TInlineAllocator<8u>> images;
+  TArray<uint32_t *, TInlineAllocator<8u>> image_data;
+  images.SetNumZeroed(NumberOfImages);
+  image_data.SetNumZeroed(NumberOfImages);
+  for (auto i = 0; i < NumberOfImages; ++i) {
+    images[i].width = FMath::Max(ImageSizes[i].X, 0);
+    images[i].height = FMath::Max(ImageSizes[i].Y, 0);
+    images[i].frame_number = GFrameCounter;
+    images[i].camera_index = i;
+    images[i].encoding = CARLA_SERVER_IMAGE_BGRA8;
+    images[i].compression = CARLA_SERVER_IMAGE_COMPRESSION_NONE;
+  }
+
+  auto ec = carla_acquire_image_buffer(Server, images.GetData(), NumberOfImages, image_data.GetData());
+  if (ec != CARLA_SERVER_SUCCESS) {
+    return ParseErrorCode(ec);
+  }
+
+  // Touch every pixel, as reading back the render targets would.
+  SET_DWORD_STAT(STAT_CarlaImagesSent, NumberOfImages);
+  int64 ImageMemory = 0;
+  for (auto i = 0; i < NumberOfImages; ++i) {
+    const auto SizeInBytes = sizeof(uint32_t) * images[i].width * images[i].height;
+    FMemory::Memset(image_data[i], static_cast<uint8>(GFrameCounter), SizeInBytes);
+    ImageMemory += SizeInBytes;
+  }
+  SET_MEMORY_STAT(STAT_CarlaImageMemory, ImageMemory);
+
+  return ParseErrorCode(carla_commit_image_buffer(Server, values));
+}
+
+int32 CarlaServer::ReadAgents(const ACarlaGameState &GameState, FFrameArena &Arena)
+{
+  const auto &Records = GameState.GetAgentRegistry().GetAgents();
+  return GetAgentInfo(Records, nullptr, Arena.NewArray<carla_agent>(Records.Num())).Num();
 }
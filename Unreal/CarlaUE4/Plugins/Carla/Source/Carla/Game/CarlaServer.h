@@ -6,10 +6,18 @@
 
 #pragma once
 
+#include "Game/AgentBoxProjector.h"
+#include "Game/AgentGrid.h"
+#include "Game/CarlaPlayerState.h"
+#include "Game/ClassHistogram.h"
+#include "SceneCaptureAtlas.h"
+
 class ACarlaGameState;
 class ACarlaVehicleController;
 class APlayerStart;
+class FFrameArena;
 class UCarlaSettings;
+class URoadMap;
 
 /// Wrapper around carla_server API.
 class CARLA_API CarlaServer
@@ -26,32 +34,215 @@ public:
 
   ~CarlaServer();
 
+  /// Configure the sockets and the liveness time-out of their reads, takes
+  /// effect on the next Connect.
+  void SetSocketOptions(const UCarlaSettings &Settings);
+
+  /// Pin the I/O threads of the server to their CPUs and set their priority,
+  /// takes effect immediately.
+  void SetThreadOptions(const UCarlaSettings &Settings);
+
+  /// Set how the image and agent buffers are allocated, takes effect on the
+  /// next allocation.
+  static void SetBufferOptions(const UCarlaSettings &Settings);
+
   /// Connect with the client, block until the client connects or the time-out
   /// is met.
   ErrorCode Connect();
 
+  /// Start waiting for the client to connect without blocking, the client is
+  /// connected once ReadNewEpisode succeeds.
+  ErrorCode Listen();
+
+  /// Read the settings of the new episode requested by the client into
+  /// @a Settings. Parsed only if they differ from the last ones read.
   ErrorCode ReadNewEpisode(UCarlaSettings &Settings, bool bBlocking);
 
+  /// Start an episode without any client with the current @a Settings, the
+  /// measurements sent from now on are only recorded, into the recording
+  /// directory of @a Settings. Never blocks.
+  ErrorCode StartOfflineEpisode(const UCarlaSettings &Settings);
+
+  /// Read the INI of the next episode queued by the client while the current
+  /// one runs, never blocks. The episode only starts when the client requests
+  /// it, through ReadNewEpisode.
+  ErrorCode ReadQueuedEpisode(FString &IniFile);
+
+  /// Read the snapshot request of the client, never blocks. @a RestoreData is
+  /// the snapshot to restore, or empty to take one. Every request has to be
+  /// answered with SendWorldSnapshot.
+  ErrorCode ReadWorldSnapshotRequest(TArray<uint8> &RestoreData);
+
+  ErrorCode SendWorldSnapshot(bool bSuccess, const TArray<uint8> &Data);
+
+  /// Read the route query of the client, never blocks. The route starts at
+  /// @a StartLocation heading @a StartForward and ends at @a EndLocation.
+  /// Every query has to be answered with SendRoute.
+  ErrorCode ReadRouteRequest(FVector &StartLocation, FVector &StartForward, FVector &EndLocation);
+
+  /// Answer the route query with @a Waypoints and the @a Lanes they belong
+  /// to, empty if no route was found.
+  ErrorCode SendRoute(const TArray<FVector> &Waypoints, const TArray<int32> &Lanes, FFrameArena &Arena);
+
+  /// The client may ask for the road map while the episode runs, the server
+  /// library skips the pixels if the client has them already.
+  ///
+  /// Every request has to be answered with SendRoadMap.
+  ErrorCode ReadRoadMapRequest();
+
+  /// @a RoadMap may be null if the level has none.
+  ErrorCode SendRoadMap(const URoadMap *RoadMap);
+
+  /// Keep the totals of the episode ending now to send them with the next
+  /// scene description, see SendSceneDescription.
+  void SetEpisodeSummary(const FEpisodeSummary &Summary)
+  {
+    EpisodeSummary = Summary;
+  }
+
+  /// Report the wait and jitter of the frame pacer with the timing of the
+  /// next measurements, see FFramePacer.
+  void SetFramePacing(float WaitMs, float JitterMs)
+  {
+    FramePacingWaitMs = WaitMs;
+    FramePacingJitterMs = JitterMs;
+  }
+
+  /// Send the start spots of the level, and the summary of the previous
+  /// episode if any.
   ErrorCode SendSceneDescription(
       const TArray<APlayerStart *> &AvailableStartSpots,
+      FFrameArena &Arena,
       bool bBlocking);
 
   ErrorCode ReadEpisodeStart(uint32 &StartPositionIndex, bool bBlocking);
 
   ErrorCode SendEpisodeReady(bool bBlocking);
 
+  /// Read the next batch of controls sent by the client and apply the first
+  /// one, the rest are applied on the following calls to ApplyPendingControl.
   ErrorCode ReadControl(ACarlaVehicleController &Player, bool bBlocking);
 
+  /// If controls of the last batch remain to be applied, apply the next one
+  /// and return true.
+  bool ApplyPendingControl(ACarlaVehicleController &Player);
+
+  /// Read the next batch of controls sent by the client without applying
+  /// them.
+  ErrorCode DiscardControl(bool bBlocking);
+
+  /// Whether the measurements of this frame should not be sent, as the client
+  /// asked only for the ones at the end of the current batch.
+  bool ShouldSkipMeasurements() const
+  {
+    return bSkipIntermediateMeasurements && (NextPendingControl < PendingControls.Num());
+  }
+
+  /// Whether the client wants the images of the sensor at @a SensorIndex in
+  /// the next measurements, the cameras first and then the LiDARs. True for
+  /// every sensor unless the last control read came with an observation
+  /// request.
+  bool IsSensorObserved(uint32 SensorIndex) const
+  {
+    return !Observation.bActive || Observation.Sensors.Contains(SensorIndex);
+  }
+
+  /// Send the measurements of the current frame. The images are read from
+  /// the player's cameras directly into the server's buffer, the rest of the
+  /// buffers are allocated from @a Arena and must outlive the call only.
   ErrorCode SendMeasurements(
       const ACarlaGameState &GameState,
-      const ACarlaPlayerState &PlayerState,
-      bool bSendNonPlayerAgentsInfo);
+      const ACarlaVehicleController &Player,
+      const UCarlaSettings &Settings,
+      FFrameArena &Arena);
+
+  /// Send measurements of @a NumberOfAgents fake agents and an image of each
+  /// of the @a ImageSizes, without reading the world. Goes through the same
+  /// path as SendMeasurements, to measure its networking and encoding
+  /// overhead in isolation.
+  ErrorCode SendSyntheticMeasurements(
+      const TArray<FIntPoint> &ImageSizes,
+      uint32 NumberOfAgents,
+      FFrameArena &Arena);
+
+  /// Read every non-player agent of @a GameState into @a Arena as
+  /// SendMeasurements does, without sending them. Returns the number of
+  /// agents read. For the performance tests.
+  static int32 ReadAgents(const ACarlaGameState &GameState, FFrameArena &Arena);
+
+  /// Account the memory held by the road map, the player's images and render
+  /// targets, and the spawner pools, in the "stat Carla" group and in the
+  /// metrics of the server.
+  void ReportMemoryUsage(const ACarlaGameState &GameState, const ACarlaVehicleController &Player);
 
 private:
 
+  /// Set how the measurements and images are encoded.
+  void SetEncodingOptions(const UCarlaSettings &Settings);
+
+  void SetStreamRecorder(const UCarlaSettings &Settings, bool bEnable);
+
   const uint32 WorldPort;
 
   const uint32 TimeOut;
 
   void* const Server;
+
+  struct FControl
+  {
+    float Steer;
+    float Throttle;
+    float Brake;
+    bool bHandBrake;
+    bool bReverse;
+    /** Echoed back to the client once applied, zero if none. */
+    uint64 SequenceNumber;
+  };
+
+  /** Controls of the last batch, the first one was applied on read. */
+  TArray<FControl> PendingControls;
+
+  int32 NextPendingControl = 0;
+
+  bool bSkipIntermediateMeasurements = false;
+
+  /** What the client asked for in the next measurements, with the control. */
+  struct FObservationRequest
+  {
+    bool bActive = false;
+    TArray<uint32, TInlineAllocator<8u>> Sensors;
+    bool bNonPlayerAgents = true;
+    bool bAgentBoxes = true;
+    bool bClassHistograms = true;
+  };
+
+  FObservationRequest Observation;
+
+  /** Of the last frame paced, zero in synchronous mode. */
+  float FramePacingWaitMs = 0.0f;
+
+  float FramePacingJitterMs = 0.0f;
+
+  /** Totals of the episode that ended, until the next scene description. */
+  TOptional<FEpisodeSummary> EpisodeSummary;
+
+  /** INI of the last episode, the client usually sends the same or almost. */
+  FString LastIniFile;
+
+  /** Agents around the player, used if the settings filter the agents. */
+  FAgentGrid AgentGrid;
+
+  TArray<int32> AgentIndices;
+
+  /** Projects the agents into the cameras computing their boxes. */
+  FAgentBoxProjector AgentBoxProjector;
+
+  /** Pixels per label of the cameras computing them, one per camera. */
+  TArray<FClassHistogram> ClassHistograms;
+
+  /** Images of the cameras computing class histograms but not sending them. */
+  TArray<uint8> HistogramImage;
+
+  /** Used to read back every synchronous camera at once. */
+  FSceneCaptureAtlas CameraAtlas;
 };
@@ -7,6 +7,8 @@
 #include "Carla.h"
 #include "CarlaVehicleController.h"
 
+#include "CarlaWheeledVehicle.h"
+#include "RayCastLidar.h"
 #include "SceneCaptureCamera.h"
 
 #include "Components/BoxComponent.h"
@@ -15,6 +17,9 @@
 #include "WheeledVehicle.h"
 #include "WheeledVehicleMovementComponent.h"
 
+DECLARE_CYCLE_STAT(TEXT("Vehicle Controller Tick"), STAT_CarlaVehicleControllerTick, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Intersect Player With Road Map"), STAT_CarlaIntersectPlayerWithRoadMap, STATGROUP_Carla);
+
 // =============================================================================
 // -- Constructor and destructor -----------------------------------------------
 // =============================================================================
@@ -60,16 +65,16 @@ void ACarlaVehicleController::BeginPlay()
   Super::BeginPlay();
 
   if (CarlaPlayerState != nullptr) {
-    CarlaPlayerState->Images.Empty();
+    // Reuse the images of the previous episode if any, only their info changes.
     const auto NumberOfCameras = SceneCaptureCameras.Num();
+    CarlaPlayerState->Images.SetNum(NumberOfCameras);
     if (NumberOfCameras > 0) {
-      CarlaPlayerState->Images.AddDefaulted(NumberOfCameras);
       for (auto i = 0; i < NumberOfCameras; ++i) {
         auto *Camera = SceneCaptureCameras[i];
         check(Camera != nullptr);
         auto &Image = CarlaPlayerState->Images[i];
-        Image.SizeX = Camera->GetImageSizeX();
-        Image.SizeY = Camera->GetImageSizeY();
+        Image.SizeX = Camera->GetOutputSizeX();
+        Image.SizeY = Camera->GetOutputSizeY();
         Image.PostProcessEffect = Camera->GetPostProcessEffect();
       }
     }
@@ -78,12 +83,14 @@ void ACarlaVehicleController::BeginPlay()
 
 void ACarlaVehicleController::Tick(float DeltaTime)
 {
+  SCOPE_CYCLE_COUNTER(STAT_CarlaVehicleControllerTick);
   Super::Tick(DeltaTime);
 
   if (IsPossessingAVehicle()) {
     auto Vehicle = GetPossessedVehicle();
     CarlaPlayerState->UpdateTimeStamp(DeltaTime);
     const FVector PreviousSpeed = CarlaPlayerState->ForwardSpeed * CarlaPlayerState->GetOrientation();
+    const FVector PreviousLocation = CarlaPlayerState->GetLocation();
     CarlaPlayerState->Transform = Vehicle->GetActorTransform();
     CarlaPlayerState->ForwardSpeed = Vehicle->GetVehicleForwardSpeed();
     const FVector CurrentSpeed = CarlaPlayerState->ForwardSpeed * CarlaPlayerState->GetOrientation();
@@ -96,15 +103,37 @@ void ACarlaVehicleController::Tick(float DeltaTime)
     CarlaPlayerState->CurrentGear = Vehicle->GetVehicleCurrentGear();
     CarlaPlayerState->SpeedLimit = GetSpeedLimit();
     CarlaPlayerState->TrafficLightState = GetTrafficLightState();
+    CarlaPlayerState->UpdateCollisions();
     IntersectPlayerWithRoadMap();
-    const auto NumberOfCameras = SceneCaptureCameras.Num();
-    check(NumberOfCameras == CarlaPlayerState->Images.Num());
-    for (auto i = 0; i < NumberOfCameras; ++i) {
-      auto &Image = CarlaPlayerState->Images[i];
-      if (!SceneCaptureCameras[i]->ReadPixels(Image.BitMap)) {
-        Image.BitMap.Empty();
-      }
+    CarlaPlayerState->UpdateEpisodeSummary(DeltaTime, PreviousLocation);
+    // The pixels of the cameras are not read here, CarlaServer reads them
+    // directly into the network buffer when sending the measurements.
+  }
+}
+
+// =============================================================================
+// -- Episode ------------------------------------------------------------------
+// =============================================================================
+
+void ACarlaVehicleController::ResetEpisode(const FTransform &Transform)
+{
+  if (IsPossessingAVehicle()) {
+    auto Vehicle = GetPossessedVehicle();
+    Vehicle->SetActorTransform(Transform, false, nullptr, ETeleportType::TeleportPhysics);
+    auto *RootPrimitive = Cast<UPrimitiveComponent>(Vehicle->GetRootComponent());
+    if (RootPrimitive != nullptr) {
+      RootPrimitive->SetPhysicsLinearVelocity(FVector::ZeroVector);
+      RootPrimitive->SetPhysicsAngularVelocity(FVector::ZeroVector);
     }
+    Vehicle->SetThrottleInput(0.0f);
+    Vehicle->SetSteeringInput(0.0f);
+    Vehicle->SetBrakeInput(0.0f);
+    Vehicle->SetHandbrakeInput(false);
+    Vehicle->SetReverse(false);
+    CarlaPlayerState->Transform = Transform;
+  }
+  if (CarlaPlayerState != nullptr) {
+    CarlaPlayerState->ResetIncrementalValues();
   }
 }
 
@@ -134,6 +163,22 @@ void ACarlaVehicleController::AddSceneCaptureCamera(
       *PostProcessEffect::ToString(Camera->GetPostProcessEffect()));
 }
 
+void ACarlaVehicleController::AddRayCastLidar(const FLidarDescription &Description)
+{
+  auto Lidar = GetWorld()->SpawnActor<ARayCastLidar>(Description.Position, Description.Rotation);
+  Lidar->Set(Description);
+  Lidar->AttachToActor(GetPawn(), FAttachmentTransformRules::KeepRelativeTransform);
+  Lidar->SetOwner(GetPawn());
+  AddTickPrerequisiteActor(Lidar);
+  RayCastLidars.Add(Lidar);
+  UE_LOG(
+      LogCarla,
+      Log,
+      TEXT("Created LiDAR %d with %d channels"),
+      RayCastLidars.Num() - 1,
+      Description.Channels);
+}
+
 // =============================================================================
 // -- Events -------------------------------------------------------------------
 // =============================================================================
@@ -157,6 +202,7 @@ void ACarlaVehicleController::OnCollisionEvent(
 
 void ACarlaVehicleController::IntersectPlayerWithRoadMap()
 {
+  SCOPE_CYCLE_COUNTER(STAT_CarlaIntersectPlayerWithRoadMap);
   auto RoadMap = GetRoadMap();
   if (RoadMap == nullptr) {
     UE_LOG(LogCarla, Error, TEXT("Controller doesn't have a road map!"));
@@ -11,8 +11,10 @@
 
 class ACarlaHUD;
 class ACarlaPlayerState;
+class ARayCastLidar;
 class ASceneCaptureCamera;
 struct FCameraDescription;
+struct FLidarDescription;
 
 /// The CARLA player controller.
 UCLASS()
@@ -74,6 +76,18 @@ public:
     return *CarlaPlayerState;
   }
 
+  /// @}
+  // ===========================================================================
+  /// @name Episode
+  // ===========================================================================
+  /// @{
+public:
+
+  /// Move the player's vehicle to @a Transform, at rest, and reset the values
+  /// of the player state accumulated during the episode. Used to start a new
+  /// episode without reloading the level.
+  void ResetEpisode(const FTransform &Transform);
+
   /// @}
   // ===========================================================================
   /// @name Scene Capture
@@ -85,6 +99,18 @@ public:
       const FCameraDescription &CameraDescription,
       const FCameraPostProcessParameters *OverridePostProcessParameters);
 
+  const TArray<ASceneCaptureCamera *> &GetSceneCaptureCameras() const
+  {
+    return SceneCaptureCameras;
+  }
+
+  void AddRayCastLidar(const FLidarDescription &LidarDescription);
+
+  const TArray<ARayCastLidar *> &GetRayCastLidars() const
+  {
+    return RayCastLidars;
+  }
+
   /// @}
   // ===========================================================================
   /// @name Events
@@ -117,6 +143,9 @@ private:
   UPROPERTY()
   TArray<ASceneCaptureCamera *> SceneCaptureCameras;
 
+  UPROPERTY()
+  TArray<ARayCastLidar *> RayCastLidars;
+
   // Cast for quick access to the custom player state.
   UPROPERTY()
   ACarlaPlayerState *CarlaPlayerState;
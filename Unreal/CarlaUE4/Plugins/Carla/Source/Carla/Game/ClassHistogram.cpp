@@ -0,0 +1,70 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "ClassHistogram.h"
+
+#include "Async/ParallelFor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Class Histogram"), STAT_CarlaClassHistogram, STATGROUP_Carla);
+
+/// Pixels counted by each task.
+static constexpr uint32 PIXELS_PER_CHUNK = 64u * 1024u;
+
+/// Interleaved sub-histograms per chunk, so consecutive pixels of the same
+/// label do not serialize on the same counter.
+static constexpr uint32 LANES = 4u;
+
+static constexpr uint32 BINS = 256u;
+
+template <typename GetLabel>
+static void CountChunk(uint32 Begin, uint32 End, uint32 *Bins, GetLabel &&Label)
+{
+  uint32 Index = Begin;
+  for (; Index + LANES <= End; Index += LANES) {
+    for (auto Lane = 0u; Lane < LANES; ++Lane) {
+      ++Bins[Lane * BINS + Label(Index + Lane)];
+    }
+  }
+  for (; Index < End; ++Index) {
+    ++Bins[Label(Index)];
+  }
+}
+
+void FClassHistogram::Compute(
+    const void *Image,
+    const EImageEncoding Encoding,
+    const uint32 NumberOfPixels)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaClassHistogram);
+  check((Encoding == EImageEncoding::Gray8) || ImageEncoding::IsReadAsBGRA8(Encoding));
+  check((Image != nullptr) || (NumberOfPixels == 0u));
+
+  const int32 NumberOfChunks = (NumberOfPixels + PIXELS_PER_CHUNK - 1u) / PIXELS_PER_CHUNK;
+  ChunkCounts.SetNumUninitialized(NumberOfChunks * LANES * BINS, false);
+  ParallelFor(NumberOfChunks, [&](const int32 Chunk) {
+    uint32 *Bins = ChunkCounts.GetData() + Chunk * LANES * BINS;
+    FMemory::Memzero(Bins, sizeof(uint32) * LANES * BINS);
+    const uint32 Begin = Chunk * PIXELS_PER_CHUNK;
+    const uint32 End = FMath::Min(NumberOfPixels, Begin + PIXELS_PER_CHUNK);
+    if (Encoding == EImageEncoding::Gray8) {
+      const auto *Labels = static_cast<const uint8 *>(Image);
+      CountChunk(Begin, End, Bins, [Labels](uint32 i) { return Labels[i]; });
+    } else {
+      const auto *Pixels = static_cast<const FColor *>(Image);
+      CountChunk(Begin, End, Bins, [Pixels](uint32 i) { return Pixels[i].R; });
+    }
+  }, NumberOfChunks < 2);
+
+  Counts.Init(0u, NumberOfClasses);
+  for (auto Chunk = 0; Chunk < NumberOfChunks; ++Chunk) {
+    const uint32 *Bins = ChunkCounts.GetData() + Chunk * LANES * BINS;
+    for (auto Bin = 0u; Bin < LANES * BINS; ++Bin) {
+      const uint32 Label = Bin % BINS;
+      Counts[Label < NumberOfClasses ? Label : 0u] += Bins[Bin];
+    }
+  }
+}
@@ -0,0 +1,38 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Settings/ImageEncoding.h"
+
+/// Pixels per semantic label (see ECityObjectLabel) of the images of a
+/// semantic segmentation camera.
+class CARLA_API FClassHistogram
+{
+public:
+
+  /// Labels counted, those above are counted as None.
+  static constexpr uint32 NumberOfClasses = 13u;
+
+  /// Count the labels of the @a NumberOfPixels pixels of @a Image, as read
+  /// back with @a Encoding: the label is the byte of Gray8 images and the red
+  /// channel of BGRA8 images. The image is split in chunks counted in
+  /// parallel in the task graph workers.
+  void Compute(const void *Image, EImageEncoding Encoding, uint32 NumberOfPixels);
+
+  /// Counts of the last image, NumberOfClasses of them.
+  const TArray<uint32> &GetCounts() const
+  {
+    return Counts;
+  }
+
+private:
+
+  TArray<uint32> Counts;
+
+  /** Counts of each chunk, merged into Counts. */
+  TArray<uint32> ChunkCounts;
+};
@@ -0,0 +1,100 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "FrameBudgetGovernor.h"
+
+#include "RHI.h"
+
+#include "SceneCaptureCamera.h"
+
+/// Weight of the last frame in the average GPU time.
+static constexpr float SMOOTHING = 0.1f;
+
+/// Change of Scale on each step.
+static constexpr float SCALE_STEP = 0.1f;
+
+/// The steps are undone only below this fraction of the budget, so the
+/// governor does not oscillate around it.
+static constexpr float HEADROOM = 0.8f;
+
+/// Frames each step is held, the GPU time lags a few frames behind.
+static constexpr uint32 FRAMES_PER_STEP = 15u;
+
+static int32 CountOptionalCameras(const TArray<ASceneCaptureCamera *> &Cameras)
+{
+  int32 Count = 0;
+  for (const auto *Camera : Cameras) {
+    if ((Camera != nullptr) && Camera->GetRenderQuality().bOptional) {
+      ++Count;
+    }
+  }
+  return Count;
+}
+
+void FFrameBudgetGovernor::Reset(
+    const float BudgetMilliseconds,
+    const TArray<ASceneCaptureCamera *> &Cameras)
+{
+  Budget = FMath::Max(BudgetMilliseconds, 0.0f);
+  AverageGPUTime = 0.0f;
+  Scale = 1.0f;
+  NumberOfDroppedCameras = 0;
+  FramesToNextStep = FRAMES_PER_STEP;
+  Apply(Cameras);
+}
+
+void FFrameBudgetGovernor::Tick(const TArray<ASceneCaptureCamera *> &Cameras)
+{
+  if (!IsEnabled()) {
+    return;
+  }
+  const float GPUTime = FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles());
+  AverageGPUTime = (AverageGPUTime > 0.0f ?
+      FMath::Lerp(AverageGPUTime, GPUTime, SMOOTHING) :
+      GPUTime);
+  if (FramesToNextStep > 0u) {
+    --FramesToNextStep;
+    return;
+  }
+  if (AverageGPUTime > Budget) {
+    if (Scale > 0.0f) {
+      Scale = FMath::Max(Scale - SCALE_STEP, 0.0f);
+    } else if (NumberOfDroppedCameras < CountOptionalCameras(Cameras)) {
+      ++NumberOfDroppedCameras;
+    } else {
+      return;
+    }
+  } else if (AverageGPUTime < HEADROOM * Budget) {
+    if (NumberOfDroppedCameras > 0) {
+      --NumberOfDroppedCameras;
+    } else if (Scale < 1.0f) {
+      Scale = FMath::Min(Scale + SCALE_STEP, 1.0f);
+    } else {
+      return;
+    }
+  } else {
+    return;
+  }
+  Apply(Cameras);
+  FramesToNextStep = FRAMES_PER_STEP;
+}
+
+void FFrameBudgetGovernor::Apply(const TArray<ASceneCaptureCamera *> &Cameras) const
+{
+  int32 OptionalCamerasLeft = CountOptionalCameras(Cameras);
+  for (auto *Camera : Cameras) {
+    if (Camera == nullptr) {
+      continue;
+    }
+    const auto &Quality = Camera->GetRenderQuality();
+    Camera->SetScreenPercentage(FMath::Lerp(Quality.MinScreenPercentage, Quality.ScreenPercentage, Scale));
+    if (Quality.bOptional) {
+      Camera->SetDroppedByBudget(OptionalCamerasLeft <= NumberOfDroppedCameras);
+      --OptionalCamerasLeft;
+    }
+  }
+}
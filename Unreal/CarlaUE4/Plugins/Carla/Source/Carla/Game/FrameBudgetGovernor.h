@@ -0,0 +1,54 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+class ASceneCaptureCamera;
+
+/// Keeps the GPU time of the frames within a budget by lowering the
+/// resolution the cameras are rendered at, see
+/// UCarlaSettings::FrameBudgetMs.
+///
+/// When the average GPU frame time goes over budget, the screen percentage of
+/// every camera is lowered a step towards its MinScreenPercentage. Once all
+/// of them are at their minimum, the optional cameras stop capturing, the
+/// last one first. When the frames fit well within the budget again, the
+/// same steps are undone in reverse order. Each step is held for a few frames
+/// so its effect shows in the average before taking the next one.
+class CARLA_API FFrameBudgetGovernor
+{
+public:
+
+  /// Restore every camera to full quality and set the budget, zero disables
+  /// the governor.
+  void Reset(float BudgetMilliseconds, const TArray<ASceneCaptureCamera *> &Cameras);
+
+  bool IsEnabled() const
+  {
+    return Budget > 0.0f;
+  }
+
+  /// Take the GPU time of the last frame, and scale or drop @a Cameras if
+  /// a step is due.
+  void Tick(const TArray<ASceneCaptureCamera *> &Cameras);
+
+private:
+
+  void Apply(const TArray<ASceneCaptureCamera *> &Cameras) const;
+
+  float Budget = 0.0f;
+
+  float AverageGPUTime = 0.0f;
+
+  /// Position of the screen percentages between their minimum (zero) and
+  /// their configured value (one).
+  float Scale = 1.0f;
+
+  /// Number of optional cameras not capturing, counted from the last one.
+  int32 NumberOfDroppedCameras = 0;
+
+  uint32 FramesToNextStep = 0u;
+};
@@ -0,0 +1,107 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "FramePacer.h"
+
+#include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Frame Pacing Wait (ms)"), STAT_CarlaFramePacingWait, STATGROUP_Carla);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Frame Pacing Jitter (ms)"), STAT_CarlaFramePacingJitter, STATGROUP_Carla);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Frame Pacing Overruns"), STAT_CarlaFramePacingOverruns, STATGROUP_Carla);
+
+/// Weight of the last frame in the average jitter.
+static constexpr float SMOOTHING = 0.1f;
+
+static IConsoleVariable *GetMaxFPS()
+{
+  return IConsoleManager::Get().FindConsoleVariable(TEXT("t.MaxFPS"));
+}
+
+FFramePacer::~FFramePacer()
+{
+  SetEngineFrameRateLimits(false);
+}
+
+void FFramePacer::Reset(const float TargetFramesPerSecond, const float SpinMilliseconds)
+{
+  Period = (TargetFramesPerSecond > 0.0f ? 1.0 / TargetFramesPerSecond : 0.0);
+  SpinTime = FMath::Max(SpinMilliseconds, 0.0f) / 1000.0;
+  NextDeadline = 0.0;
+  LastFrameTime = 0.0;
+  LastWaitMs = 0.0f;
+  AverageJitterMs = 0.0f;
+  NumberOfOverruns = 0u;
+  SetEngineFrameRateLimits(IsEnabled());
+}
+
+void FFramePacer::Wait()
+{
+  if (!IsEnabled()) {
+    return;
+  }
+  const double Start = FPlatformTime::Seconds();
+  if (NextDeadline == 0.0) {
+    NextDeadline = Start;
+  }
+  // Sleep while the deadline is far, the scheduler may oversleep a bit, and
+  // spin the rest.
+  const double SleepTime = NextDeadline - Start - SpinTime;
+  if (SleepTime > 0.0) {
+    FPlatformProcess::SleepNoStats(static_cast<float>(SleepTime));
+  }
+  double Now = FPlatformTime::Seconds();
+  while (Now < NextDeadline) {
+    FPlatformProcess::YieldThread();
+    Now = FPlatformTime::Seconds();
+  }
+  LastWaitMs = 1000.0 * (Now - Start);
+  if (LastFrameTime > 0.0) {
+    const float JitterMs = 1000.0 * FMath::Abs((Now - LastFrameTime) - Period);
+    AverageJitterMs = FMath::Lerp(AverageJitterMs, JitterMs, SMOOTHING);
+    // Took its whole budget and more, nothing left to wait.
+    if (Start - LastFrameTime > Period) {
+      ++NumberOfOverruns;
+    }
+  }
+  LastFrameTime = Now;
+  NextDeadline += Period;
+  if (NextDeadline <= Now) {
+    // A whole period behind, start over from this frame instead of rushing
+    // the next ones to catch up.
+    NextDeadline = Now + Period;
+  }
+  SET_FLOAT_STAT(STAT_CarlaFramePacingWait, LastWaitMs);
+  SET_FLOAT_STAT(STAT_CarlaFramePacingJitter, AverageJitterMs);
+  SET_DWORD_STAT(STAT_CarlaFramePacingOverruns, NumberOfOverruns);
+}
+
+void FFramePacer::SetEngineFrameRateLimits(const bool bEnabled)
+{
+  if (GEngine == nullptr) {
+    return;
+  }
+  auto *MaxFPS = GetMaxFPS();
+  if (bEnabled && !bEngineLimitsSaved) {
+    bSavedSmoothFrameRate = GEngine->bSmoothFrameRate;
+    bSavedUseFixedFrameRate = GEngine->bUseFixedFrameRate;
+    SavedMaxFPS = (MaxFPS != nullptr ? MaxFPS->GetFloat() : 0.0f);
+    bEngineLimitsSaved = true;
+    GEngine->bSmoothFrameRate = false;
+    GEngine->bUseFixedFrameRate = false;
+    if (MaxFPS != nullptr) {
+      MaxFPS->Set(0.0f);
+    }
+  } else if (!bEnabled && bEngineLimitsSaved) {
+    GEngine->bSmoothFrameRate = bSavedSmoothFrameRate;
+    GEngine->bUseFixedFrameRate = bSavedUseFixedFrameRate;
+    if (MaxFPS != nullptr) {
+      MaxFPS->Set(SavedMaxFPS);
+    }
+    bEngineLimitsSaved = false;
+  }
+}
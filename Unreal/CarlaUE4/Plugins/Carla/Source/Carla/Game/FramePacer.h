@@ -0,0 +1,86 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+/// Ticks the game at a steady rate in asynchronous mode, see
+/// UCarlaSettings::TargetFramesPerSecond.
+///
+/// Every frame has a deadline one period after the previous one, and the game
+/// thread waits for it before sending the measurements: it sleeps until
+/// shortly before, then spins the rest, so the frames come out at an even
+/// cadence without a core busy while a frame is ahead of schedule. A frame
+/// that overruns its budget does not make the next ones hurry, the schedule
+/// restarts from it once it falls a whole period behind. The engine's own
+/// frame rate smoothing and cap are turned off meanwhile.
+class CARLA_API FFramePacer
+{
+public:
+
+  ~FFramePacer();
+
+  /// Set the target rate and restart the schedule, zero disables the pacer.
+  /// The last @a SpinMilliseconds before each deadline are spun instead of
+  /// slept.
+  void Reset(float TargetFramesPerSecond, float SpinMilliseconds);
+
+  bool IsEnabled() const
+  {
+    return Period > 0.0;
+  }
+
+  /// Wait until the deadline of this frame and schedule the next one.
+  void Wait();
+
+  /// Milliseconds the last frame waited for its deadline.
+  float GetLastWaitMs() const
+  {
+    return LastWaitMs;
+  }
+
+  /// Average deviation in milliseconds of the interval between frames from
+  /// the target period.
+  float GetJitterMs() const
+  {
+    return AverageJitterMs;
+  }
+
+  /// Frames that took longer than the period since the last reset.
+  uint32 GetNumberOfOverruns() const
+  {
+    return NumberOfOverruns;
+  }
+
+private:
+
+  /// Turn the engine's frame rate limits off while enabled, and restore them
+  /// afterwards.
+  void SetEngineFrameRateLimits(bool bEnabled);
+
+  double Period = 0.0;
+
+  double SpinTime = 0.0;
+
+  /// Zero until the first frame.
+  double NextDeadline = 0.0;
+
+  double LastFrameTime = 0.0;
+
+  float LastWaitMs = 0.0f;
+
+  float AverageJitterMs = 0.0f;
+
+  uint32 NumberOfOverruns = 0u;
+
+  /// Engine settings saved while enabled.
+  bool bEngineLimitsSaved = false;
+
+  bool bSavedSmoothFrameRate = false;
+
+  bool bSavedUseFixedFrameRate = false;
+
+  float SavedMaxFPS = 0.0f;
+};
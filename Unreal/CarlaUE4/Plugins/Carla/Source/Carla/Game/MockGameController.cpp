@@ -7,9 +7,17 @@
 #include "Carla.h"
 #include "MockGameController.h"
 
+#include "CarlaServer.h"
+#include "CarlaVehicleController.h"
+#include "Settings/CarlaSettings.h"
+
+using Errc = CarlaServer::ErrorCode;
+
 MockGameController::MockGameController(const FMockGameControllerSettings &InSettings) :
   Settings(InSettings) {}
 
+MockGameController::~MockGameController() {}
+
 void MockGameController::Initialize(UCarlaSettings &CarlaSettings)
 {
 #if WITH_EDITOR
@@ -31,12 +39,26 @@ void MockGameController::Initialize(UCarlaSettings &CarlaSettings)
     CarlaSettings.bSemanticSegmentationEnabled = true;
   }
 #endif // WITH_EDITOR
+
+  if (Settings.bSyntheticLoad) {
+    InitializeSyntheticLoad(CarlaSettings);
+  }
 }
 
 APlayerStart *MockGameController::ChoosePlayerStart(
     const TArray<APlayerStart *> &AvailableStartSpots)
 {
   check(AvailableStartSpots.Num() > 0);
+  if (Server != nullptr) {
+    uint32 StartIndex = 0u;
+    if ((Errc::Success != Server->SendSceneDescription(AvailableStartSpots, FrameArena, /*bBlocking=*/true)) ||
+        (Errc::Success != Server->ReadEpisodeStart(StartIndex, /*bBlocking=*/true))) {
+      UE_LOG(LogCarlaServer, Warning, TEXT("Failed to start the synthetic load episode, server needs restart"));
+      Server = nullptr;
+    } else {
+      return AvailableStartSpots[StartIndex % AvailableStartSpots.Num()];
+    }
+  }
   const uint32 Index =
       (Settings.bRandomPlayerStart ?
           FMath::RandRange(0, AvailableStartSpots.Num() - 1) :
@@ -48,6 +70,7 @@ APlayerStart *MockGameController::ChoosePlayerStart(
 void MockGameController::RegisterPlayer(AController &NewPlayer)
 {
   ACarlaVehicleController *VehicleController = Cast<ACarlaVehicleController>(&NewPlayer);
+  Player = VehicleController;
   if (VehicleController != nullptr) {
     VehicleController->EnableUserInput(true);
   } else {
@@ -57,10 +80,72 @@ void MockGameController::RegisterPlayer(AController &NewPlayer)
 
 void MockGameController::BeginPlay()
 {
+  SyntheticFrameTime = 0.0f;
+  if ((Server != nullptr) && (Errc::Success != Server->SendEpisodeReady(/*bBlocking=*/true))) {
+    UE_LOG(LogCarlaServer, Warning, TEXT("Failed to send episode ready, server needs restart"));
+    Server = nullptr;
+  }
+}
+
+void MockGameController::Tick(float DeltaSeconds)
+{
+  FrameArena.Reset();
+  if (Settings.bSyntheticLoad) {
+    TickSyntheticLoad(DeltaSeconds);
+  }
+}
 
+void MockGameController::InitializeSyntheticLoad(UCarlaSettings &InCarlaSettings)
+{
+  CarlaSettings = &InCarlaSettings;
+  if (Server == nullptr) {
+    UE_LOG(LogCarla, Log, TEXT("Mock controller running a synthetic load"));
+    Server = MakeUnique<CarlaServer>(CarlaSettings->WorldPort, CarlaSettings->ServerTimeOut);
+    Server->SetSocketOptions(*CarlaSettings);
+    if ((Errc::Success != Server->Connect()) ||
+        (Errc::Success != Server->ReadNewEpisode(*CarlaSettings, /*bBlocking=*/true))) {
+      UE_LOG(LogCarlaServer, Warning, TEXT("Failed to initialize, server needs restart"));
+      Server = nullptr;
+    }
+  }
 }
 
-void MockGameController::Tick(float /*DeltaSeconds*/)
+void MockGameController::TickSyntheticLoad(const float DeltaSeconds)
 {
+  if ((Server == nullptr) || (Player == nullptr)) {
+    if (Player != nullptr) {
+      UE_LOG(LogCarlaServer, Warning, TEXT("Client disconnected, server needs restart"));
+      Player->RestartLevel();
+    }
+    return;
+  }
+  check(CarlaSettings != nullptr);
 
+  switch (Server->ReadNewEpisode(*CarlaSettings, /*bBlocking=*/false)) {
+    case Errc::Success:
+      Player->RestartLevel();
+      return;
+    case Errc::Error:
+      Server = nullptr;
+      return;
+    default:
+      break;
+  }
+
+  if (Settings.SyntheticTickRate > 0.0f) {
+    const float FramePeriod = 1.0f / Settings.SyntheticTickRate;
+    SyntheticFrameTime += DeltaSeconds;
+    if (SyntheticFrameTime < FramePeriod) {
+      return;
+    }
+    SyntheticFrameTime = FMath::Fmod(SyntheticFrameTime, FramePeriod);
+  }
+
+  if ((Errc::Error == Server->SendSyntheticMeasurements(
+          Settings.SyntheticCameras,
+          FMath::Max(Settings.NumberOfSyntheticAgents, 0),
+          FrameArena)) ||
+      (Errc::Error == Server->DiscardControl(CarlaSettings->bSynchronousMode))) {
+    Server = nullptr;
+  }
 }
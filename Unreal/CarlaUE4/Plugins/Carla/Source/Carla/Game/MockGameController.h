@@ -8,14 +8,23 @@
 
 #include "CarlaGameControllerBase.h"
 #include "MockGameControllerSettings.h"
+#include "Util/FrameArena.h"
+
+class ACarlaVehicleController;
+class CarlaServer;
 
 /// Mocks the CARLA game controller class for testing purposes.
+///
+/// If FMockGameControllerSettings::bSyntheticLoad is set, it also serves a
+/// client with synthetic measurements and images, see TickSyntheticLoad.
 class CARLA_API MockGameController : public CarlaGameControllerBase
 {
 public:
 
   explicit MockGameController(const FMockGameControllerSettings &Settings);
 
+  ~MockGameController();
+
   virtual void Initialize(UCarlaSettings &CarlaSettings) override;
 
   virtual APlayerStart *ChoosePlayerStart(const TArray<APlayerStart *> &AvailableStartSpots) override;
@@ -28,5 +37,23 @@ public:
 
 private:
 
+  /// Connect to the client and read the first episode, if not connected yet.
+  void InitializeSyntheticLoad(UCarlaSettings &CarlaSettings);
+
+  /// Send the synthetic frame if it is due and read the control.
+  void TickSyntheticLoad(float DeltaSeconds);
+
   FMockGameControllerSettings Settings;
+
+  TUniquePtr<CarlaServer> Server;
+
+  /// Buffers sent to the client, released at every tick.
+  FFrameArena FrameArena;
+
+  ACarlaVehicleController *Player = nullptr;
+
+  UCarlaSettings *CarlaSettings = nullptr;
+
+  /// Time since the last synthetic frame was sent.
+  float SyntheticFrameTime = 0.0f;
 };
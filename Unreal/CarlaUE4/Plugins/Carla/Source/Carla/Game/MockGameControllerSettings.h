@@ -32,6 +32,30 @@ struct FMockGameControllerSettings
   UPROPERTY(EditAnywhere, Category = "Mock CARLA Controller")
   bool bForceEnableSemanticSegmentation = false;
 
+  /** If true, the controller connects to the client like the CARLA controller
+    * does, and sends synthetic measurements and images every tick instead of
+    * reading the world. Nothing is rendered for the client, so the networking
+    * and encoding overhead can be measured in isolation on a packaged build.
+    *
+    * The controls sent by the client are read and discarded.
+    */
+  UPROPERTY(EditAnywhere, Category = "Mock CARLA Controller|Synthetic Load")
+  bool bSyntheticLoad = false;
+
+  /** Size of the image of each fake camera, one image per camera is sent every
+    * frame.
+    */
+  UPROPERTY(EditAnywhere, Category = "Mock CARLA Controller|Synthetic Load", meta = (EditCondition = "bSyntheticLoad"))
+  TArray<FIntPoint> SyntheticCameras = {FIntPoint(800, 600)};
+
+  /** Number of fake non-player agents sent every frame. */
+  UPROPERTY(EditAnywhere, Category = "Mock CARLA Controller|Synthetic Load", meta = (EditCondition = "bSyntheticLoad", ClampMin = 0))
+  int32 NumberOfSyntheticAgents = 100;
+
+  /** Frames sent per second, if zero one frame is sent every tick. */
+  UPROPERTY(EditAnywhere, Category = "Mock CARLA Controller|Synthetic Load", meta = (EditCondition = "bSyntheticLoad", ClampMin = 0.0))
+  float SyntheticTickRate = 0.0f;
+
 #if WITH_EDITORONLY_DATA
 
   /** Override available settings in CARLA Settings (Editor only). */
@@ -0,0 +1,112 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "ResidentMaps.h"
+
+#include "Engine/LevelStreamingKismet.h"
+#include "HAL/FileManager.h"
+#include "Misc/PackageName.h"
+
+/// Size of the package of @a LongPackageName on disk, or -1 if missing.
+static int64 GetPackageSize(const FString &LongPackageName)
+{
+  FString FileName;
+  if (!FPackageName::DoesPackageExist(LongPackageName, nullptr, &FileName)) {
+    return -1;
+  }
+  return IFileManager::Get().FileSize(*FileName);
+}
+
+void FResidentMaps::Load(UWorld &World, const FString &MapNames, const uint32 MemoryBudgetMB)
+{
+  for (auto &Map : Maps) {
+    if (Map.Level.IsValid()) {
+      Map.Level->bShouldBeVisible = false;
+      Map.Level->bShouldBeLoaded = false;
+    }
+  }
+  Maps.Reset();
+  VisibleMap.Reset();
+
+  TArray<FString> Names;
+  MapNames.ParseIntoArray(Names, TEXT(","), true);
+  const int64 Budget = static_cast<int64>(MemoryBudgetMB) * 1024 * 1024;
+  int64 TotalSize = 0;
+  for (auto &Name : Names) {
+    Name = Name.Trim().TrimTrailing();
+    const FString LongName = (FPackageName::IsShortPackageName(Name) ?
+        FPackageName::SearchForPackageOnDisk(Name) :
+        Name);
+    const int64 Size = (LongName.IsEmpty() ? -1 : GetPackageSize(LongName));
+    if (Size < 0) {
+      UE_LOG(LogCarla, Warning, TEXT("Resident map \"%s\" not found"), *Name);
+      continue;
+    }
+    if ((Budget > 0) && (TotalSize + Size > Budget)) {
+      UE_LOG(LogCarla, Log, TEXT("Resident map \"%s\" does not fit in the memory budget, skipped"), *Name);
+      continue;
+    }
+    bool bSuccess = false;
+    auto *Level = ULevelStreamingKismet::LoadLevelInstance(
+        &World,
+        LongName,
+        FVector::ZeroVector,
+        FRotator::ZeroRotator,
+        bSuccess);
+    if (!bSuccess || (Level == nullptr)) {
+      UE_LOG(LogCarla, Warning, TEXT("Failed to load resident map \"%s\""), *Name);
+      continue;
+    }
+    Level->bShouldBeVisible = false;
+    TotalSize += Size;
+    Maps.Add({FPackageName::GetShortName(LongName), Level});
+  }
+  World.FlushLevelStreaming();
+  UE_LOG(
+      LogCarla,
+      Log,
+      TEXT("%d resident maps loaded, %.1f MB on disk"),
+      Maps.Num(),
+      static_cast<float>(TotalSize) / (1024.0f * 1024.0f));
+}
+
+const FString &FResidentMaps::GetDefaultMap() const
+{
+  static const FString None;
+  return (Maps.Num() > 0 ? Maps[0].Name : None);
+}
+
+bool FResidentMaps::Contains(const FString &MapName) const
+{
+  return Find(MapName) != nullptr;
+}
+
+bool FResidentMaps::Show(UWorld &World, const FString &MapName)
+{
+  const auto *Shown = Find(MapName);
+  if ((Shown == nullptr) || !Shown->Level.IsValid()) {
+    return false;
+  }
+  // Hidden first, so both maps are never in the world at the same time.
+  for (auto &Map : Maps) {
+    if ((&Map != Shown) && Map.Level.IsValid()) {
+      Map.Level->bShouldBeVisible = false;
+    }
+  }
+  World.FlushLevelStreaming(EFlushLevelStreamingType::Visibility);
+  Shown->Level->bShouldBeVisible = true;
+  World.FlushLevelStreaming(EFlushLevelStreamingType::Visibility);
+  VisibleMap = Shown->Name;
+  UE_LOG(LogCarla, Log, TEXT("Showing resident map \"%s\""), *VisibleMap);
+  return true;
+}
+
+const FResidentMaps::FMap *FResidentMaps::Find(const FString &MapName) const
+{
+  const FString ShortName = FPackageName::GetShortName(MapName);
+  return Maps.FindByPredicate([&](const FMap &Map) { return Map.Name == ShortName; });
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+class ULevelStreaming;
+class UWorld;
+
+/// Keeps several maps loaded as streamed sub-levels of the persistent level,
+/// only one of them visible at a time, see UCarlaSettings::ResidentMaps.
+///
+/// A streamed level loaded but not visible is not added to the world, its
+/// actors neither tick, render nor collide. Switching map hides the visible
+/// level and shows another one without touching the disk.
+class CARLA_API FResidentMaps
+{
+public:
+
+  /// Load, hidden, the first maps of the comma-separated @a MapNames that fit
+  /// within @a MemoryBudgetMB, zero for no limit. The size of each map is
+  /// estimated by the size of its package on disk. The maps loaded before
+  /// are unloaded.
+  void Load(UWorld &World, const FString &MapNames, uint32 MemoryBudgetMB);
+
+  bool IsEmpty() const
+  {
+    return Maps.Num() == 0;
+  }
+
+  bool Contains(const FString &MapName) const;
+
+  /// Make @a MapName the only map visible, blocks until the world is
+  /// updated. Returns false, leaving the world untouched, if @a MapName is
+  /// not resident.
+  bool Show(UWorld &World, const FString &MapName);
+
+  /// The first map loaded, empty if none.
+  const FString &GetDefaultMap() const;
+
+  /// Empty if no map was shown yet.
+  const FString &GetVisibleMap() const
+  {
+    return VisibleMap;
+  }
+
+private:
+
+  struct FMap
+  {
+    /// Short name, as in the settings.
+    FString Name;
+
+    TWeakObjectPtr<ULevelStreaming> Level;
+  };
+
+  const FMap *Find(const FString &MapName) const;
+
+  TArray<FMap> Maps;
+
+  FString VisibleMap;
+};
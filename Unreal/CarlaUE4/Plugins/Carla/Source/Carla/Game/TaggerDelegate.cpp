@@ -21,6 +21,11 @@ void UTaggerDelegate::RegisterSpawnHandler(UWorld *InWorld)
 void UTaggerDelegate::OnActorSpawned(AActor* InActor)
 {
   if (InActor != nullptr) {
-    ATagger::TagActor(*InActor, bSemanticSegmentationEnabled);
+    ATagger::TagActor(*InActor, bSemanticSegmentationEnabled, LabelCache);
   }
 }
+
+void UTaggerDelegate::TagActorsInLevel(UWorld &World, const bool bTagForSemanticSegmentation)
+{
+  ATagger::TagActorsInLevel(World, bTagForSemanticSegmentation, LabelCache);
+}
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include "Tagger.h"
 #include "TaggerDelegate.generated.h"
 
 /// Used to tag every actor that is spawned into the world.
@@ -27,9 +28,15 @@ public:
 
   void OnActorSpawned(AActor *Actor);
 
+  /// Tag every actor in @a World, sharing the label cache with the actors
+  /// spawned later.
+  void TagActorsInLevel(UWorld &World, bool bTagForSemanticSegmentation);
+
 private:
 
   FOnActorSpawned::FDelegate ActorSpawnedDelegate;
 
   bool bSemanticSegmentationEnabled = false;
+
+  ATagger::FLabelCache LabelCache;
 };
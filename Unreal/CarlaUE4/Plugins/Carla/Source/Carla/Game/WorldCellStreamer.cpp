@@ -0,0 +1,129 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "WorldCellStreamer.h"
+
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMeshActor.h"
+#include "EngineUtils.h"
+
+#include "CarlaVehicleController.h"
+#include "MapGen/CityMapMeshHolder.h"
+#include "SceneCaptureCamera.h"
+
+/// Cells are streamed out only beyond this fraction of the radius, so a cell
+/// at the edge does not go in and out every frame.
+static constexpr float UNLOAD_MARGIN = 1.2f;
+
+/// The cells are updated only once a source moved this fraction of the
+/// radius.
+static constexpr float UPDATE_DISTANCE = 0.1f;
+
+static bool IsStreamable(const UPrimitiveComponent *Component)
+{
+  return (Component != nullptr) &&
+         Component->IsRegistered() &&
+         Component->IsVisible() &&
+         (Component->Mobility == EComponentMobility::Static);
+}
+
+void FWorldCellStreamer::Reset(UWorld &World, const float InRadius, const bool bInStreamCollision)
+{
+  LoadAll();
+  Cells.Reset();
+  LastSources.Reset();
+  Radius = FMath::Max(InRadius, 0.0f);
+  bStreamCollision = bInStreamCollision;
+  if (!IsEnabled()) {
+    return;
+  }
+  auto AddCell = [this](UPrimitiveComponent *Component) {
+    if (IsStreamable(Component)) {
+      Cells.Add({Component, Component->Bounds.GetBox(), Component->GetCollisionEnabled(), true});
+    }
+  };
+  for (TActorIterator<ACityMapMeshHolder> It(&World); It; ++It) {
+    for (auto *Instantiator : It->GetInstantiators()) {
+      if ((Instantiator != nullptr) && (Instantiator->GetInstanceCount() > 0)) {
+        AddCell(Instantiator);
+      }
+    }
+  }
+  for (TActorIterator<AStaticMeshActor> It(&World); It; ++It) {
+    AddCell(It->GetStaticMeshComponent());
+  }
+  UE_LOG(LogCarla, Log, TEXT("Streaming %d cells within %.1f cm of the player"), Cells.Num(), Radius);
+}
+
+void FWorldCellStreamer::Tick(const ACarlaVehicleController &Player)
+{
+  if (!IsEnabled()) {
+    return;
+  }
+  TArray<FVector, TInlineAllocator<8u>> Sources;
+  const APawn *Pawn = Player.GetPawn();
+  if (Pawn != nullptr) {
+    Sources.Add(Pawn->GetActorLocation());
+  }
+  for (const auto *Camera : Player.GetSceneCaptureCameras()) {
+    if (Camera != nullptr) {
+      Sources.Add(Camera->GetActorLocation());
+    }
+  }
+  if (Sources.Num() == 0) {
+    return;
+  }
+
+  // Update only if the sources changed or moved enough since the last time.
+  bool bShouldUpdate = (Sources.Num() != LastSources.Num());
+  const float UpdateDistanceSquared = FMath::Square(UPDATE_DISTANCE * Radius);
+  for (auto i = 0; !bShouldUpdate && (i < Sources.Num()); ++i) {
+    bShouldUpdate = (FVector::DistSquared(Sources[i], LastSources[i]) > UpdateDistanceSquared);
+  }
+  if (!bShouldUpdate) {
+    return;
+  }
+  LastSources = Sources;
+
+  const float LoadDistanceSquared = FMath::Square(Radius);
+  const float UnloadDistanceSquared = FMath::Square(UNLOAD_MARGIN * Radius);
+  for (auto &Cell : Cells) {
+    float DistanceSquared = TNumericLimits<float>::Max();
+    for (const auto &Source : Sources) {
+      DistanceSquared = FMath::Min(DistanceSquared, Cell.Bounds.ComputeSquaredDistanceToPoint(Source));
+    }
+    if (!Cell.bLoaded && (DistanceSquared <= LoadDistanceSquared)) {
+      SetLoaded(Cell, true);
+    } else if (Cell.bLoaded && (DistanceSquared > UnloadDistanceSquared)) {
+      SetLoaded(Cell, false);
+    }
+  }
+}
+
+void FWorldCellStreamer::SetLoaded(FCell &Cell, const bool bLoaded) const
+{
+  Cell.bLoaded = bLoaded;
+  auto *Component = Cell.Component.Get();
+  if (Component == nullptr) {
+    return;
+  }
+  // A hidden component is removed from the scene, its render proxy and GPU
+  // buffers are released.
+  Component->SetVisibility(bLoaded);
+  if (bStreamCollision) {
+    Component->SetCollisionEnabled(bLoaded ? Cell.Collision : ECollisionEnabled::NoCollision);
+  }
+}
+
+void FWorldCellStreamer::LoadAll()
+{
+  for (auto &Cell : Cells) {
+    if (!Cell.bLoaded) {
+      SetLoaded(Cell, true);
+    }
+  }
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Engine/EngineTypes.h"
+
+class ACarlaVehicleController;
+class UPrimitiveComponent;
+
+/// Keeps in the scene only the static meshes of the level around the player
+/// and its cameras, see UCarlaSettings::StreamingRadius.
+///
+/// The cells of the generated city (see
+/// ACityMapMeshHolder::StreamingCellSize) and the static props placed in the
+/// level are streamed in once they come within the radius of the player or
+/// any of its cameras, and out once they are farther than the radius plus a
+/// margin. Streamed out meshes have no render proxy, so they cost neither GPU
+/// memory nor culling time, and optionally no collision either. The instances
+/// stay in memory, so streaming a cell in does not touch the disk.
+class CARLA_API FWorldCellStreamer
+{
+public:
+
+  /// Stream in everything streamed out so far and gather the meshes of
+  /// @a World to stream with @a Radius, zero disables the streamer.
+  void Reset(UWorld &World, float Radius, bool bStreamCollision);
+
+  bool IsEnabled() const
+  {
+    return Radius > 0.0f;
+  }
+
+  /// Stream the cells in or out if the player or its cameras moved enough
+  /// since the last update.
+  void Tick(const ACarlaVehicleController &Player);
+
+private:
+
+  struct FCell
+  {
+    TWeakObjectPtr<UPrimitiveComponent> Component;
+
+    FBox Bounds;
+
+    /// The collision the component had before being streamed out.
+    ECollisionEnabled::Type Collision;
+
+    bool bLoaded;
+  };
+
+  void SetLoaded(FCell &Cell, bool bLoaded) const;
+
+  /// Stream in every cell.
+  void LoadAll();
+
+  TArray<FCell> Cells;
+
+  /// Where the player and its cameras were on the last update.
+  TArray<FVector> LastSources;
+
+  float Radius = 0.0f;
+
+  bool bStreamCollision = false;
+};
@@ -0,0 +1,345 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "WorldSnapshot.h"
+
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+#include "AI/TrafficLightTimer.h"
+#include "AI/VehicleSpawnerBase.h"
+#include "AI/WalkerAIController.h"
+#include "AI/WalkerSpawnerBase.h"
+#include "CarlaVehicleController.h"
+#include "CarlaWheeledVehicle.h"
+#include "Util/RandomEngine.h"
+
+DECLARE_CYCLE_STAT(TEXT("World Snapshot"), STAT_CarlaWorldSnapshot, STATGROUP_Carla);
+
+static constexpr uint32 SNAPSHOT_MAGIC = 0x53574343u; // "CCWS"
+
+static constexpr uint32 SNAPSHOT_VERSION = 1u;
+
+// =============================================================================
+// -- Snapshot layout ----------------------------------------------------------
+// =============================================================================
+
+/// The state of a pawn and its controller. The controller is serialized by
+/// its own class into a nested buffer, applied once the whole snapshot is
+/// validated.
+struct FPawnState
+{
+  FString Name;
+
+  FTransform Transform;
+
+  FVector LinearVelocity = FVector::ZeroVector;
+
+  FVector AngularVelocity = FVector::ZeroVector;
+
+  bool bReverse = false;
+
+  TArray<uint8> ControllerState;
+
+  friend FArchive &operator<<(FArchive &Ar, FPawnState &State)
+  {
+    Ar << State.Name;
+    Ar << State.Transform;
+    Ar << State.LinearVelocity;
+    Ar << State.AngularVelocity;
+    Ar << State.bReverse;
+    Ar << State.ControllerState;
+    return Ar;
+  }
+};
+
+struct FWorldState
+{
+  uint32 Magic = SNAPSHOT_MAGIC;
+
+  uint32 Version = SNAPSHOT_VERSION;
+
+  FGuid Episode;
+
+  FPawnState Player;
+
+  TArray<FPawnState> Vehicles;
+
+  TArray<FPawnState> Walkers;
+
+  TArray<uint8> TrafficLights;
+
+  TArray<uint8> VehicleRandomEngine;
+
+  TArray<uint8> WalkerRandomEngine;
+
+  friend FArchive &operator<<(FArchive &Ar, FWorldState &State)
+  {
+    Ar << State.Magic;
+    Ar << State.Version;
+    if (Ar.IsLoading() && ((State.Magic != SNAPSHOT_MAGIC) || (State.Version != SNAPSHOT_VERSION))) {
+      Ar.ArIsError = true;
+      return Ar;
+    }
+    Ar << State.Episode;
+    Ar << State.Player;
+    Ar << State.Vehicles;
+    Ar << State.Walkers;
+    Ar << State.TrafficLights;
+    Ar << State.VehicleRandomEngine;
+    Ar << State.WalkerRandomEngine;
+    return Ar;
+  }
+};
+
+// =============================================================================
+// -- Static local functions ---------------------------------------------------
+// =============================================================================
+
+/// Serialize @a Object's state into @a Data with its SerializeState-like
+/// method @a Serialize.
+template <typename T, typename F>
+static void SaveNested(T &Object, F Serialize, TArray<uint8> &Data)
+{
+  FMemoryWriter Writer(Data);
+  (Object.*Serialize)(Writer);
+}
+
+template <typename T, typename F>
+static bool LoadNested(T &Object, F Serialize, const TArray<uint8> &Data)
+{
+  FMemoryReader Reader(Data);
+  (Object.*Serialize)(Reader);
+  return !Reader.IsError();
+}
+
+static void GetVelocities(const APawn &Pawn, FPawnState &State)
+{
+  auto *Character = Cast<ACharacter>(&Pawn);
+  if ((Character != nullptr) && (Character->GetCharacterMovement() != nullptr)) {
+    State.LinearVelocity = Character->GetCharacterMovement()->Velocity;
+    return;
+  }
+  auto *Primitive = Cast<UPrimitiveComponent>(Pawn.GetRootComponent());
+  if (Primitive != nullptr) {
+    State.LinearVelocity = Primitive->GetPhysicsLinearVelocity();
+    State.AngularVelocity = Primitive->GetPhysicsAngularVelocity();
+  }
+}
+
+static void SetVelocities(APawn &Pawn, const FPawnState &State)
+{
+  auto *Character = Cast<ACharacter>(&Pawn);
+  if ((Character != nullptr) && (Character->GetCharacterMovement() != nullptr)) {
+    Character->GetCharacterMovement()->Velocity = State.LinearVelocity;
+    return;
+  }
+  auto *Primitive = Cast<UPrimitiveComponent>(Pawn.GetRootComponent());
+  if (Primitive != nullptr) {
+    Primitive->SetPhysicsLinearVelocity(State.LinearVelocity);
+    Primitive->SetPhysicsAngularVelocity(State.AngularVelocity);
+  }
+}
+
+static FPawnState SaveVehicle(ACarlaWheeledVehicle &Vehicle)
+{
+  FPawnState State;
+  State.Name = Vehicle.GetName();
+  State.Transform = Vehicle.GetActorTransform();
+  State.bReverse = Vehicle.IsInReverse();
+  GetVelocities(Vehicle, State);
+  auto *Controller = Cast<AWheeledVehicleAIController>(Vehicle.GetController());
+  if (Controller != nullptr) {
+    SaveNested(*Controller, &AWheeledVehicleAIController::SerializeAutopilotState, State.ControllerState);
+  }
+  return State;
+}
+
+static bool RestoreVehicle(ACarlaWheeledVehicle &Vehicle, const FPawnState &State)
+{
+  // Kinematic bodies take no velocity.
+  Vehicle.StopResting();
+  Vehicle.SetActorTransform(State.Transform, false, nullptr, ETeleportType::TeleportPhysics);
+  SetVelocities(Vehicle, State);
+  Vehicle.SetReverse(State.bReverse);
+  auto *Controller = Cast<AWheeledVehicleAIController>(Vehicle.GetController());
+  return
+      (Controller == nullptr) ||
+      (State.ControllerState.Num() == 0) ||
+      LoadNested(*Controller, &AWheeledVehicleAIController::SerializeAutopilotState, State.ControllerState);
+}
+
+static FPawnState SaveWalker(ACharacter &Walker)
+{
+  FPawnState State;
+  State.Name = Walker.GetName();
+  State.Transform = Walker.GetActorTransform();
+  GetVelocities(Walker, State);
+  auto *Controller = Cast<AWalkerAIController>(Walker.GetController());
+  if (Controller != nullptr) {
+    SaveNested(*Controller, &AWalkerAIController::SerializeState, State.ControllerState);
+  }
+  return State;
+}
+
+static bool RestoreWalker(ACharacter &Walker, const FPawnState &State)
+{
+  Walker.SetActorTransform(State.Transform, false, nullptr, ETeleportType::TeleportPhysics);
+  SetVelocities(Walker, State);
+  auto *Controller = Cast<AWalkerAIController>(Walker.GetController());
+  return
+      (Controller == nullptr) ||
+      (State.ControllerState.Num() == 0) ||
+      LoadNested(*Controller, &AWalkerAIController::SerializeState, State.ControllerState);
+}
+
+static ACarlaWheeledVehicle *GetPlayerVehicle(const FWorldSnapshot::FContext &Context)
+{
+  return (Context.Player != nullptr ? Context.Player->GetPossessedVehicle() : nullptr);
+}
+
+static TArray<ACharacter *> GetWalkers(const AWalkerSpawnerBase *WalkerSpawner)
+{
+  TArray<ACharacter *> Walkers;
+  if (WalkerSpawner != nullptr) {
+    Walkers.Append(WalkerSpawner->GetWalkersWhiteList());
+    Walkers.Append(WalkerSpawner->GetWalkersBlackList());
+  }
+  return Walkers;
+}
+
+// =============================================================================
+// -- FWorldSnapshot -----------------------------------------------------------
+// =============================================================================
+
+void FWorldSnapshot::Save(const FContext &Context, TArray<uint8> &Data)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaWorldSnapshot);
+  FWorldState State;
+  State.Episode = Context.Episode;
+  auto *Player = GetPlayerVehicle(Context);
+  if (Player != nullptr) {
+    State.Player = SaveVehicle(*Player);
+  }
+  if (Context.VehicleSpawner != nullptr) {
+    for (auto *Vehicle : Context.VehicleSpawner->GetVehicles()) {
+      if (IsValid(Vehicle)) {
+        State.Vehicles.Emplace(SaveVehicle(*Vehicle));
+      }
+    }
+    SaveNested(*Context.VehicleSpawner->GetRandomEngine(), &URandomEngine::SerializeState, State.VehicleRandomEngine);
+  }
+  for (auto *Walker : GetWalkers(Context.WalkerSpawner)) {
+    if (IsValid(Walker)) {
+      State.Walkers.Emplace(SaveWalker(*Walker));
+    }
+  }
+  if (Context.WalkerSpawner != nullptr) {
+    SaveNested(*Context.WalkerSpawner->GetRandomEngine(), &URandomEngine::SerializeState, State.WalkerRandomEngine);
+  }
+  if (Context.TrafficLightTimer != nullptr) {
+    SaveNested(*Context.TrafficLightTimer, &ATrafficLightTimer::SerializeState, State.TrafficLights);
+  }
+  Data.Reset();
+  FMemoryWriter Writer(Data);
+  Writer << State;
+  UE_LOG(
+      LogCarla,
+      Log,
+      TEXT("World snapshot taken: %d vehicles, %d walkers, %d bytes"),
+      State.Vehicles.Num(),
+      State.Walkers.Num(),
+      Data.Num());
+}
+
+bool FWorldSnapshot::Restore(const FContext &Context, const TArray<uint8> &Data)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaWorldSnapshot);
+  FWorldState State;
+  FMemoryReader Reader(Data);
+  Reader << State;
+  if (Reader.IsError()) {
+    UE_LOG(LogCarla, Error, TEXT("World snapshot: invalid data"));
+    return false;
+  }
+  if (State.Episode != Context.Episode) {
+    UE_LOG(LogCarla, Error, TEXT("World snapshot: taken in another episode"));
+    return false;
+  }
+
+  // Validate everything before touching the world.
+  TArray<ACarlaWheeledVehicle *> Vehicles;
+  if (Context.VehicleSpawner != nullptr) {
+    for (auto *Vehicle : Context.VehicleSpawner->GetVehicles()) {
+      if (IsValid(Vehicle)) {
+        Vehicles.Add(Vehicle);
+      }
+    }
+  }
+  if (Vehicles.Num() != State.Vehicles.Num()) {
+    UE_LOG(
+        LogCarla,
+        Error,
+        TEXT("World snapshot: %d vehicles saved, but there are %d"),
+        State.Vehicles.Num(),
+        Vehicles.Num());
+    return false;
+  }
+  for (auto i = 0; i < Vehicles.Num(); ++i) {
+    if (Vehicles[i]->GetName() != State.Vehicles[i].Name) {
+      UE_LOG(LogCarla, Error, TEXT("World snapshot: vehicle %s is gone"), *State.Vehicles[i].Name);
+      return false;
+    }
+  }
+  auto *Player = GetPlayerVehicle(Context);
+  if ((Player == nullptr) || (Player->GetName() != State.Player.Name)) {
+    UE_LOG(LogCarla, Error, TEXT("World snapshot: the player's vehicle changed"));
+    return false;
+  }
+
+  // Traffic lights first, they update the vehicles waiting at them.
+  bool bSuccess = true;
+  if (Context.TrafficLightTimer != nullptr) {
+    bSuccess &= LoadNested(*Context.TrafficLightTimer, &ATrafficLightTimer::SerializeState, State.TrafficLights);
+  }
+  bSuccess &= RestoreVehicle(*Player, State.Player);
+  for (auto i = 0; i < Vehicles.Num(); ++i) {
+    bSuccess &= RestoreVehicle(*Vehicles[i], State.Vehicles[i]);
+  }
+  TMap<FString, ACharacter *> Walkers;
+  for (auto *Walker : GetWalkers(Context.WalkerSpawner)) {
+    if (IsValid(Walker)) {
+      Walkers.Add(Walker->GetName(), Walker);
+    }
+  }
+  int32 MissingWalkers = 0;
+  for (auto &WalkerState : State.Walkers) {
+    auto *Walker = Walkers.FindRef(WalkerState.Name);
+    if (Walker != nullptr) {
+      bSuccess &= RestoreWalker(*Walker, WalkerState);
+    } else {
+      ++MissingWalkers;
+    }
+  }
+  if (Context.VehicleSpawner != nullptr) {
+    bSuccess &= LoadNested(*Context.VehicleSpawner->GetRandomEngine(), &URandomEngine::SerializeState, State.VehicleRandomEngine);
+  }
+  if (Context.WalkerSpawner != nullptr) {
+    bSuccess &= LoadNested(*Context.WalkerSpawner->GetRandomEngine(), &URandomEngine::SerializeState, State.WalkerRandomEngine);
+  }
+  if (MissingWalkers > 0) {
+    UE_LOG(LogCarla, Warning, TEXT("World snapshot: %d walkers are gone and were not restored"), MissingWalkers);
+  }
+  if (!bSuccess) {
+    UE_LOG(LogCarla, Error, TEXT("World snapshot: failed to restore some of the actors"));
+  } else {
+    UE_LOG(LogCarla, Log, TEXT("World snapshot restored"));
+  }
+  return bSuccess;
+}
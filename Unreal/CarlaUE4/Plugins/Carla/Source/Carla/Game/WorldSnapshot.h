@@ -0,0 +1,48 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+class ACarlaVehicleController;
+class ATrafficLightTimer;
+class AVehicleSpawnerBase;
+class AWalkerSpawnerBase;
+
+/// Binary snapshot of the state of the world that evolves during an episode,
+/// so the client can fork the episode by restoring it as many times as it
+/// wants without reloading anything.
+///
+/// It holds the transform and velocities of the player and of every vehicle
+/// and walker, the state of their controllers, the traffic lights and the
+/// random engines of the spawners. Actors are matched by name, and a snapshot
+/// is only valid within the episode it was taken from. The internal state of
+/// the physics engine (wheels, suspension, engine revolutions) is not kept.
+class CARLA_API FWorldSnapshot
+{
+public:
+
+  /// The actors of the current episode the snapshot applies to.
+  struct FContext
+  {
+    ACarlaVehicleController *Player = nullptr;
+
+    AVehicleSpawnerBase *VehicleSpawner = nullptr;
+
+    AWalkerSpawnerBase *WalkerSpawner = nullptr;
+
+    ATrafficLightTimer *TrafficLightTimer = nullptr;
+
+    /// Identifies the episode, snapshots of other episodes are rejected.
+    FGuid Episode;
+  };
+
+  static void Save(const FContext &Context, TArray<uint8> &Data);
+
+  /// Nothing is applied if @a Data does not belong to this episode or the
+  /// vehicles differ. Walkers are spawned and destroyed as the episode goes
+  /// on, only those still alive are restored.
+  static bool Restore(const FContext &Context, const TArray<uint8> &Data);
+};
@@ -0,0 +1,182 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "ImageDiskWriter.h"
+
+#include "HAL/RunnableThread.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "ModuleManager.h"
+#include "Paths.h"
+
+DECLARE_CYCLE_STAT(TEXT("Queue Image To Disk"), STAT_CarlaQueueImageToDisk, STATGROUP_Carla);
+
+/// Time the threads wait on an event before checking the queue again, so a
+/// wake-up taken by another thread is never missed for long.
+static constexpr uint32 WAIT_TIME_MS = 50u;
+
+static const TCHAR *GetExtension(const EImageFileFormat Format)
+{
+  switch (Format) {
+    case EImageFileFormat::Raw:     return TEXT("bgr");
+    case EImageFileFormat::RawZlib: return TEXT("bgr.z");
+    default:                        return TEXT("png");
+  }
+}
+
+static TArray<uint8> PackBGR(const TArray<FColor> &BitMap)
+{
+  TArray<uint8> Packed;
+  Packed.SetNumUninitialized(3 * BitMap.Num());
+  uint8 *Dest = Packed.GetData();
+  for (const FColor &Color : BitMap) {
+    *Dest++ = Color.B;
+    *Dest++ = Color.G;
+    *Dest++ = Color.R;
+  }
+  return Packed;
+}
+
+FImageDiskWriter::FImageDiskWriter(const uint32 NumberOfThreads, const uint32 InMaxQueuedImages)
+  : ImageWrapperModule(FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"))),
+    MaxQueuedImages(FMath::Max(InMaxQueuedImages, 1u)),
+    ImageQueued(FPlatformProcess::GetSynchEventFromPool(false)),
+    ImageTaken(FPlatformProcess::GetSynchEventFromPool(false))
+{
+  const uint32 Count = FMath::Max(NumberOfThreads, 1u);
+  for (uint32 i = 0u; i < Count; ++i) {
+    Workers.Emplace(MakeUnique<FWorker>(*this));
+    Threads.Add(FRunnableThread::Create(
+        Workers.Last().Get(),
+        *FString::Printf(TEXT("CarlaImageDiskWriter%d"), i),
+        0u,
+        TPri_BelowNormal));
+  }
+}
+
+FImageDiskWriter::~FImageDiskWriter()
+{
+  {
+    FScopeLock Lock(&Mutex);
+    bStopping = true;
+  }
+  for (auto *Thread : Threads) {
+    ImageQueued->Trigger();
+    if (Thread != nullptr) {
+      Thread->WaitForCompletion();
+      delete Thread;
+    }
+  }
+  FPlatformProcess::ReturnSynchEventToPool(ImageQueued);
+  FPlatformProcess::ReturnSynchEventToPool(ImageTaken);
+}
+
+void FImageDiskWriter::Write(
+    const FString &FilePath,
+    TArray<FColor> &&BitMap,
+    const FIntPoint &Size,
+    const EImageFileFormat Format)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaQueueImageToDisk);
+  FImage Image;
+  Image.FilePath = FPaths::GetBaseFilename(FilePath, false) + TEXT(".") + GetExtension(Format);
+  Image.BitMap = MoveTemp(BitMap);
+  Image.Size = Size;
+  Image.Format = Format;
+  for (;;) {
+    {
+      FScopeLock Lock(&Mutex);
+      if (Queue.Num() < MaxQueuedImages) {
+        Queue.Emplace(MoveTemp(Image));
+        break;
+      }
+    }
+    ImageTaken->Wait(WAIT_TIME_MS);
+  }
+  ImageQueued->Trigger();
+}
+
+int32 FImageDiskWriter::GetNumberOfQueuedImages() const
+{
+  FScopeLock Lock(&Mutex);
+  return Queue.Num();
+}
+
+bool FImageDiskWriter::Pop(FImage &Image)
+{
+  for (;;) {
+    {
+      FScopeLock Lock(&Mutex);
+      if (Queue.Num() > 0) {
+        Image = MoveTemp(Queue[0]);
+        Queue.RemoveAt(0, 1, false);
+        break;
+      }
+      if (bStopping) {
+        return false;
+      }
+    }
+    ImageQueued->Wait(WAIT_TIME_MS);
+  }
+  ImageTaken->Trigger();
+  return true;
+}
+
+bool FImageDiskWriter::WriteToDisk(FImage &Image) const
+{
+  switch (Image.Format) {
+    case EImageFileFormat::Raw:
+      return FFileHelper::SaveArrayToFile(PackBGR(Image.BitMap), *Image.FilePath);
+    case EImageFileFormat::RawZlib: {
+      const TArray<uint8> Packed = PackBGR(Image.BitMap);
+      int32 CompressedSize = FCompression::CompressMemoryBound(COMPRESS_ZLIB, Packed.Num());
+      TArray<uint8> Compressed;
+      Compressed.SetNumUninitialized(CompressedSize);
+      if (!FCompression::CompressMemory(
+              static_cast<ECompressionFlags>(COMPRESS_ZLIB | COMPRESS_BiasSpeed),
+              Compressed.GetData(),
+              CompressedSize,
+              Packed.GetData(),
+              Packed.Num())) {
+        return false;
+      }
+      Compressed.SetNum(CompressedSize, false);
+      return FFileHelper::SaveArrayToFile(Compressed, *Image.FilePath);
+    }
+    default: {
+      // PNG keeps the alpha channel, make it opaque.
+      for (FColor &Color : Image.BitMap) {
+        Color.A = 255u;
+      }
+      TSharedPtr<IImageWrapper> Wrapper = ImageWrapperModule.CreateImageWrapper(EImageFormat::PNG);
+      if (!Wrapper.IsValid() ||
+          !Wrapper->SetRaw(
+              Image.BitMap.GetData(),
+              Image.BitMap.Num() * sizeof(FColor),
+              Image.Size.X,
+              Image.Size.Y,
+              ERGBFormat::BGRA,
+              8)) {
+        return false;
+      }
+      return FFileHelper::SaveArrayToFile(Wrapper->GetCompressed(), *Image.FilePath);
+    }
+  }
+}
+
+uint32 FImageDiskWriter::FWorker::Run()
+{
+  FImage Image;
+  while (Writer.Pop(Image)) {
+    if (!Writer.WriteToDisk(Image)) {
+      UE_LOG(LogCarla, Error, TEXT("ImageDiskWriter: Failed to write %s"), *Image.FilePath);
+    }
+  }
+  return 0u;
+}
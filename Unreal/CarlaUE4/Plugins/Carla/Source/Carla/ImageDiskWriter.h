@@ -0,0 +1,108 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "HAL/Runnable.h"
+#include "ImageDiskWriter.generated.h"
+
+class FRunnableThread;
+class IImageWrapperModule;
+
+/// Format of the image files written to disk.
+UENUM(BlueprintType)
+enum class EImageFileFormat : uint8
+{
+  /// PNG, lossless but slowest to encode.
+  PNG       UMETA(DisplayName = "PNG"),
+  /// Raw BGR pixels, 3 bytes per pixel, no header.
+  Raw       UMETA(DisplayName = "Raw BGR"),
+  /// Raw BGR pixels compressed with zlib at its fastest level.
+  RawZlib   UMETA(DisplayName = "Raw BGR, zlib")
+};
+
+/// Pool of threads encoding and writing images to disk in the background.
+///
+/// Images are queued in a bounded queue, so the game thread only pays for
+/// moving the bitmap in. If the writers fall behind and the queue is full,
+/// Write blocks until there is room, no image is dropped. The alpha channel
+/// is dropped while encoding, in the writer threads.
+class FImageDiskWriter
+{
+public:
+
+  FImageDiskWriter(uint32 NumberOfThreads, uint32 MaxQueuedImages);
+
+  FImageDiskWriter(const FImageDiskWriter &) = delete;
+
+  FImageDiskWriter &operator=(const FImageDiskWriter &) = delete;
+
+  /// Waits until every image queued is written.
+  ~FImageDiskWriter();
+
+  /// Queue @a BitMap to be written to @a FilePath, the extension is replaced
+  /// by the one of @a Format.
+  void Write(
+      const FString &FilePath,
+      TArray<FColor> &&BitMap,
+      const FIntPoint &Size,
+      EImageFileFormat Format);
+
+  /// Number of images queued and not yet taken by a writer thread.
+  int32 GetNumberOfQueuedImages() const;
+
+private:
+
+  struct FImage
+  {
+    FString FilePath;
+
+    TArray<FColor> BitMap;
+
+    FIntPoint Size;
+
+    EImageFileFormat Format;
+  };
+
+  class FWorker : public FRunnable
+  {
+  public:
+
+    explicit FWorker(FImageDiskWriter &Writer) : Writer(Writer) {}
+
+    virtual uint32 Run() override;
+
+  private:
+
+    FImageDiskWriter &Writer;
+  };
+
+  /// Take the oldest image queued, waiting for one. Returns false once
+  /// stopping and the queue is empty.
+  bool Pop(FImage &Image);
+
+  bool WriteToDisk(FImage &Image) const;
+
+  IImageWrapperModule &ImageWrapperModule;
+
+  const int32 MaxQueuedImages;
+
+  mutable FCriticalSection Mutex;
+
+  TArray<FImage> Queue;
+
+  bool bStopping = false;
+
+  /// Signaled when an image is queued.
+  FEvent *ImageQueued = nullptr;
+
+  /// Signaled when an image is taken from the queue.
+  FEvent *ImageTaken = nullptr;
+
+  TArray<TUniquePtr<FWorker>> Workers;
+
+  TArray<FRunnableThread *> Threads;
+};
@@ -7,7 +7,7 @@
 #include "Carla.h"
 #include "CityMapMeshHolder.h"
 
-#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
 #include "Engine/StaticMesh.h"
 
 #include <vector>
@@ -43,7 +43,8 @@ void ACityMapMeshHolder::OnConstruction(const FTransform &Transform)
   if (MeshInstatiators.Num() == 0) {
     ResetInstantiators();
     UpdateMapScale();
-    UpdateMap();
+    UpdateMapInBatches();
+    BuildInstantiators();
   }
 }
 
@@ -51,10 +52,20 @@ void ACityMapMeshHolder::OnConstruction(const FTransform &Transform)
 void ACityMapMeshHolder::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
 {
   Super::PostEditChangeProperty(PropertyChangedEvent);
-  if (PropertyChangedEvent.Property) {
+  if (PropertyChangedEvent.Property == nullptr) {
+    return;
+  }
+  if (!IsMapUpToDate()) {
     ResetInstantiators();
     UpdateMapScale();
-    UpdateMap();
+    UpdateMapInBatches();
+    BuildInstantiators();
+  } else {
+    // Only the meshes of some tags may have changed, the instances stay.
+    const int32 Count = UpdateStaticMeshes();
+    if (Count > 0) {
+      UE_LOG(LogCarla, Log, TEXT("Updated the static mesh of %d instantiators"), Count);
+    }
   }
 }
 #endif // WITH_EDITOR
@@ -107,16 +118,69 @@ void ACityMapMeshHolder::AddInstance(ECityMapMeshTag Tag, uint32 X, uint32 Y, fl
 
 void ACityMapMeshHolder::AddInstance(ECityMapMeshTag Tag, FTransform Transform)
 {
-  auto &instantiator = GetInstantiator(Tag);
+  if (bCollectInstances) {
+    PendingInstances.FindOrAdd(Tag).Add(Transform);
+    return;
+  }
+  auto &instantiator = GetInstantiator(Tag, GetCellIndex(Transform.GetLocation()));
   instantiator.AddInstance(Transform);
 }
 
+void ACityMapMeshHolder::AddInstances(ECityMapMeshTag Tag, TArrayView<const FTransform> Transforms)
+{
+  TMap<int32, TArray<FTransform>> TransformsByCell;
+  for (const auto &Transform : Transforms) {
+    TransformsByCell.FindOrAdd(GetCellIndex(Transform.GetLocation())).Add(Transform);
+  }
+  for (const auto &Item : TransformsByCell) {
+    auto &instantiator = GetInstantiator(Tag, Item.Key);
+    // An unregistered component does not update its render state nor create
+    // any physics body per instance, it does it for all of them when
+    // registered again.
+    const bool bWasRegistered = instantiator.IsRegistered();
+    if (bWasRegistered) {
+      instantiator.UnregisterComponent();
+    }
+    for (const auto &Transform : Item.Value) {
+      instantiator.AddInstance(Transform);
+    }
+    if (bWasRegistered) {
+      instantiator.RegisterComponent();
+    }
+  }
+}
+
 // =============================================================================
 // -- Private methods ----------------------------------------------------------
 // =============================================================================
 
 void ACityMapMeshHolder::UpdateMap() {}
 
+bool ACityMapMeshHolder::IsMapUpToDate() const
+{
+  return false;
+}
+
+int32 ACityMapMeshHolder::UpdateStaticMeshes()
+{
+  TagMap.Reset();
+  for (const auto &Item : StaticMeshes) {
+    if (Item.Value != nullptr) {
+      TagMap.Add(Item.Value, Item.Key);
+    }
+  }
+  int32 Count = 0;
+  for (int32 i = 0; i < MeshInstatiators.Num(); ++i) {
+    auto *instantiator = MeshInstatiators[i];
+    auto *Mesh = GetStaticMesh(CityMapMeshTag::FromUInt(i % NUMBER_OF_TAGS));
+    if ((instantiator != nullptr) && (instantiator->GetStaticMesh() != Mesh)) {
+      instantiator->SetStaticMesh(Mesh);
+      ++Count;
+    }
+  }
+  return Count;
+}
+
 void ACityMapMeshHolder::ResetInstantiators()
 {
   for (auto *instantiator : MeshInstatiators) {
@@ -124,17 +188,45 @@ void ACityMapMeshHolder::ResetInstantiators()
       instantiator->ClearInstances();
     }
   }
+  // The cells may be laid out differently now, keep only the first one.
+  for (int32 i = NUMBER_OF_TAGS; i < MeshInstatiators.Num(); ++i) {
+    if (MeshInstatiators[i] != nullptr) {
+      MeshInstatiators[i]->DestroyComponent();
+    }
+  }
+  CellIndices.Empty();
   if (MeshInstatiators.Num() != NUMBER_OF_TAGS) {
-    MeshInstatiators.Empty();
-    MeshInstatiators.Init(nullptr, NUMBER_OF_TAGS);
+    MeshInstatiators.SetNumZeroed(NUMBER_OF_TAGS);
   }
   check(MeshInstatiators.Num() == NUMBER_OF_TAGS);
   for (tag_size_t i = 0u; i < NUMBER_OF_TAGS; ++i) {
-    auto &instantiator = GetInstantiator(CityMapMeshTag::FromUInt(i));
+    auto &instantiator = GetInstantiator(CityMapMeshTag::FromUInt(i), 0);
     instantiator.SetStaticMesh(GetStaticMesh(CityMapMeshTag::FromUInt(i)));
   }
 }
 
+void ACityMapMeshHolder::UpdateMapInBatches()
+{
+  PendingInstances.Reset();
+  bCollectInstances = true;
+  UpdateMap();
+  bCollectInstances = false;
+  for (const auto &Item : PendingInstances) {
+    AddInstances(Item.Key, Item.Value);
+  }
+  PendingInstances.Empty();
+}
+
+void ACityMapMeshHolder::BuildInstantiators()
+{
+  for (auto *instantiator : MeshInstatiators) {
+    auto *hierarchical = Cast<UHierarchicalInstancedStaticMeshComponent>(instantiator);
+    if (hierarchical != nullptr) {
+      hierarchical->BuildTreeIfOutdated(false, true);
+    }
+  }
+}
+
 void ACityMapMeshHolder::UpdateMapScale()
 {
   auto Tag = CityMapMeshTag::GetBaseMeshTag();
@@ -152,17 +244,39 @@ void ACityMapMeshHolder::UpdateMapScale()
   }
 }
 
-UInstancedStaticMeshComponent &ACityMapMeshHolder::GetInstantiator(ECityMapMeshTag Tag)
+int32 ACityMapMeshHolder::GetCellIndex(const FVector &Location)
+{
+  FIntPoint Cell(0, 0);
+  if (StreamingCellSize > 0u) {
+    const float CellSize = StreamingCellSize * MapScale;
+    Cell.X = FMath::FloorToInt(Location.X / CellSize);
+    Cell.Y = FMath::FloorToInt(Location.Y / CellSize);
+  }
+  const int32 *Index = CellIndices.Find(Cell);
+  if (Index != nullptr) {
+    return *Index;
+  }
+  const int32 NewIndex = CellIndices.Num();
+  CellIndices.Add(Cell, NewIndex);
+  const int32 Count = (NewIndex + 1) * NUMBER_OF_TAGS;
+  if (MeshInstatiators.Num() < Count) {
+    MeshInstatiators.SetNumZeroed(Count);
+  }
+  return NewIndex;
+}
+
+UInstancedStaticMeshComponent &ACityMapMeshHolder::GetInstantiator(ECityMapMeshTag Tag, int32 CellIndex)
 {
-  UInstancedStaticMeshComponent *instantiator = MeshInstatiators[CityMapMeshTag::ToUInt(Tag)];
+  const int32 Index = CellIndex * NUMBER_OF_TAGS + CityMapMeshTag::ToUInt(Tag);
+  UInstancedStaticMeshComponent *instantiator = MeshInstatiators[Index];
   if (instantiator == nullptr) {
     // Create and register an instantiator.
-    instantiator = NewObject<UInstancedStaticMeshComponent>(this);
+    instantiator = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
     instantiator->SetMobility(EComponentMobility::Static);
     instantiator->SetCollisionObjectType(ECollisionChannel::ECC_WorldStatic);
     instantiator->SetupAttachment(SceneRootComponent);
     instantiator->SetStaticMesh(GetStaticMesh(Tag));
-    MeshInstatiators[CityMapMeshTag::ToUInt(Tag)] = instantiator;
+    MeshInstatiators[Index] = instantiator;
     instantiator->RegisterComponent();
   }
   check(instantiator != nullptr);
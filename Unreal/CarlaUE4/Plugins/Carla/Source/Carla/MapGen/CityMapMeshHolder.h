@@ -7,6 +7,7 @@
 #pragma once
 
 #include "GameFramework/Actor.h"
+#include "Containers/ArrayView.h"
 #include "CityMapMeshTag.h"
 #include "CityMapMeshHolder.generated.h"
 
@@ -27,6 +28,13 @@ public:
   /// However, instances cannot be added until OnConstruction is called.
   ACityMapMeshHolder(const FObjectInitializer& ObjectInitializer);
 
+  /// The components holding the instances, one per mesh and streaming cell.
+  /// May contain null entries.
+  const TArray<UInstancedStaticMeshComponent *> &GetInstantiators() const
+  {
+    return MeshInstatiators;
+  }
+
 protected:
 
   /// Initializes the instantiators.
@@ -47,6 +55,11 @@ protected:
     return MapScale;
   }
 
+  uint32 GetStreamingCellSize() const
+  {
+    return StreamingCellSize;
+  }
+
   /// Return the 3D world location (relative to this actor) of the given 2D
   /// tile.
   FVector GetTileLocation(uint32 X, uint32 Y) const;
@@ -76,11 +89,19 @@ protected:
   ///   @param Angle Rotation around Z axis
   void AddInstance(ECityMapMeshTag Tag, uint32 X, uint32 Y, float Angle);
 
-  /// Add an instance of a mesh with a given transform.
+  /// Add an instance of a mesh with a given transform. While the map is
+  /// updated the instances are collected and added in batches once it is
+  /// done, see AddInstances.
   ///   @param Tag The mesh' tag
   ///   @param Transform Transform that will be applied to the mesh
   void AddInstance(ECityMapMeshTag Tag, FTransform Transform);
 
+  /// Add instances of a mesh with the given transforms. Each component gets
+  /// its instances at once, updating its render and physics state only once.
+  ///   @param Tag The mesh' tag
+  ///   @param Transforms Transforms that will be applied to the mesh
+  void AddInstances(ECityMapMeshTag Tag, TArrayView<const FTransform> Transforms);
+
   // ===========================================================================
   // -- Private methods and members --------------------------------------------
   // ===========================================================================
@@ -89,14 +110,35 @@ private:
   /// Here does nothing, implement in derived classes.
   virtual void UpdateMap();
 
+  /// Whether the instances already added match the current properties, so
+  /// editing a property does not need to regenerate the map. The static
+  /// meshes are not taken into account, see UpdateStaticMeshes. Here always
+  /// false, implement in derived classes.
+  virtual bool IsMapUpToDate() const;
+
+  /// Give the instantiators of each tag the static mesh now set for the tag,
+  /// keeping their instances. Returns the number of instantiators changed.
+  int32 UpdateStaticMeshes();
+
   /// Clear all instances in the instantiators and update the static meshes.
   void ResetInstantiators();
 
+  /// Update the map collecting the instances added, and add them in batches.
+  void UpdateMapInBatches();
+
+  /// Build the cluster tree of every instantiator, once all the instances of
+  /// the map have been added.
+  void BuildInstantiators();
+
   /// Set the scale to the dimensions of the base mesh.
   void UpdateMapScale();
 
+  /// Index of the streaming cell @a Location (relative to this actor) falls
+  /// in, adds the cell if new.
+  int32 GetCellIndex(const FVector &Location);
+
   /// Creates a new one if necessary.
-  UInstancedStaticMeshComponent &GetInstantiator(ECityMapMeshTag Tag);
+  UInstancedStaticMeshComponent &GetInstantiator(ECityMapMeshTag Tag, int32 CellIndex);
 
   UPROPERTY()
   USceneComponent *SceneRootComponent;
@@ -104,6 +146,19 @@ private:
   UPROPERTY(Category = "Map Generation", VisibleAnywhere)
   float MapScale;
 
+  /** Size in map units of the square cells the instances are grouped in, each
+    * cell gets its own components so it can be streamed in and out around
+    * the player (see StreamingRadius in CarlaSettings). Zero keeps every
+    * instance of a mesh in a single component.
+    */
+  UPROPERTY(Category = "Map Generation", EditAnywhere, meta = (ClampMax = "200"))
+  uint32 StreamingCellSize = 0u;
+
+  /// Index of each streaming cell, the instantiators of the cell i are at
+  /// [i * NumberOfTags, (i + 1) * NumberOfTags).
+  UPROPERTY()
+  TMap<FIntPoint, int32> CellIndices;
+
   UPROPERTY(Category = "Meshes", EditAnywhere)
   TMap<ECityMapMeshTag, UStaticMesh *> StaticMeshes;
 
@@ -112,4 +167,9 @@ private:
 
   UPROPERTY(Category = "Meshes", VisibleAnywhere)
   TArray<UInstancedStaticMeshComponent *> MeshInstatiators;
+
+  /// Instances added while the map is updated, by tag.
+  TMap<ECityMapMeshTag, TArray<FTransform>> PendingInstances;
+
+  bool bCollectInstances = false;
 };
@@ -8,15 +8,18 @@
 
 #include "GraphTypes.h"
 #include "Position.h"
+#include "Util/ChunkedVector.h"
 #include "Util/ListView.h"
 
 #include <array>
-#include <list>
 
 namespace MapGen {
 
   /// Simple doubly-connected edge list structure. It only allows adding
   /// elements, not removing them.
+  ///
+  /// Elements are stored in chunks of contiguous memory and never move, so
+  /// the pointers linking them stay valid as the graph grows.
   class CARLA_API DoublyConnectedEdgeList : private NonCopyable
   {
     // =========================================================================
@@ -73,15 +76,15 @@ namespace MapGen {
       HalfEdge *HalfEdge = nullptr;
     };
 
-    using NodeContainer = std::list<Node>;
+    using NodeContainer = ChunkedVector<Node>;
     using NodeIterator = typename NodeContainer::iterator;
     using ConstNodeIterator = typename NodeContainer::const_iterator;
 
-    using HalfEdgeContainer = std::list<HalfEdge>;
+    using HalfEdgeContainer = ChunkedVector<HalfEdge>;
     using HalfEdgeIterator = typename HalfEdgeContainer::iterator;
     using ConstHalfEdgeIterator = typename HalfEdgeContainer::const_iterator;
 
-    using FaceContainer = std::list<Face>;
+    using FaceContainer = ChunkedVector<Face>;
     using FaceIterator = typename FaceContainer::iterator;
     using ConstFaceIterator = typename FaceContainer::const_iterator;
 
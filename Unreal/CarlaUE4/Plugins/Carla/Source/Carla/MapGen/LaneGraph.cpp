@@ -0,0 +1,275 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "LaneGraph.h"
+
+#include "MapGen/DoublyConnectedEdgeList.h"
+#include "MapGen/RoadMap.h"
+
+#include "Algo/Reverse.h"
+
+// =============================================================================
+// -- Static local methods -----------------------------------------------------
+// =============================================================================
+
+/// Number of road map samples across the road to find the lane center.
+static constexpr int32 LANE_CENTER_SAMPLES = 64;
+
+/// Routes kept in the cache, the least recently used are evicted first.
+static constexpr int32 MAX_CACHED_ROUTES = 4096;
+
+static float GetDistanceToSegmentSquared2D(
+    const FVector &Point,
+    const FVector &Start,
+    const FVector &End)
+{
+  const FVector Closest = FMath::ClosestPointOnSegment(Point, Start, End);
+  return FVector::DistSquaredXY(Point, Closest);
+}
+
+/// Lateral offset (in cm, to the right of @a Direction) of the lane going
+/// along @a Direction at the road center @a Location, found by sampling the
+/// road map across the road. Both in local space of @a ActorTransform.
+static bool FindLaneOffset(
+    const URoadMap &RoadMap,
+    const FTransform &ActorTransform,
+    const FVector &Location,
+    const FVector &Direction,
+    const float MapScale,
+    float &Offset)
+{
+  const FVector Right(-Direction.Y, Direction.X, 0.0f);
+  const FVector WorldDirection = ActorTransform.TransformVectorNoScale(Direction);
+  FVector Samples[LANE_CENTER_SAMPLES];
+  FRoadMapPixelData Data[LANE_CENTER_SAMPLES];
+  for (auto i = 0; i < LANE_CENTER_SAMPLES; ++i) {
+    const float Lateral = MapScale * (2.0f * i / (LANE_CENTER_SAMPLES - 1) - 1.0f);
+    Samples[i] = ActorTransform.TransformPosition(Location + Right * Lateral);
+  }
+  RoadMap.GetDataAt(MakeArrayView(Samples), MakeArrayView(Data));
+  float Sum = 0.0f;
+  int32 Count = 0;
+  for (auto i = 0; i < LANE_CENTER_SAMPLES; ++i) {
+    if (Data[i].IsRoad() &&
+        Data[i].HasDirection() &&
+        (FVector::DotProduct(Data[i].GetDirection(), WorldDirection) > 0.7f)) {
+      Sum += MapScale * (2.0f * i / (LANE_CENTER_SAMPLES - 1) - 1.0f);
+      ++Count;
+    }
+  }
+  if (Count == 0) {
+    return false;
+  }
+  Offset = Sum / Count;
+  return true;
+}
+
+// =============================================================================
+// -- ULaneGraph ---------------------------------------------------------------
+// =============================================================================
+
+void ULaneGraph::Build(
+    const MapGen::DoublyConnectedEdgeList &Dcel,
+    const FTransform &ActorTransform,
+    const float MapScale,
+    const uint32 IntersectionMargin,
+    const URoadMap &RoadMap,
+    const bool bLeftHandTraffic)
+{
+  using Graph = MapGen::DoublyConnectedEdgeList;
+
+  Intersections.Reset();
+  Lanes.Reset();
+  RouteCache.Reset();
+
+  auto GetLocalLocation = [=](const Graph::Position &Position) {
+    return FVector(Position.x * MapScale, Position.y * MapScale, 0.0f);
+  };
+
+  TMap<const Graph::Node *, int32> NodeIndices;
+  for (auto &Node : Dcel.GetNodes()) {
+    NodeIndices.Add(&Node, Intersections.Num());
+    Intersections.Add(ActorTransform.TransformPosition(GetLocalLocation(Node.GetPosition())));
+  }
+
+  // One lane per half-edge.
+  TMap<const Graph::HalfEdge *, int32> LaneIndices;
+  for (auto &Edge : Dcel.GetHalfEdges()) {
+    const auto &Source = Graph::GetSource(Edge);
+    const auto &Target = Graph::GetTarget(Edge);
+    const FVector SourceLocation = GetLocalLocation(Source.GetPosition());
+    const FVector TargetLocation = GetLocalLocation(Target.GetPosition());
+    const FVector Direction = (TargetLocation - SourceLocation).GetSafeNormal2D();
+    const float Margin = MapScale * IntersectionMargin;
+    const float EdgeLength = FVector::Dist(SourceLocation, TargetLocation);
+    if (Direction.IsNearlyZero() || (EdgeLength <= 2.0f * Margin)) {
+      continue;
+    }
+
+    float Offset;
+    if (!FindLaneOffset(
+            RoadMap,
+            ActorTransform,
+            0.5f * (SourceLocation + TargetLocation),
+            Direction,
+            MapScale,
+            Offset)) {
+      // Assume the lane lies at the middle of its half of the road.
+      Offset = (bLeftHandTraffic ? -0.25f : 0.25f) * MapScale;
+    }
+    const FVector Right(-Direction.Y, Direction.X, 0.0f);
+
+    FLaneGraphLane Lane;
+    Lane.Source = NodeIndices[&Source];
+    Lane.Target = NodeIndices[&Target];
+    Lane.Points.Add(ActorTransform.TransformPosition(
+        SourceLocation + Direction * Margin + Right * Offset));
+    Lane.Points.Add(ActorTransform.TransformPosition(
+        TargetLocation - Direction * Margin + Right * Offset));
+    Lane.Length = FVector::Dist(Lane.Points[0], Lane.Points[1]);
+    LaneIndices.Add(&Edge, Lanes.Add(Lane));
+  }
+
+  // Connect each lane with the lanes leaving its target, but the way back.
+  for (auto &Item : LaneIndices) {
+    const auto &Edge = *Item.Key;
+    const auto &Pair = Graph::GetPair(Edge);
+    const auto &First = Graph::GetLeavingHalfEdge(Graph::GetTarget(Edge));
+    const auto *Next = &First;
+    do {
+      const int32 *NextLane = LaneIndices.Find(Next);
+      if ((Next != &Pair) && (NextLane != nullptr)) {
+        Lanes[Item.Value].NextLanes.Add(*NextLane);
+      }
+      Next = &Graph::GetNextInNode(*Next);
+    } while (Next != &First);
+  }
+
+  UE_LOG(LogCarla, Log, TEXT("Generated lane graph with %d intersections and %d lanes"), Intersections.Num(), Lanes.Num());
+}
+
+int32 ULaneGraph::FindLane(const FVector &Location, const FVector &Forward) const
+{
+  int32 Result = INDEX_NONE;
+  float MinDistance = TNumericLimits<float>::Max();
+  for (auto i = 0; i < Lanes.Num(); ++i) {
+    const auto &Points = Lanes[i].Points;
+    float Distance = TNumericLimits<float>::Max();
+    for (auto j = 1; j < Points.Num(); ++j) {
+      float Penalty = 0.0f;
+      // Prefer the lanes going our way.
+      if (FVector::DotProduct(Points[j] - Points[j - 1], Forward) < 0.0f) {
+        Penalty = 1e8f;
+      }
+      Distance = FMath::Min(
+          Distance,
+          GetDistanceToSegmentSquared2D(Location, Points[j - 1], Points[j]) + Penalty);
+    }
+    if (Distance < MinDistance) {
+      MinDistance = Distance;
+      Result = i;
+    }
+  }
+  return Result;
+}
+
+const TArray<int32> *ULaneGraph::GetRoute(const int32 FromLane, const int32 ToLane) const
+{
+  check(Lanes.IsValidIndex(FromLane) && Lanes.IsValidIndex(ToLane));
+  const FIntPoint Key(FromLane, ToLane);
+  FCachedRoute *Cached = RouteCache.Find(Key);
+  if (Cached == nullptr) {
+    // Evict the oldest quarter at once, so the scan is amortized over many
+    // misses.
+    if (RouteCache.Num() >= MAX_CACHED_ROUTES) {
+      RouteCache.ValueSort([](const FCachedRoute &Lhs, const FCachedRoute &Rhs) {
+        return Lhs.LastUsed > Rhs.LastUsed;
+      });
+      int32 Index = 0;
+      for (auto It = RouteCache.CreateIterator(); It; ++It) {
+        if (Index++ >= MAX_CACHED_ROUTES * 3 / 4) {
+          It.RemoveCurrent();
+        }
+      }
+      RouteCache.Compact();
+    }
+    // Dijkstra over the lanes, the cost of a lane is its length plus the way
+    // through the intersection to the next one.
+    TArray<float> Costs;
+    Costs.Init(TNumericLimits<float>::Max(), Lanes.Num());
+    TArray<int32> Previous;
+    Previous.Init(INDEX_NONE, Lanes.Num());
+    using FItem = TPair<float, int32>;
+    TArray<FItem> Heap;
+    auto Less = [](const FItem &Lhs, const FItem &Rhs) { return Lhs.Key < Rhs.Key; };
+    Costs[FromLane] = 0.0f;
+    Heap.HeapPush(FItem(0.0f, FromLane), Less);
+    while (Heap.Num() > 0) {
+      FItem Item;
+      Heap.HeapPop(Item, Less);
+      const int32 Lane = Item.Value;
+      if ((Lane == ToLane) || (Item.Key > Costs[Lane])) {
+        continue;
+      }
+      for (const int32 Next : Lanes[Lane].NextLanes) {
+        const float Cost = Costs[Lane] + Lanes[Lane].Length +
+            FVector::Dist(Lanes[Lane].Points.Last(), Lanes[Next].Points[0]);
+        if (Cost < Costs[Next]) {
+          Costs[Next] = Cost;
+          Previous[Next] = Lane;
+          Heap.HeapPush(FItem(Cost, Next), Less);
+        }
+      }
+    }
+    TArray<int32> Route;
+    if ((FromLane == ToLane) || (Previous[ToLane] != INDEX_NONE)) {
+      for (int32 Lane = ToLane; Lane != INDEX_NONE; Lane = (Lane == FromLane ? INDEX_NONE : Previous[Lane])) {
+        Route.Add(Lane);
+      }
+      Algo::Reverse(Route);
+    }
+    FCachedRoute Entry;
+    Entry.Lanes = MoveTemp(Route);
+    Cached = &RouteCache.Add(Key, MoveTemp(Entry));
+  }
+  Cached->LastUsed = ++RouteCacheClock;
+  return (Cached->Lanes.Num() > 0 ? &Cached->Lanes : nullptr);
+}
+
+bool ULaneGraph::GetRouteWaypoints(
+    const FVector &Location,
+    const FVector &Forward,
+    const FVector &Destination,
+    TArray<FVector> &Waypoints,
+    TArray<int32> *RouteLanes) const
+{
+  const int32 FromLane = FindLane(Location, Forward);
+  const int32 ToLane = FindLane(Destination, FVector::ZeroVector);
+  if ((FromLane == INDEX_NONE) || (ToLane == INDEX_NONE)) {
+    return false;
+  }
+  const auto *Route = GetRoute(FromLane, ToLane);
+  if (Route == nullptr) {
+    return false;
+  }
+  if (RouteLanes != nullptr) {
+    RouteLanes->Append(*Route);
+  }
+  for (auto i = 0; i < Route->Num(); ++i) {
+    const auto &Points = Lanes[(*Route)[i]].Points;
+    // The start of the first lane is likely behind us, and the destination
+    // is somewhere along the last lane.
+    const int32 First = (i == 0 ? Points.Num() - 1 : 0);
+    const int32 Last = (i == Route->Num() - 1 ? Points.Num() - 1 : Points.Num());
+    for (auto j = First; j < Last; ++j) {
+      Waypoints.Add(Points[j]);
+    }
+  }
+  const auto &LastPoints = Lanes[ToLane].Points;
+  Waypoints.Add(FMath::ClosestPointOnSegment(Destination, LastPoints[LastPoints.Num() - 2], LastPoints.Last()));
+  return true;
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "UObject/NoExportTypes.h"
+#include "LaneGraph.generated.h"
+
+class URoadMap;
+
+namespace MapGen {
+  class DoublyConnectedEdgeList;
+} // namespace MapGen
+
+/// A lane of the lane graph, from one intersection to the next one.
+USTRUCT()
+struct FLaneGraphLane
+{
+  GENERATED_BODY()
+
+  /// Index of the intersection the lane leaves.
+  UPROPERTY(VisibleAnywhere)
+  int32 Source = INDEX_NONE;
+
+  /// Index of the intersection the lane enters.
+  UPROPERTY(VisibleAnywhere)
+  int32 Target = INDEX_NONE;
+
+  /// Lane center polyline in world space, without the intersections.
+  UPROPERTY(VisibleAnywhere)
+  TArray<FVector> Points;
+
+  /// Lanes that can be taken at the target intersection.
+  UPROPERTY(VisibleAnywhere)
+  TArray<int32> NextLanes;
+
+  UPROPERTY(VisibleAnywhere)
+  float Length = 0.0f;
+};
+
+/// Graph of the lanes of the city, with nodes at the intersections. Built
+/// along with the road map, the road layout gives the graph and the road map
+/// gives the side of the road of each lane.
+///
+/// Routes between lanes are computed on demand and cached, as the vehicles
+/// and the clients keep asking for the same ones. The cache keeps only the
+/// routes used most recently.
+UCLASS()
+class CARLA_API ULaneGraph : public UObject
+{
+  GENERATED_BODY()
+
+public:
+
+  /// Build the graph from the road layout in @a Dcel, whose positions are in
+  /// map units of @a MapScale cm, and the road map already generated for the
+  /// same layout.
+  void Build(
+      const MapGen::DoublyConnectedEdgeList &Dcel,
+      const FTransform &ActorTransform,
+      float MapScale,
+      uint32 IntersectionMargin,
+      const URoadMap &RoadMap,
+      bool bLeftHandTraffic);
+
+  bool IsValid() const
+  {
+    return Lanes.Num() > 0;
+  }
+
+  const TArray<FLaneGraphLane> &GetLanes() const
+  {
+    return Lanes;
+  }
+
+  const TArray<FVector> &GetIntersections() const
+  {
+    return Intersections;
+  }
+
+  /// Find the lane closest to @a Location going along @a Forward. Returns
+  /// INDEX_NONE if the graph is empty.
+  int32 FindLane(const FVector &Location, const FVector &Forward) const;
+
+  /// Get the sequence of lanes from @a FromLane to @a ToLane, both included.
+  /// Returns null if @a ToLane cannot be reached. Valid until the next call.
+  const TArray<int32> *GetRoute(int32 FromLane, int32 ToLane) const;
+
+  /// Append to @a Waypoints the lane center points to drive from
+  /// @a Location, heading @a Forward, to @a Destination, and to @a RouteLanes
+  /// the lanes they belong to if not null. Returns false if no route was
+  /// found.
+  bool GetRouteWaypoints(
+      const FVector &Location,
+      const FVector &Forward,
+      const FVector &Destination,
+      TArray<FVector> &Waypoints,
+      TArray<int32> *RouteLanes = nullptr) const;
+
+private:
+
+  UPROPERTY(VisibleAnywhere)
+  TArray<FVector> Intersections;
+
+  UPROPERTY(VisibleAnywhere)
+  TArray<FLaneGraphLane> Lanes;
+
+  struct FCachedRoute
+  {
+    TArray<int32> Lanes;
+
+    /// Value of RouteCacheClock the last time the route was used.
+    uint64 LastUsed = 0u;
+  };
+
+  /// Routes already computed, by source and target lane.
+  mutable TMap<FIntPoint, FCachedRoute> RouteCache;
+
+  mutable uint64 RouteCacheClock = 0u;
+};
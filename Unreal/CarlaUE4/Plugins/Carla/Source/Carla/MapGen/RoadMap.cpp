@@ -7,6 +7,7 @@
 #include "Carla.h"
 #include "RoadMap.h"
 
+#include "Async/ParallelFor.h"
 #include "FileHelper.h"
 #include "HighResScreenshot.h"
 
@@ -27,6 +28,52 @@ static uint32 ClampFloatToUInt(const float Value, int32 Min, int32 Max)
   return FMath::Clamp(FMath::FloorToInt(Value), Min, Max);
 }
 
+/// Units of the distance field per pixel, the 3-4 chamfer distance keeps the
+/// error under a tenth of the euclidean distance.
+static constexpr int32 DISTANCE_UNITS_PER_PIXEL = 3;
+
+/// Two-pass chamfer transform. Return, for every pixel, the distance to the
+/// closest pixel for which @a IsTarget is true.
+template <typename P>
+static TArray<int32> ComputeChamferDistance(
+    const TArray<uint16> &Data,
+    const int32 Width,
+    const int32 Height,
+    P IsTarget)
+{
+  constexpr int32 Orthogonal = DISTANCE_UNITS_PER_PIXEL;
+  constexpr int32 Diagonal = 4;
+  TArray<int32> Distance;
+  Distance.SetNumUninitialized(Data.Num());
+  for (auto i = 0; i < Data.Num(); ++i) {
+    Distance[i] = (IsTarget(FRoadMapPixelData(Data[i])) ? 0 : MAX_int32 / 2);
+  }
+  auto Relax = [&](const int32 Index, const int32 X, const int32 Y, const int32 Cost) {
+    if ((X >= 0) && (X < Width) && (Y >= 0) && (Y < Height)) {
+      Distance[Index] = FMath::Min(Distance[Index], Distance[X + Width * Y] + Cost);
+    }
+  };
+  for (auto Y = 0; Y < Height; ++Y) {
+    for (auto X = 0; X < Width; ++X) {
+      const int32 Index = X + Width * Y;
+      Relax(Index, X - 1, Y,     Orthogonal);
+      Relax(Index, X - 1, Y - 1, Diagonal);
+      Relax(Index, X,     Y - 1, Orthogonal);
+      Relax(Index, X + 1, Y - 1, Diagonal);
+    }
+  }
+  for (auto Y = Height - 1; Y >= 0; --Y) {
+    for (auto X = Width - 1; X >= 0; --X) {
+      const int32 Index = X + Width * Y;
+      Relax(Index, X + 1, Y,     Orthogonal);
+      Relax(Index, X + 1, Y + 1, Diagonal);
+      Relax(Index, X,     Y + 1, Orthogonal);
+      Relax(Index, X - 1, Y + 1, Diagonal);
+    }
+  }
+  return Distance;
+}
+
 // Return the azimuth angle (in spherical coordinates) rotated by PI so it lies
 // in the range [0, 2*PI].
 static float GetRotatedAzimuthAngle(const FVector &Direction)
@@ -47,6 +94,20 @@ uint16 FRoadMapPixelData::Encode(bool IsRoad, bool HasDirection, const FVector &
   return (IsRoad << IsRoadRow) | (HasDirection << HasDirectionRow) | (AngleAsUInt);
 }
 
+const TArray<FVector2D> &FRoadMapPixelData::GetDirectionTable()
+{
+  static const TArray<FVector2D> Table = [](){
+    TArray<FVector2D> Directions;
+    Directions.SetNumUninitialized(AngleMask + 1);
+    for (auto i = 0; i < Directions.Num(); ++i) {
+      const float Azimuth = FRoadMapPixelData(static_cast<uint16>(i)).GetDirectionAzimuthalAngle();
+      Directions[i] = FVector2D(FMath::Cos(Azimuth), FMath::Sin(Azimuth));
+    }
+    return Directions;
+  }();
+  return Table;
+}
+
 FColor FRoadMapPixelData::EncodeAsColor() const
 {
   if (!IsRoad()) {
@@ -78,6 +139,37 @@ URoadMap::URoadMap(const FObjectInitializer& ObjectInitializer) :
       "Declaration map of FRoadMapPixelData's value does not match current serialization type");
 }
 
+void URoadMap::PostLoad()
+{
+  Super::PostLoad();
+  if (IsValid() && (DistanceField.Num() != RoadMapData.Num())) {
+    GenerateDistanceField();
+  }
+  // The editor may generate the map again, it needs the dense arrays.
+  if (!GIsEditor && IsValid()) {
+    CompactToTiles();
+  }
+}
+
+void URoadMap::CompactToTiles()
+{
+  check(IsValid() && (DistanceField.Num() == RoadMapData.Num()));
+  const SIZE_T DenseSize = RoadMapData.GetAllocatedSize() + DistanceField.GetAllocatedSize();
+  RoadMapTiles.Build(RoadMapData, Width, Height);
+  DistanceTiles.Build(DistanceField, Width, Height);
+  RoadMapData.Empty();
+  DistanceField.Empty();
+  const SIZE_T TiledSize = RoadMapTiles.GetAllocatedSize() + DistanceTiles.GetAllocatedSize();
+  UE_LOG(
+      LogCarla,
+      Log,
+      TEXT("Compacted road map %dx%d from %.2fMB to %.2fMB"),
+      Width,
+      Height,
+      static_cast<float>(DenseSize) / (1024.0f * 1024.0f),
+      static_cast<float>(TiledSize) / (1024.0f * 1024.0f));
+}
+
 void URoadMap::Reset(
     const uint32 inWidth,
     const uint32 inHeight,
@@ -85,7 +177,10 @@ void URoadMap::Reset(
     const FTransform &inWorldToMap,
     const FVector &inMapOffset)
 {
+  RoadMapTiles.Reset();
+  DistanceTiles.Reset();
   RoadMapData.Init(0u, inWidth * inHeight);
+  DistanceField.Init(0, inWidth * inHeight);
   Width = inWidth;
   Height = inHeight;
   PixelsPerCentimeter = inPixelsPerCentimeter;
@@ -196,6 +291,23 @@ void URoadMap::SetPixelAt(
   RoadMapData[GetIndex(PixelX, PixelY)] = Value;
 }
 
+void URoadMap::GenerateDistanceField()
+{
+  check(IsValid() && RoadMapTiles.IsEmpty());
+  const auto ToRoad = ComputeChamferDistance(RoadMapData, Width, Height, [](const FRoadMapPixelData &Data) {
+    return Data.IsRoad();
+  });
+  const auto ToOffRoad = ComputeChamferDistance(RoadMapData, Width, Height, [](const FRoadMapPixelData &Data) {
+    return !Data.IsRoad();
+  });
+  DistanceField.SetNumUninitialized(RoadMapData.Num());
+  for (auto i = 0; i < RoadMapData.Num(); ++i) {
+    const int32 Distance = (FRoadMapPixelData(RoadMapData[i]).IsRoad() ? ToOffRoad[i] : -ToRoad[i]);
+    constexpr int32 MaxDistance = MaxDistanceInPixels * DISTANCE_UNITS_PER_PIXEL;
+    DistanceField[i] = FMath::Clamp(Distance, -MaxDistance, MaxDistance);
+  }
+}
+
 FVector URoadMap::GetWorldLocation(uint32 PixelX, uint32 PixelY) const
 {
   const FVector RelativePosition(
@@ -208,44 +320,165 @@ FVector URoadMap::GetWorldLocation(uint32 PixelX, uint32 PixelY) const
 FRoadMapPixelData URoadMap::GetDataAt(const FVector &WorldLocation) const
 {
   check(IsValid());
-  const FVector Location = WorldToMap.TransformPosition(WorldLocation) - MapOffset;
-  uint32 X = ClampFloatToUInt(PixelsPerCentimeter * Location.X, 0, Width - 1);
-  uint32 Y = ClampFloatToUInt(PixelsPerCentimeter * Location.Y, 0, Height - 1);
+  const FVector2D Location = GetPixelCoordinates(WorldLocation);
+  uint32 X = ClampFloatToUInt(Location.X, 0, Width - 1);
+  uint32 Y = ClampFloatToUInt(Location.Y, 0, Height - 1);
   return GetDataAt(X, Y);
 }
 
+void URoadMap::GetDataAt(
+    TArrayView<const FVector> WorldLocations,
+    TArrayView<FRoadMapPixelData> OutData) const
+{
+  check(WorldLocations.Num() == OutData.Num());
+  for (auto i = 0; i < WorldLocations.Num(); ++i) {
+    OutData[i] = GetDataAt(WorldLocations[i]);
+  }
+}
+
+float URoadMap::GetOffRoadDistance(const FVector &WorldLocation) const
+{
+  check(IsValid());
+  const FVector2D Location = GetPixelCoordinates(WorldLocation);
+  const uint32 X = ClampFloatToUInt(Location.X, 0, Width - 1);
+  const uint32 Y = ClampFloatToUInt(Location.Y, 0, Height - 1);
+  const float CmPerUnit = 1.0f / (DISTANCE_UNITS_PER_PIXEL * PixelsPerCentimeter);
+  return CmPerUnit * static_cast<float>(GetDistanceAt(X, Y));
+}
+
+bool URoadMap::IsBoxOnRoad(const FTransform &BoxTransform, const FVector &BoxExtent) const
+{
+  const float Radius = FVector2D(BoxExtent.X, BoxExtent.Y).Size() * BoxTransform.GetMaximumAxisScale();
+  // The distance is measured from the centre of the pixel, add its diagonal.
+  const float PixelDiagonal = 1.4142135f / PixelsPerCentimeter;
+  return GetOffRoadDistance(BoxTransform.GetLocation()) > Radius + PixelDiagonal;
+}
+
+bool URoadMap::IsBoxOffRoad(const FTransform &BoxTransform, const FVector &BoxExtent) const
+{
+  const float Radius = FVector2D(BoxExtent.X, BoxExtent.Y).Size() * BoxTransform.GetMaximumAxisScale();
+  const float PixelDiagonal = 1.4142135f / PixelsPerCentimeter;
+  return -GetOffRoadDistance(BoxTransform.GetLocation()) > Radius + PixelDiagonal;
+}
+
 FRoadMapIntersectionResult URoadMap::Intersect(
     const FTransform &BoxTransform,
     const FVector &BoxExtent,
     float ChecksPerCentimeter) const
 {
+  check(IsValid());
+  // A box far from the road needs no checks.
+  if (IsBoxOffRoad(BoxTransform, BoxExtent)) {
+    return {1.0f, 0.0f};
+  }
   auto DirectionOfMovement = BoxTransform.GetRotation().GetForwardVector();
   DirectionOfMovement.Z = 0.0f; // Project to XY plane (won't be normalized anymore).
-  uint32 CheckCount = 0u;
-  FRoadMapIntersectionResult Result = {0.0f, 0.0f};
+  const FVector2D Movement(DirectionOfMovement.X, DirectionOfMovement.Y);
+
+  // Both transforms are affine, so the checks are laid out on a grid in map
+  // coordinates too. Project the corner of the box and one step along each
+  // axis, then walk the grid.
   const float Step = 1.0f / ChecksPerCentimeter;
-  for (float X = -BoxExtent.X; X < BoxExtent.X; X += Step) {
-    for (float Y = -BoxExtent.Y; Y < BoxExtent.Y; Y += Step) {
-      ++CheckCount;
-      auto Location = BoxTransform.TransformPosition(FVector(X, Y, 0.0f));
-      const auto &Data = GetDataAt(Location);
-      if (!Data.IsRoad()) {
-        Result.OffRoad += 1.0f;
-      } else if (Data.HasDirection() &&
-                 0.0f > FVector::DotProduct(Data.GetDirection(), DirectionOfMovement)) {
-        Result.OppositeLane += 1.0f;
+  const int32 ChecksX = FMath::Max(0, FMath::CeilToInt(2.0f * BoxExtent.X * ChecksPerCentimeter));
+  const int32 ChecksY = FMath::Max(0, FMath::CeilToInt(2.0f * BoxExtent.Y * ChecksPerCentimeter));
+  auto ProjectStep = [&](const FVector &LocalStep) {
+    const FVector MapStep =
+        PixelsPerCentimeter * WorldToMap.TransformVector(BoxTransform.TransformVector(LocalStep));
+    return FVector2D(MapStep.X, MapStep.Y);
+  };
+  const FVector2D StepX = ProjectStep(FVector(Step, 0.0f, 0.0f));
+  const FVector2D StepY = ProjectStep(FVector(0.0f, Step, 0.0f));
+  FVector2D RowStart = GetPixelCoordinates(
+      BoxTransform.TransformPosition(FVector(-BoxExtent.X, -BoxExtent.Y, 0.0f)));
+
+  const auto &Directions = FRoadMapPixelData::GetDirectionTable();
+  constexpr uint16 IsRoadBit = (1 << FRoadMapPixelData::IsRoadRow);
+  constexpr uint16 HasDirectionBit = (1 << FRoadMapPixelData::HasDirectionRow);
+  const int32 MaxX = Width - 1;
+  const int32 MaxY = Height - 1;
+
+  int32 OffRoadCount = 0;
+  int32 OppositeLaneCount = 0;
+  for (auto i = 0; i < ChecksX; ++i) {
+    FVector2D Position = RowStart;
+    for (auto j = 0; j < ChecksY; ++j) {
+      const uint32 PixelX = ClampFloatToUInt(Position.X, 0, MaxX);
+      const uint32 PixelY = ClampFloatToUInt(Position.Y, 0, MaxY);
+      const uint16 Value = GetValueAt(PixelX, PixelY);
+      if (!(Value & IsRoadBit)) {
+        ++OffRoadCount;
+      } else if ((Value & HasDirectionBit) &&
+                 (0.0f > FVector2D::DotProduct(Directions[Value & FRoadMapPixelData::AngleMask], Movement))) {
+        ++OppositeLaneCount;
       }
+      Position += StepY;
     }
+    RowStart += StepX;
   }
-  if (CheckCount > 0u) {
-    Result.OffRoad /= static_cast<float>(CheckCount);
-    Result.OppositeLane /= static_cast<float>(CheckCount);
+
+  FRoadMapIntersectionResult Result = {0.0f, 0.0f};
+  const int32 CheckCount = ChecksX * ChecksY;
+  if (CheckCount > 0) {
+    Result.OffRoad = static_cast<float>(OffRoadCount) / static_cast<float>(CheckCount);
+    Result.OppositeLane = static_cast<float>(OppositeLaneCount) / static_cast<float>(CheckCount);
   } else {
     UE_LOG(LogCarla, Warning, TEXT("URoadMap::Intersect did zero checks"));
   }
   return Result;
 }
 
+/// Boxes are intersected in parallel in chunks of this size, fewer boxes are
+/// intersected on the calling thread.
+static constexpr int32 BOXES_PER_CHUNK = 16;
+
+void URoadMap::IntersectMany(
+    const TArray<FTransform> &BoxTransforms,
+    const TArray<FVector> &BoxExtents,
+    const float ChecksPerCentimeter,
+    TArray<FRoadMapIntersectionResult> &Results) const
+{
+  check(BoxTransforms.Num() == BoxExtents.Num());
+  const int32 NumberOfBoxes = BoxTransforms.Num();
+  Results.SetNumUninitialized(NumberOfBoxes, false);
+  const int32 NumberOfChunks = (NumberOfBoxes + BOXES_PER_CHUNK - 1) / BOXES_PER_CHUNK;
+  // The map is only read, each chunk writes its own slice of the results.
+  ParallelFor(NumberOfChunks, [&](const int32 Chunk) {
+    const int32 End = FMath::Min(NumberOfBoxes, (Chunk + 1) * BOXES_PER_CHUNK);
+    for (int32 i = Chunk * BOXES_PER_CHUNK; i < End; ++i) {
+      Results[i] = Intersect(BoxTransforms[i], BoxExtents[i], ChecksPerCentimeter);
+    }
+  }, NumberOfChunks < 2);
+}
+
+FVector2D URoadMap::GetPixelCoordinates(const FVector &WorldLocation) const
+{
+  const FVector Location = WorldToMap.TransformPosition(WorldLocation) - MapOffset;
+  return FVector2D(PixelsPerCentimeter * Location.X, PixelsPerCentimeter * Location.Y);
+}
+
+bool URoadMap::GetPixels(TArray<uint16> &OutPixels, float OutWorldToPixel[8u]) const
+{
+  if (!IsValid()) {
+    return false;
+  }
+  OutPixels.SetNumUninitialized(Width * Height);
+  for (auto Y = 0u; Y < Height; ++Y) {
+    for (auto X = 0u; X < Width; ++X) {
+      OutPixels[GetIndex(X, Y)] = GetValueAt(X, Y);
+    }
+  }
+  // Same as GetPixelCoordinates, positions are row vectors in UE4 matrices.
+  const FMatrix Matrix = WorldToMap.ToMatrixWithScale();
+  for (auto Axis = 0; Axis < 2; ++Axis) {
+    float *Row = OutWorldToPixel + 4 * Axis;
+    Row[0] = PixelsPerCentimeter * Matrix.M[0][Axis];
+    Row[1] = PixelsPerCentimeter * Matrix.M[1][Axis];
+    Row[2] = PixelsPerCentimeter * Matrix.M[2][Axis];
+    Row[3] = PixelsPerCentimeter * (Matrix.M[3][Axis] - MapOffset[Axis]);
+  }
+  return true;
+}
+
 bool URoadMap::SaveAsPNG(const FString &Folder, const FString &MapName) const
 {
   if (!IsValid()) {
@@ -254,8 +487,11 @@ bool URoadMap::SaveAsPNG(const FString &Folder, const FString &MapName) const
   }
 
   TArray<FColor> BitMap;
-  for (auto Value : RoadMapData) {
-    BitMap.Emplace(FRoadMapPixelData(Value).EncodeAsColor());
+  BitMap.Reserve(Width * Height);
+  for (auto Y = 0u; Y < Height; ++Y) {
+    for (auto X = 0u; X < Width; ++X) {
+      BitMap.Emplace(GetDataAt(X, Y).EncodeAsColor());
+    }
   }
 
   const FString ImagePath = FPaths::Combine(Folder, MapName + TEXT(".png"));
@@ -8,6 +8,7 @@
 
 #include "UObject/NoExportTypes.h"
 #include "MapGen/CityMapMeshTag.h"
+#include "MapGen/RoadMapTiles.h"
 #include "RoadMap.generated.h"
 
 /// Road map intersection result. See URoadMap.
@@ -40,6 +41,9 @@ struct FRoadMapPixelData
 
 public:
 
+  /// An off-road pixel.
+  FRoadMapPixelData() : Value(0u) {}
+
   explicit FRoadMapPixelData(uint16 inValue) : Value(inValue) {}
 
   /// Whether this pixel lies in-road.
@@ -71,8 +75,17 @@ public:
   /// Undefined if !HasDirection().
   FVector GetDirection() const
   {
-    const FVector2D SphericalCoords(HALF_PI, GetDirectionAzimuthalAngle());
-    return SphericalCoords.SphericalToUnitCartesian();
+    const FVector2D &Direction = GetDirection2D();
+    return {Direction.X, Direction.Y, 0.0f};
+  }
+
+  /// Get the road direction at this pixel in the XY plane. Looked up in a
+  /// table, so it costs no trigonometric functions.
+  ///
+  /// Undefined if !HasDirection().
+  const FVector2D &GetDirection2D() const
+  {
+    return GetDirectionTable()[AngleMask & Value];
   }
 
   FColor EncodeAsColor() const;
@@ -81,6 +94,9 @@ private:
 
   static uint16 Encode(bool IsRoad, bool HasDirection, const FVector &Direction);
 
+  /// Unit direction in the XY plane of every encoded angle.
+  static const TArray<FVector2D> &GetDirectionTable();
+
   uint16 Value;
 };
 
@@ -96,6 +112,10 @@ public:
   /// Creates a valid empty map (every point is off-road).
   URoadMap(const FObjectInitializer& ObjectInitializer);
 
+  /// Generates the distance field of maps saved without it. Outside the
+  /// editor the map is also compacted into tiles, see RoadMapTiles.
+  virtual void PostLoad() override;
+
   /// Resets current map an initializes an empty map of the given size.
   void Reset(
       uint32 Width,
@@ -104,6 +124,7 @@ public:
       const FTransform &WorldToMap,
       const FVector &MapOffset);
 
+  /// Safe to call concurrently for different pixels.
   void SetPixelAt(
       uint32 PixelX,
       uint32 PixelY,
@@ -111,6 +132,10 @@ public:
       const FTransform &Transform,
       bool bInvertDirection = false);
 
+  /// Generate the distance field from the current pixels, needs to be called
+  /// once every pixel is set. See GetOffRoadDistance.
+  void GenerateDistanceField();
+
   uint32 GetWidth() const
   {
     return Width;
@@ -128,21 +153,63 @@ public:
   FRoadMapPixelData GetDataAt(uint32 PixelX, uint32 PixelY) const
   {
     check(IsValid());
-    return FRoadMapPixelData(RoadMapData[GetIndex(PixelX, PixelY)]);
+    return FRoadMapPixelData(GetValueAt(PixelX, PixelY));
   }
 
   /// Clamps value if lies outside map limits.
   FRoadMapPixelData GetDataAt(const FVector &WorldLocation) const;
 
+  /// Retrieve the data at several world locations at once, clamped as above.
+  /// @a OutData must be as long as @a WorldLocations.
+  void GetDataAt(
+      TArrayView<const FVector> WorldLocations,
+      TArrayView<FRoadMapPixelData> OutData) const;
+
+  /// Signed distance in centimeters from @a WorldLocation to the edge of the
+  /// road, positive on road and negative off-road. Approximated to a fraction
+  /// of a pixel and saturated at MaxDistanceInPixels, the location is clamped
+  /// to the map limits.
+  float GetOffRoadDistance(const FVector &WorldLocation) const;
+
+  /// Whether the box lies completely on road, or completely off-road, judging
+  /// by the circle that encloses it in the XY plane. Cheap but conservative,
+  /// both return false if the circle crosses the edge of the road.
+  bool IsBoxOnRoad(const FTransform &BoxTransform, const FVector &BoxExtent) const;
+
+  bool IsBoxOffRoad(const FTransform &BoxTransform, const FVector &BoxExtent) const;
+
   /// Intersect actor bounds with map.
   ///
   /// Bounds box is projected to the map and checked against it for possible
-  /// intersections with off-road areas and opposite lanes.
+  /// intersections with off-road areas and opposite lanes. The box is
+  /// projected once, every check only walks the map pixels, so the cost
+  /// depends only on the number of checks.
   FRoadMapIntersectionResult Intersect(
       const FTransform &BoxTransform,
       const FVector &BoxExtent,
       float ChecksPerCentimeter) const;
 
+  /// Intersect every box of @a BoxTransforms and @a BoxExtents (same size)
+  /// with the map, as Intersect. The boxes are checked in parallel in the task
+  /// graph workers, @a Results is resized to the number of boxes.
+  void IntersectMany(
+      const TArray<FTransform> &BoxTransforms,
+      const TArray<FVector> &BoxExtents,
+      float ChecksPerCentimeter,
+      TArray<FRoadMapIntersectionResult> &Results) const;
+
+  /// Copy every pixel, row-major, and the affine transform from a world
+  /// location to pixel coordinates (two rows of a 3x4 matrix, x then y).
+  /// Returns false if the map is not valid.
+  bool GetPixels(TArray<uint16> &OutPixels, float OutWorldToPixel[8u]) const;
+
+  /// Bytes of the pixels and the distance field, dense or in tiles.
+  SIZE_T GetAllocatedSize() const
+  {
+    return RoadMapData.GetAllocatedSize() + DistanceField.GetAllocatedSize() +
+        RoadMapTiles.GetAllocatedSize() + DistanceTiles.GetAllocatedSize();
+  }
+
   /// Save the current map as PNG with the pixel data encoded as color.
   bool SaveAsPNG(const FString &Folder, const FString &MapName) const;
 
@@ -165,9 +232,31 @@ private:
 
   bool IsValid() const
   {
-    return ((RoadMapData.Num() > 0) && (RoadMapData.Num() == Height * Width));
+    return !RoadMapTiles.IsEmpty() ||
+        ((RoadMapData.Num() > 0) && (RoadMapData.Num() == Height * Width));
+  }
+
+  uint16 GetValueAt(uint32 PixelX, uint32 PixelY) const
+  {
+    return (RoadMapTiles.IsEmpty() ?
+        RoadMapData[GetIndex(PixelX, PixelY)] :
+        RoadMapTiles.Get(PixelX, PixelY));
+  }
+
+  int16 GetDistanceAt(uint32 PixelX, uint32 PixelY) const
+  {
+    return (DistanceTiles.IsEmpty() ?
+        DistanceField[GetIndex(PixelX, PixelY)] :
+        DistanceTiles.Get(PixelX, PixelY));
   }
 
+  /// Move the pixel data and the distance field into tiles, and free the
+  /// dense arrays. The map cannot be modified afterwards.
+  void CompactToTiles();
+
+  /// Project a world location to map pixel coordinates, unclamped.
+  FVector2D GetPixelCoordinates(const FVector &WorldLocation) const;
+
   /// World-to-map transform.
   UPROPERTY(VisibleAnywhere)
   FTransform WorldToMap;
@@ -190,4 +279,21 @@ private:
 
   UPROPERTY()
   TArray<uint16> RoadMapData;
+
+  /// Distance of every pixel to the closest pixel on the other side of the
+  /// road edge, in thirds of a pixel, positive on road. Same layout as
+  /// RoadMapData.
+  UPROPERTY()
+  TArray<int16> DistanceField;
+
+  /// Distances are saturated so that the pixels far from the edge of the road
+  /// hold the same value, and their tiles take no memory.
+  static constexpr int32 MaxDistanceInPixels = 64;
+
+  /// Compacted pixel data, used instead of RoadMapData if not empty. Most of
+  /// the map is uniform (blocks, or long straight lanes) so most tiles only
+  /// store one value.
+  TRoadMapTiles<uint16> RoadMapTiles;
+
+  TRoadMapTiles<int16> DistanceTiles;
 };
@@ -0,0 +1,92 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+/// Read-only copy of a 2D array of pixels split in square tiles. Tiles whose
+/// pixels all hold the same value only store that value, so large uniform
+/// areas (e.g. the blocks between roads) take almost no memory.
+template <typename T>
+class TRoadMapTiles
+{
+public:
+
+  /// Pixels per side of a tile.
+  static constexpr uint32 TileSize = 64u;
+
+  bool IsEmpty() const
+  {
+    return Tiles.Num() == 0;
+  }
+
+  void Reset()
+  {
+    Tiles.Empty();
+    TilesX = 0u;
+  }
+
+  /// Copy @a Pixels, a row-major array of @a Width x @a Height pixels.
+  void Build(const TArray<T> &Pixels, const uint32 Width, const uint32 Height)
+  {
+    check(Pixels.Num() == Width * Height);
+    TilesX = FMath::DivideAndRoundUp(Width, TileSize);
+    const uint32 TilesY = FMath::DivideAndRoundUp(Height, TileSize);
+    Tiles.Empty(TilesX * TilesY);
+    for (auto TileY = 0u; TileY < TilesY; ++TileY) {
+      for (auto TileX = 0u; TileX < TilesX; ++TileX) {
+        FTile &Tile = Tiles[Tiles.AddDefaulted()];
+        Tile.Pixels.SetNumUninitialized(TileSize * TileSize);
+        // Pixels past the edge of the map repeat the last ones, they are never
+        // read anyway.
+        bool bIsUniform = true;
+        for (auto Y = 0u; Y < TileSize; ++Y) {
+          const uint32 PixelY = FMath::Min(TileY * TileSize + Y, Height - 1u);
+          for (auto X = 0u; X < TileSize; ++X) {
+            const uint32 PixelX = FMath::Min(TileX * TileSize + X, Width - 1u);
+            const T Value = Pixels[PixelX + Width * PixelY];
+            Tile.Pixels[X + TileSize * Y] = Value;
+            bIsUniform &= (Value == Tile.Pixels[0u]);
+          }
+        }
+        if (bIsUniform) {
+          Tile.Value = Tile.Pixels[0u];
+          Tile.Pixels.Empty();
+        }
+      }
+    }
+  }
+
+  T Get(const uint32 PixelX, const uint32 PixelY) const
+  {
+    const FTile &Tile = Tiles[(PixelX / TileSize) + TilesX * (PixelY / TileSize)];
+    return (Tile.Pixels.Num() == 0 ?
+        Tile.Value :
+        Tile.Pixels[(PixelX % TileSize) + TileSize * (PixelY % TileSize)]);
+  }
+
+  SIZE_T GetAllocatedSize() const
+  {
+    SIZE_T Size = Tiles.GetAllocatedSize();
+    for (const auto &Tile : Tiles) {
+      Size += Tile.Pixels.GetAllocatedSize();
+    }
+    return Size;
+  }
+
+private:
+
+  struct FTile
+  {
+    /// Value of every pixel if Pixels is empty.
+    T Value = T(0);
+
+    TArray<T> Pixels;
+  };
+
+  TArray<FTile> Tiles;
+
+  uint32 TilesX = 0u;
+};
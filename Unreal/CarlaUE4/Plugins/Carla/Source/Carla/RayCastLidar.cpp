@@ -0,0 +1,121 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "RayCastLidar.h"
+
+#include "Async/ParallelFor.h"
+#include "Components/SceneComponent.h"
+#include "Engine/CollisionProfile.h"
+
+#include "Tagger.h"
+
+DECLARE_CYCLE_STAT(TEXT("LiDAR Scan"), STAT_CarlaLidarScan, STATGROUP_Carla);
+DECLARE_DWORD_COUNTER_STAT(TEXT("LiDAR Rays Traced"), STAT_CarlaLidarRays, STATGROUP_Carla);
+
+/// Rays are traced in parallel in chunks of this size.
+static constexpr int32 RAYS_PER_CHUNK = 256;
+
+ARayCastLidar::ARayCastLidar(const FObjectInitializer& ObjectInitializer) :
+  Super(ObjectInitializer)
+{
+  PrimaryActorTick.bCanEverTick = true;
+  PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+  RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SceneComponent"));
+}
+
+void ARayCastLidar::Set(const FLidarDescription &LidarDescription)
+{
+  Description = LidarDescription;
+  const uint32 Channels = FMath::Max(Description.Channels, 1u);
+  ChannelAngles.SetNumUninitialized(Channels);
+  const float Delta = (Channels > 1u ?
+      (Description.UpperFovLimit - Description.LowerFovLimit) / (Channels - 1u) :
+      0.0f);
+  for (auto i = 0u; i < Channels; ++i) {
+    ChannelAngles[i] = Description.UpperFovLimit - i * Delta;
+  }
+  NumberOfPoints = 0u;
+  HorizontalAngle = 0.0f;
+  PendingPoints = 0.0f;
+}
+
+void ARayCastLidar::Tick(const float DeltaSeconds)
+{
+  Super::Tick(DeltaSeconds);
+
+  const uint32 Channels = ChannelAngles.Num();
+  if ((Channels == 0u) || (DeltaSeconds <= 0.0f)) {
+    NumberOfPoints = 0u;
+    return;
+  }
+  // Only the slice swept during this frame, the points per channel follow the
+  // points per second so the cost is flat regardless of the frame rate.
+  PendingPoints += Description.PointsPerSecond * DeltaSeconds / Channels;
+  const uint32 PointsPerChannel = FMath::FloorToInt(PendingPoints);
+  PendingPoints -= PointsPerChannel;
+  const float SweptAngle = FMath::Min(360.0f, 360.0f * Description.RotationFrequency * DeltaSeconds);
+  if (PointsPerChannel == 0u) {
+    NumberOfPoints = 0u;
+  } else {
+    Scan(PointsPerChannel, SweptAngle / PointsPerChannel);
+  }
+  HorizontalAngle = FMath::Fmod(HorizontalAngle + SweptAngle, 360.0f);
+}
+
+void ARayCastLidar::Scan(const uint32 PointsPerChannel, const float AngleStep)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaLidarScan);
+
+  const int32 NumberOfRays = ChannelAngles.Num() * PointsPerChannel;
+  SET_DWORD_STAT(STAT_CarlaLidarRays, NumberOfRays);
+  Points.SetNumUninitialized(NumberOfRays, false);
+  Hits.SetNumUninitialized(NumberOfRays, false);
+
+  const UWorld *World = GetWorld();
+  check(World != nullptr);
+  const FTransform Transform = GetActorTransform();
+  const FVector Start = Transform.GetLocation();
+  FCollisionQueryParams TraceParams(FName(TEXT("LiDAR Trace")), true, this);
+  TraceParams.bReturnPhysicalMaterial = false;
+  TraceParams.AddIgnoredActor(GetOwner());
+
+  const int32 NumberOfChunks = (NumberOfRays + RAYS_PER_CHUNK - 1) / RAYS_PER_CHUNK;
+  ParallelFor(NumberOfChunks, [&](const int32 Chunk) {
+    const int32 End = FMath::Min(NumberOfRays, (Chunk + 1) * RAYS_PER_CHUNK);
+    for (int32 Index = Chunk * RAYS_PER_CHUNK; Index < End; ++Index) {
+      const uint32 Channel = Index / PointsPerChannel;
+      const uint32 Step = Index % PointsPerChannel;
+      const FRotator LaserRotation(ChannelAngles[Channel], HorizontalAngle + Step * AngleStep, 0.0f);
+      const FVector Direction = Transform.TransformVectorNoScale(LaserRotation.Vector());
+      FHitResult Hit;
+      Hits[Index] = World->LineTraceSingleByChannel(
+          Hit,
+          Start,
+          Start + Description.Range * Direction,
+          ECC_Visibility,
+          TraceParams,
+          FCollisionResponseParams::DefaultResponseParam);
+      if (Hits[Index]) {
+        const FVector Location = Transform.InverseTransformPositionNoScale(Hit.ImpactPoint);
+        const UPrimitiveComponent *Component = Hit.Component.Get();
+        const float Label = (Component != nullptr ?
+            static_cast<float>(ATagger::GetTagOfTaggedComponent(*Component)) :
+            0.0f);
+        Points[Index] = FVector4(Location, Label);
+      }
+    }
+  }, NumberOfChunks < 2);
+
+  // Compact the points hit, in order of channel and angle.
+  NumberOfPoints = 0u;
+  for (int32 Index = 0; Index < NumberOfRays; ++Index) {
+    if (Hits[Index]) {
+      Points[NumberOfPoints++] = Points[Index];
+    }
+  }
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "Settings/LidarDescription.h"
+#include "RayCastLidar.generated.h"
+
+/// A ray-cast based LiDAR. Every frame it traces only the slice of the
+/// rotation swept since the previous frame, all the lasers at once in the task
+/// graph workers, and keeps the points hit until the next frame.
+///
+/// Points are in centimeters relative to the LiDAR, packed as four 32-bit
+/// floats, x, y, z and the semantic label of the object hit (see
+/// ECityObjectLabel).
+UCLASS(hidecategories=(Collision, Attachment, Actor))
+class CARLA_API ARayCastLidar : public AActor
+{
+  GENERATED_BODY()
+
+public:
+
+  ARayCastLidar(const FObjectInitializer& ObjectInitializer);
+
+  virtual void Tick(float DeltaSeconds) override;
+
+  void Set(const FLidarDescription &LidarDescription);
+
+  const FLidarDescription &GetDescription() const
+  {
+    return Description;
+  }
+
+  /// Number of points hit in the last frame.
+  uint32 GetNumberOfPoints() const
+  {
+    return NumberOfPoints;
+  }
+
+  /// Points hit in the last frame, GetNumberOfPoints() of them.
+  const FVector4 *GetPoints() const
+  {
+    return Points.GetData();
+  }
+
+  /// Horizontal angle in degrees the next frame starts tracing at.
+  float GetHorizontalAngle() const
+  {
+    return HorizontalAngle;
+  }
+
+private:
+
+  /// Trace the rays of @a PointsPerChannel steps of @a AngleStep degrees
+  /// each, for every channel.
+  void Scan(uint32 PointsPerChannel, float AngleStep);
+
+  UPROPERTY(Category = "LiDAR", VisibleAnywhere)
+  FLidarDescription Description;
+
+  /** Pitch in degrees of each channel. */
+  TArray<float> ChannelAngles;
+
+  /** One slot per ray traced, compacted to the points hit. Keeps its memory
+    * between frames.
+    */
+  TArray<FVector4> Points;
+
+  /** Whether each ray traced hit something. */
+  TArray<bool> Hits;
+
+  uint32 NumberOfPoints = 0u;
+
+  float HorizontalAngle = 0.0f;
+
+  /** Fraction of point carried over to the next frame, so the number of
+    * points per second is kept at any frame rate.
+    */
+  float PendingPoints = 0.0f;
+};
@@ -0,0 +1,124 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "SceneCaptureAtlas.h"
+
+#include "RenderingThread.h"
+#include "SceneCaptureCamera.h"
+#include "TextureResource.h"
+
+DECLARE_CYCLE_STAT(TEXT("Read Atlas Pixels"), STAT_CarlaReadAtlasPixels, STATGROUP_Carla);
+
+/// Conservative limit supported by every RHI we run on.
+static constexpr int32 MAX_ATLAS_SIZE = 8192;
+
+FSceneCaptureAtlas::~FSceneCaptureAtlas()
+{
+  if (Texture.IsValid()) {
+    ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+        FSceneCaptureAtlasReleaseCommand,
+        FTexture2DRHIRef, AtlasTexture, Texture,
+    {
+      AtlasTexture.SafeRelease();
+    });
+  }
+}
+
+bool FSceneCaptureAtlas::Layout(const TArray<ASceneCaptureCamera *, TInlineAllocator<8u>> &Cameras)
+{
+  Tiles.Reset();
+  FIntPoint Cursor = {0, 0};
+  int32 RowHeight = 0;
+  FIntPoint NewSize = {0, 0};
+  for (auto *Camera : Cameras) {
+    check(Camera != nullptr);
+    const int32 Width = Camera->GetImageSizeX();
+    const int32 Height = Camera->GetImageSizeY();
+    if ((Cursor.X > 0) && (Cursor.X + Width > MAX_ATLAS_SIZE)) {
+      // Start a new row.
+      Cursor.X = 0;
+      Cursor.Y += RowHeight;
+      RowHeight = 0;
+    }
+    auto *Source = Camera->GetRenderTargetResource();
+    if ((Source == nullptr) || (Cursor.X + Width > MAX_ATLAS_SIZE)) {
+      return false;
+    }
+    Tiles.Add({Source, FIntRect(Cursor.X, Cursor.Y, Cursor.X + Width, Cursor.Y + Height)});
+    Cursor.X += Width;
+    RowHeight = FMath::Max(RowHeight, Height);
+    NewSize.X = FMath::Max(NewSize.X, Cursor.X);
+    NewSize.Y = FMath::Max(NewSize.Y, Cursor.Y + RowHeight);
+  }
+  if (NewSize.Y > MAX_ATLAS_SIZE) {
+    return false;
+  }
+  Size = NewSize;
+  return true;
+}
+
+bool FSceneCaptureAtlas::ReadPixels(
+    const TArray<ASceneCaptureCamera *, TInlineAllocator<8u>> &Cameras,
+    const TArray<FColor *, TInlineAllocator<8u>> &Buffers)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaReadAtlasPixels);
+  check(Cameras.Num() == Buffers.Num());
+  if (Cameras.Num() == 0) {
+    return true;
+  }
+  if (!Layout(Cameras)) {
+    UE_LOG(LogCarla, Error, TEXT("SceneCaptureAtlas: Cameras do not fit in a %dx%d atlas"), MAX_ATLAS_SIZE, MAX_ATLAS_SIZE);
+    return false;
+  }
+
+  ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+      FSceneCaptureAtlasReadbackCommand,
+      FSceneCaptureAtlas *, Atlas, this,
+  {
+    Atlas->CopyAndReadback_RenderThread(RHICmdList);
+  });
+  // The only synchronization point with the render thread for every camera.
+  FlushRenderingCommands();
+
+  if (BitMap.Num() != Size.X * Size.Y) {
+    UE_LOG(LogCarla, Error, TEXT("SceneCaptureAtlas: Readback failed"));
+    return false;
+  }
+
+  // Slice the atlas into the image of each camera.
+  for (auto i = 0; i < Tiles.Num(); ++i) {
+    check(Buffers[i] != nullptr);
+    const auto &Rect = Tiles[i].Rect;
+    const int32 Width = Rect.Width();
+    for (auto Row = 0; Row < Rect.Height(); ++Row) {
+      FMemory::Memcpy(
+          Buffers[i] + Row * Width,
+          BitMap.GetData() + (Rect.Min.Y + Row) * Size.X + Rect.Min.X,
+          sizeof(FColor) * Width);
+    }
+  }
+  return true;
+}
+
+void FSceneCaptureAtlas::CopyAndReadback_RenderThread(FRHICommandListImmediate &RHICmdList)
+{
+  check(IsInRenderingThread());
+  if (!Texture.IsValid() ||
+      (Texture->GetSizeX() != static_cast<uint32>(Size.X)) ||
+      (Texture->GetSizeY() != static_cast<uint32>(Size.Y))) {
+    FRHIResourceCreateInfo CreateInfo;
+    Texture = RHICreateTexture2D(Size.X, Size.Y, PF_B8G8R8A8, 1u, 1u, TexCreate_RenderTargetable, CreateInfo);
+  }
+  for (const auto &Tile : Tiles) {
+    FResolveParams Params(FResolveRect(0, 0, Tile.Rect.Width(), Tile.Rect.Height()));
+    Params.DestRect = FResolveRect(Tile.Rect.Min.X, Tile.Rect.Min.Y, Tile.Rect.Max.X, Tile.Rect.Max.Y);
+    RHICmdList.CopyToResolveTarget(Tile.Source->GetRenderTargetTexture(), Texture, false, Params);
+  }
+  FReadSurfaceDataFlags ReadPixelFlags(RCM_UNorm);
+  ReadPixelFlags.SetLinearToGamma(true);
+  RHICmdList.ReadSurfaceData(Texture, FIntRect(0, 0, Size.X, Size.Y), BitMap, ReadPixelFlags);
+}
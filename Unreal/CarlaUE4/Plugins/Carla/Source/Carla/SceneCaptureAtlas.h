@@ -0,0 +1,63 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "RHIResources.h"
+
+class ASceneCaptureCamera;
+class FTextureRenderTargetResource;
+
+/// Reads back the images of several cameras in a single transfer from the GPU.
+///
+/// The render target of each camera is copied into a tile of one atlas
+/// texture, the atlas is read back at once and sliced into the image of each
+/// camera. So N cameras synchronize with the render thread only once instead
+/// of N times.
+class FSceneCaptureAtlas
+{
+public:
+
+  FSceneCaptureAtlas() = default;
+
+  FSceneCaptureAtlas(const FSceneCaptureAtlas &) = delete;
+
+  FSceneCaptureAtlas &operator=(const FSceneCaptureAtlas &) = delete;
+
+  ~FSceneCaptureAtlas();
+
+  /// Read the pixels of every camera in @a Cameras into the buffer at the same
+  /// index in @a Buffers, each must have room for at least SizeX * SizeY
+  /// pixels of its camera. Only cameras with synchronous readback are
+  /// supported.
+  bool ReadPixels(
+      const TArray<ASceneCaptureCamera *, TInlineAllocator<8u>> &Cameras,
+      const TArray<FColor *, TInlineAllocator<8u>> &Buffers);
+
+private:
+
+  struct FTile
+  {
+    FTextureRenderTargetResource *Source;
+
+    FIntRect Rect;
+  };
+
+  /// Arrange the tiles in rows no wider than the maximum texture size, and
+  /// compute the size of the atlas.
+  bool Layout(const TArray<ASceneCaptureCamera *, TInlineAllocator<8u>> &Cameras);
+
+  void CopyAndReadback_RenderThread(FRHICommandListImmediate &RHICmdList);
+
+  TArray<FTile, TInlineAllocator<8u>> Tiles;
+
+  FIntPoint Size = {0, 0};
+
+  /// Only accessed in the render thread.
+  FTexture2DRHIRef Texture;
+
+  TArray<FColor> BitMap;
+};
@@ -7,17 +7,33 @@
 #include "Carla.h"
 #include "SceneCaptureCamera.h"
 
+#include "CameraRenderTargetPool.h"
+#include "Game/CarlaGameInstance.h"
+
+#include "Async/ParallelFor.h"
 #include "Components/DrawFrustumComponent.h"
 #include "Components/SceneCaptureComponent2D.h"
+#include "Components/SceneCaptureComponentCube.h"
 #include "Components/StaticMeshComponent.h"
 #include "Engine/CollisionProfile.h"
 #include "Engine/TextureRenderTarget2D.h"
+#include "Engine/TextureRenderTargetCube.h"
 #include "HighResScreenshot.h"
 #include "Materials/Material.h"
 #include "Paths.h"
+#include "RenderUtils.h"
+#include "RenderingThread.h"
 #include "StaticMeshResources.h"
 #include "TextureResource.h"
 
+DECLARE_CYCLE_STAT(TEXT("Scene Capture Camera Tick"), STAT_CarlaSceneCaptureCameraTick, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Read Pixels"), STAT_CarlaReadPixels, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Read Pixels Async"), STAT_CarlaReadPixelsAsync, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Resize Image"), STAT_CarlaResizeImage, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Read Panorama"), STAT_CarlaReadPanorama, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Read Point Cloud"), STAT_CarlaReadPointCloud, STATGROUP_Carla);
+DECLARE_CYCLE_STAT(TEXT("Read Motion Vectors"), STAT_CarlaReadMotionVectors, STATGROUP_Carla);
+
 static constexpr auto DEPTH_MAT_PATH =
 #if PLATFORM_LINUX
     TEXT("Material'/Carla/PostProcessingMaterials/DepthEffectMaterial_GLSL.DepthEffectMaterial_GLSL'");
@@ -30,13 +46,57 @@ static constexpr auto DEPTH_MAT_PATH =
 static constexpr auto SEMANTIC_SEGMENTATION_MAT_PATH =
     TEXT("Material'/Carla/PostProcessingMaterials/GTMaterial.GTMaterial'");
 
+/// Slots of the ring of shared textures, enough for the client to read one
+/// frame while the next is being written.
+static constexpr uint32 SHARED_RENDER_TARGET_SLOTS = 3u;
+
 static void RemoveShowFlags(FEngineShowFlags &ShowFlags);
 
+static void RemoveShadingShowFlags(FEngineShowFlags &ShowFlags, bool bKeepPostProcessing);
+
+static void ApplyRenderQuality(
+    const FCameraRenderQuality &RenderQuality,
+    USceneCaptureComponent &CaptureComponent);
+
+static void ReadSurfaceData_RenderThread(
+    FRHICommandListImmediate &RHICmdList,
+    FTextureRenderTargetResource *RTResource,
+    const FIntRect &Rect,
+    TArray<FColor> &BitMap);
+
+static void ResizeImage(
+    const FColor *Source,
+    const FIntPoint &SourceSize,
+    FColor *Destination,
+    const FIntPoint &DestinationSize,
+    EImageResizeFilter Filter);
+
+static const FColor &SampleCubeFaces(
+    const TArray<FColor> *Faces,
+    int32 FaceSize,
+    const FVector &Direction);
+
 ASceneCaptureCamera::ASceneCaptureCamera(const FObjectInitializer& ObjectInitializer) :
   Super(ObjectInitializer),
   SizeX(720u),
   SizeY(512u),
-  PostProcessEffect(EPostProcessEffect::SceneFinal)
+  OutputSizeX(0u),
+  OutputSizeY(0u),
+  ResizeFilter(EImageResizeFilter::Box),
+  Projection(EImageProjection::Perspective),
+  VerticalFOVAngle(90.0f),
+  PostProcessEffect(EPostProcessEffect::SceneFinal),
+  ImageEncoding(EImageEncoding::BGRA8),
+  ImageCompression(EImageCompression::None),
+  ImageKeyFrameInterval(30u),
+  ReadbackLatency(0u),
+  CaptureEveryNFrames(1u),
+  bComputeAgentBoxes(false),
+  bComputeClassHistogram(false),
+  bSendImage(true),
+  bShareRenderTarget(false),
+  PointCloudStride(1u),
+  PointCloudFarClip(0.0f)
 {
   PrimaryActorTick.bCanEverTick = true; /// @todo Does it need to tick?
   PrimaryActorTick.TickGroup = TG_PrePhysics;
@@ -91,11 +151,139 @@ void ASceneCaptureCamera::PostActorCreated()
 
 void ASceneCaptureCamera::BeginPlay()
 {
+  SetUpSceneCapture();
+
+  PreviousTransform.Reset();
+
+  // Setup asynchronous readback.
+  ReleaseReadbacks();
+  if (IsAsyncReadback()) {
+    Readbacks.SetNum(ReadbackLatency + 1u);
+  }
+
+  // Setup the textures shared with the client.
+  if (bShareRenderTarget && FSharedRenderTarget::IsSupported()) {
+    SharedRenderTarget = MakeUnique<FSharedRenderTarget>(SHARED_RENDER_TARGET_SLOTS);
+    bool bSuccess = false;
+    ENQUEUE_UNIQUE_RENDER_COMMAND_THREEPARAMETER(
+        FInitializeSharedRenderTargetCommand,
+        FSharedRenderTarget *, Target, SharedRenderTarget.Get(),
+        FTextureRenderTargetResource *, RTResource, GetRenderTargetResource(),
+        bool *, Result, &bSuccess,
+    {
+      *Result = Target->Initialize_RenderThread(RTResource);
+    });
+    FlushRenderingCommands();
+    if (!bSuccess) {
+      UE_LOG(LogCarla, Warning, TEXT("SceneCaptureCamera: Failed to share the render target, reading back the pixels"));
+      ReleaseSharedRenderTarget();
+    }
+  } else if (bShareRenderTarget) {
+    UE_LOG(LogCarla, Warning, TEXT("SceneCaptureCamera: Sharing render targets is only supported with D3D11, reading back the pixels"));
+  }
+
+  Super::BeginPlay();
+}
+
+void ASceneCaptureCamera::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+  ReleaseReadbacks();
+  ReleaseSharedRenderTarget();
+  ReleasePooledRenderTarget();
+  Super::EndPlay(EndPlayReason);
+}
+
+void ASceneCaptureCamera::ReleaseReadbacks()
+{
+  // The render thread writes into the bitmap of each readback pending, and
+  // reads from the render target released next.
+  for (auto &Readback : Readbacks) {
+    if (Readback.bPending) {
+      Readback.Fence.Wait();
+    }
+  }
+  Readbacks.Empty();
+  NextReadback = 0;
+}
+
+void ASceneCaptureCamera::ReleaseSharedRenderTarget()
+{
+  if (SharedRenderTarget.IsValid()) {
+    ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+        FReleaseSharedRenderTargetCommand,
+        FSharedRenderTarget *, Target, SharedRenderTarget.Release(),
+    {
+      delete Target;
+    });
+  }
+}
+
+UCameraRenderTargetPool *ASceneCaptureCamera::GetRenderTargetPool() const
+{
+  auto *GameInstance = Cast<UCarlaGameInstance>(GetGameInstance());
+  return (GameInstance != nullptr ? GameInstance->GetCameraRenderTargetPool() : nullptr);
+}
+
+void ASceneCaptureCamera::ReleasePooledRenderTarget()
+{
+  if (!bIsRenderTargetPooled) {
+    return;
+  }
+  bIsRenderTargetPooled = false;
+  CaptureComponent2D->TextureTarget = nullptr;
+  auto *Pool = GetRenderTargetPool();
+  if (Pool != nullptr) {
+    Pool->Release(CaptureRenderTarget);
+  }
+}
+
+void ASceneCaptureCamera::SetUpSceneCapture()
+{
+  if (bIsSceneCaptureSetUp) {
+    return;
+  }
+  bIsSceneCaptureSetUp = true;
+
+  if (IsPanoramic()) {
+    if (!ImageEncoding::IsReadAsBGRA8(ImageEncoding) ||
+        ((PostProcessEffect != EPostProcessEffect::None) &&
+         (PostProcessEffect != EPostProcessEffect::SceneFinal))) {
+      UE_LOG(LogCarla, Warning, TEXT("SceneCaptureCamera: Panoramic projection is only supported for scene color read as BGRA8, capturing in perspective"));
+      Projection = EImageProjection::Perspective;
+    } else {
+      if (ReadbackLatency > 0u) {
+        UE_LOG(LogCarla, Warning, TEXT("SceneCaptureCamera: Panoramic cameras are read back synchronously"));
+        ReadbackLatency = 0u;
+      }
+      if (bShareRenderTarget) {
+        UE_LOG(LogCarla, Warning, TEXT("SceneCaptureCamera: Panoramic cameras cannot share their render target, reading back the pixels"));
+        bShareRenderTarget = false;
+      }
+      if (bComputeAgentBoxes) {
+        UE_LOG(LogCarla, Warning, TEXT("SceneCaptureCamera: Agent boxes are only computed for perspective cameras"));
+        bComputeAgentBoxes = false;
+      }
+      SetUpPanoramicCapture();
+      return;
+    }
+  }
+
   const bool bRemovePostProcessing = (PostProcessEffect != EPostProcessEffect::SceneFinal);
 
   // Setup render target.
   const bool bInForceLinearGamma = bRemovePostProcessing;
-  CaptureRenderTarget->InitCustomFormat(SizeX, SizeY, PF_B8G8R8A8, bInForceLinearGamma);
+  const EPixelFormat PixelFormat = ImageEncoding::GetPixelFormat(ImageEncoding);
+  auto *Pool = GetRenderTargetPool();
+  if (Pool != nullptr) {
+    // A render target left by a camera of a previous level may do, its
+    // resource is already allocated.
+    auto *PooledRenderTarget = Pool->Acquire(SizeX, SizeY, PixelFormat, bInForceLinearGamma);
+    PooledRenderTarget->TargetGamma = CaptureRenderTarget->TargetGamma;
+    CaptureRenderTarget = PooledRenderTarget;
+    bIsRenderTargetPooled = true;
+  } else {
+    CaptureRenderTarget->InitCustomFormat(SizeX, SizeY, PixelFormat, bInForceLinearGamma);
+  }
 
   CaptureComponent2D->Deactivate();
   CaptureComponent2D->TextureTarget = CaptureRenderTarget;
@@ -107,7 +295,26 @@ void ASceneCaptureCamera::BeginPlay()
   if (bRemovePostProcessing) {
     RemoveShowFlags(CaptureComponent2D->ShowFlags);
   }
-  if (PostProcessEffect == EPostProcessEffect::Depth) {
+  ApplyRenderQuality(RenderQuality, *CaptureComponent2D);
+  ScreenPercentage = RenderQuality.ScreenPercentage;
+  const bool bIsFloatDepth =
+      (PostProcessEffect == EPostProcessEffect::Depth) &&
+      ((ImageEncoding == EImageEncoding::Float32) ||
+       (ImageEncoding == EImageEncoding::Float16) ||
+       (ImageEncoding == EImageEncoding::PointsXYZL) ||
+       (ImageEncoding == EImageEncoding::MotionVectors));
+  // Depth and labels only need the depth buffer and the custom stencil, the
+  // passes that only shade the scene color can go.
+  const bool bIsDepthOrStencilOnly =
+      (PostProcessEffect == EPostProcessEffect::Depth) ||
+      (PostProcessEffect == EPostProcessEffect::SemanticSegmentation);
+  if (bIsDepthOrStencilOnly) {
+    RemoveShadingShowFlags(CaptureComponent2D->ShowFlags, !bIsFloatDepth);
+  }
+  if (bIsFloatDepth) {
+    // Scene depth goes straight into the float target, no need to encode it.
+    CaptureComponent2D->CaptureSource = ESceneCaptureSource::SCS_SceneDepth;
+  } else if (PostProcessEffect == EPostProcessEffect::Depth) {
     CaptureComponent2D->PostProcessSettings.AddBlendable(PostProcessDepth, 1.0f);
   } else if (PostProcessEffect == EPostProcessEffect::SemanticSegmentation) {
     CaptureComponent2D->PostProcessSettings.AddBlendable(PostProcessSemanticSegmentation, 1.0f);
@@ -115,8 +322,58 @@ void ASceneCaptureCamera::BeginPlay()
 
   CaptureComponent2D->UpdateContent();
   CaptureComponent2D->Activate();
+}
 
-  Super::BeginPlay();
+void ASceneCaptureCamera::SetUpPanoramicCapture()
+{
+  // Enough for the equator of the panorama, and for its poles or the top and
+  // bottom rows of the cylinder, to get about a pixel of a face each.
+  const float VerticalFaceSize = (Projection == EImageProjection::Cylindrical ?
+      SizeY / FMath::Tan(FMath::DegreesToRadians(0.5f * VerticalFOVAngle)) :
+      0.5f * SizeY);
+  const int32 FaceSize = FMath::Clamp(
+      FMath::Max(FMath::DivideAndRoundUp<int32>(SizeX, 4), FMath::CeilToInt(VerticalFaceSize)),
+      1,
+      4096);
+
+  CaptureRenderTargetCube = NewObject<UTextureRenderTargetCube>(this);
+  CaptureRenderTargetCube->Init(FaceSize, PF_B8G8R8A8);
+
+  CaptureComponentCube = NewObject<USceneCaptureComponentCube>(this);
+  CaptureComponentCube->SetupAttachment(MeshComp);
+  CaptureComponentCube->TextureTarget = CaptureRenderTargetCube;
+  CaptureComponentCube->bCaptureEveryFrame = false;
+  CaptureComponentCube->bCaptureOnMovement = false;
+  if (PostProcessEffect == EPostProcessEffect::None) {
+    RemoveShowFlags(CaptureComponentCube->ShowFlags);
+  }
+  ApplyRenderQuality(RenderQuality, *CaptureComponentCube);
+  CaptureComponentCube->RegisterComponent();
+
+  CaptureComponent2D->bCaptureEveryFrame = false;
+  CaptureComponent2D->Deactivate();
+  PanoramaDirections.Reset();
+}
+
+void ASceneCaptureCamera::CaptureSceneNow()
+{
+  SetUpSceneCapture();
+  if (CaptureComponentCube != nullptr) {
+    CaptureComponentCube->CaptureScene();
+  } else {
+    CaptureComponent2D->CaptureScene();
+  }
+}
+
+void ASceneCaptureCamera::Tick(const float DeltaSeconds)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaSceneCaptureCameraTick);
+  Super::Tick(DeltaSeconds);
+
+  UpdateCaptureEveryFrame();
+  if (IsAsyncReadback() && CaptureComponent2D->bCaptureEveryFrame) {
+    EnqueueReadback(GFrameCounter);
+  }
 }
 
 void ASceneCaptureCamera::SetImageSize(uint32 otherSizeX, uint32 otherSizeY)
@@ -125,6 +382,54 @@ void ASceneCaptureCamera::SetImageSize(uint32 otherSizeX, uint32 otherSizeY)
   SizeY = otherSizeY;
 }
 
+FIntRect ASceneCaptureCamera::GetRegionOfInterest() const
+{
+  return (RegionOfInterest.Area() > 0 ? RegionOfInterest : FIntRect(0, 0, SizeX, SizeY));
+}
+
+uint32 ASceneCaptureCamera::GetOutputSizeX() const
+{
+  return (OutputSizeX > 0u ? OutputSizeX : GetRegionOfInterest().Width());
+}
+
+uint32 ASceneCaptureCamera::GetOutputSizeY() const
+{
+  return (OutputSizeY > 0u ? OutputSizeY : GetRegionOfInterest().Height());
+}
+
+bool ASceneCaptureCamera::IsCroppedOrScaled() const
+{
+  return (GetRegionOfInterest() != FIntRect(0, 0, SizeX, SizeY)) ||
+         (GetOutputSizeX() != SizeX) ||
+         (GetOutputSizeY() != SizeY);
+}
+
+void ASceneCaptureCamera::SetRegionOfInterest(const FIntRect &Region)
+{
+  RegionOfInterest = Region;
+  RegionOfInterest.Clip(FIntRect(0, 0, SizeX, SizeY));
+  PanoramaDirections.Reset();
+}
+
+void ASceneCaptureCamera::SetOutputSize(const uint32 otherSizeX, const uint32 otherSizeY)
+{
+  OutputSizeX = otherSizeX;
+  OutputSizeY = otherSizeY;
+}
+
+void ASceneCaptureCamera::SetResizeFilter(const EImageResizeFilter Filter)
+{
+  ResizeFilter = Filter;
+}
+
+void ASceneCaptureCamera::SetProjection(
+    const EImageProjection otherProjection,
+    const float otherVerticalFOVAngle)
+{
+  Projection = otherProjection;
+  VerticalFOVAngle = FMath::Clamp(otherVerticalFOVAngle, 1.0f, 170.0f);
+}
+
 void ASceneCaptureCamera::SetPostProcessEffect(EPostProcessEffect otherPostProcessEffect)
 {
   PostProcessEffect = otherPostProcessEffect;
@@ -137,23 +442,153 @@ void ASceneCaptureCamera::SetPostProcessEffect(EPostProcessEffect otherPostProce
   }
 }
 
+void ASceneCaptureCamera::SetImageEncoding(const EImageEncoding otherImageEncoding)
+{
+  ImageEncoding = otherImageEncoding;
+}
+
+void ASceneCaptureCamera::SetImageCompression(const EImageCompression otherImageCompression)
+{
+  ImageCompression = otherImageCompression;
+}
+
+void ASceneCaptureCamera::SetImageKeyFrameInterval(const uint32 Images)
+{
+  ImageKeyFrameInterval = FMath::Max(Images, 1u);
+}
+
 void ASceneCaptureCamera::SetFOVAngle(const float FOVAngle)
 {
   check(CaptureComponent2D != nullptr);
   CaptureComponent2D->FOVAngle = FOVAngle;
 }
 
+float ASceneCaptureCamera::GetFOVAngle() const
+{
+  check(CaptureComponent2D != nullptr);
+  return CaptureComponent2D->FOVAngle;
+}
+
+void ASceneCaptureCamera::SetComputeAgentBoxes(const bool bEnabled)
+{
+  bComputeAgentBoxes = bEnabled;
+}
+
+void ASceneCaptureCamera::SetComputeClassHistogram(const bool bEnabled)
+{
+  bComputeClassHistogram = bEnabled;
+}
+
+void ASceneCaptureCamera::SetSendImage(const bool bEnabled)
+{
+  bSendImage = bEnabled;
+}
+
+void ASceneCaptureCamera::SetRenderQuality(const FCameraRenderQuality &InRenderQuality)
+{
+  RenderQuality = InRenderQuality;
+}
+
+void ASceneCaptureCamera::SetScreenPercentage(const float Percentage)
+{
+  if (!bIsSceneCaptureSetUp) {
+    return;
+  }
+  ScreenPercentage = FMath::Clamp(
+      Percentage,
+      FMath::Min(RenderQuality.MinScreenPercentage, RenderQuality.ScreenPercentage),
+      RenderQuality.ScreenPercentage);
+  auto &PostProcessSettings = CaptureComponent2D->PostProcessSettings;
+  PostProcessSettings.bOverride_ScreenPercentage = (ScreenPercentage < 100.0f);
+  PostProcessSettings.ScreenPercentage = ScreenPercentage;
+}
+
+float ASceneCaptureCamera::GetImageScreenPercentage() const
+{
+  if (IsAsyncReadback()) {
+    const auto Index = FindReadyReadback();
+    if (Index != INDEX_NONE) {
+      return Readbacks[Index].ScreenPercentage;
+    }
+  }
+  return ScreenPercentage;
+}
+
+void ASceneCaptureCamera::SetShareRenderTarget(const bool bEnabled)
+{
+  bShareRenderTarget = bEnabled;
+}
+
+void ASceneCaptureCamera::SetPointCloud(const uint32 Stride, const float FarClip)
+{
+  PointCloudStride = FMath::Max(Stride, 1u);
+  PointCloudFarClip = FMath::Max(FarClip, 0.0f);
+}
+
 void ASceneCaptureCamera::SetTargetGamma(const float TargetGamma)
 {
   check(CaptureRenderTarget != nullptr);
   CaptureRenderTarget->TargetGamma = TargetGamma;
 }
 
+void ASceneCaptureCamera::SetReadbackLatency(const uint32 Frames)
+{
+  ReadbackLatency = Frames;
+}
+
+void ASceneCaptureCamera::SetCaptureEveryNFrames(const uint32 Frames)
+{
+  CaptureEveryNFrames = FMath::Max(Frames, 1u);
+}
+
+void ASceneCaptureCamera::SetCaptureEnabled(const bool bEnabled)
+{
+  bCaptureEnabled = bEnabled;
+  UpdateCaptureEveryFrame();
+}
+
+void ASceneCaptureCamera::SetDroppedByBudget(const bool bDropped)
+{
+  bDroppedByBudget = bDropped;
+  UpdateCaptureEveryFrame();
+}
+
+bool ASceneCaptureCamera::HasImage(const uint64 FrameNumber) const
+{
+  if (bDroppedByBudget) {
+    return false;
+  }
+  if (IsAsyncReadback()) {
+    uint64 ReadyFrameNumber;
+    return (CaptureEveryNFrames == 1u) || PeekPixelsAsync(ReadyFrameNumber);
+  }
+  return IsCaptureDue(FrameNumber);
+}
+
 void ASceneCaptureCamera::Set(const FCameraDescription &CameraDescription)
 {
   SetImageSize(CameraDescription.ImageSizeX, CameraDescription.ImageSizeY);
+  SetRegionOfInterest(FIntRect(
+      CameraDescription.RegionOfInterestX,
+      CameraDescription.RegionOfInterestY,
+      CameraDescription.RegionOfInterestX + CameraDescription.RegionOfInterestWidth,
+      CameraDescription.RegionOfInterestY + CameraDescription.RegionOfInterestHeight));
+  SetOutputSize(CameraDescription.OutputSizeX, CameraDescription.OutputSizeY);
+  SetResizeFilter(CameraDescription.ResizeFilter);
+  SetProjection(CameraDescription.Projection, CameraDescription.VerticalFOVAngle);
   SetPostProcessEffect(CameraDescription.PostProcessEffect);
+  SetImageEncoding(CameraDescription.ImageEncoding);
+  SetImageCompression(CameraDescription.ImageCompression);
+  SetImageKeyFrameInterval(CameraDescription.ImageKeyFrameInterval);
   SetFOVAngle(CameraDescription.FOVAngle);
+  SetReadbackLatency(CameraDescription.ReadbackLatency);
+  SetCaptureEveryNFrames(CameraDescription.CaptureEveryNFrames);
+  SetComputeAgentBoxes(CameraDescription.bComputeAgentBoxes);
+  SetComputeClassHistogram(CameraDescription.bComputeClassHistogram);
+  SetSendImage(CameraDescription.bSendImage);
+  SetShareRenderTarget(CameraDescription.bShareRenderTarget);
+  SetRenderQuality(CameraDescription.RenderQuality);
+  SetPointCloud(CameraDescription.PointCloudStride, CameraDescription.PointCloudFarClip);
 }
 
 void ASceneCaptureCamera::Set(
@@ -172,6 +607,42 @@ void ASceneCaptureCamera::Set(
   Set(CameraDescription);
 }
 
+FTextureRenderTargetResource *ASceneCaptureCamera::GetRenderTargetResource() const
+{
+  check(CaptureRenderTarget != nullptr);
+  return CaptureRenderTarget->GameThread_GetRenderTargetResource();
+}
+
+SIZE_T ASceneCaptureCamera::GetRenderTargetAllocatedSize() const
+{
+  if (CaptureRenderTargetCube != nullptr) {
+    return CubeFace_MAX * CalcTextureSize(
+        CaptureRenderTargetCube->SizeX,
+        CaptureRenderTargetCube->SizeX,
+        CaptureRenderTargetCube->GetFormat(),
+        1u);
+  }
+  return (CaptureRenderTarget == nullptr ?
+      0u :
+      CalcTextureSize(
+          CaptureRenderTarget->SizeX,
+          CaptureRenderTarget->SizeY,
+          CaptureRenderTarget->GetFormat(),
+          1u));
+}
+
+SIZE_T ASceneCaptureCamera::GetBitMapsAllocatedSize() const
+{
+  SIZE_T Size = BitMap.GetAllocatedSize() + PanoramaDirections.GetAllocatedSize();
+  for (const auto &Face : CubeFaces) {
+    Size += Face.GetAllocatedSize();
+  }
+  for (const auto &Readback : Readbacks) {
+    Size += Readback.BitMap.GetAllocatedSize();
+  }
+  return Size;
+}
+
 bool ASceneCaptureCamera::ReadPixels(TArray<FColor> &BitMap) const
 {
   FTextureRenderTargetResource* RTResource = CaptureRenderTarget->GameThread_GetRenderTargetResource();
@@ -184,6 +655,413 @@ bool ASceneCaptureCamera::ReadPixels(TArray<FColor> &BitMap) const
   return RTResource->ReadPixels(BitMap, ReadPixelFlags);
 }
 
+bool ASceneCaptureCamera::ReadPixels(FColor *Buffer)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaReadPixels);
+  check(Buffer != nullptr);
+  if (CaptureComponentCube != nullptr) {
+    return ReadPanorama(Buffer);
+  }
+  FTextureRenderTargetResource* RTResource = CaptureRenderTarget->GameThread_GetRenderTargetResource();
+  if (RTResource == nullptr) {
+    UE_LOG(LogCarla, Error, TEXT("SceneCaptureCamera: Missing render target"));
+    return false;
+  }
+  // Not FRenderTarget::ReadPixelsPtr, it allocates a new bitmap on every call.
+  ENQUEUE_UNIQUE_RENDER_COMMAND_THREEPARAMETER(
+      FSceneCaptureReadPixelsCommand,
+      FTextureRenderTargetResource *, RTResource, RTResource,
+      FIntRect, Rect, GetRegionOfInterest(),
+      TArray<FColor> *, BitMap, &BitMap,
+  {
+    ReadSurfaceData_RenderThread(RHICmdList, RTResource, Rect, *BitMap);
+  });
+  FlushRenderingCommands();
+  if (!CopyToOutput(BitMap, Buffer)) {
+    UE_LOG(LogCarla, Error, TEXT("SceneCaptureCamera: Readback failed"));
+    return false;
+  }
+  return true;
+}
+
+bool ASceneCaptureCamera::ReadPanorama(FColor *Buffer)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaReadPanorama);
+  check(CaptureRenderTargetCube != nullptr);
+  FTextureRenderTargetResource* RTResource = CaptureRenderTargetCube->GameThread_GetRenderTargetResource();
+  if (RTResource == nullptr) {
+    UE_LOG(LogCarla, Error, TEXT("SceneCaptureCamera: Missing render target"));
+    return false;
+  }
+  const int32 FaceSize = CaptureRenderTargetCube->SizeX;
+  ENQUEUE_UNIQUE_RENDER_COMMAND_THREEPARAMETER(
+      FSceneCaptureReadCubeFacesCommand,
+      FTextureRenderTargetResource *, RTResource, RTResource,
+      int32, FaceSize, FaceSize,
+      TArray<FColor> *, Faces, CubeFaces,
+  {
+    for (auto Face = 0; Face < CubeFace_MAX; ++Face) {
+      FReadSurfaceDataFlags ReadPixelFlags(RCM_UNorm, static_cast<ECubeFace>(Face));
+      ReadPixelFlags.SetLinearToGamma(true);
+      RHICmdList.ReadSurfaceData(RTResource->TextureRHI, FIntRect(0, 0, FaceSize, FaceSize), Faces[Face], ReadPixelFlags);
+    }
+  });
+  FlushRenderingCommands();
+  for (const auto &Face : CubeFaces) {
+    if (Face.Num() != FaceSize * FaceSize) {
+      UE_LOG(LogCarla, Error, TEXT("SceneCaptureCamera: Readback failed"));
+      return false;
+    }
+  }
+
+  UpdatePanoramaDirections();
+  const FIntRect Region = GetRegionOfInterest();
+  const int32 Width = Region.Width();
+  const FQuat Rotation = GetActorQuat();
+  BitMap.SetNumUninitialized(Region.Area(), false);
+  ParallelFor(Region.Height(), [&](const int32 Y) {
+    const FVector *Directions = PanoramaDirections.GetData() + Y * Width;
+    FColor *Row = BitMap.GetData() + Y * Width;
+    for (auto X = 0; X < Width; ++X) {
+      Row[X] = SampleCubeFaces(CubeFaces, FaceSize, Rotation.RotateVector(Directions[X]));
+    }
+  });
+  if (!CopyToOutput(BitMap, Buffer)) {
+    UE_LOG(LogCarla, Error, TEXT("SceneCaptureCamera: Readback failed"));
+    return false;
+  }
+  return true;
+}
+
+void ASceneCaptureCamera::UpdatePanoramaDirections()
+{
+  const FIntRect Region = GetRegionOfInterest();
+  if (PanoramaDirections.Num() == Region.Area()) {
+    return;
+  }
+  PanoramaDirections.SetNumUninitialized(Region.Area());
+  const float TanHalfVerticalFOV = FMath::Tan(FMath::DegreesToRadians(0.5f * VerticalFOVAngle));
+  // X forward, Y right and Z up; the longitude is zero at the center column.
+  // Only the major axis of a direction matters to sample the cube, they need
+  // not be unit vectors.
+  for (auto Y = Region.Min.Y; Y < Region.Max.Y; ++Y) {
+    FVector *Directions = PanoramaDirections.GetData() + (Y - Region.Min.Y) * Region.Width();
+    const float V = (Y + 0.5f) / SizeY;
+    for (auto X = Region.Min.X; X < Region.Max.X; ++X) {
+      const float Longitude = 2.0f * PI * ((X + 0.5f) / SizeX - 0.5f);
+      float SinLongitude;
+      float CosLongitude;
+      FMath::SinCos(&SinLongitude, &CosLongitude, Longitude);
+      if (Projection == EImageProjection::Cylindrical) {
+        const float Height = TanHalfVerticalFOV * (1.0f - 2.0f * V);
+        Directions[X - Region.Min.X] = FVector(CosLongitude, SinLongitude, Height);
+      } else {
+        float SinLatitude;
+        float CosLatitude;
+        FMath::SinCos(&SinLatitude, &CosLatitude, PI * (0.5f - V));
+        Directions[X - Region.Min.X] = FVector(
+            CosLatitude * CosLongitude,
+            CosLatitude * SinLongitude,
+            SinLatitude);
+      }
+    }
+  }
+}
+
+bool ASceneCaptureCamera::ShareRenderTarget(FSharedRenderTargetFrame &Frame)
+{
+  if (!SharedRenderTarget.IsValid()) {
+    return false;
+  }
+  FTextureRenderTargetResource* RTResource = CaptureRenderTarget->GameThread_GetRenderTargetResource();
+  if (RTResource == nullptr) {
+    UE_LOG(LogCarla, Error, TEXT("SceneCaptureCamera: Missing render target"));
+    return false;
+  }
+  Frame = SharedRenderTarget->GetNextFrame();
+  ENQUEUE_UNIQUE_RENDER_COMMAND_THREEPARAMETER(
+      FSceneCaptureShareRenderTargetCommand,
+      FSharedRenderTarget *, Target, SharedRenderTarget.Get(),
+      FTextureRenderTargetResource *, RTResource, RTResource,
+      uint32, Slot, Frame.Slot,
+  {
+    Target->Copy_RenderThread(RHICmdList, RTResource, Slot);
+  });
+  return true;
+}
+
+bool ASceneCaptureCamera::ReadRawPixels(void *Buffer) const
+{
+  check(Buffer != nullptr);
+  FTextureRenderTargetResource* RTResource = CaptureRenderTarget->GameThread_GetRenderTargetResource();
+  if (RTResource == nullptr) {
+    UE_LOG(LogCarla, Error, TEXT("SceneCaptureCamera: Missing render target"));
+    return false;
+  }
+  if (ImageEncoding == EImageEncoding::PointsXYZL) {
+    return ReadPointCloud(RTResource, static_cast<FVector4 *>(Buffer));
+  }
+  if (ImageEncoding == EImageEncoding::MotionVectors) {
+    return ReadMotionVectors(RTResource, static_cast<FFloat16 *>(Buffer));
+  }
+  struct FReadRawPixelsContext
+  {
+    FTextureRenderTargetResource *Source;
+    uint8 *Destination;
+    uint32 RowSize;
+    uint32 NumberOfRows;
+  };
+  const FReadRawPixelsContext Context = {
+      RTResource,
+      static_cast<uint8 *>(Buffer),
+      ImageEncoding::GetBytesPerPixel(ImageEncoding) * SizeX,
+      SizeY};
+  ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+      FSceneCaptureReadRawPixelsCommand,
+      FReadRawPixelsContext, Context, Context,
+  {
+    FTexture2DRHIParamRef Texture = Context.Source->GetRenderTargetTexture();
+    uint32 Stride;
+    const auto *Source = static_cast<const uint8 *>(RHILockTexture2D(Texture, 0, RLM_ReadOnly, Stride, false));
+    for (auto Row = 0u; Row < Context.NumberOfRows; ++Row) {
+      FMemory::Memcpy(Context.Destination + Row * Context.RowSize, Source + Row * Stride, Context.RowSize);
+    }
+    RHIUnlockTexture2D(Texture, 0, false);
+  });
+  FlushRenderingCommands();
+  return true;
+}
+
+bool ASceneCaptureCamera::ReadPointCloud(
+    FTextureRenderTargetResource *RTResource,
+    FVector4 *Buffer) const
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaReadPointCloud);
+  struct FReadPointCloudContext
+  {
+    FTextureRenderTargetResource *Source;
+    FVector4 *Destination;
+    FIntPoint OutputSize;
+    FVector2D HalfSize;
+    float InverseFocal;
+    uint32 Stride;
+    float FarClip;
+  };
+  const FVector2D HalfSize(0.5f * SizeX, 0.5f * SizeY);
+  const float Focal = HalfSize.X / FMath::Tan(FMath::DegreesToRadians(0.5f * GetFOVAngle()));
+  const FReadPointCloudContext Context = {
+      RTResource,
+      Buffer,
+      FIntPoint(GetOutputSizeX(), GetOutputSizeY()),
+      HalfSize,
+      1.0f / Focal,
+      PointCloudStride,
+      (PointCloudFarClip > 0.0f ? PointCloudFarClip : TNumericLimits<float>::Max())};
+  ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+      FSceneCaptureReadPointCloudCommand,
+      FReadPointCloudContext, Context, Context,
+  {
+    FTexture2DRHIParamRef Texture = Context.Source->GetRenderTargetTexture();
+    uint32 Stride;
+    const auto *Source = static_cast<const uint8 *>(RHILockTexture2D(Texture, 0, RLM_ReadOnly, Stride, false));
+    // Only the pixels sampled are touched, rows in parallel. The camera looks
+    // along X, with Y to the right and Z up; depth is along the view axis.
+    ParallelFor(Context.OutputSize.Y, [&](const int32 Row) {
+      const uint32 Y = Row * Context.Stride;
+      const auto *Depths = reinterpret_cast<const float *>(Source + Y * Stride);
+      FVector4 *Points = Context.Destination + Row * Context.OutputSize.X;
+      const float V = (Context.HalfSize.Y - (Y + 0.5f)) * Context.InverseFocal;
+      for (auto Column = 0; Column < Context.OutputSize.X; ++Column) {
+        const uint32 X = Column * Context.Stride;
+        const float Depth = Depths[X];
+        const float U = ((X + 0.5f) - Context.HalfSize.X) * Context.InverseFocal;
+        const FVector Point(Depth, U * Depth, V * Depth);
+        Points[Column] = (Point.SizeSquared() <= FMath::Square(Context.FarClip) ?
+            FVector4(Point, 0.0f) :
+            FVector4(0.0f, 0.0f, 0.0f, 0.0f));
+      }
+    });
+    RHIUnlockTexture2D(Texture, 0, false);
+  });
+  FlushRenderingCommands();
+  return true;
+}
+
+bool ASceneCaptureCamera::CopyToOutput(const TArray<FColor> &BitMap, FColor *Buffer) const
+{
+  const FIntRect Region = GetRegionOfInterest();
+  if (BitMap.Num() != Region.Area()) {
+    return false;
+  }
+  const FIntPoint OutputSize(GetOutputSizeX(), GetOutputSizeY());
+  if (OutputSize == Region.Size()) {
+    FMemory::Memcpy(Buffer, BitMap.GetData(), sizeof(FColor) * BitMap.Num());
+  } else {
+    SCOPE_CYCLE_COUNTER(STAT_CarlaResizeImage);
+    ResizeImage(BitMap.GetData(), Region.Size(), Buffer, OutputSize, ResizeFilter);
+  }
+  return true;
+}
+
+bool ASceneCaptureCamera::ReadMotionVectors(
+    FTextureRenderTargetResource *RTResource,
+    FFloat16 *Buffer) const
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaReadMotionVectors);
+  const FTransform CurrentTransform = GetActorTransform();
+  if (!PreviousTransform.IsSet()) {
+    FMemory::Memzero(Buffer, 2u * sizeof(FFloat16) * SizeX * SizeY);
+    PreviousTransform = CurrentTransform;
+    return true;
+  }
+  struct FReadMotionVectorsContext
+  {
+    FTextureRenderTargetResource *Source;
+    FFloat16 *Destination;
+    FIntPoint Size;
+    FVector2D HalfSize;
+    float Focal;
+    /// From the current camera space to the previous one.
+    FTransform CurrentToPrevious;
+  };
+  const FVector2D HalfSize(0.5f * SizeX, 0.5f * SizeY);
+  const float Focal = HalfSize.X / FMath::Tan(FMath::DegreesToRadians(0.5f * GetFOVAngle()));
+  const FReadMotionVectorsContext Context = {
+      RTResource,
+      Buffer,
+      FIntPoint(SizeX, SizeY),
+      HalfSize,
+      Focal,
+      CurrentTransform.GetRelativeTransform(PreviousTransform.GetValue())};
+  PreviousTransform = CurrentTransform;
+  ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+      FSceneCaptureReadMotionVectorsCommand,
+      FReadMotionVectorsContext, Context, Context,
+  {
+    FTexture2DRHIParamRef Texture = Context.Source->GetRenderTargetTexture();
+    uint32 Stride;
+    const auto *Source = static_cast<const uint8 *>(RHILockTexture2D(Texture, 0, RLM_ReadOnly, Stride, false));
+    const float InverseFocal = 1.0f / Context.Focal;
+    // Same camera space as ReadPointCloud, X along the view axis.
+    ParallelFor(Context.Size.Y, [&](const int32 Y) {
+      const auto *Depths = reinterpret_cast<const float *>(Source + Y * Stride);
+      FFloat16 *Motion = Context.Destination + 2 * Y * Context.Size.X;
+      const float V = (Context.HalfSize.Y - (Y + 0.5f)) * InverseFocal;
+      for (auto X = 0; X < Context.Size.X; ++X) {
+        const float Depth = Depths[X];
+        const float U = ((X + 0.5f) - Context.HalfSize.X) * InverseFocal;
+        const FVector Previous = Context.CurrentToPrevious.TransformPosition(FVector(Depth, U * Depth, V * Depth));
+        float MotionX = 0.0f;
+        float MotionY = 0.0f;
+        // Points behind the previous camera were not visible, no motion.
+        if (Previous.X > KINDA_SMALL_NUMBER) {
+          const float PreviousX = Context.HalfSize.X + Context.Focal * Previous.Y / Previous.X;
+          const float PreviousY = Context.HalfSize.Y - Context.Focal * Previous.Z / Previous.X;
+          MotionX = (X + 0.5f) - PreviousX;
+          MotionY = (Y + 0.5f) - PreviousY;
+        }
+        Motion[2 * X] = FFloat16(MotionX);
+        Motion[2 * X + 1] = FFloat16(MotionY);
+      }
+    });
+    RHIUnlockTexture2D(Texture, 0, false);
+  });
+  FlushRenderingCommands();
+  return true;
+}
+
+int32 ASceneCaptureCamera::FindReadyReadback() const
+{
+  int32 Oldest = INDEX_NONE;
+  for (auto i = 0; i < Readbacks.Num(); ++i) {
+    const auto &Readback = Readbacks[i];
+    if (Readback.bPending &&
+        ((Oldest == INDEX_NONE) || (Readback.FrameNumber < Readbacks[Oldest].FrameNumber))) {
+      Oldest = i;
+    }
+  }
+  if ((Oldest != INDEX_NONE) && (Readbacks[Oldest].FrameNumber + ReadbackLatency > GFrameCounter)) {
+    return INDEX_NONE;
+  }
+  return Oldest;
+}
+
+bool ASceneCaptureCamera::PeekPixelsAsync(uint64 &FrameNumber) const
+{
+  const auto Index = FindReadyReadback();
+  if (Index == INDEX_NONE) {
+    return false;
+  }
+  FrameNumber = Readbacks[Index].FrameNumber;
+  return true;
+}
+
+bool ASceneCaptureCamera::ReadPixelsAsync(FColor *Buffer, uint64 &FrameNumber)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaReadPixelsAsync);
+  check(Buffer != nullptr);
+  const auto Index = FindReadyReadback();
+  if (Index == INDEX_NONE) {
+    return false;
+  }
+  auto *Oldest = &Readbacks[Index];
+  // In steady state the fence is already signaled, waiting is only needed if
+  // the render thread falls more than ReadbackLatency frames behind.
+  if (!Oldest->Fence.IsFenceComplete()) {
+    Oldest->Fence.Wait();
+  }
+  Oldest->bPending = false;
+  if (!CopyToOutput(Oldest->BitMap, Buffer)) {
+    UE_LOG(LogCarla, Error, TEXT("SceneCaptureCamera: Asynchronous readback failed"));
+    return false;
+  }
+  FrameNumber = Oldest->FrameNumber;
+  return true;
+}
+
+void ASceneCaptureCamera::EnqueueReadback(const uint64 FrameNumber)
+{
+  check(Readbacks.Num() > 0);
+  FTextureRenderTargetResource* RTResource = CaptureRenderTarget->GameThread_GetRenderTargetResource();
+  if (RTResource == nullptr) {
+    UE_LOG(LogCarla, Error, TEXT("SceneCaptureCamera: Missing render target"));
+    return;
+  }
+
+  auto &Readback = Readbacks[NextReadback];
+  NextReadback = (NextReadback + 1) % Readbacks.Num();
+
+  // If the slot was never consumed, make sure the render thread is done with it
+  // before reusing it.
+  if (Readback.bPending) {
+    Readback.Fence.Wait();
+  }
+  Readback.FrameNumber = FrameNumber;
+  Readback.ScreenPercentage = ScreenPercentage;
+  Readback.bPending = true;
+
+  ENQUEUE_UNIQUE_RENDER_COMMAND_THREEPARAMETER(
+      FSceneCaptureReadbackCommand,
+      FTextureRenderTargetResource *, RTResource, RTResource,
+      FIntRect, Rect, GetRegionOfInterest(),
+      TArray<FColor> *, BitMap, &Readback.BitMap,
+  {
+    ReadSurfaceData_RenderThread(RHICmdList, RTResource, Rect, *BitMap);
+  });
+  Readback.Fence.BeginFence();
+}
+
+void ASceneCaptureCamera::UpdateCaptureEveryFrame()
+{
+  check(CaptureComponent2D != nullptr);
+  const bool bCapture = bCaptureEnabled && !bDroppedByBudget && IsCaptureDue(GFrameCounter);
+  if (CaptureComponentCube != nullptr) {
+    CaptureComponentCube->bCaptureEveryFrame = bCapture;
+  } else {
+    CaptureComponent2D->bCaptureEveryFrame = bCapture;
+  }
+}
+
 void ASceneCaptureCamera::UpdateDrawFrustum()
 {
   if(DrawFrustum && CaptureComponent2D)
@@ -199,8 +1077,170 @@ void ASceneCaptureCamera::UpdateDrawFrustum()
   }
 }
 
+// Read @a Rect of the render target into @a BitMap, only the pixels in the
+// rect are transferred from the GPU. The bitmap keeps its memory between reads
+// as long as the size does not change.
+static void ReadSurfaceData_RenderThread(
+    FRHICommandListImmediate &RHICmdList,
+    FTextureRenderTargetResource *RTResource,
+    const FIntRect &Rect,
+    TArray<FColor> &BitMap)
+{
+  check(IsInRenderingThread());
+  FReadSurfaceDataFlags ReadPixelFlags(RCM_UNorm);
+  ReadPixelFlags.SetLinearToGamma(true);
+  RHICmdList.ReadSurfaceData(RTResource->GetRenderTargetTexture(), Rect, BitMap, ReadPixelFlags);
+}
+
+// Pixel of the cube faces seen along @a Direction in world space, the major
+// axis picks the face. The faces follow the hardware cube map layout, the
+// scene capture orients them so the cube is sampled with world directions as
+// the reflection captures are.
+static const FColor &SampleCubeFaces(
+    const TArray<FColor> *Faces,
+    const int32 FaceSize,
+    const FVector &Direction)
+{
+  const FVector Abs = Direction.GetAbs();
+  ECubeFace Face;
+  float Major;
+  float S;
+  float T;
+  if ((Abs.X >= Abs.Y) && (Abs.X >= Abs.Z)) {
+    Face = (Direction.X > 0.0f ? CubeFace_PosX : CubeFace_NegX);
+    Major = Abs.X;
+    S = (Direction.X > 0.0f ? -Direction.Z : Direction.Z);
+    T = -Direction.Y;
+  } else if (Abs.Y >= Abs.Z) {
+    Face = (Direction.Y > 0.0f ? CubeFace_PosY : CubeFace_NegY);
+    Major = Abs.Y;
+    S = Direction.X;
+    T = (Direction.Y > 0.0f ? Direction.Z : -Direction.Z);
+  } else {
+    Face = (Direction.Z > 0.0f ? CubeFace_PosZ : CubeFace_NegZ);
+    Major = Abs.Z;
+    S = (Direction.Z > 0.0f ? Direction.X : -Direction.X);
+    T = -Direction.Y;
+  }
+  const float Scale = 0.5f * FaceSize / Major;
+  const int32 X = FMath::Clamp(FMath::FloorToInt(S * Scale + 0.5f * FaceSize), 0, FaceSize - 1);
+  const int32 Y = FMath::Clamp(FMath::FloorToInt(T * Scale + 0.5f * FaceSize), 0, FaceSize - 1);
+  return Faces[Face][Y * FaceSize + X];
+}
+
+// Scale the image in @a Source to @a DestinationSize, one task per row of the
+// destination.
+static void ResizeImage(
+    const FColor *Source,
+    const FIntPoint &SourceSize,
+    FColor *Destination,
+    const FIntPoint &DestinationSize,
+    const EImageResizeFilter Filter)
+{
+  const float ScaleX = static_cast<float>(SourceSize.X) / DestinationSize.X;
+  const float ScaleY = static_cast<float>(SourceSize.Y) / DestinationSize.Y;
+  ParallelFor(DestinationSize.Y, [=](int32 Y) {
+    FColor *Row = Destination + Y * DestinationSize.X;
+    if (Filter == EImageResizeFilter::Bilinear) {
+      // Sample at the center of each destination pixel.
+      const float SampleY = FMath::Clamp((Y + 0.5f) * ScaleY - 0.5f, 0.0f, SourceSize.Y - 1.0f);
+      const int32 Y0 = FMath::FloorToInt(SampleY);
+      const int32 Y1 = FMath::Min(Y0 + 1, SourceSize.Y - 1);
+      const float AlphaY = SampleY - Y0;
+      const FColor *Row0 = Source + Y0 * SourceSize.X;
+      const FColor *Row1 = Source + Y1 * SourceSize.X;
+      for (int32 X = 0; X < DestinationSize.X; ++X) {
+        const float SampleX = FMath::Clamp((X + 0.5f) * ScaleX - 0.5f, 0.0f, SourceSize.X - 1.0f);
+        const int32 X0 = FMath::FloorToInt(SampleX);
+        const int32 X1 = FMath::Min(X0 + 1, SourceSize.X - 1);
+        const float AlphaX = SampleX - X0;
+        const FColor &TopLeft = Row0[X0];
+        const FColor &TopRight = Row0[X1];
+        const FColor &BottomLeft = Row1[X0];
+        const FColor &BottomRight = Row1[X1];
+        auto Channel = [=](uint8 A, uint8 B, uint8 C, uint8 D) {
+          const float Top = FMath::Lerp<float>(A, B, AlphaX);
+          const float Bottom = FMath::Lerp<float>(C, D, AlphaX);
+          return static_cast<uint8>(FMath::RoundToInt(FMath::Lerp(Top, Bottom, AlphaY)));
+        };
+        Row[X] = FColor(
+            Channel(TopLeft.R, TopRight.R, BottomLeft.R, BottomRight.R),
+            Channel(TopLeft.G, TopRight.G, BottomLeft.G, BottomRight.G),
+            Channel(TopLeft.B, TopRight.B, BottomLeft.B, BottomRight.B),
+            Channel(TopLeft.A, TopRight.A, BottomLeft.A, BottomRight.A));
+      }
+    } else {
+      // Average of the source pixels covered, at least one.
+      const int32 Y0 = FMath::Min(FMath::FloorToInt(Y * ScaleY), SourceSize.Y - 1);
+      const int32 Y1 = FMath::Clamp(FMath::FloorToInt((Y + 1) * ScaleY), Y0 + 1, SourceSize.Y);
+      for (int32 X = 0; X < DestinationSize.X; ++X) {
+        const int32 X0 = FMath::Min(FMath::FloorToInt(X * ScaleX), SourceSize.X - 1);
+        const int32 X1 = FMath::Clamp(FMath::FloorToInt((X + 1) * ScaleX), X0 + 1, SourceSize.X);
+        uint32 Sum[4u] = {0u, 0u, 0u, 0u};
+        for (int32 SourceY = Y0; SourceY < Y1; ++SourceY) {
+          const FColor *Pixel = Source + SourceY * SourceSize.X + X0;
+          for (int32 SourceX = X0; SourceX < X1; ++SourceX, ++Pixel) {
+            Sum[0u] += Pixel->R;
+            Sum[1u] += Pixel->G;
+            Sum[2u] += Pixel->B;
+            Sum[3u] += Pixel->A;
+          }
+        }
+        const uint32 Count = (Y1 - Y0) * (X1 - X0);
+        Row[X] = FColor(Sum[0u] / Count, Sum[1u] / Count, Sum[2u] / Count, Sum[3u] / Count);
+      }
+    }
+  });
+}
+
 // Remove the show flags that might interfere with post-processing effects like
 // depth and semantic segmentation.
+static void ApplyRenderQuality(
+    const FCameraRenderQuality &RenderQuality,
+    USceneCaptureComponent &CaptureComponent)
+{
+  CaptureComponent.MaxViewDistanceOverride =
+      (RenderQuality.MaxViewDistance > 0.0f ? RenderQuality.MaxViewDistance : -1.0f);
+  CaptureComponent.LODDistanceFactor = RenderQuality.LODDistanceScale;
+  // Only turn features off, those already removed with the post-processing
+  // stay removed.
+  auto &ShowFlags = CaptureComponent.ShowFlags;
+  if (!RenderQuality.bDynamicShadows) {
+    ShowFlags.SetDynamicShadows(false);
+  }
+  if (!RenderQuality.bAmbientOcclusion) {
+    ShowFlags.SetAmbientOcclusion(false);
+    ShowFlags.SetDistanceFieldAO(false);
+  }
+  // Also if the frame budget governor may scale it down later. Cube captures
+  // have no post-process settings, they render at full size.
+  auto *CaptureComponent2D = Cast<USceneCaptureComponent2D>(&CaptureComponent);
+  if ((CaptureComponent2D != nullptr) &&
+      (FMath::Min(RenderQuality.ScreenPercentage, RenderQuality.MinScreenPercentage) < 100.0f)) {
+    ShowFlags.SetScreenPercentage(true);
+    auto &PostProcessSettings = CaptureComponent2D->PostProcessSettings;
+    PostProcessSettings.bOverride_ScreenPercentage = true;
+    PostProcessSettings.ScreenPercentage = RenderQuality.ScreenPercentage;
+  }
+}
+
+// On top of RemoveShowFlags, for cameras that read only the depth and the
+// custom stencil. None of these write depth nor stencil.
+static void RemoveShadingShowFlags(FEngineShowFlags &ShowFlags, const bool bKeepPostProcessing)
+{
+  ShowFlags.SetCapsuleShadows(false);
+  ShowFlags.SetDecals(false);
+  ShowFlags.SetDistanceFieldAO(false);
+  ShowFlags.SetReflectionEnvironment(false);
+  ShowFlags.SetSeparateTranslucency(false);
+  ShowFlags.SetSpecular(false);
+  ShowFlags.SetTextRender(false);
+  ShowFlags.SetTranslucency(false);
+  ShowFlags.SetVolumetricFog(false);
+  // Needed by the post-process materials that encode depth and labels.
+  ShowFlags.SetPostProcessing(bKeepPostProcessing);
+}
+
 static void RemoveShowFlags(FEngineShowFlags &ShowFlags)
 {
   ShowFlags.SetAmbientOcclusion(false);
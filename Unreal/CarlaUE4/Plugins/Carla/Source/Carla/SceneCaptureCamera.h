@@ -7,14 +7,38 @@
 #pragma once
 
 #include "GameFramework/Actor.h"
+#include "Math/Float16.h"
+#include "RenderCommandFence.h"
 #include "StaticMeshResources.h"
 #include "Settings/CameraDescription.h"
+#include "SharedRenderTarget.h"
 #include "SceneCaptureCamera.generated.h"
 
+class FTextureRenderTargetResource;
+class UCameraRenderTargetPool;
 class UDrawFrustumComponent;
 class USceneCaptureComponent2D;
+class USceneCaptureComponentCube;
 class UStaticMeshComponent;
 class UTextureRenderTarget2D;
+class UTextureRenderTargetCube;
+
+/// Pixels of a scene capture being read back asynchronously from the GPU.
+struct FSceneCaptureReadback
+{
+  TArray<FColor> BitMap;
+
+  /// Signaled when the render thread has finished filling the bitmap.
+  FRenderCommandFence Fence;
+
+  uint64 FrameNumber = 0u;
+
+  /// Screen percentage the image was rendered at.
+  float ScreenPercentage = 100.0f;
+
+  /// Whether the readback was enqueued and not yet consumed.
+  bool bPending = false;
+};
 
 /// Own SceneCapture, re-implementing some of the methods since ASceneCapture
 /// cannot be subclassed.
@@ -35,6 +59,10 @@ public:
 
   virtual void BeginPlay() override;
 
+  virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+  virtual void Tick(float DeltaSeconds) override;
+
   uint32 GetImageSizeX() const
   {
     return SizeX;
@@ -45,29 +73,321 @@ public:
     return SizeY;
   }
 
+  /// Region of the captured image that is read back, the whole image unless
+  /// set otherwise.
+  FIntRect GetRegionOfInterest() const;
+
+  /// X size in pixels of the image sent, the region of interest scaled.
+  uint32 GetOutputSizeX() const;
+
+  /// Y size in pixels of the image sent, the region of interest scaled.
+  uint32 GetOutputSizeY() const;
+
+  /// Whether the image sent is not the whole captured image as is.
+  bool IsCroppedOrScaled() const;
+
   EPostProcessEffect GetPostProcessEffect() const
   {
     return PostProcessEffect;
   }
 
+  EImageProjection GetProjection() const
+  {
+    return Projection;
+  }
+
+  /// Whether the image is a panorama remapped from a cube capture, see
+  /// ReadPanorama.
+  bool IsPanoramic() const
+  {
+    return Projection != EImageProjection::Perspective;
+  }
+
+  EImageEncoding GetImageEncoding() const
+  {
+    return ImageEncoding;
+  }
+
+  EImageCompression GetImageCompression() const
+  {
+    return ImageCompression;
+  }
+
+  uint32 GetImageKeyFrameInterval() const
+  {
+    return ImageKeyFrameInterval;
+  }
+
+  uint32 GetReadbackLatency() const
+  {
+    return ReadbackLatency;
+  }
+
+  bool IsAsyncReadback() const
+  {
+    return ReadbackLatency > 0u;
+  }
+
+  uint32 GetCaptureEveryNFrames() const
+  {
+    return CaptureEveryNFrames;
+  }
+
+  /// Whether the camera captures an image in the frame @a FrameNumber.
+  bool IsCaptureDue(uint64 FrameNumber) const
+  {
+    return (FrameNumber % CaptureEveryNFrames) == 0u;
+  }
+
+  float GetFOVAngle() const;
+
+  /// Whether the boxes of the agents seen by this camera are sent with its
+  /// images, see FAgentBoxProjector.
+  bool IsComputingAgentBoxes() const
+  {
+    return bComputeAgentBoxes;
+  }
+
   void SetImageSize(uint32 SizeX, uint32 SizeY);
 
+  /// Read back only @a Region of the captured image, the whole image if
+  /// empty.
+  void SetRegionOfInterest(const FIntRect &Region);
+
+  /// Scale the region of interest to @a SizeX x @a SizeY pixels before
+  /// sending it, zero keeps the size of the region.
+  void SetOutputSize(uint32 SizeX, uint32 SizeY);
+
+  void SetResizeFilter(EImageResizeFilter Filter);
+
+  /// Takes effect at begin play. @a VerticalFOVAngle is only used by the
+  /// cylindrical projection.
+  void SetProjection(EImageProjection Projection, float VerticalFOVAngle);
+
   void SetPostProcessEffect(EPostProcessEffect PostProcessEffect);
 
+  void SetImageEncoding(EImageEncoding ImageEncoding);
+
+  void SetImageCompression(EImageCompression ImageCompression);
+
+  /// Send a key frame every @a Images delta compressed images, one if zero.
+  void SetImageKeyFrameInterval(uint32 Images);
+
   void SetFOVAngle(float FOVAngle);
 
   void SetTargetGamma(float TargetGamma);
 
+  void SetComputeAgentBoxes(bool bEnabled);
+
+  /// Takes effect at begin play.
+  void SetRenderQuality(const FCameraRenderQuality &RenderQuality);
+
+  const FCameraRenderQuality &GetRenderQuality() const
+  {
+    return RenderQuality;
+  }
+
+  /// Percentage of the image size the scene is currently rendered at.
+  float GetScreenPercentage() const
+  {
+    return ScreenPercentage;
+  }
+
+  /// Render the scene at @a Percentage of the image size from the next
+  /// capture on, clamped to the MinScreenPercentage and ScreenPercentage of
+  /// the render quality. Only once the scene capture is set up.
+  void SetScreenPercentage(float Percentage);
+
+  /// Screen percentage the image sent in this frame was rendered at, that of
+  /// the image the next ReadPixelsAsync would return for asynchronous
+  /// readback.
+  float GetImageScreenPercentage() const;
+
+  /// Stop capturing to save GPU time, see FFrameBudgetGovernor. Independent of
+  /// SetCaptureEnabled, a dropped camera sends no image.
+  void SetDroppedByBudget(bool bDropped);
+
+  bool IsDroppedByBudget() const
+  {
+    return bDroppedByBudget;
+  }
+
+  /// Whether the pixels of each semantic label are counted and sent, see
+  /// FClassHistogram.
+  bool IsComputingClassHistogram() const
+  {
+    return bComputeClassHistogram;
+  }
+
+  void SetComputeClassHistogram(bool bEnabled);
+
+  /// Whether the images of this camera are sent, otherwise they are only
+  /// read back for the class histogram.
+  bool IsSendingImage() const
+  {
+    return bSendImage;
+  }
+
+  void SetSendImage(bool bEnabled);
+
+  /// Whether the render target is shared with the client in the GPU instead
+  /// of read back, only once the shared textures are set up at begin play.
+  bool IsSharingRenderTarget() const
+  {
+    return SharedRenderTarget.IsValid();
+  }
+
+  /// Share the render target with clients in the same host, see
+  /// FSharedRenderTarget. Takes effect at begin play, only with an RHI that
+  /// supports it.
+  void SetShareRenderTarget(bool bEnabled);
+
+  /// For PointsXYZL encoding, unproject the depth every @a Stride pixels and
+  /// zero the points farther than @a FarClip centimeters (zero to keep all).
+  void SetPointCloud(uint32 Stride, float FarClip);
+
+  /// Number of frames the readback of the pixels is allowed to lag behind, if
+  /// zero pixels are read synchronously.
+  void SetReadbackLatency(uint32 Frames);
+
+  /// Capture an image only every @a Frames frames, one if zero.
+  void SetCaptureEveryNFrames(uint32 Frames);
+
+  /// Enable or disable capturing the scene, a disabled camera does not render
+  /// nor read back its images even in the frames it is due.
+  void SetCaptureEnabled(bool bEnabled);
+
+  bool IsCaptureEnabled() const
+  {
+    return bCaptureEnabled;
+  }
+
+  /// Whether an image of this camera has to be sent in the frame
+  /// @a FrameNumber. For asynchronous readback, whether there is an image
+  /// ready (always true if capturing every frame, an empty image is sent
+  /// until the first one is ready).
+  bool HasImage(uint64 FrameNumber) const;
+
   void Set(const FCameraDescription &CameraDescription);
 
   void Set(
       const FCameraDescription &CameraDescription,
       const FCameraPostProcessParameters &OverridePostProcessParameters);
 
+  /// Resource of the render target the scene is captured into.
+  FTextureRenderTargetResource *GetRenderTargetResource() const;
+
+  /// Bytes of the render target, estimated from its size and format.
+  SIZE_T GetRenderTargetAllocatedSize() const;
+
+  /// Bytes of the bitmaps the render target is read back into.
+  SIZE_T GetBitMapsAllocatedSize() const;
+
   bool ReadPixels(TArray<FColor> &BitMap) const;
 
+  /// Read the pixels into @a Buffer, it must have room for at least
+  /// GetOutputSizeX() * GetOutputSizeY() pixels. The pixels go through the
+  /// bitmap of the camera, allocated on the first read and reused on every
+  /// frame after.
+  ///
+  /// Panoramic cameras read their cube capture instead, see ReadPanorama.
+  bool ReadPixels(FColor *Buffer);
+
+  /// Read the pixels as they are in the render target, without converting
+  /// them to FColor. @a Buffer must have room for at least SizeX * SizeY
+  /// pixels of the size given by the image encoding.
+  ///
+  /// With PointsXYZL encoding, the depth is unprojected instead to camera
+  /// space straight from the locked render target, one point per pixel of the
+  /// output size, so @a Buffer must have room for that many points.
+  ///
+  /// With MotionVectors encoding, the depth is reprojected into the previous
+  /// image read of this camera, see ReadMotionVectors.
+  bool ReadRawPixels(void *Buffer) const;
+
+  /// Copy into @a Buffer, as ReadPixels, the oldest image whose asynchronous
+  /// readback is at least ReadbackLatency frames old, waiting for the render
+  /// thread if it is not yet complete. On success, @a FrameNumber is set to
+  /// the frame in which the image was captured.
+  ///
+  /// Returns false if there is no image old enough yet (e.g., during the first
+  /// frames of the episode).
+  bool ReadPixelsAsync(FColor *Buffer, uint64 &FrameNumber);
+
+  /// Retrieve the frame number of the image that the next call to
+  /// ReadPixelsAsync would return, without consuming it.
+  bool PeekPixelsAsync(uint64 &FrameNumber) const;
+
+  /// Enqueue a copy of the render target into the next slot of the shared
+  /// textures, @a Frame is set to what the client needs to open it. The
+  /// client waits on the keyed mutex of the slot, so this does not
+  /// synchronize with the render thread.
+  bool ShareRenderTarget(FSharedRenderTargetFrame &Frame);
+
+  /// Render the scene once right away, even before begin play, so the shaders
+  /// of the post-process effect are compiled ahead of the first episode.
+  void CaptureSceneNow();
+
 private:
 
+  /// Set up the render target and the capture component for the current
+  /// settings, done once at begin play (or at the first CaptureSceneNow).
+  void SetUpSceneCapture();
+
+  /// Create the cube render target and capture component of a panoramic
+  /// camera, the 2D capture component stays idle.
+  void SetUpPanoramicCapture();
+
+  /// Read back the six faces of the cube in a single render command, and
+  /// remap the region of interest of the panorama from them with the nearest
+  /// pixel of each direction. The cube capture is aligned with the world, the
+  /// directions are rotated with the camera on every read.
+  bool ReadPanorama(FColor *Buffer);
+
+  /// Direction in camera space of every pixel of the region of interest of
+  /// the panorama, computed on the first read after the region changes.
+  void UpdatePanoramaDirections();
+
+  /// Wait for the render thread to fill the readbacks pending, and release
+  /// them.
+  void ReleaseReadbacks();
+
+  /// Release the shared textures in the render thread, if any.
+  void ReleaseSharedRenderTarget();
+
+  /// The pool of the game instance, null outside a CARLA game.
+  UCameraRenderTargetPool *GetRenderTargetPool() const;
+
+  /// Hand the render target back to the pool for the cameras of the next
+  /// level.
+  void ReleasePooledRenderTarget();
+
+  /// Enqueue in the render thread a copy of the render target into the next
+  /// readback slot.
+  void EnqueueReadback(uint64 FrameNumber);
+
+  /// Copy the region of interest read back into @a BitMap to @a Buffer,
+  /// scaling it to the output size. Rows are scaled in parallel in the task
+  /// graph workers.
+  bool CopyToOutput(const TArray<FColor> &BitMap, FColor *Buffer) const;
+
+  /// Unproject the depth in the render target into @a Buffer, one point per
+  /// pixel of the output size, in the render thread.
+  bool ReadPointCloud(FTextureRenderTargetResource *RTResource, FVector4 *Buffer) const;
+
+  /// Screen-space motion of every pixel since the previous image read, in
+  /// pixels as two half floats. The depth of each pixel is unprojected and
+  /// projected back with the previous pose of the camera, so only the motion
+  /// of the camera is accounted for, the scene is taken as static. Zero for
+  /// the first image.
+  bool ReadMotionVectors(FTextureRenderTargetResource *RTResource, FFloat16 *Buffer) const;
+
+  /// Index of the oldest readback ready to be consumed, or INDEX_NONE.
+  int32 FindReadyReadback() const;
+
+  /// Render the scene this frame only if capture is enabled and due.
+  void UpdateCaptureEveryFrame();
+
   /// Used to synchronize the DrawFrustumComponent with the
   /// SceneCaptureComponent2D settings.
   void UpdateDrawFrustum();
@@ -78,9 +398,75 @@ private:
   UPROPERTY(Category = "Scene Capture", EditAnywhere)
   uint32 SizeY;
 
+  /// Empty for the whole image.
+  FIntRect RegionOfInterest;
+
+  /// Zero for the size of the region of interest.
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  uint32 OutputSizeX;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  uint32 OutputSizeY;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  EImageResizeFilter ResizeFilter;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  EImageProjection Projection;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere, meta=(ClampMin = "1.0", ClampMax = "170.0"))
+  float VerticalFOVAngle;
+
   UPROPERTY(Category = "Scene Capture", EditAnywhere)
   EPostProcessEffect PostProcessEffect;
 
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  EImageEncoding ImageEncoding;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  EImageCompression ImageCompression;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere, meta=(ClampMin = "1"))
+  uint32 ImageKeyFrameInterval;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  uint32 ReadbackLatency;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere, meta=(ClampMin = "1"))
+  uint32 CaptureEveryNFrames;
+
+  bool bCaptureEnabled = true;
+
+  bool bDroppedByBudget = false;
+
+  bool bIsSceneCaptureSetUp = false;
+
+  /// Whether CaptureRenderTarget came from the UCameraRenderTargetPool.
+  bool bIsRenderTargetPooled = false;
+
+  float ScreenPercentage = 100.0f;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  bool bComputeAgentBoxes;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  bool bComputeClassHistogram;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  bool bSendImage;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  bool bShareRenderTarget;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  FCameraRenderQuality RenderQuality;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere, meta=(ClampMin = "1"))
+  uint32 PointCloudStride;
+
+  UPROPERTY(Category = "Scene Capture", EditAnywhere)
+  float PointCloudFarClip;
+
   /** To display the 3d camera in the editor. */
   UPROPERTY()
   UStaticMeshComponent* MeshComp;
@@ -97,9 +483,39 @@ private:
   UPROPERTY(EditAnywhere)
   USceneCaptureComponent2D* CaptureComponent2D;
 
+  /** Render target of the panoramic cameras, created at begin play. */
+  UPROPERTY(Transient)
+  UTextureRenderTargetCube* CaptureRenderTargetCube = nullptr;
+
+  /** Scene capture component of the panoramic cameras. */
+  UPROPERTY(Transient)
+  USceneCaptureComponentCube* CaptureComponentCube = nullptr;
+
   UPROPERTY()
   UMaterial *PostProcessDepth;
 
   UPROPERTY()
   UMaterial *PostProcessSemanticSegmentation;
+
+  /// Bitmap of the synchronous readback, kept for the lifetime of the camera.
+  TArray<FColor> BitMap;
+
+  /// Faces of the cube read back, in ECubeFace order.
+  TArray<FColor> CubeFaces[CubeFace_MAX];
+
+  /// See UpdatePanoramaDirections.
+  TArray<FVector> PanoramaDirections;
+
+  /// Ring of ReadbackLatency + 1 slots for asynchronous readback.
+  TArray<FSceneCaptureReadback> Readbacks;
+
+  int32 NextReadback = 0;
+
+  /// Pose of the camera at the previous image read with MotionVectors
+  /// encoding.
+  mutable TOptional<FTransform> PreviousTransform;
+
+  /// Textures shared with the client, if enabled and supported. Released in
+  /// the render thread.
+  TUniquePtr<FSharedRenderTarget> SharedRenderTarget;
 };
@@ -23,6 +23,19 @@ void ASceneCaptureToDiskCamera::BeginPlay()
   PrimaryActorTick.TickInterval = 1.0f / CapturesPerSecond;
 
   CaptureFileNameCount = 0u;
+
+  if (bCaptureScene) {
+    Writer = MakeUnique<FImageDiskWriter>(
+        FMath::Max(WriterThreads, 1),
+        FMath::Max(MaxQueuedImages, 1));
+  }
+}
+
+void ASceneCaptureToDiskCamera::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+  // Waits for the images still queued.
+  Writer.Reset();
+  Super::EndPlay(EndPlayReason);
 }
 
 void ASceneCaptureToDiskCamera::Tick(const float DeltaTime)
@@ -43,10 +56,14 @@ bool ASceneCaptureToDiskCamera::SaveCaptureToDisk(const FString &FilePath) const
   if (!ReadPixels(OutBMP)) {
     return false;
   }
+  const FIntPoint DestSize(GetImageSizeX(), GetImageSizeY());
+  if (Writer.IsValid()) {
+    Writer->Write(FilePath, MoveTemp(OutBMP), DestSize, FileFormat);
+    return true;
+  }
   for (FColor &color : OutBMP) {
     color.A = 255;
   }
-  const FIntPoint DestSize(GetImageSizeX(), GetImageSizeY());
   FString ResultPath;
   FHighResScreenshotConfig &HighResScreenshotConfig = GetHighResScreenshotConfig();
   return HighResScreenshotConfig.SaveImage(FilePath, OutBMP, DestSize, &ResultPath);
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include "ImageDiskWriter.h"
 #include "SceneCaptureCamera.h"
 #include "SceneCaptureToDiskCamera.generated.h"
 
@@ -20,8 +21,13 @@ public:
 
   virtual void BeginPlay() override;
 
+  virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
   virtual void Tick(float DeltaTime) override;
 
+  /// Read the pixels and queue them to be written by the writer threads, or
+  /// write them right away if the camera is not playing. Returns false only
+  /// if the pixels could not be read, or written right away.
   UFUNCTION(BlueprintCallable)
   bool SaveCaptureToDisk(const FString &FilePath) const;
 
@@ -39,8 +45,21 @@ public:
   UPROPERTY(Category = "Scene Capture", EditAnywhere, BlueprintReadWrite, meta = (EditCondition = bCaptureScene))
   float CapturesPerSecond = 10.0f;
 
+  UPROPERTY(Category = "Scene Capture", EditAnywhere, BlueprintReadWrite, meta = (EditCondition = bCaptureScene))
+  EImageFileFormat FileFormat = EImageFileFormat::PNG;
+
+  /** Threads encoding and writing the images in the background. */
+  UPROPERTY(Category = "Scene Capture", EditAnywhere, BlueprintReadWrite, meta = (EditCondition = bCaptureScene, ClampMin = "1"))
+  int32 WriterThreads = 2;
+
+  /** Images waiting to be written, the game thread blocks beyond it. */
+  UPROPERTY(Category = "Scene Capture", EditAnywhere, BlueprintReadWrite, meta = (EditCondition = bCaptureScene, ClampMin = "1"))
+  int32 MaxQueuedImages = 8;
+
 private:
 
+  TUniquePtr<FImageDiskWriter> Writer;
+
   UPROPERTY()
   uint32 CaptureFileNameCount;
 };
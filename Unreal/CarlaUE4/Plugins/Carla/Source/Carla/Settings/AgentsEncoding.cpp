@@ -0,0 +1,17 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "AgentsEncoding.h"
+#include "Package.h"
+
+FString AgentsEncoding::ToString(EAgentsEncoding AgentsEncoding)
+{
+  const UEnum* ptr = FindObject<UEnum>(ANY_PACKAGE, TEXT("EAgentsEncoding"), true);
+  if(!ptr)
+    return FString("Invalid");
+  return ptr->GetNameStringByIndex(static_cast<int32>(AgentsEncoding));
+}
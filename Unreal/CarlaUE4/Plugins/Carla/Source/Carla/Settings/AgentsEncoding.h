@@ -0,0 +1,37 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "AgentsEncoding.generated.h"
+
+/// Encoding of the non-player agents sent packed, same values as
+/// CARLA_SERVER_AGENTS_*.
+UENUM(BlueprintType)
+enum class EAgentsEncoding : uint8
+{
+  Float32               UMETA(DisplayName = "32-bit float"),
+  Quantized             UMETA(DisplayName = "Centimeters and 16-bit unit vectors"),
+  QuantizedDelta        UMETA(DisplayName = "Quantized, varint deltas"),
+  HalfFloat             UMETA(DisplayName = "16-bit float"),
+
+  SIZE                  UMETA(Hidden),
+  INVALID               UMETA(Hidden),
+};
+
+/// Helper class for working with EAgentsEncoding.
+class CARLA_API AgentsEncoding {
+public:
+
+  using uint_type = typename std::underlying_type<EAgentsEncoding>::type;
+
+  static FString ToString(EAgentsEncoding AgentsEncoding);
+
+  static constexpr uint_type ToUInt(EAgentsEncoding AgentsEncoding)
+  {
+    return static_cast<uint_type>(AgentsEncoding);
+  }
+};
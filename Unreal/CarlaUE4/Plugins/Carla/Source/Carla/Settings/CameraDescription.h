@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include "CameraRenderQuality.h"
+#include "ImageEncoding.h"
 #include "PostProcessEffect.h"
 #include "CameraDescription.generated.h"
 
@@ -22,6 +24,51 @@ struct FCameraDescription
   UPROPERTY(Category = "Camera Description", EditDefaultsOnly, meta=(ClampMin = "1"))
   uint32 ImageSizeY = 512u;
 
+  /** Region of the captured image sent to the client, the rest is cropped
+    * when reading back the image from the GPU. A zero width or height selects
+    * the whole image. Only for images read as BGRA8.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  uint32 RegionOfInterestX = 0u;
+
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  uint32 RegionOfInterestY = 0u;
+
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  uint32 RegionOfInterestWidth = 0u;
+
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  uint32 RegionOfInterestHeight = 0u;
+
+  /** Size in pixels of the image sent, the region of interest is scaled to
+    * it in the task graph workers after the readback. Zero keeps the size of
+    * the region of interest.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  uint32 OutputSizeX = 0u;
+
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  uint32 OutputSizeY = 0u;
+
+  /** Filter used to scale the region of interest to the output size. */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  EImageResizeFilter ResizeFilter = EImageResizeFilter::Box;
+
+  /** Projection of the captured image. The panoramic projections capture a
+    * cube around the camera with a single scene capture and read back its six
+    * faces at once, the image spans 360 degrees from left to right with the
+    * camera forward at the center. Only for scene color read as BGRA8 or BGR8
+    * synchronously, without agent boxes nor shared render target.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  EImageProjection Projection = EImageProjection::Perspective;
+
+  /** Cylindrical projection only, field of view (in degrees) from the top to
+    * the bottom of the image.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly, meta=(ClampMin = "1.0", ClampMax = "170.0"))
+  float VerticalFOVAngle = 90.0f;
+
   /** Position relative to the player. */
   UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
   FVector Position = {170.0f, 0.0f, 150.0f};
@@ -34,7 +81,96 @@ struct FCameraDescription
   UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
   EPostProcessEffect PostProcessEffect = EPostProcessEffect::SceneFinal;
 
+  /** Encoding of the pixels sent. Depth can be sent as a single float channel
+    * with the depth in centimeters, and semantic segmentation as a single
+    * 8-bit channel with the label.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  EImageEncoding ImageEncoding = EImageEncoding::BGRA8;
+
+  /** Lossless compression of the images, done by the server in its
+    * networking threads. Pays off for semantic segmentation and depth, that
+    * have large uniform regions.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  EImageCompression ImageCompression = EImageCompression::None;
+
+  /** Delta compression only. Every this many images a key frame is sent,
+    * compressed on its own, so the clients that missed an image resume
+    * decoding at the next one.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly, meta=(ClampMin = "1"))
+  uint32 ImageKeyFrameInterval = 30u;
+
   /** Camera field of view (in degrees). */
   UPROPERTY(Category = "Camera Description", EditDefaultsOnly, meta=(DisplayName = "Field of View", ClampMin = "0.001", ClampMax = "360.0"))
   float FOVAngle = 90.0f;
+
+  /** Number of frames of latency allowed for reading back the captured image
+    * from the GPU. If zero, the pixels are read synchronously stalling the
+    * game thread, otherwise the copy is enqueued in the render thread and the
+    * image of frame k is delivered at frame k + ReadbackLatency.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly, meta=(ClampMin = "0", ClampMax = "8"))
+  uint32 ReadbackLatency = 0u;
+
+  /** Capture an image only every N frames of the simulation. In the frames
+    * the camera is not due it is neither rendered nor read back, and no image
+    * of this camera is sent.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly, meta=(ClampMin = "1"))
+  uint32 CaptureEveryNFrames = 1u;
+
+  /** Compute the screen-space boxes of the non-player agents seen by this
+    * camera and send them with its images. If a colocated camera captures
+    * depth, the boxes fully hidden behind the scene are flagged as occluded.
+    * Only for cameras read back synchronously.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  bool bComputeAgentBoxes = false;
+
+  /** Count the pixels of each semantic label and send the counts with the
+    * measurements. Only for semantic segmentation cameras read back
+    * synchronously.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  bool bComputeClassHistogram = false;
+
+  /** Send the images of this camera. Cameras computing class histograms may
+    * turn it off, the image is still read back but only the counts are sent.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  bool bSendImage = true;
+
+  /** Rendering features that can be turned down for this camera. */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  FCameraRenderQuality RenderQuality;
+
+  /** Share the render target with clients in the same host as a GPU texture
+    * instead of reading back its pixels, the image sent only carries the
+    * handle of the texture. Only with D3D11, the region of interest and the
+    * output size do not apply.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  bool bShareRenderTarget = false;
+
+  /** Depth cameras with PointsXYZL encoding only. The depth is unprojected
+    * to a point in camera space every PointCloudStride pixels in each
+    * direction, when reading it back.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly, meta=(ClampMin = "1"))
+  uint32 PointCloudStride = 1u;
+
+  /** Points farther than this distance in centimeters are sent as zero, zero
+    * disables the clipping.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly, meta=(ClampMin = "0.0"))
+  float PointCloudFarClip = 0.0f;
+
+  /** Other post-process effects requested for a camera at the very same
+    * place, each is expanded into its own camera description when loading
+    * the settings.
+    */
+  UPROPERTY(Category = "Camera Description", EditDefaultsOnly)
+  TArray<EPostProcessEffect> ColocatedPostProcessEffects;
 };
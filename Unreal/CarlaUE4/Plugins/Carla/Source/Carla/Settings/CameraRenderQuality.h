@@ -0,0 +1,59 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "CameraRenderQuality.generated.h"
+
+/**
+  * Rendering features of a camera that can be turned down to save GPU time,
+  * e.g. for auxiliary depth and semantic segmentation cameras. The defaults
+  * render as the main camera.
+  */
+USTRUCT()
+struct FCameraRenderQuality
+{
+  GENERATED_USTRUCT_BODY()
+
+  /** Primitives farther than this distance in centimeters are not rendered,
+    * zero or negative for no limit.
+    */
+  UPROPERTY(Category = "Camera Render Quality", EditDefaultsOnly)
+  float MaxViewDistance = 0.0f;
+
+  /** Scale of the distances used to select the level of detail of the
+    * meshes, greater than one switches earlier to the coarser LODs.
+    */
+  UPROPERTY(Category = "Camera Render Quality", EditDefaultsOnly, meta=(ClampMin = "0.01"))
+  float LODDistanceScale = 1.0f;
+
+  /** Render dynamic shadows. */
+  UPROPERTY(Category = "Camera Render Quality", EditDefaultsOnly)
+  bool bDynamicShadows = true;
+
+  /** Render ambient occlusion, screen-space and distance field. */
+  UPROPERTY(Category = "Camera Render Quality", EditDefaultsOnly)
+  bool bAmbientOcclusion = true;
+
+  /** Percentage of the image size the scene is rendered at before being
+    * upscaled to the image size.
+    */
+  UPROPERTY(Category = "Camera Render Quality", EditDefaultsOnly, meta=(ClampMin = "10.0", ClampMax = "100.0"))
+  float ScreenPercentage = 100.0f;
+
+  /** Lowest screen percentage the frame budget governor may scale the camera
+    * down to, zero (or ScreenPercentage) to keep it fixed. See
+    * UCarlaSettings::FrameBudgetMs.
+    */
+  UPROPERTY(Category = "Camera Render Quality", EditDefaultsOnly, meta=(ClampMin = "0.0", ClampMax = "100.0"))
+  float MinScreenPercentage = 0.0f;
+
+  /** Whether the frame budget governor may stop capturing this camera when
+    * the frame is still over budget at the lowest screen percentages.
+    */
+  UPROPERTY(Category = "Camera Render Quality", EditDefaultsOnly)
+  bool bOptional = false;
+};
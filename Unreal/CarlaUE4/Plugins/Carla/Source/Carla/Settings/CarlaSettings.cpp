@@ -10,6 +10,7 @@
 #include "UnrealMathUtility.h"
 
 #include "DynamicWeather.h"
+#include "Game/AgentGrid.h"
 #include "Settings/CarlaSettings.h"
 #include "Util/IniFile.h"
 
@@ -17,6 +18,8 @@
 #define S_CARLA_SERVER                 TEXT("CARLA/Server")
 #define S_CARLA_LEVELSETTINGS          TEXT("CARLA/LevelSettings")
 #define S_CARLA_SCENECAPTURE           TEXT("CARLA/SceneCapture")
+#define S_CARLA_LIDAR                  TEXT("CARLA/LiDAR")
+#define S_CARLA_BATCH                  TEXT("CARLA/Batch")
 
 // =============================================================================
 // -- MyIniFile ----------------------------------------------------------------
@@ -29,30 +32,250 @@ public:
 
   explicit MyIniFile(const FString &FileName) : IniFile(FileName) {}
 
-  void GetPostProcessEffect(const TCHAR* Section, const TCHAR* Key, EPostProcessEffect &Target) const
+  /// The value may be a comma-separated list of effects, then the first one
+  /// is set to @a Target and the rest to @a Others.
+  void GetPostProcessEffects(
+      const TCHAR* Section,
+      const TCHAR* Key,
+      EPostProcessEffect &Target,
+      TArray<EPostProcessEffect> &Others) const
+  {
+    FString ValueString;
+    if (GetFConfigFile().GetString(Section, Key, ValueString)) {
+      TArray<FString> Names;
+      ValueString.ParseIntoArray(Names, TEXT(","), true);
+      Others.Empty();
+      for (auto i = 0; i < Names.Num(); ++i) {
+        const auto Effect = ParsePostProcessEffect(Names[i].Trim().TrimTrailing());
+        if (i == 0) {
+          Target = Effect;
+        } else {
+          Others.Add(Effect);
+        }
+      }
+    }
+  }
+
+  void GetImageEncoding(const TCHAR* Section, const TCHAR* Key, EImageEncoding &Target) const
+  {
+    FString ValueString;
+    if (GetFConfigFile().GetString(Section, Key, ValueString)) {
+      if (ValueString == "BGRA8") {
+        Target = EImageEncoding::BGRA8;
+      } else if (ValueString == "Float32") {
+        Target = EImageEncoding::Float32;
+      } else if (ValueString == "Float16") {
+        Target = EImageEncoding::Float16;
+      } else if (ValueString == "Gray8") {
+        Target = EImageEncoding::Gray8;
+      } else if (ValueString == "BGR8") {
+        Target = EImageEncoding::BGR8;
+      } else if (ValueString == "PointsXYZL") {
+        Target = EImageEncoding::PointsXYZL;
+      } else if (ValueString == "MotionVectors") {
+        Target = EImageEncoding::MotionVectors;
+      } else {
+        UE_LOG(LogCarla, Error, TEXT("Invalid image encoding \"%s\" in INI file"), *ValueString);
+        Target = EImageEncoding::BGRA8;
+      }
+    }
+  }
+
+  void GetImageResizeFilter(const TCHAR* Section, const TCHAR* Key, EImageResizeFilter &Target) const
+  {
+    FString ValueString;
+    if (GetFConfigFile().GetString(Section, Key, ValueString)) {
+      if (ValueString == "Box") {
+        Target = EImageResizeFilter::Box;
+      } else if (ValueString == "Bilinear") {
+        Target = EImageResizeFilter::Bilinear;
+      } else {
+        UE_LOG(LogCarla, Error, TEXT("Invalid resize filter \"%s\" in INI file"), *ValueString);
+        Target = EImageResizeFilter::Box;
+      }
+    }
+  }
+
+  void GetImageProjection(const TCHAR* Section, const TCHAR* Key, EImageProjection &Target) const
+  {
+    FString ValueString;
+    if (GetFConfigFile().GetString(Section, Key, ValueString)) {
+      if (ValueString == "Perspective") {
+        Target = EImageProjection::Perspective;
+      } else if (ValueString == "Equirectangular") {
+        Target = EImageProjection::Equirectangular;
+      } else if (ValueString == "Cylindrical") {
+        Target = EImageProjection::Cylindrical;
+      } else {
+        UE_LOG(LogCarla, Error, TEXT("Invalid projection \"%s\" in INI file"), *ValueString);
+        Target = EImageProjection::Perspective;
+      }
+    }
+  }
+
+  bool GetAgentsEncoding(const TCHAR* Section, const TCHAR* Key, EAgentsEncoding &Target) const
+  {
+    FString ValueString;
+    if (GetFConfigFile().GetString(Section, Key, ValueString)) {
+      if (ValueString == "Float32") {
+        Target = EAgentsEncoding::Float32;
+      } else if (ValueString == "Quantized") {
+        Target = EAgentsEncoding::Quantized;
+      } else if (ValueString == "QuantizedDelta") {
+        Target = EAgentsEncoding::QuantizedDelta;
+      } else if (ValueString == "HalfFloat") {
+        Target = EAgentsEncoding::HalfFloat;
+      } else {
+        UE_LOG(LogCarla, Error, TEXT("Invalid agents encoding \"%s\" in INI file"), *ValueString);
+        Target = EAgentsEncoding::Float32;
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void GetImageCompression(const TCHAR* Section, const TCHAR* Key, EImageCompression &Target) const
   {
     FString ValueString;
     if (GetFConfigFile().GetString(Section, Key, ValueString)) {
       if (ValueString == "None") {
-        Target = EPostProcessEffect::None;
-      } else if (ValueString == "SceneFinal") {
-        Target = EPostProcessEffect::SceneFinal;
-      } else if (ValueString == "Depth") {
-        Target = EPostProcessEffect::Depth;
-      } else if (ValueString == "SemanticSegmentation") {
-        Target = EPostProcessEffect::SemanticSegmentation;
+        Target = EImageCompression::None;
+      } else if (ValueString == "LZ4") {
+        Target = EImageCompression::LZ4;
+      } else if (ValueString == "Delta") {
+        Target = EImageCompression::Delta;
       } else {
-        UE_LOG(LogCarla, Error, TEXT("Invalid post-processing \"%s\" in INI file"), *ValueString);
-        Target = EPostProcessEffect::INVALID;
+        UE_LOG(LogCarla, Error, TEXT("Invalid image compression \"%s\" in INI file"), *ValueString);
+        Target = EImageCompression::None;
       }
     }
   }
+
+private:
+
+  static EPostProcessEffect ParsePostProcessEffect(const FString &ValueString)
+  {
+    if (ValueString == "None") {
+      return EPostProcessEffect::None;
+    } else if (ValueString == "SceneFinal") {
+      return EPostProcessEffect::SceneFinal;
+    } else if (ValueString == "Depth") {
+      return EPostProcessEffect::Depth;
+    } else if (ValueString == "SemanticSegmentation") {
+      return EPostProcessEffect::SemanticSegmentation;
+    } else {
+      UE_LOG(LogCarla, Error, TEXT("Invalid post-processing \"%s\" in INI file"), *ValueString);
+      return EPostProcessEffect::INVALID;
+    }
+  }
+};
+
+// =============================================================================
+// -- FCompiledCarlaSettings ---------------------------------------------------
+// =============================================================================
+
+template <typename T>
+using TSettingsAssignments = TArray<TPair<T UCarlaSettings::*, T>>;
+
+/// The values an INI file sets, parsed once into typed assignments to the
+/// members of UCarlaSettings, so applying them again looks up no section nor
+/// key. The cameras and LiDARs are kept whole, loading an INI replaces them.
+class FCompiledCarlaSettings
+{
+public:
+
+  template <typename T>
+  void Add(T UCarlaSettings::*Member, const T &Value)
+  {
+    GetAssignments(Member).Emplace(Member, Value);
+  }
+
+  void Apply(UCarlaSettings &Settings) const
+  {
+    ApplyAll(Bools, Settings);
+    ApplyAll(UInt8s, Settings);
+    ApplyAll(Int32s, Settings);
+    ApplyAll(UInt32s, Settings);
+    ApplyAll(Floats, Settings);
+    ApplyAll(Strings, Settings);
+    ApplyAll(AgentsEncodings, Settings);
+    Settings.CameraDescriptions = CameraDescriptions;
+    Settings.LidarDescriptions = LidarDescriptions;
+    Settings.bSemanticSegmentationEnabled = bSemanticSegmentationEnabled;
+  }
+
+  TMap<FString, FCameraDescription> CameraDescriptions;
+
+  TMap<FString, FLidarDescription> LidarDescriptions;
+
+  bool bSemanticSegmentationEnabled = false;
+
+private:
+
+  template <typename T>
+  static void ApplyAll(const TSettingsAssignments<T> &Assignments, UCarlaSettings &Settings)
+  {
+    for (const auto &Assignment : Assignments) {
+      Settings.*Assignment.Key = Assignment.Value;
+    }
+  }
+
+  TSettingsAssignments<bool> &GetAssignments(bool UCarlaSettings::*) { return Bools; }
+  TSettingsAssignments<uint8> &GetAssignments(uint8 UCarlaSettings::*) { return UInt8s; }
+  TSettingsAssignments<int32> &GetAssignments(int32 UCarlaSettings::*) { return Int32s; }
+  TSettingsAssignments<uint32> &GetAssignments(uint32 UCarlaSettings::*) { return UInt32s; }
+  TSettingsAssignments<float> &GetAssignments(float UCarlaSettings::*) { return Floats; }
+  TSettingsAssignments<FString> &GetAssignments(FString UCarlaSettings::*) { return Strings; }
+  TSettingsAssignments<EAgentsEncoding> &GetAssignments(EAgentsEncoding UCarlaSettings::*) { return AgentsEncodings; }
+
+  TSettingsAssignments<bool> Bools;
+
+  TSettingsAssignments<uint8> UInt8s;
+
+  TSettingsAssignments<int32> Int32s;
+
+  TSettingsAssignments<uint32> UInt32s;
+
+  TSettingsAssignments<float> Floats;
+
+  TSettingsAssignments<FString> Strings;
+
+  TSettingsAssignments<EAgentsEncoding> AgentsEncodings;
 };
 
 // =============================================================================
 // -- Static methods -----------------------------------------------------------
 // =============================================================================
 
+static bool GetAgentTypeMask(
+    const MyIniFile &ConfigFile,
+    const TCHAR* Section,
+    const TCHAR* Key,
+    uint8 &Mask)
+{
+  FString Types;
+  ConfigFile.GetString(Section, Key, Types);
+  if (Types.IsEmpty()) {
+    return false;
+  }
+  TArray<FString> TypeNames;
+  Types.ParseIntoArray(TypeNames, TEXT(","), true);
+  Mask = 0u;
+  for (FString &Name : TypeNames) {
+    Name = Name.Trim().TrimTrailing();
+    if (Name == TEXT("Vehicles")) {
+      Mask |= FAgentGrid::GetTypeBit(EAgentType::Vehicle);
+    } else if (Name == TEXT("Pedestrians")) {
+      Mask |= FAgentGrid::GetTypeBit(EAgentType::Walker);
+    } else if (Name == TEXT("TrafficSigns")) {
+      Mask |= FAgentGrid::GetTypeBit(EAgentType::TrafficSign);
+    } else {
+      UE_LOG(LogCarla, Error, TEXT("Invalid agent type \"%s\" in INI file"), *Name);
+    }
+  }
+  return true;
+}
+
 static void GetCameraDescription(
     const MyIniFile &ConfigFile,
     const TCHAR* Section,
@@ -60,21 +283,174 @@ static void GetCameraDescription(
 {
   ConfigFile.GetInt(Section, TEXT("ImageSizeX"), Camera.ImageSizeX);
   ConfigFile.GetInt(Section, TEXT("ImageSizeY"), Camera.ImageSizeY);
+  ConfigFile.GetInt(Section, TEXT("RegionOfInterestX"), Camera.RegionOfInterestX);
+  ConfigFile.GetInt(Section, TEXT("RegionOfInterestY"), Camera.RegionOfInterestY);
+  ConfigFile.GetInt(Section, TEXT("RegionOfInterestWidth"), Camera.RegionOfInterestWidth);
+  ConfigFile.GetInt(Section, TEXT("RegionOfInterestHeight"), Camera.RegionOfInterestHeight);
+  ConfigFile.GetInt(Section, TEXT("OutputSizeX"), Camera.OutputSizeX);
+  ConfigFile.GetInt(Section, TEXT("OutputSizeY"), Camera.OutputSizeY);
+  ConfigFile.GetImageResizeFilter(Section, TEXT("ResizeFilter"), Camera.ResizeFilter);
   ConfigFile.GetInt(Section, TEXT("CameraFOV"), Camera.FOVAngle);
+  ConfigFile.GetImageProjection(Section, TEXT("Projection"), Camera.Projection);
+  ConfigFile.GetFloat(Section, TEXT("VerticalFOV"), Camera.VerticalFOVAngle);
   ConfigFile.GetInt(Section, TEXT("CameraPositionX"), Camera.Position.X);
   ConfigFile.GetInt(Section, TEXT("CameraPositionY"), Camera.Position.Y);
   ConfigFile.GetInt(Section, TEXT("CameraPositionZ"), Camera.Position.Z);
   ConfigFile.GetInt(Section, TEXT("CameraRotationPitch"), Camera.Rotation.Pitch);
   ConfigFile.GetInt(Section, TEXT("CameraRotationRoll"), Camera.Rotation.Roll);
   ConfigFile.GetInt(Section, TEXT("CameraRotationYaw"), Camera.Rotation.Yaw);
-  ConfigFile.GetPostProcessEffect(Section, TEXT("PostProcessing"), Camera.PostProcessEffect);
+  ConfigFile.GetPostProcessEffects(
+      Section,
+      TEXT("PostProcessing"),
+      Camera.PostProcessEffect,
+      Camera.ColocatedPostProcessEffects);
+  ConfigFile.GetImageEncoding(Section, TEXT("ImageEncoding"), Camera.ImageEncoding);
+  ConfigFile.GetImageCompression(Section, TEXT("ImageCompression"), Camera.ImageCompression);
+  ConfigFile.GetInt(Section, TEXT("ImageKeyFrameInterval"), Camera.ImageKeyFrameInterval);
+  ConfigFile.GetInt(Section, TEXT("ReadbackLatency"), Camera.ReadbackLatency);
+  ConfigFile.GetInt(Section, TEXT("CaptureEveryNFrames"), Camera.CaptureEveryNFrames);
+  ConfigFile.GetBool(Section, TEXT("AgentBoxes"), Camera.bComputeAgentBoxes);
+  ConfigFile.GetBool(Section, TEXT("ClassHistogram"), Camera.bComputeClassHistogram);
+  ConfigFile.GetBool(Section, TEXT("SendImage"), Camera.bSendImage);
+  ConfigFile.GetBool(Section, TEXT("ShareRenderTarget"), Camera.bShareRenderTarget);
+  ConfigFile.GetFloat(Section, TEXT("MaxViewDistance"), Camera.RenderQuality.MaxViewDistance);
+  ConfigFile.GetFloat(Section, TEXT("LODDistanceScale"), Camera.RenderQuality.LODDistanceScale);
+  ConfigFile.GetBool(Section, TEXT("DynamicShadows"), Camera.RenderQuality.bDynamicShadows);
+  ConfigFile.GetBool(Section, TEXT("AmbientOcclusion"), Camera.RenderQuality.bAmbientOcclusion);
+  ConfigFile.GetFloat(Section, TEXT("ScreenPercentage"), Camera.RenderQuality.ScreenPercentage);
+  ConfigFile.GetFloat(Section, TEXT("MinScreenPercentage"), Camera.RenderQuality.MinScreenPercentage);
+  ConfigFile.GetBool(Section, TEXT("Optional"), Camera.RenderQuality.bOptional);
+  ConfigFile.GetInt(Section, TEXT("PointCloudStride"), Camera.PointCloudStride);
+  ConfigFile.GetFloat(Section, TEXT("PointCloudFarClip"), Camera.PointCloudFarClip);
 }
 
 static void ValidateCameraDescription(FCameraDescription &Camera)
 {
   FMath::Clamp(Camera.FOVAngle, 0.001f, 360.0f);
+  Camera.VerticalFOVAngle = FMath::Clamp(Camera.VerticalFOVAngle, 1.0f, 170.0f);
   Camera.ImageSizeX = (Camera.ImageSizeX == 0u ? 720u : Camera.ImageSizeX);
   Camera.ImageSizeY = (Camera.ImageSizeY == 0u ? 512u : Camera.ImageSizeY);
+  Camera.ReadbackLatency = FMath::Min(Camera.ReadbackLatency, 8u);
+  Camera.CaptureEveryNFrames = FMath::Max(Camera.CaptureEveryNFrames, 1u);
+  Camera.RenderQuality.LODDistanceScale = FMath::Max(Camera.RenderQuality.LODDistanceScale, 0.01f);
+  Camera.RenderQuality.ScreenPercentage = FMath::Clamp(Camera.RenderQuality.ScreenPercentage, 10.0f, 100.0f);
+  Camera.RenderQuality.MinScreenPercentage = (Camera.RenderQuality.MinScreenPercentage <= 0.0f ?
+      Camera.RenderQuality.ScreenPercentage :
+      FMath::Clamp(Camera.RenderQuality.MinScreenPercentage, 10.0f, Camera.RenderQuality.ScreenPercentage));
+  if (Camera.bComputeAgentBoxes && (Camera.ReadbackLatency > 0u)) {
+    UE_LOG(LogCarla, Warning, TEXT("Agent boxes not supported with asynchronous readback, disabling them"));
+    Camera.bComputeAgentBoxes = false;
+  }
+  const bool bIsFloat =
+      (Camera.ImageEncoding == EImageEncoding::Float32) ||
+      (Camera.ImageEncoding == EImageEncoding::Float16);
+  const bool bIsGray = (Camera.ImageEncoding == EImageEncoding::Gray8);
+  const bool bIsComputedFromDepth =
+      (Camera.ImageEncoding == EImageEncoding::PointsXYZL) ||
+      (Camera.ImageEncoding == EImageEncoding::MotionVectors);
+  if (((bIsFloat || bIsComputedFromDepth) && (Camera.PostProcessEffect != EPostProcessEffect::Depth)) ||
+      (bIsGray && (Camera.PostProcessEffect != EPostProcessEffect::SemanticSegmentation))) {
+    UE_LOG(LogCarla, Warning, TEXT("Image encoding %s not supported for this post-processing, using BGRA8"), *ImageEncoding::ToString(Camera.ImageEncoding));
+    Camera.ImageEncoding = EImageEncoding::BGRA8;
+  }
+  if (Camera.bComputeClassHistogram &&
+      ((Camera.PostProcessEffect != EPostProcessEffect::SemanticSegmentation) || (Camera.ReadbackLatency > 0u))) {
+    UE_LOG(LogCarla, Warning, TEXT("Class histograms only supported for semantic segmentation read back synchronously, disabling them"));
+    Camera.bComputeClassHistogram = false;
+  }
+  if (!Camera.bSendImage && !Camera.bComputeClassHistogram) {
+    UE_LOG(LogCarla, Warning, TEXT("Camera not sending images nor class histograms, sending images"));
+    Camera.bSendImage = true;
+  }
+  if (!Camera.bSendImage && Camera.bComputeAgentBoxes) {
+    UE_LOG(LogCarla, Warning, TEXT("Agent boxes not supported for cameras not sending images, disabling them"));
+    Camera.bComputeAgentBoxes = false;
+  }
+  if (!ImageEncoding::IsReadAsBGRA8(Camera.ImageEncoding) && (Camera.ReadbackLatency > 0u)) {
+    UE_LOG(LogCarla, Warning, TEXT("Asynchronous readback only supports BGRA8 and BGR8 images, reading synchronously"));
+    Camera.ReadbackLatency = 0u;
+  }
+  if (Camera.bShareRenderTarget &&
+      (!Camera.bSendImage ||
+       Camera.bComputeAgentBoxes ||
+       Camera.bComputeClassHistogram ||
+       bIsComputedFromDepth)) {
+    UE_LOG(LogCarla, Warning, TEXT("Sharing the render target not supported for cameras reading back the pixels, disabling it"));
+    Camera.bShareRenderTarget = false;
+  }
+  if (Camera.bShareRenderTarget) {
+    // Nothing to read back, the client waits on the shared texture instead.
+    Camera.ReadbackLatency = 0u;
+  }
+  // The region of interest must lie within the image.
+  Camera.RegionOfInterestX = FMath::Min(Camera.RegionOfInterestX, Camera.ImageSizeX - 1u);
+  Camera.RegionOfInterestY = FMath::Min(Camera.RegionOfInterestY, Camera.ImageSizeY - 1u);
+  if ((Camera.RegionOfInterestWidth == 0u) || (Camera.RegionOfInterestHeight == 0u)) {
+    Camera.RegionOfInterestX = 0u;
+    Camera.RegionOfInterestY = 0u;
+    Camera.RegionOfInterestWidth = Camera.ImageSizeX;
+    Camera.RegionOfInterestHeight = Camera.ImageSizeY;
+  }
+  Camera.RegionOfInterestWidth = FMath::Min(Camera.RegionOfInterestWidth, Camera.ImageSizeX - Camera.RegionOfInterestX);
+  Camera.RegionOfInterestHeight = FMath::Min(Camera.RegionOfInterestHeight, Camera.ImageSizeY - Camera.RegionOfInterestY);
+  Camera.OutputSizeX = (Camera.OutputSizeX == 0u ? Camera.RegionOfInterestWidth : Camera.OutputSizeX);
+  Camera.OutputSizeY = (Camera.OutputSizeY == 0u ? Camera.RegionOfInterestHeight : Camera.OutputSizeY);
+  const bool bIsWholeImage =
+      (Camera.RegionOfInterestWidth == Camera.ImageSizeX) &&
+      (Camera.RegionOfInterestHeight == Camera.ImageSizeY) &&
+      (Camera.OutputSizeX == Camera.ImageSizeX) &&
+      (Camera.OutputSizeY == Camera.ImageSizeY);
+  if (!ImageEncoding::IsReadAsBGRA8(Camera.ImageEncoding) && !bIsWholeImage) {
+    UE_LOG(LogCarla, Warning, TEXT("Region of interest and output size only supported for BGRA8 and BGR8 images, sending the whole image"));
+    Camera.RegionOfInterestX = 0u;
+    Camera.RegionOfInterestY = 0u;
+    Camera.RegionOfInterestWidth = Camera.ImageSizeX;
+    Camera.RegionOfInterestHeight = Camera.ImageSizeY;
+    Camera.OutputSizeX = Camera.ImageSizeX;
+    Camera.OutputSizeY = Camera.ImageSizeY;
+  }
+  if (Camera.ImageEncoding == EImageEncoding::PointsXYZL) {
+    // One point every PointCloudStride pixels in each direction.
+    Camera.PointCloudStride = FMath::Max(Camera.PointCloudStride, 1u);
+    Camera.PointCloudFarClip = FMath::Max(Camera.PointCloudFarClip, 0.0f);
+    Camera.OutputSizeX = FMath::DivideAndRoundUp(Camera.ImageSizeX, Camera.PointCloudStride);
+    Camera.OutputSizeY = FMath::DivideAndRoundUp(Camera.ImageSizeY, Camera.PointCloudStride);
+    if (Camera.bComputeAgentBoxes) {
+      UE_LOG(LogCarla, Warning, TEXT("Agent boxes not supported for point clouds, disabling them"));
+      Camera.bComputeAgentBoxes = false;
+    }
+  }
+  if ((Camera.ImageEncoding == EImageEncoding::MotionVectors) && Camera.bComputeAgentBoxes) {
+    UE_LOG(LogCarla, Warning, TEXT("Agent boxes not supported for motion vectors, disabling them"));
+    Camera.bComputeAgentBoxes = false;
+  }
+}
+
+static void GetLidarDescription(
+    const MyIniFile &ConfigFile,
+    const TCHAR* Section,
+    FLidarDescription &Lidar)
+{
+  ConfigFile.GetInt(Section, TEXT("Channels"), Lidar.Channels);
+  ConfigFile.GetFloat(Section, TEXT("Range"), Lidar.Range);
+  ConfigFile.GetInt(Section, TEXT("PointsPerSecond"), Lidar.PointsPerSecond);
+  ConfigFile.GetFloat(Section, TEXT("RotationFrequency"), Lidar.RotationFrequency);
+  ConfigFile.GetFloat(Section, TEXT("UpperFovLimit"), Lidar.UpperFovLimit);
+  ConfigFile.GetFloat(Section, TEXT("LowerFovLimit"), Lidar.LowerFovLimit);
+  ConfigFile.GetFloat(Section, TEXT("LidarPositionX"), Lidar.Position.X);
+  ConfigFile.GetFloat(Section, TEXT("LidarPositionY"), Lidar.Position.Y);
+  ConfigFile.GetFloat(Section, TEXT("LidarPositionZ"), Lidar.Position.Z);
+  ConfigFile.GetFloat(Section, TEXT("LidarRotationPitch"), Lidar.Rotation.Pitch);
+  ConfigFile.GetFloat(Section, TEXT("LidarRotationRoll"), Lidar.Rotation.Roll);
+  ConfigFile.GetFloat(Section, TEXT("LidarRotationYaw"), Lidar.Rotation.Yaw);
+}
+
+static void ValidateLidarDescription(FLidarDescription &Lidar)
+{
+  Lidar.Channels = FMath::Clamp(Lidar.Channels, 1u, 128u);
+  Lidar.Range = FMath::Max(Lidar.Range, 1.0f);
+  Lidar.PointsPerSecond = FMath::Max(Lidar.PointsPerSecond, 1u);
+  Lidar.RotationFrequency = FMath::Max(Lidar.RotationFrequency, 0.01f);
 }
 
 static bool RequestedSemanticSegmentation(const FCameraDescription &Camera)
@@ -82,33 +458,172 @@ static bool RequestedSemanticSegmentation(const FCameraDescription &Camera)
   return (Camera.PostProcessEffect == EPostProcessEffect::SemanticSegmentation);
 }
 
-static void LoadSettingsFromConfig(
+/// Reads the values of the INI into the typed assignments of a
+/// FCompiledCarlaSettings, only the ones present in the INI.
+class FSettingsCompiler
+{
+public:
+
+  FSettingsCompiler(const MyIniFile &InConfigFile, FCompiledCarlaSettings &InCompiled)
+    : ConfigFile(InConfigFile),
+      Compiled(InCompiled) {}
+
+  template <typename T>
+  void GetInt(const TCHAR* Section, const TCHAR* Key, T UCarlaSettings::*Member)
+  {
+    T Value;
+    if (ConfigFile.GetInt(Section, Key, Value)) {
+      Compiled.Add(Member, Value);
+    }
+  }
+
+  void GetBool(const TCHAR* Section, const TCHAR* Key, bool UCarlaSettings::*Member)
+  {
+    bool Value;
+    if (ConfigFile.GetBool(Section, Key, Value)) {
+      Compiled.Add(Member, Value);
+    }
+  }
+
+  void GetFloat(const TCHAR* Section, const TCHAR* Key, float UCarlaSettings::*Member)
+  {
+    float Value;
+    if (ConfigFile.GetFloat(Section, Key, Value)) {
+      Compiled.Add(Member, Value);
+    }
+  }
+
+  void GetString(const TCHAR* Section, const TCHAR* Key, FString UCarlaSettings::*Member)
+  {
+    FString Value;
+    if (ConfigFile.GetString(Section, Key, Value)) {
+      Compiled.Add(Member, Value);
+    }
+  }
+
+  void GetAgentsEncoding(const TCHAR* Section, const TCHAR* Key, EAgentsEncoding UCarlaSettings::*Member)
+  {
+    EAgentsEncoding Value;
+    if (ConfigFile.GetAgentsEncoding(Section, Key, Value)) {
+      Compiled.Add(Member, Value);
+    }
+  }
+
+  void GetAgentTypeMask(const TCHAR* Section, const TCHAR* Key, uint8 UCarlaSettings::*Member)
+  {
+    uint8 Value;
+    if (::GetAgentTypeMask(ConfigFile, Section, Key, Value)) {
+      Compiled.Add(Member, Value);
+    }
+  }
+
+private:
+
+  const MyIniFile &ConfigFile;
+
+  FCompiledCarlaSettings &Compiled;
+};
+
+/// Parses every value of the INI, and validates the cameras and LiDARs.
+static void CompileSettings(
     const MyIniFile &ConfigFile,
-    UCarlaSettings &Settings,
+    FCompiledCarlaSettings &Compiled,
     const bool bLoadCarlaServerSection)
 {
+  FSettingsCompiler Compiler(ConfigFile, Compiled);
   // CarlaServer.
   if (bLoadCarlaServerSection) {
-    ConfigFile.GetBool(S_CARLA_SERVER, TEXT("UseNetworking"), Settings.bUseNetworking);
-    ConfigFile.GetInt(S_CARLA_SERVER, TEXT("WorldPort"), Settings.WorldPort);
-    ConfigFile.GetInt(S_CARLA_SERVER, TEXT("ServerTimeOut"), Settings.ServerTimeOut);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("UseNetworking"), &UCarlaSettings::bUseNetworking);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("WorldPort"), &UCarlaSettings::WorldPort);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("ServerTimeOut"), &UCarlaSettings::ServerTimeOut);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("TCPNoDelay"), &UCarlaSettings::bTCPNoDelay);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("TCPReuseAddress"), &UCarlaSettings::bTCPReuseAddress);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("MeasurementsSendBufferSize"), &UCarlaSettings::MeasurementsSendBufferSize);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("ControlReceiveBufferSize"), &UCarlaSettings::ControlReceiveBufferSize);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("LivenessTimeOut"), &UCarlaSettings::LivenessTimeOut);
+    Compiler.GetString(S_CARLA_SERVER, TEXT("ServerThreadCPUs"), &UCarlaSettings::ServerThreadCPUs);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("ServerThreadPriority"), &UCarlaSettings::ServerThreadPriority);
+    Compiler.GetString(S_CARLA_SERVER, TEXT("GameThreadCPUs"), &UCarlaSettings::GameThreadCPUs);
+    Compiler.GetString(S_CARLA_SERVER, TEXT("RenderThreadCPUs"), &UCarlaSettings::RenderThreadCPUs);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("HugePageBuffers"), &UCarlaSettings::bHugePageBuffers);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("NUMALocalBuffers"), &UCarlaSettings::bNUMALocalBuffers);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("PreWarmWeatherPresets"), &UCarlaSettings::bPreWarmWeatherPresets);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("PreWarmShaders"), &UCarlaSettings::bPreWarmShaders);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("CameraRenderTargetPoolSize"), &UCarlaSettings::CameraRenderTargetPoolSize);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("TextureStreamingPoolSizeMB"), &UCarlaSettings::TextureStreamingPoolSizeMB);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("RenderTargetPoolSizeMB"), &UCarlaSettings::RenderTargetPoolSizeMB);
+    Compiler.GetFloat(S_CARLA_SERVER, TEXT("TextureMipBias"), &UCarlaSettings::TextureMipBias);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("PublishMeasurements"), &UCarlaSettings::bPublishMeasurements);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("PublisherMaxQueuedFrames"), &UCarlaSettings::PublisherMaxQueuedFrames);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("RecordStream"), &UCarlaSettings::bRecordStream);
+    Compiler.GetString(S_CARLA_SERVER, TEXT("RecordingDirectory"), &UCarlaSettings::RecordingDirectory);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("RecordingSegmentSizeMB"), &UCarlaSettings::RecordingSegmentSizeMB);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("MetricsServer"), &UCarlaSettings::bEnableMetricsServer);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("ReconnectWithoutRestart"), &UCarlaSettings::bReconnectWithoutRestart);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("PauseWhileDisconnected"), &UCarlaSettings::bPauseWhileDisconnected);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("LoadLevelBeforeClient"), &UCarlaSettings::bLoadLevelBeforeClient);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("AsyncPhysicsScene"), &UCarlaSettings::bAsyncPhysicsScene);
+    Compiler.GetBool(S_CARLA_SERVER, TEXT("RestStoppedVehicles"), &UCarlaSettings::bRestStoppedVehicles);
+    Compiler.GetString(S_CARLA_SERVER, TEXT("ResidentMaps"), &UCarlaSettings::ResidentMaps);
+    Compiler.GetInt(S_CARLA_SERVER, TEXT("ResidentMapsMemoryBudgetMB"), &UCarlaSettings::ResidentMapsMemoryBudgetMB);
+    // Batch.
+    Compiler.GetInt(S_CARLA_BATCH, TEXT("NumberOfEpisodes"), &UCarlaSettings::BatchNumberOfEpisodes);
+    Compiler.GetInt(S_CARLA_BATCH, TEXT("FramesPerEpisode"), &UCarlaSettings::BatchFramesPerEpisode);
+    Compiler.GetInt(S_CARLA_BATCH, TEXT("WarmUpFrames"), &UCarlaSettings::BatchWarmUpFrames);
+    Compiler.GetString(S_CARLA_BATCH, TEXT("Weathers"), &UCarlaSettings::BatchWeathers);
   }
-  ConfigFile.GetBool(S_CARLA_SERVER, TEXT("SynchronousMode"), Settings.bSynchronousMode);
-  ConfigFile.GetBool(S_CARLA_SERVER, TEXT("SendNonPlayerAgentsInfo"), Settings.bSendNonPlayerAgentsInfo);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("SynchronousMode"), &UCarlaSettings::bSynchronousMode);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("PipelinedSynchronousMode"), &UCarlaSettings::bPipelinedSynchronousMode);
+  Compiler.GetInt(S_CARLA_SERVER, TEXT("ControlSpinCount"), &UCarlaSettings::ControlSpinCount);
+  Compiler.GetInt(S_CARLA_SERVER, TEXT("ControlYieldCount"), &UCarlaSettings::ControlYieldCount);
+  Compiler.GetFloat(S_CARLA_SERVER, TEXT("FixedDeltaSeconds"), &UCarlaSettings::FixedDeltaSeconds);
+  Compiler.GetFloat(S_CARLA_SERVER, TEXT("TargetFramesPerSecond"), &UCarlaSettings::TargetFramesPerSecond);
+  Compiler.GetFloat(S_CARLA_SERVER, TEXT("FramePacingSpinMilliseconds"), &UCarlaSettings::FramePacingSpinMilliseconds);
+  Compiler.GetInt(S_CARLA_SERVER, TEXT("PhysicsSubsteps"), &UCarlaSettings::PhysicsSubsteps);
+  Compiler.GetFloat(S_CARLA_SERVER, TEXT("MaxPhysicsSubstepDeltaSeconds"), &UCarlaSettings::MaxPhysicsSubstepDeltaSeconds);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("SkipUnusedFrameRendering"), &UCarlaSettings::bSkipUnusedFrameRendering);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("HeadlessRendering"), &UCarlaSettings::bHeadlessRendering);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("SendNonPlayerAgentsInfo"), &UCarlaSettings::bSendNonPlayerAgentsInfo);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("PackNonPlayerAgentsInfo"), &UCarlaSettings::bPackNonPlayerAgentsInfo);
+  Compiler.GetAgentsEncoding(S_CARLA_SERVER, TEXT("PackedAgentsEncoding"), &UCarlaSettings::PackedAgentsEncoding);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("SendNonPlayerAgentsDelta"), &UCarlaSettings::bSendNonPlayerAgentsDelta);
+  Compiler.GetFloat(S_CARLA_SERVER, TEXT("NonPlayerAgentsDeltaThreshold"), &UCarlaSettings::NonPlayerAgentsDeltaThreshold);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("NonPlayerAgentsRoadIntersection"), &UCarlaSettings::bSendNonPlayerAgentsRoadIntersection);
+  Compiler.GetFloat(S_CARLA_SERVER, TEXT("NonPlayerAgentsRadius"), &UCarlaSettings::NonPlayerAgentsRadius);
+  Compiler.GetInt(S_CARLA_SERVER, TEXT("MaxNumberOfNonPlayerAgents"), &UCarlaSettings::MaxNumberOfNonPlayerAgents);
+  Compiler.GetAgentTypeMask(S_CARLA_SERVER, TEXT("NonPlayerAgentsTypes"), &UCarlaSettings::NonPlayerAgentsTypeMask);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("SharedMemoryImages"), &UCarlaSettings::bUseSharedMemoryImages);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("PersistentAgentConnections"), &UCarlaSettings::bPersistentAgentConnections);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("SeparateImagesStream"), &UCarlaSettings::bSeparateImagesStream);
+  Compiler.GetInt(S_CARLA_SERVER, TEXT("ImagesStreamBufferSize"), &UCarlaSettings::ImagesStreamBufferSize);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("ImagesStreamDropOldest"), &UCarlaSettings::bImagesStreamDropOldest);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("SoftEpisodeReset"), &UCarlaSettings::bSoftEpisodeReset);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("DeltaEpisodeReset"), &UCarlaSettings::bDeltaEpisodeReset);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("ResumeEpisode"), &UCarlaSettings::bResumeEpisode);
+  Compiler.GetBool(S_CARLA_SERVER, TEXT("SendFrameTiming"), &UCarlaSettings::bSendFrameTiming);
   // LevelSettings.
-  ConfigFile.GetString(S_CARLA_LEVELSETTINGS, TEXT("PlayerVehicle"), Settings.PlayerVehicle);
-  ConfigFile.GetInt(S_CARLA_LEVELSETTINGS, TEXT("NumberOfVehicles"), Settings.NumberOfVehicles);
-  ConfigFile.GetInt(S_CARLA_LEVELSETTINGS, TEXT("NumberOfPedestrians"), Settings.NumberOfPedestrians);
-  ConfigFile.GetInt(S_CARLA_LEVELSETTINGS, TEXT("WeatherId"), Settings.WeatherId);
-  ConfigFile.GetInt(S_CARLA_LEVELSETTINGS, TEXT("SeedVehicles"), Settings.SeedVehicles);
-  ConfigFile.GetInt(S_CARLA_LEVELSETTINGS, TEXT("SeedPedestrians"), Settings.SeedPedestrians);
+  Compiler.GetString(S_CARLA_LEVELSETTINGS, TEXT("MapName"), &UCarlaSettings::MapName);
+  Compiler.GetString(S_CARLA_LEVELSETTINGS, TEXT("PlayerVehicle"), &UCarlaSettings::PlayerVehicle);
+  Compiler.GetInt(S_CARLA_LEVELSETTINGS, TEXT("NumberOfVehicles"), &UCarlaSettings::NumberOfVehicles);
+  Compiler.GetInt(S_CARLA_LEVELSETTINGS, TEXT("NumberOfPedestrians"), &UCarlaSettings::NumberOfPedestrians);
+  Compiler.GetInt(S_CARLA_LEVELSETTINGS, TEXT("WeatherId"), &UCarlaSettings::WeatherId);
+  Compiler.GetInt(S_CARLA_LEVELSETTINGS, TEXT("SeedVehicles"), &UCarlaSettings::SeedVehicles);
+  Compiler.GetInt(S_CARLA_LEVELSETTINGS, TEXT("SeedPedestrians"), &UCarlaSettings::SeedPedestrians);
+  Compiler.GetInt(S_CARLA_LEVELSETTINGS, TEXT("MaxSpawnsPerFrame"), &UCarlaSettings::MaxSpawnsPerFrame);
+  Compiler.GetFloat(S_CARLA_LEVELSETTINGS, TEXT("StreamingRadius"), &UCarlaSettings::StreamingRadius);
+  Compiler.GetBool(S_CARLA_LEVELSETTINGS, TEXT("StreamCollision"), &UCarlaSettings::bStreamCollision);
+  Compiler.GetInt(S_CARLA_LEVELSETTINGS, TEXT("MaxCrowdPedestrians"), &UCarlaSettings::MaxCrowdPedestrians);
+  Compiler.GetFloat(S_CARLA_LEVELSETTINGS, TEXT("CrowdQueryRange"), &UCarlaSettings::CrowdQueryRange);
+  Compiler.GetFloat(S_CARLA_LEVELSETTINGS, TEXT("CrowdHighQualityDistance"), &UCarlaSettings::CrowdHighQualityDistance);
   // SceneCapture.
+  Compiler.GetBool(S_CARLA_SCENECAPTURE, TEXT("UseCameraAtlas"), &UCarlaSettings::bUseCameraAtlas);
+  Compiler.GetFloat(S_CARLA_SCENECAPTURE, TEXT("FrameBudgetMs"), &UCarlaSettings::FrameBudgetMs);
   FString Cameras;
   ConfigFile.GetString(S_CARLA_SCENECAPTURE, TEXT("Cameras"), Cameras);
   TArray<FString> CameraNames;
   Cameras.ParseIntoArray(CameraNames, TEXT(","), true);
   for (FString &Name : CameraNames) {
-    FCameraDescription &Camera = Settings.CameraDescriptions.FindOrAdd(Name);
+    FCameraDescription &Camera = Compiled.CameraDescriptions.FindOrAdd(Name);
     GetCameraDescription(ConfigFile, S_CARLA_SCENECAPTURE, Camera);
 
     TArray<FString> SubSections;
@@ -122,17 +637,83 @@ static void LoadSettingsFromConfig(
     }
 
     ValidateCameraDescription(Camera);
-    Settings.bSemanticSegmentationEnabled |= RequestedSemanticSegmentation(Camera);
+    Compiled.bSemanticSegmentationEnabled |= RequestedSemanticSegmentation(Camera);
+
+    // Expand the co-located effects into their own camera, same description
+    // but a different post-processing. Its own subsection may override other
+    // values (e.g., the image encoding).
+    const auto ColocatedEffects = Camera.ColocatedPostProcessEffects;
+    Camera.ColocatedPostProcessEffects.Empty();
+    for (const auto Effect : ColocatedEffects) {
+      const FString EffectName = PostProcessEffect::ToString(Effect);
+      FCameraDescription Colocated = Compiled.CameraDescriptions[Name];
+      GetCameraDescription(ConfigFile, *(Section + TEXT("/") + EffectName), Colocated);
+      Colocated.PostProcessEffect = Effect;
+      Colocated.ColocatedPostProcessEffects.Empty();
+      ValidateCameraDescription(Colocated);
+      Compiled.bSemanticSegmentationEnabled |= RequestedSemanticSegmentation(Colocated);
+      Compiled.CameraDescriptions.Add(Name + TEXT("/") + EffectName, Colocated);
+    }
+  }
+  // LiDAR.
+  FString Lidars;
+  ConfigFile.GetString(S_CARLA_LIDAR, TEXT("Lidars"), Lidars);
+  TArray<FString> LidarNames;
+  Lidars.ParseIntoArray(LidarNames, TEXT(","), true);
+  for (FString &Name : LidarNames) {
+    FLidarDescription &Lidar = Compiled.LidarDescriptions.FindOrAdd(Name);
+    GetLidarDescription(ConfigFile, S_CARLA_LIDAR, Lidar);
+    GetLidarDescription(ConfigFile, *(FString(S_CARLA_LIDAR) + TEXT("/") + Name), Lidar);
+    ValidateLidarDescription(Lidar);
   }
 }
 
-static bool GetSettingsFilePathFromCommandLine(FString &Value)
+/// Number of INI strings kept compiled, a client usually requests its
+/// episodes with a few of them, e.g. one per weather.
+static constexpr int32 MAX_COMPILED_SETTINGS = 8;
+
+/// Compiles the INI, or takes it from the ones compiled before if the very
+/// same contents were seen, then nothing is parsed. Game thread only.
+static TSharedPtr<const FCompiledCarlaSettings> GetCompiledSettings(const FString &INIFileContents)
 {
-  if (FParse::Value(FCommandLine::Get(), TEXT("-carla-settings="), Value)) {
+  struct FEntry
+  {
+    uint32 Hash;
+    FString Contents;
+    TSharedPtr<const FCompiledCarlaSettings> Settings;
+  };
+  // Most recently used last.
+  static TArray<FEntry> Cache;
+  check(IsInGameThread());
+  const uint32 Hash = FCrc::MemCrc32(*INIFileContents, INIFileContents.Len() * sizeof(TCHAR));
+  for (auto i = Cache.Num() - 1; i >= 0; --i) {
+    if ((Cache[i].Hash == Hash) && Cache[i].Contents.Equals(INIFileContents, ESearchCase::CaseSensitive)) {
+      FEntry Entry = Cache[i];
+      Cache.RemoveAt(i);
+      Cache.Add(Entry);
+      UE_LOG(LogCarla, Log, TEXT("Using the settings compiled before"));
+      return Entry.Settings;
+    }
+  }
+  MyIniFile ConfigFile;
+  ConfigFile.ProcessInputFileContents(INIFileContents);
+  TSharedPtr<FCompiledCarlaSettings> Compiled = MakeShareable(new FCompiledCarlaSettings());
+  constexpr bool bLoadCarlaServerSection = false;
+  CompileSettings(ConfigFile, *Compiled, bLoadCarlaServerSection);
+  if (Cache.Num() == MAX_COMPILED_SETTINGS) {
+    Cache.RemoveAt(0);
+  }
+  Cache.Add(FEntry{Hash, INIFileContents, Compiled});
+  return Compiled;
+}
+
+static bool GetSettingsFilePathFromCommandLine(const TCHAR *Option, FString &Value)
+{
+  if (FParse::Value(FCommandLine::Get(), Option, Value)) {
     if (FPaths::IsRelative(Value)) {
       Value = FPaths::ConvertRelativePathToFull(FPaths::LaunchDir(), Value);
-      return true;
     }
+    return true;
   }
   return false;
 }
@@ -149,8 +730,16 @@ void UCarlaSettings::LoadSettings()
   // Load settings given by command-line arg if provided.
   {
     FString FilePath;
-    if (GetSettingsFilePathFromCommandLine(FilePath)) {
+    if (GetSettingsFilePathFromCommandLine(TEXT("-carla-settings="), FilePath)) {
+      LoadSettingsFromFile(FilePath, true);
+    }
+  }
+  // The job of a batch run goes on top, it usually holds the sensors too.
+  {
+    FString FilePath;
+    if (GetSettingsFilePathFromCommandLine(TEXT("-carla-batch="), FilePath)) {
       LoadSettingsFromFile(FilePath, true);
+      BatchJobFile = FilePath;
     }
   }
   // Override settings from command-line.
@@ -170,11 +759,7 @@ void UCarlaSettings::LoadSettings()
 void UCarlaSettings::LoadSettingsFromString(const FString &INIFileContents)
 {
   UE_LOG(LogCarla, Log, TEXT("Loading CARLA settings from string"));
-  ResetCameraDescriptions();
-  MyIniFile ConfigFile;
-  ConfigFile.ProcessInputFileContents(INIFileContents);
-  constexpr bool bLoadCarlaServerSection = false;
-  LoadSettingsFromConfig(ConfigFile, *this, bLoadCarlaServerSection);
+  GetCompiledSettings(INIFileContents)->Apply(*this);
   CurrentFileName = TEXT("<string-provided-by-client>");
 }
 
@@ -202,15 +787,85 @@ void UCarlaSettings::LogSettings() const
   UE_LOG(LogCarla, Log, TEXT("Networking = %s"), EnabledDisabled(bUseNetworking));
   UE_LOG(LogCarla, Log, TEXT("World Port = %d"), WorldPort);
   UE_LOG(LogCarla, Log, TEXT("Server Time-out = %d ms"), ServerTimeOut);
+  UE_LOG(LogCarla, Log, TEXT("TCP No Delay = %s"), EnabledDisabled(bTCPNoDelay));
+  UE_LOG(LogCarla, Log, TEXT("TCP Reuse Address = %s"), EnabledDisabled(bTCPReuseAddress));
+  UE_LOG(LogCarla, Log, TEXT("Measurements Send Buffer Size = %d bytes"), MeasurementsSendBufferSize);
+  UE_LOG(LogCarla, Log, TEXT("Control Receive Buffer Size = %d bytes"), ControlReceiveBufferSize);
+  UE_LOG(LogCarla, Log, TEXT("Liveness Time-out = %d ms"), LivenessTimeOut);
+  UE_LOG(LogCarla, Log, TEXT("Server Thread CPUs = \"%s\""), *ServerThreadCPUs);
+  UE_LOG(LogCarla, Log, TEXT("Server Thread Priority = %d"), ServerThreadPriority);
+  UE_LOG(LogCarla, Log, TEXT("Game Thread CPUs = \"%s\""), *GameThreadCPUs);
+  UE_LOG(LogCarla, Log, TEXT("Render Thread CPUs = \"%s\""), *RenderThreadCPUs);
+  UE_LOG(LogCarla, Log, TEXT("Huge Page Buffers = %s"), EnabledDisabled(bHugePageBuffers));
+  UE_LOG(LogCarla, Log, TEXT("NUMA-Local Buffers = %s"), EnabledDisabled(bNUMALocalBuffers));
+  UE_LOG(LogCarla, Log, TEXT("Pre-warm Weather Presets = %s"), EnabledDisabled(bPreWarmWeatherPresets));
+  UE_LOG(LogCarla, Log, TEXT("Pre-warm Shaders = %s"), EnabledDisabled(bPreWarmShaders));
+  UE_LOG(LogCarla, Log, TEXT("Camera Render Target Pool Size = %d"), CameraRenderTargetPoolSize);
+  UE_LOG(LogCarla, Log, TEXT("Texture Streaming Pool Size = %d MB"), TextureStreamingPoolSizeMB);
+  UE_LOG(LogCarla, Log, TEXT("Render Target Pool Size = %d MB"), RenderTargetPoolSizeMB);
+  UE_LOG(LogCarla, Log, TEXT("Texture Mip Bias = %.2f"), TextureMipBias);
+  UE_LOG(LogCarla, Log, TEXT("Publish Measurements = %s"), EnabledDisabled(bPublishMeasurements));
+  UE_LOG(LogCarla, Log, TEXT("Publisher Max Queued Frames = %d"), PublisherMaxQueuedFrames);
+  UE_LOG(LogCarla, Log, TEXT("Record Stream = %s"), EnabledDisabled(bRecordStream));
+  UE_LOG(LogCarla, Log, TEXT("Recording Directory = \"%s\""), *RecordingDirectory);
+  UE_LOG(LogCarla, Log, TEXT("Recording Segment Size = %d MB"), RecordingSegmentSizeMB);
+  UE_LOG(LogCarla, Log, TEXT("Metrics Server = %s"), EnabledDisabled(bEnableMetricsServer));
+  UE_LOG(LogCarla, Log, TEXT("Reconnect Without Restart = %s"), EnabledDisabled(bReconnectWithoutRestart));
+  UE_LOG(LogCarla, Log, TEXT("Pause While Disconnected = %s"), EnabledDisabled(bPauseWhileDisconnected));
+  UE_LOG(LogCarla, Log, TEXT("Load Level Before Client = %s"), EnabledDisabled(bLoadLevelBeforeClient));
+  UE_LOG(LogCarla, Log, TEXT("Async Physics Scene = %s"), EnabledDisabled(bAsyncPhysicsScene));
+  UE_LOG(LogCarla, Log, TEXT("Rest Stopped Vehicles = %s"), EnabledDisabled(bRestStoppedVehicles));
+  UE_LOG(LogCarla, Log, TEXT("Resident Maps = \"%s\""), *ResidentMaps);
+  UE_LOG(LogCarla, Log, TEXT("Resident Maps Memory Budget = %d MB"), ResidentMapsMemoryBudgetMB);
   UE_LOG(LogCarla, Log, TEXT("Synchronous Mode = %s"), EnabledDisabled(bSynchronousMode));
+  UE_LOG(LogCarla, Log, TEXT("Pipelined Synchronous Mode = %s"), EnabledDisabled(bPipelinedSynchronousMode));
+  UE_LOG(LogCarla, Log, TEXT("Control Spin Count = %d"), ControlSpinCount);
+  UE_LOG(LogCarla, Log, TEXT("Control Yield Count = %d"), ControlYieldCount);
+  UE_LOG(LogCarla, Log, TEXT("Fixed Delta Seconds = %.4f"), FixedDeltaSeconds);
+  UE_LOG(LogCarla, Log, TEXT("Target Frames Per Second = %.2f"), TargetFramesPerSecond);
+  UE_LOG(LogCarla, Log, TEXT("Frame Pacing Spin = %.2f ms"), FramePacingSpinMilliseconds);
+  UE_LOG(LogCarla, Log, TEXT("Physics Substeps = %d"), PhysicsSubsteps);
+  UE_LOG(LogCarla, Log, TEXT("Max Physics Substep Delta Seconds = %.4f"), MaxPhysicsSubstepDeltaSeconds);
+  UE_LOG(LogCarla, Log, TEXT("Skip Unused Frame Rendering = %s"), EnabledDisabled(bSkipUnusedFrameRendering));
+  UE_LOG(LogCarla, Log, TEXT("Headless Rendering = %s"), EnabledDisabled(bHeadlessRendering));
   UE_LOG(LogCarla, Log, TEXT("Send Non-Player Agents Info = %s"), EnabledDisabled(bSendNonPlayerAgentsInfo));
+  UE_LOG(LogCarla, Log, TEXT("Pack Non-Player Agents Info = %s"), EnabledDisabled(bPackNonPlayerAgentsInfo));
+  UE_LOG(LogCarla, Log, TEXT("Packed Agents Encoding = %s"), *AgentsEncoding::ToString(PackedAgentsEncoding));
+  UE_LOG(LogCarla, Log, TEXT("Send Non-Player Agents Delta = %s"), EnabledDisabled(bSendNonPlayerAgentsDelta));
+  UE_LOG(LogCarla, Log, TEXT("Non-Player Agents Delta Threshold = %.2f"), NonPlayerAgentsDeltaThreshold);
+  UE_LOG(LogCarla, Log, TEXT("Non-Player Agents Road Intersection = %s"), EnabledDisabled(bSendNonPlayerAgentsRoadIntersection));
+  UE_LOG(LogCarla, Log, TEXT("Non-Player Agents Radius = %.2f"), NonPlayerAgentsRadius);
+  UE_LOG(LogCarla, Log, TEXT("Max Number Of Non-Player Agents = %d"), MaxNumberOfNonPlayerAgents);
+  UE_LOG(LogCarla, Log, TEXT("Non-Player Agents Type Mask = 0x%02x"), NonPlayerAgentsTypeMask);
+  UE_LOG(LogCarla, Log, TEXT("Shared Memory Images = %s"), EnabledDisabled(bUseSharedMemoryImages));
+  UE_LOG(LogCarla, Log, TEXT("Persistent Agent Connections = %s"), EnabledDisabled(bPersistentAgentConnections));
+  UE_LOG(LogCarla, Log, TEXT("Separate Images Stream = %s"), EnabledDisabled(bSeparateImagesStream));
+  UE_LOG(LogCarla, Log, TEXT("Images Stream Buffer Size = %d"), ImagesStreamBufferSize);
+  UE_LOG(LogCarla, Log, TEXT("Images Stream Drop Oldest = %s"), EnabledDisabled(bImagesStreamDropOldest));
+  UE_LOG(LogCarla, Log, TEXT("Soft Episode Reset = %s"), EnabledDisabled(bSoftEpisodeReset));
+  UE_LOG(LogCarla, Log, TEXT("Delta Episode Reset = %s"), EnabledDisabled(bDeltaEpisodeReset));
+  UE_LOG(LogCarla, Log, TEXT("Resume Episode = %s"), EnabledDisabled(bResumeEpisode));
+  UE_LOG(LogCarla, Log, TEXT("Send Frame Timing = %s"), EnabledDisabled(bSendFrameTiming));
+  UE_LOG(LogCarla, Log, TEXT("[%s]"), S_CARLA_BATCH);
+  UE_LOG(LogCarla, Log, TEXT("Job File = \"%s\""), *BatchJobFile);
+  UE_LOG(LogCarla, Log, TEXT("Number Of Episodes = %d"), BatchNumberOfEpisodes);
+  UE_LOG(LogCarla, Log, TEXT("Frames Per Episode = %d"), BatchFramesPerEpisode);
+  UE_LOG(LogCarla, Log, TEXT("Warm-up Frames = %d"), BatchWarmUpFrames);
+  UE_LOG(LogCarla, Log, TEXT("Weathers = \"%s\""), *BatchWeathers);
   UE_LOG(LogCarla, Log, TEXT("[%s]"), S_CARLA_LEVELSETTINGS);
+  UE_LOG(LogCarla, Log, TEXT("Map Name              = %s"), (MapName.IsEmpty() ? TEXT("Current") : *MapName));
   UE_LOG(LogCarla, Log, TEXT("Player Vehicle        = %s"), (PlayerVehicle.IsEmpty() ? TEXT("Default") : *PlayerVehicle));
   UE_LOG(LogCarla, Log, TEXT("Number Of Vehicles    = %d"), NumberOfVehicles);
   UE_LOG(LogCarla, Log, TEXT("Number Of Pedestrians = %d"), NumberOfPedestrians);
   UE_LOG(LogCarla, Log, TEXT("Weather Id = %d"), WeatherId);
   UE_LOG(LogCarla, Log, TEXT("Seed Vehicle Spawner = %d"), SeedVehicles);
   UE_LOG(LogCarla, Log, TEXT("Seed Pedestrian Spawner = %d"), SeedPedestrians);
+  UE_LOG(LogCarla, Log, TEXT("Max Spawns Per Frame = %d"), MaxSpawnsPerFrame);
+  UE_LOG(LogCarla, Log, TEXT("Streaming Radius = %.1f"), StreamingRadius);
+  UE_LOG(LogCarla, Log, TEXT("Stream Collision = %s"), EnabledDisabled(bStreamCollision));
+  UE_LOG(LogCarla, Log, TEXT("Max Crowd Pedestrians = %d"), MaxCrowdPedestrians);
+  UE_LOG(LogCarla, Log, TEXT("Crowd Query Range = %.1f"), CrowdQueryRange);
+  UE_LOG(LogCarla, Log, TEXT("Crowd High Quality Distance = %.1f"), CrowdHighQualityDistance);
   UE_LOG(LogCarla, Log, TEXT("Found %d available weather settings."), WeatherDescriptions.Num());
   for (auto i = 0; i < WeatherDescriptions.Num(); ++i) {
     UE_LOG(LogCarla, Log, TEXT("  * %d - %s"), i, *WeatherDescriptions[i].Name);
@@ -218,12 +873,47 @@ void UCarlaSettings::LogSettings() const
   UE_LOG(LogCarla, Log, TEXT("[%s]"), S_CARLA_SCENECAPTURE);
   UE_LOG(LogCarla, Log, TEXT("Added %d cameras."), CameraDescriptions.Num());
   UE_LOG(LogCarla, Log, TEXT("Semantic Segmentation = %s"), EnabledDisabled(bSemanticSegmentationEnabled));
+  UE_LOG(LogCarla, Log, TEXT("Camera Atlas = %s"), EnabledDisabled(bUseCameraAtlas));
+  UE_LOG(LogCarla, Log, TEXT("Frame Budget = %.2f ms"), FrameBudgetMs);
   for (auto &Item : CameraDescriptions) {
     UE_LOG(LogCarla, Log, TEXT("[%s/%s]"), S_CARLA_SCENECAPTURE, *Item.Key);
     UE_LOG(LogCarla, Log, TEXT("Image Size = %dx%d"), Item.Value.ImageSizeX, Item.Value.ImageSizeY);
+    UE_LOG(LogCarla, Log, TEXT("Region Of Interest = %dx%d at (%d, %d)"), Item.Value.RegionOfInterestWidth, Item.Value.RegionOfInterestHeight, Item.Value.RegionOfInterestX, Item.Value.RegionOfInterestY);
+    UE_LOG(LogCarla, Log, TEXT("Output Size = %dx%d (%s)"), Item.Value.OutputSizeX, Item.Value.OutputSizeY, *ImageResizeFilter::ToString(Item.Value.ResizeFilter));
+    UE_LOG(LogCarla, Log, TEXT("Projection = %s"), *ImageProjection::ToString(Item.Value.Projection));
+    if (Item.Value.Projection == EImageProjection::Cylindrical) {
+      UE_LOG(LogCarla, Log, TEXT("Vertical Field Of View = %.2f"), Item.Value.VerticalFOVAngle);
+    }
     UE_LOG(LogCarla, Log, TEXT("Camera Position = (%s)"), *Item.Value.Position.ToString());
     UE_LOG(LogCarla, Log, TEXT("Camera Rotation = (%s)"), *Item.Value.Rotation.ToString());
     UE_LOG(LogCarla, Log, TEXT("Post-Processing = %s"), *PostProcessEffect::ToString(Item.Value.PostProcessEffect));
+    UE_LOG(LogCarla, Log, TEXT("Image Encoding = %s"), *ImageEncoding::ToString(Item.Value.ImageEncoding));
+    UE_LOG(LogCarla, Log, TEXT("Image Compression = %s"), *ImageCompression::ToString(Item.Value.ImageCompression));
+    if (Item.Value.ImageCompression == EImageCompression::Delta) {
+      UE_LOG(LogCarla, Log, TEXT("Image Key Frame Every %d Images"), Item.Value.ImageKeyFrameInterval);
+    }
+    UE_LOG(LogCarla, Log, TEXT("Readback Latency = %d frames"), Item.Value.ReadbackLatency);
+    UE_LOG(LogCarla, Log, TEXT("Capture Every %d Frames"), Item.Value.CaptureEveryNFrames);
+    UE_LOG(LogCarla, Log, TEXT("Share Render Target = %s"), EnabledDisabled(Item.Value.bShareRenderTarget));
+    const auto &Quality = Item.Value.RenderQuality;
+    UE_LOG(LogCarla, Log, TEXT("Max View Distance = %.2f cm"), Quality.MaxViewDistance);
+    UE_LOG(LogCarla, Log, TEXT("LOD Distance Scale = %.2f"), Quality.LODDistanceScale);
+    UE_LOG(LogCarla, Log, TEXT("Dynamic Shadows = %s"), EnabledDisabled(Quality.bDynamicShadows));
+    UE_LOG(LogCarla, Log, TEXT("Ambient Occlusion = %s"), EnabledDisabled(Quality.bAmbientOcclusion));
+    UE_LOG(LogCarla, Log, TEXT("Screen Percentage = %.0f%% (min %.0f%%)"), Quality.ScreenPercentage, Quality.MinScreenPercentage);
+    UE_LOG(LogCarla, Log, TEXT("Optional = %s"), EnabledDisabled(Quality.bOptional));
+  }
+  UE_LOG(LogCarla, Log, TEXT("[%s]"), S_CARLA_LIDAR);
+  UE_LOG(LogCarla, Log, TEXT("Added %d LiDARs."), LidarDescriptions.Num());
+  for (auto &Item : LidarDescriptions) {
+    UE_LOG(LogCarla, Log, TEXT("[%s/%s]"), S_CARLA_LIDAR, *Item.Key);
+    UE_LOG(LogCarla, Log, TEXT("Channels = %d"), Item.Value.Channels);
+    UE_LOG(LogCarla, Log, TEXT("Range = %.2f cm"), Item.Value.Range);
+    UE_LOG(LogCarla, Log, TEXT("Points Per Second = %d"), Item.Value.PointsPerSecond);
+    UE_LOG(LogCarla, Log, TEXT("Rotation Frequency = %.2f Hz"), Item.Value.RotationFrequency);
+    UE_LOG(LogCarla, Log, TEXT("Field Of View = [%.2f, %.2f] degrees"), Item.Value.LowerFovLimit, Item.Value.UpperFovLimit);
+    UE_LOG(LogCarla, Log, TEXT("LiDAR Position = (%s)"), *Item.Value.Position.ToString());
+    UE_LOG(LogCarla, Log, TEXT("LiDAR Rotation = (%s)"), *Item.Value.Rotation.ToString());
   }
   UE_LOG(LogCarla, Log, TEXT("================================================================================"));
 }
@@ -231,6 +921,7 @@ void UCarlaSettings::LogSettings() const
 #undef S_CARLA_SERVER
 #undef S_CARLA_LEVELSETTINGS
 #undef S_CARLA_SCENECAPTURE
+#undef S_CARLA_LIDAR
 
 void UCarlaSettings::GetActiveWeatherDescription(
     bool &bWeatherWasChanged,
@@ -252,20 +943,15 @@ const FWeatherDescription &UCarlaSettings::GetWeatherDescriptionByIndex(int32 In
   return WeatherDescriptions[Index];
 }
 
-void UCarlaSettings::ResetCameraDescriptions()
-{
-  CameraDescriptions.Empty();
-  bSemanticSegmentationEnabled = false;
-}
-
 void UCarlaSettings::LoadSettingsFromFile(const FString &FilePath, const bool bLogOnFailure)
 {
   if (FPaths::FileExists(FilePath)) {
     UE_LOG(LogCarla, Log, TEXT("Loading CARLA settings from \"%s\""), *FilePath);
-    ResetCameraDescriptions();
     const MyIniFile ConfigFile(FilePath);
+    FCompiledCarlaSettings Compiled;
     constexpr bool bLoadCarlaServerSection = true;
-    LoadSettingsFromConfig(ConfigFile, *this, bLoadCarlaServerSection);
+    CompileSettings(ConfigFile, Compiled, bLoadCarlaServerSection);
+    Compiled.Apply(*this);
     CurrentFileName = FilePath;
   } else if (bLogOnFailure) {
     UE_LOG(LogCarla, Error, TEXT("Unable to find settings file \"%s\""), *FilePath);
@@ -6,7 +6,9 @@
 
 #pragma once
 
+#include "AgentsEncoding.h"
 #include "CameraDescription.h"
+#include "LidarDescription.h"
 #include "WeatherDescription.h"
 
 #include "UObject/NoExportTypes.h"
@@ -56,8 +58,6 @@ private:
 
   void LoadSettingsFromFile(const FString &FilePath, bool bLogOnFailure);
 
-  void ResetCameraDescriptions();
-
   /** File name of the settings file used to load this settings. Empty if none used. */
   UPROPERTY(Category = "CARLA Settings|Debug", VisibleAnywhere)
   FString CurrentFileName;
@@ -80,16 +80,411 @@ public:
   UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
   uint32 ServerTimeOut = 10000u;
 
+  /** Disable Nagle's algorithm (TCP_NODELAY) on every socket, avoids the
+    * delayed-ACK stalls of the small control messages.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bTCPNoDelay = true;
+
+  /** Allow binding the ports right after a restart (SO_REUSEADDR). */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bTCPReuseAddress = true;
+
+  /** Size in bytes of the send buffer of the measurements socket, zero for the
+    * default of the system.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  uint32 MeasurementsSendBufferSize = 0u;
+
+  /** Size in bytes of the receive buffer of the control socket, zero for the
+    * default of the system.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  uint32 ControlReceiveBufferSize = 0u;
+
+  /** Time-out in milliseconds of the reads from a client that sends
+    * heartbeats, so a client gone without closing its connections is
+    * noticed early. Zero to wait the server time-out instead.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  uint32 LivenessTimeOut = 0u;
+
+  /** CPUs the I/O threads of the server may run on, as a list like
+    * "0-3,8". Any CPU if empty.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  FString ServerThreadCPUs;
+
+  /** Nice value of the I/O threads of the server, from -20 (highest) to 19.
+    * Only on Linux, negative values need privileges.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  int32 ServerThreadPriority = 0;
+
+  /** CPUs the game thread may run on, same format as ServerThreadCPUs. */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  FString GameThreadCPUs;
+
+  /** CPUs the rendering thread may run on, same format as ServerThreadCPUs. */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  FString RenderThreadCPUs;
+
+  /** Back the image and agent buffers with huge pages, falls back to regular
+    * pages if none are available.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  bool bHugePageBuffers = false;
+
+  /** Place the image and agent buffers in the NUMA node of the game thread. */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  bool bNUMALocalBuffers = false;
+
+  /** Activate every weather preset for a few frames when the first level is
+    * loaded, before the first episode starts, so no weather change needs to
+    * compile shaders later on.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  bool bPreWarmWeatherPresets = false;
+
+  /** Render the first level once with a camera of each post-process effect
+    * before accepting the client, so the first episode does not wait for
+    * their shaders to compile. The time spent is logged.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  bool bPreWarmShaders = false;
+
+  /** Render targets of the cameras kept when the level is reloaded, for the
+    * cameras of the next level with the same size and format to reuse
+    * instead of allocating them again. Zero disables it.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  uint32 CameraRenderTargetPoolSize = 8u;
+
+  /** Size in MB of the texture streaming pool, zero for the engine default.
+    * Instances sharing a GPU should split its memory between them, otherwise
+    * each one fills the memory with its textures and evicts the others'.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  uint32 TextureStreamingPoolSizeMB = 0u;
+
+  /** Memory in MB the pool of render targets of the captures keeps allocated
+    * between frames, zero for the engine default. Above it, the render
+    * targets not used in the frame are released.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  uint32 RenderTargetPoolSizeMB = 0u;
+
+  /** Mip levels dropped from every streamed texture, e.g. 1 for a quarter of
+    * the texture memory.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  float TextureMipBias = 0.0f;
+
+  /** Publish the measurements stream to any number of read-only subscribers
+    * connected to WorldPort + 3, e.g. recorders or visualizers.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bPublishMeasurements = false;
+
+  /** Frames queued for each subscriber, a subscriber falling behind drops its
+    * oldest frames.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bPublishMeasurements))
+  uint32 PublisherMaxQueuedFrames = 2u;
+
+  /** Record the measurements stream in the server host into
+    * RecordingDirectory, as segment files with an index of frame offsets.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bRecordStream = false;
+
+  /** Directory of the recordings, "Saved/StreamRecordings" of the project if
+    * empty.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bRecordStream))
+  FString RecordingDirectory;
+
+  /** Maximum size in megabytes of each segment file of a recording. */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bRecordStream))
+  uint32 RecordingSegmentSizeMB = 1024u;
+
+  /** Serve the metrics of the server in Prometheus text format through HTTP
+    * at WorldPort + 4.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bEnableMetricsServer = false;
+
+  /** If the client disconnects, keep the level loaded and wait for a client
+    * to connect again at the same ports instead of reloading the level. The
+    * client that connects may resume the current episode, see bResumeEpisode,
+    * or request a new one.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bReconnectWithoutRestart = false;
+
+  /** Pause the world while waiting for the client to reconnect, otherwise it
+    * keeps running with the last control received.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bReconnectWithoutRestart))
+  bool bPauseWhileDisconnected = true;
+
+  /** Load the level with these settings, pre-warm the shaders and fill the
+    * spawner pools while waiting for the first client, instead of after it
+    * sends its settings. Once they arrive only what differs is applied, the
+    * level is reloaded only if the player or its sensors change.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bLoadLevelBeforeClient = false;
+
+  /** Maps kept loaded as streamed sub-levels, comma-separated, only the one
+    * requested by the client (see MapName) visible and simulated. Switching
+    * to a resident map resets the episode in place instead of loading the
+    * map. The level the simulator is launched with stays visible, so it
+    * should hold none of them.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  FString ResidentMaps;
+
+  /** Memory in MB the resident maps may take, estimated by the size of their
+    * packages on disk, zero for no limit. The maps that do not fit are loaded
+    * from scratch when requested.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  uint32 ResidentMapsMemoryBudgetMB = 0u;
+
   /** In synchronous mode, CARLA waits every tick until the control from the
     * client is received.
     */
   UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
   bool bSynchronousMode = true;
 
+  /** In pipelined synchronous mode, the control answering the measurements of
+    * a frame drives the frame after the next one, so the simulation of each
+    * frame overlaps with the client computing the next control. Every control
+    * is applied with exactly one frame of latency, so episodes are still
+    * reproducible.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSynchronousMode))
+  bool bPipelinedSynchronousMode = false;
+
+  /** Times the game thread polls for the control before blocking, first
+    * pausing the CPU between checks and then yielding. Saves the scheduler
+    * wake-up time on every frame in synchronous mode, but keeps a core busy
+    * while waiting.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSynchronousMode))
+  uint32 ControlSpinCount = 0u;
+
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSynchronousMode))
+  uint32 ControlYieldCount = 0u;
+
+  /** If greater than zero, the simulation advances this fixed number of
+    * seconds every frame regardless of the wall-clock time elapsed, making
+    * results reproducible. If zero, a variable time-step is used.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  float FixedDeltaSeconds = 0.0f;
+
+  /** In asynchronous mode, if greater than zero, tick the game at this steady
+    * rate instead of as fast as possible. Each frame sleeps until shortly
+    * before its deadline and spins the last FramePacingSpinMilliseconds, so
+    * the interval between frames barely deviates from the target without a
+    * core busy meanwhile. See FFramePacer.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  float TargetFramesPerSecond = 0.0f;
+
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  float FramePacingSpinMilliseconds = 1.0f;
+
+  /** Maximum number of physics steps each frame is split into, so the
+    * vehicle dynamics keep the accuracy of MaxPhysicsSubstepDeltaSeconds
+    * steps whatever the frame rate. Zero or one to simulate each frame in a
+    * single step.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  uint32 PhysicsSubsteps = 6u;
+
+  /** Maximum length in seconds of each physics substep. */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  float MaxPhysicsSubstepDeltaSeconds = 1.0f / 60.0f;
+
+  /** Simulate the physics bodies that are not vehicles (props, ragdolls...)
+    * in a second physics scene, whose simulation overlaps with the next
+    * frame of the game thread. The vehicles stay in the main scene, the only
+    * one PhysX vehicles support. Takes effect on the levels loaded after the
+    * settings, only read from the settings file.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  bool bAsyncPhysicsScene = false;
+
+  /** Switch the bodies of the non-player vehicles to kinematic while they
+    * stand still with the brake pressed, e.g. at a red light, so the physics
+    * scene skips their wheels and suspension. They simulate again on the
+    * first throttle or on a contact.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  bool bRestStoppedVehicles = true;
+
+  /** Do not render the frames whose measurements and images are not going
+    * to be sent to the client.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bSkipUnusedFrameRendering = false;
+
+  /** Do not render the world in the main viewport nor draw the HUD, only the
+    * scene capture cameras render. For machines without a display.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere)
+  bool bHeadlessRendering = false;
+
   /** Send info about every non-player agent in the scene every frame. */
   UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
   bool bSendNonPlayerAgentsInfo = false;
 
+  /** Send the non-player agents packed as a structure of arrays, much cheaper
+    * to encode and decode than one message per agent.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bPackNonPlayerAgentsInfo = false;
+
+  /** Encoding of the packed non-player agents, for the clients that support
+    * it. The quantized and half-precision encodings are lossy but take
+    * between a half and a third of the bytes.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bPackNonPlayerAgentsInfo))
+  EAgentsEncoding PackedAgentsEncoding = EAgentsEncoding::Float32;
+
+  /** Send only the non-player agents that changed since they were last sent,
+    * plus the ones removed. Every agent is sent on the episode start.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bSendNonPlayerAgentsDelta = false;
+
+  /** Minimum change of any component of an agent's state for it to be sent
+    * again in delta mode.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSendNonPlayerAgentsDelta))
+  float NonPlayerAgentsDeltaThreshold = 1.0f;
+
+  /** Compute the off-road and opposite lane intersection of the non-player
+    * vehicles sent, as done for the player.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSendNonPlayerAgentsInfo))
+  bool bSendNonPlayerAgentsRoadIntersection = false;
+
+  /** Send only the non-player agents within this radius (in centimeters) of
+    * the player. If zero or negative, the radius is not limited.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSendNonPlayerAgentsInfo))
+  float NonPlayerAgentsRadius = 0.0f;
+
+  /** Send at most this number of non-player agents, the nearest to the player.
+    * If zero, the number is not limited.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSendNonPlayerAgentsInfo))
+  uint32 MaxNumberOfNonPlayerAgents = 0u;
+
+  /** Types of non-player agents to send, bit mask of FAgentGrid::GetTypeBit
+    * values.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSendNonPlayerAgentsInfo))
+  uint8 NonPlayerAgentsTypeMask = 0xFFu;
+
+  /** Write the images into a shared memory segment instead of sending them
+    * through the socket, for clients running in the same machine. The name
+    * of the segment is sent in the scene description.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bUseSharedMemoryImages = false;
+
+  /** Keep the measurements and control connections open across episodes, the
+    * client must support it (see EpisodeReady in carla_server.proto).
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bPersistentAgentConnections = false;
+
+  /** Send the images through a connection of their own at WorldPort + 67, so
+    * a slow image send does not delay the measurements. The client must
+    * support it (see EpisodeReady in carla_server.proto).
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bSeparateImagesStream = false;
+
+  /** Frames of images queued for the images stream, at least 2. */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSeparateImagesStream))
+  uint32 ImagesStreamBufferSize = 2u;
+
+  /** Whether the images stream drops the oldest frame when the client falls
+    * behind, otherwise the game thread waits for a free slot.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSeparateImagesStream))
+  bool bImagesStreamDropOldest = true;
+
+  /** Start new episodes without reloading the level whenever the player
+    * vehicle and the cameras do not change. The non-player agents are
+    * spawned again and the weather is re-applied instead.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bSoftEpisodeReset = false;
+
+  /** On soft episode resets, reconfigure only what changed from the current
+    * episode. The weather and the time step are applied only if they change,
+    * and the non-player agents are spawned again only if their number, seeds
+    * or spawn budget change, otherwise they go on where they are.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bSoftEpisodeReset))
+  bool bDeltaEpisodeReset = false;
+
+  /** A client reconnecting, see bReconnectWithoutRestart, continues the
+    * current episode where it was instead of starting a new one, provided it
+    * requests the same player, sensors, weather, time step and non-player
+    * agents. The player start it chooses is ignored.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bResumeEpisode = false;
+
+  /** Send with the measurements the time spent on each stage of the frame,
+    * game tick, AI, image readback, frame pacing, and the server's encode,
+    * queue and send.
+    */
+  UPROPERTY(Category = "CARLA Server", VisibleAnywhere, meta = (EditCondition = bUseNetworking))
+  bool bSendFrameTiming = false;
+
+  /// @}
+  // ===========================================================================
+  /// @name Batch
+  // ===========================================================================
+  /// @{
+public:
+
+  /** Job INI given with -carla-batch=, empty if not running a batch job. The
+    * job runs its episodes without any client, driving the player with the
+    * autopilot and recording every frame into RecordingDirectory.
+    */
+  UPROPERTY(Category = "Batch", VisibleAnywhere)
+  FString BatchJobFile;
+
+  /** Number of episodes of the batch job, the level is reloaded for each. */
+  UPROPERTY(Category = "Batch", VisibleAnywhere)
+  uint32 BatchNumberOfEpisodes = 1u;
+
+  /** Frames recorded in each episode of the batch job. */
+  UPROPERTY(Category = "Batch", VisibleAnywhere)
+  uint32 BatchFramesPerEpisode = 1000u;
+
+  /** Frames simulated but not recorded at the start of each episode, while
+    * the vehicles start moving.
+    */
+  UPROPERTY(Category = "Batch", VisibleAnywhere)
+  uint32 BatchWarmUpFrames = 0u;
+
+  /** Weather ids of the episodes, used in turn, like "1,3,7". Every weather
+    * of the map in turn if empty.
+    */
+  UPROPERTY(Category = "Batch", VisibleAnywhere)
+  FString BatchWeathers;
+
   /// @}
   // ===========================================================================
   /// @name Level Settings
@@ -97,6 +492,12 @@ public:
   /// @{
 public:
 
+  /** Name of the map of the episode, empty to keep the current one. See
+    * ResidentMaps.
+    */
+  UPROPERTY(Category = "Level Settings", VisibleAnywhere)
+  FString MapName;
+
   /** Path to the pawn class of the player. */
   UPROPERTY(Category = "Level Settings", VisibleAnywhere)
   FString PlayerVehicle;
@@ -125,6 +526,46 @@ public:
   UPROPERTY(Category = "Level Settings", VisibleAnywhere)
   int32 SeedVehicles = 123456789;
 
+  /** Maximum number of spawn attempts of non-player agents per frame when
+    * populating the level, zero for no limit. The episode ready is not sent
+    * until every agent has been spawned.
+    */
+  UPROPERTY(Category = "Level Settings", VisibleAnywhere)
+  uint32 MaxSpawnsPerFrame = 0u;
+
+  /** Distance in centimeters around the player and its cameras beyond which
+    * the static meshes of the level are removed from the scene, zero to keep
+    * everything. See ACityMapMeshHolder::StreamingCellSize.
+    */
+  UPROPERTY(Category = "Level Settings", VisibleAnywhere)
+  float StreamingRadius = 0.0f;
+
+  /** Whether the static meshes streamed out lose their collision too. Saves
+    * the physics cost of the whole map, but the vehicles and pedestrians away
+    * from the player have nothing to stand on.
+    */
+  UPROPERTY(Category = "Level Settings", VisibleAnywhere)
+  bool bStreamCollision = false;
+
+  /** Maximum number of pedestrians simulated by the crowd manager, the
+    * nearest to the player. The rest follow their path without avoiding the
+    * others.
+    */
+  UPROPERTY(Category = "Level Settings", VisibleAnywhere)
+  uint32 MaxCrowdPedestrians = 50u;
+
+  /** Range in centimeters in which the pedestrians of the crowd look for
+    * neighbours to avoid, halved beyond CrowdHighQualityDistance.
+    */
+  UPROPERTY(Category = "Level Settings", VisibleAnywhere)
+  float CrowdQueryRange = 400.0f;
+
+  /** Distance in centimeters to the player up to which the pedestrians of the
+    * crowd avoid the others with high quality.
+    */
+  UPROPERTY(Category = "Level Settings", VisibleAnywhere)
+  float CrowdHighQualityDistance = 3000.0f;
+
   /// @}
   // ===========================================================================
   /// @name Scene Capture
@@ -143,5 +584,30 @@ public:
   UPROPERTY(Category = "Scene Capture", VisibleAnywhere)
   bool bSemanticSegmentationEnabled = false;
 
+  /** Read back the images of every camera with synchronous readback in a
+    * single transfer, copying them first into tiles of one atlas texture.
+    */
+  UPROPERTY(Category = "Scene Capture", VisibleAnywhere)
+  bool bUseCameraAtlas = false;
+
+  /** GPU time in milliseconds the frames should take, zero to disable. When
+    * over budget, the cameras are rendered at lower screen percentages down to
+    * their MinScreenPercentage, and then the optional cameras stop capturing,
+    * until the frames fit the budget again.
+    */
+  UPROPERTY(Category = "Scene Capture", VisibleAnywhere)
+  float FrameBudgetMs = 0.0f;
+
+  /// @}
+  // ===========================================================================
+  /// @name LiDAR
+  // ===========================================================================
+  /// @{
+public:
+
+  /** Descriptions of the LiDARs to be attached to the player. */
+  UPROPERTY(Category = "LiDAR", VisibleAnywhere)
+  TMap<FString, FLidarDescription> LidarDescriptions;
+
   /// @}
 };
@@ -0,0 +1,67 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "ImageEncoding.h"
+#include "Package.h"
+
+FString ImageEncoding::ToString(EImageEncoding ImageEncoding)
+{
+  const UEnum* ptr = FindObject<UEnum>(ANY_PACKAGE, TEXT("EImageEncoding"), true);
+  if(!ptr)
+    return FString("Invalid");
+  return ptr->GetNameStringByIndex(static_cast<int32>(ImageEncoding));
+}
+
+uint32 ImageEncoding::GetBytesPerPixel(EImageEncoding ImageEncoding)
+{
+  switch (ImageEncoding) {
+    case EImageEncoding::Float32: return 4u;
+    case EImageEncoding::PointsXYZL: return 16u;
+    case EImageEncoding::MotionVectors: return 4u;
+    case EImageEncoding::Float16: return 2u;
+    case EImageEncoding::Gray8:   return 1u;
+    default:                      return 4u;
+  }
+}
+
+EPixelFormat ImageEncoding::GetPixelFormat(EImageEncoding ImageEncoding)
+{
+  switch (ImageEncoding) {
+    case EImageEncoding::Float32: return PF_R32_FLOAT;
+    // Captured as depth, unprojected to points when read back.
+    case EImageEncoding::PointsXYZL: return PF_R32_FLOAT;
+    // Captured as depth, reprojected with the motion of the camera.
+    case EImageEncoding::MotionVectors: return PF_R32_FLOAT;
+    case EImageEncoding::Float16: return PF_R16F;
+    case EImageEncoding::Gray8:   return PF_G8;
+    default:                      return PF_B8G8R8A8;
+  }
+}
+
+FString ImageCompression::ToString(EImageCompression ImageCompression)
+{
+  const UEnum* ptr = FindObject<UEnum>(ANY_PACKAGE, TEXT("EImageCompression"), true);
+  if(!ptr)
+    return FString("Invalid");
+  return ptr->GetNameStringByIndex(static_cast<int32>(ImageCompression));
+}
+
+FString ImageResizeFilter::ToString(EImageResizeFilter ImageResizeFilter)
+{
+  const UEnum* ptr = FindObject<UEnum>(ANY_PACKAGE, TEXT("EImageResizeFilter"), true);
+  if(!ptr)
+    return FString("Invalid");
+  return ptr->GetNameStringByIndex(static_cast<int32>(ImageResizeFilter));
+}
+
+FString ImageProjection::ToString(EImageProjection ImageProjection)
+{
+  const UEnum* ptr = FindObject<UEnum>(ANY_PACKAGE, TEXT("EImageProjection"), true);
+  if(!ptr)
+    return FString("Invalid");
+  return ptr->GetNameStringByIndex(static_cast<int32>(ImageProjection));
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "ImageEncoding.generated.h"
+
+/// Encoding of the pixels of the images sent to the client, same values as
+/// CARLA_SERVER_IMAGE_*.
+UENUM(BlueprintType)
+enum class EImageEncoding : uint8
+{
+  BGRA8                 UMETA(DisplayName = "8-bit BGRA"),
+  Float32               UMETA(DisplayName = "32-bit float, depth only"),
+  Float16               UMETA(DisplayName = "16-bit float, depth only"),
+  Gray8                 UMETA(DisplayName = "8-bit single channel, semantic segmentation only"),
+  BGR8                  UMETA(DisplayName = "8-bit BGR, alpha dropped by the server"),
+  PointsXYZL            UMETA(DisplayName = "Point cloud, 32-bit float x, y, z and label, LiDAR and depth only"),
+  GPUShared             UMETA(Hidden),
+  MotionVectors         UMETA(DisplayName = "Screen-space motion, 16-bit float x and y, depth only"),
+
+  SIZE                  UMETA(Hidden),
+  INVALID               UMETA(Hidden),
+};
+
+/// Compression applied to the images in the networking threads of the server,
+/// same values as CARLA_SERVER_IMAGE_COMPRESSION_*.
+UENUM(BlueprintType)
+enum class EImageCompression : uint8
+{
+  None                  UMETA(DisplayName = "None"),
+  LZ4                   UMETA(DisplayName = "LZ4, lossless"),
+  Delta                 UMETA(DisplayName = "Delta of the previous image, lossless"),
+
+  SIZE                  UMETA(Hidden),
+  INVALID               UMETA(Hidden),
+};
+
+/// Filter used to scale the region of interest of a camera to the size of the
+/// image sent.
+UENUM(BlueprintType)
+enum class EImageResizeFilter : uint8
+{
+  Box                   UMETA(DisplayName = "Box, average of the pixels covered"),
+  Bilinear              UMETA(DisplayName = "Bilinear"),
+
+  SIZE                  UMETA(Hidden),
+  INVALID               UMETA(Hidden),
+};
+
+/// Projection of the image captured by a camera. The panoramic ones render a
+/// cube around the camera and remap it to the image size, 360 degrees across.
+UENUM(BlueprintType)
+enum class EImageProjection : uint8
+{
+  Perspective           UMETA(DisplayName = "Perspective"),
+  Equirectangular       UMETA(DisplayName = "Equirectangular, 180 degrees from top to bottom"),
+  Cylindrical           UMETA(DisplayName = "Cylindrical, vertical field of view of the camera"),
+
+  SIZE                  UMETA(Hidden),
+  INVALID               UMETA(Hidden),
+};
+
+/// Helper class for working with EImageEncoding.
+class CARLA_API ImageEncoding {
+public:
+
+  using uint_type = typename std::underlying_type<EImageEncoding>::type;
+
+  static FString ToString(EImageEncoding ImageEncoding);
+
+  static constexpr uint_type ToUInt(EImageEncoding ImageEncoding)
+  {
+    return static_cast<uint_type>(ImageEncoding);
+  }
+
+  /// Bytes per pixel of the image read back, BGR8 images are read as BGRA8.
+  static uint32 GetBytesPerPixel(EImageEncoding ImageEncoding);
+
+  /// Whether the image is read back as 8-bit BGRA.
+  static bool IsReadAsBGRA8(EImageEncoding ImageEncoding)
+  {
+    return (ImageEncoding == EImageEncoding::BGRA8) || (ImageEncoding == EImageEncoding::BGR8);
+  }
+
+  static EPixelFormat GetPixelFormat(EImageEncoding ImageEncoding);
+};
+
+/// Helper class for working with EImageCompression.
+class CARLA_API ImageCompression {
+public:
+
+  using uint_type = typename std::underlying_type<EImageCompression>::type;
+
+  static FString ToString(EImageCompression ImageCompression);
+
+  static constexpr uint_type ToUInt(EImageCompression ImageCompression)
+  {
+    return static_cast<uint_type>(ImageCompression);
+  }
+};
+
+/// Helper class for working with EImageResizeFilter.
+class CARLA_API ImageResizeFilter {
+public:
+
+  static FString ToString(EImageResizeFilter ImageResizeFilter);
+};
+
+/// Helper class for working with EImageProjection.
+class CARLA_API ImageProjection {
+public:
+
+  static FString ToString(EImageProjection ImageProjection);
+};
@@ -0,0 +1,52 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "LidarDescription.generated.h"
+
+USTRUCT()
+struct FLidarDescription
+{
+  GENERATED_USTRUCT_BODY()
+
+  /** Number of lasers, evenly spread between the lower and upper field of
+    * view limits.
+    */
+  UPROPERTY(Category = "LiDAR Description", EditDefaultsOnly, meta=(ClampMin = "1", ClampMax = "128"))
+  uint32 Channels = 32u;
+
+  /** Measure distance in centimeters, hits farther away are dropped. */
+  UPROPERTY(Category = "LiDAR Description", EditDefaultsOnly, meta=(ClampMin = "1.0"))
+  float Range = 5000.0f;
+
+  /** Points generated by all the lasers per second. */
+  UPROPERTY(Category = "LiDAR Description", EditDefaultsOnly, meta=(ClampMin = "1"))
+  uint32 PointsPerSecond = 56000u;
+
+  /** LiDAR rotation frequency in Hz. Each frame only the slice swept since
+    * the previous one is traced, so the cost per frame does not depend on the
+    * frame rate.
+    */
+  UPROPERTY(Category = "LiDAR Description", EditDefaultsOnly, meta=(ClampMin = "0.01"))
+  float RotationFrequency = 10.0f;
+
+  /** Angle in degrees of the upper laser. */
+  UPROPERTY(Category = "LiDAR Description", EditDefaultsOnly)
+  float UpperFovLimit = 10.0f;
+
+  /** Angle in degrees of the lower laser. */
+  UPROPERTY(Category = "LiDAR Description", EditDefaultsOnly)
+  float LowerFovLimit = -30.0f;
+
+  /** Position relative to the player. */
+  UPROPERTY(Category = "LiDAR Description", EditDefaultsOnly)
+  FVector Position = {0.0f, 0.0f, 250.0f};
+
+  /** Rotation relative to the player. */
+  UPROPERTY(Category = "LiDAR Description", EditDefaultsOnly)
+  FRotator Rotation = {0.0f, 0.0f, 0.0f};
+};
@@ -0,0 +1,154 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "SharedRenderTarget.h"
+
+#include "DynamicRHI.h"
+#include "RHICommandList.h"
+#include "TextureResource.h"
+
+#if PLATFORM_WINDOWS
+#  include "AllowWindowsPlatformTypes.h"
+#  include <d3d11.h>
+#  include "HideWindowsPlatformTypes.h"
+#endif // PLATFORM_WINDOWS
+
+DECLARE_CYCLE_STAT(TEXT("Copy Shared Render Target"), STAT_CarlaCopySharedRenderTarget, STATGROUP_Carla);
+
+/// Time the render thread waits for the client to release a slot before
+/// skipping the frame.
+static constexpr uint32 ACQUIRE_TIMEOUT_MS = 2u;
+
+bool FSharedRenderTarget::IsSupported()
+{
+#if PLATFORM_WINDOWS
+  return (GDynamicRHI != nullptr) && (FCString::Strcmp(GDynamicRHI->GetName(), TEXT("D3D11")) == 0);
+#else
+  return false;
+#endif // PLATFORM_WINDOWS
+}
+
+FSharedRenderTarget::FSharedRenderTarget(const uint32 NumberOfSlots)
+{
+  Slots.SetNum(FMath::Max(NumberOfSlots, 1u));
+}
+
+FSharedRenderTarget::~FSharedRenderTarget()
+{
+  check(IsInRenderingThread());
+#if PLATFORM_WINDOWS
+  for (auto &Slot : Slots) {
+    if (Slot.KeyedMutex != nullptr) {
+      static_cast<IDXGIKeyedMutex *>(Slot.KeyedMutex)->Release();
+    }
+    if (Slot.Texture != nullptr) {
+      static_cast<ID3D11Texture2D *>(Slot.Texture)->Release();
+    }
+  }
+#endif // PLATFORM_WINDOWS
+}
+
+bool FSharedRenderTarget::Initialize_RenderThread(FTextureRenderTargetResource *Source)
+{
+  check(IsInRenderingThread());
+#if PLATFORM_WINDOWS
+  if (!IsSupported() || (Source == nullptr) || !Source->GetRenderTargetTexture().IsValid()) {
+    return false;
+  }
+  auto *Device = static_cast<ID3D11Device *>(RHIGetNativeDevice());
+  auto *SourceTexture = static_cast<ID3D11Texture2D *>(Source->GetRenderTargetTexture()->GetNativeResource());
+  if ((Device == nullptr) || (SourceTexture == nullptr)) {
+    return false;
+  }
+  D3D11_TEXTURE2D_DESC Desc;
+  SourceTexture->GetDesc(&Desc);
+  Desc.MipLevels = 1u;
+  Desc.ArraySize = 1u;
+  Desc.SampleDesc.Count = 1u;
+  Desc.SampleDesc.Quality = 0u;
+  Desc.Usage = D3D11_USAGE_DEFAULT;
+  Desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+  Desc.CPUAccessFlags = 0u;
+  Desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX;
+  Width = Desc.Width;
+  Height = Desc.Height;
+  Format = Desc.Format;
+  for (auto &Slot : Slots) {
+    ID3D11Texture2D *Texture = nullptr;
+    if (FAILED(Device->CreateTexture2D(&Desc, nullptr, &Texture))) {
+      UE_LOG(LogCarla, Error, TEXT("SharedRenderTarget: Failed to create texture"));
+      return false;
+    }
+    Slot.Texture = Texture;
+    IDXGIKeyedMutex *KeyedMutex = nullptr;
+    IDXGIResource *Resource = nullptr;
+    HANDLE Handle = nullptr;
+    const bool bSuccess =
+        SUCCEEDED(Texture->QueryInterface(__uuidof(IDXGIKeyedMutex), reinterpret_cast<void **>(&KeyedMutex))) &&
+        SUCCEEDED(Texture->QueryInterface(__uuidof(IDXGIResource), reinterpret_cast<void **>(&Resource))) &&
+        SUCCEEDED(Resource->GetSharedHandle(&Handle));
+    if (Resource != nullptr) {
+      Resource->Release();
+    }
+    Slot.KeyedMutex = KeyedMutex;
+    if (!bSuccess) {
+      UE_LOG(LogCarla, Error, TEXT("SharedRenderTarget: Failed to share texture"));
+      return false;
+    }
+    Slot.Handle = reinterpret_cast<uint64>(Handle);
+  }
+  return true;
+#else
+  return false;
+#endif // PLATFORM_WINDOWS
+}
+
+FSharedRenderTargetFrame FSharedRenderTarget::GetNextFrame()
+{
+  FSharedRenderTargetFrame Frame;
+  Frame.Slot = NextSlot;
+  Frame.Handle = Slots[NextSlot].Handle;
+  Frame.Width = Width;
+  Frame.Height = Height;
+  Frame.Format = Format;
+  NextSlot = (NextSlot + 1u) % Slots.Num();
+  return Frame;
+}
+
+void FSharedRenderTarget::Copy_RenderThread(
+    FRHICommandListImmediate &RHICmdList,
+    FTextureRenderTargetResource *Source,
+    const uint32 SlotIndex)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaCopySharedRenderTarget);
+  check(IsInRenderingThread());
+#if PLATFORM_WINDOWS
+  check(SlotIndex < static_cast<uint32>(Slots.Num()));
+  auto &Slot = Slots[SlotIndex];
+  if ((Slot.Texture == nullptr) || (Source == nullptr)) {
+    return;
+  }
+  // The immediate context is used below behind the back of the RHI.
+  RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
+  auto *KeyedMutex = static_cast<IDXGIKeyedMutex *>(Slot.KeyedMutex);
+  // A frame the client never read is taken back, otherwise wait for the
+  // client to release it.
+  if ((KeyedMutex->AcquireSync(1u, 0u) != S_OK) &&
+      (KeyedMutex->AcquireSync(0u, ACQUIRE_TIMEOUT_MS) != S_OK)) {
+    UE_LOG(LogCarla, Warning, TEXT("SharedRenderTarget: Slot %d still in use by the client, frame skipped"), SlotIndex);
+    return;
+  }
+  auto *Device = static_cast<ID3D11Device *>(RHIGetNativeDevice());
+  ID3D11DeviceContext *Context = nullptr;
+  Device->GetImmediateContext(&Context);
+  Context->CopyResource(
+      static_cast<ID3D11Texture2D *>(Slot.Texture),
+      static_cast<ID3D11Texture2D *>(Source->GetRenderTargetTexture()->GetNativeResource()));
+  Context->Release();
+  KeyedMutex->ReleaseSync(1u);
+#endif // PLATFORM_WINDOWS
+}
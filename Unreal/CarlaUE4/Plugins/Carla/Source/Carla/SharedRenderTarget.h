@@ -0,0 +1,87 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+class FRHICommandListImmediate;
+class FTextureRenderTargetResource;
+
+/// What a client in the same host needs to open the texture a frame was
+/// copied into, see carla_gpu_shared_image.
+struct FSharedRenderTargetFrame
+{
+  uint64 Handle = 0u;
+
+  uint32 Width = 0u;
+
+  uint32 Height = 0u;
+
+  /// Native pixel format (DXGI_FORMAT).
+  uint32 Format = 0u;
+
+  uint32 Slot = 0u;
+};
+
+/// Ring of textures shared with other processes of the same host, the render
+/// target of a scene capture is copied into the next slot every frame instead
+/// of being read back to the CPU.
+///
+/// Only supported with the D3D11 RHI. Each slot is guarded by a keyed mutex,
+/// the render thread acquires it with key 0 and releases it with key 1 once
+/// the copy is done, the client acquires key 1 and releases key 0 when done
+/// reading. So the client never reads a slot being written, and a slow client
+/// makes the render thread skip its frame instead of stalling.
+class FSharedRenderTarget
+{
+public:
+
+  /// Whether the RHI in use can share textures.
+  static bool IsSupported();
+
+  explicit FSharedRenderTarget(uint32 NumberOfSlots);
+
+  FSharedRenderTarget(const FSharedRenderTarget &) = delete;
+
+  FSharedRenderTarget &operator=(const FSharedRenderTarget &) = delete;
+
+  /// Has to be destroyed in the render thread.
+  ~FSharedRenderTarget();
+
+  /// Create the textures, same size and format as @a Source.
+  bool Initialize_RenderThread(FTextureRenderTargetResource *Source);
+
+  /// Select the slot the next frame is copied into. Game thread only, after
+  /// the textures are initialized.
+  FSharedRenderTargetFrame GetNextFrame();
+
+  void Copy_RenderThread(
+      FRHICommandListImmediate &RHICmdList,
+      FTextureRenderTargetResource *Source,
+      uint32 Slot);
+
+private:
+
+  struct FSlot
+  {
+    /// ID3D11Texture2D.
+    void *Texture = nullptr;
+
+    /// IDXGIKeyedMutex.
+    void *KeyedMutex = nullptr;
+
+    uint64 Handle = 0u;
+  };
+
+  TArray<FSlot, TInlineAllocator<4u>> Slots;
+
+  uint32 Width = 0u;
+
+  uint32 Height = 0u;
+
+  uint32 Format = 0u;
+
+  uint32 NextSlot = 0u;
+};
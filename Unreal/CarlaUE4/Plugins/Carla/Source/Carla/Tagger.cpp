@@ -6,6 +6,7 @@
 
 #include "Carla.h"
 #include "Tagger.h"
+#include "Async/ParallelFor.h"
 #include "EngineUtils.h"
 #include "Engine/StaticMesh.h"
 #include "Engine/SkeletalMesh.h"
@@ -13,6 +14,8 @@
 #include "Components/SkeletalMeshComponent.h"
 #include "PhysicsEngine/PhysicsAsset.h"
 
+DECLARE_CYCLE_STAT(TEXT("Tag Actors In Level"), STAT_CarlaTagActorsInLevel, STATGROUP_Carla);
+
 #ifdef CARLA_TAGGER_EXTRA_LOG
 static FString GetLabelAsString(const ECityObjectLabel Label)
 {
@@ -59,15 +62,25 @@ static ECityObjectLabel GetLabelByFolderName(const FString &String) {
   else                                  return ECityObjectLabel::None;
 }
 
-template <typename T>
-static ECityObjectLabel GetLabelByPath(const T *Object)
+static ECityObjectLabel GetLabelByPath(const UObject *Object)
 {
+  if (Object == nullptr) {
+    return ECityObjectLabel::None;
+  }
   const FString Path = Object->GetPathName();
   TArray<FString> StringArray;
   Path.ParseIntoArray(StringArray, TEXT("/"), false);
   return (StringArray.Num() > 3 ? GetLabelByFolderName(StringArray[3]) : ECityObjectLabel::None);
 }
 
+static ECityObjectLabel GetLabelByPath(
+    const UObject *Object,
+    ATagger::FLabelCache &LabelCache)
+{
+  const ECityObjectLabel *Label = LabelCache.Find(Object);
+  return (Label != nullptr ? *Label : LabelCache.Add(Object, GetLabelByPath(Object)));
+}
+
 static void SetStencilValue(
     UPrimitiveComponent &Component,
     const ECityObjectLabel &Label,
@@ -83,6 +96,15 @@ static void SetStencilValue(
 // =============================================================================
 
 void ATagger::TagActor(const AActor &Actor, bool bTagForSemanticSegmentation)
+{
+  FLabelCache LabelCache;
+  TagActor(Actor, bTagForSemanticSegmentation, LabelCache);
+}
+
+void ATagger::TagActor(
+    const AActor &Actor,
+    const bool bTagForSemanticSegmentation,
+    FLabelCache &LabelCache)
 {
 #ifdef CARLA_TAGGER_EXTRA_LOG
   UE_LOG(LogCarla, Log, TEXT("Actor: %s"), *Actor.GetName());
@@ -92,7 +114,7 @@ void ATagger::TagActor(const AActor &Actor, bool bTagForSemanticSegmentation)
   TArray<UStaticMeshComponent *> StaticMeshComponents;
   Actor.GetComponents<UStaticMeshComponent>(StaticMeshComponents);
   for (UStaticMeshComponent *Component : StaticMeshComponents) {
-    const auto Label = GetLabelByPath(Component->GetStaticMesh());
+    const auto Label = GetLabelByPath(Component->GetStaticMesh(), LabelCache);
     SetStencilValue(*Component, Label, bTagForSemanticSegmentation);
 #ifdef CARLA_TAGGER_EXTRA_LOG
     UE_LOG(LogCarla, Log, TEXT("  + StaticMeshComponent: %s"), *Component->GetName());
@@ -104,7 +126,7 @@ void ATagger::TagActor(const AActor &Actor, bool bTagForSemanticSegmentation)
   TArray<USkeletalMeshComponent *> SkeletalMeshComponents;
   Actor.GetComponents<USkeletalMeshComponent>(SkeletalMeshComponents);
   for (USkeletalMeshComponent *Component : SkeletalMeshComponents) {
-    const auto Label = GetLabelByPath(Component->GetPhysicsAsset());
+    const auto Label = GetLabelByPath(Component->GetPhysicsAsset(), LabelCache);
     SetStencilValue(*Component, Label, bTagForSemanticSegmentation);
 #ifdef CARLA_TAGGER_EXTRA_LOG
     UE_LOG(LogCarla, Log, TEXT("  + SkeletalMeshComponent: %s"), *Component->GetName());
@@ -115,8 +137,55 @@ void ATagger::TagActor(const AActor &Actor, bool bTagForSemanticSegmentation)
 
 void ATagger::TagActorsInLevel(UWorld &World, bool bTagForSemanticSegmentation)
 {
-  for (TActorIterator<AActor> it(&World); it; ++it) {
-    TagActor(**it, bTagForSemanticSegmentation);
+  FLabelCache LabelCache;
+  TagActorsInLevel(World, bTagForSemanticSegmentation, LabelCache);
+}
+
+void ATagger::TagActorsInLevel(
+    UWorld &World,
+    const bool bTagForSemanticSegmentation,
+    FLabelCache &LabelCache)
+{
+  SCOPE_CYCLE_COUNTER(STAT_CarlaTagActorsInLevel);
+  // Tagging is done in three passes: gather the components and the assets
+  // not seen yet on the game thread, parse the path of those assets in
+  // parallel, and finally set the stencil values back on the game thread.
+  TArray<TPair<UPrimitiveComponent *, const UObject *>> Components;
+  TArray<const UObject *> NewAssets;
+  {
+    TSet<const UObject *> NewAssetSet;
+    TArray<UStaticMeshComponent *> StaticMeshComponents;
+    TArray<USkeletalMeshComponent *> SkeletalMeshComponents;
+    auto AddComponent = [&](UPrimitiveComponent *Component, const UObject *Asset) {
+      Components.Emplace(Component, Asset);
+      if (!LabelCache.Contains(Asset) && !NewAssetSet.Contains(Asset)) {
+        NewAssetSet.Add(Asset);
+        NewAssets.Add(Asset);
+      }
+    };
+    for (TActorIterator<AActor> it(&World); it; ++it) {
+      it->GetComponents<UStaticMeshComponent>(StaticMeshComponents);
+      for (UStaticMeshComponent *Component : StaticMeshComponents) {
+        AddComponent(Component, Component->GetStaticMesh());
+      }
+      it->GetComponents<USkeletalMeshComponent>(SkeletalMeshComponents);
+      for (USkeletalMeshComponent *Component : SkeletalMeshComponents) {
+        AddComponent(Component, Component->GetPhysicsAsset());
+      }
+    }
+  }
+
+  TArray<ECityObjectLabel> NewLabels;
+  NewLabels.SetNumUninitialized(NewAssets.Num());
+  ParallelFor(NewAssets.Num(), [&](const int32 Index) {
+    NewLabels[Index] = GetLabelByPath(NewAssets[Index]);
+  });
+  for (auto i = 0; i < NewAssets.Num(); ++i) {
+    LabelCache.Add(NewAssets[i], NewLabels[i]);
+  }
+
+  for (auto &Item : Components) {
+    SetStencilValue(*Item.Key, LabelCache[Item.Value], bTagForSemanticSegmentation);
   }
 }
 
@@ -39,6 +39,10 @@ class CARLA_API ATagger : public AActor
 
 public:
 
+  /// Labels already found, by static mesh or physics asset. Finding the label
+  /// of an asset requires parsing its path, so it is done only once per asset.
+  using FLabelCache = TMap<const UObject *, ECityObjectLabel>;
+
   /// Set the tag of an actor.
   ///
   /// If bTagForSemanticSegmentation true, activate the custom depth pass. This
@@ -47,6 +51,12 @@ public:
   /// objects having this value active.
   static void TagActor(const AActor &Actor, bool bTagForSemanticSegmentation);
 
+  /// @copydoc TagActor, using and filling @a LabelCache.
+  static void TagActor(
+      const AActor &Actor,
+      bool bTagForSemanticSegmentation,
+      FLabelCache &LabelCache);
+
   /// Set the tag of every actor in level.
   ///
   /// If bTagForSemanticSegmentation true, activate the custom depth pass. This
@@ -55,6 +65,12 @@ public:
   /// objects having this value active.
   static void TagActorsInLevel(UWorld &World, bool bTagForSemanticSegmentation);
 
+  /// @copydoc TagActorsInLevel, using and filling @a LabelCache.
+  static void TagActorsInLevel(
+      UWorld &World,
+      bool bTagForSemanticSegmentation,
+      FLabelCache &LabelCache);
+
   /// Retrieve the tag of an already tagged component.
   static ECityObjectLabel GetTagOfTaggedComponent(const UPrimitiveComponent &Component)
   {
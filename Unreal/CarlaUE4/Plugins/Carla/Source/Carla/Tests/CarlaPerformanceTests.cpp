@@ -0,0 +1,367 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Engine/Engine.h"
+#include "EngineUtils.h"
+#include "Misc/CommandLine.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Tests/AutomationCommon.h"
+
+#include "AI/VehicleSpawnerBase.h"
+#include "AI/WalkerSpawnerBase.h"
+#include "CarlaWheeledVehicle.h"
+#include "Game/CarlaGameState.h"
+#include "Game/CarlaServer.h"
+#include "MapGen/RoadMap.h"
+#include "SceneCaptureCamera.h"
+#include "Tagger.h"
+#include "Util/FrameArena.h"
+
+// =============================================================================
+// -- Run parameters and results -----------------------------------------------
+// =============================================================================
+
+/// Hot paths timed, in the order they are reported.
+enum class ECarlaHotPath : int32
+{
+  SpawnAgents,
+  RoadMapIntersect,
+  TagActorsInLevel,
+  GetAgentInfo,
+  CameraReadback,
+  SIZE
+};
+
+static const TCHAR *GetName(const ECarlaHotPath Path)
+{
+  switch (Path) {
+    case ECarlaHotPath::SpawnAgents:      return TEXT("Spawners.SpawnAtBeginPlay");
+    case ECarlaHotPath::RoadMapIntersect: return TEXT("RoadMap.Intersect");
+    case ECarlaHotPath::TagActorsInLevel: return TEXT("Tagger.TagActorsInLevel");
+    case ECarlaHotPath::GetAgentInfo:     return TEXT("CarlaServer.GetAgentInfo");
+    case ECarlaHotPath::CameraReadback:   return TEXT("SceneCaptureCamera.ReadPixels");
+    default:                              return TEXT("Unknown");
+  }
+}
+
+struct FCarlaHotPathSamples
+{
+  /// Milliseconds of each sample.
+  TArray<double> Milliseconds;
+
+  /// Items processed by the last sample, e.g. the boxes intersected.
+  int32 Items = 0;
+};
+
+/// State shared by the latent commands of a run. The parameters are read from
+/// the command line, e.g. "-CarlaPerfFrames=600".
+struct FCarlaPerformanceRun
+{
+  explicit FCarlaPerformanceRun(FAutomationTestBase &InTest) : Test(InTest)
+  {
+    const TCHAR *CommandLine = FCommandLine::Get();
+    FParse::Value(CommandLine, TEXT("CarlaPerfMap="), MapName);
+    FParse::Value(CommandLine, TEXT("CarlaPerfFrames="), NumberOfFrames);
+    FParse::Value(CommandLine, TEXT("CarlaPerfVehicles="), NumberOfVehicles);
+    FParse::Value(CommandLine, TEXT("CarlaPerfWalkers="), NumberOfWalkers);
+    FParse::Value(CommandLine, TEXT("CarlaPerfSpawnRounds="), NumberOfSpawnRounds);
+    FParse::Value(CommandLine, TEXT("CarlaPerfImageSizeX="), ImageSize.X);
+    FParse::Value(CommandLine, TEXT("CarlaPerfImageSizeY="), ImageSize.Y);
+    FParse::Value(CommandLine, TEXT("CarlaPerfOutput="), OutputFile);
+    NumberOfFrames = FMath::Max(NumberOfFrames, 1);
+    NumberOfSpawnRounds = FMath::Max(NumberOfSpawnRounds, 1);
+    Samples.SetNum(static_cast<int32>(ECarlaHotPath::SIZE));
+  }
+
+  FCarlaHotPathSamples &operator[](const ECarlaHotPath Path)
+  {
+    return Samples[static_cast<int32>(Path)];
+  }
+
+  FAutomationTestBase &Test;
+
+  FString MapName = TEXT("/Game/Maps/Town01");
+
+  int32 NumberOfFrames = 300;
+
+  int32 NumberOfVehicles = 50;
+
+  int32 NumberOfWalkers = 50;
+
+  /// Times the agents are despawned and spawned again before measuring the
+  /// frames, the first round from scratch and the next ones from the pools.
+  int32 NumberOfSpawnRounds = 3;
+
+  FIntPoint ImageSize = FIntPoint(800, 600);
+
+  FString OutputFile = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Automation"), TEXT("CarlaPerformance.json"));
+
+  TArray<FCarlaHotPathSamples> Samples;
+
+  int32 FramesMeasured = 0;
+
+  TWeakObjectPtr<AVehicleSpawnerBase> VehicleSpawner;
+
+  TWeakObjectPtr<AWalkerSpawnerBase> WalkerSpawner;
+
+  TWeakObjectPtr<ASceneCaptureCamera> Camera;
+
+  FFrameArena Arena;
+
+  TArray<FColor> BitMap;
+};
+
+using FCarlaPerformanceRunRef = TSharedRef<FCarlaPerformanceRun, ESPMode::ThreadSafe>;
+
+// =============================================================================
+// -- Helpers ------------------------------------------------------------------
+// =============================================================================
+
+/// The world of the game or of the play-in-editor session the map was opened
+/// in.
+static UWorld *GetTestWorld()
+{
+  check(GEngine != nullptr);
+  for (const auto &Context : GEngine->GetWorldContexts()) {
+    if (((Context.WorldType == EWorldType::PIE) || (Context.WorldType == EWorldType::Game)) &&
+        (Context.World() != nullptr)) {
+      return Context.World();
+    }
+  }
+  return nullptr;
+}
+
+template <typename F>
+static double TimeMilliseconds(F &&Function)
+{
+  const double Start = FPlatformTime::Seconds();
+  Function();
+  return 1000.0 * (FPlatformTime::Seconds() - Start);
+}
+
+/// Value at @a Percentile of @a Sorted, by the nearest rank.
+static double GetPercentile(const TArray<double> &Sorted, const double Percentile)
+{
+  check(Sorted.Num() > 0);
+  const int32 Rank = FMath::CeilToInt(0.01 * Percentile * Sorted.Num());
+  return Sorted[FMath::Clamp(Rank - 1, 0, Sorted.Num() - 1)];
+}
+
+/// Log the results and write them as JSON to the output file, one object per
+/// hot path with the statistics of its samples in milliseconds.
+static void ReportResults(FCarlaPerformanceRun &Run, const int32 NumberOfAgents)
+{
+  FString Json;
+  Json += TEXT("{\n");
+  Json += FString::Printf(TEXT("  \"map\": \"%s\",\n"), *Run.MapName);
+  Json += FString::Printf(TEXT("  \"engine_version\": \"%s\",\n"), *FEngineVersion::Current().ToString());
+  Json += FString::Printf(TEXT("  \"frames\": %d,\n"), Run.FramesMeasured);
+  Json += FString::Printf(TEXT("  \"vehicles\": %d,\n"), Run.NumberOfVehicles);
+  Json += FString::Printf(TEXT("  \"walkers\": %d,\n"), Run.NumberOfWalkers);
+  Json += FString::Printf(TEXT("  \"agents\": %d,\n"), NumberOfAgents);
+  Json += FString::Printf(TEXT("  \"image_size\": [%d, %d],\n"), Run.ImageSize.X, Run.ImageSize.Y);
+  Json += TEXT("  \"results\": [");
+  for (auto i = 0; i < static_cast<int32>(ECarlaHotPath::SIZE); ++i) {
+    const auto Path = static_cast<ECarlaHotPath>(i);
+    const auto &Samples = Run[Path];
+    TArray<double> Sorted = Samples.Milliseconds;
+    Sorted.Sort();
+    double Total = 0.0;
+    for (auto Value : Sorted) {
+      Total += Value;
+    }
+    const bool bEmpty = (Sorted.Num() == 0);
+    const double Mean = (bEmpty ? 0.0 : Total / Sorted.Num());
+    const double Min = (bEmpty ? 0.0 : Sorted[0]);
+    const double Median = (bEmpty ? 0.0 : GetPercentile(Sorted, 50.0));
+    const double P95 = (bEmpty ? 0.0 : GetPercentile(Sorted, 95.0));
+    const double Max = (bEmpty ? 0.0 : Sorted.Last());
+    Json += FString::Printf(
+        TEXT("%s\n    {\"name\": \"%s\", \"samples\": %d, \"items\": %d, \"mean_ms\": %.4f, \"min_ms\": %.4f, \"median_ms\": %.4f, \"p95_ms\": %.4f, \"max_ms\": %.4f}"),
+        (i == 0 ? TEXT("") : TEXT(",")),
+        GetName(Path),
+        Sorted.Num(),
+        Samples.Items,
+        Mean,
+        Min,
+        Median,
+        P95,
+        Max);
+    Run.Test.AddInfo(FString::Printf(
+        TEXT("%s: %d samples of %d items, mean %.3f ms, median %.3f ms, p95 %.3f ms, max %.3f ms"),
+        GetName(Path),
+        Sorted.Num(),
+        Samples.Items,
+        Mean,
+        Median,
+        P95,
+        Max));
+  }
+  Json += TEXT("\n  ]\n}\n");
+  if (FFileHelper::SaveStringToFile(Json, *Run.OutputFile)) {
+    UE_LOG(LogCarla, Log, TEXT("Performance results written to \"%s\""), *Run.OutputFile);
+  } else {
+    Run.Test.AddError(FString::Printf(TEXT("Failed to write the results to \"%s\""), *Run.OutputFile));
+  }
+}
+
+// =============================================================================
+// -- Latent commands ----------------------------------------------------------
+// =============================================================================
+
+/// Spawn the agents of the run, timing the spawners, and a camera in front of
+/// the first vehicle.
+DEFINE_LATENT_AUTOMATION_COMMAND_ONE_PARAMETER(FCarlaPerformanceSetUpCommand, FCarlaPerformanceRunRef, Run);
+
+bool FCarlaPerformanceSetUpCommand::Update()
+{
+  UWorld *World = GetTestWorld();
+  if (World == nullptr) {
+    Run->Test.AddError(TEXT("No game world, the map failed to load"));
+    return true;
+  }
+  TActorIterator<AVehicleSpawnerBase> VehicleSpawner(World);
+  TActorIterator<AWalkerSpawnerBase> WalkerSpawner(World);
+  Run->VehicleSpawner = (VehicleSpawner ? *VehicleSpawner : nullptr);
+  Run->WalkerSpawner = (WalkerSpawner ? *WalkerSpawner : nullptr);
+  if (!Run->VehicleSpawner.IsValid() || !Run->WalkerSpawner.IsValid()) {
+    Run->Test.AddError(TEXT("The map has no vehicle or walker spawner"));
+    return true;
+  }
+
+  // Every agent within the call, none left to the next ticks.
+  auto &Vehicles = *Run->VehicleSpawner;
+  auto &Walkers = *Run->WalkerSpawner;
+  Vehicles.SetMaxSpawnsPerFrame(0);
+  Walkers.SetMaxSpawnsPerFrame(0);
+  for (auto Round = 0; Round < Run->NumberOfSpawnRounds; ++Round) {
+    Vehicles.DespawnVehicles();
+    Walkers.DespawnWalkers();
+    Vehicles.SetNumberOfVehicles(Run->NumberOfVehicles);
+    Walkers.SetNumberOfWalkers(Run->NumberOfWalkers);
+    (*Run)[ECarlaHotPath::SpawnAgents].Milliseconds.Add(TimeMilliseconds([&]() {
+      Vehicles.SpawnVehicles();
+      Walkers.SpawnWalkersAtBeginPlay();
+    }));
+  }
+  (*Run)[ECarlaHotPath::SpawnAgents].Items =
+      Vehicles.GetNumberOfSpawnedVehicles() + Walkers.GetCurrentNumberOfWalkers();
+
+  // Deferred so the size is set before begin play sets up the capture.
+  FTransform Transform(FVector(0.0f, 0.0f, 200.0f));
+  const auto &SpawnedVehicles = Vehicles.GetVehicles();
+  if ((SpawnedVehicles.Num() > 0) && (SpawnedVehicles[0] != nullptr)) {
+    Transform = SpawnedVehicles[0]->GetActorTransform();
+    Transform.AddToTranslation(FVector(0.0f, 0.0f, 200.0f));
+  }
+  auto *Camera = World->SpawnActorDeferred<ASceneCaptureCamera>(ASceneCaptureCamera::StaticClass(), Transform);
+  if (Camera == nullptr) {
+    Run->Test.AddError(TEXT("Failed to spawn the camera"));
+    return true;
+  }
+  Camera->SetImageSize(Run->ImageSize.X, Run->ImageSize.Y);
+  Camera->FinishSpawning(Transform);
+  Run->Camera = Camera;
+  return true;
+}
+
+/// Time every hot path once per frame until the frames of the run are
+/// measured, then report the results.
+DEFINE_LATENT_AUTOMATION_COMMAND_ONE_PARAMETER(FCarlaPerformanceMeasureCommand, FCarlaPerformanceRunRef, Run);
+
+bool FCarlaPerformanceMeasureCommand::Update()
+{
+  UWorld *World = GetTestWorld();
+  auto *GameState = (World != nullptr ? World->GetGameState<ACarlaGameState>() : nullptr);
+  if ((GameState == nullptr) || !Run->VehicleSpawner.IsValid() || !Run->Camera.IsValid()) {
+    // Already reported by the set-up, or the world went away meanwhile.
+    if (Run->FramesMeasured > 0) {
+      Run->Test.AddError(TEXT("The world was torn down before the run finished"));
+    }
+    return true;
+  }
+  auto &State = *Run;
+  State.Arena.Reset();
+
+  // The vehicles against the road map, one at a time as the player is.
+  const URoadMap *RoadMap = State.VehicleSpawner->GetRoadMap();
+  if (RoadMap != nullptr) {
+    const auto &Vehicles = State.VehicleSpawner->GetVehicles();
+    State[ECarlaHotPath::RoadMapIntersect].Items = Vehicles.Num();
+    State[ECarlaHotPath::RoadMapIntersect].Milliseconds.Add(TimeMilliseconds([&]() {
+      constexpr float ChecksPerCentimeter = 0.1f;
+      for (const auto *Vehicle : Vehicles) {
+        if (Vehicle != nullptr) {
+          RoadMap->Intersect(Vehicle->GetActorTransform(), Vehicle->GetVehicleBoundsExtent(), ChecksPerCentimeter);
+        }
+      }
+    }));
+  }
+
+  State[ECarlaHotPath::TagActorsInLevel].Items = World->GetActorCount();
+  State[ECarlaHotPath::TagActorsInLevel].Milliseconds.Add(TimeMilliseconds([&]() {
+    ATagger::TagActorsInLevel(*World, true);
+  }));
+
+  int32 AgentsRead = 0;
+  State[ECarlaHotPath::GetAgentInfo].Milliseconds.Add(TimeMilliseconds([&]() {
+    AgentsRead = CarlaServer::ReadAgents(*GameState, State.Arena);
+  }));
+  State[ECarlaHotPath::GetAgentInfo].Items = AgentsRead;
+
+  // Includes waiting for the render thread to draw the capture.
+  auto &Camera = *State.Camera;
+  Camera.CaptureSceneNow();
+  State[ECarlaHotPath::CameraReadback].Items = State.ImageSize.X * State.ImageSize.Y;
+  State[ECarlaHotPath::CameraReadback].Milliseconds.Add(TimeMilliseconds([&]() {
+    if (!Camera.ReadPixels(State.BitMap)) {
+      State.Test.AddWarning(TEXT("Failed to read back the camera"));
+    }
+  }));
+
+  if (++State.FramesMeasured < State.NumberOfFrames) {
+    return false;
+  }
+  ReportResults(State, AgentsRead);
+  Camera.Destroy();
+  return true;
+}
+
+// =============================================================================
+// -- Tests --------------------------------------------------------------------
+// =============================================================================
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(
+    FCarlaHotPathsPerformanceTest,
+    "Carla.Performance.HotPaths",
+    EAutomationTestFlags::EditorContext |
+    EAutomationTestFlags::ClientContext |
+    EAutomationTestFlags::PerfFilter)
+
+bool FCarlaHotPathsPerformanceTest::RunTest(const FString &Parameters)
+{
+  FCarlaPerformanceRunRef Run = MakeShared<FCarlaPerformanceRun, ESPMode::ThreadSafe>(*this);
+  if (!AutomationOpenMap(Run->MapName)) {
+    AddError(FString::Printf(TEXT("Failed to open the map \"%s\""), *Run->MapName));
+    return false;
+  }
+  // Let the spawners of the level begin play and the streaming settle.
+  ADD_LATENT_AUTOMATION_COMMAND(FWaitLatentCommand(2.0f));
+  ADD_LATENT_AUTOMATION_COMMAND(FCarlaPerformanceSetUpCommand(Run));
+  ADD_LATENT_AUTOMATION_COMMAND(FWaitLatentCommand(1.0f));
+  ADD_LATENT_AUTOMATION_COMMAND(FCarlaPerformanceMeasureCommand(Run));
+  return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,206 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "NonCopyable.h"
+
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Append-only sequence stored in contiguous chunks of @a ChunkSize elements.
+///
+/// Like std::list, elements are never moved so pointers and references to
+/// them remain valid as new elements are added, and elements do not need to
+/// be copyable or movable. Unlike std::list, elements are allocated in bulk
+/// and lie next to each other in memory, so iterating is cache friendly.
+template <typename T, size_t ChunkSize = 256u>
+class ChunkedVector : private NonCopyable
+{
+  static_assert(ChunkSize > 0u, "Chunk size must be positive");
+
+  using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+public:
+
+  // ===========================================================================
+  // -- Iterators --------------------------------------------------------------
+  // ===========================================================================
+
+  template <typename VECTOR, typename VALUE>
+  class Iterator
+  {
+  public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename std::remove_const<VALUE>::type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = VALUE *;
+    using reference = VALUE &;
+
+    Iterator(VECTOR &InVector, const size_t InIndex) :
+      Vector(&InVector),
+      Index(InIndex) {}
+
+    reference operator*() const
+    {
+      return (*Vector)[Index];
+    }
+
+    pointer operator->() const
+    {
+      return &(*Vector)[Index];
+    }
+
+    Iterator &operator++()
+    {
+      ++Index;
+      return *this;
+    }
+
+    Iterator operator++(int)
+    {
+      Iterator Result = *this;
+      ++Index;
+      return Result;
+    }
+
+    bool operator==(const Iterator &Rhs) const
+    {
+      return (Index == Rhs.Index) && (Vector == Rhs.Vector);
+    }
+
+    bool operator!=(const Iterator &Rhs) const
+    {
+      return !(*this == Rhs);
+    }
+
+  private:
+
+    VECTOR *Vector;
+
+    size_t Index;
+  };
+
+  using iterator = Iterator<ChunkedVector, T>;
+
+  using const_iterator = Iterator<const ChunkedVector, const T>;
+
+  // ===========================================================================
+  // -- Constructors and destructor --------------------------------------------
+  // ===========================================================================
+
+  ChunkedVector() = default;
+
+  /// Create a vector with @a Count default constructed elements.
+  explicit ChunkedVector(const size_t Count)
+  {
+    for (auto i = 0u; i < Count; ++i) {
+      emplace_back();
+    }
+  }
+
+  ~ChunkedVector()
+  {
+    for (auto i = 0u; i < Size; ++i) {
+      (*this)[i].~T();
+    }
+  }
+
+  // ===========================================================================
+  // -- Modifiers --------------------------------------------------------------
+  // ===========================================================================
+
+  template <typename... ARGS>
+  T &emplace_back(ARGS &&... Args)
+  {
+    if (Size == Chunks.size() * ChunkSize) {
+      Chunks.emplace_back(new Storage[ChunkSize]);
+    }
+    T *Element = new (GetStorage(Size)) T(std::forward<ARGS>(Args)...);
+    ++Size;
+    return *Element;
+  }
+
+  // ===========================================================================
+  // -- Element access ---------------------------------------------------------
+  // ===========================================================================
+
+  size_t size() const
+  {
+    return Size;
+  }
+
+  bool empty() const
+  {
+    return Size == 0u;
+  }
+
+  T &operator[](const size_t Index)
+  {
+    return *reinterpret_cast<T *>(GetStorage(Index));
+  }
+
+  const T &operator[](const size_t Index) const
+  {
+    return *reinterpret_cast<const T *>(GetStorage(Index));
+  }
+
+  T &front()
+  {
+    return (*this)[0u];
+  }
+
+  const T &front() const
+  {
+    return (*this)[0u];
+  }
+
+  T &back()
+  {
+    return (*this)[Size - 1u];
+  }
+
+  const T &back() const
+  {
+    return (*this)[Size - 1u];
+  }
+
+  iterator begin()
+  {
+    return iterator(*this, 0u);
+  }
+
+  const_iterator begin() const
+  {
+    return const_iterator(*this, 0u);
+  }
+
+  iterator end()
+  {
+    return iterator(*this, Size);
+  }
+
+  const_iterator end() const
+  {
+    return const_iterator(*this, Size);
+  }
+
+private:
+
+  Storage *GetStorage(const size_t Index) const
+  {
+    return &Chunks[Index / ChunkSize][Index % ChunkSize];
+  }
+
+  std::vector<std::unique_ptr<Storage[]>> Chunks;
+
+  size_t Size = 0u;
+};
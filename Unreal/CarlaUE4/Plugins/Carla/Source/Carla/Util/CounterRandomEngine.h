@@ -0,0 +1,98 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+/// Counter-based pseudo-random number engine (SplitMix64).
+///
+/// The n-th number of a sequence is a hash of the sequence key and n, so the
+/// state is just these two integers and forking an independent sequence is
+/// as cheap as hashing an id into a new key. Each subsystem, vehicle or
+/// parallel task forks its own stream from a seeded engine, and its numbers
+/// do not depend on how many the others drew or in which order.
+///
+/// Meets the UniformRandomBitGenerator requirements, so it can be used with
+/// the standard distributions.
+class FCounterRandomEngine
+{
+public:
+
+  using result_type = uint64_t;
+
+  explicit FCounterRandomEngine(uint64_t Seed = 0u)
+    : Key(Mix(Seed)) {}
+
+  static constexpr result_type min()
+  {
+    return std::numeric_limits<result_type>::min();
+  }
+
+  static constexpr result_type max()
+  {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()()
+  {
+    return Mix(Key + (++Counter) * GOLDEN_GAMMA);
+  }
+
+  /// Skip the next @a Count numbers.
+  void Discard(uint64_t Count)
+  {
+    Counter += Count;
+  }
+
+  /// Independent stream identified by @a StreamId. Depends only on the key
+  /// of this engine, not on the numbers drawn from it.
+  FCounterRandomEngine Fork(uint64_t StreamId) const
+  {
+    FCounterRandomEngine Stream;
+    Stream.Key = Mix(Key ^ Mix(StreamId + STREAM_SALT));
+    return Stream;
+  }
+
+  /// @name State
+  /// @{
+
+  uint64_t GetKey() const
+  {
+    return Key;
+  }
+
+  uint64_t GetCounter() const
+  {
+    return Counter;
+  }
+
+  void SetState(uint64_t InKey, uint64_t InCounter)
+  {
+    Key = InKey;
+    Counter = InCounter;
+  }
+
+  /// @}
+
+private:
+
+  static constexpr uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ull;
+
+  static constexpr uint64_t STREAM_SALT = 0x632be59bd9b4e019ull;
+
+  static uint64_t Mix(uint64_t Value)
+  {
+    Value = (Value ^ (Value >> 30u)) * 0xbf58476d1ce4e5b9ull;
+    Value = (Value ^ (Value >> 27u)) * 0x94d049bb133111ebull;
+    return Value ^ (Value >> 31u);
+  }
+
+  uint64_t Key;
+
+  uint64_t Counter = 0u;
+};
@@ -0,0 +1,65 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "FrameArena.h"
+
+/// Alignment of the blocks, enough for any type sent to the server.
+static constexpr uint32 BLOCK_ALIGNMENT = 16u;
+
+FFrameArena::FFrameArena(const SIZE_T InitialSize)
+{
+  AddBlock(FMath::Max<SIZE_T>(InitialSize, BLOCK_ALIGNMENT));
+}
+
+FFrameArena::~FFrameArena()
+{
+  for (auto &Block : Blocks) {
+    FMemory::Free(Block.Data);
+  }
+}
+
+void FFrameArena::Reset()
+{
+  if (Blocks.Num() > 1) {
+    // The last frame did not fit, merge the blocks so the next one does.
+    const SIZE_T Size = GetAllocatedSize();
+    for (auto &Block : Blocks) {
+      FMemory::Free(Block.Data);
+    }
+    Blocks.Reset();
+    AddBlock(Size);
+  }
+  Offset = 0u;
+  UsedSize = 0u;
+}
+
+void *FFrameArena::Allocate(const SIZE_T Size, const uint32 Alignment)
+{
+  check(FMath::IsPowerOfTwo(Alignment) && (Alignment <= BLOCK_ALIGNMENT));
+  if (Align(Offset, Alignment) + Size > Blocks.Last().Size) {
+    AddBlock(FMath::Max<SIZE_T>(2u * Blocks.Last().Size, Align(Size, BLOCK_ALIGNMENT)));
+  }
+  const SIZE_T Begin = Align(Offset, Alignment);
+  UsedSize += (Begin - Offset) + Size;
+  Offset = Begin + Size;
+  return Blocks.Last().Data + Begin;
+}
+
+SIZE_T FFrameArena::GetAllocatedSize() const
+{
+  SIZE_T Size = 0u;
+  for (const auto &Block : Blocks) {
+    Size += Block.Size;
+  }
+  return Size;
+}
+
+void FFrameArena::AddBlock(const SIZE_T Size)
+{
+  Blocks.Add({static_cast<uint8 *>(FMemory::Malloc(Size, BLOCK_ALIGNMENT)), Size});
+  Offset = 0u;
+}
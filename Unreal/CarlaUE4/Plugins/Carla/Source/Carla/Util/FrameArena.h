@@ -0,0 +1,79 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Containers/ArrayView.h"
+#include "NonCopyable.h"
+
+#include <type_traits>
+
+/// Linear allocator for the buffers that live for a single frame.
+///
+/// Allocating only bumps an offset, and everything allocated is released at
+/// once by Reset, at the start of the next frame. Memory is never returned to
+/// the system, if a frame needs more than the arena holds an extra block is
+/// allocated, and on the next Reset the blocks are merged into a single one
+/// big enough for that frame. So after a few frames the arena stops
+/// allocating.
+///
+/// Only trivially destructible types can be allocated, no destructor is
+/// called.
+class CARLA_API FFrameArena : private NonCopyable
+{
+public:
+
+  explicit FFrameArena(SIZE_T InitialSize = 64u * 1024u);
+
+  ~FFrameArena();
+
+  /// Release everything allocated since the last reset.
+  void Reset();
+
+  /// Allocate @a Size bytes aligned to @a Alignment, uninitialized.
+  void *Allocate(SIZE_T Size, uint32 Alignment);
+
+  /// Allocate an array of @a Count zero-initialized elements.
+  template <typename T>
+  TArrayView<T> NewArray(const int32 Count)
+  {
+    static_assert(std::is_trivially_destructible<T>::value, "Arena allocated types are never destroyed");
+    if (Count <= 0) {
+      return TArrayView<T>();
+    }
+    const SIZE_T Size = sizeof(T) * Count;
+    T *Data = static_cast<T *>(Allocate(Size, alignof(T)));
+    FMemory::Memzero(Data, Size);
+    return TArrayView<T>(Data, Count);
+  }
+
+  /// Bytes allocated since the last reset, including alignment padding.
+  SIZE_T GetUsedSize() const
+  {
+    return UsedSize;
+  }
+
+  /// Bytes held by the arena.
+  SIZE_T GetAllocatedSize() const;
+
+private:
+
+  struct FBlock
+  {
+    uint8 *Data;
+
+    SIZE_T Size;
+  };
+
+  void AddBlock(SIZE_T Size);
+
+  TArray<FBlock, TInlineAllocator<4u>> Blocks;
+
+  /// Offset in the last block.
+  SIZE_T Offset = 0u;
+
+  SIZE_T UsedSize = 0u;
+};
@@ -0,0 +1,54 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "Async/TaskGraphInterfaces.h"
+#include "NonCopyable.h"
+
+/// Work of a single frame split in tasks run by the engine's task graph.
+///
+/// Each task starts once those it depends on are done, so independent work
+/// runs in parallel while the game thread carries on with its own. The game
+/// thread waits only where it needs the results, and the destructor waits for
+/// anything left, so tasks may safely reference locals of the frame.
+class FFrameTaskGraph : private NonCopyable
+{
+public:
+
+  using FTask = FGraphEventRef;
+
+  ~FFrameTaskGraph()
+  {
+    WaitAll();
+  }
+
+  /// Run @a Function in a worker thread once @a Prerequisites are done.
+  template <typename FunctionType>
+  FTask Add(FunctionType &&Function, const FGraphEventArray &Prerequisites = FGraphEventArray())
+  {
+    FTask Task = FFunctionGraphTask::CreateAndDispatchWhenReady(
+        Forward<FunctionType>(Function),
+        TStatId(),
+        &Prerequisites,
+        ENamedThreads::AnyThread);
+    Tasks.Add(Task);
+    return Task;
+  }
+
+  /// Block until every task added is done.
+  void WaitAll()
+  {
+    if (Tasks.Num() > 0) {
+      FTaskGraphInterface::Get().WaitUntilTasksComplete(Tasks);
+      Tasks.Reset();
+    }
+  }
+
+private:
+
+  FGraphEventArray Tasks;
+};
@@ -11,19 +11,22 @@
 #include <limits>
 
 /// Wrapper around Unreal's INI file. In get functions, @a Target value is only
-/// set if it was present in the INI file, otherwise it keeps its value.
+/// set if it was present in the INI file, otherwise it keeps its value. They
+/// return whether it was set.
 class CARLA_API IniFile : private NonCopyable
 {
 private:
 
   template <typename TARGET, typename SOURCE>
-  static void SafeCastTo(SOURCE source, TARGET &target)
+  static bool SafeCastTo(SOURCE source, TARGET &target)
   {
     if ((source >= std::numeric_limits<TARGET>::lowest()) &&
         (source <= std::numeric_limits<TARGET>::max())) {
       target = static_cast<TARGET>(source);
+      return true;
     } else {
       UE_LOG(LogCarla, Error, TEXT("IniFile: Type cast failed"));
+      return false;
     }
   }
 
@@ -88,44 +91,50 @@ public:
   /// @{
 
   template <typename T>
-  void GetInt(const TCHAR* Section, const TCHAR* Key, T &Target) const
+  bool GetInt(const TCHAR* Section, const TCHAR* Key, T &Target) const
   {
     int64 Value;
-    if (ConfigFile.GetInt64(Section, Key, Value)) {
-      SafeCastTo<T>(Value, Target);
-    }
+    return ConfigFile.GetInt64(Section, Key, Value) && SafeCastTo<T>(Value, Target);
   }
 
-  void GetString(const TCHAR* Section, const TCHAR* Key, FString &Target) const
+  bool GetString(const TCHAR* Section, const TCHAR* Key, FString &Target) const
   {
     FString Value;
     if (ConfigFile.GetString(Section, Key, Value)) {
       Target = Value;
+      return true;
     }
+    return false;
   }
 
-  void GetBool(const TCHAR* Section, const TCHAR* Key, bool &Target) const
+  bool GetBool(const TCHAR* Section, const TCHAR* Key, bool &Target) const
   {
     bool Value;
     if (ConfigFile.GetBool(Section, Key, Value)) {
       Target = Value;
+      return true;
     }
+    return false;
   }
 
-  void GetFloat(const TCHAR* Section, const TCHAR* Key, float &Target) const
+  bool GetFloat(const TCHAR* Section, const TCHAR* Key, float &Target) const
   {
     FString Value;
     if (ConfigFile.GetString(Section, Key, Value)) {
       Target = FCString::Atof(*Value);
+      return true;
     }
+    return false;
   }
 
-  void GetLinearColor(const TCHAR* Section, const TCHAR* Key, FLinearColor &Target) const
+  bool GetLinearColor(const TCHAR* Section, const TCHAR* Key, FLinearColor &Target) const
   {
     FString Value;
     if (ConfigFile.GetString(Section, Key, Value)) {
       Target.InitFromString(Value);
+      return true;
     }
+    return false;
   }
 
   /// @}
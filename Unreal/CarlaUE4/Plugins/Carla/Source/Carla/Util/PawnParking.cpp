@@ -0,0 +1,78 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "PawnParking.h"
+
+#include "GameFramework/Controller.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PawnMovementComponent.h"
+
+/// Far below the level, parked pawns have no collision so they can share it.
+static const FVector PARKING_LOCATION(0.0f, 0.0f, -1.0e6f);
+
+static void SetTickEnabled(APawn &Pawn, const bool bEnabled)
+{
+  Pawn.SetActorTickEnabled(bEnabled);
+  for (auto *Component : Pawn.GetComponents()) {
+    if (Component != nullptr) {
+      Component->SetComponentTickEnabled(bEnabled);
+    }
+  }
+  auto *Controller = Pawn.GetController();
+  if (Controller != nullptr) {
+    Controller->SetActorTickEnabled(bEnabled);
+  }
+}
+
+static void StopPawn(APawn &Pawn)
+{
+  auto *RootPrimitive = Cast<UPrimitiveComponent>(Pawn.GetRootComponent());
+  if ((RootPrimitive != nullptr) && RootPrimitive->IsSimulatingPhysics()) {
+    RootPrimitive->SetPhysicsLinearVelocity(FVector::ZeroVector);
+    RootPrimitive->SetPhysicsAngularVelocity(FVector::ZeroVector);
+  }
+  auto *MovementComponent = Pawn.GetMovementComponent();
+  if (MovementComponent != nullptr) {
+    MovementComponent->StopMovementImmediately();
+  }
+}
+
+void FPawnParking::Park(APawn &Pawn)
+{
+  StopPawn(Pawn);
+  auto *RootPrimitive = Cast<UPrimitiveComponent>(Pawn.GetRootComponent());
+  if ((RootPrimitive != nullptr) && RootPrimitive->IsSimulatingPhysics()) {
+    RootPrimitive->SetSimulatePhysics(false);
+  }
+  SetTickEnabled(Pawn, false);
+  Pawn.SetActorEnableCollision(false);
+  Pawn.SetActorHiddenInGame(true);
+  Pawn.SetActorLocation(PARKING_LOCATION, false, nullptr, ETeleportType::TeleportPhysics);
+}
+
+void FPawnParking::Unpark(APawn &Pawn, const FTransform &Transform, const bool bSimulatePhysics)
+{
+  Pawn.SetActorTransform(Transform, false, nullptr, ETeleportType::TeleportPhysics);
+  Pawn.SetActorHiddenInGame(false);
+  Pawn.SetActorEnableCollision(true);
+  SetTickEnabled(Pawn, true);
+  auto *RootPrimitive = Cast<UPrimitiveComponent>(Pawn.GetRootComponent());
+  if (bSimulatePhysics && (RootPrimitive != nullptr)) {
+    RootPrimitive->SetSimulatePhysics(true);
+  }
+  StopPawn(Pawn);
+}
+
+SIZE_T FPawnParking::GetResourceSize(APawn &Pawn)
+{
+  SIZE_T Size = Pawn.GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+  TInlineComponentArray<UActorComponent *> Components(&Pawn);
+  for (auto *Component : Components) {
+    Size += Component->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+  }
+  return Size;
+}
@@ -0,0 +1,28 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+class APawn;
+
+/// Takes pawns out of the simulation without destroying them, so the spawners
+/// can reuse them instead of paying again for spawning the actor, creating
+/// its physics bodies and possessing it with a new controller.
+class CARLA_API FPawnParking
+{
+public:
+
+  /// Hide @a Pawn and disable its collision, physics and tick, and the tick
+  /// of its controller. The pawn is moved away from the level.
+  static void Park(APawn &Pawn);
+
+  /// Undo Park and teleport @a Pawn to @a Transform, at rest.
+  static void Unpark(APawn &Pawn, const FTransform &Transform, bool bSimulatePhysics);
+
+  /// Bytes held by @a Pawn and its components while parked, meshes and other
+  /// assets shared with the rest of the level are not counted.
+  static SIZE_T GetResourceSize(APawn &Pawn);
+};
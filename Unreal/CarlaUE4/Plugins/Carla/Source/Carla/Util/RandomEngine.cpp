@@ -17,3 +17,22 @@ int32 URandomEngine::GenerateRandomSeed()
       std::numeric_limits<int32>::max());
   return Distribution(RandomDevice);
 }
+
+URandomEngine *URandomEngine::Fork(UObject *Outer, const int32 StreamId) const
+{
+  auto *Forked = NewObject<URandomEngine>(Outer != nullptr ? Outer : GetTransientPackage());
+  // Reinterpreted so negative ids are valid streams too.
+  Forked->Engine = Engine.Fork(static_cast<uint32>(StreamId));
+  return Forked;
+}
+
+void URandomEngine::SerializeState(FArchive &Ar)
+{
+  uint64 Key = Engine.GetKey();
+  uint64 Counter = Engine.GetCounter();
+  Ar << Key;
+  Ar << Counter;
+  if (Ar.IsLoading() && !Ar.IsError()) {
+    Engine.SetState(Key, Counter);
+  }
+}
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include "Util/CounterRandomEngine.h"
+
 #include <random>
 
 #include "RandomEngine.generated.h"
@@ -28,9 +30,26 @@ public:
   UFUNCTION(BlueprintCallable)
   void Seed(int32 InSeed)
   {
-    Engine.seed(InSeed);
+    Engine = FCounterRandomEngine(static_cast<uint32>(InSeed));
   }
 
+  /// Create a new random engine with the independent stream @a StreamId of
+  /// this one. Forks with the same seed and stream id draw the same sequence
+  /// regardless of the numbers drawn from this engine or its other forks.
+  UFUNCTION(BlueprintCallable)
+  URandomEngine *Fork(UObject *Outer, int32 StreamId) const;
+
+  /// Independent stream @a StreamId of this engine, for code that does not
+  /// need a UObject, e.g. parallel tasks.
+  FCounterRandomEngine ForkEngine(uint64 StreamId) const
+  {
+    return Engine.Fork(StreamId);
+  }
+
+  /// Save or restore the state of the engine, so it continues the same
+  /// sequence after a world snapshot is restored.
+  void SerializeState(FArchive &Ar);
+
   /// @}
   // ===========================================================================
   /// @name Uniform distribution
@@ -140,5 +159,5 @@ public:
 
 private:
 
-  std::minstd_rand Engine;
+  FCounterRandomEngine Engine;
 };
@@ -0,0 +1,55 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "StartupProfiler.h"
+
+#include <carla/carla_server.h>
+
+struct FStartupPhase
+{
+  FString Name;
+
+  double Seconds;
+};
+
+static TArray<FStartupPhase> &GetPhases()
+{
+  static TArray<FStartupPhase> Phases;
+  return Phases;
+}
+
+static bool bReportLogged = false;
+
+void FStartupProfiler::Mark(const TCHAR *Phase)
+{
+  check(IsInGameThread());
+  auto &Phases = GetPhases();
+  if (Phases.ContainsByPredicate([Phase](const FStartupPhase &Item) { return Item.Name == Phase; })) {
+    return;
+  }
+  // GStartTime is taken at the very beginning of the engine pre-init.
+  const double Seconds = FPlatformTime::Seconds() - GStartTime;
+  Phases.Add({Phase, Seconds});
+  UE_LOG(LogCarla, Log, TEXT("Startup: %s at %.3f s"), Phase, Seconds);
+  carla_mark_startup_phase(TCHAR_TO_ANSI(Phase), Seconds);
+}
+
+void FStartupProfiler::LogReport()
+{
+  check(IsInGameThread());
+  if (bReportLogged) {
+    return;
+  }
+  bReportLogged = true;
+  const auto &Phases = GetPhases();
+  UE_LOG(LogCarla, Log, TEXT("Startup report, seconds since the engine started:"));
+  double Previous = 0.0;
+  for (const auto &Phase : Phases) {
+    UE_LOG(LogCarla, Log, TEXT("  %-28s %8.3f (+%.3f)"), *Phase.Name, Phase.Seconds, Phase.Seconds - Previous);
+    Previous = Phase.Seconds;
+  }
+}
@@ -0,0 +1,22 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+/// Time since the engine started at which every startup phase ended, to know
+/// where the time to the first frame goes. Game thread only.
+class CARLA_API FStartupProfiler
+{
+public:
+
+  /// Record the end of @a Phase in the log and in the metrics of the server,
+  /// see carla_mark_startup_phase. Only the first time each phase ends, the
+  /// episodes after the first one are not part of the startup.
+  static void Mark(const TCHAR *Phase);
+
+  /// Log every phase recorded so far and how long each one took, only once.
+  static void LogReport();
+};
@@ -0,0 +1,97 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "Carla.h"
+#include "ThreadAffinity.h"
+
+#include "RenderingThread.h"
+
+#if PLATFORM_LINUX
+#  include <sched.h>
+#endif // PLATFORM_LINUX
+
+bool FThreadAffinity::ParseCPUList(const FString &List, TArray<uint32> &CPUs)
+{
+  CPUs.Reset();
+  TArray<FString> Ranges;
+  List.ParseIntoArray(Ranges, TEXT(","), true);
+  for (FString &Range : Ranges) {
+    Range = Range.Trim().TrimTrailing();
+    FString First = Range;
+    FString Last = Range;
+    Range.Split(TEXT("-"), &First, &Last);
+    if (!First.IsNumeric() || !Last.IsNumeric()) {
+      return false;
+    }
+    const int32 Begin = FCString::Atoi(*First);
+    const int32 End = FCString::Atoi(*Last);
+    if ((Begin < 0) || (End < Begin)) {
+      return false;
+    }
+    for (int32 CPU = Begin; CPU <= End; ++CPU) {
+      CPUs.AddUnique(CPU);
+    }
+  }
+  return true;
+}
+
+bool FThreadAffinity::PinCurrentThread(const TArray<uint32> &CPUs)
+{
+  if (CPUs.Num() == 0) {
+    return true;
+  }
+#if PLATFORM_LINUX
+  cpu_set_t Set;
+  CPU_ZERO(&Set);
+  for (auto CPU : CPUs) {
+    if (CPU >= CPU_SETSIZE) {
+      return false;
+    }
+    CPU_SET(CPU, &Set);
+  }
+  return (sched_setaffinity(0, sizeof(Set), &Set) == 0);
+#else
+  uint64 Mask = 0u;
+  for (auto CPU : CPUs) {
+    if (CPU >= 64u) {
+      return false;
+    }
+    Mask |= (uint64(1u) << CPU);
+  }
+  FPlatformProcess::SetThreadAffinityMask(Mask);
+  return true;
+#endif // PLATFORM_LINUX
+}
+
+static bool ParseOrLog(const TCHAR *ThreadName, const FString &List, TArray<uint32> &CPUs)
+{
+  if (!FThreadAffinity::ParseCPUList(List, CPUs)) {
+    UE_LOG(LogCarla, Error, TEXT("Invalid CPU list \"%s\" for the %s thread"), *List, ThreadName);
+    return false;
+  }
+  return (CPUs.Num() > 0);
+}
+
+void FThreadAffinity::PinEngineThreads(const FString &GameThreadCPUs, const FString &RenderThreadCPUs)
+{
+  TArray<uint32> CPUs;
+  if (ParseOrLog(TEXT("game"), GameThreadCPUs, CPUs)) {
+    check(IsInGameThread());
+    if (!PinCurrentThread(CPUs)) {
+      UE_LOG(LogCarla, Error, TEXT("Failed to pin the game thread to CPUs \"%s\""), *GameThreadCPUs);
+    }
+  }
+  if (ParseOrLog(TEXT("rendering"), RenderThreadCPUs, CPUs)) {
+    ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+        FCarlaPinRenderThreadCommand,
+        TArray<uint32>, RenderCPUs, CPUs,
+    {
+      if (!FThreadAffinity::PinCurrentThread(RenderCPUs)) {
+        UE_LOG(LogCarla, Error, TEXT("Failed to pin the rendering thread"));
+      }
+    });
+  }
+}
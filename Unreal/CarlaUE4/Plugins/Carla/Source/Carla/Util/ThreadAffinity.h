@@ -0,0 +1,26 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+/// Pinning of the engine threads to a set of CPUs, so several simulators
+/// sharing a host do not thrash each other's caches.
+class CARLA_API FThreadAffinity
+{
+public:
+
+  /// Parse a list of CPUs as "0-3,8,10-11" into @a CPUs. Returns false if the
+  /// list is malformed, an empty list is valid and means any CPU.
+  static bool ParseCPUList(const FString &List, TArray<uint32> &CPUs);
+
+  /// Pin the calling thread to @a CPUs, does nothing if empty. On platforms
+  /// other than Linux only the first 64 CPUs can be used.
+  static bool PinCurrentThread(const TArray<uint32> &CPUs);
+
+  /// Pin the game thread (the calling thread) and the rendering thread to the
+  /// CPUs of the given lists, each is ignored if empty.
+  static void PinEngineThreads(const FString &GameThreadCPUs, const FString &RenderThreadCPUs);
+};
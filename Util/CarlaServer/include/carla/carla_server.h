@@ -28,11 +28,75 @@ extern "C" {
     float z;
   };
 
+  /** Pixel encodings of an image. */
+#define CARLA_SERVER_IMAGE_BGRA8            0u  /* 8-bit BGRA, 4 bytes per pixel. */
+#define CARLA_SERVER_IMAGE_FLOAT32          1u  /* 32-bit float, 4 bytes per pixel. */
+#define CARLA_SERVER_IMAGE_FLOAT16          2u  /* 16-bit float, 2 bytes per pixel. */
+#define CARLA_SERVER_IMAGE_GRAY8            3u  /* 8-bit single channel, 1 byte per pixel. */
+#define CARLA_SERVER_IMAGE_BGR8             4u  /* 8-bit BGRA given, sent as BGR, 3 bytes per pixel. */
+#define CARLA_SERVER_IMAGE_POINTS_XYZL      5u  /* Point cloud, x, y, z and label as 32-bit floats, 16 bytes per point. */
+#define CARLA_SERVER_IMAGE_GPU_SHARED       6u  /* A single carla_gpu_shared_image, sent as a 1x1 image. */
+#define CARLA_SERVER_IMAGE_MOTION_VECTORS   7u  /* Screen-space motion, x and y in pixels as 16-bit floats, 4 bytes per pixel. */
+
+  /** Compressions of an image, applied in the networking threads. */
+#define CARLA_SERVER_IMAGE_COMPRESSION_NONE 0u
+#define CARLA_SERVER_IMAGE_COMPRESSION_LZ4  1u  /* Lossless, LZ4 block format. */
+#define CARLA_SERVER_IMAGE_COMPRESSION_DELTA 2u /* Lossless, XOR of the previous image of the camera, LZ4 block format. */
+
   struct carla_image {
     uint32_t width;
     uint32_t height;
     uint32_t type;
     const uint32_t *data;
+    /** Simulation frame in which the image was captured. */
+    uint64_t frame_number;
+    /** Index of the camera that captured the image. Cameras may capture at
+      * a lower rate than the simulation, so not every camera sends an image
+      * every frame.
+      */
+    uint32_t camera_index;
+    /** Encoding of the pixels, one of CARLA_SERVER_IMAGE_*. Data points to
+      * height rows of width pixels of this encoding, see row_pitch.
+      */
+    uint32_t encoding;
+    /** Compression to apply before sending, one of
+      * CARLA_SERVER_IMAGE_COMPRESSION_*.
+      */
+    uint32_t compression;
+    /** Bytes between the start of two consecutive rows of data, zero if the
+      * rows are tightly packed. Lets the pixels be passed as they are read
+      * back from the GPU or as a crop of a larger image, the rows are packed
+      * when copied into the message. Ignored by carla_acquire_image_buffer,
+      * the buffers it returns are tightly packed.
+      */
+    uint32_t row_pitch;
+    /** Percentage of the image size the scene was rendered at before being
+      * upscaled to the image size, zero is taken as 100.
+      */
+    uint32_t screen_percentage;
+    /** CARLA_SERVER_IMAGE_COMPRESSION_DELTA only. Every this many images of
+      * the camera a key frame is sent, compressed as LZ4 alone, zero is taken
+      * as 30.
+      */
+    uint32_t key_frame_interval;
+  };
+
+  /** Render target shared with clients in the same host, in place of the
+    * pixels of an image. The texture is guarded by a keyed mutex, the server
+    * releases it with key 1 once the frame is copied in and the client has to
+    * release it with key 0 when done reading.
+    */
+  struct carla_gpu_shared_image {
+    /** Shared handle of the texture (e.g., DXGI shared handle). */
+    uint64_t handle;
+    uint32_t width;
+    uint32_t height;
+    /** Pixel format of the texture in the native graphics API (e.g.,
+      * DXGI_FORMAT).
+      */
+    uint32_t format;
+    /** Slot of the ring of textures of the camera the frame was copied into. */
+    uint32_t slot;
   };
 
   struct carla_transform {
@@ -61,6 +125,72 @@ extern "C" {
     struct carla_transform transform;
     struct carla_vector3d box_extent;
     float forward_speed;
+    /** Vehicles only, fraction of the box off-road and invading the opposite
+      * lane, as those of the player. Zero unless the simulator computes them,
+      * not sent in packed agents mode.
+      */
+    float intersection_offroad;
+    float intersection_otherlane;
+  };
+
+  /** The same non-player agents as an array of carla_agent, one array per
+    * field (structure of arrays), each holding number_of_agents values. The
+    * fields have the same meaning as in carla_agent, traffic light state
+    * included in the type. This is the layout the agents are sent with in
+    * packed agents mode, so they are copied with a single memcpy per array.
+    */
+  struct carla_agent_arrays {
+    uint32_t number_of_agents;
+    const uint32_t *ids;
+    const uint32_t *types;
+    const struct carla_vector3d *locations;
+    const struct carla_vector3d *orientations;
+    const struct carla_vector3d *box_extents;
+    const float *forward_speeds;
+  };
+
+  /** The box is cut by the borders of the image. */
+#define CARLA_SERVER_AGENT_BOX_TRUNCATED  1u
+  /** The depth of the scene in front of the whole box is closer than the
+    * agent. Only checked if the camera has a colocated depth camera.
+    */
+#define CARLA_SERVER_AGENT_BOX_OCCLUDED   2u
+
+  /** Screen-space box of an agent in the image of a camera, in pixels. */
+  struct carla_agent_box_2d {
+    uint32_t agent_id;
+    float min_x;
+    float min_y;
+    float max_x;
+    float max_y;
+    /** CARLA_SERVER_AGENT_BOX_* bits. */
+    uint32_t flags;
+  };
+
+  struct carla_camera_agent_boxes {
+    uint32_t camera_index;
+    const struct carla_agent_box_2d *boxes;
+    uint32_t number_of_boxes;
+  };
+
+  /** Pixels of each semantic label in the image of a camera. */
+  struct carla_class_histogram {
+    uint32_t camera_index;
+    /** Count of each label, indexed by label. */
+    const uint32_t *counts;
+    uint32_t number_of_classes;
+  };
+
+  /** Hits of the player against a component of another actor during a
+    * frame, aggregated.
+    */
+  struct carla_collision_event {
+    /** Id of the other actor if it is a non-player agent, 0 otherwise. */
+    uint32_t other_actor_id;
+    /** Semantic label of the component hit. */
+    uint32_t label;
+    /** Sum of the normal impulses of the hits. */
+    float normal_impulse;
   };
 
   /* ======================================================================== */
@@ -83,10 +213,31 @@ extern "C" {
   /* -- carla_scene_description --------------------------------------------- */
   /* ======================================================================== */
 
+  /** Totals of the player over a whole episode. */
+  struct carla_episode_summary {
+    uint32_t number_of_frames;
+    /** Game time the episode lasted, in milliseconds. */
+    uint32_t game_timestamp;
+    /** In centimeters. */
+    float distance_traveled;
+    float collision_vehicles;
+    float collision_pedestrians;
+    float collision_other;
+    /** Each run of consecutive frames with collisions counts once. */
+    uint32_t number_of_collisions;
+    /** Weighted by the fraction of the vehicle off-road. */
+    float seconds_off_road;
+    /** Weighted by the fraction of the vehicle on the other lane. */
+    float seconds_on_other_lane;
+    float seconds_over_speed_limit;
+  };
+
   struct carla_scene_description {
     /** Collection of the initial player start locations. */
     const struct carla_transform *player_start_spots;
     uint32_t number_of_player_start_spots;
+    /** Summary of the episode that just ended, null if none. */
+    const struct carla_episode_summary *previous_episode_summary;
   };
 
   /* ======================================================================== */
@@ -105,6 +256,87 @@ extern "C" {
     bool ready;
   };
 
+  /* ======================================================================== */
+  /* -- carla_world_snapshot ------------------------------------------------ */
+  /* ======================================================================== */
+
+  /** Request of the client to take a snapshot of the world, or to restore one
+    * if restore_data is not empty.
+    *
+    * Do NOT delete the array, it is valid until the next call to
+    * carla_read_request_new_episode.
+    */
+  struct carla_world_snapshot_request {
+    const void *restore_data;
+    uint32_t restore_data_length;
+  };
+
+  /** Answer to a carla_world_snapshot_request. On restore, data is ignored
+    * and success tells whether the snapshot was applied. The data is copied,
+    * it may be deleted after carla_write_world_snapshot returns.
+    */
+  struct carla_world_snapshot {
+    bool success;
+    const void *data;
+    uint32_t data_length;
+  };
+
+  /* ======================================================================== */
+  /* -- carla_route --------------------------------------------------------- */
+  /* ======================================================================== */
+
+  /** Request of the client for the shortest route along the lanes from the
+    * lane closest to start, going along its orientation, to the point of the
+    * lane closest to end.
+    */
+  struct carla_route_request {
+    struct carla_transform start;
+    struct carla_transform end;
+  };
+
+  /** Answer to a carla_route_request. The arrays are copied, they may be
+    * deleted after carla_write_route returns.
+    */
+  struct carla_route {
+    bool success;
+    /** Lane center points to follow, the last one the closest to end. */
+    const struct carla_vector3d *waypoints;
+    uint32_t number_of_waypoints;
+    /** Indices of the lanes of the route, in order. */
+    const uint32_t *lanes;
+    uint32_t number_of_lanes;
+    /** Along the waypoints, in centimeters. */
+    float length;
+  };
+
+  /* ======================================================================== */
+  /* -- carla_road_map ------------------------------------------------------ */
+  /* ======================================================================== */
+
+  /** Request of the client for the road map of the city. */
+  struct carla_road_map_request {
+    /** Hash of the road map the client already has, zero if none. */
+    uint64_t cached_hash;
+  };
+
+  /** Answer to a carla_road_map_request. The pixels are encoded before
+    * carla_write_road_map returns, they may be deleted after.
+    */
+  struct carla_road_map {
+    bool success;
+    /** Row-major, width x height, in the encoding of the road map of the
+      * simulator.
+      */
+    const uint16_t *pixels;
+    uint32_t width;
+    uint32_t height;
+    /** Affine transform from a world location in centimeters to pixel
+      * coordinates, px = m[0] x + m[1] y + m[2] z + m[3] and py = m[4] x +
+      * m[5] y + m[6] z + m[7].
+      */
+    float world_to_pixel[8u];
+  };
+
   /* ======================================================================== */
   /* -- carla_control ------------------------------------------------------- */
   /* ======================================================================== */
@@ -115,6 +347,53 @@ extern "C" {
     float brake;
     bool hand_brake;
     bool reverse;
+    /** Sequence number the client tagged the control with, zero if none. Give
+      * it to carla_set_applied_control once the control is applied.
+      */
+    uint64_t sequence_number;
+  };
+
+  /** @warning the underlying array is allocated inside CarlaServer, it might
+    * be deleted on subsequent calls to carla_read_control_batch, therefore
+    * for a given CarlaServer carla_read_control_batch is NOT thread-safe.
+    *
+    * Do NOT delete the array.
+    */
+  struct carla_control_batch {
+    /** Controls to apply one per tick, the first one on the current tick. At
+      * least one.
+      */
+    const struct carla_control *controls;
+    uint32_t number_of_controls;
+    /** The client only wants the measurements after the last control of the
+      * batch is applied.
+      */
+    bool skip_intermediate_measurements;
+    /** The client asked for only part of the next measurements, the fields
+      * below are set only if true. Holds until the next batch read.
+      */
+    bool has_observation_request;
+    /** Indices of the sensors to send images of, the cameras first and then
+      * the LiDARs. The others need not be rendered nor read.
+      */
+    const uint32_t *observed_sensors;
+    uint32_t number_of_observed_sensors;
+    /** Whether to send each of these, if the settings enable them too. */
+    bool observe_non_player_agents;
+    bool observe_agent_boxes;
+    bool observe_class_histograms;
+  };
+
+  /** How recent the control returned by carla_read_latest_control is. */
+  struct carla_control_status {
+    /** Controls received in the current episode, this one included. */
+    uint64_t number_of_controls;
+    /** Frames written since the control arrived, counted with the
+      * frame_number of the measurements.
+      */
+    uint64_t age_in_frames;
+    /** Milliseconds since the control arrived. */
+    float age_in_milliseconds;
   };
 
   /* ======================================================================== */
@@ -146,11 +425,37 @@ extern "C" {
   /* -- carla_measurements -------------------------------------------------- */
   /* ======================================================================== */
 
+  /** Time spent on each stage of producing and sending a frame, in
+    * milliseconds. The server fills the encode, queue wait and send times,
+    * the simulator fills the rest.
+    */
+  struct carla_frame_timing {
+    /** Game thread time of the frame. */
+    float game_tick;
+    /** Time spent updating the AI agents. */
+    float ai;
+    /** Time spent reading back the images from the GPU. */
+    float capture_readback;
+    /** Time spent encoding the previous measurements. */
+    float encode;
+    /** Time these measurements waited in the queue to be sent. */
+    float queue_wait;
+    /** Time spent sending the previous measurements. */
+    float send;
+    /** Time the frame waited to keep the target frame rate, in asynchronous
+      * mode only. */
+    float pacing_wait;
+    /** Average deviation of the time between frames from the target. */
+    float pacing_jitter;
+  };
+
   struct carla_measurements {
     /** Time-stamp of the current frame, in milliseconds as given by the OS. */
     uint32_t platform_timestamp;
     /** In-game time-stamp, milliseconds elapsed since the beginning of the current level. */
     uint32_t game_timestamp;
+    /** Simulation frame in which these measurements were taken. */
+    uint64_t frame_number;
     /** Player measurements. */
     struct carla_player_measurements player_measurements;
     /** Non-player agents. */
@@ -211,6 +516,283 @@ extern "C" {
   /** Signal the world server to disconnect. */
   CARLA_SERVER_API void carla_disconnect_server(CarlaServerPtr self);
 
+  /* -- Sockets ------------------------------------------------------------- */
+
+#define CARLA_SERVER_SOCKET_WORLD        0u  /* world_port */
+#define CARLA_SERVER_SOCKET_MEASUREMENTS 1u  /* world_port + 1 */
+#define CARLA_SERVER_SOCKET_CONTROL      2u  /* world_port + 2 */
+
+  struct carla_socket_options {
+    /** Disable Nagle's algorithm (TCP_NODELAY). */
+    bool no_delay;
+    /** Allow re-binding the port right after a restart (SO_REUSEADDR). */
+    bool reuse_address;
+    /** SO_SNDBUF in bytes, zero for the default of the system. */
+    uint32_t send_buffer_size;
+    /** SO_RCVBUF in bytes, zero for the default of the system. */
+    uint32_t receive_buffer_size;
+  };
+
+  /** Set the options of one of the sockets, CARLA_SERVER_SOCKET_*. The options
+    * of the world socket take effect on the next carla_server_connect, the
+    * others on the next episode. By default TCP_NODELAY and SO_REUSEADDR are
+    * enabled, and the buffers have the size given by the system.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The options were set.
+    *   Any other value if the socket is unknown.
+    */
+  CARLA_SERVER_API int32_t carla_set_socket_options(
+      CarlaServerPtr self,
+      uint32_t socket,
+      const carla_socket_options &options);
+
+  /* -- Measurements stream ------------------------------------------------- */
+
+  /** What to do when the agent client falls behind and every buffered frame is
+    * still pending to be sent.
+    */
+#define CARLA_SERVER_STREAM_DROP_OLDEST 0u  /* Discard the oldest frame. */
+#define CARLA_SERVER_STREAM_BLOCK       1u  /* Block until a frame is sent. */
+
+  struct carla_stream_stats {
+    uint64_t number_of_writes;
+    uint64_t number_of_reads;
+    uint64_t number_of_drops;
+    /** Frames pending to be sent. */
+    uint32_t depth;
+    uint32_t max_depth;
+  };
+
+  /** Set the number of frames (at least 2) buffered for sending measurements
+    * and images, and the policy to apply when the buffer is full. Takes effect
+    * on the next episode. By default 2 frames with
+    * CARLA_SERVER_STREAM_DROP_OLDEST.
+    */
+  CARLA_SERVER_API int32_t carla_set_measurements_buffer(
+      CarlaServerPtr self,
+      uint32_t number_of_frames,
+      uint32_t policy);
+
+  /** Send the images of every agent through a separate stream at
+    * world_port + 67 + agent index, with its own connection and writer
+    * thread, so a slow image send does not delay the measurements. Images are
+    * buffered independently, @a number_of_frames (at least 2) with @a policy
+    * as in carla_set_measurements_buffer. The measurements carry an image
+    * message without images, and EpisodeReady tells the client to connect
+    * the images stream. Takes effect on the next episode. Disabled by
+    * default.
+    */
+  CARLA_SERVER_API int32_t carla_set_images_stream(
+      CarlaServerPtr self,
+      bool enable,
+      uint32_t number_of_frames,
+      uint32_t policy);
+
+  /** Return values:
+    *   CARLA_SERVER_SUCCESS Stats of the current episode were retrieved.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_get_measurements_stats(
+      CarlaServerPtr self,
+      carla_stream_stats &stats);
+
+  /** Send the non-player agents packed as a structure of arrays instead of one
+    * protobuf message per agent, see PackedAgents in carla_server.proto.
+    * Disabled by default.
+    */
+  CARLA_SERVER_API int32_t carla_set_packed_agents(
+      CarlaServerPtr self,
+      bool enable);
+
+  /** Encodings of the packed agents, see AgentsEncoding in
+    * carla_server.proto.
+    */
+#define CARLA_SERVER_AGENTS_FLOAT32          0u  /* 48 bytes per agent. */
+#define CARLA_SERVER_AGENTS_QUANTIZED        1u  /* Centimeters and int16 unit vectors, 33 bytes per agent. */
+#define CARLA_SERVER_AGENTS_QUANTIZED_DELTA  2u  /* The quantized values as varint deltas, smaller. */
+#define CARLA_SERVER_AGENTS_HALF_FLOAT       3u  /* 16-bit floats, 25 bytes per agent. */
+
+  /** Encoding of the packed agents, for the clients that support it; the
+    * others get CARLA_SERVER_AGENTS_FLOAT32. CARLA_SERVER_AGENTS_FLOAT32 by
+    * default.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The encoding was set.
+    *   Any other value if the encoding is unknown.
+    */
+  CARLA_SERVER_API int32_t carla_set_agents_encoding(
+      CarlaServerPtr self,
+      uint32_t encoding);
+
+  /** Send only the non-player agents whose location, orientation, box extent
+    * or forward speed changed more than @a threshold (in any component) since
+    * they were last sent, plus the ids of the agents removed. Every agent is
+    * sent in the first measurements of each episode. Disabled by default.
+    */
+  CARLA_SERVER_API int32_t carla_set_delta_agents(
+      CarlaServerPtr self,
+      bool enable,
+      float threshold);
+
+  /** Write the images into a shared memory segment for clients running in the
+    * same host, instead of sending them through the socket. The name of the
+    * segment is sent in the next scene description, so this has to be called
+    * before carla_write_scene_description. Disabled by default.
+    */
+  CARLA_SERVER_API int32_t carla_set_shared_memory_images(
+      CarlaServerPtr self,
+      bool enable);
+
+  /** Allow sharing the render targets of the cameras with clients in the same
+    * host, the images of those cameras are then sent as
+    * CARLA_SERVER_IMAGE_GPU_SHARED. Only if the client supports it too.
+    * Disabled by default.
+    */
+  CARLA_SERVER_API int32_t carla_set_gpu_shared_images(
+      CarlaServerPtr self,
+      bool enable);
+
+  /** Whether the render targets can be shared in the current episode, i.e.
+    * enabled and supported by the client.
+    */
+  CARLA_SERVER_API int32_t carla_get_gpu_shared_images(
+      CarlaServerPtr self,
+      bool &enabled);
+
+  /** Publish the measurements stream to any number of read-only subscribers
+    * connected to world_port + 3 (e.g. recorders or visualizers). They
+    * receive the same messages as the agent client, and keep connected across
+    * episodes. Each subscriber queues up to @a max_queued_frames (at least 1)
+    * frames, a subscriber falling behind drops its oldest frames without
+    * stalling the simulation. Has to be called after carla_server_connect.
+    * Disabled by default.
+    *
+    * Note that images written into shared memory are not published, only
+    * subscribers in the same host can read them.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The publisher was enabled or disabled.
+    *   Any other value if the port could not be opened.
+    */
+  CARLA_SERVER_API int32_t carla_set_measurements_publisher(
+      CarlaServerPtr self,
+      bool enable,
+      uint32_t max_queued_frames);
+
+  /** Record the measurements stream in this host into @a directory (that must
+    * exist), as an append-only sequence of segment files of up to
+    * @a segment_size_mb megabytes each. Each segment holds the messages
+    * exactly as sent to the agent client, and comes with an index of the
+    * offset and size of every frame so it can be memory-mapped or replayed.
+    * Frames are written in batches by a background thread bypassing the page
+    * cache where possible, if the disk falls behind new frames are dropped
+    * without stalling the simulation. The recording goes on across episodes,
+    * new segments are numbered after the ones already in the directory.
+    * Disabled by default.
+    *
+    * Note that images written into shared memory are not recorded.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The recorder was enabled or disabled.
+    *   Any other value if the directory or segment size are invalid.
+    */
+  CARLA_SERVER_API int32_t carla_set_stream_recorder(
+      CarlaServerPtr self,
+      bool enable,
+      const char *directory,
+      uint32_t segment_size_mb);
+
+  /** Serve the metrics of the server (frames and bytes sent, dropped frames,
+    * queue depth, encode and send times, connection state) in Prometheus
+    * text format through HTTP at world_port + 4. Has to be called after
+    * carla_server_connect. Disabled by default.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The metrics server was enabled or disabled.
+    *   Any other value if the port could not be opened.
+    */
+  CARLA_SERVER_API int32_t carla_set_metrics_server(CarlaServerPtr self, bool enable);
+
+  /** Bytes held by the largest structures of the simulator, in the metrics
+    * next to those of the library (images, agents and road map buffers), and
+    * the GPU memory of the instance.
+    */
+  struct carla_memory_usage {
+    /** Pixels and distance field of the road map. */
+    uint64_t road_map;
+    /** Bitmaps of the images captured by the player. */
+    uint64_t captured_images;
+    /** Render targets of the cameras. */
+    uint64_t render_targets;
+    /** Agents kept by the spawners for the next episodes. */
+    uint64_t spawner_pools;
+    /** GPU memory of the textures of the instance. */
+    uint64_t gpu_textures;
+    /** GPU memory of the render targets of the instance. */
+    uint64_t gpu_render_targets;
+    /** Size of the texture streaming pool, zero if not limited. */
+    uint64_t gpu_texture_pool;
+  };
+
+  /** Report the memory held by the simulator, served by the metrics server
+    * until the next report. Never blocks, meant to be called periodically.
+    */
+  CARLA_SERVER_API int32_t carla_set_memory_usage(
+      CarlaServerPtr self,
+      const carla_memory_usage &values);
+
+  /** Keep the measurements and control connections open across episodes, so
+    * clients do not need to reconnect every episode. Only the protocol state
+    * is reset on each new episode, the episode ready message tells the client
+    * whether its connections were kept, and every measurements message
+    * carries the id of its episode. If the client closes any of the
+    * connections, the agent server is restarted on the next episode.
+    * Disabled by default.
+    */
+  CARLA_SERVER_API int32_t carla_set_persistent_agent_connections(
+      CarlaServerPtr self,
+      bool enable);
+
+  /** Before blocking for the next control, poll for it @a spins times pausing
+    * the CPU between checks, then @a yields times yielding the thread. Cuts
+    * the latency of a blocking read by the scheduler wake-up time, at the cost
+    * of keeping a core busy while waiting; meant for the synchronous mode.
+    * Applies to every agent from the next read. By default 0 and 0, i.e. the
+    * reader blocks right away.
+    */
+  CARLA_SERVER_API int32_t carla_set_control_wait(
+      CarlaServerPtr self,
+      uint32_t spins,
+      uint32_t yields);
+
+  /** Clients may send heartbeats, the size 0xFFFFFFFF alone in place of a
+    * message, through the world and control connections, or binary controls
+    * with the heartbeat flag once they send binary controls. Once a client
+    * sends one through a connection, reading from that connection fails if
+    * nothing arrives within @a milliseconds, instead of waiting for the
+    * server time-out. A client sending heartbeats every fraction of that is
+    * then known to be gone within @a milliseconds. Applies to every
+    * connection from its next read. By default 0, i.e. disabled.
+    */
+  CARLA_SERVER_API int32_t carla_set_liveness_timeout(
+      CarlaServerPtr self,
+      uint32_t milliseconds);
+
+  /** Number of player agents (at least 1, up to 32) sharing the world, each
+    * with its own measurements and control connections. The first agent uses
+    * world_port + 1 and + 2, agent i > 0 uses world_port + 3 + 2i and + 4 + 2i.
+    * The functions without an agent index address the first agent. Takes
+    * effect on the next episode, the episode ready message announces it. By
+    * default 1.
+    *
+    * Note that only the first agent may use shared memory images, and only
+    * its stream is published, recorded and served as metrics.
+    */
+  CARLA_SERVER_API int32_t carla_set_number_of_agents(
+      CarlaServerPtr self,
+      uint32_t number_of_agents);
+
   /* -- Write and read functions -------------------------------------------- */
 
   /** If the new episode request is received, blocks until the agent server is
@@ -221,6 +803,78 @@ extern "C" {
       carla_request_new_episode &values,
       uint32_t timeout_milliseconds);
 
+  /** The client may queue the next episode while the current one is running,
+    * to give the simulator the chance to prepare it. Queued episodes are not
+    * returned by carla_read_request_new_episode until the client starts them,
+    * this returns CARLA_SERVER_SUCCESS once for every episode queued, and
+    * CARLA_SERVER_TRY_AGAIN otherwise. Never blocks, and it is only updated
+    * by calls to carla_read_request_new_episode.
+    *
+    * The char array is valid until the next call to
+    * carla_read_request_new_episode.
+    */
+  CARLA_SERVER_API int32_t carla_read_queued_episode(
+      CarlaServerPtr self,
+      carla_request_new_episode &values);
+
+  /** The client may ask for a snapshot of the world while the episode is
+    * running, to restore it later in the same episode (e.g. to fork several
+    * rollouts from the same state). Like carla_read_queued_episode, this
+    * returns CARLA_SERVER_SUCCESS once for every request, CARLA_SERVER_TRY_AGAIN
+    * otherwise, never blocks and it is only updated by calls to
+    * carla_read_request_new_episode. Every request must be answered with
+    * carla_write_world_snapshot, the world port reads nothing else until then.
+    */
+  CARLA_SERVER_API int32_t carla_read_world_snapshot_request(
+      CarlaServerPtr self,
+      carla_world_snapshot_request &values);
+
+  /** Answer the last request read by carla_read_world_snapshot_request.
+    * Fails if there is no request pending.
+    */
+  CARLA_SERVER_API int32_t carla_write_world_snapshot(
+      CarlaServerPtr self,
+      const carla_world_snapshot &values,
+      uint32_t timeout_milliseconds);
+
+  /** The client may ask for a route between two transforms while the episode
+    * is running. Same as carla_read_world_snapshot_request, returns
+    * CARLA_SERVER_SUCCESS once for every request and never blocks. Every
+    * request must be answered with carla_write_route, the world port reads
+    * nothing else until then.
+    */
+  CARLA_SERVER_API int32_t carla_read_route_request(
+      CarlaServerPtr self,
+      carla_route_request &values);
+
+  /** Answer the last request read by carla_read_route_request. Fails if
+    * there is no request pending.
+    */
+  CARLA_SERVER_API int32_t carla_write_route(
+      CarlaServerPtr self,
+      const carla_route &values,
+      uint32_t timeout_milliseconds);
+
+  /** The client may ask for the road map while the episode is running. Same
+    * as carla_read_route_request, returns CARLA_SERVER_SUCCESS once for every
+    * request and never blocks, and every request must be answered with
+    * carla_write_road_map.
+    */
+  CARLA_SERVER_API int32_t carla_read_road_map_request(
+      CarlaServerPtr self,
+      carla_road_map_request &values);
+
+  /** Answer the last request read by carla_read_road_map_request. Fails if
+    * there is no request pending. The encoded map is kept while its hash does
+    * not change, so answering every request with the same map only costs
+    * hashing the pixels, and the client gets no pixels if it has the map
+    * already.
+    */
+  CARLA_SERVER_API int32_t carla_write_road_map(
+      CarlaServerPtr self,
+      const carla_road_map &values,
+      uint32_t timeout_milliseconds);
+
   CARLA_SERVER_API int32_t carla_write_scene_description(
       CarlaServerPtr self,
       const carla_scene_description &values,
@@ -237,6 +891,22 @@ extern "C" {
       const carla_episode_ready &values,
       const uint32_t timeout);
 
+  /** Start an episode without any client, e.g. to generate data in bulk with
+    * the simulator driving the player itself. The measurements and images
+    * written from now on (carla_write_measurements and the image buffers)
+    * are encoded as if sent to the agent client, but only fed to the stream
+    * recorder and the measurements publisher. Writing waits for the encoder
+    * rather than dropping frames. No control is ever received. Ends the
+    * current episode, if any; the offline episode lasts until the next one,
+    * the next episode requested by a client, or carla_free_server.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The episode was started.
+    *   CARLA_SERVER_OPERATION_ABORTED Neither the stream recorder nor the
+    *   measurements publisher are enabled.
+    */
+  CARLA_SERVER_API int32_t carla_start_offline_episode(CarlaServerPtr self);
+
   /** Return values:
     *   CARLA_SERVER_SUCCESS A value was readed.
     *   CARLA_SERVER_TRY_AGAIN Nothing received yet.
@@ -247,9 +917,39 @@ extern "C" {
       carla_control &values,
       uint32_t timeout_milliseconds);
 
+  /** Same as carla_read_control, but retrieves every control sent by the
+    * client in the message, carla_read_control keeps only the first one.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS A value was readed.
+    *   CARLA_SERVER_TRY_AGAIN Nothing received yet.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_read_control_batch(
+      CarlaServerPtr self,
+      carla_control_batch &values,
+      uint32_t timeout_milliseconds);
+
+  /** Latest control received in the current episode, for asynchronous mode.
+    * Never blocks and does not consume the control: carla_read_control still
+    * returns it, and calling this again returns it until a newer one arrives.
+    * status tells how old the control is, so the game may hold, decay or
+    * extrapolate it.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS A control was read.
+    *   CARLA_SERVER_TRY_AGAIN No control received in this episode yet.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_read_latest_control(
+      CarlaServerPtr self,
+      carla_control &values,
+      carla_control_status &status);
+
   /** Return values:
     *   CARLA_SERVER_SUCCESS Value was posted for sending.
     *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    *   Any other value if an image has an unknown encoding or compression.
     */
   CARLA_SERVER_API int32_t carla_write_measurements(
       CarlaServerPtr self,
@@ -257,6 +957,331 @@ extern "C" {
       const struct carla_image *images,
       uint32_t number_of_images);
 
+  /* -- Multiple agents ----------------------------------------------------- */
+
+  /** Same as carla_read_control_batch, for the agent at @a agent_index, see
+    * carla_set_number_of_agents. Each agent holds its own array.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS A value was readed.
+    *   CARLA_SERVER_TRY_AGAIN Nothing received yet.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_read_agent_control_batch(
+      CarlaServerPtr self,
+      uint32_t agent_index,
+      carla_control_batch &values,
+      uint32_t timeout_milliseconds);
+
+  /** Same as carla_write_measurements, for the agent at @a agent_index.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS Value was posted for sending.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    *   Any other value if an image has an unknown encoding or compression.
+    */
+  CARLA_SERVER_API int32_t carla_write_agent_measurements(
+      CarlaServerPtr self,
+      uint32_t agent_index,
+      const carla_measurements &values,
+      const struct carla_image *images,
+      uint32_t number_of_images);
+
+  /** Same as carla_get_measurements_stats, for the agent at @a agent_index.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS Stats of the current episode were retrieved.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_get_agent_measurements_stats(
+      CarlaServerPtr self,
+      uint32_t agent_index,
+      carla_stream_stats &stats);
+
+  /** Same as carla_write_measurements, but the non-player agents are given as
+    * carla_agent_arrays, the non_player_agents of values are ignored.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS Value was posted for sending.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    *   Any other value if an image has an unknown encoding or compression,
+    *   or an array of agents is null.
+    */
+  CARLA_SERVER_API int32_t carla_write_measurements_arrays(
+      CarlaServerPtr self,
+      const carla_measurements &values,
+      const carla_agent_arrays &agents,
+      const struct carla_image *images,
+      uint32_t number_of_images);
+
+  /** Called by the server with the given user_data once it no longer needs
+    * the memory handed over with carla_write_measurements_leased. It may be
+    * called from any thread of the server, and must not call the server.
+    */
+  typedef void (*carla_release_callback)(void *user_data);
+
+  /** Same as carla_write_measurements, but neither the agents nor the images
+    * are copied in this call. The server only keeps the pointers, and copies
+    * the data later in its own writer thread.
+    *
+    * On success, the agents of values and the images and their pixels must
+    * stay valid and unchanged until release is called with user_data. This
+    * happens exactly once, when the frame has been copied, dropped, or the
+    * agent server is terminated. On failure release is never called.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS Value was posted for sending.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    *   Any other value if an image has an unknown encoding or compression.
+    */
+  CARLA_SERVER_API int32_t carla_write_measurements_leased(
+      CarlaServerPtr self,
+      const carla_measurements &values,
+      const struct carla_image *images,
+      uint32_t number_of_images,
+      carla_release_callback release,
+      void *user_data);
+
+  /** Outcome of a measurements write, see carla_write_measurements_async. */
+  struct carla_write_completion {
+    /** Token given to carla_write_measurements_async. */
+    uint64_t token;
+    /** CARLA_SERVER_SUCCESS if the frame was sent to the client,
+      * CARLA_SERVER_OPERATION_ABORTED if it was dropped or the agent server
+      * was terminated before sending it, or the error of the send.
+      */
+    int32_t result;
+  };
+
+  /** Same as carla_write_measurements, and once the frame is sent, dropped,
+    * or the agent server is terminated, a completion carrying token is queued
+    * to be reaped with carla_poll_write_completions. Every successful call
+    * produces exactly one completion, on failure none is produced.
+    *
+    * The data is copied in this call as in carla_write_measurements; this
+    * does not wait for the frame to be sent either.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS Value was posted for sending.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    *   Any other value if an image has an unknown encoding or compression.
+    */
+  CARLA_SERVER_API int32_t carla_write_measurements_async(
+      CarlaServerPtr self,
+      const carla_measurements &values,
+      const struct carla_image *images,
+      uint32_t number_of_images,
+      uint64_t token);
+
+  /** Move up to max_completions pending completions of
+    * carla_write_measurements_async into completions, oldest first, and set
+    * number_of_completions to how many were moved. Never blocks.
+    *
+    * Completions survive the agent server, those of the frames of a
+    * terminated agent server are reaped here too.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS At least one completion was moved.
+    *   CARLA_SERVER_TRY_AGAIN No completion pending.
+    */
+  CARLA_SERVER_API int32_t carla_poll_write_completions(
+      CarlaServerPtr self,
+      struct carla_write_completion *completions,
+      uint32_t max_completions,
+      uint32_t &number_of_completions);
+
+  /** Zero-copy alternative to carla_write_measurements.
+    *
+    * Lock a buffer owned by the server big enough to hold the given images.
+    * Every field of each image is read but the data pointer, which is ignored.
+    * On success, image_data (an array of number_of_images pointers)
+    * is filled with the locations inside the server's buffer where the pixels
+    * of each image have to be written.
+    *
+    * These locations are valid until carla_commit_image_buffer is called or
+    * the agent server is terminated.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The buffer was acquired.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    *   Any other value if an image has an unknown encoding or compression.
+    */
+  CARLA_SERVER_API int32_t carla_acquire_image_buffer(
+      CarlaServerPtr self,
+      const struct carla_image *images,
+      uint32_t number_of_images,
+      uint32_t **image_data);
+
+  /** Post the measurements together with the images previously written into
+    * the buffer returned by carla_acquire_image_buffer.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS Value was posted for sending.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_commit_image_buffer(
+      CarlaServerPtr self,
+      const carla_measurements &values);
+
+  /** Attach @a timing to the next measurements written or committed, only
+    * these measurements carry a timing block. The server-side fields of
+    * @a timing are ignored, they are filled when the measurements are sent.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The timing will be sent.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_set_frame_timing(
+      CarlaServerPtr self,
+      const carla_frame_timing &timing);
+
+  /** Tell that the control with @a sequence_number, of the last batch read,
+    * was applied to the player now. The measurements written from now on
+    * echo it back to the client, with the times the control was received
+    * and applied and the measurements written and sent. A zero
+    * @a sequence_number is ignored.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The control will be echoed back.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_set_applied_control(
+      CarlaServerPtr self,
+      uint64_t sequence_number);
+
+  /** Attach the boxes of the agents seen by each of the given cameras to the
+    * next measurements written or committed, only these measurements carry
+    * them. The boxes are copied in this call.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The boxes will be sent.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_set_agent_boxes(
+      CarlaServerPtr self,
+      const struct carla_camera_agent_boxes *cameras,
+      uint32_t number_of_cameras);
+
+  /** Attach the per-label pixel counts of the given cameras to the next
+    * measurements written or committed, as carla_set_agent_boxes. The counts
+    * are copied in this call.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The histograms will be sent.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_set_class_histograms(
+      CarlaServerPtr self,
+      const struct carla_class_histogram *histograms,
+      uint32_t number_of_histograms);
+
+  /** Attach the collisions of the player during the last frame to the next
+    * measurements written or committed, as carla_set_agent_boxes. The events
+    * are copied in this call.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The events will be sent.
+    *   CARLA_SERVER_OPERATION_ABORTED Agent server is missing.
+    */
+  CARLA_SERVER_API int32_t carla_set_collision_events(
+      CarlaServerPtr self,
+      const struct carla_collision_event *events,
+      uint32_t number_of_events);
+
+  /* -- Profiling ----------------------------------------------------------- */
+
+  /** Start (or stop) capturing an event for every profiled scope of the
+    * server, each thread keeps its last events_per_thread events. Events are
+    * tagged with the frame number of the last measurements written.
+    */
+  CARLA_SERVER_API void carla_set_profiler_event_capture(
+      bool enable,
+      uint32_t events_per_thread);
+
+  /** Write the events captured so far as Chrome trace JSON, it can be opened
+    * with chrome://tracing or the Perfetto UI.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The trace was written.
+    *   Any other value if the file could not be written.
+    */
+  CARLA_SERVER_API int32_t carla_dump_profiler_trace(const char *filename);
+
+  /* -- Logging ------------------------------------------------------------- */
+
+#define CARLA_SERVER_LOG_DEBUG     10
+#define CARLA_SERVER_LOG_INFO      20
+#define CARLA_SERVER_LOG_WARNING   30
+#define CARLA_SERVER_LOG_ERROR     40
+#define CARLA_SERVER_LOG_CRITICAL  50
+#define CARLA_SERVER_LOG_NONE     100
+
+  /** Discard the log messages of the server below level, one of
+    * CARLA_SERVER_LOG_*. Levels below the one the server was compiled with
+    * cannot be enabled.
+    */
+  CARLA_SERVER_API void carla_set_log_level(int32_t level);
+
+  /** Log through a background thread instead of printing on the spot, so
+    * logging does not block the server threads. Disabling it flushes the
+    * messages queued.
+    */
+  CARLA_SERVER_API void carla_set_async_logging(bool enable);
+
+  /* -- Threads ------------------------------------------------------------- */
+
+  struct carla_thread_options {
+    /** CPUs the threads may run on, any if empty. */
+    const uint32_t *cpus;
+    uint32_t number_of_cpus;
+    /** Nice value, from -20 (highest priority) to 19, 0 by default. Negative
+      * values usually need privileges.
+      */
+    int32_t priority;
+  };
+
+  /** Pin the I/O threads of every server in this process to the given CPUs and
+    * set their priority. Applies to the threads running and to those started
+    * later. Only supported on Linux.
+    *
+    * Return values:
+    *   CARLA_SERVER_SUCCESS The options were applied to every thread.
+    *   Any other value if the options are invalid, or could not be applied to
+    *   some thread (e.g. missing privileges), the rest are still applied.
+    */
+  CARLA_SERVER_API int32_t carla_set_thread_options(const carla_thread_options &options);
+
+  /* -- Memory -------------------------------------------------------------- */
+
+  struct carla_buffer_options {
+    /** Back the frame buffers with 2 MiB pages (large pages on Windows, which
+      * need the "Lock pages in memory" privilege). If none are reserved in the
+      * system, transparent huge pages are requested instead.
+      */
+    bool huge_pages;
+    /** Place the frame buffers in the NUMA node of the thread writing the
+      * measurements.
+      */
+    bool numa_local;
+  };
+
+  /** Allocation of the buffers holding the images and the non-player agents of
+    * every server in this process, from 2 MiB on. Applies to the buffers
+    * allocated afterwards, i.e. on the next episode or the next time a frame
+    * outgrows its buffer. Both disabled by default. Buffers fall back to the
+    * heap if they cannot be allocated as requested.
+    */
+  CARLA_SERVER_API void carla_set_buffer_options(const carla_buffer_options &options);
+
+  /* -- Startup ------------------------------------------------------------- */
+
+  /** Record that the startup phase named @a phase ended @a seconds_since_start
+    * after the process started. Served as carla_startup_phase_seconds by the
+    * metrics of every server in this process. Only the first time each phase
+    * ends is kept, so the later episodes do not overwrite the cold start.
+    */
+  CARLA_SERVER_API void carla_mark_startup_phase(const char *phase, double seconds_since_start);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+
+#include <carla/server/AgentsDelta.h>
+#include <carla/server/CarlaEncoder.h>
+
+#include <cstring>
+#include <vector>
+
+using namespace carla::server;
+
+/// Measurements of a player surrounded by @a number_of_agents vehicles spread
+/// on a grid, so every agent has different values.
+static std::vector<carla_agent> MakeAgents(const size_t number_of_agents) {
+  std::vector<carla_agent> agents(number_of_agents);
+  std::memset(agents.data(), 0, sizeof(carla_agent) * agents.size());
+  for (auto i = 0u; i < agents.size(); ++i) {
+    agents[i].id = i + 1u;
+    agents[i].type = CARLA_SERVER_AGENT_VEHICLE;
+    agents[i].transform.location = {100.0f * (i % 32u), 100.0f * (i / 32u), 0.0f};
+    agents[i].transform.orientation = {1.0f, 0.0f, 0.0f};
+    agents[i].box_extent = {200.0f, 100.0f, 80.0f};
+    agents[i].forward_speed = 0.1f * i;
+  }
+  return agents;
+}
+
+/// Encodes the measurements into the reused buffer, as the measurements stream
+/// does. Arguments: number of agents, packed agents.
+static void BM_EncodeMeasurements(benchmark::State &state) {
+  const auto agents = MakeAgents(static_cast<size_t>(state.range(0)));
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  measurements.non_player_agents = agents.data();
+  measurements.number_of_non_player_agents = static_cast<uint32_t>(agents.size());
+  const auto frames = carla::array_view::make_const<uint64_t>(nullptr, 0u);
+  const auto cameras = carla::array_view::make_const<uint32_t>(nullptr, 0u);
+
+  CarlaEncoder encoder;
+  encoder.SetPackedAgents(state.range(1) != 0);
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  size_t bytes = 0u;
+  for (auto _ : state) {
+    ++measurements.frame_number;
+    const auto encoded = encoder.Encode(measurements, frames, cameras, buffer, delta);
+    benchmark::DoNotOptimize(encoded.data());
+    bytes += encoded.size();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+BENCHMARK(BM_EncodeMeasurements)
+    ->ArgNames({"agents", "packed"})
+    ->Args({0, 0})
+    ->Args({100, 0})
+    ->Args({1000, 0})
+    ->Args({100, 1})
+    ->Args({1000, 1});
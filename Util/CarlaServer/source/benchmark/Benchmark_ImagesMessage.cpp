@@ -0,0 +1,49 @@
+#include <benchmark/benchmark.h>
+
+#include <carla/server/ImagesMessage.h>
+
+#include <vector>
+
+using namespace carla::server;
+
+/// Copies a single camera image into the message. Arguments: width, height,
+/// and one of CARLA_SERVER_IMAGE_COMPRESSION_*.
+static void BM_ImagesMessageWrite(benchmark::State &state) {
+  const auto width = static_cast<uint32_t>(state.range(0));
+  const auto height = static_cast<uint32_t>(state.range(1));
+  const auto compression = static_cast<uint32_t>(state.range(2));
+  // A gradient, so compression has something to do but does not collapse.
+  std::vector<uint32_t> pixels(width * height);
+  for (auto i = 0u; i < pixels.size(); ++i) {
+    pixels[i] = 0xff000000u | ((i % width) * 0x010101u & 0x00ffffffu);
+  }
+  const carla_image image = {
+      width,
+      height,
+      0u,
+      pixels.data(),
+      0u,
+      0u,
+      CARLA_SERVER_IMAGE_BGRA8,
+      compression,
+      0u,
+      0u,
+      0u};
+
+  ImagesMessage message;
+  std::vector<unsigned char> encode_buffer;
+  for (auto _ : state) {
+    message.Write(carla::array_view::make_const(&image, 1u));
+    // Compression happens when encoding, right before sending.
+    benchmark::DoNotOptimize(message.Encode(encode_buffer));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * sizeof(uint32_t) * pixels.size());
+}
+
+BENCHMARK(BM_ImagesMessageWrite)
+    ->ArgNames({"width", "height", "compression"})
+    ->Args({800, 600, CARLA_SERVER_IMAGE_COMPRESSION_NONE})
+    ->Args({1280, 720, CARLA_SERVER_IMAGE_COMPRESSION_NONE})
+    ->Args({1920, 1080, CARLA_SERVER_IMAGE_COMPRESSION_NONE})
+    ->Args({800, 600, CARLA_SERVER_IMAGE_COMPRESSION_LZ4})
+    ->Args({1920, 1080, CARLA_SERVER_IMAGE_COMPRESSION_LZ4});
@@ -0,0 +1,65 @@
+#include <benchmark/benchmark.h>
+
+#include <carla/server/TCPServer.h>
+
+#include <boost/asio/ip/tcp.hpp>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace carla::server;
+
+static constexpr uint32_t BENCHMARK_PORT = 4300u;
+
+/// Connects to the server at @a port on loopback, retrying until the server
+/// is listening, and reads until the server closes the connection.
+static void DrainClient(const uint32_t port) {
+  using boost::asio::ip::tcp;
+  boost::asio::io_service service;
+  tcp::socket socket(service);
+  const tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+  boost::system::error_code ec;
+  for (auto attempt = 0u; attempt < 100u; ++attempt) {
+    socket.connect(endpoint, ec);
+    if (!ec) {
+      break;
+    }
+    socket.close();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::vector<char> data(1u << 16u);
+  while (!ec) {
+    socket.read_some(boost::asio::buffer(data), ec);
+  }
+}
+
+/// Throughput of the blocking Write over a loopback connection. Argument:
+/// size of each write in bytes.
+static void BM_TCPServerLoopbackWrite(benchmark::State &state) {
+  const auto port = BENCHMARK_PORT;
+  std::thread client(DrainClient, port);
+  const auto timeout = boost::posix_time::seconds(10);
+  TCPServer server;
+  if (server.Connect(port, timeout)) {
+    state.SkipWithError("unable to connect");
+  } else {
+    const std::vector<char> data(static_cast<size_t>(state.range(0)), 'x');
+    for (auto _ : state) {
+      if (server.Write(boost::asio::buffer(data), timeout)) {
+        state.SkipWithError("write failed");
+        break;
+      }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+  }
+  server.Disconnect();
+  client.join();
+}
+
+BENCHMARK(BM_TCPServerLoopbackWrite)
+    ->ArgName("bytes")
+    ->Arg(1024)
+    ->Arg(64 * 1024)
+    ->Arg(1920 * 1080 * 4)
+    ->UseRealTime();
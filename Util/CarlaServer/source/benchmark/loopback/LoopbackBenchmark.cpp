@@ -0,0 +1,428 @@
+// End-to-end benchmark of the CarlaServer library: a simulated game drives the
+// C API with synthetic measurements and images, and a native client in the
+// same process consumes the streams over loopback.
+//
+// Usage: loopback_benchmark_carlaserver [--port 2000] [--frames 1000]
+//            [--cameras 1] [--width 800] [--height 600] [--agents 0]
+//            [--compression none|lz4] [--mode sync|async]
+//            [--write copy|leased]
+//
+// In sync mode the game waits for the control of every frame before writing
+// the next one, in async mode it writes as fast as it can and frames may be
+// dropped by the server.
+//
+// With --write leased the frames are written with
+// carla_write_measurements_leased, so the game thread does not copy them.
+
+#include <carla/carla_server.h>
+#include <carla/server/carla_server.pb.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <time.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cs = carla_server;
+using boost::asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+static constexpr uint32_t TIMEOUT = 10u * 1000u;
+
+// =============================================================================
+// -- Options ------------------------------------------------------------------
+// =============================================================================
+
+struct Options {
+  uint32_t port = 2000u;
+  uint32_t frames = 1000u;
+  uint32_t cameras = 1u;
+  uint32_t width = 800u;
+  uint32_t height = 600u;
+  uint32_t agents = 0u;
+  uint32_t compression = CARLA_SERVER_IMAGE_COMPRESSION_NONE;
+  bool sync = true;
+  bool leased = false;
+};
+
+static Options ParseOptions(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      std::cout << "usage: " << argv[0] << " [--port N] [--frames N] [--cameras N] "
+                   "[--width N] [--height N] [--agents N] [--compression none|lz4] "
+                   "[--mode sync|async] [--write copy|leased]\n";
+      std::exit(0);
+    }
+    if (i + 1 == argc) {
+      throw std::invalid_argument("missing value for " + arg);
+    }
+    const std::string value = argv[++i];
+    auto number = [&]() { return static_cast<uint32_t>(std::stoul(value)); };
+    if (arg == "--port") {
+      options.port = number();
+    } else if (arg == "--frames") {
+      options.frames = std::max(number(), 1u);
+    } else if (arg == "--cameras") {
+      options.cameras = number();
+    } else if (arg == "--width") {
+      options.width = number();
+    } else if (arg == "--height") {
+      options.height = number();
+    } else if (arg == "--agents") {
+      options.agents = number();
+    } else if ((arg == "--compression") && (value == "none" || value == "lz4")) {
+      options.compression = (value == "lz4" ?
+          CARLA_SERVER_IMAGE_COMPRESSION_LZ4 :
+          CARLA_SERVER_IMAGE_COMPRESSION_NONE);
+    } else if ((arg == "--mode") && (value == "sync" || value == "async")) {
+      options.sync = (value == "sync");
+    } else if ((arg == "--write") && (value == "copy" || value == "leased")) {
+      options.leased = (value == "leased");
+    } else {
+      throw std::invalid_argument("invalid option " + arg + " " + value);
+    }
+  }
+  return options;
+}
+
+// =============================================================================
+// -- Helpers ------------------------------------------------------------------
+// =============================================================================
+
+/// CPU time consumed so far by the process (@a clock CLOCK_PROCESS_CPUTIME_ID)
+/// or by the calling thread (CLOCK_THREAD_CPUTIME_ID), in seconds.
+static double CpuSeconds(const clockid_t clock) {
+  timespec time;
+  clock_gettime(clock, &time);
+  return static_cast<double>(time.tv_sec) + 1e-9 * static_cast<double>(time.tv_nsec);
+}
+
+static int64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      clock_type::now().time_since_epoch()).count();
+}
+
+static void Check(const int32_t ec, const char *what) {
+  if (ec != CARLA_SERVER_SUCCESS) {
+    throw std::runtime_error(std::string(what) + " failed with error " + std::to_string(ec));
+  }
+}
+
+static const std::string &ReadMessage(tcp::socket &socket, std::string &message) {
+  uint32_t size;
+  boost::asio::read(socket, boost::asio::buffer(&size, sizeof(size)));
+  message.resize(size);
+  if (size > 0u) {
+    boost::asio::read(socket, boost::asio::buffer(&message[0u], size));
+  }
+  return message;
+}
+
+static void WriteMessage(tcp::socket &socket, const std::string &message) {
+  const uint32_t size = static_cast<uint32_t>(message.size());
+  const std::array<boost::asio::const_buffer, 2u> buffers = {{
+      boost::asio::buffer(&size, sizeof(size)),
+      boost::asio::buffer(message)}};
+  boost::asio::write(socket, buffers);
+}
+
+static void Connect(tcp::socket &socket, const uint32_t port) {
+  const tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+  for (auto i = 0u; i < 200u; ++i) {
+    boost::system::error_code ec;
+    socket.connect(endpoint, ec);
+    if (!ec) {
+      socket.set_option(tcp::no_delay(true));
+      return;
+    }
+    socket.close();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  throw std::runtime_error("unable to connect to port " + std::to_string(port));
+}
+
+// =============================================================================
+// -- Shared state -------------------------------------------------------------
+// =============================================================================
+
+/// Written by the game thread, read by the client thread.
+struct SharedState {
+  explicit SharedState(const uint32_t frames) : write_time(frames) {
+    for (auto &time : write_time) {
+      time = 0;
+    }
+  }
+
+  /// Time at which the game started writing each frame, the latency of a
+  /// frame is measured from here until the client received its images.
+  std::vector<std::atomic<int64_t>> write_time;
+
+  std::atomic_bool client_done{false};
+
+  /// Time the game thread spent in the write calls, in nanoseconds.
+  std::atomic<int64_t> game_write_time{0};
+
+  /// Leases not yet released by the server, see --write leased.
+  std::atomic<uint32_t> pending_leases{0u};
+};
+
+struct ClientResult {
+  uint32_t frames_received = 0u;
+
+  uint64_t bytes_received = 0u;
+
+  /// Latency of each frame received, in microseconds.
+  std::vector<double> latencies;
+
+  double wall_seconds = 0.0;
+
+  double cpu_seconds = 0.0;
+};
+
+// =============================================================================
+// -- Client -------------------------------------------------------------------
+// =============================================================================
+
+static ClientResult RunClient(const Options &options, SharedState &state) {
+  boost::asio::io_service service;
+  tcp::socket world(service);
+  tcp::socket measurements(service);
+  tcp::socket control(service);
+  std::string message;
+
+  Connect(world, options.port);
+  WriteMessage(world, cs::RequestNewEpisode().SerializeAsString());
+  ReadMessage(world, message); // scene description.
+  WriteMessage(world, cs::EpisodeStart().SerializeAsString());
+  cs::EpisodeReady ready;
+  if (!ready.ParseFromString(ReadMessage(world, message)) || !ready.ready()) {
+    throw std::runtime_error("episode not ready");
+  }
+  Connect(measurements, options.port + 1u);
+  Connect(control, options.port + 2u);
+
+  ClientResult result;
+  result.latencies.reserve(options.frames);
+  const auto control_message = cs::Control().SerializeAsString();
+  const auto cpu_start = CpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+  const auto wall_start = clock_type::now();
+  const uint64_t last_frame = options.frames - 1u;
+  uint64_t frame_number = 0u;
+  cs::Measurements parsed;
+  try {
+    while (frame_number < last_frame) {
+      if (!parsed.ParseFromString(ReadMessage(measurements, message))) {
+        throw std::runtime_error("invalid measurements");
+      }
+      result.bytes_received += message.size();
+      result.bytes_received += ReadMessage(measurements, message).size(); // images.
+      const auto received = Now();
+      frame_number = parsed.frame_number();
+      if (frame_number < state.write_time.size()) {
+        const auto written = state.write_time[frame_number].load();
+        result.latencies.emplace_back(1e-3 * static_cast<double>(received - written));
+      }
+      ++result.frames_received;
+      WriteMessage(control, control_message);
+    }
+  } catch (const boost::system::system_error &) {
+    // The server gave up on us, report what we got.
+  }
+  result.wall_seconds = std::chrono::duration<double>(clock_type::now() - wall_start).count();
+  result.cpu_seconds = CpuSeconds(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+  state.client_done = true;
+  return result;
+}
+
+// =============================================================================
+// -- Game ---------------------------------------------------------------------
+// =============================================================================
+
+static void RunGame(const Options &options, SharedState &state) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto guard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr server = guard.get();
+
+  Check(carla_server_connect(server, options.port, TIMEOUT), "connect");
+  {
+    carla_request_new_episode values;
+    Check(carla_read_request_new_episode(server, values, TIMEOUT), "read new episode");
+  }
+  {
+    const carla_transform start_locations[] = {
+      {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{1.0f, 0.0f, 0.0f}}
+    };
+    const carla_scene_description values{start_locations, 1u, nullptr};
+    Check(carla_write_scene_description(server, values, TIMEOUT), "write scene");
+  }
+  {
+    carla_episode_start values;
+    Check(carla_read_episode_start(server, values, TIMEOUT), "read episode start");
+  }
+  {
+    const carla_episode_ready values{true};
+    Check(carla_write_episode_ready(server, values, TIMEOUT), "write episode ready");
+  }
+
+  // Synthetic frame: a gradient per camera and a grid of vehicles.
+  std::vector<uint32_t> pixels(options.width * options.height);
+  for (auto i = 0u; i < pixels.size(); ++i) {
+    pixels[i] = 0xff000000u | ((i % std::max(options.width, 1u)) * 0x010101u & 0x00ffffffu);
+  }
+  std::vector<carla_image> images(options.cameras);
+  for (auto i = 0u; i < images.size(); ++i) {
+    images[i] = carla_image{
+        options.width,
+        options.height,
+        0u,
+        pixels.data(),
+        0u,
+        i,
+        CARLA_SERVER_IMAGE_BGRA8,
+        options.compression,
+        0u,
+        0u,
+        0u};
+  }
+  std::vector<carla_agent> agents(options.agents);
+  std::memset(agents.data(), 0, sizeof(carla_agent) * agents.size());
+  for (auto i = 0u; i < agents.size(); ++i) {
+    agents[i].id = i + 1u;
+    agents[i].type = CARLA_SERVER_AGENT_VEHICLE;
+    agents[i].transform.location = {100.0f * (i % 32u), 100.0f * (i / 32u), 0.0f};
+    agents[i].transform.orientation = {1.0f, 0.0f, 0.0f};
+    agents[i].box_extent = {200.0f, 100.0f, 80.0f};
+  }
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  measurements.non_player_agents = agents.data();
+  measurements.number_of_non_player_agents = options.agents;
+
+  // The agents and pixels never change, so every lease refers to the same
+  // memory and releasing it only needs to be counted.
+  const auto release = [](void *user_data) {
+    --static_cast<SharedState *>(user_data)->pending_leases;
+  };
+
+  for (auto frame = 0u; frame < options.frames; ++frame) {
+    const auto write_start = Now();
+    state.write_time[frame] = write_start;
+    measurements.frame_number = frame;
+    measurements.game_timestamp = frame;
+    for (auto &image : images) {
+      image.frame_number = frame;
+    }
+    if (options.leased) {
+      ++state.pending_leases;
+      const auto ec = carla_write_measurements_leased(
+          server, measurements, images.data(), options.cameras, release, &state);
+      if (ec != CARLA_SERVER_SUCCESS) {
+        --state.pending_leases;
+      }
+      Check(ec, "write measurements");
+    } else {
+      Check(carla_write_measurements(server, measurements, images.data(), options.cameras),
+            "write measurements");
+    }
+    state.game_write_time += Now() - write_start;
+    carla_control control;
+    if (options.sync) {
+      int32_t ec;
+      do {
+        ec = carla_read_control(server, control, TIMEOUT);
+      } while ((ec == CARLA_SERVER_TRY_AGAIN) && !state.client_done);
+      Check(ec, "read control");
+    } else {
+      carla_read_control(server, control, 0u);
+    }
+  }
+
+  // In async mode the client may still be receiving.
+  const auto deadline = clock_type::now() + std::chrono::milliseconds(TIMEOUT);
+  while (!state.client_done && (clock_type::now() < deadline)) {
+    carla_control control;
+    carla_read_control(server, control, 10u);
+  }
+
+  // Free the server while the leased memory is still alive, it releases every
+  // lease pending.
+  guard.reset();
+  if (state.pending_leases != 0u) {
+    throw std::runtime_error("leases not released by the server");
+  }
+}
+
+// =============================================================================
+// -- Report -------------------------------------------------------------------
+// =============================================================================
+
+static double Percentile(const std::vector<double> &sorted, const double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const auto index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1u) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1u)];
+}
+
+static void Report(
+    const Options &options,
+    const SharedState &state,
+    ClientResult &result,
+    const double process_cpu_seconds) {
+  std::sort(result.latencies.begin(), result.latencies.end());
+  const auto frames = std::max(result.frames_received, 1u);
+  const auto seconds = std::max(result.wall_seconds, 1e-9);
+  std::cout << std::fixed << std::setprecision(2)
+            << "mode:            " << (options.sync ? "sync" : "async")
+            << (options.leased ? ", leased writes" : "") << '\n'
+            << "cameras:         " << options.cameras << " x " << options.width << 'x' << options.height
+            << (options.compression == CARLA_SERVER_IMAGE_COMPRESSION_LZ4 ? " lz4" : "") << '\n'
+            << "agents:          " << options.agents << '\n'
+            << "frames:          " << result.frames_received << " received of " << options.frames << " written\n"
+            << "throughput:      " << result.frames_received / seconds << " frames/s, "
+            << 1e-6 * static_cast<double>(result.bytes_received) / seconds << " MB/s\n"
+            << "latency (us):    min " << Percentile(result.latencies, 0.0)
+            << "  p50 " << Percentile(result.latencies, 0.5)
+            << "  p90 " << Percentile(result.latencies, 0.9)
+            << "  p99 " << Percentile(result.latencies, 0.99)
+            << "  max " << Percentile(result.latencies, 1.0) << '\n'
+            << "cpu/frame (us):  total " << 1e6 * process_cpu_seconds / frames
+            << "  client " << 1e6 * result.cpu_seconds / frames
+            << "  server " << 1e6 * (process_cpu_seconds - result.cpu_seconds) / frames << '\n'
+            << "write call (us): " << 1e-3 * static_cast<double>(state.game_write_time) / options.frames << '\n';
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+    const auto options = ParseOptions(argc, argv);
+    SharedState state(options.frames);
+    const auto cpu_start = CpuSeconds(CLOCK_PROCESS_CPUTIME_ID);
+    auto client = std::async(std::launch::async, [&]() { return RunClient(options, state); });
+    RunGame(options, state);
+    auto result = client.get();
+    Report(options, state, result, CpuSeconds(CLOCK_PROCESS_CPUTIME_ID) - cpu_start);
+  } catch (const std::exception &e) {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
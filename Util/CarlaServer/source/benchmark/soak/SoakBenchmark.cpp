@@ -0,0 +1,529 @@
+// Soak benchmark of the CarlaServer library: a simulated game drives the C API
+// through thousands of episodes, and a native client in the same process
+// requests each episode, streams a number of frames and requests the next one,
+// so the agent server is torn down and started again every time. The process
+// is sampled every few episodes, and the run fails if memory, allocations,
+// threads or latency drift from the first window sampled after warm-up.
+//
+// Usage: soak_benchmark_carlaserver [--port 2000] [--episodes 2000]
+//            [--frames 100] [--window 50] [--cameras 1] [--width 400]
+//            [--height 300] [--agents 20] [--compression none|lz4]
+//            [--max-rss-growth 64] [--max-allocation-growth 10000]
+//            [--max-thread-growth 0] [--max-latency-ratio 3]
+//
+// Each window prints a row with the resident memory, the heap allocations
+// alive and made per frame, the number of threads and the latency
+// percentiles of the frames of its episodes. Allocations are counted by
+// replacing the global operator new of this executable, they include those of
+// the client.
+
+#include <carla/carla_server.h>
+#include <carla/client/CarlaClient.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+static constexpr uint32_t TIMEOUT = 10u * 1000u;
+
+/// Frames in flight tracked for the latency, only one is in sync mode.
+static constexpr uint32_t WRITE_TIME_SLOTS = 64u;
+
+// =============================================================================
+// -- Allocation counting ------------------------------------------------------
+// =============================================================================
+
+static std::atomic<uint64_t> g_allocations{0u};
+
+static std::atomic<int64_t> g_live_allocations{0};
+
+static void *Allocate(const size_t size) noexcept {
+  void *ptr = std::malloc(size == 0u ? 1u : size);
+  if (ptr != nullptr) {
+    ++g_allocations;
+    ++g_live_allocations;
+  }
+  return ptr;
+}
+
+static void Deallocate(void *ptr) noexcept {
+  if (ptr != nullptr) {
+    --g_live_allocations;
+    std::free(ptr);
+  }
+}
+
+void *operator new(const size_t size) {
+  void *ptr = Allocate(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](const size_t size) {
+  return ::operator new(size);
+}
+
+void *operator new(const size_t size, const std::nothrow_t &) noexcept {
+  return Allocate(size);
+}
+
+void *operator new[](const size_t size, const std::nothrow_t &) noexcept {
+  return Allocate(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  Deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  Deallocate(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  Deallocate(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+  Deallocate(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  Deallocate(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  Deallocate(ptr);
+}
+
+// =============================================================================
+// -- Options ------------------------------------------------------------------
+// =============================================================================
+
+struct Options {
+  uint32_t port = 2000u;
+  uint32_t episodes = 2000u;
+  uint32_t frames = 100u;
+  uint32_t window = 50u;
+  uint32_t cameras = 1u;
+  uint32_t width = 400u;
+  uint32_t height = 300u;
+  uint32_t agents = 20u;
+  uint32_t compression = CARLA_SERVER_IMAGE_COMPRESSION_LZ4;
+  /// In megabytes.
+  double max_rss_growth = 64.0;
+  int64_t max_allocation_growth = 10000;
+  int64_t max_thread_growth = 0;
+  /// Of the p50 and the p99 latency of the last window to those of the
+  /// baseline window.
+  double max_latency_ratio = 3.0;
+};
+
+static Options ParseOptions(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      std::cout << "usage: " << argv[0] << " [--port N] [--episodes N] [--frames N] "
+                   "[--window N] [--cameras N] [--width N] [--height N] [--agents N] "
+                   "[--compression none|lz4] [--max-rss-growth MB] "
+                   "[--max-allocation-growth N] [--max-thread-growth N] "
+                   "[--max-latency-ratio X]\n";
+      std::exit(0);
+    }
+    if (i + 1 == argc) {
+      throw std::invalid_argument("missing value for " + arg);
+    }
+    const std::string value = argv[++i];
+    auto number = [&]() { return static_cast<uint32_t>(std::stoul(value)); };
+    if (arg == "--port") {
+      options.port = number();
+    } else if (arg == "--episodes") {
+      options.episodes = std::max(number(), 1u);
+    } else if (arg == "--frames") {
+      options.frames = std::max(number(), 1u);
+    } else if (arg == "--window") {
+      options.window = std::max(number(), 1u);
+    } else if (arg == "--cameras") {
+      options.cameras = number();
+    } else if (arg == "--width") {
+      options.width = number();
+    } else if (arg == "--height") {
+      options.height = number();
+    } else if (arg == "--agents") {
+      options.agents = number();
+    } else if ((arg == "--compression") && (value == "none" || value == "lz4")) {
+      options.compression = (value == "lz4" ?
+          CARLA_SERVER_IMAGE_COMPRESSION_LZ4 :
+          CARLA_SERVER_IMAGE_COMPRESSION_NONE);
+    } else if (arg == "--max-rss-growth") {
+      options.max_rss_growth = std::stod(value);
+    } else if (arg == "--max-allocation-growth") {
+      options.max_allocation_growth = std::stoll(value);
+    } else if (arg == "--max-thread-growth") {
+      options.max_thread_growth = std::stoll(value);
+    } else if (arg == "--max-latency-ratio") {
+      options.max_latency_ratio = std::stod(value);
+    } else {
+      throw std::invalid_argument("invalid option " + arg + " " + value);
+    }
+  }
+  return options;
+}
+
+// =============================================================================
+// -- Helpers ------------------------------------------------------------------
+// =============================================================================
+
+static int64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      clock_type::now().time_since_epoch()).count();
+}
+
+static void Check(const int32_t ec, const char *what) {
+  if (ec != CARLA_SERVER_SUCCESS) {
+    throw std::runtime_error(std::string(what) + " failed with error " + std::to_string(ec));
+  }
+}
+
+static double Percentile(const std::vector<double> &sorted, const double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const auto index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1u) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1u)];
+}
+
+/// Resident memory in megabytes and number of threads of the process, from
+/// /proc/self/status.
+static void ReadProcessStatus(double &rss_megabytes, int64_t &threads) {
+  rss_megabytes = 0.0;
+  threads = 0;
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while (status >> key) {
+    if (key == "VmRSS:") {
+      uint64_t kilobytes;
+      status >> kilobytes;
+      rss_megabytes = static_cast<double>(kilobytes) / 1024.0;
+    } else if (key == "Threads:") {
+      status >> threads;
+    }
+    status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+}
+
+// =============================================================================
+// -- Shared state -------------------------------------------------------------
+// =============================================================================
+
+/// Shared between the game thread and the client thread.
+struct SharedState {
+  SharedState() {
+    for (auto &time : write_time) {
+      time = 0;
+    }
+  }
+
+  /// Time at which the game started writing each frame, by frame number
+  /// modulo WRITE_TIME_SLOTS.
+  std::atomic<int64_t> write_time[WRITE_TIME_SLOTS];
+
+  std::atomic_bool client_done{false};
+
+  /// Latency of the frames received since the last window, in microseconds.
+  std::vector<double> latencies;
+
+  std::mutex latencies_mutex;
+
+  std::atomic<uint64_t> frames_received{0u};
+};
+
+/// Sample of the process taken every window of episodes.
+struct Sample {
+  uint32_t episodes = 0u;
+  double rss_megabytes = 0.0;
+  int64_t live_allocations = 0;
+  double allocations_per_frame = 0.0;
+  int64_t threads = 0;
+  double p50 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+// =============================================================================
+// -- Client -------------------------------------------------------------------
+// =============================================================================
+
+static void RunClient(const Options &options, SharedState &state) {
+  try {
+    carla::client::CarlaClient client("127.0.0.1", options.port);
+    carla::client::Frame frame;
+    for (auto episode = 0u; episode < options.episodes; ++episode) {
+      client.RequestNewEpisode("");
+      if (!client.StartEpisode(0u).ready()) {
+        throw std::runtime_error("episode not ready");
+      }
+      for (auto i = 0u; i < options.frames; ++i) {
+        client.ReadFrame(frame);
+        const auto received = Now();
+        const auto frame_number = frame.measurements().frame_number();
+        const auto written = state.write_time[frame_number % WRITE_TIME_SLOTS].load();
+        {
+          std::lock_guard<std::mutex> lock(state.latencies_mutex);
+          state.latencies.emplace_back(1e-3 * static_cast<double>(received - written));
+        }
+        ++state.frames_received;
+        client.SendControl(0.0f, 0.5f, 0.0f);
+      }
+    }
+    // One more request ends the last episode, so the last window is sampled
+    // with the agent server stopped as every other.
+    client.RequestNewEpisode("");
+  } catch (const std::exception &e) {
+    std::cerr << "client error: " << e.what() << std::endl;
+  }
+  state.client_done = true;
+}
+
+// =============================================================================
+// -- Game ---------------------------------------------------------------------
+// =============================================================================
+
+static Sample TakeSample(
+    const uint32_t episodes,
+    SharedState &state,
+    uint64_t &previous_allocations,
+    uint64_t &previous_frames) {
+  Sample sample;
+  sample.episodes = episodes;
+  ReadProcessStatus(sample.rss_megabytes, sample.threads);
+  sample.live_allocations = g_live_allocations;
+  std::vector<double> latencies;
+  {
+    std::lock_guard<std::mutex> lock(state.latencies_mutex);
+    latencies.swap(state.latencies);
+  }
+  std::sort(latencies.begin(), latencies.end());
+  sample.p50 = Percentile(latencies, 0.5);
+  sample.p99 = Percentile(latencies, 0.99);
+  sample.max = Percentile(latencies, 1.0);
+  const uint64_t allocations = g_allocations;
+  const uint64_t frames = state.frames_received;
+  sample.allocations_per_frame =
+      static_cast<double>(allocations - previous_allocations) /
+      static_cast<double>(std::max<uint64_t>(frames - previous_frames, 1u));
+  previous_allocations = allocations;
+  previous_frames = frames;
+  return sample;
+}
+
+static void PrintSample(const Sample &sample) {
+  std::cout << std::fixed << std::setprecision(2)
+            << std::setw(8) << sample.episodes
+            << std::setw(10) << sample.rss_megabytes
+            << std::setw(12) << sample.live_allocations
+            << std::setw(12) << sample.allocations_per_frame
+            << std::setw(8) << sample.threads
+            << std::setw(10) << sample.p50
+            << std::setw(10) << sample.p99
+            << std::setw(10) << sample.max << std::endl;
+}
+
+static std::vector<Sample> RunGame(const Options &options, SharedState &state) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto guard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr server = guard.get();
+
+  // Synthetic frame: a gradient per camera and a grid of vehicles.
+  std::vector<uint32_t> pixels(options.width * options.height);
+  for (auto i = 0u; i < pixels.size(); ++i) {
+    pixels[i] = 0xff000000u | ((i % std::max(options.width, 1u)) * 0x010101u & 0x00ffffffu);
+  }
+  std::vector<carla_image> images(options.cameras);
+  for (auto i = 0u; i < images.size(); ++i) {
+    images[i] = carla_image{
+        options.width,
+        options.height,
+        0u,
+        pixels.data(),
+        0u,
+        i,
+        CARLA_SERVER_IMAGE_BGRA8,
+        options.compression,
+        0u,
+        0u,
+        0u};
+  }
+  std::vector<carla_agent> agents(options.agents);
+  std::memset(agents.data(), 0, sizeof(carla_agent) * agents.size());
+  for (auto i = 0u; i < agents.size(); ++i) {
+    agents[i].id = i + 1u;
+    agents[i].type = CARLA_SERVER_AGENT_VEHICLE;
+    agents[i].transform.location = {100.0f * (i % 32u), 100.0f * (i / 32u), 0.0f};
+    agents[i].transform.orientation = {1.0f, 0.0f, 0.0f};
+    agents[i].box_extent = {200.0f, 100.0f, 80.0f};
+  }
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  measurements.non_player_agents = agents.data();
+  measurements.number_of_non_player_agents = options.agents;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{1.0f, 0.0f, 0.0f}}
+  };
+
+  std::cout << "episodes    rss_mb  live_allocs allocs/frame threads   p50_us    p99_us    max_us\n";
+  std::vector<Sample> samples;
+  uint64_t previous_allocations = g_allocations;
+  uint64_t previous_frames = 0u;
+
+  Check(carla_server_connect(server, options.port, TIMEOUT), "connect");
+  {
+    carla_request_new_episode values;
+    Check(carla_read_request_new_episode(server, values, TIMEOUT), "read new episode");
+  }
+
+  uint64_t frame = 0u;
+  for (auto episode = 0u; episode <= options.episodes; ++episode) {
+    {
+      const carla_scene_description values{start_locations, 1u, nullptr};
+      Check(carla_write_scene_description(server, values, TIMEOUT), "write scene");
+    }
+    if (episode == options.episodes) {
+      break;
+    }
+    {
+      carla_episode_start values;
+      Check(carla_read_episode_start(server, values, TIMEOUT), "read episode start");
+    }
+    {
+      const carla_episode_ready values{true};
+      Check(carla_write_episode_ready(server, values, TIMEOUT), "write episode ready");
+    }
+
+    // Stream until the client asks for the next episode, as the game does.
+    // The client closes the agent connections before asking, so failing to
+    // write or read on them means the request is on its way.
+    bool new_episode_requested = false;
+    auto wait_for_new_episode = [&]() {
+      if (!state.client_done) {
+        carla_request_new_episode values;
+        Check(carla_read_request_new_episode(server, values, TIMEOUT), "read new episode");
+        new_episode_requested = true;
+      }
+    };
+    while (!new_episode_requested && !state.client_done) {
+      state.write_time[frame % WRITE_TIME_SLOTS] = Now();
+      measurements.frame_number = frame;
+      measurements.game_timestamp = static_cast<uint32_t>(frame);
+      for (auto &image : images) {
+        image.frame_number = frame;
+      }
+      ++frame;
+      const auto ec = carla_write_measurements(server, measurements, images.data(), options.cameras);
+      if ((ec != CARLA_SERVER_SUCCESS) && (ec != CARLA_SERVER_OPERATION_ABORTED)) {
+        wait_for_new_episode();
+        break;
+      }
+      for (;;) {
+        carla_request_new_episode values;
+        if (carla_read_request_new_episode(server, values, 0u) == CARLA_SERVER_SUCCESS) {
+          new_episode_requested = true;
+          break;
+        }
+        carla_control control;
+        const auto ec = carla_read_control(server, control, 1u);
+        if ((ec == CARLA_SERVER_SUCCESS) || state.client_done) {
+          break;
+        }
+        if (ec != CARLA_SERVER_TRY_AGAIN) {
+          wait_for_new_episode();
+          break;
+        }
+      }
+    }
+
+    if (new_episode_requested && (((episode + 1u) % options.window) == 0u)) {
+      samples.emplace_back(TakeSample(episode + 1u, state, previous_allocations, previous_frames));
+      PrintSample(samples.back());
+    }
+    if (state.client_done) {
+      break;
+    }
+  }
+  return samples;
+}
+
+// =============================================================================
+// -- Report -------------------------------------------------------------------
+// =============================================================================
+
+/// The first window warms up the buffers and the connections, the second one
+/// is the baseline the last one is compared with. Returns whether every
+/// metric is within its threshold.
+static bool Report(const Options &options, const std::vector<Sample> &samples) {
+  if (samples.size() < 3u) {
+    std::cout << "not enough windows to check for drift, run more episodes\n";
+    return true;
+  }
+  const auto &baseline = samples[1u];
+  const auto &last = samples.back();
+  bool success = true;
+  auto check = [&](const bool within, const char *what, const double from, const double to) {
+    std::cout << std::fixed << std::setprecision(2)
+              << (within ? "ok     " : "DRIFT  ") << what << ": " << from << " -> " << to << '\n';
+    success &= within;
+  };
+  check(last.rss_megabytes - baseline.rss_megabytes <= options.max_rss_growth,
+        "resident memory (MB)", baseline.rss_megabytes, last.rss_megabytes);
+  check(last.live_allocations - baseline.live_allocations <= options.max_allocation_growth,
+        "live allocations", baseline.live_allocations, last.live_allocations);
+  check(last.threads - baseline.threads <= options.max_thread_growth,
+        "threads", baseline.threads, last.threads);
+  check(last.p50 <= options.max_latency_ratio * baseline.p50,
+        "p50 latency (us)", baseline.p50, last.p50);
+  check(last.p99 <= options.max_latency_ratio * baseline.p99,
+        "p99 latency (us)", baseline.p99, last.p99);
+  return success;
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+    const auto options = ParseOptions(argc, argv);
+    carla_set_log_level(CARLA_SERVER_LOG_WARNING);
+    SharedState state;
+    auto client = std::async(std::launch::async, [&]() { RunClient(options, state); });
+    const auto samples = RunGame(options, state);
+    client.get();
+    if (state.frames_received < static_cast<uint64_t>(options.episodes) * options.frames) {
+      std::cerr << "error: the client received " << state.frames_received << " frames of "
+                << static_cast<uint64_t>(options.episodes) * options.frames << std::endl;
+      return 1;
+    }
+    if (!Report(options, samples)) {
+      return 1;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
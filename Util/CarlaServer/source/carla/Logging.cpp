@@ -0,0 +1,313 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/Logging.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "carla/NonCopyable.h"
+
+namespace carla {
+namespace logging {
+
+namespace detail {
+
+  std::atomic<int> level{CARLA_SERVER_LOG_LEVEL};
+
+  std::atomic<bool> async{false};
+
+} // namespace detail
+
+  // ===========================================================================
+  // -- LogRing ----------------------------------------------------------------
+  // ===========================================================================
+
+  /// Single-producer single-consumer ring of messages. Written only by its
+  /// thread, read only by the flush under the logger's flush mutex. Each
+  /// message is stored as a header followed by its characters, possibly
+  /// wrapping around the end.
+  class LogRing : private NonCopyable {
+  public:
+
+    static constexpr size_t CAPACITY = 1u << 16u;
+
+    LogRing() : _data(new char[CAPACITY]) {}
+
+    bool empty() const {
+      return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    size_t size() const {
+      return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    /// Returns false, leaving the ring untouched, if the message does not fit.
+    bool Push(const bool to_stderr, const std::string &message) {
+      const Header header{static_cast<uint32_t>(message.size()), to_stderr};
+      const auto head = _head.load(std::memory_order_relaxed);
+      const auto tail = _tail.load(std::memory_order_acquire);
+      if (CAPACITY - (head - tail) < sizeof(Header) + message.size()) {
+        return false;
+      }
+      Copy(head, reinterpret_cast<const char *>(&header), sizeof(Header));
+      Copy(head + sizeof(Header), message.data(), message.size());
+      _head.store(head + sizeof(Header) + message.size(), std::memory_order_release);
+      return true;
+    }
+
+    /// Call @a callback(to_stderr, message) for every message queued.
+    template <typename F>
+    void Drain(std::string &message, F &&callback) {
+      auto tail = _tail.load(std::memory_order_relaxed);
+      const auto head = _head.load(std::memory_order_acquire);
+      while (tail != head) {
+        Header header;
+        CopyOut(tail, reinterpret_cast<char *>(&header), sizeof(Header));
+        message.resize(header.size);
+        CopyOut(tail + sizeof(Header), &message[0u], header.size);
+        tail += sizeof(Header) + header.size;
+        callback(header.to_stderr, message);
+      }
+      _tail.store(tail, std::memory_order_release);
+    }
+
+  private:
+
+    struct Header {
+      uint32_t size;
+      bool to_stderr;
+    };
+
+    void Copy(const size_t position, const char *source, const size_t size) {
+      const auto offset = position % CAPACITY;
+      const auto first = std::min(size, CAPACITY - offset);
+      std::memcpy(_data.get() + offset, source, first);
+      std::memcpy(_data.get(), source + first, size - first);
+    }
+
+    void CopyOut(const size_t position, char *destination, const size_t size) const {
+      const auto offset = position % CAPACITY;
+      const auto first = std::min(size, CAPACITY - offset);
+      std::memcpy(destination, _data.get() + offset, first);
+      std::memcpy(destination + first, _data.get(), size - first);
+    }
+
+    const std::unique_ptr<char[]> _data;
+
+    std::atomic<size_t> _head{0u};
+
+    std::atomic<size_t> _tail{0u};
+  };
+
+  // ===========================================================================
+  // -- AsyncLogger ------------------------------------------------------------
+  // ===========================================================================
+
+  /// Keeps the ring of every thread logging asynchronously, and the thread
+  /// flushing them.
+  class AsyncLogger : private NonCopyable {
+  public:
+
+    /// The rings are drained at least this often.
+    static constexpr uint32_t FLUSH_INTERVAL_MS = 20u;
+
+    static AsyncLogger &Get() {
+      static AsyncLogger logger;
+      return logger;
+    }
+
+    ~AsyncLogger() {
+      Stop();
+    }
+
+    void Start() {
+      std::lock_guard<std::mutex> lock(_thread_mutex);
+      if (!_thread.joinable()) {
+        _done = false;
+        _thread = std::thread([this]() { Run(); });
+      }
+    }
+
+    void Stop() {
+      {
+        std::lock_guard<std::mutex> lock(_thread_mutex);
+        if (_thread.joinable()) {
+          {
+            std::lock_guard<std::mutex> wake_lock(_wake_mutex);
+            _done = true;
+          }
+          _wake.notify_one();
+          _thread.join();
+        }
+      }
+      Flush();
+    }
+
+    void Push(const bool to_stderr, const std::string &message) {
+      auto &ring = GetThreadRing();
+      if (!ring.Push(to_stderr, message)) {
+        _dropped.fetch_add(1u, std::memory_order_relaxed);
+        _wake.notify_one();
+      } else if (ring.size() > LogRing::CAPACITY / 2u) {
+        _wake.notify_one();
+      }
+    }
+
+    void Flush() {
+      std::vector<std::shared_ptr<LogRing>> rings;
+      {
+        std::lock_guard<std::mutex> lock(_rings_mutex);
+        rings = _rings;
+      }
+      std::lock_guard<std::mutex> lock(_flush_mutex);
+      for (auto &ring : rings) {
+        ring->Drain(_message, [](const bool to_stderr, const std::string &message) {
+          std::fwrite(message.data(), 1u, message.size(), to_stderr ? stderr : stdout);
+        });
+      }
+      const auto dropped = _dropped.exchange(0u, std::memory_order_relaxed);
+      if (dropped > 0u) {
+        std::fprintf(stderr, "WARNING: %llu log messages dropped\n", static_cast<unsigned long long>(dropped));
+      }
+      std::fflush(stdout);
+      std::fflush(stderr);
+      // Forget the rings of the threads already finished, now empty.
+      rings.clear();
+      std::lock_guard<std::mutex> rings_lock(_rings_mutex);
+      _rings.erase(std::remove_if(_rings.begin(), _rings.end(), [](const std::shared_ptr<LogRing> &ring) {
+        return ring.use_count() == 1 && ring->empty();
+      }), _rings.end());
+    }
+
+  private:
+
+    AsyncLogger() = default;
+
+    /// Ring of the calling thread, created on first use. Shared with the
+    /// logger so the messages of a finished thread are still flushed.
+    LogRing &GetThreadRing() {
+      static thread_local std::shared_ptr<LogRing> ring;
+      if (ring == nullptr) {
+        ring = std::make_shared<LogRing>();
+        std::lock_guard<std::mutex> lock(_rings_mutex);
+        _rings.emplace_back(ring);
+      }
+      return *ring;
+    }
+
+    void Run() {
+      std::unique_lock<std::mutex> lock(_wake_mutex);
+      while (!_done) {
+        _wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+        lock.unlock();
+        Flush();
+        lock.lock();
+      }
+    }
+
+    std::mutex _thread_mutex;
+
+    std::thread _thread;
+
+    std::mutex _wake_mutex;
+
+    std::condition_variable _wake;
+
+    bool _done = false;
+
+    std::mutex _rings_mutex;
+
+    std::vector<std::shared_ptr<LogRing>> _rings;
+
+    /// Only one thread drains the rings at a time.
+    std::mutex _flush_mutex;
+
+    std::string _message;
+
+    std::atomic<uint64_t> _dropped{0u};
+  };
+
+  // ===========================================================================
+  // -- logging ----------------------------------------------------------------
+  // ===========================================================================
+
+namespace detail {
+
+  std::ostringstream &thread_stream() {
+    static thread_local std::ostringstream stream;
+    return stream;
+  }
+
+  void push(const bool to_stderr, const std::string &message) {
+    AsyncLogger::Get().Push(to_stderr, message);
+  }
+
+} // namespace detail
+
+  void set_level(const int level) {
+    detail::level = std::max(level, CARLA_SERVER_LOG_LEVEL);
+  }
+
+  void set_async(const bool enable) {
+    auto &logger = AsyncLogger::Get();
+    if (enable) {
+      // Flush what was printed synchronously before, so the order is kept.
+      std::cout.flush();
+      std::cerr.flush();
+      logger.Start();
+      detail::async = true;
+    } else {
+      detail::async = false;
+      logger.Stop();
+    }
+  }
+
+  void flush() {
+    AsyncLogger::Get().Flush();
+  }
+
+  static int ParseLevel(const std::string &value) {
+    if (value == "debug") {
+      return CARLA_SERVER_LOG_LEVEL_DEBUG;
+    } else if (value == "info") {
+      return CARLA_SERVER_LOG_LEVEL_INFO;
+    } else if (value == "warning") {
+      return CARLA_SERVER_LOG_LEVEL_WARNING;
+    } else if (value == "error") {
+      return CARLA_SERVER_LOG_LEVEL_ERROR;
+    } else if (value == "critical") {
+      return CARLA_SERVER_LOG_LEVEL_CRITICAL;
+    } else if (value == "none") {
+      return CARLA_SERVER_LOG_LEVEL_NONE;
+    }
+    return std::atoi(value.c_str());
+  }
+
+  static bool ConfigureLoggingAtStartup() {
+    const char *level = std::getenv("CARLA_LOG_LEVEL");
+    if ((level != nullptr) && (level[0] != '\0')) {
+      set_level(ParseLevel(level));
+    }
+    const char *async = std::getenv("CARLA_LOG_ASYNC");
+    if ((async != nullptr) && (std::atoi(async) != 0)) {
+      set_async(true);
+    }
+    return detail::async;
+  }
+
+  static const bool ASYNC_LOGGING_AT_STARTUP = ConfigureLoggingAtStartup();
+
+} // namespace logging
+} // namespace carla
@@ -33,12 +33,25 @@
 //
 //  * LOG_DEBUG_ONLY(/* code here */)
 //  * LOG_INFO_ONLY(/* code here */)
+//
+// Within the levels compiled in, the messages are further filtered at run time
+// by logging::set_level (or the environment variable CARLA_LOG_LEVEL); a call
+// below the run-time level costs a relaxed atomic load and a branch.
+//
+// By default messages are printed synchronously. With logging::set_async (or
+// CARLA_LOG_ASYNC=1) each thread formats its messages into its own lock-free
+// ring, flushed to the standard output and error by a background thread, so
+// logging does not block the I/O threads. Messages that do not fit in the ring
+// are dropped and counted.
 
 // =============================================================================
 // -- Implementation of log functions ------------------------------------------
 // =============================================================================
 
+#include <atomic>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 namespace carla {
 
@@ -52,13 +65,61 @@ namespace logging {
     (void)expander{0, (void(out << ' ' << std::forward<Args>(args)),0)...};
   }
 
+namespace detail {
+
+  extern std::atomic<int> level;
+
+  extern std::atomic<bool> async;
+
+  /// Stream reused by the calling thread to format its messages.
+  std::ostringstream &thread_stream();
+
+  /// Queue @a message in the ring of the calling thread.
+  void push(bool to_stderr, const std::string &message);
+
+} // namespace detail
+
+  /// Whether messages of @a level pass the run-time filter.
+  static inline bool is_enabled(int level) {
+    return level >= detail::level.load(std::memory_order_relaxed);
+  }
+
+  static inline int get_level() {
+    return detail::level.load(std::memory_order_relaxed);
+  }
+
+  /// Set the run-time level, one of CARLA_SERVER_LOG_LEVEL_*. The levels
+  /// below CARLA_SERVER_LOG_LEVEL are not compiled in and cannot be enabled.
+  void set_level(int level);
+
+  /// Enable or disable the asynchronous backend. Disabling it flushes the
+  /// messages queued so far.
+  void set_async(bool enable);
+
+  /// Print the messages queued so far by the asynchronous backend.
+  void flush();
+
+  template <typename ... Args>
+  static void write(bool to_stderr, Args &&... args) {
+    if (detail::async.load(std::memory_order_relaxed)) {
+      auto &stream = detail::thread_stream();
+      stream.str(std::string());
+      print(stream, std::forward<Args>(args)...);
+      detail::push(to_stderr, stream.str());
+    } else {
+      print(to_stderr ? std::cerr : std::cout, std::forward<Args>(args)...);
+    }
+  }
+
 } // namespace logging
 
 #if CARLA_SERVER_LOG_LEVEL <= CARLA_SERVER_LOG_LEVEL_DEBUG
 
   template <typename ... Args>
   static inline void log_debug(Args &&... args) {
-    logging::print(std::cout, "DEBUG:", std::forward<Args>(args)..., '\n');
+    if (logging::is_enabled(CARLA_SERVER_LOG_LEVEL_DEBUG)) {
+      logging::write(false, "DEBUG:", std::forward<Args>(args)..., '\n');
+    }
   }
 
 #else
@@ -72,7 +133,9 @@ namespace logging {
 
   template <typename ... Args>
   static inline void log_info(Args &&... args) {
-    logging::print(std::cout, "INFO: ", std::forward<Args>(args)..., '\n');
+    if (logging::is_enabled(CARLA_SERVER_LOG_LEVEL_INFO)) {
+      logging::write(false, "INFO: ", std::forward<Args>(args)..., '\n');
+    }
   }
 
 #else
@@ -86,7 +149,9 @@ namespace logging {
 
   template <typename ... Args>
   static inline void log_warning(Args &&... args) {
-    logging::print(std::cerr, "WARNING:", std::forward<Args>(args)..., '\n');
+    if (logging::is_enabled(CARLA_SERVER_LOG_LEVEL_WARNING)) {
+      logging::write(true, "WARNING:", std::forward<Args>(args)..., '\n');
+    }
   }
 
 #else
@@ -100,7 +165,9 @@ namespace logging {
 
   template <typename ... Args>
   static inline void log_error(Args &&... args) {
-    logging::print(std::cerr, "ERROR:", std::forward<Args>(args)..., '\n');
+    if (logging::is_enabled(CARLA_SERVER_LOG_LEVEL_ERROR)) {
+      logging::write(true, "ERROR:", std::forward<Args>(args)..., '\n');
+    }
   }
 
 #else
@@ -114,7 +181,9 @@ namespace logging {
 
   template <typename ... Args>
   static inline void log_critical(Args &&... args) {
-    logging::print(std::cerr, "CRITICAL:", std::forward<Args>(args)..., '\n');
+    if (logging::is_enabled(CARLA_SERVER_LOG_LEVEL_CRITICAL)) {
+      logging::write(true, "CRITICAL:", std::forward<Args>(args)..., '\n');
+    }
   }
 
 #else
@@ -0,0 +1,489 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "carla/Logging.h"
+
+namespace carla {
+
+  // ===========================================================================
+  // -- LatencyHistogram -------------------------------------------------------
+  // ===========================================================================
+
+  constexpr uint32_t LatencyHistogram::SUB_BUCKET_BITS;
+  constexpr uint32_t LatencyHistogram::SUB_BUCKETS;
+  constexpr uint32_t LatencyHistogram::MAX_BITS;
+  constexpr uint32_t LatencyHistogram::NUMBER_OF_BUCKETS;
+
+  static uint32_t GetMostSignificantBit(uint64_t value) {
+    uint32_t bit = 0u;
+    while (value >>= 1u) {
+      ++bit;
+    }
+    return bit;
+  }
+
+  uint32_t LatencyHistogram::GetBucket(uint64_t value) {
+    value = std::min(value, (uint64_t(1u) << MAX_BITS) - 1u);
+    if (value < 2u * SUB_BUCKETS) {
+      return static_cast<uint32_t>(value);
+    }
+    const uint32_t msb = GetMostSignificantBit(value);
+    const uint32_t shift = msb - SUB_BUCKET_BITS;
+    const uint32_t sub_bucket = static_cast<uint32_t>(value >> shift) - SUB_BUCKETS;
+    return 2u * SUB_BUCKETS + (msb - SUB_BUCKET_BITS - 1u) * SUB_BUCKETS + sub_bucket;
+  }
+
+  uint64_t LatencyHistogram::GetBucketValue(const uint32_t bucket) {
+    if (bucket < 2u * SUB_BUCKETS) {
+      return bucket;
+    }
+    const uint32_t index = bucket - 2u * SUB_BUCKETS;
+    const uint32_t shift = index / SUB_BUCKETS + 1u;
+    const uint64_t sub_bucket = index % SUB_BUCKETS + SUB_BUCKETS;
+    return ((sub_bucket + 1u) << shift) - 1u;
+  }
+
+  // Only the owner thread writes, so there is no need for read-modify-write
+  // atomic operations.
+  template <typename T>
+  static void Store(std::atomic<T> &atomic, T value) {
+    atomic.store(value, std::memory_order_relaxed);
+  }
+
+  template <typename T>
+  static T Load(const std::atomic<T> &atomic) {
+    return atomic.load(std::memory_order_relaxed);
+  }
+
+  void LatencyHistogram::Add(const uint64_t value) {
+    auto &bucket = _buckets[GetBucket(value)];
+    Store(bucket, Load(bucket) + 1u);
+    Store(_total, Load(_total) + value);
+    if (value < Load(_min)) {
+      Store(_min, value);
+    }
+    if (value > Load(_max)) {
+      Store(_max, value);
+    }
+  }
+
+  void LatencyHistogram::CopyTo(
+      std::vector<uint64_t> &buckets,
+      uint64_t &total,
+      uint64_t &min,
+      uint64_t &max) const {
+    for (auto i = 0u; i < NUMBER_OF_BUCKETS; ++i) {
+      buckets[i] += Load(_buckets[i]);
+    }
+    total += Load(_total);
+    min = std::min(min, Load(_min));
+    max = std::max(max, Load(_max));
+  }
+
+  // ===========================================================================
+  // -- EventBuffer ------------------------------------------------------------
+  // ===========================================================================
+
+  struct ProfilerEvent {
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t frame_number;
+  };
+
+  /// Ring buffer with the last scope events of a thread. Written only by its
+  /// thread without locking, read by any other thread; events overwritten
+  /// while being read are discarded. Has a spare slot for the event being
+  /// written.
+  class EventBuffer : private NonCopyable {
+  public:
+
+    EventBuffer(const uint32_t thread_id, const uint32_t capacity)
+      : _thread_id(thread_id),
+        _slots(std::max(capacity, 1u) + 1u) {}
+
+    uint32_t thread_id() const {
+      return _thread_id;
+    }
+
+    size_t capacity() const {
+      return _slots.size() - 1u;
+    }
+
+    void Push(const ProfilerEvent &event) {
+      const auto index = Load(_next);
+      auto &slot = _slots[index % _slots.size()];
+      Store(slot.name, event.name);
+      Store(slot.begin, event.begin);
+      Store(slot.end, event.end);
+      Store(slot.frame_number, event.frame_number);
+      _next.store(index + 1u, std::memory_order_release);
+    }
+
+    void CopyTo(std::vector<ProfilerEvent> &events) const {
+      const auto last = _next.load(std::memory_order_acquire);
+      const auto first = last > capacity() ? last - capacity() : 0u;
+      const auto size = events.size();
+      for (auto i = first; i < last; ++i) {
+        const auto &slot = _slots[i % _slots.size()];
+        events.push_back({Load(slot.name), Load(slot.begin), Load(slot.end), Load(slot.frame_number)});
+      }
+      // Discard the slots the writer may have started overwriting meanwhile.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const auto now = Load(_next);
+      const auto overwritten = (now >= first + _slots.size() ? now - _slots.size() - first + 1u : 0u);
+      const auto discard = std::min<uint64_t>(overwritten, last - first);
+      events.erase(events.begin() + size, events.begin() + size + discard);
+    }
+
+  private:
+
+    struct Slot {
+      std::atomic<const char *> name{nullptr};
+      std::atomic<uint64_t> begin{0u};
+      std::atomic<uint64_t> end{0u};
+      std::atomic<uint64_t> frame_number{0u};
+    };
+
+    const uint32_t _thread_id;
+
+    std::vector<Slot> _slots;
+
+    std::atomic<uint64_t> _next{0u};
+  };
+
+  static uint64_t ToMicroseconds(const Profiler::clock::time_point time_point) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        time_point.time_since_epoch()).count());
+  }
+
+  // ===========================================================================
+  // -- ProfilerRegistry -------------------------------------------------------
+  // ===========================================================================
+
+  /// Merged data of a scope.
+  struct ScopeData {
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(LatencyHistogram::NUMBER_OF_BUCKETS, 0u);
+    uint64_t total = 0u;
+    uint64_t min = std::numeric_limits<uint64_t>::max();
+    uint64_t max = 0u;
+  };
+
+  static LatencySnapshot MakeSnapshot(std::string name, const ScopeData &data) {
+    LatencySnapshot snapshot;
+    snapshot.name = std::move(name);
+    for (auto count : data.buckets) {
+      snapshot.count += count;
+    }
+    if (snapshot.count == 0u) {
+      return snapshot;
+    }
+    snapshot.min = data.min;
+    snapshot.max = data.max;
+    snapshot.mean = static_cast<double>(data.total) / static_cast<double>(snapshot.count);
+    auto percentile = [&](const double p) {
+      const auto rank = static_cast<uint64_t>(std::ceil(p * snapshot.count));
+      uint64_t accumulated = 0u;
+      for (auto i = 0u; i < data.buckets.size(); ++i) {
+        accumulated += data.buckets[i];
+        if (accumulated >= rank) {
+          return std::min(LatencyHistogram::GetBucketValue(i), data.max);
+        }
+      }
+      return data.max;
+    };
+    snapshot.p50 = percentile(0.5);
+    snapshot.p99 = percentile(0.99);
+    snapshot.p999 = percentile(0.999);
+    return snapshot;
+  }
+
+  /// Keeps track of the data of every thread, and prints the reports.
+  class ProfilerRegistry : private NonCopyable {
+  public:
+
+    static ProfilerRegistry &Get() {
+      static ProfilerRegistry registry;
+      return registry;
+    }
+
+    ~ProfilerRegistry() {
+      StopReporting();
+      if (_was_enabled) {
+        Print(GetSnapshots());
+      }
+      if (!_trace_filename.empty()) {
+        WriteChromeTrace(_trace_filename);
+      }
+    }
+
+    void Register(const ProfilerData &data) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _live.emplace_back(&data);
+    }
+
+    /// The thread owning @a data is exiting, keep its data.
+    void Unregister(const ProfilerData &data) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _live.erase(std::remove(_live.begin(), _live.end(), &data), _live.end());
+      auto &retired = _retired[data.name()];
+      data.histogram().CopyTo(retired.buckets, retired.total, retired.min, retired.max);
+    }
+
+    std::vector<LatencySnapshot> GetSnapshots() {
+      std::map<std::string, ScopeData> scopes;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        scopes = _retired;
+        for (auto *data : _live) {
+          auto &scope = scopes[data->name()];
+          data->histogram().CopyTo(scope.buckets, scope.total, scope.min, scope.max);
+        }
+      }
+      std::vector<LatencySnapshot> result;
+      result.reserve(scopes.size());
+      for (auto &item : scopes) {
+        result.emplace_back(MakeSnapshot(item.first, item.second));
+      }
+      return result;
+    }
+
+    /// Buffer of the calling thread, created on first use.
+    EventBuffer &GetEventBuffer() {
+      static thread_local std::shared_ptr<EventBuffer> buffer;
+      if (buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        buffer = std::make_shared<EventBuffer>(_next_thread_id++, _events_per_thread);
+        // Buffers are shared with the registry so the events of the threads
+        // already finished can still be dumped, keep only the latest ones.
+        _event_buffers.emplace_back(buffer);
+        if (_event_buffers.size() > MAX_EVENT_BUFFERS) {
+          _event_buffers.erase(_event_buffers.begin());
+        }
+      }
+      return *buffer;
+    }
+
+    void SetEventCapture(const uint32_t events_per_thread, std::string trace_filename) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _events_per_thread = events_per_thread;
+      if (!trace_filename.empty()) {
+        _trace_filename = std::move(trace_filename);
+      }
+    }
+
+    void DumpChromeTrace(std::ostream &out) {
+      std::vector<ProfilerEvent> events;
+      std::vector<std::pair<uint32_t, size_t>> threads;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &buffer : _event_buffers) {
+          threads.emplace_back(buffer->thread_id(), events.size());
+          buffer->CopyTo(events);
+        }
+      }
+      threads.emplace_back(0u, events.size());
+      out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+      bool first = true;
+      for (auto i = 0u; i + 1u < threads.size(); ++i) {
+        for (auto j = threads[i].second; j < threads[i + 1u].second; ++j) {
+          const auto &event = events[j];
+          out << (first ? "\n" : ",\n")
+              << "{\"name\":\"" << event.name
+              << "\",\"cat\":\"carla\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threads[i].first
+              << ",\"ts\":" << event.begin
+              << ",\"dur\":" << (event.end - event.begin)
+              << ",\"args\":{\"frame\":" << event.frame_number << "}}";
+          first = false;
+        }
+      }
+      out << "\n]}\n";
+    }
+
+    bool WriteChromeTrace(const std::string &filename) {
+      std::ofstream out(filename);
+      if (!out) {
+        return false;
+      }
+      DumpChromeTrace(out);
+      return static_cast<bool>(out);
+    }
+
+    void StartReporting(const std::chrono::seconds interval) {
+      StopReporting();
+      _was_enabled = true;
+      if (interval.count() > 0) {
+        _stop_reporting = false;
+        _reporter = std::thread([this, interval]() {
+          std::unique_lock<std::mutex> lock(_reporter_mutex);
+          while (!_reporter_condition.wait_for(lock, interval, [this]() { return _stop_reporting; })) {
+            Print(GetSnapshots());
+          }
+        });
+      }
+    }
+
+    void StopReporting() {
+      {
+        std::lock_guard<std::mutex> lock(_reporter_mutex);
+        _stop_reporting = true;
+      }
+      _reporter_condition.notify_all();
+      if (_reporter.joinable()) {
+        _reporter.join();
+      }
+    }
+
+    static void Print(const std::vector<LatencySnapshot> &snapshots) {
+      for (auto &s : snapshots) {
+        if (s.count > 0u) {
+          logging::print(
+              std::cout, "PROFILER:", s.name, ':',
+              "count =", s.count, std::fixed, std::setprecision(3),
+              "mean =", 1e-3 * s.mean, "ms",
+              "p50 =", 1e-3 * s.p50, "ms",
+              "p99 =", 1e-3 * s.p99, "ms",
+              "p999 =", 1e-3 * s.p999, "ms",
+              "min =", 1e-3 * s.min, "ms",
+              "max =", 1e-3 * s.max, "ms\n");
+        }
+      }
+    }
+
+  private:
+
+    static constexpr size_t MAX_EVENT_BUFFERS = 64u;
+
+    ProfilerRegistry() = default;
+
+    std::mutex _mutex;
+
+    uint32_t _events_per_thread = 1u << 14u;
+
+    uint32_t _next_thread_id = 1u;
+
+    std::vector<std::shared_ptr<EventBuffer>> _event_buffers;
+
+    std::string _trace_filename;
+
+    std::vector<const ProfilerData *> _live;
+
+    std::map<std::string, ScopeData> _retired;
+
+    bool _was_enabled = false;
+
+    std::mutex _reporter_mutex;
+
+    std::condition_variable _reporter_condition;
+
+    bool _stop_reporting = true;
+
+    std::thread _reporter;
+  };
+
+  // ===========================================================================
+  // -- ProfilerData -----------------------------------------------------------
+  // ===========================================================================
+
+  ProfilerData::ProfilerData(std::string name) : _name(std::move(name)) {
+    ProfilerRegistry::Get().Register(*this);
+  }
+
+  ProfilerData::~ProfilerData() {
+    ProfilerRegistry::Get().Unregister(*this);
+  }
+
+  // ===========================================================================
+  // -- Profiler ---------------------------------------------------------------
+  // ===========================================================================
+
+  constexpr uint32_t Profiler::STATS;
+  constexpr uint32_t Profiler::EVENTS;
+  constexpr size_t ProfilerRegistry::MAX_EVENT_BUFFERS;
+
+  std::atomic<uint32_t> Profiler::_mode{0u};
+
+  std::atomic<uint64_t> Profiler::_frame_number{0u};
+
+  void Profiler::Enable(const std::chrono::seconds report_interval) {
+    ProfilerRegistry::Get().StartReporting(report_interval);
+    _mode |= STATS;
+  }
+
+  void Profiler::Disable() {
+    _mode &= ~STATS;
+    ProfilerRegistry::Get().StopReporting();
+  }
+
+  void Profiler::EnableEventCapture(const uint32_t events_per_thread) {
+    ProfilerRegistry::Get().SetEventCapture(events_per_thread, std::string());
+    _mode |= EVENTS;
+  }
+
+  void Profiler::DisableEventCapture() {
+    _mode &= ~EVENTS;
+  }
+
+  void Profiler::RecordEvent(
+      const char *name,
+      const clock::time_point begin,
+      const clock::time_point end) {
+    ProfilerRegistry::Get().GetEventBuffer().Push({
+        name,
+        ToMicroseconds(begin),
+        ToMicroseconds(end),
+        _frame_number.load(std::memory_order_relaxed)});
+  }
+
+  void Profiler::DumpChromeTrace(std::ostream &out) {
+    ProfilerRegistry::Get().DumpChromeTrace(out);
+  }
+
+  bool Profiler::DumpChromeTrace(const std::string &filename) {
+    return ProfilerRegistry::Get().WriteChromeTrace(filename);
+  }
+
+  std::vector<LatencySnapshot> Profiler::GetSnapshots() {
+    return ProfilerRegistry::Get().GetSnapshots();
+  }
+
+  void Profiler::PrintSnapshots() {
+    ProfilerRegistry::Print(GetSnapshots());
+  }
+
+  static bool EnableProfilerAtStartup() {
+#ifdef CARLA_WITH_PROFILER
+    Profiler::Enable();
+#endif // CARLA_WITH_PROFILER
+    const char *interval = std::getenv("CARLA_PROFILER");
+    if (interval != nullptr) {
+      Profiler::Enable(std::chrono::seconds(std::max(0, std::atoi(interval))));
+    }
+    const char *trace_filename = std::getenv("CARLA_PROFILER_TRACE");
+    if ((trace_filename != nullptr) && (trace_filename[0] != '\0')) {
+      ProfilerRegistry::Get().SetEventCapture(1u << 14u, trace_filename);
+      Profiler::EnableEventCapture();
+    }
+    return Profiler::GetMode() != 0u;
+  }
+
+  static const bool PROFILER_ENABLED_AT_STARTUP = EnableProfilerAtStartup();
+
+} // namespace carla
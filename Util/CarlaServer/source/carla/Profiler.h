@@ -6,91 +6,219 @@
 
 #pragma once
 
-// #define CARLA_WITH_PROFILER
-
-#ifdef CARLA_WITH_PROFILER
+// Profiling is compiled in but disabled by default, it can be enabled at run
+// time with Profiler::Enable or by setting the environment variable
+// CARLA_PROFILER to the interval in seconds between reports (0 reports only
+// at exit). Defining CARLA_WITH_PROFILER enables it from the start.
+//
+// Independently, every profiled scope can be captured as an event to be
+// dumped as a Chrome trace (chrome://tracing, Perfetto UI). Capture is enabled
+// with Profiler::EnableEventCapture or by setting CARLA_PROFILER_TRACE to the
+// path of the trace to write at exit.
+//
+// While both are disabled, each profiled scope costs a relaxed atomic load.
 
-#include <algorithm>
-#include <iomanip>
-#include <iostream>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <string>
+#include <vector>
 
-#include "carla/Logging.h"
 #include "carla/NonCopyable.h"
-#include "carla/StopWatch.h"
+#include "carla/TscClock.h"
 
 namespace carla {
 
-  template <typename ... Args>
-  static inline void log_profiler(Args &&... args) {
-    logging::print(std::cout, "PROFILER:", std::forward<Args>(args)..., '\n');
-  }
+  /// Summary of the latencies recorded in a scope, in microseconds.
+  struct LatencySnapshot {
+    std::string name;
+    uint64_t count = 0u;
+    uint64_t min = 0u;
+    uint64_t max = 0u;
+    double mean = 0.0;
+    uint64_t p50 = 0u;
+    uint64_t p99 = 0u;
+    uint64_t p999 = 0u;
+  };
+
+  /// Log-linear histogram of latencies in microseconds. Values are grouped by
+  /// power of two, and each power of two split in 16 linear buckets, so the
+  /// relative error of the percentiles is at most 1/16.
+  ///
+  /// Written by a single thread, but can be read from any other thread at any
+  /// time.
+  class LatencyHistogram : private NonCopyable {
+  public:
+
+    static constexpr uint32_t SUB_BUCKET_BITS = 4u;
+
+    static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+
+    /// Values up to 2^40 us (about 12 days), larger values are clamped.
+    static constexpr uint32_t MAX_BITS = 40u;
+
+    static constexpr uint32_t NUMBER_OF_BUCKETS =
+        2u * SUB_BUCKETS + (MAX_BITS - SUB_BUCKET_BITS - 1u) * SUB_BUCKETS;
+
+    static uint32_t GetBucket(uint64_t value);
+
+    /// Largest value that falls in @a bucket.
+    static uint64_t GetBucketValue(uint32_t bucket);
+
+    void Add(uint64_t value);
+
+    /// Add the counts of this histogram to @a buckets, must have
+    /// NUMBER_OF_BUCKETS elements.
+    void CopyTo(std::vector<uint64_t> &buckets, uint64_t &total, uint64_t &min, uint64_t &max) const;
 
+  private:
+
+    std::array<std::atomic<uint64_t>, NUMBER_OF_BUCKETS> _buckets{};
+
+    std::atomic<uint64_t> _total{0u};
+
+    std::atomic<uint64_t> _min{std::numeric_limits<uint64_t>::max()};
+
+    std::atomic<uint64_t> _max{0u};
+  };
+
+  /// Latencies of a profiled scope recorded by a single thread. The data of
+  /// every thread is merged by scope name when reporting.
   class ProfilerData : private NonCopyable {
   public:
 
-    explicit ProfilerData(std::string name) : _name(std::move(name)) {}
+    explicit ProfilerData(std::string name);
 
-    ~ProfilerData() {
-      log_profiler(_name, ':', "annotated", _count, "times", std::fixed, std::setprecision(3));
-      if (_count > 0u) {
-        log_profiler(_name, ':', "average =", Average(), "ms");
-        log_profiler(_name, ':', "maximum =", Maximum(), "ms");
-        log_profiler(_name, ':', "minimum =", Minimum(), "ms");
-      }
+    ~ProfilerData();
+
+    const std::string &name() const {
+      return _name;
+    }
+
+    const LatencyHistogram &histogram() const {
+      return _histogram;
     }
 
-    void Annotate(const StopWatch &stop_watch) {
-      size_t elapsed_microseconds = stop_watch.GetElapsedTime<std::chrono::microseconds>();
-      ++_count;
-      _total_microseconds += elapsed_microseconds;
-      _max_elapsed = std::max(elapsed_microseconds, _max_elapsed);
-      _min_elapsed = std::min(elapsed_microseconds, _min_elapsed);
+    void Annotate(uint64_t elapsed_microseconds) {
+      _histogram.Add(elapsed_microseconds);
     }
 
-    float Average() const {
-      return ms(_total_microseconds) / static_cast<float>(_count);
+  private:
+
+    std::string _name;
+
+    LatencyHistogram _histogram;
+  };
+
+  class Profiler {
+  public:
+
+    /// Reads the time-stamp counter where available, so profiling
+    /// fine-grained scopes does not distort their timings.
+    using clock = TscClock;
+
+    static bool IsEnabled() {
+      return (GetMode() & STATS) != 0u;
     }
 
-    float Maximum() const {
-      return ms(_max_elapsed);
+    static bool IsCapturingEvents() {
+      return (GetMode() & EVENTS) != 0u;
     }
 
-    float Minimum() const {
-      return ms(_min_elapsed);
+    /// Bit mask of what is being recorded, see IsEnabled and
+    /// IsCapturingEvents.
+    static uint32_t GetMode() {
+      return _mode.load(std::memory_order_relaxed);
     }
 
-  private:
+    /// Start recording the profiled scopes. Every @a report_interval a
+    /// snapshot of every scope is printed; zero prints only at exit.
+    static void Enable(std::chrono::seconds report_interval = std::chrono::seconds(0u));
 
-    static inline float ms(size_t microseconds) {
-      return 1e-3f * static_cast<float>(microseconds);
+    /// Stop recording, the data recorded so far is kept.
+    static void Disable();
+
+    /// Snapshot of every scope recorded, merging the data of every thread.
+    static std::vector<LatencySnapshot> GetSnapshots();
+
+    /// Print GetSnapshots to the standard output.
+    static void PrintSnapshots();
+
+    /// @name Event capture
+    /// @{
+
+    /// Each thread keeps its last @a events_per_thread scope events.
+    static void EnableEventCapture(uint32_t events_per_thread = 1u << 14u);
+
+    static void DisableEventCapture();
+
+    /// Frame number stored with the events from now on.
+    static void SetFrameNumber(uint64_t frame_number) {
+      _frame_number.store(frame_number, std::memory_order_relaxed);
     }
 
-    std::string _name;
+    /// Store the event of a scope that ran from @a begin to @a end in the
+    /// calling thread. @a name must have static storage duration.
+    static void RecordEvent(const char *name, clock::time_point begin, clock::time_point end);
 
-    size_t _count = 0u;
+    /// Write the events captured so far as Chrome trace JSON.
+    static void DumpChromeTrace(std::ostream &out);
 
-    size_t _total_microseconds = 0u;
+    static bool DumpChromeTrace(const std::string &filename);
 
-    size_t _max_elapsed = 0u;
+    /// @}
 
-    size_t _min_elapsed = -1;
+    static constexpr uint32_t STATS = 1u << 0u;
+
+    static constexpr uint32_t EVENTS = 1u << 1u;
+
+  private:
+
+    static std::atomic<uint32_t> _mode;
+
+    static std::atomic<uint64_t> _frame_number;
   };
 
   class ScopedProfiler {
   public:
 
-    explicit ScopedProfiler(ProfilerData &parent) : _profiler(parent) {}
+    using clock = Profiler::clock;
+
+    /// @a name must have static storage duration.
+    ScopedProfiler(ProfilerData &parent, const char *name)
+      : _profiler(parent),
+        _name(name),
+        _mode(Profiler::GetMode()) {
+      if (_mode != 0u) {
+        _start = clock::now();
+      }
+    }
 
     ~ScopedProfiler() {
-      _stop_watch.Stop();
-      _profiler.Annotate(_stop_watch);
+      if (_mode != 0u) {
+        const auto end = clock::now();
+        if ((_mode & Profiler::STATS) != 0u) {
+          _profiler.Annotate(static_cast<uint64_t>(
+              std::chrono::duration_cast<std::chrono::microseconds>(end - _start).count()));
+        }
+        if ((_mode & Profiler::EVENTS) != 0u) {
+          Profiler::RecordEvent(_name, _start, end);
+        }
+      }
     }
 
   private:
 
     ProfilerData &_profiler;
 
-    StopWatch _stop_watch;
+    const char *_name;
+
+    const uint32_t _mode;
+
+    clock::time_point _start;
   };
 
 } // namespace carla
@@ -99,10 +227,5 @@ namespace carla {
     static thread_local ::carla::ProfilerData carla_profiler_ ## context ## _ ## name ## _data( \
         #context "." #name); \
     ::carla::ScopedProfiler carla_profiler_ ## context ## _ ## name ## _scoped_profiler( \
-        carla_profiler_ ## context ## _ ## name ## _data);
-
-#else // CARLA_WITH_PROFILER
-
-#define CARLA_PROFILE_SCOPE(context, name)
-
-#endif // CARLA_WITH_PROFILER
+        carla_profiler_ ## context ## _ ## name ## _data, \
+        #context "." #name);
@@ -8,6 +8,8 @@
 
 #include <chrono>
 
+#include "carla/TscClock.h"
+
 namespace carla {
 
   template <typename CLOCK>
@@ -52,6 +54,11 @@ namespace carla {
 
   using StopWatch = StopWatchTmpl<std::chrono::steady_clock>;
 
+  /// Cheaper to read than StopWatch, see TscClock.
+  using TscStopWatch = StopWatchTmpl<TscClock>;
+
   static_assert(carla::StopWatch::clock::is_steady, "The StopWatch's clock must be steady");
 
+  static_assert(carla::TscStopWatch::clock::is_steady, "The StopWatch's clock must be steady");
+
 } // namespace carla
@@ -0,0 +1,156 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "carla/ArrayView.h"
+
+#include <cstdint>
+#include <type_traits>
+
+namespace carla {
+
+namespace detail {
+
+  /// A view over a 2D array whose rows are @a row_pitch bytes apart, e.g. a
+  /// texture read back with padded rows or a crop of a larger image. Does NOT
+  /// own the data.
+  ///
+  /// Do not use StridedView directly, use mutable_strided_view or
+  /// const_strided_view.
+  template <typename T>
+  class StridedView {
+  public:
+
+    using value_type = T;
+    using mutable_value_type = std::remove_const_t<T>;
+    using const_value_type = const std::remove_const_t<T>;
+    using size_type = std::size_t;
+    using byte_type = std::conditional_t<std::is_const<T>::value, const unsigned char, unsigned char>;
+
+    /// A @a row_pitch of zero means the rows are tightly packed.
+    explicit StridedView(T *data, size_type width, size_type height, size_type row_pitch = 0u)
+        : _data(data),
+          _width(width),
+          _height(height),
+          _row_pitch(row_pitch == 0u ? sizeof(T) * width : row_pitch) {}
+
+    StridedView(StridedView<mutable_value_type> &rhs)
+        : _data(rhs.data()),
+          _width(rhs.width()),
+          _height(rhs.height()),
+          _row_pitch(rhs.row_pitch()) {}
+
+    StridedView(const StridedView<const_value_type> &rhs)
+        : _data(rhs.data()),
+          _width(rhs.width()),
+          _height(rhs.height()),
+          _row_pitch(rhs.row_pitch()) {}
+
+    bool empty() const {
+      return (_width == 0u) || (_height == 0u);
+    }
+
+    size_type width() const {
+      return _width;
+    }
+
+    size_type height() const {
+      return _height;
+    }
+
+    /// Bytes between the start of two consecutive rows.
+    size_type row_pitch() const {
+      return _row_pitch;
+    }
+
+    /// Bytes of each row that belong to the view.
+    size_type row_size() const {
+      return sizeof(T) * _width;
+    }
+
+    /// Whether the rows are tightly packed, so the whole view can be copied at
+    /// once.
+    bool is_contiguous() const {
+      return (_row_pitch == row_size()) || (_height <= 1u);
+    }
+
+    value_type *data() {
+      return _data;
+    }
+
+    const_value_type *data() const {
+      return _data;
+    }
+
+    ArrayView<value_type> row(size_type y) {
+      return ArrayView<value_type>(RowBegin(y), _width);
+    }
+
+    ArrayView<const_value_type> row(size_type y) const {
+      return ArrayView<const_value_type>(RowBegin(y), _width);
+    }
+
+    value_type &operator()(size_type x, size_type y) {
+      return RowBegin(y)[x];
+    }
+
+    const_value_type &operator()(size_type x, size_type y) const {
+      return RowBegin(y)[x];
+    }
+
+    /// View of the region @a width x @a height at (@a x, @a y), sharing the
+    /// row pitch.
+    StridedView subview(size_type x, size_type y, size_type width, size_type height) const {
+      return StridedView(RowBegin(y) + x, width, height, _row_pitch);
+    }
+
+  private:
+
+    value_type *RowBegin(size_type y) const {
+      return reinterpret_cast<value_type *>(reinterpret_cast<byte_type *>(_data) + y * _row_pitch);
+    }
+
+    value_type *_data;
+
+    size_type _width;
+
+    size_type _height;
+
+    size_type _row_pitch;
+  };
+
+} // namespace detail
+
+  template <typename T>
+  using mutable_strided_view = detail::StridedView<std::remove_const_t<T>>;
+
+  template <typename T>
+  using const_strided_view = detail::StridedView<const std::remove_const_t<T>>;
+
+namespace strided_view {
+
+  template <typename T, typename V = mutable_strided_view<T>>
+  static inline auto make_mutable(
+      T *data,
+      typename V::size_type width,
+      typename V::size_type height,
+      typename V::size_type row_pitch = 0u) {
+    return V(data, width, height, row_pitch);
+  }
+
+  template <typename T, typename V = const_strided_view<T>>
+  static inline auto make_const(
+      const T *data,
+      typename V::size_type width,
+      typename V::size_type height,
+      typename V::size_type row_pitch = 0u) {
+    return V(data, width, height, row_pitch);
+  }
+
+} // namespace strided_view
+
+} // namespace carla
@@ -0,0 +1,76 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/TscClock.h"
+
+#include <cstdlib>
+
+#if defined(CARLA_HAS_TSC) && !defined(_MSC_VER)
+#  include <cpuid.h>
+#endif
+
+#include "carla/Logging.h"
+
+namespace carla {
+
+  /// Time spent measuring the frequency of the counter.
+  static constexpr auto CALIBRATION_TIME = std::chrono::milliseconds(20);
+
+#ifdef CARLA_HAS_TSC
+
+  /// Whether the CPU advertises an invariant TSC, CPUID.80000007H:EDX[8].
+  static bool HasInvariantTsc() {
+    uint32_t regs[4u] = {0u, 0u, 0u, 0u};
+#ifdef _MSC_VER
+    int info[4u];
+    __cpuid(info, 0x80000000);
+    if (static_cast<uint32_t>(info[0u]) < 0x80000007u) {
+      return false;
+    }
+    __cpuid(info, 0x80000007);
+    for (auto i = 0u; i < 4u; ++i) {
+      regs[i] = static_cast<uint32_t>(info[i]);
+    }
+#else
+    if (__get_cpuid_max(0x80000000u, nullptr) < 0x80000007u) {
+      return false;
+    }
+    __get_cpuid(0x80000007u, &regs[0u], &regs[1u], &regs[2u], &regs[3u]);
+#endif // _MSC_VER
+    return (regs[3u] & (1u << 8u)) != 0u;
+  }
+
+#endif // CARLA_HAS_TSC
+
+  TscClock::Calibration TscClock::Calibrate() {
+    Calibration calibration;
+#ifdef CARLA_HAS_TSC
+    if ((std::getenv("CARLA_NO_TSC") != nullptr) || !HasInvariantTsc()) {
+      log_info("TSC not used, the profiler reads steady_clock");
+      return calibration;
+    }
+    using steady = std::chrono::steady_clock;
+    const auto start_time = steady::now();
+    const auto start_ticks = __rdtsc();
+    auto end_time = start_time;
+    while (end_time - start_time < CALIBRATION_TIME) {
+      end_time = steady::now();
+    }
+    const auto end_ticks = __rdtsc();
+    if (end_ticks <= start_ticks) {
+      return calibration;
+    }
+    const auto elapsed = std::chrono::duration_cast<duration>(end_time - start_time).count();
+    calibration.nanoseconds_per_tick = static_cast<double>(elapsed) / static_cast<double>(end_ticks - start_ticks);
+    calibration.base_ticks = end_ticks;
+    calibration.base_nanoseconds = std::chrono::duration_cast<duration>(end_time.time_since_epoch()).count();
+    calibration.is_valid = true;
+    log_info("TSC calibrated at", 1.0 / calibration.nanoseconds_per_tick, "GHz");
+#endif // CARLA_HAS_TSC
+    return calibration;
+  }
+
+} // namespace carla
@@ -0,0 +1,81 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>
+#  define CARLA_HAS_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#  define CARLA_HAS_TSC
+#endif
+
+namespace carla {
+
+  /// Steady clock reading the CPU's time-stamp counter, much cheaper than
+  /// the system clocks. The counter is calibrated against
+  /// std::chrono::steady_clock at start-up, and the time points share its
+  /// epoch so they can be compared with time points of steady_clock.
+  ///
+  /// Falls back to steady_clock if the CPU has no invariant TSC (one that
+  /// ticks at a constant rate in every core and power state), or if the
+  /// environment variable CARLA_NO_TSC is set.
+  class TscClock {
+  public:
+
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<TscClock, duration>;
+
+    static constexpr bool is_steady = true;
+
+    static time_point now() {
+#ifdef CARLA_HAS_TSC
+      const auto &calibration = GetCalibration();
+      if (calibration.is_valid) {
+        const auto ticks = static_cast<double>(static_cast<int64_t>(__rdtsc() - calibration.base_ticks));
+        return time_point(duration(calibration.base_nanoseconds + static_cast<rep>(ticks * calibration.nanoseconds_per_tick)));
+      }
+#endif // CARLA_HAS_TSC
+      return time_point(std::chrono::duration_cast<duration>(
+          std::chrono::steady_clock::now().time_since_epoch()));
+    }
+
+    /// Whether now reads the time-stamp counter.
+    static bool IsUsingTsc() {
+      return GetCalibration().is_valid;
+    }
+
+    /// Ticks of the time-stamp counter per second, zero if not used.
+    static double GetTscFrequency() {
+      const auto &calibration = GetCalibration();
+      return calibration.is_valid ? 1e9 / calibration.nanoseconds_per_tick : 0.0;
+    }
+
+  private:
+
+    struct Calibration {
+      bool is_valid = false;
+      uint64_t base_ticks = 0u;
+      rep base_nanoseconds = 0;
+      double nanoseconds_per_tick = 0.0;
+    };
+
+    static const Calibration &GetCalibration() {
+      // Set up on first use, every thread sees it initialized.
+      static const Calibration calibration = Calibrate();
+      return calibration;
+    }
+
+    static Calibration Calibrate();
+  };
+
+} // namespace carla
@@ -0,0 +1,266 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/client/CarlaClient.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/system/system_error.hpp>
+
+#include "carla/Logging.h"
+#include "carla/server/ControlBatch.h"
+#include "carla/server/WorldServer.h"
+
+namespace carla {
+namespace client {
+
+  using boost::asio::ip::tcp;
+
+  // ===========================================================================
+  // -- Static local functions -------------------------------------------------
+  // ===========================================================================
+
+  static void ThrowProtocolError(const char *what) {
+    log_error("protocol error:", what);
+    throw boost::system::system_error(
+        boost::asio::error::make_error_code(boost::asio::error::invalid_argument),
+        what);
+  }
+
+  /// The agent ports open once the server writes the episode ready, retry for
+  /// a while.
+  static void Connect(
+      boost::asio::io_service &service,
+      tcp::socket &socket,
+      const std::string &host,
+      const uint32_t port) {
+    tcp::resolver resolver(service);
+    const auto endpoints = resolver.resolve(tcp::resolver::query(host, std::to_string(port)));
+    boost::system::error_code ec;
+    for (auto i = 0u; i < 100u; ++i) {
+      boost::asio::connect(socket, endpoints, ec);
+      if (!ec) {
+        socket.set_option(tcp::no_delay(true));
+        return;
+      }
+      socket.close();
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    throw boost::system::system_error(ec, "unable to connect to port " + std::to_string(port));
+  }
+
+  // ===========================================================================
+  // -- CarlaClient ------------------------------------------------------------
+  // ===========================================================================
+
+  CarlaClient::CarlaClient(const std::string &host, const uint32_t world_port)
+      : _host(host),
+        _world_port(world_port),
+        _world(_service),
+        _measurements(_service),
+        _control(_service) {
+    Connect(_service, _world, _host, _world_port);
+  }
+
+  CarlaClient::~CarlaClient() {
+    DisconnectAgent();
+    boost::system::error_code ec;
+    _world.close(ec);
+  }
+
+  const CarlaClient::SceneDescription &CarlaClient::RequestNewEpisode(const std::string &ini_file) {
+    if (!_episode_ready.persistent_agent_connections()) {
+      DisconnectAgent();
+    }
+    carla_server::RequestNewEpisode request;
+    request.set_ini_file(ini_file);
+    if (_capabilities.empty()) {
+      request.add_capabilities(carla_server::CAPABILITY_NONE);
+    }
+    for (auto capability : _capabilities) {
+      request.add_capabilities(capability);
+    }
+    WriteMessage(_world, request);
+    ReadMessage(_world, _read_buffer);
+    if (!_scene_description.ParseFromString(_read_buffer)) {
+      ThrowProtocolError("invalid scene description");
+    }
+    return _scene_description;
+  }
+
+  const CarlaClient::EpisodeReady &CarlaClient::StartEpisode(
+      const uint32_t player_start_spot_index,
+      const uint32_t agent_index) {
+    carla_server::EpisodeStart start;
+    start.set_player_start_spot_index(player_start_spot_index);
+    WriteMessage(_world, start);
+    ReadMessage(_world, _read_buffer);
+    if (!_episode_ready.ParseFromString(_read_buffer)) {
+      ThrowProtocolError("invalid episode ready");
+    }
+    if (!_episode_ready.agent_connections_reused() || !IsAgentConnected()) {
+      DisconnectAgent();
+      // An episode broker may send us to the simulator behind it.
+      const bool redirected = !_episode_ready.server_host().empty();
+      const auto &host = (redirected ? _episode_ready.server_host() : _host);
+      const auto ports = server::WorldServer::GetAgentPorts(
+          redirected ? _episode_ready.server_world_port() : _world_port,
+          agent_index);
+      Connect(_service, _measurements, host, ports.first);
+      Connect(_service, _control, host, ports.second);
+    }
+    const auto &capabilities = _episode_ready.capabilities();
+    _flat_measurements = std::find(
+        capabilities.begin(),
+        capabilities.end(),
+        carla_server::CAPABILITY_FLAT_MEASUREMENTS) != capabilities.end();
+    return _episode_ready;
+  }
+
+  void CarlaClient::ReadFrame(Frame &frame) {
+    for (;;) {
+      uint64_t episode_id;
+      if (_flat_measurements) {
+        // Received straight into the frame and read in place from there.
+        ReadMessage(_measurements, frame._flat_measurements);
+        const auto view = frame.flat_measurements();
+        if (!view.IsValid()) {
+          ThrowProtocolError("invalid flat measurements");
+        }
+        frame._measurements.Clear();
+        episode_id = view.header().episode_id;
+      } else {
+        ReadMessage(_measurements, _read_buffer);
+        if (!frame._measurements.ParseFromString(_read_buffer)) {
+          ThrowProtocolError("invalid measurements");
+        }
+        frame._flat_measurements.clear();
+        episode_id = frame._measurements.episode_id();
+      }
+      uint32_t size;
+      boost::asio::read(_measurements, boost::asio::buffer(&size, sizeof(size)));
+      auto *buffer = frame.ResizeImagesBuffer(size);
+      boost::asio::read(_measurements, boost::asio::buffer(buffer, size));
+      if ((_episode_ready.episode_id() == 0u) || (episode_id == _episode_ready.episode_id())) {
+        break;
+      }
+      log_debug("discarding measurements of episode", episode_id);
+    }
+    if (!frame.ParseImages()) {
+      ThrowProtocolError("invalid images");
+    }
+  }
+
+  void CarlaClient::SendControl(const Control &control) {
+    if (_binary_control) {
+      if ((control.next_controls_size() > 0) ||
+          control.skip_intermediate_measurements() ||
+          (control.measurements_credit() > 0u) ||
+          (control.sequence_number() > 0u)) {
+        ThrowProtocolError("only binary controls can follow a binary control");
+      }
+      WriteBinaryControl(
+          control.steer(),
+          control.throttle(),
+          control.brake(),
+          control.hand_brake(),
+          control.reverse());
+    } else {
+      WriteMessage(_control, control);
+    }
+  }
+
+  void CarlaClient::SendControl(
+      const float steer,
+      const float throttle,
+      const float brake,
+      const bool hand_brake,
+      const bool reverse) {
+    if (_episode_ready.binary_control()) {
+      WriteBinaryControl(steer, throttle, brake, hand_brake, reverse);
+      return;
+    }
+    _control_message.set_steer(steer);
+    _control_message.set_throttle(throttle);
+    _control_message.set_brake(brake);
+    _control_message.set_hand_brake(hand_brake);
+    _control_message.set_reverse(reverse);
+    WriteMessage(_control, _control_message);
+  }
+
+  void CarlaClient::SendHeartbeat() {
+    static const uint32_t HEARTBEAT = server::HEARTBEAT_MESSAGE;
+    boost::asio::write(_world, boost::asio::buffer(&HEARTBEAT, sizeof(HEARTBEAT)));
+    if (!_control.is_open()) {
+      return;
+    }
+    // A binary control flagged as such once binary controls are sent.
+    if (_binary_control) {
+      using server::BinaryControl;
+      BinaryControl heartbeat;
+      std::memset(&heartbeat, 0, sizeof(heartbeat));
+      heartbeat.header = BinaryControl::MAGIC | BinaryControl::HEARTBEAT;
+      boost::asio::write(_control, boost::asio::buffer(&heartbeat, sizeof(heartbeat)));
+    } else {
+      boost::asio::write(_control, boost::asio::buffer(&HEARTBEAT, sizeof(HEARTBEAT)));
+    }
+  }
+
+  void CarlaClient::DisconnectAgent() {
+    _binary_control = false;
+    boost::system::error_code ec;
+    _measurements.close(ec);
+    _control.close(ec);
+  }
+
+  void CarlaClient::ReadMessage(tcp::socket &socket, std::string &message) {
+    uint32_t size;
+    boost::asio::read(socket, boost::asio::buffer(&size, sizeof(size)));
+    message.resize(size);
+    if (size > 0u) {
+      boost::asio::read(socket, boost::asio::buffer(&message[0u], size));
+    }
+  }
+
+  void CarlaClient::WriteMessage(
+      tcp::socket &socket,
+      const google::protobuf::MessageLite &message) {
+    const uint32_t size = static_cast<uint32_t>(message.ByteSizeLong());
+    _write_buffer.resize(sizeof(size) + size);
+    std::memcpy(&_write_buffer[0u], &size, sizeof(size));
+    message.SerializeWithCachedSizesToArray(
+        reinterpret_cast<uint8_t *>(&_write_buffer[sizeof(size)]));
+    boost::asio::write(socket, boost::asio::buffer(_write_buffer));
+  }
+
+  void CarlaClient::WriteBinaryControl(
+      const float steer,
+      const float throttle,
+      const float brake,
+      const bool hand_brake,
+      const bool reverse) {
+    using server::BinaryControl;
+    BinaryControl control;
+    control.header =
+        BinaryControl::MAGIC |
+        (hand_brake ? BinaryControl::HAND_BRAKE : 0u) |
+        (reverse ? BinaryControl::REVERSE : 0u);
+    control.steer = steer;
+    control.throttle = throttle;
+    control.brake = brake;
+    boost::asio::write(_control, boost::asio::buffer(&control, sizeof(control)));
+    _binary_control = true;
+  }
+
+} // namespace client
+} // namespace carla
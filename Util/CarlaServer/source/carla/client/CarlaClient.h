@@ -0,0 +1,135 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include "carla/NonCopyable.h"
+#include "carla/client/Frame.h"
+#include "carla/server/carla_server.pb.h"
+
+namespace carla {
+namespace client {
+
+  /// Native client of the CARLA server, the counterpart of the C interface
+  /// in carla_server.h. Speaks the protocol described in carla_server.md
+  /// through blocking sockets, every call throws boost::system::system_error
+  /// on networking errors.
+  ///
+  /// Messages are received into buffers reused from call to call, and images
+  /// straight into the buffer of the given Frame, so a client reading frames
+  /// in a loop does not allocate.
+  ///
+  /// Images written into shared memory are not supported, the frames of such
+  /// a server come with no images.
+  class CarlaClient : private NonCopyable {
+  public:
+
+    using SceneDescription = carla_server::SceneDescription;
+    using EpisodeReady = carla_server::EpisodeReady;
+    using Control = carla_server::Control;
+    using Capability = carla_server::Capability;
+
+    /// Connect to the world port of the server at @a host.
+    CarlaClient(const std::string &host, uint32_t world_port);
+
+    ~CarlaClient();
+
+    /// Optional encodings to ask for in the next episodes, see
+    /// RequestNewEpisode.capabilities in carla_server.proto. By default those
+    /// this client handles: packed agents, agents delta, compressed images
+    /// and binary controls. Add CAPABILITY_DELTA_IMAGES if the images are
+    /// decompressed with an ImageHistory, and CAPABILITY_FLAT_MEASUREMENTS
+    /// to read the measurements in place, see Frame::flat_measurements.
+    void SetCapabilities(std::vector<Capability> capabilities) {
+      _capabilities = std::move(capabilities);
+    }
+
+    /// Request a new episode with the given CarlaSettings.ini contents, and
+    /// return the scene description sent back by the server.
+    const SceneDescription &RequestNewEpisode(const std::string &ini_file);
+
+    /// Start the episode at the given player start and connect the agent
+    /// sockets of @a agent_index, unless the server says the current ones
+    /// are kept.
+    const EpisodeReady &StartEpisode(uint32_t player_start_spot_index, uint32_t agent_index = 0u);
+
+    /// Read the next measurements and images into @a frame. Frames of
+    /// previous episodes still in flight are skipped.
+    void ReadFrame(Frame &frame);
+
+    /// Throws if a binary control was already sent in this connection,
+    /// unless @a control fits in one, then it is sent as such.
+    void SendControl(const Control &control);
+
+    /// Sent as a fixed-size binary control if the server accepts them, see
+    /// EpisodeReady.binary_control.
+    void SendControl(float steer, float throttle, float brake, bool hand_brake = false, bool reverse = false);
+
+    /// Tell the server this client is alive through the world connection, and
+    /// the control connection if connected, see carla_set_liveness_timeout.
+    /// Meant to be called periodically while computing the next control.
+    void SendHeartbeat();
+
+    bool IsAgentConnected() const {
+      return _measurements.is_open() && _control.is_open();
+    }
+
+  private:
+
+    void DisconnectAgent();
+
+    void ReadMessage(boost::asio::ip::tcp::socket &socket, std::string &message);
+
+    void WriteMessage(boost::asio::ip::tcp::socket &socket, const google::protobuf::MessageLite &message);
+
+    void WriteBinaryControl(float steer, float throttle, float brake, bool hand_brake, bool reverse);
+
+    const std::string _host;
+
+    const uint32_t _world_port;
+
+    boost::asio::io_service _service;
+
+    boost::asio::ip::tcp::socket _world;
+
+    boost::asio::ip::tcp::socket _measurements;
+
+    boost::asio::ip::tcp::socket _control;
+
+    std::string _read_buffer;
+
+    std::string _write_buffer;
+
+    SceneDescription _scene_description;
+
+    EpisodeReady _episode_ready;
+
+    Control _control_message;
+
+    std::vector<Capability> _capabilities = {
+        carla_server::CAPABILITY_PACKED_AGENTS,
+        carla_server::CAPABILITY_AGENTS_DELTA,
+        carla_server::CAPABILITY_COMPRESSED_IMAGES,
+        carla_server::CAPABILITY_BINARY_CONTROL};
+
+    /// Whether the measurements of the current episode come in the
+    /// FlatMeasurements layout.
+    bool _flat_measurements = false;
+
+    /// Whether binary controls were sent through the current control socket.
+    bool _binary_control = false;
+  };
+
+} // namespace client
+} // namespace carla
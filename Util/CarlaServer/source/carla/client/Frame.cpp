@@ -0,0 +1,110 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/client/Frame.h"
+
+#include <cstring>
+
+#include "carla/Logging.h"
+#include "carla/server/ImagesMessage.h"
+#include "carla/server/LZ4.h"
+
+namespace carla {
+namespace client {
+
+  using server::ImagesMessage;
+
+  static constexpr uint32_t HEADER_SIZE = 2u * sizeof(uint32_t);
+
+  static constexpr uint32_t ENTRY_SIZE = ImagesMessage::HeaderEntrySize * sizeof(uint32_t);
+
+  bool Frame::Decompress(const ImageView &image, unsigned char *destination) {
+    const size_t size = static_cast<size_t>(image.stride) * image.height;
+    if (image.compression == ImagesMessage::None) {
+      if (image.size < size) {
+        return false;
+      }
+      std::memcpy(destination, image.data, size);
+      return true;
+    }
+    if ((image.compression != ImagesMessage::LZ4) || (image.size < sizeof(uint32_t))) {
+      return false;
+    }
+    uint32_t compressed_size;
+    std::memcpy(&compressed_size, image.data, sizeof(uint32_t));
+    if (compressed_size > image.size - sizeof(uint32_t)) {
+      return false;
+    }
+    return server::LZ4::Decompress(
+        image.data + sizeof(uint32_t),
+        compressed_size,
+        destination,
+        size);
+  }
+
+  unsigned char *Frame::ResizeImagesBuffer(const uint32_t size) {
+    const size_t required = size + ImagesMessage::Alignment;
+    if (_capacity < required) {
+      _allocation = std::make_unique<unsigned char[]>(required);
+      _capacity = required;
+      const auto address = reinterpret_cast<uintptr_t>(_allocation.get());
+      const auto misalignment = address % ImagesMessage::Alignment;
+      _buffer = _allocation.get() +
+          (misalignment == 0u ? 0u : ImagesMessage::Alignment - misalignment);
+    }
+    _size = size;
+    return _buffer;
+  }
+
+  bool Frame::ParseImages() {
+    _images.clear();
+    if (_size == 0u) {
+      return true;
+    }
+    if (_size < HEADER_SIZE) {
+      return false;
+    }
+    uint32_t header[2u];
+    std::memcpy(header, _buffer, HEADER_SIZE);
+    const uint32_t version = header[0u];
+    const uint32_t number_of_images = header[1u];
+    if ((version != ImagesMessage::Version) ||
+        (number_of_images > (_size - HEADER_SIZE) / ENTRY_SIZE)) {
+      log_error("invalid images message, version", version, "images", number_of_images);
+      return false;
+    }
+    _images.reserve(number_of_images);
+    for (auto i = 0u; i < number_of_images; ++i) {
+      uint32_t entry[ImagesMessage::HeaderEntrySize];
+      std::memcpy(entry, _buffer + HEADER_SIZE + i * ENTRY_SIZE, ENTRY_SIZE);
+      ImageView image;
+      image.width = entry[1u];
+      image.height = entry[2u];
+      image.type = entry[3u];
+      image.stride = entry[4u];
+      image.encoding = entry[5u] & ((1u << ImagesMessage::CompressionShift) - 1u);
+      image.compression = entry[5u] >> ImagesMessage::CompressionShift;
+      image.screen_percentage = entry[6u];
+      const uint32_t offset = entry[0u];
+      // Images end where the next one begins, or at the end of the message.
+      uint32_t end = _size;
+      if (i + 1u < number_of_images) {
+        std::memcpy(&end, _buffer + HEADER_SIZE + (i + 1u) * ENTRY_SIZE, sizeof(uint32_t));
+      }
+      if ((offset > end) || (end > _size)) {
+        log_error("invalid offset of image", i);
+        _images.clear();
+        return false;
+      }
+      image.data = _buffer + offset;
+      image.size = end - offset;
+      _images.emplace_back(image);
+    }
+    return true;
+  }
+
+} // namespace client
+} // namespace carla
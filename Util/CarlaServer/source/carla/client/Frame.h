@@ -0,0 +1,110 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "carla/ArrayView.h"
+#include "carla/NonCopyable.h"
+#include "carla/server/FlatMeasurements.h"
+#include "carla/server/carla_server.pb.h"
+
+namespace carla {
+namespace client {
+
+  /// An image of a Frame, points into the buffer the frame was received in.
+  struct ImageView {
+    uint32_t width;
+    uint32_t height;
+    /// Post-processing of the camera, see the images message in
+    /// carla_server.md.
+    uint32_t type;
+    /// Size in bytes of each row of pixels.
+    uint32_t stride;
+    /// One of CARLA_SERVER_IMAGE_*.
+    uint32_t encoding;
+    /// One of CARLA_SERVER_IMAGE_COMPRESSION_*. If compressed, data holds the
+    /// compressed pixels, see Frame::Decompress.
+    uint32_t compression;
+    /// Percentage of the image size the scene was rendered at.
+    uint32_t screen_percentage;
+    const unsigned char *data;
+    uint32_t size;
+  };
+
+  /// Measurements and images of a simulation frame as received from the
+  /// measurements stream.
+  ///
+  /// The images message is received straight into a buffer aligned to
+  /// ImagesMessage::Alignment, so the pixels of every image are aligned too
+  /// and are only exposed as views. The buffer is only grown, a frame reused
+  /// for every read allocates just once for images of similar size.
+  class Frame : private NonCopyable {
+  public:
+
+    /// Empty if the measurements came in the flat layout.
+    const carla_server::Measurements &measurements() const {
+      return _measurements;
+    }
+
+    /// Whether the measurements came in the FlatMeasurements layout, see
+    /// CAPABILITY_FLAT_MEASUREMENTS in carla_server.proto.
+    bool is_flat() const {
+      return !_flat_measurements.empty();
+    }
+
+    /// The measurements read in place from the buffer they were received in,
+    /// valid until the frame is read again. Only if is_flat().
+    server::FlatMeasurementsView flat_measurements() const {
+      return server::FlatMeasurementsView(
+          array_view::make_const(_flat_measurements.data(), _flat_measurements.size()));
+    }
+
+    /// Views of the images of this frame, valid until the frame is read
+    /// again.
+    const_array_view<ImageView> images() const {
+      return const_array_view<ImageView>(_images.data(), _images.size());
+    }
+
+    /// Decompress the pixels of @a image into @a destination, it must have
+    /// room for stride * height bytes. Returns false if the data is
+    /// malformed. Uncompressed images are just copied, delta images need the
+    /// previous image of their camera, see ImageHistory.
+    static bool Decompress(const ImageView &image, unsigned char *destination);
+
+  private:
+
+    friend class CarlaClient;
+
+    /// Make room for an images message of @a size bytes, returns where it
+    /// should be received.
+    unsigned char *ResizeImagesBuffer(uint32_t size);
+
+    /// Parse the header table of the images buffer into the image views.
+    bool ParseImages();
+
+    carla_server::Measurements _measurements;
+
+    /// The measurements message as received, if flat.
+    std::string _flat_measurements;
+
+    std::unique_ptr<unsigned char[]> _allocation;
+
+    size_t _capacity = 0u;
+
+    unsigned char *_buffer = nullptr;
+
+    uint32_t _size = 0u;
+
+    std::vector<ImageView> _images;
+  };
+
+} // namespace client
+} // namespace carla
@@ -0,0 +1,69 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/client/ImageHistory.h"
+
+#include <cstring>
+
+#include "carla/server/ImagesDelta.h"
+#include "carla/server/ImagesMessage.h"
+#include "carla/server/LZ4.h"
+
+namespace carla {
+namespace client {
+
+  using server::ImagesMessage;
+
+  static constexpr size_t DELTA_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint64_t);
+
+  bool ImageHistory::Decompress(
+      const ImageView &image,
+      const uint32_t camera_index,
+      const uint64_t frame_number,
+      unsigned char *destination) {
+    if (_cameras.size() <= camera_index) {
+      _cameras.resize(camera_index + 1u);
+    }
+    auto &camera = _cameras[camera_index];
+    const size_t size = static_cast<size_t>(image.stride) * image.height;
+    if (image.compression != ImagesMessage::Delta) {
+      if (!Frame::Decompress(image, destination)) {
+        camera.valid = false;
+        return false;
+      }
+      // Only compressed images may be the key frame of a delta camera.
+      if (image.compression == ImagesMessage::LZ4) {
+        camera.pixels.assign(destination, destination + size);
+        camera.frame_number = frame_number;
+        camera.valid = true;
+      }
+      return true;
+    }
+
+    if (image.size < DELTA_HEADER_SIZE) {
+      camera.valid = false;
+      return false;
+    }
+    uint32_t compressed_size;
+    uint64_t base_frame_number;
+    std::memcpy(&compressed_size, image.data, sizeof(uint32_t));
+    std::memcpy(&base_frame_number, image.data + sizeof(uint32_t), sizeof(uint64_t));
+    if (!camera.valid ||
+        (camera.frame_number != base_frame_number) ||
+        (camera.pixels.size() != size) ||
+        (compressed_size > image.size - DELTA_HEADER_SIZE) ||
+        !server::LZ4::Decompress(image.data + DELTA_HEADER_SIZE, compressed_size, destination, size)) {
+      camera.valid = false;
+      return false;
+    }
+    server::ImagesDelta::XOR(destination, camera.pixels.data(), size, destination);
+    std::memcpy(camera.pixels.data(), destination, size);
+    camera.frame_number = frame_number;
+    return true;
+  }
+
+} // namespace client
+} // namespace carla
@@ -0,0 +1,55 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "carla/NonCopyable.h"
+#include "carla/client/Frame.h"
+
+namespace carla {
+namespace client {
+
+  /// Last image decoded of every camera, to decode the images compressed as a
+  /// delta of the previous one (CARLA_SERVER_IMAGE_COMPRESSION_DELTA). Keep
+  /// one for the whole stream and decode the images of every frame in order.
+  class ImageHistory : private NonCopyable {
+  public:
+
+    /// Same as Frame::Decompress, and a delta image is applied on top of the
+    /// previous image of @a camera_index. Returns false too if that image is
+    /// not the one the delta is against (e.g., it was dropped), the camera
+    /// decodes again from its next key frame.
+    ///
+    /// The camera index and frame number of each image are those of the
+    /// measurements, image_camera_indices and image_frame_numbers.
+    bool Decompress(
+        const ImageView &image,
+        uint32_t camera_index,
+        uint64_t frame_number,
+        unsigned char *destination);
+
+    /// Forget every image, e.g. at the start of an episode.
+    void Reset() {
+      _cameras.clear();
+    }
+
+  private:
+
+    struct Camera {
+      std::vector<unsigned char> pixels;
+      uint64_t frame_number = 0u;
+      bool valid = false;
+    };
+
+    /// Indexed by camera index.
+    std::vector<Camera> _cameras;
+  };
+
+} // namespace client
+} // namespace carla
@@ -0,0 +1,104 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/Acceptor.h"
+
+#include <boost/asio/strand.hpp>
+
+#include "carla/Debug.h"
+#include "carla/Logging.h"
+
+namespace carla {
+namespace server {
+
+  using boost::asio::ip::tcp;
+
+  // ===========================================================================
+  // -- Acceptor::State --------------------------------------------------------
+  // ===========================================================================
+
+  /// Shared with the accept handler, so the acceptor can be destroyed without
+  /// waiting for it. The acceptor is accessed only within the strand.
+  class Acceptor::State
+    : public std::enable_shared_from_this<State>,
+      private NonCopyable {
+  public:
+
+    State(boost::asio::io_service &service, const char *log_prefix, callback_type callback)
+      : service(service),
+        acceptor(service),
+        strand(service),
+        log_prefix(log_prefix),
+        callback(std::move(callback)) {}
+
+    void Accept() {
+      auto socket = std::make_shared<socket_type>(service);
+      auto self = shared_from_this();
+      acceptor.async_accept(*socket, strand.wrap([self, socket](const error_code &ec) {
+        if (!self->acceptor.is_open()) {
+          return;
+        }
+        if (ec) {
+          log_error(self->log_prefix, "unable to accept connection:", ec.message());
+        } else {
+          self->callback(std::move(*socket));
+        }
+        self->Accept();
+      }));
+    }
+
+    boost::asio::io_service &service;
+
+    tcp::acceptor acceptor;
+
+    boost::asio::io_service::strand strand;
+
+    const char *const log_prefix;
+
+    const callback_type callback;
+  };
+
+  // ===========================================================================
+  // -- Acceptor ---------------------------------------------------------------
+  // ===========================================================================
+
+  Acceptor::Acceptor(
+      boost::asio::io_service &service,
+      const char *log_prefix,
+      callback_type callback)
+    : _state(std::make_shared<State>(service, log_prefix, std::move(callback))) {
+    DEBUG_ASSERT(_state->callback != nullptr);
+  }
+
+  Acceptor::~Acceptor() {
+    auto state = _state;
+    state->strand.post([state]() {
+      error_code ec;
+      state->acceptor.close(ec);
+    });
+  }
+
+  error_code Acceptor::Listen(const uint32_t port) {
+    const tcp::endpoint endpoint(tcp::v4(), port);
+    try {
+      // No handler is pending yet, the acceptor can be set up out of the
+      // strand.
+      auto &acceptor = _state->acceptor;
+      acceptor.open(endpoint.protocol());
+      acceptor.set_option(tcp::acceptor::reuse_address(true));
+      acceptor.bind(endpoint);
+      acceptor.listen();
+    } catch (const boost::system::system_error &exception) {
+      log_error(_state->log_prefix, "unable to listen at port", port, ':', exception.what());
+      return exception.code();
+    }
+    auto state = _state;
+    state->strand.post([state]() { state->Accept(); });
+    return errc::success();
+  }
+
+} // namespace server
+} // namespace carla
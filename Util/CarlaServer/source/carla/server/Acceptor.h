@@ -0,0 +1,54 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// Accepts any number of TCP connections at a port, handing each connected
+  /// socket to a callback. Used by the side servers that are not bound to a
+  /// single client, like the MeasurementsPublisher and the MetricsServer.
+  class Acceptor : private NonCopyable {
+  public:
+
+    using socket_type = boost::asio::ip::tcp::socket;
+
+    /// Called within the strand of the acceptor, one connection at a time. It
+    /// may be called after the acceptor is destroyed, with a connection
+    /// accepted before.
+    using callback_type = std::function<void(socket_type socket)>;
+
+    /// @a log_prefix must be a string literal.
+    Acceptor(
+        boost::asio::io_service &service,
+        const char *log_prefix,
+        callback_type callback);
+
+    /// Stops accepting connections, the ones accepted are not affected.
+    ~Acceptor();
+
+    /// Start accepting connections at @a port.
+    error_code Listen(uint32_t port);
+
+  private:
+
+    class State;
+
+    std::shared_ptr<State> _state;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,88 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "carla/ArrayView.h"
+#include "carla/server/CarlaServerAPI.h"
+
+namespace carla {
+namespace server {
+
+  /// Screen-space boxes of the agents seen by each camera, kept packed as they
+  /// are sent, see AgentBoxes2D in carla_server.proto. The buffers keep their
+  /// memory between frames. Assumes a little-endian platform.
+  class AgentBoxes {
+  public:
+
+    struct Camera {
+      uint32_t camera_index = 0u;
+      uint32_t number_of_boxes = 0u;
+      std::string data;
+    };
+
+    static constexpr size_t BYTES_PER_BOX = 2u * sizeof(uint32_t) + 4u * sizeof(float);
+
+    void Write(const_array_view<carla_camera_agent_boxes> cameras) {
+      if (_cameras.size() < cameras.size()) {
+        _cameras.resize(cameras.size());
+      }
+      _size = cameras.size();
+      for (size_t i = 0u; i < _size; ++i) {
+        Pack(cameras[i], _cameras[i]);
+      }
+    }
+
+    void Clear() {
+      _size = 0u;
+    }
+
+    bool empty() const {
+      return _size == 0u;
+    }
+
+    const_array_view<Camera> cameras() const {
+      return array_view::make_const(_cameras.data(), _size);
+    }
+
+    void swap(AgentBoxes &other) {
+      _cameras.swap(other._cameras);
+      std::swap(_size, other._size);
+    }
+
+  private:
+
+    static void Pack(const carla_camera_agent_boxes &rhs, Camera &lhs) {
+      const size_t count = rhs.number_of_boxes;
+      lhs.camera_index = rhs.camera_index;
+      lhs.number_of_boxes = rhs.number_of_boxes;
+      lhs.data.resize(BYTES_PER_BOX * count);
+      char *ids = &lhs.data[0u];
+      auto *boxes = reinterpret_cast<float *>(ids + count * sizeof(uint32_t));
+      char *flags = reinterpret_cast<char *>(boxes + 4u * count);
+      for (size_t i = 0u; i < count; ++i) {
+        const carla_agent_box_2d &box = rhs.boxes[i];
+        std::memcpy(ids + i * sizeof(uint32_t), &box.agent_id, sizeof(uint32_t));
+        *boxes++ = box.min_x;
+        *boxes++ = box.min_y;
+        *boxes++ = box.max_x;
+        *boxes++ = box.max_y;
+        std::memcpy(flags + i * sizeof(uint32_t), &box.flags, sizeof(uint32_t));
+      }
+    }
+
+    std::vector<Camera> _cameras;
+
+    size_t _size = 0u;
+  };
+
+} // namespace server
+} // namespace carla
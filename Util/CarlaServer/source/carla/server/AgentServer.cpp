@@ -6,6 +6,8 @@
 
 #include "carla/server/AgentServer.h"
 
+#include "carla/Logging.h"
+
 namespace carla {
 namespace server {
 
@@ -13,15 +15,89 @@ namespace server {
       CarlaEncoder &encoder,
       const uint32_t out_port,
       const uint32_t in_port,
-      const time_duration timeout)
+      const time_duration timeout,
+      const uint32_t number_of_slots,
+      const RingBufferPolicy policy,
+      const TCPOptions &out_options,
+      const TCPOptions &in_options,
+      const ImagesStreamOptions &images_options)
       : _out(encoder),
         _in(encoder),
-        _measurements(timeout),
-        _control(timeout) {
+        _measurements(timeout, number_of_slots, policy),
+        _control(timeout),
+        _images(timeout, images_options.number_of_slots, images_options.policy),
+        _encoder(encoder),
+        _control_mailbox(encoder.GetControlMailbox()),
+        _measurements_credits(encoder.GetMeasurementsCredits()),
+        _write_completions(encoder.GetWriteCompletions()) {
+    _measurements_credits.Reset();
+    _out.SetOptions(out_options);
+    _in.SetOptions(in_options);
     _out.Connect(out_port, timeout);
     _out.Execute(_measurements);
     _in.Connect(in_port, timeout);
     _in.Execute(_control);
+    if (images_options.port != 0u) {
+      _images_out = std::make_unique<AsyncServer<EncoderServer<TCPServer>>>(encoder);
+      _images_out->SetOptions(out_options);
+      _images_out->Connect(images_options.port, timeout);
+      _images_out->Execute(_images);
+    }
+    RegisterMeasurementsBuffer(encoder);
+  }
+
+  AgentServer::AgentServer(
+      CarlaEncoder &encoder,
+      Offline,
+      const uint32_t number_of_slots)
+      : _out(encoder),
+        _in(encoder),
+        // The time-out only paces the checks for the end of the stream.
+        _measurements(boost::posix_time::seconds(1), number_of_slots, RingBufferPolicy::Block),
+        _control(boost::posix_time::seconds(1)),
+        _encoder(encoder),
+        _control_mailbox(encoder.GetControlMailbox()),
+        _measurements_credits(encoder.GetMeasurementsCredits()),
+        _write_completions(encoder.GetWriteCompletions()) {
+    _measurements_credits.Reset();
+    _offline_out = std::make_unique<AsyncServer<EncoderServer<NullServer>>>(encoder);
+    _offline_out->Execute(_measurements);
+    // Nothing is going to be read, do not let ReadControl wait.
+    _control.buffer()->set_done();
+    RegisterMeasurementsBuffer(encoder);
+  }
+
+  void AgentServer::RegisterMeasurementsBuffer(CarlaEncoder &encoder) {
+    std::weak_ptr<RingBuffer<MeasurementsMessage>> buffer = _measurements.buffer();
+    encoder.GetMetrics().SetMeasurementsBuffer([buffer]() {
+      const auto ptr = buffer.lock();
+      return (ptr != nullptr ? ptr->GetStats() : RingBufferStats());
+    });
+  }
+
+  void AgentServer::StartEpisode(const uint64_t episode_id) {
+    DEBUG_ASSERT(!_pending_writer && !_pending_images_writer);
+    _episode_id = episode_id;
+    _control_mailbox.Clear();
+    _measurements_credits.Reset();
+    _applied_control = boost::none;
+    // Discard the controls of the previous episode, if any.
+    _control.buffer()->TryMakeReader(timeout_t());
+  }
+
+  AgentServer::~AgentServer() {
+    // Do not let the measurements stream wait for credit anymore.
+    _measurements_credits.Reset();
+    if (IsOffline()) {
+      // Encode every frame written, nothing is dropped offline.
+      _measurements.buffer()->set_done();
+      _measurements.get_result();
+    }
+    const auto stats = GetMeasurementsStats();
+    log_info(
+        "measurements sent:", stats.number_of_reads,
+        "dropped:", stats.number_of_drops,
+        "max queue depth:", stats.max_depth);
   }
 
 } // namespace server
@@ -6,9 +6,16 @@
 
 #pragma once
 
+#include <boost/optional.hpp>
+
+#include "carla/Debug.h"
 #include "carla/NonCopyable.h"
 #include "carla/server/AsyncServer.h"
+#include "carla/server/ControlBatch.h"
+#include "carla/server/ControlMailbox.h"
 #include "carla/server/EncoderServer.h"
+#include "carla/server/ImagesFrame.h"
+#include "carla/server/NullServer.h"
 #include "carla/server/TCPServer.h"
 
 namespace carla {
@@ -19,45 +26,429 @@ namespace server {
   class AgentServer : private NonCopyable {
   public:
 
+    /// @a number_of_slots and @a policy configure the buffer of measurements
+    /// pending to be sent, see RingBuffer.
     explicit AgentServer(
         CarlaEncoder &encoder,
         uint32_t out_port,
         uint32_t in_port,
-        time_duration timeout);
+        time_duration timeout,
+        uint32_t number_of_slots = 2u,
+        RingBufferPolicy policy = RingBufferPolicy::DropOldest,
+        const TCPOptions &out_options = TCPOptions(),
+        const TCPOptions &in_options = TCPOptions(),
+        const ImagesStreamOptions &images_options = ImagesStreamOptions());
+
+    /// Tag of the offline constructor.
+    struct Offline {};
+
+    /// Agent server without any client. The measurements written are only
+    /// encoded, for the recorder and the publisher of @a encoder, and wait
+    /// for a free slot of the @a number_of_slots instead of being dropped.
+    /// No control is ever received.
+    AgentServer(CarlaEncoder &encoder, Offline, uint32_t number_of_slots = 2u);
+
+    ~AgentServer();
+
+    bool IsOffline() const {
+      return _offline_out != nullptr;
+    }
+
+    /// Whether both the measurements and the control streams are still
+    /// running, i.e. the client did not close any of the connections.
+    bool IsConnected() const {
+      return
+          _measurements.IsRunning() &&
+          _control.IsRunning() &&
+          (!HasSeparateImagesStream() || _images.IsRunning());
+    }
+
+    /// Whether the images are sent through their own stream, with its own
+    /// connection and writer thread, instead of along with the measurements.
+    /// Then the measurements carry an image message without images, and a
+    /// slow image send does not delay them.
+    bool HasSeparateImagesStream() const {
+      return _images_out != nullptr;
+    }
+
+    /// Start a new episode on this agent server. The measurements written from
+    /// now on carry @a episode_id, and any control received before is
+    /// discarded.
+    void StartEpisode(uint64_t episode_id);
+
+    error_code WriteMeasurements(
+        const carla_measurements &measurements,
+        const_array_view<carla_image> images) {
+      return WriteFrame(measurements.frame_number, images, [&](MeasurementsMessage &message, const_array_view<carla_image> frame_images) {
+        message.Write(measurements, frame_images);
+      });
+    };
 
+    /// Same as WriteMeasurements but the non-player agents are taken from
+    /// @a agents, see carla_write_measurements_arrays.
     error_code WriteMeasurements(
         const carla_measurements &measurements,
+        const carla_agent_arrays &agents,
         const_array_view<carla_image> images) {
+      return WriteFrame(measurements.frame_number, images, [&](MeasurementsMessage &message, const_array_view<carla_image> frame_images) {
+        message.Write(measurements, agents, frame_images);
+      });
+    }
+
+    /// Same as WriteMeasurements, once the frame is sent, dropped, or the
+    /// stream ends, a completion with @a token is pushed to the encoder's
+    /// WriteCompletions. On failure no completion is pushed.
+    error_code WriteMeasurementsAsync(
+        const carla_measurements &measurements,
+        const_array_view<carla_image> images,
+        uint64_t token) {
+      return WriteFrame(measurements.frame_number, images, [&](MeasurementsMessage &message, const_array_view<carla_image> frame_images) {
+        message.Write(measurements, frame_images);
+        message.set_completion(_write_completions, token);
+      });
+    }
+
+    /// Same as WriteMeasurements but the agents and images are only copied
+    /// by the writer thread, @a lease is released once they are. On failure
+    /// @a lease is not taken. With a separate images stream the images are
+    /// copied right away.
+    error_code WriteMeasurementsLeased(
+        const carla_measurements &measurements,
+        const_array_view<carla_image> images,
+        const FrameLease &lease) {
+      return WriteFrame(measurements.frame_number, images, [&](MeasurementsMessage &message, const_array_view<carla_image> frame_images) {
+        message.WriteLeased(measurements, frame_images, lease);
+      });
+    }
+
+    /// Queue an already encoded frame to be sent as is, e.g. one of a
+    /// recording, see MeasurementsMessage::WriteRawFrame. The episode id of
+    /// the frame is not changed.
+    error_code WriteRawFrame(
+        const_buffer measurements,
+        const_buffer images,
+        std::shared_ptr<const void> owner) {
       error_code ec;
       if (!_control.TryGetResult(ec)) {
         auto writer = _measurements.buffer()->MakeWriter();
-        writer->Write(measurements, images);
+        writer->WriteRawFrame(measurements, images, std::move(owner));
         ec = errc::success();
       }
       return ec;
-    };
+    }
+
+    /// Lock a buffer for writing and reserve space for the given images, on
+    /// success @a data points to the regions of the buffer where the pixels
+    /// should be written. The buffer remains locked until
+    /// CommitImageBuffer is called.
+    error_code AcquireImageBuffer(
+        const_array_view<carla_image> images,
+        mutable_array_view<uint32_t *> data) {
+      error_code ec;
+      if (!_control.TryGetResult(ec)) {
+        if (HasSeparateImagesStream()) {
+          if (!_pending_images_writer) {
+            _pending_images_writer.emplace(_images.buffer()->MakeWriter());
+          }
+          (*_pending_images_writer)->Reserve(images, data);
+          return errc::success();
+        }
+        if (!_pending_writer) {
+          _pending_queue_depth = _measurements.buffer()->GetStats().depth;
+          _pending_writer.emplace(_measurements.buffer()->MakeWriter());
+        }
+        (*_pending_writer)->ReserveImages(images, data);
+        ec = errc::success();
+      }
+      return ec;
+    }
+
+    /// Write the measurements into the buffer previously acquired and release
+    /// it for sending.
+    error_code CommitImageBuffer(const carla_measurements &measurements) {
+      error_code ec;
+      if (!_control.TryGetResult(ec)) {
+        if (_pending_images_writer) {
+          // The measurements go first, the images are already in place.
+          ec = WriteFrame(measurements.frame_number, NoImages(), [&](MeasurementsMessage &message, const_array_view<carla_image> frame_images) {
+            message.Write(measurements, frame_images);
+          });
+          (*_pending_images_writer)->set_ids(_episode_id, _server_frame_id, measurements.frame_number);
+          _pending_images_writer = boost::none;
+          return ec;
+        }
+        if (!_pending_writer) {
+          return errc::invalid_argument();
+        }
+        _control_mailbox.SetFrameNumber(measurements.frame_number);
+        (*_pending_writer)->WriteMeasurements(measurements);
+        (*_pending_writer)->set_episode_id(_episode_id);
+        AttachFrameTiming(**_pending_writer);
+        AttachControlLatency(**_pending_writer);
+        AttachAgentBoxes(**_pending_writer);
+        AttachClassHistograms(**_pending_writer);
+        AttachCollisionEvents(**_pending_writer);
+        AttachFlowControl(**_pending_writer, _pending_queue_depth);
+        _pending_writer = boost::none;
+        ec = errc::success();
+      }
+      return ec;
+    }
+
+    /// Attach @a timing to the next measurements written.
+    void SetFrameTiming(const carla_frame_timing &timing) {
+      _frame_timing = timing;
+    }
+
+    /// The control with @a sequence_number, of the last batch read, was
+    /// applied now. Echoed back with every measurements written from now on,
+    /// zero is ignored.
+    void SetAppliedControl(uint64_t sequence_number) {
+      if (sequence_number == 0u) {
+        return;
+      }
+      ControlLatency latency;
+      latency.sequence_number = sequence_number;
+      latency.apply_us = ControlLatency::ToMicroseconds(StopWatch::clock::now());
+      for (auto &control : _control_batch.controls) {
+        if (control.sequence_number == sequence_number) {
+          latency.receive_us = ControlLatency::ToMicroseconds(_control_batch.receive_time);
+          break;
+        }
+      }
+      _applied_control = latency;
+    }
+
+    /// Attach the boxes of the agents seen by @a cameras to the next
+    /// measurements written.
+    void SetAgentBoxes(const_array_view<carla_camera_agent_boxes> cameras) {
+      _agent_boxes.Write(cameras);
+    }
+
+    /// Attach the per-label pixel counts of @a histograms to the next
+    /// measurements written.
+    void SetClassHistograms(const_array_view<carla_class_histogram> histograms) {
+      _class_histograms.Write(histograms);
+    }
+
+    /// Attach the collisions of the player in @a events to the next
+    /// measurements written.
+    void SetCollisionEvents(const_array_view<carla_collision_event> events) {
+      _collision_events.Write(events);
+    }
+
+    RingBufferStats GetMeasurementsStats() {
+      return _measurements.buffer()->GetStats();
+    }
 
+    /// Read the first control of the next batch, the rest are discarded. A
+    /// control received before the stream ended is still read.
     error_code ReadControl(carla_control &control, timeout_t timeout) {
       error_code ec = errc::try_again();
-      if (!_control.TryGetResult(ec)) {
-        auto reader = _control.buffer()->TryMakeReader(timeout);
-        if (reader != nullptr) {
-          control = *reader;
-          ec = errc::success();
+      // Returns right away once the stream ended.
+      auto reader = _control.buffer()->TryMakeReader(timeout, _encoder.GetControlWait());
+      if (reader != nullptr) {
+        DEBUG_ASSERT(!reader->controls.empty());
+        control = reader->controls.front();
+        _control_batch.controls.assign(1u, control);
+        _control_batch.receive_time = reader->receive_time;
+        ec = errc::success();
+      } else {
+        // The stream may have failed while waiting.
+        _control.TryGetResult(ec);
+      }
+      return ec;
+    }
+
+    /// The controls are held in memory until the next call. A batch received
+    /// before the stream ended is still read.
+    error_code ReadControlBatch(carla_control_batch &batch, timeout_t timeout) {
+      error_code ec = errc::try_again();
+      // Returns right away once the stream ended.
+      auto reader = _control.buffer()->TryMakeReader(timeout, _encoder.GetControlWait());
+      if (reader != nullptr) {
+        _control_batch.controls.assign(reader->controls.begin(), reader->controls.end());
+        _control_batch.skip_intermediate_measurements = reader->skip_intermediate_measurements;
+        _control_batch.receive_time = reader->receive_time;
+        batch.controls = _control_batch.controls.data();
+        batch.number_of_controls = static_cast<uint32_t>(_control_batch.controls.size());
+        batch.skip_intermediate_measurements = _control_batch.skip_intermediate_measurements;
+        batch.has_observation_request = reader->has_observation_request;
+        if (batch.has_observation_request) {
+          _control_batch.observed_sensors.assign(reader->observed_sensors.begin(), reader->observed_sensors.end());
+          batch.observed_sensors = _control_batch.observed_sensors.data();
+          batch.number_of_observed_sensors = static_cast<uint32_t>(_control_batch.observed_sensors.size());
+          batch.observe_non_player_agents = reader->observe_non_player_agents;
+          batch.observe_agent_boxes = reader->observe_agent_boxes;
+          batch.observe_class_histograms = reader->observe_class_histograms;
         }
+        ec = errc::success();
+      } else {
+        _control.TryGetResult(ec);
+      }
+      return ec;
+    }
+
+    /// Latest control received in this episode, see ControlMailbox. Never
+    /// blocks nor consumes the control, ReadControl still returns it.
+    error_code ReadLatestControl(ControlMailbox::Latest &latest) {
+      error_code ec;
+      if (!_control.TryGetResult(ec)) {
+        ec = (_control_mailbox.Read(latest) ? errc::success() : errc::try_again());
       }
       return ec;
     }
 
   private:
 
+    static const_array_view<carla_image> NoImages() {
+      return array_view::make_const<carla_image>(nullptr, 0u);
+    }
+
+    /// Queue the measurements of @a frame_number written into the message by
+    /// @a write, unless the agent server is done. @a write is given the
+    /// @a images to write along, none if there is a separate images stream;
+    /// then they are queued in it once the measurements are.
+    template <typename F>
+    error_code WriteFrame(uint64_t frame_number, const_array_view<carla_image> images, F &&write) {
+      error_code ec;
+      if (!_control.TryGetResult(ec)) {
+        _control_mailbox.SetFrameNumber(frame_number);
+        const bool separate_images = HasSeparateImagesStream();
+        {
+          const auto queue_depth = _measurements.buffer()->GetStats().depth;
+          auto writer = _measurements.buffer()->MakeWriter();
+          write(*writer, separate_images ? NoImages() : images);
+          writer->set_episode_id(_episode_id);
+          AttachFrameTiming(*writer);
+          AttachControlLatency(*writer);
+          AttachAgentBoxes(*writer);
+          AttachClassHistograms(*writer);
+          AttachCollisionEvents(*writer);
+          AttachFlowControl(*writer, queue_depth);
+        }
+        if (separate_images && !images.empty()) {
+          auto writer = _images.buffer()->MakeWriter();
+          writer->Write(images);
+          writer->set_ids(_episode_id, _server_frame_id, frame_number);
+        }
+        ec = errc::success();
+      }
+      return ec;
+    }
+
+    /// Move the pending frame timing, if any, to @a message.
+    void AttachFrameTiming(MeasurementsMessage &message) {
+      message.set_timing(_frame_timing ? _frame_timing.get_ptr() : nullptr);
+      _frame_timing = boost::none;
+    }
+
+    /// Give @a message the latency of the last control applied, if any,
+    /// captured now.
+    void AttachControlLatency(MeasurementsMessage &message) {
+      if (_applied_control) {
+        _applied_control->capture_us = ControlLatency::ToMicroseconds(StopWatch::clock::now());
+      }
+      message.set_control_latency(_applied_control ? _applied_control.get_ptr() : nullptr);
+    }
+
+    /// Move the pending agent boxes, if any, to @a message.
+    void AttachAgentBoxes(MeasurementsMessage &message) {
+      message.agent_boxes().swap(_agent_boxes);
+      _agent_boxes.Clear();
+    }
+
+    /// Move the pending class histograms, if any, to @a message.
+    void AttachClassHistograms(MeasurementsMessage &message) {
+      message.class_histograms().swap(_class_histograms);
+      _class_histograms.Clear();
+    }
+
+    /// Move the pending collision events, if any, to @a message.
+    void AttachCollisionEvents(MeasurementsMessage &message) {
+      message.collision_events().swap(_collision_events);
+      _collision_events.Clear();
+    }
+
+    /// Give @a message the next server frame id.
+    void AttachFlowControl(MeasurementsMessage &message, uint32_t queue_depth) {
+      message.set_flow_control(++_server_frame_id, queue_depth);
+    }
+
+    /// Report the stats of the measurements buffer in the metrics of
+    /// @a encoder.
+    void RegisterMeasurementsBuffer(CarlaEncoder &encoder);
+
     AsyncServer<EncoderServer<TCPServer>> _out;
 
     AsyncServer<EncoderServer<TCPServer>> _in;
 
+    /// Only with a separate images stream.
+    std::unique_ptr<AsyncServer<EncoderServer<TCPServer>>> _images_out;
+
+    /// Only offline, in place of the measurements connection.
+    std::unique_ptr<AsyncServer<EncoderServer<NullServer>>> _offline_out;
+
     StreamWriteTask<MeasurementsMessage> _measurements;
 
-    StreamReadTask<carla_control> _control;
+    StreamReadTask<ControlBatch> _control;
+
+    StreamWriteTask<ImagesFrame> _images;
+
+    /// Owned by the world server, outlives every agent server using it.
+    const CarlaEncoder &_encoder;
+
+    /// Owned by the encoder, the control stream publishes into it.
+    ControlMailbox &_control_mailbox;
+
+    /// Owned by the encoder, the control stream grants and the measurements
+    /// stream takes the credit.
+    MeasurementsCredits &_measurements_credits;
+
+    /// Owned by the encoder, the measurements stream pushes into it.
+    std::shared_ptr<WriteCompletions> _write_completions;
+
+    /// Last batch read with ReadControlBatch.
+    ControlBatch _control_batch;
+
+    uint64_t _episode_id = 0u;
+
+    /// Id of the last measurements written, see FrameFlowControl.
+    uint64_t _server_frame_id = 0u;
+
+    using writer_type = decltype(
+        std::declval<RingBuffer<MeasurementsMessage> &>().MakeWriter());
+
+    /// Writer held between AcquireImageBuffer and CommitImageBuffer.
+    boost::optional<writer_type> _pending_writer;
+
+    /// Queue depth when the pending writer was acquired.
+    uint32_t _pending_queue_depth = 0u;
+
+    using images_writer_type = decltype(
+        std::declval<RingBuffer<ImagesFrame> &>().MakeWriter());
+
+    /// Writer held between AcquireImageBuffer and CommitImageBuffer with a
+    /// separate images stream.
+    boost::optional<images_writer_type> _pending_images_writer;
+
+    /// Timing to attach to the next measurements, see SetFrameTiming.
+    boost::optional<carla_frame_timing> _frame_timing;
+
+    /// Last control applied in this episode, see SetAppliedControl.
+    boost::optional<ControlLatency> _applied_control;
+
+    /// Boxes to attach to the next measurements, see SetAgentBoxes. Swapped
+    /// with those of the message to keep the memory of both.
+    AgentBoxes _agent_boxes;
+
+    /// Histograms to attach to the next measurements, see
+    /// SetClassHistograms.
+    ClassHistograms _class_histograms;
+
+    /// Collisions to attach to the next measurements, see
+    /// SetCollisionEvents.
+    CollisionEvents _collision_events;
   };
 
 } // namespace server
@@ -0,0 +1,74 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/AgentsDelta.h"
+
+#include <cmath>
+
+namespace carla {
+namespace server {
+
+  static bool Differ(const float lhs, const float rhs, const float threshold) {
+    return std::abs(lhs - rhs) > threshold;
+  }
+
+  static bool Differ(
+      const carla_vector3d &lhs,
+      const carla_vector3d &rhs,
+      const float threshold) {
+    return
+        Differ(lhs.x, rhs.x, threshold) ||
+        Differ(lhs.y, rhs.y, threshold) ||
+        Differ(lhs.z, rhs.z, threshold);
+  }
+
+  static bool Differ(
+      const carla_agent &lhs,
+      const carla_agent &rhs,
+      const float threshold) {
+    return
+        (lhs.type != rhs.type) ||
+        Differ(lhs.transform.location, rhs.transform.location, threshold) ||
+        Differ(lhs.transform.orientation, rhs.transform.orientation, threshold) ||
+        Differ(lhs.box_extent, rhs.box_extent, threshold) ||
+        Differ(lhs.forward_speed, rhs.forward_speed, threshold);
+  }
+
+  void AgentsDelta::Update(
+      const_array_view<carla_agent> agents,
+      const float threshold) {
+    _is_full_update = _last_sent.empty();
+    _changed.clear();
+    _removed.clear();
+    const auto update = ++_update_count;
+    size_t number_of_seen = 0u;
+    for (auto &agent : agents) {
+      auto result = _last_sent.emplace(agent.id, Entry{agent, 0u});
+      auto &entry = result.first->second;
+      if (result.second || Differ(entry.agent, agent, threshold)) {
+        entry.agent = agent;
+        _changed.emplace_back(agent);
+      }
+      if (entry.last_seen != update) {
+        entry.last_seen = update;
+        ++number_of_seen;
+      }
+    }
+    if (_last_sent.size() > number_of_seen) {
+      // Some agents were not seen in this update.
+      for (auto it = _last_sent.begin(); it != _last_sent.end();) {
+        if (it->second.last_seen != update) {
+          _removed.emplace_back(it->first);
+          it = _last_sent.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,72 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "carla/ArrayView.h"
+#include "carla/NonCopyable.h"
+#include "carla/server/CarlaServerAPI.h"
+
+namespace carla {
+namespace server {
+
+  /// Keeps the last state sent of every non-player agent of a connection, and
+  /// computes which agents need to be sent again.
+  ///
+  /// The first update after construction or Reset is a full update, every
+  /// agent is reported as changed.
+  class AgentsDelta : private NonCopyable {
+  public:
+
+    /// Compare @a agents against the last state sent. An agent is considered
+    /// changed if any component of its location, orientation, box extent or
+    /// forward speed differs more than @a threshold from the last sent value,
+    /// or if its type changed. Agents not present anymore are reported as
+    /// removed.
+    void Update(const_array_view<carla_agent> agents, float threshold);
+
+    /// Forget every agent, next update is a full update.
+    void Reset() {
+      _last_sent.clear();
+      _is_full_update = true;
+    }
+
+    /// Whether the last update contains every agent.
+    bool is_full_update() const {
+      return _is_full_update;
+    }
+
+    const_array_view<carla_agent> changed() const {
+      return array_view::make_const(_changed.data(), _changed.size());
+    }
+
+    const_array_view<uint32_t> removed() const {
+      return array_view::make_const(_removed.data(), _removed.size());
+    }
+
+  private:
+
+    struct Entry {
+      carla_agent agent;
+      uint64_t last_seen;
+    };
+
+    std::unordered_map<uint32_t, Entry> _last_sent;
+
+    std::vector<carla_agent> _changed;
+
+    std::vector<uint32_t> _removed;
+
+    uint64_t _update_count = 0u;
+
+    bool _is_full_update = true;
+  };
+
+} // namespace server
+} // namespace carla
@@ -6,9 +6,20 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <boost/asio/strand.hpp>
+
 #include "carla/NonCopyable.h"
 #include "carla/Profiler.h"
-#include "carla/server/AsyncService.h"
+#include "carla/server/IOExecutor.h"
 #include "carla/server/ServerTraits.h"
 #include "carla/server/Task.h"
 
@@ -20,9 +31,15 @@ namespace server {
   // ===========================================================================
 
   /// Asynchronous server. Every "Connect", "Write", and "Read" tasks are
-  /// submitted to a queue of asynchronous jobs. These jobs are executed in a
-  /// single separate thread in order of submission. The "Disconnect()" function
-  /// of the underlying server is assumed to be thread-safe.
+  /// submitted to a queue of asynchronous jobs, executed in order of
+  /// submission, each one starting once the previous one completes.
+  ///
+  /// The jobs run in the IOExecutor shared by every server in the process,
+  /// serialized by a strand, and never block one of its threads: they start
+  /// the asynchronous operations of the underlying server (see
+  /// EncoderServer), and wait for the messages and buffers of the tasks to be
+  /// ready by registering a callback. The "Disconnect()" and "SetOptions()"
+  /// functions of the underlying server are assumed to be thread-safe.
   template <typename SERVER>
   class AsyncServer : private NonCopyable {
   public:
@@ -30,12 +47,25 @@ namespace server {
     using server_type = SERVER;
 
     template<typename... Args>
-    AsyncServer(Args&&... args) : _server(std::forward<Args>(args)...) {}
+    AsyncServer(Args&&... args)
+      : _executor(IOExecutor::GetShared()),
+        _strand(_executor->service()),
+        _server(std::forward<Args>(args)...) {}
+
+    /// Disconnects the server and cancels the wait of the job running, the
+    /// jobs not started are discarded. Blocks until no handler refers to this
+    /// server anymore.
+    ~AsyncServer();
 
     void Disconnect() {
       _server.Disconnect();
     }
 
+    template <typename OPTIONS>
+    void SetOptions(const OPTIONS &options) {
+      _server.SetOptions(options);
+    }
+
     std::future<error_code> Connect(uint32_t port, time_duration timeout);
 
     void Execute(ConnectTask &task);
@@ -54,22 +84,168 @@ namespace server {
 
   private:
 
-    server_type _server;
+    /// Started in the strand, calls Next() once completed.
+    using job_type = std::function<void()>;
+
+    using result_type = std::shared_ptr<std::promise<error_code>>;
+
+    /// Queue @a job after the ones already submitted.
+    void Submit(job_type job);
+
+    /// Start the next job. Strand only.
+    void StartNext();
+
+    /// Called by each job on completion, from any thread.
+    void Next() {
+      Post([this]() { StartNext(); });
+    }
+
+    /// Let the destructor cancel the wait of the job running with
+    /// @a interrupt, null once the wait is over. Returns false if the server
+    /// is being destroyed, the job must not wait then.
+    bool SetInterrupt(std::function<void()> interrupt);
+
+    /// Post @a callback to the strand.
+    template <typename F>
+    void Post(F &&callback) {
+      _strand.post(Track(std::forward<F>(callback)));
+    }
+
+    /// Keep count of the handlers pending so we can wait for them on
+    /// destruction.
+    template <typename F>
+    auto Track(F &&handler);
+
+    template <typename T>
+    void StreamRead(
+        std::shared_ptr<DoubleBuffer<T>> buffer,
+        std::shared_ptr<T> value,
+        time_duration timeout,
+        result_type result);
+
+    template <typename T>
+    void StreamWrite(
+        std::shared_ptr<RingBuffer<T>> buffer,
+        time_duration timeout,
+        result_type result);
+
+    /// End a stream job with @a ec.
+    template <typename Buffer>
+    void EndStream(Buffer &buffer, std::promise<error_code> &result, const error_code &ec) {
+      // Nothing else is going to be written or read, wake up the other end.
+      buffer.set_done();
+      result.set_value(ec);
+      Next();
+    }
+
+    const std::shared_ptr<IOExecutor> _executor;
+
+    boost::asio::io_service::strand _strand;
+
+    /// Jobs not started yet. Strand only.
+    std::deque<job_type> _jobs;
+
+    /// Whether a job is running. Strand only.
+    bool _running = false;
+
+    std::atomic_bool _done{false};
+
+    std::mutex _mutex;
+
+    std::condition_variable _condition;
+
+    uint32_t _pending_handlers = 0u;
+
+    std::function<void()> _interrupt;
 
-    AsyncService _service;
+    bool _interrupted = false;
+
+    server_type _server;
   };
 
   // ===========================================================================
   // -- AsyncServer implementation ---------------------------------------------
   // ===========================================================================
 
+  template <typename S>
+  AsyncServer<S>::~AsyncServer() {
+    _done = true;
+    std::function<void()> interrupt;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _interrupted = true;
+      interrupt = std::move(_interrupt);
+    }
+    if (interrupt) {
+      interrupt();
+    }
+    _server.Disconnect();
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this]() { return _pending_handlers == 0u; });
+  }
+
+  template <typename S>
+  template <typename F>
+  auto AsyncServer<S>::Track(F &&handler) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      ++_pending_handlers;
+    }
+    return [this, handler{std::forward<F>(handler)}](auto &&... args) mutable {
+      handler(std::forward<decltype(args)>(args)...);
+      std::lock_guard<std::mutex> lock(_mutex);
+      --_pending_handlers;
+      _condition.notify_all();
+    };
+  }
+
+  template <typename S>
+  void AsyncServer<S>::Submit(job_type job) {
+    Post([this, job{std::move(job)}]() mutable {
+      _jobs.emplace_back(std::move(job));
+      if (!_running) {
+        StartNext();
+      }
+    });
+  }
+
+  template <typename S>
+  void AsyncServer<S>::StartNext() {
+    if (_done) {
+      // Broken promises, as nobody is going to run them.
+      _jobs.clear();
+    }
+    _running = !_jobs.empty();
+    if (_running) {
+      auto job = std::move(_jobs.front());
+      _jobs.pop_front();
+      job();
+    }
+  }
+
+  template <typename S>
+  bool AsyncServer<S>::SetInterrupt(std::function<void()> interrupt) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_interrupted) {
+      return false;
+    }
+    _interrupt = std::move(interrupt);
+    return true;
+  }
+
   template <typename S>
   std::future<error_code> AsyncServer<S>::Connect(
       const uint32_t port,
       const time_duration timeout) {
-    return _service.Post([=](){
-      return _server.Connect(port, timeout);
+    auto result = std::make_shared<std::promise<error_code>>();
+    auto future = result->get_future();
+    Submit([=]() {
+      _server.AsyncConnect(port, timeout, Track([=](const error_code &ec) {
+        result->set_value(ec);
+        Next();
+      }));
     });
+    return future;
   }
 
   template <typename S>
@@ -80,74 +256,135 @@ namespace server {
   template <typename S>
   template <typename T>
   void AsyncServer<S>::Execute(ReadTask<T> &task) {
-    auto job = [this, timeout=task.timeout()](){
+    auto result = std::make_shared<std::promise<Reading<T>>>();
+    task._result = result->get_future();
+    Submit([this, result, timeout=task.timeout()]() {
       CARLA_PROFILE_SCOPE(AsyncServer, Read);
-      Reading<T> result;
-      result.error_code = _server.Read(result.message, timeout);
-      return result;
-    };
-    task._result = _service.Post(std::move(job));
+      auto reading = std::make_shared<Reading<T>>();
+      _server.AsyncRead(reading->message, timeout, Track([=](const error_code &ec) {
+        reading->error_code = ec;
+        result->set_value(std::move(*reading));
+        Next();
+      }));
+    });
   }
 
   template <typename S>
   template <typename T>
   void AsyncServer<S>::Execute(WriteTask<T> &task) {
-    // We could make the lambda mutable to avoid creating the shared_ptr, but it
-    // doesn't compile with VC++2015. Perhaps we can change it in the future.
-    auto message = std::make_shared<std::future<T>>(task.get_future_message());
-    auto job = [this, message{std::move(message)}, timeout = task.timeout()]() {
-      CARLA_PROFILE_SCOPE(AsyncServer, Write);
-      while (!_service.done()) {
-        T message_value;
-        if (future::wait_and_get(*message, message_value, timeout_t::milliseconds(1))) {
-          return _server.Write(message_value, timeout);
-        }
+    auto result = std::make_shared<std::promise<error_code>>();
+    task._result = result->get_future();
+    Submit([this, result, message=task.get_pending_message(), timeout=task.timeout()]() {
+      if (!SetInterrupt([message]() { message->Cancel(); })) {
+        result->set_value(errc::operation_aborted());
+        Next();
+        return;
       }
-      return errc::operation_aborted();
-    };
-    task._result = _service.Post(std::move(job));
+      // Called in the thread setting the message.
+      message->AsyncWait(Track([=]() {
+        Post([=]() {
+          CARLA_PROFILE_SCOPE(AsyncServer, Write);
+          SetInterrupt(nullptr);
+          auto value = std::make_shared<T>();
+          if (!message->Wait(*value) || _done) {
+            result->set_value(errc::operation_aborted());
+            Next();
+            return;
+          }
+          _server.AsyncWrite(*value, timeout, Track([=](const error_code &ec) {
+            result->set_value(ec);
+            Next();
+          }));
+        });
+      }));
+    });
   }
 
   template <typename S>
   template <typename T>
   void AsyncServer<S>::Execute(StreamReadTask<T> &task) {
-    auto job = [this, buffer=task.buffer(), timeout=task.timeout()]() {
-      error_code ec;
-      do {
+    auto result = std::make_shared<std::promise<error_code>>();
+    task._result = result->get_future();
+    Submit([this, result, buffer=task.buffer(), timeout=task.timeout()]() {
+      // Read aside, so a failed read is never handed to the reader. Swapped
+      // into the buffer to keep the capacity of both.
+      StreamRead(buffer, std::make_shared<T>(), timeout, result);
+    });
+  }
+
+  template <typename S>
+  template <typename T>
+  void AsyncServer<S>::StreamRead(
+      std::shared_ptr<DoubleBuffer<T>> buffer,
+      std::shared_ptr<T> value,
+      const time_duration timeout,
+      result_type result) {
+    if (_done) {
+      EndStream(*buffer, *result, errc::operation_aborted());
+      return;
+    }
+    _server.AsyncRead(*value, timeout, Track([=](const error_code &ec) {
+      if (ec) {
+        EndStream(*buffer, *result, ec);
+        return;
+      }
+      {
         CARLA_PROFILE_SCOPE(AsyncServer, StreamRead);
-        if (_service.done()) {
-          ec = errc::operation_aborted();
-          break;
-        }
-        auto writer = buffer->MakeWriter();
-        ec = _server.Read(*writer, timeout);
-      } while (!ec);
-      return ec;
-    };
-    task._result = _service.Post(std::move(job));
+        using std::swap;
+        swap(*buffer->MakeWriter(), *value);
+      }
+      // Back to the strand, the server may complete right away.
+      Post([=]() { StreamRead(buffer, value, timeout, result); });
+    }));
   }
 
   template <typename S>
   template <typename T>
   void AsyncServer<S>::Execute(StreamWriteTask<T> &task) {
-    auto job = [this, buffer=task.buffer(), timeout=task.timeout()]() {
-      error_code ec;
-      do {
-        CARLA_PROFILE_SCOPE(AsyncServer, StreamWrite);
-        if (_service.done()) {
-          ec = errc::operation_aborted();
-          break;
-        }
-        auto reader = buffer->TryMakeReader(timeout);
-        if (reader != nullptr) {
-          ec = _server.Write(*reader, timeout);
-        } else if (buffer->done()) {
-          ec = errc::operation_aborted();
-        }
-      } while (!ec);
-      return ec;
-    };
-    task._result = _service.Post(std::move(job));
+    auto result = std::make_shared<std::promise<error_code>>();
+    task._result = result->get_future();
+    Submit([this, result, buffer=task.buffer(), timeout=task.timeout()]() {
+      StreamWrite(buffer, timeout, result);
+    });
+  }
+
+  template <typename S>
+  template <typename T>
+  void AsyncServer<S>::StreamWrite(
+      std::shared_ptr<RingBuffer<T>> buffer,
+      const time_duration timeout,
+      result_type result) {
+    if (_done) {
+      EndStream(*buffer, *result, errc::operation_aborted());
+      return;
+    }
+    auto reader = buffer->TryMakeReader(timeout_t());
+    if (reader == nullptr) {
+      if (buffer->done() || !SetInterrupt([buffer]() { buffer->set_done(); })) {
+        EndStream(*buffer, *result, errc::operation_aborted());
+        return;
+      }
+      // Called in the thread of the producer.
+      buffer->AsyncWaitForData(Track([=]() {
+        Post([=]() {
+          SetInterrupt(nullptr);
+          StreamWrite(buffer, timeout, result);
+        });
+      }));
+      return;
+    }
+    CARLA_PROFILE_SCOPE(AsyncServer, StreamWrite);
+    // The slot is locked for reading until written.
+    auto slot = std::make_shared<decltype(reader)>(std::move(reader));
+    _server.AsyncWrite(**slot, timeout, Track([=](const error_code &ec) {
+      slot->reset();
+      if (ec) {
+        EndStream(*buffer, *result, ec);
+        return;
+      }
+      // Back to the strand, the server may complete right away.
+      Post([=]() { StreamWrite(buffer, timeout, result); });
+    }));
   }
 
 } // namespace server
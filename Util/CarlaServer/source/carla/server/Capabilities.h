@@ -0,0 +1,83 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+
+namespace carla {
+namespace server {
+
+  /// Optional encodings of the protocol, same values as Capability in
+  /// carla_server.proto.
+  enum class Capability : uint32_t {
+    PackedAgents = 1u,
+    AgentsDelta = 2u,
+    CompressedImages = 3u,
+    BinaryControl = 4u,
+    SeparateImagesStream = 5u,
+    SharedMemoryImages = 6u,
+    GpuSharedImages = 7u,
+    QuantizedAgents = 8u,
+    HalfFloatAgents = 9u,
+    DeltaImages = 10u,
+    FlatMeasurements = 11u
+  };
+
+  /// Set of capabilities supported by a client, or used in an episode.
+  class Capabilities {
+  public:
+
+    static constexpr uint32_t MaxValue = 11u;
+
+    /// Those of a client that does not negotiate, all but flat measurements,
+    /// which replace the Measurements protobuf such a client expects.
+    static Capabilities All() {
+      Capabilities capabilities;
+      for (auto value = 1u; value <= MaxValue; ++value) {
+        if (value != static_cast<uint32_t>(Capability::FlatMeasurements)) {
+          capabilities.Add(value);
+        }
+      }
+      return capabilities;
+    }
+
+    bool Has(Capability capability) const {
+      return (_mask & Bit(static_cast<uint32_t>(capability))) != 0u;
+    }
+
+    /// Unknown values are ignored.
+    void Add(uint32_t value) {
+      if ((value > 0u) && (value <= MaxValue)) {
+        _mask |= Bit(value);
+      }
+    }
+
+    void Add(Capability capability) {
+      Add(static_cast<uint32_t>(capability));
+    }
+
+    /// Call @a callback with the value of every capability in the set.
+    template <typename F>
+    void ForEach(F &&callback) const {
+      for (auto value = 1u; value <= MaxValue; ++value) {
+        if ((_mask & Bit(value)) != 0u) {
+          callback(value);
+        }
+      }
+    }
+
+  private:
+
+    static constexpr uint32_t Bit(uint32_t value) {
+      return 1u << value;
+    }
+
+    uint32_t _mask = 0u;
+  };
+
+} // namespace server
+} // namespace carla
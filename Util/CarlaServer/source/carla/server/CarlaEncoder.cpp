@@ -11,6 +11,11 @@
 #include "carla/ArrayView.h"
 #include "carla/Debug.h"
 #include "carla/Logging.h"
+#include "carla/server/AgentBoxes.h"
+#include "carla/server/ClassHistograms.h"
+#include "carla/server/CollisionEvents.h"
+#include "carla/server/FlatMeasurements.h"
+#include "carla/server/SharedMemoryImages.h"
 
 #include "carla/server/carla_server.pb.h"
 
@@ -40,6 +45,17 @@ namespace server {
     Set(lhs->mutable_orientation(), rhs.orientation);
   }
 
+  static void Set(carla_vector3d &lhs, const cs::Vector3D &rhs) {
+    lhs.x = rhs.x();
+    lhs.y = rhs.y();
+    lhs.z = rhs.z();
+  }
+
+  static void Set(carla_transform &lhs, const cs::Transform &rhs) {
+    Set(lhs.location, rhs.location());
+    Set(lhs.orientation, rhs.orientation());
+  }
+
   static void Set(cs::Control *lhs, const carla_control &rhs) {
     DEBUG_ASSERT(lhs != nullptr);
     lhs->set_steer(rhs.steer);
@@ -49,11 +65,22 @@ namespace server {
     lhs->set_reverse(rhs.reverse);
   }
 
+  static void Set(carla_control &lhs, const cs::Control &rhs) {
+    lhs.steer = rhs.steer();
+    lhs.throttle = rhs.throttle();
+    lhs.brake = rhs.brake();
+    lhs.hand_brake = rhs.hand_brake();
+    lhs.reverse = rhs.reverse();
+    lhs.sequence_number = rhs.sequence_number();
+  }
+
   static void SetVehicle(cs::Vehicle *lhs, const carla_agent &rhs) {
     DEBUG_ASSERT(lhs != nullptr);
     Set(lhs->mutable_transform(), rhs.transform);
     Set(lhs->mutable_box_extent(), rhs.box_extent);
     lhs->set_forward_speed(rhs.forward_speed);
+    lhs->set_intersection_offroad(rhs.intersection_offroad);
+    lhs->set_intersection_otherlane(rhs.intersection_otherlane);
   }
 
   static void SetPedestrian(cs::Pedestrian *lhs, const carla_agent &rhs) {
@@ -94,27 +121,109 @@ namespace server {
     }
   }
 
-  std::string CarlaEncoder::Encode(const carla_scene_description &values) {
-    auto *message = _protobuf.CreateMessage<cs::SceneDescription>();
-    DEBUG_ASSERT(message != nullptr);
-    for (auto &spot : start_spots(values)) {
-      Set(message->add_player_start_spots(), spot);
-    }
-    return Protobuf::Encode(*message);
-  }
-
-  std::string CarlaEncoder::Encode(const carla_episode_ready &values) {
-    auto *message = _protobuf.CreateMessage<cs::EpisodeReady>();
-    DEBUG_ASSERT(message != nullptr);
-    message->set_ready(values.ready);
-    return Protobuf::Encode(*message);
+  // Writes the agents as a structure of arrays, see PackedAgents in
+  // carla_server.proto.
+  static void SetPacked(
+      cs::PackedAgents *lhs,
+      const_array_view<carla_agent> rhs,
+      const AgentsEncoding encoding) {
+    DEBUG_ASSERT(lhs != nullptr);
+    lhs->set_number_of_agents(static_cast<uint32_t>(rhs.size()));
+    lhs->set_encoding(static_cast<cs::AgentsEncoding>(encoding));
+    // The string keeps its capacity as we cache the message.
+    WritePackedAgents(encoding, rhs, *lhs->mutable_data());
   }
 
-  std::string CarlaEncoder::Encode(const carla_measurements &values) {
-    static thread_local auto *message = _protobuf.CreateMessage<cs::Measurements>();
-    DEBUG_ASSERT(message != nullptr);
+  // Fills the measurements message of this thread, reused every frame.
+  static const cs::Measurements &FillMeasurements(
+      const carla_measurements &values,
+      const_array_view<uint64_t> image_frame_numbers,
+      const_array_view<uint32_t> image_camera_indices,
+      const bool packed_agents,
+      const AgentsEncoding agents_encoding,
+      const AgentsDelta *delta = nullptr,
+      const uint64_t shared_memory_sequence = 0u,
+      const uint64_t episode_id = 0u,
+      const carla_frame_timing *timing = nullptr,
+      const FrameFlowControl *flow_control = nullptr,
+      const_array_view<char> packed = array_view::make_const<char>(nullptr, 0u),
+      const AgentBoxes *agent_boxes = nullptr,
+      const ClassHistograms *class_histograms = nullptr,
+      const CollisionEvents *collision_events = nullptr,
+      const ControlLatency *control_latency = nullptr) {
+    // We keep one per thread out of any arena.
+    static thread_local cs::Measurements measurements;
+    auto *message = &measurements;
     message->set_platform_timestamp(values.platform_timestamp);
     message->set_game_timestamp(values.game_timestamp);
+    message->set_frame_number(values.frame_number);
+    message->clear_image_frame_numbers();
+    for (auto frame_number : image_frame_numbers) {
+      message->add_image_frame_numbers(frame_number);
+    }
+    message->clear_image_camera_indices();
+    for (auto camera_index : image_camera_indices) {
+      message->add_image_camera_indices(camera_index);
+    }
+    message->set_shared_memory_images_sequence(shared_memory_sequence);
+    message->set_episode_id(episode_id);
+    if (timing != nullptr) {
+      auto *frame_timing = message->mutable_timing();
+      frame_timing->set_game_tick_ms(timing->game_tick);
+      frame_timing->set_ai_ms(timing->ai);
+      frame_timing->set_capture_readback_ms(timing->capture_readback);
+      frame_timing->set_encode_ms(timing->encode);
+      frame_timing->set_queue_wait_ms(timing->queue_wait);
+      frame_timing->set_send_ms(timing->send);
+      frame_timing->set_pacing_wait_ms(timing->pacing_wait);
+      frame_timing->set_pacing_jitter_ms(timing->pacing_jitter);
+    } else {
+      message->clear_timing();
+    }
+    if (flow_control != nullptr) {
+      auto *frame_flow_control = message->mutable_flow_control();
+      frame_flow_control->set_server_frame_id(flow_control->server_frame_id);
+      frame_flow_control->set_dropped_frames(flow_control->dropped_frames);
+      frame_flow_control->set_queue_depth(flow_control->queue_depth);
+    } else {
+      message->clear_flow_control();
+    }
+    if (control_latency != nullptr) {
+      auto *latency = message->mutable_control_latency();
+      latency->set_last_applied_control_sequence(control_latency->sequence_number);
+      latency->set_receive_us(control_latency->receive_us);
+      latency->set_apply_us(control_latency->apply_us);
+      latency->set_capture_us(control_latency->capture_us);
+      latency->set_send_us(control_latency->send_us);
+    } else {
+      message->clear_control_latency();
+    }
+    message->clear_agent_boxes();
+    if (agent_boxes != nullptr) {
+      for (auto &camera : agent_boxes->cameras()) {
+        auto *boxes = message->add_agent_boxes();
+        boxes->set_camera_index(camera.camera_index);
+        boxes->set_number_of_boxes(camera.number_of_boxes);
+        boxes->set_data(camera.data);
+      }
+    }
+    message->clear_class_histograms();
+    if (class_histograms != nullptr) {
+      for (auto &camera : class_histograms->cameras()) {
+        auto *histogram = message->add_class_histograms();
+        histogram->set_camera_index(camera.camera_index);
+        histogram->mutable_counts()->Add(camera.counts.begin(), camera.counts.end());
+      }
+    }
+    message->clear_collision_events();
+    if (collision_events != nullptr) {
+      for (auto &event : collision_events->events()) {
+        auto *collision = message->add_collision_events();
+        collision->set_other_actor_id(event.other_actor_id);
+        collision->set_label(event.label);
+        collision->set_normal_impulse(event.normal_impulse);
+      }
+    }
     // Player measurements.
     auto *player = message->mutable_player_measurements();
     DEBUG_ASSERT(player != nullptr);
@@ -129,16 +238,407 @@ namespace server {
     Set(player->mutable_ai_control(), values.player_measurements.ai_control);
     // Non-player agents.
     message->clear_non_player_agents(); // we need to clear as we cache the message.
-    for (auto &agent : agents(values)) {
-      Set(message->add_non_player_agents(), agent);
+    message->clear_removed_non_player_agents();
+    message->set_non_player_agents_delta(false);
+    if (packed.size() > 0u) {
+      DEBUG_ASSERT(packed_agents && (agents_encoding == AgentsEncoding::Float32) && (delta == nullptr));
+      auto *packed_message = message->mutable_packed_non_player_agents();
+      packed_message->set_number_of_agents(values.number_of_non_player_agents);
+      packed_message->set_encoding(cs::AGENTS_FLOAT32);
+      packed_message->mutable_data()->assign(packed.data(), packed.size());
+      return *message;
+    }
+    const auto agents_to_send = (delta != nullptr ? delta->changed() : agents(values));
+    if (delta != nullptr) {
+      message->set_non_player_agents_delta(!delta->is_full_update());
+      for (auto id : delta->removed()) {
+        message->add_removed_non_player_agents(id);
+      }
+    }
+    if (packed_agents) {
+      SetPacked(message->mutable_packed_non_player_agents(), agents_to_send, agents_encoding);
+    } else {
+      message->clear_packed_non_player_agents();
+      for (auto &agent : agents_to_send) {
+        Set(message->add_non_player_agents(), agent);
+      }
+    }
+    return *message;
+  }
+
+  // Writes the measurements straight into @a buffer in the FlatMeasurements
+  // layout, prefixed by its size. Returns the number of bytes written.
+  static size_t WriteFlatMeasurements(
+      const carla_measurements &values,
+      const_array_view<uint64_t> image_frame_numbers,
+      const_array_view<uint32_t> image_camera_indices,
+      const AgentsDelta *delta,
+      const uint64_t shared_memory_sequence,
+      const uint64_t episode_id,
+      const carla_frame_timing *timing,
+      const FrameFlowControl *flow_control,
+      const AgentBoxes *agent_boxes,
+      const ClassHistograms *class_histograms,
+      const CollisionEvents *collision_events,
+      const ControlLatency *control_latency,
+      std::vector<char> &buffer) {
+    using Layout = FlatMeasurements;
+    const auto agents_to_send = (delta != nullptr ? delta->changed() : agents(values));
+    const auto removed = (delta != nullptr ? delta->removed() : array_view::make_const<uint32_t>(nullptr, 0u));
+    const auto number_of_boxes = (agent_boxes != nullptr ? agent_boxes->cameras().size() : 0u);
+    const auto number_of_histograms = (class_histograms != nullptr ? class_histograms->cameras().size() : 0u);
+    const auto number_of_events = (collision_events != nullptr ? collision_events->events().size() : 0u);
+    const size_t counts[Layout::NumberOfSections] = {
+        image_frame_numbers.size(),
+        image_camera_indices.size(),
+        agents_to_send.size(),
+        removed.size(),
+        number_of_events,
+        number_of_boxes,
+        number_of_histograms};
+    // Lay out the sections after the header, and the blobs after them.
+    Layout::Header header;
+    std::memset(&header, 0, sizeof(header));
+    uint32_t size = Layout::Align(sizeof(Layout::Header));
+    for (auto i = 0u; i < Layout::NumberOfSections; ++i) {
+      const auto section = static_cast<Layout::Section>(i);
+      header.sections[i].offset = size;
+      header.sections[i].count = static_cast<uint32_t>(counts[i]);
+      size = Layout::Align(size + static_cast<uint32_t>(counts[i] * Layout::ElementSize(section)));
+    }
+    const uint32_t blobs_offset = size;
+    if (agent_boxes != nullptr) {
+      for (auto &camera : agent_boxes->cameras()) {
+        size = Layout::Align(size + static_cast<uint32_t>(camera.data.size()));
+      }
+    }
+    if (class_histograms != nullptr) {
+      for (auto &camera : class_histograms->cameras()) {
+        size = Layout::Align(size + static_cast<uint32_t>(camera.counts.size() * sizeof(uint32_t)));
+      }
+    }
+    const size_t total = sizeof(uint32_t) + size;
+    if (buffer.size() < total) {
+      buffer.resize(total);
+    }
+    char *message = buffer.data() + sizeof(uint32_t);
+    std::memcpy(buffer.data(), &size, sizeof(uint32_t));
+    // The padding is sent too, do not leak what the buffer held.
+    std::memset(message, 0, size);
+    // Header.
+    header.magic = Layout::MAGIC;
+    header.version = Layout::VERSION;
+    header.header_size = sizeof(Layout::Header);
+    header.frame_number = values.frame_number;
+    header.episode_id = episode_id;
+    header.shared_memory_images_sequence = shared_memory_sequence;
+    header.platform_timestamp = values.platform_timestamp;
+    header.game_timestamp = values.game_timestamp;
+    const auto &player = values.player_measurements;
+    header.player.location = player.transform.location;
+    header.player.orientation = player.transform.orientation;
+    header.player.acceleration = player.acceleration;
+    header.player.forward_speed = player.forward_speed;
+    header.player.collision_vehicles = player.collision_vehicles;
+    header.player.collision_pedestrians = player.collision_pedestrians;
+    header.player.collision_other = player.collision_other;
+    header.player.intersection_otherlane = player.intersection_otherlane;
+    header.player.intersection_offroad = player.intersection_offroad;
+    header.player.ai_steer = player.ai_control.steer;
+    header.player.ai_throttle = player.ai_control.throttle;
+    header.player.ai_brake = player.ai_control.brake;
+    header.player.ai_flags =
+        (player.ai_control.hand_brake ? Layout::HAND_BRAKE : 0u) |
+        (player.ai_control.reverse ? Layout::REVERSE : 0u);
+    if (timing != nullptr) {
+      header.flags |= Layout::HAS_TIMING;
+      header.timing.game_tick = timing->game_tick;
+      header.timing.ai = timing->ai;
+      header.timing.capture_readback = timing->capture_readback;
+      header.timing.encode = timing->encode;
+      header.timing.queue_wait = timing->queue_wait;
+      header.timing.send = timing->send;
+      header.timing.pacing_wait = timing->pacing_wait;
+      header.timing.pacing_jitter = timing->pacing_jitter;
+    }
+    if (flow_control != nullptr) {
+      header.flags |= Layout::HAS_FLOW_CONTROL;
+      header.flow_control.server_frame_id = flow_control->server_frame_id;
+      header.flow_control.dropped_frames = flow_control->dropped_frames;
+      header.flow_control.queue_depth = flow_control->queue_depth;
+    }
+    if (control_latency != nullptr) {
+      header.flags |= Layout::HAS_CONTROL_LATENCY;
+      header.control_latency.last_applied_control_sequence = control_latency->sequence_number;
+      header.control_latency.receive_us = control_latency->receive_us;
+      header.control_latency.apply_us = control_latency->apply_us;
+      header.control_latency.capture_us = control_latency->capture_us;
+      header.control_latency.send_us = control_latency->send_us;
+    }
+    if ((delta != nullptr) && !delta->is_full_update()) {
+      header.flags |= Layout::AGENTS_DELTA;
+    }
+    std::memcpy(message, &header, sizeof(header));
+    // Sections.
+    auto section = [&](Layout::Section index) {
+      return message + header.sections[index].offset;
+    };
+    auto copy = [](char *destination, const void *source, size_t size) {
+      if (size > 0u) {
+        std::memcpy(destination, source, size);
+      }
+    };
+    copy(
+        section(Layout::ImageFrameNumbers),
+        image_frame_numbers.data(),
+        image_frame_numbers.size() * sizeof(uint64_t));
+    copy(
+        section(Layout::ImageCameraIndices),
+        image_camera_indices.data(),
+        image_camera_indices.size() * sizeof(uint32_t));
+    char *out = section(Layout::Agents);
+    for (auto &agent : agents_to_send) {
+      Layout::Agent record;
+      record.id = agent.id;
+      record.type = agent.type;
+      record.location = agent.transform.location;
+      record.orientation = agent.transform.orientation;
+      record.box_extent = agent.box_extent;
+      record.forward_speed = agent.forward_speed;
+      record.intersection_offroad = agent.intersection_offroad;
+      record.intersection_otherlane = agent.intersection_otherlane;
+      std::memcpy(out, &record, sizeof(record));
+      out += sizeof(record);
+    }
+    copy(section(Layout::RemovedAgents), removed.data(), removed.size() * sizeof(uint32_t));
+    out = section(Layout::CollisionEvents);
+    if (collision_events != nullptr) {
+      for (auto &event : collision_events->events()) {
+        Layout::CollisionEvent record;
+        record.other_actor_id = event.other_actor_id;
+        record.label = event.label;
+        record.normal_impulse = event.normal_impulse;
+        std::memcpy(out, &record, sizeof(record));
+        out += sizeof(record);
+      }
+    }
+    // Blobs.
+    uint32_t blob_offset = blobs_offset;
+    auto write_blob = [&, copy](char *entry, uint32_t camera_index, uint32_t count, const void *data, uint32_t size) {
+      const Layout::Blob blob = {camera_index, count, blob_offset, size};
+      std::memcpy(entry, &blob, sizeof(blob));
+      copy(message + blob_offset, data, size);
+      blob_offset = Layout::Align(blob_offset + size);
+    };
+    out = section(Layout::AgentBoxes);
+    if (agent_boxes != nullptr) {
+      for (auto &camera : agent_boxes->cameras()) {
+        write_blob(
+            out,
+            camera.camera_index,
+            camera.number_of_boxes,
+            camera.data.data(),
+            static_cast<uint32_t>(camera.data.size()));
+        out += sizeof(Layout::Blob);
+      }
+    }
+    out = section(Layout::ClassHistograms);
+    if (class_histograms != nullptr) {
+      for (auto &camera : class_histograms->cameras()) {
+        write_blob(
+            out,
+            camera.camera_index,
+            static_cast<uint32_t>(camera.counts.size()),
+            camera.counts.data(),
+            static_cast<uint32_t>(camera.counts.size() * sizeof(uint32_t)));
+        out += sizeof(Layout::Blob);
+      }
+    }
+    DEBUG_ASSERT(blob_offset == size);
+    return total;
+  }
+
+  std::string CarlaEncoder::Encode(const carla_scene_description &values) {
+    Protobuf::ScopedArena arena;
+    auto *message = arena.CreateMessage<cs::SceneDescription>();
+    DEBUG_ASSERT(message != nullptr);
+    for (auto &spot : start_spots(values)) {
+      Set(message->add_player_start_spots(), spot);
+    }
+    const auto shared_memory = GetSharedMemoryImages();
+    if (shared_memory != nullptr) {
+      message->set_shared_memory_images(shared_memory->name());
+    }
+    if (values.previous_episode_summary != nullptr) {
+      const auto &summary = *values.previous_episode_summary;
+      auto *totals = message->mutable_previous_episode_summary();
+      totals->set_number_of_frames(summary.number_of_frames);
+      totals->set_game_timestamp(summary.game_timestamp);
+      totals->set_distance_traveled(summary.distance_traveled);
+      totals->set_collision_vehicles(summary.collision_vehicles);
+      totals->set_collision_pedestrians(summary.collision_pedestrians);
+      totals->set_collision_other(summary.collision_other);
+      totals->set_number_of_collisions(summary.number_of_collisions);
+      totals->set_seconds_off_road(summary.seconds_off_road);
+      totals->set_seconds_on_other_lane(summary.seconds_on_other_lane);
+      totals->set_seconds_over_speed_limit(summary.seconds_over_speed_limit);
+    }
+    return Protobuf::Encode(*message);
+  }
+
+  std::string CarlaEncoder::Encode(const EpisodeReady &values) {
+    Protobuf::ScopedArena arena;
+    auto *message = arena.CreateMessage<cs::EpisodeReady>();
+    DEBUG_ASSERT(message != nullptr);
+    message->set_ready(values.values.ready);
+    message->set_episode_id(values.episode_id);
+    message->set_persistent_agent_connections(values.persistent_agent_connections);
+    message->set_agent_connections_reused(values.agent_connections_reused);
+    message->set_number_of_agents(values.number_of_agents);
+    message->set_separate_images_stream(values.separate_images_stream);
+    message->set_binary_control(values.capabilities.Has(Capability::BinaryControl));
+    values.capabilities.ForEach([message](uint32_t value) {
+      message->add_capabilities(static_cast<cs::Capability>(value));
+    });
+    return Protobuf::Encode(*message);
+  }
+
+  std::string CarlaEncoder::Encode(const ImagesFrame &values) {
+    Protobuf::ScopedArena arena;
+    auto *message = arena.CreateMessage<cs::ImagesFrame>();
+    DEBUG_ASSERT(message != nullptr);
+    message->set_episode_id(values.episode_id());
+    message->set_server_frame_id(values.server_frame_id());
+    message->set_frame_number(values.frame_number());
+    for (auto frame_number : values.image_frame_numbers()) {
+      message->add_image_frame_numbers(frame_number);
+    }
+    for (auto camera_index : values.image_camera_indices()) {
+      message->add_image_camera_indices(camera_index);
+    }
+    return Protobuf::Encode(*message);
+  }
+
+  std::string CarlaEncoder::Encode(const WorldSnapshot &values) {
+    Protobuf::ScopedArena arena;
+    auto *message = arena.CreateMessage<cs::WorldSnapshot>();
+    DEBUG_ASSERT(message != nullptr);
+    message->set_success(values.success);
+    message->set_data(values.data);
+    return Protobuf::Encode(*message);
+  }
+
+  std::string CarlaEncoder::Encode(const Route &values) {
+    Protobuf::ScopedArena arena;
+    auto *message = arena.CreateMessage<cs::Route>();
+    DEBUG_ASSERT(message != nullptr);
+    message->set_success(values.success);
+    for (auto &waypoint : values.waypoints) {
+      Set(message->add_waypoints(), waypoint);
     }
+    for (auto lane : values.lanes) {
+      message->add_lanes(lane);
+    }
+    message->set_length(values.length);
     return Protobuf::Encode(*message);
   }
 
-  bool CarlaEncoder::Decode(const std::string &str, RequestNewEpisode &values) {
-    auto *message = _protobuf.CreateMessage<cs::RequestNewEpisode>();
+  std::string CarlaEncoder::Encode(const RoadMap &values) {
+    Protobuf::ScopedArena arena;
+    auto *message = arena.CreateMessage<cs::RoadMap>();
     DEBUG_ASSERT(message != nullptr);
-    message->ParseFromString(str);
+    message->set_success(values.success);
+    message->set_hash(values.hash);
+    if (values.data != nullptr) {
+      message->set_data(*values.data);
+    }
+    return Protobuf::Encode(*message);
+  }
+
+  std::string CarlaEncoder::Encode(const carla_measurements &values) {
+    return Encode(
+        values,
+        array_view::make_const<uint64_t>(nullptr, 0u),
+        array_view::make_const<uint32_t>(nullptr, 0u));
+  }
+
+  std::string CarlaEncoder::Encode(
+      const carla_measurements &values,
+      const_array_view<uint64_t> image_frame_numbers,
+      const_array_view<uint32_t> image_camera_indices) {
+    return Protobuf::Encode(FillMeasurements(
+        values,
+        image_frame_numbers,
+        image_camera_indices,
+        _packed_agents,
+        _agents_encoding));
+  }
+
+  const_array_view<char> CarlaEncoder::Encode(
+      const carla_measurements &values,
+      const_array_view<uint64_t> image_frame_numbers,
+      const_array_view<uint32_t> image_camera_indices,
+      std::vector<char> &buffer,
+      AgentsDelta &delta,
+      const uint64_t shared_memory_sequence,
+      const uint64_t episode_id,
+      const carla_frame_timing *timing,
+      const FrameFlowControl *flow_control,
+      const_array_view<char> packed_agents,
+      const AgentBoxes *agent_boxes,
+      const ClassHistograms *class_histograms,
+      const CollisionEvents *collision_events,
+      const ControlLatency *control_latency) {
+    const AgentsDelta *agents_delta = nullptr;
+    if (_delta_agents) {
+      delta.Update(agents(values), _delta_threshold);
+      agents_delta = &delta;
+    } else {
+      delta.Reset();
+    }
+    if (_flat_measurements) {
+      const auto size = WriteFlatMeasurements(
+          values,
+          image_frame_numbers,
+          image_camera_indices,
+          agents_delta,
+          shared_memory_sequence,
+          episode_id,
+          timing,
+          flow_control,
+          agent_boxes,
+          class_histograms,
+          collision_events,
+          control_latency,
+          buffer);
+      return array_view::make_const(buffer.data(), size);
+    }
+    const auto size = Protobuf::Encode(
+        FillMeasurements(
+            values,
+            image_frame_numbers,
+            image_camera_indices,
+            _packed_agents,
+            _agents_encoding,
+            agents_delta,
+            shared_memory_sequence,
+            episode_id,
+            timing,
+            flow_control,
+            packed_agents,
+            agent_boxes,
+            class_histograms,
+            collision_events,
+            control_latency),
+        buffer);
+    return array_view::make_const(buffer.data(), size);
+  }
+
+  bool CarlaEncoder::Decode(const_array_view<char> str, RequestNewEpisode &values) {
+    Protobuf::ScopedArena arena;
+    auto *message = arena.CreateMessage<cs::RequestNewEpisode>();
+    DEBUG_ASSERT(message != nullptr);
+    message->ParseFromArray(str.data(), static_cast<int>(str.size()));
     if (message->IsInitialized()) {
       const std::string &file = message->ini_file();
       auto data = std::make_unique<char[]>(file.size());
@@ -146,6 +646,24 @@ namespace server {
       values.data = std::move(data);
       values.values.ini_file = values.data.get();
       values.values.ini_file_length = file.size();
+      values.queue = message->queue();
+      values.restore_snapshot = message->restore_snapshot();
+      values.snapshot = message->snapshot() || !values.restore_snapshot.empty();
+      values.route = message->has_route();
+      if (values.route) {
+        Set(values.route_request.start, message->route().start());
+        Set(values.route_request.end, message->route().end());
+      }
+      values.road_map = message->road_map();
+      values.road_map_request.cached_hash = message->cached_road_map_hash();
+      if (message->capabilities_size() > 0) {
+        values.capabilities = Capabilities();
+        for (auto i = 0; i < message->capabilities_size(); ++i) {
+          values.capabilities.Add(static_cast<uint32_t>(message->capabilities(i)));
+        }
+      } else {
+        values.capabilities = Capabilities::All();
+      }
       return true;
     } else {
       log_error("invalid protobuf message: request new episode");
@@ -153,10 +671,11 @@ namespace server {
     }
   }
 
-  bool CarlaEncoder::Decode(const std::string &str, carla_episode_start &values) {
-    auto *message = _protobuf.CreateMessage<cs::EpisodeStart>();
+  bool CarlaEncoder::Decode(const_array_view<char> str, carla_episode_start &values) {
+    Protobuf::ScopedArena arena;
+    auto *message = arena.CreateMessage<cs::EpisodeStart>();
     DEBUG_ASSERT(message != nullptr);
-    message->ParseFromString(str);
+    message->ParseFromArray(str.data(), static_cast<int>(str.size()));
     if (message->IsInitialized()) {
       values.player_start_spot_index = message->player_start_spot_index();
       return true;
@@ -166,16 +685,41 @@ namespace server {
     }
   }
 
-  bool CarlaEncoder::Decode(const std::string &str, carla_control &values) {
-    static thread_local auto *message = _protobuf.CreateMessage<cs::Control>();
-    DEBUG_ASSERT(message != nullptr);
-    message->ParseFromString(str);
+  bool CarlaEncoder::Decode(const_array_view<char> str, carla_control &values) {
+    // Reused every frame, we keep one per thread out of any arena.
+    static thread_local cs::Control control;
+    auto *message = &control;
+    message->ParseFromArray(str.data(), static_cast<int>(str.size()));
+    if (message->IsInitialized()) {
+      Set(values, *message);
+      return true;
+    } else {
+      log_error("invalid protobuf message: control");
+      return false;
+    }
+  }
+
+  bool CarlaEncoder::Decode(const_array_view<char> str, ControlBatch &values) {
+    // Reused every frame, we keep one per thread out of any arena.
+    static thread_local cs::Control control;
+    auto *message = &control;
+    message->ParseFromArray(str.data(), static_cast<int>(str.size()));
     if (message->IsInitialized()) {
-      values.steer = message->steer();
-      values.throttle = message->throttle();
-      values.brake = message->brake();
-      values.hand_brake = message->hand_brake();
-      values.reverse = message->reverse();
+      values.controls.resize(1u + message->next_controls_size());
+      Set(values.controls.front(), *message);
+      for (auto i = 0; i < message->next_controls_size(); ++i) {
+        Set(values.controls[i + 1u], message->next_controls(i));
+      }
+      values.skip_intermediate_measurements = message->skip_intermediate_measurements();
+      values.measurements_credit = message->measurements_credit();
+      values.has_observation_request = message->has_observation_request();
+      if (values.has_observation_request) {
+        const auto &request = message->observation_request();
+        values.observed_sensors.assign(request.sensors().begin(), request.sensors().end());
+        values.observe_non_player_agents = request.non_player_agents();
+        values.observe_agent_boxes = request.agent_boxes();
+        values.observe_class_histograms = request.class_histograms();
+      }
       return true;
     } else {
       log_error("invalid protobuf message: control");
@@ -6,18 +6,196 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "carla/ArrayView.h"
+#include "carla/server/AgentsDelta.h"
 #include "carla/server/CarlaServerAPI.h"
+#include "carla/server/ControlBatch.h"
+#include "carla/server/ControlMailbox.h"
+#include "carla/server/EncodedFrame.h"
+#include "carla/server/EpisodeReady.h"
+#include "carla/server/FlowControl.h"
+#include "carla/server/PackedAgents.h"
+#include "carla/server/ImagesFrame.h"
 #include "carla/server/Protobuf.h"
 #include "carla/server/RequestNewEpisode.h"
+#include "carla/server/RoadMap.h"
+#include "carla/server/Route.h"
+#include "carla/server/ServerMetrics.h"
+#include "carla/server/SpinWait.h"
+#include "carla/server/WorldSnapshot.h"
+#include "carla/server/WriteCompletions.h"
 
 namespace carla {
 namespace server {
 
+  class AgentBoxes;
+  class ClassHistograms;
+  class CollisionEvents;
+  class MeasurementsPublisher;
+  class SharedMemoryImages;
+  class StreamRecorder;
+
   /// Converts the data between the C interface types and the Protobuf message
   /// that is going to be sent and received through the socket.
   class CarlaEncoder {
   public:
 
+    /// In packed agents mode the non-player agents are encoded as a single
+    /// blob, see PackedAgents in carla_server.proto.
+    void SetPackedAgents(bool enable) {
+      _packed_agents = enable;
+    }
+
+    bool IsPackingAgents() const {
+      return _packed_agents;
+    }
+
+    /// Encoding of the packed agents, see AgentsEncoding in
+    /// carla_server.proto.
+    void SetAgentsEncoding(AgentsEncoding encoding) {
+      _agents_encoding = encoding;
+    }
+
+    AgentsEncoding GetAgentsEncoding() const {
+      return _agents_encoding;
+    }
+
+    /// In delta agents mode only the non-player agents that changed more than
+    /// @a threshold since the last message sent are encoded, see AgentsDelta.
+    void SetDeltaAgents(bool enable, float threshold) {
+      _delta_threshold = threshold;
+      _delta_agents = enable;
+    }
+
+    bool IsDeltaAgents() const {
+      return _delta_agents;
+    }
+
+    float GetDeltaThreshold() const {
+      return _delta_threshold;
+    }
+
+    /// If disabled, the images are sent uncompressed whatever compression
+    /// they were written with, for clients that cannot decompress them.
+    void SetCompressedImages(bool enable) {
+      _compressed_images = enable;
+    }
+
+    bool IsCompressingImages() const {
+      return _compressed_images;
+    }
+
+    /// If disabled, the images written with delta compression are sent as
+    /// LZ4 alone, for clients that cannot apply the deltas.
+    void SetDeltaImages(bool enable) {
+      _delta_images = enable;
+    }
+
+    bool IsDeltaImages() const {
+      return _delta_images;
+    }
+
+    /// In flat measurements mode the measurements are written in the
+    /// FlatMeasurements layout instead of as a Measurements protobuf, see
+    /// CAPABILITY_FLAT_MEASUREMENTS in carla_server.proto.
+    void SetFlatMeasurements(bool enable) {
+      _flat_measurements = enable;
+    }
+
+    bool IsFlatMeasurements() const {
+      return _flat_measurements;
+    }
+
+    /// How the control streams using this encoder poll for the next control
+    /// before blocking, see SpinWait.
+    void SetControlWait(const SpinWait &wait) {
+      _control_spins = wait.spins;
+      _control_yields = wait.yields;
+    }
+
+    SpinWait GetControlWait() const {
+      SpinWait wait;
+      wait.spins = _control_spins;
+      wait.yields = _control_yields;
+      return wait;
+    }
+
+    /// Once a client sends a heartbeat through a connection, reading from it
+    /// fails if nothing arrives within @a milliseconds, zero disables it. See
+    /// EncoderServer.
+    void SetLivenessTimeout(uint32_t milliseconds) {
+      _liveness_timeout_ms = milliseconds;
+    }
+
+    uint32_t GetLivenessTimeout() const {
+      return _liveness_timeout_ms;
+    }
+
+    /// If not null, the scene description announces the shared memory segment
+    /// and the measurements streams write their images into it.
+    void SetSharedMemoryImages(std::shared_ptr<SharedMemoryImages> shared_memory) {
+      std::atomic_store(&_shared_memory_images, std::move(shared_memory));
+    }
+
+    std::shared_ptr<SharedMemoryImages> GetSharedMemoryImages() const {
+      return std::atomic_load(&_shared_memory_images);
+    }
+
+    /// If not null, the measurements streams publish every message they send
+    /// to the subscribers of @a publisher too.
+    void SetPublisher(std::shared_ptr<MeasurementsPublisher> publisher) {
+      std::atomic_store(&_publisher, std::move(publisher));
+    }
+
+    std::shared_ptr<MeasurementsPublisher> GetPublisher() const {
+      return std::atomic_load(&_publisher);
+    }
+
+    /// If not null, the measurements streams record every message they send
+    /// with @a recorder too.
+    void SetRecorder(std::shared_ptr<StreamRecorder> recorder) {
+      std::atomic_store(&_recorder, std::move(recorder));
+    }
+
+    std::shared_ptr<StreamRecorder> GetRecorder() const {
+      return std::atomic_load(&_recorder);
+    }
+
+    /// Frames shared by the publisher and the recorder, see EncodedFrame.
+    EncodedFramePool &GetFramePool() {
+      return _frame_pool;
+    }
+
+    /// Metrics of the streams using this encoder, see MetricsServer.
+    ServerMetrics &GetMetrics() {
+      return *_metrics;
+    }
+
+    std::shared_ptr<const ServerMetrics> GetSharedMetrics() const {
+      return _metrics;
+    }
+
+    /// Latest control received by the control streams using this encoder.
+    ControlMailbox &GetControlMailbox() {
+      return _control_mailbox;
+    }
+
+    /// Measurements credit granted by the control streams using this
+    /// encoder, taken by the measurements streams.
+    MeasurementsCredits &GetMeasurementsCredits() {
+      return _measurements_credits;
+    }
+
+    /// Completions of the measurements written with a token, pushed by the
+    /// measurements streams using this encoder.
+    const std::shared_ptr<WriteCompletions> &GetWriteCompletions() const {
+      return _write_completions;
+    }
+
     // =========================================================================
     /// @name string encoders (for testing only)
     // =========================================================================
@@ -27,8 +205,8 @@ namespace server {
       return Protobuf::Encode(values);
     }
 
-    bool Decode(std::string message, std::string &values) {
-      values = std::move(message);
+    bool Decode(const_array_view<char> message, std::string &values) {
+      values.assign(message.begin(), message.end());
       return true;
     }
 
@@ -37,24 +215,118 @@ namespace server {
     /// @name Protobuf encodings
     // =========================================================================
     /// @{
+    ///
+    /// Decode functions parse the message straight from the given memory.
 
     std::string Encode(const carla_scene_description &values);
 
-    std::string Encode(const carla_episode_ready &values);
+    std::string Encode(const EpisodeReady &values);
+
+    std::string Encode(const WorldSnapshot &values);
+
+    std::string Encode(const Route &values);
+
+    std::string Encode(const RoadMap &values);
+
+    std::string Encode(const ImagesFrame &values);
 
     std::string Encode(const carla_measurements &values);
 
-    bool Decode(const std::string &message, RequestNewEpisode &values);
+    std::string Encode(
+        const carla_measurements &values,
+        const_array_view<uint64_t> image_frame_numbers,
+        const_array_view<uint32_t> image_camera_indices);
+
+    /// Encodes the measurements straight into @a buffer, see
+    /// Protobuf::Encode, or in the FlatMeasurements layout in flat
+    /// measurements mode. Returns the part of the buffer to be sent.
+    ///
+    /// @a delta holds the agents sent so far through the connection, it is
+    /// updated (or reset if delta agents mode is disabled) on every call.
+    ///
+    /// @a shared_memory_sequence is the slot of the shared memory holding the
+    /// images, zero if they are sent through the socket.
+    ///
+    /// @a episode_id is the episode the measurements belong to.
+    ///
+    /// @a timing, if not null, is sent as the measurements' timing block.
+    ///
+    /// @a flow_control, if not null, is sent as the measurements' flow
+    /// control block.
+    ///
+    /// @a packed_agents, if not empty, are the non-player agents of @a values
+    /// already packed, they are sent as they are. Only in packed agents mode
+    /// without delta agents, in the float32 encoding.
+    ///
+    /// @a agent_boxes, if not null, are sent as the measurements' agent
+    /// boxes, @a class_histograms as their class histograms, and
+    /// @a collision_events as their collision events.
+    ///
+    /// @a control_latency, if not null, is sent as the measurements' control
+    /// latency block.
+    const_array_view<char> Encode(
+        const carla_measurements &values,
+        const_array_view<uint64_t> image_frame_numbers,
+        const_array_view<uint32_t> image_camera_indices,
+        std::vector<char> &buffer,
+        AgentsDelta &delta,
+        uint64_t shared_memory_sequence = 0u,
+        uint64_t episode_id = 0u,
+        const carla_frame_timing *timing = nullptr,
+        const FrameFlowControl *flow_control = nullptr,
+        const_array_view<char> packed_agents = array_view::make_const<char>(nullptr, 0u),
+        const AgentBoxes *agent_boxes = nullptr,
+        const ClassHistograms *class_histograms = nullptr,
+        const CollisionEvents *collision_events = nullptr,
+        const ControlLatency *control_latency = nullptr);
+
+    bool Decode(const_array_view<char> message, RequestNewEpisode &values);
 
-    bool Decode(const std::string &message, carla_episode_start &values);
+    bool Decode(const_array_view<char> message, carla_episode_start &values);
 
-    bool Decode(const std::string &message, carla_control &values);
+    bool Decode(const_array_view<char> message, carla_control &values);
+
+    bool Decode(const_array_view<char> message, ControlBatch &values);
 
     /// @}
 
   private:
 
-    Protobuf _protobuf;
+    std::atomic_bool _packed_agents{false};
+
+    std::atomic<AgentsEncoding> _agents_encoding{AgentsEncoding::Float32};
+
+    std::atomic_bool _delta_agents{false};
+
+    std::atomic<float> _delta_threshold{0.0f};
+
+    std::atomic_bool _compressed_images{true};
+
+    std::atomic_bool _delta_images{true};
+
+    std::atomic_bool _flat_measurements{false};
+
+    std::atomic<uint32_t> _control_spins{0u};
+
+    std::atomic<uint32_t> _control_yields{0u};
+
+    std::atomic<uint32_t> _liveness_timeout_ms{0u};
+
+    std::shared_ptr<SharedMemoryImages> _shared_memory_images;
+
+    std::shared_ptr<MeasurementsPublisher> _publisher;
+
+    std::shared_ptr<StreamRecorder> _recorder;
+
+    EncodedFramePool _frame_pool;
+
+    const std::shared_ptr<ServerMetrics> _metrics = std::make_shared<ServerMetrics>();
+
+    ControlMailbox _control_mailbox;
+
+    MeasurementsCredits _measurements_credits;
+
+    const std::shared_ptr<WriteCompletions> _write_completions = std::make_shared<WriteCompletions>();
   };
 
 } // namespace server
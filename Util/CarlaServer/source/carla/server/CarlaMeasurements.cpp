@@ -8,20 +8,89 @@
 
 #include "carla/Logging.h"
 
+#include <cstring>
+#include <type_traits>
+
 namespace carla {
 namespace server {
 
-  void CarlaMeasurements::Write(const carla_measurements &measurements) {
-    _measurements = measurements;
-    const auto size = measurements.number_of_non_player_agents * sizeof(carla_agent);
+  // Layout of PackedAgents in carla_server.proto.
+  static constexpr size_t BYTES_PER_PACKED_AGENT = 2u * sizeof(uint32_t) + 10u * sizeof(float);
+
+  static_assert(sizeof(carla_vector3d) == 3u * sizeof(float), "PackedAgents layout mismatch");
+
+  void CarlaMeasurements::ReserveAgents(const uint32_t number_of_agents) {
+    const auto size = number_of_agents * sizeof(carla_agent);
     if (_agents_buffer_size < size) {
       log_info("allocating agents buffer of", size, "bytes");
-      _agents_buffer = std::make_unique<unsigned char[]>(size);
+      _agents_buffer = LargeBuffer(size, MemorySubsystem::AgentsBuffers);
       _agents_buffer_size = size;
     }
-    std::memcpy(_agents_buffer.get(), measurements.non_player_agents, size);
+  }
+
+  void CarlaMeasurements::Write(const carla_measurements &measurements) {
+    _measurements = measurements;
+    _has_packed_agents = false;
+    const auto size = measurements.number_of_non_player_agents * sizeof(carla_agent);
+    ReserveAgents(measurements.number_of_non_player_agents);
+    std::memcpy(_agents_buffer.data(), measurements.non_player_agents, size);
     _measurements.non_player_agents =
-        reinterpret_cast<const carla_agent *>(_agents_buffer.get());
+        reinterpret_cast<const carla_agent *>(_agents_buffer.data());
+  }
+
+  void CarlaMeasurements::Write(
+      const carla_measurements &measurements,
+      const carla_agent_arrays &agents) {
+    _measurements = measurements;
+    _measurements.non_player_agents = nullptr;
+    _measurements.number_of_non_player_agents = agents.number_of_agents;
+    _has_packed_agents = true;
+    // Keeps its capacity between frames.
+    const size_t count = agents.number_of_agents;
+    _packed_agents.resize(BYTES_PER_PACKED_AGENT * count);
+    char *out = _packed_agents.data();
+    auto copy_column = [&out](const void *column, size_t size) {
+      std::memcpy(out, column, size);
+      out += size;
+    };
+    copy_column(agents.ids, count * sizeof(uint32_t));
+    copy_column(agents.types, count * sizeof(uint32_t));
+    copy_column(agents.locations, count * sizeof(carla_vector3d));
+    copy_column(agents.orientations, count * sizeof(carla_vector3d));
+    copy_column(agents.box_extents, count * sizeof(carla_vector3d));
+    copy_column(agents.forward_speeds, count * sizeof(float));
+  }
+
+  void CarlaMeasurements::UnpackAgents() {
+    if (!_has_packed_agents) {
+      return;
+    }
+    const size_t count = _measurements.number_of_non_player_agents;
+    ReserveAgents(_measurements.number_of_non_player_agents);
+    auto *agents = reinterpret_cast<carla_agent *>(_agents_buffer.data());
+    const char *in = _packed_agents.data();
+    // Copies the next column into the field of each agent returned by
+    // @a field.
+    auto read_column = [&in, agents, count](auto field) {
+      using value_type = std::remove_reference_t<decltype(field(*agents))>;
+      for (size_t i = 0u; i < count; ++i) {
+        std::memcpy(&field(agents[i]), in + i * sizeof(value_type), sizeof(value_type));
+      }
+      in += count * sizeof(value_type);
+    };
+    read_column([](carla_agent &agent) -> uint32_t & { return agent.id; });
+    read_column([](carla_agent &agent) -> uint32_t & { return agent.type; });
+    read_column([](carla_agent &agent) -> carla_vector3d & { return agent.transform.location; });
+    read_column([](carla_agent &agent) -> carla_vector3d & { return agent.transform.orientation; });
+    read_column([](carla_agent &agent) -> carla_vector3d & { return agent.box_extent; });
+    read_column([](carla_agent &agent) -> float & { return agent.forward_speed; });
+    // Not part of the packed agents.
+    for (size_t i = 0u; i < count; ++i) {
+      agents[i].intersection_offroad = 0.0f;
+      agents[i].intersection_otherlane = 0.0f;
+    }
+    _measurements.non_player_agents = agents;
+    _has_packed_agents = false;
   }
 
 } // namespace server
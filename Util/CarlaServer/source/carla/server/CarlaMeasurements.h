@@ -6,10 +6,13 @@
 
 #pragma once
 
+#include "carla/ArrayView.h"
 #include "carla/NonCopyable.h"
 #include "carla/server/CarlaServerAPI.h"
+#include "carla/server/LargeBuffer.h"
 
 #include <memory>
+#include <vector>
 
 namespace carla {
 namespace server {
@@ -21,17 +24,42 @@ namespace server {
 
     void Write(const carla_measurements &measurements);
 
+    /// Same as Write but the non-player agents are taken from @a agents, and
+    /// kept only packed as they are sent, see PackedAgents in
+    /// carla_server.proto. The non_player_agents of @a measurements are
+    /// ignored, until UnpackAgents is called the ones of measurements() are
+    /// null.
+    void Write(const carla_measurements &measurements, const carla_agent_arrays &agents);
+
+    /// Unpack the agents written with carla_agent_arrays, if any, into the
+    /// non_player_agents of measurements().
+    void UnpackAgents();
+
     const carla_measurements &measurements() const {
       return _measurements;
     }
 
+    /// Packed agents written with carla_agent_arrays, empty if the agents
+    /// were written as carla_agent or are already unpacked.
+    const_array_view<char> packed_agents() const {
+      return (_has_packed_agents ?
+          array_view::make_const(_packed_agents.data(), _packed_agents.size()) :
+          array_view::make_const<char>(nullptr, 0u));
+    }
+
   private:
 
+    void ReserveAgents(uint32_t number_of_agents);
+
     carla_measurements _measurements;
 
-    std::unique_ptr<unsigned char[]> _agents_buffer = nullptr;
+    LargeBuffer _agents_buffer;
 
     uint32_t _agents_buffer_size = 0u;
+
+    std::vector<char> _packed_agents;
+
+    bool _has_packed_agents = false;
   };
 
 } // namespace server
@@ -6,12 +6,30 @@
 
 #include "carla/Debug.h"
 #include "carla/Logging.h"
+#include "carla/Profiler.h"
 #include "carla/server/AgentServer.h"
 #include "carla/server/CarlaServer.h"
+#include "carla/server/ImagesMessage.h"
+#include "carla/server/LargeBuffer.h"
+#include "carla/server/ServerThreads.h"
+#include "carla/server/StartupReport.h"
 
 using namespace carla;
 using namespace carla::server;
 
+static_assert(CARLA_SERVER_LOG_DEBUG == CARLA_SERVER_LOG_LEVEL_DEBUG, "Log levels mismatch");
+static_assert(CARLA_SERVER_LOG_INFO == CARLA_SERVER_LOG_LEVEL_INFO, "Log levels mismatch");
+static_assert(CARLA_SERVER_LOG_WARNING == CARLA_SERVER_LOG_LEVEL_WARNING, "Log levels mismatch");
+static_assert(CARLA_SERVER_LOG_ERROR == CARLA_SERVER_LOG_LEVEL_ERROR, "Log levels mismatch");
+static_assert(CARLA_SERVER_LOG_CRITICAL == CARLA_SERVER_LOG_LEVEL_CRITICAL, "Log levels mismatch");
+static_assert(CARLA_SERVER_LOG_NONE == CARLA_SERVER_LOG_LEVEL_NONE, "Log levels mismatch");
+
+using AgentsEncoding = carla::server::AgentsEncoding;
+static_assert(CARLA_SERVER_AGENTS_FLOAT32 == static_cast<uint32_t>(AgentsEncoding::Float32), "Agents encodings mismatch");
+static_assert(CARLA_SERVER_AGENTS_QUANTIZED == static_cast<uint32_t>(AgentsEncoding::Quantized), "Agents encodings mismatch");
+static_assert(CARLA_SERVER_AGENTS_QUANTIZED_DELTA == static_cast<uint32_t>(AgentsEncoding::QuantizedDelta), "Agents encodings mismatch");
+static_assert(CARLA_SERVER_AGENTS_HALF_FLOAT == static_cast<uint32_t>(AgentsEncoding::HalfFloat), "Agents encodings mismatch");
+
 // =============================================================================
 // -- Static local functions ---------------------------------------------------
 // =============================================================================
@@ -20,6 +38,25 @@ static inline carla::server::CarlaServer *Cast(CarlaServerPtr self) {
   return static_cast<carla::server::CarlaServer*>(self);
 }
 
+static bool AreValidImages(const carla_image *images, const uint32_t number_of_images) {
+  for (auto i = 0u; i < number_of_images; ++i) {
+    if (ImagesMessage::GetBytesPerPixel(images[i].encoding) == 0u) {
+      log_error("invalid encoding", images[i].encoding, "of image", i);
+      return false;
+    }
+    if (!ImagesMessage::IsValidCompression(images[i].compression)) {
+      log_error("invalid compression", images[i].compression, "of image", i);
+      return false;
+    }
+    const auto row_size = ImagesMessage::GetBytesPerPixel(images[i].encoding) * images[i].width;
+    if ((images[i].row_pitch != 0u) && (images[i].row_pitch < row_size)) {
+      log_error("invalid row pitch", images[i].row_pitch, "of image", i);
+      return false;
+    }
+  }
+  return true;
+}
+
 // =============================================================================
 // -- Implementation of the C-interface of CarlaServer -------------------------
 // =============================================================================
@@ -57,6 +94,192 @@ void carla_disconnect_server(CarlaServerPtr self) {
   Cast(self)->Disconnect();
 }
 
+int32_t carla_set_socket_options(
+      CarlaServerPtr self,
+      const uint32_t socket,
+      const carla_socket_options &values) {
+  TCPOptions options;
+  options.no_delay = values.no_delay;
+  options.reuse_address = values.reuse_address;
+  options.send_buffer_size = values.send_buffer_size;
+  options.receive_buffer_size = values.receive_buffer_size;
+  switch (socket) {
+    case CARLA_SERVER_SOCKET_WORLD:
+      Cast(self)->SetWorldSocketOptions(options);
+      break;
+    case CARLA_SERVER_SOCKET_MEASUREMENTS:
+      Cast(self)->SetMeasurementsSocketOptions(options);
+      break;
+    case CARLA_SERVER_SOCKET_CONTROL:
+      Cast(self)->SetControlSocketOptions(options);
+      break;
+    default:
+      log_error("invalid socket:", socket);
+      return errc::invalid_argument().value();
+  }
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_measurements_buffer(
+      CarlaServerPtr self,
+      const uint32_t number_of_frames,
+      const uint32_t policy) {
+  if ((number_of_frames < 2u) ||
+      ((policy != CARLA_SERVER_STREAM_DROP_OLDEST) && (policy != CARLA_SERVER_STREAM_BLOCK))) {
+    log_error("invalid measurements buffer settings:", number_of_frames, "frames, policy", policy);
+    return errc::invalid_argument().value();
+  }
+  Cast(self)->SetMeasurementsBuffer(
+      number_of_frames,
+      policy == CARLA_SERVER_STREAM_BLOCK ? RingBufferPolicy::Block : RingBufferPolicy::DropOldest);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_images_stream(
+      CarlaServerPtr self,
+      const bool enable,
+      const uint32_t number_of_frames,
+      const uint32_t policy) {
+  if ((number_of_frames < 2u) ||
+      ((policy != CARLA_SERVER_STREAM_DROP_OLDEST) && (policy != CARLA_SERVER_STREAM_BLOCK))) {
+    log_error("invalid images stream settings:", number_of_frames, "frames, policy", policy);
+    return errc::invalid_argument().value();
+  }
+  Cast(self)->SetImagesStream(
+      enable,
+      number_of_frames,
+      policy == CARLA_SERVER_STREAM_BLOCK ? RingBufferPolicy::Block : RingBufferPolicy::DropOldest);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_get_measurements_stats(
+      CarlaServerPtr self,
+      carla_stream_stats &values) {
+  return carla_get_agent_measurements_stats(self, 0u, values);
+}
+
+int32_t carla_get_agent_measurements_stats(
+      CarlaServerPtr self,
+      const uint32_t agent_index,
+      carla_stream_stats &values) {
+  auto agent = Cast(self)->GetAgentServer(agent_index);
+  if (agent == nullptr) {
+    log_debug("trying to get measurements stats but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  }
+  const auto stats = agent->GetMeasurementsStats();
+  values.number_of_writes = stats.number_of_writes;
+  values.number_of_reads = stats.number_of_reads;
+  values.number_of_drops = stats.number_of_drops;
+  values.depth = stats.depth;
+  values.max_depth = stats.max_depth;
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_packed_agents(CarlaServerPtr self, const bool enable) {
+  Cast(self)->SetPackedAgents(enable);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_agents_encoding(CarlaServerPtr self, const uint32_t encoding) {
+  if (encoding > CARLA_SERVER_AGENTS_HALF_FLOAT) {
+    log_error("invalid agents encoding:", encoding);
+    return errc::invalid_argument().value();
+  }
+  Cast(self)->SetAgentsEncoding(static_cast<AgentsEncoding>(encoding));
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_delta_agents(
+      CarlaServerPtr self,
+      const bool enable,
+      const float threshold) {
+  if (!(threshold >= 0.0f)) {
+    log_error("invalid delta agents threshold:", threshold);
+    return errc::invalid_argument().value();
+  }
+  Cast(self)->SetDeltaAgents(enable, threshold);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_shared_memory_images(CarlaServerPtr self, const bool enable) {
+  Cast(self)->SetSharedMemoryImages(enable);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_gpu_shared_images(CarlaServerPtr self, const bool enable) {
+  Cast(self)->SetGpuSharedImages(enable);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_get_gpu_shared_images(CarlaServerPtr self, bool &enabled) {
+  enabled = Cast(self)->IsGpuSharedImagesEnabled();
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_measurements_publisher(
+      CarlaServerPtr self,
+      const bool enable,
+      const uint32_t max_queued_frames) {
+  if (max_queued_frames == 0u) {
+    log_error("invalid publisher settings:", max_queued_frames, "queued frames");
+    return errc::invalid_argument().value();
+  }
+  return Cast(self)->SetPublisher(enable, max_queued_frames).value();
+}
+
+int32_t carla_set_stream_recorder(
+      CarlaServerPtr self,
+      const bool enable,
+      const char *directory,
+      const uint32_t segment_size_mb) {
+  if (enable && ((directory == nullptr) || (*directory == '\0') || (segment_size_mb == 0u))) {
+    log_error("invalid recorder settings:", segment_size_mb, "MB segments");
+    return errc::invalid_argument().value();
+  }
+  const uint64_t segment_size = 1024u * 1024u * static_cast<uint64_t>(segment_size_mb);
+  return Cast(self)->SetRecorder(enable, (directory != nullptr ? directory : ""), segment_size).value();
+}
+
+int32_t carla_set_metrics_server(CarlaServerPtr self, const bool enable) {
+  return Cast(self)->SetMetricsServer(enable).value();
+}
+
+int32_t carla_set_memory_usage(CarlaServerPtr self, const carla_memory_usage &values) {
+  Cast(self)->SetMemoryUsage(values);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_persistent_agent_connections(CarlaServerPtr self, const bool enable) {
+  Cast(self)->SetPersistentAgentConnections(enable);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_control_wait(
+      CarlaServerPtr self,
+      const uint32_t spins,
+      const uint32_t yields) {
+  SpinWait wait;
+  wait.spins = spins;
+  wait.yields = yields;
+  Cast(self)->SetControlWait(wait);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_liveness_timeout(CarlaServerPtr self, const uint32_t milliseconds) {
+  Cast(self)->SetLivenessTimeout(milliseconds);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_number_of_agents(CarlaServerPtr self, const uint32_t number_of_agents) {
+  if ((number_of_agents == 0u) || (number_of_agents > WorldServer::MaxNumberOfAgents)) {
+    log_error("invalid number of agents:", number_of_agents);
+    return errc::invalid_argument().value();
+  }
+  Cast(self)->SetNumberOfAgents(number_of_agents);
+  return CARLA_SERVER_SUCCESS;
+}
+
 int32_t carla_read_request_new_episode(
       CarlaServerPtr self,
       carla_request_new_episode &values,
@@ -65,11 +288,65 @@ int32_t carla_read_request_new_episode(
   auto ec = Cast(self)->TryRead(values, timeout_t::milliseconds(timeout));
   if (!ec) {
     log_debug("received valid request new episode");
-    Cast(self)->KillAgentServer();
+    Cast(self)->StopAgentServer();
   }
   return ec.value();
 }
 
+int32_t carla_read_queued_episode(
+      CarlaServerPtr self,
+      carla_request_new_episode &values) {
+  return Cast(self)->TryReadQueued(values).value();
+}
+
+int32_t carla_read_world_snapshot_request(
+      CarlaServerPtr self,
+      carla_world_snapshot_request &values) {
+  return Cast(self)->TryReadSnapshotRequest(values).value();
+}
+
+int32_t carla_write_world_snapshot(
+      CarlaServerPtr self,
+      const carla_world_snapshot &values,
+      const uint32_t timeout) {
+  auto result = Cast(self)->Write(values);
+  error_code ec = errc::timed_out();
+  future::wait_and_get(result, ec, timeout_t::milliseconds(timeout));
+  return ec.value();
+}
+
+int32_t carla_read_route_request(
+      CarlaServerPtr self,
+      carla_route_request &values) {
+  return Cast(self)->TryReadRouteRequest(values).value();
+}
+
+int32_t carla_write_route(
+      CarlaServerPtr self,
+      const carla_route &values,
+      const uint32_t timeout) {
+  auto result = Cast(self)->Write(values);
+  error_code ec = errc::timed_out();
+  future::wait_and_get(result, ec, timeout_t::milliseconds(timeout));
+  return ec.value();
+}
+
+int32_t carla_read_road_map_request(
+      CarlaServerPtr self,
+      carla_road_map_request &values) {
+  return Cast(self)->TryReadRoadMapRequest(values).value();
+}
+
+int32_t carla_write_road_map(
+      CarlaServerPtr self,
+      const carla_road_map &values,
+      const uint32_t timeout) {
+  auto result = Cast(self)->Write(values);
+  error_code ec = errc::timed_out();
+  future::wait_and_get(result, ec, timeout_t::milliseconds(timeout));
+  return ec.value();
+}
+
 int32_t carla_write_scene_description(
       CarlaServerPtr self,
       const carla_scene_description &values,
@@ -103,6 +380,10 @@ int32_t carla_write_episode_ready(
   return ec.value();
 }
 
+int32_t carla_start_offline_episode(CarlaServerPtr self) {
+  return Cast(self)->StartOfflineAgentServer().value();
+}
+
 int32_t carla_read_control(
       CarlaServerPtr self,
       carla_control &values,
@@ -116,19 +397,304 @@ int32_t carla_read_control(
   return agent->ReadControl(values, timeout_t::milliseconds(timeout)).value();
 }
 
+int32_t carla_read_control_batch(
+      CarlaServerPtr self,
+      carla_control_batch &values,
+      const uint32_t timeout) {
+  return carla_read_agent_control_batch(self, 0u, values, timeout);
+}
+
+int32_t carla_read_agent_control_batch(
+      CarlaServerPtr self,
+      const uint32_t agent_index,
+      carla_control_batch &values,
+      const uint32_t timeout) {
+  CARLA_PROFILE_SCOPE(C_API, ReadControl);
+  auto agent = Cast(self)->GetAgentServer(agent_index);
+  if (agent == nullptr) {
+    log_debug("trying to read control but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  }
+  return agent->ReadControlBatch(values, timeout_t::milliseconds(timeout)).value();
+}
+
+int32_t carla_read_latest_control(
+      CarlaServerPtr self,
+      carla_control &values,
+      carla_control_status &status) {
+  CARLA_PROFILE_SCOPE(C_API, ReadControl);
+  auto agent = Cast(self)->GetAgentServer();
+  if (agent == nullptr) {
+    log_debug("trying to read control but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  }
+  ControlMailbox::Latest latest;
+  const auto ec = agent->ReadLatestControl(latest);
+  if (!ec) {
+    values = latest.control;
+    status.number_of_controls = latest.number_of_controls;
+    status.age_in_frames = latest.age_in_frames;
+    status.age_in_milliseconds = std::chrono::duration<float, std::milli>(latest.age).count();
+  }
+  return ec.value();
+}
+
 int32_t carla_write_measurements(
       CarlaServerPtr self,
       const carla_measurements &values,
       const struct carla_image *images,
       const uint32_t number_of_images) {
+  return carla_write_agent_measurements(self, 0u, values, images, number_of_images);
+}
+
+int32_t carla_write_agent_measurements(
+      CarlaServerPtr self,
+      const uint32_t agent_index,
+      const carla_measurements &values,
+      const struct carla_image *images,
+      const uint32_t number_of_images) {
   CARLA_PROFILE_SCOPE(C_API, WriteMeasurements);
+  carla::Profiler::SetFrameNumber(values.frame_number);
+  auto agent = Cast(self)->GetAgentServer(agent_index);
+  if (agent == nullptr) {
+    log_debug("trying to write measurements but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  } else if (!AreValidImages(images, number_of_images)) {
+    return errc::invalid_argument().value();
+  } else {
+    return agent->WriteMeasurements(
+        values,
+        carla::const_array_view<carla_image>(images, number_of_images)).value();
+  }
+}
+
+int32_t carla_write_measurements_arrays(
+      CarlaServerPtr self,
+      const carla_measurements &values,
+      const carla_agent_arrays &agents,
+      const struct carla_image *images,
+      const uint32_t number_of_images) {
+  CARLA_PROFILE_SCOPE(C_API, WriteMeasurementsArrays);
+  carla::Profiler::SetFrameNumber(values.frame_number);
   auto agent = Cast(self)->GetAgentServer();
+  const bool valid_agents = (agents.number_of_agents == 0u) || (
+      (agents.ids != nullptr) &&
+      (agents.types != nullptr) &&
+      (agents.locations != nullptr) &&
+      (agents.orientations != nullptr) &&
+      (agents.box_extents != nullptr) &&
+      (agents.forward_speeds != nullptr));
   if (agent == nullptr) {
     log_debug("trying to write measurements but agent server is missing");
     return CARLA_SERVER_OPERATION_ABORTED;
+  } else if (!valid_agents || !AreValidImages(images, number_of_images)) {
+    return errc::invalid_argument().value();
   } else {
     return agent->WriteMeasurements(
         values,
+        agents,
         carla::const_array_view<carla_image>(images, number_of_images)).value();
   }
 }
+
+int32_t carla_write_measurements_leased(
+      CarlaServerPtr self,
+      const carla_measurements &values,
+      const struct carla_image *images,
+      const uint32_t number_of_images,
+      const carla_release_callback release,
+      void *user_data) {
+  CARLA_PROFILE_SCOPE(C_API, WriteMeasurementsLeased);
+  carla::Profiler::SetFrameNumber(values.frame_number);
+  auto agent = Cast(self)->GetAgentServer();
+  if (agent == nullptr) {
+    log_debug("trying to write measurements but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  } else if ((release == nullptr) || !AreValidImages(images, number_of_images)) {
+    return errc::invalid_argument().value();
+  } else {
+    return agent->WriteMeasurementsLeased(
+        values,
+        carla::const_array_view<carla_image>(images, number_of_images),
+        FrameLease{release, user_data}).value();
+  }
+}
+
+int32_t carla_write_measurements_async(
+      CarlaServerPtr self,
+      const carla_measurements &values,
+      const struct carla_image *images,
+      const uint32_t number_of_images,
+      const uint64_t token) {
+  CARLA_PROFILE_SCOPE(C_API, WriteMeasurementsAsync);
+  carla::Profiler::SetFrameNumber(values.frame_number);
+  auto agent = Cast(self)->GetAgentServer();
+  if (agent == nullptr) {
+    log_debug("trying to write measurements but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  } else if (!AreValidImages(images, number_of_images)) {
+    return errc::invalid_argument().value();
+  } else {
+    return agent->WriteMeasurementsAsync(
+        values,
+        carla::const_array_view<carla_image>(images, number_of_images),
+        token).value();
+  }
+}
+
+int32_t carla_poll_write_completions(
+      CarlaServerPtr self,
+      struct carla_write_completion *completions,
+      const uint32_t max_completions,
+      uint32_t &number_of_completions) {
+  carla::mutable_array_view<carla_write_completion> view(completions, max_completions);
+  number_of_completions = Cast(self)->GetWriteCompletions().Poll(view);
+  return (number_of_completions > 0u ?
+      errc::success().value() :
+      errc::try_again().value());
+}
+
+int32_t carla_acquire_image_buffer(
+      CarlaServerPtr self,
+      const struct carla_image *images,
+      const uint32_t number_of_images,
+      uint32_t **image_data) {
+  CARLA_PROFILE_SCOPE(C_API, AcquireImageBuffer);
+  auto agent = Cast(self)->GetAgentServer();
+  if (agent == nullptr) {
+    log_debug("trying to acquire image buffer but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  } else if (!AreValidImages(images, number_of_images)) {
+    return errc::invalid_argument().value();
+  } else {
+    carla::mutable_array_view<uint32_t *> data(image_data, number_of_images);
+    return agent->AcquireImageBuffer(
+        carla::const_array_view<carla_image>(images, number_of_images),
+        data).value();
+  }
+}
+
+int32_t carla_commit_image_buffer(
+      CarlaServerPtr self,
+      const carla_measurements &values) {
+  CARLA_PROFILE_SCOPE(C_API, CommitImageBuffer);
+  carla::Profiler::SetFrameNumber(values.frame_number);
+  auto agent = Cast(self)->GetAgentServer();
+  if (agent == nullptr) {
+    log_debug("trying to commit image buffer but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  } else {
+    return agent->CommitImageBuffer(values).value();
+  }
+}
+
+int32_t carla_set_frame_timing(
+      CarlaServerPtr self,
+      const carla_frame_timing &timing) {
+  auto agent = Cast(self)->GetAgentServer();
+  if (agent == nullptr) {
+    log_debug("trying to set frame timing but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  }
+  agent->SetFrameTiming(timing);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_applied_control(
+      CarlaServerPtr self,
+      const uint64_t sequence_number) {
+  auto agent = Cast(self)->GetAgentServer();
+  if (agent == nullptr) {
+    log_debug("trying to set applied control but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  }
+  agent->SetAppliedControl(sequence_number);
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_agent_boxes(
+      CarlaServerPtr self,
+      const struct carla_camera_agent_boxes *cameras,
+      const uint32_t number_of_cameras) {
+  auto agent = Cast(self)->GetAgentServer();
+  if (agent == nullptr) {
+    log_debug("trying to set agent boxes but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  }
+  agent->SetAgentBoxes(carla::array_view::make_const(cameras, number_of_cameras));
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_class_histograms(
+      CarlaServerPtr self,
+      const struct carla_class_histogram *histograms,
+      const uint32_t number_of_histograms) {
+  auto agent = Cast(self)->GetAgentServer();
+  if (agent == nullptr) {
+    log_debug("trying to set class histograms but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  }
+  agent->SetClassHistograms(carla::array_view::make_const(histograms, number_of_histograms));
+  return CARLA_SERVER_SUCCESS;
+}
+
+int32_t carla_set_collision_events(
+      CarlaServerPtr self,
+      const struct carla_collision_event *events,
+      const uint32_t number_of_events) {
+  auto agent = Cast(self)->GetAgentServer();
+  if (agent == nullptr) {
+    log_debug("trying to set collision events but agent server is missing");
+    return CARLA_SERVER_OPERATION_ABORTED;
+  }
+  agent->SetCollisionEvents(carla::array_view::make_const(events, number_of_events));
+  return CARLA_SERVER_SUCCESS;
+}
+
+void carla_set_profiler_event_capture(const bool enable, const uint32_t events_per_thread) {
+  if (enable) {
+    carla::Profiler::EnableEventCapture(events_per_thread);
+  } else {
+    carla::Profiler::DisableEventCapture();
+  }
+}
+
+int32_t carla_dump_profiler_trace(const char *filename) {
+  if ((filename == nullptr) || !carla::Profiler::DumpChromeTrace(filename)) {
+    log_error("failed to write profiler trace");
+    return errc::invalid_argument().value();
+  }
+  return CARLA_SERVER_SUCCESS;
+}
+
+void carla_set_log_level(const int32_t level) {
+  carla::logging::set_level(level);
+}
+
+void carla_set_async_logging(const bool enable) {
+  carla::logging::set_async(enable);
+}
+
+int32_t carla_set_thread_options(const carla_thread_options &options) {
+  if ((options.number_of_cpus > 0u) && (options.cpus == nullptr)) {
+    log_error("invalid thread options: missing cpus");
+    return errc::invalid_argument().value();
+  }
+  ThreadOptions values;
+  values.cpus.assign(options.cpus, options.cpus + options.number_of_cpus);
+  values.priority = options.priority;
+  return ServerThreads::SetOptions(values).value();
+}
+
+void carla_mark_startup_phase(const char *phase, const double seconds_since_start) {
+  if (phase != nullptr) {
+    StartupReport::Mark(phase, seconds_since_start);
+  }
+}
+
+void carla_set_buffer_options(const carla_buffer_options &options) {
+  LargeBufferOptions values;
+  values.huge_pages = options.huge_pages;
+  values.numa_local = options.numa_local;
+  LargeBuffer::SetOptions(values);
+}
@@ -6,12 +6,16 @@
 
 #pragma once
 
-#if defined(_MSC_VER)
-#  define CARLA_SERVER_API __declspec(dllexport) extern
-#elif defined(__GNUC__) || defined(__clang__)
-#  define CARLA_SERVER_API __attribute__((visibility("default"))) extern
-#else
-#  error Compiler not supported!
-#endif
+// carla_server.h falls back to a plain extern when a test or a client
+// includes it first, the library sources include this header before it.
+#ifndef CARLA_SERVER_API
+#  if defined(_MSC_VER)
+#    define CARLA_SERVER_API __declspec(dllexport) extern
+#  elif defined(__GNUC__) || defined(__clang__)
+#    define CARLA_SERVER_API __attribute__((visibility("default"))) extern
+#  else
+#    error Compiler not supported!
+#  endif
+#endif // CARLA_SERVER_API
 
 #include <carla/carla_server.h>
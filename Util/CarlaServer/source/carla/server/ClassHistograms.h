@@ -0,0 +1,68 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "carla/ArrayView.h"
+#include "carla/server/CarlaServerAPI.h"
+
+namespace carla {
+namespace server {
+
+  /// Pixels per semantic label of each camera, see ClassHistogram in
+  /// carla_server.proto. The buffers keep their memory between frames.
+  class ClassHistograms {
+  public:
+
+    struct Camera {
+      uint32_t camera_index = 0u;
+      std::vector<uint32_t> counts;
+    };
+
+    void Write(const_array_view<carla_class_histogram> histograms) {
+      if (_cameras.size() < histograms.size()) {
+        _cameras.resize(histograms.size());
+      }
+      _size = histograms.size();
+      for (size_t i = 0u; i < _size; ++i) {
+        const auto &histogram = histograms[i];
+        auto &camera = _cameras[i];
+        camera.camera_index = histogram.camera_index;
+        camera.counts.assign(
+            histogram.counts,
+            histogram.counts + histogram.number_of_classes);
+      }
+    }
+
+    void Clear() {
+      _size = 0u;
+    }
+
+    bool empty() const {
+      return _size == 0u;
+    }
+
+    const_array_view<Camera> cameras() const {
+      return array_view::make_const(_cameras.data(), _size);
+    }
+
+    void swap(ClassHistograms &other) {
+      _cameras.swap(other._cameras);
+      std::swap(_size, other._size);
+    }
+
+  private:
+
+    std::vector<Camera> _cameras;
+
+    size_t _size = 0u;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,48 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <vector>
+
+#include "carla/ArrayView.h"
+#include "carla/server/CarlaServerAPI.h"
+
+namespace carla {
+namespace server {
+
+  /// Collisions of the player during the last frame, see CollisionEvent in
+  /// carla_server.proto. The buffer keeps its memory between frames.
+  class CollisionEvents {
+  public:
+
+    void Write(const_array_view<carla_collision_event> events) {
+      _events.assign(events.begin(), events.end());
+    }
+
+    void Clear() {
+      _events.clear();
+    }
+
+    bool empty() const {
+      return _events.empty();
+    }
+
+    const_array_view<carla_collision_event> events() const {
+      return array_view::make_const(_events.data(), _events.size());
+    }
+
+    void swap(CollisionEvents &other) {
+      _events.swap(other._events);
+    }
+
+  private:
+
+    std::vector<carla_collision_event> _events;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,111 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "carla/StopWatch.h"
+#include "carla/server/CarlaServerAPI.h"
+
+namespace carla {
+namespace server {
+
+  /// Controls received in a single Control message, to be applied one per
+  /// tick. Holds at least one control once decoded.
+  struct ControlBatch {
+    std::vector<carla_control> controls;
+    bool skip_intermediate_measurements = false;
+    /// Measurements credit granted with this message, see
+    /// MeasurementsCredits.
+    uint32_t measurements_credit = 0u;
+    /// Observation request sent along, see
+    /// Control.observation_request in carla_server.proto.
+    bool has_observation_request = false;
+    std::vector<uint32_t> observed_sensors;
+    bool observe_non_player_agents = false;
+    bool observe_agent_boxes = false;
+    bool observe_class_histograms = false;
+    /// When the message was read from the socket.
+    StopWatch::clock::time_point receive_time;
+  };
+
+  /// Latency of the last control applied, sent with the measurements, see
+  /// Measurements.ControlLatency in carla_server.proto. The times are
+  /// microseconds since the epoch of the StopWatch's clock, zero if unknown.
+  struct ControlLatency {
+    uint64_t sequence_number = 0u;
+    uint64_t receive_us = 0u;
+    uint64_t apply_us = 0u;
+    uint64_t capture_us = 0u;
+    uint64_t send_us = 0u;
+
+    static uint64_t ToMicroseconds(StopWatch::clock::time_point time) {
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+          time.time_since_epoch()).count());
+    }
+  };
+
+  /// Sent in place of the size of a protobuf message, a heartbeat instead of
+  /// a message, see EncoderServer. Protobuf messages may be empty, so no size
+  /// a message can have is used.
+  constexpr uint32_t HEARTBEAT_MESSAGE = 0xFFFFFFFFu;
+
+  /// Fixed-size control message, read straight from the socket instead of a
+  /// Control protobuf, see EpisodeReady.binary_control in carla_server.proto.
+  /// Little-endian, 16 bytes, not prepended by any size.
+  struct BinaryControl {
+    static constexpr uint32_t MAGIC = 0xCA7C0000u;
+    static constexpr uint32_t MAGIC_MASK = 0xFFFF0000u;
+    static constexpr uint32_t HAND_BRAKE = 1u << 0;
+    static constexpr uint32_t REVERSE = 1u << 1;
+    /// Not a control but a heartbeat, see EncoderServer.
+    static constexpr uint32_t HEARTBEAT = 1u << 2;
+
+    /// Whether @a word, read where the size of a protobuf message is
+    /// expected, is the header of a binary control. No protobuf message is
+    /// that large.
+    static bool IsHeader(uint32_t word) {
+      return (word & MAGIC_MASK) == MAGIC;
+    }
+
+    bool IsHeartbeat() const {
+      return IsHeader(header) && ((header & HEARTBEAT) != 0u);
+    }
+
+    /// MAGIC in the upper half, the flags in the lower.
+    uint32_t header;
+    float steer;
+    float throttle;
+    float brake;
+
+    /// Fill @a values with a batch of this single control, false if the
+    /// header is not valid.
+    bool Decode(ControlBatch &values) const {
+      if (!IsHeader(header)) {
+        return false;
+      }
+      values.controls.resize(1u);
+      auto &control = values.controls.front();
+      control.steer = steer;
+      control.throttle = throttle;
+      control.brake = brake;
+      control.hand_brake = ((header & HAND_BRAKE) != 0u);
+      control.reverse = ((header & REVERSE) != 0u);
+      control.sequence_number = 0u;
+      values.skip_intermediate_measurements = false;
+      values.measurements_credit = 0u;
+      values.has_observation_request = false;
+      return true;
+    }
+  };
+
+  static_assert(sizeof(BinaryControl) == 16u, "BinaryControl must be 16 bytes");
+
+} // namespace server
+} // namespace carla
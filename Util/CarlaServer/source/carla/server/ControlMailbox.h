@@ -0,0 +1,134 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#include "carla/NonCopyable.h"
+#include "carla/StopWatch.h"
+#include "carla/server/CarlaServerAPI.h"
+
+namespace carla {
+namespace server {
+
+  /// Holds the last control received, so the game can always get the most
+  /// recent one, and how old it is, without blocking nor consuming it.
+  ///
+  /// A seqlock: the writer bumps the sequence to odd, stores the value and
+  /// bumps it back to even; readers copy the value and retry if the sequence
+  /// changed meanwhile. The value is kept in atomic words so the copies never
+  /// race.
+  ///
+  /// @warning Only one thread may call Publish.
+  class ControlMailbox : private NonCopyable {
+  public:
+
+    struct Latest {
+      carla_control control;
+      /// Number of controls published since the last Clear, including this.
+      uint64_t number_of_controls;
+      /// Measurements frames written since the control arrived.
+      uint64_t age_in_frames;
+      StopWatch::clock::duration age;
+    };
+
+    /// Publish @a control as the latest one. Called by the control stream.
+    void Publish(const carla_control &control) {
+      const auto count = _published.load(std::memory_order_relaxed) + 1u;
+      Value value;
+      std::memset(&value, 0, sizeof(value));
+      value.control = control;
+      value.count = count;
+      value.frame_number = _frame_number.load(std::memory_order_relaxed);
+      value.arrival = StopWatch::clock::now().time_since_epoch().count();
+      Words words{};
+      std::memcpy(words.data(), &value, sizeof(value));
+
+      const auto sequence = _sequence.load(std::memory_order_relaxed);
+      _sequence.store(sequence + 1u, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (auto i = 0u; i < words.size(); ++i) {
+        _words[i].store(words[i], std::memory_order_relaxed);
+      }
+      _sequence.store(sequence + 2u, std::memory_order_release);
+      _published.store(count, std::memory_order_relaxed);
+    }
+
+    /// Latest control published since the last Clear, returns false if
+    /// there is none. Never blocks, may retry while a control is published.
+    bool Read(Latest &latest) const {
+      Value value;
+      for (;;) {
+        const auto sequence = _sequence.load(std::memory_order_acquire);
+        if ((sequence & 1u) != 0u) {
+          std::this_thread::yield();
+          continue;
+        }
+        Words words;
+        for (auto i = 0u; i < words.size(); ++i) {
+          words[i] = _words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_sequence.load(std::memory_order_relaxed) == sequence) {
+          std::memcpy(&value, words.data(), sizeof(value));
+          break;
+        }
+      }
+      const auto cleared = _cleared.load(std::memory_order_relaxed);
+      if (value.count <= cleared) {
+        return false;
+      }
+      const auto frame_number = _frame_number.load(std::memory_order_relaxed);
+      latest.control = value.control;
+      latest.number_of_controls = value.count - cleared;
+      latest.age_in_frames = (frame_number > value.frame_number ? frame_number - value.frame_number : 0u);
+      latest.age =
+          StopWatch::clock::now().time_since_epoch() -
+          StopWatch::clock::duration(value.arrival);
+      return true;
+    }
+
+    /// Forget the controls published so far, e.g. on a new episode.
+    void Clear() {
+      _cleared.store(_published.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    /// Frame number of the last measurements written, the age in frames of
+    /// the controls is measured against it.
+    void SetFrameNumber(uint64_t frame_number) {
+      _frame_number.store(frame_number, std::memory_order_relaxed);
+    }
+
+  private:
+
+    struct Value {
+      carla_control control;
+      uint64_t count;
+      uint64_t frame_number;
+      StopWatch::clock::rep arrival;
+    };
+
+    using Words = std::array<uint64_t, (sizeof(Value) + sizeof(uint64_t) - 1u) / sizeof(uint64_t)>;
+
+    std::atomic<uint64_t> _sequence{0u};
+
+    std::array<std::atomic<uint64_t>, std::tuple_size<Words>::value> _words{};
+
+    std::atomic<uint64_t> _published{0u};
+
+    std::atomic<uint64_t> _cleared{0u};
+
+    std::atomic<uint64_t> _frame_number{0u};
+  };
+
+} // namespace server
+} // namespace carla
@@ -15,6 +15,7 @@
 
 #include "carla/Logging.h"
 #include "carla/server/ServerTraits.h"
+#include "carla/server/SpinWait.h"
 
 namespace carla {
 namespace server {
@@ -78,15 +79,20 @@ namespace detail {
     ///
     /// Returns nullptr if the time-out was met, or the DoubleBuffer is marked
     /// as done.
-    auto TryMakeReader(timeout_t timeout) {
+    ///
+    /// With a non-zero time-out the buffers are first polled as configured by
+    /// @a wait, without taking the mutex, and only then the reader blocks. The
+    /// polling does not count against the time-out.
+    auto TryMakeReader(timeout_t timeout, const SpinWait &wait = SpinWait()) {
       const auto deleter = [this](const T *ptr) { if (ptr) EndReading(); };
       ActiveBuffer active = NUMBER_OF_BUFFERS;
-      {
+      const auto ready = [&] {
+        active = StartReading();
+        return _done || (active != NUMBER_OF_BUFFERS);
+      };
+      if ((timeout.to_chrono().count() == 0) || !wait.Poll(ready)) {
         std::unique_lock<std::mutex> lock(_mutex);
-        _condition.wait_for(lock, timeout.to_chrono(), [&] {
-          active = StartReading();
-          return _done || (active != NUMBER_OF_BUFFERS);
-        });
+        _condition.wait_for(lock, timeout.to_chrono(), ready);
       }
       const T *pointer = (active != NUMBER_OF_BUFFERS ? &_buffer[active] : nullptr);
       return std::unique_ptr<const T, decltype(deleter)>(pointer, deleter);
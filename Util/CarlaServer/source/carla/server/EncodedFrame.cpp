@@ -0,0 +1,139 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/EncodedFrame.h"
+
+#include <mutex>
+
+#include "carla/Debug.h"
+
+namespace carla {
+namespace server {
+
+  // ===========================================================================
+  // -- detail::EncodedFramePoolState ------------------------------------------
+  // ===========================================================================
+
+namespace detail {
+
+  /// Shared with the frames in use, so they can be released after the pool is
+  /// destroyed.
+  class EncodedFramePoolState : private NonCopyable {
+  public:
+
+    explicit EncodedFramePoolState(const uint32_t max_free_frames)
+      : max_free_frames(max_free_frames) {}
+
+    ~EncodedFramePoolState() {
+      for (auto *frame : free_frames) {
+        delete frame;
+      }
+    }
+
+    /// Take ownership of @a frame back, freeing it if the pool is full or
+    /// closed.
+    void Recycle(EncodedFrame *frame) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!closed && (free_frames.size() < max_free_frames)) {
+          free_frames.push_back(frame);
+          return;
+        }
+      }
+      delete frame;
+    }
+
+    const uint32_t max_free_frames;
+
+    mutable std::mutex mutex;
+
+    std::vector<EncodedFrame *> free_frames;
+
+    uint64_t number_of_frames = 0u;
+
+    uint64_t number_of_allocations = 0u;
+
+    bool closed = false;
+  };
+
+} // namespace detail
+
+  // ===========================================================================
+  // -- EncodedFrame -----------------------------------------------------------
+  // ===========================================================================
+
+  EncodedFramePtr EncodedFrame::Make(const const_buffer measurements, const const_buffer images) {
+    auto *frame = new EncodedFrame();
+    frame->Write(measurements, images);
+    return EncodedFramePtr(frame);
+  }
+
+  void EncodedFrame::Write(const const_buffer measurements, const const_buffer images) {
+    _measurements_size = boost::asio::buffer_size(measurements);
+    // Keeps the capacity of the last frame written.
+    _data.resize(_measurements_size + boost::asio::buffer_size(images));
+    boost::asio::buffer_copy(boost::asio::buffer(_data), measurements);
+    boost::asio::buffer_copy(boost::asio::buffer(_data) + _measurements_size, images);
+  }
+
+  void intrusive_ptr_release(const EncodedFrame *frame) {
+    if (frame->_references.fetch_sub(1u, std::memory_order_acq_rel) == 1u) {
+      // Nobody else references the frame, it can be written again.
+      auto *mutable_frame = const_cast<EncodedFrame *>(frame);
+      auto pool = std::move(mutable_frame->_pool);
+      if (pool != nullptr) {
+        pool->Recycle(mutable_frame);
+      } else {
+        delete mutable_frame;
+      }
+    }
+  }
+
+  // ===========================================================================
+  // -- EncodedFramePool -------------------------------------------------------
+  // ===========================================================================
+
+  EncodedFramePool::EncodedFramePool(const uint32_t max_free_frames)
+    : _state(std::make_shared<detail::EncodedFramePoolState>(max_free_frames)) {}
+
+  EncodedFramePool::~EncodedFramePool() {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    _state->closed = true;
+  }
+
+  EncodedFramePtr EncodedFramePool::Make(const const_buffer measurements, const const_buffer images) {
+    EncodedFrame *frame = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(_state->mutex);
+      ++_state->number_of_frames;
+      if (!_state->free_frames.empty()) {
+        frame = _state->free_frames.back();
+        _state->free_frames.pop_back();
+      } else {
+        ++_state->number_of_allocations;
+      }
+    }
+    if (frame == nullptr) {
+      frame = new EncodedFrame();
+    }
+    DEBUG_ASSERT(frame->_references == 0u);
+    // Copied out of the lock, the frame is not shared yet.
+    frame->Write(measurements, images);
+    frame->_pool = _state;
+    return EncodedFramePtr(frame);
+  }
+
+  EncodedFramePool::Stats EncodedFramePool::GetStats() const {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    Stats stats;
+    stats.number_of_frames = _state->number_of_frames;
+    stats.number_of_allocations = _state->number_of_allocations;
+    stats.number_of_free_frames = static_cast<uint32_t>(_state->free_frames.size());
+    return stats;
+  }
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,135 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+
+#include "carla/ArrayView.h"
+#include "carla/NonCopyable.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  class EncodedFrame;
+
+  /// Shared reference to an immutable EncodedFrame.
+  using EncodedFramePtr = boost::intrusive_ptr<const EncodedFrame>;
+
+namespace detail {
+
+  class EncodedFramePoolState;
+
+} // namespace detail
+
+  /// A measurements message followed by its images message, exactly as sent
+  /// to the agent client, see StreamRecorder and MeasurementsPublisher.
+  ///
+  /// A frame is written once and then only read, so any number of sinks may
+  /// hold a reference to it, from any thread, without copying it. Frames made
+  /// by an EncodedFramePool go back to the pool when the last reference is
+  /// dropped, keeping their memory for the next frame.
+  class EncodedFrame : private NonCopyable {
+  public:
+
+    /// Copy @a measurements and @a images into a frame not owned by any pool.
+    static EncodedFramePtr Make(const_buffer measurements, const_buffer images);
+
+    const unsigned char *data() const {
+      return _data.data();
+    }
+
+    /// Bytes of both messages.
+    size_t size() const {
+      return _data.size();
+    }
+
+    /// Measurements message, size prefix included.
+    const_buffer measurements() const {
+      return boost::asio::buffer(_data.data(), _measurements_size);
+    }
+
+    /// Images message, size prefix included.
+    const_buffer images() const {
+      return boost::asio::buffer(_data.data() + _measurements_size, _data.size() - _measurements_size);
+    }
+
+    /// Both messages, one after the other.
+    const_buffer buffer() const {
+      return boost::asio::buffer(_data.data(), _data.size());
+    }
+
+  private:
+
+    friend class EncodedFramePool;
+
+    friend class detail::EncodedFramePoolState;
+
+    friend void intrusive_ptr_add_ref(const EncodedFrame *frame);
+
+    friend void intrusive_ptr_release(const EncodedFrame *frame);
+
+    EncodedFrame() = default;
+
+    void Write(const_buffer measurements, const_buffer images);
+
+    mutable std::atomic<uint32_t> _references{0u};
+
+    std::vector<unsigned char> _data;
+
+    size_t _measurements_size = 0u;
+
+    /// Pool the frame goes back to, null if none. Set only while the frame is
+    /// referenced, so the pool outlives every frame in use.
+    std::shared_ptr<detail::EncodedFramePoolState> _pool;
+  };
+
+  inline void intrusive_ptr_add_ref(const EncodedFrame *frame) {
+    frame->_references.fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  void intrusive_ptr_release(const EncodedFrame *frame);
+
+  /// Recycles the EncodedFrames of a stream, so steady-state frames of
+  /// similar size do not allocate. Thread-safe, frames may be made and
+  /// released from any thread.
+  class EncodedFramePool : private NonCopyable {
+  public:
+
+    struct Stats {
+      /// Frames made so far.
+      uint64_t number_of_frames;
+      /// Frames that had to be allocated because the pool was empty.
+      uint64_t number_of_allocations;
+      /// Frames idle in the pool.
+      uint32_t number_of_free_frames;
+    };
+
+    /// At most @a max_free_frames idle frames are kept, the rest are freed
+    /// once released.
+    explicit EncodedFramePool(uint32_t max_free_frames = 8u);
+
+    /// Frames still referenced are freed once released.
+    ~EncodedFramePool();
+
+    /// Copy @a measurements and @a images into a recycled frame.
+    EncodedFramePtr Make(const_buffer measurements, const_buffer images);
+
+    Stats GetStats() const;
+
+  private:
+
+    const std::shared_ptr<detail::EncodedFramePoolState> _state;
+  };
+
+} // namespace server
+} // namespace carla
@@ -6,90 +6,496 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "carla/ArrayView.h"
+#include "carla/Debug.h"
 #include "carla/NonCopyable.h"
 #include "carla/Logging.h"
+#include "carla/StopWatch.h"
+#include "carla/server/AgentsDelta.h"
 #include "carla/server/CarlaEncoder.h"
+#include "carla/server/ControlBatch.h"
+#include "carla/server/ImagesDelta.h"
 #include "carla/server/MeasurementsMessage.h"
+#include "carla/server/MeasurementsPublisher.h"
 #include "carla/server/ServerTraits.h"
+#include "carla/server/SharedMemoryImages.h"
+#include "carla/server/StreamRecorder.h"
 
 namespace carla {
 namespace server {
 
   /// Wrapper around a server for encoding and decoding the messages with a
   /// CarlaEncoder.
+  ///
+  /// Every operation is asynchronous on top of those of the server (see
+  /// TCPServer), it returns right away and calls the handler on completion.
+  /// Only one operation may be in progress at a time, see AsyncServer.
+  ///
+  /// A size prefix equal to HEARTBEAT_MESSAGE is a keep-alive with no
+  /// payload; the reader skips it and reads the next size. Once the client
+  /// sends one through this connection, each read fails if nothing arrives
+  /// within the liveness time-out of the encoder, so a client that vanished
+  /// is noticed long before the time-out of the read.
   template <typename SERVER>
   class EncoderServer : private NonCopyable {
   public:
 
     using server_type = SERVER;
     using encoder_type = CarlaEncoder;
+    using completion_handler = std::function<void(const error_code &)>;
 
     template<typename... Args>
     explicit EncoderServer(encoder_type &encoder, Args&&... args)
       : _server(std::forward<Args>(args)...),
         _encoder(encoder) {}
 
-    error_code Connect(uint32_t port, time_duration timeout) {
-      return _server.Connect(port, timeout);
+    void AsyncConnect(uint32_t port, time_duration timeout, completion_handler handler) {
+      _server.AsyncConnect(port, timeout, std::move(handler));
     }
 
     void Disconnect() {
       _server.Disconnect();
     }
 
-    /// @warning Since every received message consists of two Reads, the timeout
-    /// applies to each individual Read. Effectively, it may wait twice the
-    /// timeout.
+    template <typename OPTIONS>
+    void SetOptions(const OPTIONS &options) {
+      _server.SetOptions(options);
+    }
+
+    /// @warning Since every received message consists of two reads, the
+    /// timeout applies to each individual read. Effectively, it may wait twice
+    /// the timeout.
+    ///
+    /// @warning @a values must be kept alive until @a handler is called.
+    template <typename T>
+    void AsyncRead(T &values, time_duration timeout, completion_handler handler) {
+      AsyncReadMessage(timeout, [this, &values, handler](error_code ec) {
+        if (!ec) {
+          ec = Decode(values);
+        }
+        handler(ec);
+      });
+    }
+
+    /// Same as above, and the last control of the batch is published as the
+    /// latest control, see ControlMailbox. Any measurements credit received
+    /// is granted right away, see MeasurementsCredits.
+    ///
+    /// Once the client sends a BinaryControl, it is expected to send only
+    /// those through this connection, and each one is read with a single
+    /// read into the control, skipping the protobuf decoding. Its heartbeats
+    /// are binary controls with the BinaryControl::HEARTBEAT flag.
+    void AsyncRead(ControlBatch &values, time_duration timeout, completion_handler handler) {
+      auto on_read = [this, &values, handler](const error_code &ec) {
+        if (!ec) {
+          DEBUG_ASSERT(!values.controls.empty());
+          values.receive_time = StopWatch::clock::now();
+          _encoder.GetControlMailbox().Publish(values.controls.back());
+          _encoder.GetMeasurementsCredits().Grant(values.measurements_credit);
+        }
+        handler(ec);
+      };
+      AsyncReadControlBatch(values, GetDeadline(timeout), timeout, std::move(on_read));
+    }
+
+    /// @warning @a values must be kept alive until @a handler is called.
+    template <typename T>
+    void AsyncWrite(const T &values, time_duration timeout, completion_handler handler) {
+      _message = _encoder.Encode(values);
+      _buffers[0u] = boost::asio::buffer(_message);
+      _server.AsyncWrite(array_view::make_const(_buffers, 1u), timeout, std::move(handler));
+    }
+
+    /// Measurements and images are sent with a single vectored write, the
+    /// image buffer is not copied unless some image has to be packed or
+    /// compressed. The measurements and images are encoded into the message's
+    /// own buffers in this (networking) thread.
+    ///
+    /// If the encoder has a shared memory segment, the images are written into
+    /// it and an empty image message is sent instead.
+    ///
+    /// If the encoder has a publisher, the same message is published to its
+    /// subscribers, and if it has a recorder, the same message is recorded.
+    /// Both share a single copy of the message, see EncodedFrame.
+    ///
+    /// A raw frame, see MeasurementsMessage::WriteRawFrame, is sent as is. A
+    /// leased frame, see MeasurementsMessage::WriteLeased, is copied here
+    /// first.
+    ///
+    /// If the client grants measurements credit, waits for it before sending,
+    /// see MeasurementsCredits. The wait ends only when credit is granted or
+    /// reset, so the credits must be reset before disconnecting.
+    ///
+    /// The completion of the message, if any, is pushed with the result.
+    void AsyncWrite(const MeasurementsMessage &values, time_duration timeout, completion_handler handler) {
+      auto retry = [this, &values, timeout, handler]() {
+        // Called in the thread granting the credit.
+        _server.AsyncPost([this, &values, timeout, handler]() {
+          AsyncWrite(values, timeout, handler);
+        });
+      };
+      if (!_encoder.GetMeasurementsCredits().TryAcquire(std::move(retry))) {
+        return;
+      }
+      AsyncWriteMeasurements(values, timeout, [&values, handler](const error_code &ec) {
+        values.Complete(ec);
+        handler(ec);
+      });
+    }
+
+    /// The images of a frame sent through the separate images stream, after
+    /// a small message identifying them, see ImagesFrame.
+    void AsyncWrite(const ImagesFrame &values, time_duration timeout, completion_handler handler) {
+      if (values.episode_id() != _episode_id) {
+        _episode_id = values.episode_id();
+        _images_delta.Reset();
+      }
+      _message = _encoder.Encode(values);
+      _buffers[0u] = boost::asio::buffer(_message);
+      _buffers[1u] = values.encoded_images(_encoder.IsCompressingImages(), GetImagesDelta());
+      _server.AsyncWrite(array_view::make_const(_buffers, 2u), timeout, std::move(handler));
+    }
+
+  private:
+
+    /// Decode the message read into _buffer.
     template <typename T>
-    error_code Read(T &values, time_duration timeout) {
-      std::string string;
-      auto ec = ReadString(string, timeout);
-      if (!ec && !_encoder.Decode(string, values)) {
+    error_code Decode(T &values) {
+      if (_encoder.Decode(array_view::make_const(_buffer.data(), _message_size), values)) {
+        return errc::success();
+      }
+      return error_code(
+          boost::system::errc::illegal_byte_sequence,
+          boost::system::system_category());
+    }
+
+    void AsyncReadControlBatch(
+        ControlBatch &values,
+        const StopWatch::clock::time_point deadline,
+        const time_duration timeout,
+        completion_handler handler) {
+      auto on_binary = [this, &values, deadline, timeout, handler](const error_code &ec) {
+        OnBinaryControl(values, deadline, timeout, ec, handler);
+      };
+      if (_binary_control) {
+        _server.AsyncRead(
+            boost::asio::buffer(&_binary, sizeof(_binary)),
+            GetReadTimeout(deadline),
+            std::move(on_binary));
+        return;
+      }
+      AsyncReadMessageSize(deadline, [this, &values, timeout, handler, on_binary](const error_code &ec) {
+        if (ec) {
+          handler(ec);
+          return;
+        }
+        if (!BinaryControl::IsHeader(_message_size)) {
+          AsyncReadMessageBody(timeout, [this, &values, handler](error_code ec) {
+            if (!ec) {
+              ec = Decode(values);
+            }
+            handler(ec);
+          });
+          return;
+        }
+        log_debug("client switched to binary controls");
+        _binary_control = true;
+        _binary.header = _message_size;
+        _message_size = 0u;
+        _server.AsyncRead(
+            boost::asio::buffer(&_binary.steer, sizeof(_binary) - sizeof(_binary.header)),
+            timeout,
+            on_binary);
+      });
+    }
+
+    /// Heartbeats are skipped, reading the next control until @a deadline.
+    void OnBinaryControl(
+        ControlBatch &values,
+        const StopWatch::clock::time_point deadline,
+        const time_duration timeout,
+        error_code ec,
+        completion_handler handler) {
+      if (!ec && _binary.IsHeartbeat()) {
+        _heartbeats = true;
+        ec = CheckDeadline(deadline);
+        if (!ec) {
+          AsyncReadControlBatch(values, deadline, timeout, std::move(handler));
+          return;
+        }
+      }
+      if (!ec && !_binary.Decode(values)) {
+        log_error("invalid binary control");
         ec.assign(
             boost::system::errc::illegal_byte_sequence,
             boost::system::system_category());
       }
-      return ec;
+      handler(ec);
     }
 
-    template <typename T>
-    error_code Write(const T &values, time_duration timeout) {
-      const auto string = _encoder.Encode(values);
-      return _server.Write(boost::asio::buffer(string), timeout);
+    void AsyncWriteMeasurements(
+        const MeasurementsMessage &values,
+        const time_duration timeout,
+        completion_handler handler) {
+      const auto encode_start = StopWatch::clock::now();
+      if (values.has_raw_frame()) {
+        _buffers[0u] = values.raw_measurements();
+        _buffers[1u] = values.raw_images();
+        AsyncSend(encode_start, timeout, std::move(handler));
+        return;
+      }
+      values.StageLeasedFrame();
+      if (values.episode_id() != _episode_id) {
+        // Every agent and key frame is sent again in the first message of an
+        // episode.
+        _episode_id = values.episode_id();
+        _agents_delta.Reset();
+        _images_delta.Reset();
+      }
+      // The encode and send times known are those of the previous message.
+      const carla_frame_timing *timing = nullptr;
+      if (values.timing() != nullptr) {
+        _timing = *values.timing();
+        _timing.encode = _last_encode_ms;
+        _timing.queue_wait = ToMilliseconds(encode_start - values.timing_start());
+        _timing.send = _last_send_ms;
+        timing = &_timing;
+      }
+      const ControlLatency *control_latency = nullptr;
+      if (values.control_latency() != nullptr) {
+        _control_latency = *values.control_latency();
+        _control_latency.send_us = ControlLatency::ToMicroseconds(encode_start);
+        control_latency = &_control_latency;
+      }
+      const FrameFlowControl *flow_control = nullptr;
+      if (values.server_frame_id() != 0u) {
+        _flow_control.dropped_frames =
+            (values.server_frame_id() > _flow_control.server_frame_id + 1u ?
+                values.server_frame_id() - _flow_control.server_frame_id - 1u :
+                0u);
+        _flow_control.server_frame_id = values.server_frame_id();
+        _flow_control.queue_depth = values.queue_depth();
+        flow_control = &_flow_control;
+      }
+      // Agents written packed are sent as they are if nothing else is needed.
+      auto packed_agents = values.packed_agents();
+      if (!_encoder.IsPackingAgents() ||
+          _encoder.IsFlatMeasurements() ||
+          _encoder.IsDeltaAgents() ||
+          (_encoder.GetAgentsEncoding() != AgentsEncoding::Float32)) {
+        values.UnpackAgents();
+        packed_agents = array_view::make_const<char>(nullptr, 0u);
+      }
+      const auto images = values.encoded_images(_encoder.IsCompressingImages(), GetImagesDelta());
+      const auto shared_memory = _encoder.GetSharedMemoryImages();
+      const uint64_t sequence = (shared_memory != nullptr ? shared_memory->Write(images) : 0u);
+      const auto encoded = _encoder.Encode(
+          values.measurements(),
+          values.image_frame_numbers(),
+          values.image_camera_indices(),
+          values.encode_buffer(),
+          _agents_delta,
+          sequence,
+          _episode_id,
+          timing,
+          flow_control,
+          packed_agents,
+          &values.agent_boxes(),
+          &values.class_histograms(),
+          &values.collision_events(),
+          control_latency);
+      static const uint32_t EMPTY_MESSAGE = 0u;
+      _buffers[0u] = boost::asio::buffer(encoded.data(), encoded.size());
+      _buffers[1u] = (sequence > 0u ? boost::asio::buffer(&EMPTY_MESSAGE, sizeof(EMPTY_MESSAGE)) : images);
+      AsyncSend(encode_start, timeout, std::move(handler));
     }
 
-    /// @warning This operation consists of two Writes, the timeout applies to
-    /// each individual Write. Effectively, it may wait twice the timeout.
-    error_code Write(const MeasurementsMessage &values, time_duration timeout) {
-      const auto string = _encoder.Encode(values.measurements());
-      auto ec = _server.Write(boost::asio::buffer(string), timeout);
-      if (!ec) {
-        ec = _server.Write(values.images(), timeout);
+    /// Publish, record and send the measurements and images in _buffers.
+    /// The message slot is reused once sent, so the sinks other than the
+    /// client share an EncodedFrame, copied only if there is any sink.
+    void AsyncSend(
+        const StopWatch::clock::time_point encode_start,
+        const time_duration timeout,
+        completion_handler handler) {
+      auto publisher = _encoder.GetPublisher();
+      if ((publisher != nullptr) && !publisher->HasSubscribers()) {
+        publisher = nullptr;
+      }
+      const auto recorder = _encoder.GetRecorder();
+      if ((publisher != nullptr) || (recorder != nullptr)) {
+        const auto frame = _encoder.GetFramePool().Make(_buffers[0u], _buffers[1u]);
+        if (publisher != nullptr) {
+          publisher->Publish(frame);
+        }
+        if (recorder != nullptr) {
+          recorder->Record(frame);
+        }
       }
-      return ec;
+      const auto send_start = StopWatch::clock::now();
+      auto on_sent = [this, encode_start, send_start, handler](const error_code &ec) {
+        const auto send_end = StopWatch::clock::now();
+        _last_encode_ms = ToMilliseconds(send_start - encode_start);
+        _last_send_ms = ToMilliseconds(send_end - send_start);
+        auto &metrics = _encoder.GetMetrics();
+        if (ec) {
+          metrics.AddSendError();
+        } else {
+          metrics.AddFrameSent(
+              boost::asio::buffer_size(_buffers[0u]) + boost::asio::buffer_size(_buffers[1u]),
+              ToMicroseconds(send_start - encode_start),
+              ToMicroseconds(send_end - send_start));
+        }
+        handler(ec);
+      };
+      _server.AsyncWrite(array_view::make_const(_buffers, 2u), timeout, std::move(on_sent));
     }
 
-  private:
+    /// Null if the client cannot apply image deltas. The images previously
+    /// sent are forgotten then, so the deltas start again with a key frame.
+    ImagesDelta *GetImagesDelta() {
+      if (!_encoder.IsDeltaImages()) {
+        _images_delta.Reset();
+        return nullptr;
+      }
+      return &_images_delta;
+    }
+
+    static float ToMilliseconds(StopWatch::clock::duration duration) {
+      return std::chrono::duration<float, std::milli>(duration).count();
+    }
+
+    static uint64_t ToMicroseconds(StopWatch::clock::duration duration) {
+      return static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    }
+
+    /// Read the next message into _buffer, which only grows so it is
+    /// allocated just once for messages of similar size.
+    void AsyncReadMessage(const time_duration timeout, completion_handler handler) {
+      AsyncReadMessageSize(GetDeadline(timeout), [this, timeout, handler](const error_code &ec) {
+        if (ec) {
+          handler(ec);
+          return;
+        }
+        AsyncReadMessageBody(timeout, handler);
+      });
+    }
 
-    error_code ReadString(std::string &string, time_duration timeout) {
-       // Get the message's size.
-      uint32_t message_size;
-      auto ec = _server.Read(boost::asio::buffer(&message_size, sizeof(uint32_t)), timeout);
-      if (ec) {
-        return ec;
+    /// Heartbeats received meanwhile are skipped.
+    void AsyncReadMessageSize(
+        const StopWatch::clock::time_point deadline,
+        completion_handler handler) {
+      _server.AsyncRead(
+          boost::asio::buffer(&_message_size, sizeof(uint32_t)),
+          GetReadTimeout(deadline),
+          [this, deadline, handler](error_code ec) {
+        if (!ec && (_message_size == HEARTBEAT_MESSAGE)) {
+          _heartbeats = true;
+          ec = CheckDeadline(deadline);
+          if (!ec) {
+            AsyncReadMessageSize(deadline, handler);
+            return;
+          }
+        }
+        if (ec) {
+          _message_size = 0u;
+        }
+        handler(ec);
+      });
+    }
+
+    /// An infinite @a timeout never expires.
+    static StopWatch::clock::time_point GetDeadline(time_duration timeout) {
+      return (timeout.is_pos_infinity() ?
+          StopWatch::clock::time_point::max() :
+          StopWatch::clock::now() + timeout_t(timeout).to_chrono());
+    }
+
+    /// Time-out of the next read to finish by @a deadline, shortened to the
+    /// liveness time-out once the client sends heartbeats.
+    time_duration GetReadTimeout(StopWatch::clock::time_point deadline) const {
+      const auto liveness = _encoder.GetLivenessTimeout();
+      const bool alive = _heartbeats && (liveness > 0u);
+      if (deadline == StopWatch::clock::time_point::max()) {
+        return (alive ? time_duration(boost::posix_time::milliseconds(liveness)) : time_duration(boost::posix_time::pos_infin));
       }
-      // Knowing the size now we can Read the message.
-      auto buffer = std::make_unique<char[]>(message_size);
-      ec = _server.Read(boost::asio::buffer(buffer.get(), message_size), timeout);
-      if (!ec) {
-        string.assign(buffer.get(), message_size);
+      const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - StopWatch::clock::now()).count();
+      auto milliseconds = std::max<int64_t>(remaining, 0);
+      if (alive) {
+        milliseconds = std::min<int64_t>(milliseconds, liveness);
       }
-      return ec;
+      return boost::posix_time::milliseconds(milliseconds);
+    }
+
+    static error_code CheckDeadline(StopWatch::clock::time_point deadline) {
+      return (StopWatch::clock::now() < deadline ? errc::success() : errc::timed_out());
+    }
+
+    /// Knowing the size now we can read the message.
+    void AsyncReadMessageBody(const time_duration timeout, completion_handler handler) {
+      if (_buffer.size() < _message_size) {
+        _buffer.resize(_message_size);
+      }
+      _server.AsyncRead(
+          boost::asio::buffer(_buffer.data(), _message_size),
+          timeout,
+          std::move(handler));
     }
 
     server_type _server;
 
     encoder_type &_encoder;
+
+    /// Receive buffer of this connection.
+    std::vector<char> _buffer;
+
+    uint32_t _message_size = 0u;
+
+    /// Control being read once the client sends BinaryControl messages.
+    BinaryControl _binary;
+
+    /// Message being sent, if encoded aside from the values.
+    std::string _message;
+
+    /// Buffers being sent.
+    const_buffer _buffers[2u];
+
+    /// Whether the client sends BinaryControl messages.
+    bool _binary_control = false;
+
+    /// Whether the client sends heartbeats through this connection.
+    bool _heartbeats = false;
+
+    /// Non-player agents sent so far through this connection.
+    AgentsDelta _agents_delta;
+
+    /// Last image of each delta compressed camera sent through this
+    /// connection.
+    ImagesDelta _images_delta;
+
+    /// Episode of the last measurements sent through this connection.
+    uint64_t _episode_id = 0u;
+
+    /// Timing block of the message being sent.
+    carla_frame_timing _timing;
+
+    /// Control latency block of the message being sent.
+    ControlLatency _control_latency;
+
+    /// Flow control block of the last message sent.
+    FrameFlowControl _flow_control;
+
+    /// Encode and send times of the last message.
+    float _last_encode_ms = 0.0f;
+
+    float _last_send_ms = 0.0f;
   };
 
 } // namespace server
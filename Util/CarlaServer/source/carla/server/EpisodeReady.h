@@ -0,0 +1,29 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "carla/server/Capabilities.h"
+#include "carla/server/CarlaServerAPI.h"
+
+namespace carla {
+namespace server {
+
+  /// Holds a carla_episode_ready together with the state of the agent
+  /// connections the world server sends along with it.
+  struct EpisodeReady {
+    carla_episode_ready values;
+    uint64_t episode_id;
+    bool persistent_agent_connections;
+    bool agent_connections_reused;
+    uint32_t number_of_agents;
+    bool separate_images_stream;
+    /// Optional encodings used in the episode.
+    Capabilities capabilities;
+  };
+
+} // namespace server
+} // namespace carla
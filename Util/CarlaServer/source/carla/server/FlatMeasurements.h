@@ -0,0 +1,301 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <carla/carla_server.h>
+
+#include "carla/ArrayView.h"
+
+namespace carla {
+namespace server {
+
+  /// Layout of the measurements sent in place of the Measurements protobuf to
+  /// the clients that negotiate CAPABILITY_FLAT_MEASUREMENTS, prefixed by its
+  /// size as any other message. The fields are at fixed offsets of the header
+  /// or in sections the header points to, so a client reads any of them
+  /// straight from its receive buffer without parsing the rest, and the
+  /// server writes the message straight into its send buffer.
+  ///
+  /// Little-endian, the structures below are the schema, see also
+  /// carla_server.md. Every section starts at a multiple of 8 bytes from the
+  /// start of the message.
+  struct FlatMeasurements {
+    static constexpr uint32_t MAGIC = 0x4D464143u; // "CAFM"
+    static constexpr uint32_t VERSION = 1u;
+
+    /// @name Header flags
+    /// @{
+
+    static constexpr uint32_t HAS_TIMING = 1u << 0;
+    static constexpr uint32_t HAS_FLOW_CONTROL = 1u << 1;
+    static constexpr uint32_t HAS_CONTROL_LATENCY = 1u << 2;
+    /// Only the agents that changed are sent, see AgentsDelta.
+    static constexpr uint32_t AGENTS_DELTA = 1u << 3;
+
+    /// @}
+
+    /// @name AI control flags
+    /// @{
+
+    static constexpr uint32_t HAND_BRAKE = 1u << 0;
+    static constexpr uint32_t REVERSE = 1u << 1;
+
+    /// @}
+
+    /// Sections of the header, in this order.
+    enum Section : uint32_t {
+      ImageFrameNumbers,   ///< uint64_t
+      ImageCameraIndices,  ///< uint32_t
+      Agents,              ///< Agent
+      RemovedAgents,       ///< uint32_t ids
+      CollisionEvents,     ///< CollisionEvent
+      AgentBoxes,          ///< Blob, data as AgentBoxes in carla_server.proto
+      ClassHistograms,     ///< Blob, data the uint32_t count of each class
+      NumberOfSections
+    };
+
+    /// Size of each element of @a section.
+    static constexpr uint32_t ElementSize(Section section);
+
+    struct Player {
+      carla_vector3d location;
+      carla_vector3d orientation;
+      carla_vector3d acceleration;
+      float forward_speed;
+      float collision_vehicles;
+      float collision_pedestrians;
+      float collision_other;
+      float intersection_otherlane;
+      float intersection_offroad;
+      float ai_steer;
+      float ai_throttle;
+      float ai_brake;
+      uint32_t ai_flags;
+      uint32_t padding;
+    };
+
+    /// Milliseconds, as FrameTiming in carla_server.proto.
+    struct Timing {
+      float game_tick;
+      float ai;
+      float capture_readback;
+      float encode;
+      float queue_wait;
+      float send;
+      float pacing_wait;
+      float pacing_jitter;
+    };
+
+    struct FlowControl {
+      uint64_t server_frame_id;
+      uint64_t dropped_frames;
+      uint32_t queue_depth;
+      uint32_t padding;
+    };
+
+    /// As ControlLatency in carla_server.proto.
+    struct ControlLatency {
+      uint64_t last_applied_control_sequence;
+      uint64_t receive_us;
+      uint64_t apply_us;
+      uint64_t capture_us;
+      uint64_t send_us;
+    };
+
+    /// Where a section is, @a offset from the start of the message.
+    struct SectionEntry {
+      uint32_t offset;
+      uint32_t count;
+    };
+
+    /// The blocks not flagged as present are zeroed.
+    struct Header {
+      uint32_t magic;
+      uint32_t version;
+      /// Size of the header, later versions may append fields.
+      uint32_t header_size;
+      uint32_t flags;
+      uint64_t frame_number;
+      uint64_t episode_id;
+      uint64_t shared_memory_images_sequence;
+      uint32_t platform_timestamp;
+      uint32_t game_timestamp;
+      Player player;
+      Timing timing;
+      FlowControl flow_control;
+      ControlLatency control_latency;
+      SectionEntry sections[NumberOfSections];
+    };
+
+    struct Agent {
+      uint32_t id;
+      uint32_t type;
+      carla_vector3d location;
+      carla_vector3d orientation;
+      carla_vector3d box_extent;
+      float forward_speed;
+      float intersection_offroad;
+      float intersection_otherlane;
+    };
+
+    struct CollisionEvent {
+      uint32_t other_actor_id;
+      uint32_t label;
+      float normal_impulse;
+    };
+
+    /// Per-camera data, @a size bytes at @a offset from the start of the
+    /// message. @a count is the number of boxes or classes.
+    struct Blob {
+      uint32_t camera_index;
+      uint32_t count;
+      uint32_t offset;
+      uint32_t size;
+    };
+
+    static constexpr uint32_t Align(uint32_t size) {
+      return (size + 7u) & ~7u;
+    }
+  };
+
+  constexpr uint32_t FlatMeasurements::ElementSize(const Section section) {
+    return
+        (section == ImageFrameNumbers ? sizeof(uint64_t) :
+        (section == Agents ? sizeof(Agent) :
+        (section == CollisionEvents ? sizeof(CollisionEvent) :
+        ((section == AgentBoxes) || (section == ClassHistograms) ? sizeof(Blob) :
+        sizeof(uint32_t)))));
+  }
+
+  static_assert(sizeof(FlatMeasurements::Player) == 80u, "FlatMeasurements layout mismatch");
+  static_assert(sizeof(FlatMeasurements::Header) == 280u, "FlatMeasurements layout mismatch");
+  static_assert(offsetof(FlatMeasurements::Header, player) == 48u, "FlatMeasurements layout mismatch");
+  static_assert(offsetof(FlatMeasurements::Header, sections) == 224u, "FlatMeasurements layout mismatch");
+  static_assert(sizeof(FlatMeasurements::Agent) == 56u, "FlatMeasurements layout mismatch");
+  static_assert(sizeof(FlatMeasurements::CollisionEvent) == 12u, "FlatMeasurements layout mismatch");
+
+  /// Reads a FlatMeasurements message in place, nothing is copied. The
+  /// message must outlive the view and start at a multiple of 8 bytes, as
+  /// any buffer from the heap does.
+  class FlatMeasurementsView {
+  public:
+
+    using Layout = FlatMeasurements;
+
+    /// @a message without its size prefix.
+    explicit FlatMeasurementsView(const_array_view<char> message)
+      : _message(message) {}
+
+    /// Whether the message is a FlatMeasurements of a known version whose
+    /// sections and blobs are all within its bounds. The accessors below
+    /// must not be called otherwise.
+    bool IsValid() const {
+      const auto address = reinterpret_cast<uintptr_t>(_message.data());
+      if (((address % 8u) != 0u) || (_message.size() < sizeof(Layout::Header))) {
+        return false;
+      }
+      const auto &head = header();
+      if ((head.magic != Layout::MAGIC) ||
+          (head.version != Layout::VERSION) ||
+          (head.header_size < sizeof(Layout::Header)) ||
+          (head.header_size > _message.size())) {
+        return false;
+      }
+      for (auto i = 0u; i < Layout::NumberOfSections; ++i) {
+        const auto section = static_cast<Layout::Section>(i);
+        const auto &entry = head.sections[i];
+        if (((entry.offset % 8u) != 0u) ||
+            !IsWithinBounds(entry.offset, uint64_t(entry.count) * Layout::ElementSize(section))) {
+          return false;
+        }
+      }
+      for (auto &blob : agent_boxes()) {
+        if (!IsWithinBounds(blob.offset, blob.size)) {
+          return false;
+        }
+      }
+      for (auto &blob : class_histograms()) {
+        if (((blob.offset % 4u) != 0u) ||
+            (blob.size != uint64_t(blob.count) * sizeof(uint32_t)) ||
+            !IsWithinBounds(blob.offset, blob.size)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    const Layout::Header &header() const {
+      return *reinterpret_cast<const Layout::Header *>(_message.data());
+    }
+
+    bool has(uint32_t flag) const {
+      return (header().flags & flag) != 0u;
+    }
+
+    const_array_view<uint64_t> image_frame_numbers() const {
+      return Get<uint64_t>(Layout::ImageFrameNumbers);
+    }
+
+    const_array_view<uint32_t> image_camera_indices() const {
+      return Get<uint32_t>(Layout::ImageCameraIndices);
+    }
+
+    const_array_view<Layout::Agent> agents() const {
+      return Get<Layout::Agent>(Layout::Agents);
+    }
+
+    const_array_view<uint32_t> removed_agents() const {
+      return Get<uint32_t>(Layout::RemovedAgents);
+    }
+
+    const_array_view<Layout::CollisionEvent> collision_events() const {
+      return Get<Layout::CollisionEvent>(Layout::CollisionEvents);
+    }
+
+    const_array_view<Layout::Blob> agent_boxes() const {
+      return Get<Layout::Blob>(Layout::AgentBoxes);
+    }
+
+    const_array_view<Layout::Blob> class_histograms() const {
+      return Get<Layout::Blob>(Layout::ClassHistograms);
+    }
+
+    /// The boxes of a camera of agent_boxes().
+    const_array_view<char> boxes(const Layout::Blob &blob) const {
+      return array_view::make_const(_message.data() + blob.offset, blob.size);
+    }
+
+    /// The counts of a camera of class_histograms().
+    const_array_view<uint32_t> counts(const Layout::Blob &blob) const {
+      return array_view::make_const(
+          reinterpret_cast<const uint32_t *>(_message.data() + blob.offset),
+          blob.count);
+    }
+
+  private:
+
+    bool IsWithinBounds(uint64_t offset, uint64_t size) const {
+      return (offset <= _message.size()) && (size <= _message.size() - offset);
+    }
+
+    template <typename T>
+    const_array_view<T> Get(Layout::Section section) const {
+      const auto &entry = header().sections[section];
+      return array_view::make_const(
+          reinterpret_cast<const T *>(_message.data() + entry.offset),
+          entry.count);
+    }
+
+    const_array_view<char> _message;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,122 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include "carla/NonCopyable.h"
+
+namespace carla {
+namespace server {
+
+  /// Flow control block sent with each measurements message, so the client
+  /// knows whether it falls behind.
+  struct FrameFlowControl {
+    /// Increases by one with every measurements message queued for the
+    /// connection, the ids skipped were dropped.
+    uint64_t server_frame_id = 0u;
+    /// Messages dropped since the previous one sent.
+    uint64_t dropped_frames = 0u;
+    /// Messages waiting to be sent when this one was queued.
+    uint32_t queue_depth = 0u;
+  };
+
+  /// Credit granted by the client to send measurements, see
+  /// Control.measurements_credit in carla_server.proto.
+  ///
+  /// Until the client grants any credit the measurements are sent as they
+  /// come. Once it does, each message sent takes one credit and the sender
+  /// waits while there is none left. The measurements pile up meanwhile, and
+  /// are dropped or block the simulation according to the RingBufferPolicy.
+  class MeasurementsCredits : private NonCopyable {
+  public:
+
+    /// Grant @a credit more messages, zero is ignored.
+    void Grant(uint32_t credit) {
+      if (credit == 0u) {
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _enabled = true;
+        _credit += credit;
+      }
+      _condition.notify_all();
+      CallRetry();
+    }
+
+    /// Take one credit, blocks until there is some. Returns immediately if
+    /// the client never granted any credit since the last Reset.
+    void Acquire() {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _condition.wait(lock, [this]() { return !_enabled || (_credit > 0u); });
+      if (_enabled) {
+        --_credit;
+      }
+    }
+
+    /// Same as Acquire without blocking. Returns false if there is no credit
+    /// left, then @a retry is called once some is granted or on Reset. It is
+    /// called in the thread granting the credit and should not block.
+    bool TryAcquire(std::function<void()> retry) {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_enabled) {
+          return true;
+        }
+        if (_credit > 0u) {
+          --_credit;
+          return true;
+        }
+        _retry = std::move(retry);
+      }
+      return false;
+    }
+
+    /// Go back to sending without credit, and wake up the sender if it is
+    /// waiting. Called on every new episode and when the agent disconnects.
+    void Reset() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _enabled = false;
+        _credit = 0u;
+      }
+      _condition.notify_all();
+      CallRetry();
+    }
+
+  private:
+
+    void CallRetry() {
+      std::function<void()> retry;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        retry = std::move(_retry);
+        _retry = nullptr;
+      }
+      if (retry) {
+        retry();
+      }
+    }
+
+    std::mutex _mutex;
+
+    std::condition_variable _condition;
+
+    /// Sender waiting asynchronously, see TryAcquire.
+    std::function<void()> _retry;
+
+    bool _enabled = false;
+
+    uint64_t _credit = 0u;
+  };
+
+} // namespace server
+} // namespace carla
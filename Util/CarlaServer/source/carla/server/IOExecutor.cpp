@@ -0,0 +1,65 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/IOExecutor.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "carla/Logging.h"
+#include "carla/server/ServerThreads.h"
+
+namespace carla {
+namespace server {
+
+  static uint32_t GetNumberOfThreads(const uint32_t number_of_threads) {
+    if (number_of_threads > 0u) {
+      return number_of_threads;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  IOExecutor::IOExecutor(const uint32_t number_of_threads)
+    : _service(),
+      _timer_wheel(_service),
+      _work(std::make_unique<boost::asio::io_service::work>(_service)) {
+    const auto count = GetNumberOfThreads(number_of_threads);
+    log_debug("starting I/O executor with", count, "threads");
+    _threads.reserve(count);
+    for (auto i = 0u; i < count; ++i) {
+      _threads.emplace_back([this]() {
+        ServerThreads::Scope scope;
+        _service.run();
+      });
+    }
+  }
+
+  IOExecutor::~IOExecutor() {
+    // Let the threads finish the pending handlers and exit, the wheel's timer
+    // would keep them running while any deadline is left armed.
+    _timer_wheel.Stop();
+    _work = nullptr;
+    for (auto &thread : _threads) {
+      if (thread.joinable()) {
+        thread.join();
+      }
+    }
+  }
+
+  std::shared_ptr<IOExecutor> IOExecutor::GetShared() {
+    static std::mutex mutex;
+    static std::weak_ptr<IOExecutor> shared;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto executor = shared.lock();
+    if (executor == nullptr) {
+      executor = std::make_shared<IOExecutor>();
+      shared = executor;
+    }
+    return executor;
+  }
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,60 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/TimerWheel.h"
+
+namespace carla {
+namespace server {
+
+  /// An io_service run by a fixed number of worker threads. Many servers can
+  /// share the same executor, each serializing its own handlers with a strand,
+  /// and the timer wheel checking their deadlines.
+  class IOExecutor : private NonCopyable {
+  public:
+
+    /// If @a number_of_threads is zero, one thread per hardware core is used.
+    explicit IOExecutor(uint32_t number_of_threads = 0u);
+
+    ~IOExecutor();
+
+    boost::asio::io_service &service() {
+      return _service;
+    }
+
+    TimerWheel &timer_wheel() {
+      return _timer_wheel;
+    }
+
+    uint32_t number_of_threads() const {
+      return static_cast<uint32_t>(_threads.size());
+    }
+
+    /// Return the executor shared by every server in this process. It is
+    /// created on first use and destroyed when no longer referenced.
+    static std::shared_ptr<IOExecutor> GetShared();
+
+  private:
+
+    boost::asio::io_service _service;
+
+    TimerWheel _timer_wheel;
+
+    std::unique_ptr<boost::asio::io_service::work> _work;
+
+    std::vector<std::thread> _threads;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,73 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/ImagesDelta.h"
+
+#include <cstring>
+
+namespace carla {
+namespace server {
+
+  void ImagesDelta::XOR(
+      const unsigned char *lhs,
+      const unsigned char *rhs,
+      const size_t size,
+      unsigned char *destination) {
+    // Four words per iteration, the compiler turns it into vector
+    // instructions.
+    size_t i = 0u;
+    for (; i + 32u <= size; i += 32u) {
+      uint64_t a[4u];
+      uint64_t b[4u];
+      std::memcpy(a, lhs + i, sizeof(a));
+      std::memcpy(b, rhs + i, sizeof(b));
+      for (auto j = 0u; j < 4u; ++j) {
+        a[j] ^= b[j];
+      }
+      std::memcpy(destination + i, a, sizeof(a));
+    }
+    for (; i < size; ++i) {
+      destination[i] = lhs[i] ^ rhs[i];
+    }
+  }
+
+  const unsigned char *ImagesDelta::Encode(
+      const uint32_t camera_index,
+      const uint64_t frame_number,
+      const uint32_t key_frame_interval,
+      const unsigned char *pixels,
+      const size_t size,
+      uint64_t &base_frame_number) {
+    if (_cameras.size() <= camera_index) {
+      _cameras.resize(camera_index + 1u);
+    }
+    auto &camera = _cameras[camera_index];
+    const uint32_t interval =
+        (key_frame_interval == 0u ? DefaultKeyFrameInterval : key_frame_interval);
+    const bool key_frame =
+        !camera.valid ||
+        (camera.pixels.size() != size) ||
+        (camera.count + 1u >= interval);
+    const unsigned char *delta = nullptr;
+    if (key_frame) {
+      camera.count = 0u;
+    } else {
+      if (_delta.size() < size) {
+        _delta.resize(size);
+      }
+      XOR(pixels, camera.pixels.data(), size, _delta.data());
+      delta = _delta.data();
+      base_frame_number = camera.frame_number;
+      ++camera.count;
+    }
+    camera.pixels.assign(pixels, pixels + size);
+    camera.frame_number = frame_number;
+    camera.valid = true;
+    return delta;
+  }
+
+} // namespace server
+} // namespace carla
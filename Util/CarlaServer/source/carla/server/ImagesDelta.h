@@ -0,0 +1,74 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "carla/NonCopyable.h"
+
+namespace carla {
+namespace server {
+
+  /// Keeps the last image sent of every camera of a connection compressed
+  /// with CARLA_SERVER_IMAGE_COMPRESSION_DELTA, and computes the delta of the
+  /// next one against it.
+  ///
+  /// The first image of each camera after construction or Reset is a key
+  /// frame, and so is every image whose size differs from the previous one.
+  class ImagesDelta : private NonCopyable {
+  public:
+
+    /// Key frame interval of the images that do not set one.
+    static constexpr uint32_t DefaultKeyFrameInterval = 30u;
+
+    /// XOR of @a pixels against the previous image of @a camera_index, or
+    /// null if a key frame is due. Either way @a pixels, @a size bytes,
+    /// become the previous image of the camera. On return @a base_frame_number
+    /// holds the frame number of the image the delta is against.
+    ///
+    /// The delta returned is valid until the next call.
+    const unsigned char *Encode(
+        uint32_t camera_index,
+        uint64_t frame_number,
+        uint32_t key_frame_interval,
+        const unsigned char *pixels,
+        size_t size,
+        uint64_t &base_frame_number);
+
+    /// Forget every image, the next one of each camera is a key frame.
+    void Reset() {
+      _cameras.clear();
+    }
+
+    /// Write the XOR of @a lhs and @a rhs, @a size bytes, into
+    /// @a destination, which may be either of them.
+    static void XOR(
+        const unsigned char *lhs,
+        const unsigned char *rhs,
+        size_t size,
+        unsigned char *destination);
+
+  private:
+
+    struct Camera {
+      std::vector<unsigned char> pixels;
+      uint64_t frame_number = 0u;
+      /// Images sent since the last key frame.
+      uint32_t count = 0u;
+      bool valid = false;
+    };
+
+    /// Indexed by camera index.
+    std::vector<Camera> _cameras;
+
+    std::vector<unsigned char> _delta;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,94 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <vector>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/ImagesMessage.h"
+#include "carla/server/RingBuffer.h"
+
+namespace carla {
+namespace server {
+
+  /// Settings of the separate images stream of an agent server, see
+  /// WorldServer::SetImagesStream.
+  struct ImagesStreamOptions {
+    /// Zero if the images are sent along with the measurements.
+    uint32_t port = 0u;
+
+    /// Frames buffered for sending, and what to do when they are all pending,
+    /// independent of those of the measurements.
+    uint32_t number_of_slots = 2u;
+
+    RingBufferPolicy policy = RingBufferPolicy::DropOldest;
+  };
+
+  /// Images of a frame sent through the separate images stream, see
+  /// WorldServer::SetImagesStream. Identified by the same episode and server
+  /// frame id as the measurements they belong to.
+  class ImagesFrame : private NonCopyable {
+  public:
+
+    void Write(const_array_view<carla_image> images) {
+      _images.Write(images);
+    }
+
+    /// See ImagesMessage::Reserve.
+    void Reserve(
+        const_array_view<carla_image> images,
+        mutable_array_view<uint32_t *> data) {
+      _images.Reserve(images, data);
+    }
+
+    void set_ids(uint64_t episode_id, uint64_t server_frame_id, uint64_t frame_number) {
+      _episode_id = episode_id;
+      _server_frame_id = server_frame_id;
+      _frame_number = frame_number;
+    }
+
+    uint64_t episode_id() const {
+      return _episode_id;
+    }
+
+    uint64_t server_frame_id() const {
+      return _server_frame_id;
+    }
+
+    uint64_t frame_number() const {
+      return _frame_number;
+    }
+
+    /// Images as they are sent, see ImagesMessage::Encode. Only the reader
+    /// holding this frame may call it.
+    const_buffer encoded_images(bool compress = true, ImagesDelta *delta = nullptr) const {
+      return _images.Encode(_images_buffer, compress, delta);
+    }
+
+    const_array_view<uint64_t> image_frame_numbers() const {
+      return _images.frame_numbers();
+    }
+
+    const_array_view<uint32_t> image_camera_indices() const {
+      return _images.camera_indices();
+    }
+
+  private:
+
+    ImagesMessage _images;
+
+    mutable std::vector<unsigned char> _images_buffer;
+
+    uint64_t _episode_id = 0u;
+
+    uint64_t _server_frame_id = 0u;
+
+    uint64_t _frame_number = 0u;
+  };
+
+} // namespace server
+} // namespace carla
@@ -6,21 +6,42 @@
 
 #include "carla/server/ImagesMessage.h"
 
+#include <algorithm>
 #include <cstring>
 
 #include "carla/Debug.h"
 #include "carla/Logging.h"
+#include "carla/StridedView.h"
+#include "carla/server/ImagesDelta.h"
+#include "carla/server/LZ4.h"
 
 namespace carla {
 namespace server {
 
+  static constexpr size_t AlignUp(size_t size) {
+    return (size + ImagesMessage::Alignment - 1u) & ~size_t(ImagesMessage::Alignment - 1u);
+  }
+
+  static size_t GetSizeOfHeader(const_array_view<carla_image> images) {
+    // version, number of images, and the table.
+    const size_t size = 2u + ImagesMessage::HeaderEntrySize * images.size();
+    return AlignUp(sizeof(uint32_t) * size);
+  }
+
+  static size_t GetStride(const carla_image &image) {
+    return ImagesMessage::GetBytesPerPixel(image.encoding) * image.width;
+  }
+
+  static size_t GetSizeOfPixels(const carla_image &image) {
+    return GetStride(image) * image.height;
+  }
+
   static size_t GetSizeOfBuffer(const_array_view<carla_image> images) {
-    size_t total = 0u;
+    size_t total = GetSizeOfHeader(images);
     for (const auto &image : images) {
-      total += 3u; // width, height, type.
-      total += image.width * image.height;
+      total += AlignUp(GetSizeOfPixels(image));
     }
-    return total * sizeof(uint32_t);
+    return total;
   }
 
   static size_t WriteSizeToBuffer(unsigned char *buffer, uint32_t size) {
@@ -28,32 +49,272 @@ namespace server {
     return sizeof(uint32_t);
   }
 
+  static size_t WriteHeaderEntryToBuffer(
+      unsigned char *buffer,
+      const size_t offset,
+      const carla_image &image) {
+    auto begin = buffer;
+    begin += WriteSizeToBuffer(begin, offset);
+    begin += WriteSizeToBuffer(begin, image.width);
+    begin += WriteSizeToBuffer(begin, image.height);
+    begin += WriteSizeToBuffer(begin, image.type);
+    begin += WriteSizeToBuffer(begin, GetStride(image));
+    begin += WriteSizeToBuffer(begin, image.encoding);
+    begin += WriteSizeToBuffer(begin, image.screen_percentage == 0u ? 100u : image.screen_percentage);
+    return std::distance(buffer, begin);
+  }
+
+  static void WritePaddingToBuffer(unsigned char *buffer, const size_t size) {
+    std::memset(buffer + size, 0, AlignUp(size) - size);
+  }
+
   static size_t WriteImageToBuffer(unsigned char *buffer, const carla_image &image) {
-    const auto size = sizeof(uint32_t) * image.width * image.height;
+    const auto size = GetSizeOfPixels(image);
     DEBUG_ASSERT(image.data != nullptr);
-    std::memcpy(buffer, image.data, size);
+    const auto pixels = strided_view::make_const(
+        reinterpret_cast<const unsigned char *>(image.data),
+        GetStride(image),
+        image.height,
+        image.row_pitch);
+    if (pixels.is_contiguous()) {
+      std::memcpy(buffer, pixels.data(), size);
+    } else {
+      for (auto y = 0u; y < pixels.height(); ++y) {
+        std::memcpy(buffer + y * pixels.row_size(), pixels.row(y).data(), pixels.row_size());
+      }
+    }
+    WritePaddingToBuffer(buffer, size);
+    return AlignUp(size);
+  }
+
+  static uint32_t ReadSizeFromBuffer(const unsigned char *buffer) {
+    uint32_t size;
+    std::memcpy(&size, buffer, sizeof(uint32_t));
     return size;
   }
 
+  /// Copy @a number_of_pixels BGRA pixels into BGR.
+  static void PackBGR(
+      const unsigned char *source,
+      const size_t number_of_pixels,
+      unsigned char *destination) {
+    // Four pixels per iteration, written as three words (little-endian).
+    size_t i = 0u;
+    for (; i + 4u <= number_of_pixels; i += 4u) {
+      uint32_t px[4u];
+      std::memcpy(px, source + 4u * i, sizeof(px));
+      const uint32_t words[3u] = {
+        (px[0u] & 0x00FFFFFFu) | (px[1u] << 24u),
+        ((px[1u] >> 8u) & 0x0000FFFFu) | (px[2u] << 16u),
+        ((px[2u] >> 16u) & 0x000000FFu) | (px[3u] << 8u)
+      };
+      std::memcpy(destination + 3u * i, words, sizeof(words));
+    }
+    for (; i < number_of_pixels; ++i) {
+      std::memcpy(destination + 3u * i, source + 4u * i, 3u);
+    }
+  }
+
+  static bool SetImageInfo(
+      std::vector<uint64_t> &frame_numbers,
+      std::vector<uint32_t> &camera_indices,
+      std::vector<uint32_t> &compressions,
+      std::vector<uint32_t> &key_frame_intervals,
+      const_array_view<carla_image> images) {
+    frame_numbers.clear();
+    camera_indices.clear();
+    compressions.clear();
+    key_frame_intervals.clear();
+    bool needs_encoding = false;
+    for (const auto &image : images) {
+      frame_numbers.emplace_back(image.frame_number);
+      camera_indices.emplace_back(image.camera_index);
+      compressions.emplace_back(image.compression);
+      key_frame_intervals.emplace_back(image.key_frame_interval);
+      needs_encoding |=
+          (image.compression != ImagesMessage::None) ||
+          (image.encoding == ImagesMessage::RawBGR8);
+    }
+    return needs_encoding;
+  }
+
+  uint32_t ImagesMessage::GetBytesPerPixel(const uint32_t encoding) {
+    switch (encoding) {
+      case RawPointsXYZL:
+        return 16u;
+      case RawGPUShared:
+        return sizeof(carla_gpu_shared_image);
+      case RawBGRA8:
+      case RawBGR8:
+      case RawFloat32:
+      case RawMotionVectors:
+        return 4u;
+      case RawFloat16:
+        return 2u;
+      case RawGray8:
+        return 1u;
+      default:
+        return 0u;
+    }
+  }
+
+  uint32_t ImagesMessage::GetBytesPerPixelOnTheWire(const uint32_t encoding) {
+    return (encoding == RawBGR8 ? 3u : GetBytesPerPixel(encoding));
+  }
+
   void ImagesMessage::Write(const_array_view<carla_image> images) {
+    const auto header_size = WriteHeader(images);
+    auto begin = _begin + header_size;
+    for (const auto &image : images) {
+      begin += WriteImageToBuffer(begin, image);
+    }
+    DEBUG_ASSERT(std::distance(_begin, begin) == _size);
+    _needs_encoding = SetImageInfo(
+        _frame_numbers,
+        _camera_indices,
+        _compressions,
+        _key_frame_intervals,
+        images);
+  }
+
+  void ImagesMessage::Reserve(
+      const_array_view<carla_image> images,
+      mutable_array_view<uint32_t *> data) {
+    DEBUG_ASSERT(images.size() == data.size());
+    const auto header_size = WriteHeader(images);
+    auto begin = _begin + header_size;
+    for (auto i = 0u; i < images.size(); ++i) {
+      const auto size = GetSizeOfPixels(images[i]);
+      data[i] = reinterpret_cast<uint32_t *>(begin);
+      WritePaddingToBuffer(begin, size);
+      begin += AlignUp(size);
+    }
+    DEBUG_ASSERT(std::distance(_begin, begin) == _size);
+    _needs_encoding = SetImageInfo(
+        _frame_numbers,
+        _camera_indices,
+        _compressions,
+        _key_frame_intervals,
+        images);
+  }
+
+  const_buffer ImagesMessage::Encode(
+      std::vector<unsigned char> &buffer,
+      const bool compress_images,
+      ImagesDelta *delta) const {
+    if (!_needs_encoding) {
+      return this->buffer();
+    }
+    const auto *message = _begin + sizeof(uint32_t);
+    const auto number_of_images = _compressions.size();
+    DEBUG_ASSERT(ReadSizeFromBuffer(message + sizeof(uint32_t)) == number_of_images);
+    const size_t header_size = AlignUp(sizeof(uint32_t) * (2u + HeaderEntrySize * number_of_images));
+    auto entry = [&](size_t image, size_t field) {
+      return sizeof(uint32_t) * (2u + HeaderEntrySize * image + field);
+    };
+    constexpr size_t OFFSET = 0u, WIDTH = 1u, HEIGHT = 2u, STRIDE = 4u, ENCODING = 5u;
+
+    // Make room for the worst case, plus a scratch area at the end for packing
+    // the images that are compressed afterwards.
+    size_t capacity = sizeof(uint32_t) + header_size;
+    size_t scratch_size = 0u;
+    for (auto i = 0u; i < number_of_images; ++i) {
+      const size_t size =
+          ReadSizeFromBuffer(message + entry(i, STRIDE)) *
+          ReadSizeFromBuffer(message + entry(i, HEIGHT));
+      capacity += AlignUp(sizeof(uint32_t) + sizeof(uint64_t) + LZ4::CompressBound(size));
+      scratch_size = std::max(scratch_size, size);
+    }
+    if (buffer.size() < capacity + scratch_size) {
+      buffer.resize(capacity + scratch_size);
+    }
+    auto *scratch = buffer.data() + capacity;
+
+    auto *encoded = buffer.data() + sizeof(uint32_t);
+    std::memcpy(encoded, message, header_size);
+    size_t offset = header_size;
+    for (auto i = 0u; i < number_of_images; ++i) {
+      const auto *pixels = message + ReadSizeFromBuffer(message + entry(i, OFFSET));
+      const auto encoding = ReadSizeFromBuffer(message + entry(i, ENCODING));
+      const size_t width = ReadSizeFromBuffer(message + entry(i, WIDTH));
+      const size_t height = ReadSizeFromBuffer(message + entry(i, HEIGHT));
+      const size_t stride = GetBytesPerPixelOnTheWire(encoding) * width;
+      const size_t size = stride * height;
+      auto *begin = encoded + offset;
+      const bool compress = compress_images && (_compressions[i] != None);
+      if (encoding == RawBGR8) {
+        auto *packed = (compress ? scratch : begin);
+        PackBGR(pixels, width * height, packed);
+        pixels = packed;
+        WriteSizeToBuffer(encoded + entry(i, STRIDE), stride);
+      }
+      size_t written;
+      if (compress) {
+        // Delta images are sent as LZ4 if the key frame is due.
+        const unsigned char *source = pixels;
+        uint32_t compression = LZ4;
+        size_t header = sizeof(uint32_t);
+        if ((_compressions[i] == Delta) && (delta != nullptr)) {
+          uint64_t base_frame_number = 0u;
+          const auto *xored = delta->Encode(
+              _camera_indices[i],
+              _frame_numbers[i],
+              _key_frame_intervals[i],
+              pixels,
+              size,
+              base_frame_number);
+          if (xored != nullptr) {
+            source = xored;
+            compression = Delta;
+            std::memcpy(begin + header, &base_frame_number, sizeof(uint64_t));
+            header += sizeof(uint64_t);
+          }
+        }
+        const auto compressed_size = LZ4::Compress(source, size, begin + header);
+        WriteSizeToBuffer(begin, compressed_size);
+        written = header + compressed_size;
+        WriteSizeToBuffer(encoded + entry(i, ENCODING), encoding | (compression << CompressionShift));
+      } else {
+        if (pixels != begin) {
+          std::memcpy(begin, pixels, size);
+        }
+        written = size;
+      }
+      WritePaddingToBuffer(begin, written);
+      WriteSizeToBuffer(encoded + entry(i, OFFSET), offset);
+      offset += AlignUp(written);
+    }
+    WriteSizeToBuffer(buffer.data(), offset);
+    return boost::asio::buffer(buffer.data(), sizeof(uint32_t) + offset);
+  }
+
+  size_t ImagesMessage::WriteHeader(const_array_view<carla_image> images) {
     const size_t buffer_size = GetSizeOfBuffer(images);
-    Reset(sizeof(uint32_t) + buffer_size); // header + buffer.
+    Reset(sizeof(uint32_t) + buffer_size); // total size + buffer.
 
-    auto begin = _buffer.get();
+    auto begin = _begin;
     begin += WriteSizeToBuffer(begin, buffer_size);
+    const auto message = begin; // offsets are relative to here.
+    begin += WriteSizeToBuffer(begin, Version);
+    begin += WriteSizeToBuffer(begin, images.size());
+    size_t offset = GetSizeOfHeader(images);
     for (const auto &image : images) {
-      begin += WriteSizeToBuffer(begin, image.width);
-      begin += WriteSizeToBuffer(begin, image.height);
-      begin += WriteSizeToBuffer(begin, image.type);
-      begin += WriteImageToBuffer(begin, image);
+      begin += WriteHeaderEntryToBuffer(begin, offset, image);
+      offset += AlignUp(GetSizeOfPixels(image));
     }
-    DEBUG_ASSERT(std::distance(_buffer.get(), begin) == _size);
+    std::memset(begin, 0, std::distance(begin, message + GetSizeOfHeader(images)));
+    return sizeof(uint32_t) + GetSizeOfHeader(images);
   }
 
   void ImagesMessage::Reset(const uint32_t count) {
     if (_capacity < count) {
       log_info("allocating image buffer of", count, "bytes");
-      _buffer = std::make_unique<unsigned char[]>(count);
+      // Allocate extra space to align the beginning of the message (right
+      // after the total size).
+      _buffer = LargeBuffer(count + Alignment, MemorySubsystem::ImagesMessages);
+      const auto address = reinterpret_cast<uintptr_t>(_buffer.data()) + sizeof(uint32_t);
+      const auto aligned = AlignUp(address);
+      _begin = _buffer.data() + (aligned - address);
       _capacity = count;
     }
     _size = count;
@@ -8,29 +8,104 @@
 
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "carla/ArrayView.h"
 #include "carla/NonCopyable.h"
 #include "carla/server/CarlaServerAPI.h"
+#include "carla/server/LargeBuffer.h"
 #include "carla/server/ServerTraits.h"
 
 namespace carla {
 namespace server {
 
+  class ImagesDelta;
+
   /// Encodes the given images as binary array to be sent to the client.
   ///
-  /// The message consists of an array of uint32's in the following layout
+  /// The message consists of a header table of uint32's followed by the pixels
+  /// of each image, every pixel array starts at an offset multiple of
+  /// ImagesMessage::Alignment bytes (padding is filled with zeros)
   ///
   ///    {
-  ///      total size,
-  ///      width, height, type, color[0], color[1],...,     <- first image
-  ///      width, height, type, color[0], color[1],...,     <- second image
+  ///      total size,                                      <- not in offsets
+  ///      version, number of images,
+  ///      offset, width, height, type, stride, encoding, screen percentage,   <- first image
+  ///      offset, width, height, type, stride, encoding, screen percentage,   <- second image
+  ///      ...
+  ///      padding,
+  ///      color[0], color[1],..., padding,                 <- first image
+  ///      color[0], color[1],..., padding,                 <- second image
   ///      ...
   ///    }
   ///
-  class ImagesMessage : private NonCopyable {
+  /// Offsets are in bytes from the beginning of the message (i.e., right after
+  /// the total size), and stride is the size in bytes of each row of pixels.
+  /// Screen percentage is the percentage of the image size the scene was
+  /// rendered at, 100 unless scaled down (see carla_image).
+  ///
+  /// A compressed image has the compression in the upper 16 bits of its
+  /// encoding, and its pixels are replaced by the size in bytes of the
+  /// compressed data (uint32) followed by the data itself. A delta image has
+  /// the frame number (uint64) of the image it is against in between, see
+  /// ImagesDelta; its key frames are sent as LZ4.
+  ///
+    class ImagesMessage : private NonCopyable {
   public:
 
+    /// Version of the layout of the message, increased on every change.
+    static constexpr uint32_t Version = 3u;
+
+    /// Alignment in bytes of each image's pixels.
+    static constexpr uint32_t Alignment = 64u;
+
+    /// Size in uint32's of each entry of the header table.
+    static constexpr uint32_t HeaderEntrySize = 7u;
+
+    /// Same values as CARLA_SERVER_IMAGE_*.
+    enum Encoding : uint32_t {
+      /// Uncompressed BGRA, 8 bits per channel.
+      RawBGRA8 = CARLA_SERVER_IMAGE_BGRA8,
+      /// Uncompressed single channel 32-bit float (e.g., depth).
+      RawFloat32 = CARLA_SERVER_IMAGE_FLOAT32,
+      /// Uncompressed single channel 16-bit float (e.g., depth).
+      RawFloat16 = CARLA_SERVER_IMAGE_FLOAT16,
+      /// Uncompressed single channel, 8 bits (e.g., semantic labels).
+      RawGray8 = CARLA_SERVER_IMAGE_GRAY8,
+      /// Uncompressed BGR, 8 bits per channel. Written as RawBGRA8, the alpha
+      /// is dropped when the message is encoded for sending.
+      RawBGR8 = CARLA_SERVER_IMAGE_BGR8,
+      /// Point cloud (e.g., LiDAR), each "pixel" is a point of four 32-bit
+      /// floats, x, y, z and label.
+      RawPointsXYZL = CARLA_SERVER_IMAGE_POINTS_XYZL,
+      /// A carla_gpu_shared_image in place of the pixels, see
+      /// carla_set_gpu_shared_images.
+      RawGPUShared = CARLA_SERVER_IMAGE_GPU_SHARED,
+      /// Uncompressed screen-space motion since the previous image of the
+      /// camera, two 16-bit floats per pixel.
+      RawMotionVectors = CARLA_SERVER_IMAGE_MOTION_VECTORS
+    };
+
+    /// Position of the compression in the encoding field of the header.
+    static constexpr uint32_t CompressionShift = 16u;
+
+    enum Compression : uint32_t {
+      None = CARLA_SERVER_IMAGE_COMPRESSION_NONE,
+      LZ4 = CARLA_SERVER_IMAGE_COMPRESSION_LZ4,
+      Delta = CARLA_SERVER_IMAGE_COMPRESSION_DELTA
+    };
+
+    /// Number of bytes of each pixel in the given @a encoding, zero if the
+    /// encoding is unknown.
+    static uint32_t GetBytesPerPixel(uint32_t encoding);
+
+    /// Same as GetBytesPerPixel but after encoding the message for sending.
+    static uint32_t GetBytesPerPixelOnTheWire(uint32_t encoding);
+
+    static bool IsValidCompression(uint32_t compression) {
+      return (compression == None) || (compression == LZ4) || (compression == Delta);
+    }
+
     /// Allocates a new buffer if the capacity is not enough to hold the images,
     /// but it does not allocate a smaller one if the capacity is greater than
     /// the size of the images.
@@ -39,19 +114,73 @@ namespace server {
     /// buffer of images, so memory allocation occurs only once.
     void Write(const_array_view<carla_image> images);
 
+    /// Same as Write but the pixels are not copied. Only the width, height,
+    /// and type of the @a images are read, and on return @a data holds, for
+    /// each image, a pointer to the region of the buffer where its pixels
+    /// should be written by the caller.
+    ///
+    /// The pointers are valid until the next call to Write or Reserve.
+    void Reserve(
+        const_array_view<carla_image> images,
+        mutable_array_view<uint32_t *> data);
+
     const_buffer buffer() const {
-      return boost::asio::buffer(_buffer.get(), _size);
+      return boost::asio::buffer(_begin, _size);
+    }
+
+    /// Return the message as it is sent, stored in @a buffer: BGR8 images
+    /// without the alpha channel, and the images compressed as requested by
+    /// the last call to Write or Reserve unless not @a compress. If no image
+    /// needs any of these, the message is returned as it is and @a buffer is
+    /// not touched.
+    ///
+    /// The delta images are encoded against the images previously sent
+    /// through @a delta, and sent as LZ4 if null.
+    ///
+    /// @a buffer is only grown, so it is allocated just once for messages of
+    /// similar size.
+    const_buffer Encode(
+        std::vector<unsigned char> &buffer,
+        bool compress = true,
+        ImagesDelta *delta = nullptr) const;
+
+    /// Frame numbers of the images of the last call to Write or Reserve.
+    const_array_view<uint64_t> frame_numbers() const {
+      return array_view::make_const(_frame_numbers.data(), _frame_numbers.size());
+    }
+
+    /// Camera indices of the images of the last call to Write or Reserve.
+    const_array_view<uint32_t> camera_indices() const {
+      return array_view::make_const(_camera_indices.data(), _camera_indices.size());
     }
 
   private:
 
     void Reset(uint32_t count);
 
-    std::unique_ptr<unsigned char[]> _buffer = nullptr;
+    /// Writes the total size and the header table, returns the offset of the
+    /// first image.
+    size_t WriteHeader(const_array_view<carla_image> images);
+
+    LargeBuffer _buffer;
+
+    /// Beginning of the message inside _buffer, such that the pixels of every
+    /// image are aligned in memory too.
+    unsigned char *_begin = nullptr;
 
     uint32_t _size = 0u;
 
     uint32_t _capacity = 0u;
+
+    std::vector<uint64_t> _frame_numbers;
+
+    std::vector<uint32_t> _camera_indices;
+
+    std::vector<uint32_t> _compressions;
+
+    std::vector<uint32_t> _key_frame_intervals;
+
+    bool _needs_encoding = false;
   };
 
 } // namespace server
@@ -0,0 +1,175 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/LZ4.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace carla {
+namespace server {
+
+  // Constants of the block format.
+  static constexpr size_t MIN_MATCH = 4u;
+  static constexpr size_t LAST_LITERALS = 5u;
+  static constexpr size_t MF_LIMIT = 12u;
+  static constexpr size_t MAX_OFFSET = 65535u;
+
+  static constexpr uint32_t HASH_LOG = 12u;
+
+  static inline uint32_t Read32(const unsigned char *source) {
+    uint32_t value;
+    std::memcpy(&value, source, sizeof(value));
+    return value;
+  }
+
+  static inline uint32_t Hash(const uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32u - HASH_LOG);
+  }
+
+  static inline unsigned char *WriteLength(unsigned char *destination, size_t length) {
+    for (; length >= 255u; length -= 255u) {
+      *destination++ = 255u;
+    }
+    *destination++ = static_cast<unsigned char>(length);
+    return destination;
+  }
+
+  static inline unsigned char *WriteLiterals(
+      unsigned char *destination,
+      const unsigned char *literals,
+      const size_t number_of_literals,
+      const size_t match_length) {
+    auto *token = destination++;
+    *token = static_cast<unsigned char>(
+        (std::min<size_t>(number_of_literals, 15u) << 4u) |
+        std::min<size_t>(match_length, 15u));
+    if (number_of_literals >= 15u) {
+      destination = WriteLength(destination, number_of_literals - 15u);
+    }
+    std::memcpy(destination, literals, number_of_literals);
+    return destination + number_of_literals;
+  }
+
+  size_t LZ4::Compress(
+      const unsigned char *source,
+      const size_t size,
+      unsigned char *destination) {
+    auto *output = destination;
+    const auto *anchor = source;
+    if (size > MF_LIMIT) {
+      // Position + 1 of the last occurrence of each hashed sequence.
+      std::array<uint32_t, 1u << HASH_LOG> table;
+      table.fill(0u);
+      const auto *input = source;
+      const auto *input_limit = source + size - MF_LIMIT;
+      const auto *match_limit = source + size - LAST_LITERALS;
+      while (input < input_limit) {
+        const auto sequence = Read32(input);
+        auto &entry = table[Hash(sequence)];
+        const auto *match = source + entry - 1u;
+        const bool found =
+            (entry > 0u) &&
+            (static_cast<size_t>(input - match) <= MAX_OFFSET) &&
+            (Read32(match) == sequence);
+        entry = static_cast<uint32_t>(input - source) + 1u;
+        if (!found) {
+          // Skip faster through data that does not compress.
+          input += 1u + ((input - anchor) >> 6u);
+          continue;
+        }
+        const auto *end = input + MIN_MATCH;
+        const auto *match_end = match + MIN_MATCH;
+        while ((end < match_limit) && (*end == *match_end)) {
+          ++end;
+          ++match_end;
+        }
+        const size_t match_length = (end - input) - MIN_MATCH;
+        output = WriteLiterals(output, anchor, input - anchor, match_length);
+        const auto offset = static_cast<uint16_t>(input - match);
+        *output++ = static_cast<unsigned char>(offset & 0xFFu);
+        *output++ = static_cast<unsigned char>(offset >> 8u);
+        if (match_length >= 15u) {
+          output = WriteLength(output, match_length - 15u);
+        }
+        input = end;
+        anchor = input;
+      }
+    }
+    // The last sequence has only literals.
+    output = WriteLiterals(output, anchor, (source + size) - anchor, 0u);
+    return output - destination;
+  }
+
+  static inline bool ReadLength(
+      const unsigned char *&source,
+      const unsigned char *end,
+      size_t &length) {
+    unsigned char byte;
+    do {
+      if (source == end) {
+        return false;
+      }
+      byte = *source++;
+      length += byte;
+    } while (byte == 255u);
+    return true;
+  }
+
+  bool LZ4::Decompress(
+      const unsigned char *source,
+      const size_t size,
+      unsigned char *destination,
+      const size_t decompressed_size) {
+    const auto *input = source;
+    const auto *input_end = source + size;
+    auto *output = destination;
+    const auto *output_end = destination + decompressed_size;
+    while (input < input_end) {
+      const auto token = *input++;
+      size_t number_of_literals = token >> 4u;
+      if ((number_of_literals == 15u) && !ReadLength(input, input_end, number_of_literals)) {
+        return false;
+      }
+      if ((number_of_literals > static_cast<size_t>(input_end - input)) ||
+          (number_of_literals > static_cast<size_t>(output_end - output))) {
+        return false;
+      }
+      std::memcpy(output, input, number_of_literals);
+      input += number_of_literals;
+      output += number_of_literals;
+      if (input == input_end) {
+        break; // last sequence.
+      }
+      if (input_end - input < 2) {
+        return false;
+      }
+      const size_t offset = input[0u] | (input[1u] << 8u);
+      input += 2u;
+      if ((offset == 0u) || (offset > static_cast<size_t>(output - destination))) {
+        return false;
+      }
+      size_t match_length = token & 0x0Fu;
+      if ((match_length == 15u) && !ReadLength(input, input_end, match_length)) {
+        return false;
+      }
+      match_length += MIN_MATCH;
+      if (match_length > static_cast<size_t>(output_end - output)) {
+        return false;
+      }
+      // Byte by byte, the match may overlap the output.
+      const auto *match = output - offset;
+      for (size_t i = 0u; i < match_length; ++i) {
+        output[i] = match[i];
+      }
+      output += match_length;
+    }
+    return output == output_end;
+  }
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,51 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace carla {
+namespace server {
+
+  /// Minimal compressor and decompressor of the LZ4 block format, fast enough
+  /// for the images and decodable by any LZ4 library (e.g., python's
+  /// lz4.block.decompress).
+  ///
+  /// The compressor is a greedy single-pass matcher with a small hash table, it
+  /// does not reach the ratio of the reference implementation but images with
+  /// large uniform regions (labels, depth of the sky) compress well.
+  class LZ4 {
+  public:
+
+    /// Maximum size of the compressed data of @a size bytes.
+    static constexpr size_t CompressBound(size_t size) {
+      return size + size / 255u + 16u;
+    }
+
+    /// Compress @a size bytes of @a source into @a destination, it must have
+    /// room for at least CompressBound(size) bytes.
+    ///
+    /// Returns the size of the compressed data.
+    static size_t Compress(
+        const unsigned char *source,
+        size_t size,
+        unsigned char *destination);
+
+    /// Decompress @a size bytes of @a source into @a destination, that must be
+    /// exactly @a decompressed_size bytes.
+    ///
+    /// Returns false if the data is malformed.
+    static bool Decompress(
+        const unsigned char *source,
+        size_t size,
+        unsigned char *destination,
+        size_t decompressed_size);
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,224 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/LargeBuffer.h"
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+#ifdef __linux__
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#elif defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#endif // __linux__
+
+#include "carla/Logging.h"
+
+namespace carla {
+namespace server {
+
+  static std::atomic_bool HUGE_PAGES{false};
+
+  static std::atomic_bool NUMA_LOCAL{false};
+
+  static constexpr size_t RoundUp(size_t size, size_t alignment) {
+    return (size + alignment - 1u) / alignment * alignment;
+  }
+
+#ifdef __linux__
+
+  /// Prefer the NUMA node of the calling thread for the pages of the mapping,
+  /// before they are touched. Without libnuma, through the raw system calls.
+  static void BindToCurrentNode(void *address, size_t size) {
+#if defined(SYS_getcpu) && defined(SYS_mbind)
+    constexpr int MPOL_PREFERRED_MODE = 1;
+    unsigned cpu = 0u;
+    unsigned node = 0u;
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+      return;
+    }
+    constexpr size_t BITS = 8u * sizeof(unsigned long);
+    unsigned long mask[1024u / BITS] = {0u};
+    if (node >= 1024u) {
+      return;
+    }
+    mask[node / BITS] = 1ul << (node % BITS);
+    if (::syscall(SYS_mbind, address, size, MPOL_PREFERRED_MODE, mask, 1024u, 0u) != 0) {
+      log_debug("large buffer: failed to bind to NUMA node", node);
+    }
+#endif // SYS_getcpu && SYS_mbind
+  }
+
+  static void *Map(size_t &size, bool &huge) {
+    const bool huge_pages = HUGE_PAGES;
+    void *address = MAP_FAILED;
+    huge = false;
+    if (huge_pages) {
+      const size_t huge_size = RoundUp(size, LargeBuffer::MinimumMappedSize);
+      address = ::mmap(
+          nullptr,
+          huge_size,
+          PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+          -1,
+          0);
+      if (address != MAP_FAILED) {
+        size = huge_size;
+        huge = true;
+      }
+    }
+    if (address == MAP_FAILED) {
+      address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (address == MAP_FAILED) {
+        return nullptr;
+      }
+      if (huge_pages) {
+        // No huge pages reserved, transparent huge pages are the best we get.
+        ::madvise(address, size, MADV_HUGEPAGE);
+      }
+    }
+    if (NUMA_LOCAL) {
+      BindToCurrentNode(address, size);
+    }
+    return address;
+  }
+
+  static void Unmap(void *address, size_t size) {
+    ::munmap(address, size);
+  }
+
+#elif defined(_WIN32)
+
+  static void *Map(size_t &size, bool &huge) {
+    const DWORD type = MEM_RESERVE | MEM_COMMIT;
+    DWORD node = NUMA_NO_PREFERRED_NODE;
+    if (NUMA_LOCAL) {
+      UCHAR current_node = 0u;
+      if (GetNumaProcessorNode(static_cast<UCHAR>(GetCurrentProcessorNumber()), &current_node)) {
+        node = current_node;
+      }
+    }
+    huge = false;
+    const size_t large_page = GetLargePageMinimum();
+    if (HUGE_PAGES && (large_page > 0u)) {
+      // Needs the "Lock pages in memory" privilege.
+      const size_t huge_size = RoundUp(size, large_page);
+      void *address = VirtualAllocExNuma(
+          GetCurrentProcess(), nullptr, huge_size, type | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+      if (address != nullptr) {
+        size = huge_size;
+        huge = true;
+        return address;
+      }
+    }
+    return VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, type, PAGE_READWRITE, node);
+  }
+
+  static void Unmap(void *address, size_t) {
+    VirtualFree(address, 0u, MEM_RELEASE);
+  }
+
+#else
+
+  static void *Map(size_t &, bool &huge) {
+    huge = false;
+    return nullptr;
+  }
+
+  static void Unmap(void *, size_t) {}
+
+#endif // __linux__
+
+  void LargeBuffer::SetOptions(const LargeBufferOptions &options) {
+    HUGE_PAGES = options.huge_pages;
+    NUMA_LOCAL = options.numa_local;
+  }
+
+  LargeBufferOptions LargeBuffer::GetOptions() {
+    LargeBufferOptions options;
+    options.huge_pages = HUGE_PAGES;
+    options.numa_local = NUMA_LOCAL;
+    return options;
+  }
+
+  LargeBuffer::LargeBuffer(const size_t size, const MemorySubsystem subsystem)
+    : _size(size),
+      _subsystem(subsystem) {
+    if ((size >= MinimumMappedSize) && (HUGE_PAGES || NUMA_LOCAL)) {
+      // Mappings are page aligned and zero-initialized.
+      size_t mapped_size = size;
+      _allocation = Map(mapped_size, _huge);
+      if (_allocation != nullptr) {
+        _mapped_size = mapped_size;
+        _data = static_cast<unsigned char *>(_allocation);
+        _accounted_size = mapped_size;
+        MemoryAccounting::Add(_subsystem, _accounted_size);
+        return;
+      }
+      log_warning("large buffer: failed to map", size, "bytes, using the heap");
+    }
+    auto *allocation = new unsigned char[size + Alignment]();
+    _allocation = allocation;
+    const auto address = reinterpret_cast<uintptr_t>(allocation);
+    _data = allocation + (RoundUp(address, Alignment) - address);
+    _accounted_size = size + Alignment;
+    MemoryAccounting::Add(_subsystem, _accounted_size);
+  }
+
+  LargeBuffer::LargeBuffer(LargeBuffer &&other) noexcept {
+    *this = std::move(other);
+  }
+
+  LargeBuffer &LargeBuffer::operator=(LargeBuffer &&other) noexcept {
+    if (this != &other) {
+      Release();
+      _data = other._data;
+      _size = other._size;
+      _allocation = other._allocation;
+      _mapped_size = other._mapped_size;
+      _huge = other._huge;
+      _subsystem = other._subsystem;
+      _accounted_size = other._accounted_size;
+      other._data = nullptr;
+      other._size = 0u;
+      other._allocation = nullptr;
+      other._mapped_size = 0u;
+      other._huge = false;
+      other._accounted_size = 0u;
+    }
+    return *this;
+  }
+
+  LargeBuffer::~LargeBuffer() {
+    Release();
+  }
+
+  void LargeBuffer::Release() {
+    if (_allocation == nullptr) {
+      return;
+    }
+    if (_mapped_size > 0u) {
+      Unmap(_allocation, _mapped_size);
+    } else {
+      delete[] static_cast<unsigned char *>(_allocation);
+    }
+    MemoryAccounting::Remove(_subsystem, _accounted_size);
+    _allocation = nullptr;
+    _data = nullptr;
+    _accounted_size = 0u;
+  }
+
+} // namespace server
+} // namespace carla
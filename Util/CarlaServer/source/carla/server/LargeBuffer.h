@@ -0,0 +1,95 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "carla/server/MemoryAccounting.h"
+
+namespace carla {
+namespace server {
+
+  /// How LargeBuffer allocates its memory, process-wide.
+  struct LargeBufferOptions {
+    /// Back the buffers with 2 MiB pages (large pages on Windows) to save TLB
+    /// misses when copying whole frames. If none are reserved in the system,
+    /// transparent huge pages are requested instead (Linux only).
+    bool huge_pages = false;
+
+    /// Place the memory in the NUMA node of the thread allocating it, i.e. the
+    /// thread writing the frames.
+    bool numa_local = false;
+  };
+
+  /// Zero-initialized memory for the buffers holding whole frames, i.e. the
+  /// images and the non-player agents. Aligned to at least Alignment bytes.
+  ///
+  /// Buffers from MinimumMappedSize on are mapped straight from the system as
+  /// set by SetOptions, smaller ones (or any, if no option is set) come from
+  /// the heap. The options apply to the buffers allocated afterwards.
+  ///
+  /// The memory allocated is accounted to @a subsystem, see MemoryAccounting.
+  class LargeBuffer {
+  public:
+
+    static constexpr size_t Alignment = 64u;
+
+    static constexpr size_t MinimumMappedSize = 2u * 1024u * 1024u;
+
+    static void SetOptions(const LargeBufferOptions &options);
+
+    static LargeBufferOptions GetOptions();
+
+    LargeBuffer() = default;
+
+    explicit LargeBuffer(size_t size, MemorySubsystem subsystem = MemorySubsystem::OtherBuffers);
+
+    LargeBuffer(LargeBuffer &&other) noexcept;
+
+    LargeBuffer &operator=(LargeBuffer &&other) noexcept;
+
+    ~LargeBuffer();
+
+    unsigned char *data() const {
+      return _data;
+    }
+
+    size_t size() const {
+      return _size;
+    }
+
+    /// Whether the buffer is backed by huge pages (those reserved in the
+    /// system, not transparent huge pages).
+    bool is_huge() const {
+      return _huge;
+    }
+
+  private:
+
+    void Release();
+
+    unsigned char *_data = nullptr;
+
+    size_t _size = 0u;
+
+    /// Beginning of the allocation, either mapped or from the heap.
+    void *_allocation = nullptr;
+
+    /// Size of the mapping, zero if allocated from the heap.
+    size_t _mapped_size = 0u;
+
+    bool _huge = false;
+
+    MemorySubsystem _subsystem = MemorySubsystem::OtherBuffers;
+
+    /// Bytes accounted to _subsystem, the whole allocation.
+    size_t _accounted_size = 0u;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,167 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "carla/NonCopyable.h"
+
+namespace carla {
+namespace server {
+
+  /// A lock-free queue for multiple producers and a single consumer. Same
+  /// interface as ThreadSafeQueue, but pushing and popping never take a lock
+  /// unless the consumer is parked waiting for new values.
+  ///
+  /// Based on Dmitry Vyukov's intrusive MPSC node-based queue.
+  ///
+  /// @warning Only one thread may pop values from the queue.
+  template<typename T>
+  class LockFreeQueue : private NonCopyable {
+  public:
+
+    LockFreeQueue()
+      : _head(new Node),
+        _tail(_head.load()),
+        _done(false),
+        _waiting(false) {}
+
+    ~LockFreeQueue() {
+      set_done(true);
+      while (_tail != nullptr) {
+        Node *next = _tail->next.load();
+        delete _tail;
+        _tail = next;
+      }
+    }
+
+    /// @warning Must be called from the consumer thread.
+    bool empty() const {
+      return _tail->next.load() == nullptr;
+    }
+
+    bool done() const {
+      return _done;
+    }
+
+    void set_done(bool done = true) {
+      _done = done;
+      std::lock_guard<std::mutex> lock(_mutex);
+      _condition.notify_all();
+    }
+
+    void Push(T &&new_value) {
+      Emplace(std::move(new_value));
+    }
+
+    /// Constructs the new value in place.
+    template <typename... Args>
+    void Emplace(Args &&... args) {
+      Node *node = new Node(std::forward<Args>(args)...);
+      Node *previous = _head.exchange(node, std::memory_order_acq_rel);
+      // Between the exchange and this store the consumer sees the queue as
+      // empty, that's fine it will spin or wait until it's published.
+      previous->next.store(node);
+      if (_waiting.load()) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _condition.notify_one();
+      }
+    }
+
+    /// Spins for a short period and then blocks until there is a value to pop
+    /// or the queue is marked as done.
+    bool WaitAndPop(T &value) {
+      for (auto i = 0u; i < SPIN_COUNT; ++i) {
+        if (TryPop(value)) {
+          return true;
+        }
+        if (_done) {
+          return false;
+        }
+        std::this_thread::yield();
+      }
+      std::unique_lock<std::mutex> lock(_mutex);
+      _waiting = true;
+      _condition.wait(lock, [this] { return _done || !empty(); });
+      _waiting = false;
+      return TryPop(value);
+    }
+
+    bool TryPop(T &value) {
+      Node *next = _tail->next.load(std::memory_order_acquire);
+      if (next == nullptr) {
+        return false;
+      }
+      // The next node becomes the new stub, we can steal its value.
+      value = std::move(next->value);
+      delete _tail;
+      _tail = next;
+      return true;
+    }
+
+    /// Spins for a short period and then blocks until there is some value in
+    /// the queue, or the queue is marked as done, then moves every value at the
+    /// end of @a values in order.
+    ///
+    /// Returns false if nothing was popped.
+    bool WaitAndPopAll(std::vector<T> &values) {
+      T value;
+      if (!WaitAndPop(value)) {
+        return false;
+      }
+      values.emplace_back(std::move(value));
+      PopAll(values);
+      return true;
+    }
+
+    /// Moves every value in the queue at the end of @a values in order.
+    ///
+    /// Returns false if nothing was popped.
+    bool PopAll(std::vector<T> &values) {
+      T value;
+      bool popped = false;
+      while (TryPop(value)) {
+        values.emplace_back(std::move(value));
+        popped = true;
+      }
+      return popped;
+    }
+
+  private:
+
+    /// Number of attempts to pop before parking the consumer thread.
+    static constexpr unsigned SPIN_COUNT = 64u;
+
+    struct Node {
+      template <typename... Args>
+      explicit Node(Args &&... args) : value(std::forward<Args>(args)...) {}
+
+      std::atomic<Node *> next{nullptr};
+      T value;
+    };
+
+    /// Last pushed node, shared by the producers.
+    std::atomic<Node *> _head;
+
+    /// Stub node whose next is the next value to pop, owned by the consumer.
+    Node *_tail;
+
+    std::atomic_bool _done;
+
+    std::atomic_bool _waiting;
+
+    std::mutex _mutex;
+
+    std::condition_variable _condition;
+  };
+
+} // namespace server
+} // namespace carla
@@ -6,37 +6,338 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "carla/NonCopyable.h"
+#include "carla/StopWatch.h"
+#include "carla/server/AgentBoxes.h"
+#include "carla/server/ClassHistograms.h"
+#include "carla/server/CollisionEvents.h"
 #include "carla/server/CarlaMeasurements.h"
 #include "carla/server/CarlaServerAPI.h"
+#include "carla/server/ControlBatch.h"
+#include "carla/server/FlowControl.h"
 #include "carla/server/ImagesMessage.h"
+#include "carla/server/WriteCompletions.h"
 
 namespace carla {
 namespace server {
 
+  /// Memory of the caller lent to a MeasurementsMessage, see
+  /// carla_write_measurements_leased.
+  struct FrameLease {
+    carla_release_callback release = nullptr;
+    void *user_data = nullptr;
+  };
+
   class MeasurementsMessage : private NonCopyable {
   public:
 
+    ~MeasurementsMessage() {
+      ReleaseLease();
+      Complete(errc::operation_aborted());
+    }
+
     void Write(
         const carla_measurements &measurements,
         const_array_view<carla_image> images) {
+      ClearRawFrame();
       _measurements.Write(measurements);
       _images.Write(images);
     }
 
+    /// Same as Write but the non-player agents are taken from @a agents, see
+    /// CarlaMeasurements.
+    void Write(
+        const carla_measurements &measurements,
+        const carla_agent_arrays &agents,
+        const_array_view<carla_image> images) {
+      ClearRawFrame();
+      _measurements.Write(measurements, agents);
+      _images.Write(images);
+    }
+
+    /// Same as Write but only the pointers are kept, the agents and the
+    /// images are copied by StageLeasedFrame. The memory is held until then,
+    /// or until this message is written again or destroyed, and then @a lease
+    /// is released.
+    void WriteLeased(
+        const carla_measurements &measurements,
+        const_array_view<carla_image> images,
+        const FrameLease &lease) {
+      ClearRawFrame();
+      _leased_measurements = measurements;
+      _leased_images.assign(images.begin(), images.end());
+      _lease = lease;
+    }
+
+    /// Copy the leased frame, if any, into this message's own buffers and
+    /// release the lease. Only the reader holding this message may call it.
+    void StageLeasedFrame() const {
+      if (_lease.release != nullptr) {
+        _measurements.Write(_leased_measurements);
+        _images.Write(array_view::make_const(_leased_images.data(), _leased_images.size()));
+        ReleaseLease();
+      }
+    }
+
+    /// Report the outcome of sending this message to @a completions with
+    /// @a token, see Complete. A message written again or destroyed before
+    /// being sent completes as aborted.
+    void set_completion(std::shared_ptr<WriteCompletions> completions, uint64_t token) {
+      _completions = std::move(completions);
+      _completion_token = token;
+    }
+
+    /// Push the pending completion, if any, with the result @a ec. Only the
+    /// reader holding this message may call it, or the owner on destruction.
+    void Complete(error_code ec) const {
+      if (_completions != nullptr) {
+        _completions->Push(_completion_token, ec);
+        _completions = nullptr;
+      }
+    }
+
+    /// Reserve space for the images without copying them, see
+    /// ImagesMessage::Reserve.
+    void ReserveImages(
+        const_array_view<carla_image> images,
+        mutable_array_view<uint32_t *> data) {
+      ClearRawFrame();
+      _images.Reserve(images, data);
+    }
+
+    /// Write only the measurements, the images must have been reserved and
+    /// filled already.
+    void WriteMeasurements(const carla_measurements &measurements) {
+      ClearRawFrame();
+      _measurements.Write(measurements);
+    }
+
+    /// Send an already encoded frame as is instead, e.g. one of a recording.
+    /// @a owner keeps the memory of @a measurements and @a images alive while
+    /// this message holds them.
+    void WriteRawFrame(
+        const_buffer measurements,
+        const_buffer images,
+        std::shared_ptr<const void> owner) {
+      ReleaseLease();
+      Complete(errc::operation_aborted());
+      _server_frame_id = 0u;
+      _raw_measurements = measurements;
+      _raw_images = images;
+      _raw_frame_owner = std::move(owner);
+      _has_raw_frame = true;
+    }
+
+    bool has_raw_frame() const {
+      return _has_raw_frame;
+    }
+
+    /// Measurements message of the raw frame, size prefix included.
+    const_buffer raw_measurements() const {
+      return _raw_measurements;
+    }
+
+    /// Images message of the raw frame, size prefix included.
+    const_buffer raw_images() const {
+      return _raw_images;
+    }
+
+    /// Episode these measurements belong to, see AgentServer::StartEpisode.
+    void set_episode_id(uint64_t episode_id) {
+      _episode_id = episode_id;
+    }
+
+    uint64_t episode_id() const {
+      return _episode_id;
+    }
+
+    /// Attach @a timing to these measurements, or remove it if null. The
+    /// queue wait is measured from this call.
+    void set_timing(const carla_frame_timing *timing) {
+      _has_timing = (timing != nullptr);
+      if (_has_timing) {
+        _timing = *timing;
+        _timing_start = StopWatch::clock::now();
+      }
+    }
+
+    /// Attach the latency of the last control applied to these measurements,
+    /// or remove it if null.
+    void set_control_latency(const ControlLatency *latency) {
+      _has_control_latency = (latency != nullptr);
+      if (_has_control_latency) {
+        _control_latency = *latency;
+      }
+    }
+
+    /// Identify these measurements in the flow control block sent with them,
+    /// see FrameFlowControl.
+    void set_flow_control(uint64_t server_frame_id, uint32_t queue_depth) {
+      _server_frame_id = server_frame_id;
+      _queue_depth = queue_depth;
+    }
+
+    /// Zero if these measurements carry no flow control block.
+    uint64_t server_frame_id() const {
+      return _server_frame_id;
+    }
+
+    uint32_t queue_depth() const {
+      return _queue_depth;
+    }
+
+    /// Null if these measurements carry no timing.
+    const carla_frame_timing *timing() const {
+      return (_has_timing ? &_timing : nullptr);
+    }
+
+    /// Null if these measurements carry no control latency.
+    const ControlLatency *control_latency() const {
+      return (_has_control_latency ? &_control_latency : nullptr);
+    }
+
+    /// When set_timing was called.
+    StopWatch::clock::time_point timing_start() const {
+      return _timing_start;
+    }
+
+    /// Boxes of the agents seen by the cameras, empty if these measurements
+    /// carry none.
+    AgentBoxes &agent_boxes() {
+      return _agent_boxes;
+    }
+
+    const AgentBoxes &agent_boxes() const {
+      return _agent_boxes;
+    }
+
+    /// Pixels per label of the semantic cameras, empty if these measurements
+    /// carry none.
+    ClassHistograms &class_histograms() {
+      return _class_histograms;
+    }
+
+    const ClassHistograms &class_histograms() const {
+      return _class_histograms;
+    }
+
+    /// Collisions of the player during the last frame, empty if none.
+    CollisionEvents &collision_events() {
+      return _collision_events;
+    }
+
+    const CollisionEvents &collision_events() const {
+      return _collision_events;
+    }
+
     const carla_measurements &measurements() const {
       return _measurements.measurements();
     }
 
+    /// Packed agents if written with carla_agent_arrays, then the
+    /// non-player agents of measurements() are null until UnpackAgents is
+    /// called, see CarlaMeasurements.
+    const_array_view<char> packed_agents() const {
+      return _measurements.packed_agents();
+    }
+
+    /// Only the reader holding this message may call it.
+    void UnpackAgents() const {
+      _measurements.UnpackAgents();
+    }
+
     const_buffer images() const {
       return _images.buffer();
     }
 
+    /// Images as they are sent, see ImagesMessage::Encode. Only the reader
+    /// holding this message may call it.
+    const_buffer encoded_images(bool compress = true, ImagesDelta *delta = nullptr) const {
+      return _images.Encode(_images_buffer, compress, delta);
+    }
+
+    const_array_view<uint64_t> image_frame_numbers() const {
+      return _images.frame_numbers();
+    }
+
+    const_array_view<uint32_t> image_camera_indices() const {
+      return _images.camera_indices();
+    }
+
+    /// Buffer where the measurements are encoded before being sent. Only the
+    /// reader holding this message may use it.
+    std::vector<char> &encode_buffer() const {
+      return _encode_buffer;
+    }
+
   private:
 
-    CarlaMeasurements _measurements;
+    void ClearRawFrame() {
+      ReleaseLease();
+      Complete(errc::operation_aborted());
+      _server_frame_id = 0u;
+      _has_raw_frame = false;
+      _raw_frame_owner = nullptr;
+    }
+
+    void ReleaseLease() const {
+      if (_lease.release != nullptr) {
+        _lease.release(_lease.user_data);
+        _lease = FrameLease();
+      }
+    }
+
+    /// Written by StageLeasedFrame and UnpackAgents too.
+    mutable CarlaMeasurements _measurements;
+
+    mutable ImagesMessage _images;
+
+    carla_measurements _leased_measurements;
+
+    std::vector<carla_image> _leased_images;
+
+    mutable FrameLease _lease;
+
+    mutable std::shared_ptr<WriteCompletions> _completions;
+
+    uint64_t _completion_token = 0u;
+
+    uint64_t _episode_id = 0u;
+
+    uint64_t _server_frame_id = 0u;
+
+    uint32_t _queue_depth = 0u;
+
+    bool _has_timing = false;
+
+    AgentBoxes _agent_boxes;
+
+    ClassHistograms _class_histograms;
+
+    CollisionEvents _collision_events;
+
+    carla_frame_timing _timing;
+
+    StopWatch::clock::time_point _timing_start;
+
+    bool _has_control_latency = false;
+
+    ControlLatency _control_latency;
+
+    mutable std::vector<char> _encode_buffer;
+
+    mutable std::vector<unsigned char> _images_buffer;
+
+    bool _has_raw_frame = false;
+
+    const_buffer _raw_measurements;
+
+    const_buffer _raw_images;
 
-    ImagesMessage _images;
+    std::shared_ptr<const void> _raw_frame_owner;
   };
 
 } // namespace server
@@ -0,0 +1,249 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/MeasurementsPublisher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
+
+#include "carla/Debug.h"
+#include "carla/Logging.h"
+
+namespace carla {
+namespace server {
+
+  using boost::asio::ip::tcp;
+
+  static constexpr auto LOG_PREFIX = "publisher:";
+
+  using frame_type = EncodedFramePtr;
+
+  // ===========================================================================
+  // -- MeasurementsPublisher::Subscriber --------------------------------------
+  // ===========================================================================
+
+  /// Every member but the socket and the drop counter is accessed only within
+  /// the strand.
+  class MeasurementsPublisher::Subscriber
+    : public std::enable_shared_from_this<Subscriber>,
+      private NonCopyable {
+  public:
+
+    Subscriber(
+        boost::asio::io_service &service,
+        tcp::socket socket,
+        const uint32_t max_queued_frames)
+      : _socket(std::move(socket)),
+        _strand(service),
+        _max_queued_frames(max_queued_frames) {}
+
+    bool is_closed() const {
+      return _closed;
+    }
+
+    uint64_t number_of_drops() const {
+      return _number_of_drops;
+    }
+
+    void Push(frame_type frame) {
+      auto self = shared_from_this();
+      _strand.post([self, frame]() {
+        if (self->_closed) {
+          return;
+        }
+        self->_queue.emplace_back(frame);
+        // While writing, the front frame is in flight and cannot be dropped.
+        const size_t in_flight = (self->_writing ? 1u : 0u);
+        while (self->_queue.size() - in_flight > self->_max_queued_frames) {
+          self->_queue.erase(self->_queue.begin() + in_flight);
+          ++self->_number_of_drops;
+        }
+        if (!self->_writing) {
+          self->WriteNext();
+        }
+      });
+    }
+
+    void PostClose() {
+      auto self = shared_from_this();
+      _strand.post([self]() { self->Close(); });
+    }
+
+  private:
+
+    void WriteNext() {
+      if (_queue.empty() || _closed) {
+        _writing = false;
+        return;
+      }
+      _writing = true;
+      auto self = shared_from_this();
+      boost::asio::async_write(
+          _socket,
+          _queue.front()->buffer(),
+          _strand.wrap([self](const error_code &ec, size_t) {
+            if (ec) {
+              if (ec != boost::asio::error::operation_aborted) {
+                log_info(LOG_PREFIX, "subscriber disconnected:", ec.message());
+              }
+              self->Close();
+              return;
+            }
+            self->_queue.pop_front();
+            self->WriteNext();
+          }));
+    }
+
+    void Close() {
+      if (!_closed) {
+        log_debug(LOG_PREFIX, "closing subscriber,", _number_of_drops, "frames dropped");
+      }
+      _closed = true;
+      _writing = false;
+      _queue.clear();
+      error_code ec;
+      _socket.close(ec);
+    }
+
+    tcp::socket _socket;
+
+    boost::asio::io_service::strand _strand;
+
+    const size_t _max_queued_frames;
+
+    std::deque<frame_type> _queue;
+
+    bool _writing = false;
+
+    std::atomic_bool _closed{false};
+
+    std::atomic<uint64_t> _number_of_drops{0u};
+  };
+
+  // ===========================================================================
+  // -- MeasurementsPublisher::State -------------------------------------------
+  // ===========================================================================
+
+  /// Shared with the accept callback, so the publisher can be destroyed
+  /// without waiting for it.
+  class MeasurementsPublisher::State : private NonCopyable {
+  public:
+
+    State(boost::asio::io_service &service, const uint32_t max_queued_frames)
+      : service(service),
+        max_queued_frames(max_queued_frames) {}
+
+    void AddSubscriber(tcp::socket socket) {
+      error_code ec;
+      socket.set_option(tcp::no_delay(true), ec);
+      log_info(LOG_PREFIX, "new subscriber");
+      auto subscriber = std::make_shared<Subscriber>(service, std::move(socket), max_queued_frames);
+      std::lock_guard<std::mutex> lock(mutex);
+      subscribers.emplace_back(subscriber);
+    }
+
+    /// Remove the closed subscribers, must be called with the mutex locked.
+    void RemoveClosedSubscribers() {
+      auto it = std::remove_if(subscribers.begin(), subscribers.end(), [this](const auto &subscriber) {
+        if (subscriber->is_closed()) {
+          number_of_drops_of_closed += subscriber->number_of_drops();
+          return true;
+        }
+        return false;
+      });
+      subscribers.erase(it, subscribers.end());
+    }
+
+    boost::asio::io_service &service;
+
+    const uint32_t max_queued_frames;
+
+    mutable std::mutex mutex;
+
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+
+    uint64_t number_of_frames = 0u;
+
+    uint64_t number_of_drops_of_closed = 0u;
+  };
+
+  // ===========================================================================
+  // -- MeasurementsPublisher --------------------------------------------------
+  // ===========================================================================
+
+  MeasurementsPublisher::MeasurementsPublisher(
+      const uint32_t max_queued_frames,
+      std::shared_ptr<IOExecutor> executor)
+    : _executor(std::move(executor)),
+      _state(std::make_shared<State>(_executor->service(), max_queued_frames)),
+      _acceptor(_executor->service(), LOG_PREFIX, [state = _state](tcp::socket socket) {
+        state->AddSubscriber(std::move(socket));
+      }) {
+    DEBUG_ASSERT(max_queued_frames > 0u);
+  }
+
+  MeasurementsPublisher::~MeasurementsPublisher() {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    for (auto &subscriber : _state->subscribers) {
+      subscriber->PostClose();
+    }
+  }
+
+  error_code MeasurementsPublisher::Listen(const uint32_t port) {
+    const auto ec = _acceptor.Listen(port);
+    if (!ec) {
+      log_info(LOG_PREFIX, "accepting subscribers at port", port);
+    }
+    return ec;
+  }
+
+  bool MeasurementsPublisher::HasSubscribers() const {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    return !_state->subscribers.empty();
+  }
+
+  void MeasurementsPublisher::Publish(const EncodedFramePtr &frame) {
+    DEBUG_ASSERT(frame != nullptr);
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    {
+      std::lock_guard<std::mutex> lock(_state->mutex);
+      _state->RemoveClosedSubscribers();
+      if (_state->subscribers.empty()) {
+        return;
+      }
+      ++_state->number_of_frames;
+      subscribers = _state->subscribers;
+    }
+    // Every subscriber shares the frame, and so do the other sinks.
+    for (auto &subscriber : subscribers) {
+      subscriber->Push(frame);
+    }
+  }
+
+  MeasurementsPublisher::Stats MeasurementsPublisher::GetStats() const {
+    std::lock_guard<std::mutex> lock(_state->mutex);
+    Stats stats;
+    stats.number_of_subscribers = 0u;
+    stats.number_of_frames = _state->number_of_frames;
+    stats.number_of_drops = _state->number_of_drops_of_closed;
+    for (auto &subscriber : _state->subscribers) {
+      if (!subscriber->is_closed()) {
+        ++stats.number_of_subscribers;
+      }
+      stats.number_of_drops += subscriber->number_of_drops();
+    }
+    return stats;
+  }
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,76 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <memory>
+
+#include "carla/ArrayView.h"
+#include "carla/NonCopyable.h"
+#include "carla/server/Acceptor.h"
+#include "carla/server/EncodedFrame.h"
+#include "carla/server/IOExecutor.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// Fans out the measurements stream to any number of read-only subscribers
+  /// connected to a TCP port, e.g. recorders or visualizers running next to
+  /// the agent client. Every subscriber receives the very same messages as the
+  /// agent client.
+  ///
+  /// Each subscriber has its own bounded queue of frames. A subscriber that
+  /// falls behind loses its oldest queued frames, it never blocks the
+  /// publisher nor the other subscribers.
+  class MeasurementsPublisher : private NonCopyable {
+  public:
+
+    struct Stats {
+      uint32_t number_of_subscribers;
+      uint64_t number_of_frames;
+      /// Frames dropped by every subscriber, disconnected ones included.
+      uint64_t number_of_drops;
+    };
+
+    /// @a max_queued_frames is the number of frames (at least one) each
+    /// subscriber may have pending besides the one being sent.
+    explicit MeasurementsPublisher(
+        uint32_t max_queued_frames = 2u,
+        std::shared_ptr<IOExecutor> executor = IOExecutor::GetShared());
+
+    /// Closes every subscriber, pending frames are discarded.
+    ~MeasurementsPublisher();
+
+    /// Start accepting subscribers at @a port.
+    error_code Listen(uint32_t port);
+
+    /// Whether there is any subscriber to publish to, the caller may skip
+    /// making a frame otherwise.
+    bool HasSubscribers() const;
+
+    /// Queue a reference to @a frame to every subscriber, the frame is not
+    /// copied. Never blocks.
+    void Publish(const EncodedFramePtr &frame);
+
+    Stats GetStats() const;
+
+  private:
+
+    class Subscriber;
+
+    class State;
+
+    /// Destroyed last, the executor joins the handlers still holding the state.
+    const std::shared_ptr<IOExecutor> _executor;
+
+    std::shared_ptr<State> _state;
+
+    Acceptor _acceptor;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,49 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/MemoryAccounting.h"
+
+#include <atomic>
+
+#include "carla/Debug.h"
+
+namespace carla {
+namespace server {
+
+  static constexpr auto NUMBER_OF_SUBSYSTEMS = static_cast<size_t>(MemorySubsystem::SIZE);
+
+  static std::atomic<uint64_t> BYTES[NUMBER_OF_SUBSYSTEMS];
+
+  static std::atomic<uint64_t> &GetBytes(const MemorySubsystem subsystem) {
+    const auto index = static_cast<size_t>(subsystem);
+    DEBUG_ASSERT(index < NUMBER_OF_SUBSYSTEMS);
+    return BYTES[index];
+  }
+
+  void MemoryAccounting::Add(const MemorySubsystem subsystem, const size_t bytes) {
+    GetBytes(subsystem).fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  void MemoryAccounting::Remove(const MemorySubsystem subsystem, const size_t bytes) {
+    GetBytes(subsystem).fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  uint64_t MemoryAccounting::Get(const MemorySubsystem subsystem) {
+    return GetBytes(subsystem).load(std::memory_order_relaxed);
+  }
+
+  const char *MemoryAccounting::GetName(const MemorySubsystem subsystem) {
+    switch (subsystem) {
+      case MemorySubsystem::ImagesMessages: return "images_messages";
+      case MemorySubsystem::AgentsBuffers:  return "agents_buffers";
+      case MemorySubsystem::EncodedRoadMap: return "encoded_road_map";
+      case MemorySubsystem::OtherBuffers:   return "other_buffers";
+      default:                              return "unknown";
+    }
+  }
+
+} // namespace server
+} // namespace carla
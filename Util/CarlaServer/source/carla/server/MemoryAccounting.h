@@ -0,0 +1,45 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace carla {
+namespace server {
+
+  /// Largest structures held by the library, see MemoryAccounting.
+  enum class MemorySubsystem : uint32_t {
+    /// Buffers of the images of every agent, see ImagesMessage.
+    ImagesMessages,
+    /// Copies of the non-player agents, see CarlaMeasurements.
+    AgentsBuffers,
+    /// Road map kept for the clients, see RoadMapEncoding.
+    EncodedRoadMap,
+    /// Any other LargeBuffer.
+    OtherBuffers,
+
+    SIZE
+  };
+
+  /// Bytes currently held by each MemorySubsystem, process-wide, served by
+  /// every ServerMetrics.
+  class MemoryAccounting {
+  public:
+
+    static void Add(MemorySubsystem subsystem, size_t bytes);
+
+    static void Remove(MemorySubsystem subsystem, size_t bytes);
+
+    static uint64_t Get(MemorySubsystem subsystem);
+
+    /// Name of the subsystem in the metrics.
+    static const char *GetName(MemorySubsystem subsystem);
+  };
+
+} // namespace server
+} // namespace carla
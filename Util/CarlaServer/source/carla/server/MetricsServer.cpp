@@ -0,0 +1,144 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/MetricsServer.h"
+
+#include <string>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
+
+#include "carla/Debug.h"
+#include "carla/Logging.h"
+
+namespace carla {
+namespace server {
+
+  using boost::asio::ip::tcp;
+
+  static constexpr auto LOG_PREFIX = "metrics:";
+
+  /// Requests are never larger than this, bigger ones are closed unanswered.
+  static constexpr size_t MAX_REQUEST_SIZE = 8u * 1024u;
+
+  // ===========================================================================
+  // -- MetricsServer::Connection ----------------------------------------------
+  // ===========================================================================
+
+  /// Reads the request headers, which are ignored, and writes the response.
+  /// Every member but the deadline is accessed only within the strand.
+  class MetricsServer::Connection
+    : public std::enable_shared_from_this<Connection>,
+      private NonCopyable {
+  public:
+
+    Connection(IOExecutor &executor, tcp::socket socket, const time_duration timeout)
+      : _socket(std::move(socket)),
+        _strand(executor.service()),
+        _request(MAX_REQUEST_SIZE),
+        _timeout(timeout),
+        _deadline(executor.timer_wheel(), [this]() {
+          // The read handler cancels the deadline before releasing the
+          // connection, so it is still alive here.
+          auto self = shared_from_this();
+          _strand.post([self]() { self->OnTimeout(); });
+        }) {}
+
+    void Start(std::shared_ptr<const ServerMetrics> metrics) {
+      auto self = shared_from_this();
+      _strand.post([self, metrics]() { self->Read(metrics); });
+    }
+
+  private:
+
+    void Read(std::shared_ptr<const ServerMetrics> metrics) {
+      _reading = true;
+      _deadline.ExpiresFromNow(_timeout);
+      auto self = shared_from_this();
+      boost::asio::async_read_until(_socket, _request, "\r\n\r\n",
+          _strand.wrap([self, metrics](const error_code &ec, size_t) {
+        self->_deadline.Cancel();
+        self->_reading = false;
+        if (ec) {
+          log_debug(LOG_PREFIX, "invalid request:", ec.message());
+          self->Close();
+          return;
+        }
+        const auto body = metrics->GetText();
+        self->_response =
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "Connection: close\r\n"
+            "\r\n" + body;
+        boost::asio::async_write(self->_socket, boost::asio::buffer(self->_response),
+            self->_strand.wrap([self](const error_code &, size_t) { self->Close(); }));
+      }));
+    }
+
+    void OnTimeout() {
+      // The request may have completed after the deadline expired.
+      if (_reading) {
+        log_debug(LOG_PREFIX, "request timed out");
+        Close();
+      }
+    }
+
+    void Close() {
+      error_code ec;
+      _socket.shutdown(tcp::socket::shutdown_both, ec);
+      _socket.close(ec);
+    }
+
+    tcp::socket _socket;
+
+    boost::asio::io_service::strand _strand;
+
+    boost::asio::streambuf _request;
+
+    std::string _response;
+
+    const time_duration _timeout;
+
+    bool _reading = false;
+
+    TimerWheel::Deadline _deadline;
+  };
+
+  // ===========================================================================
+  // -- MetricsServer ----------------------------------------------------------
+  // ===========================================================================
+
+  MetricsServer::MetricsServer(
+      std::shared_ptr<const ServerMetrics> metrics,
+      std::shared_ptr<IOExecutor> executor,
+      const time_duration request_timeout)
+    : _executor(std::move(executor)),
+      _acceptor(
+          _executor->service(),
+          LOG_PREFIX,
+          [executor = _executor.get(), metrics, request_timeout](tcp::socket socket) {
+        auto connection = std::make_shared<Connection>(*executor, std::move(socket), request_timeout);
+        connection->Start(metrics);
+      }) {
+    DEBUG_ASSERT(metrics != nullptr);
+  }
+
+  MetricsServer::~MetricsServer() = default;
+
+  error_code MetricsServer::Listen(const uint32_t port) {
+    const auto ec = _acceptor.Listen(port);
+    if (!ec) {
+      log_info(LOG_PREFIX, "serving metrics at port", port);
+    }
+    return ec;
+  }
+
+} // namespace server
+} // namespace carla
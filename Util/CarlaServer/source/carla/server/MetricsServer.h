@@ -0,0 +1,51 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <memory>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/Acceptor.h"
+#include "carla/server/IOExecutor.h"
+#include "carla/server/ServerMetrics.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// Minimal HTTP listener answering every request with the ServerMetrics in
+  /// Prometheus text format, so the health of a running server can be scraped
+  /// from outside. Each connection is closed after the response.
+  class MetricsServer : private NonCopyable {
+  public:
+
+    /// Connections that do not send a whole request within
+    /// @a request_timeout are closed unanswered.
+    explicit MetricsServer(
+        std::shared_ptr<const ServerMetrics> metrics,
+        std::shared_ptr<IOExecutor> executor = IOExecutor::GetShared(),
+        time_duration request_timeout = boost::posix_time::seconds(10));
+
+    /// Stops accepting connections, the responses in flight are completed.
+    ~MetricsServer();
+
+    /// Start accepting connections at @a port.
+    error_code Listen(uint32_t port);
+
+  private:
+
+    class Connection;
+
+    /// Destroyed last, the executor joins the handlers still holding the
+    /// connections.
+    const std::shared_ptr<IOExecutor> _executor;
+
+    Acceptor _acceptor;
+  };
+
+} // namespace server
+} // namespace carla
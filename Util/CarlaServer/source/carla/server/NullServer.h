@@ -0,0 +1,52 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <functional>
+
+#include "carla/ArrayView.h"
+#include "carla/NonCopyable.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// Server without any connection, everything written is discarded and
+  /// nothing can be read. Used by the offline agent server, so the messages
+  /// are only encoded for the recorder and the publisher, see EncoderServer.
+  ///
+  /// Same interface as the asynchronous functions of TCPServer, but every
+  /// handler is called right away in the calling thread.
+  class NullServer : private NonCopyable {
+  public:
+
+    using completion_handler = std::function<void(const error_code &)>;
+
+    void Disconnect() {}
+
+    template <typename OPTIONS>
+    void SetOptions(const OPTIONS &) {}
+
+    void AsyncConnect(uint32_t, time_duration, completion_handler handler) {
+      handler(errc::success());
+    }
+
+    void AsyncRead(mutable_buffer, time_duration, completion_handler handler) {
+      handler(errc::operation_not_supported());
+    }
+
+    void AsyncWrite(const_array_view<const_buffer>, time_duration, completion_handler handler) {
+      handler(errc::success());
+    }
+
+    void AsyncPost(std::function<void()> job) {
+      job();
+    }
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,248 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/PackedAgents.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "carla/Debug.h"
+
+namespace carla {
+namespace server {
+
+  // ===========================================================================
+  // -- Helpers ----------------------------------------------------------------
+  // ===========================================================================
+
+  template <typename T>
+  static char *Write(char *out, const T &value) {
+    std::memcpy(out, &value, sizeof(T));
+    return out + sizeof(T);
+  }
+
+  template <typename T>
+  static char *WriteVector(char *out, const carla_vector3d &vector, T (*quantize)(float)) {
+    out = Write(out, quantize(vector.x));
+    out = Write(out, quantize(vector.y));
+    return Write(out, quantize(vector.z));
+  }
+
+  /// Locations, rounded to centimeters.
+  static int32_t QuantizeLocation(const float value) {
+    constexpr float limit = 2147483520.0f; // Largest float below 2^31.
+    return static_cast<int32_t>(std::lround(std::max(-limit, std::min(value, limit))));
+  }
+
+  /// Components of unit vectors, scaled to [-32767, 32767].
+  static int16_t QuantizeOrientation(const float value) {
+    return static_cast<int16_t>(std::lround(32767.0f * std::max(-1.0f, std::min(value, 1.0f))));
+  }
+
+  /// Box extents, rounded to centimeters.
+  static uint16_t QuantizeExtent(const float value) {
+    return static_cast<uint16_t>(std::lround(std::max(0.0f, std::min(value, 65535.0f))));
+  }
+
+  static uint8_t QuantizeType(const uint32_t type) {
+    DEBUG_ASSERT(type <= 0xFFu);
+    return static_cast<uint8_t>(type);
+  }
+
+  /// Zigzag encoded difference, written as a little-endian base 128 varint.
+  static void WriteDelta(std::string &data, const int64_t value, int64_t &previous) {
+    const int64_t delta = value - previous;
+    previous = value;
+    uint64_t zigzag = (static_cast<uint64_t>(delta) << 1u) ^ static_cast<uint64_t>(delta >> 63u);
+    while (zigzag >= 0x80u) {
+      data.push_back(static_cast<char>(zigzag | 0x80u));
+      zigzag >>= 7u;
+    }
+    data.push_back(static_cast<char>(zigzag));
+  }
+
+  // ===========================================================================
+  // -- Encodings --------------------------------------------------------------
+  // ===========================================================================
+
+  static void WriteFloat32(const_array_view<carla_agent> agents, std::string &data) {
+    constexpr size_t BYTES_PER_AGENT = 2u * sizeof(uint32_t) + 10u * sizeof(float);
+    static_assert(BYTES_PER_AGENT == 48u, "PackedAgents layout mismatch");
+    const size_t count = agents.size();
+    data.resize(BYTES_PER_AGENT * count);
+    char *ids = &data[0u];
+    char *types = ids + count * sizeof(uint32_t);
+    auto *locations = reinterpret_cast<float *>(types + count * sizeof(uint32_t));
+    auto *orientations = locations + 3u * count;
+    auto *box_extents = orientations + 3u * count;
+    auto *forward_speeds = box_extents + 3u * count;
+    auto write_vector = [](float *&out, const carla_vector3d &vector) {
+      *out++ = vector.x;
+      *out++ = vector.y;
+      *out++ = vector.z;
+    };
+    for (size_t i = 0u; i < count; ++i) {
+      const carla_agent &agent = agents[i];
+      std::memcpy(ids + i * sizeof(uint32_t), &agent.id, sizeof(uint32_t));
+      std::memcpy(types + i * sizeof(uint32_t), &agent.type, sizeof(uint32_t));
+      write_vector(locations, agent.transform.location);
+      write_vector(orientations, agent.transform.orientation);
+      write_vector(box_extents, agent.box_extent);
+      forward_speeds[i] = agent.forward_speed;
+    }
+  }
+
+  static void WriteQuantized(const_array_view<carla_agent> agents, std::string &data) {
+    constexpr size_t BYTES_PER_AGENT = 4u + 1u + 12u + 6u + 6u + 4u;
+    const size_t count = agents.size();
+    data.resize(BYTES_PER_AGENT * count);
+    char *ids = &data[0u];
+    char *types = ids + 4u * count;
+    char *locations = types + count;
+    char *orientations = locations + 12u * count;
+    char *box_extents = orientations + 6u * count;
+    char *forward_speeds = box_extents + 6u * count;
+    for (auto &agent : agents) {
+      ids = Write(ids, agent.id);
+      types = Write(types, QuantizeType(agent.type));
+      locations = WriteVector(locations, agent.transform.location, QuantizeLocation);
+      orientations = WriteVector(orientations, agent.transform.orientation, QuantizeOrientation);
+      box_extents = WriteVector(box_extents, agent.box_extent, QuantizeExtent);
+      forward_speeds = Write(forward_speeds, agent.forward_speed);
+    }
+  }
+
+  static void WriteQuantizedDelta(const_array_view<carla_agent> agents, std::string &data) {
+    data.clear();
+    int64_t previous = 0;
+    for (auto &agent : agents) {
+      WriteDelta(data, agent.id, previous);
+    }
+    previous = 0;
+    for (auto &agent : agents) {
+      WriteDelta(data, QuantizeType(agent.type), previous);
+    }
+    // Each component is relative to the same component of the previous agent.
+    auto write_vectors = [&](auto get_vector, auto quantize) {
+      int64_t previous_xyz[3u] = {0, 0, 0};
+      for (auto &agent : agents) {
+        const carla_vector3d &vector = get_vector(agent);
+        WriteDelta(data, quantize(vector.x), previous_xyz[0u]);
+        WriteDelta(data, quantize(vector.y), previous_xyz[1u]);
+        WriteDelta(data, quantize(vector.z), previous_xyz[2u]);
+      }
+    };
+    using vector_ref = const carla_vector3d &;
+    write_vectors([](const carla_agent &agent) -> vector_ref { return agent.transform.location; }, QuantizeLocation);
+    write_vectors([](const carla_agent &agent) -> vector_ref { return agent.transform.orientation; }, QuantizeOrientation);
+    write_vectors([](const carla_agent &agent) -> vector_ref { return agent.box_extent; }, QuantizeExtent);
+    const size_t offset = data.size();
+    data.resize(offset + sizeof(float) * agents.size());
+    char *forward_speeds = &data[offset];
+    for (auto &agent : agents) {
+      forward_speeds = Write(forward_speeds, agent.forward_speed);
+    }
+  }
+
+  static void WriteHalfFloat(const_array_view<carla_agent> agents, std::string &data) {
+    constexpr size_t BYTES_PER_AGENT = 4u + 1u + 10u * sizeof(uint16_t);
+    const size_t count = agents.size();
+    data.resize(BYTES_PER_AGENT * count);
+    char *ids = &data[0u];
+    char *types = ids + 4u * count;
+    char *locations = types + count;
+    char *orientations = locations + 6u * count;
+    char *box_extents = orientations + 6u * count;
+    char *forward_speeds = box_extents + 6u * count;
+    for (auto &agent : agents) {
+      ids = Write(ids, agent.id);
+      types = Write(types, QuantizeType(agent.type));
+      locations = WriteVector(locations, agent.transform.location, ToHalf);
+      orientations = WriteVector(orientations, agent.transform.orientation, ToHalf);
+      box_extents = WriteVector(box_extents, agent.box_extent, ToHalf);
+      forward_speeds = Write(forward_speeds, ToHalf(agent.forward_speed));
+    }
+  }
+
+  void WritePackedAgents(
+      const AgentsEncoding encoding,
+      const_array_view<carla_agent> agents,
+      std::string &data) {
+    switch (encoding) {
+      case AgentsEncoding::Quantized:
+        return WriteQuantized(agents, data);
+      case AgentsEncoding::QuantizedDelta:
+        return WriteQuantizedDelta(agents, data);
+      case AgentsEncoding::HalfFloat:
+        return WriteHalfFloat(agents, data);
+      case AgentsEncoding::Float32:
+      default:
+        return WriteFloat32(agents, data);
+    }
+  }
+
+  // ===========================================================================
+  // -- Half-precision floats --------------------------------------------------
+  // ===========================================================================
+
+  uint16_t ToHalf(const float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16u) & 0x8000u);
+    bits &= 0x7FFFFFFFu;
+    if (bits > 0x7F800000u) {
+      return sign | 0x7E00u; // NaN.
+    }
+    if (bits >= 0x477FE000u) {
+      return sign | 0x7BFFu; // Clamped to 65504.
+    }
+    if (bits < 0x38800000u) {
+      // Subnormal half, in units of 2^-24.
+      if (bits <= 0x33000000u) {
+        return sign;
+      }
+      const uint32_t shift = 126u - (bits >> 23u);
+      const uint32_t mantissa = (bits & 0x7FFFFFu) | 0x800000u;
+      uint32_t half = mantissa >> shift;
+      const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+      const uint32_t halfway = 1u << (shift - 1u);
+      if ((remainder > halfway) || ((remainder == halfway) && ((half & 1u) != 0u))) {
+        ++half;
+      }
+      return sign | static_cast<uint16_t>(half);
+    }
+    // Normal half, rebias the exponent from 127 to 15.
+    uint32_t half = (bits - 0x38000000u) >> 13u;
+    const uint32_t remainder = bits & 0x1FFFu;
+    if ((remainder > 0x1000u) || ((remainder == 0x1000u) && ((half & 1u) != 0u))) {
+      ++half;
+    }
+    return sign | static_cast<uint16_t>(half);
+  }
+
+  float FromHalf(const uint16_t half) {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16u;
+    const uint32_t exponent = (half >> 10u) & 0x1Fu;
+    const uint32_t mantissa = half & 0x3FFu;
+    float value;
+    if (exponent == 0u) {
+      value = std::ldexp(static_cast<float>(mantissa), -24);
+    } else if (exponent == 0x1Fu) {
+      value = (mantissa == 0u ? INFINITY : NAN);
+    } else {
+      const uint32_t bits = ((exponent + 112u) << 23u) | (mantissa << 13u);
+      std::memcpy(&value, &bits, sizeof(value));
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits |= sign;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,42 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "carla/ArrayView.h"
+#include "carla/server/CarlaServerAPI.h"
+
+namespace carla {
+namespace server {
+
+  /// Encodings of the packed non-player agents, same values as
+  /// CARLA_SERVER_AGENTS_* and AgentsEncoding in carla_server.proto.
+  enum class AgentsEncoding : uint32_t {
+    Float32 = 0u,
+    Quantized = 1u,
+    QuantizedDelta = 2u,
+    HalfFloat = 3u
+  };
+
+  /// Write @a agents as a structure of arrays in @a encoding, see PackedAgents
+  /// in carla_server.proto. @a data keeps its capacity. Assumes a
+  /// little-endian platform.
+  void WritePackedAgents(
+      AgentsEncoding encoding,
+      const_array_view<carla_agent> agents,
+      std::string &data);
+
+  /// IEEE 754 half-precision bits of @a value, rounded to nearest even.
+  /// Values out of range are clamped to the largest finite half.
+  uint16_t ToHalf(float value);
+
+  float FromHalf(uint16_t half);
+
+} // namespace server
+} // namespace carla
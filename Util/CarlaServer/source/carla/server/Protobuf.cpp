@@ -6,11 +6,58 @@
 
 #include "carla/server/Protobuf.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <mutex>
+
 #include "carla/Debug.h"
 
 namespace carla {
 namespace server {
 
+  // ===========================================================================
+  // -- Arena statistics -------------------------------------------------------
+  // ===========================================================================
+
+  static std::mutex ARENA_STATS_MUTEX;
+
+  static Protobuf::ArenaStats ARENA_STATS;
+
+  static void RecordArena(const uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(ARENA_STATS_MUTEX);
+    ++ARENA_STATS.number_of_arenas;
+    ARENA_STATS.total_bytes += bytes;
+    ARENA_STATS.max_bytes = std::max(ARENA_STATS.max_bytes, bytes);
+  }
+
+  Protobuf::ArenaStats Protobuf::GetArenaStats() {
+    std::lock_guard<std::mutex> lock(ARENA_STATS_MUTEX);
+    return ARENA_STATS;
+  }
+
+  // ===========================================================================
+  // -- ScopedArena ------------------------------------------------------------
+  // ===========================================================================
+
+  static google::protobuf::ArenaOptions MakeArenaOptions(char *block, size_t size) {
+    google::protobuf::ArenaOptions options;
+    options.initial_block = block;
+    options.initial_block_size = size;
+    return options;
+  }
+
+  Protobuf::ScopedArena::ScopedArena()
+    : _arena(MakeArenaOptions(_initial_block, INITIAL_BLOCK_SIZE)) {}
+
+  Protobuf::ScopedArena::~ScopedArena() {
+    RecordArena(_arena.SpaceAllocated());
+  }
+
+  // ===========================================================================
+  // -- Protobuf ---------------------------------------------------------------
+  // ===========================================================================
+
   static void PrependByteSize(std::string &string, const uint32_t size) {
     constexpr uint32_t extraSize = sizeof(uint32_t);
     string.reserve(size + extraSize);
@@ -32,5 +79,23 @@ namespace server {
     return result;
   }
 
+  size_t Protobuf::Encode(
+      const google::protobuf::MessageLite &message,
+      std::vector<char> &buffer) {
+    DEBUG_ASSERT(message.IsInitialized());
+    constexpr size_t extraSize = sizeof(uint32_t);
+    const size_t size = message.ByteSizeLong();
+    DEBUG_ASSERT(size <= std::numeric_limits<uint32_t>::max());
+    const size_t total_size = size + extraSize;
+    if (buffer.size() < total_size) {
+      buffer.resize(total_size);
+    }
+    const uint32_t prefix = static_cast<uint32_t>(size);
+    std::memcpy(buffer.data(), &prefix, extraSize);
+    message.SerializeWithCachedSizesToArray(
+        reinterpret_cast<google::protobuf::uint8 *>(buffer.data() + extraSize));
+    return total_size;
+  }
+
 } // namespace server
 } // namespace carla
@@ -6,14 +6,19 @@
 
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include <google/protobuf/arena.h>
 #include <google/protobuf/message_lite.h>
 
+#include "carla/NonCopyable.h"
+
 namespace carla {
 namespace server {
 
-  /// Wrapper around google's protobuf library. It holds a protobuf arena for a
-  /// more efficient memory usage.
+  /// Wrapper around google's protobuf library.
   ///
   /// Encode functions return a string encoded as follows
   ///
@@ -22,6 +27,41 @@ namespace server {
   class Protobuf {
   public:
 
+    /// Statistics of the memory allocated by the message arenas of this
+    /// process.
+    struct ArenaStats {
+      uint64_t number_of_arenas = 0u;
+      /// Bytes allocated so far by every arena, including those already freed.
+      uint64_t total_bytes = 0u;
+      /// Maximum bytes allocated by a single arena.
+      uint64_t max_bytes = 0u;
+    };
+
+    /// A protobuf arena scoped to the encoding or decoding of a single message,
+    /// everything allocated in it is freed on destruction. Small messages are
+    /// allocated in an initial block without touching the heap.
+    class ScopedArena : private NonCopyable {
+    public:
+
+      ScopedArena();
+
+      ~ScopedArena();
+
+      /// Creates a protobuf message using arena allocation.
+      template <typename T>
+      T *CreateMessage() {
+        return google::protobuf::Arena::CreateMessage<T>(&_arena);
+      }
+
+    private:
+
+      static constexpr size_t INITIAL_BLOCK_SIZE = 1024u;
+
+      alignas(8) char _initial_block[INITIAL_BLOCK_SIZE];
+
+      google::protobuf::Arena _arena;
+    };
+
     /// Prepends the size of the message to the string. Only for testing
     /// purposes, for protobuf objects use specilized version of "encode"
     /// function.
@@ -31,15 +71,16 @@ namespace server {
     /// message.
     static std::string Encode(const google::protobuf::MessageLite &message);
 
-    /// Creates a protobuf message using arena allocation.
-    template <typename T>
-    T *CreateMessage() {
-      return google::protobuf::Arena::CreateMessage<T>(&_arena);
-    }
-
-  private:
+    /// Serializes the message straight into @a buffer, prefixed by its size
+    /// as any other encoding. The buffer is only grown, so it is allocated just
+    /// once for messages of similar size.
+    ///
+    /// Returns the number of bytes written, size prefix included.
+    static size_t Encode(
+        const google::protobuf::MessageLite &message,
+        std::vector<char> &buffer);
 
-    google::protobuf::Arena _arena;
+    static ArenaStats GetArenaStats();
   };
 
 } // namespace server
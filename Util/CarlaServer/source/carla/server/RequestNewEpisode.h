@@ -7,7 +7,9 @@
 #pragma once
 
 #include <memory>
+#include <string>
 
+#include "carla/server/Capabilities.h"
 #include "carla/server/CarlaServerAPI.h"
 
 namespace carla {
@@ -20,6 +22,24 @@ namespace server {
   struct RequestNewEpisode {
     carla_request_new_episode values;
     std::unique_ptr<const char[]> data;
+    /// Whether the episode is only queued, see carla_read_queued_episode().
+    bool queue = false;
+    /// Whether this is not an episode but a request to take a snapshot of the
+    /// world, or to restore restore_snapshot if not empty, see
+    /// carla_read_world_snapshot_request().
+    bool snapshot = false;
+    std::string restore_snapshot;
+    /// Whether this is not an episode but a route query, see
+    /// carla_read_route_request().
+    bool route = false;
+    carla_route_request route_request;
+    /// Whether this is not an episode but a road map request, see
+    /// carla_read_road_map_request().
+    bool road_map = false;
+    carla_road_map_request road_map_request;
+    /// Optional encodings supported by the client, all of them if it does
+    /// not negotiate.
+    Capabilities capabilities = Capabilities::All();
   };
 
 } // namespace server
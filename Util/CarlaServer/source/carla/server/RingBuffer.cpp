@@ -0,0 +1,77 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/RingBuffer.h"
+
+#include <algorithm>
+
+#include "carla/Debug.h"
+
+namespace carla {
+namespace server {
+namespace detail {
+
+  constexpr uint32_t RingBufferState::NONE;
+
+  // We need at least one slot for the producer and one for the consumer.
+  static constexpr uint32_t MIN_NUMBER_OF_SLOTS = 2u;
+
+  RingBufferState::RingBufferState(
+      const uint32_t number_of_slots,
+      const RingBufferPolicy policy)
+    : _policy(policy),
+      _queue(std::max(number_of_slots, MIN_NUMBER_OF_SLOTS), NONE) {
+    _free.reserve(_queue.size());
+    for (auto i = 0u; i < _queue.size(); ++i) {
+      _free.emplace_back(i);
+    }
+  }
+
+  uint32_t RingBufferState::StartWriting(const bool force_drop) {
+    if (_free.empty()) {
+      if ((_stats.depth == 0u) ||
+          ((_policy == RingBufferPolicy::Block) && !force_drop)) {
+        return NONE;
+      }
+      // Drop the oldest value in the queue and take its slot.
+      const auto slot = _queue[_queue_begin];
+      _queue_begin = (_queue_begin + 1u) % _queue.size();
+      --_stats.depth;
+      ++_stats.number_of_drops;
+      return slot;
+    }
+    const auto slot = _free.back();
+    _free.pop_back();
+    return slot;
+  }
+
+  void RingBufferState::EndWriting(const uint32_t slot) {
+    DEBUG_ASSERT(_stats.depth < _queue.size());
+    _queue[(_queue_begin + _stats.depth) % _queue.size()] = slot;
+    ++_stats.depth;
+    ++_stats.number_of_writes;
+    _stats.max_depth = std::max(_stats.max_depth, _stats.depth);
+  }
+
+  uint32_t RingBufferState::StartReading() {
+    if (_stats.depth == 0u) {
+      return NONE;
+    }
+    const auto slot = _queue[_queue_begin];
+    _queue_begin = (_queue_begin + 1u) % _queue.size();
+    --_stats.depth;
+    return slot;
+  }
+
+  void RingBufferState::EndReading(const uint32_t slot) {
+    DEBUG_ASSERT(_free.size() < _queue.size());
+    _free.emplace_back(slot);
+    ++_stats.number_of_reads;
+  }
+
+} // namespace detail
+} // namespace server
+} // namespace carla
@@ -0,0 +1,231 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// What to do when the producer of a RingBuffer finds every slot taken.
+  enum class RingBufferPolicy : uint32_t {
+    /// Discard the oldest value not yet read, never blocks the producer.
+    DropOldest,
+    /// Wait until the consumer releases a slot.
+    Block
+  };
+
+  /// Counters of a RingBuffer.
+  struct RingBufferStats {
+    uint64_t number_of_writes = 0u;
+    uint64_t number_of_reads = 0u;
+    uint64_t number_of_drops = 0u;
+    /// Number of values waiting to be read.
+    uint32_t depth = 0u;
+    /// Maximum depth reached.
+    uint32_t max_depth = 0u;
+  };
+
+namespace detail {
+
+  /// Keeps track of which slots of a ring buffer are free, queued for reading,
+  /// or in use. Not thread-safe, access must be synchronized by the caller.
+  class RingBufferState {
+  public:
+
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    RingBufferState(uint32_t number_of_slots, RingBufferPolicy policy);
+
+    uint32_t number_of_slots() const {
+      return static_cast<uint32_t>(_queue.size());
+    }
+
+    RingBufferPolicy policy() const {
+      return _policy;
+    }
+
+    /// Returns NONE if there is no free slot and the policy does not allow to
+    /// drop the oldest value, unless @a force_drop is true.
+    uint32_t StartWriting(bool force_drop);
+
+    void EndWriting(uint32_t slot);
+
+    /// Returns NONE if there is no data to read yet.
+    uint32_t StartReading();
+
+    void EndReading(uint32_t slot);
+
+    const RingBufferStats &stats() const {
+      return _stats;
+    }
+
+  private:
+
+    RingBufferPolicy _policy;
+
+    /// Stack of free slots.
+    std::vector<uint32_t> _free;
+
+    /// Circular queue of slots waiting to be read, oldest first.
+    std::vector<uint32_t> _queue;
+
+    uint32_t _queue_begin = 0u;
+
+    RingBufferStats _stats;
+  };
+
+} // namespace detail
+
+  /// A thread-safe ring buffer of a fixed number of slots for one producer and
+  /// one consumer. Values are read in the same order they were written.
+  ///
+  /// With two slots and RingBufferPolicy::DropOldest behaves as DoubleBuffer.
+  template <typename T>
+  class RingBuffer : private NonCopyable {
+  public:
+
+    explicit RingBuffer(
+        uint32_t number_of_slots = 2u,
+        RingBufferPolicy policy = RingBufferPolicy::DropOldest)
+      : _state(number_of_slots, policy),
+        _done(false),
+        _buffer(std::make_unique<T[]>(_state.number_of_slots())) {}
+
+    ~RingBuffer() { set_done(); }
+
+    bool done() const {
+      return _done;
+    }
+
+    void set_done() {
+      _done = true;
+      _condition.notify_all();
+      CallDataCallback();
+    }
+
+    RingBufferStats GetStats() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _state.stats();
+    }
+
+    /// Returns an unique_ptr to the oldest value not yet read. The given slot
+    /// will be locked for reading until the unique_ptr is destroyed.
+    ///
+    /// Blocks until there is some data to read, or the time-out is met.
+    ///
+    /// Returns nullptr if the time-out was met, or the RingBuffer is marked as
+    /// done.
+    auto TryMakeReader(timeout_t timeout) {
+      const auto deleter = [this](const T *ptr) {
+        if (ptr) {
+          {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _state.EndReading(GetSlot(ptr));
+          }
+          _condition.notify_all();
+        }
+      };
+      uint32_t slot = detail::RingBufferState::NONE;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait_for(lock, timeout.to_chrono(), [&] {
+          slot = _state.StartReading();
+          return _done || (slot != detail::RingBufferState::NONE);
+        });
+      }
+      const T *pointer = (slot != detail::RingBufferState::NONE ? &_buffer[slot] : nullptr);
+      return std::unique_ptr<const T, decltype(deleter)>(pointer, deleter);
+    }
+
+    /// Calls @a callback once there is some data to read or the RingBuffer is
+    /// marked as done, right away if it already is. The callback is called in
+    /// the thread of the producer and should not block, TryMakeReader with a
+    /// zero time-out does not block then. Replaces any callback pending.
+    void AsyncWaitForData(std::function<void()> callback) {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_done && (_state.stats().depth == 0u)) {
+          _data_callback = std::move(callback);
+          return;
+        }
+      }
+      callback();
+    }
+
+    /// Returns an unique_ptr to the slot to be written. The given slot will be
+    /// locked for writing until the unique_ptr is destroyed.
+    ///
+    /// With RingBufferPolicy::Block, blocks until a slot is free or the
+    /// RingBuffer is marked as done (then the oldest value is dropped).
+    ///
+    /// Never returns nullptr.
+    auto MakeWriter() {
+      const auto deleter = [this](T *ptr) {
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _state.EndWriting(GetSlot(ptr));
+        }
+        _condition.notify_all();
+        CallDataCallback();
+      };
+      uint32_t slot = detail::RingBufferState::NONE;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [&] {
+          slot = _state.StartWriting(_done);
+          return slot != detail::RingBufferState::NONE;
+        });
+      }
+      return std::unique_ptr<T, decltype(deleter)>(&_buffer[slot], deleter);
+    }
+
+  private:
+
+    /// Called out of the lock, the callback may read right away.
+    void CallDataCallback() {
+      std::function<void()> callback;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        callback = std::move(_data_callback);
+        _data_callback = nullptr;
+      }
+      if (callback) {
+        callback();
+      }
+    }
+
+    uint32_t GetSlot(const T *ptr) const {
+      return static_cast<uint32_t>(ptr - _buffer.get());
+    }
+
+    detail::RingBufferState _state;
+
+    std::mutex _mutex;
+
+    std::condition_variable _condition;
+
+    std::atomic_bool _done;
+
+    /// Consumer waiting asynchronously, see AsyncWaitForData.
+    std::function<void()> _data_callback;
+
+    const std::unique_ptr<T[]> _buffer;
+  };
+
+} // namespace server
+} // namespace carla
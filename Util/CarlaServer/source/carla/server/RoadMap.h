@@ -0,0 +1,26 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace carla {
+namespace server {
+
+  /// Answer to a road map request. The encoded map is shared with the world
+  /// server, that keeps it for the next requests, see RoadMapEncoding.
+  struct RoadMap {
+    bool success = false;
+    uint64_t hash = 0u;
+    /// Null if the client has the map already.
+    std::shared_ptr<const std::string> data;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,162 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/RoadMapEncoding.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "carla/Debug.h"
+#include "carla/server/LZ4.h"
+
+namespace carla {
+namespace server {
+
+  static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+  static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+  static constexpr uint32_t PIXELS_PER_TILE =
+      RoadMapEncoding::TileSize * RoadMapEncoding::TileSize;
+
+  static inline uint32_t DivideAndRoundUp(const uint32_t a, const uint32_t b) {
+    return (a + b - 1u) / b;
+  }
+
+  // FNV-1a over 64-bit words, the map may be tens of megabytes.
+  static inline void HashWord(uint64_t &hash, const uint64_t word) {
+    hash = (hash ^ word) * FNV_PRIME;
+  }
+
+  uint64_t RoadMapEncoding::Hash(const carla_road_map &road_map) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    HashWord(hash, (static_cast<uint64_t>(road_map.width) << 32u) | road_map.height);
+    for (auto i = 0u; i < 8u; i += 2u) {
+      uint64_t word;
+      std::memcpy(&word, &road_map.world_to_pixel[i], sizeof(word));
+      HashWord(hash, word);
+    }
+    const size_t size = size_t(road_map.width) * size_t(road_map.height);
+    const auto *pixels = road_map.pixels;
+    size_t i = 0u;
+    for (; i + 4u <= size; i += 4u) {
+      uint64_t word;
+      std::memcpy(&word, pixels + i, sizeof(word));
+      HashWord(hash, word);
+    }
+    for (; i < size; ++i) {
+      HashWord(hash, pixels[i]);
+    }
+    return (hash == 0u ? 1u : hash);
+  }
+
+  std::string RoadMapEncoding::Encode(const carla_road_map &road_map, const uint64_t hash) {
+    DEBUG_ASSERT(road_map.pixels != nullptr);
+    DEBUG_ASSERT((road_map.width > 0u) && (road_map.height > 0u));
+    const uint32_t tiles_x = DivideAndRoundUp(road_map.width, TileSize);
+    const uint32_t tiles_y = DivideAndRoundUp(road_map.height, TileSize);
+    Header header;
+    header.magic = Magic;
+    header.version = Version;
+    header.width = road_map.width;
+    header.height = road_map.height;
+    header.tile_size = TileSize;
+    header.number_of_tiles = tiles_x * tiles_y;
+    std::memcpy(header.world_to_pixel, road_map.world_to_pixel, sizeof(header.world_to_pixel));
+    header.hash = hash;
+
+    std::vector<TileEntry> table(header.number_of_tiles);
+    const size_t data_start = sizeof(Header) + table.size() * sizeof(TileEntry);
+    std::string result(data_start, '\0');
+
+    std::array<uint16_t, PIXELS_PER_TILE> tile;
+    std::vector<unsigned char> compressed(LZ4::CompressBound(sizeof(tile)));
+    for (auto tile_y = 0u; tile_y < tiles_y; ++tile_y) {
+      for (auto tile_x = 0u; tile_x < tiles_x; ++tile_x) {
+        bool is_uniform = true;
+        for (auto y = 0u; y < TileSize; ++y) {
+          const uint32_t pixel_y = std::min(tile_y * TileSize + y, road_map.height - 1u);
+          const auto *row = road_map.pixels + size_t(pixel_y) * road_map.width;
+          for (auto x = 0u; x < TileSize; ++x) {
+            const uint32_t pixel_x = std::min(tile_x * TileSize + x, road_map.width - 1u);
+            const uint16_t value = row[pixel_x];
+            tile[x + TileSize * y] = value;
+            is_uniform &= (value == tile[0u]);
+          }
+        }
+        auto &entry = table[tile_x + tiles_x * tile_y];
+        if (is_uniform) {
+          entry.offset = tile[0u];
+          entry.size = 0u;
+        } else {
+          const size_t size = LZ4::Compress(
+              reinterpret_cast<const unsigned char *>(tile.data()),
+              sizeof(tile),
+              compressed.data());
+          entry.offset = static_cast<uint32_t>(result.size());
+          entry.size = static_cast<uint32_t>(size);
+          result.append(reinterpret_cast<const char *>(compressed.data()), size);
+        }
+      }
+    }
+    std::memcpy(&result[0u], &header, sizeof(Header));
+    if (!table.empty()) {
+      std::memcpy(&result[sizeof(Header)], table.data(), table.size() * sizeof(TileEntry));
+    }
+    return result;
+  }
+
+  bool RoadMapEncoding::Decode(
+      const std::string &data,
+      Header &header,
+      std::vector<uint16_t> &pixels) {
+    if (data.size() < sizeof(Header)) {
+      return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(Header));
+    const uint32_t tiles_x = DivideAndRoundUp(header.width, TileSize);
+    const uint32_t tiles_y = DivideAndRoundUp(header.height, TileSize);
+    if ((header.magic != Magic) ||
+        (header.version != Version) ||
+        (header.tile_size != TileSize) ||
+        (header.number_of_tiles != tiles_x * tiles_y) ||
+        (data.size() < sizeof(Header) + size_t(header.number_of_tiles) * sizeof(TileEntry))) {
+      return false;
+    }
+    std::vector<TileEntry> table(header.number_of_tiles);
+    if (!table.empty()) {
+      std::memcpy(table.data(), &data[sizeof(Header)], table.size() * sizeof(TileEntry));
+    }
+    pixels.resize(size_t(header.width) * size_t(header.height));
+    std::array<uint16_t, PIXELS_PER_TILE> tile;
+    for (auto tile_y = 0u; tile_y < tiles_y; ++tile_y) {
+      for (auto tile_x = 0u; tile_x < tiles_x; ++tile_x) {
+        const auto &entry = table[tile_x + tiles_x * tile_y];
+        if (entry.size == 0u) {
+          tile.fill(static_cast<uint16_t>(entry.offset));
+        } else if ((size_t(entry.offset) + entry.size > data.size()) ||
+                   !LZ4::Decompress(
+                       reinterpret_cast<const unsigned char *>(data.data()) + entry.offset,
+                       entry.size,
+                       reinterpret_cast<unsigned char *>(tile.data()),
+                       sizeof(tile))) {
+          return false;
+        }
+        const uint32_t width = std::min(TileSize, header.width - tile_x * TileSize);
+        const uint32_t height = std::min(TileSize, header.height - tile_y * TileSize);
+        for (auto y = 0u; y < height; ++y) {
+          std::memcpy(
+              &pixels[size_t(tile_y * TileSize + y) * header.width + tile_x * TileSize],
+              &tile[TileSize * y],
+              width * sizeof(uint16_t));
+        }
+      }
+    }
+    return true;
+  }
+
+} // namespace server
+} // namespace carla
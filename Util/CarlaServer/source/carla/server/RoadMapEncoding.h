@@ -0,0 +1,70 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "carla/server/CarlaServerAPI.h"
+
+namespace carla {
+namespace server {
+
+  /// Encoding of the road map sent to the client, in little-endian:
+  ///
+  ///   - a Header of 64 bytes;
+  ///   - a TileEntry per tile, row-major, TileSize x TileSize pixels each;
+  ///   - the LZ4 block of every tile that is not uniform.
+  ///
+  /// Tiles on the right and bottom edges are padded repeating the last pixel
+  /// of the map. A uniform tile has no data, its size is zero and its offset
+  /// holds the value of its pixels.
+  class RoadMapEncoding {
+  public:
+
+    static constexpr uint32_t Magic = 0x50414d52u; // "RMAP"
+
+    static constexpr uint32_t Version = 1u;
+
+    static constexpr uint32_t TileSize = 64u;
+
+    struct Header {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t width;
+      uint32_t height;
+      uint32_t tile_size;
+      uint32_t number_of_tiles;
+      /// Same as carla_road_map::world_to_pixel.
+      float world_to_pixel[8u];
+      uint64_t hash;
+    };
+
+    static_assert(sizeof(Header) == 64u, "Unexpected size of the header");
+
+    struct TileEntry {
+      /// From the start of the encoded map.
+      uint32_t offset;
+      uint32_t size;
+    };
+
+    /// Content hash of the map, its size and transform included. Never zero
+    /// for a valid map, so zero stands for no map.
+    static uint64_t Hash(const carla_road_map &road_map);
+
+    static std::string Encode(const carla_road_map &road_map, uint64_t hash);
+
+    /// Returns false if @a data is not a valid encoded map.
+    static bool Decode(
+        const std::string &data,
+        Header &header,
+        std::vector<uint16_t> &pixels);
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,26 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <vector>
+
+#include "carla/server/CarlaServerAPI.h"
+
+namespace carla {
+namespace server {
+
+  /// Holds a copy of the data of a carla_route, since the write to the client
+  /// happens after carla_write_route() returns.
+  struct Route {
+    bool success = false;
+    std::vector<carla_vector3d> waypoints;
+    std::vector<uint32_t> lanes;
+    float length = 0.0f;
+  };
+
+} // namespace server
+} // namespace carla
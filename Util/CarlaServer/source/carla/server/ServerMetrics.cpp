@@ -0,0 +1,170 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/ServerMetrics.h"
+
+#include <sstream>
+
+#include "carla/server/MeasurementsPublisher.h"
+#include "carla/server/MemoryAccounting.h"
+#include "carla/server/Protobuf.h"
+#include "carla/server/StartupReport.h"
+#include "carla/server/StreamRecorder.h"
+
+namespace carla {
+namespace server {
+
+  template <typename T>
+  static void Print(
+      std::ostream &out,
+      const char *name,
+      const char *type,
+      const char *help,
+      const T value) {
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << ' ' << type << '\n'
+        << name << ' ' << value << '\n';
+  }
+
+  /// Gauge of the bytes held by every subsystem, labelled by subsystem.
+  class MemoryPrinter {
+  public:
+
+    explicit MemoryPrinter(std::ostream &out) : _out(out) {
+      _out << "# HELP carla_memory_bytes Bytes held by the largest structures of the simulator.\n"
+           << "# TYPE carla_memory_bytes gauge\n";
+    }
+
+    void Print(const char *subsystem, const uint64_t bytes) {
+      _out << "carla_memory_bytes{subsystem=\"" << subsystem << "\"} " << bytes << '\n';
+    }
+
+  private:
+
+    std::ostream &_out;
+  };
+
+  std::string ServerMetrics::GetText() const {
+    RingBufferStats buffer_stats;
+    bool has_publisher = false;
+    MeasurementsPublisher::Stats publisher_stats{0u, 0u, 0u};
+    bool has_recorder = false;
+    StreamRecorder::Stats recorder_stats{0u, 0u, 0u, 0u, false};
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_measurements_buffer) {
+        buffer_stats = _measurements_buffer();
+      }
+      const auto publisher = _publisher.lock();
+      if (publisher != nullptr) {
+        has_publisher = true;
+        publisher_stats = publisher->GetStats();
+      }
+      const auto recorder = _recorder.lock();
+      if (recorder != nullptr) {
+        has_recorder = true;
+        recorder_stats = recorder->GetStats();
+      }
+    }
+
+    auto load = [](const auto &value) { return value.load(std::memory_order_relaxed); };
+    auto seconds = [&](const auto &microseconds) { return 1e-6 * static_cast<double>(load(microseconds)); };
+
+    std::ostringstream out;
+    Print(out, "carla_agent_server_running", "gauge",
+        "Whether an agent server is running the current episode.",
+        load(_agent_server_running) ? 1 : 0);
+    Print(out, "carla_episode_id", "gauge",
+        "Id of the current episode.",
+        load(_episode_id));
+    Print(out, "carla_frames_sent_total", "counter",
+        "Measurements messages sent to the agent client.",
+        load(_frames_sent));
+    Print(out, "carla_bytes_sent_total", "counter",
+        "Bytes of measurements and images sent to the agent client.",
+        load(_bytes_sent));
+    Print(out, "carla_send_errors_total", "counter",
+        "Measurements messages that failed to be sent.",
+        load(_send_errors));
+    Print(out, "carla_encode_seconds_total", "counter",
+        "Time spent encoding the measurements messages sent.",
+        seconds(_encode_microseconds));
+    Print(out, "carla_send_seconds_total", "counter",
+        "Time spent sending the measurements messages.",
+        seconds(_send_microseconds));
+    Print(out, "carla_measurements_written_total", "counter",
+        "Measurements written by the simulator in the current agent server.",
+        buffer_stats.number_of_writes);
+    Print(out, "carla_measurements_dropped_total", "counter",
+        "Measurements dropped before being sent in the current agent server.",
+        buffer_stats.number_of_drops);
+    Print(out, "carla_measurements_queue_depth", "gauge",
+        "Measurements waiting to be sent.",
+        buffer_stats.depth);
+    Print(out, "carla_measurements_queue_max_depth", "gauge",
+        "Maximum number of measurements waiting to be sent in the current agent server.",
+        buffer_stats.max_depth);
+    Print(out, "carla_publisher_enabled", "gauge",
+        "Whether the measurements publisher is enabled.",
+        has_publisher ? 1 : 0);
+    Print(out, "carla_publisher_subscribers", "gauge",
+        "Subscribers connected to the measurements publisher.",
+        publisher_stats.number_of_subscribers);
+    Print(out, "carla_publisher_frames_total", "counter",
+        "Frames published to the subscribers.",
+        publisher_stats.number_of_frames);
+    Print(out, "carla_publisher_dropped_frames_total", "counter",
+        "Frames dropped by the subscribers falling behind.",
+        publisher_stats.number_of_drops);
+    Print(out, "carla_recorder_enabled", "gauge",
+        "Whether the stream recorder is enabled.",
+        has_recorder ? 1 : 0);
+    Print(out, "carla_recorder_failed", "gauge",
+        "Whether the stream recorder stopped after failing to write a segment.",
+        recorder_stats.failed ? 1 : 0);
+    Print(out, "carla_recorder_frames_total", "counter",
+        "Frames recorded.",
+        recorder_stats.number_of_frames);
+    Print(out, "carla_recorder_bytes_total", "counter",
+        "Bytes of the frames recorded.",
+        recorder_stats.bytes_written);
+    Print(out, "carla_recorder_dropped_frames_total", "counter",
+        "Frames dropped by the recorder falling behind or failing.",
+        recorder_stats.number_of_drops);
+    Print(out, "carla_recorder_segments_total", "counter",
+        "Segment files started by the recorder.",
+        recorder_stats.number_of_segments);
+    {
+      MemoryPrinter memory(out);
+      for (auto i = 0u; i < static_cast<uint32_t>(MemorySubsystem::SIZE); ++i) {
+        const auto subsystem = static_cast<MemorySubsystem>(i);
+        memory.Print(MemoryAccounting::GetName(subsystem), MemoryAccounting::Get(subsystem));
+      }
+      memory.Print("road_map", load(_road_map_bytes));
+      memory.Print("captured_images", load(_captured_images_bytes));
+      memory.Print("render_targets", load(_render_targets_bytes));
+      memory.Print("spawner_pools", load(_spawner_pools_bytes));
+    }
+    out << "# HELP carla_gpu_memory_bytes GPU memory allocated by the instance.\n"
+        << "# TYPE carla_gpu_memory_bytes gauge\n"
+        << "carla_gpu_memory_bytes{kind=\"textures\"} " << load(_gpu_textures_bytes) << '\n'
+        << "carla_gpu_memory_bytes{kind=\"render_targets\"} " << load(_gpu_render_targets_bytes) << '\n';
+    Print(out, "carla_gpu_texture_pool_bytes", "gauge",
+        "Size of the texture streaming pool, zero if not limited.",
+        load(_gpu_texture_pool_bytes));
+    Print(out, "carla_protobuf_arena_max_bytes", "gauge",
+        "Largest protobuf arena used to encode a message.",
+        Protobuf::GetArenaStats().max_bytes);
+    out << "# HELP carla_startup_phase_seconds Time since the process started at which each startup phase ended.\n"
+        << "# TYPE carla_startup_phase_seconds gauge\n";
+    for (const auto &phase : StartupReport::GetPhases()) {
+      out << "carla_startup_phase_seconds{phase=\"" << phase.first << "\"} " << phase.second << '\n';
+    }
+    return out.str();
+  }
+
+} // namespace server
+} // namespace carla
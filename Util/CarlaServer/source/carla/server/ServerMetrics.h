@@ -0,0 +1,130 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/CarlaServerAPI.h"
+#include "carla/server/RingBuffer.h"
+
+namespace carla {
+namespace server {
+
+  class MeasurementsPublisher;
+  class StreamRecorder;
+
+  /// Counters and gauges of a world server and its agent servers, written by
+  /// the game and networking threads and read by the MetricsServer at any
+  /// time.
+  class ServerMetrics : private NonCopyable {
+  public:
+
+    /// @name Measurements stream, written by the networking thread
+    /// @{
+
+    void AddFrameSent(uint64_t bytes, uint64_t encode_microseconds, uint64_t send_microseconds) {
+      _frames_sent.fetch_add(1u, std::memory_order_relaxed);
+      _bytes_sent.fetch_add(bytes, std::memory_order_relaxed);
+      _encode_microseconds.fetch_add(encode_microseconds, std::memory_order_relaxed);
+      _send_microseconds.fetch_add(send_microseconds, std::memory_order_relaxed);
+    }
+
+    void AddSendError() {
+      _send_errors.fetch_add(1u, std::memory_order_relaxed);
+    }
+
+    /// @}
+
+    /// @name Connection state, written by the game thread
+    /// @{
+
+    void SetAgentServerRunning(bool running, uint64_t episode_id) {
+      _agent_server_running.store(running, std::memory_order_relaxed);
+      _episode_id.store(episode_id, std::memory_order_relaxed);
+    }
+
+    /// Read the stats of the measurements buffer of the current agent server
+    /// from @a source, may be called from any thread.
+    void SetMeasurementsBuffer(std::function<RingBufferStats()> source) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _measurements_buffer = std::move(source);
+    }
+
+    void SetPublisher(std::weak_ptr<MeasurementsPublisher> publisher) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _publisher = std::move(publisher);
+    }
+
+    void SetRecorder(std::weak_ptr<StreamRecorder> recorder) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _recorder = std::move(recorder);
+    }
+
+    /// Memory held by the structures of the game, served next to the ones of
+    /// the library, see MemoryAccounting.
+    void SetGameMemory(const carla_memory_usage &usage) {
+      _road_map_bytes.store(usage.road_map, std::memory_order_relaxed);
+      _captured_images_bytes.store(usage.captured_images, std::memory_order_relaxed);
+      _render_targets_bytes.store(usage.render_targets, std::memory_order_relaxed);
+      _spawner_pools_bytes.store(usage.spawner_pools, std::memory_order_relaxed);
+      _gpu_textures_bytes.store(usage.gpu_textures, std::memory_order_relaxed);
+      _gpu_render_targets_bytes.store(usage.gpu_render_targets, std::memory_order_relaxed);
+      _gpu_texture_pool_bytes.store(usage.gpu_texture_pool, std::memory_order_relaxed);
+    }
+
+    /// @}
+
+    /// Every metric in Prometheus text exposition format.
+    std::string GetText() const;
+
+  private:
+
+    std::atomic<uint64_t> _frames_sent{0u};
+
+    std::atomic<uint64_t> _bytes_sent{0u};
+
+    std::atomic<uint64_t> _send_errors{0u};
+
+    std::atomic<uint64_t> _encode_microseconds{0u};
+
+    std::atomic<uint64_t> _send_microseconds{0u};
+
+    std::atomic_bool _agent_server_running{false};
+
+    std::atomic<uint64_t> _episode_id{0u};
+
+    std::atomic<uint64_t> _road_map_bytes{0u};
+
+    std::atomic<uint64_t> _captured_images_bytes{0u};
+
+    std::atomic<uint64_t> _render_targets_bytes{0u};
+
+    std::atomic<uint64_t> _spawner_pools_bytes{0u};
+
+    std::atomic<uint64_t> _gpu_textures_bytes{0u};
+
+    std::atomic<uint64_t> _gpu_render_targets_bytes{0u};
+
+    std::atomic<uint64_t> _gpu_texture_pool_bytes{0u};
+
+    mutable std::mutex _mutex;
+
+    std::function<RingBufferStats()> _measurements_buffer;
+
+    std::weak_ptr<MeasurementsPublisher> _publisher;
+
+    std::weak_ptr<StreamRecorder> _recorder;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,182 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/ServerThreads.h"
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#  include <cerrno>
+#  include <sched.h>
+#  include <sys/resource.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif // __linux__
+
+#include "carla/Logging.h"
+
+namespace carla {
+namespace server {
+
+namespace detail {
+
+#ifdef __linux__
+
+  using thread_id = pid_t;
+
+  static thread_id GetCurrentThreadId() {
+    return static_cast<thread_id>(::syscall(SYS_gettid));
+  }
+
+  static error_code LastError() {
+    return error_code(errno, boost::system::system_category());
+  }
+
+  static error_code Apply(const thread_id thread, const ThreadOptions &options) {
+    error_code ec = errc::success();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (options.cpus.empty()) {
+      // Let the kernel restrict it to the CPUs available to the process.
+      for (auto cpu = 0u; cpu < CPU_SETSIZE; ++cpu) {
+        CPU_SET(cpu, &set);
+      }
+    } else {
+      for (auto cpu : options.cpus) {
+        CPU_SET(cpu, &set);
+      }
+    }
+    if (::sched_setaffinity(thread, sizeof(set), &set) != 0) {
+      ec = LastError();
+    }
+    if ((::setpriority(PRIO_PROCESS, static_cast<id_t>(thread), options.priority) != 0) && !ec) {
+      ec = LastError();
+    }
+    return ec;
+  }
+
+#else
+
+  using thread_id = std::thread::id;
+
+  static thread_id GetCurrentThreadId() {
+    return std::this_thread::get_id();
+  }
+
+  static error_code Apply(thread_id, const ThreadOptions &) {
+    return errc::operation_not_supported();
+  }
+
+#endif // __linux__
+
+  static bool IsDefault(const ThreadOptions &options) {
+    return options.cpus.empty() && (options.priority == 0);
+  }
+
+  class ThreadRegistry {
+  public:
+
+    void Register() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      const auto thread = GetCurrentThreadId();
+      _threads.push_back(thread);
+      if (!IsDefault(_options)) {
+        const auto ec = Apply(thread, _options);
+        if (ec) {
+          log_error("failed to set the options of a server thread:", ec.message());
+        }
+      }
+    }
+
+    void Unregister() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      const auto it = std::find(_threads.begin(), _threads.end(), GetCurrentThreadId());
+      if (it != _threads.end()) {
+        *it = _threads.back();
+        _threads.pop_back();
+      }
+    }
+
+    error_code SetOptions(const ThreadOptions &options) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _options = options;
+      error_code result = errc::success();
+      for (auto thread : _threads) {
+        const auto ec = Apply(thread, _options);
+        if (ec && !result) {
+          result = ec;
+        }
+      }
+      log_info(
+          "server threads:", _threads.size(),
+          "cpus:", _options.cpus.size(),
+          "priority:", _options.priority);
+      return result;
+    }
+
+    ThreadOptions GetOptions() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _options;
+    }
+
+    size_t size() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _threads.size();
+    }
+
+  private:
+
+    std::mutex _mutex;
+
+    ThreadOptions _options;
+
+    std::vector<thread_id> _threads;
+  };
+
+  static ThreadRegistry &GetThreadRegistry() {
+    // Never destroyed, threads of static servers may unregister at exit.
+    static auto *registry = new ThreadRegistry();
+    return *registry;
+  }
+
+} // namespace detail
+
+  ServerThreads::Scope::Scope() {
+    detail::GetThreadRegistry().Register();
+  }
+
+  ServerThreads::Scope::~Scope() {
+    detail::GetThreadRegistry().Unregister();
+  }
+
+  error_code ServerThreads::SetOptions(const ThreadOptions &options) {
+#ifdef __linux__
+    for (auto cpu : options.cpus) {
+      if (cpu >= CPU_SETSIZE) {
+        log_error("invalid server thread cpu:", cpu);
+        return errc::invalid_argument();
+      }
+    }
+#endif // __linux__
+    if ((options.priority < -20) || (options.priority > 19)) {
+      log_error("invalid server thread priority:", options.priority);
+      return errc::invalid_argument();
+    }
+    return detail::GetThreadRegistry().SetOptions(options);
+  }
+
+  ThreadOptions ServerThreads::GetOptions() {
+    return detail::GetThreadRegistry().GetOptions();
+  }
+
+  size_t ServerThreads::size() {
+    return detail::GetThreadRegistry().size();
+  }
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,60 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// CPUs and priority of the threads of the server, applied to every thread
+  /// registered in ServerThreads.
+  struct ThreadOptions {
+    /// CPUs the threads may run on, any if empty.
+    std::vector<uint32_t> cpus;
+
+    /// Nice value of the threads, from -20 (highest priority) to 19. Negative
+    /// values usually need privileges.
+    int32_t priority = 0;
+  };
+
+  /// Registry of the threads owned by the server (those of the IOExecutor, on
+  /// which every server runs), so they can be pinned and prioritized as a
+  /// whole. Options apply to the threads already running and to those
+  /// registered later.
+  ///
+  /// Only implemented on Linux, elsewhere setting any option fails and the
+  /// threads are left as they are.
+  class ServerThreads {
+  public:
+
+    /// Registers the calling thread for its lifetime, applying the current
+    /// options to it.
+    class Scope : private NonCopyable {
+    public:
+
+      Scope();
+
+      ~Scope();
+    };
+
+    /// Apply @a options to every registered thread. On error the remaining
+    /// threads are still updated, and the first error is returned.
+    static error_code SetOptions(const ThreadOptions &options);
+
+    static ThreadOptions GetOptions();
+
+    /// Number of threads currently registered.
+    static size_t size();
+  };
+
+} // namespace server
+} // namespace carla
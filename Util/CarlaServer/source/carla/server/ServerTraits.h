@@ -45,6 +45,10 @@ namespace errc {
     return boost::asio::error::basic_errors::operation_aborted;
   }
 
+  static inline error_code operation_not_supported() {
+    return boost::asio::error::basic_errors::operation_not_supported;
+  }
+
 } // namespace errc
 
   using time_duration = boost::posix_time::time_duration;
@@ -0,0 +1,105 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/SharedMemoryImages.h"
+
+#include <atomic>
+#include <cstring>
+
+#include <boost/interprocess/exceptions.hpp>
+
+#include "carla/Debug.h"
+#include "carla/Logging.h"
+
+namespace carla {
+namespace server {
+
+  namespace bip = boost::interprocess;
+
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Slot sequences must be lock-free");
+
+  static constexpr size_t AlignUp(size_t size) {
+    return (size + SharedMemoryImages::Alignment - 1u) & ~size_t(SharedMemoryImages::Alignment - 1u);
+  }
+
+  static std::atomic<uint64_t> &GetSequence(unsigned char *slot) {
+    return *reinterpret_cast<std::atomic<uint64_t> *>(slot);
+  }
+
+  SharedMemoryImages::SharedMemoryImages(std::string name, const uint32_t number_of_slots)
+    : _name(std::move(name)),
+      _number_of_slots(number_of_slots) {
+    DEBUG_ASSERT(_number_of_slots > 0u);
+  }
+
+  SharedMemoryImages::~SharedMemoryImages() {
+    if (_slot_size > 0u) {
+      bip::shared_memory_object::remove(_name.c_str());
+    }
+  }
+
+  uint64_t SharedMemoryImages::Write(const const_buffer images) {
+    const auto size = boost::asio::buffer_size(images);
+    if (_slot_size == 0u) {
+      if (_allocation_failed) {
+        return 0u;
+      }
+      // Leave some margin for the images to grow, e.g. compressed ones.
+      if (!Allocate(size + size / 4u)) {
+        _allocation_failed = true;
+        return 0u;
+      }
+    }
+    if (size > _slot_size) {
+      log_debug("shared memory", _name, ": images of", size, "bytes do not fit in a slot");
+      return 0u;
+    }
+    const auto sequence = ++_sequence;
+    auto *slot = GetSlot(sequence);
+    auto &slot_sequence = GetSequence(slot);
+    slot_sequence.store(0u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(slot + Alignment, boost::asio::buffer_cast<const unsigned char *>(images), size);
+    slot_sequence.store(sequence, std::memory_order_release);
+    return sequence;
+  }
+
+  bool SharedMemoryImages::Allocate(size_t slot_size) {
+    slot_size = AlignUp(slot_size);
+    const size_t total_size = Alignment + _number_of_slots * (Alignment + slot_size);
+    try {
+      // Remove any segment left behind by a previous instance.
+      bip::shared_memory_object::remove(_name.c_str());
+      bip::shared_memory_object segment(bip::create_only, _name.c_str(), bip::read_write);
+      segment.truncate(static_cast<bip::offset_t>(total_size));
+      bip::mapped_region region(segment, bip::read_write);
+      _segment.swap(segment);
+      _region.swap(region);
+    } catch (const bip::interprocess_exception &exception) {
+      log_error("unable to create shared memory", _name, ':', exception.what());
+      return false;
+    }
+    auto *begin = static_cast<unsigned char *>(_region.get_address());
+    const uint32_t header[] = {
+        Magic,
+        Version,
+        _number_of_slots,
+        static_cast<uint32_t>(slot_size)};
+    std::memcpy(begin, header, sizeof(header));
+    _slot_size = slot_size;
+    log_info("shared memory", _name, "created with", _number_of_slots, "slots of", slot_size, "bytes");
+    return true;
+  }
+
+  unsigned char *SharedMemoryImages::GetSlot(const uint64_t sequence) const {
+    DEBUG_ASSERT(sequence > 0u);
+    const auto index = (sequence - 1u) % _number_of_slots;
+    auto *begin = static_cast<unsigned char *>(_region.get_address());
+    return begin + Alignment + index * (Alignment + _slot_size);
+  }
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,87 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <string>
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// Ring of slots in a named shared memory segment where the image messages
+  /// are written for clients running in the same host. The measurements sent
+  /// through the socket carry the sequence number of the slot holding their
+  /// images, the socket message acts as doorbell.
+  ///
+  /// Layout of the segment, every field little-endian:
+  ///
+  ///     [magic, version, number of slots, slot size]  (uint32 each)
+  ///     padding up to Alignment
+  ///     for each slot:
+  ///       [sequence]  (uint64)
+  ///       padding up to Alignment
+  ///       [image message]  (slot size bytes, same as sent through the socket)
+  ///
+  /// The sequence of a slot is zero while it is being written, a reader
+  /// should check it before and after copying the images.
+  ///
+  /// The segment is created on the first write, sized after those images with
+  /// some margin. Images that do not fit later on are sent through the socket
+  /// instead.
+  class SharedMemoryImages : private NonCopyable {
+  public:
+
+    static constexpr uint32_t Magic = 0x414c5243u; // "CRLA"
+
+    static constexpr uint32_t Version = 1u;
+
+    static constexpr size_t Alignment = 64u;
+
+    explicit SharedMemoryImages(std::string name, uint32_t number_of_slots = 4u);
+
+    /// Removes the segment, clients keep their mapping until they unmap it.
+    ~SharedMemoryImages();
+
+    const std::string &name() const {
+      return _name;
+    }
+
+    /// Copy @a images into the next slot. Returns its sequence number, or zero
+    /// if the images could not be written and have to be sent through the
+    /// socket.
+    ///
+    /// @warning Not thread-safe, there is a single writer per segment.
+    uint64_t Write(const_buffer images);
+
+  private:
+
+    bool Allocate(size_t slot_size);
+
+    unsigned char *GetSlot(uint64_t sequence) const;
+
+    const std::string _name;
+
+    const uint32_t _number_of_slots;
+
+    size_t _slot_size = 0u;
+
+    uint64_t _sequence = 0u;
+
+    bool _allocation_failed = false;
+
+    boost::interprocess::shared_memory_object _segment;
+
+    boost::interprocess::mapped_region _region;
+  };
+
+} // namespace server
+} // namespace carla
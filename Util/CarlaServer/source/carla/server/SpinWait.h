@@ -0,0 +1,66 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <immintrin.h>
+#endif
+
+namespace carla {
+namespace server {
+
+  /// How long a consumer polls before blocking on a condition variable. It
+  /// first polls @a spins times pausing the CPU between checks, then @a yields
+  /// times yielding the rest of its time slice. Zero for both blocks right
+  /// away.
+  ///
+  /// Polling trades CPU time for latency: a consumer woken up through the
+  /// kernel pays the scheduler wake-up time, which dominates the round trip
+  /// of tight lockstep loops.
+  struct SpinWait {
+    uint32_t spins = 0u;
+    uint32_t yields = 0u;
+
+    bool empty() const {
+      return (spins == 0u) && (yields == 0u);
+    }
+
+    /// Poll @a ready as configured, returns whether it became true.
+    template <typename Predicate>
+    bool Poll(Predicate &&ready) const {
+      for (auto i = 0u; i < spins; ++i) {
+        if (ready()) {
+          return true;
+        }
+        Pause();
+      }
+      for (auto i = 0u; i < yields; ++i) {
+        if (ready()) {
+          return true;
+        }
+        std::this_thread::yield();
+      }
+      return false;
+    }
+
+    /// Hint the CPU that we are in a spin-wait loop.
+    static inline void Pause() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+      _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+      __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+      asm volatile("yield");
+#endif
+    }
+  };
+
+} // namespace server
+} // namespace carla
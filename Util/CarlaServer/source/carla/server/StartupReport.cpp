@@ -0,0 +1,35 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/StartupReport.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace carla {
+namespace server {
+
+  static std::mutex PHASES_MUTEX;
+
+  static std::vector<StartupReport::Phase> PHASES;
+
+  void StartupReport::Mark(const std::string &phase, const double seconds_since_start) {
+    std::lock_guard<std::mutex> lock(PHASES_MUTEX);
+    const auto it = std::find_if(PHASES.begin(), PHASES.end(), [&](const Phase &item) {
+      return item.first == phase;
+    });
+    if (it == PHASES.end()) {
+      PHASES.emplace_back(phase, seconds_since_start);
+    }
+  }
+
+  std::vector<StartupReport::Phase> StartupReport::GetPhases() {
+    std::lock_guard<std::mutex> lock(PHASES_MUTEX);
+    return PHASES;
+  }
+
+} // namespace server
+} // namespace carla
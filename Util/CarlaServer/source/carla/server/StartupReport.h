@@ -0,0 +1,32 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace carla {
+namespace server {
+
+  /// Time at which every startup phase of the simulator ended, process-wide,
+  /// served by every ServerMetrics, see carla_mark_startup_phase.
+  class StartupReport {
+  public:
+
+    using Phase = std::pair<std::string, double>;
+
+    /// Only the first time a phase ends is kept, i.e. the cold start, later
+    /// episodes going through the same phases are ignored.
+    static void Mark(const std::string &phase, double seconds_since_start);
+
+    /// In the order they were marked.
+    static std::vector<Phase> GetPhases();
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,366 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/StreamRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef __linux__
+#  include <cerrno>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif // __linux__
+
+#include "carla/Debug.h"
+#include "carla/Logging.h"
+
+namespace carla {
+namespace server {
+
+  static constexpr auto RECORDER_LOG_PREFIX = "recorder:";
+
+  /// Alignment of the offsets, sizes and memory of direct writes.
+  static constexpr size_t RECORDER_BLOCK_SIZE = 4096u;
+
+  /// Bytes of frames gathered before writing them at once.
+  static constexpr size_t RECORDER_BATCH_SIZE = 1024u * RECORDER_BLOCK_SIZE;
+
+  /// A segment with unwritten frames is written after this long without new
+  /// frames.
+  static constexpr auto RECORDER_IDLE_FLUSH = std::chrono::milliseconds(500);
+
+  // ===========================================================================
+  // -- StreamRecorder::Segment ------------------------------------------------
+  // ===========================================================================
+
+  /// A segment file and its index. Frames are gathered in an aligned buffer
+  /// and written a whole batch at a time. With direct writes only whole blocks
+  /// can be written, so on Flush the last partial block is written padded,
+  /// kept in the buffer to be written again once complete, and the file is
+  /// truncated back to its actual size.
+  class StreamRecorder::Segment : private NonCopyable {
+  public:
+
+    explicit Segment(const std::string &name)
+      : _name(name),
+        _memory(new unsigned char[RECORDER_BATCH_SIZE + RECORDER_BLOCK_SIZE]) {
+      auto address = reinterpret_cast<uintptr_t>(_memory.get());
+      address = (address + RECORDER_BLOCK_SIZE - 1u) & ~static_cast<uintptr_t>(RECORDER_BLOCK_SIZE - 1u);
+      _buffer = reinterpret_cast<unsigned char *>(address);
+      _good = Open(_name + ".stream");
+      _index = (_good ? std::fopen((_name + ".index").c_str(), "wb") : nullptr);
+      if (_index == nullptr) {
+        log_error(RECORDER_LOG_PREFIX, "unable to open segment", _name);
+        _good = false;
+        return;
+      }
+      IndexHeader header;
+      std::memcpy(header.magic, "CARLAIDX", sizeof(header.magic));
+      header.version = INDEX_VERSION;
+      header.entry_size = sizeof(IndexEntry);
+      _good = (std::fwrite(&header, sizeof(header), 1u, _index) == 1u);
+      log_debug(RECORDER_LOG_PREFIX, "recording into", _name, _direct ? "(direct)" : "(buffered)");
+    }
+
+    ~Segment() {
+      Flush();
+      Close();
+      if (_index != nullptr) {
+        std::fclose(_index);
+      }
+    }
+
+    bool good() const {
+      return _good;
+    }
+
+    uint64_t size() const {
+      return _size;
+    }
+
+    void Append(const EncodedFrame &frame) {
+      IndexEntry entry;
+      entry.offset = _size;
+      entry.measurements_size = static_cast<uint32_t>(boost::asio::buffer_size(frame.measurements()));
+      entry.images_size = static_cast<uint32_t>(boost::asio::buffer_size(frame.images()));
+      const auto *data = frame.data();
+      auto remaining = frame.size();
+      while (_good && (remaining > 0u)) {
+        const auto count = std::min(remaining, RECORDER_BATCH_SIZE - _buffered);
+        std::memcpy(_buffer + _buffered, data, count);
+        _buffered += count;
+        data += count;
+        remaining -= count;
+        if (_buffered == RECORDER_BATCH_SIZE) {
+          _good = WriteAt(_buffer, RECORDER_BATCH_SIZE, _committed);
+          _committed += RECORDER_BATCH_SIZE;
+          _buffered = 0u;
+        }
+      }
+      _size += frame.size();
+      _good = _good && (std::fwrite(&entry, sizeof(entry), 1u, _index) == 1u);
+      _dirty = true;
+    }
+
+    /// Write every frame appended so far.
+    void Flush() {
+      if (!_good || !_dirty) {
+        return;
+      }
+      _dirty = false;
+      if (_buffered > 0u) {
+        auto size = _buffered;
+        if (_direct) {
+          size = (size + RECORDER_BLOCK_SIZE - 1u) & ~(RECORDER_BLOCK_SIZE - 1u);
+          std::memset(_buffer + _buffered, 0, size - _buffered);
+        }
+        _good = WriteAt(_buffer, size, _committed);
+        const auto written = (_direct ? _buffered & ~(RECORDER_BLOCK_SIZE - 1u) : _buffered);
+        std::memmove(_buffer, _buffer + written, _buffered - written);
+        _committed += written;
+        _buffered -= written;
+      }
+      _good = _good && Truncate(_size) && (std::fflush(_index) == 0);
+      if (!_good) {
+        log_error(RECORDER_LOG_PREFIX, "error writing segment", _name);
+      }
+    }
+
+  private:
+
+#ifdef __linux__
+
+    bool Open(const std::string &filename) {
+      constexpr int FLAGS = O_WRONLY | O_CREAT | O_TRUNC;
+      _file = ::open(filename.c_str(), FLAGS | O_DIRECT, 0644);
+      _direct = (_file >= 0);
+      if (!_direct && (errno == EINVAL)) {
+        // The file system does not support direct I/O (e.g. tmpfs).
+        _file = ::open(filename.c_str(), FLAGS, 0644);
+      }
+      return _file >= 0;
+    }
+
+    bool WriteAt(const unsigned char *data, size_t size, uint64_t offset) {
+      while (size > 0u) {
+        const auto count = ::pwrite(_file, data, size, static_cast<off_t>(offset));
+        if (count < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return false;
+        }
+        data += count;
+        size -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+      }
+      return true;
+    }
+
+    bool Truncate(uint64_t size) {
+      return !_direct || (::ftruncate(_file, static_cast<off_t>(size)) == 0);
+    }
+
+    void Close() {
+      if (_file >= 0) {
+        ::close(_file);
+      }
+    }
+
+    int _file = -1;
+
+#else
+
+    bool Open(const std::string &filename) {
+      _file = std::fopen(filename.c_str(), "wb");
+      return _file != nullptr;
+    }
+
+    bool WriteAt(const unsigned char *data, size_t size, uint64_t) {
+      // Buffered writes, always at the end of the file.
+      return (std::fwrite(data, 1u, size, _file) == size) && (std::fflush(_file) == 0);
+    }
+
+    bool Truncate(uint64_t) {
+      return true;
+    }
+
+    void Close() {
+      if (_file != nullptr) {
+        std::fclose(_file);
+      }
+    }
+
+    std::FILE *_file = nullptr;
+
+#endif // __linux__
+
+    const std::string _name;
+
+    const std::unique_ptr<unsigned char[]> _memory;
+
+    /// Aligned to RECORDER_BLOCK_SIZE, holds the bytes from _committed on.
+    unsigned char *_buffer;
+
+    size_t _buffered = 0u;
+
+    /// Offset in the file of the first byte of the buffer.
+    uint64_t _committed = 0u;
+
+    /// Bytes of the frames appended.
+    uint64_t _size = 0u;
+
+    std::FILE *_index = nullptr;
+
+    bool _direct = false;
+
+    bool _good = false;
+
+    bool _dirty = false;
+  };
+
+  // ===========================================================================
+  // -- StreamRecorder ---------------------------------------------------------
+  // ===========================================================================
+
+  constexpr uint32_t StreamRecorder::INDEX_VERSION;
+
+  std::string StreamRecorder::GetSegmentPath(const std::string &directory, const uint32_t number) {
+    char name[16u];
+    std::snprintf(name, sizeof(name), "%05u", static_cast<unsigned>(number));
+    return directory + "/" + name;
+  }
+
+  StreamRecorder::StreamRecorder(std::string directory)
+    : StreamRecorder(std::move(directory), Options()) {}
+
+  StreamRecorder::StreamRecorder(std::string directory, const Options &options)
+    : _directory(std::move(directory)),
+      _options(options) {
+    DEBUG_ASSERT(_options.segment_size > 0u);
+    // Never overwrite a previous recording.
+    while (std::ifstream(GetSegmentPath(_directory, _next_segment) + ".stream").good()) {
+      ++_next_segment;
+    }
+    _thread = std::thread([this]() { Run(); });
+  }
+
+  StreamRecorder::~StreamRecorder() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _done = true;
+    }
+    _frames_queued.notify_one();
+    _thread.join();
+  }
+
+  void StreamRecorder::Record(const EncodedFramePtr &frame) {
+    DEBUG_ASSERT(frame != nullptr);
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_stats.failed || (_queued_bytes + frame->size() > _options.max_queued_bytes)) {
+        ++_stats.number_of_drops;
+        return;
+      }
+      _queued_bytes += frame->size();
+      _queue.emplace_back(frame);
+    }
+    _frames_queued.notify_one();
+  }
+
+  void StreamRecorder::Flush() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    const auto request = ++_flush_requests;
+    _frames_queued.notify_one();
+    _flushed.wait(lock, [&]() { return _flushes_done >= request; });
+  }
+
+  StreamRecorder::Stats StreamRecorder::GetStats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+  }
+
+  void StreamRecorder::Run() {
+    std::deque<EncodedFramePtr> batch;
+    for (;;) {
+      uint64_t flush_requests;
+      bool done;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _frames_queued.wait_for(lock, RECORDER_IDLE_FLUSH, [this]() {
+          return _done || !_queue.empty() || (_flush_requests > _flushes_done);
+        });
+        batch.swap(_queue);
+        flush_requests = _flush_requests;
+        done = _done;
+      }
+      uint64_t bytes = 0u;
+      for (auto &frame : batch) {
+        WriteFrame(*frame);
+        bytes += frame->size();
+      }
+      // Idle, or somebody is waiting for the frames to be on disk.
+      if ((batch.empty() || (flush_requests > _flushes_done)) && (_segment != nullptr)) {
+        _segment->Flush();
+      }
+      const bool failed = ((_segment != nullptr) && !_segment->good());
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queued_bytes -= bytes;
+        if (failed) {
+          _stats.number_of_drops += _queue.size();
+          _queued_bytes = 0u;
+          _queue.clear();
+          _stats.failed = true;
+        }
+        _flushes_done = flush_requests;
+      }
+      _flushed.notify_all();
+      batch.clear();
+      if (done) {
+        // Frames queued after _done are not recorded.
+        _segment = nullptr;
+        return;
+      }
+    }
+  }
+
+  void StreamRecorder::WriteFrame(const EncodedFrame &frame) {
+    if (_segment != nullptr) {
+      if (!_segment->good()) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_stats.number_of_drops;
+        return;
+      }
+      if ((_segment->size() > 0u) && (_segment->size() + frame.size() > _options.segment_size)) {
+        _segment = nullptr;
+      }
+    }
+    if (_segment == nullptr) {
+      _segment = std::make_unique<Segment>(GetSegmentPath(_directory, _next_segment++));
+      std::lock_guard<std::mutex> lock(_mutex);
+      ++_stats.number_of_segments;
+      if (!_segment->good()) {
+        ++_stats.number_of_drops;
+        return;
+      }
+    }
+    _segment->Append(frame);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_segment->good()) {
+      ++_stats.number_of_frames;
+      _stats.bytes_written += frame.size();
+    } else {
+      ++_stats.number_of_drops;
+    }
+  }
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,141 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/EncodedFrame.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// Records the measurements stream into append-only segment files in a
+  /// directory, so the recording is done in the simulator host instead of by
+  /// the client.
+  ///
+  /// Each segment ("00000.stream", "00001.stream"...) holds the frames one
+  /// after the other exactly as sent to the agent client, so it can be
+  /// replayed as is or memory-mapped. Next to it, an index ("00000.index")
+  /// holds an IndexHeader followed by an IndexEntry per frame. The numbering
+  /// continues after the segments already in the directory.
+  ///
+  /// References to the frames are queued, up to a bound, and written in
+  /// batches by a background thread, bypassing the page cache (O_DIRECT) where available.
+  /// If the disk falls behind, new frames are dropped instead of stalling the
+  /// simulation.
+  class StreamRecorder : private NonCopyable {
+  public:
+
+    struct IndexHeader {
+      /// "CARLAIDX".
+      char magic[8u];
+      uint32_t version;
+      uint32_t entry_size;
+    };
+
+    struct IndexEntry {
+      /// Offset of the frame in the segment.
+      uint64_t offset;
+      /// Size of the measurements message, size prefix included.
+      uint32_t measurements_size;
+      /// Size of the images message that follows, size prefix included.
+      uint32_t images_size;
+    };
+
+    static constexpr uint32_t INDEX_VERSION = 1u;
+
+    /// Path of the segment @a number in @a directory, without extension.
+    static std::string GetSegmentPath(const std::string &directory, uint32_t number);
+
+    struct Options {
+      /// A new segment is started when a frame would not fit in the current
+      /// one.
+      uint64_t segment_size = 1024u * 1024u * 1024u;
+
+      /// Bytes of frames waiting to be written before dropping new frames.
+      uint64_t max_queued_bytes = 256u * 1024u * 1024u;
+    };
+
+    struct Stats {
+      uint64_t number_of_frames;
+      uint64_t number_of_drops;
+      uint64_t bytes_written;
+      uint32_t number_of_segments;
+      /// A segment failed to be opened or written, nothing else is recorded.
+      bool failed;
+    };
+
+    /// Frames are recorded into @a directory, that must exist.
+    explicit StreamRecorder(std::string directory);
+
+    StreamRecorder(std::string directory, const Options &options);
+
+    /// Writes every queued frame and closes the current segment.
+    ~StreamRecorder();
+
+    /// Queue a reference to @a frame to be written, the frame is not copied.
+    /// Never blocks on the disk.
+    void Record(const EncodedFramePtr &frame);
+
+    /// Blocks until every frame queued so far has been written and the
+    /// current segment and index are up to date on disk.
+    void Flush();
+
+    const std::string &GetDirectory() const {
+      return _directory;
+    }
+
+    Stats GetStats() const;
+
+  private:
+
+    class Segment;
+
+    void Run();
+
+    void WriteFrame(const EncodedFrame &frame);
+
+    const std::string _directory;
+
+    const Options _options;
+
+    mutable std::mutex _mutex;
+
+    std::condition_variable _frames_queued;
+
+    std::condition_variable _flushed;
+
+    std::deque<EncodedFramePtr> _queue;
+
+    uint64_t _queued_bytes = 0u;
+
+    uint64_t _flush_requests = 0u;
+
+    uint64_t _flushes_done = 0u;
+
+    bool _done = false;
+
+    Stats _stats{0u, 0u, 0u, 0u, false};
+
+    /// Accessed only by the writer thread.
+    std::unique_ptr<Segment> _segment;
+
+    uint32_t _next_segment = 0u;
+
+    std::thread _thread;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,133 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/StreamRecording.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "carla/Debug.h"
+#include "carla/Logging.h"
+#include "carla/server/StreamRecorder.h"
+
+namespace carla {
+namespace server {
+
+  namespace bip = boost::interprocess;
+
+  static constexpr auto RECORDING_LOG_PREFIX = "recording:";
+
+  // ===========================================================================
+  // -- StreamRecording::Segment -----------------------------------------------
+  // ===========================================================================
+
+  class StreamRecording::Segment : private NonCopyable {
+  public:
+
+    /// Throws bip::interprocess_exception if the file cannot be mapped.
+    explicit Segment(const std::string &filename) {
+      bip::file_mapping file(filename.c_str(), bip::read_only);
+      // Empty files cannot be mapped.
+      std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+      if (stream.tellg() > 0) {
+        _region = bip::mapped_region(file, bip::read_only);
+      }
+    }
+
+    const unsigned char *data() const {
+      return static_cast<const unsigned char *>(_region.get_address());
+    }
+
+    uint64_t size() const {
+      return _region.get_size();
+    }
+
+  private:
+
+    bip::mapped_region _region;
+  };
+
+  // ===========================================================================
+  // -- StreamRecording --------------------------------------------------------
+  // ===========================================================================
+
+  static bool ReadIndex(const std::string &filename, std::vector<StreamRecorder::IndexEntry> &entries) {
+    std::ifstream file(filename, std::ios::binary);
+    StreamRecorder::IndexHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        (std::memcmp(header.magic, "CARLAIDX", sizeof(header.magic)) != 0) ||
+        (header.version != StreamRecorder::INDEX_VERSION) ||
+        (header.entry_size != sizeof(StreamRecorder::IndexEntry))) {
+      return false;
+    }
+    const std::string data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    // A partially written entry at the end is ignored.
+    entries.resize(data.size() / sizeof(StreamRecorder::IndexEntry));
+    std::memcpy(entries.data(), data.data(), entries.size() * sizeof(StreamRecorder::IndexEntry));
+    return true;
+  }
+
+  error_code StreamRecording::Open(const std::string &directory) {
+    _segments.clear();
+    _frames.clear();
+    std::vector<StreamRecorder::IndexEntry> entries;
+    for (uint32_t number = 0u; ; ++number) {
+      const auto path = StreamRecorder::GetSegmentPath(directory, number);
+      if (!std::ifstream(path + ".stream").good()) {
+        break;
+      }
+      if (!ReadIndex(path + ".index", entries)) {
+        log_error(RECORDING_LOG_PREFIX, "invalid index of segment", path);
+        return errc::invalid_argument();
+      }
+      std::shared_ptr<const Segment> segment;
+      try {
+        segment = std::make_shared<Segment>(path + ".stream");
+      } catch (const bip::interprocess_exception &exception) {
+        log_error(RECORDING_LOG_PREFIX, "unable to map segment", path, ':', exception.what());
+        return errc::invalid_argument();
+      }
+      for (auto &entry : entries) {
+        const uint64_t end = entry.offset + entry.measurements_size + entry.images_size;
+        if ((end > segment->size()) || (entry.measurements_size < sizeof(uint32_t))) {
+          log_info(RECORDING_LOG_PREFIX, "ignoring the incomplete frames of segment", path);
+          break;
+        }
+        _frames.push_back(FrameEntry{
+            static_cast<uint32_t>(_segments.size()),
+            entry.offset,
+            entry.measurements_size,
+            entry.images_size});
+      }
+      _segments.emplace_back(std::move(segment));
+    }
+    if (_segments.empty()) {
+      log_error(RECORDING_LOG_PREFIX, "no segments found in", directory);
+      return errc::invalid_argument();
+    }
+    log_info(RECORDING_LOG_PREFIX, _frames.size(), "frames in", _segments.size(), "segments");
+    return errc::success();
+  }
+
+  StreamRecording::Frame StreamRecording::GetFrame(const size_t index) const {
+    DEBUG_ASSERT(index < _frames.size());
+    const auto &entry = _frames[index];
+    const auto &segment = _segments[entry.segment];
+    const auto *data = segment->data() + entry.offset;
+    Frame frame;
+    frame.measurements = boost::asio::buffer(data, entry.measurements_size);
+    frame.images = boost::asio::buffer(data + entry.measurements_size, entry.images_size);
+    frame.segment = segment;
+    return frame;
+  }
+
+} // namespace server
+} // namespace carla
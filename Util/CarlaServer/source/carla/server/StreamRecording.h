@@ -0,0 +1,66 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// Read-only view of a recording made by StreamRecorder. Every segment is
+  /// memory-mapped, frames are not copied.
+  class StreamRecording : private NonCopyable {
+  public:
+
+    struct Frame {
+      /// Measurements message, size prefix included.
+      const_buffer measurements;
+      /// Images message, size prefix included.
+      const_buffer images;
+      /// Keeps the segment of the frame mapped, even after the recording is
+      /// destroyed.
+      std::shared_ptr<const void> segment;
+    };
+
+    /// Map the segments in @a directory, from 00000 until the first one
+    /// missing. Frames whose index entry points past the end of their segment,
+    /// i.e. not written yet, are ignored.
+    error_code Open(const std::string &directory);
+
+    size_t size() const {
+      return _frames.size();
+    }
+
+    bool empty() const {
+      return _frames.empty();
+    }
+
+    Frame GetFrame(size_t index) const;
+
+  private:
+
+    class Segment;
+
+    struct FrameEntry {
+      uint32_t segment;
+      uint64_t offset;
+      uint32_t measurements_size;
+      uint32_t images_size;
+    };
+
+    std::vector<std::shared_ptr<const Segment>> _segments;
+
+    std::vector<FrameEntry> _frames;
+  };
+
+} // namespace server
+} // namespace carla
@@ -13,17 +13,15 @@
 
 #include "carla/server/TCPServer.h"
 
+#include <future>
+
 #include <boost/asio/read.hpp>
 #include <boost/asio/write.hpp>
-#include <boost/lambda/bind.hpp>
-#include <boost/lambda/lambda.hpp>
 #include <boost/system/error_code.hpp>
 #include <boost/system/system_error.hpp>
 
 #include "carla/Logging.h"
 
-using boost::lambda::_1;
-using boost::lambda::var;
 using namespace boost::asio::ip;
 
 namespace carla {
@@ -34,127 +32,229 @@ namespace server {
   // ===========================================================================
 
   static inline int GetPort(const tcp::socket &socket) {
-    return (socket.is_open() ? socket.local_endpoint().port() : 0);
+    error_code ec;
+    return (socket.is_open() ? socket.local_endpoint(ec).port() : 0);
   }
 
 #define LOG_PREFIX "tcpserver", GetPort(_socket), ':'
 
-  static void CloseConnection(tcp::acceptor &_acceptor, tcp::socket &_socket) {
+  // ===========================================================================
+  // -- TCPServer private methods ----------------------------------------------
+  // ===========================================================================
+
+  template <typename F>
+  auto TCPServer::Track(F &&handler) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      ++_pending_handlers;
+    }
+    return [this, handler{std::forward<F>(handler)}](auto &&... args) mutable {
+      handler(std::forward<decltype(args)>(args)...);
+      std::lock_guard<std::mutex> lock(_mutex);
+      --_pending_handlers;
+      _condition.notify_all();
+    };
+  }
+
+  template <typename F>
+  void TCPServer::Post(F &&callback) {
+    _strand.post(Track(std::forward<F>(callback)));
+  }
+
+  template <typename F>
+  auto TCPServer::Wrap(F &&handler) {
+    return _strand.wrap(Track([this, handler{std::forward<F>(handler)}](auto &&... args) mutable {
+      // The operation completed, its time-out no longer applies.
+      CancelDeadline();
+      handler(std::forward<decltype(args)>(args)...);
+    }));
+  }
+
+  template <typename Operation>
+  error_code TCPServer::Wait(Operation &&operation) {
+    auto promise = std::make_shared<std::promise<error_code>>();
+    auto result = promise->get_future();
+    operation([promise](const error_code &ec) { promise->set_value(ec); });
+    return result.get();
+  }
+
+  void TCPServer::OpenAcceptor(const uint32_t port) {
+    const tcp::endpoint endpoint(tcp::v4(), port);
+    _acceptor = tcp::acceptor(_executor->service());
+    _acceptor.open(endpoint.protocol());
+    _acceptor.set_option(tcp::acceptor::reuse_address(_options.reuse_address));
+    // The accepted socket inherits the buffer sizes, they need to be set
+    // before listening for the TCP window to be negotiated accordingly.
+    if (_options.send_buffer_size > 0u) {
+      _acceptor.set_option(boost::asio::socket_base::send_buffer_size(_options.send_buffer_size));
+    }
+    if (_options.receive_buffer_size > 0u) {
+      _acceptor.set_option(boost::asio::socket_base::receive_buffer_size(_options.receive_buffer_size));
+    }
+    _acceptor.bind(endpoint);
+    _acceptor.listen();
+  }
+
+  void TCPServer::CloseConnection() {
     log_info(LOG_PREFIX, "disconnecting");
+    error_code ec;
     if (_acceptor.is_open()) {
-      _acceptor.close();
+      _acceptor.close(ec);
     }
     if (_socket.is_open()) {
-      _socket.close();
+      _socket.close(ec);
+    }
+  }
+
+  void TCPServer::ArmDeadline(const time_duration timeout) {
+    _deadline_generation.fetch_add(1u);
+    _deadline.ExpiresFromNow(timeout);
+  }
+
+  void TCPServer::CancelDeadline() {
+    // After cancelling, so an expiry already on its way sees an old
+    // generation.
+    _deadline.Cancel();
+    _deadline_generation.fetch_add(1u);
+  }
+
+  void TCPServer::OnDeadline(const uint64_t generation) {
+    if (_closing || (generation != _deadline_generation.load())) {
+      return;
     }
+    log_info(LOG_PREFIX, "timed out");
+    CloseConnection();
   }
 
   // ===========================================================================
   // -- TCPServer --------------------------------------------------------------
   // ===========================================================================
 
-  TCPServer::TCPServer()
-      : _service(),
-        _acceptor(_service),
-        _socket(_service),
-        _deadline(_service) {
-    // No deadline is required until the first socket operation is started. We
-    // set the deadline to positive infinity so that the actor takes no action
-    // until a specific deadline is set.
-    _deadline.expires_at(boost::posix_time::pos_infin);
-    // Start the persistent actor that checks for deadline expiry.
-    CheckDeadline();
-  }
+  TCPServer::TCPServer() : TCPServer(IOExecutor::GetShared()) {}
+
+  TCPServer::TCPServer(std::shared_ptr<IOExecutor> executor)
+      : _executor(std::move(executor)),
+        _strand(_executor->service()),
+        _acceptor(_executor->service()),
+        _socket(_executor->service()),
+        _deadline(_executor->timer_wheel(), [this]() {
+          const auto generation = _deadline_generation.load();
+          Post([this, generation]() { OnDeadline(generation); });
+        }) {}
 
   TCPServer::~TCPServer() {
-    CloseConnection(_acceptor, _socket);
+    Post([this]() {
+      _closing = true;
+      CloseConnection();
+      CancelDeadline();
+    });
+    // Wait until no handler references this server.
+    std::unique_lock<std::mutex> lock(_mutex);
+    _condition.wait(lock, [this]() { return _pending_handlers == 0u; });
   }
 
   void TCPServer::Disconnect() {
     log_debug(LOG_PREFIX, "request close connection");
-    _service.post([this](){ CloseConnection(_acceptor, _socket); });
+    Post([this]() { CloseConnection(); });
   }
 
-  error_code TCPServer::Connect(uint32_t port, time_duration timeout) {
-    // Set the deadline, it will close the socket when expired.
-    _deadline.expires_from_now(timeout);
-
-    if (_acceptor.is_open()) {
-      log_error(LOG_PREFIX, "already connected");
-      return boost::asio::error::already_connected;
-    }
-
-    // Create an acceptor at the given port.
-    try {
-      _acceptor = tcp::acceptor(_service, tcp::endpoint(tcp::v4(), port));
-    } catch (const boost::system::system_error &exception) {
-      log_error(LOG_PREFIX, "unable to accept connection:", exception.what());
-      return exception.code();
-    }
+  void TCPServer::SetOptions(const TCPOptions &options) {
+    Post([this, options]() { _options = options; });
+  }
 
-    // Asio guarantees that its asynchronous operations will never fail with
-    // would_block, so any other value in ec indicates completion.
-    error_code ec = boost::asio::error::would_block;
+  error_code TCPServer::Connect(uint32_t port, time_duration timeout) {
+    return Wait([&](auto handler) { AsyncConnect(port, timeout, handler); });
+  }
 
-    // Start the asynchronous operation.
-    _acceptor.async_accept(_socket, var(ec) = _1);
+  error_code TCPServer::Read(mutable_buffer buffer, time_duration timeout) {
+    return Wait([&](auto handler) { AsyncRead(buffer, timeout, handler); });
+  }
 
-    // Block until the asynchronous operation has completed.
-    do {
-      _service.run_one();
-    } while (ec == boost::asio::error::would_block);
+  error_code TCPServer::Write(const_buffer buffer, time_duration timeout) {
+    return Write(array_view::make_const(&buffer, 1u), timeout);
+  }
 
-    // Determine whether a connection was successfully established.
-    if (ec) {
-      log_error(LOG_PREFIX, "connection failed:", ec.message());
-      Disconnect(); // Will disconnect on the next run.
-    } else {
-      log_info(LOG_PREFIX, "connected");
-    }
-    return ec;
+  error_code TCPServer::Write(
+      const_array_view<const_buffer> buffers,
+      time_duration timeout) {
+    return Wait([&](auto handler) { AsyncWrite(buffers, timeout, handler); });
   }
 
-  error_code TCPServer::Read(mutable_buffer buffer, time_duration timeout) {
-    log_debug(LOG_PREFIX, "receiving to buffer of length", boost::asio::buffer_size(buffer));
-    _deadline.expires_from_now(timeout);
+  void TCPServer::AsyncConnect(
+      const uint32_t port,
+      const time_duration timeout,
+      completion_handler handler) {
+    Post([=]() {
+      if (_acceptor.is_open()) {
+        log_error(LOG_PREFIX, "already connected");
+        handler(boost::asio::error::already_connected);
+        return;
+      }
 
-    error_code ec = boost::asio::error::would_block;
-    boost::asio::async_read(_socket, boost::asio::buffer(buffer), var(ec) = _1);
+      // Create an acceptor at the given port.
+      try {
+        OpenAcceptor(port);
+      } catch (const boost::system::system_error &exception) {
+        log_error(LOG_PREFIX, "unable to accept connection:", exception.what());
+        handler(exception.code());
+        return;
+      }
 
-    do {
-      _service.run_one();
-    } while (ec == boost::asio::error::would_block);
+      // Set the deadline, it will close the socket when expired.
+      ArmDeadline(timeout);
 
-    if (ec) {
-      log_error(LOG_PREFIX, "error reading message:", ec.message());
-    }
-    return ec;
+      _acceptor.async_accept(_socket, Wrap([=](const error_code &ec) {
+        // Determine whether a connection was successfully established.
+        if (ec) {
+          log_error(LOG_PREFIX, "connection failed:", ec.message());
+          CloseConnection();
+        } else {
+          log_info(LOG_PREFIX, "connected");
+          error_code option_ec;
+          _socket.set_option(tcp::no_delay(_options.no_delay), option_ec);
+          if (option_ec) {
+            log_error(LOG_PREFIX, "unable to set TCP_NODELAY:", option_ec.message());
+          }
+        }
+        handler(ec);
+      }));
+    });
   }
 
-  error_code TCPServer::Write(const_buffer buffer, time_duration timeout) {
-    log_debug(LOG_PREFIX, "sending from buffer of length", boost::asio::buffer_size(buffer));
-    _deadline.expires_from_now(timeout);
-
-    error_code ec = boost::asio::error::would_block;
-    boost::asio::async_write(_socket, boost::asio::buffer(buffer), var(ec) = _1);
-
-    do {
-      _service.run_one();
-    } while (ec == boost::asio::error::would_block);
+  void TCPServer::AsyncRead(
+      const mutable_buffer buffer,
+      const time_duration timeout,
+      completion_handler handler) {
+    log_debug(LOG_PREFIX, "receiving to buffer of length", boost::asio::buffer_size(buffer));
+    Post([=]() {
+      ArmDeadline(timeout);
+      boost::asio::async_read(_socket, boost::asio::buffer(buffer), Wrap([=](const error_code &ec, size_t) {
+        if (ec) {
+          log_error(LOG_PREFIX, "error reading message:", ec.message());
+        }
+        handler(ec);
+      }));
+    });
+  }
 
-    if (ec) {
-      log_error(LOG_PREFIX, "error writing message:", ec.message());
-    }
-    return ec;
+  void TCPServer::AsyncWrite(
+      const const_array_view<const_buffer> buffers,
+      const time_duration timeout,
+      completion_handler handler) {
+    log_debug(LOG_PREFIX, "sending from", buffers.size(), "buffers of total length", boost::asio::buffer_size(buffers));
+    Post([=]() {
+      ArmDeadline(timeout);
+      boost::asio::async_write(_socket, buffers, Wrap([=](const error_code &ec, size_t) {
+        if (ec) {
+          log_error(LOG_PREFIX, "error writing message:", ec.message());
+        }
+        handler(ec);
+      }));
+    });
   }
 
-  void TCPServer::CheckDeadline() {
-    if (_deadline.expires_at() <= boost::asio::deadline_timer::traits_type::now()) {
-      log_info(LOG_PREFIX, "timed out");
-      CloseConnection(_acceptor, _socket);
-      _deadline.expires_at(boost::posix_time::pos_infin);
-    }
-    _deadline.async_wait(boost::lambda::bind(&TCPServer::CheckDeadline, this));
+  void TCPServer::AsyncPost(std::function<void()> job) {
+    Post(std::move(job));
   }
 
 #undef LOG_PREFIX
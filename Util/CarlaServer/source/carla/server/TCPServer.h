@@ -6,45 +6,159 @@
 
 #pragma once
 
-#include <boost/asio/deadline_timer.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/strand.hpp>
 
+#include "carla/ArrayView.h"
 #include "carla/NonCopyable.h"
+#include "carla/server/IOExecutor.h"
 #include "carla/server/ServerTraits.h"
+#include "carla/server/TimerWheel.h"
 
 namespace carla {
 namespace server {
 
-  /// Basic blocking TCP server with time-out. It is safe to call disconnect
-  /// in a separate thread.
+  /// Options of the sockets of a TCPServer.
+  struct TCPOptions {
+    /// Disable Nagle's algorithm (TCP_NODELAY).
+    bool no_delay = true;
+
+    /// Allow binding the port while a previous connection is in TIME_WAIT
+    /// (SO_REUSEADDR).
+    bool reuse_address = true;
+
+    /// Size in bytes of the socket send buffer (SO_SNDBUF), zero for the
+    /// default of the system.
+    uint32_t send_buffer_size = 0u;
+
+    /// Size in bytes of the socket receive buffer (SO_RCVBUF), zero for the
+    /// default of the system.
+    uint32_t receive_buffer_size = 0u;
+  };
+
+  /// TCP server with time-out. It is safe to call disconnect in a separate
+  /// thread.
+  ///
+  /// The socket operations run in an IOExecutor, by default the one shared by
+  /// every server in the process, serialized by a strand per server. The
+  /// asynchronous functions return immediately and call the given handler on
+  /// completion, the others block the calling thread until the operation
+  /// completes. The time-out of each operation is a deadline in the
+  /// executor's timer wheel, with the resolution of its tick. The AsyncServer
+  /// uses only the asynchronous functions, see EncoderServer.
   class TCPServer : private NonCopyable {
   public:
 
+    /// Called on completion of an asynchronous operation, inside one of the
+    /// executor's threads. It should not block.
+    using completion_handler = std::function<void(const error_code &)>;
+
     TCPServer();
 
+    explicit TCPServer(std::shared_ptr<IOExecutor> executor);
+
     ~TCPServer();
 
     /// Posts a job to disconnect the server.
     void Disconnect();
 
+    /// Posts a job to set the socket options, applied on the next connection.
+    void SetOptions(const TCPOptions &options);
+
     error_code Connect(uint32_t port, time_duration timeout);
 
     error_code Read(mutable_buffer buffer, time_duration timeout);
 
     error_code Write(const_buffer buffer, time_duration timeout);
 
+    /// Write a sequence of buffers in a single (vectored) write operation, the
+    /// buffers are sent in order without being concatenated.
+    error_code Write(const_array_view<const_buffer> buffers, time_duration timeout);
+
+    void AsyncConnect(uint32_t port, time_duration timeout, completion_handler handler);
+
+    /// @warning @a buffer must be kept alive until @a handler is called.
+    void AsyncRead(mutable_buffer buffer, time_duration timeout, completion_handler handler);
+
+    /// @warning @a buffers, and the memory they point to, must be kept alive
+    /// until @a handler is called.
+    void AsyncWrite(
+        const_array_view<const_buffer> buffers,
+        time_duration timeout,
+        completion_handler handler);
+
+    /// Run @a job inside the executor, serialized with the completion
+    /// handlers of this server.
+    void AsyncPost(std::function<void()> job);
+
   private:
 
-    void CheckDeadline();
+    /// Start @a operation passing it a completion handler, and block until
+    /// that handler is called.
+    template <typename Operation>
+    static error_code Wait(Operation &&operation);
+
+    /// Post @a callback to the strand.
+    template <typename F>
+    void Post(F &&callback);
 
-    boost::asio::io_service _service;
+    /// Wrap a completion handler to run in the strand, cancelling the
+    /// deadline of the operation before.
+    template <typename F>
+    auto Wrap(F &&handler);
+
+    /// Keep count of the handlers pending so we can wait for them on
+    /// destruction.
+    template <typename F>
+    auto Track(F &&handler);
+
+    /// Arm the deadline of a new operation. Strand only.
+    void ArmDeadline(time_duration timeout);
+
+    /// Disarm the deadline of the operation completed. Strand only.
+    void CancelDeadline();
+
+    /// Close the connection unless the deadline was re-armed or cancelled
+    /// since it expired with @a generation. A deadline expiring right as its
+    /// operation completes posts this before the completion handler cancels
+    /// it.
+    void OnDeadline(uint64_t generation);
+
+    /// Open, configure, and bind the acceptor. Throws on failure.
+    void OpenAcceptor(uint32_t port);
+
+    void CloseConnection();
+
+    const std::shared_ptr<IOExecutor> _executor;
+
+    boost::asio::io_service::strand _strand;
 
     boost::asio::ip::tcp::acceptor _acceptor;
 
     boost::asio::ip::tcp::socket _socket;
 
-    boost::asio::deadline_timer _deadline;
+    TCPOptions _options;
+
+    std::mutex _mutex;
+
+    std::condition_variable _condition;
+
+    uint32_t _pending_handlers = 0u;
+
+    bool _closing = false;
+
+    /// Incremented each time the deadline is armed or cancelled.
+    std::atomic<uint64_t> _deadline_generation{0u};
+
+    /// Declared last, no callback is called once it is destroyed.
+    TimerWheel::Deadline _deadline;
   };
 
 } // namespace server
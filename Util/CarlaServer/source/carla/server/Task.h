@@ -6,8 +6,15 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "carla/NonCopyable.h"
 #include "carla/server/DoubleBuffer.h"
 #include "carla/server/Future.h"
+#include "carla/server/RingBuffer.h"
 #include "carla/server/ServerTraits.h"
 
 namespace carla {
@@ -141,7 +148,130 @@ namespace detail {
   // -- WriteTask --------------------------------------------------------------
   // ===========================================================================
 
-  /// Single write task.
+namespace detail {
+
+  /// A message to be set by one thread and waited by another. Waiting blocks
+  /// on a condition variable until the message is set or cancelled, or calls
+  /// back then, see AsyncWait.
+  template <typename T>
+  class PendingMessage : private NonCopyable {
+  public:
+
+    template <typename M>
+    void Set(M &&message) {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _message = std::forward<M>(message);
+        _ready = true;
+      }
+      _condition.notify_all();
+      CallReadyCallback();
+    }
+
+    /// Wake up any waiting thread, a message already set can still be
+    /// retrieved.
+    void Cancel() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cancelled = true;
+      }
+      _condition.notify_all();
+      CallReadyCallback();
+    }
+
+    /// Calls @a callback once the message is set or cancelled, right away if
+    /// it already is. The callback is called in the thread setting or
+    /// cancelling the message and should not block, Wait does not block
+    /// then.
+    void AsyncWait(std::function<void()> callback) {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_ready && !_cancelled) {
+          _callback = std::move(callback);
+          return;
+        }
+      }
+      callback();
+    }
+
+    /// Blocks until the message is set or cancelled. Returns false if
+    /// cancelled before setting the message.
+    bool Wait(T &message) {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _condition.wait(lock, [this]() { return _ready || _cancelled; });
+      if (!_ready) {
+        return false;
+      }
+      message = std::move(_message);
+      return true;
+    }
+
+  private:
+
+    void CallReadyCallback() {
+      std::function<void()> callback;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        callback = std::move(_callback);
+        _callback = nullptr;
+      }
+      if (callback) {
+        callback();
+      }
+    }
+
+    std::mutex _mutex;
+
+    std::condition_variable _condition;
+
+    std::function<void()> _callback;
+
+    T _message;
+
+    bool _ready = false;
+
+    bool _cancelled = false;
+  };
+
+  /// Owns a shared PendingMessage, cancelling it when no longer owned (nobody
+  /// is going to set that message anymore).
+  template <typename T>
+  class PendingMessageHandle {
+  public:
+
+    PendingMessageHandle() : _message(std::make_shared<PendingMessage<T>>()) {}
+
+    PendingMessageHandle(PendingMessageHandle &&rhs) = default;
+
+    PendingMessageHandle &operator=(PendingMessageHandle &&rhs) {
+      Cancel();
+      _message = std::move(rhs._message);
+      return *this;
+    }
+
+    ~PendingMessageHandle() {
+      Cancel();
+    }
+
+    const std::shared_ptr<PendingMessage<T>> &get() const {
+      return _message;
+    }
+
+  private:
+
+    void Cancel() {
+      if (_message != nullptr) {
+        _message->Cancel();
+      }
+    }
+
+    std::shared_ptr<PendingMessage<T>> _message;
+  };
+
+} // namespace detail
+
+  /// Single write task. The write is scheduled when the task is executed, and
+  /// performed as soon as the message is set (waiting for it does not poll).
   template <typename T>
   class WriteTask : public detail::Task<error_code> {
   public:
@@ -152,16 +282,16 @@ namespace detail {
 
     template <typename M>
     void set_message(M &&message) {
-      _message.set_value(std::forward<M>(message));
+      _message.get()->Set(std::forward<M>(message));
     }
 
-    std::future<T> get_future_message() {
-      return _message.get_future();
+    const std::shared_ptr<detail::PendingMessage<T>> &get_pending_message() const {
+      return _message.get();
     }
 
   private:
 
-    std::promise<T> _message;
+    detail::PendingMessageHandle<T> _message;
   };
 
   // ===========================================================================
@@ -171,27 +301,30 @@ namespace detail {
 namespace detail {
 
   /// Base class for tasks that continuously read/write from/to a buffer.
-  template <typename T>
+  template <typename Buffer>
   class StreamTask : public detail::Task<error_code> {
   public:
 
-    StreamTask() : _buffer(std::make_shared<DoubleBuffer<T>>()) {}
+    using buffer_type = Buffer;
+
+    StreamTask() : _buffer(std::make_shared<Buffer>()) {}
 
-    explicit StreamTask(time_duration timeout)
+    template <typename... Args>
+    explicit StreamTask(time_duration timeout, Args &&... args)
         : Task(timeout),
-          _buffer(std::make_shared<DoubleBuffer<T>>()) {}
+          _buffer(std::make_shared<Buffer>(std::forward<Args>(args)...)) {}
 
     ~StreamTask() {
       _buffer->set_done();
     }
 
-    std::shared_ptr<DoubleBuffer<T>> buffer() {
+    std::shared_ptr<Buffer> buffer() {
       return _buffer;
     }
 
   private:
 
-    const std::shared_ptr<DoubleBuffer<T>> _buffer;
+    const std::shared_ptr<Buffer> _buffer;
   };
 
 } // namespace detail
@@ -202,28 +335,33 @@ namespace detail {
 
   /// Continuously read from a server and write to the buffer.
   template <typename T>
-  class StreamReadTask : public detail::StreamTask<T> {
+  class StreamReadTask : public detail::StreamTask<DoubleBuffer<T>> {
   public:
 
     StreamReadTask() = default;
 
     explicit StreamReadTask(time_duration timeout)
-        : detail::StreamTask<T>(timeout) {}
+        : detail::StreamTask<DoubleBuffer<T>>(timeout) {}
   };
 
   // ===========================================================================
   // -- StreamWriteTask --------------------------------------------------------
   // ===========================================================================
 
-  /// Continuously read from the buffer and write to a server.
+  /// Continuously read from the buffer and write to a server. Values are
+  /// written into a RingBuffer, so the number of values pending to be sent and
+  /// what happens when the server falls behind can be configured.
   template <typename T>
-  class StreamWriteTask : public detail::StreamTask<T> {
+  class StreamWriteTask : public detail::StreamTask<RingBuffer<T>> {
   public:
 
     StreamWriteTask() = default;
 
-    explicit StreamWriteTask(time_duration timeout)
-        : detail::StreamTask<T>(timeout) {}
+    explicit StreamWriteTask(
+        time_duration timeout,
+        uint32_t number_of_slots = 2u,
+        RingBufferPolicy policy = RingBufferPolicy::DropOldest)
+        : detail::StreamTask<RingBuffer<T>>(timeout, number_of_slots, policy) {}
   };
 
 } // namespace server
@@ -10,6 +10,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 #include "carla/NonCopyable.h"
 
@@ -44,8 +45,16 @@ namespace server {
     }
 
     void Push(T &&new_value) {
-      std::lock_guard<std::mutex> lock(_mutex);
-      _queue.push(std::forward<T>(new_value));
+      Emplace(std::move(new_value));
+    }
+
+    /// Constructs the new value in place.
+    template <typename... Args>
+    void Emplace(Args &&... args) {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.emplace(std::forward<Args>(args)...);
+      }
       _condition.notify_one();
     }
 
@@ -55,7 +64,7 @@ namespace server {
       if (_queue.empty()) {
         return false;
       }
-      value = _queue.front();
+      value = std::move(_queue.front());
       _queue.pop();
       return true;
     }
@@ -65,13 +74,43 @@ namespace server {
       if (_queue.empty()) {
         return false;
       }
-      value = _queue.front();
+      value = std::move(_queue.front());
       _queue.pop();
       return true;
     }
 
+    /// Blocks until there is some value in the queue, or the queue is marked
+    /// as done, then moves every value at the end of @a values in order.
+    ///
+    /// Returns false if nothing was popped.
+    bool WaitAndPopAll(std::vector<T> &values) {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _condition.wait(lock, [this] { return _done || !_queue.empty(); });
+      return PopAll(values, lock);
+    }
+
+    /// Moves every value in the queue at the end of @a values in order.
+    ///
+    /// Returns false if nothing was popped.
+    bool PopAll(std::vector<T> &values) {
+      std::unique_lock<std::mutex> lock(_mutex);
+      return PopAll(values, lock);
+    }
+
   private:
 
+    bool PopAll(std::vector<T> &values, std::unique_lock<std::mutex> &) {
+      if (_queue.empty()) {
+        return false;
+      }
+      values.reserve(values.size() + _queue.size());
+      while (!_queue.empty()) {
+        values.emplace_back(std::move(_queue.front()));
+        _queue.pop();
+      }
+      return true;
+    }
+
     mutable std::mutex _mutex;
 
     std::queue<T> _queue;
@@ -0,0 +1,192 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "carla/server/TimerWheel.h"
+
+#include <algorithm>
+
+namespace carla {
+namespace server {
+
+  // ===========================================================================
+  // -- Static local methods ---------------------------------------------------
+  // ===========================================================================
+
+  /// Number of whole ticks covering @a timeout, rounding up.
+  static uint64_t GetNumberOfTicks(
+      const time_duration &timeout,
+      const TimerWheel::clock::duration tick) {
+    if (timeout.is_negative()) {
+      return 0u;
+    }
+    const auto us = std::chrono::microseconds(timeout.total_microseconds());
+    const auto duration = std::chrono::duration_cast<TimerWheel::clock::duration>(us);
+    return static_cast<uint64_t>((duration + tick - TimerWheel::clock::duration(1)) / tick);
+  }
+
+  // ===========================================================================
+  // -- TimerWheel -------------------------------------------------------------
+  // ===========================================================================
+
+  TimerWheel::TimerWheel(
+      boost::asio::io_service &service,
+      const clock::duration tick)
+    : _tick(std::max(tick, clock::duration(1))),
+      _start(clock::now()),
+      _timer(service) {
+    for (auto &wheel : _wheels) {
+      wheel.fill(nullptr);
+    }
+  }
+
+  TimerWheel::~TimerWheel() {
+    Stop();
+  }
+
+  void TimerWheel::Stop() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopped = true;
+    error_code ec;
+    _timer.cancel(ec);
+  }
+
+  uint64_t TimerWheel::CurrentTick() const {
+    return static_cast<uint64_t>((clock::now() - _start) / _tick);
+  }
+
+  void TimerWheel::Arm(Deadline &deadline, const time_duration timeout) {
+    if (timeout.is_pos_infinity()) {
+      Cancel(deadline);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (deadline._armed) {
+      Remove(deadline);
+    } else {
+      ++_size;
+      deadline._armed = true;
+    }
+    const auto now = CurrentTick();
+    if (!_timer_running) {
+      // The wheels are empty, start counting from now.
+      _next_tick = now;
+    }
+    // Plus one since we are already somewhere within the current tick, so it
+    // never expires early.
+    deadline._expiry = std::max(now + GetNumberOfTicks(timeout, _tick) + 1u, _next_tick);
+    Insert(deadline);
+    if (!_timer_running && !_stopped) {
+      ScheduleTimer();
+    }
+  }
+
+  void TimerWheel::Cancel(Deadline &deadline) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (deadline._armed) {
+      Remove(deadline);
+      deadline._armed = false;
+      --_size;
+    }
+  }
+
+  void TimerWheel::Insert(Deadline &deadline) {
+    const auto delta = deadline._expiry - _next_tick;
+    uint32_t wheel = 0u;
+    while ((wheel + 1u < NumberOfWheels) && (delta >> (SlotBits * (wheel + 1u))) != 0u) {
+      ++wheel;
+    }
+    // Too far to fit in the last wheel, wait in its furthest slot and be
+    // inserted again when it comes down.
+    const uint64_t max_delta = (uint64_t(1u) << (SlotBits * NumberOfWheels)) - 1u;
+    const auto expiry = _next_tick + std::min(delta, max_delta);
+    auto &slot = _wheels[wheel][(expiry >> (SlotBits * wheel)) & (SlotsPerWheel - 1u)];
+    deadline._slot = &slot;
+    deadline._previous = nullptr;
+    deadline._next = slot;
+    if (slot != nullptr) {
+      slot->_previous = &deadline;
+    }
+    slot = &deadline;
+  }
+
+  void TimerWheel::Remove(Deadline &deadline) {
+    if (deadline._previous != nullptr) {
+      deadline._previous->_next = deadline._next;
+    } else {
+      *deadline._slot = deadline._next;
+    }
+    if (deadline._next != nullptr) {
+      deadline._next->_previous = deadline._previous;
+    }
+    deadline._previous = nullptr;
+    deadline._next = nullptr;
+    deadline._slot = nullptr;
+  }
+
+  uint32_t TimerWheel::Cascade(const uint32_t wheel) {
+    const auto index = static_cast<uint32_t>((_next_tick >> (SlotBits * wheel)) & (SlotsPerWheel - 1u));
+    auto *deadline = _wheels[wheel][index];
+    _wheels[wheel][index] = nullptr;
+    while (deadline != nullptr) {
+      auto *next = deadline->_next;
+      Insert(*deadline);
+      deadline = next;
+    }
+    return index;
+  }
+
+  void TimerWheel::ProcessTick() {
+    const auto index = static_cast<uint32_t>(_next_tick & (SlotsPerWheel - 1u));
+    if (index == 0u) {
+      // A turn of the first wheel is complete, bring down the next slot of the
+      // wheels above, each one only when the wheel below completed a turn too.
+      for (auto wheel = 1u; (wheel < NumberOfWheels) && (Cascade(wheel) == 0u); ++wheel);
+    }
+    const auto tick = _next_tick++;
+    auto *deadline = _wheels[0u][index];
+    _wheels[0u][index] = nullptr;
+    while (deadline != nullptr) {
+      auto *next = deadline->_next;
+      if (deadline->_expiry <= tick) {
+        deadline->_previous = nullptr;
+        deadline->_next = nullptr;
+        deadline->_slot = nullptr;
+        deadline->_armed = false;
+        --_size;
+        deadline->_callback();
+      } else {
+        Insert(*deadline);
+      }
+      deadline = next;
+    }
+  }
+
+  void TimerWheel::ScheduleTimer() {
+    _timer_running = true;
+    _timer.expires_at(_start + _tick * _next_tick);
+    _timer.async_wait([this](const error_code &ec) { OnTimer(ec); });
+  }
+
+  void TimerWheel::OnTimer(const error_code &ec) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (ec == boost::asio::error::operation_aborted || _stopped) {
+      _timer_running = false;
+      return;
+    }
+    const auto now = CurrentTick();
+    while ((_size > 0u) && (_next_tick <= now)) {
+      ProcessTick();
+    }
+    if (_size == 0u) {
+      // Nothing to wait for, the next deadline armed starts the timer again.
+      _timer_running = false;
+    } else {
+      ScheduleTimer();
+    }
+  }
+
+} // namespace server
+} // namespace carla
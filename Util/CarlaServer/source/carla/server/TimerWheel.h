@@ -0,0 +1,169 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "carla/NonCopyable.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// Deadlines of many connections checked by a single timer with the coarse
+  /// resolution of a tick. Arming, re-arming and cancelling a deadline are
+  /// O(1) and make no system call; the timer wakes up once per tick while
+  /// any deadline is armed.
+  ///
+  /// Hierarchical: the deadlines within 64 ticks wait in the slots of the
+  /// first wheel, one per tick, the later ones in the slots of the next
+  /// wheels, each slot spanning a whole turn of the wheel below, and move
+  /// down as their time gets closer.
+  class TimerWheel : private NonCopyable {
+  public:
+
+    using clock = std::chrono::steady_clock;
+
+    /// A deadline in a wheel, calls its callback once it expires unless
+    /// re-armed or cancelled before. Thread-safe.
+    class Deadline : private NonCopyable {
+    public:
+
+      /// @a callback is called inside one of the threads of the service with
+      /// the wheel locked, it must not block nor arm or cancel deadlines;
+      /// post the work somewhere else instead.
+      Deadline(TimerWheel &wheel, std::function<void()> callback)
+        : _wheel(wheel),
+          _callback(std::move(callback)) {}
+
+      ~Deadline() {
+        Cancel();
+      }
+
+      /// Expire after @a timeout, or at the tick after if already passed.
+      /// An infinite @a timeout cancels the deadline.
+      void ExpiresFromNow(time_duration timeout) {
+        _wheel.Arm(*this, timeout);
+      }
+
+      /// Once it returns, the callback is not called until armed again.
+      void Cancel() {
+        _wheel.Cancel(*this);
+      }
+
+      bool IsArmed() const {
+        std::lock_guard<std::mutex> lock(_wheel._mutex);
+        return _armed;
+      }
+
+    private:
+
+      friend class TimerWheel;
+
+      TimerWheel &_wheel;
+
+      const std::function<void()> _callback;
+
+      /// @name Guarded by the mutex of the wheel
+      /// @{
+
+      Deadline *_previous = nullptr;
+
+      Deadline *_next = nullptr;
+
+      Deadline **_slot = nullptr;
+
+      uint64_t _expiry = 0u;
+
+      bool _armed = false;
+
+      /// @}
+    };
+
+    /// The timer runs in @a service, which must be stopped, or run out of
+    /// work after Stop(), before the wheel is destroyed.
+    explicit TimerWheel(
+        boost::asio::io_service &service,
+        clock::duration tick = std::chrono::milliseconds(10));
+
+    ~TimerWheel();
+
+    /// Stops the timer, the deadlines still armed never expire. Called by
+    /// the executor before waiting for its threads.
+    void Stop();
+
+    clock::duration tick() const {
+      return _tick;
+    }
+
+    /// Number of deadlines armed.
+    size_t size() const {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _size;
+    }
+
+  private:
+
+    static constexpr uint32_t SlotBits = 6u;
+
+    static constexpr uint32_t SlotsPerWheel = 1u << SlotBits;
+
+    static constexpr uint32_t NumberOfWheels = 4u;
+
+    /// Intrusive list of deadlines, the slot holds a pointer to the first.
+    using slot_type = Deadline *;
+
+    void Arm(Deadline &deadline, time_duration timeout);
+
+    void Cancel(Deadline &deadline);
+
+    uint64_t CurrentTick() const;
+
+    void Insert(Deadline &deadline);
+
+    void Remove(Deadline &deadline);
+
+    /// Moves the deadlines of the current slot of @a wheel to the wheels
+    /// below, returns the index of that slot.
+    uint32_t Cascade(uint32_t wheel);
+
+    /// Expires the deadlines of the tick _next_tick and advances it.
+    void ProcessTick();
+
+    void ScheduleTimer();
+
+    void OnTimer(const error_code &ec);
+
+    const clock::duration _tick;
+
+    const clock::time_point _start;
+
+    boost::asio::steady_timer _timer;
+
+    mutable std::mutex _mutex;
+
+    std::array<std::array<slot_type, SlotsPerWheel>, NumberOfWheels> _wheels;
+
+    /// Next tick to process, every deadline before it has expired.
+    uint64_t _next_tick = 0u;
+
+    size_t _size = 0u;
+
+    bool _timer_running = false;
+
+    bool _stopped = false;
+  };
+
+} // namespace server
+} // namespace carla
@@ -8,6 +8,13 @@
 
 #include "carla/Debug.h"
 #include "carla/server/AgentServer.h"
+#include "carla/server/MeasurementsPublisher.h"
+#include "carla/server/MemoryAccounting.h"
+#include "carla/server/MetricsServer.h"
+#include "carla/server/Protobuf.h"
+#include "carla/server/RoadMapEncoding.h"
+#include "carla/server/SharedMemoryImages.h"
+#include "carla/server/StreamRecorder.h"
 
 namespace carla {
 namespace server {
@@ -18,7 +25,7 @@ namespace server {
 
   static bool IsPortValid(const uint32_t port) {
     constexpr uint32_t MIN = 1023u;
-    return (port > MIN) && (port + 1u > MIN) && (port + 2u > MIN);
+    return (port > MIN) && (port + 1u > MIN) && (port + 2u > MIN) && (port + 3u > MIN);
   }
 
   static std::future<error_code> GetInvalidPortResult(const uint32_t port) {
@@ -64,7 +71,11 @@ namespace server {
       : _encoder(),
         _world_server(_encoder) {}
 
-  WorldServer::~WorldServer() {}
+  WorldServer::~WorldServer() {
+    if (_road_map_data != nullptr) {
+      MemoryAccounting::Remove(MemorySubsystem::EncodedRoadMap, _road_map_data->size());
+    }
+  }
 
   std::future<error_code> WorldServer::Connect(
       const uint32_t port,
@@ -83,12 +94,162 @@ namespace server {
       carla_request_new_episode &request_new_episode,
       const timeout_t timeout) {
     auto ec = carla::server::TryRead(_protocol.request_new_episode, _new_episode_data, timeout);
+    if (!ec && _new_episode_data.snapshot) {
+      log_debug("world snapshot requested");
+      _snapshot_request = std::move(_new_episode_data);
+      _is_snapshot_request_unread = true;
+      // Nothing else is read until the snapshot is written, and the current
+      // episode goes on.
+      _protocol.world_snapshot = WriteTask<WorldSnapshot>(_timeout);
+      _world_server.Execute(_protocol.world_snapshot);
+      _world_server.Execute(_protocol.request_new_episode);
+      return errc::try_again();
+    }
+    if (!ec && _new_episode_data.route) {
+      log_debug("route requested");
+      _route_request = _new_episode_data.route_request;
+      _is_route_request_unread = true;
+      // Same as a snapshot, the current episode goes on.
+      _protocol.route = WriteTask<Route>(_timeout);
+      _world_server.Execute(_protocol.route);
+      _world_server.Execute(_protocol.request_new_episode);
+      return errc::try_again();
+    }
+    if (!ec && _new_episode_data.road_map) {
+      log_debug("road map requested");
+      _road_map_request = _new_episode_data.road_map_request;
+      _is_road_map_request_unread = true;
+      _protocol.road_map = WriteTask<RoadMap>(_timeout);
+      _world_server.Execute(_protocol.road_map);
+      _world_server.Execute(_protocol.request_new_episode);
+      return errc::try_again();
+    }
+    while (!ec && _new_episode_data.queue) {
+      log_info("queued the next episode");
+      _queued_episode = std::move(_new_episode_data);
+      _is_queued_episode_unread = true;
+      // The current episode goes on, wait for the request that starts it.
+      _world_server.Execute(_protocol.request_new_episode);
+      ec = carla::server::TryRead(_protocol.request_new_episode, _new_episode_data, timeout);
+    }
     if (!ec) {
+      _client_capabilities = _new_episode_data.capabilities;
+      ApplyCapabilities();
+      if ((_new_episode_data.values.ini_file_length == 0u) && (_queued_episode.data != nullptr)) {
+        log_debug("starting the queued episode");
+        _new_episode_data = std::move(_queued_episode);
+      }
+      _queued_episode = RequestNewEpisode();
+      _is_queued_episode_unread = false;
       request_new_episode = _new_episode_data.values;
+      ExecuteEpisodeSetUp();
     }
     return ec;
   }
 
+  error_code WorldServer::TryReadQueued(carla_request_new_episode &queued_episode) {
+    if (!_is_queued_episode_unread) {
+      return errc::try_again();
+    }
+    _is_queued_episode_unread = false;
+    queued_episode = _queued_episode.values;
+    return errc::success();
+  }
+
+  error_code WorldServer::TryReadSnapshotRequest(carla_world_snapshot_request &request) {
+    if (!_is_snapshot_request_unread) {
+      return errc::try_again();
+    }
+    _is_snapshot_request_unread = false;
+    const auto &data = _snapshot_request.restore_snapshot;
+    request.restore_data = (data.empty() ? nullptr : data.data());
+    request.restore_data_length = static_cast<uint32_t>(data.size());
+    return errc::success();
+  }
+
+  std::future<error_code> WorldServer::Write(const carla_world_snapshot &snapshot) {
+    if (!_protocol.world_snapshot.valid()) {
+      log_error("no world snapshot request to answer");
+      std::promise<error_code> promise;
+      promise.set_value(errc::invalid_argument());
+      return promise.get_future();
+    }
+    WorldSnapshot message;
+    message.success = snapshot.success;
+    if ((snapshot.data != nullptr) && (snapshot.data_length > 0u)) {
+      message.data.assign(static_cast<const char *>(snapshot.data), snapshot.data_length);
+    }
+    return carla::server::Write(_protocol.world_snapshot, message);
+  }
+
+  error_code WorldServer::TryReadRouteRequest(carla_route_request &request) {
+    if (!_is_route_request_unread) {
+      return errc::try_again();
+    }
+    _is_route_request_unread = false;
+    request = _route_request;
+    return errc::success();
+  }
+
+  std::future<error_code> WorldServer::Write(const carla_route &route) {
+    if (!_protocol.route.valid()) {
+      log_error("no route request to answer");
+      std::promise<error_code> promise;
+      promise.set_value(errc::invalid_argument());
+      return promise.get_future();
+    }
+    Route message;
+    message.success = route.success;
+    if (route.waypoints != nullptr) {
+      message.waypoints.assign(route.waypoints, route.waypoints + route.number_of_waypoints);
+    }
+    if (route.lanes != nullptr) {
+      message.lanes.assign(route.lanes, route.lanes + route.number_of_lanes);
+    }
+    message.length = route.length;
+    return carla::server::Write(_protocol.route, message);
+  }
+
+  error_code WorldServer::TryReadRoadMapRequest(carla_road_map_request &request) {
+    if (!_is_road_map_request_unread) {
+      return errc::try_again();
+    }
+    _is_road_map_request_unread = false;
+    request = _road_map_request;
+    return errc::success();
+  }
+
+  std::future<error_code> WorldServer::Write(const carla_road_map &road_map) {
+    if (!_protocol.road_map.valid()) {
+      log_error("no road map request to answer");
+      std::promise<error_code> promise;
+      promise.set_value(errc::invalid_argument());
+      return promise.get_future();
+    }
+    RoadMap message;
+    message.success = road_map.success &&
+        (road_map.pixels != nullptr) &&
+        (road_map.width > 0u) &&
+        (road_map.height > 0u);
+    if (message.success) {
+      message.hash = RoadMapEncoding::Hash(road_map);
+      if ((message.hash != _road_map_hash) || (_road_map_data == nullptr)) {
+        log_info("encoding road map of", road_map.width, "x", road_map.height, "pixels");
+        if (_road_map_data != nullptr) {
+          MemoryAccounting::Remove(MemorySubsystem::EncodedRoadMap, _road_map_data->size());
+        }
+        _road_map_data = std::make_shared<const std::string>(
+            RoadMapEncoding::Encode(road_map, message.hash));
+        MemoryAccounting::Add(MemorySubsystem::EncodedRoadMap, _road_map_data->size());
+        _road_map_hash = message.hash;
+      }
+      if (message.hash != _road_map_request.cached_hash) {
+        message.data = _road_map_data;
+      }
+    }
+    return carla::server::Write(_protocol.road_map, message);
+  }
+
   std::future<error_code> WorldServer::Write(
       const carla_scene_description &scene_description) {
     return carla::server::Write(_protocol.scene_description, scene_description);
@@ -102,18 +263,237 @@ namespace server {
 
   std::future<error_code> WorldServer::Write(
       const carla_episode_ready &episode_ready) {
-    return carla::server::Write(_protocol.episode_ready, episode_ready);
+    EpisodeReady message;
+    message.values = episode_ready;
+    message.episode_id = (_accept_any_episode ? 0u : _episode_id);
+    message.persistent_agent_connections = _persistent_agent_connections;
+    message.agent_connections_reused = _agent_connections_reused;
+    message.number_of_agents = _number_of_agents;
+    message.separate_images_stream =
+        (_agent_server != nullptr) && _agent_server->HasSeparateImagesStream();
+    auto &capabilities = message.capabilities;
+    if (_encoder.IsPackingAgents()) {
+      capabilities.Add(Capability::PackedAgents);
+      switch (_encoder.GetAgentsEncoding()) {
+        case AgentsEncoding::Quantized:
+        case AgentsEncoding::QuantizedDelta:
+          capabilities.Add(Capability::QuantizedAgents);
+          break;
+        case AgentsEncoding::HalfFloat:
+          capabilities.Add(Capability::HalfFloatAgents);
+          break;
+        case AgentsEncoding::Float32:
+          break;
+      }
+    }
+    if (_encoder.IsDeltaAgents()) {
+      capabilities.Add(Capability::AgentsDelta);
+    }
+    if (_encoder.IsCompressingImages()) {
+      capabilities.Add(Capability::CompressedImages);
+    }
+    if (_encoder.IsCompressingImages() && _encoder.IsDeltaImages()) {
+      capabilities.Add(Capability::DeltaImages);
+    }
+    if (_client_capabilities.Has(Capability::BinaryControl)) {
+      capabilities.Add(Capability::BinaryControl);
+    }
+    if (_encoder.IsFlatMeasurements()) {
+      capabilities.Add(Capability::FlatMeasurements);
+    }
+    if (message.separate_images_stream) {
+      capabilities.Add(Capability::SeparateImagesStream);
+    }
+    if (_encoder.GetSharedMemoryImages() != nullptr) {
+      capabilities.Add(Capability::SharedMemoryImages);
+    }
+    if (IsGpuSharedImagesEnabled()) {
+      capabilities.Add(Capability::GpuSharedImages);
+    }
+    return carla::server::Write(_protocol.episode_ready, message);
+  }
+
+  void WorldServer::ApplyCapabilities() {
+    const auto &client = _client_capabilities;
+    const bool packed_agents = _packed_agents_enabled && client.Has(Capability::PackedAgents);
+    const bool delta_agents = _delta_agents_enabled && client.Has(Capability::AgentsDelta);
+    const bool compressed_images = client.Has(Capability::CompressedImages);
+    const bool delta_images = client.Has(Capability::DeltaImages);
+    const bool flat_measurements = client.Has(Capability::FlatMeasurements);
+    // Clients that cannot decode the encoding get the float32 one.
+    auto agents_encoding = _agents_encoding;
+    if ((((agents_encoding == AgentsEncoding::Quantized) ||
+          (agents_encoding == AgentsEncoding::QuantizedDelta)) &&
+         !client.Has(Capability::QuantizedAgents)) ||
+        ((agents_encoding == AgentsEncoding::HalfFloat) &&
+         !client.Has(Capability::HalfFloatAgents))) {
+      agents_encoding = AgentsEncoding::Float32;
+    }
+    _encoder.SetPackedAgents(packed_agents);
+    _encoder.SetAgentsEncoding(agents_encoding);
+    _encoder.SetDeltaAgents(delta_agents, _delta_threshold);
+    _encoder.SetCompressedImages(compressed_images);
+    _encoder.SetDeltaImages(delta_images);
+    _encoder.SetFlatMeasurements(flat_measurements);
+    for (auto &encoder : _secondary_encoders) {
+      encoder->SetPackedAgents(packed_agents);
+      encoder->SetAgentsEncoding(agents_encoding);
+      encoder->SetDeltaAgents(delta_agents, _delta_threshold);
+      encoder->SetCompressedImages(compressed_images);
+      encoder->SetDeltaImages(delta_images);
+      encoder->SetFlatMeasurements(flat_measurements);
+    }
+    const bool enable =
+        _shared_memory_images_enabled && client.Has(Capability::SharedMemoryImages);
+    auto shared_memory = _encoder.GetSharedMemoryImages();
+    if (!enable) {
+      shared_memory = nullptr;
+    } else if (shared_memory == nullptr) {
+      // One segment per world port, so several simulators can share a host.
+      shared_memory = std::make_shared<SharedMemoryImages>("carla_images_" + std::to_string(_port));
+    }
+    _encoder.SetSharedMemoryImages(std::move(shared_memory));
+  }
+
+  error_code WorldServer::SetPublisher(const bool enable, const uint32_t max_queued_frames) {
+    if (!enable) {
+      _encoder.SetPublisher(nullptr);
+      return errc::success();
+    }
+    if (_encoder.GetPublisher() != nullptr) {
+      return errc::success();
+    }
+    if (_port == 0u) {
+      log_error("the publisher needs the world server to be connected first");
+      return errc::invalid_argument();
+    }
+    auto publisher = std::make_shared<MeasurementsPublisher>(max_queued_frames);
+    const auto ec = publisher->Listen(_port + 3u);
+    if (!ec) {
+      _encoder.GetMetrics().SetPublisher(publisher);
+      _encoder.SetPublisher(std::move(publisher));
+    }
+    return ec;
+  }
+
+  error_code WorldServer::SetRecorder(
+      const bool enable,
+      const std::string &directory,
+      const uint64_t segment_size) {
+    auto recorder = _encoder.GetRecorder();
+    if (!enable) {
+      _encoder.SetRecorder(nullptr);
+      return errc::success();
+    }
+    if ((recorder != nullptr) && (recorder->GetDirectory() == directory)) {
+      return errc::success();
+    }
+    StreamRecorder::Options options;
+    options.segment_size = segment_size;
+    recorder = std::make_shared<StreamRecorder>(directory, options);
+    _encoder.GetMetrics().SetRecorder(recorder);
+    _encoder.SetRecorder(std::move(recorder));
+    return errc::success();
+  }
+
+  error_code WorldServer::SetMetricsServer(const bool enable) {
+    if (!enable) {
+      _metrics_server = nullptr;
+      return errc::success();
+    }
+    if (_metrics_server != nullptr) {
+      return errc::success();
+    }
+    if (_port == 0u) {
+      log_error("the metrics server needs the world server to be connected first");
+      return errc::invalid_argument();
+    }
+    auto metrics_server = std::make_unique<MetricsServer>(_encoder.GetSharedMetrics());
+    const auto ec = metrics_server->Listen(_port + 4u);
+    if (!ec) {
+      _metrics_server = std::move(metrics_server);
+    }
+    return ec;
   }
 
   void WorldServer::StartAgentServer() {
-    _agent_server = std::make_unique<AgentServer>(_encoder, _port + 1u, _port + 2u, _timeout);
+    ++_episode_id;
+    _agent_connections_reused = false;
+    if (_idle_agent_server != nullptr) {
+      if (_persistent_agent_connections && AreIdleAgentServersConnected()) {
+        log_debug("reusing agent connections for episode", _episode_id);
+        _agent_server = std::move(_idle_agent_server);
+        _secondary_agent_servers = std::move(_idle_secondary_agent_servers);
+        _idle_secondary_agent_servers.clear();
+        _agent_connections_reused = true;
+      } else {
+        log_debug("agent connections lost, restarting agent servers");
+        _idle_agent_server = nullptr;
+        _idle_secondary_agent_servers.clear();
+      }
+    }
+    if (_agent_server == nullptr) {
+      _agent_server = MakeAgentServer(_encoder, 0u);
+      for (auto i = 1u; i < _number_of_agents; ++i) {
+        if (_secondary_encoders.size() < i) {
+          _secondary_encoders.emplace_back(std::make_unique<CarlaEncoder>());
+        }
+        auto &encoder = *_secondary_encoders[i - 1u];
+        encoder.SetPackedAgents(_encoder.IsPackingAgents());
+        encoder.SetAgentsEncoding(_encoder.GetAgentsEncoding());
+        encoder.SetDeltaAgents(_encoder.IsDeltaAgents(), _encoder.GetDeltaThreshold());
+        encoder.SetCompressedImages(_encoder.IsCompressingImages());
+        encoder.SetDeltaImages(_encoder.IsDeltaImages());
+        encoder.SetControlWait(_encoder.GetControlWait());
+        encoder.SetLivenessTimeout(_encoder.GetLivenessTimeout());
+        _secondary_agent_servers.emplace_back(MakeAgentServer(encoder, i));
+      }
+    }
+    _agent_server->StartEpisode(_episode_id);
+    for (auto &agent_server : _secondary_agent_servers) {
+      agent_server->StartEpisode(_episode_id);
+    }
+    _encoder.GetMetrics().SetAgentServerRunning(true, _episode_id);
+  }
+
+  error_code WorldServer::StartOfflineAgentServer() {
+    if ((_encoder.GetRecorder() == nullptr) && (_encoder.GetPublisher() == nullptr)) {
+      log_error("an offline episode needs the recorder or the publisher enabled");
+      return errc::operation_aborted();
+    }
+    KillAgentServer();
+    ++_episode_id;
+    log_info("starting offline episode", _episode_id);
+    _agent_server = std::make_unique<AgentServer>(_encoder, AgentServer::Offline(), _measurements_buffer_slots);
+    _agent_server->StartEpisode(_episode_id);
+    _encoder.GetMetrics().SetAgentServerRunning(true, _episode_id);
+    return errc::success();
+  }
+
+  void WorldServer::StopAgentServer() {
+    if (_persistent_agent_connections && (_agent_server != nullptr)) {
+      _idle_agent_server = std::move(_agent_server);
+      _idle_secondary_agent_servers = std::move(_secondary_agent_servers);
+    }
+    _agent_server = nullptr;
+    _secondary_agent_servers.clear();
+    _encoder.GetMetrics().SetAgentServerRunning(false, _episode_id);
   }
 
   void WorldServer::KillAgentServer() {
     _agent_server = nullptr;
+    _idle_agent_server = nullptr;
+    _secondary_agent_servers.clear();
+    _idle_secondary_agent_servers.clear();
+    _encoder.GetMetrics().SetAgentServerRunning(false, _episode_id);
   }
 
   void WorldServer::ResetProtocol() {
+    const auto arena_stats = Protobuf::GetArenaStats();
+    log_debug(
+        "protobuf arenas:", arena_stats.number_of_arenas,
+        "total bytes:", arena_stats.total_bytes,
+        "max bytes:", arena_stats.max_bytes);
     Protocol protocol(_timeout);
     // Here we need to wait forever for the new episode, as it will take as long
     // as the current episode lasts.
@@ -124,6 +504,43 @@ namespace server {
   void WorldServer::ExecuteProtocol(Protocol &&protocol) {
     _protocol = std::move(protocol);
     _world_server.Execute(_protocol.request_new_episode);
+  }
+
+  bool WorldServer::AreIdleAgentServersConnected() const {
+    if ((_idle_agent_server == nullptr) ||
+        !_idle_agent_server->IsConnected() ||
+        (_idle_agent_server->HasSeparateImagesStream() != IsImagesStreamEnabled()) ||
+        (1u + _idle_secondary_agent_servers.size() != _number_of_agents)) {
+      return false;
+    }
+    for (auto &agent_server : _idle_secondary_agent_servers) {
+      if (!agent_server->IsConnected()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::unique_ptr<AgentServer> WorldServer::MakeAgentServer(
+      CarlaEncoder &encoder,
+      const uint32_t agent_index) {
+    const auto ports = GetAgentPorts(_port, agent_index);
+    log_debug("starting agent server", agent_index, "at ports", ports.first, "and", ports.second);
+    auto images_options = _images_stream_options;
+    images_options.port = (IsImagesStreamEnabled() ? GetImagesPort(_port, agent_index) : 0u);
+    return std::make_unique<AgentServer>(
+        encoder,
+        ports.first,
+        ports.second,
+        _timeout,
+        _measurements_buffer_slots,
+        _measurements_buffer_policy,
+        _measurements_options,
+        _control_options,
+        images_options);
+  }
+
+  void WorldServer::ExecuteEpisodeSetUp() {
     _world_server.Execute(_protocol.scene_description);
     _world_server.Execute(_protocol.episode_start);
     _world_server.Execute(_protocol.episode_ready);
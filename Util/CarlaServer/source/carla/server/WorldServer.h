@@ -6,16 +6,23 @@
 
 #pragma once
 
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "carla/Debug.h"
 #include "carla/NonCopyable.h"
 #include "carla/server/AsyncServer.h"
 #include "carla/server/CarlaEncoder.h"
 #include "carla/server/EncoderServer.h"
+#include "carla/server/EpisodeReady.h"
 #include "carla/server/TCPServer.h"
 
 namespace carla {
 namespace server {
 
   class AgentServer;
+  class MetricsServer;
 
   class WorldServer : private NonCopyable {
   public:
@@ -31,22 +38,227 @@ namespace server {
 
     std::future<error_code> Connect(uint32_t port, time_duration timeout);
 
+    /// Queued episodes are not returned, see TryReadQueued. The timeout applies
+    /// to every message read.
     error_code TryRead(carla_request_new_episode &request_new_episode, timeout_t timeout);
 
+    /// Return the episode queued by the client, only once. The data is valid
+    /// until the next call to TryRead.
+    error_code TryReadQueued(carla_request_new_episode &queued_episode);
+
+    /// Return the snapshot request of the client, only once. The data is valid
+    /// until the next call to TryRead. Snapshot requests are neither returned
+    /// by TryRead.
+    error_code TryReadSnapshotRequest(carla_world_snapshot_request &request);
+
+    std::future<error_code> Write(const carla_world_snapshot &snapshot);
+
+    /// Return the route query of the client, only once, see
+    /// carla_read_route_request().
+    error_code TryReadRouteRequest(carla_route_request &request);
+
+    std::future<error_code> Write(const carla_route &route);
+
+    /// Return the road map request of the client, only once, see
+    /// carla_read_road_map_request().
+    error_code TryReadRoadMapRequest(carla_road_map_request &request);
+
+    /// The map is only encoded again if its hash changes.
+    std::future<error_code> Write(const carla_road_map &road_map);
+
     std::future<error_code> Write(const carla_scene_description &scene_description);
 
     error_code TryRead(carla_episode_start &episode_start, timeout_t timeout);
 
     std::future<error_code> Write(const carla_episode_ready &episode_ready);
 
+    /// Set the buffering of the measurements stream for the next agent
+    /// servers to be started.
+    void SetMeasurementsBuffer(uint32_t number_of_slots, RingBufferPolicy policy) {
+      _measurements_buffer_slots = number_of_slots;
+      _measurements_buffer_policy = policy;
+    }
+
+    /// Only if the client supports it too, see ApplyCapabilities.
+    void SetPackedAgents(bool enable) {
+      _packed_agents_enabled = enable;
+      ApplyCapabilities();
+    }
+
+    /// Only if the client supports it too, see ApplyCapabilities.
+    void SetAgentsEncoding(AgentsEncoding encoding) {
+      _agents_encoding = encoding;
+      ApplyCapabilities();
+    }
+
+    /// Only if the client supports it too, see ApplyCapabilities.
+    void SetDeltaAgents(bool enable, float threshold) {
+      _delta_agents_enabled = enable;
+      _delta_threshold = threshold;
+      ApplyCapabilities();
+    }
+
+    void SetControlWait(const SpinWait &wait) {
+      _encoder.SetControlWait(wait);
+      for (auto &encoder : _secondary_encoders) {
+        encoder->SetControlWait(wait);
+      }
+    }
+
+    void SetLivenessTimeout(uint32_t milliseconds) {
+      _encoder.SetLivenessTimeout(milliseconds);
+      for (auto &encoder : _secondary_encoders) {
+        encoder->SetLivenessTimeout(milliseconds);
+      }
+    }
+
+    /// Upper limit of SetNumberOfAgents.
+    static constexpr uint32_t MaxNumberOfAgents = 32u;
+
+    /// Number of player agents sharing the world, each with its own agent
+    /// server, see GetAgentPorts. Takes effect on the next agent servers to be
+    /// started.
+    void SetNumberOfAgents(uint32_t number_of_agents) {
+      DEBUG_ASSERT((number_of_agents > 0u) && (number_of_agents <= MaxNumberOfAgents));
+      _number_of_agents = number_of_agents;
+    }
+
+    uint32_t GetNumberOfAgents() const {
+      return 1u + static_cast<uint32_t>(_secondary_agent_servers.size());
+    }
+
+    /// Measurements and control ports of the agent at @a agent_index. The
+    /// first agent uses world_port + 1 and + 2, the next ones continue after
+    /// the ports of the publisher and the metrics server, i.e. agent i > 0
+    /// uses world_port + 3 + 2i and + 4 + 2i.
+    static std::pair<uint32_t, uint32_t> GetAgentPorts(uint32_t world_port, uint32_t agent_index) {
+      const uint32_t out_port = world_port + (agent_index == 0u ? 1u : 3u + 2u * agent_index);
+      return {out_port, out_port + 1u};
+    }
+
+    /// Port of the separate images stream of the agent at @a agent_index,
+    /// after the ports of every agent there may be, i.e. world_port + 67 +
+    /// agent_index.
+    static uint32_t GetImagesPort(uint32_t world_port, uint32_t agent_index) {
+      return world_port + 3u + 2u * MaxNumberOfAgents + agent_index;
+    }
+
+    /// Send the images of every agent through a stream of their own, with
+    /// its own connection, writer thread and buffer of @a number_of_slots
+    /// frames with @a policy, so a slow image send does not delay the
+    /// measurements. Takes effect on the next agent servers to be started,
+    /// only if the client supports it too.
+    void SetImagesStream(bool enable, uint32_t number_of_slots, RingBufferPolicy policy) {
+      _images_stream_enabled = enable;
+      _images_stream_options.number_of_slots = number_of_slots;
+      _images_stream_options.policy = policy;
+    }
+
+    /// Options of the world socket, applied on the next Connect.
+    void SetWorldSocketOptions(const TCPOptions &options) {
+      _world_server.SetOptions(options);
+    }
+
+    /// Options of the measurements socket, applied on the next agent servers
+    /// to be started.
+    void SetMeasurementsSocketOptions(const TCPOptions &options) {
+      _measurements_options = options;
+    }
+
+    /// Options of the control socket, applied on the next agent servers to be
+    /// started.
+    void SetControlSocketOptions(const TCPOptions &options) {
+      _control_options = options;
+    }
+
+    /// Write the images into a shared memory segment, announced in the next
+    /// scene description, instead of sending them through the socket. Only if
+    /// the client supports it too.
+    void SetSharedMemoryImages(bool enable) {
+      _shared_memory_images_enabled = enable;
+      ApplyCapabilities();
+    }
+
+    /// Allow sharing the render targets of the cameras with the client, only
+    /// if the client supports it too.
+    void SetGpuSharedImages(bool enable) {
+      _gpu_shared_images_enabled = enable;
+    }
+
+    bool IsGpuSharedImagesEnabled() const {
+      return _gpu_shared_images_enabled && _client_capabilities.Has(Capability::GpuSharedImages);
+    }
+
+    /// Publish the measurements stream to the subscribers connected to
+    /// world_port + 3, see MeasurementsPublisher. Subscribers stay connected
+    /// across episodes, @a max_queued_frames only takes effect when enabling
+    /// a disabled publisher.
+    error_code SetPublisher(bool enable, uint32_t max_queued_frames);
+
+    /// Record the measurements stream into segments of @a segment_size bytes
+    /// in @a directory, see StreamRecorder. The recording goes on across
+    /// episodes, @a segment_size only takes effect when enabling a disabled
+    /// recorder or changing its directory.
+    error_code SetRecorder(bool enable, const std::string &directory, uint64_t segment_size);
+
+    /// Serve the metrics of this server in Prometheus text format at
+    /// world_port + 4, see MetricsServer.
+    error_code SetMetricsServer(bool enable);
+
+    void SetMemoryUsage(const carla_memory_usage &usage) {
+      _encoder.GetMetrics().SetGameMemory(usage);
+    }
+
+    /// Keep the agent server, and thus its connections, alive across episodes.
+    /// Only its protocol state is reset on every new episode, as long as the
+    /// client keeps both connections open. Takes effect at the end of the
+    /// current episode, and options of the measurements and control sockets
+    /// are not applied to an agent server kept alive.
+    void SetPersistentAgentConnections(bool enable) {
+      _persistent_agent_connections = enable;
+    }
+
+    /// Announce episode id zero in the episode ready messages, so the client
+    /// accepts the measurements of any episode, e.g. the frames of a replayed
+    /// recording, which carry the episode ids of the recording.
+    void SetAcceptAnyEpisode(bool enable) {
+      _accept_any_episode = enable;
+    }
+
     /// This assumes you have entered the loop of write measurements, read
     /// control.
     void StartAgentServer();
 
+    /// End the current episode, if any, and start one without any client,
+    /// see AgentServer::Offline. Fails if there is neither a recorder nor a
+    /// publisher to feed.
+    error_code StartOfflineAgentServer();
+
     AgentServer *GetAgentServer() {
       return _agent_server.get();
     }
 
+    /// Agent server of the agent at @a agent_index, null if missing.
+    AgentServer *GetAgentServer(uint32_t agent_index) {
+      if (agent_index == 0u) {
+        return GetAgentServer();
+      }
+      return (agent_index - 1u < _secondary_agent_servers.size() ?
+          _secondary_agent_servers[agent_index - 1u].get() :
+          nullptr);
+    }
+
+    /// Completions of the measurements written with a token by the player
+    /// agent, see carla_write_measurements_async.
+    WriteCompletions &GetWriteCompletions() {
+      return *_encoder.GetWriteCompletions();
+    }
+
+    /// End the episode of the agent server. It is kept idle if persistent
+    /// agent connections are enabled, killed otherwise.
+    void StopAgentServer();
+
+    /// Kill the agent server, even if idle.
     void KillAgentServer();
 
     void ResetProtocol();
@@ -60,24 +272,126 @@ namespace server {
       ReadTask<RequestNewEpisode> request_new_episode;
       WriteTask<carla_scene_description> scene_description;
       ReadTask<carla_episode_start> episode_start;
-      WriteTask<carla_episode_ready> episode_ready;
+      WriteTask<EpisodeReady> episode_ready;
+      /// Only executed on a snapshot request.
+      WriteTask<WorldSnapshot> world_snapshot;
+      /// Only executed on a route query.
+      WriteTask<Route> route;
+      /// Only executed on a road map request.
+      WriteTask<RoadMap> road_map;
     };
 
+    /// Only the request of a new episode is read ahead, the messages setting it
+    /// up are executed once it is received, since a queued episode is followed
+    /// by another request.
     void ExecuteProtocol(Protocol &&protocol);
 
-    uint32_t _port;
+    void ExecuteEpisodeSetUp();
+
+    /// Enable in the encoders the optional encodings enabled in the settings
+    /// and supported by the client, see RequestNewEpisode.capabilities in
+    /// carla_server.proto.
+    void ApplyCapabilities();
+
+    bool IsImagesStreamEnabled() const {
+      return _images_stream_enabled && _client_capabilities.Has(Capability::SeparateImagesStream);
+    }
+
+    /// Whether every idle agent server can be reused for the next episode.
+    bool AreIdleAgentServersConnected() const;
+
+    std::unique_ptr<AgentServer> MakeAgentServer(CarlaEncoder &encoder, uint32_t agent_index);
+
+    uint32_t _port = 0u;
 
     time_duration _timeout;
 
+    uint32_t _measurements_buffer_slots = 2u;
+
+    RingBufferPolicy _measurements_buffer_policy = RingBufferPolicy::DropOldest;
+
+    TCPOptions _measurements_options;
+
+    TCPOptions _control_options;
+
+    bool _packed_agents_enabled = false;
+
+    AgentsEncoding _agents_encoding = AgentsEncoding::Float32;
+
+    bool _delta_agents_enabled = false;
+
+    float _delta_threshold = 0.0f;
+
+    bool _shared_memory_images_enabled = false;
+
+    bool _gpu_shared_images_enabled = false;
+
+    bool _images_stream_enabled = false;
+
+    /// Of the last episode requested, everything until the client negotiates.
+    Capabilities _client_capabilities = Capabilities::All();
+
+    /// The port is set for each agent server.
+    ImagesStreamOptions _images_stream_options;
+
     CarlaEncoder _encoder;
 
     Protocol _protocol;
 
     AsyncServer<EncoderServer<TCPServer>> _world_server;
 
+    bool _persistent_agent_connections = false;
+
+    bool _accept_any_episode = false;
+
+    /// Incremented on every agent server started.
+    uint64_t _episode_id = 0u;
+
+    bool _agent_connections_reused = false;
+
     std::unique_ptr<AgentServer> _agent_server;
 
+    /// Agent server kept between episodes, see SetPersistentAgentConnections.
+    std::unique_ptr<AgentServer> _idle_agent_server;
+
+    uint32_t _number_of_agents = 1u;
+
+    /// One encoder per agent after the first one, so every agent has its own
+    /// control mailbox and measurements credit. Only grows, the agent servers
+    /// keep references to them.
+    std::vector<std::unique_ptr<CarlaEncoder>> _secondary_encoders;
+
+    /// Agent servers of the agents after the first one, same lifetime as
+    /// _agent_server.
+    std::vector<std::unique_ptr<AgentServer>> _secondary_agent_servers;
+
+    std::vector<std::unique_ptr<AgentServer>> _idle_secondary_agent_servers;
+
     RequestNewEpisode _new_episode_data;
+
+    /// Episode queued by the client, started by the next empty request.
+    RequestNewEpisode _queued_episode;
+
+    std::unique_ptr<MetricsServer> _metrics_server;
+
+    bool _is_queued_episode_unread = false;
+
+    RequestNewEpisode _snapshot_request;
+
+    bool _is_snapshot_request_unread = false;
+
+    carla_route_request _route_request;
+
+    bool _is_route_request_unread = false;
+
+    carla_road_map_request _road_map_request;
+
+    bool _is_road_map_request_unread = false;
+
+    /// Last road map encoded, see RoadMapEncoding.
+    uint64_t _road_map_hash = 0u;
+
+    std::shared_ptr<const std::string> _road_map_data;
   };
 
 } // namespace server
@@ -0,0 +1,22 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <string>
+
+namespace carla {
+namespace server {
+
+  /// Holds a copy of the data of a carla_world_snapshot, since the write to
+  /// the client happens after carla_write_world_snapshot() returns.
+  struct WorldSnapshot {
+    bool success = false;
+    std::string data;
+  };
+
+} // namespace server
+} // namespace carla
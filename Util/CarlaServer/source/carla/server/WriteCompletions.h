@@ -0,0 +1,52 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "carla/ArrayView.h"
+#include "carla/NonCopyable.h"
+#include "carla/server/CarlaServerAPI.h"
+#include "carla/server/ServerTraits.h"
+
+namespace carla {
+namespace server {
+
+  /// Outcome of the measurements written with a completion token, see
+  /// carla_write_measurements_async. Completions are pushed by whichever
+  /// thread finishes with the message (the networking thread once sent, the
+  /// game thread if the frame is dropped) and reaped by the game thread.
+  class WriteCompletions : private NonCopyable {
+  public:
+
+    void Push(uint64_t token, error_code ec) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _completions.push_back({token, ec.value()});
+    }
+
+    /// Move up to @a completions.size() completions, oldest first, into
+    /// @a completions. Returns how many were moved.
+    uint32_t Poll(mutable_array_view<carla_write_completion> &completions) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      const auto count = std::min(completions.size(), _completions.size());
+      std::copy_n(_completions.begin(), count, completions.begin());
+      _completions.erase(_completions.begin(), _completions.begin() + count);
+      return static_cast<uint32_t>(count);
+    }
+
+  private:
+
+    std::mutex _mutex;
+
+    std::vector<carla_write_completion> _completions;
+  };
+
+} // namespace server
+} // namespace carla
@@ -0,0 +1,303 @@
+// Replay server: serves a recording made by the stream recorder, see
+// StreamRecorder, to any client as if it were the simulator. The segments are
+// memory-mapped and every frame is sent as recorded, without decoding nor
+// copying it.
+//
+// Usage: replay_carlaserver --recording DIR [--port 2000]
+//            [--pacing realtime|fixed|max] [--fps 10] [--loop]
+//            [--queued-frames 4] [--timeout 10000]
+//
+// In realtime pacing the frames are sent following the game timestamps of the
+// recording, in fixed pacing at --fps frames per second, and in max pacing as
+// fast as the client reads them.
+//
+// Every new episode requested by the client restarts the replay from the first
+// frame. The frames keep the episode ids of the recording, the episode ready
+// message announces episode id zero so the client accepts them.
+
+#include <carla/Logging.h>
+#include <carla/server/AgentServer.h>
+#include <carla/server/Future.h>
+#include <carla/server/StreamRecording.h>
+#include <carla/server/WorldServer.h>
+#include <carla/server/carla_server.pb.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace cs = carla_server;
+using namespace carla::server;
+using clock_type = std::chrono::steady_clock;
+
+// =============================================================================
+// -- Options ------------------------------------------------------------------
+// =============================================================================
+
+enum class Pacing {
+  RealTime,
+  FixedRate,
+  Max
+};
+
+struct Options {
+  std::string recording;
+  uint32_t port = 2000u;
+  Pacing pacing = Pacing::RealTime;
+  uint32_t fps = 10u;
+  bool loop = false;
+  uint32_t queued_frames = 4u;
+  uint32_t timeout = 10u * 1000u;
+};
+
+static Options ParseOptions(int argc, char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if ((arg == "-h") || (arg == "--help")) {
+      std::cout << "usage: " << argv[0] << " --recording DIR [--port N] "
+                   "[--pacing realtime|fixed|max] [--fps N] [--loop] "
+                   "[--queued-frames N] [--timeout MS]\n";
+      std::exit(0);
+    }
+    if (arg == "--loop") {
+      options.loop = true;
+      continue;
+    }
+    if (i + 1 == argc) {
+      throw std::invalid_argument("missing value for " + arg);
+    }
+    const std::string value = argv[++i];
+    auto number = [&]() { return static_cast<uint32_t>(std::stoul(value)); };
+    if (arg == "--recording") {
+      options.recording = value;
+    } else if (arg == "--port") {
+      options.port = number();
+    } else if ((arg == "--pacing") && (value == "realtime")) {
+      options.pacing = Pacing::RealTime;
+    } else if ((arg == "--pacing") && (value == "fixed")) {
+      options.pacing = Pacing::FixedRate;
+    } else if ((arg == "--pacing") && (value == "max")) {
+      options.pacing = Pacing::Max;
+    } else if (arg == "--fps") {
+      options.fps = std::max(number(), 1u);
+    } else if (arg == "--queued-frames") {
+      options.queued_frames = std::max(number(), 1u);
+    } else if (arg == "--timeout") {
+      options.timeout = number();
+    } else {
+      throw std::invalid_argument("invalid option " + arg + " " + value);
+    }
+  }
+  if (options.recording.empty()) {
+    throw std::invalid_argument("missing --recording");
+  }
+  return options;
+}
+
+// =============================================================================
+// -- Pacer --------------------------------------------------------------------
+// =============================================================================
+
+/// Decides when each frame is sent. If the client falls behind the schedule
+/// is reset instead of sending a burst of frames to catch up.
+class Pacer {
+public:
+
+  explicit Pacer(const Options &options)
+    : _pacing(options.pacing),
+      _period(std::chrono::duration_cast<clock_type::duration>(
+          std::chrono::duration<double>(1.0 / options.fps))) {}
+
+  void Restart() {
+    _next = clock_type::now();
+    _has_timestamp = false;
+  }
+
+  void Wait(const StreamRecording::Frame &frame) {
+    switch (_pacing) {
+      case Pacing::RealTime:
+        _next += GetElapsedGameTime(frame);
+        break;
+      case Pacing::FixedRate:
+        _next += _period;
+        break;
+      case Pacing::Max:
+        return;
+    }
+    const auto now = clock_type::now();
+    if (_next > now) {
+      std::this_thread::sleep_until(_next);
+    } else {
+      _next = now;
+    }
+  }
+
+private:
+
+  /// Game time since the previous frame. Zero for the first frame and when
+  /// the game timestamp goes backwards, i.e. a new episode in the recording.
+  clock_type::duration GetElapsedGameTime(const StreamRecording::Frame &frame) {
+    const auto *data = boost::asio::buffer_cast<const char *>(frame.measurements);
+    const auto size = boost::asio::buffer_size(frame.measurements);
+    // Skip the size prefix.
+    if (!_measurements.ParseFromArray(data + sizeof(uint32_t), static_cast<int>(size - sizeof(uint32_t)))) {
+      carla::log_error("replay: unable to parse the measurements of a frame");
+      return clock_type::duration::zero();
+    }
+    const auto timestamp = _measurements.game_timestamp();
+    const bool forward = _has_timestamp && (timestamp > _timestamp);
+    const auto elapsed = (forward ? timestamp - _timestamp : 0u);
+    _timestamp = timestamp;
+    _has_timestamp = true;
+    return std::chrono::milliseconds(elapsed);
+  }
+
+  const Pacing _pacing;
+
+  const clock_type::duration _period;
+
+  clock_type::time_point _next;
+
+  cs::Measurements _measurements;
+
+  uint32_t _timestamp = 0u;
+
+  bool _has_timestamp = false;
+};
+
+// =============================================================================
+// -- Replay -------------------------------------------------------------------
+// =============================================================================
+
+static void Check(const error_code &ec, const char *what) {
+  if (ec) {
+    throw std::runtime_error(std::string(what) + " failed: " + ec.message());
+  }
+}
+
+/// Block until the client requests a new episode.
+static void WaitForNewEpisode(WorldServer &server, const Options &options) {
+  carla_request_new_episode request;
+  error_code ec;
+  do {
+    ec = server.TryRead(request, timeout_t::milliseconds(options.timeout));
+  } while (ec == errc::try_again());
+  Check(ec, "read request new episode");
+}
+
+/// Answer the set up of the episode with a single start spot at the origin.
+static void SetUpEpisode(WorldServer &server, const Options &options) {
+  const auto timeout = timeout_t::milliseconds(options.timeout);
+  carla_transform start_spot;
+  std::memset(&start_spot, 0, sizeof(start_spot));
+  start_spot.orientation.x = 1.0f;
+  carla_scene_description scene_description;
+  scene_description.player_start_spots = &start_spot;
+  scene_description.number_of_player_start_spots = 1u;
+  scene_description.previous_episode_summary = nullptr;
+  auto scene_written = server.Write(scene_description);
+  error_code ec = errc::timed_out();
+  future::wait_and_get(scene_written, ec, timeout);
+  Check(ec, "write scene description");
+
+  carla_episode_start episode_start;
+  Check(server.TryRead(episode_start, timeout), "read episode start");
+
+  server.StartAgentServer();
+  auto ready_written = server.Write(carla_episode_ready{true});
+  ec = errc::timed_out();
+  future::wait_and_get(ready_written, ec, timeout);
+  server.ResetProtocol();
+  Check(ec, "write episode ready");
+}
+
+/// Serve the recording until the client requests a new episode, returns false
+/// if the recording ended without looping.
+static bool PlayEpisode(
+    WorldServer &server,
+    const StreamRecording &recording,
+    const Options &options) {
+  auto *agent = server.GetAgentServer();
+  if (agent == nullptr) {
+    throw std::runtime_error("agent server not started");
+  }
+  Pacer pacer(options);
+  pacer.Restart();
+  uint64_t frames = 0u;
+  uint64_t bytes = 0u;
+  const auto start = clock_type::now();
+  auto report = [&]() {
+    const auto seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    carla::log_info(
+        "replay:", frames, "frames sent,",
+        1e-6 * static_cast<double>(bytes) / std::max(seconds, 1e-9), "MB/s");
+  };
+  for (size_t index = 0u; ; ++index) {
+    if (index == recording.size()) {
+      if (!options.loop) {
+        report();
+        return false;
+      }
+      index = 0u;
+      pacer.Restart();
+    }
+    carla_request_new_episode request;
+    const auto ec = server.TryRead(request, timeout_t());
+    if (ec != errc::try_again()) {
+      Check(ec, "read request new episode");
+      report();
+      return true;
+    }
+    const auto frame = recording.GetFrame(index);
+    pacer.Wait(frame);
+    Check(agent->WriteRawFrame(frame.measurements, frame.images, frame.segment), "write frame");
+    ++frames;
+    bytes += boost::asio::buffer_size(frame.measurements) + boost::asio::buffer_size(frame.images);
+  }
+}
+
+/// Serve a client until it disconnects or fails.
+static void Serve(const StreamRecording &recording, const Options &options) {
+  WorldServer server;
+  // Blocking, with max pacing the client's reads set the pace.
+  server.SetMeasurementsBuffer(options.queued_frames, RingBufferPolicy::Block);
+  server.SetAcceptAnyEpisode(true);
+  server.Connect(options.port, timeout_t::milliseconds(options.timeout));
+  WaitForNewEpisode(server, options);
+  for (;;) {
+    server.StopAgentServer();
+    SetUpEpisode(server, options);
+    if (!PlayEpisode(server, recording, options)) {
+      WaitForNewEpisode(server, options);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
+    const auto options = ParseOptions(argc, argv);
+    StreamRecording recording;
+    Check(recording.Open(options.recording), "open recording");
+    if (recording.empty()) {
+      throw std::runtime_error("no frames in " + options.recording);
+    }
+    for (;;) {
+      try {
+        Serve(recording, options);
+      } catch (const std::runtime_error &e) {
+        std::cerr << "client lost: " << e.what() << std::endl;
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+// Helpers of the tests whose client runs in the same process as the server,
+// unlike the CarlaServerAPI tests. The messages are prefixed by their size as
+// in the protocol of the server.
+namespace test {
+
+  inline std::string ReadMessage(boost::asio::ip::tcp::socket &socket) {
+    uint32_t size;
+    boost::asio::read(socket, boost::asio::buffer(&size, sizeof(size)));
+    std::string message(size, '\0');
+    if (size > 0u) {
+      boost::asio::read(socket, boost::asio::buffer(&message[0u], size));
+    }
+    return message;
+  }
+
+  inline void WriteMessage(boost::asio::ip::tcp::socket &socket, const std::string &message) {
+    const uint32_t size = static_cast<uint32_t>(message.size());
+    const std::array<boost::asio::const_buffer, 2u> buffers = {{
+        boost::asio::buffer(&size, sizeof(size)),
+        boost::asio::buffer(message)}};
+    boost::asio::write(socket, buffers);
+  }
+
+  /// Retries until the server listens on @a port, for about five seconds.
+  inline void Connect(boost::asio::ip::tcp::socket &socket, const uint32_t port) {
+    const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+    for (auto i = 0u; i < 100u; ++i) {
+      boost::system::error_code ec;
+      socket.connect(endpoint, ec);
+      if (!ec) {
+        return;
+      }
+      socket.close();
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    throw std::runtime_error("unable to connect");
+  }
+
+} // namespace test
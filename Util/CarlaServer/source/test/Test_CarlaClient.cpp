@@ -0,0 +1,369 @@
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <carla/client/CarlaClient.h>
+#include <carla/server/ImagesMessage.h>
+
+static constexpr uint32_t WORLD_PORT = 3000u;
+static constexpr uint32_t TIMEOUT = 6u * 1000u;
+static constexpr uint32_t NUMBER_OF_FRAMES = 5u;
+static constexpr uint32_t WIDTH = 64u;
+static constexpr uint32_t HEIGHT = 32u;
+
+static void Check(bool condition, const char *what) {
+  if (!condition) {
+    throw std::runtime_error(what);
+  }
+}
+
+// Returns the number of frames read.
+static uint32_t RunClient() {
+  carla::client::CarlaClient client("127.0.0.1", WORLD_PORT);
+  const auto &scene = client.RequestNewEpisode("");
+  Check(scene.player_start_spots_size() == 1, "unexpected scene description");
+  const auto &ready = client.StartEpisode(0u);
+  Check(ready.ready(), "episode not ready");
+  carla::client::Frame frame;
+  std::vector<unsigned char> labels(WIDTH * HEIGHT);
+  for (auto i = 0u; i < NUMBER_OF_FRAMES; ++i) {
+    client.ReadFrame(frame);
+    Check(frame.measurements().frame_number() == i, "unexpected frame number");
+    const auto images = frame.images();
+    Check(images.size() == 2u, "unexpected number of images");
+    for (auto &image : images) {
+      const auto address = reinterpret_cast<uintptr_t>(image.data);
+      Check(address % carla::server::ImagesMessage::Alignment == 0u, "misaligned image");
+    }
+    const auto &compressed = images[0u];
+    Check(compressed.compression == CARLA_SERVER_IMAGE_COMPRESSION_LZ4, "image not compressed");
+    Check(compressed.stride == WIDTH, "unexpected stride");
+    Check(carla::client::Frame::Decompress(compressed, labels.data()), "decompression failed");
+    for (auto label : labels) {
+      Check(label == i, "unexpected label");
+    }
+    const auto &color = images[1u];
+    Check((color.width == WIDTH) && (color.height == HEIGHT), "unexpected size");
+    uint32_t pixel;
+    std::memcpy(&pixel, color.data + color.stride * (HEIGHT - 1u), sizeof(pixel));
+    Check(pixel == 0xFF000000u + i, "unexpected pixel");
+    // Sent as binary controls, the server accepts them.
+    Check(ready.binary_control(), "binary controls not accepted");
+    client.SendControl(0.5f, 1.0f, 0.0f, (i % 2u) == 1u, i == 2u);
+  }
+  return NUMBER_OF_FRAMES;
+}
+
+TEST(CarlaClient, ReceiveFrames) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  auto client = std::async(std::launch::async, RunClient);
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  {
+    carla_request_new_episode values;
+    ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_scene_description values{start_locations, 1u, nullptr};
+    ASSERT_EQ(S, carla_write_scene_description(CarlaServer, values, TIMEOUT));
+  }
+  {
+    carla_episode_start values;
+    ASSERT_EQ(S, carla_read_episode_start(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_episode_ready values{true};
+    ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, values, TIMEOUT));
+  }
+  std::vector<uint8_t> labels(WIDTH * HEIGHT);
+  std::vector<uint32_t> color(WIDTH * HEIGHT);
+  for (auto i = 0u; i < NUMBER_OF_FRAMES; ++i) {
+    std::fill(labels.begin(), labels.end(), static_cast<uint8_t>(i));
+    std::fill(color.begin(), color.end(), 0xFF000000u + i);
+    const carla_image images[] = {
+      {WIDTH, HEIGHT, 3u, reinterpret_cast<const uint32_t *>(labels.data()), i, 0u, CARLA_SERVER_IMAGE_GRAY8, CARLA_SERVER_IMAGE_COMPRESSION_LZ4, 0u, 0u, 0u},
+      {WIDTH, HEIGHT, 1u, color.data(), i, 1u, CARLA_SERVER_IMAGE_BGRA8, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u}
+    };
+    carla_measurements measurements;
+    std::memset(&measurements, 0, sizeof(measurements));
+    measurements.frame_number = i;
+    ASSERT_EQ(S, carla_write_measurements(CarlaServer, measurements, images, 2u));
+    carla_control control;
+    ASSERT_EQ(S, carla_read_control(CarlaServer, control, TIMEOUT));
+    ASSERT_EQ(0.5f, control.steer);
+    ASSERT_EQ(1.0f, control.throttle);
+    ASSERT_EQ((i % 2u) == 1u, control.hand_brake);
+    ASSERT_EQ(i == 2u, control.reverse);
+  }
+  ASSERT_EQ(NUMBER_OF_FRAMES, client.get());
+}
+
+// A client that cannot decompress the images gets them uncompressed.
+TEST(CarlaClient, NegotiateCapabilities) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  auto client = std::async(std::launch::async, []() {
+    carla::client::CarlaClient client("127.0.0.1", WORLD_PORT);
+    client.SetCapabilities({carla_server::CAPABILITY_PACKED_AGENTS});
+    client.RequestNewEpisode("");
+    const auto &ready = client.StartEpisode(0u);
+    Check(!ready.binary_control(), "unexpected binary controls");
+    Check(ready.capabilities_size() == 1, "unexpected capabilities");
+    Check(ready.capabilities(0) == carla_server::CAPABILITY_PACKED_AGENTS, "unexpected capability");
+    carla::client::Frame frame;
+    client.ReadFrame(frame);
+    const auto images = frame.images();
+    Check(images.size() == 1u, "unexpected number of images");
+    Check(images[0u].compression == CARLA_SERVER_IMAGE_COMPRESSION_NONE, "image compressed");
+    Check(images[0u].data[0u] == 7u, "unexpected pixel");
+    client.SendControl(0.5f, 1.0f, 0.0f);
+  });
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  {
+    carla_request_new_episode values;
+    ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  }
+  ASSERT_EQ(S, carla_set_packed_agents(CarlaServer, true));
+  ASSERT_EQ(S, carla_set_delta_agents(CarlaServer, true, 0.0f));
+  {
+    const carla_scene_description values{start_locations, 1u, nullptr};
+    ASSERT_EQ(S, carla_write_scene_description(CarlaServer, values, TIMEOUT));
+  }
+  {
+    carla_episode_start values;
+    ASSERT_EQ(S, carla_read_episode_start(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_episode_ready values{true};
+    ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, values, TIMEOUT));
+  }
+  std::vector<uint8_t> labels(WIDTH * HEIGHT, 7u);
+  const carla_image images[] = {
+    {WIDTH, HEIGHT, 3u, reinterpret_cast<const uint32_t *>(labels.data()), 0u, 0u, CARLA_SERVER_IMAGE_GRAY8, CARLA_SERVER_IMAGE_COMPRESSION_LZ4, 0u, 0u, 0u}
+  };
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  ASSERT_EQ(S, carla_write_measurements(CarlaServer, measurements, images, 1u));
+  carla_control control;
+  ASSERT_EQ(S, carla_read_control(CarlaServer, control, TIMEOUT));
+  ASSERT_EQ(0.5f, control.steer);
+  client.get();
+}
+
+// A client that asks for flat measurements reads them in place.
+TEST(CarlaClient, FlatMeasurements) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  auto client = std::async(std::launch::async, []() {
+    carla::client::CarlaClient client("127.0.0.1", WORLD_PORT);
+    client.SetCapabilities({carla_server::CAPABILITY_FLAT_MEASUREMENTS});
+    client.RequestNewEpisode("");
+    const auto &ready = client.StartEpisode(0u);
+    Check(ready.capabilities_size() == 1, "unexpected capabilities");
+    Check(ready.capabilities(0) == carla_server::CAPABILITY_FLAT_MEASUREMENTS, "unexpected capability");
+    carla::client::Frame frame;
+    client.ReadFrame(frame);
+    Check(frame.is_flat(), "measurements not flat");
+    const auto view = frame.flat_measurements();
+    Check(view.header().frame_number == 9u, "unexpected frame number");
+    Check(view.agents().size() == 2u, "unexpected number of agents");
+    Check(view.agents()[1u].id == 12u, "unexpected agent");
+    Check(view.agents()[1u].location.x == 5.0f, "unexpected location");
+    Check(frame.images().size() == 1u, "unexpected number of images");
+    client.SendControl(0.5f, 1.0f, 0.0f);
+  });
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  {
+    carla_request_new_episode values;
+    ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_scene_description values{start_locations, 1u, nullptr};
+    ASSERT_EQ(S, carla_write_scene_description(CarlaServer, values, TIMEOUT));
+  }
+  {
+    carla_episode_start values;
+    ASSERT_EQ(S, carla_read_episode_start(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_episode_ready values{true};
+    ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, values, TIMEOUT));
+  }
+  carla_agent agents[2u];
+  std::memset(agents, 0, sizeof(agents));
+  agents[0u].id = 11u;
+  agents[1u].id = 12u;
+  agents[1u].type = CARLA_SERVER_AGENT_VEHICLE;
+  agents[1u].transform.location.x = 5.0f;
+  std::vector<uint8_t> labels(WIDTH * HEIGHT, 7u);
+  const carla_image images[] = {
+    {WIDTH, HEIGHT, 3u, reinterpret_cast<const uint32_t *>(labels.data()), 0u, 0u, CARLA_SERVER_IMAGE_GRAY8, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u}
+  };
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  measurements.frame_number = 9u;
+  measurements.non_player_agents = agents;
+  measurements.number_of_non_player_agents = 2u;
+  ASSERT_EQ(S, carla_write_measurements(CarlaServer, measurements, images, 1u));
+  carla_control control;
+  ASSERT_EQ(S, carla_read_control(CarlaServer, control, TIMEOUT));
+  ASSERT_EQ(0.5f, control.steer);
+  client.get();
+}
+
+TEST(CarlaClient, Heartbeats) {
+  constexpr uint32_t LIVENESS_TIMEOUT = 300u;
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  std::promise<void> server_done;
+  auto client = std::async(std::launch::async, [done = server_done.get_future()]() {
+    carla::client::CarlaClient client("127.0.0.1", WORLD_PORT);
+    client.RequestNewEpisode("");
+    client.StartEpisode(0u);
+    carla::client::Frame frame;
+    client.ReadFrame(frame);
+    // Takes longer than the liveness time-out to compute the control.
+    for (auto i = 0u; i < 6u; ++i) {
+      client.SendHeartbeat();
+      std::this_thread::sleep_for(std::chrono::milliseconds(LIVENESS_TIMEOUT / 3u));
+    }
+    client.SendControl(0.5f, 1.0f, 0.0f);
+    // Hangs without closing the connections.
+    done.wait_for(std::chrono::milliseconds(TIMEOUT));
+  });
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  ASSERT_EQ(S, carla_set_liveness_timeout(CarlaServer, LIVENESS_TIMEOUT));
+  {
+    carla_request_new_episode values;
+    ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_scene_description values{start_locations, 1u, nullptr};
+    ASSERT_EQ(S, carla_write_scene_description(CarlaServer, values, TIMEOUT));
+  }
+  {
+    carla_episode_start values;
+    ASSERT_EQ(S, carla_read_episode_start(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_episode_ready values{true};
+    ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, values, TIMEOUT));
+  }
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  ASSERT_EQ(S, carla_write_measurements(CarlaServer, measurements, nullptr, 0u));
+  carla_control control;
+  ASSERT_EQ(S, carla_read_control(CarlaServer, control, TIMEOUT));
+  ASSERT_EQ(0.5f, control.steer);
+
+  const auto start = std::chrono::steady_clock::now();
+  ASSERT_NE(S, carla_read_control(CarlaServer, control, TIMEOUT));
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  ASSERT_LT(elapsed, std::chrono::milliseconds(TIMEOUT / 2u));
+  server_done.set_value();
+  client.get();
+}
+
+TEST(CarlaClient, ControlLatency) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  auto client = std::async(std::launch::async, []() {
+    carla::client::CarlaClient client("127.0.0.1", WORLD_PORT);
+    client.RequestNewEpisode("");
+    client.StartEpisode(0u);
+    carla::client::Frame frame;
+    client.ReadFrame(frame);
+    Check(!frame.measurements().has_control_latency(), "unexpected control latency");
+    carla::client::CarlaClient::Control control;
+    control.set_steer(0.5f);
+    control.set_sequence_number(42u);
+    client.SendControl(control);
+    client.ReadFrame(frame);
+    Check(frame.measurements().has_control_latency(), "missing control latency");
+    const auto &latency = frame.measurements().control_latency();
+    Check(latency.last_applied_control_sequence() == 42u, "unexpected sequence number");
+    Check(latency.receive_us() > 0u, "missing receive time");
+    Check(latency.receive_us() <= latency.apply_us(), "applied before received");
+    Check(latency.apply_us() <= latency.capture_us(), "captured before applied");
+    Check(latency.capture_us() <= latency.send_us(), "sent before captured");
+  });
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  {
+    carla_request_new_episode values;
+    ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_scene_description values{start_locations, 1u, nullptr};
+    ASSERT_EQ(S, carla_write_scene_description(CarlaServer, values, TIMEOUT));
+  }
+  {
+    carla_episode_start values;
+    ASSERT_EQ(S, carla_read_episode_start(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_episode_ready values{true};
+    ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, values, TIMEOUT));
+  }
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  ASSERT_EQ(S, carla_write_measurements(CarlaServer, measurements, nullptr, 0u));
+  carla_control_batch batch;
+  ASSERT_EQ(S, carla_read_control_batch(CarlaServer, batch, TIMEOUT));
+  ASSERT_EQ(1u, batch.number_of_controls);
+  ASSERT_EQ(42u, batch.controls[0u].sequence_number);
+  ASSERT_EQ(S, carla_set_applied_control(CarlaServer, batch.controls[0u].sequence_number));
+  measurements.frame_number = 1u;
+  ASSERT_EQ(S, carla_write_measurements(CarlaServer, measurements, nullptr, 0u));
+  client.get();
+}
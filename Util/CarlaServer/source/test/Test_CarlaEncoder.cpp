@@ -0,0 +1,895 @@
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include <carla/server/AgentBoxes.h>
+#include <carla/server/CarlaEncoder.h>
+#include <carla/server/CarlaMeasurements.h>
+#include <carla/server/ClassHistograms.h>
+#include <carla/server/CollisionEvents.h>
+#include <carla/server/FlatMeasurements.h>
+#include <carla/server/carla_server.pb.h>
+
+#include <cstring>
+#include <vector>
+
+TEST(CarlaEncoder, EncodeMeasurementsIntoBuffer) {
+  using namespace carla::server;
+
+  carla_agent agents[3u];
+  std::memset(agents, 0, sizeof(agents));
+  for (auto i = 0u; i < 3u; ++i) {
+    agents[i].id = i + 1u;
+    agents[i].type = CARLA_SERVER_AGENT_VEHICLE;
+    agents[i].forward_speed = 10.0f * i;
+    agents[i].intersection_offroad = 0.25f * i;
+    agents[i].intersection_otherlane = 0.5f;
+  }
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  measurements.frame_number = 42u;
+  measurements.game_timestamp = 1234u;
+  measurements.non_player_agents = agents;
+  measurements.number_of_non_player_agents = 3u;
+  const uint64_t frame_numbers[] = {40u, 41u};
+  const auto frames = carla::array_view::make_const(frame_numbers, 2u);
+  const uint32_t camera_indices[] = {0u, 2u};
+  const auto cameras = carla::array_view::make_const(camera_indices, 2u);
+
+  CarlaEncoder encoder;
+  const auto expected = encoder.Encode(measurements, frames, cameras);
+
+  carla_server::Measurements message;
+  ASSERT_TRUE(message.ParseFromArray(
+      expected.data() + sizeof(uint32_t),
+      static_cast<int>(expected.size() - sizeof(uint32_t))));
+  ASSERT_EQ(2, message.image_frame_numbers_size());
+  ASSERT_EQ(41u, message.image_frame_numbers(1));
+  ASSERT_EQ(2, message.image_camera_indices_size());
+  ASSERT_EQ(2u, message.image_camera_indices(1));
+  ASSERT_EQ(3, message.non_player_agents_size());
+  ASSERT_EQ(0.5f, message.non_player_agents(2).vehicle().intersection_offroad());
+  ASSERT_EQ(0.5f, message.non_player_agents(2).vehicle().intersection_otherlane());
+
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  for (auto i = 0u; i < 2u; ++i) {
+    const auto encoded = encoder.Encode(measurements, frames, cameras, buffer, delta);
+    ASSERT_EQ(expected.size(), encoded.size());
+    ASSERT_EQ(buffer.data(), encoded.data());
+    ASSERT_EQ(0, std::memcmp(expected.data(), encoded.data(), encoded.size()));
+  }
+
+  // A smaller message reuses the same buffer.
+  measurements.number_of_non_player_agents = 1u;
+  const auto capacity = buffer.size();
+  const auto encoded = encoder.Encode(measurements, frames, cameras, buffer, delta);
+  ASSERT_EQ(capacity, buffer.size());
+  ASSERT_EQ(encoder.Encode(measurements, frames, cameras).size(), encoded.size());
+}
+
+TEST(CarlaEncoder, PackedAgents) {
+  using namespace carla::server;
+
+  constexpr uint32_t numberOfAgents = 3u;
+  carla_agent agents[numberOfAgents];
+  std::memset(agents, 0, sizeof(agents));
+  for (auto i = 0u; i < numberOfAgents; ++i) {
+    agents[i].id = 100u + i;
+    agents[i].type = CARLA_SERVER_AGENT_PEDESTRIAN;
+    agents[i].transform.location = {1.0f * i, 2.0f * i, 3.0f * i};
+    agents[i].box_extent = {4.0f, 5.0f, 6.0f};
+    agents[i].forward_speed = 7.0f * i;
+  }
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  measurements.non_player_agents = agents;
+  measurements.number_of_non_player_agents = numberOfAgents;
+
+  CarlaEncoder encoder;
+  encoder.SetPackedAgents(true);
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  const auto encoded = encoder.Encode(
+      measurements,
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      buffer,
+      delta);
+
+  carla_server::Measurements message;
+  ASSERT_TRUE(message.ParseFromArray(
+      encoded.data() + sizeof(uint32_t),
+      static_cast<int>(encoded.size() - sizeof(uint32_t))));
+  ASSERT_EQ(0, message.non_player_agents_size());
+  const auto &packed = message.packed_non_player_agents();
+  ASSERT_EQ(numberOfAgents, packed.number_of_agents());
+  ASSERT_EQ(48u * numberOfAgents, packed.data().size());
+
+  const char *data = packed.data().data();
+  auto read_uint = [&](size_t offset) {
+    uint32_t value;
+    std::memcpy(&value, data + offset, sizeof(value));
+    return value;
+  };
+  auto read_float = [&](size_t offset) {
+    float value;
+    std::memcpy(&value, data + offset, sizeof(value));
+    return value;
+  };
+  constexpr auto N = numberOfAgents;
+  for (auto i = 0u; i < N; ++i) {
+    ASSERT_EQ(100u + i, read_uint(4u * i));
+    ASSERT_EQ(CARLA_SERVER_AGENT_PEDESTRIAN, read_uint(4u * (N + i)));
+    ASSERT_EQ(2.0f * i, read_float(8u * N + 12u * i + 4u));
+    ASSERT_EQ(5.0f, read_float(32u * N + 12u * i + 4u));
+    ASSERT_EQ(7.0f * i, read_float(44u * N + 4u * i));
+  }
+  ASSERT_EQ(carla_server::AGENTS_FLOAT32, packed.encoding());
+
+  // Same agents in half-precision floats.
+  encoder.SetAgentsEncoding(AgentsEncoding::HalfFloat);
+  const auto half = encoder.Encode(
+      measurements,
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      buffer,
+      delta);
+  ASSERT_TRUE(message.ParseFromArray(
+      half.data() + sizeof(uint32_t),
+      static_cast<int>(half.size() - sizeof(uint32_t))));
+  ASSERT_EQ(carla_server::AGENTS_HALF_FLOAT, message.packed_non_player_agents().encoding());
+  ASSERT_EQ(25u * numberOfAgents, message.packed_non_player_agents().data().size());
+  encoder.SetAgentsEncoding(AgentsEncoding::Float32);
+
+  // Back to one message per agent.
+  encoder.SetPackedAgents(false);
+  const auto unpacked = encoder.Encode(
+      measurements,
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      buffer,
+      delta);
+  ASSERT_TRUE(message.ParseFromArray(
+      unpacked.data() + sizeof(uint32_t),
+      static_cast<int>(unpacked.size() - sizeof(uint32_t))));
+  ASSERT_EQ(static_cast<int>(numberOfAgents), message.non_player_agents_size());
+  ASSERT_FALSE(message.has_packed_non_player_agents());
+}
+
+TEST(CarlaEncoder, AgentArrays) {
+  using namespace carla::server;
+
+  constexpr uint32_t numberOfAgents = 3u;
+  carla_agent agents[numberOfAgents];
+  std::memset(agents, 0, sizeof(agents));
+  uint32_t ids[numberOfAgents];
+  uint32_t types[numberOfAgents];
+  carla_vector3d locations[numberOfAgents];
+  carla_vector3d orientations[numberOfAgents];
+  carla_vector3d box_extents[numberOfAgents];
+  float forward_speeds[numberOfAgents];
+  for (auto i = 0u; i < numberOfAgents; ++i) {
+    agents[i].id = ids[i] = 100u + i;
+    agents[i].type = types[i] = CARLA_SERVER_AGENT_VEHICLE;
+    agents[i].transform.location = locations[i] = {1.0f * i, 2.0f * i, 3.0f * i};
+    agents[i].transform.orientation = orientations[i] = {0.0f, 90.0f, 1.0f * i};
+    agents[i].box_extent = box_extents[i] = {4.0f, 5.0f, 6.0f * i};
+    agents[i].forward_speed = forward_speeds[i] = 7.0f * i;
+  }
+  const carla_agent_arrays arrays = {
+      numberOfAgents, ids, types, locations, orientations, box_extents, forward_speeds};
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  measurements.non_player_agents = agents;
+  measurements.number_of_non_player_agents = numberOfAgents;
+
+  CarlaEncoder encoder;
+  encoder.SetPackedAgents(true);
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  const auto encoded = encoder.Encode(
+      measurements,
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      buffer,
+      delta);
+  carla_server::Measurements message;
+  ASSERT_TRUE(message.ParseFromArray(
+      encoded.data() + sizeof(uint32_t),
+      static_cast<int>(encoded.size() - sizeof(uint32_t))));
+  const std::string expected = message.packed_non_player_agents().data();
+
+  // The arrays are kept as they are sent.
+  CarlaMeasurements copy;
+  copy.Write(measurements, arrays);
+  ASSERT_EQ(nullptr, copy.measurements().non_player_agents);
+  ASSERT_EQ(numberOfAgents, copy.measurements().number_of_non_player_agents);
+  const auto packed = copy.packed_agents();
+  ASSERT_EQ(expected, std::string(packed.data(), packed.size()));
+  std::vector<char> other_buffer;
+  const auto from_arrays = encoder.Encode(
+      copy.measurements(),
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      other_buffer,
+      delta,
+      0u,
+      0u,
+      nullptr,
+      nullptr,
+      packed);
+  ASSERT_EQ(
+      std::string(encoded.data(), encoded.size()),
+      std::string(from_arrays.data(), from_arrays.size()));
+
+  // Unpacked they are the same agents.
+  copy.UnpackAgents();
+  ASSERT_EQ(0u, copy.packed_agents().size());
+  ASSERT_NE(nullptr, copy.measurements().non_player_agents);
+  ASSERT_EQ(0, std::memcmp(agents, copy.measurements().non_player_agents, sizeof(agents)));
+}
+
+TEST(CarlaEncoder, DeltaAgents) {
+  using namespace carla::server;
+
+  carla_agent agents[3u];
+  std::memset(agents, 0, sizeof(agents));
+  for (auto i = 0u; i < 3u; ++i) {
+    agents[i].id = i + 1u;
+    agents[i].type = CARLA_SERVER_AGENT_VEHICLE;
+  }
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  measurements.non_player_agents = agents;
+  measurements.number_of_non_player_agents = 3u;
+  const auto frames = carla::array_view::make_const<uint64_t>(nullptr, 0u);
+  const auto cameras = carla::array_view::make_const<uint32_t>(nullptr, 0u);
+
+  CarlaEncoder encoder;
+  encoder.SetDeltaAgents(true, 1.0f);
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  carla_server::Measurements message;
+  auto encode = [&]() {
+    const auto encoded = encoder.Encode(measurements, frames, cameras, buffer, delta);
+    return message.ParseFromArray(
+        encoded.data() + sizeof(uint32_t),
+        static_cast<int>(encoded.size() - sizeof(uint32_t)));
+  };
+
+  // First message has every agent.
+  ASSERT_TRUE(encode());
+  ASSERT_FALSE(message.non_player_agents_delta());
+  ASSERT_EQ(3, message.non_player_agents_size());
+
+  // Nothing moved beyond the threshold.
+  agents[0u].transform.location.x = 0.5f;
+  ASSERT_TRUE(encode());
+  ASSERT_TRUE(message.non_player_agents_delta());
+  ASSERT_EQ(0, message.non_player_agents_size());
+  ASSERT_EQ(0, message.removed_non_player_agents_size());
+
+  // Changes are accumulated against the last state sent, and agent 3 is gone.
+  agents[0u].transform.location.x = 1.5f;
+  measurements.number_of_non_player_agents = 2u;
+  ASSERT_TRUE(encode());
+  ASSERT_TRUE(message.non_player_agents_delta());
+  ASSERT_EQ(1, message.non_player_agents_size());
+  ASSERT_EQ(1u, message.non_player_agents(0).id());
+  ASSERT_EQ(1, message.removed_non_player_agents_size());
+  ASSERT_EQ(3u, message.removed_non_player_agents(0));
+
+  // Disabling the mode sends everything again.
+  encoder.SetDeltaAgents(false, 1.0f);
+  ASSERT_TRUE(encode());
+  ASSERT_FALSE(message.non_player_agents_delta());
+  ASSERT_EQ(2, message.non_player_agents_size());
+}
+
+TEST(CarlaEncoder, FrameTiming) {
+  using namespace carla::server;
+
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  const auto frames = carla::array_view::make_const<uint64_t>(nullptr, 0u);
+  const auto cameras = carla::array_view::make_const<uint32_t>(nullptr, 0u);
+
+  CarlaEncoder encoder;
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  carla_server::Measurements message;
+  auto encode = [&](const carla_frame_timing *timing) {
+    const auto encoded = encoder.Encode(measurements, frames, cameras, buffer, delta, 0u, 0u, timing);
+    return message.ParseFromArray(
+        encoded.data() + sizeof(uint32_t),
+        static_cast<int>(encoded.size() - sizeof(uint32_t)));
+  };
+
+  const carla_frame_timing timing = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f};
+  ASSERT_TRUE(encode(&timing));
+  ASSERT_TRUE(message.has_timing());
+  ASSERT_EQ(1.0f, message.timing().game_tick_ms());
+  ASSERT_EQ(2.0f, message.timing().ai_ms());
+  ASSERT_EQ(3.0f, message.timing().capture_readback_ms());
+  ASSERT_EQ(4.0f, message.timing().encode_ms());
+  ASSERT_EQ(5.0f, message.timing().queue_wait_ms());
+  ASSERT_EQ(6.0f, message.timing().send_ms());
+  ASSERT_EQ(7.0f, message.timing().pacing_wait_ms());
+  ASSERT_EQ(8.0f, message.timing().pacing_jitter_ms());
+
+  // The message is reused, the timing must not leak into the next one.
+  ASSERT_TRUE(encode(nullptr));
+  ASSERT_FALSE(message.has_timing());
+}
+
+TEST(CarlaEncoder, ControlLatency) {
+  using namespace carla::server;
+
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  const auto frames = carla::array_view::make_const<uint64_t>(nullptr, 0u);
+  const auto cameras = carla::array_view::make_const<uint32_t>(nullptr, 0u);
+
+  CarlaEncoder encoder;
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  carla_server::Measurements message;
+  auto encode = [&](const ControlLatency *latency) {
+    const auto encoded = encoder.Encode(
+        measurements,
+        frames,
+        cameras,
+        buffer,
+        delta,
+        0u,
+        0u,
+        nullptr,
+        nullptr,
+        carla::array_view::make_const<char>(nullptr, 0u),
+        nullptr,
+        nullptr,
+        nullptr,
+        latency);
+    return message.ParseFromArray(
+        encoded.data() + sizeof(uint32_t),
+        static_cast<int>(encoded.size() - sizeof(uint32_t)));
+  };
+
+  ControlLatency latency;
+  latency.sequence_number = 42u;
+  latency.receive_us = 1000u;
+  latency.apply_us = 2000u;
+  latency.capture_us = 3000u;
+  latency.send_us = 4000u;
+  ASSERT_TRUE(encode(&latency));
+  ASSERT_TRUE(message.has_control_latency());
+  ASSERT_EQ(42u, message.control_latency().last_applied_control_sequence());
+  ASSERT_EQ(1000u, message.control_latency().receive_us());
+  ASSERT_EQ(2000u, message.control_latency().apply_us());
+  ASSERT_EQ(3000u, message.control_latency().capture_us());
+  ASSERT_EQ(4000u, message.control_latency().send_us());
+
+  // The message is reused, the latency must not leak into the next one.
+  ASSERT_TRUE(encode(nullptr));
+  ASSERT_FALSE(message.has_control_latency());
+}
+
+TEST(CarlaEncoder, FlowControl) {
+  using namespace carla::server;
+
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  const auto frames = carla::array_view::make_const<uint64_t>(nullptr, 0u);
+  const auto cameras = carla::array_view::make_const<uint32_t>(nullptr, 0u);
+
+  CarlaEncoder encoder;
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  carla_server::Measurements message;
+  auto encode = [&](const FrameFlowControl *flow_control) {
+    const auto encoded = encoder.Encode(measurements, frames, cameras, buffer, delta, 0u, 0u, nullptr, flow_control);
+    return message.ParseFromArray(
+        encoded.data() + sizeof(uint32_t),
+        static_cast<int>(encoded.size() - sizeof(uint32_t)));
+  };
+
+  FrameFlowControl flow_control;
+  flow_control.server_frame_id = 42u;
+  flow_control.dropped_frames = 3u;
+  flow_control.queue_depth = 2u;
+  ASSERT_TRUE(encode(&flow_control));
+  ASSERT_TRUE(message.has_flow_control());
+  ASSERT_EQ(42u, message.flow_control().server_frame_id());
+  ASSERT_EQ(3u, message.flow_control().dropped_frames());
+  ASSERT_EQ(2u, message.flow_control().queue_depth());
+
+  ASSERT_TRUE(encode(nullptr));
+  ASSERT_FALSE(message.has_flow_control());
+}
+
+TEST(CarlaEncoder, AgentBoxes) {
+  using namespace carla::server;
+
+  const carla_agent_box_2d boxes[] = {
+    {7u, 1.0f, 2.0f, 3.0f, 4.0f, 0u},
+    {9u, 0.0f, 10.0f, 20.0f, 30.0f, CARLA_SERVER_AGENT_BOX_TRUNCATED | CARLA_SERVER_AGENT_BOX_OCCLUDED}
+  };
+  const carla_camera_agent_boxes cameras[] = {{3u, boxes, 2u}, {5u, nullptr, 0u}};
+  AgentBoxes agent_boxes;
+  agent_boxes.Write(carla::array_view::make_const(cameras, 2u));
+
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  CarlaEncoder encoder;
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  const auto encoded = encoder.Encode(
+      measurements,
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      buffer,
+      delta,
+      0u,
+      0u,
+      nullptr,
+      nullptr,
+      carla::array_view::make_const<char>(nullptr, 0u),
+      &agent_boxes);
+
+  carla_server::Measurements message;
+  ASSERT_TRUE(message.ParseFromArray(
+      encoded.data() + sizeof(uint32_t),
+      static_cast<int>(encoded.size() - sizeof(uint32_t))));
+  ASSERT_EQ(2, message.agent_boxes_size());
+  ASSERT_EQ(5u, message.agent_boxes(1).camera_index());
+  ASSERT_EQ(0u, message.agent_boxes(1).number_of_boxes());
+  const auto &camera = message.agent_boxes(0);
+  ASSERT_EQ(3u, camera.camera_index());
+  ASSERT_EQ(2u, camera.number_of_boxes());
+  ASSERT_EQ(24u * 2u, camera.data().size());
+  const char *data = camera.data().data();
+  uint32_t ids[2u];
+  float rects[2u][4u];
+  uint32_t flags[2u];
+  std::memcpy(ids, data, sizeof(ids));
+  std::memcpy(rects, data + sizeof(ids), sizeof(rects));
+  std::memcpy(flags, data + sizeof(ids) + sizeof(rects), sizeof(flags));
+  ASSERT_EQ(7u, ids[0u]);
+  ASSERT_EQ(9u, ids[1u]);
+  ASSERT_EQ(2.0f, rects[0u][1u]);
+  ASSERT_EQ(30.0f, rects[1u][3u]);
+  ASSERT_EQ(0u, flags[0u]);
+  ASSERT_EQ(CARLA_SERVER_AGENT_BOX_TRUNCATED | CARLA_SERVER_AGENT_BOX_OCCLUDED, flags[1u]);
+
+  // Without boxes the message carries none.
+  const auto empty = encoder.Encode(
+      measurements,
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      buffer,
+      delta);
+  ASSERT_TRUE(message.ParseFromArray(
+      empty.data() + sizeof(uint32_t),
+      static_cast<int>(empty.size() - sizeof(uint32_t))));
+  ASSERT_EQ(0, message.agent_boxes_size());
+}
+
+TEST(CarlaEncoder, ClassHistograms) {
+  using namespace carla::server;
+
+  const uint32_t counts[] = {100u, 0u, 25u, 7u};
+  const carla_class_histogram histograms[] = {{2u, counts, 4u}};
+  ClassHistograms class_histograms;
+  class_histograms.Write(carla::array_view::make_const(histograms, 1u));
+
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  CarlaEncoder encoder;
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  const auto encoded = encoder.Encode(
+      measurements,
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      buffer,
+      delta,
+      0u,
+      0u,
+      nullptr,
+      nullptr,
+      carla::array_view::make_const<char>(nullptr, 0u),
+      nullptr,
+      &class_histograms);
+
+  carla_server::Measurements message;
+  ASSERT_TRUE(message.ParseFromArray(
+      encoded.data() + sizeof(uint32_t),
+      static_cast<int>(encoded.size() - sizeof(uint32_t))));
+  ASSERT_EQ(0, message.agent_boxes_size());
+  ASSERT_EQ(1, message.class_histograms_size());
+  const auto &histogram = message.class_histograms(0);
+  ASSERT_EQ(2u, histogram.camera_index());
+  ASSERT_EQ(4, histogram.counts_size());
+  for (auto i = 0; i < 4; ++i) {
+    ASSERT_EQ(counts[i], histogram.counts(i));
+  }
+
+  // Cleared, the next message carries none.
+  class_histograms.Clear();
+  const auto empty = encoder.Encode(
+      measurements,
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      buffer,
+      delta,
+      0u,
+      0u,
+      nullptr,
+      nullptr,
+      carla::array_view::make_const<char>(nullptr, 0u),
+      nullptr,
+      &class_histograms);
+  ASSERT_TRUE(message.ParseFromArray(
+      empty.data() + sizeof(uint32_t),
+      static_cast<int>(empty.size() - sizeof(uint32_t))));
+  ASSERT_EQ(0, message.class_histograms_size());
+}
+
+TEST(CarlaEncoder, CollisionEvents) {
+  using namespace carla::server;
+
+  const carla_collision_event events[] = {{7u, 10u, 1500.0f}, {0u, 11u, 25.5f}};
+  CollisionEvents collision_events;
+  collision_events.Write(carla::array_view::make_const(events, 2u));
+
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  CarlaEncoder encoder;
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  const auto encoded = encoder.Encode(
+      measurements,
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      buffer,
+      delta,
+      0u,
+      0u,
+      nullptr,
+      nullptr,
+      carla::array_view::make_const<char>(nullptr, 0u),
+      nullptr,
+      nullptr,
+      &collision_events);
+
+  carla_server::Measurements message;
+  ASSERT_TRUE(message.ParseFromArray(
+      encoded.data() + sizeof(uint32_t),
+      static_cast<int>(encoded.size() - sizeof(uint32_t))));
+  ASSERT_EQ(2, message.collision_events_size());
+  for (auto i = 0; i < 2; ++i) {
+    const auto &event = message.collision_events(i);
+    ASSERT_EQ(events[i].other_actor_id, event.other_actor_id());
+    ASSERT_EQ(events[i].label, event.label());
+    ASSERT_EQ(events[i].normal_impulse, event.normal_impulse());
+  }
+
+  // Cleared, the next message carries none.
+  collision_events.Clear();
+  const auto empty = encoder.Encode(
+      measurements,
+      carla::array_view::make_const<uint64_t>(nullptr, 0u),
+      carla::array_view::make_const<uint32_t>(nullptr, 0u),
+      buffer,
+      delta,
+      0u,
+      0u,
+      nullptr,
+      nullptr,
+      carla::array_view::make_const<char>(nullptr, 0u),
+      nullptr,
+      nullptr,
+      &collision_events);
+  ASSERT_TRUE(message.ParseFromArray(
+      empty.data() + sizeof(uint32_t),
+      static_cast<int>(empty.size() - sizeof(uint32_t))));
+  ASSERT_EQ(0, message.collision_events_size());
+}
+
+TEST(CarlaEncoder, EpisodeSummary) {
+  using namespace carla::server;
+
+  const carla_transform start_spot{carla_vector3d{1.0f, 2.0f, 3.0f}, carla_vector3d{1.0f, 0.0f, 0.0f}};
+  carla_episode_summary summary;
+  std::memset(&summary, 0, sizeof(summary));
+  summary.number_of_frames = 300u;
+  summary.game_timestamp = 30000u;
+  summary.distance_traveled = 12345.0f;
+  summary.collision_vehicles = 2.5f;
+  summary.number_of_collisions = 2u;
+  summary.seconds_off_road = 1.5f;
+  summary.seconds_over_speed_limit = 4.0f;
+
+  CarlaEncoder encoder;
+  carla_scene_description values{&start_spot, 1u, &summary};
+  carla_server::SceneDescription message;
+  ASSERT_TRUE(message.ParseFromString(encoder.Encode(values).substr(4u)));
+  ASSERT_EQ(1, message.player_start_spots_size());
+  ASSERT_TRUE(message.has_previous_episode_summary());
+  const auto &totals = message.previous_episode_summary();
+  ASSERT_EQ(300u, totals.number_of_frames());
+  ASSERT_EQ(30000u, totals.game_timestamp());
+  ASSERT_EQ(12345.0f, totals.distance_traveled());
+  ASSERT_EQ(2.5f, totals.collision_vehicles());
+  ASSERT_EQ(0.0f, totals.collision_pedestrians());
+  ASSERT_EQ(2u, totals.number_of_collisions());
+  ASSERT_EQ(1.5f, totals.seconds_off_road());
+  ASSERT_EQ(4.0f, totals.seconds_over_speed_limit());
+
+  // The first episode has no previous one.
+  values.previous_episode_summary = nullptr;
+  ASSERT_TRUE(message.ParseFromString(encoder.Encode(values).substr(4u)));
+  ASSERT_FALSE(message.has_previous_episode_summary());
+}
+
+TEST(CarlaEncoder, DecodeControlBatch) {
+  using namespace carla::server;
+
+  carla_server::Control message;
+  message.set_steer(0.5f);
+  message.set_sequence_number(10u);
+  for (auto i = 1u; i <= 3u; ++i) {
+    auto *next = message.add_next_controls();
+    next->set_throttle(0.1f * i);
+    next->set_sequence_number(10u + i);
+  }
+  message.set_skip_intermediate_measurements(true);
+  const auto encoded = message.SerializeAsString();
+  const auto view = carla::array_view::make_const(encoded.data(), encoded.size());
+
+  CarlaEncoder encoder;
+  ControlBatch batch;
+  ASSERT_TRUE(encoder.Decode(view, batch));
+  ASSERT_EQ(4u, batch.controls.size());
+  ASSERT_EQ(0.5f, batch.controls[0u].steer);
+  for (auto i = 1u; i <= 3u; ++i) {
+    ASSERT_EQ(0.1f * i, batch.controls[i].throttle);
+  }
+  for (auto i = 0u; i <= 3u; ++i) {
+    ASSERT_EQ(10u + i, batch.controls[i].sequence_number);
+  }
+  ASSERT_TRUE(batch.skip_intermediate_measurements);
+  ASSERT_EQ(0u, batch.measurements_credit);
+
+  // A single control decodes as a batch of one.
+  carla_server::Control single;
+  single.set_brake(1.0f);
+  single.set_measurements_credit(5u);
+  const auto encoded_single = single.SerializeAsString();
+  ASSERT_TRUE(encoder.Decode(
+      carla::array_view::make_const(encoded_single.data(), encoded_single.size()),
+      batch));
+  ASSERT_EQ(1u, batch.controls.size());
+  ASSERT_EQ(1.0f, batch.controls[0u].brake);
+  ASSERT_FALSE(batch.skip_intermediate_measurements);
+  ASSERT_EQ(5u, batch.measurements_credit);
+}
+
+TEST(CarlaEncoder, DecodeObservationRequest) {
+  using namespace carla::server;
+
+  carla_server::Control message;
+  auto *request = message.mutable_observation_request();
+  request->add_sensors(2u);
+  request->add_sensors(0u);
+  request->set_agent_boxes(true);
+  const auto encoded = message.SerializeAsString();
+
+  CarlaEncoder encoder;
+  ControlBatch batch;
+  ASSERT_TRUE(encoder.Decode(carla::array_view::make_const(encoded.data(), encoded.size()), batch));
+  ASSERT_TRUE(batch.has_observation_request);
+  ASSERT_EQ((std::vector<uint32_t>{2u, 0u}), batch.observed_sensors);
+  ASSERT_FALSE(batch.observe_non_player_agents);
+  ASSERT_TRUE(batch.observe_agent_boxes);
+  ASSERT_FALSE(batch.observe_class_histograms);
+
+  // An empty request observes nothing, but still is a request.
+  carla_server::Control empty;
+  empty.mutable_observation_request();
+  const auto encoded_empty = empty.SerializeAsString();
+  ASSERT_TRUE(encoder.Decode(carla::array_view::make_const(encoded_empty.data(), encoded_empty.size()), batch));
+  ASSERT_TRUE(batch.has_observation_request);
+  ASSERT_TRUE(batch.observed_sensors.empty());
+
+  // Without a request everything is observed again.
+  carla_server::Control none;
+  const auto encoded_none = none.SerializeAsString();
+  ASSERT_TRUE(encoder.Decode(carla::array_view::make_const(encoded_none.data(), encoded_none.size()), batch));
+  ASSERT_FALSE(batch.has_observation_request);
+}
+
+TEST(CarlaEncoder, Capabilities) {
+  using namespace carla::server;
+
+  CarlaEncoder encoder;
+  auto decode = [&](const carla_server::RequestNewEpisode &message) {
+    const auto encoded = message.SerializeAsString();
+    RequestNewEpisode request;
+    EXPECT_TRUE(encoder.Decode(carla::array_view::make_const(encoded.data(), encoded.size()), request));
+    return request.capabilities;
+  };
+
+  // A client that does not negotiate supports everything.
+  carla_server::RequestNewEpisode message;
+  const auto all = decode(message);
+  ASSERT_TRUE(all.Has(Capability::PackedAgents));
+  ASSERT_TRUE(all.Has(Capability::SharedMemoryImages));
+  ASSERT_TRUE(all.Has(Capability::GpuSharedImages));
+  ASSERT_FALSE(all.Has(Capability::FlatMeasurements));
+
+  message.add_capabilities(carla_server::CAPABILITY_NONE);
+  const auto none = decode(message);
+  ASSERT_FALSE(none.Has(Capability::PackedAgents));
+  ASSERT_FALSE(none.Has(Capability::BinaryControl));
+
+  message.add_capabilities(carla_server::CAPABILITY_BINARY_CONTROL);
+  message.add_capabilities(static_cast<carla_server::Capability>(100));
+  const auto binary_control = decode(message);
+  ASSERT_TRUE(binary_control.Has(Capability::BinaryControl));
+  ASSERT_FALSE(binary_control.Has(Capability::CompressedImages));
+
+  EpisodeReady ready;
+  std::memset(&ready.values, 0, sizeof(ready.values));
+  ready.episode_id = 1u;
+  ready.persistent_agent_connections = false;
+  ready.agent_connections_reused = false;
+  ready.number_of_agents = 1u;
+  ready.separate_images_stream = false;
+  ready.capabilities = binary_control;
+  carla_server::EpisodeReady answer;
+  const auto encoded = encoder.Encode(ready);
+  ASSERT_TRUE(answer.ParseFromArray(encoded.data() + 4u, static_cast<int>(encoded.size() - 4u)));
+  ASSERT_TRUE(answer.binary_control());
+  ASSERT_EQ(1, answer.capabilities_size());
+  ASSERT_EQ(carla_server::CAPABILITY_BINARY_CONTROL, answer.capabilities(0));
+}
+
+TEST(CarlaEncoder, FlatMeasurements) {
+  using namespace carla::server;
+  using Layout = FlatMeasurements;
+
+  carla_agent agents[3u];
+  std::memset(agents, 0, sizeof(agents));
+  for (auto i = 0u; i < 3u; ++i) {
+    agents[i].id = i + 1u;
+    agents[i].type = CARLA_SERVER_AGENT_PEDESTRIAN;
+    agents[i].transform.location = {100.0f * i, 2.0f, 3.0f};
+    agents[i].box_extent = {1.0f, 2.0f, 0.5f * i};
+    agents[i].forward_speed = 10.0f * i;
+  }
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  measurements.frame_number = 42u;
+  measurements.platform_timestamp = 7u;
+  measurements.game_timestamp = 1234u;
+  measurements.player_measurements.transform.location = {1.0f, 2.0f, 3.0f};
+  measurements.player_measurements.forward_speed = 50.0f;
+  measurements.player_measurements.ai_control.steer = -0.5f;
+  measurements.player_measurements.ai_control.reverse = true;
+  measurements.non_player_agents = agents;
+  measurements.number_of_non_player_agents = 3u;
+  const uint64_t frames[] = {40u, 41u};
+  const uint32_t cameras[] = {0u, 2u};
+
+  const carla_agent_box_2d boxes[] = {{7u, 1.0f, 2.0f, 3.0f, 4.0f, 0u}};
+  const carla_camera_agent_boxes camera_boxes[] = {{2u, boxes, 1u}};
+  AgentBoxes agent_boxes;
+  agent_boxes.Write(carla::array_view::make_const(camera_boxes, 1u));
+  const uint32_t counts[] = {100u, 0u, 25u};
+  const carla_class_histogram histograms[] = {{0u, counts, 3u}};
+  ClassHistograms class_histograms;
+  class_histograms.Write(carla::array_view::make_const(histograms, 1u));
+  const carla_collision_event events[] = {{2u, 10u, 500.0f}};
+  CollisionEvents collision_events;
+  collision_events.Write(carla::array_view::make_const(events, 1u));
+  const carla_frame_timing timing = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f};
+
+  CarlaEncoder encoder;
+  encoder.SetFlatMeasurements(true);
+  std::vector<char> buffer;
+  AgentsDelta delta;
+  auto encode = [&]() {
+    return encoder.Encode(
+        measurements,
+        carla::array_view::make_const(frames, 2u),
+        carla::array_view::make_const(cameras, 2u),
+        buffer,
+        delta,
+        0u,
+        3u,
+        &timing,
+        nullptr,
+        carla::array_view::make_const<char>(nullptr, 0u),
+        &agent_boxes,
+        &class_histograms,
+        &collision_events);
+  };
+  const auto encoded = encode();
+  uint32_t size;
+  std::memcpy(&size, encoded.data(), sizeof(size));
+  ASSERT_EQ(encoded.size(), sizeof(size) + size);
+
+  // Received into a buffer of its own, as a client does.
+  std::vector<uint64_t> received((size + 7u) / 8u);
+  std::memcpy(received.data(), encoded.data() + sizeof(size), size);
+  const FlatMeasurementsView view(carla::array_view::make_const(
+      reinterpret_cast<const char *>(received.data()),
+      size));
+  ASSERT_TRUE(view.IsValid());
+  const auto &header = view.header();
+  ASSERT_EQ(42u, header.frame_number);
+  ASSERT_EQ(3u, header.episode_id);
+  ASSERT_EQ(7u, header.platform_timestamp);
+  ASSERT_EQ(1234u, header.game_timestamp);
+  ASSERT_EQ(2.0f, header.player.location.y);
+  ASSERT_EQ(50.0f, header.player.forward_speed);
+  ASSERT_EQ(-0.5f, header.player.ai_steer);
+  ASSERT_EQ(uint32_t(Layout::REVERSE), header.player.ai_flags);
+  ASSERT_TRUE(view.has(Layout::HAS_TIMING));
+  ASSERT_FALSE(view.has(Layout::HAS_FLOW_CONTROL));
+  ASSERT_FALSE(view.has(Layout::HAS_CONTROL_LATENCY));
+  ASSERT_FALSE(view.has(Layout::AGENTS_DELTA));
+  ASSERT_EQ(8.0f, header.timing.pacing_jitter);
+  ASSERT_EQ(2u, view.image_frame_numbers().size());
+  ASSERT_EQ(41u, view.image_frame_numbers()[1u]);
+  ASSERT_EQ(2u, view.image_camera_indices()[1u]);
+
+  const auto flat_agents = view.agents();
+  ASSERT_EQ(3u, flat_agents.size());
+  ASSERT_EQ(3u, flat_agents[2u].id);
+  ASSERT_EQ(uint32_t(CARLA_SERVER_AGENT_PEDESTRIAN), flat_agents[2u].type);
+  ASSERT_EQ(200.0f, flat_agents[2u].location.x);
+  ASSERT_EQ(1.0f, flat_agents[2u].box_extent.z);
+  ASSERT_EQ(20.0f, flat_agents[2u].forward_speed);
+  ASSERT_EQ(0u, view.removed_agents().size());
+
+  ASSERT_EQ(1u, view.collision_events().size());
+  ASSERT_EQ(500.0f, view.collision_events()[0u].normal_impulse);
+  ASSERT_EQ(1u, view.agent_boxes().size());
+  const auto &camera_box = view.agent_boxes()[0u];
+  ASSERT_EQ(2u, camera_box.camera_index);
+  ASSERT_EQ(1u, camera_box.count);
+  ASSERT_EQ(agent_boxes.cameras()[0u].data, std::string(view.boxes(camera_box).begin(), view.boxes(camera_box).end()));
+  ASSERT_EQ(1u, view.class_histograms().size());
+  const auto flat_counts = view.counts(view.class_histograms()[0u]);
+  ASSERT_EQ(3u, flat_counts.size());
+  ASSERT_EQ(25u, flat_counts[2u]);
+
+  // In delta agents mode only the agents that changed are sent.
+  encoder.SetDeltaAgents(true, 1.0f);
+  encode();
+  agents[1u].transform.location.x += 10.0f;
+  measurements.number_of_non_player_agents = 2u;
+  const auto second = encode();
+  std::memcpy(&size, second.data(), sizeof(size));
+  received.resize((size + 7u) / 8u);
+  std::memcpy(received.data(), second.data() + sizeof(size), size);
+  const FlatMeasurementsView delta_view(carla::array_view::make_const(
+      reinterpret_cast<const char *>(received.data()),
+      size));
+  ASSERT_TRUE(delta_view.IsValid());
+  ASSERT_TRUE(delta_view.has(Layout::AGENTS_DELTA));
+  ASSERT_EQ(1u, delta_view.agents().size());
+  ASSERT_EQ(2u, delta_view.agents()[0u].id);
+  ASSERT_EQ(1u, delta_view.removed_agents().size());
+  ASSERT_EQ(3u, delta_view.removed_agents()[0u]);
+
+  // Truncated or corrupted messages are rejected.
+  ASSERT_FALSE(FlatMeasurementsView(carla::array_view::make_const(
+      reinterpret_cast<const char *>(received.data()),
+      size - 8u)).IsValid());
+  reinterpret_cast<Layout::Header *>(received.data())->sections[Layout::Agents].count = 1000u;
+  ASSERT_FALSE(delta_view.IsValid());
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <atomic>
 #include <future>
 #include <iostream>
@@ -53,7 +54,7 @@ TEST(CarlaServerAPI, SimBlocking) {
   constexpr uint32_t ImageSizeY = 200u;
   const uint32_t image0[ImageSizeX*ImageSizeY] = {0u};
   const carla_image images[] = {
-    {ImageSizeX, ImageSizeY, 1u, image0}
+    {ImageSizeX, ImageSizeY, 1u, image0, 0u, 0u, CARLA_SERVER_IMAGE_BGRA8, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u}
   };
 
   const carla_transform start_locations[] = {
@@ -83,7 +84,8 @@ TEST(CarlaServerAPI, SimBlocking) {
       test_log("sending scene description...");
       const carla_scene_description values{
           start_locations,
-          SIZE_OF_ARRAY(start_locations)};
+          SIZE_OF_ARRAY(start_locations),
+          nullptr};
       ASSERT_EQ(S, carla_write_scene_description(CarlaServer, values, TIMEOUT));
     }
     {
@@ -138,3 +140,86 @@ TEST(CarlaServerAPI, SimBlocking) {
   }
   test_log("###### End Test ######");
 }
+
+// Same as SimBlocking, but images are written directly into the server's
+// buffer, and everything runs in a single thread as in the game.
+TEST(CarlaServerAPI, SimBlockingZeroCopy) {
+  auto CarlaServerGuard = make_carla_server();
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  constexpr uint32_t ImageSizeX = 300u;
+  constexpr uint32_t ImageSizeY = 200u;
+  const carla_image images[] = {
+    {ImageSizeX, ImageSizeY, 1u, nullptr, 0u, 0u, CARLA_SERVER_IMAGE_BGRA8, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u}
+  };
+
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}},
+    {carla_vector3d{1.0f, 1.0f, 0.0f}, carla_vector3d{1.0f, 1.0f, 0.0f}}
+  };
+
+  const auto S = CARLA_SERVER_SUCCESS;
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, PORT, TIMEOUT));
+
+  {
+    carla_request_new_episode values;
+    ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  }
+
+  for (auto i = 0u; i < 3u; ++i) {
+    {
+      const carla_scene_description values{
+          start_locations,
+          SIZE_OF_ARRAY(start_locations),
+          nullptr};
+      ASSERT_EQ(S, carla_write_scene_description(CarlaServer, values, TIMEOUT));
+    }
+    {
+      carla_episode_start values;
+      ASSERT_EQ(S, carla_read_episode_start(CarlaServer, values, TIMEOUT));
+    }
+    {
+      const carla_episode_ready values{true};
+      ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, values, TIMEOUT));
+    }
+
+    std::array<carla_agent, 10u> agents_data;
+
+    for (;;) {
+      {
+        carla_request_new_episode new_episode;
+        auto ec = carla_read_request_new_episode(CarlaServer, new_episode, 0);
+        ASSERT_TRUE((ec == S) || (ec == CARLA_SERVER_TRY_AGAIN));
+        if (ec == S) {
+          test_log("received new episode request");
+          break;
+        }
+      }
+      {
+        uint32_t *image_data[SIZE_OF_ARRAY(images)];
+        auto ec = carla_acquire_image_buffer(CarlaServer, images, SIZE_OF_ARRAY(images), image_data);
+        if (ec != S) {
+          test_log("error acquiring image buffer, waiting for new episode");
+          std::this_thread::sleep_for(std::chrono::milliseconds(16));
+          continue;
+        }
+        std::fill_n(image_data[0u], ImageSizeX * ImageSizeY, 0u);
+        carla_measurements measurements;
+        measurements.non_player_agents = agents_data.data();
+        measurements.number_of_non_player_agents = agents_data.size();
+        ec = carla_commit_image_buffer(CarlaServer, measurements);
+        ASSERT_TRUE((ec == S) || (ec == CARLA_SERVER_OPERATION_ABORTED));
+      }
+      {
+        carla_control control;
+        auto ec = carla_read_control(CarlaServer, control, TIMEOUT);
+        if ((ec != S) && (ec != CARLA_SERVER_TRY_AGAIN)) {
+          test_log("error reading control, waiting for new episode");
+          std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        }
+      }
+    }
+  }
+}
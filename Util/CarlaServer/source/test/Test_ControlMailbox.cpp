@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <carla/server/ControlMailbox.h>
+
+#include <atomic>
+#include <future>
+
+static carla_control MakeControl(float value) {
+  return carla_control{value, value, value, false, true, 0u};
+}
+
+TEST(ControlMailbox, LatestWins) {
+  using namespace carla::server;
+
+  ControlMailbox mailbox;
+  ControlMailbox::Latest latest;
+  ASSERT_FALSE(mailbox.Read(latest));
+
+  mailbox.SetFrameNumber(10u);
+  mailbox.Publish(MakeControl(1.0f));
+  mailbox.Publish(MakeControl(2.0f));
+  mailbox.SetFrameNumber(13u);
+
+  ASSERT_TRUE(mailbox.Read(latest));
+  ASSERT_EQ(2.0f, latest.control.steer);
+  ASSERT_TRUE(latest.control.reverse);
+  ASSERT_EQ(2u, latest.number_of_controls);
+  ASSERT_EQ(3u, latest.age_in_frames);
+  ASSERT_GE(latest.age.count(), 0);
+
+  // Reading does not consume it.
+  ASSERT_TRUE(mailbox.Read(latest));
+  ASSERT_EQ(2.0f, latest.control.steer);
+
+  mailbox.Clear();
+  ASSERT_FALSE(mailbox.Read(latest));
+  mailbox.Publish(MakeControl(3.0f));
+  ASSERT_TRUE(mailbox.Read(latest));
+  ASSERT_EQ(3.0f, latest.control.steer);
+  ASSERT_EQ(1u, latest.number_of_controls);
+  ASSERT_EQ(0u, latest.age_in_frames);
+}
+
+TEST(ControlMailbox, ConcurrentReads) {
+  using namespace carla::server;
+
+  ControlMailbox mailbox;
+  constexpr uint32_t numberOfControls = 100000u;
+  std::atomic_bool done{false};
+
+  auto reader = std::async(std::launch::async, [&]() {
+    uint64_t last = 0u;
+    while (!done) {
+      ControlMailbox::Latest latest;
+      if (mailbox.Read(latest)) {
+        // Never torn, and never older than a control already read.
+        EXPECT_EQ(latest.control.steer, latest.control.throttle);
+        EXPECT_EQ(latest.control.steer, latest.control.brake);
+        EXPECT_EQ(static_cast<float>(latest.number_of_controls), latest.control.steer);
+        EXPECT_GE(latest.number_of_controls, last);
+        last = latest.number_of_controls;
+      }
+    }
+  });
+
+  for (uint32_t i = 1u; i <= numberOfControls; ++i) {
+    mailbox.Publish(MakeControl(static_cast<float>(i)));
+  }
+  done = true;
+  reader.get();
+
+  ControlMailbox::Latest latest;
+  ASSERT_TRUE(mailbox.Read(latest));
+  ASSERT_EQ(numberOfControls, latest.number_of_controls);
+}
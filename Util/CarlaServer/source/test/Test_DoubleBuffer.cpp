@@ -144,3 +144,39 @@ TEST(DoubleBuffer, LongMessage) {
   result_reader.get();
   result_writer.get();
 }
+
+TEST(DoubleBuffer, SpinWait) {
+  using namespace carla::server;
+
+  DoubleBuffer<size_t> ping;
+  DoubleBuffer<size_t> pong;
+
+  SpinWait wait;
+  wait.spins = 1000u;
+  wait.yields = 100u;
+
+  constexpr auto numberOfRoundTrips = 200u;
+  const time_duration timeout = boost::posix_time::seconds(1u);
+
+  // Lockstep, every value is written only once and read back before the
+  // next one, so none may be missed by the polling.
+  auto result_echo = std::async(std::launch::async, [&](){
+    for (size_t i = 0u; i < numberOfRoundTrips; ++i) {
+      auto reader = ping.TryMakeReader(timeout, wait);
+      ASSERT_TRUE(reader != nullptr);
+      ASSERT_EQ(i, *reader);
+      *pong.MakeWriter() = *reader;
+    }
+  });
+
+  for (size_t i = 0u; i < numberOfRoundTrips; ++i) {
+    *ping.MakeWriter() = i;
+    auto reader = pong.TryMakeReader(timeout, wait);
+    ASSERT_TRUE(reader != nullptr);
+    ASSERT_EQ(i, *reader);
+  }
+  result_echo.get();
+
+  // Nothing to read, polls and then times out.
+  ASSERT_TRUE(pong.TryMakeReader(std::chrono::milliseconds(1), wait) == nullptr);
+}
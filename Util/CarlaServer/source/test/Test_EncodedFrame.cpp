@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <carla/server/EncodedFrame.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace carla::server;
+
+static std::string ToString(const const_buffer buffer) {
+  return std::string(
+      boost::asio::buffer_cast<const char *>(buffer),
+      boost::asio::buffer_size(buffer));
+}
+
+TEST(EncodedFrame, Make) {
+  const std::string measurements = "measurements";
+  const std::string images = "images";
+  const auto frame = EncodedFrame::Make(boost::asio::buffer(measurements), boost::asio::buffer(images));
+  ASSERT_EQ(measurements.size() + images.size(), frame->size());
+  ASSERT_EQ(measurements, ToString(frame->measurements()));
+  ASSERT_EQ(images, ToString(frame->images()));
+  ASSERT_EQ(measurements + images, ToString(frame->buffer()));
+}
+
+TEST(EncodedFrame, PoolRecyclesFrames) {
+  EncodedFramePool pool(2u);
+  const std::string data(1024u, 'x');
+  const EncodedFrame *first;
+  {
+    const auto frame = pool.Make(boost::asio::buffer(data), boost::asio::buffer(data));
+    first = frame.get();
+    // Every sink shares the same frame.
+    auto copy = frame;
+    ASSERT_EQ(first, copy.get());
+    ASSERT_EQ(0u, pool.GetStats().number_of_free_frames);
+  }
+  ASSERT_EQ(1u, pool.GetStats().number_of_free_frames);
+  {
+    const auto frame = pool.Make(boost::asio::buffer(data, 10u), boost::asio::buffer(data, 20u));
+    ASSERT_EQ(first, frame.get());
+    ASSERT_EQ(30u, frame->size());
+    ASSERT_EQ(10u, boost::asio::buffer_size(frame->measurements()));
+  }
+  {
+    // Only two idle frames are kept.
+    std::vector<EncodedFramePtr> frames;
+    for (auto i = 0u; i < 4u; ++i) {
+      frames.emplace_back(pool.Make(boost::asio::buffer(data), boost::asio::buffer(data)));
+    }
+  }
+  const auto stats = pool.GetStats();
+  ASSERT_EQ(6u, stats.number_of_frames);
+  ASSERT_EQ(4u, stats.number_of_allocations);
+  ASSERT_EQ(2u, stats.number_of_free_frames);
+}
+
+TEST(EncodedFrame, ReleasedAfterThePool) {
+  EncodedFramePtr frame;
+  {
+    EncodedFramePool pool;
+    frame = pool.Make(boost::asio::buffer("a", 1u), boost::asio::buffer("b", 1u));
+  }
+  ASSERT_EQ("ab", ToString(frame->buffer()));
+  frame = nullptr;
+}
+
+TEST(EncodedFrame, ReleasedFromManyThreads) {
+  EncodedFramePool pool;
+  const std::string data(64u, 'x');
+  for (auto i = 0u; i < 100u; ++i) {
+    const auto frame = pool.Make(boost::asio::buffer(data), boost::asio::buffer(data));
+    std::vector<std::thread> threads;
+    for (auto j = 0u; j < 4u; ++j) {
+      threads.emplace_back([frame]() { ASSERT_EQ(128u, frame->size()); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+  ASSERT_EQ(1u, pool.GetStats().number_of_allocations);
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include <carla/server/FlowControl.h>
+
+#include <chrono>
+#include <future>
+
+TEST(MeasurementsCredits, NoCreditNeverBlocks) {
+  using namespace carla::server;
+
+  MeasurementsCredits credits;
+  for (auto i = 0u; i < 10u; ++i) {
+    credits.Acquire();
+  }
+  credits.Grant(0u);
+  credits.Acquire();
+}
+
+TEST(MeasurementsCredits, WaitsForCredit) {
+  using namespace carla::server;
+
+  MeasurementsCredits credits;
+  credits.Grant(2u);
+  credits.Acquire();
+  credits.Acquire();
+
+  auto sender = std::async(std::launch::async, [&]() { credits.Acquire(); });
+  ASSERT_EQ(
+      std::future_status::timeout,
+      sender.wait_for(std::chrono::milliseconds(50)));
+  credits.Grant(1u);
+  ASSERT_EQ(
+      std::future_status::ready,
+      sender.wait_for(std::chrono::seconds(5)));
+}
+
+TEST(MeasurementsCredits, ResetWakesUpTheSender) {
+  using namespace carla::server;
+
+  MeasurementsCredits credits;
+  credits.Grant(1u);
+  credits.Acquire();
+
+  auto sender = std::async(std::launch::async, [&]() { credits.Acquire(); });
+  ASSERT_EQ(
+      std::future_status::timeout,
+      sender.wait_for(std::chrono::milliseconds(50)));
+  credits.Reset();
+  ASSERT_EQ(
+      std::future_status::ready,
+      sender.wait_for(std::chrono::seconds(5)));
+
+  // Back to sending without credit.
+  credits.Acquire();
+}
@@ -0,0 +1,301 @@
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include <carla/client/ImageHistory.h>
+#include <carla/server/ImagesDelta.h>
+#include <carla/server/ImagesMessage.h>
+#include <carla/server/LZ4.h>
+#include <carla/StridedView.h>
+
+#include <cstring>
+#include <vector>
+
+TEST(ImagesMessage, Encodings) {
+  using namespace carla::server;
+
+  const uint8_t labels[3u * 2u] = {1u, 2u, 3u, 4u, 5u, 6u};
+  const float depth[3u * 2u] = {0.5f, 1.0f, 1.5f, 2.0f, 2.5f, 3.0f};
+  const carla_image images[] = {
+    {3u, 2u, 3u, reinterpret_cast<const uint32_t *>(labels), 0u, 0u, CARLA_SERVER_IMAGE_GRAY8, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u},
+    {3u, 2u, 2u, reinterpret_cast<const uint32_t *>(depth), 0u, 1u, CARLA_SERVER_IMAGE_FLOAT32, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 50u, 0u}
+  };
+
+  ImagesMessage message;
+  message.Write(carla::array_view::make_const(images, 2u));
+
+  const auto buffer = message.buffer();
+  const auto *data = boost::asio::buffer_cast<const unsigned char *>(buffer);
+  auto read_uint = [&](size_t index) {
+    uint32_t value;
+    std::memcpy(&value, data + sizeof(uint32_t) * index, sizeof(value));
+    return value;
+  };
+  // total size, version, number of images, then the table.
+  ASSERT_EQ(2u, read_uint(2u));
+  constexpr size_t first = 3u;
+  constexpr size_t second = first + ImagesMessage::HeaderEntrySize;
+  ASSERT_EQ(3u, read_uint(first + 4u)); // stride.
+  ASSERT_EQ(0u + ImagesMessage::RawGray8, read_uint(first + 5u));
+  ASSERT_EQ(12u, read_uint(second + 4u));
+  ASSERT_EQ(0u + ImagesMessage::RawFloat32, read_uint(second + 5u));
+  ASSERT_EQ(100u, read_uint(first + 6u)); // screen percentage, zero is 100.
+  ASSERT_EQ(50u, read_uint(second + 6u));
+
+  // Offsets are relative to right after the total size.
+  const auto *message_begin = data + sizeof(uint32_t);
+  ASSERT_EQ(0, std::memcmp(message_begin + read_uint(first), labels, sizeof(labels)));
+  ASSERT_EQ(0, std::memcmp(message_begin + read_uint(second), depth, sizeof(depth)));
+  ASSERT_EQ(0u, read_uint(second) % ImagesMessage::Alignment);
+
+  ASSERT_EQ(4u, ImagesMessage::GetBytesPerPixel(ImagesMessage::RawMotionVectors));
+  ASSERT_EQ(0u, ImagesMessage::GetBytesPerPixel(42u));
+}
+
+TEST(ImagesMessage, PointCloud) {
+  using namespace carla::server;
+
+  const float points[2u * 4u] = {1.0f, 2.0f, 3.0f, 7.0f, -4.0f, 5.0f, -6.0f, 0.0f};
+  const carla_image images[] = {
+    {2u, 1u, 4u, reinterpret_cast<const uint32_t *>(points), 0u, 3u, CARLA_SERVER_IMAGE_POINTS_XYZL, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u}
+  };
+
+  ImagesMessage message;
+  message.Write(carla::array_view::make_const(images, 1u));
+
+  const auto buffer = message.buffer();
+  const auto *data = boost::asio::buffer_cast<const unsigned char *>(buffer);
+  auto read_uint = [&](size_t index) {
+    uint32_t value;
+    std::memcpy(&value, data + sizeof(uint32_t) * index, sizeof(value));
+    return value;
+  };
+  constexpr size_t first = 3u;
+  ASSERT_EQ(1u, read_uint(2u));
+  ASSERT_EQ(2u, read_uint(first + 1u)); // width, one per point.
+  ASSERT_EQ(1u, read_uint(first + 2u));
+  ASSERT_EQ(4u, read_uint(first + 3u)); // type.
+  ASSERT_EQ(sizeof(points), read_uint(first + 4u)); // stride.
+  ASSERT_EQ(0u + ImagesMessage::RawPointsXYZL, read_uint(first + 5u));
+  const auto *message_begin = data + sizeof(uint32_t);
+  ASSERT_EQ(0, std::memcmp(message_begin + read_uint(first), points, sizeof(points)));
+  ASSERT_EQ(16u, ImagesMessage::GetBytesPerPixelOnTheWire(ImagesMessage::RawPointsXYZL));
+}
+
+TEST(ImagesMessage, RowPitch) {
+  using namespace carla::server;
+
+  // A 3x2 crop at (1, 1) of a 4x3 label image with 8-byte rows.
+  const uint8_t labels[8u * 3u] = {
+    0u, 0u, 0u, 0u, 9u, 9u, 9u, 9u,
+    0u, 1u, 2u, 3u, 9u, 9u, 9u, 9u,
+    0u, 4u, 5u, 6u, 9u, 9u, 9u, 9u
+  };
+  const auto full = carla::strided_view::make_const(labels, 4u, 3u, 8u);
+  ASSERT_FALSE(full.is_contiguous());
+  const auto crop = full.subview(1u, 1u, 3u, 2u);
+  ASSERT_EQ(5u, crop(1u, 1u));
+  ASSERT_EQ(3u, crop.row(0u).size());
+  ASSERT_TRUE(carla::strided_view::make_const(labels, 8u, 3u).is_contiguous());
+
+  carla_image image = {3u, 2u, 3u, reinterpret_cast<const uint32_t *>(crop.data()), 0u, 0u, CARLA_SERVER_IMAGE_GRAY8, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u};
+  image.row_pitch = static_cast<uint32_t>(crop.row_pitch());
+
+  ImagesMessage message;
+  message.Write(carla::array_view::make_const(&image, 1u));
+
+  const auto buffer = message.buffer();
+  const auto *data = boost::asio::buffer_cast<const unsigned char *>(buffer);
+  uint32_t offset;
+  std::memcpy(&offset, data + sizeof(uint32_t) * 3u, sizeof(offset));
+  uint32_t stride;
+  std::memcpy(&stride, data + sizeof(uint32_t) * 7u, sizeof(stride));
+  ASSERT_EQ(3u, stride);
+  const uint8_t expected[] = {1u, 2u, 3u, 4u, 5u, 6u};
+  ASSERT_EQ(0, std::memcmp(data + sizeof(uint32_t) + offset, expected, sizeof(expected)));
+}
+
+TEST(ImagesMessage, GPUShared) {
+  using namespace carla::server;
+
+  const carla_gpu_shared_image shared = {0x1234u, 800u, 600u, 87u, 2u};
+  const carla_image images[] = {
+    {1u, 1u, 1u, reinterpret_cast<const uint32_t *>(&shared), 0u, 0u, CARLA_SERVER_IMAGE_GPU_SHARED, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u}
+  };
+
+  ImagesMessage message;
+  message.Write(carla::array_view::make_const(images, 1u));
+
+  const auto buffer = message.buffer();
+  const auto *data = boost::asio::buffer_cast<const unsigned char *>(buffer);
+  auto read_uint = [&](size_t index) {
+    uint32_t value;
+    std::memcpy(&value, data + sizeof(uint32_t) * index, sizeof(value));
+    return value;
+  };
+  constexpr size_t first = 3u;
+  ASSERT_EQ(sizeof(shared), read_uint(first + 4u)); // stride.
+  const auto *message_begin = data + sizeof(uint32_t);
+  carla_gpu_shared_image read;
+  std::memcpy(&read, message_begin + read_uint(first), sizeof(read));
+  ASSERT_EQ(shared.handle, read.handle);
+  ASSERT_EQ(shared.slot, read.slot);
+}
+
+TEST(ImagesMessage, Compression) {
+  using namespace carla::server;
+
+  std::vector<uint8_t> labels(64u * 32u, 7u);
+  const uint8_t plain[4u] = {1u, 2u, 3u, 4u};
+  const carla_image images[] = {
+    {64u, 32u, 3u, reinterpret_cast<const uint32_t *>(labels.data()), 0u, 0u, CARLA_SERVER_IMAGE_GRAY8, CARLA_SERVER_IMAGE_COMPRESSION_LZ4, 0u, 0u, 0u},
+    {1u, 1u, 1u, reinterpret_cast<const uint32_t *>(plain), 0u, 1u, CARLA_SERVER_IMAGE_BGRA8, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u}
+  };
+
+  ImagesMessage message;
+  message.Write(carla::array_view::make_const(images, 2u));
+
+  std::vector<unsigned char> encode_buffer;
+  const auto buffer = message.Encode(encode_buffer);
+  const auto *data = boost::asio::buffer_cast<const unsigned char *>(buffer);
+  auto read_uint = [&](size_t offset) {
+    uint32_t value;
+    std::memcpy(&value, data + offset, sizeof(value));
+    return value;
+  };
+  ASSERT_EQ(boost::asio::buffer_size(buffer), sizeof(uint32_t) + read_uint(0u));
+  ASSERT_LT(boost::asio::buffer_size(buffer), boost::asio::buffer_size(message.buffer()));
+
+  constexpr size_t first = sizeof(uint32_t) * 3u;
+  constexpr size_t second = first + sizeof(uint32_t) * ImagesMessage::HeaderEntrySize;
+  const auto *message_begin = data + sizeof(uint32_t);
+  ASSERT_EQ(64u, read_uint(first + 16u)); // stride is not compressed.
+  ASSERT_EQ(
+      ImagesMessage::RawGray8 | (ImagesMessage::LZ4 << ImagesMessage::CompressionShift),
+      read_uint(first + 20u));
+  ASSERT_EQ(0u + ImagesMessage::RawBGRA8, read_uint(second + 20u));
+
+  const auto offset = read_uint(first);
+  uint32_t compressed_size;
+  std::memcpy(&compressed_size, message_begin + offset, sizeof(compressed_size));
+  std::vector<uint8_t> decompressed(labels.size());
+  ASSERT_TRUE(LZ4::Decompress(
+      message_begin + offset + sizeof(uint32_t),
+      compressed_size,
+      decompressed.data(),
+      decompressed.size()));
+  ASSERT_EQ(labels, decompressed);
+  ASSERT_EQ(0, std::memcmp(message_begin + read_uint(second), plain, sizeof(plain)));
+  ASSERT_EQ(0u, read_uint(second) % ImagesMessage::Alignment);
+
+  ASSERT_FALSE(ImagesMessage::IsValidCompression(42u));
+}
+
+TEST(ImagesMessage, DeltaCompression) {
+  using namespace carla::server;
+
+  constexpr uint32_t width = 64u;
+  constexpr uint32_t height = 32u;
+  std::vector<uint8_t> labels(width * height, 7u);
+  std::vector<uint8_t> decompressed(labels.size());
+
+  ImagesMessage message;
+  ImagesDelta delta;
+  carla::client::ImageHistory history;
+  std::vector<unsigned char> encode_buffer;
+  // A key frame every three images.
+  const uint32_t expected[] = {
+    ImagesMessage::LZ4, ImagesMessage::Delta, ImagesMessage::Delta,
+    ImagesMessage::LZ4, ImagesMessage::Delta
+  };
+  for (auto frame = 0u; frame < 5u; ++frame) {
+    // A few labels change every frame.
+    labels[frame * 100u] = static_cast<uint8_t>(frame);
+    const carla_image image =
+        {width, height, 3u, reinterpret_cast<const uint32_t *>(labels.data()), frame, 2u, CARLA_SERVER_IMAGE_GRAY8, CARLA_SERVER_IMAGE_COMPRESSION_DELTA, 0u, 0u, 3u};
+    message.Write(carla::array_view::make_const(&image, 1u));
+    const auto buffer = message.Encode(encode_buffer, true, &delta);
+    const auto *data = boost::asio::buffer_cast<const unsigned char *>(buffer);
+    uint32_t entry[ImagesMessage::HeaderEntrySize];
+    std::memcpy(entry, data + sizeof(uint32_t) * 3u, sizeof(entry));
+    const uint32_t compression = entry[5u] >> ImagesMessage::CompressionShift;
+    ASSERT_EQ(expected[frame], compression);
+    ASSERT_EQ(0u + ImagesMessage::RawGray8, entry[5u] & 0xFFFFu);
+
+    const auto *message_begin = data + sizeof(uint32_t);
+    const auto message_size = boost::asio::buffer_size(buffer) - sizeof(uint32_t);
+    const carla::client::ImageView view = {
+        entry[1u], entry[2u], entry[3u], entry[4u],
+        entry[5u] & 0xFFFFu, compression, entry[6u],
+        message_begin + entry[0u],
+        static_cast<uint32_t>(message_size - entry[0u])};
+    std::fill(decompressed.begin(), decompressed.end(), 0u);
+    ASSERT_TRUE(history.Decompress(view, 2u, frame, decompressed.data()));
+    ASSERT_EQ(labels, decompressed);
+
+    if (compression == ImagesMessage::Delta) {
+      // Without the previous image the delta cannot be applied.
+      carla::client::ImageHistory empty;
+      ASSERT_FALSE(empty.Decompress(view, 2u, frame, decompressed.data()));
+      ASSERT_FALSE(carla::client::Frame::Decompress(view, decompressed.data()));
+    }
+  }
+
+  // Without a delta state the key frames alone are sent.
+  const auto buffer = message.Encode(encode_buffer, true, nullptr);
+  uint32_t encoding;
+  std::memcpy(&encoding, boost::asio::buffer_cast<const unsigned char *>(buffer) + sizeof(uint32_t) * 8u, sizeof(encoding));
+  ASSERT_EQ(0u + ImagesMessage::LZ4, encoding >> ImagesMessage::CompressionShift);
+}
+
+TEST(ImagesMessage, PackBGR) {
+  using namespace carla::server;
+
+  constexpr uint32_t width = 5u;
+  constexpr uint32_t height = 3u;
+  std::vector<uint8_t> bgra(4u * width * height);
+  std::vector<uint8_t> bgr;
+  for (auto i = 0u; i < width * height; ++i) {
+    for (auto channel = 0u; channel < 4u; ++channel) {
+      bgra[4u * i + channel] = static_cast<uint8_t>(10u * i + channel);
+      if (channel < 3u) {
+        bgr.emplace_back(bgra[4u * i + channel]);
+      }
+    }
+  }
+  const carla_image images[] = {
+    {width, height, 1u, reinterpret_cast<const uint32_t *>(bgra.data()), 0u, 0u, CARLA_SERVER_IMAGE_BGR8, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u},
+    {width, height, 1u, reinterpret_cast<const uint32_t *>(bgra.data()), 0u, 1u, CARLA_SERVER_IMAGE_BGR8, CARLA_SERVER_IMAGE_COMPRESSION_LZ4, 0u, 0u, 0u}
+  };
+
+  ImagesMessage message;
+  message.Write(carla::array_view::make_const(images, 2u));
+
+  std::vector<unsigned char> encode_buffer;
+  const auto buffer = message.Encode(encode_buffer);
+  const auto *data = boost::asio::buffer_cast<const unsigned char *>(buffer);
+  auto read_uint = [&](size_t offset) {
+    uint32_t value;
+    std::memcpy(&value, data + offset, sizeof(value));
+    return value;
+  };
+  constexpr size_t first = sizeof(uint32_t) * 3u;
+  constexpr size_t second = first + sizeof(uint32_t) * ImagesMessage::HeaderEntrySize;
+  const auto *message_begin = data + sizeof(uint32_t);
+
+  ASSERT_EQ(3u * width, read_uint(first + 16u));
+  ASSERT_EQ(0u + ImagesMessage::RawBGR8, read_uint(first + 20u));
+  ASSERT_EQ(0, std::memcmp(message_begin + read_uint(first), bgr.data(), bgr.size()));
+
+  ASSERT_EQ(3u * width, read_uint(second + 16u));
+  const auto offset = read_uint(second);
+  uint32_t compressed_size;
+  std::memcpy(&compressed_size, message_begin + offset, sizeof(compressed_size));
+  std::vector<uint8_t> decompressed(bgr.size());
+  ASSERT_TRUE(LZ4::Decompress(
+      message_begin + offset + sizeof(uint32_t),
+      compressed_size,
+      decompressed.data(),
+      decompressed.size()));
+  ASSERT_EQ(bgr, decompressed);
+}
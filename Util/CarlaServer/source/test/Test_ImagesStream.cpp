@@ -0,0 +1,132 @@
+#include <cstring>
+#include <future>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <carla/carla_server.h>
+#include <carla/server/carla_server.pb.h>
+
+#include "InProcessClient.h"
+
+#include <chrono>
+#include <thread>
+
+namespace cs = carla_server;
+using boost::asio::ip::tcp;
+using test::Connect;
+using test::ReadMessage;
+using test::WriteMessage;
+
+static constexpr uint32_t WORLD_PORT = 3300u;
+static constexpr uint32_t TIMEOUT = 6u * 1000u;
+
+static constexpr uint32_t NUMBER_OF_FRAMES = 3u;
+
+static uint32_t GetNumberOfImages(const std::string &message) {
+  uint32_t header[2u];
+  if (message.size() < sizeof(header)) {
+    throw std::runtime_error("unexpected image message");
+  }
+  std::memcpy(header, message.data(), sizeof(header));
+  return header[1u];
+}
+
+// Reads the measurements and the images of each frame from their own
+// connections, and checks they belong together.
+static void RunClient() {
+  boost::asio::io_service service;
+  tcp::socket world(service);
+  tcp::socket measurements(service);
+  tcp::socket control(service);
+  tcp::socket images(service);
+  Connect(world, WORLD_PORT);
+  cs::RequestNewEpisode request;
+  request.set_ini_file("ini");
+  WriteMessage(world, request.SerializeAsString());
+  ReadMessage(world); // scene description.
+  WriteMessage(world, cs::EpisodeStart().SerializeAsString());
+  cs::EpisodeReady episode_ready;
+  if (!episode_ready.ParseFromString(ReadMessage(world)) ||
+      !episode_ready.separate_images_stream()) {
+    throw std::runtime_error("expected a separate images stream");
+  }
+  Connect(measurements, WORLD_PORT + 1u);
+  Connect(control, WORLD_PORT + 2u);
+  Connect(images, WORLD_PORT + 67u);
+  for (auto i = 0u; i < NUMBER_OF_FRAMES; ++i) {
+    cs::Measurements message;
+    if (!message.ParseFromString(ReadMessage(measurements)) ||
+        (GetNumberOfImages(ReadMessage(measurements)) != 0u)) {
+      throw std::runtime_error("unexpected measurements");
+    }
+    cs::ImagesFrame frame;
+    if (!frame.ParseFromString(ReadMessage(images)) ||
+        (GetNumberOfImages(ReadMessage(images)) != 1u)) {
+      throw std::runtime_error("unexpected images");
+    }
+    if ((frame.episode_id() != episode_ready.episode_id()) ||
+        (frame.server_frame_id() != message.flow_control().server_frame_id()) ||
+        (frame.frame_number() != message.frame_number()) ||
+        (frame.image_frame_numbers_size() != 1) ||
+        (frame.image_frame_numbers(0) != message.frame_number())) {
+      throw std::runtime_error("images do not match the measurements");
+    }
+    WriteMessage(control, cs::Control().SerializeAsString());
+  }
+}
+
+TEST(ImagesStream, SeparateFromMeasurements) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  ASSERT_NE(S, carla_set_images_stream(CarlaServer, true, 1u, CARLA_SERVER_STREAM_DROP_OLDEST));
+  ASSERT_EQ(S, carla_set_images_stream(CarlaServer, true, 2u, CARLA_SERVER_STREAM_BLOCK));
+
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  auto client = std::async(std::launch::async, RunClient);
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  carla_request_new_episode values;
+  ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  const carla_scene_description scene{start_locations, 1u, nullptr};
+  ASSERT_EQ(S, carla_write_scene_description(CarlaServer, scene, TIMEOUT));
+  carla_episode_start episode_start;
+  ASSERT_EQ(S, carla_read_episode_start(CarlaServer, episode_start, TIMEOUT));
+  const carla_episode_ready episode_ready{true};
+  ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, episode_ready, TIMEOUT));
+
+  const uint32_t pixels[4u] = {1u, 2u, 3u, 4u};
+  for (auto i = 0u; i < NUMBER_OF_FRAMES; ++i) {
+    carla_measurements measurements;
+    std::memset(&measurements, 0, sizeof(measurements));
+    measurements.frame_number = 10u + i;
+    carla_image image;
+    std::memset(&image, 0, sizeof(image));
+    image.width = 2u;
+    image.height = 2u;
+    image.data = pixels;
+    image.frame_number = measurements.frame_number;
+    // Wait for the client to connect the agent streams.
+    auto written = false;
+    for (auto j = 0u; (j < 200u) && !written; ++j) {
+      written = (carla_write_measurements(CarlaServer, measurements, &image, 1u) == S);
+      if (!written) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    ASSERT_TRUE(written);
+    carla_control control;
+    ASSERT_EQ(S, carla_read_control(CarlaServer, control, TIMEOUT));
+  }
+  client.get();
+}
@@ -0,0 +1,50 @@
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include <carla/server/LZ4.h>
+
+#include <random>
+#include <vector>
+
+using carla::server::LZ4;
+
+static void RoundTrip(const std::vector<unsigned char> &data) {
+  std::vector<unsigned char> compressed(LZ4::CompressBound(data.size()));
+  const auto size = LZ4::Compress(data.data(), data.size(), compressed.data());
+  ASSERT_LE(size, compressed.size());
+  std::vector<unsigned char> decompressed(data.size());
+  ASSERT_TRUE(LZ4::Decompress(compressed.data(), size, decompressed.data(), decompressed.size()));
+  ASSERT_EQ(data, decompressed);
+}
+
+TEST(LZ4, RoundTrip) {
+  RoundTrip({});
+  RoundTrip({1u, 2u, 3u});
+
+  // Label-like image, large uniform regions.
+  std::vector<unsigned char> labels(640u * 480u);
+  for (auto i = 0u; i < labels.size(); ++i) {
+    labels[i] = static_cast<unsigned char>((i % 640u) / 50u);
+  }
+  RoundTrip(labels);
+  std::vector<unsigned char> compressed(LZ4::CompressBound(labels.size()));
+  ASSERT_LT(LZ4::Compress(labels.data(), labels.size(), compressed.data()), labels.size() / 10u);
+
+  // Noise, does not compress.
+  std::mt19937 engine(42u);
+  std::vector<unsigned char> noise(100000u);
+  for (auto &byte : noise) {
+    byte = static_cast<unsigned char>(engine());
+  }
+  RoundTrip(noise);
+}
+
+TEST(LZ4, MalformedInput) {
+  const unsigned char garbage[] = {0xFFu, 0xFFu, 0xFFu};
+  unsigned char output[16u];
+  ASSERT_FALSE(LZ4::Decompress(garbage, sizeof(garbage), output, sizeof(output)));
+  // Match offset before the beginning of the output.
+  const unsigned char bad_offset[] = {0x10u, 'a', 0x08u, 0x00u};
+  ASSERT_FALSE(LZ4::Decompress(bad_offset, sizeof(bad_offset), output, sizeof(output)));
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <carla/server/LargeBuffer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+static void CheckBuffer(const carla::server::LargeBuffer &buffer, size_t size) {
+  using namespace carla::server;
+  ASSERT_NE(nullptr, buffer.data());
+  ASSERT_EQ(size, buffer.size());
+  ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(buffer.data()) % LargeBuffer::Alignment);
+  ASSERT_TRUE(std::all_of(buffer.data(), buffer.data() + size, [](unsigned char c) { return c == 0u; }));
+  std::memset(buffer.data(), 0xff, size);
+}
+
+TEST(LargeBuffer, Heap) {
+  using namespace carla::server;
+  LargeBuffer buffer(1000u);
+  CheckBuffer(buffer, 1000u);
+  ASSERT_FALSE(buffer.is_huge());
+}
+
+TEST(LargeBuffer, Mapped) {
+  using namespace carla::server;
+  const auto previous = LargeBuffer::GetOptions();
+  LargeBufferOptions options;
+  options.huge_pages = true;
+  options.numa_local = true;
+  LargeBuffer::SetOptions(options);
+  // Falls back to regular pages or the heap if no huge pages are available.
+  constexpr size_t size = 3u * LargeBuffer::MinimumMappedSize + 1u;
+  LargeBuffer buffer(size);
+  CheckBuffer(buffer, size);
+  LargeBuffer small(1000u);
+  CheckBuffer(small, 1000u);
+  ASSERT_FALSE(small.is_huge());
+  LargeBuffer::SetOptions(previous);
+
+  LargeBuffer moved = std::move(buffer);
+  ASSERT_EQ(nullptr, buffer.data());
+  ASSERT_EQ(size, moved.size());
+  ASSERT_EQ(0xff, moved.data()[size - 1u]);
+  moved = LargeBuffer();
+  ASSERT_EQ(nullptr, moved.data());
+}
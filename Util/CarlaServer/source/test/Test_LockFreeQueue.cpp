@@ -0,0 +1,81 @@
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include <carla/server/LockFreeQueue.h>
+
+#include <future>
+#include <memory>
+#include <vector>
+
+TEST(LockFreeQueue, PushAndPop) {
+  using namespace carla::server;
+
+  LockFreeQueue<std::unique_ptr<int>> queue;
+  ASSERT_TRUE(queue.empty());
+
+  for (int i = 0; i < 10; ++i) {
+    queue.Push(std::make_unique<int>(i));
+  }
+  ASSERT_FALSE(queue.empty());
+
+  for (int i = 0; i < 10; ++i) {
+    std::unique_ptr<int> value;
+    ASSERT_TRUE(queue.TryPop(value));
+    ASSERT_TRUE(value != nullptr);
+    ASSERT_EQ(i, *value);
+  }
+  std::unique_ptr<int> value;
+  ASSERT_FALSE(queue.TryPop(value));
+  ASSERT_TRUE(queue.empty());
+}
+
+TEST(LockFreeQueue, MultipleProducers) {
+  using namespace carla::server;
+
+  LockFreeQueue<size_t> queue;
+
+  constexpr size_t numberOfProducers = 4u;
+  constexpr size_t numberOfPushes = 10000u;
+
+  auto result_consumer = std::async(std::launch::async, [&](){
+    // Values of each producer must arrive in order.
+    std::vector<size_t> next(numberOfProducers, 0u);
+    for (size_t i = 0u; i < numberOfProducers * numberOfPushes; ++i) {
+      size_t value;
+      ASSERT_TRUE(queue.WaitAndPop(value));
+      const auto producer = value / numberOfPushes;
+      ASSERT_LT(producer, numberOfProducers);
+      ASSERT_EQ(next[producer], value % numberOfPushes);
+      ++next[producer];
+    }
+  });
+
+  std::vector<std::future<void>> producers;
+  for (size_t p = 0u; p < numberOfProducers; ++p) {
+    producers.emplace_back(std::async(std::launch::async, [&queue, p](){
+      for (size_t i = 0u; i < numberOfPushes; ++i) {
+        queue.Push(p * numberOfPushes + i);
+      }
+    }));
+  }
+
+  for (auto &producer : producers) {
+    producer.get();
+  }
+  result_consumer.get();
+}
+
+TEST(LockFreeQueue, SetDoneWakesConsumer) {
+  using namespace carla::server;
+
+  LockFreeQueue<int> queue;
+
+  auto result_consumer = std::async(std::launch::async, [&](){
+    int value;
+    return queue.WaitAndPop(value);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50u));
+  queue.set_done();
+  ASSERT_FALSE(result_consumer.get());
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include <carla/Logging.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace carla;
+
+// Warnings are compiled in both debug and release.
+
+TEST(Logging, RuntimeLevel) {
+  const auto previous = logging::get_level();
+  logging::set_level(CARLA_SERVER_LOG_LEVEL_ERROR);
+  testing::internal::CaptureStderr();
+  log_warning("filtered");
+  log_error("kept");
+  const auto output = testing::internal::GetCapturedStderr();
+  logging::set_level(previous);
+  ASSERT_EQ(std::string::npos, output.find("filtered"));
+  ASSERT_NE(std::string::npos, output.find("kept"));
+}
+
+TEST(Logging, AsyncKeepsEveryMessageOfEachThread) {
+  constexpr auto NUMBER_OF_THREADS = 4u;
+  constexpr auto MESSAGES_PER_THREAD = 200u;
+  const auto previous = logging::get_level();
+  logging::set_level(CARLA_SERVER_LOG_LEVEL_WARNING);
+  testing::internal::CaptureStderr();
+  logging::set_async(true);
+  std::vector<std::thread> threads;
+  for (auto t = 0u; t < NUMBER_OF_THREADS; ++t) {
+    threads.emplace_back([t]() {
+      for (auto i = 0u; i < MESSAGES_PER_THREAD; ++i) {
+        log_warning("thread", t, "message", i);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  logging::set_async(false);
+  const auto output = testing::internal::GetCapturedStderr();
+  logging::set_level(previous);
+
+  ASSERT_EQ(NUMBER_OF_THREADS * MESSAGES_PER_THREAD, std::count(output.begin(), output.end(), '\n'));
+  // Messages of the same thread are printed in order.
+  for (auto t = 0u; t < NUMBER_OF_THREADS; ++t) {
+    size_t position = 0u;
+    for (auto i = 0u; i < MESSAGES_PER_THREAD; ++i) {
+      const auto line = "thread " + std::to_string(t) + " message " + std::to_string(i) + " \n";
+      position = output.find(line, position);
+      ASSERT_NE(std::string::npos, position) << line;
+    }
+  }
+}
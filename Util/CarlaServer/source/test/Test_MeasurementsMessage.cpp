@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <carla/server/MeasurementsMessage.h>
+
+#include <array>
+#include <cstring>
+#include <memory>
+
+static void CountRelease(void *user_data) {
+  ++*static_cast<int *>(user_data);
+}
+
+TEST(MeasurementsMessage, LeasedFrame) {
+  using namespace carla::server;
+
+  int releases = 0;
+  const FrameLease lease{CountRelease, &releases};
+
+  std::array<carla_agent, 3u> agents;
+  std::memset(agents.data(), 0, sizeof(carla_agent) * agents.size());
+  agents[1u].id = 42u;
+  std::array<uint32_t, 4u> pixels = {1u, 2u, 3u, 4u};
+  const carla_image images[] = {
+    {2u, 2u, 1u, pixels.data(), 7u, 0u, CARLA_SERVER_IMAGE_BGRA8, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u}
+  };
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+  measurements.frame_number = 7u;
+  measurements.non_player_agents = agents.data();
+  measurements.number_of_non_player_agents = agents.size();
+
+  auto message = std::make_unique<MeasurementsMessage>();
+  message->WriteLeased(measurements, carla::array_view::make_const(images, 1u), lease);
+  ASSERT_EQ(0, releases);
+
+  // Staging copies the frame and releases the memory.
+  message->StageLeasedFrame();
+  ASSERT_EQ(1, releases);
+  agents[1u].id = 0u;
+  pixels.fill(0u);
+  message->StageLeasedFrame();
+  ASSERT_EQ(1, releases);
+  ASSERT_EQ(7u, message->measurements().frame_number);
+  ASSERT_EQ(3u, message->measurements().number_of_non_player_agents);
+  ASSERT_NE(agents.data(), message->measurements().non_player_agents);
+  ASSERT_EQ(42u, message->measurements().non_player_agents[1u].id);
+  ASSERT_EQ(1u, message->image_frame_numbers().size());
+  ASSERT_EQ(7u, message->image_frame_numbers()[0u]);
+  const auto buffer = message->images();
+  const auto *data = boost::asio::buffer_cast<const unsigned char *>(buffer);
+  const uint32_t expected[] = {1u, 2u, 3u, 4u};
+  ASSERT_EQ(0, std::memcmp(
+      data + boost::asio::buffer_size(buffer) - ImagesMessage::Alignment,
+      expected,
+      sizeof(expected)));
+
+  // A frame never staged is released when overwritten or destroyed.
+  message->WriteLeased(measurements, carla::array_view::make_const(images, 1u), lease);
+  message->Write(measurements, carla::array_view::make_const(images, 1u));
+  ASSERT_EQ(2, releases);
+  message->WriteLeased(measurements, carla::array_view::make_const(images, 1u), lease);
+  message = nullptr;
+  ASSERT_EQ(3, releases);
+}
+
+TEST(MeasurementsMessage, WriteCompletion) {
+  using namespace carla::server;
+
+  auto completions = std::make_shared<WriteCompletions>();
+  carla_measurements measurements;
+  std::memset(&measurements, 0, sizeof(measurements));
+
+  auto message = std::make_unique<MeasurementsMessage>();
+  message->Write(measurements, carla::array_view::make_const<carla_image>(nullptr, 0u));
+  message->set_completion(completions, 1u);
+  message->Complete(errc::success());
+  message->Complete(errc::success());
+
+  // A frame never sent completes as aborted when overwritten or destroyed.
+  message->set_completion(completions, 2u);
+  message->Write(measurements, carla::array_view::make_const<carla_image>(nullptr, 0u));
+  message->set_completion(completions, 3u);
+  message = nullptr;
+
+  std::array<carla_write_completion, 4u> reaped;
+  carla::mutable_array_view<carla_write_completion> first(reaped.data(), 2u);
+  ASSERT_EQ(2u, completions->Poll(first));
+  carla::mutable_array_view<carla_write_completion> rest(reaped.data() + 2u, 2u);
+  ASSERT_EQ(1u, completions->Poll(rest));
+  ASSERT_EQ(0u, completions->Poll(rest));
+  ASSERT_EQ(1u, reaped[0u].token);
+  ASSERT_EQ(CARLA_SERVER_SUCCESS, reaped[0u].result);
+  ASSERT_EQ(2u, reaped[1u].token);
+  ASSERT_EQ(CARLA_SERVER_OPERATION_ABORTED, reaped[1u].result);
+  ASSERT_EQ(3u, reaped[2u].token);
+  ASSERT_EQ(CARLA_SERVER_OPERATION_ABORTED, reaped[2u].result);
+}
@@ -0,0 +1,97 @@
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include <carla/server/MeasurementsPublisher.h>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+static constexpr uint32_t PUBLISHER_PORT = 4123u;
+
+static bool WaitForSubscribers(
+    const carla::server::MeasurementsPublisher &publisher,
+    const uint32_t number_of_subscribers) {
+  for (auto i = 0u; i < 200u; ++i) {
+    if (publisher.GetStats().number_of_subscribers == number_of_subscribers) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+TEST(MeasurementsPublisher, FanOut) {
+  using namespace carla::server;
+  using boost::asio::ip::tcp;
+
+  MeasurementsPublisher publisher(4u);
+  ASSERT_FALSE(publisher.Listen(PUBLISHER_PORT));
+
+  // Nothing is published without subscribers.
+  const std::string header = "head";
+  const std::string body = "body";
+  const auto frame = EncodedFrame::Make(boost::asio::buffer(header), boost::asio::buffer(body));
+  publisher.Publish(frame);
+  ASSERT_EQ(0u, publisher.GetStats().number_of_frames);
+
+  boost::asio::io_service service;
+  const tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), PUBLISHER_PORT);
+  tcp::socket first(service);
+  tcp::socket second(service);
+  first.connect(endpoint);
+  second.connect(endpoint);
+  ASSERT_TRUE(WaitForSubscribers(publisher, 2u));
+
+  for (auto i = 0u; i < 3u; ++i) {
+    publisher.Publish(frame);
+  }
+  for (auto *socket : {&first, &second}) {
+    std::string received(3u * (header.size() + body.size()), '\0');
+    boost::asio::read(*socket, boost::asio::buffer(&received[0u], received.size()));
+    ASSERT_EQ("headbodyheadbodyheadbody", received);
+  }
+  const auto stats = publisher.GetStats();
+  ASSERT_EQ(3u, stats.number_of_frames);
+  ASSERT_EQ(0u, stats.number_of_drops);
+
+  second.close();
+  // The closed subscriber is noticed when a write fails.
+  for (auto i = 0u; (i < 200u) && (publisher.GetStats().number_of_subscribers > 1u); ++i) {
+    publisher.Publish(frame);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(1u, publisher.GetStats().number_of_subscribers);
+}
+
+TEST(MeasurementsPublisher, SlowSubscriberDropsFrames) {
+  using namespace carla::server;
+  using boost::asio::ip::tcp;
+
+  MeasurementsPublisher publisher(2u);
+  ASSERT_FALSE(publisher.Listen(PUBLISHER_PORT + 1u));
+
+  boost::asio::io_service service;
+  tcp::socket subscriber(service);
+  subscriber.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), PUBLISHER_PORT + 1u));
+  ASSERT_TRUE(WaitForSubscribers(publisher, 1u));
+
+  // The subscriber never reads, publishing must not block anyway.
+  const std::vector<unsigned char> data(1u << 20u, 42u);
+  const auto frame = EncodedFrame::Make(boost::asio::buffer(data), boost::asio::buffer(data));
+  constexpr uint32_t number_of_frames = 64u;
+  for (auto i = 0u; i < number_of_frames; ++i) {
+    publisher.Publish(frame);
+  }
+  for (auto i = 0u; (i < 200u) && (publisher.GetStats().number_of_drops == 0u); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  const auto stats = publisher.GetStats();
+  ASSERT_EQ(number_of_frames, stats.number_of_frames);
+  ASSERT_GT(stats.number_of_drops, 0u);
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <carla/server/LargeBuffer.h>
+#include <carla/server/MemoryAccounting.h>
+#include <carla/server/MetricsServer.h>
+#include <carla/server/ServerMetrics.h>
+#include <carla/server/StartupReport.h>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <memory>
+#include <string>
+
+static constexpr uint32_t METRICS_PORT = 4223u;
+
+static std::string Scrape(const uint32_t port) {
+  using boost::asio::ip::tcp;
+  boost::asio::io_service service;
+  tcp::socket socket(service);
+  socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+  const std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  boost::asio::write(socket, boost::asio::buffer(request));
+  // The server closes the connection after the response.
+  std::string response;
+  char data[512u];
+  boost::system::error_code ec;
+  while (!ec) {
+    const auto size = socket.read_some(boost::asio::buffer(data), ec);
+    response.append(data, size);
+  }
+  return response;
+}
+
+TEST(MetricsServer, PrometheusText) {
+  using namespace carla::server;
+
+  auto metrics = std::make_shared<ServerMetrics>();
+  metrics->AddFrameSent(100u, 2000u, 500u);
+  metrics->AddFrameSent(50u, 1000u, 500u);
+  metrics->AddSendError();
+  metrics->SetAgentServerRunning(true, 7u);
+  RingBufferStats stats;
+  stats.number_of_writes = 10u;
+  stats.number_of_drops = 3u;
+  stats.depth = 1u;
+  metrics->SetMeasurementsBuffer([stats]() { return stats; });
+
+  MetricsServer server(metrics);
+  ASSERT_FALSE(server.Listen(METRICS_PORT));
+
+  const auto response = Scrape(METRICS_PORT);
+  ASSERT_EQ(0u, response.find("HTTP/1.0 200 OK\r\n"));
+  const auto body = response.substr(response.find("\r\n\r\n") + 4u);
+  auto has_line = [&](const std::string &line) {
+    return body.find('\n' + line + '\n') != std::string::npos;
+  };
+  ASSERT_TRUE(has_line("carla_agent_server_running 1"));
+  ASSERT_TRUE(has_line("carla_episode_id 7"));
+  ASSERT_TRUE(has_line("carla_frames_sent_total 2"));
+  ASSERT_TRUE(has_line("carla_bytes_sent_total 150"));
+  ASSERT_TRUE(has_line("carla_send_errors_total 1"));
+  ASSERT_TRUE(has_line("carla_encode_seconds_total 0.003"));
+  ASSERT_TRUE(has_line("carla_send_seconds_total 0.001"));
+  ASSERT_TRUE(has_line("carla_measurements_written_total 10"));
+  ASSERT_TRUE(has_line("carla_measurements_dropped_total 3"));
+  ASSERT_TRUE(has_line("carla_measurements_queue_depth 1"));
+  ASSERT_TRUE(has_line("carla_publisher_enabled 0"));
+  ASSERT_TRUE(has_line("# TYPE carla_frames_sent_total counter"));
+
+  // Scraped again, the values are current.
+  metrics->SetAgentServerRunning(false, 7u);
+  ASSERT_NE(std::string::npos, Scrape(METRICS_PORT).find("\ncarla_agent_server_running 0\n"));
+}
+
+TEST(MetricsServer, RequestTimeout) {
+  using namespace carla::server;
+  using boost::asio::ip::tcp;
+
+  auto metrics = std::make_shared<ServerMetrics>();
+  MetricsServer server(metrics, IOExecutor::GetShared(), boost::posix_time::milliseconds(100));
+  ASSERT_FALSE(server.Listen(METRICS_PORT));
+
+  // A client that never sends its request is disconnected unanswered.
+  boost::asio::io_service service;
+  tcp::socket socket(service);
+  socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), METRICS_PORT));
+  char data[64u];
+  boost::system::error_code ec;
+  const auto size = socket.read_some(boost::asio::buffer(data), ec);
+  ASSERT_EQ(0u, size);
+  ASSERT_TRUE(ec);
+
+  // The server keeps answering the next clients.
+  ASSERT_EQ(0u, Scrape(METRICS_PORT).find("HTTP/1.0 200 OK\r\n"));
+}
+
+TEST(MetricsServer, MemoryBySubsystem) {
+  using namespace carla::server;
+
+  const auto before = MemoryAccounting::Get(MemorySubsystem::ImagesMessages);
+  {
+    LargeBuffer buffer(1000u, MemorySubsystem::ImagesMessages);
+    LargeBuffer moved = std::move(buffer);
+    ASSERT_EQ(before + 1000u + LargeBuffer::Alignment, MemoryAccounting::Get(MemorySubsystem::ImagesMessages));
+  }
+  ASSERT_EQ(before, MemoryAccounting::Get(MemorySubsystem::ImagesMessages));
+
+  ServerMetrics metrics;
+  metrics.SetGameMemory(carla_memory_usage{100u, 200u, 300u, 400u, 500u, 600u, 700u});
+  const auto text = metrics.GetText();
+  ASSERT_NE(std::string::npos, text.find("# TYPE carla_memory_bytes gauge\n"));
+  ASSERT_NE(std::string::npos, text.find("\ncarla_memory_bytes{subsystem=\"road_map\"} 100\n"));
+  ASSERT_NE(std::string::npos, text.find("\ncarla_memory_bytes{subsystem=\"spawner_pools\"} 400\n"));
+  ASSERT_NE(std::string::npos, text.find("\ncarla_gpu_memory_bytes{kind=\"textures\"} 500\n"));
+  ASSERT_NE(std::string::npos, text.find("\ncarla_gpu_memory_bytes{kind=\"render_targets\"} 600\n"));
+  ASSERT_NE(std::string::npos, text.find("\ncarla_gpu_texture_pool_bytes 700\n"));
+  ASSERT_NE(std::string::npos, text.find("\ncarla_memory_bytes{subsystem=\"images_messages\"} "));
+  ASSERT_NE(std::string::npos, text.find("\ncarla_protobuf_arena_max_bytes "));
+}
+
+TEST(MetricsServer, StartupPhases) {
+  using namespace carla::server;
+
+  StartupReport::Mark("test_engine_initialized", 2.5);
+  StartupReport::Mark("test_first_measurements_sent", 10.25);
+  // Later episodes do not overwrite the cold start.
+  StartupReport::Mark("test_engine_initialized", 30.0);
+
+  ServerMetrics metrics;
+  const auto text = metrics.GetText();
+  ASSERT_NE(std::string::npos, text.find("# TYPE carla_startup_phase_seconds gauge\n"));
+  const auto engine = text.find("\ncarla_startup_phase_seconds{phase=\"test_engine_initialized\"} 2.5\n");
+  const auto first_frame = text.find("\ncarla_startup_phase_seconds{phase=\"test_first_measurements_sent\"} 10.25\n");
+  ASSERT_NE(std::string::npos, engine);
+  ASSERT_NE(std::string::npos, first_frame);
+  ASSERT_LT(engine, first_frame);
+}
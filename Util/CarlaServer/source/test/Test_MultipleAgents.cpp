@@ -0,0 +1,129 @@
+#include <cstring>
+#include <future>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <carla/carla_server.h>
+#include <carla/server/carla_server.pb.h>
+
+#include "InProcessClient.h"
+
+#include <chrono>
+#include <thread>
+
+namespace cs = carla_server;
+using boost::asio::ip::tcp;
+using test::Connect;
+using test::ReadMessage;
+using test::WriteMessage;
+
+static constexpr uint32_t WORLD_PORT = 3000u;
+static constexpr uint32_t TIMEOUT = 6u * 1000u;
+static constexpr uint32_t NUMBER_OF_AGENTS = 3u;
+static constexpr uint32_t NUMBER_OF_FRAMES = 10u;
+
+static uint32_t GetMeasurementsPort(const uint32_t agent_index) {
+  return WORLD_PORT + (agent_index == 0u ? 1u : 3u + 2u * agent_index);
+}
+
+// Client of one agent, steers with its own index and checks that it only
+// receives the measurements of its own player.
+static void RunAgentClient(const uint32_t agent_index) {
+  boost::asio::io_service service;
+  tcp::socket measurements(service);
+  tcp::socket control(service);
+  Connect(measurements, GetMeasurementsPort(agent_index));
+  Connect(control, GetMeasurementsPort(agent_index) + 1u);
+  for (auto frame = 0u; frame < NUMBER_OF_FRAMES; ++frame) {
+    cs::Measurements message;
+    message.ParseFromString(ReadMessage(measurements));
+    ReadMessage(measurements); // images.
+    if (message.player_measurements().forward_speed() != static_cast<float>(agent_index)) {
+      throw std::runtime_error("measurements of another agent");
+    }
+    cs::Control values;
+    values.set_steer(static_cast<float>(agent_index));
+    WriteMessage(control, values.SerializeAsString());
+  }
+}
+
+static uint32_t RunClient() {
+  boost::asio::io_service service;
+  tcp::socket world(service);
+  Connect(world, WORLD_PORT);
+  WriteMessage(world, cs::RequestNewEpisode().SerializeAsString());
+  ReadMessage(world); // scene description.
+  WriteMessage(world, cs::EpisodeStart().SerializeAsString());
+  cs::EpisodeReady ready;
+  if (!ready.ParseFromString(ReadMessage(world)) || !ready.ready()) {
+    throw std::runtime_error("unexpected episode ready");
+  }
+  std::vector<std::future<void>> agents;
+  for (auto i = 0u; i < ready.number_of_agents(); ++i) {
+    agents.emplace_back(std::async(std::launch::async, RunAgentClient, i));
+  }
+  for (auto &agent : agents) {
+    agent.get();
+  }
+  return ready.number_of_agents();
+}
+
+TEST(MultipleAgents, OneStreamPerAgent) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+  ASSERT_NE(CARLA_SERVER_SUCCESS, carla_set_number_of_agents(CarlaServer, 0u));
+  ASSERT_EQ(CARLA_SERVER_SUCCESS, carla_set_number_of_agents(CarlaServer, NUMBER_OF_AGENTS));
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  auto client = std::async(std::launch::async, RunClient);
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  {
+    carla_request_new_episode values;
+    ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_scene_description values{start_locations, 1u, nullptr};
+    ASSERT_EQ(S, carla_write_scene_description(CarlaServer, values, TIMEOUT));
+  }
+  {
+    carla_episode_start values;
+    ASSERT_EQ(S, carla_read_episode_start(CarlaServer, values, TIMEOUT));
+  }
+  {
+    const carla_episode_ready values{true};
+    ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, values, TIMEOUT));
+  }
+  {
+    carla_stream_stats stats;
+    ASSERT_EQ(CARLA_SERVER_OPERATION_ABORTED,
+        carla_get_agent_measurements_stats(CarlaServer, NUMBER_OF_AGENTS, stats));
+  }
+  for (auto frame = 0u; frame < NUMBER_OF_FRAMES; ++frame) {
+    for (auto i = 0u; i < NUMBER_OF_AGENTS; ++i) {
+      carla_measurements measurements;
+      std::memset(&measurements, 0, sizeof(measurements));
+      measurements.frame_number = frame;
+      measurements.player_measurements.forward_speed = static_cast<float>(i);
+      ASSERT_EQ(S, carla_write_agent_measurements(CarlaServer, i, measurements, nullptr, 0u));
+    }
+    for (auto i = 0u; i < NUMBER_OF_AGENTS; ++i) {
+      carla_control_batch batch;
+      ASSERT_EQ(S, carla_read_agent_control_batch(CarlaServer, i, batch, TIMEOUT));
+      ASSERT_EQ(1u, batch.number_of_controls);
+      ASSERT_EQ(static_cast<float>(i), batch.controls[0u].steer);
+    }
+  }
+  ASSERT_EQ(NUMBER_OF_AGENTS, client.get());
+}
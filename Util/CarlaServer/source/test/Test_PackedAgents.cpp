@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <carla/server/PackedAgents.h>
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace carla::server;
+
+static std::vector<carla_agent> MakeAgents() {
+  std::vector<carla_agent> agents(5u);
+  std::memset(agents.data(), 0, sizeof(carla_agent) * agents.size());
+  for (auto i = 0u; i < agents.size(); ++i) {
+    auto &agent = agents[i];
+    agent.id = 1000u + 3u * i;
+    agent.type = (i % 2u == 0u ? CARLA_SERVER_AGENT_VEHICLE : CARLA_SERVER_AGENT_TRAFFICLIGHT_RED);
+    agent.transform.location = {12345.4f - 100.0f * i, -2000.6f * i, 38.0f};
+    agent.transform.orientation = {0.6f, -0.8f, 0.0f};
+    agent.box_extent = {230.2f, 90.0f, 75.5f};
+    agent.forward_speed = 1.5f * i;
+  }
+  return agents;
+}
+
+template <typename T>
+static T Read(const char *&in) {
+  T value;
+  std::memcpy(&value, in, sizeof(T));
+  in += sizeof(T);
+  return value;
+}
+
+static int64_t ReadDelta(const char *&in, int64_t &previous) {
+  uint64_t zigzag = 0u;
+  for (uint32_t shift = 0u;; shift += 7u) {
+    const auto byte = static_cast<uint8_t>(*in++);
+    zigzag |= static_cast<uint64_t>(byte & 0x7Fu) << shift;
+    if ((byte & 0x80u) == 0u) {
+      break;
+    }
+  }
+  previous += static_cast<int64_t>((zigzag >> 1u) ^ (~(zigzag & 1u) + 1u));
+  return previous;
+}
+
+TEST(PackedAgents, HalfFloat) {
+  for (float value : {0.0f, 1.0f, -2.5f, 0.333333f, 1000.0f, 65504.0f, 6.1e-5f, 3.0e-7f}) {
+    const float decoded = FromHalf(ToHalf(value));
+    ASSERT_NEAR(value, decoded, std::abs(value) / 1024.0f + 6.0e-8f) << value;
+  }
+  ASSERT_EQ(0x3C00u, ToHalf(1.0f));
+  ASSERT_EQ(0xC000u, ToHalf(-2.0f));
+  // Ties to even.
+  ASSERT_EQ(0x3C00u, ToHalf(1.0f + 1.0f / 2048.0f));
+  // Out of range values are clamped.
+  ASSERT_EQ(0x7BFFu, ToHalf(1.0e6f));
+  ASSERT_EQ(0xFBFFu, ToHalf(-INFINITY));
+  ASSERT_TRUE(std::isnan(FromHalf(ToHalf(NAN))));
+}
+
+TEST(PackedAgents, Float32) {
+  const auto agents = MakeAgents();
+  const auto N = agents.size();
+  std::string data;
+  WritePackedAgents(AgentsEncoding::Float32, carla::array_view::make_const(agents.data(), N), data);
+  ASSERT_EQ(48u * N, data.size());
+  const char *in = data.data() + 8u * N + 12u * 2u;
+  ASSERT_EQ(agents[2u].transform.location.x, Read<float>(in));
+}
+
+TEST(PackedAgents, Quantized) {
+  const auto agents = MakeAgents();
+  const auto N = agents.size();
+  std::string data;
+  WritePackedAgents(AgentsEncoding::Quantized, carla::array_view::make_const(agents.data(), N), data);
+  ASSERT_EQ(33u * N, data.size());
+  const char *in = data.data();
+  for (auto &agent : agents) {
+    ASSERT_EQ(agent.id, Read<uint32_t>(in));
+  }
+  for (auto &agent : agents) {
+    ASSERT_EQ(agent.type, Read<uint8_t>(in));
+  }
+  for (auto &agent : agents) {
+    ASSERT_EQ(std::lround(agent.transform.location.x), Read<int32_t>(in));
+    ASSERT_EQ(std::lround(agent.transform.location.y), Read<int32_t>(in));
+    ASSERT_EQ(38, Read<int32_t>(in));
+  }
+  for (auto i = 0u; i < N; ++i) {
+    ASSERT_EQ(19660, Read<int16_t>(in));
+    ASSERT_EQ(-26214, Read<int16_t>(in));
+    ASSERT_EQ(0, Read<int16_t>(in));
+  }
+  for (auto i = 0u; i < N; ++i) {
+    ASSERT_EQ(230u, Read<uint16_t>(in));
+    ASSERT_EQ(90u, Read<uint16_t>(in));
+    ASSERT_EQ(76u, Read<uint16_t>(in));
+  }
+  for (auto &agent : agents) {
+    ASSERT_EQ(agent.forward_speed, Read<float>(in));
+  }
+  ASSERT_EQ(data.data() + data.size(), in);
+}
+
+TEST(PackedAgents, QuantizedDelta) {
+  const auto agents = MakeAgents();
+  const auto N = agents.size();
+  const auto view = carla::array_view::make_const(agents.data(), N);
+  std::string quantized;
+  WritePackedAgents(AgentsEncoding::Quantized, view, quantized);
+  std::string data;
+  WritePackedAgents(AgentsEncoding::QuantizedDelta, view, data);
+  ASSERT_LT(data.size(), quantized.size());
+
+  // Decodes to the same values as the quantized encoding.
+  const char *in = data.data();
+  const char *expected = quantized.data();
+  int64_t previous = 0;
+  for (auto i = 0u; i < N; ++i) {
+    ASSERT_EQ(Read<uint32_t>(expected), ReadDelta(in, previous));
+  }
+  previous = 0;
+  for (auto i = 0u; i < N; ++i) {
+    ASSERT_EQ(Read<uint8_t>(expected), ReadDelta(in, previous));
+  }
+  auto check_vectors = [&](auto read) {
+    int64_t previous_xyz[3u] = {0, 0, 0};
+    for (auto i = 0u; i < 3u * N; ++i) {
+      ASSERT_EQ(read(expected), ReadDelta(in, previous_xyz[i % 3u]));
+    }
+  };
+  check_vectors(Read<int32_t>);
+  check_vectors(Read<int16_t>);
+  check_vectors(Read<uint16_t>);
+  for (auto i = 0u; i < N; ++i) {
+    ASSERT_EQ(Read<float>(expected), Read<float>(in));
+  }
+  ASSERT_EQ(data.data() + data.size(), in);
+  ASSERT_EQ(quantized.data() + quantized.size(), expected);
+}
+
+TEST(PackedAgents, HalfFloatAgents) {
+  const auto agents = MakeAgents();
+  const auto N = agents.size();
+  std::string data;
+  WritePackedAgents(AgentsEncoding::HalfFloat, carla::array_view::make_const(agents.data(), N), data);
+  ASSERT_EQ(25u * N, data.size());
+  const char *in = data.data() + 5u * N;
+  for (auto &agent : agents) {
+    const auto &location = agent.transform.location;
+    ASSERT_NEAR(location.x, FromHalf(Read<uint16_t>(in)), 8.0f);
+    ASSERT_NEAR(location.y, FromHalf(Read<uint16_t>(in)), 8.0f);
+    ASSERT_NEAR(location.z, FromHalf(Read<uint16_t>(in)), 0.1f);
+  }
+  in += 12u * N;
+  for (auto &agent : agents) {
+    ASSERT_NEAR(agent.forward_speed, FromHalf(Read<uint16_t>(in)), 0.01f);
+  }
+}
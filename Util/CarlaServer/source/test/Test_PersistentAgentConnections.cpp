@@ -0,0 +1,125 @@
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <carla/carla_server.h>
+#include <carla/server/carla_server.pb.h>
+
+#include "InProcessClient.h"
+
+#include <chrono>
+#include <thread>
+
+namespace cs = carla_server;
+using boost::asio::ip::tcp;
+using test::Connect;
+using test::ReadMessage;
+using test::WriteMessage;
+
+static constexpr uint32_t WORLD_PORT = 3000u;
+static constexpr uint32_t TIMEOUT = 6u * 1000u;
+static constexpr uint32_t NUMBER_OF_EPISODES = 3u;
+
+// Client connecting the agent sockets only once, returns the number of
+// episodes in which the connections were reused.
+static uint32_t RunClient() {
+  boost::asio::io_service service;
+  tcp::socket world(service);
+  tcp::socket measurements(service);
+  tcp::socket control(service);
+  Connect(world, WORLD_PORT);
+  uint32_t reused = 0u;
+  uint64_t previous_episode_id = 0u;
+  for (auto episode = 0u; episode < NUMBER_OF_EPISODES; ++episode) {
+    WriteMessage(world, cs::RequestNewEpisode().SerializeAsString());
+    ReadMessage(world); // scene description.
+    WriteMessage(world, cs::EpisodeStart().SerializeAsString());
+    cs::EpisodeReady ready;
+    if (!ready.ParseFromString(ReadMessage(world)) ||
+        !ready.ready() ||
+        !ready.persistent_agent_connections() ||
+        (ready.episode_id() <= previous_episode_id) ||
+        (ready.agent_connections_reused() != (episode > 0u))) {
+      throw std::runtime_error("unexpected episode ready");
+    }
+    previous_episode_id = ready.episode_id();
+    if (ready.agent_connections_reused()) {
+      ++reused;
+    } else {
+      Connect(measurements, WORLD_PORT + 1u);
+      Connect(control, WORLD_PORT + 2u);
+    }
+    for (auto frame = 0u; frame < 10u;) {
+      cs::Measurements message;
+      message.ParseFromString(ReadMessage(measurements));
+      ReadMessage(measurements); // images.
+      if (message.episode_id() == ready.episode_id()) {
+        ++frame;
+      } else if (message.episode_id() > ready.episode_id()) {
+        throw std::runtime_error("measurements from the future");
+      }
+      WriteMessage(control, cs::Control().SerializeAsString());
+    }
+  }
+  return reused;
+}
+
+TEST(PersistentAgentConnections, ReuseAcrossEpisodes) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+  ASSERT_EQ(CARLA_SERVER_SUCCESS, carla_set_persistent_agent_connections(CarlaServer, true));
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  auto client = std::async(std::launch::async, RunClient);
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  {
+    carla_request_new_episode values;
+    ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  }
+  for (auto episode = 0u; episode < NUMBER_OF_EPISODES; ++episode) {
+    {
+      const carla_scene_description values{start_locations, 1u, nullptr};
+      ASSERT_EQ(S, carla_write_scene_description(CarlaServer, values, TIMEOUT));
+    }
+    {
+      carla_episode_start values;
+      ASSERT_EQ(S, carla_read_episode_start(CarlaServer, values, TIMEOUT));
+    }
+    {
+      const carla_episode_ready values{true};
+      ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, values, TIMEOUT));
+    }
+    for (;;) {
+      carla_request_new_episode new_episode;
+      auto ec = carla_read_request_new_episode(CarlaServer, new_episode, 0);
+      if (ec == S) {
+        break;
+      }
+      carla_measurements measurements;
+      std::memset(&measurements, 0, sizeof(measurements));
+      if ((ec != CARLA_SERVER_TRY_AGAIN) ||
+          (carla_write_measurements(CarlaServer, measurements, nullptr, 0u) != S)) {
+        // The client closes the connections after its last episode.
+        ASSERT_EQ(NUMBER_OF_EPISODES - 1u, episode);
+        break;
+      }
+      carla_control control;
+      carla_read_control(CarlaServer, control, 100u);
+    }
+  }
+  ASSERT_EQ(NUMBER_OF_EPISODES - 1u, client.get());
+}
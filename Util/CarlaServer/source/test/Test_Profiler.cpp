@@ -0,0 +1,110 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include <gtest/gtest.h>
+
+#include <carla/Profiler.h>
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+TEST(Profiler, HistogramBuckets) {
+  using carla::LatencyHistogram;
+  // Small values have a bucket each.
+  for (uint64_t value = 0u; value < 2u * LatencyHistogram::SUB_BUCKETS; ++value) {
+    ASSERT_EQ(value, LatencyHistogram::GetBucketValue(LatencyHistogram::GetBucket(value)));
+  }
+  // Larger values fall in a bucket whose upper bound is within 1/16.
+  uint32_t previous_bucket = 0u;
+  for (uint64_t value = 1u; value < (uint64_t(1u) << 36u); value += 1u + value / 7u) {
+    const auto bucket = LatencyHistogram::GetBucket(value);
+    ASSERT_LT(bucket, LatencyHistogram::NUMBER_OF_BUCKETS);
+    ASSERT_GE(bucket, previous_bucket);
+    previous_bucket = bucket;
+    const auto upper = LatencyHistogram::GetBucketValue(bucket);
+    ASSERT_GE(upper, value);
+    ASSERT_LE(upper - value, value / LatencyHistogram::SUB_BUCKETS);
+  }
+  ASSERT_EQ(
+      LatencyHistogram::NUMBER_OF_BUCKETS - 1u,
+      LatencyHistogram::GetBucket(std::numeric_limits<uint64_t>::max()));
+}
+
+TEST(Profiler, PercentilesAcrossThreads) {
+  using namespace carla;
+  auto record = [](uint64_t first, uint64_t last) {
+    static thread_local ProfilerData data("Test_Profiler.Percentiles");
+    for (auto value = first; value <= last; ++value) {
+      data.Annotate(value);
+    }
+  };
+  // Half of the values from a thread already gone, half from this one.
+  std::thread(record, 1u, 500u).join();
+  record(501u, 1000u);
+
+  auto snapshots = Profiler::GetSnapshots();
+  auto it = std::find_if(snapshots.begin(), snapshots.end(), [](const LatencySnapshot &s) {
+    return s.name == "Test_Profiler.Percentiles";
+  });
+  ASSERT_TRUE(it != snapshots.end());
+  ASSERT_EQ(1000u, it->count);
+  ASSERT_EQ(1u, it->min);
+  ASSERT_EQ(1000u, it->max);
+  ASSERT_NEAR(500.5, it->mean, 1e-6);
+  ASSERT_NEAR(500.0, it->p50, 500.0 / 16.0);
+  ASSERT_NEAR(990.0, it->p99, 990.0 / 16.0);
+  ASSERT_NEAR(999.0, it->p999, 999.0 / 16.0);
+}
+
+TEST(Profiler, DisabledScopesAreNotRecorded) {
+  using namespace carla;
+  const bool was_enabled = Profiler::IsEnabled();
+  Profiler::Disable();
+  {
+    CARLA_PROFILE_SCOPE(Test_Profiler, Disabled);
+  }
+  for (auto &snapshot : Profiler::GetSnapshots()) {
+    if (snapshot.name == "Test_Profiler.Disabled") {
+      ASSERT_EQ(0u, snapshot.count);
+    }
+  }
+  if (was_enabled) {
+    Profiler::Enable();
+  }
+}
+
+TEST(Profiler, ChromeTrace) {
+  using namespace carla;
+  const uint32_t mode = Profiler::GetMode();
+  Profiler::EnableEventCapture(4u);
+  Profiler::SetFrameNumber(42u);
+  // Only the last four events of each new thread are kept.
+  std::thread([]() {
+    for (auto i = 0u; i < 10u; ++i) {
+      CARLA_PROFILE_SCOPE(Test_Profiler, Traced);
+    }
+  }).join();
+  std::thread([]() { CARLA_PROFILE_SCOPE(Test_Profiler, TracedInThread); }).join();
+  std::ostringstream out;
+  Profiler::DumpChromeTrace(out);
+  if ((mode & Profiler::EVENTS) == 0u) {
+    Profiler::DisableEventCapture();
+  }
+
+  const std::string trace = out.str();
+  auto count = [&](const std::string &str) {
+    size_t result = 0u;
+    for (auto pos = trace.find(str); pos != std::string::npos; pos = trace.find(str, pos + 1u)) {
+      ++result;
+    }
+    return result;
+  };
+  ASSERT_EQ(0u, trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  ASSERT_EQ(4u, count("\"name\":\"Test_Profiler.Traced\""));
+  ASSERT_EQ(1u, count("\"name\":\"Test_Profiler.TracedInThread\""));
+  ASSERT_LE(5u, count("\"frame\":42}"));
+}
@@ -0,0 +1,117 @@
+#include <future>
+#include <iostream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <carla/carla_server.h>
+#include <carla/server/carla_server.pb.h>
+
+#include "InProcessClient.h"
+
+#include <chrono>
+#include <thread>
+
+namespace cs = carla_server;
+using boost::asio::ip::tcp;
+using test::Connect;
+using test::ReadMessage;
+using test::WriteMessage;
+
+static constexpr uint32_t WORLD_PORT = 3100u;
+static constexpr uint32_t TIMEOUT = 6u * 1000u;
+
+static void WriteRequestNewEpisode(tcp::socket &socket, const std::string &ini, const bool queue) {
+  cs::RequestNewEpisode request;
+  request.set_ini_file(ini);
+  request.set_queue(queue);
+  WriteMessage(socket, request.SerializeAsString());
+}
+
+static void SetUpEpisode(tcp::socket &world) {
+  ReadMessage(world); // scene description.
+  WriteMessage(world, cs::EpisodeStart().SerializeAsString());
+  cs::EpisodeReady ready;
+  if (!ready.ParseFromString(ReadMessage(world)) || !ready.ready()) {
+    throw std::runtime_error("unexpected episode ready");
+  }
+}
+
+// Starts an episode, queues the next one and a replacement of it, then starts
+// the queued one with an empty request.
+static void RunClient(std::promise<void> &first_episode_ready, std::future<void> &queued_episode_prepared) {
+  boost::asio::io_service service;
+  tcp::socket world(service);
+  Connect(world, WORLD_PORT);
+  WriteRequestNewEpisode(world, "first", false);
+  SetUpEpisode(world);
+  first_episode_ready.set_value();
+  WriteRequestNewEpisode(world, "discarded", true);
+  WriteRequestNewEpisode(world, "queued", true);
+  queued_episode_prepared.wait();
+  WriteRequestNewEpisode(world, "", false);
+  SetUpEpisode(world);
+}
+
+static std::string ToString(const carla_request_new_episode &values) {
+  return std::string(values.ini_file, values.ini_file_length);
+}
+
+TEST(QueuedEpisode, StartQueuedEpisode) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  std::promise<void> first_episode_ready;
+  std::promise<void> queued_episode_prepared;
+  auto first_episode_ready_future = first_episode_ready.get_future();
+  auto queued_episode_prepared_future = queued_episode_prepared.get_future();
+  auto client = std::async(std::launch::async, [&]() {
+    RunClient(first_episode_ready, queued_episode_prepared_future);
+  });
+
+  auto set_up_episode = [&]() {
+    const carla_scene_description scene{start_locations, 1u, nullptr};
+    ASSERT_EQ(S, carla_write_scene_description(CarlaServer, scene, TIMEOUT));
+    carla_episode_start episode_start;
+    ASSERT_EQ(S, carla_read_episode_start(CarlaServer, episode_start, TIMEOUT));
+    const carla_episode_ready episode_ready{true};
+    ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, episode_ready, TIMEOUT));
+  };
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  carla_request_new_episode values;
+  ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  ASSERT_EQ("first", ToString(values));
+  ASSERT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_queued_episode(CarlaServer, values));
+  set_up_episode();
+  first_episode_ready_future.wait();
+
+  // The queued episodes do not end the current one.
+  std::string queued;
+  for (auto i = 0u; (i < 200u) && (queued != "queued"); ++i) {
+    ASSERT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_request_new_episode(CarlaServer, values, 0u));
+    if (carla_read_queued_episode(CarlaServer, values) == S) {
+      queued = ToString(values);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ("queued", queued);
+  ASSERT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_queued_episode(CarlaServer, values));
+  queued_episode_prepared.set_value();
+
+  // The empty request starts the queued episode.
+  ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  ASSERT_EQ("queued", ToString(values));
+  set_up_episode();
+  client.get();
+}
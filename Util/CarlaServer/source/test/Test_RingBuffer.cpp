@@ -0,0 +1,100 @@
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include <carla/Logging.h>
+#include <carla/server/RingBuffer.h>
+
+#include <atomic>
+#include <future>
+
+TEST(RingBuffer, DropOldest) {
+  using namespace carla::server;
+
+  RingBuffer<size_t> buffer(4u, RingBufferPolicy::DropOldest);
+
+  // Nobody is reading, writes beyond the capacity drop the oldest values.
+  for (size_t i = 0u; i < 10u; ++i) {
+    auto writer = buffer.MakeWriter();
+    ASSERT_TRUE(writer != nullptr);
+    *writer = i;
+  }
+
+  auto stats = buffer.GetStats();
+  ASSERT_EQ(10u, stats.number_of_writes);
+  ASSERT_EQ(6u, stats.number_of_drops);
+  ASSERT_EQ(4u, stats.depth);
+  ASSERT_EQ(4u, stats.max_depth);
+
+  // The newest values are read in order.
+  const auto timeout = timeout_t::milliseconds(10u);
+  for (size_t i = 6u; i < 10u; ++i) {
+    auto reader = buffer.TryMakeReader(timeout);
+    ASSERT_TRUE(reader != nullptr);
+    ASSERT_EQ(i, *reader);
+  }
+  ASSERT_TRUE(buffer.TryMakeReader(timeout) == nullptr);
+
+  stats = buffer.GetStats();
+  ASSERT_EQ(4u, stats.number_of_reads);
+  ASSERT_EQ(0u, stats.depth);
+}
+
+TEST(RingBuffer, Block) {
+  using namespace carla::server;
+
+  RingBuffer<size_t> buffer(3u, RingBufferPolicy::Block);
+
+  constexpr auto numberOfWrites = 50u;
+
+  auto result_writer = std::async(std::launch::async, [&](){
+    for (size_t i = 0u; i < numberOfWrites; ++i) {
+      auto writer = buffer.MakeWriter();
+      ASSERT_TRUE(writer != nullptr);
+      *writer = i;
+    }
+  });
+
+  const auto timeout = timeout_t::milliseconds(1000u);
+
+  auto result_reader = std::async(std::launch::async, [&](){
+    for (size_t i = 0u; i < numberOfWrites; ++i) {
+      auto reader = buffer.TryMakeReader(timeout);
+      ASSERT_TRUE(reader != nullptr);
+      // Every value written is read, in order.
+      ASSERT_EQ(i, *reader);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1u));
+    }
+  });
+
+  result_reader.get();
+  result_writer.get();
+
+  const auto stats = buffer.GetStats();
+  ASSERT_EQ(numberOfWrites, stats.number_of_writes);
+  ASSERT_EQ(numberOfWrites, stats.number_of_reads);
+  ASSERT_EQ(0u, stats.number_of_drops);
+  ASSERT_LE(stats.max_depth, 3u);
+}
+
+TEST(RingBuffer, BlockUntilDone) {
+  using namespace carla::server;
+
+  RingBuffer<size_t> buffer(2u, RingBufferPolicy::Block);
+
+  for (size_t i = 0u; i < 2u; ++i) {
+    *buffer.MakeWriter() = i;
+  }
+
+  // The buffer is full, the writer blocks until it is marked as done.
+  auto result_writer = std::async(std::launch::async, [&](){
+    *buffer.MakeWriter() = 2u;
+  });
+  ASSERT_EQ(
+      std::future_status::timeout,
+      result_writer.wait_for(std::chrono::milliseconds(50u)));
+  buffer.set_done();
+  result_writer.get();
+
+  ASSERT_EQ(1u, buffer.GetStats().number_of_drops);
+}
@@ -0,0 +1,181 @@
+#include <future>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <carla/carla_server.h>
+#include <carla/server/RoadMapEncoding.h>
+#include <carla/server/carla_server.pb.h>
+
+#include "InProcessClient.h"
+
+#include <chrono>
+#include <thread>
+
+namespace cs = carla_server;
+using boost::asio::ip::tcp;
+using test::Connect;
+using test::ReadMessage;
+using test::WriteMessage;
+using carla::server::RoadMapEncoding;
+
+static constexpr uint32_t WORLD_PORT = 3600u;
+static constexpr uint32_t TIMEOUT = 6u * 1000u;
+
+// Not a multiple of the tile size, with a road across uniform off-road tiles.
+static constexpr uint32_t WIDTH = 200u;
+static constexpr uint32_t HEIGHT = 130u;
+
+static std::vector<uint16_t> MakePixels() {
+  std::vector<uint16_t> pixels(WIDTH * HEIGHT, 0u);
+  for (auto y = 0u; y < HEIGHT; ++y) {
+    for (auto x = 90u; x < 110u; ++x) {
+      pixels[x + WIDTH * y] = static_cast<uint16_t>(0x8000u | (x * 7u + y));
+    }
+  }
+  pixels.back() = 0x4000u;
+  return pixels;
+}
+
+static carla_road_map MakeRoadMap(const std::vector<uint16_t> &pixels) {
+  carla_road_map road_map{true, pixels.data(), WIDTH, HEIGHT, {}};
+  const float world_to_pixel[8u] = {0.1f, 0.0f, 0.0f, 100.0f, 0.0f, 0.1f, 0.0f, 65.0f};
+  std::copy(world_to_pixel, world_to_pixel + 8u, road_map.world_to_pixel);
+  return road_map;
+}
+
+TEST(RoadMapEncoding, RoundTrip) {
+  const auto pixels = MakePixels();
+  const auto road_map = MakeRoadMap(pixels);
+  const auto hash = RoadMapEncoding::Hash(road_map);
+  ASSERT_NE(0u, hash);
+  const auto data = RoadMapEncoding::Encode(road_map, hash);
+  ASSERT_LT(data.size(), pixels.size() * sizeof(uint16_t) / 2u);
+
+  RoadMapEncoding::Header header;
+  std::vector<uint16_t> decoded;
+  ASSERT_TRUE(RoadMapEncoding::Decode(data, header, decoded));
+  ASSERT_EQ(WIDTH, header.width);
+  ASSERT_EQ(HEIGHT, header.height);
+  ASSERT_EQ(4u * 3u, header.number_of_tiles);
+  ASSERT_EQ(hash, header.hash);
+  ASSERT_EQ(100.0f, header.world_to_pixel[3u]);
+  ASSERT_EQ(pixels, decoded);
+
+  ASSERT_FALSE(RoadMapEncoding::Decode(data.substr(0u, 100u), header, decoded));
+}
+
+TEST(RoadMapEncoding, HashChangesWithTheContents) {
+  auto pixels = MakePixels();
+  auto road_map = MakeRoadMap(pixels);
+  const auto hash = RoadMapEncoding::Hash(road_map);
+  ASSERT_EQ(hash, RoadMapEncoding::Hash(road_map));
+  road_map.world_to_pixel[7u] = 66.0f;
+  ASSERT_NE(hash, RoadMapEncoding::Hash(road_map));
+  road_map = MakeRoadMap(pixels);
+  pixels[1234u] = 1u;
+  ASSERT_NE(hash, RoadMapEncoding::Hash(road_map));
+}
+
+static cs::RoadMap RequestRoadMap(tcp::socket &world, const uint64_t cached_hash) {
+  cs::RequestNewEpisode request;
+  request.set_road_map(true);
+  request.set_cached_road_map_hash(cached_hash);
+  WriteMessage(world, request.SerializeAsString());
+  cs::RoadMap road_map;
+  if (!road_map.ParseFromString(ReadMessage(world))) {
+    throw std::runtime_error("unexpected road map");
+  }
+  return road_map;
+}
+
+// Starts an episode, downloads the road map, asks for it again with its hash,
+// then starts the next episode.
+static void RunClient(std::promise<void> &road_maps_received) {
+  boost::asio::io_service service;
+  tcp::socket world(service);
+  Connect(world, WORLD_PORT);
+  cs::RequestNewEpisode request;
+  request.set_ini_file("first");
+  WriteMessage(world, request.SerializeAsString());
+  ReadMessage(world); // scene description.
+  WriteMessage(world, cs::EpisodeStart().SerializeAsString());
+  ReadMessage(world); // episode ready.
+  const auto downloaded = RequestRoadMap(world, 0u);
+  RoadMapEncoding::Header header;
+  std::vector<uint16_t> pixels;
+  if (!downloaded.success() ||
+      !RoadMapEncoding::Decode(downloaded.data(), header, pixels) ||
+      (header.hash != downloaded.hash()) ||
+      (pixels != MakePixels())) {
+    throw std::runtime_error("unexpected road map downloaded");
+  }
+  const auto cached = RequestRoadMap(world, downloaded.hash());
+  if (!cached.success() || (cached.hash() != downloaded.hash()) || !cached.data().empty()) {
+    throw std::runtime_error("unexpected cached road map");
+  }
+  road_maps_received.set_value();
+  request.set_ini_file("second");
+  WriteMessage(world, request.SerializeAsString());
+  ReadMessage(world); // scene description.
+}
+
+TEST(RoadMap, DownloadedOnceWhileTheEpisodeRuns) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  std::promise<void> road_maps_received;
+  auto road_maps_received_future = road_maps_received.get_future();
+  auto client = std::async(std::launch::async, [&]() { RunClient(road_maps_received); });
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  carla_request_new_episode values;
+  ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  const auto pixels = MakePixels();
+  const auto road_map = MakeRoadMap(pixels);
+  ASSERT_NE(S, carla_write_road_map(CarlaServer, road_map, TIMEOUT));
+  const carla_scene_description scene{start_locations, 1u, nullptr};
+  ASSERT_EQ(S, carla_write_scene_description(CarlaServer, scene, TIMEOUT));
+  carla_episode_start episode_start;
+  ASSERT_EQ(S, carla_read_episode_start(CarlaServer, episode_start, TIMEOUT));
+  const carla_episode_ready episode_ready{true};
+  ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, episode_ready, TIMEOUT));
+
+  carla_road_map_request request;
+  auto read_road_map_request = [&]() {
+    for (auto i = 0u; i < 200u; ++i) {
+      EXPECT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_request_new_episode(CarlaServer, values, 0u));
+      if (carla_read_road_map_request(CarlaServer, request) == S) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+  };
+
+  ASSERT_TRUE(read_road_map_request());
+  ASSERT_EQ(0u, request.cached_hash);
+  ASSERT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_road_map_request(CarlaServer, request));
+  ASSERT_EQ(S, carla_write_road_map(CarlaServer, road_map, TIMEOUT));
+
+  ASSERT_TRUE(read_road_map_request());
+  ASSERT_EQ(RoadMapEncoding::Hash(road_map), request.cached_hash);
+  ASSERT_EQ(S, carla_write_road_map(CarlaServer, road_map, TIMEOUT));
+  road_maps_received_future.wait();
+
+  ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  ASSERT_EQ("second", std::string(values.ini_file, values.ini_file_length));
+  ASSERT_EQ(S, carla_write_scene_description(CarlaServer, scene, TIMEOUT));
+  client.get();
+}
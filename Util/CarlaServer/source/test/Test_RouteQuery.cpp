@@ -0,0 +1,130 @@
+#include <future>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <carla/carla_server.h>
+#include <carla/server/carla_server.pb.h>
+
+#include "InProcessClient.h"
+
+#include <chrono>
+#include <thread>
+
+namespace cs = carla_server;
+using boost::asio::ip::tcp;
+using test::Connect;
+using test::ReadMessage;
+using test::WriteMessage;
+
+static constexpr uint32_t WORLD_PORT = 3400u;
+static constexpr uint32_t TIMEOUT = 6u * 1000u;
+
+static cs::Route RequestRoute(tcp::socket &world, const float end_x) {
+  cs::RequestNewEpisode request;
+  auto *route_request = request.mutable_route();
+  route_request->mutable_start()->mutable_orientation()->set_x(1.0f);
+  route_request->mutable_end()->mutable_location()->set_x(end_x);
+  WriteMessage(world, request.SerializeAsString());
+  cs::Route route;
+  if (!route.ParseFromString(ReadMessage(world))) {
+    throw std::runtime_error("unexpected route");
+  }
+  return route;
+}
+
+// Starts an episode, asks for a route that exists and one that does not, then
+// starts the next episode.
+static void RunClient(std::promise<void> &routes_received) {
+  boost::asio::io_service service;
+  tcp::socket world(service);
+  Connect(world, WORLD_PORT);
+  cs::RequestNewEpisode request;
+  request.set_ini_file("first");
+  WriteMessage(world, request.SerializeAsString());
+  ReadMessage(world); // scene description.
+  WriteMessage(world, cs::EpisodeStart().SerializeAsString());
+  ReadMessage(world); // episode ready.
+  const auto found = RequestRoute(world, 1000.0f);
+  if (!found.success() ||
+      (found.waypoints_size() != 2) ||
+      (found.waypoints(1).x() != 1000.0f) ||
+      (found.lanes_size() != 1) ||
+      (found.lanes(0) != 7u) ||
+      (found.length() != 1000.0f)) {
+    throw std::runtime_error("unexpected route found");
+  }
+  const auto not_found = RequestRoute(world, -1.0f);
+  if (not_found.success() || (not_found.waypoints_size() != 0)) {
+    throw std::runtime_error("unexpected route not found");
+  }
+  routes_received.set_value();
+  request.set_ini_file("second");
+  WriteMessage(world, request.SerializeAsString());
+  ReadMessage(world); // scene description.
+}
+
+TEST(RouteQuery, AnsweredWhileTheEpisodeRuns) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  std::promise<void> routes_received;
+  auto routes_received_future = routes_received.get_future();
+  auto client = std::async(std::launch::async, [&]() { RunClient(routes_received); });
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  carla_request_new_episode values;
+  ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  carla_route_request request;
+  ASSERT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_route_request(CarlaServer, request));
+  const carla_route no_request{false, nullptr, 0u, nullptr, 0u, 0.0f};
+  ASSERT_NE(S, carla_write_route(CarlaServer, no_request, TIMEOUT));
+  const carla_scene_description scene{start_locations, 1u, nullptr};
+  ASSERT_EQ(S, carla_write_scene_description(CarlaServer, scene, TIMEOUT));
+  carla_episode_start episode_start;
+  ASSERT_EQ(S, carla_read_episode_start(CarlaServer, episode_start, TIMEOUT));
+  const carla_episode_ready episode_ready{true};
+  ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, episode_ready, TIMEOUT));
+
+  // Route queries do not end the episode.
+  auto read_route_request = [&]() {
+    for (auto i = 0u; i < 200u; ++i) {
+      EXPECT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_request_new_episode(CarlaServer, values, 0u));
+      if (carla_read_route_request(CarlaServer, request) == S) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+  };
+
+  ASSERT_TRUE(read_route_request());
+  ASSERT_EQ(1.0f, request.start.orientation.x);
+  ASSERT_EQ(1000.0f, request.end.location.x);
+  ASSERT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_route_request(CarlaServer, request));
+  const carla_vector3d waypoints[] = {{0.0f, 0.0f, 0.0f}, {1000.0f, 0.0f, 0.0f}};
+  const uint32_t lanes[] = {7u};
+  const carla_route found{true, waypoints, 2u, lanes, 1u, 1000.0f};
+  ASSERT_EQ(S, carla_write_route(CarlaServer, found, TIMEOUT));
+
+  ASSERT_TRUE(read_route_request());
+  ASSERT_EQ(-1.0f, request.end.location.x);
+  const carla_route not_found{false, nullptr, 0u, nullptr, 0u, 0.0f};
+  ASSERT_EQ(S, carla_write_route(CarlaServer, not_found, TIMEOUT));
+  routes_received_future.wait();
+
+  ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  ASSERT_EQ("second", std::string(values.ini_file, values.ini_file_length));
+  ASSERT_EQ(S, carla_write_scene_description(CarlaServer, scene, TIMEOUT));
+  client.get();
+}
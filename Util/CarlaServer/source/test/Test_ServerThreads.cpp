@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <carla/server/IOExecutor.h>
+#include <carla/server/ServerThreads.h>
+
+#include <thread>
+
+#ifdef __linux__
+#  include <sched.h>
+#endif // __linux__
+
+TEST(ServerThreads, Register) {
+  using namespace carla::server;
+
+  const auto count = ServerThreads::size();
+  {
+    IOExecutor executor(2u);
+    ASSERT_EQ(2u, executor.number_of_threads());
+    // The threads register as soon as they start.
+    for (auto i = 0u; (i < 1000u) && (ServerThreads::size() < count + 2u); ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(count + 2u, ServerThreads::size());
+  }
+  ASSERT_EQ(count, ServerThreads::size());
+}
+
+TEST(ServerThreads, InvalidOptions) {
+  using namespace carla::server;
+
+  ThreadOptions options;
+  options.priority = 20;
+  ASSERT_EQ(errc::invalid_argument(), ServerThreads::SetOptions(options));
+  options.priority = -21;
+  ASSERT_EQ(errc::invalid_argument(), ServerThreads::SetOptions(options));
+}
+
+#ifdef __linux__
+
+TEST(ServerThreads, Affinity) {
+  using namespace carla::server;
+
+  const int cpu = ::sched_getcpu();
+  ASSERT_GE(cpu, 0);
+
+  ThreadOptions options;
+  options.cpus = {static_cast<uint32_t>(cpu)};
+  ASSERT_FALSE(ServerThreads::SetOptions(options));
+
+  // Threads registered later are pinned too.
+  int count = 0;
+  bool is_set = false;
+  std::thread thread([&]() {
+    ServerThreads::Scope scope;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    ASSERT_EQ(0, ::sched_getaffinity(0, sizeof(set), &set));
+    count = CPU_COUNT(&set);
+    is_set = CPU_ISSET(cpu, &set);
+  });
+  thread.join();
+  ASSERT_EQ(1, count);
+  ASSERT_TRUE(is_set);
+
+  ASSERT_FALSE(ServerThreads::SetOptions(ThreadOptions()));
+}
+
+#endif // __linux__
@@ -0,0 +1,48 @@
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include <carla/server/SharedMemoryImages.h>
+
+#include <cstring>
+#include <vector>
+
+TEST(SharedMemoryImages, WriteSlots) {
+  using namespace carla::server;
+  namespace bip = boost::interprocess;
+
+  const std::string name = "carla_test_shared_memory_images";
+  SharedMemoryImages shared_memory(name, 2u);
+
+  std::vector<unsigned char> images(1000u);
+  for (auto i = 0u; i < images.size(); ++i) {
+    images[i] = static_cast<unsigned char>(i);
+  }
+  ASSERT_EQ(1u, shared_memory.Write(boost::asio::buffer(images)));
+  ASSERT_EQ(2u, shared_memory.Write(boost::asio::buffer(images.data(), 10u)));
+  // Bigger than the slot, the images have to go through the socket.
+  std::vector<unsigned char> too_big(10000u);
+  ASSERT_EQ(0u, shared_memory.Write(boost::asio::buffer(too_big)));
+
+  bip::shared_memory_object segment(bip::open_only, name.c_str(), bip::read_only);
+  bip::mapped_region region(segment, bip::read_only);
+  const auto *begin = static_cast<const unsigned char *>(region.get_address());
+  uint32_t header[4u];
+  std::memcpy(header, begin, sizeof(header));
+  ASSERT_EQ(0u + SharedMemoryImages::Magic, header[0u]);
+  ASSERT_EQ(0u + SharedMemoryImages::Version, header[1u]);
+  ASSERT_EQ(2u, header[2u]);
+  const size_t slot_size = header[3u];
+  ASSERT_GE(slot_size, images.size());
+
+  // Third write wraps around to the first slot.
+  ASSERT_EQ(3u, shared_memory.Write(boost::asio::buffer(images)));
+  const auto *slot = begin + SharedMemoryImages::Alignment;
+  uint64_t sequence;
+  std::memcpy(&sequence, slot, sizeof(sequence));
+  ASSERT_EQ(3u, sequence);
+  ASSERT_EQ(0, std::memcmp(slot + SharedMemoryImages::Alignment, images.data(), images.size()));
+  slot += SharedMemoryImages::Alignment + slot_size;
+  std::memcpy(&sequence, slot, sizeof(sequence));
+  ASSERT_EQ(2u, sequence);
+}
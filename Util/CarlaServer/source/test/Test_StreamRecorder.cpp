@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+
+#include <carla/carla_server.h>
+#include <carla/server/StreamRecorder.h>
+#include <carla/server/StreamRecording.h>
+#include <carla/server/carla_server.pb.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using carla::server::EncodedFrame;
+using carla::server::StreamRecorder;
+using carla::server::StreamRecording;
+
+static std::string ReadFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static std::vector<StreamRecorder::IndexEntry> ReadIndex(const std::string &path) {
+  const auto index = ReadFile(path);
+  StreamRecorder::IndexHeader header;
+  EXPECT_LE(sizeof(header), index.size());
+  std::memcpy(&header, index.data(), sizeof(header));
+  EXPECT_EQ(0, std::memcmp(header.magic, "CARLAIDX", sizeof(header.magic)));
+  EXPECT_EQ(StreamRecorder::INDEX_VERSION, header.version);
+  EXPECT_EQ(sizeof(StreamRecorder::IndexEntry), header.entry_size);
+  std::vector<StreamRecorder::IndexEntry> entries((index.size() - sizeof(header)) / header.entry_size);
+  std::memcpy(entries.data(), index.data() + sizeof(header), entries.size() * sizeof(StreamRecorder::IndexEntry));
+  return entries;
+}
+
+class StreamRecorderTest : public ::testing::Test {
+protected:
+
+  void SetUp() override {
+    // In the working directory rather than /tmp, where direct I/O is more
+    // likely to be supported.
+    char name[] = "recorder-XXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(name));
+    directory = name;
+  }
+
+  void TearDown() override {
+    for (auto *segment : {"00000", "00001", "00002", "00003"}) {
+      std::remove(Path(segment, ".stream").c_str());
+      std::remove(Path(segment, ".index").c_str());
+    }
+    std::remove(directory.c_str());
+  }
+
+  std::string Path(const std::string &segment, const char *extension) const {
+    return directory + "/" + segment + extension;
+  }
+
+  std::string directory;
+};
+
+static std::string MakeFrame(const size_t size, const char seed) {
+  std::string frame(size, '\0');
+  for (auto i = 0u; i < size; ++i) {
+    frame[i] = static_cast<char>(seed + i % 251u);
+  }
+  return frame;
+}
+
+TEST_F(StreamRecorderTest, IndexAndSegments) {
+  const std::vector<size_t> sizes = {100u, 7000u, 1u, 5000000u, 3u, 4096u};
+  std::vector<std::string> measurements;
+  std::vector<std::string> images;
+  {
+    StreamRecorder::Options options;
+    options.segment_size = 5000100u;
+    StreamRecorder recorder(directory, options);
+    for (auto i = 0u; i < sizes.size(); ++i) {
+      measurements.emplace_back(MakeFrame(10u + i, 'm'));
+      images.emplace_back(MakeFrame(sizes[i], static_cast<char>(i)));
+      recorder.Record(EncodedFrame::Make(boost::asio::buffer(measurements.back()), boost::asio::buffer(images.back())));
+      if (i == 1u) {
+        // Flushed frames are readable while recording.
+        recorder.Flush();
+        ASSERT_EQ(2u, ReadIndex(Path("00000", ".index")).size());
+        ASSERT_EQ(
+            measurements[0u] + images[0u] + measurements[1u] + images[1u],
+            ReadFile(Path("00000", ".stream")));
+      }
+    }
+    recorder.Flush();
+    const auto stats = recorder.GetStats();
+    ASSERT_EQ(sizes.size(), stats.number_of_frames);
+    ASSERT_EQ(0u, stats.number_of_drops);
+    ASSERT_EQ(3u, stats.number_of_segments);
+    ASSERT_FALSE(stats.failed);
+  }
+
+  // A segment is started whenever a frame does not fit in the current one.
+  const std::vector<std::pair<std::string, std::vector<size_t>>> segments = {
+    {"00000", {0u, 1u, 2u}},
+    {"00001", {3u, 4u}},
+    {"00002", {5u}}};
+  for (auto &segment : segments) {
+    const auto stream = ReadFile(Path(segment.first, ".stream"));
+    const auto entries = ReadIndex(Path(segment.first, ".index"));
+    ASSERT_EQ(segment.second.size(), entries.size());
+    uint64_t offset = 0u;
+    for (auto i = 0u; i < entries.size(); ++i) {
+      const auto frame = segment.second[i];
+      ASSERT_EQ(offset, entries[i].offset);
+      ASSERT_EQ(measurements[frame].size(), entries[i].measurements_size);
+      ASSERT_EQ(images[frame].size(), entries[i].images_size);
+      ASSERT_EQ(measurements[frame], stream.substr(offset, entries[i].measurements_size));
+      ASSERT_EQ(images[frame], stream.substr(offset + entries[i].measurements_size, entries[i].images_size));
+      offset += entries[i].measurements_size + entries[i].images_size;
+    }
+    ASSERT_EQ(offset, stream.size());
+  }
+
+  // A new recorder does not overwrite the previous segments.
+  {
+    StreamRecorder recorder(directory);
+    recorder.Record(EncodedFrame::Make(boost::asio::buffer(measurements[0u]), boost::asio::buffer(images[0u])));
+  }
+  ASSERT_EQ(measurements[0u] + images[0u], ReadFile(Path("00003", ".stream")));
+  ASSERT_EQ(1u, ReadIndex(Path("00003", ".index")).size());
+}
+
+TEST_F(StreamRecorderTest, DropsWhenFallingBehind) {
+  StreamRecorder::Options options;
+  options.max_queued_bytes = 1000u;
+  StreamRecorder recorder(directory, options);
+  const std::string frame(2000u, 'x');
+  recorder.Record(EncodedFrame::Make(boost::asio::buffer(frame), boost::asio::buffer(frame)));
+  recorder.Flush();
+  const auto stats = recorder.GetStats();
+  ASSERT_EQ(0u, stats.number_of_frames);
+  ASSERT_EQ(1u, stats.number_of_drops);
+}
+
+TEST_F(StreamRecorderTest, MissingDirectory) {
+  StreamRecorder recorder(directory + "/missing");
+  const std::string frame = "frame";
+  recorder.Record(EncodedFrame::Make(boost::asio::buffer(frame), boost::asio::buffer(frame)));
+  recorder.Flush();
+  recorder.Record(EncodedFrame::Make(boost::asio::buffer(frame), boost::asio::buffer(frame)));
+  const auto stats = recorder.GetStats();
+  ASSERT_TRUE(stats.failed);
+  ASSERT_EQ(0u, stats.number_of_frames);
+  ASSERT_EQ(2u, stats.number_of_drops);
+}
+
+TEST_F(StreamRecorderTest, ReadRecording) {
+  std::vector<std::string> frames;
+  {
+    StreamRecorder::Options options;
+    options.segment_size = 10000u;
+    StreamRecorder recorder(directory, options);
+    for (auto i = 0u; i < 5u; ++i) {
+      frames.emplace_back(MakeFrame(4000u + i, static_cast<char>(i)));
+      recorder.Record(EncodedFrame::Make(
+          boost::asio::buffer(frames.back().data(), 10u),
+          boost::asio::buffer(frames.back().data() + 10u, frames.back().size() - 10u)));
+    }
+  }
+  // Not yet written frames, past the end of the segment, are ignored.
+  {
+    std::ofstream index(Path("00002", ".index"), std::ios::binary | std::ios::app);
+    const StreamRecorder::IndexEntry entry{8001u, 10u, 100u};
+    index.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+  }
+  StreamRecording::Frame last;
+  {
+    StreamRecording recording;
+    ASSERT_FALSE(recording.Open(directory));
+    ASSERT_EQ(frames.size(), recording.size());
+    for (auto i = 0u; i < frames.size(); ++i) {
+      const auto frame = recording.GetFrame(i);
+      const auto *measurements = boost::asio::buffer_cast<const char *>(frame.measurements);
+      const auto *images = boost::asio::buffer_cast<const char *>(frame.images);
+      ASSERT_EQ(frames[i].substr(0u, 10u), std::string(measurements, boost::asio::buffer_size(frame.measurements)));
+      ASSERT_EQ(frames[i].substr(10u), std::string(images, boost::asio::buffer_size(frame.images)));
+      ASSERT_NE(nullptr, frame.segment);
+    }
+    last = recording.GetFrame(4u);
+  }
+  // The frame keeps its segment mapped.
+  const auto *images = boost::asio::buffer_cast<const char *>(last.images);
+  ASSERT_EQ(frames[4u].substr(10u), std::string(images, boost::asio::buffer_size(last.images)));
+}
+
+TEST_F(StreamRecorderTest, ReadInvalidRecording) {
+  StreamRecording recording;
+  ASSERT_TRUE(recording.Open(directory));
+  std::ofstream(Path("00000", ".stream")) << "frame";
+  std::ofstream(Path("00000", ".index")) << "not an index";
+  ASSERT_TRUE(recording.Open(directory));
+}
+
+TEST_F(StreamRecorderTest, OfflineEpisode) {
+  constexpr uint32_t NUMBER_OF_FRAMES = 20u;
+  {
+    const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+    auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+    CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+    ASSERT_TRUE(CarlaServer != nullptr);
+    // Nothing to feed yet.
+    ASSERT_EQ(CARLA_SERVER_OPERATION_ABORTED, carla_start_offline_episode(CarlaServer));
+    ASSERT_EQ(CARLA_SERVER_SUCCESS, carla_set_stream_recorder(CarlaServer, true, directory.c_str(), 1u));
+    ASSERT_EQ(CARLA_SERVER_SUCCESS, carla_start_offline_episode(CarlaServer));
+    carla_control control;
+    ASSERT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_control(CarlaServer, control, 0u));
+    const std::vector<uint32_t> pixels(16u * 8u, 0xFF00FF00u);
+    const carla_image images[] = {
+      {16u, 8u, 0u, pixels.data(), 0u, 0u, CARLA_SERVER_IMAGE_BGRA8, CARLA_SERVER_IMAGE_COMPRESSION_NONE, 0u, 0u, 0u}
+    };
+    carla_measurements measurements;
+    std::memset(&measurements, 0, sizeof(measurements));
+    for (auto i = 0u; i < NUMBER_OF_FRAMES; ++i) {
+      measurements.frame_number = i;
+      ASSERT_EQ(CARLA_SERVER_SUCCESS, carla_write_measurements(CarlaServer, measurements, images, 1u));
+    }
+  }
+  // Every frame is recorded once the server is freed.
+  StreamRecording recording;
+  ASSERT_FALSE(recording.Open(directory));
+  ASSERT_EQ(NUMBER_OF_FRAMES, recording.size());
+  for (auto i = 0u; i < NUMBER_OF_FRAMES; ++i) {
+    const auto frame = recording.GetFrame(i);
+    const auto *data = boost::asio::buffer_cast<const char *>(frame.measurements);
+    const auto size = boost::asio::buffer_size(frame.measurements);
+    ASSERT_LT(sizeof(uint32_t), size);
+    carla_server::Measurements message;
+    ASSERT_TRUE(message.ParseFromArray(data + sizeof(uint32_t), static_cast<int>(size - sizeof(uint32_t))));
+    ASSERT_EQ(i, message.frame_number());
+    ASSERT_EQ(1u, message.episode_id());
+    ASSERT_LT(16u * 8u * sizeof(uint32_t), boost::asio::buffer_size(frame.images));
+  }
+}
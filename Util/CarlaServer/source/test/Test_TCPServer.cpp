@@ -4,6 +4,11 @@
 
 #include <gtest/gtest.h>
 
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
 #include <carla/Logging.h>
 #include <carla/server/Protobuf.h>
 #include <carla/server/TCPServer.h>
@@ -31,6 +36,51 @@ TEST(TCPServer, SayHello) {
   }
 }
 
+TEST(TCPServer, VectoredWrite) {
+  TCPServer server;
+  ASSERT_FALSE(server.Connect(PORT, TIMEOUT)) << "missing echo client!";
+
+  // Split the message so the size prefix and the payload go in different
+  // buffers.
+  const std::string message = Protobuf::Encode("Hello client!");
+  const auto length = message.size();
+  const const_buffer buffers[] = {
+      boost::asio::buffer(message.data(), 6u),
+      boost::asio::buffer(message.data() + 6u, length - 6u)};
+
+  ASSERT_FALSE(server.Write(carla::array_view::make_const(buffers, 2u), TIMEOUT));
+
+  auto buffer = std::make_unique<char[]>(length);
+  ASSERT_FALSE(server.Read(boost::asio::buffer(buffer.get(), length), TIMEOUT));
+  ASSERT_EQ(message, std::string(buffer.get(), length));
+}
+
+TEST(TCPServer, AsyncSayHello) {
+  TCPServer server;
+  std::promise<error_code> connected;
+  server.AsyncConnect(PORT, TIMEOUT, [&](const error_code &ec) { connected.set_value(ec); });
+  ASSERT_FALSE(connected.get_future().get()) << "missing echo client!";
+
+  const std::string message = Protobuf::Encode("Hello client!");
+  const auto length = message.size();
+  const const_buffer buffer = boost::asio::buffer(message);
+  auto received = std::make_unique<char[]>(length);
+
+  // Both operations are in flight at the same time, this thread does not
+  // block until we wait for the results.
+  std::promise<error_code> written;
+  std::promise<error_code> read;
+  server.AsyncWrite(carla::array_view::make_const(&buffer, 1u), TIMEOUT, [&](const error_code &ec) {
+    written.set_value(ec);
+  });
+  server.AsyncRead(boost::asio::buffer(received.get(), length), TIMEOUT, [&](const error_code &ec) {
+    read.set_value(ec);
+  });
+  ASSERT_FALSE(written.get_future().get());
+  ASSERT_FALSE(read.get_future().get());
+  ASSERT_EQ(message, std::string(received.get(), length));
+}
+
 TEST(TCPServer, ConnectTwice) {
   TCPServer server;
   ASSERT_FALSE(server.Connect(PORT, TIMEOUT)) << "missing echo client!";
@@ -68,3 +118,89 @@ TEST(TCPServer, AsyncDisconnect) {
 
   result.get();
 }
+
+TEST(TCPServer, SocketOptions) {
+  TCPOptions options;
+  options.no_delay = true;
+  options.send_buffer_size = 1024u * 1024u;
+  options.receive_buffer_size = 64u * 1024u;
+  TCPServer server;
+  server.SetOptions(options);
+  ASSERT_FALSE(server.Connect(PORT, TIMEOUT)) << "missing echo client!";
+
+  const std::string message = Protobuf::Encode("Hello client!");
+  ASSERT_FALSE(server.Write(boost::asio::buffer(message), TIMEOUT));
+  auto received = std::make_unique<char[]>(message.size());
+  ASSERT_FALSE(server.Read(boost::asio::buffer(received.get(), message.size()), TIMEOUT));
+  ASSERT_EQ(message, std::string(received.get(), message.size()));
+}
+
+// Unlike the tests above, the client runs in this process.
+static constexpr uint32_t IDLE_PORT = 3700u;
+
+static void ConnectLocal(boost::asio::ip::tcp::socket &socket, const uint32_t port) {
+  const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+  for (auto i = 0u; i < 100u; ++i) {
+    error_code ec;
+    socket.connect(endpoint, ec);
+    if (!ec) {
+      return;
+    }
+    socket.close();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  throw std::runtime_error("unable to connect");
+}
+
+// The time-out applies to each operation, a connection idle for longer in
+// between is not closed.
+TEST(TCPServerDeadline, IdleLongerThanTimeout) {
+  const auto timeout = milliseconds(300);
+  const auto idle = std::chrono::seconds(1);
+  const std::string message = "Hello!";
+  const auto length = message.size();
+
+  boost::asio::io_service service;
+  boost::asio::ip::tcp::socket client(service);
+  auto connected = std::async(std::launch::async, [&]() { ConnectLocal(client, IDLE_PORT); });
+
+  TCPServer server;
+  ASSERT_FALSE(server.Connect(IDLE_PORT, seconds(5)));
+  connected.get();
+
+  // Two writes.
+  std::string received(length, '\0');
+  ASSERT_FALSE(server.Write(boost::asio::buffer(message), timeout));
+  boost::asio::read(client, boost::asio::buffer(&received[0u], length));
+  ASSERT_EQ(message, received);
+  std::this_thread::sleep_for(idle);
+  ASSERT_FALSE(server.Write(boost::asio::buffer(message), timeout));
+  boost::asio::read(client, boost::asio::buffer(&received[0u], length));
+  ASSERT_EQ(message, received);
+
+  // Two reads.
+  boost::asio::write(client, boost::asio::buffer(message));
+  ASSERT_FALSE(server.Read(boost::asio::buffer(&received[0u], length), timeout));
+  ASSERT_EQ(message, received);
+  std::this_thread::sleep_for(idle);
+  boost::asio::write(client, boost::asio::buffer(message));
+  ASSERT_FALSE(server.Read(boost::asio::buffer(&received[0u], length), timeout));
+  ASSERT_EQ(message, received);
+}
+
+TEST(TCPServerDeadline, ReadTimedOut) {
+  boost::asio::io_service service;
+  boost::asio::ip::tcp::socket client(service);
+  auto connected = std::async(std::launch::async, [&]() { ConnectLocal(client, IDLE_PORT); });
+
+  TCPServer server;
+  ASSERT_FALSE(server.Connect(IDLE_PORT, seconds(5)));
+  connected.get();
+
+  char received[8u];
+  ASSERT_TRUE(server.Read(boost::asio::buffer(received), milliseconds(300)));
+  // The connection was closed by the time-out.
+  error_code ec;
+  boost::asio::read(client, boost::asio::buffer(received), ec);
+  ASSERT_EQ(boost::asio::error::eof, ec);
+}
@@ -0,0 +1,42 @@
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include <carla/server/ThreadSafeQueue.h>
+
+#include <memory>
+#include <vector>
+
+TEST(ThreadSafeQueue, MoveOnly) {
+  using namespace carla::server;
+
+  ThreadSafeQueue<std::unique_ptr<int>> queue;
+  queue.Push(std::make_unique<int>(0));
+  queue.Emplace(new int(1));
+
+  std::unique_ptr<int> value;
+  ASSERT_TRUE(queue.WaitAndPop(value));
+  ASSERT_EQ(0, *value);
+  ASSERT_TRUE(queue.TryPop(value));
+  ASSERT_EQ(1, *value);
+  ASSERT_FALSE(queue.TryPop(value));
+}
+
+TEST(ThreadSafeQueue, PopAll) {
+  using namespace carla::server;
+
+  ThreadSafeQueue<std::unique_ptr<int>> queue;
+  for (int i = 0; i < 10; ++i) {
+    queue.Emplace(std::make_unique<int>(i));
+  }
+
+  std::vector<std::unique_ptr<int>> values;
+  ASSERT_TRUE(queue.WaitAndPopAll(values));
+  ASSERT_EQ(10u, values.size());
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(i, *values[i]);
+  }
+  ASSERT_TRUE(queue.empty());
+  ASSERT_FALSE(queue.PopAll(values));
+  ASSERT_EQ(10u, values.size());
+}
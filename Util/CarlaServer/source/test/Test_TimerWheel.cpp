@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+
+#include <carla/server/IOExecutor.h>
+#include <carla/server/TimerWheel.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace carla::server;
+
+using clock_type = std::chrono::steady_clock;
+
+/// A wheel with a tick of a millisecond, and a thread running its timer.
+class TestWheel {
+public:
+
+  TestWheel()
+    : _work(std::make_unique<boost::asio::io_service::work>(_service)),
+      wheel(_service, std::chrono::milliseconds(1)),
+      _thread([this]() { _service.run(); }) {}
+
+  ~TestWheel() {
+    wheel.Stop();
+    _work = nullptr;
+    _thread.join();
+  }
+
+private:
+
+  boost::asio::io_service _service;
+
+  std::unique_ptr<boost::asio::io_service::work> _work;
+
+public:
+
+  TimerWheel wheel;
+
+private:
+
+  std::thread _thread;
+};
+
+static void WaitFor(const std::atomic<uint32_t> &count, const uint32_t expected) {
+  for (auto i = 0u; (i < 2000u) && (count < expected); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+TEST(TimerWheel, Expires) {
+  TestWheel test;
+  auto &wheel = test.wheel;
+
+  std::atomic<uint32_t> count{0u};
+  TimerWheel::Deadline deadline(wheel, [&]() { ++count; });
+  const auto start = clock_type::now();
+  deadline.ExpiresFromNow(boost::posix_time::milliseconds(20));
+  ASSERT_TRUE(deadline.IsArmed());
+  ASSERT_EQ(1u, wheel.size());
+  WaitFor(count, 1u);
+  ASSERT_EQ(1u, count);
+  ASSERT_GE(clock_type::now() - start, std::chrono::milliseconds(20));
+  ASSERT_FALSE(deadline.IsArmed());
+  ASSERT_EQ(0u, wheel.size());
+
+  // Armed again after going idle.
+  deadline.ExpiresFromNow(boost::posix_time::milliseconds(5));
+  WaitFor(count, 2u);
+  ASSERT_EQ(2u, count);
+}
+
+TEST(TimerWheel, ExpiresInHigherWheels) {
+  TestWheel test;
+  auto &wheel = test.wheel;
+
+  // Beyond the 64 ticks of the first wheel, cascaded down before expiring.
+  std::atomic<uint32_t> count{0u};
+  TimerWheel::Deadline deadline(wheel, [&]() { ++count; });
+  const auto start = clock_type::now();
+  deadline.ExpiresFromNow(boost::posix_time::milliseconds(150));
+  WaitFor(count, 1u);
+  ASSERT_EQ(1u, count);
+  ASSERT_GE(clock_type::now() - start, std::chrono::milliseconds(150));
+}
+
+TEST(TimerWheel, Rearm) {
+  TestWheel test;
+  auto &wheel = test.wheel;
+
+  std::atomic<uint32_t> count{0u};
+  TimerWheel::Deadline deadline(wheel, [&]() { ++count; });
+  for (auto i = 0u; i < 50u; ++i) {
+    deadline.ExpiresFromNow(boost::posix_time::milliseconds(20));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  ASSERT_EQ(0u, count);
+  ASSERT_EQ(1u, wheel.size());
+  WaitFor(count, 1u);
+  ASSERT_EQ(1u, count);
+}
+
+TEST(TimerWheel, Cancel) {
+  TestWheel test;
+  auto &wheel = test.wheel;
+
+  std::atomic<uint32_t> count{0u};
+  TimerWheel::Deadline deadline(wheel, [&]() { ++count; });
+  deadline.ExpiresFromNow(boost::posix_time::milliseconds(10));
+  deadline.Cancel();
+  ASSERT_FALSE(deadline.IsArmed());
+  ASSERT_EQ(0u, wheel.size());
+
+  // An infinite time-out cancels it too.
+  deadline.ExpiresFromNow(boost::posix_time::milliseconds(10));
+  deadline.ExpiresFromNow(boost::posix_time::pos_infin);
+  ASSERT_FALSE(deadline.IsArmed());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_EQ(0u, count);
+}
+
+TEST(TimerWheel, ManyDeadlines) {
+  TestWheel test;
+  auto &wheel = test.wheel;
+
+  constexpr auto number_of_deadlines = 500u;
+  std::atomic<uint32_t> count{0u};
+  std::vector<std::unique_ptr<TimerWheel::Deadline>> deadlines;
+  for (auto i = 0u; i < number_of_deadlines; ++i) {
+    deadlines.emplace_back(std::make_unique<TimerWheel::Deadline>(wheel, [&]() { ++count; }));
+    deadlines.back()->ExpiresFromNow(boost::posix_time::milliseconds(i % 200u));
+  }
+  // Every other one is cancelled.
+  for (auto i = 0u; i < number_of_deadlines; i += 2u) {
+    deadlines[i]->Cancel();
+  }
+  WaitFor(count, number_of_deadlines / 2u);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_EQ(number_of_deadlines / 2u, count);
+  ASSERT_EQ(0u, wheel.size());
+}
+
+TEST(TimerWheel, ExecutorWheel) {
+  IOExecutor executor(1u);
+  ASSERT_EQ(std::chrono::milliseconds(10), executor.timer_wheel().tick());
+
+  std::atomic<uint32_t> count{0u};
+  TimerWheel::Deadline deadline(executor.timer_wheel(), [&]() { ++count; });
+  deadline.ExpiresFromNow(boost::posix_time::milliseconds(30));
+  WaitFor(count, 1u);
+  ASSERT_EQ(1u, count);
+}
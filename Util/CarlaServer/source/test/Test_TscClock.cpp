@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+
+#include <carla/StopWatch.h>
+#include <carla/TscClock.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace carla;
+
+TEST(TscClock, IsMonotonic) {
+  auto previous = TscClock::now();
+  for (auto i = 0u; i < 100000u; ++i) {
+    const auto now = TscClock::now();
+    ASSERT_LE(previous, now);
+    previous = now;
+  }
+}
+
+TEST(TscClock, MatchesSteadyClock) {
+  using namespace std::chrono;
+  const auto steady_start = steady_clock::now();
+  const auto tsc_start = TscClock::now();
+  // Shares the epoch of steady_clock.
+  ASSERT_LT(std::abs(duration_cast<microseconds>(
+      tsc_start.time_since_epoch() - steady_start.time_since_epoch()).count()), 1000);
+  std::this_thread::sleep_for(milliseconds(50));
+  const auto tsc_elapsed = duration_cast<microseconds>(TscClock::now() - tsc_start).count();
+  const auto steady_elapsed = duration_cast<microseconds>(steady_clock::now() - steady_start).count();
+  // Within 2% plus the time between the two reads.
+  ASSERT_NEAR(static_cast<double>(steady_elapsed), static_cast<double>(tsc_elapsed), 0.02 * steady_elapsed + 200.0);
+}
+
+TEST(TscClock, StopWatch) {
+  TscStopWatch watch;
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  watch.Stop();
+  ASSERT_GE(watch.GetElapsedTime<std::chrono::microseconds>(), 10000);
+}
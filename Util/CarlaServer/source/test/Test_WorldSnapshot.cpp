@@ -0,0 +1,122 @@
+#include <future>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <carla/carla_server.h>
+#include <carla/server/carla_server.pb.h>
+
+#include "InProcessClient.h"
+
+#include <chrono>
+#include <thread>
+
+namespace cs = carla_server;
+using boost::asio::ip::tcp;
+using test::Connect;
+using test::ReadMessage;
+using test::WriteMessage;
+
+static constexpr uint32_t WORLD_PORT = 3200u;
+static constexpr uint32_t TIMEOUT = 6u * 1000u;
+
+static cs::WorldSnapshot RequestSnapshot(tcp::socket &world, const std::string &restore) {
+  cs::RequestNewEpisode request;
+  request.set_snapshot(true);
+  request.set_restore_snapshot(restore);
+  WriteMessage(world, request.SerializeAsString());
+  cs::WorldSnapshot snapshot;
+  if (!snapshot.ParseFromString(ReadMessage(world))) {
+    throw std::runtime_error("unexpected world snapshot");
+  }
+  return snapshot;
+}
+
+// Starts an episode, takes a snapshot and restores it, then starts the next
+// episode.
+static void RunClient(std::promise<void> &snapshot_restored) {
+  boost::asio::io_service service;
+  tcp::socket world(service);
+  Connect(world, WORLD_PORT);
+  cs::RequestNewEpisode request;
+  request.set_ini_file("first");
+  WriteMessage(world, request.SerializeAsString());
+  ReadMessage(world); // scene description.
+  WriteMessage(world, cs::EpisodeStart().SerializeAsString());
+  ReadMessage(world); // episode ready.
+  const auto taken = RequestSnapshot(world, "");
+  if (!taken.success() || (taken.data() != "state")) {
+    throw std::runtime_error("unexpected snapshot taken");
+  }
+  const auto restored = RequestSnapshot(world, taken.data());
+  if (!restored.success() || !restored.data().empty()) {
+    throw std::runtime_error("unexpected snapshot restored");
+  }
+  snapshot_restored.set_value();
+  request.set_ini_file("second");
+  WriteMessage(world, request.SerializeAsString());
+  ReadMessage(world); // scene description.
+}
+
+TEST(WorldSnapshot, TakeAndRestore) {
+  const auto deleter = [](void *ptr) { carla_free_server(ptr); };
+  auto CarlaServerGuard = std::unique_ptr<void, decltype(deleter)>(carla_make_server(), deleter);
+  CarlaServerPtr CarlaServer = CarlaServerGuard.get();
+  ASSERT_TRUE(CarlaServer != nullptr);
+
+  const auto S = CARLA_SERVER_SUCCESS;
+  const carla_transform start_locations[] = {
+    {carla_vector3d{0.0f, 0.0f, 0.0f}, carla_vector3d{0.0f, 0.0f, 0.0f}}
+  };
+
+  std::promise<void> snapshot_restored;
+  auto snapshot_restored_future = snapshot_restored.get_future();
+  auto client = std::async(std::launch::async, [&]() { RunClient(snapshot_restored); });
+
+  ASSERT_EQ(S, carla_server_connect(CarlaServer, WORLD_PORT, TIMEOUT));
+  carla_request_new_episode values;
+  ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  carla_world_snapshot_request request;
+  ASSERT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_world_snapshot_request(CarlaServer, request));
+  const carla_world_snapshot no_request{true, nullptr, 0u};
+  ASSERT_NE(S, carla_write_world_snapshot(CarlaServer, no_request, TIMEOUT));
+  const carla_scene_description scene{start_locations, 1u, nullptr};
+  ASSERT_EQ(S, carla_write_scene_description(CarlaServer, scene, TIMEOUT));
+  carla_episode_start episode_start;
+  ASSERT_EQ(S, carla_read_episode_start(CarlaServer, episode_start, TIMEOUT));
+  const carla_episode_ready episode_ready{true};
+  ASSERT_EQ(S, carla_write_episode_ready(CarlaServer, episode_ready, TIMEOUT));
+
+  // Snapshot requests do not end the episode.
+  auto read_snapshot_request = [&]() {
+    for (auto i = 0u; i < 200u; ++i) {
+      EXPECT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_request_new_episode(CarlaServer, values, 0u));
+      if (carla_read_world_snapshot_request(CarlaServer, request) == S) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+  };
+
+  ASSERT_TRUE(read_snapshot_request());
+  ASSERT_EQ(0u, request.restore_data_length);
+  ASSERT_EQ(CARLA_SERVER_TRY_AGAIN, carla_read_world_snapshot_request(CarlaServer, request));
+  const std::string state = "state";
+  const carla_world_snapshot taken{true, state.data(), static_cast<uint32_t>(state.size())};
+  ASSERT_EQ(S, carla_write_world_snapshot(CarlaServer, taken, TIMEOUT));
+
+  ASSERT_TRUE(read_snapshot_request());
+  ASSERT_EQ(state, std::string(static_cast<const char *>(request.restore_data), request.restore_data_length));
+  const carla_world_snapshot restored{true, nullptr, 0u};
+  ASSERT_EQ(S, carla_write_world_snapshot(CarlaServer, restored, TIMEOUT));
+  snapshot_restored_future.wait();
+
+  ASSERT_EQ(S, carla_read_request_new_episode(CarlaServer, values, TIMEOUT));
+  ASSERT_EQ("second", std::string(values.ini_file, values.ini_file_length));
+  ASSERT_EQ(S, carla_write_scene_description(CarlaServer, scene, TIMEOUT));
+  client.get();
+}
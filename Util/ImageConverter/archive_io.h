@@ -0,0 +1,308 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "image_converter_types.h"
+
+namespace image_converter {
+namespace detail {
+
+  /// Size of a tar block, headers and data are padded to a multiple of it.
+  static constexpr size_t TAR_BLOCK_SIZE = 512u;
+
+  /// Fields of a ustar header, see POSIX.1-1988.
+  struct tar_header {
+    char name[100u];
+    char mode[8u];
+    char uid[8u];
+    char gid[8u];
+    char size[12u];
+    char mtime[12u];
+    char checksum[8u];
+    char typeflag;
+    char linkname[100u];
+    char magic[6u];
+    char version[2u];
+    char uname[32u];
+    char gname[32u];
+    char devmajor[8u];
+    char devminor[8u];
+    char prefix[155u];
+    char padding[12u];
+  };
+
+  static_assert(sizeof(tar_header) == TAR_BLOCK_SIZE, "invalid tar header size");
+
+  static size_t tar_padded_size(size_t size) {
+    return (size + TAR_BLOCK_SIZE - 1u) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+  }
+
+  /// Sum of the header bytes, with the checksum field counted as spaces.
+  static uint32 tar_checksum(const tar_header &header) {
+    const auto *bytes = reinterpret_cast<const uint8 *>(&header);
+    uint32 sum = 0u;
+    for (auto i = 0u; i < TAR_BLOCK_SIZE; ++i) {
+      sum += bytes[i];
+    }
+    for (auto byte : header.checksum) {
+      sum += uint8(' ') - static_cast<uint8>(byte);
+    }
+    return sum;
+  }
+
+  static size_t parse_tar_octal(const char *field, size_t size) {
+    size_t value = 0u;
+    for (auto i = 0u; (i < size) && (field[i] != '\0') && (field[i] != ' '); ++i) {
+      if ((field[i] < '0') || (field[i] > '7')) {
+        throw std::runtime_error("invalid tar archive: malformed number");
+      }
+      value = 8u * value + static_cast<size_t>(field[i] - '0');
+    }
+    return value;
+  }
+
+  /// Writes @a value as zero-padded octal digits followed by a null.
+  static void write_tar_octal(char *field, size_t size, size_t value) {
+    std::snprintf(field, size, "%0*llo", static_cast<int>(size - 1u), static_cast<unsigned long long>(value));
+  }
+
+} // namespace detail
+
+  // ===========================================================================
+  // -- archive_entry ----------------------------------------------------------
+  // ===========================================================================
+
+  /// A file of an archive. The data belongs to the archive.
+  struct archive_entry {
+    std::string name;
+    const uint8 *data = nullptr;
+    size_t size = 0u;
+  };
+
+  // ===========================================================================
+  // -- tar_reader -------------------------------------------------------------
+  // ===========================================================================
+
+  /// Reads the regular files of a tar archive (ustar, plus the GNU long names)
+  /// in order. The archive is memory-mapped and read sequentially, so a shard
+  /// of many small images costs a single open and large reads.
+  class tar_reader {
+  public:
+
+    explicit tar_reader(const std::string &filename)
+      : _file(filename.c_str(), boost::interprocess::read_only),
+        _region(_file, boost::interprocess::read_only),
+        _position(static_cast<const uint8 *>(_region.get_address())),
+        _end(_position + _region.get_size()) {
+      _region.advise(boost::interprocess::mapped_region::advice_sequential);
+    }
+
+    /// Reads the next regular file into @a entry, returns false at the end of
+    /// the archive. The data is valid while the reader lives. Throws
+    /// std::runtime_error if the archive is malformed.
+    bool next(archive_entry &entry) {
+      std::string long_name;
+      while (block_left() && !is_end_block()) {
+        detail::tar_header header;
+        std::memcpy(&header, _position, sizeof(header));
+        check(std::strncmp(header.magic, "ustar", 5u) == 0, "not a ustar header");
+        check(
+            detail::parse_tar_octal(header.checksum, sizeof(header.checksum)) == detail::tar_checksum(header),
+            "header checksum mismatch");
+        const auto size = detail::parse_tar_octal(header.size, sizeof(header.size));
+        const auto *data = _position + sizeof(header);
+        check(detail::tar_padded_size(size) <= static_cast<size_t>(_end - data), "truncated entry");
+        _position = data + detail::tar_padded_size(size);
+        if (header.typeflag == 'L') {
+          long_name.assign(reinterpret_cast<const char *>(data), size);
+          long_name.resize(std::strlen(long_name.c_str()));
+        } else if ((header.typeflag == '0') || (header.typeflag == '\0')) {
+          entry.name = long_name.empty() ? make_name(header) : long_name;
+          entry.data = data;
+          entry.size = size;
+          return true;
+        } else {
+          // Folders, links and extended headers.
+          long_name.clear();
+        }
+      }
+      return false;
+    }
+
+  private:
+
+    static void check(bool condition, const char *what) {
+      if (!condition) {
+        throw std::runtime_error(std::string("invalid tar archive: ") + what);
+      }
+    }
+
+    static std::string field(const char *begin, size_t size) {
+      return std::string(begin, std::find(begin, begin + size, '\0'));
+    }
+
+    static std::string make_name(const detail::tar_header &header) {
+      const auto prefix = field(header.prefix, sizeof(header.prefix));
+      const auto name = field(header.name, sizeof(header.name));
+      return prefix.empty() ? name : prefix + "/" + name;
+    }
+
+    bool block_left() const {
+      return static_cast<size_t>(_end - _position) >= detail::TAR_BLOCK_SIZE;
+    }
+
+    bool is_end_block() const {
+      return std::all_of(_position, _position + detail::TAR_BLOCK_SIZE, [](uint8 byte) { return byte == 0u; });
+    }
+
+    boost::interprocess::file_mapping _file;
+
+    boost::interprocess::mapped_region _region;
+
+    const uint8 *_position;
+
+    const uint8 *_end;
+  };
+
+  // ===========================================================================
+  // -- tar_writer -------------------------------------------------------------
+  // ===========================================================================
+
+  /// Writes files into tar archives of up to @a shard_size files each
+  /// (shard_00000.tar, shard_00001.tar...) in @a folder, through a large
+  /// buffer so the disk sees big sequential writes. Thread-safe, the files
+  /// are stored in the order they are written.
+  class tar_writer {
+  public:
+
+    tar_writer(std::string folder, uint32 shard_size)
+      : _folder(std::move(folder)),
+        _shard_size(std::max<uint32>(1u, shard_size)),
+        _buffer(new char[BUFFER_SIZE]) {}
+
+    ~tar_writer() {
+      try {
+        close();
+      } catch (const std::exception &e) {
+        std::fprintf(stderr, "error closing archive: %s\n", e.what());
+      }
+    }
+
+    /// Throws std::invalid_argument if the name is longer than a ustar header
+    /// holds (100 characters, or 255 split at a '/').
+    void write(const std::string &name, const uint8 *data, size_t size) {
+      detail::tar_header header;
+      make_header(name, size, header);
+      static const char zeros[detail::TAR_BLOCK_SIZE] = {};
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_shard.is_open() && (_count == _shard_size)) {
+        close_shard();
+      }
+      if (!_shard.is_open()) {
+        open_shard();
+      }
+      _shard.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      _shard.write(reinterpret_cast<const char *>(data), size);
+      _shard.write(zeros, detail::tar_padded_size(size) - size);
+      ++_count;
+      check();
+    }
+
+    /// Finishes the shard being written, if any.
+    void close() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_shard.is_open()) {
+        close_shard();
+      }
+    }
+
+  private:
+
+    static constexpr size_t BUFFER_SIZE = 4u << 20u;
+
+    static void make_header(const std::string &name, size_t size, detail::tar_header &header) {
+      std::memset(&header, 0, sizeof(header));
+      auto split = std::string::npos;
+      if (name.size() > sizeof(header.name)) {
+        split = name.rfind('/', sizeof(header.prefix));
+        if ((split == std::string::npos) || (name.size() - split - 1u > sizeof(header.name))) {
+          throw std::invalid_argument("name too long for a tar archive: " + name);
+        }
+        std::memcpy(header.prefix, name.data(), split);
+      }
+      const auto base = (split == std::string::npos ? 0u : split + 1u);
+      std::memcpy(header.name, name.data() + base, name.size() - base);
+      detail::write_tar_octal(header.mode, sizeof(header.mode), 0644u);
+      detail::write_tar_octal(header.uid, sizeof(header.uid), 0u);
+      detail::write_tar_octal(header.gid, sizeof(header.gid), 0u);
+      detail::write_tar_octal(header.size, sizeof(header.size), size);
+      detail::write_tar_octal(header.mtime, sizeof(header.mtime), 0u);
+      header.typeflag = '0';
+      std::memcpy(header.magic, "ustar", 6u);
+      std::memcpy(header.version, "00", 2u);
+      // Six digits, a null and a space.
+      std::snprintf(header.checksum, sizeof(header.checksum), "%06o", static_cast<unsigned>(detail::tar_checksum(header)));
+      header.checksum[7u] = ' ';
+    }
+
+    void check() const {
+      if (!_shard) {
+        throw std::runtime_error("error writing file: " + _shard_filename);
+      }
+    }
+
+    void open_shard() {
+      char name[32u];
+      std::snprintf(name, sizeof(name), "shard_%05u.tar", static_cast<unsigned>(_next_shard++));
+      _shard_filename = _folder + "/" + name;
+      _shard.rdbuf()->pubsetbuf(_buffer.get(), BUFFER_SIZE);
+      _shard.open(_shard_filename, std::ios::binary);
+      if (!_shard) {
+        throw std::runtime_error("cannot open file: " + _shard_filename);
+      }
+      _count = 0u;
+    }
+
+    void close_shard() {
+      // The archive ends with two zero blocks.
+      static const char zeros[2u * detail::TAR_BLOCK_SIZE] = {};
+      _shard.write(zeros, sizeof(zeros));
+      _shard.close();
+      check();
+      _shard.clear();
+    }
+
+    const std::string _folder;
+
+    const uint32 _shard_size;
+
+    const std::unique_ptr<char[]> _buffer;
+
+    std::mutex _mutex;
+
+    std::ofstream _shard;
+
+    std::string _shard_filename;
+
+    uint32 _next_shard = 0u;
+
+    uint32 _count = 0u;
+  };
+
+} // namespace image_converter
@@ -0,0 +1,437 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+// Throughput of the converters and of the image formats on synthetic images,
+// in megapixels per second. The results of the vector kernels are checked
+// against the per-pixel converters, exits with an error if they differ.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/gil/image_view_factory.hpp>
+#include <boost/program_options.hpp>
+
+#include "image_converter.h"
+#include "image_converter_api.h"
+
+enum MainFunctionReturnValues {
+  Success,
+  InvalidArgument,
+  UnknownException,
+  MismatchFound
+};
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+namespace gil = boost::gil;
+namespace ic = image_converter;
+
+struct image_size {
+  ic::uint32 width;
+  ic::uint32 height;
+};
+
+// Common camera sizes.
+static const image_size IMAGE_SIZES[] = {
+  {800u, 600u},
+  {1280u, 720u},
+  {1920u, 1080u}
+};
+
+struct benchmark_options {
+  ic::uint32 repetitions = 5u;
+  ic::uint32 threads = 1u;
+  fs::path temp_folder;
+};
+
+static bool g_mismatch_found = false;
+
+// ============================================================================
+// -- Synthetic images --------------------------------------------------------
+// ============================================================================
+
+// Depth encoded as the server does, a ramp from near to far with noise in the
+// lowest byte so every channel takes many values.
+static gil::rgb8_image_t make_depth_image(const image_size &size, std::mt19937 &rng) {
+  gil::rgb8_image_t image(size.width, size.height);
+  const auto view = gil::view(image);
+  std::uniform_int_distribution<int> noise(0, 255);
+  for (auto y = 0; y < view.height(); ++y) {
+    for (auto x = 0; x < view.width(); ++x) {
+      const auto ramp = static_cast<uint32_t>((static_cast<uint64_t>(y * view.width() + x) << 24u) / view.size());
+      const auto depth = (ramp & ~0xffu) | static_cast<uint32_t>(noise(rng));
+      view(x, y) = gil::rgb8_pixel_t(depth & 0xffu, (depth >> 8u) & 0xffu, (depth >> 16u) & 0xffu);
+    }
+  }
+  return image;
+}
+
+// Label ids in the red channel, in blocks as objects would be, with a few
+// out-of-range ids.
+static gil::rgb8_image_t make_label_image(const image_size &size, std::mt19937 &rng) {
+  gil::rgb8_image_t image(size.width, size.height);
+  const auto view = gil::view(image);
+  std::uniform_int_distribution<int> label(0, 12);
+  std::uniform_int_distribution<int> any(0, 255);
+  for (auto y = 0; y < view.height(); ++y) {
+    for (auto x = 0; x < view.width(); x += 8) {
+      const auto id = (rng() % 64u == 0u ? any(rng) : label(rng));
+      for (auto i = x; i < std::min<int>(x + 8, view.width()); ++i) {
+        view(i, y) = gil::rgb8_pixel_t(id, 0, 0);
+      }
+    }
+  }
+  return image;
+}
+
+// The same pixels as the server sends them, BGRA.
+static std::vector<ic::uint8> to_bgra(const gil::rgb8_image_t &image) {
+  const auto view = gil::const_view(image);
+  std::vector<ic::uint8> bgra;
+  bgra.reserve(4u * view.size());
+  for (auto y = 0; y < view.height(); ++y) {
+    for (auto x = 0; x < view.width(); ++x) {
+      const auto &pixel = view(x, y);
+      bgra.insert(bgra.end(), {pixel[2], pixel[1], pixel[0], 255u});
+    }
+  }
+  return bgra;
+}
+
+// ============================================================================
+// -- Measurements ------------------------------------------------------------
+// ============================================================================
+
+// Best time of the repetitions of run(), prepare() is called before each one
+// and not timed.
+template <typename PREPARE, typename RUN>
+static double best_seconds(ic::uint32 repetitions, PREPARE &&prepare, RUN &&run) {
+  auto best = 1e30;
+  for (auto i = 0u; i < std::max<ic::uint32>(1u, repetitions); ++i) {
+    prepare();
+    const auto start = std::chrono::steady_clock::now();
+    run();
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(end - start).count());
+  }
+  return best;
+}
+
+static void report(const std::string &what, const image_size &size, double seconds, const std::string &check = "") {
+  const auto megapixels = 1e-6 * size.width * size.height;
+  std::printf(
+      "%-32s %4ux%-4u %10.1f MP/s %s\n",
+      what.c_str(),
+      static_cast<unsigned>(size.width),
+      static_cast<unsigned>(size.height),
+      megapixels / std::max(seconds, 1e-12),
+      check.c_str());
+}
+
+static std::string format_float(float value) {
+  char buffer[32u];
+  std::snprintf(buffer, sizeof(buffer), "%g", value);
+  return buffer;
+}
+
+static bool same_pixels(const gil::rgb8_image_t &lhs, const gil::rgb8_image_t &rhs) {
+  return (lhs.dimensions() == rhs.dimensions()) && gil::equal_pixels(gil::const_view(lhs), gil::const_view(rhs));
+}
+
+static std::string mismatch(const std::string &what) {
+  g_mismatch_found = true;
+  return "MISMATCH " + what;
+}
+
+// Runs converter over the rows of view split among threads.
+template <typename IMAGE_CONVERTER>
+static void convert_in_threads(const IMAGE_CONVERTER &converter, const gil::rgb8_view_t &view, ic::uint32 threads) {
+  if (threads <= 1u) {
+    converter(view);
+    return;
+  }
+  std::vector<std::thread> workers;
+  const auto rows = (view.height() + static_cast<int>(threads) - 1) / static_cast<int>(threads);
+  for (auto y = 0; y < view.height(); y += rows) {
+    const auto height = std::min(rows, view.height() - y);
+    workers.emplace_back([&converter, &view, y, height]() {
+      converter(gil::subimage_view(view, 0, y, view.width(), height));
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// ============================================================================
+// -- Converters --------------------------------------------------------------
+// ============================================================================
+
+// Compares an image converter with the per-pixel converter it replaces.
+// Channels may differ by up to max_difference.
+template <typename IMAGE_CONVERTER, typename PIXEL_CONVERTER>
+static void benchmark_image_converter(
+    const std::string &name,
+    const gil::rgb8_image_t &source,
+    const benchmark_options &options,
+    int max_difference) {
+  const image_size size = {
+      static_cast<ic::uint32>(source.width()),
+      static_cast<ic::uint32>(source.height())};
+  const PIXEL_CONVERTER pixel_converter{};
+  const IMAGE_CONVERTER image_converter{};
+
+  gil::rgb8_image_t reference(source);
+  const auto scalar_seconds = best_seconds(
+      options.repetitions,
+      [&]() { gil::copy_pixels(gil::const_view(source), gil::view(reference)); },
+      [&]() {
+        for (auto &pixel : gil::view(reference)) {
+          pixel_converter(pixel);
+        }
+      });
+  report(name + " per pixel", size, scalar_seconds);
+
+  gil::rgb8_image_t converted(source);
+  const auto seconds = best_seconds(
+      options.repetitions,
+      [&]() { gil::copy_pixels(gil::const_view(source), gil::view(converted)); },
+      [&]() { convert_in_threads(image_converter, gil::view(converted), options.threads); });
+
+  auto worst = 0;
+  auto different = 0u;
+  const auto expected = gil::const_view(reference);
+  const auto actual = gil::const_view(converted);
+  for (auto y = 0; y < expected.height(); ++y) {
+    for (auto x = 0; x < expected.width(); ++x) {
+      for (auto channel = 0; channel < 3; ++channel) {
+        const auto difference = std::abs(int(expected(x, y)[channel]) - int(actual(x, y)[channel]));
+        worst = std::max(worst, difference);
+        different += (difference != 0 ? 1u : 0u);
+      }
+    }
+  }
+  std::string check = "exact";
+  if (worst > max_difference) {
+    check = mismatch("(max difference " + std::to_string(worst) + ")");
+  } else if (worst > 0) {
+    check = std::to_string(different) + " channels off by " + std::to_string(worst);
+  }
+  report(name + " x" + std::to_string(options.threads) + " threads", size, seconds, check);
+}
+
+// Compares the tensor of a batch of BGRA images with the per-pixel math.
+template <typename TRANSFORM>
+static void benchmark_depth_tensor(
+    const std::string &name,
+    bool logarithmic,
+    const gil::rgb8_image_t &source,
+    const benchmark_options &options,
+    float max_difference) {
+  const image_size size = {
+      static_cast<ic::uint32>(source.width()),
+      static_cast<ic::uint32>(source.height())};
+  const auto bgra = to_bgra(source);
+  const ic::raw_image image = {
+      size.width,
+      size.height,
+      ic::raw_image::Depth,
+      CARLA_SERVER_IMAGE_BGRA8,
+      4u,
+      bgra.data()};
+  std::vector<float> tensor(static_cast<size_t>(size.width) * size.height);
+  const auto seconds = best_seconds(
+      options.repetitions,
+      []() {},
+      [&]() { ic::convert_depth_batch(&image, 1u, logarithmic, tensor.data()); });
+
+  auto worst = 0.0f;
+  for (auto i = 0u; i < tensor.size(); ++i) {
+    const auto expected = TRANSFORM::apply(ic::detail::normalized_depth(bgra.data() + 4u * i));
+    worst = std::max(worst, std::abs(expected - tensor[i]));
+  }
+  std::string check = "exact";
+  if (worst > max_difference) {
+    check = mismatch("(max difference " + format_float(worst) + ")");
+  } else if (worst > 0.0f) {
+    check = "max difference " + format_float(worst);
+  }
+  report(name + " tensor", size, seconds, check);
+}
+
+static void benchmark_label_tensor(const gil::rgb8_image_t &source, const benchmark_options &options) {
+  const image_size size = {
+      static_cast<ic::uint32>(source.width()),
+      static_cast<ic::uint32>(source.height())};
+  const auto bgra = to_bgra(source);
+  const ic::raw_image image = {
+      size.width,
+      size.height,
+      ic::raw_image::SemanticSegmentation,
+      CARLA_SERVER_IMAGE_BGRA8,
+      4u,
+      bgra.data()};
+  std::vector<ic::uint8> tensor(static_cast<size_t>(size.width) * size.height);
+  const auto seconds = best_seconds(
+      options.repetitions,
+      []() {},
+      [&]() { ic::convert_labels_batch(&image, 1u, tensor.data()); });
+  auto matches = true;
+  for (auto i = 0u; i < tensor.size(); ++i) {
+    matches = matches && (tensor[i] == bgra[4u * i + 2u]);
+  }
+  report("semseg tensor", size, seconds, matches ? "exact" : mismatch(""));
+}
+
+// ============================================================================
+// -- Image formats -----------------------------------------------------------
+// ============================================================================
+
+// Writes and reads back the image with WRITER and READER, lossless formats
+// must give back the very same pixels.
+template <typename WRITER, typename READER>
+static void benchmark_format(
+    const std::string &name,
+    const std::string &extension,
+    const gil::rgb8_image_t &source,
+    const benchmark_options &options,
+    const ic::write_options &write_options,
+    bool lossless) {
+  const image_size size = {
+      static_cast<ic::uint32>(source.width()),
+      static_cast<ic::uint32>(source.height())};
+  const auto filename = (options.temp_folder / ("benchmark" + extension)).string();
+  const auto write_seconds = best_seconds(
+      options.repetitions,
+      []() {},
+      [&]() { WRITER::write_view(filename.c_str(), gil::const_view(source), write_options); });
+  report(name + " write", size, write_seconds);
+
+  gil::rgb8_image_t decoded;
+  const auto read_seconds = best_seconds(
+      options.repetitions,
+      []() {},
+      [&]() { READER::read_image(filename.c_str(), decoded); });
+  std::string check;
+  if (lossless) {
+    check = same_pixels(source, decoded) ? "exact" : mismatch("");
+  }
+  report(name + " read", size, read_seconds, check);
+  fs::remove(filename);
+}
+
+static void benchmark_formats(const gil::rgb8_image_t &source, const benchmark_options &options) {
+  ic::write_options defaults;
+#if IMAGE_CONVERTER_WITH_PNG_SUPPORT
+  using png_writer = ic::detail::png_writer;
+  using png_reader = ic::detail::png_reader;
+  ic::write_options fast;
+  fast.fast_png = true;
+  benchmark_format<png_writer, png_reader>("png", ".png", source, options, defaults, true);
+  benchmark_format<png_writer, png_reader>("png fast", ".png", source, options, fast, true);
+
+  // In memory, as the archives do.
+  const image_size size = {
+      static_cast<ic::uint32>(source.width()),
+      static_cast<ic::uint32>(source.height())};
+  std::vector<ic::uint8> buffer;
+  const auto encode_seconds = best_seconds(
+      options.repetitions,
+      []() {},
+      [&]() { png_writer::encode_view(gil::const_view(source), defaults, buffer); });
+  report("png memory encode", size, encode_seconds);
+  gil::rgb8_image_t decoded;
+  const auto decode_seconds = best_seconds(
+      options.repetitions,
+      []() {},
+      [&]() { png_reader::decode_image(buffer.data(), buffer.size(), decoded); });
+  report("png memory decode", size, decode_seconds, same_pixels(source, decoded) ? "exact" : mismatch(""));
+#endif // IMAGE_CONVERTER_WITH_PNG_SUPPORT
+#if IMAGE_CONVERTER_WITH_JPEG_SUPPORT
+  benchmark_format<ic::detail::jpeg_writer, ic::detail::jpeg_reader>("jpeg", ".jpg", source, options, defaults, false);
+#endif // IMAGE_CONVERTER_WITH_JPEG_SUPPORT
+#if IMAGE_CONVERTER_WITH_TIFF_SUPPORT
+  benchmark_format<ic::detail::tiff_writer, ic::detail::tiff_reader>("tiff", ".tiff", source, options, defaults, true);
+#endif // IMAGE_CONVERTER_WITH_TIFF_SUPPORT
+}
+
+// ============================================================================
+// -- main --------------------------------------------------------------------
+// ============================================================================
+
+static void run_benchmark(const benchmark_options &options) {
+  std::mt19937 rng(0u);
+  for (const auto &size : IMAGE_SIZES) {
+    const auto depth = make_depth_image(size, rng);
+    const auto labels = make_label_image(size, rng);
+
+    benchmark_image_converter<ic::depth_image_converter, ic::depth_pixel_converter>(
+        "depth", depth, options, 0);
+    // The vector logarithm may round one gray level differently.
+    benchmark_image_converter<ic::logarithmic_depth_image_converter, ic::logarithmic_depth_pixel_converter>(
+        "logdepth", depth, options, 1);
+    benchmark_image_converter<ic::label_image_converter, ic::label_pixel_converter>(
+        "semseg", labels, options, 0);
+
+    benchmark_depth_tensor<ic::detail::linear_depth_transform>("depth", false, depth, options, 0.0f);
+    benchmark_depth_tensor<ic::detail::logarithmic_depth_transform>("logdepth", true, depth, options, 1.0f / 255.0f);
+    benchmark_label_tensor(labels, options);
+
+    benchmark_formats(depth, options);
+    std::cout << std::endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    benchmark_options options;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+      ("help,h", "produce help message")
+      ("repetitions,r", po::value<ic::uint32>(&options.repetitions)->default_value(5u), "runs of each measurement, the best one is reported")
+      ("threads,t", po::value<ic::uint32>(&options.threads)->default_value(1u), "threads running the image converters")
+      ("temp-folder", po::value<fs::path>(&options.temp_folder)->default_value(fs::temp_directory_path()), "folder for the files of the image formats")
+      ;
+
+    try {
+      po::variables_map vm;
+      po::store(po::parse_command_line(argc, argv, desc), vm);
+      if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return Success;
+      }
+      po::notify(vm);
+      if (!fs::is_directory(options.temp_folder)) {
+        throw po::error("not a folder: " + options.temp_folder.string());
+      }
+    } catch (const po::error &e) {
+      std::cerr << desc << "\n" << e.what() << std::endl;
+      return InvalidArgument;
+    }
+
+    run_benchmark(options);
+
+  } catch (const std::exception &e) {
+    std::cerr << "unexpected exception thrown: " << e.what() << std::endl;
+    return UnknownException;
+  }
+
+  if (g_mismatch_found) {
+    std::cerr << "some results do not match, see MISMATCH above" << std::endl;
+    return MismatchFound;
+  }
+  return Success;
+}
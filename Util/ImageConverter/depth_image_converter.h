@@ -0,0 +1,219 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cfloat>
+
+#include "depth_pixel_converter.h"
+#include "image_converter_types.h"
+#include "simd_math.h"
+
+namespace image_converter {
+namespace detail {
+
+  // ===========================================================================
+  // -- Depth transforms -------------------------------------------------------
+  // ===========================================================================
+
+  // Vector versions of the per-pixel math in depth_pixel_converter.h, applied
+  // to the normalized depth. The linear one gives the very same gray levels,
+  // the logarithmic one may differ in one level at the boundaries.
+
+  struct linear_depth_transform {
+    static float apply(float depth) {
+      return depth;
+    }
+
+    template <typename V>
+    static typename V::f apply(typename V::f depth) {
+      return depth;
+    }
+  };
+
+  struct logarithmic_depth_transform {
+    static float apply(float depth) {
+      return clamp(logdepth(depth));
+    }
+
+    template <typename V>
+    static typename V::f apply(typename V::f depth) {
+      // log(0) would be -inf, clamped to zero anyway.
+      const auto safe_depth = V::max(depth, V::set1(FLT_MIN));
+      const auto value = V::add(V::set1(1.0f), V::div(simd::log<V>(safe_depth), V::set1(5.70378f)));
+      return V::max(V::min(value, V::set1(1.0f)), V::set1(0.0f));
+    }
+  };
+
+  /// Depth in [0, 1] encoded in the channels @a r, @a g and @a b.
+  template <typename V>
+  static inline typename V::f normalized_depth(
+      typename V::i r,
+      typename V::i g,
+      typename V::i b) {
+    const auto value = V::add_i(r, V::add_i(V::template shift_left<8>(g), V::template shift_left<16>(b)));
+    return V::div(V::to_float(value), V::set1(static_cast<float>(256 * 256 * 256 - 1)));
+  }
+
+  /// Gray level of the pixels with channels @a r, @a g and @a b.
+  template <typename V, typename TRANSFORM>
+  static inline typename V::i depth_to_grayscale(
+      typename V::i r,
+      typename V::i g,
+      typename V::i b) {
+    const auto depth = TRANSFORM::template apply<V>(normalized_depth<V>(r, g, b));
+    return V::truncate(V::mul(V::set1(255.0f), depth));
+  }
+
+  // ===========================================================================
+  // -- Row kernels ------------------------------------------------------------
+  // ===========================================================================
+
+  /// Pixels converted at once by convert_depth_block.
+  constexpr static uint32 DEPTH_BLOCK_SIZE = 16u;
+
+#if defined(IMAGE_CONVERTER_WITH_SSE)
+
+  /// pshufb masks to split 16 RGB pixels into channels and back.
+  struct rgb_shuffle_masks {
+    rgb_shuffle_masks() {
+      for (auto chunk = 0; chunk < 3; ++chunk) {
+        alignas(16) int8_t mask[16u];
+        for (auto channel = 0; channel < 3; ++channel) {
+          for (auto i = 0; i < 16; ++i) {
+            const auto index = 3 * i + channel - 16 * chunk;
+            mask[i] = static_cast<int8_t>((index >= 0) && (index < 16) ? index : -1);
+          }
+          split[channel][chunk] = _mm_load_si128(reinterpret_cast<const __m128i *>(mask));
+        }
+        for (auto i = 0; i < 16; ++i) {
+          mask[i] = static_cast<int8_t>((16 * chunk + i) / 3);
+        }
+        gray[chunk] = _mm_load_si128(reinterpret_cast<const __m128i *>(mask));
+      }
+    }
+
+    /// split[channel][chunk] moves the channel bytes of a chunk in place.
+    __m128i split[3u][3u];
+
+    /// gray[chunk] spreads 16 gray levels over the three channels of a chunk.
+    __m128i gray[3u];
+  };
+
+  static inline __m128i split_channel(const rgb_shuffle_masks &masks, const __m128i (&chunks)[3u], int channel) {
+    return _mm_or_si128(
+        _mm_or_si128(
+            _mm_shuffle_epi8(chunks[0u], masks.split[channel][0u]),
+            _mm_shuffle_epi8(chunks[1u], masks.split[channel][1u])),
+        _mm_shuffle_epi8(chunks[2u], masks.split[channel][2u]));
+  }
+
+  template <typename TRANSFORM>
+  static inline __m128i depth_to_grayscale16(__m128i r, __m128i g, __m128i b) {
+#if defined(IMAGE_CONVERTER_WITH_AVX2)
+    using V = simd::avx2_ops;
+    const auto widen = [](__m128i bytes, int half) {
+      return _mm256_cvtepu8_epi32(half == 0 ? bytes : _mm_srli_si128(bytes, 8));
+    };
+    __m128i words[2u];
+    for (auto half = 0; half < 2; ++half) {
+      const auto gray = depth_to_grayscale<V, TRANSFORM>(widen(r, half), widen(g, half), widen(b, half));
+      words[half] = _mm_packs_epi32(_mm256_castsi256_si128(gray), _mm256_extracti128_si256(gray, 1));
+    }
+    return _mm_packus_epi16(words[0u], words[1u]);
+#else
+    using V = simd::sse_ops;
+    const auto zero = _mm_setzero_si128();
+    const auto widen = [zero](__m128i bytes, int quarter) {
+      const auto words = (quarter < 2) ? _mm_unpacklo_epi8(bytes, zero) : _mm_unpackhi_epi8(bytes, zero);
+      return (quarter % 2 == 0) ? _mm_unpacklo_epi16(words, zero) : _mm_unpackhi_epi16(words, zero);
+    };
+    __m128i gray[4u];
+    for (auto quarter = 0; quarter < 4; ++quarter) {
+      gray[quarter] = depth_to_grayscale<V, TRANSFORM>(widen(r, quarter), widen(g, quarter), widen(b, quarter));
+    }
+    return _mm_packus_epi16(_mm_packs_epi32(gray[0u], gray[1u]), _mm_packs_epi32(gray[2u], gray[3u]));
+#endif // IMAGE_CONVERTER_WITH_AVX2
+  }
+
+  /// Converts in place the DEPTH_BLOCK_SIZE RGB pixels starting at @a data.
+  template <typename TRANSFORM>
+  static inline void convert_depth_block(uint8 *data) {
+    static const rgb_shuffle_masks masks;
+    const __m128i chunks[3u] = {
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(data)),
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16)),
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 32))
+    };
+    const auto gray = depth_to_grayscale16<TRANSFORM>(
+        split_channel(masks, chunks, Color::Red),
+        split_channel(masks, chunks, Color::Green),
+        split_channel(masks, chunks, Color::Blue));
+    for (auto chunk = 0u; chunk < 3u; ++chunk) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(data + 16u * chunk), _mm_shuffle_epi8(gray, masks.gray[chunk]));
+    }
+  }
+
+#elif defined(IMAGE_CONVERTER_WITH_NEON)
+
+  template <typename TRANSFORM>
+  static inline void convert_depth_block(uint8 *data) {
+    using V = simd::neon_ops;
+    const auto rgb = vld3q_u8(data);
+    const auto widen = [](uint8x16_t bytes, int quarter) {
+      const auto words = vmovl_u8(quarter < 2 ? vget_low_u8(bytes) : vget_high_u8(bytes));
+      const auto ints = vmovl_u16(quarter % 2 == 0 ? vget_low_u16(words) : vget_high_u16(words));
+      return vreinterpretq_s32_u32(ints);
+    };
+    uint16x4_t gray[4u];
+    for (auto quarter = 0; quarter < 4; ++quarter) {
+      const auto value = depth_to_grayscale<V, TRANSFORM>(
+          widen(rgb.val[Color::Red], quarter),
+          widen(rgb.val[Color::Green], quarter),
+          widen(rgb.val[Color::Blue], quarter));
+      gray[quarter] = vmovn_u32(vreinterpretq_u32_s32(value));
+    }
+    const auto bytes = vcombine_u8(
+        vmovn_u16(vcombine_u16(gray[0u], gray[1u])),
+        vmovn_u16(vcombine_u16(gray[2u], gray[3u])));
+    vst3q_u8(data, uint8x16x3_t{{bytes, bytes, bytes}});
+  }
+
+#endif // IMAGE_CONVERTER_WITH_SSE || IMAGE_CONVERTER_WITH_NEON
+
+  /// Converts the whole view, DEPTH_BLOCK_SIZE pixels at a time when vector
+  /// instructions are available, and the rest of each row with the per-pixel
+  /// converter.
+  template <typename TRANSFORM, typename PIXEL_CONVERTER>
+  struct depth_image_converter_impl {
+    void operator()(const boost::gil::rgb8_view_t &view) const {
+      static_assert(sizeof(boost::gil::rgb8_pixel_t) == 3u, "pixels must be packed");
+      const PIXEL_CONVERTER pixel_converter{};
+      const auto width = static_cast<uint32>(view.width());
+      for (auto y = 0; y < view.height(); ++y) {
+        auto *row = view.row_begin(y);
+        auto x = 0u;
+#if defined(IMAGE_CONVERTER_WITH_SSE) || defined(IMAGE_CONVERTER_WITH_NEON)
+        for (; x + DEPTH_BLOCK_SIZE <= width; x += DEPTH_BLOCK_SIZE) {
+          convert_depth_block<TRANSFORM>(reinterpret_cast<uint8 *>(&row[x]));
+        }
+#endif // IMAGE_CONVERTER_WITH_SSE || IMAGE_CONVERTER_WITH_NEON
+        for (; x < width; ++x) {
+          pixel_converter(row[x]);
+        }
+      }
+    }
+  };
+
+} // namespace detail
+
+using depth_image_converter =
+    detail::depth_image_converter_impl<detail::linear_depth_transform, depth_pixel_converter>;
+
+using logarithmic_depth_image_converter =
+    detail::depth_image_converter_impl<detail::logarithmic_depth_transform, logarithmic_depth_pixel_converter>;
+
+} // namespace image_converter
@@ -8,5 +8,14 @@
 
 #include "image_converter_types.h"
 #include "image_io.h"
+#include "pipeline.h"
 #include "depth_pixel_converter.h"
 #include "label_pixel_converter.h"
+#include "depth_image_converter.h"
+#include "label_image_converter.h"
+#include "raw_image.h"
+#include "raw_stream.h"
+#include "tensor_converter.h"
+#include "tensor_io.h"
+#include "archive_io.h"
+#include "manifest.h"
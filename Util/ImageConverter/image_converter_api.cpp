@@ -0,0 +1,71 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#include "image_converter_api.h"
+
+#include <stdexcept>
+
+#include <boost/gil/image_view_factory.hpp>
+
+#include "depth_image_converter.h"
+#include "label_image_converter.h"
+#include "tensor_converter.h"
+
+namespace image_converter {
+
+  template <typename TRANSFORM>
+  static void convert_depth_batch(const raw_image *images, size_t count, float *out) {
+    for (auto i = 0u; i < count; ++i) {
+      detail::convert_raw_depth<TRANSFORM>(images[i], out);
+      out += static_cast<size_t>(images[i].width) * images[i].height;
+    }
+  }
+
+  void convert_depth_batch(const raw_image *images, size_t count, bool logarithmic, float *out) {
+    if (logarithmic) {
+      convert_depth_batch<detail::logarithmic_depth_transform>(images, count, out);
+    } else {
+      convert_depth_batch<detail::linear_depth_transform>(images, count, out);
+    }
+  }
+
+  void convert_labels_batch(const raw_image *images, size_t count, uint8 *out) {
+    for (auto i = 0u; i < count; ++i) {
+      detail::convert_raw_labels(images[i], out);
+      out += static_cast<size_t>(images[i].width) * images[i].height;
+    }
+  }
+
+  template <typename IMAGE_CONVERTER>
+  static void convert_rgb8_batch(const rgb8_image *images, size_t count) {
+    const IMAGE_CONVERTER converter{};
+    for (auto i = 0u; i < count; ++i) {
+      const auto &image = images[i];
+      converter(boost::gil::interleaved_view(
+          image.width,
+          image.height,
+          reinterpret_cast<boost::gil::rgb8_pixel_t *>(image.data),
+          static_cast<std::ptrdiff_t>(image.row_size)));
+    }
+  }
+
+  void convert_rgb8_batch(const rgb8_image *images, size_t count, rgb8_converter converter) {
+    switch (converter) {
+      case rgb8_converter::depth:
+        convert_rgb8_batch<depth_image_converter>(images, count);
+        break;
+      case rgb8_converter::logdepth:
+        convert_rgb8_batch<logarithmic_depth_image_converter>(images, count);
+        break;
+      case rgb8_converter::semseg:
+        convert_rgb8_batch<label_image_converter>(images, count);
+        break;
+      default:
+        throw std::invalid_argument("invalid converter");
+    }
+  }
+
+} // namespace image_converter
@@ -0,0 +1,61 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstddef>
+
+#include "image_converter_types.h"
+#include "raw_image.h"
+
+namespace image_converter {
+
+  // ===========================================================================
+  // -- In-memory batch conversions --------------------------------------------
+  // ===========================================================================
+
+  // Compiled into libimage_converter.a ("make lib"), so a recorder, a replay
+  // server or a client can convert frames in process with the same vector
+  // kernels as the command-line tool, without files or image codecs.
+  //
+  // Each function converts @a count images one after the other. Throws
+  // std::invalid_argument if an image has an encoding the conversion does not
+  // support, the images before it are converted already.
+
+  /// Writes the depth of each image in [0, 1] to @a out, width x height
+  /// values per image in row-major order, one image after the other. With
+  /// @a logarithmic, in the same scale as the "logdepth" converter.
+  ///
+  /// Accepts BGRA8, BGR8 (3 or 4 bytes per pixel), FLOAT32 and FLOAT16 images.
+  void convert_depth_batch(const raw_image *images, size_t count, bool logarithmic, float *out);
+
+  /// Writes the semantic label id of each pixel to @a out, width x height
+  /// values per image in row-major order, one image after the other.
+  ///
+  /// Accepts BGRA8, BGR8 (3 or 4 bytes per pixel) and GRAY8 images.
+  void convert_labels_batch(const raw_image *images, size_t count, uint8 *out);
+
+  /// Packed 8-bit RGB pixels, e.g. a decoded PNG, converted in place.
+  struct rgb8_image {
+    uint8 *data;
+    uint32 width;
+    uint32 height;
+    /// Bytes from a row to the next, at least 3 x width.
+    size_t row_size;
+  };
+
+  /// The converters of the command-line tool.
+  enum class rgb8_converter {
+    depth,
+    logdepth,
+    semseg
+  };
+
+  /// Converts each image in place into what the command-line tool writes,
+  /// gray levels of depth or the colors of the labels.
+  void convert_rgb8_batch(const rgb8_image *images, size_t count, rgb8_converter converter);
+
+} // namespace image_converter
@@ -6,8 +6,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
 #include <boost/gil/image.hpp>
 
+#include "image_converter_types.h"
+
 #if __has_include("jpeglib.h")
 #  define IMAGE_CONVERTER_WITH_JPEG_SUPPORT true
 #  include <boost/gil/extension/io/jpeg_io.hpp>
@@ -59,6 +69,34 @@ namespace image_converter {
     return IMAGE_CONVERTER_WITH_TIFF_SUPPORT;
   }
 
+  // ===========================================================================
+  // -- write_options ----------------------------------------------------------
+  // ===========================================================================
+
+  /// Encoder settings, ignored by the formats they do not apply to.
+  struct write_options {
+    /// zlib level for PNG, 0 (none) to 9 (best), negative for libpng's default.
+    int png_compression_level = -1;
+
+    /// Skip the PNG row filters and use the fastest zlib level, trading file
+    /// size for encoding time.
+    bool fast_png = false;
+
+    /// If not empty, write 8-bit indexed PNGs with this palette (up to 256
+    /// colors), the index of each pixel being its red channel. PNG only.
+    std::vector<Color> palette;
+  };
+
+namespace detail {
+
+  static void check_no_palette(const write_options &options) {
+    if (!options.palette.empty()) {
+      throw std::invalid_argument("indexed images can only be written as PNG");
+    }
+  }
+
+} // namespace detail
+
   // ===========================================================================
   // -- readers and writers ----------------------------------------------------
   // ===========================================================================
@@ -78,8 +116,9 @@ namespace detail {
   struct jpeg_writer {
 #if IMAGE_CONVERTER_WITH_JPEG_SUPPORT
     template <typename VIEW>
-    static void write_view(const char *out_filename, const VIEW &view) {
+    static void write_view(const char *out_filename, const VIEW &view, const write_options &options) {
       static_assert(has_jpeg_support(), "JPEG not supported");
+      check_no_palette(options);
       boost::gil::jpeg_write_view(out_filename, view);
     }
 #endif // IMAGE_CONVERTER_WITH_JPEG_SUPPORT
@@ -92,15 +131,161 @@ namespace detail {
       static_assert(has_png_support(), "PNG not supported");
       boost::gil::png_read_and_convert_image(in_filename, image);
     }
+
+    /// Decodes a PNG held in memory, e.g. an archive entry, converting it to
+    /// 8-bit RGB.
+    static void decode_image(const uint8 *data, size_t size, boost::gil::rgb8_image_t &image) {
+      struct source {
+        const uint8 *data;
+        size_t size;
+      } input = {data, size};
+      png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+      png_infop info = (png != nullptr ? png_create_info_struct(png) : nullptr);
+      if ((info == nullptr) || setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, nullptr);
+        throw std::runtime_error("error decoding PNG image");
+      }
+      png_set_read_fn(png, &input, [](png_structp png, png_bytep out, png_size_t length) {
+        auto &input = *static_cast<source *>(png_get_io_ptr(png));
+        if (length > input.size) {
+          png_error(png, "truncated PNG image");
+        }
+        std::memcpy(out, input.data, length);
+        input.data += length;
+        input.size -= length;
+      });
+      png_read_info(png, info);
+      png_set_expand(png);
+      png_set_strip_16(png);
+      png_set_strip_alpha(png);
+      png_set_gray_to_rgb(png);
+      const auto passes = png_set_interlace_handling(png);
+      png_read_update_info(png, info);
+      const auto width = png_get_image_width(png, info);
+      const auto height = png_get_image_height(png, info);
+      if (png_get_rowbytes(png, info) != 3u * width) {
+        png_error(png, "unsupported PNG pixel format");
+      }
+      image.recreate(width, height);
+      const auto view = boost::gil::view(image);
+      for (auto pass = 0; pass < passes; ++pass) {
+        for (auto y = 0; y < view.height(); ++y) {
+          png_read_row(png, reinterpret_cast<png_bytep>(&view.row_begin(y)[0]), nullptr);
+        }
+      }
+      png_read_end(png, nullptr);
+      png_destroy_read_struct(&png, &info, nullptr);
+    }
 #endif // IMAGE_CONVERTER_WITH_PNG_SUPPORT
   };
 
   struct png_writer {
 #if IMAGE_CONVERTER_WITH_PNG_SUPPORT
     template <typename VIEW>
-    static void write_view(const char *out_filename, const VIEW &view) {
+    static void write_view(const char *out_filename, const VIEW &view, const write_options &options) {
       static_assert(has_png_support(), "PNG not supported");
-      boost::gil::png_write_view(out_filename, view);
+      if ((options.png_compression_level < 0) && !options.fast_png && options.palette.empty()) {
+        boost::gil::png_write_view(out_filename, view);
+      } else {
+        write_rgb8_view(out_filename, view, options);
+      }
+    }
+
+    /// Encodes @a view as PNG into @a buffer, e.g. to store it in an archive.
+    template <typename VIEW>
+    static void encode_view(const VIEW &view, const write_options &options, std::vector<uint8> &buffer) {
+      buffer.clear();
+      write_rgb8(view, options, "memory", [&buffer](png_structp png) {
+        png_set_write_fn(
+            png,
+            &buffer,
+            [](png_structp png, png_bytep data, png_size_t length) {
+              auto &buffer = *static_cast<std::vector<uint8> *>(png_get_io_ptr(png));
+              buffer.insert(buffer.end(), data, data + length);
+            },
+            [](png_structp) {});
+      });
+    }
+
+  private:
+
+    // gil's writer exposes neither the zlib settings nor the palettes, so
+    // talk to libpng directly for 8-bit RGB views.
+    template <typename VIEW>
+    static void write_rgb8_view(const char *out_filename, const VIEW &view, const write_options &options) {
+      std::FILE *file = std::fopen(out_filename, "wb");
+      if (file == nullptr) {
+        throw std::runtime_error(std::string("cannot open file: ") + out_filename);
+      }
+      try {
+        write_rgb8(view, options, out_filename, [file](png_structp png) { png_init_io(png, file); });
+      } catch (...) {
+        std::fclose(file);
+        throw;
+      }
+      std::fclose(file);
+    }
+
+    static size_t get_palette_size(const write_options &options) {
+      return std::min<size_t>(options.palette.size(), PNG_MAX_PALETTE_LENGTH);
+    }
+
+    /// Encodes @a view to the output set up by @a init_io(png).
+    template <typename VIEW, typename INIT_IO>
+    static void write_rgb8(const VIEW &view, const write_options &options, const char *out_filename, INIT_IO init_io) {
+      static_assert(sizeof(typename VIEW::value_type) == 3u, "only 8-bit RGB views supported");
+      std::vector<png_byte> indices(get_palette_size(options) > 0u ? view.width() : 0u);
+      png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+      png_infop info = (png != nullptr ? png_create_info_struct(png) : nullptr);
+      if ((info == nullptr) || setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        throw std::runtime_error(std::string("error writing PNG file: ") + out_filename);
+      }
+      init_io(png);
+      const auto palette_size = get_palette_size(options);
+      // Row filters rarely pay off on indexed images.
+      if (options.fast_png || (palette_size > 0u)) {
+        png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+      }
+      if (options.fast_png) {
+        png_set_compression_level(png, 1);
+      }
+      if (options.png_compression_level >= 0) {
+        png_set_compression_level(png, std::min(options.png_compression_level, 9));
+      }
+      png_set_IHDR(
+          png,
+          info,
+          static_cast<png_uint_32>(view.width()),
+          static_cast<png_uint_32>(view.height()),
+          8,
+          (palette_size > 0u ? PNG_COLOR_TYPE_PALETTE : PNG_COLOR_TYPE_RGB),
+          PNG_INTERLACE_NONE,
+          PNG_COMPRESSION_TYPE_BASE,
+          PNG_FILTER_TYPE_BASE);
+      if (palette_size > 0u) {
+        png_color colors[PNG_MAX_PALETTE_LENGTH];
+        for (auto i = 0u; i < palette_size; ++i) {
+          colors[i].red = options.palette[i][Color::Red];
+          colors[i].green = options.palette[i][Color::Green];
+          colors[i].blue = options.palette[i][Color::Blue];
+        }
+        png_set_PLTE(png, info, colors, static_cast<int>(palette_size));
+      }
+      png_write_info(png, info);
+      for (auto y = 0; y < view.height(); ++y) {
+        const auto *row = view.row_begin(y);
+        if (palette_size > 0u) {
+          for (auto x = 0; x < view.width(); ++x) {
+            indices[x] = static_cast<png_byte>(row[x][Color::Red] % palette_size);
+          }
+          png_write_row(png, indices.data());
+        } else {
+          png_write_row(png, reinterpret_cast<png_const_bytep>(&row[0]));
+        }
+      }
+      png_write_end(png, info);
+      png_destroy_write_struct(&png, &info);
     }
 #endif // IMAGE_CONVERTER_WITH_PNG_SUPPORT
   };
@@ -118,8 +303,9 @@ namespace detail {
   struct tiff_writer {
 #if IMAGE_CONVERTER_WITH_TIFF_SUPPORT
     template <typename VIEW>
-    static void write_view(const char *out_filename, const VIEW &view) {
+    static void write_view(const char *out_filename, const VIEW &view, const write_options &options) {
       static_assert(has_tiff_support(), "TIFF not supported");
+      check_no_palette(options);
       boost::gil::tiff_write_view(out_filename, view);
     }
 #endif // IMAGE_CONVERTER_WITH_TIFF_SUPPORT
@@ -199,15 +385,20 @@ namespace detail {
       }
     }
 
+    template <typename IMAGE_CONVERTER>
+    void apply_to_view(IMAGE_CONVERTER image_converter) {
+      image_converter(view());
+    }
+
     template <typename OTHER_FORMAT=IO_WRITER>
-    void write(const char *out_filename) const {
+    void write(const char *out_filename, const write_options &options = write_options()) const {
       static_assert(OTHER_FORMAT::is_supported, "I/O format not supported!");
-      OTHER_FORMAT::writer_type::write_view(out_filename, view());
+      OTHER_FORMAT::writer_type::write_view(out_filename, view(), options);
     }
 
     template <typename OTHER_FORMAT=IO_WRITER>
-    void write(const std::string &out_filename) const {
-      write<OTHER_FORMAT>(out_filename.c_str());
+    void write(const std::string &out_filename, const write_options &options = write_options()) const {
+      write<OTHER_FORMAT>(out_filename.c_str(), options);
     }
 
   private:
@@ -215,4 +406,72 @@ namespace detail {
     image_type _image;
   };
 
+  // ===========================================================================
+  // -- any_image_file ---------------------------------------------------------
+  // ===========================================================================
+
+  /// An 8-bit RGB image_file of any format, to handle images of different
+  /// formats in the same containers.
+  class any_image_file {
+  public:
+
+    virtual ~any_image_file() = default;
+
+    virtual boost::gil::rgb8_view_t view() = 0;
+
+    virtual void write(const std::string &out_filename, const write_options &options) const = 0;
+
+    /// Encodes the image as PNG into @a buffer, whatever its format.
+    virtual void encode_png(std::vector<uint8> &buffer, const write_options &options) const = 0;
+  };
+
+  template <typename IO>
+  class typed_image_file final : public any_image_file {
+  public:
+
+    explicit typed_image_file(const std::string &in_filename) : _file(in_filename) {}
+
+    boost::gil::rgb8_view_t view() final {
+      return _file.view();
+    }
+
+    void write(const std::string &out_filename, const write_options &options) const final {
+      _file.write(out_filename, options);
+    }
+
+    void encode_png(std::vector<uint8> &buffer, const write_options &options) const final {
+      detail::png_writer::encode_view(_file.view(), options, buffer);
+    }
+
+  private:
+
+    image_file<IO> _file;
+  };
+
+  /// A PNG image decoded from memory, e.g. from an archive entry. Written
+  /// back as PNG.
+  class memory_png_file final : public any_image_file {
+  public:
+
+    memory_png_file(const uint8 *data, size_t size) {
+      detail::png_reader::decode_image(data, size, _image);
+    }
+
+    boost::gil::rgb8_view_t view() final {
+      return boost::gil::view(_image);
+    }
+
+    void write(const std::string &out_filename, const write_options &options) const final {
+      detail::png_writer::write_view(out_filename.c_str(), boost::gil::const_view(_image), options);
+    }
+
+    void encode_png(std::vector<uint8> &buffer, const write_options &options) const final {
+      detail::png_writer::encode_view(boost::gil::const_view(_image), options, buffer);
+    }
+
+  private:
+
+    boost::gil::rgb8_image_t _image;
+  };
+
 } // namespace image_converter
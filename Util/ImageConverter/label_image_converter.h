@@ -0,0 +1,49 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include "image_converter_types.h"
+#include "label_pixel_converter.h"
+
+namespace image_converter {
+namespace detail {
+
+  /// LABEL_COLOR_MAP expanded to every possible value of the red channel, so
+  /// converting a pixel is a single lookup.
+  struct label_color_table {
+    label_color_table() {
+      constexpr auto size = sizeof(LABEL_COLOR_MAP)/sizeof(*LABEL_COLOR_MAP);
+      for (auto i = 0u; i < 256u; ++i) {
+        const auto &color = LABEL_COLOR_MAP[i % size];
+        for (auto channel = 0u; channel < Color::NUMBER_OF_CHANNELS; ++channel) {
+          data[i][channel] = color[channel];
+        }
+      }
+    }
+
+    uint8 data[256u][Color::NUMBER_OF_CHANNELS];
+  };
+
+} // namespace detail
+
+struct label_image_converter {
+  void operator()(const boost::gil::rgb8_view_t &view) const {
+    static const detail::label_color_table table;
+    for (auto y = 0; y < view.height(); ++y) {
+      auto *row = view.row_begin(y);
+      for (auto x = 0; x < view.width(); ++x) {
+        auto &pixel = row[x];
+        const auto &color = table.data[pixel[Color::Red]];
+        pixel[Color::Red]   = color[Color::Red];
+        pixel[Color::Green] = color[Color::Green];
+        pixel[Color::Blue]  = color[Color::Blue];
+      }
+    }
+  }
+};
+
+} // namespace image_converter
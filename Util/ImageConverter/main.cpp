@@ -4,11 +4,18 @@
 // This work is licensed under the terms of the MIT license.
 // For a copy, see <https://opensource.org/licenses/MIT>.
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstdio>
 #include <exception>
-#include <functional>
+#include <iterator>
 #include <iostream>
+#include <memory>
 #include <regex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
@@ -24,15 +31,31 @@ enum MainFunctionReturnValues {
 namespace fs = boost::filesystem;
 namespace po = boost::program_options;
 
-using pixel_converter_function = std::function<void(boost::gil::rgb8_pixel_t &)>;
+// Call callback with the image converter matching name. The converter type is
+// resolved here once, so everything below is instantiated for it and the
+// conversion loops are inlined.
+template <typename CALLBACK>
+static void with_image_converter(const std::string &name, CALLBACK &&callback) {
+  if (name == "semseg") {
+    callback(image_converter::label_image_converter());
+  } else if (name == "depth") {
+    callback(image_converter::depth_image_converter());
+  } else if (name == "logdepth") {
+    callback(image_converter::logarithmic_depth_image_converter());
+  } else {
+    throw po::error("invalid converter, please choose \"semseg\", \"depth\", or \"logdepth\"");
+  }
+}
 
-static pixel_converter_function get_pixel_converter(const std::string &name) {
+// Same as with_image_converter for the converters of raw streams.
+template <typename CALLBACK>
+static void with_tensor_converter(const std::string &name, CALLBACK &&callback) {
   if (name == "semseg") {
-    return image_converter::label_pixel_converter();
+    callback(image_converter::label_tensor_converter());
   } else if (name == "depth") {
-    return image_converter::depth_pixel_converter();
+    callback(image_converter::depth_tensor_converter());
   } else if (name == "logdepth") {
-    return image_converter::logarithmic_depth_pixel_converter();
+    callback(image_converter::logarithmic_depth_tensor_converter());
   } else {
     throw po::error("invalid converter, please choose \"semseg\", \"depth\", or \"logdepth\"");
   }
@@ -45,55 +68,352 @@ static bool match(const std::string &filepath, const std::string &regex) {
       std::regex(regex, std::regex_constants::icase));
 }
 
-// Load image, apply pixel converter, and save it.
-template <typename IO>
-static void parse_image(
-    const std::string &in_filename,
-    const std::string &out_filename,
-    pixel_converter_function converter) {
-  image_converter::image_file<IO> file_io(in_filename);
-  file_io.apply(converter);
-  file_io.write(out_filename);
-}
-
-// Determine the file format and parse it accordingly.
-static void parse_any_image(
-    const std::string &in_filename,
-    const std::string &out_filename,
-    pixel_converter_function converter) {
+// Determine the file format and load it accordingly, null if not supported or
+// on error. Inputs with data are entries of an input archive, the rest are
+// files of the input folder.
+static std::unique_ptr<image_converter::any_image_file> load_any_image(const image_converter::archive_entry &in) {
   namespace ic = image_converter;
+  const auto &in_filename = in.name;
   try {
-    if (ic::has_png_support() && match(in_filename, ".*\\.png$")) {
-      parse_image<ic::png_io>(in_filename, out_filename, converter);
+    if (in.data != nullptr) {
+      if (match(in_filename, ".*\\.png$")) {
+        return std::make_unique<ic::memory_png_file>(in.data, in.size);
+      }
+    } else if (ic::has_png_support() && match(in_filename, ".*\\.png$")) {
+      return std::make_unique<ic::typed_image_file<ic::png_io>>(in_filename);
     } else if (ic::has_jpeg_support() && match(in_filename, ".*\\.(jpg|jpeg)$")) {
-      parse_image<ic::jpeg_io>(in_filename, out_filename, converter);
+      return std::make_unique<ic::typed_image_file<ic::jpeg_io>>(in_filename);
     } else if (ic::has_tiff_support() && match(in_filename, ".*\\.tiff$")) {
-      parse_image<ic::tiff_io>(in_filename, out_filename, converter);
+      return std::make_unique<ic::typed_image_file<ic::tiff_io>>(in_filename);
     }
   } catch (const std::exception &e) {
     std::cerr << "exception thrown parsing file \"" << in_filename << "\"\n" << e.what() << std::endl;
   }
+  return nullptr;
 }
 
-// Parse in parallel every regular file in input_folder.
-static void do_the_thing(
+// Save image in its own format, false on error. The image is written next to
+// out_filename and renamed once complete, so an interrupted run never leaves a
+// truncated one.
+static bool store_any_image(
+    const image_converter::any_image_file &image,
+    const std::string &out_filename,
+    const image_converter::write_options &options) {
+  try {
+    const auto temporary = out_filename + ".part";
+    image.write(temporary, options);
+    fs::rename(temporary, out_filename);
+    return true;
+  } catch (const std::exception &e) {
+    std::cerr << "exception thrown writing file \"" << out_filename << "\"\n" << e.what() << std::endl;
+    return false;
+  }
+}
+
+// Save image as PNG into the output archives, named after out_filename, false
+// on error.
+static bool store_in_archive(
+    image_converter::tar_writer &archive,
+    const image_converter::any_image_file &image,
+    const std::string &out_filename,
+    const image_converter::write_options &options) {
+  static thread_local std::vector<image_converter::uint8> buffer;
+  const auto name = fs::path(out_filename).stem().string() + ".png";
+  try {
+    image.encode_png(buffer, options);
+    archive.write(name, buffer.data(), buffer.size());
+    return true;
+  } catch (const std::exception &e) {
+    std::cerr << "exception thrown writing archive entry \"" << name << "\"\n" << e.what() << std::endl;
+    return false;
+  }
+}
+
+// Output of an input of the folder or of an archive.
+static std::string make_out_filename(const fs::path &output_folder, const std::string &in_name) {
+  return (output_folder / fs::path(in_name).filename()).string();
+}
+
+// Skips the inputs that a previous run already converted, according to the
+// manifest, and records the others once stored. Lets everything through
+// without a manifest.
+class incremental_filter {
+public:
+
+  incremental_filter(
+      image_converter::manifest *manifest,
+      std::string converter,
+      const fs::path &output_folder)
+    : _manifest(manifest),
+      _converter(std::move(converter)),
+      _output_folder(output_folder) {}
+
+  // Called by the readers before loading in.
+  bool skip(const image_converter::archive_entry &in) {
+    if (_manifest == nullptr) {
+      return false;
+    }
+    image_converter::manifest_record record;
+    record.converter = _converter;
+    try {
+      if (in.data != nullptr) {
+        record.size = in.size;
+        record.stamp = image_converter::hash_content(in.data, in.size);
+      } else {
+        record.size = fs::file_size(in.name);
+        record.stamp = static_cast<uint64_t>(fs::last_write_time(in.name));
+      }
+    } catch (const std::exception &) {
+      // Let the loader report it.
+      return false;
+    }
+    if (_manifest->is_up_to_date(in.name, record)) {
+      ++_skipped;
+      return true;
+    }
+    _manifest->start(make_out_filename(_output_folder, in.name), in.name, record);
+    return false;
+  }
+
+  // Called by the writers once out_filename is written.
+  void stored(const std::string &out_filename) {
+    if (_manifest != nullptr) {
+      _manifest->commit(out_filename);
+    }
+  }
+
+  image_converter::uint32 skipped() const {
+    return _skipped;
+  }
+
+private:
+
+  image_converter::manifest *_manifest;
+
+  const std::string _converter;
+
+  const fs::path _output_folder;
+
+  std::atomic<image_converter::uint32> _skipped{0u};
+};
+
+// Regular files of a folder, walked as the readers ask for work instead of
+// listed first.
+class folder_jobs {
+public:
+
+  folder_jobs(const fs::path &input_folder, const fs::path &output_folder)
+    : _it(input_folder),
+      _output_folder(output_folder) {}
+
+  bool operator()(image_converter::archive_entry &in, std::string &out_filename) {
+    for (; _it != fs::directory_iterator(); ++_it) {
+      if (fs::is_regular_file(_it->status())) {
+        const auto &in_path = _it->path();
+        in.name = in_path.string();
+        out_filename = make_out_filename(_output_folder, in.name);
+        ++_it;
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+
+  fs::directory_iterator _it;
+
+  fs::path _output_folder;
+};
+
+// Regular files of a list of tar archives, read one archive after the other.
+// The readers only get pointers into the mapped archives here and decode the
+// entries in parallel.
+class archive_jobs {
+public:
+
+  archive_jobs(std::vector<fs::path> archives, const fs::path &output_folder)
+    : _archives(std::move(archives)),
+      _output_folder(output_folder) {}
+
+  bool operator()(image_converter::archive_entry &in, std::string &out_filename) {
+    for (;;) {
+      try {
+        if ((_current != nullptr) && _current->next(in)) {
+          out_filename = make_out_filename(_output_folder, in.name);
+          return true;
+        }
+      } catch (const std::exception &e) {
+        std::cerr << "skipping the rest of archive \"" << _archives[_next - 1u].string() << "\"\n" << e.what() << std::endl;
+      }
+      _current = nullptr;
+      if (_next == _archives.size()) {
+        return false;
+      }
+      const auto filename = _archives[_next++].string();
+      try {
+        // The entries being converted point into the archives, keep them all
+        // mapped until the pipeline is done.
+        _readers.emplace_back(std::make_unique<image_converter::tar_reader>(filename));
+        _current = _readers.back().get();
+      } catch (const std::exception &e) {
+        std::cerr << "cannot open archive \"" << filename << "\"\n" << e.what() << std::endl;
+      }
+    }
+  }
+
+private:
+
+  std::vector<fs::path> _archives;
+
+  fs::path _output_folder;
+
+  std::vector<std::unique_ptr<image_converter::tar_reader>> _readers;
+
+  image_converter::tar_reader *_current = nullptr;
+
+  size_t _next = 0u;
+};
+
+// Call callback with the jobs of the input archives if any, or of the input
+// folder otherwise.
+template <typename CALLBACK>
+static void with_jobs(
+    const std::vector<fs::path> &input_archives,
     const fs::path &input_folder,
     const fs::path &output_folder,
-    const pixel_converter_function converter) {
-  const std::vector<fs::directory_entry> entries{
-      fs::directory_iterator(input_folder),
-      fs::directory_iterator()};
-  std::cout << "parsing " << entries.size() << " files in folder\n";
-
-#pragma omp parallel for
-  for (auto i = 0u; i < entries.size(); ++i) {
-    const auto &entry = entries[i];
-    if (fs::is_regular_file(entry.status())) {
-      const auto &in_path = entry.path();
-      const auto &out_path = output_folder / in_path.filename();
-      parse_any_image(in_path.string(), out_path.string(), converter);
+    CALLBACK &&callback) {
+  if (!input_archives.empty()) {
+    std::cout << "parsing files in " << input_archives.size() << " archives\n";
+    callback(archive_jobs(input_archives, output_folder));
+  } else {
+    std::cout << "parsing files in folder\n";
+    callback(folder_jobs(input_folder, output_folder));
+  }
+}
+
+// Parse every job, decoding, converting and encoding in separate stages of
+// threads. Write the images into tar archives if archive_shard_size is not
+// zero.
+template <typename JOBS, typename IMAGE_CONVERTER>
+static void do_the_thing(
+    JOBS jobs,
+    const fs::path &output_folder,
+    const IMAGE_CONVERTER converter,
+    const image_converter::pipeline_options &pipeline_options,
+    const image_converter::write_options &write_options,
+    const image_converter::uint32 archive_shard_size,
+    incremental_filter &filter) {
+  std::unique_ptr<image_converter::tar_writer> archive;
+  if (archive_shard_size > 0u) {
+    archive = std::make_unique<image_converter::tar_writer>(output_folder.string(), archive_shard_size);
+  }
+
+  const auto count = image_converter::run_pipeline<image_converter::archive_entry>(
+      pipeline_options,
+      std::move(jobs),
+      [&](const image_converter::archive_entry &in) {
+        return filter.skip(in) ? nullptr : load_any_image(in);
+      },
+      [converter](image_converter::any_image_file &image) { converter(image.view()); },
+      [&](const image_converter::any_image_file &image, const std::string &out_filename) {
+        if (archive != nullptr) {
+          return store_in_archive(*archive, image, out_filename, write_options);
+        }
+        if (!store_any_image(image, out_filename, write_options)) {
+          return false;
+        }
+        filter.stored(out_filename);
+        return true;
+      });
+  if (archive != nullptr) {
+    archive->close();
+  }
+
+  std::cout << "parsed " << count << " files\n";
+  if (filter.skipped() > 0u) {
+    std::cout << "skipped " << filter.skipped() << " files up to date\n";
+  }
+}
+
+// Same as do_the_thing but write every image as a tensor named after it.
+template <typename JOBS, typename TENSOR_CONVERTER>
+static void do_the_tensor_thing(
+    JOBS jobs,
+    const fs::path &output_folder,
+    const TENSOR_CONVERTER converter,
+    const image_converter::pipeline_options &pipeline_options,
+    const image_converter::tensor_write_options &tensor_options,
+    incremental_filter &filter) {
+  using value_type = typename TENSOR_CONVERTER::value_type;
+
+  image_converter::tensor_writer<value_type> writer(output_folder.string(), tensor_options);
+
+  // The writers convert, the tensor is what they write.
+  const auto count = image_converter::run_pipeline<image_converter::archive_entry>(
+      pipeline_options,
+      std::move(jobs),
+      [&](const image_converter::archive_entry &in) {
+        return filter.skip(in) ? nullptr : load_any_image(in);
+      },
+      [](image_converter::any_image_file &) {},
+      [&](image_converter::any_image_file &image, const std::string &out_filename) {
+        static thread_local std::vector<value_type> tensor;
+        const auto view = image.view();
+        const auto name = fs::path(out_filename).stem().string();
+        try {
+          converter(view, tensor);
+          writer.write(name, tensor, view.height(), view.width());
+          filter.stored(out_filename);
+          return true;
+        } catch (const std::exception &e) {
+          std::cerr << "exception thrown writing tensor \"" << name << "\"\n" << e.what() << std::endl;
+          return false;
+        }
+      });
+  writer.close();
+
+  std::cout << "parsed " << count << " files\n";
+  if (filter.skipped() > 0u) {
+    std::cout << "skipped " << filter.skipped() << " files up to date\n";
+  }
+}
+
+// Convert the images of a recording of the images stream straight into
+// tensors, named after their message and their index in it.
+template <typename TENSOR_CONVERTER>
+static void do_the_raw_thing(
+    const fs::path &raw_stream_file,
+    const fs::path &output_folder,
+    const TENSOR_CONVERTER converter,
+    const image_converter::tensor_write_options &tensor_options) {
+  namespace ic = image_converter;
+  using value_type = typename TENSOR_CONVERTER::value_type;
+  std::cout << "parsing raw stream " << raw_stream_file.string() << "\n";
+  ic::raw_stream stream(raw_stream_file.string());
+  ic::tensor_writer<value_type> writer(output_folder.string(), tensor_options);
+  std::vector<ic::raw_image> images;
+  std::vector<value_type> tensor;
+  auto count = 0u;
+  for (auto message = 0u; stream.next(images); ++message) {
+    for (auto i = 0u; i < images.size(); ++i) {
+      const auto &image = images[i];
+      if (!converter.accepts(image)) {
+        continue;
+      }
+      char name[32u];
+      std::snprintf(name, sizeof(name), "%06u_%02u", message, i);
+      try {
+        converter(image, tensor);
+        writer.write(name, tensor, image.height, image.width);
+        ++count;
+      } catch (const std::exception &e) {
+        std::cerr << "exception thrown writing tensor \"" << name << "\"\n" << e.what() << std::endl;
+      }
     }
   }
+  writer.close();
+  std::cout << "parsed " << count << " images\n";
 }
 
 int main(int argc, char *argv[]) {
@@ -101,6 +421,16 @@ int main(int argc, char *argv[]) {
     std::string converter_name;
     fs::path input_folder;
     fs::path output_folder;
+    const auto hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    image_converter::pipeline_options pipeline_options;
+    image_converter::write_options write_options;
+    fs::path raw_stream_file;
+    std::vector<fs::path> input_archives;
+    image_converter::uint32 archive_shard_size;
+    fs::path manifest_file;
+    bool label_palette;
+    std::string tensor_format;
+    image_converter::tensor_write_options tensor_options;
 
     // Fill program options.
     po::options_description desc("Allowed options");
@@ -109,6 +439,19 @@ int main(int argc, char *argv[]) {
       ("converter,c", po::value<std::string>(&converter_name)->required(), "converter (semseg or depth or logdepth)")
       ("input-folder,i", po::value<fs::path>(&input_folder)->default_value("."), "input folder containing images")
       ("output-folder,o", po::value<fs::path>(&output_folder)->default_value("./converted_images"), "output folder to save converted images")
+      ("reader-threads", po::value<image_converter::uint32>(&pipeline_options.reader_threads)->default_value(std::max(1u, hardware_threads / 2u)), "threads decoding images")
+      ("converter-threads", po::value<image_converter::uint32>(&pipeline_options.converter_threads)->default_value(1u), "threads converting images")
+      ("writer-threads", po::value<image_converter::uint32>(&pipeline_options.writer_threads)->default_value(std::max(1u, hardware_threads / 2u)), "threads encoding images")
+      ("queue-size", po::value<image_converter::uint32>(&pipeline_options.queue_size)->default_value(hardware_threads), "images waiting between two stages")
+      ("png-compression", po::value<int>(&write_options.png_compression_level)->default_value(-1), "PNG compression level (0-9, negative for the default)")
+      ("fast-png", po::bool_switch(&write_options.fast_png), "encode PNG as fast as possible, bigger files")
+      ("label-palette", po::bool_switch(&label_palette), "with semseg, write 8-bit indexed PNGs whose pixels are the label ids")
+      ("input-archive,a", po::value<std::vector<fs::path>>(&input_archives)->multitoken(), "read the images of these tar archives instead of the input folder")
+      ("archive-shard-size", po::value<image_converter::uint32>(&archive_shard_size)->default_value(0u), "write the images as PNG into tar archives of up to N images, 0 for a file per image")
+      ("manifest", po::value<fs::path>(&manifest_file), "skip the inputs converted by a previous run recorded in this file, and record the new ones")
+      ("raw-stream", po::value<fs::path>(&raw_stream_file), "read a recording of the images stream instead of the input folder")
+      ("tensor-format", po::value<std::string>(&tensor_format), "write tensors instead of images (npy or raw), npy by default with --raw-stream")
+      ("shard-size", po::value<image_converter::uint32>(&tensor_options.shard_size)->default_value(0u), "tensors stacked per shard file, 0 for a file per tensor")
       ;
 
     try {
@@ -126,8 +469,22 @@ int main(int argc, char *argv[]) {
       // Throw if any argument is invalid.
       po::notify(vm);
 
+      if (!tensor_format.empty() && (tensor_format != "npy") && (tensor_format != "raw")) {
+        throw po::error("invalid tensor format, please choose \"npy\" or \"raw\"");
+      }
+      tensor_options.npy = (tensor_format != "raw");
+
+      if (label_palette && ((converter_name != "semseg") || !tensor_format.empty() || !raw_stream_file.empty())) {
+        throw po::error("--label-palette is only for images of the semseg converter");
+      }
+
+      if (!manifest_file.empty() &&
+          (!raw_stream_file.empty() || (archive_shard_size > 0u) || (tensor_options.shard_size > 0u))) {
+        throw po::error("--manifest needs a file per output, it cannot be combined with --raw-stream or shards");
+      }
+
       // Check if input_folder exists.
-      if (!fs::is_directory(input_folder)) {
+      if (raw_stream_file.empty() && input_archives.empty() && !fs::is_directory(input_folder)) {
         throw std::invalid_argument("not a folder: " + input_folder.string());
       }
 
@@ -136,10 +493,43 @@ int main(int argc, char *argv[]) {
         throw std::invalid_argument("cannot create folder: " + output_folder.string());
       }
 
-      // Retrieve the pixel converter.
-      const pixel_converter_function converter = get_pixel_converter(converter_name);
+      std::unique_ptr<image_converter::manifest> manifest;
+      if (!manifest_file.empty()) {
+        manifest = std::make_unique<image_converter::manifest>(manifest_file.string());
+      }
+      incremental_filter filter(
+          manifest.get(),
+          converter_name + "/" + (!tensor_format.empty() ? tensor_format : (label_palette ? "palette" : "image")),
+          output_folder);
 
-      do_the_thing(input_folder, output_folder, converter);
+      if (!raw_stream_file.empty()) {
+        // Retrieve the tensor converter and parse the stream with it.
+        with_tensor_converter(converter_name, [&](auto converter) {
+          do_the_raw_thing(raw_stream_file, output_folder, converter, tensor_options);
+        });
+      } else if (!tensor_format.empty()) {
+        // Retrieve the tensor converter and parse the folder with it.
+        with_tensor_converter(converter_name, [&](auto converter) {
+          with_jobs(input_archives, input_folder, output_folder, [&](auto jobs) {
+            do_the_tensor_thing(std::move(jobs), output_folder, converter, pipeline_options, tensor_options, filter);
+          });
+        });
+      } else if (label_palette) {
+        // The label ids are already the indices of the palette.
+        write_options.palette.assign(
+            std::begin(image_converter::detail::LABEL_COLOR_MAP),
+            std::end(image_converter::detail::LABEL_COLOR_MAP));
+        with_jobs(input_archives, input_folder, output_folder, [&](auto jobs) {
+          do_the_thing(std::move(jobs), output_folder, [](const boost::gil::rgb8_view_t &) {}, pipeline_options, write_options, archive_shard_size, filter);
+        });
+      } else {
+        // Retrieve the image converter and parse the folder with it.
+        with_image_converter(converter_name, [&](auto converter) {
+          with_jobs(input_archives, input_folder, output_folder, [&](auto jobs) {
+            do_the_thing(std::move(jobs), output_folder, converter, pipeline_options, write_options, archive_shard_size, filter);
+          });
+        });
+      }
 
     } catch (const po::error &e) {
       std::cerr << desc << "\n" << e.what() << std::endl;
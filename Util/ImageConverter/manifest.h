@@ -0,0 +1,180 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "image_converter_types.h"
+
+namespace image_converter {
+
+  // ===========================================================================
+  // -- manifest_record --------------------------------------------------------
+  // ===========================================================================
+
+  /// What an input looked like when it was converted, its output is up to
+  /// date while it looks the same.
+  struct manifest_record {
+    /// Converter and output format used.
+    std::string converter;
+
+    uint64_t size = 0u;
+
+    /// Modification time of a file, or hash of the content of an archive
+    /// entry (archives are rewritten as a whole).
+    uint64_t stamp = 0u;
+
+    bool operator==(const manifest_record &rhs) const {
+      return (converter == rhs.converter) && (size == rhs.size) && (stamp == rhs.stamp);
+    }
+  };
+
+  /// 64-bit FNV-1a hash of @a data.
+  static inline uint64_t hash_content(const uint8 *data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (auto i = 0u; i < size; ++i) {
+      hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  // ===========================================================================
+  // -- manifest ---------------------------------------------------------------
+  // ===========================================================================
+
+  /// Inputs converted by previous runs, kept in a text file with a
+  /// "converter size stamp input" line per input (tab-separated).
+  ///
+  /// An input is recorded only once its output has been written, and the
+  /// line is appended to the file right away, so an interrupted run resumes
+  /// where it stopped. close() rewrites the file without the stale lines.
+  /// Thread-safe.
+  class manifest {
+  public:
+
+    explicit manifest(std::string filename) : _filename(std::move(filename)) {
+      const bool truncated = load();
+      _log.open(_filename, std::ios::app);
+      if (!_log) {
+        throw std::runtime_error("cannot open manifest: " + _filename);
+      }
+      if (truncated) {
+        _log << '\n';
+      }
+    }
+
+    ~manifest() {
+      try {
+        close();
+      } catch (const std::exception &e) {
+        std::fprintf(stderr, "error closing manifest: %s\n", e.what());
+      }
+    }
+
+    /// Whether @a input was converted already and still matches @a record.
+    bool is_up_to_date(const std::string &input, const manifest_record &record) const {
+      std::lock_guard<std::mutex> lock(_mutex);
+      const auto it = _records.find(input);
+      return (it != _records.end()) && (it->second == record);
+    }
+
+    /// @a output is being converted from @a input, record it when
+    /// commit(output) is called once the output is written.
+    void start(const std::string &output, const std::string &input, const manifest_record &record) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _pending[output] = std::make_pair(input, record);
+    }
+
+    void commit(const std::string &output) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      const auto it = _pending.find(output);
+      if (it == _pending.end()) {
+        return;
+      }
+      const auto &input = it->second.first;
+      const auto &record = it->second.second;
+      // Names that would break the line are converted every time.
+      if (input.find_first_of("\t\n") == std::string::npos) {
+        _records[input] = record;
+        write(_log, input, record);
+        _log.flush();
+      }
+      _pending.erase(it);
+    }
+
+    /// Rewrites the manifest with a line per input, replacing the file at
+    /// once.
+    void close() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (!_log.is_open()) {
+        return;
+      }
+      _log.close();
+      const auto temporary = _filename + ".part";
+      {
+        std::ofstream file(temporary);
+        for (const auto &item : _records) {
+          write(file, item.first, item.second);
+        }
+        if (!file.flush()) {
+          throw std::runtime_error("error writing manifest: " + temporary);
+        }
+      }
+      if (std::rename(temporary.c_str(), _filename.c_str()) != 0) {
+        throw std::runtime_error("cannot replace manifest: " + _filename);
+      }
+    }
+
+  private:
+
+    static void write(std::ostream &out, const std::string &input, const manifest_record &record) {
+      out << record.converter << '\t' << record.size << '\t' << record.stamp << '\t' << input << '\n';
+    }
+
+    /// Later lines win, and a line cut short by an interrupted run is
+    /// ignored. Returns whether there was one.
+    bool load() {
+      std::ifstream file(_filename);
+      std::string line;
+      while (std::getline(file, line)) {
+        if (file.eof()) {
+          return true;
+        }
+        const auto first = line.find('\t');
+        const auto second = line.find('\t', first + 1u);
+        const auto third = line.find('\t', second + 1u);
+        if ((first == std::string::npos) || (second == std::string::npos) || (third == std::string::npos)) {
+          continue;
+        }
+        manifest_record record;
+        record.converter = line.substr(0u, first);
+        record.size = std::strtoull(line.c_str() + first + 1u, nullptr, 10);
+        record.stamp = std::strtoull(line.c_str() + second + 1u, nullptr, 10);
+        _records[line.substr(third + 1u)] = record;
+      }
+      return false;
+    }
+
+    const std::string _filename;
+
+    mutable std::mutex _mutex;
+
+    std::unordered_map<std::string, manifest_record> _records;
+
+    std::unordered_map<std::string, std::pair<std::string, manifest_record>> _pending;
+
+    std::ofstream _log;
+  };
+
+} // namespace image_converter
@@ -0,0 +1,216 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "image_converter_types.h"
+
+namespace image_converter {
+
+  // ===========================================================================
+  // -- bounded_queue ----------------------------------------------------------
+  // ===========================================================================
+
+  /// Blocking queue holding at most a fixed number of items, so a fast stage
+  /// cannot pile up decoded images in memory while a slower one catches up.
+  template <typename T>
+  class bounded_queue {
+  public:
+
+    explicit bounded_queue(size_t capacity) : _capacity(std::max<size_t>(1u, capacity)) {}
+
+    /// Blocks while the queue is full. Returns false if the queue was closed.
+    bool push(T item) {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _not_full.wait(lock, [this]() { return _closed || (_items.size() < _capacity); });
+      if (_closed) {
+        return false;
+      }
+      _items.emplace_back(std::move(item));
+      lock.unlock();
+      _not_empty.notify_one();
+      return true;
+    }
+
+    /// Blocks while the queue is empty. Returns false once the queue is closed
+    /// and drained.
+    bool pop(T &item) {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _not_empty.wait(lock, [this]() { return _closed || !_items.empty(); });
+      if (_items.empty()) {
+        return false;
+      }
+      item = std::move(_items.front());
+      _items.pop_front();
+      lock.unlock();
+      _not_full.notify_one();
+      return true;
+    }
+
+    /// No more items will be pushed; consumers drain what is left.
+    void close() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+      }
+      _not_empty.notify_all();
+      _not_full.notify_all();
+    }
+
+  private:
+
+    const size_t _capacity;
+
+    std::mutex _mutex;
+
+    std::condition_variable _not_empty;
+
+    std::condition_variable _not_full;
+
+    std::deque<T> _items;
+
+    bool _closed = false;
+  };
+
+  // ===========================================================================
+  // -- pipeline ---------------------------------------------------------------
+  // ===========================================================================
+
+  struct pipeline_options {
+    uint32 reader_threads = 1u;
+    uint32 converter_threads = 1u;
+    uint32 writer_threads = 1u;
+    /// Images waiting between two stages.
+    uint32 queue_size = 4u;
+  };
+
+namespace detail {
+
+  /// Runs @a number_of_threads copies of @a stage and calls @a on_done when
+  /// the last one finishes.
+  template <typename STAGE, typename ON_DONE>
+  static void launch_stage(
+      std::vector<std::thread> &threads,
+      uint32 number_of_threads,
+      std::atomic<uint32> &running,
+      STAGE stage,
+      ON_DONE on_done) {
+    number_of_threads = std::max<uint32>(1u, number_of_threads);
+    running = number_of_threads;
+    for (auto i = 0u; i < number_of_threads; ++i) {
+      threads.emplace_back([=, &running]() {
+        try {
+          stage();
+        } catch (const std::exception &e) {
+          std::cerr << "exception thrown in image pipeline: " << e.what() << std::endl;
+        }
+        if (--running == 0u) {
+          on_done();
+        }
+      });
+    }
+  }
+
+} // namespace detail
+
+  /// Decodes, converts and encodes images in three stages of threads joined by
+  /// bounded queues, so the disk and the PNG codecs are busy at the same time.
+  ///
+  ///  * @a next_job(in, out) fills the next input and output file name,
+  ///    returns false when there are no more. Called under a lock. The input
+  ///    is an @a INPUT, the input file name by default.
+  ///  * @a load(in) returns a pointer-like image, or null to skip the input.
+  ///  * @a convert(image) converts the image in place.
+  ///  * @a store(image, out) writes the image, returns whether it succeeded.
+  ///
+  /// Returns the number of images stored.
+  template <
+      typename INPUT = std::string,
+      typename NEXT_JOB,
+      typename LOAD,
+      typename CONVERT,
+      typename STORE>
+  static uint32 run_pipeline(
+      const pipeline_options &options,
+      NEXT_JOB next_job,
+      LOAD load,
+      CONVERT convert,
+      STORE store) {
+    using image_type = decltype(load(std::declval<const INPUT &>()));
+    struct job {
+      image_type image;
+      std::string out_filename;
+    };
+
+    bounded_queue<job> decoded(options.queue_size);
+    bounded_queue<job> converted(options.queue_size);
+    std::mutex next_job_mutex;
+    std::atomic<uint32> readers{0u};
+    std::atomic<uint32> converters{0u};
+    std::atomic<uint32> writers{0u};
+    std::atomic<uint32> stored{0u};
+    std::vector<std::thread> threads;
+
+    detail::launch_stage(threads, options.reader_threads, readers, [&]() {
+      job item;
+      INPUT input;
+      for (;;) {
+        {
+          std::lock_guard<std::mutex> lock(next_job_mutex);
+          if (!next_job(input, item.out_filename)) {
+            return;
+          }
+        }
+        item.image = load(input);
+        if ((item.image != nullptr) && !decoded.push(std::move(item))) {
+          return;
+        }
+      }
+    }, [&]() { decoded.close(); });
+
+    detail::launch_stage(threads, options.converter_threads, converters, [&]() {
+      job item;
+      while (decoded.pop(item)) {
+        convert(*item.image);
+        if (!converted.push(std::move(item))) {
+          return;
+        }
+      }
+    }, [&]() {
+      // Also unblock the readers if the converters bailed out early.
+      decoded.close();
+      converted.close();
+    });
+
+    detail::launch_stage(threads, options.writer_threads, writers, [&]() {
+      job item;
+      while (converted.pop(item)) {
+        if (store(*item.image, item.out_filename)) {
+          ++stored;
+        }
+        item.image = nullptr;
+      }
+    }, [&]() { converted.close(); });
+
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    return stored;
+  }
+
+} // namespace image_converter
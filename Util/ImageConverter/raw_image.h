@@ -0,0 +1,40 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <carla/carla_server.h>
+
+#include "image_converter_types.h"
+
+namespace image_converter {
+
+  // ===========================================================================
+  // -- raw_image --------------------------------------------------------------
+  // ===========================================================================
+
+  /// An image of an images message, see carla::server::ImagesMessage.
+  struct raw_image {
+    /// Same values as EPostProcessEffect in the Unreal plugin.
+    enum Type : uint32 {
+      SceneFinal = 1u,
+      Depth = 2u,
+      SemanticSegmentation = 3u
+    };
+
+    uint32 width;
+    uint32 height;
+    uint32 type;
+    /// One of CARLA_SERVER_IMAGE_*.
+    uint32 encoding;
+    /// Bytes per pixel, BGR8 images have 3 or 4 depending on whether the
+    /// message was recorded as received or as written by the server.
+    uint32 bytes_per_pixel;
+    /// Tightly packed rows of pixels.
+    const uint8 *data;
+  };
+
+} // namespace image_converter
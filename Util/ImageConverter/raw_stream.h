@@ -0,0 +1,145 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <carla/carla_server.h>
+#include <carla/server/LZ4.h>
+
+#include "image_converter_types.h"
+#include "raw_image.h"
+
+namespace image_converter {
+
+  // ===========================================================================
+  // -- raw_stream -------------------------------------------------------------
+  // ===========================================================================
+
+  /// Reads a recording of the images stream of an agent, i.e. the images
+  /// messages as received from the server (each preceded by its size in
+  /// bytes) one after the other. The file is memory-mapped, and only the LZ4
+  /// compressed images are copied.
+  class raw_stream {
+  public:
+
+    explicit raw_stream(const std::string &filename)
+      : _file(filename.c_str(), boost::interprocess::read_only),
+        _region(_file, boost::interprocess::read_only),
+        _position(static_cast<const uint8 *>(_region.get_address())),
+        _end(_position + _region.get_size()) {}
+
+    /// Reads the next message into @a images, returns false at the end of the
+    /// stream. The pixels are valid until the next call. Throws
+    /// std::runtime_error if the stream is malformed.
+    bool next(std::vector<raw_image> &images) {
+      images.clear();
+      if (_position == _end) {
+        return false;
+      }
+      const auto message_size = read(_position, _end);
+      const auto *message = _position + sizeof(uint32_t);
+      check(message_size <= static_cast<size_t>(_end - message), "truncated message");
+      const auto *message_end = message + message_size;
+      check(read(message, message_end) == MESSAGE_VERSION, "unsupported message version");
+      const auto number_of_images = read(message + sizeof(uint32_t), message_end);
+      if (_buffers.size() < number_of_images) {
+        _buffers.resize(number_of_images);
+      }
+      for (auto i = 0u; i < number_of_images; ++i) {
+        const auto *entry = message + sizeof(uint32_t) * (2u + HEADER_ENTRY_SIZE * i);
+        const auto field = [&](uint32 index) { return read(entry + sizeof(uint32_t) * index, message_end); };
+        raw_image image;
+        image.width = field(1u);
+        image.height = field(2u);
+        image.type = field(3u);
+        const auto stride = field(4u);
+        image.encoding = field(5u) & 0xffffu;
+        const auto compression = field(5u) >> COMPRESSION_SHIFT;
+        check(image.width > 0u, "empty image");
+        image.bytes_per_pixel = stride / image.width;
+        check(image.bytes_per_pixel * image.width == stride, "invalid stride");
+        check(is_valid(image.encoding, image.bytes_per_pixel), "invalid encoding");
+        const size_t size = static_cast<size_t>(stride) * image.height;
+        check(field(0u) < message_size, "invalid offset");
+        const auto *pixels = message + field(0u);
+        if (compression == CARLA_SERVER_IMAGE_COMPRESSION_LZ4) {
+          const auto compressed_size = read(pixels, message_end);
+          pixels += sizeof(uint32_t);
+          check(compressed_size <= static_cast<size_t>(message_end - pixels), "truncated image");
+          auto &buffer = _buffers[i];
+          buffer.resize(size);
+          check(
+              carla::server::LZ4::Decompress(pixels, compressed_size, buffer.data(), size),
+              "malformed LZ4 data");
+          image.data = buffer.data();
+        } else {
+          check(compression == CARLA_SERVER_IMAGE_COMPRESSION_NONE, "unknown compression");
+          check(size <= static_cast<size_t>(message_end - pixels), "truncated image");
+          image.data = pixels;
+        }
+        images.emplace_back(image);
+      }
+      _position = message_end;
+      return true;
+    }
+
+  private:
+
+    static constexpr uint32 MESSAGE_VERSION = 2u;
+
+    static constexpr uint32 HEADER_ENTRY_SIZE = 6u;
+
+    static constexpr uint32 COMPRESSION_SHIFT = 16u;
+
+    static void check(bool condition, const char *what) {
+      if (!condition) {
+        throw std::runtime_error(std::string("invalid raw stream: ") + what);
+      }
+    }
+
+    static uint32_t read(const uint8 *position, const uint8 *end) {
+      check(position < end && sizeof(uint32_t) <= static_cast<size_t>(end - position), "truncated header");
+      uint32_t value;
+      std::memcpy(&value, position, sizeof(uint32_t));
+      return value;
+    }
+
+    static bool is_valid(uint32 encoding, uint32 bytes_per_pixel) {
+      switch (encoding) {
+        case CARLA_SERVER_IMAGE_BGRA8:
+        case CARLA_SERVER_IMAGE_FLOAT32:
+          return bytes_per_pixel == 4u;
+        case CARLA_SERVER_IMAGE_FLOAT16:
+          return bytes_per_pixel == 2u;
+        case CARLA_SERVER_IMAGE_GRAY8:
+          return bytes_per_pixel == 1u;
+        case CARLA_SERVER_IMAGE_BGR8:
+          return (bytes_per_pixel == 3u) || (bytes_per_pixel == 4u);
+        default:
+          return false;
+      }
+    }
+
+    boost::interprocess::file_mapping _file;
+
+    boost::interprocess::mapped_region _region;
+
+    const uint8 *_position;
+
+    const uint8 *_end;
+
+    std::vector<std::vector<uint8>> _buffers;
+  };
+
+} // namespace image_converter
@@ -0,0 +1,190 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+// Thin wrappers over the vector instructions available at compile time, so the
+// math of the converters is written once. Build with -march=native (see
+// ARCH_FLAGS in the Makefile) to enable them.
+//
+//  * sse_ops   4 floats, needs SSSE3 for the RGB shuffles.
+//  * avx2_ops  8 floats.
+//  * neon_ops  4 floats, AArch64 only (needs vdivq_f32).
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#  define IMAGE_CONVERTER_WITH_SSE
+#  define IMAGE_CONVERTER_WITH_AVX2
+#elif defined(__SSSE3__)
+#  include <tmmintrin.h>
+#  define IMAGE_CONVERTER_WITH_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define IMAGE_CONVERTER_WITH_NEON
+#endif
+
+namespace image_converter {
+namespace simd {
+
+  // ===========================================================================
+  // -- Vector operations ------------------------------------------------------
+  // ===========================================================================
+
+#ifdef IMAGE_CONVERTER_WITH_SSE
+
+  struct sse_ops {
+    using f = __m128;
+    using i = __m128i;
+    static constexpr unsigned size = 4u;
+
+    static f set1(float a) { return _mm_set1_ps(a); }
+    static i set1_i(int32_t a) { return _mm_set1_epi32(a); }
+    static f add(f a, f b) { return _mm_add_ps(a, b); }
+    static f sub(f a, f b) { return _mm_sub_ps(a, b); }
+    static f mul(f a, f b) { return _mm_mul_ps(a, b); }
+    static f div(f a, f b) { return _mm_div_ps(a, b); }
+    static f min(f a, f b) { return _mm_min_ps(a, b); }
+    static f max(f a, f b) { return _mm_max_ps(a, b); }
+    static f bit_and(f a, f b) { return _mm_and_ps(a, b); }
+    static f less(f a, f b) { return _mm_cmplt_ps(a, b); }
+    static i add_i(i a, i b) { return _mm_add_epi32(a, b); }
+    static i sub_i(i a, i b) { return _mm_sub_epi32(a, b); }
+    static i and_i(i a, i b) { return _mm_and_si128(a, b); }
+    static i or_i(i a, i b) { return _mm_or_si128(a, b); }
+    template <int N> static i shift_left(i a) { return _mm_slli_epi32(a, N); }
+    template <int N> static i shift_right(i a) { return _mm_srli_epi32(a, N); }
+    static f to_float(i a) { return _mm_cvtepi32_ps(a); }
+    static i truncate(f a) { return _mm_cvttps_epi32(a); }
+    static f as_float(i a) { return _mm_castsi128_ps(a); }
+    static i as_int(f a) { return _mm_castps_si128(a); }
+    static i load_i(const void *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+    static void store(float *p, f a) { _mm_storeu_ps(p, a); }
+  };
+
+#endif // IMAGE_CONVERTER_WITH_SSE
+
+#ifdef IMAGE_CONVERTER_WITH_AVX2
+
+  struct avx2_ops {
+    using f = __m256;
+    using i = __m256i;
+    static constexpr unsigned size = 8u;
+
+    static f set1(float a) { return _mm256_set1_ps(a); }
+    static i set1_i(int32_t a) { return _mm256_set1_epi32(a); }
+    static f add(f a, f b) { return _mm256_add_ps(a, b); }
+    static f sub(f a, f b) { return _mm256_sub_ps(a, b); }
+    static f mul(f a, f b) { return _mm256_mul_ps(a, b); }
+    static f div(f a, f b) { return _mm256_div_ps(a, b); }
+    static f min(f a, f b) { return _mm256_min_ps(a, b); }
+    static f max(f a, f b) { return _mm256_max_ps(a, b); }
+    static f bit_and(f a, f b) { return _mm256_and_ps(a, b); }
+    static f less(f a, f b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static i add_i(i a, i b) { return _mm256_add_epi32(a, b); }
+    static i sub_i(i a, i b) { return _mm256_sub_epi32(a, b); }
+    static i and_i(i a, i b) { return _mm256_and_si256(a, b); }
+    static i or_i(i a, i b) { return _mm256_or_si256(a, b); }
+    template <int N> static i shift_left(i a) { return _mm256_slli_epi32(a, N); }
+    template <int N> static i shift_right(i a) { return _mm256_srli_epi32(a, N); }
+    static f to_float(i a) { return _mm256_cvtepi32_ps(a); }
+    static i truncate(f a) { return _mm256_cvttps_epi32(a); }
+    static f as_float(i a) { return _mm256_castsi256_ps(a); }
+    static i as_int(f a) { return _mm256_castps_si256(a); }
+    static i load_i(const void *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    static void store(float *p, f a) { _mm256_storeu_ps(p, a); }
+  };
+
+#endif // IMAGE_CONVERTER_WITH_AVX2
+
+#ifdef IMAGE_CONVERTER_WITH_NEON
+
+  struct neon_ops {
+    using f = float32x4_t;
+    using i = int32x4_t;
+    static constexpr unsigned size = 4u;
+
+    static f set1(float a) { return vdupq_n_f32(a); }
+    static i set1_i(int32_t a) { return vdupq_n_s32(a); }
+    static f add(f a, f b) { return vaddq_f32(a, b); }
+    static f sub(f a, f b) { return vsubq_f32(a, b); }
+    static f mul(f a, f b) { return vmulq_f32(a, b); }
+    static f div(f a, f b) { return vdivq_f32(a, b); }
+    static f min(f a, f b) { return vminq_f32(a, b); }
+    static f max(f a, f b) { return vmaxq_f32(a, b); }
+    static f bit_and(f a, f b) {
+      return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+    }
+    static f less(f a, f b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+    static i add_i(i a, i b) { return vaddq_s32(a, b); }
+    static i sub_i(i a, i b) { return vsubq_s32(a, b); }
+    static i and_i(i a, i b) { return vandq_s32(a, b); }
+    static i or_i(i a, i b) { return vorrq_s32(a, b); }
+    template <int N> static i shift_left(i a) { return vshlq_n_s32(a, N); }
+    template <int N> static i shift_right(i a) {
+      return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), N));
+    }
+    static f to_float(i a) { return vcvtq_f32_s32(a); }
+    static i truncate(f a) { return vcvtq_s32_f32(a); }
+    static f as_float(i a) { return vreinterpretq_f32_s32(a); }
+    static i as_int(f a) { return vreinterpretq_s32_f32(a); }
+    static i load_i(const void *p) { return vld1q_s32(reinterpret_cast<const int32_t *>(p)); }
+    static void store(float *p, f a) { vst1q_f32(p, a); }
+  };
+
+#endif // IMAGE_CONVERTER_WITH_NEON
+
+  /// Widest operations available, if any.
+#if defined(IMAGE_CONVERTER_WITH_AVX2)
+#  define IMAGE_CONVERTER_WITH_SIMD
+  using native_ops = avx2_ops;
+#elif defined(IMAGE_CONVERTER_WITH_SSE)
+#  define IMAGE_CONVERTER_WITH_SIMD
+  using native_ops = sse_ops;
+#elif defined(IMAGE_CONVERTER_WITH_NEON)
+#  define IMAGE_CONVERTER_WITH_SIMD
+  using native_ops = neon_ops;
+#endif
+
+  // ===========================================================================
+  // -- Math -------------------------------------------------------------------
+  // ===========================================================================
+
+  /// Natural logarithm of positive normal numbers, within a couple of ulps of
+  /// std::log (Cephes' logf).
+  template <typename V>
+  static inline typename V::f log(typename V::f x) {
+    const auto one = V::set1(1.0f);
+    // Split x = m * 2^e with m in [0.5, 1).
+    const auto bits = V::as_int(x);
+    auto e = V::to_float(V::sub_i(V::template shift_right<23>(bits), V::set1_i(126)));
+    auto m = V::as_float(V::or_i(V::and_i(bits, V::set1_i(0x007fffff)), V::set1_i(0x3f000000)));
+    // If m < sqrt(1/2) use 2m - 1 and e - 1, otherwise m - 1.
+    const auto mask = V::less(m, V::set1(0.707106781186547524f));
+    const auto tmp = V::bit_and(mask, m);
+    m = V::sub(m, one);
+    e = V::sub(e, V::bit_and(mask, one));
+    m = V::add(m, tmp);
+    const auto z = V::mul(m, m);
+    auto y = V::set1(7.0376836292E-2f);
+    y = V::add(V::mul(y, m), V::set1(-1.1514610310E-1f));
+    y = V::add(V::mul(y, m), V::set1(1.1676998740E-1f));
+    y = V::add(V::mul(y, m), V::set1(-1.2420140846E-1f));
+    y = V::add(V::mul(y, m), V::set1(1.4249322787E-1f));
+    y = V::add(V::mul(y, m), V::set1(-1.6668057665E-1f));
+    y = V::add(V::mul(y, m), V::set1(2.0000714765E-1f));
+    y = V::add(V::mul(y, m), V::set1(-2.4999993993E-1f));
+    y = V::add(V::mul(y, m), V::set1(3.3333331174E-1f));
+    y = V::mul(V::mul(y, m), z);
+    y = V::add(y, V::mul(e, V::set1(-2.12194440E-4f)));
+    y = V::sub(y, V::mul(z, V::set1(0.5f)));
+    m = V::add(m, y);
+    return V::add(m, V::mul(e, V::set1(0.693359375f)));
+  }
+
+} // namespace simd
+} // namespace image_converter
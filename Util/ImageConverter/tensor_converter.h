@@ -0,0 +1,198 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "depth_image_converter.h"
+#include "image_converter_types.h"
+#include "raw_image.h"
+#include "simd_math.h"
+
+namespace image_converter {
+namespace detail {
+
+  static float half_to_float(uint16_t half) {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16u;
+    uint32_t exponent = (half >> 10u) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0x1fu) {
+      bits = sign | 0x7f800000u | (mantissa << 13u);
+    } else if (exponent != 0u) {
+      bits = sign | ((exponent + 112u) << 23u) | (mantissa << 13u);
+    } else if (mantissa == 0u) {
+      bits = sign;
+    } else {
+      // Subnormal, normalize it.
+      exponent = 113u;
+      while ((mantissa & 0x400u) == 0u) {
+        mantissa <<= 1u;
+        --exponent;
+      }
+      bits = sign | (exponent << 23u) | ((mantissa & 0x3ffu) << 13u);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(float));
+    return value;
+  }
+
+  /// Depth in [0, 1] encoded in a BGR(A) pixel.
+  static float normalized_depth(const uint8 *bgr) {
+    const auto depth =
+        (cast(bgr[2u]) +
+        (cast(bgr[1u]) * 256.0f) +
+        (cast(bgr[0u]) * 256.0f * 256.0f));
+    return depth / cast(256 * 256 * 256 - 1);
+  }
+
+#ifdef IMAGE_CONVERTER_WITH_SIMD
+
+  /// Converts V::size BGRA pixels at once.
+  template <typename V, typename TRANSFORM>
+  static inline void convert_bgra_depth_block(const uint8 *pixels, float *out) {
+    const auto bgra = V::load_i(pixels);
+    const auto mask = V::set1_i(0xff);
+    const auto b = V::and_i(bgra, mask);
+    const auto g = V::and_i(V::template shift_right<8>(bgra), mask);
+    const auto r = V::and_i(V::template shift_right<16>(bgra), mask);
+    V::store(out, TRANSFORM::template apply<V>(normalized_depth<V>(r, g, b)));
+  }
+
+#endif // IMAGE_CONVERTER_WITH_SIMD
+
+  /// Writes width x height values to @a out.
+  template <typename TRANSFORM>
+  static void convert_raw_depth(const raw_image &image, float *out) {
+    const size_t size = static_cast<size_t>(image.width) * image.height;
+    size_t i = 0u;
+    switch (image.encoding) {
+      case CARLA_SERVER_IMAGE_BGRA8:
+      case CARLA_SERVER_IMAGE_BGR8:
+        if (image.bytes_per_pixel == 4u) {
+#ifdef IMAGE_CONVERTER_WITH_SIMD
+          using V = simd::native_ops;
+          for (; i + V::size <= size; i += V::size) {
+            convert_bgra_depth_block<V, TRANSFORM>(image.data + 4u * i, out + i);
+          }
+#endif // IMAGE_CONVERTER_WITH_SIMD
+        }
+        for (; i < size; ++i) {
+          out[i] = TRANSFORM::apply(normalized_depth(image.data + image.bytes_per_pixel * i));
+        }
+        break;
+      case CARLA_SERVER_IMAGE_FLOAT32:
+        for (; i < size; ++i) {
+          float depth;
+          std::memcpy(&depth, image.data + sizeof(float) * i, sizeof(float));
+          out[i] = TRANSFORM::apply(depth);
+        }
+        break;
+      case CARLA_SERVER_IMAGE_FLOAT16:
+        for (; i < size; ++i) {
+          uint16_t half;
+          std::memcpy(&half, image.data + sizeof(uint16_t) * i, sizeof(uint16_t));
+          out[i] = TRANSFORM::apply(half_to_float(half));
+        }
+        break;
+      default:
+        throw std::invalid_argument("depth image with unsupported encoding");
+    }
+  }
+
+  /// Writes width x height values to @a out.
+  static void convert_raw_labels(const raw_image &image, uint8 *out) {
+    const size_t size = static_cast<size_t>(image.width) * image.height;
+    switch (image.encoding) {
+      case CARLA_SERVER_IMAGE_BGRA8:
+      case CARLA_SERVER_IMAGE_BGR8: {
+        // The label is in the red channel.
+        const auto *red = image.data + 2u;
+        for (size_t i = 0u; i < size; ++i) {
+          out[i] = red[image.bytes_per_pixel * i];
+        }
+        break;
+      }
+      case CARLA_SERVER_IMAGE_GRAY8:
+        std::memcpy(out, image.data, size);
+        break;
+      default:
+        throw std::invalid_argument("labels image with unsupported encoding");
+    }
+  }
+
+  template <typename TRANSFORM>
+  struct depth_tensor_converter_impl {
+    using value_type = float;
+
+    static bool accepts(const raw_image &image) {
+      return image.type == raw_image::Depth;
+    }
+
+    void operator()(const raw_image &image, std::vector<value_type> &out) const {
+      out.resize(static_cast<size_t>(image.width) * image.height);
+      convert_raw_depth<TRANSFORM>(image, out.data());
+    }
+
+    void operator()(const boost::gil::rgb8_view_t &view, std::vector<value_type> &out) const {
+      out.resize(view.size());
+      auto *value = out.data();
+      for (auto y = 0; y < view.height(); ++y) {
+        auto *row = view.row_begin(y);
+        for (auto x = 0; x < view.width(); ++x) {
+          *value++ = TRANSFORM::apply(normalized_depth(row[x]));
+        }
+      }
+    }
+  };
+
+} // namespace detail
+
+  // ===========================================================================
+  // -- Tensor converters ------------------------------------------------------
+  // ===========================================================================
+
+  // Convert the images of a raw_stream, or decoded images, into tensors of
+  // value_type, height x width in row-major order. Images of a raw_stream
+  // rejected by accepts() are skipped.
+
+  /// Normalized depth in [0, 1].
+  using depth_tensor_converter =
+      detail::depth_tensor_converter_impl<detail::linear_depth_transform>;
+
+  /// Same scale as logarithmic_depth_pixel_converter, in [0, 1].
+  using logarithmic_depth_tensor_converter =
+      detail::depth_tensor_converter_impl<detail::logarithmic_depth_transform>;
+
+  /// Semantic label ids.
+  struct label_tensor_converter {
+    using value_type = uint8;
+
+    static bool accepts(const raw_image &image) {
+      return image.type == raw_image::SemanticSegmentation;
+    }
+
+    void operator()(const raw_image &image, std::vector<value_type> &out) const {
+      out.resize(static_cast<size_t>(image.width) * image.height);
+      detail::convert_raw_labels(image, out.data());
+    }
+
+    void operator()(const boost::gil::rgb8_view_t &view, std::vector<value_type> &out) const {
+      out.resize(view.size());
+      auto *value = out.data();
+      for (auto y = 0; y < view.height(); ++y) {
+        auto *row = view.row_begin(y);
+        for (auto x = 0; x < view.width(); ++x) {
+          *value++ = row[x][Color::Red];
+        }
+      }
+    }
+  };
+
+} // namespace image_converter
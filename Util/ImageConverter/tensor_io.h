@@ -0,0 +1,244 @@
+// Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma
+// de Barcelona (UAB), and the INTEL Visual Computing Lab.
+//
+// This work is licensed under the terms of the MIT license.
+// For a copy, see <https://opensource.org/licenses/MIT>.
+
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "image_converter_types.h"
+
+namespace image_converter {
+namespace detail {
+
+  template <typename T>
+  struct npy_type;
+
+  template <>
+  struct npy_type<float> {
+    static constexpr const char *descr = "<f4";
+  };
+
+  template <>
+  struct npy_type<uint8> {
+    static constexpr const char *descr = "|u1";
+  };
+
+  /// Magic, version, header length and header of a .npy file (1.0) holding a
+  /// tensor of the given @a shape, padded to a multiple of 64 bytes or to
+  /// @a minimum_size if larger.
+  template <typename T>
+  static std::string make_npy_preamble(const std::string &shape, size_t minimum_size = 0u) {
+    std::string header =
+        std::string("{'descr': '") + npy_type<T>::descr + "', " +
+        "'fortran_order': False, " +
+        "'shape': (" + shape + "), }";
+    // Magic (6), version (2) and header length (2) go before the header, the
+    // header is padded with spaces and ended with a newline.
+    constexpr size_t PREAMBLE = 10u;
+    auto padding = 63u - (PREAMBLE + header.size()) % 64u;
+    while (PREAMBLE + header.size() + padding + 1u < minimum_size) {
+      padding += 64u;
+    }
+    header.append(padding, ' ');
+    header.push_back('\n');
+    const auto header_size = static_cast<uint16_t>(header.size());
+    std::string preamble = {'\x93', 'N', 'U', 'M', 'P', 'Y', '\x01', '\x00'};
+    preamble.push_back(static_cast<char>(header_size & 0xffu));
+    preamble.push_back(static_cast<char>(header_size >> 8u));
+    return preamble + header;
+  }
+
+  static std::string make_shape(uint32 height, uint32 width) {
+    return std::to_string(height) + ", " + std::to_string(width);
+  }
+
+  static std::ofstream open_tensor_file(const std::string &filename) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("cannot open file: " + filename);
+    }
+    return file;
+  }
+
+  static void check_tensor_file(const std::ofstream &file, const std::string &filename) {
+    if (!file) {
+      throw std::runtime_error("error writing file: " + filename);
+    }
+  }
+
+  /// Tensors of their own are written next to their final name and renamed
+  /// once complete, so an interrupted run never leaves a truncated one.
+  static std::string make_temporary_filename(const std::string &filename) {
+    return filename + ".part";
+  }
+
+  static void commit_tensor_file(std::ofstream &file, const std::string &filename) {
+    const auto temporary = make_temporary_filename(filename);
+    file.close();
+    check_tensor_file(file, temporary);
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+      throw std::runtime_error("cannot rename file: " + temporary);
+    }
+  }
+
+} // namespace detail
+
+  /// Writes @a data as a height x width tensor, without any header.
+  template <typename T>
+  static void write_raw_tensor(const std::string &filename, const std::vector<T> &data) {
+    auto file = detail::open_tensor_file(detail::make_temporary_filename(filename));
+    file.write(reinterpret_cast<const char *>(data.data()), sizeof(T) * data.size());
+    detail::commit_tensor_file(file, filename);
+  }
+
+  /// Writes @a data as a height x width tensor in NumPy's .npy format (1.0),
+  /// loadable with numpy.load.
+  template <typename T>
+  static void write_npy_tensor(
+      const std::string &filename,
+      const std::vector<T> &data,
+      uint32 height,
+      uint32 width) {
+    auto file = detail::open_tensor_file(detail::make_temporary_filename(filename));
+    const auto preamble = detail::make_npy_preamble<T>(detail::make_shape(height, width));
+    file.write(preamble.data(), preamble.size());
+    file.write(reinterpret_cast<const char *>(data.data()), sizeof(T) * data.size());
+    detail::commit_tensor_file(file, filename);
+  }
+
+  // ===========================================================================
+  // -- tensor_writer ----------------------------------------------------------
+  // ===========================================================================
+
+  struct tensor_write_options {
+    /// NumPy's .npy, or headerless row-major data otherwise.
+    bool npy = true;
+
+    /// Tensors per shard file, zero to write a file per tensor.
+    uint32 shard_size = 0u;
+  };
+
+  /// Writes height x width tensors into @a folder, either a file per tensor
+  /// named after it, or stacked into shards of up to shard_size tensors of the
+  /// same shape (shard_00000.npy, shard_00001.npy...) that can be
+  /// memory-mapped, each with an index (shard_00000.txt...) listing a
+  /// "name height width" line per tensor in order. Thread-safe.
+  template <typename T>
+  class tensor_writer {
+  public:
+
+    tensor_writer(std::string folder, const tensor_write_options &options)
+      : _folder(std::move(folder)),
+        _options(options) {}
+
+    ~tensor_writer() {
+      try {
+        close();
+      } catch (const std::exception &e) {
+        std::fprintf(stderr, "error closing shard: %s\n", e.what());
+      }
+    }
+
+    void write(const std::string &name, const std::vector<T> &data, uint32 height, uint32 width) {
+      if (_options.shard_size == 0u) {
+        const auto filename = _folder + "/" + name + extension();
+        if (_options.npy) {
+          write_npy_tensor(filename, data, height, width);
+        } else {
+          write_raw_tensor(filename, data);
+        }
+        return;
+      }
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_shard.is_open() &&
+          ((_count == _options.shard_size) || (height != _height) || (width != _width))) {
+        close_shard();
+      }
+      if (!_shard.is_open()) {
+        open_shard(height, width);
+      }
+      _shard.write(reinterpret_cast<const char *>(data.data()), sizeof(T) * data.size());
+      _index << name << ' ' << height << ' ' << width << '\n';
+      ++_count;
+      detail::check_tensor_file(_shard, _shard_filename);
+    }
+
+    /// Finishes the shard being written, if any.
+    void close() {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_shard.is_open()) {
+        close_shard();
+      }
+    }
+
+  private:
+
+    /// Room for the header of any shard, so it can be rewritten with the final
+    /// number of tensors once the shard is closed.
+    static constexpr size_t NPY_PREAMBLE_SIZE = 128u;
+
+    const char *extension() const {
+      return _options.npy ? ".npy" : ".raw";
+    }
+
+    std::string make_shard_preamble() const {
+      const auto shape = std::to_string(_count) + ", " + detail::make_shape(_height, _width);
+      return detail::make_npy_preamble<T>(shape, NPY_PREAMBLE_SIZE);
+    }
+
+    void open_shard(uint32 height, uint32 width) {
+      char name[32u];
+      std::snprintf(name, sizeof(name), "shard_%05u", static_cast<unsigned>(_next_shard++));
+      _shard_filename = _folder + "/" + name + extension();
+      _shard = detail::open_tensor_file(_shard_filename);
+      _index = detail::open_tensor_file(_folder + "/" + name + ".txt");
+      _height = height;
+      _width = width;
+      _count = 0u;
+      if (_options.npy) {
+        const auto preamble = make_shard_preamble();
+        _shard.write(preamble.data(), preamble.size());
+      }
+    }
+
+    void close_shard() {
+      if (_options.npy) {
+        const auto preamble = make_shard_preamble();
+        _shard.seekp(0);
+        _shard.write(preamble.data(), preamble.size());
+      }
+      _shard.close();
+      _index.close();
+      detail::check_tensor_file(_shard, _shard_filename);
+    }
+
+    const std::string _folder;
+
+    const tensor_write_options _options;
+
+    std::mutex _mutex;
+
+    std::ofstream _shard;
+
+    std::ofstream _index;
+
+    std::string _shard_filename;
+
+    uint32 _next_shard = 0u;
+
+    uint32 _count = 0u;
+
+    uint32 _height = 0u;
+
+    uint32 _width = 0u;
+  };
+
+} // namespace image_converter
@@ -28,9 +28,16 @@ def make_carla_client(host, world_port, timeout=15):
 
 class CarlaClient(object):
     def __init__(self, host, world_port, timeout=15):
+        self._host = host
+        self._world_port = world_port
+        self._timeout = timeout
+        self._bytes_received = 0
         self._world_client = tcp.TCPClient(host, world_port, timeout)
-        self._stream_client = tcp.TCPClient(host, world_port + 1, timeout)
-        self._control_client = tcp.TCPClient(host, world_port + 2, timeout)
+        self._make_agent_clients(host, world_port)
+
+    def _make_agent_clients(self, host, world_port):
+        self._stream_client = tcp.TCPClient(host, world_port + 1, self._timeout)
+        self._control_client = tcp.TCPClient(host, world_port + 2, self._timeout)
 
     def connect(self):
         self._world_client.connect()
@@ -43,6 +50,10 @@ class CarlaClient(object):
     def connected(self):
         return self._world_client.connected()
 
+    def bytes_received(self):
+        """Number of bytes of measurements and images read so far."""
+        return self._bytes_received
+
     def request_new_episode(self, carla_settings):
         """Request a new episode. carla_settings object must be convertible to
         a str holding a CarlaSettings.ini.
@@ -66,6 +77,49 @@ class CarlaClient(object):
             raise RuntimeError("received 0 player start spots")
         return pb_message
 
+    def queue_new_episode(self, carla_settings):
+        """Queue the next episode while the current one is running, the
+        server prepares it in the background. The server sends no answer, the
+        episode starts with start_queued_episode().
+        """
+        pb_message = carla_protocol.RequestNewEpisode()
+        pb_message.ini_file = str(carla_settings)
+        pb_message.queue = True
+        self._world_client.write(pb_message.SerializeToString())
+
+    def start_queued_episode(self):
+        """Request the episode queued by queue_new_episode().
+
+        Returns a protobuf object holding the scene description.
+        """
+        return self.request_new_episode('')
+
+    def take_snapshot(self):
+        """Take a snapshot of the world state while the episode is running.
+
+        Returns the snapshot as an opaque bytes object, only valid within the
+        current episode, see restore_snapshot().
+        """
+        return self._request_snapshot(b'')
+
+    def restore_snapshot(self, snapshot):
+        """Restore the world state to a snapshot taken in this episode."""
+        self._request_snapshot(snapshot)
+
+    def _request_snapshot(self, restore_snapshot):
+        pb_message = carla_protocol.RequestNewEpisode()
+        pb_message.snapshot = True
+        pb_message.restore_snapshot = restore_snapshot
+        self._world_client.write(pb_message.SerializeToString())
+        data = self._world_client.read()
+        if not data:
+            raise RuntimeError('failed to read data from server')
+        pb_message = carla_protocol.WorldSnapshot()
+        pb_message.ParseFromString(data)
+        if not pb_message.success:
+            raise RuntimeError('the server failed to take or restore the snapshot')
+        return pb_message.data
+
     def start_episode(self, player_start_index):
         """Start the new episode at the player start given by the
         player_start_index. The list of player starts is retrieved by
@@ -84,7 +138,12 @@ class CarlaClient(object):
         pb_message.ParseFromString(data)
         if not pb_message.ready:
             raise RuntimeError('cannot start episode: server failed to start episode')
-        # We can start the agent clients now.
+        # We can start the agent clients now, at the simulator behind the
+        # episode broker if any.
+        if pb_message.server_host:
+            self._make_agent_clients(pb_message.server_host, pb_message.server_world_port)
+        else:
+            self._make_agent_clients(self._host, self._world_port)
         self._stream_client.connect()
         self._control_client.connect()
 
@@ -101,6 +160,7 @@ class CarlaClient(object):
         pb_message.ParseFromString(data)
         # Read images.
         images_raw_data = self._stream_client.read()
+        self._bytes_received += len(data) + len(images_raw_data)
         return pb_message, CarlaImage.parse_raw_data(images_raw_data)
 
     def send_control(self, *args, **kwargs):
@@ -114,6 +174,19 @@ class CarlaClient(object):
             pb_message.brake = kwargs.get('brake', 0.0)
             pb_message.hand_brake = kwargs.get('hand_brake', False)
             pb_message.reverse = kwargs.get('reverse', False)
+            pb_message.sequence_number = kwargs.get('sequence_number', 0)
+        self._control_client.write(pb_message.SerializeToString())
+
+    def send_control_batch(self, controls, skip_intermediate_measurements=False):
+        """Send a list of vehicle controls, the server applies one per frame.
+        If skip_intermediate_measurements, the server only sends the
+        measurements once the whole batch has been applied."""
+        if not controls:
+            raise ValueError('empty control batch')
+        pb_message = carla_protocol.Control()
+        pb_message.CopyFrom(controls[0])
+        pb_message.next_controls.extend(controls[1:])
+        pb_message.skip_intermediate_measurements = skip_intermediate_measurements
         self._control_client.write(pb_message.SerializeToString())
 
 
@@ -121,17 +194,21 @@ class CarlaImage(object):
     @staticmethod
     def parse_raw_data(raw_data):
         getval = lambda index: struct.unpack('<L', raw_data[index*4:index*4+4])[0]
+        if not raw_data:
+            return []
+        version = getval(0)
+        if version != 3:
+            raise RuntimeError('unsupported image message version %d' % version)
         images = []
-        total_size = len(raw_data) / 4
-        index = 0
-        while index < total_size:
-            width = getval(index)
-            height = getval(index + 1)
-            image_type = getval(index + 2)
-            begin = index + 3
-            end = begin + width * height
-            images.append(CarlaImage(width, height, image_type, raw_data[begin*4:end*4]))
-            index = end
+        # Header table of (offset, width, height, type, stride, encoding,
+        # screen percentage).
+        for index in range(2, 2 + 7 * getval(1), 7):
+            offset = getval(index)
+            width = getval(index + 1)
+            height = getval(index + 2)
+            image_type = getval(index + 3)
+            end = offset + getval(index + 4) * height
+            images.append(CarlaImage(width, height, image_type, raw_data[offset:end]))
         return images
 
     def __init__(self, width, height, image_type, raw_data):
@@ -0,0 +1,300 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma de
+# Barcelona (UAB), and the INTEL Visual Computing Lab.
+#
+# This work is licensed under the terms of the MIT license.
+# For a copy, see <https://opensource.org/licenses/MIT>.
+
+"""Load generator, runs one client process per CARLA server and reports the
+frames, bytes and latency of each server and of all of them together."""
+
+import argparse
+import logging
+import multiprocessing
+import random
+import time
+
+from carla.client import carla_protocol, make_carla_client
+from carla.settings import CarlaSettings, Camera
+
+
+def parse_servers(args):
+    """List of (host, port) to load, either given explicitly or as a range of
+    ports starting at args.port. Each server uses three consecutive ports."""
+    if args.servers:
+        servers = []
+        for server in args.servers.split(','):
+            host, _, port = server.rpartition(':')
+            servers.append((host or args.host, int(port)))
+        return servers
+    return [(args.host, args.port + 3 * index) for index in range(args.clients)]
+
+
+def make_settings(args):
+    settings = CarlaSettings()
+    settings.set(
+        SynchronousMode=args.synchronous,
+        SendNonPlayerAgentsInfo=args.agents_info,
+        NumberOfVehicles=args.vehicles,
+        NumberOfPedestrians=args.pedestrians)
+    settings.randomize_seeds()
+    for index in range(args.cameras):
+        camera = Camera('Camera%d' % index)
+        camera.set_image_size(args.width, args.height)
+        camera.set_rotation(0, 0, index * 360.0 / args.cameras)
+        settings.add_camera(camera)
+    return settings
+
+
+def make_controls(measurements, count):
+    controls = []
+    for _ in range(count):
+        control = carla_protocol.Control()
+        control.CopyFrom(measurements.player_measurements.ai_control)
+        controls.append(control)
+    return controls
+
+
+def run_client(index, host, port, args, results):
+    """Run the episodes of one client and put its statistics in results."""
+    random.seed(args.seed + index)
+    stats = {
+        'server': '%s:%d' % (host, port),
+        'frames': 0,
+        'bytes': 0,
+        'seconds': 0.0,
+        'latencies': [],
+        'episode_latencies': [],
+        'error': None
+    }
+    try:
+        with make_carla_client(host, port, timeout=args.timeout) as client:
+            for episode in range(args.episodes):
+                start = time.time()
+                scene = client.request_new_episode(make_settings(args))
+                client.start_episode(random.randint(0, len(scene.player_start_spots) - 1))
+                stats['episode_latencies'].append(time.time() - start)
+                logging.debug('%s: episode %d started', stats['server'], episode)
+
+                frames = 0
+                start = time.time()
+                bytes_received = client.bytes_received()
+                sent = time.time()
+                while frames < args.frames:
+                    measurements, _ = client.read_measurements()
+                    received = time.time()
+                    stats['latencies'].append(received - sent)
+                    if args.think_time > 0.0:
+                        time.sleep(args.think_time / 1000.0)
+                    if args.pattern == 'batch':
+                        batch_size = min(args.batch_size, args.frames - frames)
+                        client.send_control_batch(
+                            make_controls(measurements, batch_size),
+                            skip_intermediate_measurements=True)
+                        frames += batch_size
+                    else:
+                        client.send_control(measurements.player_measurements.ai_control)
+                        frames += 1
+                    sent = time.time()
+                stats['seconds'] += time.time() - start
+                stats['frames'] += frames
+                stats['bytes'] += client.bytes_received() - bytes_received
+    except Exception as exception:
+        stats['error'] = '%s' % exception
+    results.put(stats)
+
+
+def percentile(values, fraction):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def print_stats(name, frames, total_bytes, seconds, latencies, episode_latencies):
+    seconds = max(seconds, 1e-9)
+    to_ms = lambda value: 1000.0 * value
+    print('%-22s %8d frames %9.2f FPS %9.2f MB/s   latency ms p50 %7.2f p90 %7.2f p99 %7.2f max %7.2f   episode start ms p50 %8.1f' % (
+        name,
+        frames,
+        frames / seconds,
+        total_bytes / seconds / 1e6,
+        to_ms(percentile(latencies, 0.5)),
+        to_ms(percentile(latencies, 0.9)),
+        to_ms(percentile(latencies, 0.99)),
+        to_ms(max(latencies) if latencies else 0.0),
+        to_ms(percentile(episode_latencies, 0.5))))
+
+
+def run_load(args):
+    servers = parse_servers(args)
+    logging.info(
+        'loading %d servers with %d episodes of %d frames each (%s)',
+        len(servers),
+        args.episodes,
+        args.frames,
+        args.pattern)
+
+    results = multiprocessing.Queue()
+    processes = [
+        multiprocessing.Process(target=run_client, args=(index, host, port, args, results))
+        for index, (host, port) in enumerate(servers)]
+    start = time.time()
+    for process in processes:
+        process.start()
+    all_stats = [results.get() for _ in processes]
+    for process in processes:
+        process.join()
+    wall_time = time.time() - start
+
+    all_stats.sort(key=lambda stats: stats['server'])
+    latencies = []
+    episode_latencies = []
+    for stats in all_stats:
+        latencies += stats['latencies']
+        episode_latencies += stats['episode_latencies']
+        print_stats(
+            stats['server'],
+            stats['frames'],
+            stats['bytes'],
+            stats['seconds'],
+            stats['latencies'],
+            stats['episode_latencies'])
+        if stats['error'] is not None:
+            logging.error('%s: %s', stats['server'], stats['error'])
+    # Aggregate rates are over the wall time, so episode changes and slow
+    # servers count against them.
+    print_stats(
+        'total',
+        sum(stats['frames'] for stats in all_stats),
+        sum(stats['bytes'] for stats in all_stats),
+        wall_time,
+        latencies,
+        episode_latencies)
+    return all(stats['error'] is None for stats in all_stats)
+
+
+def main():
+    argparser = argparse.ArgumentParser(description=__doc__)
+    argparser.add_argument(
+        '-v', '--verbose',
+        action='store_true',
+        dest='debug',
+        help='print debug information')
+    argparser.add_argument(
+        '--host',
+        metavar='H',
+        default='localhost',
+        help='IP of the host server (default: localhost)')
+    argparser.add_argument(
+        '-p', '--port',
+        metavar='P',
+        default=2000,
+        type=int,
+        help='TCP port of the first server (default: 2000)')
+    argparser.add_argument(
+        '-n', '--clients',
+        metavar='N',
+        default=1,
+        type=int,
+        help='number of servers, listening every 3 ports starting at --port (default: 1)')
+    argparser.add_argument(
+        '--servers',
+        metavar='LIST',
+        default=None,
+        help='comma-separated list of host:port, overrides --port and --clients')
+    argparser.add_argument(
+        '-e', '--episodes',
+        metavar='E',
+        default=3,
+        type=int,
+        help='episodes per client (default: 3)')
+    argparser.add_argument(
+        '-f', '--frames',
+        metavar='F',
+        default=300,
+        type=int,
+        help='frames per episode (default: 300)')
+    argparser.add_argument(
+        '--pattern',
+        choices=['step', 'batch'],
+        default='step',
+        help='send one control per frame, or a batch of controls per read (default: step)')
+    argparser.add_argument(
+        '--batch-size',
+        metavar='B',
+        default=10,
+        type=int,
+        help='controls per batch with --pattern=batch (default: 10)')
+    argparser.add_argument(
+        '--think-time',
+        metavar='MS',
+        default=0.0,
+        type=float,
+        help='milliseconds each client waits before sending the control (default: 0)')
+    argparser.add_argument(
+        '-c', '--cameras',
+        metavar='C',
+        default=1,
+        type=int,
+        help='cameras per server (default: 1)')
+    argparser.add_argument(
+        '--width',
+        default=800,
+        type=int,
+        help='image width (default: 800)')
+    argparser.add_argument(
+        '--height',
+        default=600,
+        type=int,
+        help='image height (default: 600)')
+    argparser.add_argument(
+        '--vehicles',
+        default=20,
+        type=int,
+        help='number of vehicles (default: 20)')
+    argparser.add_argument(
+        '--pedestrians',
+        default=30,
+        type=int,
+        help='number of pedestrians (default: 30)')
+    argparser.add_argument(
+        '--agents-info',
+        action='store_true',
+        help='request the info of the non-player agents')
+    argparser.add_argument(
+        '-s', '--synchronous',
+        action='store_true',
+        help='enable synchronous mode')
+    argparser.add_argument(
+        '--timeout',
+        default=60,
+        type=int,
+        help='socket timeout in seconds (default: 60)')
+    argparser.add_argument(
+        '--seed',
+        default=0,
+        type=int,
+        help='seed of the player starts of each client (default: 0)')
+
+    args = argparser.parse_args()
+
+    if args.cameras < 1:
+        argparser.error('at least one camera is required')
+    if args.batch_size < 1:
+        argparser.error('batch size must be positive')
+
+    log_level = logging.DEBUG if args.debug else logging.INFO
+    logging.basicConfig(format='%(levelname)s: %(message)s', level=log_level)
+
+    if not run_load(args):
+        raise SystemExit(1)
+
+
+if __name__ == '__main__':
+
+    try:
+        main()
+    except KeyboardInterrupt:
+        print('\nCancelled by user. Bye!')
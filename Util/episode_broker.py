@@ -0,0 +1,477 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma de
+# Barcelona (UAB), and the INTEL Visual Computing Lab.
+#
+# This work is licensed under the terms of the MIT license.
+# For a copy, see <https://opensource.org/licenses/MIT>.
+
+"""Hand out the CARLA simulators of a farm to the clients connecting to a
+single world port.
+
+The broker speaks the world protocol to its clients. The first
+RequestNewEpisode of a client is queued until a simulator is idle, then the
+broker connects to that simulator and relays the world connection for the rest
+of the session. The agent connections go straight to the simulator,
+EpisodeReady tells the client where (server_host and server_world_port).
+
+Episodes are balanced by their expected cost, estimated from their
+CarlaSettings.ini: the pixels rendered by the cameras and the number of
+vehicles and pedestrians. Each request goes to the idle simulator with the
+least load relative to its capacity, preferring one already prepared for the
+same settings. While every simulator is busy, the settings of the next request
+are sent ahead as a queued episode (RequestNewEpisode.queue) to the simulator
+expected to take it, so it can prepare in the background. That pays off with
+ReconnectWithoutRestart and SoftEpisodeReset in the settings of the simulators,
+otherwise they reload the level between clients anyway.
+
+Only the few protobuf fields needed are decoded here, the broker needs no
+protobuf module. Python 3 only.
+"""
+
+import argparse
+import collections
+import configparser
+import itertools
+import logging
+import socket
+import struct
+import threading
+import time
+
+
+HEARTBEAT_MESSAGE = 0xFFFFFFFF
+
+# Cost of an episode, in units of a simulator running an empty episode.
+COST_PER_MEGAPIXEL = 1.0
+COST_PER_AGENT = 0.01
+
+
+# ==============================================================================
+# -- Protobuf wire format ------------------------------------------------------
+# ==============================================================================
+
+
+def read_varint(data, offset):
+    value = 0
+    for shift in itertools.count(0, 7):
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value, offset
+
+
+def parse_fields(data):
+    """Return a dict from field number to its last value, varints as ints and
+    length-delimited fields as bytes. Fixed-size fields are skipped."""
+    fields = {}
+    offset = 0
+    while offset < len(data):
+        key, offset = read_varint(data, offset)
+        wire_type = key & 0x7
+        if wire_type == 0:
+            fields[key >> 3], offset = read_varint(data, offset)
+        elif wire_type == 2:
+            length, offset = read_varint(data, offset)
+            fields[key >> 3] = data[offset:offset + length]
+            offset += length
+        elif wire_type in (1, 5):
+            offset += 8 if wire_type == 1 else 4
+        else:
+            raise ValueError('unsupported wire type %d' % wire_type)
+    return fields
+
+
+def write_varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def write_varint_field(number, value):
+    return write_varint(number << 3) + write_varint(value)
+
+
+def write_bytes_field(number, value):
+    return write_varint((number << 3) | 2) + write_varint(len(value)) + value
+
+
+class RequestNewEpisode(object):
+    def __init__(self, data):
+        fields = parse_fields(data)
+        self.ini_file = fields.get(1, b'').decode('utf-8', 'replace')
+        self.queue = bool(fields.get(2, 0))
+        self.snapshot = bool(fields.get(3, 0))
+
+    @staticmethod
+    def serialize(ini_file, queue=False):
+        data = write_bytes_field(1, ini_file.encode('utf-8'))
+        return data + write_varint_field(2, 1) if queue else data
+
+
+def redirect_episode_ready(data, host, world_port):
+    """Fields appended to a serialized message override the previous ones."""
+    return data + write_bytes_field(9, host.encode('utf-8')) + write_varint_field(10, world_port)
+
+
+# ==============================================================================
+# -- Episode cost --------------------------------------------------------------
+# ==============================================================================
+
+
+def estimate_cost(ini_file):
+    """Expected cost of running an episode with the given CarlaSettings.ini."""
+    config = configparser.ConfigParser(strict=False, interpolation=None)
+    config.optionxform = str
+    try:
+        config.read_string(ini_file)
+    except configparser.Error:
+        return 1.0
+
+    def get(sections, key, default):
+        # Camera values are inherited from the parent sections.
+        for section in sections:
+            if config.has_option(section, key):
+                try:
+                    return int(config.get(section, key))
+                except ValueError:
+                    break
+        return default
+
+    scene = 'CARLA/SceneCapture'
+    pixels = 0
+    cameras = config.get(scene, 'Cameras', fallback='')
+    for name in (name.strip() for name in cameras.split(',')):
+        if not name:
+            continue
+        parts = name.split('/')
+        sections = ['/'.join([scene] + parts[:i]) for i in range(len(parts), -1, -1)]
+        effects = 1
+        for section in sections:
+            if config.has_option(section, 'PostProcessing'):
+                effects = len(config.get(section, 'PostProcessing').split(','))
+                break
+        pixels += get(sections, 'ImageSizeX', 720) * get(sections, 'ImageSizeY', 512) * effects
+    level = ['CARLA/LevelSettings']
+    agents = get(level, 'NumberOfVehicles', 0) + get(level, 'NumberOfPedestrians', 0)
+    return 1.0 + COST_PER_MEGAPIXEL * pixels / 1e6 + COST_PER_AGENT * agents
+
+
+# ==============================================================================
+# -- Connections ---------------------------------------------------------------
+# ==============================================================================
+
+
+def read_n(sock, length):
+    buf = bytearray()
+    while len(buf) < length:
+        data = sock.recv(length - len(buf))
+        if not data:
+            raise ConnectionError('connection closed')
+        buf += data
+    return bytes(buf)
+
+
+def read_message(sock):
+    """Return the message, None for a heartbeat."""
+    length = struct.unpack('<L', read_n(sock, 4))[0]
+    if length == HEARTBEAT_MESSAGE:
+        return None
+    return read_n(sock, length)
+
+
+def write_message(sock, message):
+    if message is None:
+        sock.sendall(struct.pack('<L', HEARTBEAT_MESSAGE))
+    else:
+        sock.sendall(struct.pack('<L', len(message)) + message)
+
+
+class Simulator(object):
+    def __init__(self, host, world_port, capacity):
+        self.host = host
+        self.world_port = world_port
+        self.capacity = capacity
+        self.session = None
+        # Sum of the costs of the episodes given to this simulator.
+        self.load = 0.0
+        # Settings it is prepared for, those of its last or queued episode.
+        self.prepared_ini = None
+        # Until when it is left aside after failing to connect.
+        self.down_until = 0.0
+
+    def __str__(self):
+        return '%s:%d' % (self.host, self.world_port)
+
+    def score(self, cost):
+        return (self.load + cost) / self.capacity
+
+
+class Session(object):
+    """A client and the simulator it got, relaying the world connection."""
+
+    def __init__(self, broker, client, address):
+        self.broker = broker
+        self.client = client
+        self.address = address
+        self.request = None
+        self.cost = 0.0
+        self.simulator = None
+        self.server = None
+        self._assigned = threading.Event()
+        # Writes to the simulator come from the session and the scheduler.
+        self._lock = threading.Lock()
+        self._episode_running = False
+        self._client_queues = False
+
+    def run(self):
+        try:
+            self.client.settimeout(self.broker.timeout)
+            data = read_message(self.client)
+            while data is None:
+                data = read_message(self.client)
+            self.request = RequestNewEpisode(data)
+            if self.request.queue or self.request.snapshot:
+                raise RuntimeError('the first request has to start an episode')
+            self.cost = estimate_cost(self.request.ini_file)
+            self.broker.enqueue(self)
+            self._assigned.wait()
+            # The world connection stays silent while the episodes run.
+            self.client.settimeout(None)
+            self.server.settimeout(self.broker.timeout)
+            self._relay(data)
+        except (OSError, RuntimeError, ValueError) as error:
+            logging.info('%s: session closed: %s', self.address, error)
+        finally:
+            self.broker.release(self)
+            for sock in (self.client, self.server):
+                if sock is not None:
+                    sock.close()
+
+    def assign(self, simulator, server):
+        self.simulator = simulator
+        self.server = server
+        self._assigned.set()
+
+    def prepare(self, ini_file):
+        """Send ahead the settings of the next episode of the simulator. Only
+        while an episode runs, and if the client does not queue its own."""
+        with self._lock:
+            if not self._episode_running or self._client_queues:
+                return False
+            write_message(self.server, RequestNewEpisode.serialize(ini_file, queue=True))
+            self.simulator.prepared_ini = ini_file
+            return True
+
+    def _relay(self, data):
+        while True:
+            # Between episodes the client only sends requests and heartbeats.
+            request = RequestNewEpisode(data) if data is not None else None
+            with self._lock:
+                write_message(self.server, data)
+                if request is not None and request.queue:
+                    self._client_queues = True
+                    self.simulator.prepared_ini = request.ini_file
+                elif request is not None and not request.snapshot:
+                    self._episode_running = False
+                    self.simulator.prepared_ini = request.ini_file
+            if request is not None and request.snapshot:
+                write_message(self.client, read_message(self.server))
+            elif request is not None and not request.queue:
+                self._start_episode()
+            data = read_message(self.client)
+
+    def _start_episode(self):
+        # SceneDescription, then EpisodeStart and its EpisodeReady.
+        write_message(self.client, read_message(self.server))
+        data = read_message(self.client)
+        while data is None:
+            with self._lock:
+                write_message(self.server, data)
+            data = read_message(self.client)
+        with self._lock:
+            write_message(self.server, data)
+        ready = read_message(self.server)
+        write_message(self.client, redirect_episode_ready(
+            ready,
+            self.simulator.host,
+            self.simulator.world_port))
+        with self._lock:
+            self._episode_running = True
+
+
+# ==============================================================================
+# -- Broker --------------------------------------------------------------------
+# ==============================================================================
+
+
+class Broker(object):
+    def __init__(self, simulators, timeout, connect_timeout, retry_delay):
+        self.simulators = simulators
+        self.timeout = timeout
+        self.connect_timeout = connect_timeout
+        self.retry_delay = retry_delay
+        self._queue = collections.deque()
+        self._condition = threading.Condition()
+
+    def enqueue(self, session):
+        with self._condition:
+            logging.info(
+                '%s: queued episode of cost %.2f, %d waiting',
+                session.address, session.cost, len(self._queue) + 1)
+            self._queue.append(session)
+            self._condition.notify()
+
+    def release(self, session):
+        with self._condition:
+            if session in self._queue:
+                self._queue.remove(session)
+            simulator = session.simulator
+            if simulator is not None and simulator.session is session:
+                logging.info('%s: idle', simulator)
+                simulator.session = None
+            self._condition.notify()
+
+    def run(self):
+        """Assign the queued requests to the simulators as they get idle."""
+        while True:
+            with self._condition:
+                while not self._queue:
+                    self._condition.wait()
+                assignment = self._pick()
+                if assignment is None:
+                    self._prepare_next()
+                    self._condition.wait(self.retry_delay)
+                    continue
+                session, simulator = assignment
+                self._queue.remove(session)
+                simulator.session = session
+                simulator.load += session.cost
+            server = self._connect(simulator)
+            if server is None:
+                with self._condition:
+                    simulator.session = None
+                    simulator.load -= session.cost
+                    simulator.down_until = time.time() + self.retry_delay
+                    self._queue.appendleft(session)
+                continue
+            logging.info('%s: assigned to %s', session.address, simulator)
+            session.assign(simulator, server)
+
+    def _pick(self):
+        """Oldest request first, to an idle simulator prepared for the same
+        settings if any, otherwise to the one with the least relative load."""
+        now = time.time()
+        idle = [s for s in self.simulators if s.session is None and s.down_until <= now]
+        if not idle:
+            return None
+        session = self._queue[0]
+        for simulator in idle:
+            if simulator.prepared_ini == session.request.ini_file:
+                return session, simulator
+        return session, min(idle, key=lambda simulator: simulator.score(session.cost))
+
+    def _prepare_next(self):
+        session = self._queue[0]
+        ini_file = session.request.ini_file
+        busy = [s for s in self.simulators if s.session is not None]
+        if not busy or any(s.prepared_ini == ini_file for s in busy):
+            return
+        simulator = min(busy, key=lambda simulator: simulator.score(session.cost))
+        try:
+            if simulator.session.prepare(ini_file):
+                logging.info('%s: prepared for the next episode', simulator)
+        except OSError:
+            pass
+
+    def _connect(self, simulator):
+        # The simulator may still be setting up after its previous client.
+        deadline = time.time() + self.connect_timeout
+        while True:
+            try:
+                server = socket.create_connection((simulator.host, simulator.world_port), self.timeout)
+                server.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                return server
+            except OSError as error:
+                if time.time() >= deadline:
+                    logging.warning('%s: cannot connect: %s', simulator, error)
+                    return None
+                time.sleep(1.0)
+
+
+def parse_simulator(text):
+    """host:port[:capacity]"""
+    parts = text.split(':')
+    if len(parts) not in (2, 3):
+        raise argparse.ArgumentTypeError('expected host:port[:capacity], got "%s"' % text)
+    try:
+        capacity = float(parts[2]) if len(parts) == 3 else 1.0
+        return Simulator(parts[0], int(parts[1]), capacity)
+    except ValueError:
+        raise argparse.ArgumentTypeError('invalid simulator "%s"' % text)
+
+
+def main():
+    argparser = argparse.ArgumentParser(description=__doc__)
+    argparser.add_argument(
+        'simulators',
+        metavar='HOST:PORT[:CAPACITY]',
+        nargs='+',
+        type=parse_simulator,
+        help='world port of each simulator, as reachable by the clients, and its capacity relative to the others (default: 1)')
+    argparser.add_argument(
+        '-p', '--port',
+        type=int,
+        default=2000,
+        help='world port the clients connect to (default: 2000)')
+    argparser.add_argument(
+        '--timeout',
+        type=float,
+        default=60.0,
+        help='seconds a client or simulator may stay silent (default: 60)')
+    argparser.add_argument(
+        '--connect-timeout',
+        type=float,
+        default=30.0,
+        help='seconds to wait for a simulator to listen again (default: 30)')
+    argparser.add_argument(
+        '--retry-delay',
+        type=float,
+        default=10.0,
+        help='seconds a simulator that failed to connect is left aside (default: 10)')
+    argparser.add_argument(
+        '-v', '--verbose',
+        action='store_true',
+        help='print debug information')
+    args = argparser.parse_args()
+
+    logging.basicConfig(
+        format='%(asctime)s %(levelname)s: %(message)s',
+        level=logging.DEBUG if args.verbose else logging.INFO)
+
+    broker = Broker(args.simulators, args.timeout, args.connect_timeout, args.retry_delay)
+    threading.Thread(target=broker.run, daemon=True).start()
+
+    listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(('', args.port))
+    listener.listen(64)
+    logging.info('listening at port %d, %d simulators', args.port, len(args.simulators))
+    try:
+        while True:
+            client, address = listener.accept()
+            client.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            session = Session(broker, client, '%s:%d' % address)
+            threading.Thread(target=session.run, daemon=True).start()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        listener.close()
+
+
+if __name__ == '__main__':
+    main()
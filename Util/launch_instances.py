@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2017 Computer Vision Center (CVC) at the Universitat Autonoma de
+# Barcelona (UAB), and the INTEL Visual Computing Lab.
+#
+# This work is licensed under the terms of the MIT license.
+# For a copy, see <https://opensource.org/licenses/MIT>.
+
+"""Launch several CARLA simulators in this host, each pinned to its own cores.
+
+The physical cores of each NUMA node are split evenly among the instances, an
+instance never spans two nodes unless there are fewer nodes than needed. Each
+instance gets a CarlaSettings.ini with its own WorldPort and the game thread,
+rendering thread and server I/O threads pinned to disjoint subsets of its
+cores, and runs under numactl (if available) bound to the memory of its node.
+Linux only.
+"""
+
+import argparse
+import glob
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+
+def parse_cpu_list(text):
+    cpus = []
+    for item in text.strip().split(','):
+        if not item:
+            continue
+        first, _, last = item.partition('-')
+        cpus.extend(range(int(first), int(last or first) + 1))
+    return cpus
+
+
+def format_cpu_list(cpus):
+    return ','.join(str(cpu) for cpu in cpus)
+
+
+def read(path):
+    with open(path) as fd:
+        return fd.read()
+
+
+def get_numa_nodes():
+    """Return a list of nodes, each a list of cores, each a list of CPUs (the
+    hardware threads of the core)."""
+    allowed = set(os.sched_getaffinity(0))
+    node_paths = sorted(
+        glob.glob('/sys/devices/system/node/node[0-9]*'),
+        key=lambda path: int(re.search(r'(\d+)$', path).group(1)))
+    node_cpus = [parse_cpu_list(read(os.path.join(path, 'cpulist'))) for path in node_paths]
+    if not node_cpus:
+        node_cpus = [sorted(allowed)]
+    nodes = []
+    for cpus in node_cpus:
+        cores = []
+        seen = set()
+        for cpu in cpus:
+            if cpu in seen or cpu not in allowed:
+                continue
+            siblings_path = '/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list' % cpu
+            siblings = parse_cpu_list(read(siblings_path)) if os.path.exists(siblings_path) else [cpu]
+            siblings = [sibling for sibling in siblings if sibling in allowed]
+            seen.update(siblings)
+            cores.append(siblings)
+        if cores:
+            nodes.append(cores)
+    return nodes
+
+
+def assign_cores(nodes, number_of_instances):
+    """Return one (node index, cores) per instance."""
+    if len(nodes) >= number_of_instances:
+        per_node = [1] * number_of_instances + [0] * (len(nodes) - number_of_instances)
+    else:
+        per_node = [number_of_instances // len(nodes)] * len(nodes)
+        for i in range(number_of_instances % len(nodes)):
+            per_node[i] += 1
+    assignments = []
+    for index, (cores, count) in enumerate(zip(nodes, per_node)):
+        if count == 0:
+            continue
+        size = len(cores) // count
+        if size < 3:
+            raise ValueError(
+                'node %d has %d cores, not enough for %d instances' % (index, len(cores), count))
+        for i in range(count):
+            assignments.append((index, cores[i * size:(i + 1) * size]))
+    return assignments
+
+
+def split_threads(cores):
+    """Game thread on the first core, rendering thread on the second, server
+    I/O threads on the rest."""
+    flatten = lambda cores: [cpu for core in cores for cpu in core]
+    return flatten(cores[:1]), flatten(cores[1:2]), flatten(cores[2:])
+
+
+def write_settings(template, path, world_port, game_cpus, render_cpus, server_cpus, priority):
+    values = {
+        'WorldPort': str(world_port),
+        'GameThreadCPUs': format_cpu_list(game_cpus),
+        'RenderThreadCPUs': format_cpu_list(render_cpus),
+        'ServerThreadCPUs': format_cpu_list(server_cpus),
+        'ServerThreadPriority': str(priority),
+    }
+    lines = template.splitlines() if template else []
+    output = []
+    in_server_section = False
+    for line in lines:
+        stripped = line.strip()
+        if stripped.startswith('['):
+            if in_server_section:
+                output.extend('%s=%s' % item for item in sorted(values.items()))
+                values = {}
+            in_server_section = (stripped == '[CARLA/Server]')
+        elif in_server_section and '=' in stripped and not stripped.startswith(';'):
+            key = stripped.split('=', 1)[0].strip()
+            if key in values:
+                continue
+        output.append(line)
+    if values:
+        if not in_server_section:
+            output.append('[CARLA/Server]')
+        output.extend('%s=%s' % item for item in sorted(values.items()))
+    with open(path, 'w') as fd:
+        fd.write('\n'.join(output) + '\n')
+
+
+def main():
+    argparser = argparse.ArgumentParser(
+        description=__doc__,
+        epilog='Arguments after "--" are passed to every instance.')
+    argparser.add_argument(
+        'executable',
+        help='path to the CarlaUE4 executable (or launcher script)')
+    argparser.add_argument(
+        '-n', '--instances',
+        type=int,
+        required=True,
+        help='number of simulators to launch')
+    argparser.add_argument(
+        '-p', '--world-port',
+        type=int,
+        default=2000,
+        help='world port of the first instance (default: 2000)')
+    argparser.add_argument(
+        '--port-stride',
+        type=int,
+        default=10,
+        help='distance between the world ports of consecutive instances (default: 10)')
+    argparser.add_argument(
+        '--carla-settings',
+        metavar='PATH',
+        help='CarlaSettings.ini used as template for every instance')
+    argparser.add_argument(
+        '--priority',
+        type=int,
+        default=0,
+        help='nice value of the server I/O threads (default: 0)')
+    argparser.add_argument(
+        '--output-dir',
+        default='instances',
+        help='directory for the settings and logs of each instance (default: instances)')
+    argparser.add_argument(
+        '--dry-run',
+        action='store_true',
+        help='print the commands without launching anything')
+    argv = sys.argv[1:]
+    separator = argv.index('--') if '--' in argv else len(argv)
+    extra_args = argv[separator + 1:]
+    args = argparser.parse_args(argv[:separator])
+
+    if args.instances < 1:
+        argparser.error('the number of instances must be positive')
+    if args.port_stride < 5:
+        argparser.error('each instance needs at least 5 consecutive ports')
+
+    template = read(args.carla_settings) if args.carla_settings else ''
+    numactl = shutil.which('numactl')
+    os.makedirs(args.output_dir, exist_ok=True)
+
+    try:
+        assignments = assign_cores(get_numa_nodes(), args.instances)
+    except ValueError as error:
+        sys.exit('error: %s' % error)
+
+    processes = []
+    for i, (node, cores) in enumerate(assignments):
+        world_port = args.world_port + i * args.port_stride
+        game_cpus, render_cpus, server_cpus = split_threads(cores)
+        all_cpus = game_cpus + render_cpus + server_cpus
+        settings_path = os.path.abspath(os.path.join(args.output_dir, 'CarlaSettings_%d.ini' % i))
+        write_settings(
+            template, settings_path, world_port,
+            game_cpus, render_cpus, server_cpus, args.priority)
+        command = []
+        if numactl is not None:
+            command += [numactl, '--cpunodebind=%d' % node, '--membind=%d' % node]
+        command += [
+            args.executable,
+            '-carla-server',
+            '-carla-settings=%s' % settings_path,
+            '-carla-world-port=%d' % world_port]
+        command += extra_args
+        print('instance %d: node %d, cpus %s, port %d' % (i, node, format_cpu_list(all_cpus), world_port))
+        print('  ' + ' '.join(command))
+        if args.dry_run:
+            continue
+        log = open(os.path.join(args.output_dir, 'instance_%d.log' % i), 'w')
+        processes.append(subprocess.Popen(
+            command,
+            stdout=log,
+            stderr=subprocess.STDOUT,
+            preexec_fn=lambda cpus=all_cpus: os.sched_setaffinity(0, cpus)))
+
+    try:
+        for process in processes:
+            process.wait()
+    except KeyboardInterrupt:
+        for process in processes:
+            process.terminate()
+
+
+if __name__ == '__main__':
+
+    main()